@@ -64,7 +64,7 @@ def envoy_test_linkopts():
 
         # TODO(mattklein123): It's not great that we universally link against the following libs.
         # In particular, -latomic is not needed on all platforms. Make this more granular.
-        "//conditions:default": ["-pthread", "-latomic"],
+        "//conditions:default": ["-pthread", "-lrt", "-latomic"],
     })
 
 # References to Envoy external dependencies should be wrapped with this function.
@@ -190,7 +190,8 @@ def envoy_cc_test(name,
                   deps = [],
                   tags = [],
                   coverage = True,
-                  local = False):
+                  local = False,
+                  tcmalloc_dep = None):
     test_lib_tags = []
     if coverage:
       test_lib_tags.append("coverage_test_lib")
@@ -202,6 +203,7 @@ def envoy_cc_test(name,
         deps = deps,
         repository = repository,
         tags = test_lib_tags,
+        tcmalloc_dep = tcmalloc_dep,
     )
     native.cc_test(
         name = name,
@@ -226,7 +228,10 @@ def envoy_cc_test_library(name,
                           external_deps = [],
                           deps = [],
                           repository = "",
-                          tags = []):
+                          tags = [],
+                          tcmalloc_dep = None):
+    if tcmalloc_dep:
+        deps += tcmalloc_external_deps(repository)
     native.cc_library(
         name = name,
         srcs = srcs,
@@ -243,6 +248,36 @@ def envoy_cc_test_library(name,
         linkstatic = 1,
     )
 
+# Envoy C++ benchmark binaries should be specified with this function. These are not run as part
+# of the test suite since timings are only meaningful in an optimized build on a quiet machine,
+# e.g. bazel run -c opt //test/benchmark:header_map_impl_benchmark.
+def envoy_cc_benchmark_binary(name,
+                              srcs = [],
+                              data = [],
+                              external_deps = [],
+                              deps = [],
+                              repository = ""):
+    envoy_cc_test_library(
+        name = name + "_lib",
+        srcs = srcs,
+        data = data,
+        external_deps = external_deps + ["benchmark"],
+        deps = deps,
+        repository = repository,
+    )
+    native.cc_binary(
+        name = name,
+        copts = envoy_copts(repository, test = True),
+        linkopts = envoy_test_linkopts(),
+        linkstatic = 1,
+        testonly = 1,
+        malloc = tcmalloc_external_dep(repository),
+        deps = [
+            ":" + name + "_lib",
+            repository + "//test/benchmark:main",
+        ],
+    )
+
 # Envoy Python test binaries should be specified with this function.
 def envoy_py_test_binary(name,
                          external_deps = [],
@@ -18,6 +18,31 @@ struct RawSlice {
   uint64_t len_;
 };
 
+/**
+ * Externally owned, immutable memory that can be added to a buffer without copying it. When no
+ * buffer references the memory anymore, done() is called.
+ */
+class BufferFragment {
+public:
+  virtual ~BufferFragment() {}
+
+  /**
+   * @return const void* a pointer to the referenced data.
+   */
+  virtual const void* data() const PURE;
+
+  /**
+   * @return size_t the size of the referenced data.
+   */
+  virtual size_t size() const PURE;
+
+  /**
+   * Called once when the data is no longer referenced by any buffer. Since data can be moved
+   * between buffers, this may happen on a different thread than the one that added the fragment.
+   */
+  virtual void done() PURE;
+};
+
 /**
  * A basic buffer abstraction.
  */
@@ -44,6 +69,13 @@ public:
    */
   virtual void add(const Instance& data) PURE;
 
+  /**
+   * Add externally owned data to the buffer without copying it. The data must remain valid and
+   * unchanged until fragment.done() is called.
+   * @param fragment supplies the data. It is not owned by the buffer.
+   */
+  virtual void addBufferFragment(BufferFragment& fragment) PURE;
+
   /**
    * Commit a set of slices originally obtained from reserve(). The number of slices can be
    * different from the number obtained from reserve(). The size of each slice can also be altered.
@@ -65,13 +97,7 @@ public:
    * @return the actual number of slices needed, which may be greater than out_size. Passing
    *         nullptr for out and 0 for out_size will just return the size of the array needed
    *         to capture all of the slice data.
-   * TODO(mattklein123): WARNING: The underlying implementation of this function currently uses
-   * libevent's evbuffer. It has the infuriating property where calling getRawSlices(nullptr, 0)
-   * will return the slices that include all of the buffer data, but not any empty slices at the
-   * end. However, calling getRawSlices(iovec, SOME_CONST), WILL return potentially empty slices
-   * beyond the end of the buffer. Code that is trying to avoid stack overflow by limiting the
-   * number of returned slices needs to deal with this. When we get rid of evbuffer we can rework
-   * all of this.
+   *         Slices never have a length of 0.
    */
   virtual uint64_t getRawSlices(RawSlice* out, uint64_t out_size) const PURE;
 
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "envoy/common/pure.h"
+
+namespace Envoy {
+namespace Regex {
+
+/**
+ * A compiled regular expression. Implementations must match in time linear in the length of the
+ * input so that they are safe to evaluate against untrusted request data.
+ */
+class CompiledMatcher {
+public:
+  virtual ~CompiledMatcher() {}
+
+  /**
+   * @return whether the expression matches the entirety of value.
+   */
+  virtual bool match(const std::string& value) const PURE;
+
+  /**
+   * @return whether the expression matches the entirety of the range [begin, end).
+   */
+  virtual bool match(const char* begin, const char* end) const PURE;
+
+  /**
+   * Match the entirety of value and extract capturing groups.
+   * @param value supplies the string to match.
+   * @param captures supplies the vector to fill with the value of each capturing group in order.
+   *        Groups that did not participate in the match are empty.
+   * @return whether the expression matched.
+   */
+  virtual bool match(const std::string& value, std::vector<std::string>& captures) const PURE;
+
+  /**
+   * @return whether the expression matches any part of value, like ECMAScript's RegExp.test().
+   */
+  virtual bool search(const std::string& value) const PURE;
+};
+
+typedef std::unique_ptr<const CompiledMatcher> CompiledMatcherPtr;
+
+} // namespace Regex
+} // namespace Envoy
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+
+#include "envoy/buffer/buffer.h"
+#include "envoy/common/pure.h"
+
+namespace Envoy {
+namespace Compressor {
+
+/**
+ * A streaming compressor. The output of all the calls of a stream form a single compressed stream.
+ */
+class Compressor {
+public:
+  virtual ~Compressor() {}
+
+  /**
+   * Compress a chunk of a stream in place. The output is flushed, so that the peer can decompress
+   * everything it has received so far.
+   * @param buffer supplies the chunk to compress, and receives its compressed output.
+   * @param end_stream supplies whether the chunk is the last one of the stream.
+   */
+  virtual void compress(Buffer::Instance& buffer, bool end_stream) PURE;
+
+  /**
+   * Reset the compressor so that it can start a new stream, keeping the memory it allocated.
+   */
+  virtual void reset() PURE;
+};
+
+typedef std::unique_ptr<Compressor> CompressorPtr;
+
+} // namespace Compressor
+} // namespace Envoy
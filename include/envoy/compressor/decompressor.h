@@ -0,0 +1,41 @@
+#pragma once
+
+#include <memory>
+
+#include "envoy/buffer/buffer.h"
+#include "envoy/common/pure.h"
+
+namespace Envoy {
+namespace Compressor {
+
+/**
+ * A streaming decompressor. The input of all the calls of a stream form a single compressed stream.
+ */
+class Decompressor {
+public:
+  virtual ~Decompressor() {}
+
+  /**
+   * Decompress a chunk of a stream in place.
+   * @param buffer supplies the chunk to decompress, and receives its decompressed output. It is
+   *        left unchanged if the chunk is not valid, and the decompressor must then be reset.
+   * @return bool whether the chunk is valid. Data that follows the end of the stream is not, nor
+   *         is a chunk that takes the output of the stream over the limit of the decompressor.
+   */
+  virtual bool decompress(Buffer::Instance& buffer) PURE;
+
+  /**
+   * @return bool whether the end of the stream has been decompressed.
+   */
+  virtual bool finished() const PURE;
+
+  /**
+   * Reset the decompressor so that it can start a new stream, keeping the memory it allocated.
+   */
+  virtual void reset() PURE;
+};
+
+typedef std::unique_ptr<Decompressor> DecompressorPtr;
+
+} // namespace Compressor
+} // namespace Envoy
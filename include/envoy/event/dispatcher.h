@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -122,6 +123,13 @@ public:
    */
   virtual TimerPtr createTimer(TimerCb cb) PURE;
 
+  /**
+   * Allocate a timer with a given precision. @see Event::Timer for docs on how to use the timer.
+   * @param cb supplies the callback to invoke when the timer fires.
+   * @param precision supplies how precisely the timer needs to fire.
+   */
+  virtual TimerPtr createTimer(TimerCb cb, TimerPrecision precision) PURE;
+
   /**
    * Submit an item for deferred delete. @see DeferredDeletable.
    */
@@ -132,6 +140,21 @@ public:
    */
   virtual void exit() PURE;
 
+  /**
+   * Start emitting stats for the dispatcher. This must be called before the dispatcher is used by
+   * any other thread.
+   * @param scope supplies the scope to emit the stats in.
+   * @param prefix supplies the prefix of the stat names, e.g. "dispatcher.".
+   */
+  virtual void initializeStats(Stats::Scope& scope, const std::string& prefix) PURE;
+
+  /**
+   * Report the callbacks of the event loop that run for longer than a threshold, in the
+   * slow_callbacks stat and in the log. This only has an effect once stats are initialized.
+   * @param threshold supplies the threshold, or 0 to disable the reporting.
+   */
+  virtual void setSlowCallbackThreshold(std::chrono::milliseconds threshold) PURE;
+
   /**
    * Listen for a signal event. Only a single dispatcher in the process can listen for signals.
    * If more than one dispatcher calls this routine in the process the behavior is undefined.
@@ -14,6 +14,18 @@ namespace Event {
  */
 typedef std::function<void()> TimerCb;
 
+/**
+ * How precisely a timer fires.
+ */
+enum class TimerPrecision {
+  // The timer fires as close to the timeout as the event loop allows.
+  Precise,
+  // The timer may fire up to a few tens of milliseconds late, which makes enabling and disabling it
+  // much cheaper. This is meant for timeouts that are usually disabled or reset before they fire,
+  // such as idle and request timeouts.
+  Coarse
+};
+
 /**
  * An abstract timer event. Free the timer to unregister any pending timeouts.
  */
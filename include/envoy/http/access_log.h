@@ -157,6 +157,7 @@ public:
 };
 
 typedef std::unique_ptr<Filter> FilterPtr;
+typedef std::shared_ptr<Filter> FilterSharedPtr;
 
 /**
  * Abstract access logger for HTTP requests and responses.
@@ -188,6 +189,15 @@ public:
   virtual std::string format(const Http::HeaderMap& request_headers,
                              const Http::HeaderMap& response_headers,
                              const RequestInfo& request_info) const PURE;
+
+  /**
+   * Append the formatted output to a string rather than returning a new string, so that callers
+   * can reuse the storage of the output across requests.
+   * @param output supplies the string the formatted output is appended to.
+   */
+  virtual void formatAppend(const Http::HeaderMap& request_headers,
+                            const Http::HeaderMap& response_headers,
+                            const RequestInfo& request_info, std::string& output) const PURE;
 };
 
 typedef std::unique_ptr<Formatter> FormatterPtr;
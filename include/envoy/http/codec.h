@@ -173,6 +173,12 @@ public:
   virtual void onGoAway() PURE;
 };
 
+/**
+ * Default limits on the headers of each request that a server connection decodes.
+ */
+const uint32_t DEFAULT_MAX_REQUEST_HEADERS_KB = 60;
+const uint32_t DEFAULT_MAX_REQUEST_HEADERS_COUNT = 100;
+
 /**
  * HTTP/1.* Codec settings
  */
@@ -180,6 +186,14 @@ struct Http1Settings {
   // Enable codec to parse absolute uris. This enables forward/explicit proxy support for non TLS
   // traffic
   bool allow_absolute_url_{false};
+  // Maximum number of pipelined requests that a server connection processes concurrently.
+  // Responses are always sent in request order; a response that completes before the ones ahead
+  // of it is held by the codec until they are done. 1 processes one request at a time.
+  uint32_t max_pipeline_depth_{1};
+  // Limits on the headers of each request that a server connection decodes. A request is rejected
+  // with a 431 as soon as its headers go over either of them.
+  uint32_t max_request_headers_kb_{DEFAULT_MAX_REQUEST_HEADERS_KB};
+  uint32_t max_request_headers_count_{DEFAULT_MAX_REQUEST_HEADERS_COUNT};
 };
 
 /**
@@ -191,6 +205,20 @@ struct Http2Settings {
   uint32_t max_concurrent_streams_{DEFAULT_MAX_CONCURRENT_STREAMS};
   uint32_t initial_stream_window_size_{DEFAULT_INITIAL_STREAM_WINDOW_SIZE};
   uint32_t initial_connection_window_size_{DEFAULT_INITIAL_CONNECTION_WINDOW_SIZE};
+  uint32_t max_frame_size_{DEFAULT_MAX_FRAME_SIZE};
+  // Only used by upstream connection pools. A pool opens up to max_connections_per_host_
+  // connections to a host, and only opens another one when every connection it has carries at least
+  // connection_stream_threshold_ active streams. New streams go to the least loaded connection.
+  uint32_t max_connections_per_host_{DEFAULT_MAX_CONNECTIONS_PER_HOST};
+  uint32_t connection_stream_threshold_{DEFAULT_CONNECTION_STREAM_THRESHOLD};
+  // Streams are sent at the maximum weight until they have sent this many bytes of DATA, so that
+  // short responses and RPCs are scheduled ahead of bulk transfers on the same connection. 0
+  // disables the boost.
+  uint32_t small_stream_boost_bytes_{0};
+  // Only used by server connections. A stream is reset as soon as the headers that it receives go
+  // over either of these limits.
+  uint32_t max_request_headers_kb_{DEFAULT_MAX_REQUEST_HEADERS_KB};
+  uint32_t max_request_headers_count_{DEFAULT_MAX_REQUEST_HEADERS_COUNT};
 
   // disable HPACK compression
   static const uint32_t MIN_HPACK_TABLE_SIZE = 0;
@@ -224,6 +252,17 @@ struct Http2Settings {
   // our default connection-level window also equals to our stream-level
   static const uint32_t DEFAULT_INITIAL_CONNECTION_WINDOW_SIZE = 256 * 1024 * 1024;
   static const uint32_t MAX_INITIAL_CONNECTION_WINDOW_SIZE = (1U << 31) - 1;
+
+  // initial value from HTTP/2 spec, which is also the minimum
+  static const uint32_t MIN_MAX_FRAME_SIZE = (1 << 14);
+  static const uint32_t DEFAULT_MAX_FRAME_SIZE = (1 << 14);
+  // maximum from HTTP/2 spec, same as NGHTTP2_MAX_FRAME_SIZE_MAX from nghttp2
+  static const uint32_t MAX_MAX_FRAME_SIZE = (1 << 24) - 1;
+
+  // a single connection per host multiplexes all streams
+  static const uint32_t DEFAULT_MAX_CONNECTIONS_PER_HOST = 1;
+  // a common SETTINGS_MAX_CONCURRENT_STREAMS of servers
+  static const uint32_t DEFAULT_CONNECTION_STREAM_THRESHOLD = 100;
 };
 
 /**
@@ -310,7 +349,15 @@ public:
 /**
  * A server side HTTP connection.
  */
-class ServerConnection : public virtual Connection {};
+class ServerConnection : public virtual Connection {
+public:
+  /**
+   * @return uint32_t the number of pipelined requests that the connection processes concurrently.
+   *         Only HTTP/1 connections pipeline, the others return 1.
+   *         @see Http1Settings::max_pipeline_depth_.
+   */
+  virtual uint32_t maxPipelineDepth() const PURE;
+};
 
 typedef std::unique_ptr<ServerConnection> ServerConnectionPtr;
 
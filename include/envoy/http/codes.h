@@ -1,5 +1,9 @@
 #pragma once
 
+#include <string>
+
+#include "envoy/common/pure.h"
+
 namespace Envoy {
 namespace Http {
 
@@ -72,5 +76,62 @@ enum class Code {
   // clang-format on
 };
 
+/**
+ * The counters of the response codes charged under one stat prefix of a scope, e.g.
+ * canary.upstream_rq_2xx and canary.upstream_rq_201. The counter of a code is looked up by name the
+ * first time the code is charged and is incremented directly after that.
+ */
+class CodeStats {
+public:
+  virtual ~CodeStats() {}
+
+  /**
+   * Increment the counter of the class of a response code and the counter of the code itself.
+   * May be called from any thread.
+   * @param code supplies the response code.
+   */
+  virtual void charge(Code code) PURE;
+};
+
+/**
+ * The response code counters of the stats scope of an upstream cluster.
+ */
+class UpstreamCodeStats {
+public:
+  virtual ~UpstreamCodeStats() {}
+
+  /**
+   * @return CodeStats& the upstream_rq_* counters.
+   */
+  virtual CodeStats& upstream() PURE;
+
+  /**
+   * @return CodeStats& the canary.upstream_rq_* counters.
+   */
+  virtual CodeStats& canary() PURE;
+
+  /**
+   * @return CodeStats& the internal.upstream_rq_* counters.
+   */
+  virtual CodeStats& internal() PURE;
+
+  /**
+   * @return CodeStats& the external.upstream_rq_* counters.
+   */
+  virtual CodeStats& external() PURE;
+
+  /**
+   * @return CodeStats& the retry.upstream_rq_* counters.
+   */
+  virtual CodeStats& retry() PURE;
+
+  /**
+   * @param from_zone supplies the zone of the local host.
+   * @param to_zone supplies the zone of the upstream host.
+   * @return CodeStats& the zone.<from_zone>.<to_zone>.upstream_rq_* counters.
+   */
+  virtual CodeStats& zone(const std::string& from_zone, const std::string& to_zone) PURE;
+};
+
 } // namespace Http
 } // namespace Envoy
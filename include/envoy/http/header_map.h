@@ -9,6 +9,15 @@
 
 #include "envoy/common/pure.h"
 
+/**
+ * The size of the inline storage of a HeaderString, including the null terminator. Values that do
+ * not fit are heap allocated, so this can be raised at build time for deployments whose typical
+ * header values are longer, at the cost of a larger HeaderString for every header.
+ */
+#ifndef ENVOY_HEADER_STRING_INLINE_SIZE
+#define ENVOY_HEADER_STRING_INLINE_SIZE 128
+#endif
+
 namespace Envoy {
 namespace Http {
 
@@ -43,6 +52,8 @@ private:
  * 1) A reference.
  * 2) Interned string.
  * 3) Heap allocated storage.
+ * Heap allocated storage is reference counted, so that copies made with setShared() share it until
+ * one of them is modified.
  */
 class HeaderString {
 public:
@@ -77,9 +88,13 @@ public:
   void append(const char* data, uint32_t size);
 
   /**
-   * @return the modifiable backing buffer (either inline or heap allocated).
+   * @return the modifiable backing buffer (either inline or heap allocated). Heap allocated storage
+   *         that is shared with other strings is copied first.
    */
-  char* buffer() { return buffer_.dynamic_; }
+  char* buffer() {
+    unshare();
+    return buffer_.dynamic_;
+  }
 
   /**
    * @return a null terminated C string.
@@ -119,6 +134,14 @@ public:
    */
   void setReference(const std::string& ref_value);
 
+  /**
+   * Set the value of the string to the value of another string. Heap allocated storage is shared
+   * with the other string rather than copied, and is only copied once either string is modified.
+   * Inline and reference strings are copied, since the copy may outlive the request/response
+   * that a reference was made for.
+   */
+  void setShared(const HeaderString& value);
+
   /**
    * @return the size of the string, not including the null terminator.
    */
@@ -139,11 +162,15 @@ private:
   } buffer_;
 
   union {
-    char inline_buffer_[128];
+    char inline_buffer_[ENVOY_HEADER_STRING_INLINE_SIZE];
     uint32_t dynamic_capacity_;
   };
 
+  // setInteger() writes up to 32 bytes into inline storage.
+  static_assert(ENVOY_HEADER_STRING_INLINE_SIZE >= 32, "inline storage is too small");
+
   void freeDynamic();
+  void unshare();
 
   uint32_t string_length_;
   Type type_;
@@ -222,6 +249,7 @@ private:
   HEADER_FUNC(EnvoyForceTrace)                                                                     \
   HEADER_FUNC(EnvoyImmediateHealthCheckFail)                                                       \
   HEADER_FUNC(EnvoyInternalRequest)                                                                \
+  HEADER_FUNC(EnvoyIpTags)                                                                         \
   HEADER_FUNC(EnvoyMaxRetries)                                                                     \
   HEADER_FUNC(EnvoyOriginalPath)                                                                   \
   HEADER_FUNC(EnvoyRetryOn)                                                                        \
@@ -229,6 +257,8 @@ private:
   HEADER_FUNC(EnvoyUpstreamAltStatName)                                                            \
   HEADER_FUNC(EnvoyUpstreamCanary)                                                                 \
   HEADER_FUNC(EnvoyUpstreamHealthCheckedCluster)                                                   \
+  HEADER_FUNC(EnvoyUpstreamLoad)                                                                   \
+  HEADER_FUNC(EnvoyUpstreamRequestHedgeDelayMs)                                                    \
   HEADER_FUNC(EnvoyUpstreamRequestPerTryTimeoutMs)                                                 \
   HEADER_FUNC(EnvoyUpstreamRequestTimeoutAltResponse)                                              \
   HEADER_FUNC(EnvoyUpstreamRequestTimeoutMs)                                                       \
@@ -238,6 +268,7 @@ private:
   HEADER_FUNC(ForwardedFor)                                                                        \
   HEADER_FUNC(ForwardedProto)                                                                      \
   HEADER_FUNC(GrpcAcceptEncoding)                                                                  \
+  HEADER_FUNC(GrpcEncoding)                                                                        \
   HEADER_FUNC(GrpcMessage)                                                                         \
   HEADER_FUNC(GrpcStatus)                                                                          \
   HEADER_FUNC(Host)                                                                                \
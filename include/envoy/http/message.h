@@ -27,6 +27,11 @@ public:
    */
   virtual Buffer::InstancePtr& body() PURE;
 
+  /**
+   * @return const Buffer::InstancePtr& the message body, if any.
+   */
+  virtual const Buffer::InstancePtr& body() const PURE;
+
   /**
    * @return HeaderMap* the message trailers, if any.
    */
@@ -17,6 +17,12 @@ public:
    * client when there are errors establishing a connection to upstream server.
    */
   virtual void sendHeadersOnlyResponse(HeaderMap& headers) PURE;
+
+  /**
+   * Called by a WebSocket implementation once the connection to the upstream server is
+   * established. No response is sent through the callbacks afterwards.
+   */
+  virtual void onUpstreamConnected() PURE;
 };
 
 } // namespace Http
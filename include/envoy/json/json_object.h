@@ -155,7 +155,8 @@ public:
    * Validates JSON object against passed in schema.
    * @param schema supplies the schema in string format. A Json::Exception will be thrown if
    *        the JSON object doesn't conform to the supplied schema or the schema itself is not
-   *        valid.
+   *        valid. Valid schemas are compiled once and kept for the life of the process, so they
+   *        should come from a fixed set, e.g. Json::Schema.
    */
   virtual void validateSchema(const std::string& schema) const PURE;
 
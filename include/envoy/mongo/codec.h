@@ -152,6 +152,16 @@ class DecoderCallbacks {
 public:
   virtual ~DecoderCallbacks() {}
 
+  /**
+   * Called once the header of a message is decoded, before the rest of the message is.
+   * @param request_id supplies the ID of the message.
+   * @param response_to supplies the ID of the message that the message responds to.
+   * @param op_code supplies the op of the message.
+   * @return bool whether to decode the message. The messages that are not decoded are drained
+   *         without being parsed.
+   */
+  virtual bool decodeHeader(int32_t request_id, int32_t response_to,
+                            Message::OpCode op_code) PURE;
   virtual void decodeGetMore(GetMoreMessagePtr&& message) PURE;
   virtual void decodeInsert(InsertMessagePtr&& message) PURE;
   virtual void decodeKillCursors(KillCursorsMessagePtr&& message) PURE;
@@ -57,6 +57,35 @@ public:
   virtual void onBelowWriteBufferLowWatermark() PURE;
 };
 
+/**
+ * Socket options that are set on listen sockets and on upstream connections beyond the ones that
+ * are always set. A value of 0 leaves an option at the default of the kernel. Connections
+ * accepted from a listen socket inherit its options.
+ */
+struct SocketOptions {
+  // Listen sockets only: the length of the queue of TCP Fast Open connections that have not been
+  // accepted yet. 0 disables TCP Fast Open.
+  uint32_t tcp_fast_open_queue_length_{0};
+  // Listen sockets only: the seconds for which a connection is not accepted until its first data
+  // arrives.
+  uint32_t defer_accept_seconds_{0};
+  // Upstream connections only: whether the first write is sent with the SYN to hosts that have
+  // handed out a TCP Fast Open cookie before.
+  bool tcp_fast_open_connect_{false};
+  // The unsent bytes in the kernel above which the socket is no longer writable.
+  uint32_t notsent_lowat_bytes_{0};
+  // The microseconds for which a read busy polls the device queue before it blocks.
+  uint32_t busy_poll_us_{0};
+  uint32_t receive_buffer_bytes_{0};
+  uint32_t send_buffer_bytes_{0};
+
+  bool empty() const {
+    return tcp_fast_open_queue_length_ == 0 && defer_accept_seconds_ == 0 &&
+           !tcp_fast_open_connect_ && notsent_lowat_bytes_ == 0 && busy_poll_us_ == 0 &&
+           receive_buffer_bytes_ == 0 && send_buffer_bytes_ == 0;
+  }
+};
+
 /**
  * Type of connection close to perform.
  */
@@ -88,6 +117,12 @@ public:
    */
   virtual void addConnectionCallbacks(ConnectionCallbacks& cb) PURE;
 
+  /**
+   * Unregister callbacks registered with addConnectionCallbacks(). This must not be called while
+   * the connection raises an event.
+   */
+  virtual void removeConnectionCallbacks(ConnectionCallbacks& cb) PURE;
+
   /**
    * Close the connection.
    */
@@ -205,6 +240,17 @@ public:
    * @return boolean telling if the connection is currently above the high watermark.
    */
   virtual bool aboveHighWatermark() const PURE;
+
+  /**
+   * Move the data read from this connection to the socket of another connection, and the other way
+   * around, with splice(2) through a pipe, so that it is not copied to user space. From then on the
+   * read filters of neither connection see data. Both connections must be plaintext, run on the
+   * same dispatcher, and have no filters other than a single read filter each, and splice(2) needs
+   * Linux.
+   * @param peer supplies the connection to splice with.
+   * @return bool whether splicing started. When it did not, both connections are unchanged.
+   */
+  virtual bool spliceWith(Connection& peer) PURE;
 };
 
 typedef std::unique_ptr<Connection> ConnectionPtr;
@@ -219,6 +265,12 @@ public:
    * registered via setConnectionEventCb().
    */
   virtual void connect() PURE;
+
+  /**
+   * Set socket options on the connection. Must be called before connect(). Options that the
+   * kernel rejects are logged and left unset.
+   */
+  virtual void setSocketOptions(const SocketOptions& options) PURE;
 };
 
 typedef std::unique_ptr<ClientConnection> ClientConnectionPtr;
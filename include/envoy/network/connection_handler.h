@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 
 #include "envoy/network/connection.h"
@@ -71,10 +72,30 @@ public:
    */
   virtual void stopListeners(uint64_t listener_tag) PURE;
 
+  /**
+   * Stop listeners using the listener tag as a key, and remove them once all of their connections
+   * have closed. This is used to update a listener without draining its connections.
+   * @param listener_tag supplies the tag passed to addListener().
+   * @param completion supplies the completion that is called for each listener once it is removed,
+   *        either because its last connection closed or by removeListeners().
+   */
+  virtual void retireListeners(uint64_t listener_tag, std::function<void()> completion) PURE;
+
   /**
    * Stop all listeners. This will not close any connections and is used for draining.
    */
   virtual void stopListeners() PURE;
+
+  /**
+   * Stop accepting new connections on all listeners, including those added later, until
+   * enableListeners() is called. The connections wait in the accept queue of the kernel meanwhile.
+   */
+  virtual void disableListeners() PURE;
+
+  /**
+   * Resume accepting new connections on all listeners.
+   */
+  virtual void enableListeners() PURE;
 };
 
 typedef std::unique_ptr<ConnectionHandler> ConnectionHandlerPtr;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <functional>
 #include <list>
 #include <memory>
@@ -24,7 +25,27 @@ public:
   virtual void cancel() PURE;
 };
 
-enum class DnsLookupFamily { V4Only, V6Only, Auto };
+/**
+ * The address families a name is resolved to. Auto resolves to IPv6 addresses, and to IPv4
+ * addresses if there are none. All resolves to the addresses of both families, interleaved starting
+ * with IPv6 as RFC 8305 suggests.
+ */
+enum class DnsLookupFamily { V4Only, V6Only, Auto, All };
+
+/**
+ * How a DNS resolver caches its answers. Answers are cached for the TTL of their records, clamped
+ * to [min_ttl_, max_ttl_]. Answers from the hosts file and address literals are never cached.
+ */
+struct DnsCacheConfig {
+  // The shortest time an answer is cached for.
+  std::chrono::seconds min_ttl_{0};
+  // The longest time an answer is cached for. 0 disables the cache.
+  std::chrono::seconds max_ttl_{0};
+  // The time a name that does not exist, or has no addresses of the family, is cached for.
+  std::chrono::seconds negative_ttl_{0};
+  // The time an expired answer is still served for while it is resolved again in the background.
+  std::chrono::seconds stale_ttl_{0};
+};
 
 /**
  * An asynchronous DNS resolver.
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -10,6 +11,46 @@
 namespace Envoy {
 namespace Network {
 
+/**
+ * A limit on the active connections of a listener, which is shared by all of the workers that the
+ * listener runs on. A worker stops accepting from the listen socket of the listener while the limit
+ * is reached, so that new connections wait in the accept queue instead of being accepted and
+ * closed. All methods may be called from any thread.
+ */
+class ConnectionLimit {
+public:
+  virtual ~ConnectionLimit() {}
+
+  /**
+   * Count a new active connection of the listener.
+   */
+  virtual void acquire() PURE;
+
+  /**
+   * Stop counting an active connection of the listener. Resumes the paused workers once the
+   * listener is below its limit.
+   */
+  virtual void release() PURE;
+
+  /**
+   * Pause a worker if the listener is at its limit.
+   * @param key supplies a key that identifies the paused worker until it is resumed.
+   * @param resume_cb supplies the callback to call once the listener is below its limit again. It
+   *        is called once, on the thread that releases the connection, and must not call back
+   *        into the limit.
+   * @return bool whether the worker was paused. If not, it may accept a connection.
+   */
+  virtual bool pause(const void* key, std::function<void()> resume_cb) PURE;
+
+  /**
+   * Drop the resume callback of a paused worker, which is not called once this returns.
+   * @param key supplies the key that the worker was paused with.
+   */
+  virtual void cancelPause(const void* key) PURE;
+};
+
+typedef std::shared_ptr<ConnectionLimit> ConnectionLimitSharedPtr;
+
 /**
  * Listener configurations options.
  */
@@ -25,6 +66,11 @@ struct ListenerOptions {
   bool use_original_dst_;
   // Soft limit on size of the listener's new connection read and write buffers.
   uint32_t per_connection_buffer_limit_bytes_;
+  // Maximum number of connections accepted each time the listen socket is readable. Connections
+  // beyond this are accepted in the next iteration of the event loop. 0 means no limit.
+  uint32_t max_accepts_per_event_;
+  // Limit on the active connections of the listener, or nullptr if the listener has no limit.
+  ConnectionLimitSharedPtr connection_limit_;
 
   /**
    * Factory for ListenerOptions with bind_to_port_ set.
@@ -34,7 +80,9 @@ struct ListenerOptions {
     return {.bind_to_port_ = true,
             .use_proxy_proto_ = false,
             .use_original_dst_ = false,
-            .per_connection_buffer_limit_bytes_ = 0};
+            .per_connection_buffer_limit_bytes_ = 0,
+            .max_accepts_per_event_ = 0,
+            .connection_limit_ = nullptr};
   }
 };
 
@@ -45,6 +93,27 @@ class ListenerCallbacks {
 public:
   virtual ~ListenerCallbacks() {}
 
+  /**
+   * Called when a new socket is accepted, before a connection is created for it.
+   * @param fd supplies the socket.
+   * @param remote_address supplies the remote address of the socket.
+   * @param local_address supplies the local address of the socket.
+   * @param using_original_dst supplies whether the local address is the original destination of a
+   *        redirected connection.
+   * @return bool whether the callee took over the socket, for example to create the connection on
+   *         another worker. If so the listener does not create a connection for it.
+   */
+  virtual bool onAccept(int fd, Address::InstanceConstSharedPtr remote_address,
+                        Address::InstanceConstSharedPtr local_address,
+                        bool using_original_dst) PURE;
+
+  /**
+   * Called before each socket is accepted from the listen socket.
+   * @return bool whether to accept the next socket. If not, the socket is left in the accept queue
+   *         and the callee disables the listener until it can accept again.
+   */
+  virtual bool canAccept() PURE;
+
   /**
    * Called when a new connection is accepted.
    * @param new_connection supplies the new connection that is moved into the callee.
@@ -58,6 +127,30 @@ public:
 class Listener {
 public:
   virtual ~Listener() {}
+
+  /**
+   * Create a connection for a socket that was accepted by another listener on the same socket, as
+   * if this listener had accepted it. This moves new connections between workers. The listener
+   * callbacks are not asked to take over the socket again.
+   * @param fd supplies the socket. The listener takes ownership.
+   * @param remote_address supplies the remote address of the socket.
+   * @param local_address supplies the local address of the socket.
+   * @param using_original_dst supplies whether the local address is the original destination of a
+   *        redirected connection.
+   */
+  virtual void newConnection(int fd, Address::InstanceConstSharedPtr remote_address,
+                             Address::InstanceConstSharedPtr local_address,
+                             bool using_original_dst) PURE;
+
+  /**
+   * Stop accepting new connections until enable() is called.
+   */
+  virtual void disable() PURE;
+
+  /**
+   * Resume accepting new connections.
+   */
+  virtual void enable() PURE;
 };
 
 typedef std::unique_ptr<Listener> ListenerPtr;
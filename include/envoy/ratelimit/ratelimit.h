@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -83,6 +84,11 @@ public:
 
 typedef std::unique_ptr<Client> ClientPtr;
 
+/**
+ * A callback that creates a rate limit client, used by the clients that wrap another client.
+ */
+typedef std::function<ClientPtr()> ClientCreateCb;
+
 /**
  * An interface for creating a rate limit client.
  */
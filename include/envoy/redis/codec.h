@@ -22,8 +22,15 @@ enum class RespType { Null, SimpleString, BulkString, Integer, Error, Array };
 class RespValue {
 public:
   RespValue() : type_(RespType::Null) {}
+  RespValue(const RespValue& other);
   ~RespValue() { cleanup(); }
 
+  /**
+   * Deep copy a value, including its encoded bytes if it has any (which share memory with the
+   * original's).
+   */
+  RespValue& operator=(const RespValue& other);
+
   /**
    * Convert a RESP value to a string for debugging purposes.
    */
@@ -47,6 +54,15 @@ public:
   RespType type() const { return type_; }
   void type(RespType type);
 
+  /**
+   * @return const Buffer::Instance* the encoded bytes a top level value was decoded from, or
+   *         nullptr if the value was not decoded. The bytes are dropped when the value is changed
+   *         via type() or the non-const getters, so they always match the value. Encoders forward
+   *         them verbatim instead of serializing the value again.
+   */
+  const Buffer::Instance* raw() const { return raw_.get(); }
+  void raw(Buffer::InstancePtr&& raw) { raw_ = std::move(raw); }
+
 private:
   union {
     std::vector<RespValue> array_;
@@ -57,6 +73,7 @@ private:
   void cleanup();
 
   RespType type_;
+  Buffer::InstancePtr raw_;
 };
 
 typedef std::unique_ptr<RespValue> RespValuePtr;
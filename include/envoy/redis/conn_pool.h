@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -68,10 +69,28 @@ public:
    *         for some reason.
    */
   virtual PoolRequest* makeRequest(const RespValue& request, PoolCallbacks& callbacks) PURE;
+
+  /**
+   * @return uint64_t the number of requests that are waiting for a response, including the
+   *         cancelled ones.
+   */
+  virtual uint64_t numPendingRequests() const PURE;
 };
 
 typedef std::unique_ptr<Client> ClientPtr;
 
+/**
+ * Where read-only requests are sent in cluster mode.
+ */
+enum class ReadPolicy {
+  // Reads are sent to the master of the slot, like all requests.
+  Master,
+  // Reads are spread over the replicas of the slot, or sent to its master if it has none.
+  PreferReplica,
+  // Reads are spread over the master and the replicas of the slot.
+  Any
+};
+
 /**
  * Configuration for a redis connection pool.
  */
@@ -84,6 +103,46 @@ public:
    *         all operations use the same timeout.
    */
   virtual std::chrono::milliseconds opTimeout() const PURE;
+
+  /**
+   * @return uint32_t the size the buffer of encoded requests of a connection can reach before it
+   *         is written. Smaller buffers are written at the end of the current event loop
+   *         iteration, so requests made in the same iteration share a write. 0 writes every
+   *         request as it is made.
+   */
+  virtual uint32_t maxBufferSizeBeforeFlush() const PURE;
+
+  /**
+   * @return uint32_t the maximum number of connections to each upstream host.
+   */
+  virtual uint32_t maxConnectionsPerHost() const PURE;
+
+  /**
+   * @return uint32_t the number of pending requests on every connection to a host after which a
+   *         new connection is made to it, as long as maxConnectionsPerHost() allows. 0 for no
+   *         limit. Once all the connections are made, requests go to the least loaded one.
+   */
+  virtual uint32_t maxRequestsPerConnection() const PURE;
+
+  /**
+   * @return bool whether the upstream cluster is a Redis Cluster. Requests are then routed by the
+   *         slot of their hash key, using the slot map discovered with CLUSTER SLOTS, and MOVED
+   *         and ASK redirections are followed.
+   */
+  virtual bool clusterMode() const PURE;
+
+  /**
+   * @return std::chrono::milliseconds how often the slot map is discovered again in cluster mode.
+   *         A MOVED redirection triggers a discovery right away.
+   */
+  virtual std::chrono::milliseconds clusterRefreshInterval() const PURE;
+
+  /**
+   * @return ReadPolicy where the requests made with Instance::makeReadRequest() are sent in
+   *         cluster mode. Outside of cluster mode, replicas are not known and reads are load
+   *         balanced like the other requests.
+   */
+  virtual ReadPolicy readPolicy() const PURE;
 };
 
 /**
@@ -122,6 +181,29 @@ public:
    */
   virtual PoolRequest* makeRequest(const std::string& hash_key, const RespValue& request,
                                    PoolCallbacks& callbacks) PURE;
+
+  /**
+   * Makes a read-only redis request, which may be sent to a replica according to
+   * Config::readPolicy().
+   * @param hash_key supplies the key to use for consistent hashing.
+   * @param request supplies the request to make.
+   * @param callbacks supplies the request completion callbacks.
+   * @return PoolRequest* a handle to the active request or nullptr if the request could not be made
+   *         for some reason.
+   */
+  virtual PoolRequest* makeReadRequest(const std::string& hash_key, const RespValue& request,
+                                       PoolCallbacks& callbacks) PURE;
+
+  /**
+   * Find where the requests for a key are sent, so that the requests for several keys can be
+   * combined. In cluster mode, this is the slot of the key since a request may only name keys of
+   * a single slot.
+   * @param hash_key supplies the key to use for consistent hashing.
+   * @return uint64_t an identifier of the upstream of the key. The requests for the keys with the
+   *         same identifier can be combined into a single request made with any of these keys, as
+   *         long as this is done right away.
+   */
+  virtual uint64_t upstreamId(const std::string& hash_key) PURE;
 };
 
 typedef std::unique_ptr<Instance> InstancePtr;
@@ -13,6 +13,7 @@
 #include "envoy/upstream/cluster_manager.h"
 
 #include "api/filter/http_connection_manager.pb.h"
+#include "api/rds.pb.h"
 
 namespace Envoy {
 namespace Router {
@@ -42,6 +43,20 @@ public:
   getRouteConfigProvider(const envoy::api::v2::filter::Rds& rds, Upstream::ClusterManager& cm,
                          Stats::Scope& scope, const std::string& stat_prefix,
                          Init::Manager& init_manager) PURE;
+
+  /**
+   * Get a RouteConfigProviderSharedPtr for a static route configuration. Identical route
+   * configurations share one compiled configuration for as long as any provider holds it, so the
+   * memory used by a route table does not grow with the number of HttpConnectionManagers that
+   * use it. Each call still validates the clusters of the configuration if it asks for it.
+   * @param route_config supplies the static route configuration.
+   * @param runtime supplies the runtime that the configuration refers to.
+   * @param cm supplies the cluster manager to validate the clusters against.
+   * @throw EnvoyException if the configuration is invalid.
+   */
+  virtual RouteConfigProviderSharedPtr
+  getStaticRouteConfigProvider(const envoy::api::v2::RouteConfiguration& route_config,
+                               Runtime::Loader& runtime, Upstream::ClusterManager& cm) PURE;
 };
 
 /**
@@ -7,14 +7,20 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "envoy/common/optional.h"
 #include "envoy/http/codec.h"
 #include "envoy/http/header_map.h"
 #include "envoy/tracing/http_tracer.h"
+#include "envoy/upstream/load_balancer.h"
 #include "envoy/upstream/resource_manager.h"
 
 namespace Envoy {
+namespace Upstream {
+class ClusterHandle;
+}
+
 namespace Router {
 
 /**
@@ -44,6 +50,12 @@ public:
    */
   virtual const std::list<std::string>& allowOrigins() const PURE;
 
+  /**
+   * @param origin supplies the origin of a request.
+   * @return bool whether the origin matches any of the allowOrigins() values.
+   */
+  virtual bool originAllowed(const Http::HeaderString& origin) const PURE;
+
   /**
    * @return std::string access-control-allow-methods value.
    */
@@ -235,6 +247,13 @@ public:
    */
   virtual const std::string& clusterName() const PURE;
 
+  /**
+   * @return const Upstream::ClusterHandle* the handle of clusterName(), with which the cluster
+   *         manager finds the cluster faster than by its name, or nullptr if the route does not
+   *         keep one, e.g. because it only lives for a single request.
+   */
+  virtual const Upstream::ClusterHandle* clusterHandle() const PURE;
+
   /**
    * @return const CorsPolicy* the CORS policy for this virtual host.
    */
@@ -312,6 +331,19 @@ public:
    * @return bool true if the virtual host rate limits should be included.
    */
   virtual bool includeVirtualHostRateLimits() const PURE;
+
+  /**
+   * @return const Upstream::MetadataMatchCriteria* the endpoint metadata that the upstream host
+   *         must match, or nullptr if the route does not restrict the hosts of the cluster.
+   */
+  virtual const Upstream::MetadataMatchCriteria* metadataMatchCriteria() const PURE;
+
+  /**
+   * @return Optional<uint32_t> the limit in bytes of the data that the filters of a request of the
+   *         route and its upstream request buffer, or an invalid value if the request uses the
+   *         buffer limit of the connection.
+   */
+  virtual Optional<uint32_t> perRequestBufferLimit() const PURE;
 };
 
 /**
@@ -377,20 +409,20 @@ public:
    * Return a list of headers that will be cleaned from any requests that are not from an internal
    * (RFC1918) source.
    */
-  virtual const std::list<Http::LowerCaseString>& internalOnlyHeaders() const PURE;
+  virtual const std::vector<Http::LowerCaseString>& internalOnlyHeaders() const PURE;
 
   /**
    * Return a list of header key/value pairs that will be added to every response that transits the
    * router.
    */
-  virtual const std::list<std::pair<Http::LowerCaseString, std::string>>&
+  virtual const std::vector<std::pair<Http::LowerCaseString, std::string>>&
   responseHeadersToAdd() const PURE;
 
   /**
    * Return a list of upstream headers that will be stripped from every response that transits the
    * router.
    */
-  virtual const std::list<Http::LowerCaseString>& responseHeadersToRemove() const PURE;
+  virtual const std::vector<Http::LowerCaseString>& responseHeadersToRemove() const PURE;
 
   /**
    * Return whether the configuration makes use of runtime or not. Callers can use this to
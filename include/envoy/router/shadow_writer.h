@@ -4,15 +4,44 @@
 #include <memory>
 #include <string>
 
+#include "envoy/buffer/buffer.h"
+#include "envoy/http/header_map.h"
 #include "envoy/http/message.h"
 
 namespace Envoy {
 namespace Router {
 
 /**
- * Interface used to shadow complete requests to an alternate upstream cluster in a "fire and
- * forget" fashion. Right now this interface takes a fully buffered request and cannot be used for
- * streaming. This is sufficient for current use cases.
+ * A shadow request whose body is sent as it is received. Destroying the stream before the request
+ * is complete resets the shadow request. Once the request is complete, the shadow request
+ * continues in a "fire and forget" fashion.
+ */
+class ShadowStream {
+public:
+  virtual ~ShadowStream() {}
+
+  /**
+   * Send request data. The data is not drained, so the caller can still proxy it. Data is
+   * silently dropped if the shadow request already ended, e.g. because it was reset.
+   * @param data supplies the data to send.
+   * @param end_stream supplies whether this is the last data.
+   * @return false if the shadow request was abandoned because of the limit on shadowed bytes in
+   *         flight. The stream must not be used anymore in that case.
+   */
+  virtual bool sendData(const Buffer::Instance& data, bool end_stream) PURE;
+
+  /**
+   * Send request trailers, which ends the request.
+   * @param trailers supplies the trailers to send.
+   */
+  virtual void sendTrailers(const Http::HeaderMap& trailers) PURE;
+};
+
+typedef std::unique_ptr<ShadowStream> ShadowStreamPtr;
+
+/**
+ * Interface used to shadow requests to an alternate upstream cluster in a "fire and forget"
+ * fashion, either as complete requests or as they are received.
  */
 class ShadowWriter {
 public:
@@ -26,6 +55,18 @@ public:
    */
   virtual void shadow(const std::string& cluster, Http::MessagePtr&& request,
                       std::chrono::milliseconds timeout) PURE;
+
+  /**
+   * Start shadowing a request whose body and trailers are sent as they are received.
+   * @param cluster supplies the cluster name to shadow to.
+   * @param headers supplies the request headers. They are copied.
+   * @param end_stream supplies whether this is a header only request.
+   * @param timeout supplies the shadowed request timeout.
+   * @return ShadowStreamPtr the stream to send the rest of the request on, or nullptr if
+   *         end_stream is true or the shadow request failed to start.
+   */
+  virtual ShadowStreamPtr streamShadow(const std::string& cluster, const Http::HeaderMap& headers,
+                                       bool end_stream, std::chrono::milliseconds timeout) PURE;
 };
 
 typedef std::unique_ptr<ShadowWriter> ShadowWriterPtr;
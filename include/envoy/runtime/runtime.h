@@ -1,8 +1,10 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
+#include <unordered_map>
 
 #include "envoy/common/pure.h"
 
@@ -26,10 +28,41 @@ public:
    * for example, 7c25513b-0466-4558-a64c-12c6704f37ed
    */
   virtual std::string uuid() PURE;
+
+  /**
+   * Write a uuid4 without allocating. @see uuid().
+   * @param buffer supplies the buffer to write UUID_LENGTH chars to. No null terminator is written.
+   */
+  virtual void uuid(char* buffer) PURE;
+
+  static const size_t UUID_LENGTH = 36;
 };
 
 typedef std::unique_ptr<RandomGenerator> RandomGeneratorPtr;
 
+/**
+ * A runtime key with its hash computed up front. Keys used on the request path should be created
+ * once at configuration time so that lookups do not hash the key string on every call.
+ */
+class Key {
+public:
+  explicit Key(const std::string& name) : name_(name), hash_(std::hash<std::string>()(name_)) {}
+
+  /**
+   * @return const std::string& the key name.
+   */
+  const std::string& name() const { return name_; }
+
+  /**
+   * @return size_t the hash of the key name, which matches std::hash<std::string>.
+   */
+  size_t hash() const { return hash_; }
+
+private:
+  std::string name_;
+  size_t hash_;
+};
+
 /**
  * A snapshot of runtime data.
  */
@@ -96,8 +129,50 @@ public:
    * @return uint64_t the runtime value or the default value.
    */
   virtual uint64_t getInteger(const std::string& key, uint64_t default_value) const PURE;
+
+  /**
+   * Variants of the above that use a prehashed key. @see Key.
+   */
+  virtual bool featureEnabled(const Key& key, uint64_t default_value) const PURE;
+  virtual bool featureEnabled(const Key& key, uint64_t default_value,
+                              uint64_t random_value) const PURE;
+  virtual bool featureEnabled(const Key& key, uint64_t default_value, uint64_t random_value,
+                              uint16_t num_buckets) const PURE;
+  virtual const std::string& get(const Key& key) const PURE;
+  virtual uint64_t getInteger(const Key& key, uint64_t default_value) const PURE;
 };
 
+/**
+ * A runtime key that the loader resolves once per snapshot, so that a lookup does not search for
+ * the key on every call. The values are always those of the calling thread's current snapshot.
+ */
+class FeatureHandle {
+public:
+  virtual ~FeatureHandle() {}
+
+  /**
+   * @see Snapshot::featureEnabled(const std::string&, uint64_t).
+   */
+  virtual bool featureEnabled(uint64_t default_value) const PURE;
+
+  /**
+   * @see Snapshot::featureEnabled(const std::string&, uint64_t, uint64_t).
+   */
+  virtual bool featureEnabled(uint64_t default_value, uint64_t random_value) const PURE;
+
+  /**
+   * @see Snapshot::getInteger(const std::string&, uint64_t).
+   */
+  virtual uint64_t getInteger(uint64_t default_value) const PURE;
+
+  /**
+   * @return const std::string& the runtime key.
+   */
+  virtual const std::string& key() const PURE;
+};
+
+typedef std::shared_ptr<const FeatureHandle> FeatureHandleSharedPtr;
+
 /**
  * Loads runtime snapshots from storage (local disk, etc.).
  */
@@ -111,6 +186,23 @@ public:
    *         fetched again when needed.
    */
   virtual Snapshot& snapshot() PURE;
+
+  /**
+   * Create a handle for a runtime key. This should be done at configuration time on the main
+   * thread. The handle can then be used on any thread for as long as the loader exists.
+   * @param key supplies the runtime key.
+   * @return FeatureHandleSharedPtr the handle, which is shared by all callers of the same key.
+   */
+  virtual FeatureHandleSharedPtr featureHandle(const std::string& key) PURE;
+
+  /**
+   * Merge values on top of the ones that the loader reads from its source, e.g. from an admin
+   * request. The merged values are kept until they are removed and a new snapshot is swapped in.
+   * This must be called on the main thread. An EnvoyException is thrown if the loader does not
+   * support merging values.
+   * @param values supplies the values to set. An empty value removes a previously merged value.
+   */
+  virtual void mergeValues(const std::unordered_map<std::string, std::string>& values) PURE;
 };
 
 typedef std::unique_ptr<Loader> LoaderPtr;
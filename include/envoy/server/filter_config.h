@@ -11,6 +11,7 @@
 #include "envoy/ratelimit/ratelimit.h"
 #include "envoy/runtime/runtime.h"
 #include "envoy/server/admin.h"
+#include "envoy/server/overload_manager.h"
 #include "envoy/singleton/manager.h"
 #include "envoy/thread_local/thread_local.h"
 #include "envoy/tracing/http_tracer.h"
@@ -85,6 +86,11 @@ public:
    */
   virtual Envoy::Runtime::RandomGenerator& random() PURE;
 
+  /**
+   * @return OverloadManager& the server-wide overload manager.
+   */
+  virtual OverloadManager& overloadManager() PURE;
+
   /**
    * @return a new ratelimit client. The implementation depends on the configuration of the server.
    */
@@ -39,9 +39,13 @@ public:
    * Retrieve a listening socket on the specified port from the parent process. The socket will be
    * duplicated across process boundaries.
    * @param port supplies the port of the socket to duplicate.
+   * @param worker_index supplies the index of the worker that the socket is for. If the parent has
+   *        a socket per worker this selects the socket, otherwise the parent returns its shared
+   *        socket for the address.
    * @return int the fd or -1 if there is no bound listen port in the parent.
    */
-  virtual int duplicateParentListenSocket(const std::string& address) PURE;
+  virtual int duplicateParentListenSocket(const std::string& address,
+                                          uint32_t worker_index) PURE;
 
   /**
    * Retrieve stats from our parent process.
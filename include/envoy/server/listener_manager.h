@@ -2,6 +2,7 @@
 
 #include "envoy/network/filter.h"
 #include "envoy/network/listen_socket.h"
+#include "envoy/network/listener.h"
 #include "envoy/server/drain_manager.h"
 #include "envoy/server/filter_config.h"
 #include "envoy/server/guarddog.h"
@@ -30,6 +31,16 @@ public:
   virtual Network::ListenSocketSharedPtr
   createListenSocket(Network::Address::InstanceConstSharedPtr address, bool bind_to_port) PURE;
 
+  /**
+   * Creates a bound SO_REUSEPORT socket for one worker of a listener that has a socket per worker.
+   * @param address supplies the socket's address.
+   * @param worker_index supplies the index of the worker that accepts on the socket.
+   * @return Network::ListenSocketSharedPtr an initialized and bound socket.
+   */
+  virtual Network::ListenSocketSharedPtr
+  createReusePortListenSocket(Network::Address::InstanceConstSharedPtr address,
+                              uint32_t worker_index) PURE;
+
   /**
    * Creates a list of filter factories.
    * @param filters supplies the proto configuration.
@@ -70,6 +81,13 @@ public:
    */
   virtual Network::ListenSocket& socket() PURE;
 
+  /**
+   * @param worker_index supplies the index of a worker.
+   * @return Network::ListenSocket& the listen socket that the worker accepts on. This is socket()
+   *         unless the listener has a SO_REUSEPORT socket per worker.
+   */
+  virtual Network::ListenSocket& workerSocket(uint32_t worker_index) PURE;
+
   /**
    * @return Ssl::ServerContext* the SSL context
    */
@@ -100,6 +118,18 @@ public:
    */
   virtual uint32_t perConnectionBufferLimitBytes() PURE;
 
+  /**
+   * @return uint32_t the maximum number of connections accepted each time the listen socket is
+   *         readable. 0 means no limit.
+   */
+  virtual uint32_t maxAcceptsPerEvent() PURE;
+
+  /**
+   * @return Network::ConnectionLimitSharedPtr the limit on the active connections of the listener
+   *         that is shared by the workers, or nullptr if the listener has no limit.
+   */
+  virtual Network::ConnectionLimitSharedPtr connectionLimit() PURE;
+
   /**
    * @return Stats::Scope& the stats scope to use for all listener specific stats.
    */
@@ -3,9 +3,13 @@
 #include <chrono>
 #include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "envoy/common/pure.h"
 #include "envoy/network/address.h"
+#include "envoy/network/dns.h"
+#include "envoy/server/overload_manager.h"
 
 #include "spdlog/spdlog.h"
 
@@ -59,6 +63,85 @@ public:
    */
   virtual std::chrono::seconds drainTime() PURE;
 
+  /**
+   * @return uint32_t the maximum number of connections per second that each worker is told to
+   *         close while draining. 0 means no limit.
+   */
+  virtual uint32_t drainCloseRate() PURE;
+
+  /**
+   * @return uint32_t the maximum number of stats that can be kept in the shared memory region
+   *         used during hot restart. Stats beyond this are allocated on the heap and are not
+   *         preserved across a hot restart.
+   */
+  virtual uint32_t maxStats() PURE;
+
+  /**
+   * @return uint64_t the maximum number of bytes that a connection reads from its socket per read
+   *         event before it yields to the other events of its dispatcher. 0 means no limit.
+   */
+  virtual uint64_t connectionReadBudget() PURE;
+
+  /**
+   * @return const std::string& the libevent backend of the dispatchers, or empty for the default
+   *         backend of the platform.
+   */
+  virtual const std::string& eventBackend() PURE;
+
+  /**
+   * @return uint32_t the maximum number of connections that a listener accepts each time its
+   *         socket is readable. 0 means no limit.
+   */
+  virtual uint32_t maxAcceptsPerEvent() PURE;
+
+  /**
+   * @return bool whether each worker accepts connections on its own SO_REUSEPORT listen socket
+   *         instead of all workers sharing one socket per listener.
+   */
+  virtual bool reusePort() PURE;
+
+  /**
+   * @return bool whether workers hand new connections to the worker with the fewest connections
+   *         instead of keeping the connections that they accept.
+   */
+  virtual bool balanceConnections() PURE;
+
+  /**
+   * @return uint32_t the number of threads that run the private key operations of TLS handshakes
+   *         for listeners, or 0 to run them on the workers.
+   */
+  virtual uint32_t privateKeyThreads() PURE;
+
+  /**
+   * @return const std::vector<uint32_t>& the CPUs that the workers are pinned to, one per worker
+   *         in worker order and reused round robin, or empty if the workers are not pinned.
+   */
+  virtual const std::vector<uint32_t>& workerCpus() PURE;
+
+  /**
+   * @return const Network::DnsCacheConfig& how the DNS resolver shared by the clusters caches its
+   *         answers.
+   */
+  virtual const Network::DnsCacheConfig& dnsCacheConfig() PURE;
+
+  /**
+   * @return const OverloadConfig& the resource limits of the overload manager.
+   */
+  virtual const OverloadConfig& overloadConfig() PURE;
+
+  /**
+   * @return const std::vector<std::pair<std::string, std::string>>& the name and regular
+   *         expression of each tag that is extracted from stat names in addition to the default
+   *         tags.
+   */
+  virtual const std::vector<std::pair<std::string, std::string>>& statsTags() PURE;
+
+  /**
+   * @return bool whether the watchdog samples the stack of a thread that misses its deadline, so
+   *         that recurring stall sites can be found.
+   */
+  virtual bool watchdogSampleStacks() PURE;
+
   /**
    * @return const std::string& the path to the configuration file.
    */
@@ -69,6 +152,12 @@ public:
    */
   virtual const std::string& adminAddressPath() PURE;
 
+  /**
+   * @return const std::string& the directory that the last accepted xDS resources are cached in,
+   *         so that a restarted server can start from them, or empty if they are not cached.
+   */
+  virtual const std::string& xdsCacheDirectory() PURE;
+
   /**
    * @return Network::Address::IpVersion the local address IP version.
    */
@@ -79,6 +168,12 @@ public:
    */
   virtual spdlog::level::level_enum logLevel() PURE;
 
+  /**
+   * @return uint32_t the number of log messages that each logging thread buffers for a background
+   *         thread to write. 0 means that messages are written synchronously.
+   */
+  virtual uint32_t logAsyncBufferSize() PURE;
+
   /**
    * @return the number of seconds that envoy will wait before shutting down the parent envoy during
    *         a host restart. Generally this will be longer than the drainTime() option.
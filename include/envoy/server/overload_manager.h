@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+#include "envoy/common/pure.h"
+#include "envoy/event/dispatcher.h"
+
+namespace Envoy {
+namespace Server {
+
+/**
+ * The actions that the overload manager takes as the process gets closer to its resource limits.
+ * They are listed from the first one to be taken to the last one.
+ */
+enum class OverloadAction {
+  // New downstream connections get smaller buffer limits.
+  ShrinkBufferLimits,
+  // HTTP connections are closed after their current request.
+  DisableHttpKeepAlive,
+  // The workers stop accepting new connections, which wait in the accept queue of the kernel.
+  StopAcceptingConnections,
+  // New HTTP streams get a 503 response.
+  RejectNewStreams,
+};
+
+/**
+ * The limits that the overload manager measures the process against, and the pressure at which it
+ * takes each action. The pressure is the highest ratio of the use of a resource to its limit. An
+ * action stops once the pressure falls a tenth of a limit below its threshold, so that it does not
+ * flap around the threshold.
+ */
+struct OverloadConfig {
+  // The heap size of the process. 0 disables the limit.
+  uint64_t max_heap_bytes_{0};
+  // The downstream connections of all workers. 0 disables the limit.
+  uint64_t max_connections_{0};
+  // The active downstream HTTP streams of all connection managers. 0 disables the limit.
+  uint64_t max_active_streams_{0};
+  // How often the use of the resources is measured.
+  std::chrono::milliseconds refresh_interval_{1000};
+  // The buffer limit of new connections while ShrinkBufferLimits is active.
+  uint32_t shrunk_buffer_limit_bytes_{16 * 1024};
+  double shrink_buffer_limits_threshold_{0.80};
+  double disable_http_keepalive_threshold_{0.90};
+  double stop_accepting_connections_threshold_{0.95};
+  double reject_new_streams_threshold_{1.0};
+};
+
+/**
+ * Measures the use of the resources of the process and takes graduated actions as it gets close
+ * to their limits.
+ */
+class OverloadManager {
+public:
+  virtual ~OverloadManager() {}
+
+  /**
+   * Called when an action starts or stops.
+   * @param active supplies whether the action is now active.
+   */
+  typedef std::function<void(bool active)> ActionCb;
+
+  /**
+   * Start measuring the use of the resources. Called on the main thread.
+   */
+  virtual void start() PURE;
+
+  /**
+   * Register a callback for the changes of the state of an action. Called on the main thread
+   * before start(). The callback is posted to the dispatcher, so that it runs on the thread that
+   * owns the state it changes.
+   * @param action supplies the action.
+   * @param dispatcher supplies the dispatcher to run the callback on.
+   * @param callback supplies the callback.
+   */
+  virtual void registerForAction(OverloadAction action, Event::Dispatcher& dispatcher,
+                                 ActionCb callback) PURE;
+
+  /**
+   * @return bool whether an action is active. May be called from any thread.
+   */
+  virtual bool isActive(OverloadAction action) const PURE;
+};
+
+} // namespace Server
+} // namespace Envoy
@@ -54,6 +54,16 @@ public:
    */
   virtual void removeListener(Listener& listener, std::function<void()> completion) PURE;
 
+  /**
+   * Stop a listener from accepting new connections, and remove it once all of its connections have
+   * closed. This is used to update a listener without draining its connections.
+   * @param listener supplies the listener to retire.
+   * @param completion supplies the completion to be called when the listener has been removed,
+   *        either because its last connection closed or by removeListener(). This completion is
+   *        called on the worker thread. No locking is performed by the worker.
+   */
+  virtual void retireListener(Listener& listener, std::function<void()> completion) PURE;
+
   /**
    * Stop a listener from accepting new connections. This is used for server draining.
    * @param listener supplies the listener to stop.
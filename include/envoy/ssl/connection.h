@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <string>
 
 #include "envoy/common/pure.h"
@@ -7,6 +9,11 @@
 namespace Envoy {
 namespace Ssl {
 
+/**
+ * A raw SHA256 digest.
+ */
+typedef std::array<uint8_t, 32> Sha256Digest;
+
 /**
  * Base connection interface for all SSL connections.
  */
@@ -31,6 +38,13 @@ public:
    */
   virtual std::string sha256PeerCertificateDigest() PURE;
 
+  /**
+   * Get the SHA256 digest of the peer certificate without hex encoding it.
+   * @param digest supplies the digest to fill in.
+   * @return bool whether there is a peer certificate. If not, digest is left unchanged.
+   */
+  virtual bool rawSha256PeerCertificateDigest(Sha256Digest& digest) PURE;
+
   /**
    * @return the subject field of the peer certificate in RFC 2253 format. Returns "" if there is
    *         no peer certificate, or no subject.
@@ -36,7 +36,15 @@ public:
 class ClientContext : public virtual Context {};
 typedef std::unique_ptr<ClientContext> ClientContextPtr;
 
-class ServerContext : public virtual Context {};
+class ServerContext : public virtual Context {
+public:
+  /**
+   * Reload the session ticket keys from their files, so that the keys can be rotated without
+   * creating a new context. Throws EnvoyException if a key file cannot be loaded, in which case the
+   * previous keys are kept.
+   */
+  virtual void reloadSessionTicketKeys() PURE;
+};
 typedef std::unique_ptr<ServerContext> ServerContextPtr;
 
 } // namespace Ssl
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -71,6 +73,37 @@ public:
    * Otherwise, ""
    */
   virtual const std::string& serverNameIndication() const PURE;
+
+  /**
+   * @return uint32_t the maximum number of sessions, one per server address, that each thread
+   *         caches for resumption when it connects with the context. 0 disables resumption.
+   */
+  virtual uint32_t maxSessionCacheSize() const PURE;
+};
+
+/**
+ * The files of a certificate chain and of its private key.
+ */
+struct CertificateFiles {
+  std::string cert_chain_file_;
+  std::string private_key_file_;
+};
+
+/**
+ * The sizing of the TLS records written to the connections of a server context. Full records of
+ * up to 16KB can only be decrypted once all of their TCP segments have arrived, so on a lossy or
+ * slow link the first bytes of a response are held up by the rest of the record. Small records
+ * avoid that while a connection starts, and full records keep the framing overhead low once it
+ * is busy.
+ */
+struct DynamicRecordSizing {
+  // The size of the records written while a connection starts and after it was idle. 0 always
+  // writes full records.
+  uint64_t initial_record_size_{0};
+  // The bytes written in small records before the records grow to full size.
+  uint64_t ramp_bytes_{1024 * 1024};
+  // The time without writes after which the records are small again.
+  std::chrono::milliseconds idle_timeout_{1000};
 };
 
 class ServerContextConfig : public virtual ContextConfig {
@@ -79,6 +112,33 @@ public:
    * @return True if client certificate is required, false otherwise.
    */
   virtual bool requireClientCertificate() const PURE;
+
+  /**
+   * @return the files of the keys used to encrypt and decrypt session tickets. The first key
+   * encrypts new tickets and all of them decrypt tickets. If empty, the keys are generated by the
+   * TLS library and tickets can only be resumed by the context that issued them.
+   */
+  virtual const std::vector<std::string>& sessionTicketKeyPaths() const PURE;
+
+  /**
+   * @return the certificates that are served instead of certChainFile() to clients that ask for
+   * one of their names with SNI. A certificate has the DNS names of its subjectAltName, or its
+   * common name if it has none. A name like *.example.com matches a single label in front of
+   * example.com. The first certificate with a matching name is served.
+   */
+  virtual const std::vector<CertificateFiles>& sniCertificates() const PURE;
+
+  /**
+   * @return the sizing of the TLS records written to the connections.
+   */
+  virtual const DynamicRecordSizing& dynamicRecordSizing() const PURE;
+
+  /**
+   * @return whether established connections hand their record encryption over to the kernel
+   * (kTLS) when the negotiated cipher and the kernel support it. Otherwise the connections keep
+   * encrypting in user space.
+   */
+  virtual bool kernelTls() const PURE;
 };
 
 } // namespace Ssl
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "envoy/common/pure.h"
+#include "envoy/event/dispatcher.h"
+
+#include "openssl/ssl.h"
+
+namespace Envoy {
+namespace Ssl {
+
+/**
+ * Callbacks of a private key operation.
+ */
+class PrivateKeyOperationCallbacks {
+public:
+  virtual ~PrivateKeyOperationCallbacks() {}
+
+  /**
+   * Called on the dispatcher of the operation when its result is ready. The handshake should be
+   * resumed, which will call PrivateKeyOperation::complete().
+   */
+  virtual void onPrivateKeyOperationComplete() PURE;
+};
+
+/**
+ * A private key operation that runs away from the thread of the connection.
+ */
+class PrivateKeyOperation {
+public:
+  virtual ~PrivateKeyOperation() {}
+
+  /**
+   * Cancel the operation. No callbacks will be called after this. Destroying the operation also
+   * cancels it.
+   */
+  virtual void cancel() PURE;
+
+  /**
+   * Copy the result of the operation into the handshake.
+   * @param out supplies the buffer to copy the result into.
+   * @param out_len returns the length of the result.
+   * @param max_out supplies the size of out.
+   * @return ssl_private_key_retry until the result is ready, and then whether the operation
+   *         succeeded. @see SSL_PRIVATE_KEY_METHOD.
+   */
+  virtual ssl_private_key_result_t complete(uint8_t* out, size_t* out_len, size_t max_out) PURE;
+};
+
+typedef std::unique_ptr<PrivateKeyOperation> PrivateKeyOperationPtr;
+
+/**
+ * Runs the private key operations of TLS handshakes, so that the connection threads do not block
+ * on them. The inputs are copied and need not outlive the calls.
+ */
+class PrivateKeyOperationProvider {
+public:
+  virtual ~PrivateKeyOperationProvider() {}
+
+  /**
+   * Start signing the handshake with a private key.
+   * @param key supplies the private key.
+   * @param signature_algorithm supplies the TLS signature algorithm to use.
+   * @param in supplies the data to sign.
+   * @param in_len supplies the length of in.
+   * @param dispatcher supplies the dispatcher the callbacks are called on.
+   * @param callbacks supplies the callbacks of the operation.
+   * @return the operation, or nullptr if it could not be started.
+   */
+  virtual PrivateKeyOperationPtr sign(EVP_PKEY& key, uint16_t signature_algorithm,
+                                      const uint8_t* in, size_t in_len,
+                                      Event::Dispatcher& dispatcher,
+                                      PrivateKeyOperationCallbacks& callbacks) PURE;
+
+  /**
+   * Start decrypting the premaster secret of an RSA key exchange. The same parameters as sign().
+   */
+  virtual PrivateKeyOperationPtr decrypt(EVP_PKEY& key, const uint8_t* in, size_t in_len,
+                                         Event::Dispatcher& dispatcher,
+                                         PrivateKeyOperationCallbacks& callbacks) PURE;
+};
+
+typedef std::shared_ptr<PrivateKeyOperationProvider> PrivateKeyOperationProviderSharedPtr;
+
+} // namespace Ssl
+} // namespace Envoy
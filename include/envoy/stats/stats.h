@@ -2,9 +2,11 @@
 
 #include <chrono>
 #include <cstdint>
+#include <functional>
 #include <list>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "envoy/common/pure.h"
 
@@ -19,6 +21,38 @@ class Instance;
 
 namespace Stats {
 
+/**
+ * A dimension of a stat, such as the cluster that a cluster stat belongs to.
+ */
+struct Tag {
+  std::string name_;
+  std::string value_;
+};
+
+/**
+ * Extracts a tag from stat names. Stats are tagged once, when they are created.
+ */
+class TagExtractor {
+public:
+  virtual ~TagExtractor() {}
+
+  /**
+   * @return const std::string& the name of the tags that are extracted.
+   */
+  virtual const std::string& name() const PURE;
+
+  /**
+   * Extract the tag from a stat name, if it has one, and remove it from the name.
+   * @param tag_extracted_name supplies the stat name with the tags of the previous extractors
+   *        removed. The tag of this extractor is also removed from it on a match.
+   * @param tags receives the tag on a match.
+   * @return bool whether the name has the tag.
+   */
+  virtual bool extractTag(std::string& tag_extracted_name, std::vector<Tag>& tags) const PURE;
+};
+
+typedef std::unique_ptr<const TagExtractor> TagExtractorPtr;
+
 /**
  * An always incrementing counter with latching capability. Each increment is added both to a
  * global counter as well as periodic counter. Calling latch() returns the periodic counter and
@@ -30,10 +64,22 @@ public:
   virtual void add(uint64_t amount) PURE;
   virtual void inc() PURE;
   virtual uint64_t latch() PURE;
-  virtual std::string name() PURE;
+  virtual std::string name() const PURE;
   virtual void reset() PURE;
   virtual bool used() PURE;
   virtual uint64_t value() PURE;
+
+  /**
+   * @return std::string the name with the tags removed, which is the same for every stat that only
+   *         differs in the value of its tags (e.g., cluster.upstream_rq for the counters of all
+   *         clusters).
+   */
+  virtual std::string tagExtractedName() const PURE;
+
+  /**
+   * @return const std::vector<Tag>& the tags extracted from the name.
+   */
+  virtual const std::vector<Tag>& tags() const PURE;
 };
 
 typedef std::shared_ptr<Counter> CounterSharedPtr;
@@ -48,11 +94,21 @@ public:
   virtual void add(uint64_t amount) PURE;
   virtual void dec() PURE;
   virtual void inc() PURE;
-  virtual std::string name() PURE;
+  virtual std::string name() const PURE;
   virtual void set(uint64_t value) PURE;
   virtual void sub(uint64_t amount) PURE;
   virtual bool used() PURE;
   virtual uint64_t value() PURE;
+
+  /**
+   * @return std::string the name with the tags removed. @see Counter::tagExtractedName().
+   */
+  virtual std::string tagExtractedName() const PURE;
+
+  /**
+   * @return const std::vector<Tag>& the tags extracted from the name.
+   */
+  virtual const std::vector<Tag>& tags() const PURE;
 };
 
 typedef std::shared_ptr<Gauge> GaugeSharedPtr;
@@ -93,6 +149,104 @@ public:
 
 typedef std::shared_ptr<Timer> TimerSharedPtr;
 
+/**
+ * Summary statistics computed from the values recorded into a histogram.
+ */
+class HistogramStatistics {
+public:
+  virtual ~HistogramStatistics() {}
+
+  /**
+   * @return std::string a human readable summary of the computed quantiles.
+   */
+  virtual std::string summary() const PURE;
+
+  /**
+   * @return const std::vector<double>& the quantiles (between 0 and 1) that are computed.
+   */
+  virtual const std::vector<double>& supportedQuantiles() const PURE;
+
+  /**
+   * @return const std::vector<double>& the computed value of each of supportedQuantiles(), in the
+   *         same order. Values are NaN if there are no samples.
+   */
+  virtual const std::vector<double>& computedQuantiles() const PURE;
+
+  /**
+   * @return const std::vector<double>& the upper bounds of the buckets that are reported, in
+   *         increasing order.
+   */
+  virtual const std::vector<double>& supportedBuckets() const PURE;
+
+  /**
+   * @return const std::vector<uint64_t>& the number of recorded values that are at most each of
+   *         supportedBuckets(), in the same order.
+   */
+  virtual const std::vector<uint64_t>& computedBuckets() const PURE;
+
+  /**
+   * @return uint64_t the number of recorded values.
+   */
+  virtual uint64_t sampleCount() const PURE;
+
+  /**
+   * @return uint64_t the sum of all recorded values.
+   */
+  virtual uint64_t sampleSum() const PURE;
+};
+
+/**
+ * A histogram that records values so that quantiles can be computed in process.
+ */
+class Histogram {
+public:
+  virtual ~Histogram() {}
+
+  /**
+   * Record a value into the histogram.
+   */
+  virtual void recordValue(uint64_t value) PURE;
+
+  virtual std::string name() const PURE;
+};
+
+typedef std::shared_ptr<Histogram> HistogramSharedPtr;
+
+/**
+ * A histogram that aggregates the values recorded on all threads. Its statistics are updated each
+ * time the store merges histograms.
+ */
+class ParentHistogram : public Histogram {
+public:
+  /**
+   * @return const HistogramStatistics& the statistics of the values recorded between the last two
+   *         merges.
+   */
+  virtual const HistogramStatistics& intervalStatistics() const PURE;
+
+  /**
+   * @return const HistogramStatistics& the statistics of all values recorded up to the last merge.
+   */
+  virtual const HistogramStatistics& cumulativeStatistics() const PURE;
+
+  /**
+   * @return bool whether any value has been recorded and merged.
+   */
+  virtual bool used() const PURE;
+
+  /**
+   * @return std::string the name with the tags removed. @see Counter::tagExtractedName().
+   */
+  virtual std::string tagExtractedName() const PURE;
+
+  /**
+   * @return const std::vector<Tag>& the tags extracted from the name.
+   */
+  virtual const std::vector<Tag>& tags() const PURE;
+};
+
+typedef std::shared_ptr<ParentHistogram> ParentHistogramSharedPtr;
+
 /**
  * A sink for stats. Each sink is responsible for writing stats to a backing store.
  */
@@ -101,24 +255,38 @@ public:
   virtual ~Sink() {}
 
   /**
-   * This will be called before a sequence of flushCounter() and flushGauge() calls. Sinks can
+   * This will be called before a sequence of flushCounter(), flushGauge(), and flushHistogram()
+   * calls. Sinks can
    * choose to optimize writing if desired with a paired endFlush() call.
    */
   virtual void beginFlush() PURE;
 
   /**
-   * Flush a counter delta.
+   * @return bool whether the flush that beginFlush() started should include every gauge rather
+   *         than only the gauges that changed since the previous flush. Sinks that start over,
+   *         e.g. on a new connection to a collector, use this so that steady gauges are not lost.
+   */
+  virtual bool wantsAllGauges() const PURE;
+
+  /**
+   * Flush a counter delta. Sinks that support dimensions can use the tags of the counter.
+   */
+  virtual void flushCounter(const Counter& counter, uint64_t delta) PURE;
+
+  /**
+   * Flush a gauge value. Sinks that support dimensions can use the tags of the gauge.
    */
-  virtual void flushCounter(const std::string& name, uint64_t delta) PURE;
+  virtual void flushGauge(const Gauge& gauge, uint64_t value) PURE;
 
   /**
-   * Flush a gauge value.
+   * Flush the statistics of a merged histogram.
    */
-  virtual void flushGauge(const std::string& name, uint64_t value) PURE;
+  virtual void flushHistogram(const ParentHistogram& histogram) PURE;
 
   /**
-   * This will be called after beginFlush(), some number of flushCounter(), and some number of
-   * flushGauge(). Sinks can use this to optimize writing if desired.
+   * This will be called after beginFlush(), some number of flushCounter(), some number of
+   * flushGauge(), and some number of flushHistogram(). Sinks can use this to optimize writing if
+   * desired.
    */
   virtual void endFlush() PURE;
 
@@ -178,6 +346,11 @@ public:
    * @return a timer within the scope's namespace.
    */
   virtual Timer& timer(const std::string& name) PURE;
+
+  /**
+   * @return a histogram within the scope's namespace.
+   */
+  virtual Histogram& histogram(const std::string& name) PURE;
 };
 
 /**
@@ -194,6 +367,23 @@ public:
    * @return a list of all known gauges.
    */
   virtual std::list<GaugeSharedPtr> gauges() const PURE;
+
+  /**
+   * @return a list of all known histograms.
+   */
+  virtual std::list<ParentHistogramSharedPtr> histograms() const PURE;
+
+  /**
+   * @return the counters that changed since the previous call. Unlike counters(), unchanged
+   *         counters are never visited. A counter that is shared by overlapping scopes may be
+   *         returned more than once, in which case only the first latch() sees its increment.
+   */
+  virtual std::vector<CounterSharedPtr> latchChangedCounters() PURE;
+
+  /**
+   * @return the gauges that changed since the previous call. See latchChangedCounters().
+   */
+  virtual std::vector<GaugeSharedPtr> latchChangedGauges() PURE;
 };
 
 /**
@@ -218,6 +408,21 @@ public:
    * down.
    */
   virtual void shutdownThreading() PURE;
+
+  /**
+   * Called on the main thread to merge the values recorded into histograms on all threads. Workers
+   * record histogram values without synchronization, so the merge is asynchronous.
+   * @param merge_complete_cb supplies the callback that is invoked on the main thread once the
+   *        statistics of all histograms have been updated.
+   */
+  virtual void mergeHistograms(std::function<void()> merge_complete_cb) PURE;
+
+  /**
+   * Set the extractors that tag the stats created from now on. They are applied in order, each to
+   * the name left by the previous ones. This should be called before any stats are created, since
+   * existing stats are not tagged again.
+   */
+  virtual void setTagExtractors(std::vector<TagExtractorPtr>&& tag_extractors) PURE;
 };
 
 typedef std::unique_ptr<StoreRoot> StoreRootPtr;
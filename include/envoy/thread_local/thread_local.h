@@ -34,11 +34,18 @@ public:
   virtual ThreadLocalObjectSharedPtr get() PURE;
 
   /**
-   * This is a helper on top of get() that casts the object stored in the slot to the specified
+   * @return ThreadLocalObject& the thread local object stored in the slot. Unlike get(), this does
+   *         not take a reference on the object, so it is only valid until the calling thread
+   *         returns to its event loop.
+   */
+  virtual ThreadLocalObject& getRef() PURE;
+
+  /**
+   * This is a helper on top of getRef() that casts the object stored in the slot to the specified
    * type. Since the slot only stores pointers to the base interface, dynamic_cast provides some
    * level of protection via RTTI.
    */
-  template <class T> T& getTyped() { return *std::dynamic_pointer_cast<T>(get()); }
+  template <class T> T& getTyped() { return dynamic_cast<T&>(getRef()); }
 
   /**
    * Run a callback on all registered threads.
@@ -46,6 +53,14 @@ public:
    */
   virtual void runOnAllThreads(Event::PostCb cb) PURE;
 
+  /**
+   * Run a callback on all registered threads, and then run a completion callback on the main
+   * thread once the callback has run on every thread.
+   * @param cb supplies the callback to run on each thread.
+   * @param all_threads_complete_cb supplies the callback to run on the main thread afterwards.
+   */
+  virtual void runOnAllThreads(Event::PostCb cb, Event::PostCb all_threads_complete_cb) PURE;
+
   /**
    * Set thread local data on all threads previously registered via registerThread().
    * @param initializeCb supplies the functor that will be called *on each thread*. The functor
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <limits>
 #include <functional>
 #include <memory>
 #include <string>
@@ -22,6 +25,34 @@
 namespace Envoy {
 namespace Upstream {
 
+/**
+ * Refers to a cluster by name for callers that look the same cluster up for many requests, such as
+ * a route. The cluster manager resolves the name the first time that the handle is used, and from
+ * then on finds the cluster of each worker without looking the name up. A handle may be shared by
+ * all of the workers, and stays valid as its cluster is added, updated and removed.
+ */
+class ClusterHandle {
+public:
+  static const uint32_t UNRESOLVED = std::numeric_limits<uint32_t>::max();
+
+  explicit ClusterHandle(const std::string& name) : name_(name) {}
+
+  /**
+   * @return const std::string& the name of the cluster.
+   */
+  const std::string& name() const { return name_; }
+
+  /**
+   * @return std::atomic<uint32_t>& what the cluster manager resolved the name to, or UNRESOLVED.
+   *         Only the cluster manager uses this.
+   */
+  std::atomic<uint32_t>& id() const { return id_; }
+
+private:
+  const std::string name_;
+  mutable std::atomic<uint32_t> id_{UNRESOLVED};
+};
+
 /**
  * Manages connection pools and load balancing for upstream clusters. The cluster manager is
  * persistent and shared among multiple ongoing requests/connections.
@@ -65,6 +96,12 @@ public:
    */
   virtual ThreadLocalCluster* get(const std::string& cluster) PURE;
 
+  /**
+   * Like get(), without looking the name of the cluster up once the handle is resolved.
+   * @param cluster supplies the handle of the cluster.
+   */
+  virtual ThreadLocalCluster* getByHandle(const ClusterHandle& cluster) PURE;
+
   /**
    * Allocate a load balanced HTTP connection pool for a cluster. This is *per-thread* so that
    * callers do not need to worry about per thread synchronization. The load balancing policy that
@@ -77,6 +114,14 @@ public:
                                                                  ResourcePriority priority,
                                                                  LoadBalancerContext* context) PURE;
 
+  /**
+   * Like httpConnPoolForCluster(), without looking the name of the cluster up once the handle is
+   * resolved.
+   */
+  virtual Http::ConnectionPool::Instance* httpConnPoolForHandle(const ClusterHandle& cluster,
+                                                                ResourcePriority priority,
+                                                                LoadBalancerContext* context) PURE;
+
   /**
    * Allocate a load balanced TCP connection for a cluster. The created connection is already
    * bound to the correct *per-thread* dispatcher, so no further synchronization is needed. The
@@ -126,6 +171,13 @@ public:
    * @return GrpcMux& ADS API provider referencee.
    */
   virtual Config::GrpcMux& adsMux() PURE;
+
+  /**
+   * Like adsMux(), this is here for the xDS API sites that have a ClusterManager at hand.
+   * @return const std::string& the directory that xDS subscriptions cache their last accepted
+   *         resources in, or empty if they are not cached.
+   */
+  virtual const std::string& xdsCacheDirectory() PURE;
 };
 
 typedef std::unique_ptr<ClusterManager> ClusterManagerPtr;
@@ -199,6 +251,12 @@ public:
   virtual CdsApiPtr createCds(const envoy::api::v2::ConfigSource& cds_config,
                               const Optional<envoy::api::v2::ConfigSource>& eds_config,
                               ClusterManager& cm) PURE;
+
+  /**
+   * @return const std::string& the xDS cache directory of the cluster managers that are
+   *         allocated, @see ClusterManager::xdsCacheDirectory().
+   */
+  virtual const std::string& xdsCacheDirectory() PURE;
 };
 
 } // namespace Upstream
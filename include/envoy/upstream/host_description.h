@@ -87,6 +87,32 @@ public:
    * @return the "zone" of the host (deployment specific). Empty is unknown.
    */
   virtual const std::string& zone() const PURE;
+
+  /**
+   * @return the priority level of the host. Level 0 is the highest priority, the hosts of a lower
+   *         priority level only receive the load that the higher levels cannot take.
+   */
+  virtual uint32_t priority() const PURE;
+
+  /**
+   * @return the load balancing weight of the locality (zone) of the host within its priority
+   *         level. 0 if the host does not set one.
+   */
+  virtual uint32_t localityWeight() const PURE;
+
+  /**
+   * Record a utilization report from the host, e.g. from the x-envoy-upstream-load response
+   * header. The reports are smoothed with an exponentially weighted moving average. This may be
+   * called from any thread.
+   * @param load supplies the reported utilization in percent. Values above 100 are taken as 100.
+   */
+  virtual void reportLoad(uint32_t load) const PURE;
+
+  /**
+   * @return the smoothed reported utilization of the host in percent, in the range 0-100. 0 if the
+   *         host never reported its load.
+   */
+  virtual uint32_t reportedLoad() const PURE;
 };
 
 typedef std::shared_ptr<const HostDescription> HostDescriptionConstSharedPtr;
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <string>
 
 #include "envoy/common/pure.h"
 #include "envoy/upstream/upstream.h"
@@ -9,6 +10,23 @@
 namespace Envoy {
 namespace Upstream {
 
+/**
+ * Endpoint metadata that a request requires of the host that serves it. Load balancers that split
+ * a cluster into subsets of hosts by their metadata (see ClusterInfo::lbSubsetKeys()) choose the
+ * host from the subset of the hosts that match.
+ */
+class MetadataMatchCriteria {
+public:
+  virtual ~MetadataMatchCriteria() {}
+
+  /**
+   * @return const std::string& the required values of the envoy.lb endpoint metadata as built by
+   *         Config::Metadata::subsetKey() for all of the keys that the criteria match, which
+   *         identifies the subset of the hosts with these values.
+   */
+  virtual const std::string& subsetKey() const PURE;
+};
+
 /**
  * Context information passed to a load balancer to use when choosing a host. Not all load
  * balancers make use of all context information.
@@ -27,6 +45,12 @@ public:
    * balancing.
    */
   virtual const Network::Connection* downstreamConnection() const PURE;
+
+  /**
+   * @return const MetadataMatchCriteria* the endpoint metadata that the chosen host must match, or
+   *         nullptr to choose from all of the hosts.
+   */
+  virtual const MetadataMatchCriteria* metadataMatchCriteria() const PURE;
 };
 
 /**
@@ -61,6 +61,13 @@ public:
    *         or the cluster did not have enough hosts to run through success rate outlier ejection.
    */
   virtual double successRate() const PURE;
+
+  /**
+   * @return the response time percentile of the host in the last calculated interval, in
+   *         milliseconds. -1 means that the host did not have enough request volume to calculate
+   *         it or the cluster did not have enough hosts to run through latency outlier ejection.
+   */
+  virtual double latency() const PURE;
 };
 
 typedef std::unique_ptr<DetectorHostMonitor> DetectorHostMonitorPtr;
@@ -99,11 +106,27 @@ public:
    *         proceed with success rate based outlier ejection.
    */
   virtual double successRateEjectionThreshold() const PURE;
+
+  /**
+   * Returns the average response time percentile of the hosts in the Detector for the last
+   * aggregation interval.
+   * @return the average latency in milliseconds, or -1 if there were not enough hosts with enough
+   *         request volume to proceed with latency based outlier ejection.
+   */
+  virtual double latencyAverage() const PURE;
+
+  /**
+   * Returns the latency threshold used in the last interval. The threshold is used to eject hosts
+   * based on their response time percentile.
+   * @return the threshold in milliseconds, or -1 if there were not enough hosts with enough
+   *         request volume to proceed with latency based outlier ejection.
+   */
+  virtual double latencyEjectionThreshold() const PURE;
 };
 
 typedef std::shared_ptr<Detector> DetectorSharedPtr;
 
-enum class EjectionType { Consecutive5xx, SuccessRate };
+enum class EjectionType { Consecutive5xx, SuccessRate, Latency };
 
 /**
  * Sink for outlier detection event logs.
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 
@@ -73,6 +74,20 @@ public:
    * @return Resource& active retries.
    */
   virtual Resource& retries() PURE;
+
+  /**
+   * @return Resource& active retries as limited by the retry budget, a share of the active and
+   *         pending requests. It counts the same retries as retries(), so it is only checked with
+   *         canCreate() and its count follows retries().
+   */
+  virtual Resource& retryBudget() PURE;
+
+  /**
+   * Report the latency of a completed request to the cluster, which an adaptive limit of
+   * requests() follows.
+   * @param latency supplies the time from the end of the request to the end of the response.
+   */
+  virtual void putRequestLatency(std::chrono::microseconds latency) PURE;
 };
 
 } // namespace Upstream
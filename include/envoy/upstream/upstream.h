@@ -11,6 +11,7 @@
 #include "envoy/common/callback.h"
 #include "envoy/common/optional.h"
 #include "envoy/http/codec.h"
+#include "envoy/http/codes.h"
 #include "envoy/network/connection.h"
 #include "envoy/ssl/context.h"
 #include "envoy/upstream/health_check_host_monitor.h"
@@ -35,7 +36,9 @@ public:
     // The host is currently failing active health checks.
     FAILED_ACTIVE_HC = 0x1,
     // The host is currently considered an outlier and has been ejected.
-    FAILED_OUTLIER_CHECK = 0x02
+    FAILED_OUTLIER_CHECK = 0x02,
+    // The host is currently marked as unhealthy by EDS.
+    FAILED_EDS_HEALTH = 0x04
   };
 
   /**
@@ -118,6 +121,11 @@ public:
 
 typedef std::shared_ptr<const Host> HostConstSharedPtr;
 
+typedef std::shared_ptr<std::vector<HostSharedPtr>> HostVectorSharedPtr;
+typedef std::shared_ptr<const std::vector<HostSharedPtr>> HostVectorConstSharedPtr;
+typedef std::shared_ptr<std::vector<std::vector<HostSharedPtr>>> HostListsSharedPtr;
+typedef std::shared_ptr<const std::vector<std::vector<HostSharedPtr>>> HostListsConstSharedPtr;
+
 /**
  * Base host set interface. This is used both for clusters, as well as per thread/worker host sets
  * used during routing/forwarding.
@@ -168,6 +176,29 @@ public:
    * @return same as hostsPerZone but only contains healthy hosts.
    */
   virtual const std::vector<std::vector<HostSharedPtr>>& healthyHostsPerZone() const PURE;
+
+  /**
+   * The pointer variants below return the same host lists as the accessors above. The lists are
+   * immutable once published, so they can be shared with other host sets (e.g. the per worker
+   * copies of a cluster) instead of being copied on every membership change.
+   * @return HostVectorConstSharedPtr all hosts that make up the set at the current time.
+   */
+  virtual HostVectorConstSharedPtr hostsPtr() const PURE;
+
+  /**
+   * @return HostVectorConstSharedPtr all healthy hosts contained in the set at the current time.
+   */
+  virtual HostVectorConstSharedPtr healthyHostsPtr() const PURE;
+
+  /**
+   * @return HostListsConstSharedPtr hosts per zone, @see hostsPerZone().
+   */
+  virtual HostListsConstSharedPtr hostsPerZonePtr() const PURE;
+
+  /**
+   * @return HostListsConstSharedPtr healthy hosts per zone, @see healthyHostsPerZone().
+   */
+  virtual HostListsConstSharedPtr healthyHostsPerZonePtr() const PURE;
 };
 
 /**
@@ -184,6 +215,9 @@ public:
   COUNTER(lb_zone_routing_all_directly)                                                            \
   COUNTER(lb_zone_routing_sampled)                                                                 \
   COUNTER(lb_zone_routing_cross_zone)                                                              \
+  COUNTER(lb_subsets_selected)                                                                     \
+  COUNTER(lb_subsets_fallback)                                                                     \
+  COUNTER(lb_host_saturated)                                                                       \
   COUNTER(upstream_cx_total)                                                                       \
   GAUGE  (upstream_cx_active)                                                                      \
   COUNTER(upstream_cx_http1_total)                                                                 \
@@ -191,6 +225,8 @@ public:
   COUNTER(upstream_cx_connect_fail)                                                                \
   COUNTER(upstream_cx_connect_timeout)                                                             \
   COUNTER(upstream_cx_overflow)                                                                    \
+  COUNTER(upstream_cx_prefetch)                                                                    \
+  COUNTER(upstream_cx_idle_timeout)                                                                \
   TIMER  (upstream_cx_connect_ms)                                                                  \
   TIMER  (upstream_cx_length_ms)                                                                   \
   COUNTER(upstream_cx_destroy)                                                                     \
@@ -208,20 +244,25 @@ public:
   COUNTER(upstream_cx_max_requests)                                                                \
   COUNTER(upstream_cx_none_healthy)                                                                \
   COUNTER(upstream_rq_total)                                                                       \
+  COUNTER(upstream_rq_reused)                                                                      \
   GAUGE  (upstream_rq_active)                                                                      \
   COUNTER(upstream_rq_pending_total)                                                               \
   COUNTER(upstream_rq_pending_overflow)                                                            \
+  COUNTER(upstream_rq_host_overflow)                                                               \
   COUNTER(upstream_rq_pending_failure_eject)                                                       \
   GAUGE  (upstream_rq_pending_active)                                                              \
   COUNTER(upstream_rq_cancelled)                                                                   \
   COUNTER(upstream_rq_maintenance_mode)                                                            \
   COUNTER(upstream_rq_timeout)                                                                     \
   COUNTER(upstream_rq_per_try_timeout)                                                             \
+  COUNTER(upstream_rq_hedge)                                                                       \
+  COUNTER(upstream_rq_hedge_win)                                                                   \
   COUNTER(upstream_rq_rx_reset)                                                                    \
   COUNTER(upstream_rq_tx_reset)                                                                    \
   COUNTER(upstream_rq_retry)                                                                       \
   COUNTER(upstream_rq_retry_success)                                                               \
   COUNTER(upstream_rq_retry_overflow)                                                              \
+  COUNTER(upstream_rq_retry_budget_exhausted)                                                      \
   COUNTER(upstream_flow_control_paused_reading_total)                                              \
   COUNTER(upstream_flow_control_resumed_reading_total)                                             \
   COUNTER(upstream_flow_control_backed_up_total)                                                   \
@@ -235,7 +276,8 @@ public:
   COUNTER(update_attempt)                                                                          \
   COUNTER(update_success)                                                                          \
   COUNTER(update_failure)                                                                          \
-  COUNTER(update_empty)
+  COUNTER(update_empty)                                                                            \
+  COUNTER(update_no_rebuild)
 
 // clang-format on
 
@@ -290,6 +332,13 @@ public:
    */
   virtual LoadBalancerType lbType() const PURE;
 
+  /**
+   * @return the sets of envoy.lb endpoint metadata keys, each sorted, by whose values the load
+   *         balancer of the cluster splits its hosts into subsets. Empty if the hosts are not
+   *         split.
+   */
+  virtual const std::vector<std::vector<std::string>>& lbSubsetKeys() const PURE;
+
   /**
    * @return Whether the cluster is currently in maintenance mode and should not be routed to.
    *         Different filters may handle this situation in different ways. The implementation
@@ -305,6 +354,55 @@ public:
    */
   virtual uint64_t maxRequestsPerConnection() const PURE;
 
+  /**
+   * @return uint32_t the number of idle connections that each HTTP/1 connection pool keeps open or
+   *         connecting beyond the connections that its requests use, so that bursts of requests do
+   *         not wait for a connection to be established. The implementation of this routine is
+   *         typically based on runtime and may not return the same answer on each call.
+   */
+  virtual uint32_t minIdleConnections() const PURE;
+
+  /**
+   * @return uint32_t the number of connections that each HTTP/1 connection pool keeps open or
+   *         connecting as a percentage of its active and pending requests. For example 150 keeps a
+   *         spare connection for every two requests. Values up to 100 do not prefetch connections.
+   *         The implementation of this routine is typically based on runtime and may not return the
+   *         same answer on each call.
+   */
+  virtual uint32_t connectionPrefetchPercent() const PURE;
+
+  /**
+   * @return std::chrono::milliseconds how long an HTTP/1 connection may stay idle in its connection
+   *         pool before the pool closes it, so that connections are not kept past the keepalive
+   *         timeout of the backend and then fail on first use. 0 indicates no timeout. The
+   *         implementation of this routine is typically based on runtime and may not return the
+   *         same answer on each call.
+   */
+  virtual std::chrono::milliseconds idleConnectionTimeout() const PURE;
+
+  /**
+   * @return bool whether an HTTP/1 connection pool hands out the connection that has been idle the
+   *         longest (FIFO) rather than the most recently used one (LIFO). LIFO keeps the set of
+   *         connections in use small and lets the others idle out, while FIFO spreads the requests
+   *         over all of the connections and keeps them warm. The implementation of this routine is
+   *         typically based on runtime and may not return the same answer on each call.
+   */
+  virtual bool connectionReuseFifo() const PURE;
+
+  /**
+   * @return uint64_t the number of active connections to a host of the cluster at which load
+   *         balancers skip the host. 0 indicates no maximum. The implementation of this routine is
+   *         typically based on runtime and may not return the same answer on each call.
+   */
+  virtual uint64_t maxHostConnections() const PURE;
+
+  /**
+   * @return uint64_t the number of active requests to a host of the cluster at which load balancers
+   *         skip the host. 0 indicates no maximum. The implementation of this routine is typically
+   *         based on runtime and may not return the same answer on each call.
+   */
+  virtual uint64_t maxHostRequests() const PURE;
+
   /**
    * @return the human readable name of the cluster.
    */
@@ -332,12 +430,22 @@ public:
    */
   virtual Stats::Scope& statsScope() const PURE;
 
+  /**
+   * @return Http::UpstreamCodeStats& the response code counters in the stats scope of the cluster.
+   */
+  virtual Http::UpstreamCodeStats& codeStats() const PURE;
+
   /**
    * Returns an optional source address for upstream connections to bind to.
    *
    * @return a source address to bind to or nullptr if no bind need occur.
    */
   virtual const Network::Address::InstanceConstSharedPtr& sourceAddress() const PURE;
+
+  /**
+   * @return the socket options that are set on upstream connections to the cluster.
+   */
+  virtual const Network::SocketOptions& socketOptions() const PURE;
 };
 
 typedef std::shared_ptr<const ClusterInfo> ClusterInfoConstSharedPtr;
@@ -3,6 +3,7 @@
 #include <chrono>
 #include <string>
 
+#include "common/buffer/watermark_buffer.h"
 #include "common/event/dispatcher_impl.h"
 #include "common/filesystem/filesystem_impl.h"
 
@@ -10,12 +11,16 @@ namespace Envoy {
 namespace Api {
 
 Event::DispatcherPtr Impl::allocateDispatcher() {
-  return Event::DispatcherPtr{new Event::DispatcherImpl()};
+  return Event::DispatcherPtr{new Event::DispatcherImpl(
+      Buffer::WatermarkFactoryPtr{new Buffer::WatermarkBufferFactory}, connection_read_budget_,
+      event_backend_)};
 }
 
-Impl::Impl(std::chrono::milliseconds file_flush_interval_msec)
+Impl::Impl(std::chrono::milliseconds file_flush_interval_msec, uint64_t connection_read_budget,
+           const std::string& event_backend)
     : os_sys_calls_(new Filesystem::OsSysCallsImpl()),
-      file_flush_interval_msec_(file_flush_interval_msec) {}
+      file_flush_interval_msec_(file_flush_interval_msec),
+      connection_read_budget_(connection_read_budget), event_backend_(event_backend) {}
 
 Filesystem::FileSharedPtr Impl::createFile(const std::string& path, Event::Dispatcher& dispatcher,
                                            Thread::BasicLockable& lock, Stats::Store& stats_store) {
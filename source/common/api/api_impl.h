@@ -14,7 +14,15 @@ namespace Api {
  */
 class Impl : public Api::Api {
 public:
-  Impl(std::chrono::milliseconds file_flush_interval_msec);
+  /**
+   * @param file_flush_interval_msec supplies the flush interval of created files.
+   * @param connection_read_budget supplies the read budget of the connections of allocated
+   *        dispatchers. @see Event::DispatcherImpl.
+   * @param event_backend supplies the libevent backend of allocated dispatchers, or empty for the
+   *        default one.
+   */
+  Impl(std::chrono::milliseconds file_flush_interval_msec, uint64_t connection_read_budget,
+       const std::string& event_backend);
 
   // Api::Api
   Event::DispatcherPtr allocateDispatcher() override;
@@ -27,6 +35,8 @@ public:
 private:
   Filesystem::OsSysCallsPtr os_sys_calls_;
   std::chrono::milliseconds file_flush_interval_msec_;
+  const uint64_t connection_read_budget_;
+  const std::string event_backend_;
 };
 
 } // namespace Api
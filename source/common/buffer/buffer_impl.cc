@@ -1,110 +1,537 @@
 #include "common/buffer/buffer_impl.h"
 
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <new>
 #include <string>
 
-#include "common/common/assert.h"
-
-#include "event2/buffer.h"
-
 namespace Envoy {
 namespace Buffer {
 
-// RawSlice is the same structure as evbuffer_iovec. This was put into place to avoid leaking
-// libevent into most code since we will likely replace evbuffer with our own implementation at
-// some point. However, we can avoid a bunch of copies since the structure is the same.
-static_assert(sizeof(RawSlice) == sizeof(evbuffer_iovec), "RawSlice != evbuffer_iovec");
-static_assert(offsetof(RawSlice, mem_) == offsetof(evbuffer_iovec, iov_base),
-              "RawSlice != evbuffer_iovec");
-static_assert(offsetof(RawSlice, len_) == offsetof(evbuffer_iovec, iov_len),
-              "RawSlice != evbuffer_iovec");
+// RawSlice is the same structure as iovec, so slices can be passed to readv() and writev()
+// without copies.
+static_assert(sizeof(RawSlice) == sizeof(iovec), "RawSlice != iovec");
+static_assert(offsetof(RawSlice, mem_) == offsetof(iovec, iov_base), "RawSlice != iovec");
+static_assert(offsetof(RawSlice, len_) == offsetof(iovec, iov_len), "RawSlice != iovec");
+
+const uint64_t Slab::DEFAULT_SIZE;
+const uint32_t SlabPool::MAX_CACHED_SLABS;
+const uint64_t OwnedImpl::COPY_THRESHOLD;
+const uint64_t OwnedImpl::MAX_READ_SLICES;
+const uint64_t OwnedImpl::MAX_WRITE_SLICES;
+
+namespace {
+
+const uint64_t PAGE_SIZE = 4096;
+
+// Slabs can be released while thread locals are being destroyed at thread exit, so the pool of
+// the thread must not be used after the destructor of its owner ran. A trivially destructible
+// pointer stays valid until then.
+thread_local SlabPool* current_pool = nullptr;
+thread_local bool current_pool_exited = false;
+
+} // namespace
+
+/**
+ * Hands the pool of a thread over to its remaining slabs when the thread exits.
+ */
+struct ThreadSlabPool {
+  ~ThreadSlabPool() {
+    current_pool_exited = true;
+    if (current_pool != nullptr) {
+      SlabPool* pool = current_pool;
+      current_pool = nullptr;
+      pool->threadExited();
+    }
+  }
+};
+
+namespace {
+thread_local ThreadSlabPool thread_slab_pool;
+} // namespace
+
+Slab* Slab::create(uint64_t min_capacity) {
+  const uint64_t capacity = min_capacity > DEFAULT_SIZE
+                                ? (min_capacity + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE
+                                : DEFAULT_SIZE;
+  SlabPool* pool = SlabPool::threadLocal();
+  return pool != nullptr ? pool->allocate(capacity) : allocate(capacity, nullptr);
+}
+
+Slab* Slab::create(BufferFragment& fragment) {
+  // The fragment data is never written. A slice of the fragment that ends before it does, e.g.
+  // the front of a partial move, has fragment memory after its data, so Slice::reservableSize()
+  // checks isFragment() rather than relying on the capacity.
+  uint8_t* data = static_cast<uint8_t*>(const_cast<void*>(fragment.data()));
+  void* memory = ::operator new(sizeof(Slab));
+  return new (memory) Slab(fragment.size(), nullptr, &fragment, data);
+}
+
+Slab* Slab::allocate(uint64_t capacity, SlabPool* pool) {
+  void* memory = ::operator new(sizeof(Slab) + capacity);
+  Slab* slab = static_cast<Slab*>(memory);
+  return new (memory) Slab(capacity, pool, nullptr, reinterpret_cast<uint8_t*>(slab + 1));
+}
+
+void Slab::free(Slab* slab) {
+  slab->~Slab();
+  ::operator delete(slab);
+}
+
+void Slab::release() {
+  if (fragment_ != nullptr) {
+    BufferFragment& fragment = *fragment_;
+    free(this);
+    fragment.done();
+  } else if (pool_ != nullptr) {
+    pool_->release(this);
+  } else {
+    free(this);
+  }
+}
+
+SlabPool* SlabPool::threadLocal() {
+  if (current_pool == nullptr && !current_pool_exited) {
+    // Touch the thread local owner so that its destructor runs at thread exit.
+    (void)thread_slab_pool;
+    current_pool = new SlabPool();
+  }
+
+  return current_pool;
+}
+
+void SlabPool::setStats(SlabPoolStats* stats) {
+  ASSERT(this == current_pool);
+  stats_ = stats;
+  updateStats();
+}
+
+Slab* SlabPool::allocate(uint64_t capacity) {
+  ASSERT(this == current_pool);
+  refs_++;
+  Slab* slab;
+  if (capacity == Slab::DEFAULT_SIZE && num_cached_ > 0) {
+    slab = cached_[--num_cached_];
+    slab->refs_ = 1;
+  } else {
+    slab = Slab::allocate(capacity, this);
+    bytes_allocated_ += capacity;
+  }
+
+  updateStats();
+  return slab;
+}
+
+void SlabPool::release(Slab* slab) {
+  if (this != current_pool) {
+    // Released on another thread, or after the owning thread exited.
+    bytes_allocated_ -= slab->capacity();
+    Slab::free(slab);
+    unref();
+    return;
+  }
+
+  // The owning thread holds a reference, so this does not destroy the pool.
+  refs_--;
+  if (slab->capacity() == Slab::DEFAULT_SIZE && num_cached_ < MAX_CACHED_SLABS) {
+    cached_[num_cached_++] = slab;
+  } else {
+    bytes_allocated_ -= slab->capacity();
+    Slab::free(slab);
+  }
+
+  updateStats();
+}
+
+void SlabPool::threadExited() {
+  for (uint32_t i = 0; i < num_cached_; i++) {
+    bytes_allocated_ -= cached_[i]->capacity();
+    Slab::free(cached_[i]);
+  }
+
+  num_cached_ = 0;
+  stats_ = nullptr;
+  unref();
+}
+
+void SlabPool::unref() {
+  if (--refs_ == 0) {
+    delete this;
+  }
+}
 
-void OwnedImpl::add(const void* data, uint64_t size) { evbuffer_add(buffer_.get(), data, size); }
+void SlabPool::updateStats() {
+  if (stats_ != nullptr) {
+    stats_->slabs_in_use_.set(slabsInUse());
+    stats_->slabs_cached_.set(num_cached_);
+    stats_->bytes_allocated_.set(bytes_allocated_);
+  }
+}
 
-void OwnedImpl::add(const std::string& data) {
-  evbuffer_add(buffer_.get(), data.c_str(), data.size());
+uint64_t Slice::append(const void* data, uint64_t size) {
+  const uint64_t copy_size = std::min(size, reservableSize());
+  memcpy(reservable(), data, copy_size);
+  reservable_ += copy_size;
+  return copy_size;
 }
 
+void OwnedImpl::add(const void* data, uint64_t size) {
+  const uint8_t* src = static_cast<const uint8_t*>(data);
+  length_ += size;
+  while (size > 0) {
+    if (slices_.empty() || slices_.back().reservableSize() == 0) {
+      slices_.emplace_back(Slab::create(size));
+    }
+
+    const uint64_t copied = slices_.back().append(src, size);
+    src += copied;
+    size -= copied;
+  }
+}
+
+void OwnedImpl::add(const std::string& data) { add(data.c_str(), data.size()); }
+
 void OwnedImpl::add(const Instance& data) {
-  uint64_t num_slices = data.getRawSlices(nullptr, 0);
-  RawSlice slices[num_slices];
-  data.getRawSlices(slices, num_slices);
-  for (RawSlice& slice : slices) {
-    add(slice.mem_, slice.len_);
+  const OwnedImpl* other = dynamic_cast<const OwnedImpl*>(&data);
+  if (other == nullptr) {
+    uint64_t num_slices = data.getRawSlices(nullptr, 0);
+    RawSlice slices[num_slices];
+    data.getRawSlices(slices, num_slices);
+    for (RawSlice& slice : slices) {
+      add(slice.mem_, slice.len_);
+    }
+    return;
+  }
+
+  // Share the slabs of the other buffer. Iterating by index keeps this correct when adding a
+  // buffer to itself.
+  const size_t num_slices = other->slices_.size();
+  for (size_t i = 0; i < num_slices; i++) {
+    const Slice& slice = other->slices_[i];
+    if (slice.dataSize() < COPY_THRESHOLD) {
+      appendSliceCopy(slice);
+    } else {
+      length_ += slice.dataSize();
+      slices_.emplace_back(slice);
+    }
   }
 }
 
+void OwnedImpl::addBufferFragment(BufferFragment& fragment) {
+  if (fragment.size() == 0) {
+    fragment.done();
+    return;
+  }
+
+  Slice slice(Slab::create(fragment), fragment.size());
+  length_ += fragment.size();
+  slices_.emplace_back(std::move(slice));
+}
+
 void OwnedImpl::commit(RawSlice* iovecs, uint64_t num_iovecs) {
-  int rc =
-      evbuffer_commit_space(buffer_.get(), reinterpret_cast<evbuffer_iovec*>(iovecs), num_iovecs);
-  ASSERT(rc == 0);
-  UNREFERENCED_PARAMETER(rc);
+  if (num_iovecs == 0) {
+    return;
+  }
+
+  // The reserved slices are at the end of the buffer, so look for the first one from the back.
+  size_t first_reserved = slices_.size();
+  while (first_reserved > 0 && slices_[first_reserved - 1].reservable() != iovecs[0].mem_) {
+    first_reserved--;
+  }
+
+  ASSERT(first_reserved > 0);
+  if (first_reserved == 0) {
+    return;
+  }
+
+  first_reserved--;
+  size_t slice_index = first_reserved;
+  for (uint64_t i = 0; i < num_iovecs; i++) {
+    while (slice_index < slices_.size() && slices_[slice_index].reservable() != iovecs[i].mem_) {
+      slice_index++;
+    }
+
+    ASSERT(slice_index < slices_.size());
+    if (slice_index == slices_.size()) {
+      break;
+    }
+
+    slices_[slice_index].commit(iovecs[i].len_);
+    length_ += iovecs[i].len_;
+  }
+
+  // Drop reserved slices that did not get any data.
+  for (size_t i = slices_.size(); i > first_reserved; i--) {
+    if (slices_[i - 1].dataSize() == 0) {
+      slices_.erase(slices_.begin() + (i - 1));
+    }
+  }
 }
 
 void OwnedImpl::drain(uint64_t size) {
   ASSERT(size <= length());
-  int rc = evbuffer_drain(buffer_.get(), size);
-  ASSERT(rc == 0);
-  UNREFERENCED_PARAMETER(rc);
+  length_ -= size;
+  while (size > 0) {
+    Slice& slice = slices_.front();
+    if (slice.dataSize() > size) {
+      slice.drain(size);
+      return;
+    }
+
+    size -= slice.dataSize();
+    slices_.pop_front();
+  }
 }
 
 uint64_t OwnedImpl::getRawSlices(RawSlice* out, uint64_t out_size) const {
-  return evbuffer_peek(buffer_.get(), -1, nullptr, reinterpret_cast<evbuffer_iovec*>(out),
-                       out_size);
-}
+  uint64_t num_slices = 0;
+  for (const Slice& slice : slices_) {
+    if (slice.dataSize() == 0) {
+      continue;
+    }
+
+    if (num_slices < out_size) {
+      out[num_slices].mem_ = slice.data();
+      out[num_slices].len_ = slice.dataSize();
+    }
+    num_slices++;
+  }
 
-uint64_t OwnedImpl::length() const { return evbuffer_get_length(buffer_.get()); }
+  return num_slices;
+}
 
 void* OwnedImpl::linearize(uint32_t size) {
   ASSERT(size <= length());
-  return evbuffer_pullup(buffer_.get(), size);
+  while (!slices_.empty() && slices_.front().dataSize() == 0) {
+    slices_.pop_front();
+  }
+
+  if (slices_.empty()) {
+    return nullptr;
+  }
+
+  if (slices_.front().dataSize() >= size) {
+    return slices_.front().data();
+  }
+
+  Slice linearized(Slab::create(size));
+  uint64_t remaining = size;
+  while (remaining > 0) {
+    Slice& slice = slices_.front();
+    const uint64_t copy_size = std::min(remaining, slice.dataSize());
+    linearized.append(slice.data(), copy_size);
+    slice.drain(copy_size);
+    remaining -= copy_size;
+    if (slice.dataSize() == 0) {
+      slices_.pop_front();
+    }
+  }
+
+  slices_.emplace_front(std::move(linearized));
+  return slices_.front().data();
 }
 
 void OwnedImpl::move(Instance& rhs) {
-  // We do the static cast here because in practice we only have one buffer implementation right
-  // now and this is safe. Using the evbuffer move routines require having access to both evbuffers.
-  // This is a reasonable compromise in a high performance path where we want to maintain an
-  // abstraction in case we get rid of evbuffer later.
-  int rc = evbuffer_add_buffer(buffer_.get(), static_cast<LibEventInstance&>(rhs).buffer().get());
-  ASSERT(rc == 0);
-  UNREFERENCED_PARAMETER(rc);
-  static_cast<LibEventInstance&>(rhs).postProcess();
+  // We do the static cast here because in practice we only have one buffer implementation and
+  // moving slices requires access to both buffers.
+  OwnedImpl& other = static_cast<OwnedImpl&>(rhs);
+  for (Slice& slice : other.slices_) {
+    appendSlice(std::move(slice));
+  }
+
+  other.slices_.clear();
+  other.length_ = 0;
+  other.postProcess();
 }
 
 void OwnedImpl::move(Instance& rhs, uint64_t length) {
   // See move() above for why we do the static cast.
-  int rc = evbuffer_remove_buffer(static_cast<LibEventInstance&>(rhs).buffer().get(), buffer_.get(),
-                                  length);
-  ASSERT(static_cast<uint64_t>(rc) == length);
-  UNREFERENCED_PARAMETER(rc);
-  static_cast<LibEventInstance&>(rhs).postProcess();
+  OwnedImpl& other = static_cast<OwnedImpl&>(rhs);
+  ASSERT(length <= other.length());
+  other.length_ -= length;
+  while (length > 0) {
+    Slice& slice = other.slices_.front();
+    if (slice.dataSize() <= length) {
+      length -= slice.dataSize();
+      appendSlice(std::move(slice));
+      other.slices_.pop_front();
+    } else {
+      // Only part of this slice is moved. Share its slab unless the part is small.
+      Slice part = slice.front(length);
+      slice.drain(length);
+      appendSlice(std::move(part));
+      length = 0;
+    }
+  }
+
+  other.postProcess();
 }
 
 int OwnedImpl::read(int fd, uint64_t max_length) {
-  return evbuffer_read(buffer_.get(), fd, max_length);
+  if (max_length == 0) {
+    return 0;
+  }
+
+  RawSlice slices[MAX_READ_SLICES];
+  const uint64_t num_slices = OwnedImpl::reserve(max_length, slices, MAX_READ_SLICES);
+  uint64_t num_bytes_to_read = 0;
+  for (uint64_t i = 0; i < num_slices; i++) {
+    slices[i].len_ = std::min(slices[i].len_, max_length - num_bytes_to_read);
+    num_bytes_to_read += slices[i].len_;
+  }
+
+  const ssize_t rc = ::readv(fd, reinterpret_cast<iovec*>(slices), num_slices);
+  const int saved_errno = errno;
+
+  uint64_t num_bytes_read = rc > 0 ? rc : 0;
+  for (uint64_t i = 0; i < num_slices; i++) {
+    slices[i].len_ = std::min(slices[i].len_, num_bytes_read);
+    num_bytes_read -= slices[i].len_;
+  }
+
+  // Committing also releases the reserved slices that did not get any data.
+  OwnedImpl::commit(slices, num_slices);
+  errno = saved_errno;
+  return rc;
 }
 
 uint64_t OwnedImpl::reserve(uint64_t length, RawSlice* iovecs, uint64_t num_iovecs) {
-  uint64_t ret = evbuffer_reserve_space(buffer_.get(), length,
-                                        reinterpret_cast<evbuffer_iovec*>(iovecs), num_iovecs);
-  ASSERT(ret >= 1);
-  return ret;
+  ASSERT(num_iovecs > 0);
+  uint64_t num_used = 0;
+  uint64_t reserved = 0;
+
+  // Use the space left in the last slice first, unless a single reservation does not fit there.
+  if (!slices_.empty()) {
+    const Slice& last = slices_.back();
+    const uint64_t reservable_size = last.reservableSize();
+    if (reservable_size > 0 && (num_iovecs > 1 || reservable_size >= length)) {
+      iovecs[0].mem_ = last.reservable();
+      iovecs[0].len_ = reservable_size;
+      reserved = reservable_size;
+      num_used = 1;
+    }
+  }
+
+  while (num_used < num_iovecs && (reserved < length || num_used == 0)) {
+    // The last iovec must fit the rest of the reservation.
+    const uint64_t size = num_used == num_iovecs - 1 ? length - reserved : Slab::DEFAULT_SIZE;
+    slices_.emplace_back(Slab::create(size));
+    iovecs[num_used].mem_ = slices_.back().reservable();
+    iovecs[num_used].len_ = slices_.back().reservableSize();
+    reserved += iovecs[num_used].len_;
+    num_used++;
+  }
+
+  return num_used;
 }
 
 ssize_t OwnedImpl::search(const void* data, uint64_t size, size_t start) const {
-  evbuffer_ptr start_ptr;
-  if (-1 == evbuffer_ptr_set(buffer_.get(), &start_ptr, start, EVBUFFER_PTR_SET)) {
+  if (start > length_) {
     return -1;
   }
 
-  evbuffer_ptr result_ptr =
-      evbuffer_search(buffer_.get(), static_cast<const char*>(data), size, &start_ptr);
-  return result_ptr.pos;
+  if (size == 0) {
+    return start;
+  }
+
+  const uint8_t* needle = static_cast<const uint8_t*>(data);
+  uint64_t slice_start = 0;
+  for (size_t i = 0; i < slices_.size(); i++) {
+    const Slice& slice = slices_[i];
+    const uint64_t slice_size = slice.dataSize();
+    if (start >= slice_start + slice_size) {
+      slice_start += slice_size;
+      continue;
+    }
+
+    const uint8_t* slice_data = slice.data();
+    uint64_t offset = start - slice_start;
+    // The matches that lie within the slice are found by memmem(), which does not compare every
+    // candidate byte by byte. Only the candidates that run into the next slices are left.
+    if (slice_size - offset >= size) {
+      const void* match = memmem(slice_data + offset, slice_size - offset, needle, size);
+      if (match != nullptr) {
+        return slice_start + (static_cast<const uint8_t*>(match) - slice_data);
+      }
+      offset = slice_size - size + 1;
+    }
+
+    // Look for the first byte of the needle in the rest of this slice and check each candidate.
+    while (offset < slice_size) {
+      const void* candidate = memchr(slice_data + offset, needle[0], slice_size - offset);
+      if (candidate == nullptr) {
+        break;
+      }
+
+      offset = static_cast<const uint8_t*>(candidate) - slice_data;
+      if (matchesAt(i, offset, needle, size)) {
+        return slice_start + offset;
+      }
+      offset++;
+    }
+
+    slice_start += slice_size;
+    start = slice_start;
+  }
+
+  return -1;
+}
+
+int OwnedImpl::write(int fd) {
+  RawSlice slices[MAX_WRITE_SLICES];
+  const uint64_t num_slices = std::min(getRawSlices(slices, MAX_WRITE_SLICES), MAX_WRITE_SLICES);
+  if (num_slices == 0) {
+    return 0;
+  }
+
+  const ssize_t rc = ::writev(fd, reinterpret_cast<iovec*>(slices), num_slices);
+  if (rc > 0) {
+    const int saved_errno = errno;
+    OwnedImpl::drain(rc);
+    errno = saved_errno;
+  }
+
+  return rc;
 }
 
-int OwnedImpl::write(int fd) { return evbuffer_write(buffer_.get(), fd); }
+void OwnedImpl::appendSlice(Slice&& slice) {
+  if (slice.dataSize() < COPY_THRESHOLD) {
+    appendSliceCopy(slice);
+    return;
+  }
+
+  length_ += slice.dataSize();
+  slices_.emplace_back(std::move(slice));
+}
+
+void OwnedImpl::appendSliceCopy(const Slice& slice) {
+  OwnedImpl::add(slice.data(), slice.dataSize());
+}
+
+bool OwnedImpl::matchesAt(size_t slice_index, uint64_t offset, const uint8_t* data,
+                          uint64_t size) const {
+  while (size > 0 && slice_index < slices_.size()) {
+    const Slice& slice = slices_[slice_index];
+    const uint64_t compare_size = std::min(size, slice.dataSize() - offset);
+    if (0 != memcmp(slice.data() + offset, data, compare_size)) {
+      return false;
+    }
+
+    data += compare_size;
+    size -= compare_size;
+    slice_index++;
+    offset = 0;
+  }
+
+  return size == 0;
+}
 
-OwnedImpl::OwnedImpl() : buffer_(evbuffer_new()) {}
+OwnedImpl::OwnedImpl() {}
 
 OwnedImpl::OwnedImpl(const std::string& data) : OwnedImpl() { add(data); }
 
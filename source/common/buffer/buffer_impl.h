@@ -1,44 +1,301 @@
 #pragma once
 
+#include <limits.h>
+
+#include <atomic>
 #include <cstdint>
+#include <deque>
+#include <functional>
 #include <string>
 
 #include "envoy/buffer/buffer.h"
+#include "envoy/stats/stats_macros.h"
 
-#include "common/event/libevent.h"
+#include "common/common/assert.h"
 
 namespace Envoy {
 namespace Buffer {
 
-class LibEventInstance : public Instance {
+class SlabPool;
+
+/**
+ * A reference counted block of memory that backs buffer slices. The block can be shared by the
+ * slices of several buffers to avoid copies, in which case it becomes read only. Slabs are
+ * allocated from the pool of the creating thread. A slab can also reference the memory of a buffer
+ * fragment, which is always read only.
+ */
+class Slab {
+public:
+  // Capacity of a default slab. Larger slabs are only allocated for single reservations, adds and
+  // linearizations that do not fit in a default slab. They are not recycled.
+  static const uint64_t DEFAULT_SIZE = 16384;
+
+  /**
+   * @return Slab* a slab of at least min_capacity bytes with a reference count of 1.
+   */
+  static Slab* create(uint64_t min_capacity);
+
+  /**
+   * @return Slab* a slab that references the data of fragment with a reference count of 1. The
+   *         capacity of the slab is the size of the fragment. The slab is never reservable, even
+   *         through a slice that ends before the fragment does. fragment.done() is called when the
+   *         slab is released.
+   */
+  static Slab* create(BufferFragment& fragment);
+
+  void ref() { refs_++; }
+  void unref() {
+    if (--refs_ == 0) {
+      release();
+    }
+  }
+
+  bool shared() const { return refs_ > 1; }
+  bool isFragment() const { return fragment_ != nullptr; }
+  uint64_t capacity() const { return capacity_; }
+  uint8_t* data() { return data_; }
+
+private:
+  friend class SlabPool;
+
+  Slab(uint64_t capacity, SlabPool* pool, BufferFragment* fragment, uint8_t* data)
+      : refs_(1), capacity_(capacity), pool_(pool), fragment_(fragment), data_(data) {}
+
+  static Slab* allocate(uint64_t capacity, SlabPool* pool);
+  static void free(Slab* slab);
+  void release();
+
+  std::atomic<uint32_t> refs_;
+  const uint64_t capacity_;
+  SlabPool* const pool_;
+  BufferFragment* const fragment_;
+  // Either the memory right after the slab or the data of the fragment.
+  uint8_t* const data_;
+};
+
+// clang-format off
+#define ALL_SLAB_POOL_STATS(GAUGE)                                                                 \
+  GAUGE(slabs_in_use)                                                                              \
+  GAUGE(slabs_cached)                                                                              \
+  GAUGE(bytes_allocated)
+// clang-format on
+
+/**
+ * Struct definition for all slab pool stats. @see stats_macros.h
+ */
+struct SlabPoolStats {
+  ALL_SLAB_POOL_STATS(GENERATE_GAUGE_STRUCT)
+};
+
+/**
+ * The slabs allocated by one thread. Since each worker runs a single dispatcher on its own thread,
+ * this is the buffer memory of that worker. Default size slabs released on the owning thread are
+ * cached for reuse by the next allocation. Slabs released on other threads are freed, but remain
+ * accounted to the pool until then.
+ *
+ * The pool outlives its thread until the last of its slabs is released.
+ */
+class SlabPool {
+public:
+  // Maximum number of default slabs that each pool caches for reuse.
+  static const uint32_t MAX_CACHED_SLABS = 64;
+
+  /**
+   * @return SlabPool* the pool of the calling thread, or nullptr if the thread is exiting.
+   */
+  static SlabPool* threadLocal();
+
+  /**
+   * Set the gauges that reflect this pool. Must be called on the owning thread. The gauges are
+   * updated on every allocation and release on the owning thread.
+   * @param stats supplies the gauges, or nullptr to stop updating them. They must remain valid
+   *        until replaced.
+   */
+  void setStats(SlabPoolStats* stats);
+
+  /**
+   * @return uint64_t the number of slabs of this pool referenced by slices.
+   */
+  uint64_t slabsInUse() const { return refs_ - 1; }
+
+  /**
+   * @return uint64_t the number of released slabs cached for reuse.
+   */
+  uint64_t slabsCached() const { return num_cached_; }
+
+  /**
+   * @return uint64_t the memory held by the slabs in use and the cached slabs.
+   */
+  uint64_t bytesAllocated() const { return bytes_allocated_; }
+
+private:
+  friend class Slab;
+  friend struct ThreadSlabPool;
+
+  SlabPool() : refs_(1) {}
+
+  Slab* allocate(uint64_t capacity);
+  void release(Slab* slab);
+  void threadExited();
+  void unref();
+  void updateStats();
+
+  // One reference for the owning thread and one for each slab in use. Slabs can be released on
+  // any thread, so this is atomic.
+  std::atomic<uint64_t> refs_;
+  std::atomic<uint64_t> bytes_allocated_{};
+  // Only used by the owning thread.
+  Slab* cached_[MAX_CACHED_SLABS];
+  uint32_t num_cached_{};
+  SlabPoolStats* stats_{};
+};
+
+/**
+ * A contiguous range of data within a slab. The slab space following the data may be written if
+ * the slab is not shared with other slices and does not reference a fragment.
+ */
+class Slice {
 public:
-  // Allows access into the underlying buffer for move() optimizations.
-  virtual Event::Libevent::BufferPtr& buffer() PURE;
-  // Called after accessing the memory in buffer() directly to allow any post-processing.
-  virtual void postProcess() PURE;
+  /**
+   * @param slab supplies the slab. The slice takes over the caller's reference.
+   */
+  explicit Slice(Slab* slab) : slab_(slab) {}
+  /**
+   * @param slab supplies the slab. The slice takes over the caller's reference.
+   * @param size supplies the number of bytes at the start of the slab that are already data.
+   */
+  Slice(Slab* slab, uint64_t size) : slab_(slab), reservable_(size) {
+    ASSERT(size <= slab->capacity());
+  }
+  Slice(const Slice& other)
+      : slab_(other.slab_), data_(other.data_), reservable_(other.reservable_) {
+    slab_->ref();
+  }
+  Slice(Slice&& other) noexcept
+      : slab_(other.slab_), data_(other.data_), reservable_(other.reservable_) {
+    other.slab_ = nullptr;
+  }
+  ~Slice() {
+    if (slab_) {
+      slab_->unref();
+    }
+  }
+
+  Slice& operator=(const Slice&) = delete;
+  Slice& operator=(Slice&& other) noexcept {
+    if (this != &other) {
+      if (slab_) {
+        slab_->unref();
+      }
+      slab_ = other.slab_;
+      data_ = other.data_;
+      reservable_ = other.reservable_;
+      other.slab_ = nullptr;
+    }
+    return *this;
+  }
+
+  uint8_t* data() const { return slab_->data() + data_; }
+  uint64_t dataSize() const { return reservable_ - data_; }
+  uint8_t* reservable() const { return slab_->data() + reservable_; }
+  uint64_t reservableSize() const {
+    return slab_->isFragment() || slab_->shared() ? 0 : slab_->capacity() - reservable_;
+  }
+
+  /**
+   * Copy as much of the data as fits into the reservable space.
+   * @return uint64_t the number of bytes copied.
+   */
+  uint64_t append(const void* data, uint64_t size);
+
+  /**
+   * Add size bytes of the reservable space, which the caller has written, to the data.
+   */
+  void commit(uint64_t size) {
+    ASSERT(size <= reservableSize());
+    reservable_ += size;
+  }
+
+  /**
+   * Remove size bytes from the front of the data.
+   */
+  void drain(uint64_t size) {
+    ASSERT(size <= dataSize());
+    data_ += size;
+  }
+
+  /**
+   * @return Slice a slice that shares the slab and contains the first size bytes of the data.
+   */
+  Slice front(uint64_t size) const {
+    ASSERT(size <= dataSize());
+    Slice slice(*this);
+    slice.reservable_ = data_ + size;
+    return slice;
+  }
+
+private:
+  Slab* slab_;
+  uint64_t data_{};
+  uint64_t reservable_{};
+};
+
+/**
+ * A buffer fragment that calls a callback when it is done.
+ */
+class BufferFragmentImpl : public BufferFragment {
+public:
+  typedef std::function<void(const void*, size_t, const BufferFragmentImpl*)> ReleaseCb;
+
+  /**
+   * @param data supplies the externally owned data.
+   * @param size supplies the size of the data.
+   * @param release supplies an optional callback that is called with the data, the size and the
+   *        fragment itself when the fragment is done. It is typically used to free the data and
+   *        the fragment.
+   */
+  BufferFragmentImpl(const void* data, size_t size, ReleaseCb release)
+      : data_(data), size_(size), release_(release) {}
+
+  // Buffer::BufferFragment
+  const void* data() const override { return data_; }
+  size_t size() const override { return size_; }
+  void done() override {
+    if (release_) {
+      release_(data_, size_, this);
+    }
+  }
+
+private:
+  const void* const data_;
+  const size_t size_;
+  const ReleaseCb release_;
 };
 
 /**
- * Wraps an allocated and owned evbuffer.
+ * A buffer made of a queue of slices backed by pooled slabs. Moving data between buffers moves
+ * slices instead of copying data, and adding one buffer to another shares the slabs of large
+ * slices. Slices smaller than COPY_THRESHOLD are copied instead to keep buffers from fragmenting.
  *
- * Note that due to the internals of move() accessing buffer(), OwnedImpl is not
- * compatible with non-LibEventInstance buffers.
+ * Note that move() and add() only move or share slices when the other buffer is also an
+ * OwnedImpl, which in practice is the only buffer implementation. move() requires this.
  */
-class OwnedImpl : public LibEventInstance {
+class OwnedImpl : public Instance {
 public:
   OwnedImpl();
   OwnedImpl(const std::string& data);
   OwnedImpl(const Instance& data);
   OwnedImpl(const void* data, uint64_t size);
 
-  // LibEventInstance
+  // Buffer::Instance
   void add(const void* data, uint64_t size) override;
   void add(const std::string& data) override;
   void add(const Instance& data) override;
+  void addBufferFragment(BufferFragment& fragment) override;
   void commit(RawSlice* iovecs, uint64_t num_iovecs) override;
   void drain(uint64_t size) override;
   uint64_t getRawSlices(RawSlice* out, uint64_t out_size) const override;
-  uint64_t length() const override;
+  uint64_t length() const override { return length_; }
   void* linearize(uint32_t size) override;
   void move(Instance& rhs) override;
   void move(Instance& rhs, uint64_t length) override;
@@ -46,12 +303,28 @@ public:
   uint64_t reserve(uint64_t length, RawSlice* iovecs, uint64_t num_iovecs) override;
   ssize_t search(const void* data, uint64_t size, size_t start) const override;
   int write(int fd) override;
-  void postProcess() override {}
 
-  Event::Libevent::BufferPtr& buffer() override { return buffer_; }
+protected:
+  // Called after another buffer moved data out of this buffer without going through drain(), to
+  // allow any post-processing.
+  virtual void postProcess() {}
 
 private:
-  Event::Libevent::BufferPtr buffer_;
+  // Slices smaller than this are copied instead of moved or shared.
+  static const uint64_t COPY_THRESHOLD = 512;
+  // Maximum number of slices handed to a single readv(). Reads use the free space of the last slice
+  // and then default slabs, so this bounds the reads that avoid large slabs.
+  static const uint64_t MAX_READ_SLICES = 8;
+  // Maximum number of slices handed to a single writev(), so that a buffer made of many small
+  // writes is still written with one syscall.
+  static const uint64_t MAX_WRITE_SLICES = IOV_MAX;
+
+  void appendSlice(Slice&& slice);
+  void appendSliceCopy(const Slice& slice);
+  bool matchesAt(size_t slice_index, uint64_t offset, const uint8_t* data, uint64_t size) const;
+
+  std::deque<Slice> slices_;
+  uint64_t length_{};
 };
 
 } // namespace Buffer
@@ -1,5 +1,7 @@
 #include "common/buffer/zero_copy_input_stream_impl.h"
 
+#include <algorithm>
+
 #include "common/buffer/buffer_impl.h"
 #include "common/common/assert.h"
 
@@ -44,7 +46,20 @@ bool ZeroCopyInputStreamImpl::Next(const void** data, int* size) {
   return false;
 }
 
-bool ZeroCopyInputStreamImpl::Skip(int) { NOT_IMPLEMENTED; }
+bool ZeroCopyInputStreamImpl::Skip(int count) {
+  ASSERT(count >= 0);
+  if (position_ != 0) {
+    buffer_->drain(position_);
+    position_ = 0;
+  }
+
+  // Skipped data is drained without being looked at, so skipping a large field of a message does
+  // not touch its slices.
+  const uint64_t skip = std::min<uint64_t>(count, buffer_->length());
+  buffer_->drain(skip);
+  byte_count_ += skip;
+  return skip == uint64_t(count);
+}
 
 void ZeroCopyInputStreamImpl::BackUp(int count) {
   ASSERT(count >= 0);
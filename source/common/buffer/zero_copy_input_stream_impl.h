@@ -36,7 +36,9 @@ public:
   // LimitingInputStream before passing to protobuf code to avoid a spin loop.
   virtual bool Next(const void** data, int* size) override;
   virtual void BackUp(int count) override;
-  virtual bool Skip(int count) override; // Not implemented
+  // Skip() returns false when fewer than count bytes are available, whether or not the stream is
+  // finished, after skipping the available bytes.
+  virtual bool Skip(int count) override;
   virtual ProtobufTypes::Int64 ByteCount() const override { return byte_count_; }
 
 protected:
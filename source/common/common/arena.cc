@@ -0,0 +1,59 @@
+#include "common/common/arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+
+Arena::Arena() : current_(inline_storage_), end_(inline_storage_ + INLINE_SIZE) {}
+
+Arena::~Arena() {
+  while (heap_blocks_head_) {
+    HeapBlock* next = heap_blocks_head_->next_;
+    ::free(heap_blocks_head_);
+    heap_blocks_head_ = next;
+  }
+}
+
+void* Arena::allocate(size_t size, size_t alignment) {
+  ASSERT(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+  uintptr_t start = (reinterpret_cast<uintptr_t>(current_) + alignment - 1) & ~(alignment - 1);
+  if (start + size > reinterpret_cast<uintptr_t>(end_)) {
+    newHeapBlock(size + alignment);
+    start = (reinterpret_cast<uintptr_t>(current_) + alignment - 1) & ~(alignment - 1);
+  }
+
+  current_ = reinterpret_cast<uint8_t*>(start + size);
+  bytes_allocated_ += size;
+  return reinterpret_cast<void*>(start);
+}
+
+void Arena::newHeapBlock(size_t min_size) {
+  // Grow geometrically so that a stream which uses a lot of memory does not do so in many small
+  // allocations.
+  size_t size = MIN_HEAP_BLOCK_SIZE << std::min<uint32_t>(heap_blocks_, 8);
+  while (size < min_size) {
+    size *= 2;
+  }
+
+  // The header is padded out to max alignment so that the usable region starts aligned.
+  const size_t header_size =
+      (sizeof(HeapBlock) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+  void* memory = ::malloc(header_size + size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+
+  HeapBlock* block = static_cast<HeapBlock*>(memory);
+  block->next_ = heap_blocks_head_;
+  heap_blocks_head_ = block;
+  heap_blocks_++;
+
+  current_ = static_cast<uint8_t*>(memory) + header_size;
+  end_ = current_ + size;
+}
+
+} // namespace Envoy
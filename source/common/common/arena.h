@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "common/common/non_copyable.h"
+
+namespace Envoy {
+
+/**
+ * Bump allocator for objects that share a lifetime, such as everything belonging to a single HTTP
+ * stream. Allocation is a pointer increment into the current block and individual allocations are
+ * never freed; all memory is released at once when the arena is destroyed. The first block is
+ * embedded in the arena itself so that an arena which is a member of a heap allocated object adds
+ * no allocations until the embedded block is exhausted. Not thread safe.
+ */
+class Arena : NonCopyable {
+public:
+  Arena();
+  ~Arena();
+
+  /**
+   * Allocate uninitialized memory.
+   * @param size supplies the number of bytes to allocate.
+   * @param alignment supplies the required alignment, which must be a power of two.
+   * @return void* the allocated memory, valid until the arena is destroyed.
+   */
+  void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+  /**
+   * @return uint64_t the total number of bytes handed out by allocate().
+   */
+  uint64_t bytesAllocated() const { return bytes_allocated_; }
+
+  /**
+   * @return uint32_t the number of heap blocks the arena has needed beyond its embedded block.
+   */
+  uint32_t heapBlocks() const { return heap_blocks_; }
+
+  static const size_t INLINE_SIZE = 1024;
+  static const size_t MIN_HEAP_BLOCK_SIZE = 4096;
+
+private:
+  struct HeapBlock {
+    HeapBlock* next_;
+  };
+
+  void newHeapBlock(size_t min_size);
+
+  alignas(std::max_align_t) uint8_t inline_storage_[INLINE_SIZE];
+  uint8_t* current_;
+  uint8_t* end_;
+  HeapBlock* heap_blocks_head_{};
+  uint64_t bytes_allocated_{};
+  uint32_t heap_blocks_{};
+};
+
+/**
+ * STL compatible allocator that allocates from an Arena if one is supplied and from the heap
+ * otherwise. This lets a container opt into arena allocation at construction time without
+ * changing its type. Deallocation is a no-op for arena memory.
+ */
+template <class T> class ArenaAllocator {
+public:
+  typedef T value_type;
+
+  ArenaAllocator(Arena* arena = nullptr) : arena_(arena) {}
+  template <class U> ArenaAllocator(const ArenaAllocator<U>& rhs) : arena_(rhs.arena()) {}
+
+  T* allocate(size_t n) {
+    if (arena_) {
+      return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t) {
+    if (!arena_) {
+      ::operator delete(p);
+    }
+  }
+
+  Arena* arena() const { return arena_; }
+
+  template <class U> bool operator==(const ArenaAllocator<U>& rhs) const {
+    return arena_ == rhs.arena();
+  }
+  template <class U> bool operator!=(const ArenaAllocator<U>& rhs) const {
+    return arena_ != rhs.arena();
+  }
+
+private:
+  Arena* arena_;
+};
+
+/**
+ * Mixin for classes whose instances are always created in an Arena via "new (arena) T(...)".
+ * Deleting such an object (for example through a std::unique_ptr) runs its destructor only; the
+ * memory is reclaimed when the arena is destroyed, so the arena must outlive the object.
+ */
+class ArenaObject {
+public:
+  static void* operator new(size_t size, Arena& arena) { return arena.allocate(size); }
+  static void* operator new(size_t size) = delete;
+
+  // Matches the placement form above and is only called if a constructor throws.
+  static void operator delete(void*, Arena&) {}
+  static void operator delete(void*) {}
+};
+
+} // namespace Envoy
@@ -24,6 +24,55 @@ static const unsigned char REVERSE_LOOKUP_TABLE[256] = {
     64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
     64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64};
 
+namespace {
+
+// Decodes a quantum of 4 characters, which may end in padding, and advances the output past the
+// decoded bytes. Returns false if the quantum is invalid.
+inline bool decodeQuantum(const uint8_t* input, uint8_t*& output) {
+  const uint32_t a = REVERSE_LOOKUP_TABLE[input[0]];
+  const uint32_t b = REVERSE_LOOKUP_TABLE[input[1]];
+  const uint32_t c = REVERSE_LOOKUP_TABLE[input[2]];
+  const uint32_t d = REVERSE_LOOKUP_TABLE[input[3]];
+
+  // The common case of 4 valid characters is decoded as one 24 bit word, with a single check.
+  if (((a | b | c | d) & 64) == 0) {
+    const uint32_t word = a << 18 | b << 12 | c << 6 | d;
+    *output++ = word >> 16;
+    *output++ = word >> 8;
+    *output++ = word;
+    return true;
+  }
+
+  // Otherwise the quantum must end in one or two padding characters, without unused bits.
+  if (a == 64 || b == 64 || input[3] != '=') {
+    return false;
+  }
+  if (input[2] == '=') {
+    if (b & 0b1111) {
+      return false;
+    }
+    *output++ = a << 2 | b >> 4;
+    return true;
+  }
+  if (c == 64 || (c & 0b11)) {
+    return false;
+  }
+  *output++ = a << 2 | b >> 4;
+  *output++ = b << 4 | c >> 2;
+  return true;
+}
+
+// Encodes 3 bytes as 4 characters, and advances the output past them.
+inline void encodeTriple(const uint8_t* input, char*& output) {
+  const uint32_t word = input[0] << 16 | input[1] << 8 | input[2];
+  *output++ = CHAR_TABLE[word >> 18];
+  *output++ = CHAR_TABLE[(word >> 12) & 0x3f];
+  *output++ = CHAR_TABLE[(word >> 6) & 0x3f];
+  *output++ = CHAR_TABLE[word & 0x3f];
+}
+
+} // namespace
+
 std::string Base64::decode(const std::string& input) {
   if (input.length() % 4 || input.empty()) {
     return EMPTY_STRING;
@@ -180,4 +229,99 @@ std::string Base64::encode(const char* input, uint64_t length) {
 
   return ret;
 }
+
+void Base64::encode(const Buffer::Instance& input, Buffer::Instance& output) {
+  const uint64_t output_length = (input.length() + 2) / 3 * 4;
+  if (output_length == 0) {
+    return;
+  }
+
+  Buffer::RawSlice reserved;
+  output.reserve(output_length, &reserved, 1);
+  char* out = static_cast<char*>(reserved.mem_);
+
+  uint64_t num_slices = input.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  input.getRawSlices(slices, num_slices);
+
+  // The bytes of a triple that spans slices.
+  uint8_t carry[3];
+  uint64_t carry_length = 0;
+  for (const Buffer::RawSlice& slice : slices) {
+    const uint8_t* in = static_cast<const uint8_t*>(slice.mem_);
+    const uint8_t* end = in + slice.len_;
+    if (carry_length > 0) {
+      while (carry_length < 3 && in != end) {
+        carry[carry_length++] = *in++;
+      }
+      if (carry_length < 3) {
+        continue;
+      }
+      encodeTriple(carry, out);
+      carry_length = 0;
+    }
+    for (; end - in >= 3; in += 3) {
+      encodeTriple(in, out);
+    }
+    while (in != end) {
+      carry[carry_length++] = *in++;
+    }
+  }
+
+  if (carry_length > 0) {
+    const uint32_t word = carry[0] << 16 | (carry_length == 2 ? carry[1] << 8 : 0);
+    *out++ = CHAR_TABLE[word >> 18];
+    *out++ = CHAR_TABLE[(word >> 12) & 0x3f];
+    *out++ = carry_length == 2 ? CHAR_TABLE[(word >> 6) & 0x3f] : '=';
+    *out++ = '=';
+  }
+
+  reserved.len_ = output_length;
+  output.commit(&reserved, 1);
+}
+
+bool Base64StreamDecoder::decode(Buffer::Instance& input, Buffer::Instance& output) {
+  const uint64_t output_length = (pending_length_ + input.length()) / 4 * 3;
+  Buffer::RawSlice reserved{nullptr, 0};
+  if (output_length > 0) {
+    output.reserve(output_length, &reserved, 1);
+  }
+  uint8_t* out = static_cast<uint8_t*>(reserved.mem_);
+
+  uint64_t num_slices = input.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  input.getRawSlices(slices, num_slices);
+
+  bool valid = true;
+  for (const Buffer::RawSlice& slice : slices) {
+    const uint8_t* in = static_cast<const uint8_t*>(slice.mem_);
+    const uint8_t* end = in + slice.len_;
+    if (pending_length_ > 0) {
+      while (pending_length_ < 4 && in != end) {
+        pending_[pending_length_++] = *in++;
+      }
+      if (pending_length_ < 4) {
+        continue;
+      }
+      pending_length_ = 0;
+      valid = decodeQuantum(pending_, out);
+    }
+    for (; valid && end - in >= 4; in += 4) {
+      valid = decodeQuantum(in, out);
+    }
+    if (!valid) {
+      break;
+    }
+    while (in != end) {
+      pending_[pending_length_++] = *in++;
+    }
+  }
+
+  if (output_length > 0) {
+    reserved.len_ = out - static_cast<uint8_t*>(reserved.mem_);
+    output.commit(&reserved, 1);
+  }
+  input.drain(input.length());
+  return valid;
+}
 } // namespace Envoy
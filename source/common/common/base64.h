@@ -22,6 +22,13 @@ public:
    */
   static std::string encode(const char* input, uint64_t length);
 
+  /**
+   * Base64 encode an input buffer, working on its slices directly.
+   * @param input supplies the buffer to encode.
+   * @param output supplies the buffer to which the padded output is appended.
+   */
+  static void encode(const Buffer::Instance& input, Buffer::Instance& output);
+
   /**
    * Base64 decode an input string.
    * @param input supplies the input to decode.
@@ -43,4 +50,29 @@ private:
    */
   static void encodeLast(uint64_t pos, uint8_t last_char, std::string& ret);
 };
+
+/**
+ * Base64 decoder of a stream that arrives in chunks, such as a gRPC-Web text body. The characters
+ * of an incomplete quantum are carried over to the next chunk. Any quantum may end in padding,
+ * as the stream may be a concatenation of padded base64 strings.
+ */
+class Base64StreamDecoder {
+public:
+  /**
+   * Decode the complete quanta of a chunk, working on its slices directly.
+   * @param input supplies the chunk to decode, which is drained.
+   * @param output supplies the buffer to which the decoded bytes are appended.
+   * @return bool whether the chunk is valid base64. The decoder must not be used after an error.
+   */
+  bool decode(Buffer::Instance& input, Buffer::Instance& output);
+
+  /**
+   * @return uint64_t the number of characters that are carried over to the next chunk.
+   */
+  uint64_t pendingLength() const { return pending_length_; }
+
+private:
+  uint8_t pending_[4];
+  uint64_t pending_length_{0};
+};
 } // namespace Envoy
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
+#include "envoy/buffer/buffer.h"
+
+// The streaming state is only declared in full for static linking, which is how xxhash is built.
+#define XXH_STATIC_LINKING_ONLY
 #include "xxhash.h"
 
 namespace Envoy {
@@ -9,11 +14,47 @@ namespace Envoy {
 class HashUtil {
 public:
   /**
-   * Return 64-bit hash with seed of 0 from the xxHash algorithm.
+   * Return 64-bit hash from the xxHash algorithm.
    * See https://github.com/Cyan4973/xxHash for details.
+   * @param input supplies the start of the data to hash.
+   * @param length supplies the length of the data.
+   * @param seed supplies the hash seed which defaults to 0.
+   */
+  static uint64_t xxHash64(const char* input, size_t length, uint64_t seed = 0) {
+    return XXH64(input, length, seed);
+  }
+
+  /**
+   * Return 64-bit hash from the xxHash algorithm.
+   * @param input supplies the string to hash.
+   * @param seed supplies the hash seed which defaults to 0.
    */
-  static uint64_t xxHash64(const std::string& input) {
-    return XXH64(input.c_str(), input.size(), 0);
+  static uint64_t xxHash64(const std::string& input, uint64_t seed = 0) {
+    return xxHash64(input.data(), input.size(), seed);
+  }
+
+  /**
+   * Return 64-bit hash from the xxHash algorithm of the contents of a buffer, equal to the hash of
+   * the contents as one string. The slices are hashed in place.
+   * @param input supplies the buffer to hash.
+   * @param seed supplies the hash seed which defaults to 0.
+   */
+  static uint64_t xxHash64(const Buffer::Instance& input, uint64_t seed = 0) {
+    uint64_t num_slices = input.getRawSlices(nullptr, 0);
+    if (num_slices == 1) {
+      Buffer::RawSlice slice;
+      input.getRawSlices(&slice, 1);
+      return xxHash64(static_cast<const char*>(slice.mem_), slice.len_, seed);
+    }
+
+    Buffer::RawSlice slices[num_slices];
+    input.getRawSlices(slices, num_slices);
+    XXH64_state_t state;
+    XXH64_reset(&state, seed);
+    for (const Buffer::RawSlice& slice : slices) {
+      XXH64_update(&state, slice.mem_, slice.len_);
+    }
+    return XXH64_digest(&state);
   }
 };
 
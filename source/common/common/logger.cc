@@ -26,20 +26,173 @@ std::vector<Logger>& Registry::allLoggers() {
   return *all_loggers;
 }
 
+constexpr std::chrono::milliseconds LockingStderrSink::DEFAULT_ASYNC_FLUSH_INTERVAL;
+
+bool LockingStderrSink::RingBuffer::push(const char* data, size_t size) {
+  const uint64_t tail = tail_.load(std::memory_order_relaxed);
+  if (tail - head_.load(std::memory_order_acquire) == messages_.size()) {
+    return false;
+  }
+
+  messages_[tail % messages_.size()].assign(data, size);
+  tail_.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+LockingStderrSink::~LockingStderrSink() { stopAsync(); }
+
+void LockingStderrSink::startAsync(uint32_t buffer_size,
+                                   std::chrono::milliseconds flush_interval) {
+  if (buffer_size == 0 || async_) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(async_lock_);
+    buffer_size_ = buffer_size;
+    flush_interval_ = flush_interval;
+    // Generations are unique across sinks, as the ring buffer of a thread is kept in a single
+    // thread local.
+    static std::atomic<uint64_t> next_generation{1};
+    generation_ = next_generation++;
+    stopping_ = false;
+    async_.store(true, std::memory_order_release);
+  }
+  flush_thread_ = std::thread([this]() -> void { flushThreadRoutine(); });
+}
+
+void LockingStderrSink::stopAsync() {
+  if (!async_) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(async_lock_);
+    async_ = false;
+    stopping_ = true;
+  }
+  stop_cv_.notify_one();
+  flush_thread_.join();
+
+  std::lock_guard<std::mutex> guard(async_lock_);
+  writeBuffered();
+  ring_buffers_.clear();
+}
+
+LockingStderrSink::RingBuffer* LockingStderrSink::threadRingBuffer() {
+  // Each thread shares its ring buffer with the sink, and marks it on exit so that the flush thread
+  // releases it once the thread's last messages are written.
+  struct ThreadRingBuffer {
+    ~ThreadRingBuffer() {
+      if (ring_buffer_) {
+        ring_buffer_->thread_exited_ = true;
+      }
+    }
+
+    RingBufferSharedPtr ring_buffer_;
+  };
+  static thread_local ThreadRingBuffer thread_ring_buffer;
+
+  // A ring buffer of an earlier startAsync() is no longer drained.
+  RingBufferSharedPtr& ring_buffer = thread_ring_buffer.ring_buffer_;
+  if (ring_buffer && ring_buffer->generation_ == generation_.load(std::memory_order_acquire)) {
+    return ring_buffer.get();
+  }
+
+  std::lock_guard<std::mutex> guard(async_lock_);
+  if (!async_) {
+    return nullptr;
+  }
+  if (ring_buffer) {
+    ring_buffer->thread_exited_ = true;
+  }
+  ring_buffer.reset(new RingBuffer(buffer_size_, generation_));
+  ring_buffers_.push_back(ring_buffer);
+  return ring_buffer.get();
+}
+
+void LockingStderrSink::flushThreadRoutine() {
+  std::unique_lock<std::mutex> guard(async_lock_);
+  while (!stop_cv_.wait_for(guard, flush_interval_, [this]() -> bool { return stopping_; })) {
+    writeBuffered();
+  }
+}
+
+void LockingStderrSink::writeBuffered() {
+  // Release the ring buffers of exited threads that are drained, and find out whether there is
+  // anything to write at all, so that an idle sink does not take the lock.
+  bool pending = dropped_messages_ != reported_dropped_messages_;
+  for (auto it = ring_buffers_.begin(); it != ring_buffers_.end();) {
+    RingBuffer& ring_buffer = **it;
+    // Loaded before the tail, so that the messages a thread pushed before exiting are not missed.
+    const bool exited = ring_buffer.thread_exited_;
+    if (ring_buffer.tail_.load(std::memory_order_acquire) != ring_buffer.head_) {
+      pending = true;
+    } else if (exited) {
+      it = ring_buffers_.erase(it);
+      continue;
+    }
+    ++it;
+  }
+  if (!pending) {
+    return;
+  }
+
+  Thread::OptionalLockGuard<Thread::BasicLockable> guard(lock_);
+  for (const RingBufferSharedPtr& ring_buffer : ring_buffers_) {
+    const uint64_t tail = ring_buffer->tail_.load(std::memory_order_acquire);
+    uint64_t head = ring_buffer->head_.load(std::memory_order_relaxed);
+    for (; head != tail; head++) {
+      const std::string& message = ring_buffer->messages_[head % ring_buffer->messages_.size()];
+      std::cerr.write(message.data(), message.size());
+    }
+    ring_buffer->head_.store(head, std::memory_order_release);
+  }
+
+  const uint64_t dropped_messages = dropped_messages_;
+  if (dropped_messages != reported_dropped_messages_) {
+    std::cerr << "dropped " << dropped_messages - reported_dropped_messages_
+              << " log messages as the log buffers were full (" << dropped_messages << " total)\n";
+    reported_dropped_messages_ = dropped_messages;
+  }
+}
+
 void LockingStderrSink::log(const spdlog::details::log_msg& msg) {
+  if (async_.load(std::memory_order_acquire)) {
+    if (msg.level < spdlog::level::critical) {
+      RingBuffer* ring_buffer = threadRingBuffer();
+      if (ring_buffer != nullptr) {
+        if (!ring_buffer->push(msg.formatted.data(), msg.formatted.size())) {
+          dropped_messages_++;
+        }
+        return;
+      }
+    } else {
+      std::lock_guard<std::mutex> guard(async_lock_);
+      writeBuffered();
+    }
+  }
+
   Thread::OptionalLockGuard<Thread::BasicLockable> guard(lock_);
   std::cerr << msg.formatted.str();
 }
 
 void LockingStderrSink::flush() {
+  if (async_) {
+    std::lock_guard<std::mutex> guard(async_lock_);
+    writeBuffered();
+  }
+
   Thread::OptionalLockGuard<Thread::BasicLockable> guard(lock_);
   std::cerr << std::flush;
 }
 
 spdlog::logger& Registry::getLog(Id id) { return *allLoggers()[static_cast<int>(id)].logger_; }
 
-void Registry::initialize(uint64_t log_level, Thread::BasicLockable& lock) {
+void Registry::initialize(uint64_t log_level, Thread::BasicLockable& lock,
+                          uint32_t async_buffer_size) {
   getSink()->setLock(lock);
+  getSink()->startAsync(async_buffer_size, LockingStderrSink::DEFAULT_ASYNC_FLUSH_INTERVAL);
   for (Logger& logger : allLoggers()) {
     logger.logger_->set_level(static_cast<spdlog::level::level_enum>(log_level));
   }
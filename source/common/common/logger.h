@@ -1,8 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "envoy/thread/thread.h"
@@ -60,18 +65,97 @@ private:
 };
 
 /**
- * An optionally locking stderr logging sink.
+ * An optionally locking stderr logging sink. By default each message is written by the thread that
+ * logs it. In asynchronous mode, see startAsync(), log() only copies the message into a lock free
+ * ring buffer of the logging thread, and a background thread writes the messages of all of the
+ * threads in batches, taking the lock once per batch. A thread whose ring buffer is full drops its
+ * messages, which are counted and reported. Critical messages are always written synchronously,
+ * after the buffered ones, as they often precede an abort.
  */
 class LockingStderrSink : public spdlog::sinks::sink {
 public:
+  ~LockingStderrSink();
+
   void setLock(Thread::BasicLockable& lock) { lock_ = &lock; }
 
+  /**
+   * Switch to asynchronous mode. Does nothing if the sink is already asynchronous.
+   * @param buffer_size supplies the number of messages that the ring buffer of each logging thread
+   *        holds. 0 keeps the sink synchronous.
+   * @param flush_interval supplies how often the background thread writes the buffered messages.
+   */
+  void startAsync(uint32_t buffer_size, std::chrono::milliseconds flush_interval);
+
+  /**
+   * Write all of the buffered messages and switch back to synchronous mode. This must be called
+   * before the lock goes away.
+   */
+  void stopAsync();
+
+  /**
+   * @return the number of messages that were dropped because the ring buffer of the logging thread
+   *         was full.
+   */
+  uint64_t droppedMessages() const { return dropped_messages_; }
+
   // spdlog::sinks::sink
   void log(const spdlog::details::log_msg& msg) override;
   void flush() override;
 
+  static constexpr std::chrono::milliseconds DEFAULT_ASYNC_FLUSH_INTERVAL{10};
+
 private:
+  /**
+   * A single producer single consumer ring buffer of messages. The logging thread is the producer
+   * and only moves tail_, the consumer holds async_lock_ and only moves head_. A slot keeps the
+   * capacity of its string, so that logging does not allocate once the slots have grown.
+   */
+  struct RingBuffer {
+    RingBuffer(uint32_t size, uint64_t generation) : messages_(size), generation_(generation) {}
+
+    /**
+     * @return whether the message fit in the ring buffer.
+     */
+    bool push(const char* data, size_t size);
+
+    std::vector<std::string> messages_;
+    // The generation of the startAsync() call that the ring buffer belongs to.
+    const uint64_t generation_;
+    std::atomic<uint64_t> head_{};
+    std::atomic<uint64_t> tail_{};
+    // Set when the logging thread exits, the ring buffer is released once it is drained.
+    std::atomic<bool> thread_exited_{};
+  };
+
+  typedef std::shared_ptr<RingBuffer> RingBufferSharedPtr;
+
+  /**
+   * @return the ring buffer of the calling thread, registering one on first use. nullptr if the
+   *         sink stopped being asynchronous meanwhile.
+   */
+  RingBuffer* threadRingBuffer();
+  void flushThreadRoutine();
+  /**
+   * Write the buffered messages of all of the threads and report dropped messages. async_lock_
+   * must be held.
+   */
+  void writeBuffered();
+
   Thread::BasicLockable* lock_{};
+  std::atomic<bool> async_{};
+  std::atomic<uint64_t> dropped_messages_{};
+  // Set by each startAsync().
+  std::atomic<uint64_t> generation_{};
+  // Guards the following members. The lock free logging path only takes it to register a thread.
+  std::mutex async_lock_;
+  uint32_t buffer_size_{};
+  std::chrono::milliseconds flush_interval_{};
+  bool stopping_{};
+  uint64_t reported_dropped_messages_{};
+  std::vector<RingBufferSharedPtr> ring_buffers_;
+  std::condition_variable stop_cv_;
+  // The logger can't use Thread::Thread, as the thread library logs through assert.h.
+  std::thread flush_thread_;
 };
 
 /**
@@ -96,8 +180,11 @@ public:
 
   /**
    * Initialize the logging system from server options.
+   * @param async_buffer_size supplies the number of messages buffered per logging thread in
+   *        asynchronous mode, see LockingStderrSink::startAsync(). 0 logs synchronously.
    */
-  static void initialize(uint64_t log_level, Thread::BasicLockable& lock);
+  static void initialize(uint64_t log_level, Thread::BasicLockable& lock,
+                         uint32_t async_buffer_size = 0);
 
   /**
    * @return const std::vector<Logger>& the installed loggers.
@@ -171,6 +258,12 @@ protected:
  */
 #define ENVOY_LOG(LEVEL, ...) ENVOY_LOG_TO_LOGGER(ENVOY_LOGGER(), LEVEL, ##__VA_ARGS__)
 
+/**
+ * Convenience macro to check whether the class' logger logs at a level, so that the arguments of a
+ * log line are only built when they are used.
+ */
+#define ENVOY_LOG_ENABLED(LEVEL) (ENVOY_LOGGER().level() <= spdlog::level::LEVEL)
+
 /**
  * Convenience macro to log to the misc logger, which allows for logging without of direct access to
  * a logger.
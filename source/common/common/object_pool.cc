@@ -0,0 +1,66 @@
+#include "common/common/object_pool.h"
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+
+ObjectFreeList::~ObjectFreeList() {
+  for (SizeList& list : lists_) {
+    while (list.head_ != nullptr) {
+      Block* next = list.head_->next_;
+      ::operator delete(list.head_);
+      list.head_ = next;
+    }
+    list.count_ = 0;
+  }
+  // Objects of the thread that are destroyed after the free list go straight to the heap.
+  max_blocks_ = 0;
+}
+
+void* ObjectFreeList::allocate(size_t size) {
+  for (SizeList& list : lists_) {
+    if (list.size_ == size && list.head_ != nullptr) {
+      Block* block = list.head_;
+      list.head_ = block->next_;
+      list.count_--;
+      return block;
+    }
+  }
+  return ::operator new(size);
+}
+
+void ObjectFreeList::deallocate(void* block, size_t size) {
+  ASSERT(size >= sizeof(Block));
+  SizeList* free_slot = nullptr;
+  for (SizeList& list : lists_) {
+    if (list.size_ == size) {
+      free_slot = &list;
+      break;
+    }
+    if (list.size_ == 0 && free_slot == nullptr) {
+      free_slot = &list;
+    }
+  }
+
+  if (free_slot == nullptr || free_slot->count_ >= max_blocks_) {
+    ::operator delete(block);
+    return;
+  }
+
+  free_slot->size_ = size;
+  Block* head = static_cast<Block*>(block);
+  head->next_ = free_slot->head_;
+  free_slot->head_ = head;
+  free_slot->count_++;
+}
+
+uint32_t ObjectFreeList::freeBlocks(size_t size) const {
+  for (const SizeList& list : lists_) {
+    if (list.size_ == size) {
+      return list.count_;
+    }
+  }
+  return 0;
+}
+
+} // namespace Envoy
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "common/common/non_copyable.h"
+
+namespace Envoy {
+
+/**
+ * Free lists of memory blocks of up to NUM_SIZES distinct sizes. A deallocated block is kept for
+ * the next allocation of the same size, up to a maximum number of blocks per size, and is returned
+ * to the heap beyond that or when its size does not fit in one of the lists. Not thread safe.
+ */
+class ObjectFreeList : NonCopyable {
+public:
+  static const size_t NUM_SIZES = 4;
+
+  /**
+   * @param max_blocks supplies the maximum number of free blocks kept per size.
+   */
+  ObjectFreeList(uint32_t max_blocks) : max_blocks_(max_blocks) {}
+  ~ObjectFreeList();
+
+  /**
+   * Allocate a block, from the free list of its size if there is one.
+   * @param size supplies the size of the block.
+   * @return void* the block.
+   */
+  void* allocate(size_t size);
+
+  /**
+   * Deallocate a block that was allocated with allocate().
+   * @param block supplies the block.
+   * @param size supplies the size that the block was allocated with.
+   */
+  void deallocate(void* block, size_t size);
+
+  /**
+   * @param size supplies a block size.
+   * @return uint32_t the number of free blocks of that size.
+   */
+  uint32_t freeBlocks(size_t size) const;
+
+private:
+  struct Block {
+    Block* next_;
+  };
+
+  struct SizeList {
+    size_t size_;
+    Block* head_;
+    uint32_t count_;
+  };
+
+  uint32_t max_blocks_;
+  SizeList lists_[NUM_SIZES]{};
+};
+
+/**
+ * Mixin for classes whose instances are created and destroyed at a high rate, such as the streams
+ * and connections of a worker. Deleting an instance, typically from the deferred delete list of a
+ * dispatcher, keeps its memory in a free list of the deleting thread, where the next instance
+ * created on that thread picks it up without a round trip through the allocator. Derived classes
+ * of different sizes share the pool, up to ObjectFreeList::NUM_SIZES sizes. The memory kept is
+ * bounded by MaxFreeBlocks per size and thread, and is freed when the thread exits.
+ */
+template <class T, uint32_t MaxFreeBlocks = 1024> class PooledObject {
+public:
+  static void* operator new(size_t size) { return freeList().allocate(size); }
+  static void operator delete(void* block, size_t size) { freeList().deallocate(block, size); }
+
+  /**
+   * @return ObjectFreeList& the free list of T of the calling thread.
+   */
+  static ObjectFreeList& freeList() {
+    static thread_local ObjectFreeList free_list(MaxFreeBlocks);
+    return free_list;
+  }
+};
+
+} // namespace Envoy
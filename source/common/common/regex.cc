@@ -0,0 +1,54 @@
+#include "common/common/regex.h"
+
+#include "envoy/common/exception.h"
+
+#include "fmt/format.h"
+
+namespace Envoy {
+namespace Regex {
+
+namespace {
+re2::RE2::Options regexOptions() {
+  re2::RE2::Options options;
+  // Invalid expressions are reported via exception, don't also write them to stderr.
+  options.set_log_errors(false);
+  return options;
+}
+} // namespace
+
+Re2Matcher::Re2Matcher(const std::string& pattern) : regex_(pattern, regexOptions()) {
+  if (!regex_.ok()) {
+    throw EnvoyException(fmt::format("invalid regex '{}': {}", pattern, regex_.error()));
+  }
+}
+
+bool Re2Matcher::match(const char* begin, const char* end) const {
+  const re2::StringPiece input(begin, end - begin);
+  return regex_.Match(input, 0, input.size(), re2::RE2::ANCHOR_BOTH, nullptr, 0);
+}
+
+bool Re2Matcher::match(const std::string& value, std::vector<std::string>& captures) const {
+  const int groups = regex_.NumberOfCapturingGroups();
+  // Slot 0 receives the overall match.
+  std::vector<re2::StringPiece> pieces(groups + 1);
+  if (!regex_.Match(value, 0, value.size(), re2::RE2::ANCHOR_BOTH, pieces.data(), groups + 1)) {
+    return false;
+  }
+
+  captures.clear();
+  for (int i = 1; i <= groups; i++) {
+    captures.push_back(pieces[i].as_string());
+  }
+  return true;
+}
+
+bool Re2Matcher::search(const std::string& value) const {
+  return regex_.Match(value, 0, value.size(), re2::RE2::UNANCHORED, nullptr, 0);
+}
+
+CompiledMatcherPtr Utility::parseRegex(const std::string& pattern) {
+  return CompiledMatcherPtr{new Re2Matcher(pattern)};
+}
+
+} // namespace Regex
+} // namespace Envoy
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "envoy/common/regex.h"
+
+#include "re2/re2.h"
+
+namespace Envoy {
+namespace Regex {
+
+/**
+ * CompiledMatcher backed by RE2, which guarantees linear time matching and bounded stack usage.
+ */
+class Re2Matcher : public CompiledMatcher {
+public:
+  Re2Matcher(const std::string& pattern);
+
+  // Regex::CompiledMatcher
+  bool match(const std::string& value) const override {
+    return match(value.data(), value.data() + value.size());
+  }
+  bool match(const char* begin, const char* end) const override;
+  bool match(const std::string& value, std::vector<std::string>& captures) const override;
+  bool search(const std::string& value) const override;
+
+private:
+  const re2::RE2 regex_;
+};
+
+class Utility {
+public:
+  /**
+   * Compile a regular expression.
+   * @param pattern supplies the expression. The syntax is that of RE2, which is a large subset of
+   *        ECMAScript: back references and look-around assertions are not supported.
+   * @return CompiledMatcherPtr the compiled expression.
+   * @throw EnvoyException if the expression is invalid.
+   */
+  static CompiledMatcherPtr parseRegex(const std::string& pattern);
+};
+
+} // namespace Regex
+} // namespace Envoy
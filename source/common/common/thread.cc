@@ -1,6 +1,8 @@
 #include "common/common/thread.h"
 
 #ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
 #include <sys/syscall.h>
 #elif defined(__APPLE__)
 #include <pthread.h>
@@ -37,6 +39,21 @@ int32_t Thread::currentThreadId() {
 #endif
 }
 
+bool Thread::setCurrentThreadCpu(uint32_t cpu) {
+#ifdef __linux__
+  if (cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+#else
+  UNREFERENCED_PARAMETER(cpu);
+  return false;
+#endif
+}
+
 void Thread::join() {
   int rc = pthread_join(thread_id_, nullptr);
   RELEASE_ASSERT(rc == 0);
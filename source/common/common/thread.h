@@ -24,6 +24,13 @@ public:
    */
   static ThreadId currentThreadId();
 
+  /**
+   * Restrict the calling thread to run on a single CPU.
+   * @param cpu supplies the CPU number.
+   * @return bool whether the affinity was set. Always false on platforms without thread affinity.
+   */
+  static bool setCurrentThreadCpu(uint32_t cpu);
+
   /**
    * Join on thread exit.
    */
@@ -1,6 +1,34 @@
 #include "common/common/to_lower_table.h"
 
+#include <string.h>
+
 namespace Envoy {
+namespace {
+const uint64_t HIGH_BITS = 0x8080808080808080ULL;
+// Added to the low 7 bits of each byte, these carry into the high bit exactly when the byte is
+// above 'Z' and at or above 'A' respectively.
+const uint64_t ABOVE_Z = 0x2525252525252525ULL;
+const uint64_t FROM_A = 0x3f3f3f3f3f3f3f3fULL;
+
+/**
+ * Lower case the 8 bytes of a word at once. The sums carry into the high bit of each byte but
+ * never into the next byte, so every byte is converted on its own. Bytes with the high bit set
+ * are not ASCII and are left alone.
+ */
+uint64_t toLowerWord(uint64_t word) {
+  const uint64_t low_bits = word & ~HIGH_BITS;
+  const uint64_t upper = ((low_bits + FROM_A) ^ (low_bits + ABOVE_Z)) & ~word & HIGH_BITS;
+  // Move the high bit of each upper case byte onto its 0x20 bit.
+  return word | (upper >> 2);
+}
+
+uint64_t loadWord(const char* buffer) {
+  uint64_t word;
+  memcpy(&word, buffer, sizeof(word));
+  return word;
+}
+} // namespace
+
 ToLowerTable::ToLowerTable() {
   for (size_t c = 0; c < 256; c++) {
     table_[c] = c;
@@ -11,8 +39,33 @@ ToLowerTable::ToLowerTable() {
 }
 
 void ToLowerTable::toLowerCase(char* buffer, uint32_t size) const {
-  for (size_t i = 0; i < size; i++) {
+  // Convert a word at a time, which works on any target without vector instructions and leaves
+  // at most 7 bytes for the table. The loads and stores go through memcpy since the buffer need
+  // not be aligned.
+  uint32_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    const uint64_t word = toLowerWord(loadWord(buffer + i));
+    memcpy(buffer + i, &word, sizeof(word));
+  }
+
+  for (; i < size; i++) {
     buffer[i] = table_[static_cast<uint8_t>(buffer[i])];
   }
 }
+
+bool ToLowerTable::equalsIgnoreCase(const char* lhs, const char* rhs, uint32_t size) const {
+  uint32_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    if (toLowerWord(loadWord(lhs + i)) != toLowerWord(loadWord(rhs + i))) {
+      return false;
+    }
+  }
+
+  for (; i < size; i++) {
+    if (table_[static_cast<uint8_t>(lhs[i])] != table_[static_cast<uint8_t>(rhs[i])]) {
+      return false;
+    }
+  }
+  return true;
+}
 } // namespace Envoy
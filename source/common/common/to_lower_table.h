@@ -25,6 +25,22 @@ public:
    */
   void toLowerCase(std::string& string) const { toLowerCase(&string[0], string.size()); }
 
+  /**
+   * Compare two strings of the same size ignoring the case of ASCII letters.
+   * @param lhs supplies the start of the first string.
+   * @param rhs supplies the start of the second string.
+   * @param size supplies the size of both strings.
+   * @return bool whether the strings are equal once lower cased.
+   */
+  bool equalsIgnoreCase(const char* lhs, const char* rhs, uint32_t size) const;
+
+  /**
+   * Compare two strings ignoring the case of ASCII letters.
+   */
+  bool equalsIgnoreCase(const std::string& lhs, const std::string& rhs) const {
+    return lhs.size() == rhs.size() && equalsIgnoreCase(lhs.data(), rhs.data(), lhs.size());
+  }
+
 private:
   std::array<uint8_t, 256> table_;
 };
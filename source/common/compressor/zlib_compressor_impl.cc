@@ -0,0 +1,62 @@
+#include "common/compressor/zlib_compressor_impl.h"
+
+#include <cstdint>
+
+#include "envoy/common/exception.h"
+
+#include "common/buffer/buffer_impl.h"
+#include "common/common/assert.h"
+
+#include "fmt/format.h"
+
+namespace Envoy {
+namespace Compressor {
+
+ZlibCompressorImpl::ZlibCompressorImpl(int level, int window_bits, int memory_level)
+    : chunk_(new unsigned char[CHUNK_SIZE]) {
+  // Adding 16 to the window bits makes zlib write a gzip header and trailer.
+  const int result = deflateInit2(&zstream_, level, Z_DEFLATED, window_bits + 16, memory_level,
+                                  Z_DEFAULT_STRATEGY);
+  if (result != Z_OK) {
+    throw EnvoyException(fmt::format("zlib: unable to initialize the compressor: {}", result));
+  }
+}
+
+ZlibCompressorImpl::~ZlibCompressorImpl() { deflateEnd(&zstream_); }
+
+void ZlibCompressorImpl::compress(Buffer::Instance& buffer, bool end_stream) {
+  Buffer::OwnedImpl output;
+  const uint64_t num_slices = buffer.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  buffer.getRawSlices(slices, num_slices);
+  for (const Buffer::RawSlice& slice : slices) {
+    zstream_.next_in = static_cast<Bytef*>(slice.mem_);
+    zstream_.avail_in = slice.len_;
+    deflateInto(output, Z_NO_FLUSH);
+    ASSERT(zstream_.avail_in == 0);
+  }
+  deflateInto(output, end_stream ? Z_FINISH : Z_SYNC_FLUSH);
+
+  buffer.drain(buffer.length());
+  buffer.move(output);
+}
+
+void ZlibCompressorImpl::reset() {
+  const int result = deflateReset(&zstream_);
+  RELEASE_ASSERT(result == Z_OK);
+}
+
+void ZlibCompressorImpl::deflateInto(Buffer::Instance& output, int flush) {
+  // Deflate has consumed all the input and flushed as asked once it leaves output space unused.
+  do {
+    zstream_.next_out = chunk_.get();
+    zstream_.avail_out = CHUNK_SIZE;
+    const int result = deflate(&zstream_, flush);
+    // Z_BUF_ERROR only means that there was nothing to do.
+    RELEASE_ASSERT(result == Z_OK || result == Z_STREAM_END || result == Z_BUF_ERROR);
+    output.add(chunk_.get(), CHUNK_SIZE - zstream_.avail_out);
+  } while (zstream_.avail_out == 0);
+}
+
+} // namespace Compressor
+} // namespace Envoy
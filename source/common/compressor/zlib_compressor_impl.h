@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "envoy/buffer/buffer.h"
+#include "envoy/compressor/compressor.h"
+
+#include "common/common/non_copyable.h"
+
+#include "zlib.h"
+
+namespace Envoy {
+namespace Compressor {
+
+/**
+ * A gzip compressor on top of zlib's deflate. Resetting the compressor keeps the deflate state, so
+ * that a pooled compressor does not allocate for every stream.
+ */
+class ZlibCompressorImpl : public Compressor, NonCopyable {
+public:
+  /**
+   * @param level supplies the compression level, from 1 (fastest) to 9 (smallest).
+   * @param window_bits supplies the base two logarithm of the window size, from 9 to 15.
+   * @param memory_level supplies how much memory zlib uses for its state, from 1 to 9.
+   * An EnvoyException is thrown if zlib rejects the parameters.
+   */
+  ZlibCompressorImpl(int level, int window_bits, int memory_level);
+  ~ZlibCompressorImpl();
+
+  // Compressor::Compressor
+  void compress(Buffer::Instance& buffer, bool end_stream) override;
+  void reset() override;
+
+private:
+  void deflateInto(Buffer::Instance& output, int flush);
+
+  static const uint64_t CHUNK_SIZE = 4096;
+
+  z_stream zstream_{};
+  std::unique_ptr<unsigned char[]> chunk_;
+};
+
+} // namespace Compressor
+} // namespace Envoy
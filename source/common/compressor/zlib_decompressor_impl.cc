@@ -0,0 +1,81 @@
+#include "common/compressor/zlib_decompressor_impl.h"
+
+#include <cstdint>
+
+#include "envoy/common/exception.h"
+
+#include "common/buffer/buffer_impl.h"
+#include "common/common/assert.h"
+
+#include "fmt/format.h"
+
+namespace Envoy {
+namespace Compressor {
+
+ZlibDecompressorImpl::ZlibDecompressorImpl(int window_bits, uint64_t max_output_size)
+    : chunk_(new unsigned char[CHUNK_SIZE]), max_output_size_(max_output_size) {
+  // Adding 16 to the window bits makes zlib expect a gzip header and trailer.
+  const int result = inflateInit2(&zstream_, window_bits + 16);
+  if (result != Z_OK) {
+    throw EnvoyException(fmt::format("zlib: unable to initialize the decompressor: {}", result));
+  }
+}
+
+ZlibDecompressorImpl::~ZlibDecompressorImpl() { inflateEnd(&zstream_); }
+
+bool ZlibDecompressorImpl::decompress(Buffer::Instance& buffer) {
+  Buffer::OwnedImpl output;
+  const uint64_t num_slices = buffer.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  buffer.getRawSlices(slices, num_slices);
+  for (const Buffer::RawSlice& slice : slices) {
+    zstream_.next_in = static_cast<Bytef*>(slice.mem_);
+    zstream_.avail_in = slice.len_;
+    if (!inflateInto(output)) {
+      return false;
+    }
+  }
+
+  buffer.drain(buffer.length());
+  buffer.move(output);
+  return true;
+}
+
+void ZlibDecompressorImpl::reset() {
+  const int result = inflateReset(&zstream_);
+  RELEASE_ASSERT(result == Z_OK);
+  output_size_ = 0;
+  finished_ = false;
+}
+
+bool ZlibDecompressorImpl::inflateInto(Buffer::Instance& output) {
+  if (finished_) {
+    return zstream_.avail_in == 0;
+  }
+
+  // Inflate has consumed all the input it can once it leaves output space unused.
+  do {
+    zstream_.next_out = chunk_.get();
+    zstream_.avail_out = CHUNK_SIZE;
+    const int result = inflate(&zstream_, Z_NO_FLUSH);
+    // Z_BUF_ERROR only means that there was nothing to do.
+    if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+      return false;
+    }
+    const uint64_t inflated = CHUNK_SIZE - zstream_.avail_out;
+    // The limit is checked per chunk, so that a small input cannot make us allocate without bound.
+    if (inflated > max_output_size_ - output_size_) {
+      return false;
+    }
+    output_size_ += inflated;
+    output.add(chunk_.get(), inflated);
+    if (result == Z_STREAM_END) {
+      finished_ = true;
+      return zstream_.avail_in == 0;
+    }
+  } while (zstream_.avail_out == 0);
+  return true;
+}
+
+} // namespace Compressor
+} // namespace Envoy
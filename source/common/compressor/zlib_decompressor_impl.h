@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "envoy/buffer/buffer.h"
+#include "envoy/compressor/decompressor.h"
+
+#include "common/common/non_copyable.h"
+
+#include "zlib.h"
+
+namespace Envoy {
+namespace Compressor {
+
+/**
+ * A gzip decompressor on top of zlib's inflate. Resetting the decompressor keeps the inflate state,
+ * so that a long lived decompressor does not allocate for every stream.
+ */
+class ZlibDecompressorImpl : public Decompressor, NonCopyable {
+public:
+  /**
+   * @param window_bits supplies the base two logarithm of the largest window size accepted, from
+   * 8 to 15. An EnvoyException is thrown if zlib rejects it.
+   * @param max_output_size supplies the largest number of bytes that a stream may inflate to.
+   */
+  ZlibDecompressorImpl(int window_bits, uint64_t max_output_size);
+  ~ZlibDecompressorImpl();
+
+  // Compressor::Decompressor
+  bool decompress(Buffer::Instance& buffer) override;
+  bool finished() const override { return finished_; }
+  void reset() override;
+
+private:
+  bool inflateInto(Buffer::Instance& output);
+
+  static const uint64_t CHUNK_SIZE = 4096;
+
+  z_stream zstream_{};
+  std::unique_ptr<unsigned char[]> chunk_;
+  const uint64_t max_output_size_;
+  uint64_t output_size_{};
+  bool finished_{};
+};
+
+} // namespace Compressor
+} // namespace Envoy
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "envoy/config/subscription.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+
+#include "common/common/hash.h"
+#include "common/common/logger.h"
+#include "common/common/utility.h"
+#include "common/config/utility.h"
+#include "common/filesystem/filesystem_impl.h"
+#include "common/protobuf/protobuf.h"
+
+#include "api/discovery.pb.h"
+#include "fmt/format.h"
+
+namespace Envoy {
+namespace Config {
+
+/**
+ * Subscription decorator that writes the last accepted resources of a subscription to a file, and
+ * on start delivers the resources of that file, if any, before the wrapped subscription has
+ * fetched anything. A restarted server thus starts from its last configuration without waiting
+ * on the management server, and is brought up to date by the wrapped subscription as usual.
+ *
+ * The file holds a binary DiscoveryResponse. It is named after the resource type and the requested
+ * resource names, so each subscription of a server has its own file. Writes are delayed by
+ * WRITE_DELAY_MS, so that a burst of updates is written once, and go to a temporary file that is
+ * renamed over the previous one, so that a crash never leaves a partial file behind.
+ */
+template <class ResourceType>
+class CachedSubscriptionImpl : public Subscription<ResourceType>,
+                               SubscriptionCallbacks<ResourceType>,
+                               Logger::Loggable<Logger::Id::config> {
+public:
+  static const uint64_t WRITE_DELAY_MS = 1000;
+
+  CachedSubscriptionImpl(std::unique_ptr<Subscription<ResourceType>>&& subscription,
+                         Event::Dispatcher& dispatcher, const std::string& directory)
+      : subscription_(std::move(subscription)), directory_(directory),
+        write_timer_(dispatcher.createTimer([this]() -> void { writeCache(); })) {}
+
+  ~CachedSubscriptionImpl() {
+    if (!pending_write_.empty()) {
+      writeCache();
+    }
+  }
+
+  // Config::Subscription
+  void start(const std::vector<std::string>& resources,
+             SubscriptionCallbacks<ResourceType>& callbacks) override {
+    callbacks_ = &callbacks;
+    path_ = fmt::format("{}/{}.{:016x}.pb", directory_, ResourceType().GetDescriptor()->full_name(),
+                        HashUtil::xxHash64(StringUtil::join(resources, ",")));
+    loadCache();
+    subscription_->start(resources, *this);
+  }
+
+  void updateResources(const std::vector<std::string>& resources) override {
+    // The cache file stays the one of the resources the subscription was started with.
+    subscription_->updateResources(resources);
+  }
+
+  const std::string versionInfo() const override { return subscription_->versionInfo(); }
+
+  // Config::SubscriptionCallbacks
+  void onConfigUpdate(const typename SubscriptionCallbacks<ResourceType>::ResourceVector& resources)
+      override {
+    // A rejected update throws here, and so is not cached.
+    callbacks_->onConfigUpdate(resources);
+
+    envoy::api::v2::DiscoveryResponse message;
+    message.set_type_url(ResourceType().GetDescriptor()->full_name());
+    for (const auto& resource : resources) {
+      message.add_resources()->PackFrom(resource);
+    }
+    message.SerializeToString(&pending_write_);
+    write_timer_->enableTimer(std::chrono::milliseconds(WRITE_DELAY_MS));
+  }
+
+  void onConfigUpdateFailed(const EnvoyException* e) override {
+    callbacks_->onConfigUpdateFailed(e);
+  }
+
+private:
+  void loadCache() {
+    if (!Filesystem::fileExists(path_)) {
+      return;
+    }
+
+    try {
+      envoy::api::v2::DiscoveryResponse message;
+      if (!message.ParseFromString(Filesystem::fileReadToEnd(path_))) {
+        ENVOY_LOG(warn, "ignoring corrupt xDS cache file {}", path_);
+        return;
+      }
+      callbacks_->onConfigUpdate(Utility::getTypedResources<ResourceType>(message));
+      ENVOY_LOG(info, "started from {} cached resources in {}", message.resources_size(), path_);
+    } catch (const EnvoyException& e) {
+      // The subscription then waits for the management server, as it would without a cache.
+      ENVOY_LOG(warn, "cached xDS resources in {} rejected: {}", path_, e.what());
+    }
+  }
+
+  void writeCache() {
+    const std::string temporary_path = path_ + ".tmp";
+    {
+      std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+      file << pending_write_;
+      if (!file) {
+        ENVOY_LOG(warn, "unable to write xDS cache file {}", temporary_path);
+        pending_write_.clear();
+        return;
+      }
+    }
+
+    if (::rename(temporary_path.c_str(), path_.c_str()) != 0) {
+      ENVOY_LOG(warn, "unable to rename xDS cache file {} to {}", temporary_path, path_);
+    }
+    pending_write_.clear();
+  }
+
+  std::unique_ptr<Subscription<ResourceType>> subscription_;
+  const std::string directory_;
+  Event::TimerPtr write_timer_;
+  std::string path_;
+  std::string pending_write_;
+  SubscriptionCallbacks<ResourceType>* callbacks_{};
+};
+
+} // namespace Config
+} // namespace Envoy
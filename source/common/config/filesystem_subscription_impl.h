@@ -1,9 +1,14 @@
 #pragma once
 
+#include <chrono>
+#include <unordered_map>
+
 #include "envoy/config/subscription.h"
 #include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
 #include "envoy/filesystem/filesystem.h"
 
+#include "common/common/hash.h"
 #include "common/common/logger.h"
 #include "common/common/macros.h"
 #include "common/config/utility.h"
@@ -18,15 +23,25 @@ namespace Config {
 /**
  * Filesystem inotify implementation of the API Subscription interface. This allows the API to be
  * consumed on filesystem changes to files containing the JSON canonical representation of
- * lists of ResourceType.
+ * lists of ResourceType, or any other format that MessageUtil::loadFromFile() reads.
+ *
+ * Files that are moved into place in quick succession are read once, after the last move. Only
+ * the resources whose content changed since the last accepted update are unpacked, and an update
+ * whose version and resources are all unchanged is not delivered.
  */
 template <class ResourceType>
 class FilesystemSubscriptionImpl : public Config::Subscription<ResourceType>,
                                    Logger::Loggable<Logger::Id::config> {
 public:
+  /**
+   * @param debounce supplies how long the file must be left alone before it is read again.
+   */
   FilesystemSubscriptionImpl(Event::Dispatcher& dispatcher, const std::string& path,
-                             SubscriptionStats stats)
-      : path_(path), watcher_(dispatcher.createFilesystemWatcher()), stats_(stats) {}
+                             SubscriptionStats stats,
+                             std::chrono::milliseconds debounce = std::chrono::milliseconds(100))
+      : path_(path), watcher_(dispatcher.createFilesystemWatcher()),
+        refresh_timer_(dispatcher.createTimer([this]() -> void { refresh(); })),
+        debounce_(debounce), stats_(stats) {}
 
   // Config::Subscription
   void start(const std::vector<std::string>& resources,
@@ -36,7 +51,9 @@ public:
     callbacks_ = &callbacks;
     watcher_->addWatch(path_, Filesystem::Watcher::Events::MovedTo, [this](uint32_t events) {
       UNREFERENCED_PARAMETER(events);
-      refresh();
+      // Each move pushes the refresh back, so a file that is replaced again before it is read is
+      // only read and parsed once.
+      refresh_timer_->enableTimer(debounce_);
     });
     // Attempt to read in case there is a file there already.
     refresh();
@@ -59,18 +76,31 @@ private:
     try {
       envoy::api::v2::DiscoveryResponse message;
       MessageUtil::loadFromFile(path_, message);
-      const auto typed_resources = Config::Utility::getTypedResources<ResourceType>(message);
+      std::unordered_map<uint64_t, int> resource_indices;
+      Protobuf::RepeatedPtrField<ResourceType> typed_resources;
+      const bool changed = typedResources(message, typed_resources, resource_indices);
       config_update_available = true;
-      callbacks_->onConfigUpdate(typed_resources);
-      version_info_ = message.version_info();
+      if (!changed && accepted_ && message.version_info() == version_info_) {
+        ENVOY_LOG(debug, "Filesystem config for {} is unchanged", path_);
+      } else {
+        callbacks_->onConfigUpdate(typed_resources);
+        version_info_ = message.version_info();
+        accepted_ = true;
+        ENVOY_LOG(debug, "Filesystem config update accepted for {}: {}", path_,
+                  message.DebugString());
+      }
+      resources_.Swap(&typed_resources);
+      resource_indices_.swap(resource_indices);
       stats_.update_success_.inc();
-      ENVOY_LOG(debug, "Filesystem config update accepted for {}: {}", path_,
-                message.DebugString());
       // TODO(htuch): Add some notion of current version for every API in stats/admin.
     } catch (const EnvoyException& e) {
       if (config_update_available) {
         ENVOY_LOG(warn, "Filesystem config update rejected: {}", e.what());
         stats_.update_rejected_.inc();
+        // Some resources of the last accepted update may have been moved out, so all of them are
+        // unpacked again next time.
+        resources_.Clear();
+        resource_indices_.clear();
       } else {
         ENVOY_LOG(warn, "Filesystem config update failure: {}", e.what());
         stats_.update_failure_.inc();
@@ -79,11 +109,50 @@ private:
     }
   }
 
+  /**
+   * Unpack the resources of a response, moving those whose content is unchanged out of the last
+   * accepted update instead of unpacking them again.
+   * @param message supplies the response.
+   * @param typed_resources receives the unpacked resources.
+   * @param resource_indices receives the position of each resource by content hash.
+   * @return bool whether the resources differ from those of the last accepted update.
+   */
+  bool typedResources(const envoy::api::v2::DiscoveryResponse& message,
+                      Protobuf::RepeatedPtrField<ResourceType>& typed_resources,
+                      std::unordered_map<uint64_t, int>& resource_indices) {
+    bool changed = message.resources_size() != resources_.size();
+    typed_resources.Reserve(message.resources_size());
+    for (const auto& resource : message.resources()) {
+      const uint64_t hash =
+          HashUtil::xxHash64(resource.value(), HashUtil::xxHash64(resource.type_url()));
+      const int index = typed_resources.size();
+      auto* typed_resource = typed_resources.Add();
+      auto it = resource_indices_.find(hash);
+      if (it != resource_indices_.end()) {
+        typed_resource->Swap(resources_.Mutable(it->second));
+        changed |= it->second != index;
+        // A resource that appears twice is unpacked the second time.
+        resource_indices_.erase(it);
+      } else {
+        resource.UnpackTo(typed_resource);
+        changed = true;
+      }
+      resource_indices.emplace(hash, index);
+    }
+    return changed;
+  }
+
   const std::string path_;
   std::string version_info_;
+  bool accepted_{};
   std::unique_ptr<Filesystem::Watcher> watcher_;
+  Event::TimerPtr refresh_timer_;
+  const std::chrono::milliseconds debounce_;
   SubscriptionCallbacks<ResourceType>* callbacks_{};
   SubscriptionStats stats_;
+  // The resources of the last accepted update, and the position of each by content hash.
+  Protobuf::RepeatedPtrField<ResourceType> resources_;
+  std::unordered_map<uint64_t, int> resource_indices_;
 };
 
 } // namespace Config
@@ -1,5 +1,7 @@
 #include "common/config/grpc_mux_impl.h"
 
+#include <algorithm>
+
 #include "common/config/utility.h"
 #include "common/protobuf/protobuf.h"
 
@@ -25,7 +27,7 @@ GrpcMuxImpl::GrpcMuxImpl(const envoy::api::v2::Node& node,
                                                         envoy::api::v2::DiscoveryResponse>>(
                       new Grpc::AsyncClientImpl<envoy::api::v2::DiscoveryRequest,
                                                 envoy::api::v2::DiscoveryResponse>(
-                          cluster_manager, remote_cluster_name)),
+                          cluster_manager, remote_cluster_name, Grpc::CompressionAlgorithm::Gzip)),
                   dispatcher, service_method) {}
 
 GrpcMuxImpl::~GrpcMuxImpl() {
@@ -129,18 +131,26 @@ void GrpcMuxImpl::onReceiveMessage(std::unique_ptr<envoy::api::v2::DiscoveryResp
     return;
   }
   try {
-    // To avoid O(n^2) explosion (e.g. when we have 1000s of EDS watches), we
-    // build a map here from resource name to resource and then walk watches_.
-    // We have to walk all watches (and need an efficient map as a result) to
-    // ensure we deliver empty config updates when a resource is dropped.
-    std::unordered_map<std::string, ProtobufWkt::Any> resources;
     for (const auto& resource : message->resources()) {
       if (type_url != resource.type_url()) {
         throw EnvoyException(fmt::format("{} does not match {} type URL is DiscoveryResponse {}",
                                          resource.type_url(), type_url, message->DebugString()));
       }
-      const std::string resource_name = Utility::resourceName(resource);
-      resources.emplace(resource_name, resource);
+    }
+    // To avoid O(n^2) explosion (e.g. when we have 1000s of EDS watches), we
+    // build a map here from resource name to resource and then walk watches_.
+    // We have to walk all watches (and need an efficient map as a result) to
+    // ensure we deliver empty config updates when a resource is dropped. The map
+    // points into the message, and is only needed if a watch names its resources.
+    std::unordered_map<std::string, const ProtobufWkt::Any*> resources;
+    const bool named_watches =
+        std::any_of(watches_[type_url].begin(), watches_[type_url].end(),
+                    [](const GrpcMuxWatchImpl* watch) { return !watch->resources_.empty(); });
+    if (named_watches) {
+      resources.reserve(message->resources().size());
+      for (const auto& resource : message->resources()) {
+        resources.emplace(Utility::resourceName(resource), &resource);
+      }
     }
     for (auto watch : watches_[type_url]) {
       if (watch->resources_.empty()) {
@@ -151,7 +161,7 @@ void GrpcMuxImpl::onReceiveMessage(std::unique_ptr<envoy::api::v2::DiscoveryResp
       for (auto watched_resource_name : watch->resources_) {
         auto it = resources.find(watched_resource_name);
         if (it != resources.end()) {
-          found_resources.Add()->MergeFrom(it->second);
+          found_resources.Add()->CopyFrom(*it->second);
         }
       }
       watch->callbacks_.onConfigUpdate(found_resources, message->version_info());
@@ -47,16 +47,20 @@ public:
   // Config::GrpcMuxCallbacks
   void onConfigUpdate(const Protobuf::RepeatedPtrField<ProtobufWkt::Any>& resources,
                       const std::string& version_info) override {
+    // The resources are unpacked in place, rather than unpacked and then copied in.
     Protobuf::RepeatedPtrField<ResourceType> typed_resources;
-    std::transform(resources.cbegin(), resources.cend(),
-                   Protobuf::RepeatedPtrFieldBackInserter(&typed_resources),
-                   MessageUtil::anyConvert<ResourceType>);
+    typed_resources.Reserve(resources.size());
+    for (const auto& resource : resources) {
+      if (!resource.UnpackTo(typed_resources.Add())) {
+        throw EnvoyException("Unable to unpack " + resource.DebugString());
+      }
+    }
     callbacks_->onConfigUpdate(typed_resources);
     stats_.update_success_.inc();
     stats_.update_attempt_.inc();
     version_info_ = version_info;
     ENVOY_LOG(debug, "gRPC config for {} accepted with {} resources", type_url_, resources.size());
-    for (const auto resource : typed_resources) {
+    for (const auto& resource : typed_resources) {
       ENVOY_LOG(debug, "- {}", resource.DebugString());
     }
   }
@@ -22,8 +22,8 @@ public:
             std::unique_ptr<Grpc::AsyncClientImpl<envoy::api::v2::DiscoveryRequest,
                                                   envoy::api::v2::DiscoveryResponse>>(
                 new Grpc::AsyncClientImpl<envoy::api::v2::DiscoveryRequest,
-                                          envoy::api::v2::DiscoveryResponse>(cm,
-                                                                             remote_cluster_name)),
+                                          envoy::api::v2::DiscoveryResponse>(
+                    cm, remote_cluster_name, Grpc::CompressionAlgorithm::Gzip)),
             dispatcher, service_method, stats) {}
 
   GrpcSubscriptionImpl(const envoy::api::v2::Node& node,
@@ -1,5 +1,7 @@
 #include "common/config/metadata.h"
 
+#include <cstring>
+
 namespace Envoy {
 namespace Config {
 
@@ -23,5 +25,48 @@ ProtobufWkt::Value& Metadata::mutableMetadataValue(envoy::api::v2::Metadata& met
   return (*(*metadata.mutable_filter_metadata())[filter].mutable_fields())[key];
 }
 
+bool Metadata::subsetKey(const envoy::api::v2::Metadata& metadata, const std::string& filter,
+                         const std::vector<std::string>& keys, std::string& subset_key) {
+  const auto filter_it = metadata.filter_metadata().find(filter);
+  if (filter_it == metadata.filter_metadata().end()) {
+    return keys.empty();
+  }
+
+  // Each value is prefixed by its kind, and numbers are appended as their 8 bytes, so that keys do
+  // not depend on a number format and distinct values never build equal keys.
+  for (const std::string& key : keys) {
+    const auto fields_it = filter_it->second.fields().find(key);
+    if (fields_it == filter_it->second.fields().end()) {
+      return false;
+    }
+
+    subset_key.append(key);
+    subset_key.push_back('\0');
+    const ProtobufWkt::Value& value = fields_it->second;
+    switch (value.kind_case()) {
+    case ProtobufWkt::Value::kStringValue:
+      subset_key.push_back('s');
+      subset_key.append(value.string_value());
+      break;
+    case ProtobufWkt::Value::kNumberValue: {
+      const double number = value.number_value();
+      char bytes[sizeof(number)];
+      memcpy(bytes, &number, sizeof(number));
+      subset_key.push_back('n');
+      subset_key.append(bytes, sizeof(bytes));
+      break;
+    }
+    case ProtobufWkt::Value::kBoolValue:
+      subset_key.push_back(value.bool_value() ? 't' : 'f');
+      break;
+    default:
+      return false;
+    }
+    subset_key.push_back('\0');
+  }
+
+  return true;
+}
+
 } // namespace Config
 } // namespace Envoy
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "common/common/singleton.h"
 #include "common/protobuf/protobuf.h"
@@ -35,6 +36,20 @@ public:
   static ProtobufWkt::Value& mutableMetadataValue(envoy::api::v2::Metadata& metadata,
                                                   const std::string& filter,
                                                   const std::string& key);
+
+  /**
+   * Build a key that identifies the values of some keys for a given filter in Metadata, such that
+   * metadata with equal values for the keys has equal keys. Values are compared with their kind,
+   * so the string "1" does not equal the number 1.
+   * @param metadata reference.
+   * @param filter name.
+   * @param keys for filter metadata, sorted.
+   * @param subset_key supplies the string to append the key to.
+   * @return bool whether the metadata has a string, number or bool value for each of the keys.
+   *         subset_key is unspecified otherwise.
+   */
+  static bool subsetKey(const envoy::api::v2::Metadata& metadata, const std::string& filter,
+                        const std::vector<std::string>& keys, std::string& subset_key);
 };
 
 } // namespace Config
@@ -4,6 +4,7 @@
 
 #include "envoy/config/subscription.h"
 
+#include "common/config/cached_subscription_impl.h"
 #include "common/config/filesystem_subscription_impl.h"
 #include "common/config/grpc_mux_subscription_impl.h"
 #include "common/config/grpc_subscription_impl.h"
@@ -23,7 +24,8 @@ public:
    * @param config envoy::api::v2::ConfigSource to construct from.
    * @param node envoy::api::v2::Node identifier.
    * @param dispatcher event dispatcher.
-   * @param cm cluster manager for async clients (when REST/gRPC).
+   * @param cm cluster manager for async clients (when REST/gRPC), and the directory that
+   *        management server subscriptions are cached in, if any.
    * @param random random generator for jittering polling delays (when REST).
    * @param scope stats scope.
    * @param rest_legacy_constructor constructor function for Subscription adapters (when legacy v1
@@ -81,6 +83,11 @@ public:
     default:
       throw EnvoyException("Missing config source specifier in envoy::api::v2::ConfigSource");
     }
+    if (!cm.xdsCacheDirectory().empty() &&
+        config.config_source_specifier_case() != envoy::api::v2::ConfigSource::kPath) {
+      result.reset(new CachedSubscriptionImpl<ResourceType>(std::move(result), dispatcher,
+                                                            cm.xdsCacheDirectory()));
+    }
     return result;
   }
 };
@@ -11,6 +11,16 @@ void TlsContextJson::translateDownstreamTlsContext(
     envoy::api::v2::DownstreamTlsContext& downstream_tls_context) {
   translateCommonTlsContext(json_tls_context, *downstream_tls_context.mutable_common_tls_context());
   JSON_UTIL_SET_BOOL(json_tls_context, downstream_tls_context, require_client_certificate);
+  for (const std::string& path :
+       json_tls_context.getStringArray("session_ticket_key_paths", true)) {
+    downstream_tls_context.mutable_session_ticket_keys()->add_keys()->set_filename(path);
+  }
+  for (const Json::ObjectSharedPtr& certificate :
+       json_tls_context.getObjectArray("sni_certificates", true)) {
+    translateTlsCertificate(
+        *certificate,
+        *downstream_tls_context.mutable_common_tls_context()->mutable_tls_certificates()->Add());
+  }
 }
 
 void TlsContextJson::translateUpstreamTlsContext(
@@ -102,18 +102,88 @@ void Utility::translateLdsConfig(const Json::Object& json_lds,
                            *lds_config.mutable_api_config_source());
 }
 
+namespace {
+
+/**
+ * Read a top level string field out of a serialized message, skipping over the other fields
+ * rather than parsing them. If the field occurs more than once the last occurrence wins, as it
+ * does when parsing.
+ */
+std::string scanStringField(const std::string& serialized, int field_number,
+                            const std::string& type_url) {
+  Protobuf::io::CodedInputStream stream(reinterpret_cast<const uint8_t*>(serialized.data()),
+                                        serialized.size());
+  std::string value;
+  bool ok = true;
+  while (ok) {
+    const uint32_t tag = stream.ReadTag();
+    if (tag == 0) {
+      // Either the end of the message, or a malformed tag.
+      ok = stream.ConsumedEntireMessage();
+      break;
+    }
+    // See https://developers.google.com/protocol-buffers/docs/encoding#structure.
+    const uint32_t wire_type = tag & 0x7;
+    if (static_cast<int>(tag >> 3) == field_number && wire_type == 2) {
+      uint32_t length;
+      ok = stream.ReadVarint32(&length) && stream.ReadString(&value, length);
+      continue;
+    }
+    switch (wire_type) {
+    case 0: {
+      uint64_t varint;
+      ok = stream.ReadVarint64(&varint);
+      break;
+    }
+    case 1: {
+      uint64_t fixed64;
+      ok = stream.ReadLittleEndian64(&fixed64);
+      break;
+    }
+    case 2: {
+      uint32_t length;
+      ok = stream.ReadVarint32(&length) && stream.Skip(length);
+      break;
+    }
+    case 5: {
+      uint32_t fixed32;
+      ok = stream.ReadLittleEndian32(&fixed32);
+      break;
+    }
+    default:
+      // Groups are not used by the v2 API.
+      ok = false;
+    }
+  }
+  if (!ok) {
+    throw EnvoyException(fmt::format("Unable to unpack the name of a {} resource", type_url));
+  }
+  return value;
+}
+
+template <class ResourceType>
+std::string scanResourceName(const ProtobufWkt::Any& resource, const std::string& field_name) {
+  static const int field_number =
+      ResourceType::descriptor()->FindFieldByName(field_name)->number();
+  return scanStringField(resource.value(), field_number, resource.type_url());
+}
+
+} // namespace
+
 std::string Utility::resourceName(const ProtobufWkt::Any& resource) {
+  // Only the name is read, as the whole resource is parsed again by the subscription that
+  // receives it and resources such as ClusterLoadAssignment can be large.
   if (resource.type_url() == Config::TypeUrl::get().Listener) {
-    return MessageUtil::anyConvert<envoy::api::v2::Listener>(resource).name();
+    return scanResourceName<envoy::api::v2::Listener>(resource, "name");
   }
   if (resource.type_url() == Config::TypeUrl::get().RouteConfiguration) {
-    return MessageUtil::anyConvert<envoy::api::v2::RouteConfiguration>(resource).name();
+    return scanResourceName<envoy::api::v2::RouteConfiguration>(resource, "name");
   }
   if (resource.type_url() == Config::TypeUrl::get().Cluster) {
-    return MessageUtil::anyConvert<envoy::api::v2::Cluster>(resource).name();
+    return scanResourceName<envoy::api::v2::Cluster>(resource, "name");
   }
   if (resource.type_url() == Config::TypeUrl::get().ClusterLoadAssignment) {
-    return MessageUtil::anyConvert<envoy::api::v2::ClusterLoadAssignment>(resource).cluster_name();
+    return scanResourceName<envoy::api::v2::ClusterLoadAssignment>(resource, "cluster_name");
   }
   throw EnvoyException(
       fmt::format("Unknown type URL {} in DiscoveryResponse", resource.type_url()));
@@ -51,6 +51,7 @@ public:
   static Protobuf::RepeatedPtrField<ResourceType>
   getTypedResources(const envoy::api::v2::DiscoveryResponse& response) {
     Protobuf::RepeatedPtrField<ResourceType> typed_resources;
+    typed_resources.Reserve(response.resources().size());
     for (const auto& resource : response.resources()) {
       auto* typed_resource = typed_resources.Add();
       resource.UnpackTo(typed_resource);
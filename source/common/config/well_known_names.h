@@ -84,6 +84,8 @@ class HttpFilterNameValues {
 public:
   // Buffer filter
   const std::string BUFFER = "envoy.buffer";
+  // Cache filter
+  const std::string CACHE = "envoy.cache";
   // CORS filter
   const std::string CORS = "envoy.cors";
   // Dynamo filter
@@ -96,6 +98,8 @@ public:
   const std::string GRPC_JSON_TRANSCODER = "envoy.grpc_json_transcoder";
   // GRPC web filter
   const std::string GRPC_WEB = "envoy.grpc_web";
+  // Gzip filter
+  const std::string GZIP = "envoy.gzip";
   // IP tagging filter
   const std::string IP_TAGGING = "envoy.ip_tagging";
   // Rate limit filter
@@ -109,8 +113,9 @@ public:
   const V1Converter v1_converter_;
 
   HttpFilterNameValues()
-      : v1_converter_({BUFFER, CORS, DYNAMO, FAULT, GRPC_HTTP1_BRIDGE, GRPC_JSON_TRANSCODER,
-                       GRPC_WEB, HEALTH_CHECK, IP_TAGGING, RATE_LIMIT, ROUTER}) {}
+      : v1_converter_({BUFFER, CACHE, CORS, DYNAMO, FAULT, GRPC_HTTP1_BRIDGE,
+                       GRPC_JSON_TRANSCODER, GRPC_WEB, GZIP, HEALTH_CHECK, IP_TAGGING,
+                       RATE_LIMIT, ROUTER}) {}
 };
 
 typedef ConstSingleton<HttpFilterNameValues> HttpFilterNames;
@@ -135,6 +140,8 @@ class StatsSinkNameValues {
 public:
   // Statsd sink
   const std::string STATSD = "envoy.statsd";
+  // gRPC metrics service sink
+  const std::string METRICS_SERVICE = "envoy.metrics_service";
 };
 
 typedef ConstSingleton<StatsSinkNameValues> StatsSinkNames;
@@ -146,6 +153,8 @@ class AccessLogNameValues {
 public:
   // File access log
   const std::string FILE = "envoy.file_access_log";
+  // gRPC access log
+  const std::string GRPC = "envoy.grpc_access_log";
 };
 
 typedef ConstSingleton<AccessLogNameValues> AccessLogNames;
@@ -168,9 +177,24 @@ class MetadataEnvoyLbKeyValues {
 public:
   // Key in envoy.lb filter namespace for endpoint canary bool value.
   const std::string CANARY = "canary";
+  // Key in envoy.lb filter namespace for endpoint priority level number value.
+  const std::string PRIORITY = "priority";
+  // Key in envoy.lb filter namespace for endpoint locality weight number value.
+  const std::string LOCALITY_WEIGHT = "locality_weight";
 };
 
 typedef ConstSingleton<MetadataEnvoyLbKeyValues> MetadataEnvoyLbKeys;
 
+/**
+ * Keys for HttpFilterNames::ROUTER route metadata.
+ */
+class MetadataEnvoyRouterKeyValues {
+public:
+  // Key in envoy.router filter namespace for the route's per request buffer limit number value.
+  const std::string PER_REQUEST_BUFFER_LIMIT = "per_request_buffer_limit_bytes";
+};
+
+typedef ConstSingleton<MetadataEnvoyRouterKeyValues> MetadataEnvoyRouterKeys;
+
 } // namespace Config
 } // namespace Envoy
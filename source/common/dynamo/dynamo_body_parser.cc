@@ -0,0 +1,379 @@
+#include "common/dynamo/dynamo_body_parser.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Dynamo {
+
+namespace {
+
+bool isWhitespace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Letters are included so that a misspelled true/false/null ends up as one invalid literal.
+bool isLiteralChar(char c) {
+  return isDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '+' ||
+         c == '.';
+}
+
+int hexValue(char c) {
+  if (isDigit(c)) {
+    return c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  } else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+bool isNumber(const std::string& literal) {
+  size_t i = 0;
+  const size_t size = literal.size();
+  if (i < size && literal[i] == '-') {
+    i++;
+  }
+  if (i < size && literal[i] == '0') {
+    i++;
+  } else if (i < size && isDigit(literal[i])) {
+    while (i < size && isDigit(literal[i])) {
+      i++;
+    }
+  } else {
+    return false;
+  }
+  if (i < size && literal[i] == '.') {
+    i++;
+    if (i == size || !isDigit(literal[i])) {
+      return false;
+    }
+    while (i < size && isDigit(literal[i])) {
+      i++;
+    }
+  }
+  if (i < size && (literal[i] == 'e' || literal[i] == 'E')) {
+    i++;
+    if (i < size && (literal[i] == '+' || literal[i] == '-')) {
+      i++;
+    }
+    if (i == size || !isDigit(literal[i])) {
+      return false;
+    }
+    while (i < size && isDigit(literal[i])) {
+      i++;
+    }
+  }
+  return i == size;
+}
+
+} // namespace
+
+void BodyParser::parse(const Buffer::Instance& data) {
+  uint64_t num_slices = data.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  data.getRawSlices(slices, num_slices);
+  for (Buffer::RawSlice& slice : slices) {
+    parse(static_cast<const char*>(slice.mem_), slice.len_);
+  }
+}
+
+void BodyParser::parse(const char* data, uint64_t size) {
+  if (size > 0) {
+    empty_ = false;
+  }
+
+  for (uint64_t i = 0; i < size && state_ != State::Error; i++) {
+    if (state_ == State::String) {
+      // Skip over the plain characters of the strings that are not kept.
+      if (!capture_string_ && !escape_ && unicode_digits_ == 0) {
+        while (i < size && data[i] != '"' && data[i] != '\\' &&
+               static_cast<unsigned char>(data[i]) >= 0x20) {
+          i++;
+        }
+        if (i == size) {
+          break;
+        }
+      }
+      onStringChar(data[i]);
+      continue;
+    }
+
+    const char c = data[i];
+    if (state_ == State::Literal) {
+      if (isLiteralChar(c)) {
+        if (literal_.size() == MAX_LITERAL_SIZE) {
+          state_ = State::Error;
+        } else {
+          literal_.push_back(c);
+        }
+        continue;
+      }
+      // The character that ends the literal is handled below.
+      onEndLiteral();
+      if (state_ == State::Error) {
+        break;
+      }
+    }
+
+    if (isWhitespace(c)) {
+      continue;
+    }
+
+    switch (state_) {
+    case State::Value:
+      onValue(c);
+      break;
+    case State::FirstValueOrEnd:
+      if (c == ']') {
+        containers_.pop_back();
+        onEndValue();
+      } else {
+        onValue(c);
+      }
+      break;
+    case State::FirstKeyOrEnd:
+    case State::Key:
+      if (c == '"') {
+        onStartString(true, containers_.back().target_ != Target::None);
+      } else if (c == '}' && state_ == State::FirstKeyOrEnd) {
+        containers_.pop_back();
+        onEndValue();
+      } else {
+        state_ = State::Error;
+      }
+      break;
+    case State::Colon:
+      state_ = c == ':' ? State::Value : State::Error;
+      break;
+    case State::CommaOrEnd:
+      if (c == ',') {
+        state_ = containers_.back().object_ ? State::Key : State::Value;
+      } else if (c == (containers_.back().object_ ? '}' : ']')) {
+        containers_.pop_back();
+        onEndValue();
+      } else {
+        state_ = State::Error;
+      }
+      break;
+    case State::Done:
+      state_ = State::Error;
+      break;
+    case State::String:
+    case State::Literal:
+    case State::Error:
+      NOT_REACHED;
+    }
+  }
+}
+
+bool BodyParser::finish() {
+  // A number is only terminated by the end of the body when it is the whole body.
+  if (state_ == State::Literal) {
+    onEndLiteral();
+  }
+  return state_ == State::Done;
+}
+
+void BodyParser::onValue(char c) {
+  Target target = containers_.empty() ? Target::Top : value_target_;
+  value_target_ = Target::None;
+
+  switch (c) {
+  case '{':
+    if (target != Target::Top && target != Target::RequestItems &&
+        target != Target::UnprocessedKeys && target != Target::ConsumedCapacity &&
+        target != Target::Partitions) {
+      target = Target::None;
+    }
+    containers_.push_back({true, target});
+    state_ = State::FirstKeyOrEnd;
+    break;
+  case '[':
+    containers_.push_back({false, Target::None});
+    state_ = State::FirstValueOrEnd;
+    break;
+  case '"':
+    string_target_ = target;
+    onStartString(false, target == Target::TableName || target == Target::ErrorType);
+    break;
+  default:
+    if (!isLiteralChar(c)) {
+      state_ = State::Error;
+      break;
+    }
+    string_target_ = target;
+    literal_.assign(1, c);
+    state_ = State::Literal;
+    break;
+  }
+}
+
+void BodyParser::onEndValue() { state_ = containers_.empty() ? State::Done : State::CommaOrEnd; }
+
+void BodyParser::onStartString(bool key, bool capture) {
+  string_key_ = key;
+  capture_string_ = capture;
+  string_.clear();
+  state_ = State::String;
+}
+
+void BodyParser::onStringChar(char c) {
+  if (unicode_digits_ > 0) {
+    int value = hexValue(c);
+    if (value < 0) {
+      state_ = State::Error;
+      return;
+    }
+    unicode_value_ = unicode_value_ * 16 + value;
+    if (--unicode_digits_ > 0) {
+      return;
+    }
+
+    // Surrogate pairs are kept as two 3 byte sequences, which is good enough for stat names.
+    if (unicode_value_ < 0x80) {
+      appendToString(unicode_value_);
+    } else if (unicode_value_ < 0x800) {
+      appendToString(0xC0 | (unicode_value_ >> 6));
+      appendToString(0x80 | (unicode_value_ & 0x3F));
+    } else {
+      appendToString(0xE0 | (unicode_value_ >> 12));
+      appendToString(0x80 | ((unicode_value_ >> 6) & 0x3F));
+      appendToString(0x80 | (unicode_value_ & 0x3F));
+    }
+    return;
+  }
+
+  if (escape_) {
+    escape_ = false;
+    switch (c) {
+    case '"':
+    case '\\':
+    case '/':
+      appendToString(c);
+      break;
+    case 'b':
+      appendToString('\b');
+      break;
+    case 'f':
+      appendToString('\f');
+      break;
+    case 'n':
+      appendToString('\n');
+      break;
+    case 'r':
+      appendToString('\r');
+      break;
+    case 't':
+      appendToString('\t');
+      break;
+    case 'u':
+      unicode_digits_ = 4;
+      unicode_value_ = 0;
+      break;
+    default:
+      state_ = State::Error;
+      break;
+    }
+    return;
+  }
+
+  if (c == '"') {
+    onEndString();
+  } else if (c == '\\') {
+    escape_ = true;
+  } else if (static_cast<unsigned char>(c) < 0x20) {
+    state_ = State::Error;
+  } else {
+    appendToString(c);
+  }
+}
+
+void BodyParser::appendToString(char c) {
+  if (!capture_string_) {
+    return;
+  }
+  if (string_.size() == MAX_STRING_SIZE) {
+    capture_string_ = false;
+    string_.clear();
+    return;
+  }
+  string_.push_back(c);
+}
+
+void BodyParser::onEndString() {
+  if (string_key_) {
+    onEndKey();
+    return;
+  }
+
+  if (capture_string_) {
+    // Like a json document lookup, the first of duplicate keys is used.
+    if (string_target_ == Target::TableName && table_name_.empty()) {
+      table_name_ = string_;
+    } else if (string_target_ == Target::ErrorType && error_type_.empty()) {
+      error_type_ = string_;
+    }
+  }
+  onEndValue();
+}
+
+void BodyParser::onEndKey() {
+  state_ = State::Colon;
+  if (!capture_string_) {
+    return;
+  }
+
+  switch (containers_.back().target_) {
+  case Target::Top:
+    if (string_ == "TableName") {
+      value_target_ = Target::TableName;
+    } else if (string_ == "__type") {
+      value_target_ = Target::ErrorType;
+    } else if (string_ == "RequestItems") {
+      value_target_ = Target::RequestItems;
+    } else if (string_ == "UnprocessedKeys") {
+      value_target_ = Target::UnprocessedKeys;
+    } else if (string_ == "ConsumedCapacity") {
+      value_target_ = Target::ConsumedCapacity;
+    }
+    break;
+  case Target::RequestItems:
+    request_items_.push_back(string_);
+    break;
+  case Target::UnprocessedKeys:
+    unprocessed_keys_.push_back(string_);
+    break;
+  case Target::ConsumedCapacity:
+    if (string_ == "Partitions") {
+      value_target_ = Target::Partitions;
+    }
+    break;
+  case Target::Partitions:
+    partition_ = string_;
+    value_target_ = Target::PartitionCapacity;
+    break;
+  default:
+    break;
+  }
+}
+
+void BodyParser::onEndLiteral() {
+  if (literal_ == "true" || literal_ == "false" || literal_ == "null") {
+    onEndValue();
+  } else if (isNumber(literal_)) {
+    if (string_target_ == Target::PartitionCapacity) {
+      partitions_.emplace_back(partition_, std::strtod(literal_.c_str(), nullptr));
+    }
+    onEndValue();
+  } else {
+    state_ = State::Error;
+  }
+}
+
+} // namespace Dynamo
+} // namespace Envoy
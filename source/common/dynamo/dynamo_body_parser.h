@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "envoy/buffer/buffer.h"
+
+namespace Envoy {
+namespace Dynamo {
+
+/**
+ * Incremental parser for dynamodb request/response json bodies. The body is parsed as it is
+ * proxied, and only the few values that the filter uses are kept, so that the body never needs to
+ * be buffered or loaded into a json document. The rest of the body is only checked to be valid
+ * json.
+ *
+ * Basic dynamodb json request/response format:
+ * http://docs.aws.amazon.com/amazondynamodb/latest/developerguide/Appendix.CurrentAPI.html
+ */
+class BodyParser {
+public:
+  /**
+   * Parse the next part of the body.
+   * @param data supplies the data, which is not modified.
+   */
+  void parse(const Buffer::Instance& data);
+  void parse(const char* data, uint64_t size);
+
+  /**
+   * To be called once the whole body was parsed.
+   * @return bool whether the body was valid json.
+   */
+  bool finish();
+
+  /**
+   * @return bool whether no data was parsed.
+   */
+  bool empty() const { return empty_; }
+
+  /**
+   * @return const std::string& the top level "TableName" string, or empty if there is none.
+   */
+  const std::string& tableName() const { return table_name_; }
+
+  /**
+   * @return const std::vector<std::string>& the keys of the top level "RequestItems" object.
+   */
+  const std::vector<std::string>& requestItems() const { return request_items_; }
+
+  /**
+   * @return const std::string& the top level "__type" string, or empty if there is none.
+   */
+  const std::string& errorType() const { return error_type_; }
+
+  /**
+   * @return const std::vector<std::string>& the keys of the top level "UnprocessedKeys" object.
+   */
+  const std::vector<std::string>& unprocessedKeys() const { return unprocessed_keys_; }
+
+  /**
+   * @return const std::vector<std::pair<std::string, double>>& the keys and number values of the
+   *         "ConsumedCapacity": {"Partitions": {...}} object.
+   */
+  const std::vector<std::pair<std::string, double>>& partitions() const { return partitions_; }
+
+private:
+  enum class State {
+    Value,
+    FirstValueOrEnd,
+    FirstKeyOrEnd,
+    Key,
+    Colon,
+    CommaOrEnd,
+    String,
+    Literal,
+    Done,
+    Error
+  };
+
+  // What a value or the values of an object are, as far as the extracted values are concerned.
+  enum class Target {
+    None,
+    Top,
+    TableName,
+    ErrorType,
+    RequestItems,
+    UnprocessedKeys,
+    ConsumedCapacity,
+    Partitions,
+    PartitionCapacity
+  };
+
+  struct Container {
+    bool object_;
+    Target target_;
+  };
+
+  // Longer strings and literals are not kept, so that the memory use is bounded.
+  static const size_t MAX_STRING_SIZE = 1024;
+  static const size_t MAX_LITERAL_SIZE = 64;
+
+  void onValue(char c);
+  void onEndValue();
+  void onStartString(bool key, bool capture);
+  void onStringChar(char c);
+  void onEndString();
+  void onEndKey();
+  void onEndLiteral();
+  void appendToString(char c);
+
+  State state_{State::Value};
+  std::vector<Container> containers_;
+  // The target of the next value, as set by its key.
+  Target value_target_{Target::None};
+  std::string string_;
+  Target string_target_{Target::None};
+  bool string_key_{};
+  bool capture_string_{};
+  bool escape_{};
+  uint32_t unicode_digits_{};
+  uint32_t unicode_value_{};
+  std::string literal_;
+  std::string partition_;
+  bool empty_{true};
+
+  std::string table_name_;
+  std::vector<std::string> request_items_;
+  std::string error_type_;
+  std::vector<std::string> unprocessed_keys_;
+  std::vector<std::pair<std::string, double>> partitions_;
+};
+
+} // namespace Dynamo
+} // namespace Envoy
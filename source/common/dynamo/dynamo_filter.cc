@@ -5,20 +5,88 @@
 #include <string>
 #include <vector>
 
-#include "common/buffer/buffer_impl.h"
 #include "common/common/assert.h"
+#include "common/dynamo/dynamo_body_parser.h"
 #include "common/dynamo/dynamo_request_parser.h"
 #include "common/dynamo/dynamo_utility.h"
 #include "common/http/codes.h"
 #include "common/http/exception.h"
 #include "common/http/utility.h"
-#include "common/json/json_loader.h"
 
 #include "fmt/format.h"
 
 namespace Envoy {
 namespace Dynamo {
 
+const uint64_t DynamoStatsCache::DEFAULT_MAX_ENTITIES;
+
+DynamoStatsCache::EntityStats::EntityStats(const std::string& name_prefix, Stats::Scope& scope)
+    : name_prefix_(name_prefix),
+      upstream_rq_total_(scope.counter(name_prefix + "upstream_rq_total")),
+      upstream_rq_time_(name_prefix + "upstream_rq_time") {}
+
+DynamoStatsCache::DynamoStatsCache(const std::string& stat_prefix, Stats::Scope& scope,
+                                   uint64_t max_entities)
+    : prefix_(stat_prefix + "dynamodb."), scope_(scope), max_entities_(max_entities) {}
+
+DynamoStatsCache::EntityStats&
+DynamoStatsCache::entity(EntityMap& entities, const char* entity_type, const std::string& name) {
+  auto it = entities.find(name);
+  if (it != entities.end()) {
+    return *it->second;
+  }
+
+  if (entities.size() >= max_entities_) {
+    entities.clear();
+  }
+  EntityStats* stats = new EntityStats(prefix_ + entity_type + name + ".", scope_);
+  entities.emplace(name, std::unique_ptr<EntityStats>{stats});
+  return *stats;
+}
+
+DynamoStatsCache::StatusStats& DynamoStatsCache::status(EntityStats& entity, uint64_t status) {
+  auto it = entity.statuses_.find(status);
+  if (it != entity.statuses_.end()) {
+    return it->second;
+  }
+
+  const std::string group_string =
+      Http::CodeUtility::groupStringForResponseCode(static_cast<Http::Code>(status));
+  const std::string status_string = std::to_string(status);
+  StatusStats stats{scope_.counter(entity.name_prefix_ + "upstream_rq_total_" + group_string),
+                    scope_.counter(entity.name_prefix_ + "upstream_rq_total_" + status_string),
+                    entity.name_prefix_ + "upstream_rq_time_" + group_string,
+                    entity.name_prefix_ + "upstream_rq_time_" + status_string};
+  return entity.statuses_.emplace(status, std::move(stats)).first->second;
+}
+
+Stats::Counter& DynamoStatsCache::partitionCapacity(const std::string& table,
+                                                    const std::string& operation,
+                                                    const std::string& partition_id) {
+  std::unordered_map<std::string, Stats::Counter*>& partitions =
+      this->table(table).partitions_[operation];
+  auto it = partitions.find(partition_id);
+  if (it != partitions.end()) {
+    return *it->second;
+  }
+
+  if (partitions.size() >= max_entities_) {
+    partitions.clear();
+  }
+  Stats::Counter& counter =
+      scope_.counter(Utility::buildPartitionStatString(prefix_, table, operation, partition_id));
+  partitions.emplace(partition_id, &counter);
+  return counter;
+}
+
+DynamoFilterConfig::DynamoFilterConfig(const std::string& stat_prefix, Stats::Scope& scope,
+                                       ThreadLocal::SlotAllocator& tls)
+    : tls_(tls.allocateSlot()) {
+  tls_->set([stat_prefix, &scope](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return ThreadLocal::ThreadLocalObjectSharedPtr{new DynamoStatsCache(stat_prefix, scope)};
+  });
+}
+
 Http::FilterHeadersStatus DynamoFilter::decodeHeaders(Http::HeaderMap& headers, bool) {
   if (enabled_) {
     start_decode_ = std::chrono::steady_clock::now();
@@ -29,61 +97,55 @@ Http::FilterHeadersStatus DynamoFilter::decodeHeaders(Http::HeaderMap& headers,
 }
 
 Http::FilterDataStatus DynamoFilter::decodeData(Buffer::Instance& data, bool end_stream) {
-  if (enabled_ && end_stream) {
-    onDecodeComplete(data);
+  if (enabled_) {
+    // The body is parsed as it goes through, so that it does not need to be buffered.
+    request_body_.parse(data);
+    if (end_stream) {
+      onDecodeComplete();
+    }
   }
 
-  if (end_stream) {
-    return Http::FilterDataStatus::Continue;
-  } else {
-    // Buffer until the complete request has been processed.
-    return Http::FilterDataStatus::StopIterationAndBuffer;
-  }
+  return Http::FilterDataStatus::Continue;
 }
 
 Http::FilterTrailersStatus DynamoFilter::decodeTrailers(Http::HeaderMap&) {
   if (enabled_) {
-    Buffer::OwnedImpl empty;
-    onDecodeComplete(empty);
+    onDecodeComplete();
   }
 
   return Http::FilterTrailersStatus::Continue;
 }
 
-void DynamoFilter::onDecodeComplete(const Buffer::Instance& data) {
-  std::string body = buildBody(decoder_callbacks_->decodingBuffer(), data);
-  if (!body.empty()) {
-    try {
-      Json::ObjectSharedPtr json_body = Json::Factory::loadFromString(body);
-      table_descriptor_ = RequestParser::parseTable(operation_, *json_body);
-    } catch (const Json::Exception& jsonEx) {
+void DynamoFilter::onDecodeComplete() {
+  if (!request_body_.empty()) {
+    if (request_body_.finish()) {
+      table_descriptor_ = RequestParser::parseTable(operation_, request_body_);
+    } else {
       // Body parsing failed. This should not happen, just put a stat for that.
       scope_.counter(fmt::format("{}invalid_req_body", stat_prefix_)).inc();
     }
   }
 }
 
-void DynamoFilter::onEncodeComplete(const Buffer::Instance& data) {
+void DynamoFilter::onEncodeComplete() {
   ASSERT(enabled_);
   uint64_t status = Http::Utility::getResponseStatus(*response_headers_);
   chargeBasicStats(status);
 
-  std::string body = buildBody(encoder_callbacks_->encodingBuffer(), data);
-  if (!body.empty()) {
-    try {
-      Json::ObjectSharedPtr json_body = Json::Factory::loadFromString(body);
-      chargeTablePartitionIdStats(*json_body);
+  if (!response_body_.empty()) {
+    if (response_body_.finish()) {
+      chargeTablePartitionIdStats(response_body_);
 
       if (Http::CodeUtility::is4xx(status)) {
-        chargeFailureSpecificStats(*json_body);
+        chargeFailureSpecificStats(response_body_);
       }
       // Batch Operations will always return status 200 for a partial or full success. Check
       // unprocessed keys to determine partial success.
       // http://docs.aws.amazon.com/amazondynamodb/latest/developerguide/Programming.Errors.html#Programming.Errors.BatchOperations
       if (RequestParser::isBatchOperation(operation_)) {
-        chargeUnProcessedKeysStats(*json_body);
+        chargeUnProcessedKeysStats(response_body_);
       }
-    } catch (const Json::Exception&) {
+    } else {
       // Body parsing failed. This should not happen, just put a stat for that.
       scope_.counter(fmt::format("{}invalid_resp_body", stat_prefix_)).inc();
     }
@@ -95,8 +157,7 @@ Http::FilterHeadersStatus DynamoFilter::encodeHeaders(Http::HeaderMap& headers,
     response_headers_ = &headers;
 
     if (end_stream) {
-      Buffer::OwnedImpl empty;
-      onEncodeComplete(empty);
+      onEncodeComplete();
     }
   }
 
@@ -104,58 +165,33 @@ Http::FilterHeadersStatus DynamoFilter::encodeHeaders(Http::HeaderMap& headers,
 }
 
 Http::FilterDataStatus DynamoFilter::encodeData(Buffer::Instance& data, bool end_stream) {
-  if (enabled_ && end_stream) {
-    onEncodeComplete(data);
+  if (enabled_) {
+    response_body_.parse(data);
+    if (end_stream) {
+      onEncodeComplete();
+    }
   }
 
-  if (end_stream) {
-    return Http::FilterDataStatus::Continue;
-  } else {
-    // Buffer until the complete response has been processed.
-    return Http::FilterDataStatus::StopIterationAndBuffer;
-  }
+  return Http::FilterDataStatus::Continue;
 }
 
 Http::FilterTrailersStatus DynamoFilter::encodeTrailers(Http::HeaderMap&) {
   if (enabled_) {
-    Buffer::OwnedImpl empty;
-    onEncodeComplete(empty);
+    onEncodeComplete();
   }
 
   return Http::FilterTrailersStatus::Continue;
 }
 
-std::string DynamoFilter::buildBody(const Buffer::Instance* buffered,
-                                    const Buffer::Instance& last) {
-  std::string body;
-  if (buffered) {
-    uint64_t num_slices = buffered->getRawSlices(nullptr, 0);
-    Buffer::RawSlice slices[num_slices];
-    buffered->getRawSlices(slices, num_slices);
-    for (Buffer::RawSlice& slice : slices) {
-      body.append(static_cast<const char*>(slice.mem_), slice.len_);
-    }
-  }
-
-  uint64_t num_slices = last.getRawSlices(nullptr, 0);
-  Buffer::RawSlice slices[num_slices];
-  last.getRawSlices(slices, num_slices);
-  for (Buffer::RawSlice& slice : slices) {
-    body.append(static_cast<const char*>(slice.mem_), slice.len_);
-  }
-
-  return body;
-}
-
 void DynamoFilter::chargeBasicStats(uint64_t status) {
   if (!operation_.empty()) {
-    chargeStatsPerEntity(operation_, "operation", status);
+    chargeStatsPerEntity(stats_.operation(operation_), status);
   } else {
     scope_.counter(fmt::format("{}operation_missing", stat_prefix_)).inc();
   }
 
   if (!table_descriptor_.table_name.empty()) {
-    chargeStatsPerEntity(table_descriptor_.table_name, "table", status);
+    chargeStatsPerEntity(stats_.table(table_descriptor_.table_name), status);
   } else if (table_descriptor_.is_single_table) {
     scope_.counter(fmt::format("{}table_missing", stat_prefix_)).inc();
   } else {
@@ -163,38 +199,24 @@ void DynamoFilter::chargeBasicStats(uint64_t status) {
   }
 }
 
-void DynamoFilter::chargeStatsPerEntity(const std::string& entity, const std::string& entity_type,
-                                        uint64_t status) {
+void DynamoFilter::chargeStatsPerEntity(DynamoStatsCache::EntityStats& entity, uint64_t status) {
   std::chrono::milliseconds latency = std::chrono::duration_cast<std::chrono::milliseconds>(
       std::chrono::steady_clock::now() - start_decode_);
 
-  std::string group_string =
-      Http::CodeUtility::groupStringForResponseCode(static_cast<Http::Code>(status));
+  DynamoStatsCache::StatusStats& status_stats = stats_.status(entity, status);
+  entity.upstream_rq_total_.inc();
+  status_stats.upstream_rq_total_group_.inc();
+  status_stats.upstream_rq_total_status_.inc();
+
+  scope_.deliverTimingToSinks(entity.upstream_rq_time_, latency);
+  scope_.deliverTimingToSinks(status_stats.upstream_rq_time_group_, latency);
+  scope_.deliverTimingToSinks(status_stats.upstream_rq_time_status_, latency);
+}
 
-  scope_.counter(fmt::format("{}{}.{}.upstream_rq_total", stat_prefix_, entity_type, entity)).inc();
-  scope_
-      .counter(fmt::format("{}{}.{}.upstream_rq_total_{}", stat_prefix_, entity_type, entity,
-                           group_string))
-      .inc();
-  scope_
-      .counter(fmt::format("{}{}.{}.upstream_rq_total_{}", stat_prefix_, entity_type, entity,
-                           std::to_string(status)))
-      .inc();
-
-  scope_.deliverTimingToSinks(
-      fmt::format("{}{}.{}.upstream_rq_time", stat_prefix_, entity_type, entity), latency);
-  scope_.deliverTimingToSinks(
-      fmt::format("{}{}.{}.upstream_rq_time_{}", stat_prefix_, entity_type, entity, group_string),
-      latency);
-  scope_.deliverTimingToSinks(fmt::format("{}{}.{}.upstream_rq_time_{}", stat_prefix_, entity_type,
-                                          entity, std::to_string(status)),
-                              latency);
-}
-
-void DynamoFilter::chargeUnProcessedKeysStats(const Json::Object& json_body) {
+void DynamoFilter::chargeUnProcessedKeysStats(const BodyParser& body) {
   // The unprocessed keys block contains a list of tables and keys for that table that did not
   // complete apart of the batch operation. Only the table names will be logged for errors.
-  std::vector<std::string> unprocessed_tables = RequestParser::parseBatchUnProcessedKeys(json_body);
+  std::vector<std::string> unprocessed_tables = RequestParser::parseBatchUnProcessedKeys(body);
   for (const std::string& unprocessed_table : unprocessed_tables) {
     scope_
         .counter(
@@ -203,8 +225,8 @@ void DynamoFilter::chargeUnProcessedKeysStats(const Json::Object& json_body) {
   }
 }
 
-void DynamoFilter::chargeFailureSpecificStats(const Json::Object& json_body) {
-  std::string error_type = RequestParser::parseErrorType(json_body);
+void DynamoFilter::chargeFailureSpecificStats(const BodyParser& body) {
+  std::string error_type = RequestParser::parseErrorType(body);
 
   if (!error_type.empty()) {
     if (table_descriptor_.table_name.empty()) {
@@ -220,17 +242,16 @@ void DynamoFilter::chargeFailureSpecificStats(const Json::Object& json_body) {
   }
 }
 
-void DynamoFilter::chargeTablePartitionIdStats(const Json::Object& json_body) {
+void DynamoFilter::chargeTablePartitionIdStats(const BodyParser& body) {
   if (table_descriptor_.table_name.empty() || operation_.empty()) {
     return;
   }
 
   std::vector<RequestParser::PartitionDescriptor> partitions =
-      RequestParser::parsePartitions(json_body);
+      RequestParser::parsePartitions(body);
   for (const RequestParser::PartitionDescriptor& partition : partitions) {
-    std::string scope_string = Utility::buildPartitionStatString(
-        stat_prefix_, table_descriptor_.table_name, operation_, partition.partition_id_);
-    scope_.counter(scope_string).add(partition.capacity_);
+    stats_.partitionCapacity(table_descriptor_.table_name, operation_, partition.partition_id_)
+        .add(partition.capacity_);
   }
 }
 
@@ -1,18 +1,121 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <unordered_map>
 
 #include "envoy/http/filter.h"
 #include "envoy/runtime/runtime.h"
 #include "envoy/stats/stats.h"
+#include "envoy/thread_local/thread_local.h"
 
+#include "common/dynamo/dynamo_body_parser.h"
 #include "common/dynamo/dynamo_request_parser.h"
-#include "common/json/json_loader.h"
 
 namespace Envoy {
 namespace Dynamo {
 
+/**
+ * The per table and per operation stats of a worker, which are looked up in the scope the first
+ * time that the worker charges them and then kept, so that charging them does not build their
+ * names again. Table names come from the requests, so each map is cleared once it holds
+ * max_entities entries. Every worker has its own cache, so the cache is not locked.
+ */
+class DynamoStatsCache : public ThreadLocal::ThreadLocalObject {
+public:
+  /**
+   * The stats of the requests for a table or an operation that got a response status.
+   */
+  struct StatusStats {
+    Stats::Counter& upstream_rq_total_group_;
+    Stats::Counter& upstream_rq_total_status_;
+    const std::string upstream_rq_time_group_;
+    const std::string upstream_rq_time_status_;
+  };
+
+  /**
+   * The stats of the requests for a table or an operation.
+   */
+  struct EntityStats {
+    EntityStats(const std::string& name_prefix, Stats::Scope& scope);
+
+    // The name of each stat up to the stat itself, e.g. "<prefix>dynamodb.table.<table>."
+    const std::string name_prefix_;
+    Stats::Counter& upstream_rq_total_;
+    const std::string upstream_rq_time_;
+    std::unordered_map<uint64_t, StatusStats> statuses_;
+    // The partition capacity counters of a table by operation and partition id.
+    std::unordered_map<std::string, std::unordered_map<std::string, Stats::Counter*>>
+        partitions_;
+  };
+
+  static const uint64_t DEFAULT_MAX_ENTITIES = 1024;
+
+  DynamoStatsCache(const std::string& stat_prefix, Stats::Scope& scope,
+                   uint64_t max_entities = DEFAULT_MAX_ENTITIES);
+
+  /**
+   * @return const std::string& the prefix of all of the stats of the filter.
+   */
+  const std::string& prefix() const { return prefix_; }
+
+  /**
+   * @return Stats::Scope& the scope of all of the stats of the filter.
+   */
+  Stats::Scope& scope() { return scope_; }
+
+  /**
+   * @return EntityStats& the stats of a table.
+   */
+  EntityStats& table(const std::string& table) { return entity(tables_, "table.", table); }
+
+  /**
+   * @return EntityStats& the stats of an operation.
+   */
+  EntityStats& operation(const std::string& operation) {
+    return entity(operations_, "operation.", operation);
+  }
+
+  /**
+   * @return StatusStats& the stats of the requests for a table or an operation that got status.
+   */
+  StatusStats& status(EntityStats& entity, uint64_t status);
+
+  /**
+   * @return Stats::Counter& the capacity counter of a partition of a table for an operation.
+   */
+  Stats::Counter& partitionCapacity(const std::string& table, const std::string& operation,
+                                    const std::string& partition_id);
+
+private:
+  typedef std::unordered_map<std::string, std::unique_ptr<EntityStats>> EntityMap;
+
+  EntityStats& entity(EntityMap& entities, const char* entity_type, const std::string& name);
+
+  const std::string prefix_;
+  Stats::Scope& scope_;
+  const uint64_t max_entities_;
+  EntityMap tables_;
+  EntityMap operations_;
+};
+
+/**
+ * Configuration for the DynamoDb filter, which holds the stats cache of each worker.
+ */
+class DynamoFilterConfig {
+public:
+  DynamoFilterConfig(const std::string& stat_prefix, Stats::Scope& scope,
+                     ThreadLocal::SlotAllocator& tls);
+
+  DynamoStatsCache& statsCache() { return tls_->getTyped<DynamoStatsCache>(); }
+
+private:
+  ThreadLocal::SlotPtr tls_;
+};
+
+typedef std::shared_ptr<DynamoFilterConfig> DynamoFilterConfigSharedPtr;
+
 /**
  * DynamoDb filter to process egress request to dynamo and capture comprehensive stats
  * It captures RPS/latencies:
@@ -21,8 +124,9 @@ namespace Dynamo {
  */
 class DynamoFilter : public Http::StreamFilter {
 public:
-  DynamoFilter(Runtime::Loader& runtime, const std::string& stat_prefix, Stats::Scope& scope)
-      : runtime_(runtime), stat_prefix_(stat_prefix + "dynamodb."), scope_(scope) {
+  DynamoFilter(Runtime::Loader& runtime, DynamoFilterConfigSharedPtr config)
+      : runtime_(runtime), config_(config), stats_(config->statsCache()),
+        stat_prefix_(stats_.prefix()), scope_(stats_.scope()) {
     enabled_ = runtime_.snapshot().featureEnabled("dynamodb.filter_enabled", 100);
   }
 
@@ -46,24 +150,26 @@ public:
   }
 
 private:
-  void onDecodeComplete(const Buffer::Instance& data);
-  void onEncodeComplete(const Buffer::Instance& data);
-  std::string buildBody(const Buffer::Instance* buffered, const Buffer::Instance& last);
+  void onDecodeComplete();
+  void onEncodeComplete();
   void chargeBasicStats(uint64_t status);
-  void chargeStatsPerEntity(const std::string& entity, const std::string& entity_type,
-                            uint64_t status);
-  void chargeFailureSpecificStats(const Json::Object& json_body);
-  void chargeUnProcessedKeysStats(const Json::Object& json_body);
-  void chargeTablePartitionIdStats(const Json::Object& json_body);
+  void chargeStatsPerEntity(DynamoStatsCache::EntityStats& entity, uint64_t status);
+  void chargeFailureSpecificStats(const BodyParser& body);
+  void chargeUnProcessedKeysStats(const BodyParser& body);
+  void chargeTablePartitionIdStats(const BodyParser& body);
 
   Runtime::Loader& runtime_;
-  std::string stat_prefix_;
+  DynamoFilterConfigSharedPtr config_;
+  DynamoStatsCache& stats_;
+  const std::string& stat_prefix_;
   Stats::Scope& scope_;
 
   bool enabled_{};
   std::string operation_{};
   RequestParser::TableDescriptor table_descriptor_{"", true};
   std::string error_type_{};
+  BodyParser request_body_;
+  BodyParser response_body_;
   MonotonicTime start_decode_;
   Http::HeaderMap* response_headers_;
   Http::StreamDecoderFilterCallbacks* decoder_callbacks_{};
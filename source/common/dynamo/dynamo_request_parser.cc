@@ -3,6 +3,7 @@
 #include <cmath>
 #include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "common/common/utility.h"
@@ -66,44 +67,33 @@ std::string RequestParser::parseOperation(const Http::HeaderMap& headerMap) {
 }
 
 RequestParser::TableDescriptor RequestParser::parseTable(const std::string& operation,
-                                                         const Json::Object& json_data) {
+                                                         const BodyParser& body) {
   TableDescriptor table{"", true};
 
   // Simple operations on a single table, have "TableName" explicitly specified.
   if (find(SINGLE_TABLE_OPERATIONS.begin(), SINGLE_TABLE_OPERATIONS.end(), operation) !=
       SINGLE_TABLE_OPERATIONS.end()) {
-    table.table_name = json_data.getString("TableName", "");
+    table.table_name = body.tableName();
   } else if (find(BATCH_OPERATIONS.begin(), BATCH_OPERATIONS.end(), operation) !=
              BATCH_OPERATIONS.end()) {
-    Json::ObjectSharedPtr tables = json_data.getObject("RequestItems", true);
-    tables->iterate([&table](const std::string& key, const Json::Object&) {
+    for (const std::string& key : body.requestItems()) {
       if (table.table_name.empty()) {
         table.table_name = key;
-      } else {
-        if (table.table_name != key) {
-          table.table_name = "";
-          table.is_single_table = false;
-          return false;
-        }
+      } else if (table.table_name != key) {
+        table.table_name = "";
+        table.is_single_table = false;
+        break;
       }
-      return true;
-    });
+    }
   }
 
   return table;
 }
-std::vector<std::string> RequestParser::parseBatchUnProcessedKeys(const Json::Object& json_data) {
-  std::vector<std::string> unprocessed_tables;
-  Json::ObjectSharedPtr tables = json_data.getObject("UnprocessedKeys", true);
-  tables->iterate([&unprocessed_tables](const std::string& key, const Json::Object&) {
-    unprocessed_tables.emplace_back(key);
-    return true;
-  });
-
-  return unprocessed_tables;
+std::vector<std::string> RequestParser::parseBatchUnProcessedKeys(const BodyParser& body) {
+  return body.unprocessedKeys();
 }
-std::string RequestParser::parseErrorType(const Json::Object& json_data) {
-  std::string error_type = json_data.getString("__type", "");
+std::string RequestParser::parseErrorType(const BodyParser& body) {
+  const std::string& error_type = body.errorType();
   if (error_type.empty()) {
     return "";
   }
@@ -123,21 +113,17 @@ bool RequestParser::isBatchOperation(const std::string& operation) {
 }
 
 std::vector<RequestParser::PartitionDescriptor>
-RequestParser::parsePartitions(const Json::Object& json_data) {
+RequestParser::parsePartitions(const BodyParser& body) {
   std::vector<RequestParser::PartitionDescriptor> partition_descriptors;
 
-  Json::ObjectSharedPtr partitions =
-      json_data.getObject("ConsumedCapacity", true)->getObject("Partitions", true);
-  partitions->iterate([&partition_descriptors, &partitions](const std::string& key,
-                                                            const Json::Object&) {
+  for (const std::pair<std::string, double>& partition : body.partitions()) {
     // For a given partition id, the amount of capacity used is returned in the body as a double.
     // A stat will be created to track the capacity consumed for the operation, table and partition.
     // Stats counter only increments by whole numbers, capacity is round up to the nearest integer
     // to account for this.
-    uint64_t capacity_integer = static_cast<uint64_t>(std::ceil(partitions->getDouble(key, 0.0)));
-    partition_descriptors.emplace_back(key, capacity_integer);
-    return true;
-  });
+    uint64_t capacity_integer = static_cast<uint64_t>(std::ceil(partition.second));
+    partition_descriptors.emplace_back(partition.first, capacity_integer);
+  }
 
   return partition_descriptors;
 }
@@ -6,7 +6,7 @@
 
 #include "envoy/http/header_map.h"
 
-#include "common/json/json_loader.h"
+#include "common/dynamo/dynamo_body_parser.h"
 
 namespace Envoy {
 namespace Dynamo {
@@ -40,9 +40,8 @@ public:
 
   /**
    * Parse table name out of data, based on the operation.
-   * @return empty string as TableDescriptor.table_name if table name cannot be parsed out of valid
-   *json data
-   * or if operation is not in the list of operations that we support.
+   * @return empty string as TableDescriptor.table_name if table name cannot be parsed out of the
+   * body or if operation is not in the list of operations that we support.
    *
    * For simple operations on single table, e.g., GetItem, PutItem, Query etc @return table
    * name in TableDescriptor.table_name.
@@ -51,10 +50,8 @@ public:
    *TableDescriptor.table_name if it's only one
    * table used in all operations, @return empty string in TableDescriptor.table_name and
    *TableDescriptor.is_single_table=false in case of multiple.
-   *
-   * @throw Json::Exception if data is not in valid Json format.
    */
-  static TableDescriptor parseTable(const std::string& operation, const Json::Object& json_data);
+  static TableDescriptor parseTable(const std::string& operation, const BodyParser& body);
 
   /**
    * Parse error details which might be provided for a given response code.
@@ -63,17 +60,15 @@ public:
    * http://docs.aws.amazon.com/amazondynamodb/latest/APIReference/CommonErrors.html
    * Operation specific errors, for example, error section of
    * http://docs.aws.amazon.com/amazondynamodb/latest/APIReference/API_UpdateItem.html
-   *
-   * @throw Json::Exception if data is not in valid Json format.
    */
-  static std::string parseErrorType(const Json::Object& json_data);
+  static std::string parseErrorType(const BodyParser& body);
 
   /**
    * Parse unprocessed keys for batch operation results.
    * @return empty set if there are no unprocessed keys or a set of table names that did not get
    * processed in the batch operation.
    */
-  static std::vector<std::string> parseBatchUnProcessedKeys(const Json::Object& json_data);
+  static std::vector<std::string> parseBatchUnProcessedKeys(const BodyParser& body);
 
   /**
    * @return true if the operation is in the set of supported BATCH_OPERATIONS
@@ -84,10 +79,8 @@ public:
    * Parse the Partition ids and the consumed capacity from the body.
    * @return empty set if there is no partition data or a set of partition data containing
    * the partition id as a string and the capacity consumed as an integer.
-   *
-   * @throw Json::Exception if data is not in valid Json format.
    */
-  static std::vector<PartitionDescriptor> parsePartitions(const Json::Object& json_data);
+  static std::vector<PartitionDescriptor> parsePartitions(const BodyParser& body);
 
 private:
   static const Http::LowerCaseString X_AMZ_TARGET;
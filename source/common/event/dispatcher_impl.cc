@@ -1,19 +1,30 @@
 #include "common/event/dispatcher_impl.h"
 
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <chrono>
 #include <cstdint>
 #include <functional>
-#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "envoy/network/listen_socket.h"
 #include "envoy/network/listener.h"
 
 #include "common/buffer/buffer_impl.h"
+#include "common/common/assert.h"
+#include "common/common/enum_to_int.h"
+#include "common/common/macros.h"
+#include "common/common/utility.h"
 #include "common/event/file_event_impl.h"
 #include "common/event/signal_impl.h"
 #include "common/event/timer_impl.h"
+#include "common/event/timer_wheel.h"
 #include "common/filesystem/watcher_impl.h"
 #include "common/network/connection_impl.h"
 #include "common/network/dns_impl.h"
@@ -25,16 +36,78 @@
 namespace Envoy {
 namespace Event {
 
+const uint64_t DispatcherImpl::DEFAULT_CONNECTION_READ_BUDGET;
+
+namespace {
+
+const char* callbackTypeName(DispatcherImpl::CallbackType type) {
+  switch (type) {
+  case DispatcherImpl::CallbackType::FileEvent:
+    return "file event";
+  case DispatcherImpl::CallbackType::Timer:
+    return "timer";
+  case DispatcherImpl::CallbackType::Post:
+    return "post";
+  case DispatcherImpl::CallbackType::DeferredDelete:
+    return "deferred delete";
+  case DispatcherImpl::CallbackType::Internal:
+    break;
+  }
+  NOT_REACHED;
+}
+
+} // namespace
+
 DispatcherImpl::DispatcherImpl()
     : DispatcherImpl(Buffer::WatermarkFactoryPtr{new Buffer::WatermarkBufferFactory}) {}
 
 DispatcherImpl::DispatcherImpl(Buffer::WatermarkFactoryPtr&& factory)
-    : buffer_factory_(std::move(factory)), base_(event_base_new()),
-      deferred_delete_timer_(createTimer([this]() -> void { clearDeferredDeleteList(); })),
-      post_timer_(createTimer([this]() -> void { runPostCallbacks(); })),
-      current_to_delete_(&to_delete_1_) {}
+    : DispatcherImpl(std::move(factory), DEFAULT_CONNECTION_READ_BUDGET) {}
+
+DispatcherImpl::DispatcherImpl(Buffer::WatermarkFactoryPtr&& factory,
+                               uint64_t connection_read_budget)
+    : DispatcherImpl(std::move(factory), connection_read_budget, "") {}
+
+DispatcherImpl::DispatcherImpl(Buffer::WatermarkFactoryPtr&& factory,
+                               uint64_t connection_read_budget, const std::string& event_backend)
+    : buffer_factory_(std::move(factory)), connection_read_budget_(connection_read_budget),
+      base_(Libevent::Global::createBase(event_backend)),
+      deferred_delete_timer_(new TimerImpl(*this, [this]() -> void { clearDeferredDeleteList(); },
+                                           CallbackType::Internal)),
+      current_to_delete_(&to_delete_1_), post_head_(&post_stub_), post_tail_(&post_stub_) {
+#if defined(__linux__)
+  post_wakeup_fds_[0] = post_wakeup_fds_[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  RELEASE_ASSERT(post_wakeup_fds_[0] != -1);
+#else
+  RELEASE_ASSERT(pipe(post_wakeup_fds_) == 0);
+  for (int fd : post_wakeup_fds_) {
+    RELEASE_ASSERT(fcntl(fd, F_SETFL, O_NONBLOCK) == 0);
+    RELEASE_ASSERT(fcntl(fd, F_SETFD, FD_CLOEXEC) == 0);
+  }
+#endif
+  post_wakeup_event_.reset(new FileEventImpl(*this, post_wakeup_fds_[0],
+                                             [this](uint32_t events) -> void {
+                                               ASSERT(events == FileReadyType::Read);
+                                               UNREFERENCED_PARAMETER(events);
+                                               onPostWakeup();
+                                             },
+                                             FileTriggerType::Edge, FileReadyType::Read,
+                                             CallbackType::Internal));
+}
 
-DispatcherImpl::~DispatcherImpl() {}
+DispatcherImpl::~DispatcherImpl() {
+  // Callbacks that never got to run are dropped, like the pending events of the loop.
+  PostNode* node;
+  while ((node = popPostNode()) != nullptr) {
+    delete node;
+  }
+
+  post_wakeup_event_.reset();
+  close(post_wakeup_fds_[0]);
+  if (post_wakeup_fds_[1] != post_wakeup_fds_[0]) {
+    close(post_wakeup_fds_[1]);
+  }
+}
 
 void DispatcherImpl::clearDeferredDeleteList() {
   ASSERT(isThreadSafe());
@@ -61,7 +134,8 @@ void DispatcherImpl::clearDeferredDeleteList() {
   // destroy in FIFO order so just do it manually. This required 2 passes over the vector which is
   // not optimal but can be cleaned up later if needed.
   for (size_t i = 0; i < num_to_delete; i++) {
-    (*to_delete)[i].reset();
+    runCallback(CallbackType::DeferredDelete,
+                [to_delete, i]() -> void { (*to_delete)[i].reset(); });
   }
 
   to_delete->clear();
@@ -127,6 +201,18 @@ TimerPtr DispatcherImpl::createTimer(TimerCb cb) {
   return TimerPtr{new TimerImpl(*this, cb)};
 }
 
+TimerPtr DispatcherImpl::createTimer(TimerCb cb, TimerPrecision precision) {
+  if (precision == TimerPrecision::Precise) {
+    return createTimer(cb);
+  }
+
+  ASSERT(isThreadSafe());
+  if (!timer_wheel_) {
+    timer_wheel_.reset(new TimerWheel(*this, ProdMonotonicTimeSource::instance_));
+  }
+  return TimerPtr{new CoarseTimerImpl(*timer_wheel_, cb)};
+}
+
 void DispatcherImpl::deferredDelete(DeferredDeletablePtr&& to_delete) {
   ASSERT(isThreadSafe());
   current_to_delete_->emplace_back(std::move(to_delete));
@@ -138,22 +224,85 @@ void DispatcherImpl::deferredDelete(DeferredDeletablePtr&& to_delete) {
 
 void DispatcherImpl::exit() { event_base_loopexit(base_.get(), nullptr); }
 
+void DispatcherImpl::initializeStats(Stats::Scope& scope, const std::string& prefix) {
+  ASSERT(!stats_);
+  stats_.reset(new DispatcherStats{ALL_DISPATCHER_STATS(POOL_COUNTER_PREFIX(scope, prefix),
+                                                        POOL_GAUGE_PREFIX(scope, prefix))});
+  stats_scope_ = &scope;
+  stats_prefix_ = prefix;
+  post_latency_stat_name_ = prefix + "post_latency_us";
+}
+
 SignalEventPtr DispatcherImpl::listenForSignal(int signal_num, SignalCb cb) {
   ASSERT(isThreadSafe());
   return SignalEventPtr{new SignalEventImpl(*this, signal_num, cb)};
 }
 
 void DispatcherImpl::post(std::function<void()> callback) {
-  bool do_post;
-  {
-    std::unique_lock<std::mutex> lock(post_lock_);
-    do_post = post_callbacks_.empty();
-    post_callbacks_.push_back(callback);
+  PostNode* node = new PostNode();
+  node->callback_ = std::move(callback);
+  if (stats_) {
+    node->posted_time_ = ProdMonotonicTimeSource::instance_.currentTime();
+  }
+  pushPostNode(node);
+
+  // The node is counted once it is linked, so that the dispatcher never waits for a counted node
+  // for longer than it takes a producer that pushed before it to finish linking its own node.
+  if (post_pending_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+    const uint64_t value = 1;
+    const ssize_t rc = write(post_wakeup_fds_[1], &value, sizeof(value));
+    // The write can only fail if the dispatcher already has a wakeup it has not read yet.
+    UNREFERENCED_PARAMETER(rc);
+  }
+}
+
+void DispatcherImpl::pushPostNode(PostNode* node) {
+  node->next_.store(nullptr, std::memory_order_relaxed);
+  PostNode* previous = post_head_.exchange(node, std::memory_order_acq_rel);
+  previous->next_.store(node, std::memory_order_release);
+}
+
+DispatcherImpl::PostNode* DispatcherImpl::popPostNode() {
+  // This is the intrusive queue from http://www.1024cores.net/home/lock-free-algorithms/queues. It
+  // returns nullptr both when the queue is empty and when the next node has been pushed but not
+  // linked yet.
+  PostNode* tail = post_tail_;
+  PostNode* next = tail->next_.load(std::memory_order_acquire);
+  if (tail == &post_stub_) {
+    if (next == nullptr) {
+      return nullptr;
+    }
+    post_tail_ = next;
+    tail = next;
+    next = next->next_.load(std::memory_order_acquire);
   }
 
-  if (do_post) {
-    post_timer_->enableTimer(std::chrono::milliseconds(0));
+  if (next != nullptr) {
+    post_tail_ = next;
+    return tail;
   }
+
+  if (tail != post_head_.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+
+  // The tail is the last node. Put the stub back behind it so that it can be unlinked.
+  pushPostNode(&post_stub_);
+  next = tail->next_.load(std::memory_order_acquire);
+  if (next != nullptr) {
+    post_tail_ = next;
+    return tail;
+  }
+  return nullptr;
+}
+
+void DispatcherImpl::onPostWakeup() {
+  // Reset the wakeup before running the callbacks, so that a post that happens after the queue was
+  // drained wakes the dispatcher up again.
+  uint64_t value;
+  while (read(post_wakeup_fds_[0], &value, sizeof(value)) > 0) {
+  }
+  runPostCallbacks();
 }
 
 void DispatcherImpl::run(RunType type) {
@@ -165,18 +314,102 @@ void DispatcherImpl::run(RunType type) {
   // event_base_once() before some other event, the other event might get called first.
   runPostCallbacks();
 
+  if (stats_) {
+    runLoopWithStats(type);
+    return;
+  }
+
   event_base_loop(base_.get(), type == RunType::NonBlock ? EVLOOP_NONBLOCK : 0);
 }
 
+void DispatcherImpl::runLoopWithStats(RunType type) {
+  if (!loop_histograms_) {
+    loop_histograms_.reset(
+        new LoopHistograms{stats_scope_->histogram(stats_prefix_ + "loop_duration_us"),
+                           {&stats_scope_->histogram(stats_prefix_ + "loop_file_events"),
+                            &stats_scope_->histogram(stats_prefix_ + "loop_timers"),
+                            &stats_scope_->histogram(stats_prefix_ + "loop_posts"),
+                            &stats_scope_->histogram(stats_prefix_ + "loop_deferred_deletes")}});
+  }
+
+  // Run one iteration at a time, so that the work done between two polls can be recorded. An exit
+  // requested in between two iterations is not lost, since libevent implements it as an event that
+  // runs in the next iteration.
+  const int flags = EVLOOP_ONCE | (type == RunType::NonBlock ? EVLOOP_NONBLOCK : 0);
+  while (true) {
+    loop_iteration_ = {};
+    const int rc = event_base_loop(base_.get(), flags);
+
+    bool any_callbacks = false;
+    for (uint64_t callbacks : loop_iteration_.callbacks_) {
+      any_callbacks |= callbacks > 0;
+    }
+    if (any_callbacks) {
+      loop_histograms_->duration_us_.recordValue(loop_iteration_.duration_.count());
+      for (size_t i = 0; i < NUM_TIMED_CALLBACK_TYPES; i++) {
+        loop_histograms_->callbacks_[i]->recordValue(loop_iteration_.callbacks_[i]);
+      }
+    }
+
+    if (rc != 0 || type == RunType::NonBlock || event_base_got_exit(base_.get()) ||
+        event_base_got_break(base_.get())) {
+      break;
+    }
+  }
+}
+
+void DispatcherImpl::onCallbackComplete(CallbackType type, MonotonicTime start) {
+  const std::chrono::microseconds duration = std::chrono::duration_cast<std::chrono::microseconds>(
+      ProdMonotonicTimeSource::instance_.currentTime() - start);
+  loop_iteration_.callbacks_[enumToInt(type)]++;
+  // Nested callbacks, e.g. a deferred delete list that is cleared from a file event, are already
+  // part of the duration of the outer callback.
+  if (callback_depth_ == 0) {
+    loop_iteration_.duration_ += duration;
+  }
+
+  if (slow_callback_threshold_.count() > 0 && duration >= slow_callback_threshold_) {
+    stats_->slow_callbacks_.inc();
+    ENVOY_LOG(warn, "slow {} callback took {}ms", callbackTypeName(type),
+              std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+  }
+}
+
 void DispatcherImpl::runPostCallbacks() {
-  std::unique_lock<std::mutex> lock(post_lock_);
-  while (!post_callbacks_.empty()) {
-    std::function<void()> callback = post_callbacks_.front();
-    post_callbacks_.pop_front();
-
-    lock.unlock();
-    callback();
-    lock.lock();
+  ASSERT(isThreadSafe());
+  uint64_t pending = post_pending_.load(std::memory_order_acquire);
+  while (pending > 0) {
+    if (stats_) {
+      stats_->post_queue_size_.set(pending);
+    }
+
+    for (uint64_t i = 0; i < pending; i++) {
+      PostNode* node;
+      while ((node = popPostNode()) == nullptr) {
+        // A producer that pushed before the counted ones is still linking its node.
+        std::this_thread::yield();
+      }
+
+      if (stats_) {
+        stats_->post_callbacks_.inc();
+        stats_scope_->deliverHistogramToSinks(
+            post_latency_stat_name_,
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                ProdMonotonicTimeSource::instance_.currentTime() - node->posted_time_)
+                .count());
+      }
+
+      std::unique_ptr<PostNode> to_run(node);
+      runCallback(CallbackType::Post, [&to_run]() -> void { to_run->callback_(); });
+    }
+
+    // Callbacks posted while running stay counted, so they are run before returning without
+    // another wakeup.
+    pending = post_pending_.fetch_sub(pending, std::memory_order_acq_rel) - pending;
+  }
+
+  if (stats_) {
+    stats_->post_queue_size_.set(0);
   }
 }
 
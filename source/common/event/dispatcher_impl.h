@@ -1,36 +1,99 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <functional>
-#include <list>
-#include <mutex>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "envoy/common/time.h"
 #include "envoy/event/deferred_deletable.h"
 #include "envoy/event/dispatcher.h"
 #include "envoy/network/connection_handler.h"
+#include "envoy/stats/stats_macros.h"
 
 #include "common/common/logger.h"
 #include "common/common/thread.h"
+#include "common/common/utility.h"
 #include "common/event/libevent.h"
 
 namespace Envoy {
 namespace Event {
 
+class TimerWheel;
+
+// clang-format off
+#define ALL_DISPATCHER_STATS(COUNTER, GAUGE)                                                       \
+  COUNTER(post_callbacks)                                                                          \
+  COUNTER(slow_callbacks)                                                                          \
+  GAUGE  (post_queue_size)
+// clang-format on
+
+/**
+ * Struct definition for all dispatcher stats. @see stats_macros.h
+ */
+struct DispatcherStats {
+  ALL_DISPATCHER_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT)
+};
+
 /**
  * libevent implementation of Event::Dispatcher.
  */
 class DispatcherImpl : Logger::Loggable<Logger::Id::main>, public Dispatcher {
 public:
+  // The default read budget of the connections of a dispatcher. @see connectionReadBudget().
+  static const uint64_t DEFAULT_CONNECTION_READ_BUDGET = 262144;
+
+  /**
+   * The kinds of callbacks that the event loop runs, as reported by the loop stats. Internal
+   * callbacks are the ones of the dispatcher itself, which time the posts and deferred deletes
+   * they run one by one.
+   */
+  enum class CallbackType { FileEvent, Timer, Post, DeferredDelete, Internal };
+
   DispatcherImpl();
   DispatcherImpl(Buffer::WatermarkFactoryPtr&& factory);
+  DispatcherImpl(Buffer::WatermarkFactoryPtr&& factory, uint64_t connection_read_budget);
+  /**
+   * @param event_backend supplies the libevent backend of the dispatcher, or empty for the default
+   *        one. @see Libevent::Global::createBase().
+   */
+  DispatcherImpl(Buffer::WatermarkFactoryPtr&& factory, uint64_t connection_read_budget,
+                 const std::string& event_backend);
   ~DispatcherImpl();
 
+  /**
+   * @return uint64_t the maximum number of bytes that a connection of this dispatcher reads per
+   *         read event before yielding to the other events, or 0 for no limit.
+   */
+  uint64_t connectionReadBudget() const { return connection_read_budget_; }
+
   /**
    * @return event_base& the libevent base.
    */
   event_base& base() { return *base_; }
 
+  /**
+   * Run a callback of the event loop. Once stats are initialized, the callback is timed and
+   * counted towards the current loop iteration.
+   * @param type supplies the kind of callback.
+   * @param callback supplies the callback to run.
+   */
+  template <class Callback> void runCallback(CallbackType type, Callback callback) {
+    if (!stats_ || type == CallbackType::Internal) {
+      callback();
+      return;
+    }
+
+    const MonotonicTime start = ProdMonotonicTimeSource::instance_.currentTime();
+    callback_depth_++;
+    callback();
+    callback_depth_--;
+    onCallbackComplete(type, start);
+  }
+
   // Event::Dispatcher
   void clearDeferredDeleteList() override;
   Network::ClientConnectionPtr
@@ -54,14 +117,50 @@ public:
                                          Network::ListenerCallbacks& cb, Stats::Scope& scope,
                                          const Network::ListenerOptions& listener_options) override;
   TimerPtr createTimer(TimerCb cb) override;
+  TimerPtr createTimer(TimerCb cb, TimerPrecision precision) override;
   void deferredDelete(DeferredDeletablePtr&& to_delete) override;
   void exit() override;
+  void initializeStats(Stats::Scope& scope, const std::string& prefix) override;
   SignalEventPtr listenForSignal(int signal_num, SignalCb cb) override;
   void post(std::function<void()> callback) override;
   void run(RunType type) override;
+  void setSlowCallbackThreshold(std::chrono::milliseconds threshold) override {
+    slow_callback_threshold_ = threshold;
+  }
   Buffer::WatermarkFactory& getWatermarkFactory() override { return *buffer_factory_; }
 
 private:
+  /**
+   * A posted callback. The nodes are linked into an intrusive multiple producer, single consumer
+   * queue, so that posting is one exchange and no lock is ever taken.
+   */
+  struct PostNode {
+    std::atomic<PostNode*> next_{};
+    PostCb callback_;
+    MonotonicTime posted_time_;
+  };
+
+  // The number of callback types that are timed, i.e. all but CallbackType::Internal.
+  static const size_t NUM_TIMED_CALLBACK_TYPES = 4;
+
+  // The number of callbacks of each type that ran in a loop iteration, and how long they took.
+  struct LoopIteration {
+    uint64_t callbacks_[NUM_TIMED_CALLBACK_TYPES];
+    std::chrono::microseconds duration_;
+  };
+
+  // Histograms of the loop iterations. They are looked up on the dispatcher thread, since each
+  // thread records into its own histograms.
+  struct LoopHistograms {
+    Stats::Histogram& duration_us_;
+    Stats::Histogram* callbacks_[NUM_TIMED_CALLBACK_TYPES];
+  };
+
+  void onCallbackComplete(CallbackType type, MonotonicTime start);
+  void runLoopWithStats(RunType type);
+  void pushPostNode(PostNode* node);
+  PostNode* popPostNode();
+  void onPostWakeup();
   void runPostCallbacks();
 #ifndef NDEBUG
   // Validate that an operation is thread safe, i.e. it's invoked on the same thread that the
@@ -74,14 +173,34 @@ private:
 
   Thread::ThreadId run_tid_{};
   Buffer::WatermarkFactoryPtr buffer_factory_;
+  const uint64_t connection_read_budget_;
   Libevent::BasePtr base_;
+  // Created on the first coarse timer. It is destroyed after the objects awaiting deferred
+  // deletion, which may own coarse timers.
+  std::unique_ptr<TimerWheel> timer_wheel_;
   TimerPtr deferred_delete_timer_;
-  TimerPtr post_timer_;
   std::vector<DeferredDeletablePtr> to_delete_1_;
   std::vector<DeferredDeletablePtr> to_delete_2_;
   std::vector<DeferredDeletablePtr>* current_to_delete_;
-  std::mutex post_lock_;
-  std::list<std::function<void()>> post_callbacks_;
+  // The queue always contains at least the stub node. Producers only touch post_head_, the
+  // dispatcher thread only touches post_tail_.
+  PostNode post_stub_;
+  std::atomic<PostNode*> post_head_;
+  PostNode* post_tail_;
+  // The number of callbacks that have been pushed and not run yet. Only the post that makes it
+  // non-zero wakes up the dispatcher.
+  std::atomic<uint64_t> post_pending_{};
+  // An eventfd (or a pipe where there is no eventfd) that is written to wake up the dispatcher.
+  int post_wakeup_fds_[2];
+  FileEventPtr post_wakeup_event_;
+  std::unique_ptr<DispatcherStats> stats_;
+  Stats::Scope* stats_scope_{};
+  std::string stats_prefix_;
+  std::string post_latency_stat_name_;
+  std::unique_ptr<LoopHistograms> loop_histograms_;
+  LoopIteration loop_iteration_{};
+  uint32_t callback_depth_{};
+  std::chrono::milliseconds slow_callback_threshold_{};
   bool deferred_deleting_{};
 };
 
@@ -11,8 +11,10 @@ namespace Envoy {
 namespace Event {
 
 FileEventImpl::FileEventImpl(DispatcherImpl& dispatcher, int fd, FileReadyCb cb,
-                             FileTriggerType trigger, uint32_t events)
-    : cb_(cb), base_(&dispatcher.base()), fd_(fd), trigger_(trigger) {
+                             FileTriggerType trigger, uint32_t events,
+                             DispatcherImpl::CallbackType type)
+    : cb_(cb), dispatcher_(dispatcher), type_(type), base_(&dispatcher.base()), fd_(fd),
+      trigger_(trigger) {
   assignEvents(events);
   event_add(&raw_event_, nullptr);
 }
@@ -57,7 +59,8 @@ void FileEventImpl::assignEvents(uint32_t events) {
                  }
 
                  ASSERT(events);
-                 event->cb_(events);
+                 event->dispatcher_.runCallback(event->type_,
+                                                [event, events]() -> void { event->cb_(events); });
                },
                this);
 }
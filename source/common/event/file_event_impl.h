@@ -17,7 +17,8 @@ namespace Event {
 class FileEventImpl : public FileEvent, ImplBase {
 public:
   FileEventImpl(DispatcherImpl& dispatcher, int fd, FileReadyCb cb, FileTriggerType trigger,
-                uint32_t events);
+                uint32_t events,
+                DispatcherImpl::CallbackType type = DispatcherImpl::CallbackType::FileEvent);
 
   // Event::FileEvent
   void activate(uint32_t events) override;
@@ -27,6 +28,8 @@ private:
   void assignEvents(uint32_t events);
 
   FileReadyCb cb_;
+  DispatcherImpl& dispatcher_;
+  const DispatcherImpl::CallbackType type_;
   event_base* base_;
   int fd_;
   FileTriggerType trigger_;
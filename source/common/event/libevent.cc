@@ -2,9 +2,16 @@
 
 #include <signal.h>
 
+#include <memory>
+#include <string>
+
+#include "envoy/common/exception.h"
+
 #include "common/common/assert.h"
 
+#include "event2/event.h"
 #include "event2/thread.h"
+#include "fmt/format.h"
 
 namespace Envoy {
 namespace Event {
@@ -17,6 +24,65 @@ void Global::initialize() {
   signal(SIGPIPE, SIG_IGN);
 }
 
+namespace {
+
+const char EPOLL_CHANGELIST[] = "epoll_changelist";
+
+// The libevent method implementing a backend name.
+std::string backendMethod(const std::string& backend) {
+  return backend == EPOLL_CHANGELIST ? "epoll" : backend;
+}
+
+} // namespace
+
+BasePtr Global::createBase(const std::string& backend) {
+  if (backend.empty()) {
+    BasePtr base(event_base_new());
+    RELEASE_ASSERT(base);
+    return base;
+  }
+
+  if (!backendSupported(backend)) {
+    throw EnvoyException(fmt::format("event backend '{}' is not supported", backend));
+  }
+
+  // libevent has no way to ask for a method, so every other method is avoided instead.
+  std::unique_ptr<event_config, void (*)(event_config*)> config(event_config_new(),
+                                                                event_config_free);
+  RELEASE_ASSERT(config);
+  const std::string method = backendMethod(backend);
+  for (const char** other = event_get_supported_methods(); *other != nullptr; other++) {
+    if (method != *other) {
+      event_config_avoid_method(config.get(), *other);
+    }
+  }
+  if (backend == EPOLL_CHANGELIST) {
+    event_config_set_flag(config.get(), EVENT_BASE_FLAG_EPOLL_USE_CHANGELIST);
+  }
+
+  BasePtr base(event_base_new_with_config(config.get()));
+  if (!base) {
+    throw EnvoyException(fmt::format("unable to create an event base for backend '{}'", backend));
+  }
+  ASSERT(method == event_base_get_method(base.get()));
+  return base;
+}
+
+bool Global::backendSupported(const std::string& backend) {
+  if (backend.empty()) {
+    return true;
+  }
+
+  const std::string method = backendMethod(backend);
+  for (const char** supported = event_get_supported_methods(); *supported != nullptr;
+       supported++) {
+    if (method == *supported) {
+      return true;
+    }
+  }
+  return false;
+}
+
 } // namespace Libevent
 } // namespace Event
 } // namespace Envoy
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>
+
 #include "common/common/c_smart_ptr.h"
 
 struct event_base;
@@ -7,25 +9,18 @@ extern "C" {
 void event_base_free(event_base*);
 }
 
-struct evbuffer;
-extern "C" {
-void evbuffer_free(evbuffer*);
-}
-
 struct bufferevent;
 extern "C" {
 void bufferevent_free(bufferevent*);
 }
 
-struct evconnlistener;
-extern "C" {
-void evconnlistener_free(evconnlistener*);
-}
-
 namespace Envoy {
 namespace Event {
 namespace Libevent {
 
+typedef CSmartPtr<event_base, event_base_free> BasePtr;
+typedef CSmartPtr<bufferevent, bufferevent_free> BufferEventPtr;
+
 /**
  * Global functionality specific to libevent.
  */
@@ -35,12 +30,24 @@ public:
    * Initialize the library globally.
    */
   static void initialize();
-};
 
-typedef CSmartPtr<event_base, event_base_free> BasePtr;
-typedef CSmartPtr<evbuffer, evbuffer_free> BufferPtr;
-typedef CSmartPtr<bufferevent, bufferevent_free> BufferEventPtr;
-typedef CSmartPtr<evconnlistener, evconnlistener_free> ListenerPtr;
+  /**
+   * Create an event base that uses a given backend.
+   * @param backend supplies the name of a libevent backend ("epoll", "poll", "select", "kqueue"),
+   *        "epoll_changelist", or empty to let libevent pick the best backend of the platform.
+   *        "epoll_changelist" is epoll with the fd interest changes of a loop iteration collected
+   *        and submitted together right before the loop waits, so that a file event that is
+   *        enabled and disabled within one iteration costs no epoll_ctl() call.
+   * @return BasePtr the event base. Throws an EnvoyException if the backend is not available.
+   */
+  static BasePtr createBase(const std::string& backend);
+
+  /**
+   * @param backend supplies a backend name as accepted by createBase().
+   * @return bool whether the backend is available on this platform.
+   */
+  static bool backendSupported(const std::string& backend);
+};
 
 } // namespace Libevent
 } // namespace Event
@@ -10,11 +10,16 @@
 namespace Envoy {
 namespace Event {
 
-TimerImpl::TimerImpl(DispatcherImpl& dispatcher, TimerCb cb) : cb_(cb) {
+TimerImpl::TimerImpl(DispatcherImpl& dispatcher, TimerCb cb, DispatcherImpl::CallbackType type)
+    : cb_(cb), dispatcher_(dispatcher), type_(type) {
   ASSERT(cb_);
-  evtimer_assign(
-      &raw_event_, &dispatcher.base(),
-      [](evutil_socket_t, short, void* arg) -> void { static_cast<TimerImpl*>(arg)->cb_(); }, this);
+  evtimer_assign(&raw_event_, &dispatcher.base(),
+                 [](evutil_socket_t, short, void* arg) -> void {
+                   TimerImpl* timer = static_cast<TimerImpl*>(arg);
+                   timer->dispatcher_.runCallback(timer->type_,
+                                                  [timer]() -> void { timer->cb_(); });
+                 },
+                 this);
 }
 
 void TimerImpl::disableTimer() { event_del(&raw_event_); }
@@ -15,7 +15,8 @@ namespace Event {
  */
 class TimerImpl : public Timer, ImplBase {
 public:
-  TimerImpl(DispatcherImpl& dispatcher, TimerCb cb);
+  TimerImpl(DispatcherImpl& dispatcher, TimerCb cb,
+            DispatcherImpl::CallbackType type = DispatcherImpl::CallbackType::Timer);
 
   // Event::Timer
   void disableTimer() override;
@@ -23,6 +24,8 @@ public:
 
 private:
   TimerCb cb_;
+  DispatcherImpl& dispatcher_;
+  const DispatcherImpl::CallbackType type_;
 };
 
 } // namespace Event
@@ -0,0 +1,152 @@
+#include "common/event/timer_wheel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "common/common/assert.h"
+#include "common/event/timer_impl.h"
+
+namespace Envoy {
+namespace Event {
+
+const std::chrono::milliseconds TimerWheel::TICK_DURATION{10};
+const uint64_t TimerWheel::NUM_SLOTS;
+
+CoarseTimerImpl::CoarseTimerImpl(TimerWheel& wheel, TimerCb cb) : wheel_(wheel), cb_(cb) {
+  ASSERT(cb_);
+}
+
+CoarseTimerImpl::~CoarseTimerImpl() { disableTimer(); }
+
+void CoarseTimerImpl::disableTimer() {
+  if (list_ != nullptr) {
+    wheel_.disable(*this);
+  }
+}
+
+void CoarseTimerImpl::enableTimer(const std::chrono::milliseconds& d) { wheel_.enable(*this, d); }
+
+TimerWheel::TimerWheel(DispatcherImpl& dispatcher, MonotonicTimeSource& time_source)
+    : dispatcher_(dispatcher), time_source_(time_source), start_time_(time_source.currentTime()),
+      tick_timer_(new TimerImpl(dispatcher, [this]() -> void { onTick(); },
+                                DispatcherImpl::CallbackType::Internal)),
+      slots_(NUM_SLOTS) {}
+
+TimerWheel::~TimerWheel() {
+  // All the coarse timers must have been destroyed before the dispatcher.
+  ASSERT(size_ == 0);
+}
+
+void TimerWheel::enable(CoarseTimerImpl& timer, std::chrono::milliseconds d) {
+  if (timer.list_ != nullptr) {
+    unlink(timer);
+  } else {
+    if (size_ == 0) {
+      // The wheel does not tick while it is empty. Skip the ticks that passed in the meantime.
+      processed_tick_ = currentTick();
+      scheduleTick();
+    }
+    size_++;
+  }
+
+  // Round up, so that the timer never fires early. A timer that expires in the current tick fires
+  // at the next one.
+  const uint64_t expiry = std::chrono::duration_cast<std::chrono::milliseconds>(
+                              time_source_.currentTime() - start_time_ + d)
+                              .count();
+  const uint64_t tick_ms = TICK_DURATION.count();
+  timer.expiry_tick_ = std::max((expiry + tick_ms - 1) / tick_ms, processed_tick_ + 1);
+  link(slots_[timer.expiry_tick_ % NUM_SLOTS], timer);
+}
+
+void TimerWheel::disable(CoarseTimerImpl& timer) {
+  unlink(timer);
+  ASSERT(size_ > 0);
+  if (--size_ == 0) {
+    tick_timer_->disableTimer();
+  }
+}
+
+void TimerWheel::link(CoarseTimerImpl*& list, CoarseTimerImpl& timer) {
+  timer.list_ = &list;
+  timer.prev_ = nullptr;
+  timer.next_ = list;
+  if (list != nullptr) {
+    list->prev_ = &timer;
+  }
+  list = &timer;
+}
+
+void TimerWheel::unlink(CoarseTimerImpl& timer) {
+  if (timer.prev_ != nullptr) {
+    timer.prev_->next_ = timer.next_;
+  } else {
+    *timer.list_ = timer.next_;
+  }
+  if (timer.next_ != nullptr) {
+    timer.next_->prev_ = timer.prev_;
+  }
+  timer.list_ = nullptr;
+  timer.prev_ = timer.next_ = nullptr;
+}
+
+uint64_t TimerWheel::currentTick() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(time_source_.currentTime() -
+                                                               start_time_)
+             .count() /
+         TICK_DURATION.count();
+}
+
+void TimerWheel::onTick() {
+  const uint64_t now_tick = currentTick();
+  uint64_t first_tick = processed_tick_ + 1;
+  if (now_tick >= NUM_SLOTS && first_tick <= now_tick - NUM_SLOTS) {
+    // The loop stalled for more than a revolution, so every slot is expired once.
+    first_tick = now_tick - NUM_SLOTS + 1;
+  }
+  // Timers enabled by the callbacks expire after now_tick, so they are never expired by this pass.
+  processed_tick_ = std::max(processed_tick_, now_tick);
+  for (uint64_t tick = first_tick; tick <= now_tick; tick++) {
+    expireSlot(tick % NUM_SLOTS, now_tick);
+  }
+
+  if (size_ > 0) {
+    scheduleTick();
+  }
+}
+
+void TimerWheel::scheduleTick() {
+  // Fire at the start of the next tick.
+  const std::chrono::milliseconds elapsed =
+      std::chrono::duration_cast<std::chrono::milliseconds>(time_source_.currentTime() -
+                                                            start_time_);
+  tick_timer_->enableTimer(TICK_DURATION - elapsed % TICK_DURATION);
+}
+
+void TimerWheel::expireSlot(uint64_t slot, uint64_t now_tick) {
+  // Move the expired timers to their own list first. The callbacks may then disable or destroy any
+  // of the expired timers, and enable timers in this slot, without breaking the iteration.
+  CoarseTimerImpl* expired = nullptr;
+  CoarseTimerImpl* timer = slots_[slot];
+  while (timer != nullptr) {
+    CoarseTimerImpl* next = timer->next_;
+    if (timer->expiry_tick_ <= now_tick) {
+      unlink(*timer);
+      link(expired, *timer);
+    }
+    timer = next;
+  }
+
+  while (expired != nullptr) {
+    timer = expired;
+    disable(*timer);
+    // The timer may be destroyed by its own callback.
+    dispatcher_.runCallback(DispatcherImpl::CallbackType::Timer, [timer]() -> void {
+      timer->cb_();
+    });
+  }
+}
+
+} // namespace Event
+} // namespace Envoy
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "envoy/common/time.h"
+#include "envoy/event/timer.h"
+
+#include "common/event/dispatcher_impl.h"
+
+namespace Envoy {
+namespace Event {
+
+class TimerWheel;
+
+/**
+ * Timer with TimerPrecision::Coarse. The timer is kept in an intrusive list of the wheel slot that
+ * it expires in, so that enabling and disabling it does not touch the libevent timer heap.
+ */
+class CoarseTimerImpl : public Timer {
+public:
+  CoarseTimerImpl(TimerWheel& wheel, TimerCb cb);
+  ~CoarseTimerImpl();
+
+  // Event::Timer
+  void disableTimer() override;
+  void enableTimer(const std::chrono::milliseconds& d) override;
+
+private:
+  TimerWheel& wheel_;
+  TimerCb cb_;
+  // The list the timer is linked into, or nullptr when it is not enabled.
+  CoarseTimerImpl** list_{};
+  CoarseTimerImpl* prev_{};
+  CoarseTimerImpl* next_{};
+  uint64_t expiry_tick_{};
+
+  friend class TimerWheel;
+};
+
+/**
+ * Hashed timer wheel for the coarse timers of a dispatcher. Time is divided into ticks of
+ * TICK_DURATION, and a timer is put into the slot of the tick it expires in, modulo the number of
+ * slots. A single libevent timer fires at each tick while any coarse timer is enabled, and expires
+ * the timers of the slots of the ticks that passed. Timers further out than one revolution of the
+ * wheel are skipped when their slot comes up, which costs one comparison per revolution. Timers
+ * never fire early, and fire at most one tick (plus the delay of the event loop) late.
+ */
+class TimerWheel {
+public:
+  static const std::chrono::milliseconds TICK_DURATION;
+  static const uint64_t NUM_SLOTS = 4096;
+
+  TimerWheel(DispatcherImpl& dispatcher, MonotonicTimeSource& time_source);
+  ~TimerWheel();
+
+  /**
+   * @return uint64_t the number of enabled coarse timers.
+   */
+  uint64_t size() const { return size_; }
+
+private:
+  void enable(CoarseTimerImpl& timer, std::chrono::milliseconds d);
+  void disable(CoarseTimerImpl& timer);
+  void link(CoarseTimerImpl*& list, CoarseTimerImpl& timer);
+  void unlink(CoarseTimerImpl& timer);
+  uint64_t currentTick() const;
+  void onTick();
+  void scheduleTick();
+  void expireSlot(uint64_t slot, uint64_t now_tick);
+
+  DispatcherImpl& dispatcher_;
+  MonotonicTimeSource& time_source_;
+  const MonotonicTime start_time_;
+  TimerPtr tick_timer_;
+  std::vector<CoarseTimerImpl*> slots_;
+  // The last tick whose slot has been expired.
+  uint64_t processed_tick_{};
+  uint64_t size_{};
+
+  friend class CoarseTimerImpl;
+  friend class TimerWheelTest;
+};
+
+} // namespace Event
+} // namespace Envoy
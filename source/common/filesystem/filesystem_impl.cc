@@ -2,15 +2,22 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <climits>
 #include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "envoy/common/exception.h"
 #include "envoy/event/dispatcher.h"
@@ -25,6 +32,20 @@
 namespace Envoy {
 namespace Filesystem {
 
+namespace {
+
+/**
+ * @return uint32_t a number that is handed out round robin to the threads that write files, and
+ *         that stays the same for each thread. It picks the write shard of the thread.
+ */
+uint32_t threadShardIndex() {
+  static std::atomic<uint32_t> next_index{};
+  static thread_local const uint32_t index = next_index++;
+  return index;
+}
+
+} // namespace
+
 bool fileExists(const std::string& path) {
   std::ifstream input_file(path);
   return input_file.is_open();
@@ -54,6 +75,38 @@ std::string fileReadToEnd(const std::string& path) {
   return file_string.str();
 }
 
+MappedFile::MappedFile(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    throw EnvoyException(fmt::format("unable to read file: {}", path));
+  }
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) != 0) {
+    ::close(fd);
+    throw EnvoyException(fmt::format("unable to read file: {}", path));
+  }
+  size_ = file_stat.st_size;
+  // An empty file cannot be mapped and has nothing to read anyway.
+  if (size_ > 0) {
+    void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      throw EnvoyException(fmt::format("unable to map file: {}", path));
+    }
+    // The whole file is about to be read.
+    ::madvise(data, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(data);
+  }
+  // The mapping stays valid once the descriptor is closed.
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    ::munmap(const_cast<char*>(data_), size_);
+  }
+}
+
 int OsSysCallsImpl::open(const std::string& full_path, int flags, int mode) {
   return ::open(full_path.c_str(), flags, mode);
 }
@@ -64,15 +117,23 @@ ssize_t OsSysCallsImpl::write(int fd, const void* buffer, size_t num_bytes) {
   return ::write(fd, buffer, num_bytes);
 }
 
+ssize_t OsSysCallsImpl::writev(int fd, const iovec* iov, int num_iov) {
+  return ::writev(fd, iov, num_iov);
+}
+
+const uint64_t FileImpl::DEFAULT_MAX_BUFFER_SIZE;
+const uint32_t FileImpl::NUM_WRITE_SHARDS;
+
 FileImpl::FileImpl(const std::string& path, Event::Dispatcher& dispatcher,
                    Thread::BasicLockable& lock, OsSysCalls& os_sys_calls, Stats::Store& stats_store,
-                   std::chrono::milliseconds flush_interval_msec)
+                   std::chrono::milliseconds flush_interval_msec, uint64_t max_buffer_size)
     : path_(path), flush_lock_(lock), flush_timer_(dispatcher.createTimer([this]() -> void {
         stats_.flushed_by_timer_.inc();
-        flush_event_.notify_one();
+        requestFlush();
         flush_timer_->enableTimer(flush_interval_msec_);
       })),
       os_sys_calls_(os_sys_calls), flush_interval_msec_(flush_interval_msec),
+      max_buffer_size_(max_buffer_size),
       stats_{FILESYSTEM_STATS(POOL_COUNTER_PREFIX(stats_store, "filesystem."),
                               POOL_GAUGE_PREFIX(stats_store, "filesystem."))} {
   open();
@@ -91,7 +152,7 @@ void FileImpl::reopen() { reopen_file_ = true; }
 
 FileImpl::~FileImpl() {
   {
-    std::unique_lock<std::mutex> lock(write_lock_);
+    std::unique_lock<std::mutex> lock(flush_thread_lock_);
     flush_thread_exit_ = true;
     flush_event_.notify_one();
   }
@@ -102,8 +163,9 @@ FileImpl::~FileImpl() {
 
   // Flush any remaining data. If file was not opened for some reason, skip flushing part.
   if (fd_ != -1) {
-    if (flush_buffer_.length() > 0) {
-      doWrite(flush_buffer_);
+    gatherShards();
+    if (about_to_write_buffer_.length() > 0) {
+      doWrite(about_to_write_buffer_);
     }
 
     os_sys_calls_.close(fd_);
@@ -114,6 +176,10 @@ void FileImpl::doWrite(Buffer::Instance& buffer) {
   uint64_t num_slices = buffer.getRawSlices(nullptr, 0);
   Buffer::RawSlice slices[num_slices];
   buffer.getRawSlices(slices, num_slices);
+  std::vector<iovec> iovecs(num_slices);
+  for (uint64_t i = 0; i < num_slices; i++) {
+    iovecs[i] = {slices[i].mem_, slices[i].len_};
+  }
 
   // We must do the actual writes to disk under lock, so that we don't intermix chunks from
   // different FileImpl pointing to the same underlying file. This can happen either via hot
@@ -124,10 +190,16 @@ void FileImpl::doWrite(Buffer::Instance& buffer) {
   //            actually flush to disk. In the future it would be nice if we did away with the cross
   //            process lock or had multiple locks.
   std::unique_lock<Thread::BasicLockable> lock(flush_lock_);
-  for (Buffer::RawSlice& slice : slices) {
-    ssize_t rc = os_sys_calls_.write(fd_, slice.mem_, slice.len_);
-    ASSERT(rc == static_cast<ssize_t>(slice.len_));
+  for (uint64_t i = 0; i < num_slices; i += IOV_MAX) {
+    const int num_iov = std::min<uint64_t>(num_slices - i, IOV_MAX);
+    uint64_t num_bytes = 0;
+    for (int j = 0; j < num_iov; j++) {
+      num_bytes += iovecs[i + j].iov_len;
+    }
+    ssize_t rc = os_sys_calls_.writev(fd_, &iovecs[i], num_iov);
+    ASSERT(rc == static_cast<ssize_t>(num_bytes));
     UNREFERENCED_PARAMETER(rc);
+    UNREFERENCED_PARAMETER(num_bytes);
     stats_.write_completed_.inc();
   }
   lock.unlock();
@@ -136,13 +208,24 @@ void FileImpl::doWrite(Buffer::Instance& buffer) {
   buffer.drain(buffer.length());
 }
 
+void FileImpl::gatherShards() {
+  for (WriteShard& shard : shards_) {
+    std::unique_lock<std::mutex> lock(shard.lock_);
+    const uint64_t length = shard.buffer_.length();
+    if (length > 0) {
+      about_to_write_buffer_.move(shard.buffer_);
+      buffered_bytes_ -= length;
+    }
+  }
+}
+
 void FileImpl::flushThreadFunc() {
-  std::unique_lock<std::mutex> lock(write_lock_);
+  std::unique_lock<std::mutex> lock(flush_thread_lock_);
 
   while (true) {
-    // flush_event_ can be woken up either by large enough flush_buffer or by timer.
-    // In case it was timer, flush_buffer_ can be empty.
-    while (flush_buffer_.length() == 0 && !flush_thread_exit_) {
+    // flush_event_ can be woken up either by large enough buffers or by timer.
+    // In case it was timer, the buffers can be empty.
+    while (!flush_requested_ && !flush_thread_exit_) {
       flush_event_.wait(lock);
     }
 
@@ -150,13 +233,12 @@ void FileImpl::flushThreadFunc() {
       return;
     }
 
-    ASSERT(flush_buffer_.length() > 0);
-    about_to_write_buffer_.move(flush_buffer_);
-    ASSERT(flush_buffer_.length() == 0);
+    flush_requested_ = false;
     lock.unlock();
 
+    gatherShards();
     // if we failed to open file before (-1 == fd_), then simply ignore
-    if (fd_ != -1) {
+    if (about_to_write_buffer_.length() > 0 && fd_ != -1) {
       try {
         if (reopen_file_) {
           reopen_file_ = false;
@@ -174,18 +256,34 @@ void FileImpl::flushThreadFunc() {
   }
 }
 
-void FileImpl::write(const std::string& data) {
-  std::unique_lock<std::mutex> lock(write_lock_);
+void FileImpl::requestFlush() {
+  // Only the first request wakes up the flush thread. The flag is set before taking the lock so
+  // that the flush thread either sees it or is already waiting when notified.
+  if (!flush_requested_.exchange(true)) {
+    std::unique_lock<std::mutex> lock(flush_thread_lock_);
+    flush_event_.notify_one();
+  }
+}
 
-  if (flush_thread_ == nullptr) {
-    createFlushStructures();
+void FileImpl::write(const std::string& data) {
+  const uint64_t buffered = (buffered_bytes_ += data.length());
+  if (buffered > max_buffer_size_) {
+    buffered_bytes_ -= data.length();
+    stats_.write_dropped_.inc();
+    return;
   }
 
+  {
+    WriteShard& shard = shards_[threadShardIndex() % NUM_WRITE_SHARDS];
+    std::unique_lock<std::mutex> lock(shard.lock_);
+    shard.buffer_.add(data);
+  }
   stats_.write_buffered_.inc();
   stats_.write_total_buffered_.add(data.length());
-  flush_buffer_.add(data);
-  if (flush_buffer_.length() > MIN_FLUSH_SIZE) {
-    flush_event_.notify_one();
+
+  std::call_once(flush_thread_once_, [this]() -> void { createFlushStructures(); });
+  if (buffered > MIN_FLUSH_SIZE) {
+    requestFlush();
   }
 }
 
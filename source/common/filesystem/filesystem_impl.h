@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
@@ -12,6 +13,7 @@
 #include "envoy/stats/stats_macros.h"
 
 #include "common/buffer/buffer_impl.h"
+#include "common/common/non_copyable.h"
 #include "common/common/thread.h"
 
 namespace Envoy {
@@ -21,6 +23,7 @@ namespace Envoy {
   COUNTER(write_completed)                                                                         \
   COUNTER(flushed_by_timer)                                                                        \
   COUNTER(reopen_failed)                                                                           \
+  COUNTER(write_dropped)                                                                           \
   GAUGE  (write_total_buffered)
 // clang-format on
 
@@ -46,11 +49,33 @@ bool directoryExists(const std::string& path);
  */
 std::string fileReadToEnd(const std::string& path);
 
+/**
+ * A file mapped read only into memory, so that large files can be parsed without being copied. The
+ * file should be replaced by moving a new file into place rather than be written to while mapped.
+ */
+class MappedFile : NonCopyable {
+public:
+  /**
+   * @param path supplies the path of the file.
+   * Throws EnvoyException if the file cannot be opened or mapped.
+   */
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  const char* data_{};
+  size_t size_{};
+};
+
 class OsSysCallsImpl : public OsSysCalls {
 public:
   // Filesystem::OsSysCalls
   int open(const std::string& full_path, int flags, int mode) override;
   ssize_t write(int fd, const void* buffer, size_t num_bytes) override;
+  ssize_t writev(int fd, const iovec* iov, int num_iov) override;
   int close(int fd) override;
 };
 
@@ -58,14 +83,20 @@ public:
  * This is a file implementation geared for writing out access logs. It turn out that in certain
  * cases even if a standard file is opened with O_NONBLOCK, the kernel can still block when writing.
  * This implementation uses a flush thread per file, with the idea there there aren't that many
- * files. If this turns out to be a good implementation we can potentially have a single flush
- * thread that flushes all files, but we will start with this.
+ * files. Writers fill one of several write buffers, picked per thread, so that the workers logging
+ * to the same file rarely contend. The flush thread gathers all of them and writes them to disk
+ * with writev(). Writes are dropped once too much data is waiting to be flushed, e.g. when the disk
+ * stalls, rather than letting the buffers grow without bound.
  */
 class FileImpl : public File {
 public:
+  // Default limit of the data waiting to be flushed.
+  static const uint64_t DEFAULT_MAX_BUFFER_SIZE = 64 * 1024 * 1024;
+
   FileImpl(const std::string& path, Event::Dispatcher& dispatcher, Thread::BasicLockable& lock,
            OsSysCalls& osSysCalls, Stats::Store& stats_store,
-           std::chrono::milliseconds flush_interval_msec);
+           std::chrono::milliseconds flush_interval_msec,
+           uint64_t max_buffer_size = DEFAULT_MAX_BUFFER_SIZE);
   ~FileImpl();
 
   // Filesystem::File
@@ -80,32 +111,47 @@ public:
   void reopen() override;
 
 private:
+  /**
+   * Write buffer filled by the threads that map to it.
+   */
+  struct WriteShard {
+    std::mutex lock_;
+    Buffer::OwnedImpl buffer_;
+  };
+
   void doWrite(Buffer::Instance& buffer);
   void flushThreadFunc();
+  void gatherShards();
   void open();
   void createFlushStructures();
+  void requestFlush();
 
   // Minimum size before the flush thread will be told to flush.
   static const uint64_t MIN_FLUSH_SIZE = 1024 * 64;
+  // Number of write buffers. Threads are assigned to them round robin.
+  static const uint32_t NUM_WRITE_SHARDS = 16;
 
   int fd_;
   std::string path_;
   Thread::BasicLockable& flush_lock_; // This lock is used only by the flush thread when writing
                                       // to disk. This is used to make sure that file blocks do
                                       // not get interleaved.
-  std::mutex write_lock_; // The lock is used when filling the flush buffer. It allows multiple
-                          // threads to write to the same file at relatively high performance.
-                          // It is always local to the process.
+  std::mutex flush_thread_lock_; // This lock is only used to wait for and signal flush_event_.
+  std::once_flag flush_thread_once_;
   Thread::ThreadPtr flush_thread_;
   std::condition_variable_any flush_event_;
   std::atomic<bool> flush_thread_exit_{};
+  // The first pass of the flush thread flushes whatever was written before it started.
+  std::atomic<bool> flush_requested_{true};
   std::atomic<bool> reopen_file_{};
-  Buffer::OwnedImpl flush_buffer_; // This buffer is used by multiple threads. It gets filled and
-                                   // then flushed either when max size is reached or when a timer
-                                   // fires.
+  std::array<WriteShard, NUM_WRITE_SHARDS> shards_; // These buffers are filled by the writers and
+                                                    // then moved by the flush thread either when
+                                                    // enough data is buffered or when a timer
+                                                    // fires.
+  std::atomic<uint64_t> buffered_bytes_{}; // Data in the shards, bounded by max_buffer_size_.
   Buffer::OwnedImpl about_to_write_buffer_; // This buffer is used only by the flush thread. Data
-                                            // is moved from flush_buffer_ under lock, and then
-                                            // the lock is released so that flush_buffer_ can
+                                            // is moved from the shards under their locks, and
+                                            // then the locks are released so that the shards can
                                             // continue to fill. This buffer is then used for the
                                             // final write to disk.
   Event::TimerPtr flush_timer_;
@@ -113,6 +159,7 @@ private:
   const std::chrono::milliseconds flush_interval_msec_; // Time interval buffer gets flushed no
                                                         // matter if it reached the MIN_FLUSH_SIZE
                                                         // or not.
+  const uint64_t max_buffer_size_;
   FileSystemStats stats_;
 };
 
@@ -1,7 +1,9 @@
 #include "common/filter/auth/client_ssl.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <string>
 
 #include "envoy/network/connection.h"
@@ -21,6 +23,108 @@ namespace Filter {
 namespace Auth {
 namespace ClientSsl {
 
+namespace {
+const Ssl::Sha256Digest ZERO_DIGEST{};
+
+int hexDigit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+} // namespace
+
+void AllowedPrincipals::add(const std::string& sha256_digest) {
+  Ssl::Sha256Digest digest;
+  if (sha256_digest.size() != digest.size() * 2) {
+    return;
+  }
+  for (size_t i = 0; i < digest.size(); i++) {
+    const int high = hexDigit(sha256_digest[i * 2]);
+    const int low = hexDigit(sha256_digest[i * 2 + 1]);
+    if (high < 0 || low < 0) {
+      return;
+    }
+    digest[i] = (high << 4) | low;
+  }
+  insert(digest);
+}
+
+uint64_t AllowedPrincipals::slotIndex(const Ssl::Sha256Digest& sha256_digest) const {
+  // The digest is already uniformly distributed, so any 8 bytes of it are a good hash.
+  uint64_t hash;
+  memcpy(&hash, sha256_digest.data(), sizeof(hash));
+  return hash & (slots_.size() - 1);
+}
+
+void AllowedPrincipals::insert(const Ssl::Sha256Digest& sha256_digest) {
+  if (sha256_digest == ZERO_DIGEST) {
+    if (!zero_digest_allowed_) {
+      zero_digest_allowed_ = true;
+      size_++;
+    }
+    return;
+  }
+
+  if ((size_ + 1) * 2 > slots_.size()) {
+    std::vector<Ssl::Sha256Digest> old_slots(std::max<size_t>(16, slots_.size() * 2));
+    old_slots.swap(slots_);
+    size_ = zero_digest_allowed_ ? 1 : 0;
+    for (const Ssl::Sha256Digest& digest : old_slots) {
+      if (digest != ZERO_DIGEST) {
+        insert(digest);
+      }
+    }
+  }
+
+  for (uint64_t i = slotIndex(sha256_digest);; i = (i + 1) & (slots_.size() - 1)) {
+    if (slots_[i] == sha256_digest) {
+      return;
+    }
+    if (slots_[i] == ZERO_DIGEST) {
+      slots_[i] = sha256_digest;
+      size_++;
+      return;
+    }
+  }
+}
+
+bool AllowedPrincipals::allowed(const Ssl::Sha256Digest& sha256_digest) const {
+  if (sha256_digest == ZERO_DIGEST) {
+    return zero_digest_allowed_;
+  }
+  if (slots_.empty()) {
+    return false;
+  }
+
+  for (uint64_t i = slotIndex(sha256_digest);; i = (i + 1) & (slots_.size() - 1)) {
+    if (slots_[i] == sha256_digest) {
+      return true;
+    }
+    if (slots_[i] == ZERO_DIGEST) {
+      return false;
+    }
+  }
+}
+
+bool AllowedPrincipals::operator==(const AllowedPrincipals& rhs) const {
+  if (size_ != rhs.size_ || zero_digest_allowed_ != rhs.zero_digest_allowed_) {
+    return false;
+  }
+  for (const Ssl::Sha256Digest& digest : slots_) {
+    if (digest != ZERO_DIGEST && !rhs.allowed(digest)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 Config::Config(const Json::Object& config, ThreadLocal::SlotAllocator& tls,
                Upstream::ClusterManager& cm, Event::Dispatcher& dispatcher, Stats::Scope& scope,
                Runtime::RandomGenerator& random)
@@ -37,6 +141,7 @@ Config::Config(const Json::Object& config, ThreadLocal::SlotAllocator& tls,
   }
 
   AllowedPrincipalsSharedPtr empty(new AllowedPrincipals());
+  principals_ = empty;
   tls_->set(
       [empty](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr { return empty; });
 }
@@ -60,14 +165,18 @@ GlobalStats Config::generateStats(Stats::Scope& scope, const std::string& prefix
 
 void Config::parseResponse(const Http::Message& message) {
   AllowedPrincipalsSharedPtr new_principals(new AllowedPrincipals());
-  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(message.bodyAsString());
+  Json::ObjectSharedPtr loader = parseJsonBody(message);
   for (const Json::ObjectSharedPtr& certificate : loader->getObjectArray("certificates")) {
     new_principals->add(certificate->getString("fingerprint_sha256"));
   }
 
-  tls_->set([new_principals](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
-    return new_principals;
-  });
+  // Most refreshes return the same principals, which then need not be posted to the workers.
+  if (!(*new_principals == *principals_)) {
+    principals_ = new_principals;
+    tls_->set([new_principals](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+      return new_principals;
+    });
+  }
 
   stats_.update_success_.inc();
   stats_.total_principals_.set(new_principals->size());
@@ -110,8 +219,9 @@ void Instance::onEvent(Network::ConnectionEvent event) {
     return;
   }
 
-  if (!config_->allowedPrincipals().allowed(
-          read_callbacks_->connection().ssl()->sha256PeerCertificateDigest())) {
+  Ssl::Sha256Digest digest;
+  if (!read_callbacks_->connection().ssl()->rawSha256PeerCertificateDigest(digest) ||
+      !config_->allowedPrincipals().allowed(digest)) {
     config_->stats().auth_digest_no_match_.inc();
     read_callbacks_->connection().close(Network::ConnectionCloseType::NoFlush);
     return;
@@ -3,10 +3,11 @@
 #include <cstdint>
 #include <memory>
 #include <string>
-#include <unordered_set>
+#include <vector>
 
 #include "envoy/network/filter.h"
 #include "envoy/runtime/runtime.h"
+#include "envoy/ssl/connection.h"
 #include "envoy/stats/stats_macros.h"
 #include "envoy/thread_local/thread_local.h"
 #include "envoy/upstream/cluster_manager.h"
@@ -43,22 +44,35 @@ struct GlobalStats {
 };
 
 /**
- * Wraps the principals currently allowed to authenticate.
+ * Wraps the principals currently allowed to authenticate, as the raw SHA256 digests of their
+ * certificates so that a peer certificate digest is looked up without hex encoding it.
  */
 class AllowedPrincipals : public ThreadLocal::ThreadLocalObject {
 public:
-  void add(const std::string& sha256_digest) {
-    if (!sha256_digest.empty()) {
-      allowed_sha256_digests_.emplace(sha256_digest);
-    }
-  }
-  bool allowed(const std::string& sha256_digest) const {
-    return allowed_sha256_digests_.count(sha256_digest) != 0;
-  }
-  size_t size() const { return allowed_sha256_digests_.size(); }
+  /**
+   * Add a principal.
+   * @param sha256_digest supplies the hex encoded SHA256 digest of the principal's certificate.
+   *        Strings that are not 64 hex digits are ignored.
+   */
+  void add(const std::string& sha256_digest);
+
+  bool allowed(const Ssl::Sha256Digest& sha256_digest) const;
+  size_t size() const { return size_; }
+
+  /**
+   * @return bool whether both sets allow the same principals.
+   */
+  bool operator==(const AllowedPrincipals& rhs) const;
 
 private:
-  std::unordered_set<std::string> allowed_sha256_digests_;
+  void insert(const Ssl::Sha256Digest& sha256_digest);
+  uint64_t slotIndex(const Ssl::Sha256Digest& sha256_digest) const;
+
+  // Open addressing with linear probing over a power of two number of slots, at most half of
+  // which are used. The all zero digest marks an empty slot so it is tracked on its own.
+  std::vector<Ssl::Sha256Digest> slots_;
+  bool zero_digest_allowed_{};
+  size_t size_{};
 };
 
 typedef std::shared_ptr<AllowedPrincipals> AllowedPrincipalsSharedPtr;
@@ -94,6 +108,7 @@ private:
   void onFetchFailure(const EnvoyException* e) override;
 
   ThreadLocal::SlotPtr tls_;
+  AllowedPrincipalsSharedPtr principals_;
   Network::Address::IpList ip_white_list_;
   GlobalStats stats_;
 };
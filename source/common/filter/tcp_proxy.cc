@@ -1,7 +1,9 @@
 #include "common/filter/tcp_proxy.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "envoy/buffer/buffer.h"
 #include "envoy/event/dispatcher.h"
@@ -12,6 +14,7 @@
 
 #include "common/common/assert.h"
 #include "common/common/empty_string.h"
+#include "common/common/macros.h"
 #include "common/json/config_schemas.h"
 #include "common/json/json_loader.h"
 
@@ -42,13 +45,39 @@ TcpProxyConfig::Route::Route(const Json::Object& config) {
   }
 }
 
+bool TcpProxyConfig::Route::matches(Network::Connection& connection) const {
+  if (!source_port_ranges_.empty() &&
+      !Network::Utility::portInRangeList(connection.remoteAddress(), source_port_ranges_)) {
+    return false;
+  }
+
+  if (!source_ips_.empty() && !source_ips_.contains(connection.remoteAddress())) {
+    return false;
+  }
+
+  if (!destination_port_ranges_.empty() &&
+      !Network::Utility::portInRangeList(connection.localAddress(), destination_port_ranges_)) {
+    return false;
+  }
+
+  if (!destination_ips_.empty() && !destination_ips_.contains(connection.localAddress())) {
+    return false;
+  }
+
+  // if we made it past all checks, the route matches
+  return true;
+}
+
 TcpProxyConfig::TcpProxyConfig(const Json::Object& config,
-                               Upstream::ClusterManager& cluster_manager, Stats::Scope& scope)
-    : stats_(generateStats(config.getString("stat_prefix"), scope)) {
+                               Upstream::ClusterManager& cluster_manager, Stats::Scope& scope,
+                               ThreadLocal::SlotAllocator& tls)
+    : stats_(generateStats(config.getString("stat_prefix"), scope)),
+      splice_(config.getBoolean("splice", false)) {
   config.validateSchema(Json::Schema::TCP_PROXY_NETWORK_FILTER_SCHEMA);
 
-  for (const Json::ObjectSharedPtr& route_desc :
-       config.getObject("route_config")->getObjectArray("routes")) {
+  const std::vector<Json::ObjectSharedPtr> route_descs =
+      config.getObject("route_config")->getObjectArray("routes");
+  for (const Json::ObjectSharedPtr& route_desc : route_descs) {
     routes_.emplace_back(Route(*route_desc));
 
     if (!cluster_manager.get(route_desc->getString("cluster"))) {
@@ -56,36 +85,161 @@ TcpProxyConfig::TcpProxyConfig(const Json::Object& config,
                                        route_desc->getString("cluster")));
     }
   }
+  buildRouteIndex(route_descs);
+
+  if (config.hasObject("upstream_pool")) {
+    Json::ObjectSharedPtr pool_config = config.getObject("upstream_pool");
+    const TcpProxyUpstreamPoolSettings settings{
+        static_cast<uint32_t>(pool_config->getInteger("size")),
+        std::chrono::milliseconds(pool_config->getInteger("idle_timeout_ms", 60000))};
+    upstream_pools_ = tls.allocateSlot();
+    upstream_pools_->set(
+        [&cluster_manager, settings](
+            Event::Dispatcher& dispatcher) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+          return std::make_shared<ThreadLocalUpstreamPools>(cluster_manager, dispatcher, settings);
+        });
+  }
 }
 
-const std::string& TcpProxyConfig::getRouteFromEntries(Network::Connection& connection) {
-  for (const TcpProxyConfig::Route& route : routes_) {
-    if (!route.source_port_ranges_.empty() &&
-        !Network::Utility::portInRangeList(connection.remoteAddress(), route.source_port_ranges_)) {
-      continue;
+const std::vector<uint32_t>& TcpProxyConfig::noRoutes() {
+  CONSTRUCT_ON_FIRST_USE(std::vector<uint32_t>);
+}
+
+const std::vector<std::string>& TcpProxyConfig::noTags() {
+  CONSTRUCT_ON_FIRST_USE(std::vector<std::string>);
+}
+
+void TcpProxyConfig::buildRouteIndex(const std::vector<Json::ObjectSharedPtr>& route_descs) {
+  std::vector<std::pair<std::string, std::vector<Network::Address::CidrRange>>> ip_tags;
+  std::vector<uint32_t> port_boundaries;
+  for (uint32_t index = 0; index < routes_.size(); index++) {
+    const Route& route = routes_[index];
+    if (route.destination_ips_.empty()) {
+      any_destination_ip_routes_.push_back(index);
+    } else {
+      // The route has already validated the list.
+      std::vector<Network::Address::CidrRange> ranges;
+      for (const std::string& entry : route_descs[index]->getStringArray("destination_ip_list")) {
+        ranges.push_back(Network::Address::CidrRange::create(entry));
+      }
+      ip_tags.emplace_back(std::to_string(index), std::move(ranges));
     }
 
-    if (!route.source_ips_.empty() && !route.source_ips_.contains(connection.remoteAddress())) {
-      continue;
+    if (route.destination_port_ranges_.empty()) {
+      any_destination_port_routes_.push_back(index);
+    } else {
+      for (const Network::PortRange& range : route.destination_port_ranges_) {
+        port_boundaries.push_back(range.min());
+        port_boundaries.push_back(range.max() + 1);
+      }
     }
+  }
+
+  if (!ip_tags.empty()) {
+    destination_ip_routes_.reset(new Network::Address::LcTrie(ip_tags));
+  }
 
-    if (!route.destination_port_ranges_.empty() &&
-        !Network::Utility::portInRangeList(connection.localAddress(),
-                                           route.destination_port_ranges_)) {
-      continue;
+  std::sort(port_boundaries.begin(), port_boundaries.end());
+  port_boundaries.erase(std::unique(port_boundaries.begin(), port_boundaries.end()),
+                        port_boundaries.end());
+  for (uint32_t boundary : port_boundaries) {
+    destination_port_routes_.push_back({boundary, {}});
+  }
+  for (uint32_t index = 0; index < routes_.size(); index++) {
+    for (const Network::PortRange& range : routes_[index].destination_port_ranges_) {
+      auto interval = std::lower_bound(
+          destination_port_routes_.begin(), destination_port_routes_.end(), range.min(),
+          [](const PortInterval& interval, uint32_t port) { return interval.min_port_ < port; });
+      for (; interval->min_port_ <= range.max(); interval++) {
+        // Ranges of the same route may overlap.
+        if (interval->routes_.empty() || interval->routes_.back() != index) {
+          interval->routes_.push_back(index);
+        }
+      }
     }
+  }
+}
 
-    if (!route.destination_ips_.empty() &&
-        !route.destination_ips_.contains(connection.localAddress())) {
-      continue;
+const std::vector<uint32_t>&
+TcpProxyConfig::destinationPortRoutes(const Network::Address::Instance& address) const {
+  if (address.type() != Network::Address::Type::Ip) {
+    return noRoutes();
+  }
+
+  const uint32_t port = address.ip()->port();
+  auto interval = std::upper_bound(
+      destination_port_routes_.begin(), destination_port_routes_.end(), port,
+      [](uint32_t port, const PortInterval& interval) { return port < interval.min_port_; });
+  return interval == destination_port_routes_.begin() ? noRoutes() : (interval - 1)->routes_;
+}
+
+template <class RouteIndexes>
+const TcpProxyConfig::Route*
+TcpProxyConfig::firstMatchingRoute(const RouteIndexes& indexed,
+                                   const std::vector<uint32_t>& unindexed,
+                                   Network::Connection& connection) const {
+  // Both lists are in route order, and are merged so that the first route that matches wins.
+  auto next_indexed = indexed.begin();
+  auto next_unindexed = unindexed.begin();
+  while (next_indexed != indexed.end() || next_unindexed != unindexed.end()) {
+    uint32_t index;
+    if (next_unindexed == unindexed.end() ||
+        (next_indexed != indexed.end() && routeIndex(*next_indexed) < *next_unindexed)) {
+      index = routeIndex(*next_indexed++);
+    } else {
+      index = *next_unindexed++;
     }
 
-    // if we made it past all checks, the route matches
-    return route.cluster_name_;
+    if (routes_[index].matches(connection)) {
+      return &routes_[index];
+    }
+  }
+
+  return nullptr;
+}
+
+const std::string& TcpProxyConfig::getRouteFromEntries(Network::Connection& connection) {
+  // The destination is only looked up in the indexes that have routes.
+  const std::vector<std::string>& ip_routes =
+      destination_ip_routes_ ? destination_ip_routes_->getData(connection.localAddress())
+                             : noTags();
+  const std::vector<uint32_t>& port_routes = destination_port_routes_.empty()
+                                                 ? noRoutes()
+                                                 : destinationPortRoutes(connection.localAddress());
+
+  // Either index yields every route that may match, so the one with fewer candidates is used.
+  const Route* route;
+  if (ip_routes.size() + any_destination_ip_routes_.size() <=
+      port_routes.size() + any_destination_port_routes_.size()) {
+    route = firstMatchingRoute(ip_routes, any_destination_ip_routes_, connection);
+  } else {
+    route = firstMatchingRoute(port_routes, any_destination_port_routes_, connection);
   }
 
   // no match, no more routes to try
-  return EMPTY_STRING;
+  return route != nullptr ? route->cluster_name_ : EMPTY_STRING;
+}
+
+Upstream::Host::CreateConnectionData
+TcpProxyConfig::takeUpstreamConnection(const std::string& cluster_name) {
+  if (!upstream_pools_) {
+    return {};
+  }
+
+  ThreadLocalUpstreamPools& pools = upstream_pools_->getTyped<ThreadLocalUpstreamPools>();
+  TcpProxyUpstreamPoolPtr& pool = pools.pools_[cluster_name];
+  if (!pool) {
+    pool.reset(new TcpProxyUpstreamPool(pools.cluster_manager_, cluster_name, pools.dispatcher_,
+                                        pools.settings_));
+  }
+
+  Upstream::Host::CreateConnectionData conn_info = pool->take();
+  if (conn_info.connection_) {
+    stats_.downstream_cx_upstream_pool_hit_.inc();
+  } else {
+    stats_.downstream_cx_upstream_pool_miss_.inc();
+  }
+  return conn_info;
 }
 
 TcpProxy::TcpProxy(TcpProxyConfigSharedPtr config, Upstream::ClusterManager& cluster_manager)
@@ -197,6 +351,14 @@ Network::FilterStatus TcpProxy::initializeUpstreamConnection() {
     return Network::FilterStatus::StopIteration;
   }
 
+  // The WsHandlerImpl class uses TCP Proxy code with a null config.
+  if (config_) {
+    Upstream::Host::CreateConnectionData pooled = config_->takeUpstreamConnection(cluster_name);
+    if (pooled.connection_) {
+      return initializePooledUpstreamConnection(std::move(pooled));
+    }
+  }
+
   Upstream::ClusterInfoConstSharedPtr cluster = thread_local_cluster->info();
   if (!cluster->resourceManager(Upstream::ResourcePriority::Default).connections().canCreate()) {
     cluster->stats().upstream_cx_overflow_.inc();
@@ -242,6 +404,24 @@ Network::FilterStatus TcpProxy::initializeUpstreamConnection() {
   return Network::FilterStatus::Continue;
 }
 
+Network::FilterStatus
+TcpProxy::initializePooledUpstreamConnection(Upstream::Host::CreateConnectionData&& conn_info) {
+  ENVOY_CONN_LOG(debug, "using pooled upstream connection", read_callbacks_->connection());
+  // The pool has already connected, and accounted for, the connection.
+  upstream_connection_ = std::move(conn_info.connection_);
+  read_callbacks_->upstreamHost(conn_info.host_description_);
+  onUpstreamHostReady();
+  upstream_connection_->addReadFilter(upstream_callbacks_);
+  upstream_connection_->addConnectionCallbacks(*upstream_callbacks_);
+  // Whatever the upstream sent while the connection was pooled is read now.
+  upstream_connection_->readDisable(false);
+  connected_timespan_ =
+      read_callbacks_->upstreamHost()->cluster().stats().upstream_cx_length_ms_.allocateSpan();
+
+  onUpstreamConnected();
+  return Network::FilterStatus::Continue;
+}
+
 void TcpProxy::onConnectTimeout() {
   ENVOY_CONN_LOG(debug, "connect timeout", read_callbacks_->connection());
   read_callbacks_->upstreamHost()->cluster().stats().upstream_cx_connect_timeout_.inc();
@@ -274,6 +454,15 @@ void TcpProxy::onUpstreamData(Buffer::Instance& data) {
   ASSERT(0 == data.length());
 }
 
+void TcpProxy::onUpstreamConnected() {
+  // Splicing falls back to the filters for TLS, for other filters, and without splice(2).
+  if (config_ && config_->splice() &&
+      upstream_connection_->spliceWith(read_callbacks_->connection())) {
+    config_->stats().downstream_cx_spliced_.inc();
+  }
+  onConnectionSuccess();
+}
+
 void TcpProxy::onUpstreamEvent(Network::ConnectionEvent event) {
   if (event == Network::ConnectionEvent::RemoteClose) {
     read_callbacks_->upstreamHost()->cluster().stats().upstream_cx_destroy_remote_.inc();
@@ -292,7 +481,7 @@ void TcpProxy::onUpstreamEvent(Network::ConnectionEvent event) {
     onConnectionFailure();
   } else if (event == Network::ConnectionEvent::Connected) {
     connect_timespan_->complete();
-    onConnectionSuccess();
+    onUpstreamConnected();
   }
 
   if (connect_timeout_timer_) {
@@ -3,19 +3,23 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "envoy/event/timer.h"
 #include "envoy/network/connection.h"
 #include "envoy/network/filter.h"
 #include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
 #include "envoy/upstream/cluster_manager.h"
 #include "envoy/upstream/upstream.h"
 
 #include "common/common/logger.h"
+#include "common/filter/tcp_proxy_upstream_pool.h"
 #include "common/json/json_loader.h"
 #include "common/network/cidr_range.h"
 #include "common/network/filter_impl.h"
+#include "common/network/lc_trie.h"
 #include "common/network/utility.h"
 
 namespace Envoy {
@@ -32,6 +36,9 @@ namespace Filter {
   GAUGE  (downstream_cx_tx_bytes_buffered)                                                         \
   COUNTER(downstream_cx_total)                                                                     \
   COUNTER(downstream_cx_no_route)                                                                  \
+  COUNTER(downstream_cx_spliced)                                                                   \
+  COUNTER(downstream_cx_upstream_pool_hit)                                                         \
+  COUNTER(downstream_cx_upstream_pool_miss)                                                        \
   COUNTER(downstream_flow_control_paused_reading_total)                                            \
   COUNTER(downstream_flow_control_resumed_reading_total)
 // clang-format on
@@ -49,7 +56,7 @@ struct TcpProxyStats {
 class TcpProxyConfig {
 public:
   TcpProxyConfig(const Json::Object& config, Upstream::ClusterManager& cluster_manager,
-                 Stats::Scope& scope);
+                 Stats::Scope& scope, ThreadLocal::SlotAllocator& tls);
 
   /**
    * Find out which cluster an upstream connection should be opened to based on the
@@ -63,10 +70,30 @@ public:
 
   const TcpProxyStats& stats() { return stats_; }
 
+  /**
+   * @return bool whether the data of plaintext connections is to be spliced in the kernel, see
+   *         Network::Connection::spliceWith().
+   */
+  bool splice() const { return splice_; }
+
+  /**
+   * Take an established connection to a cluster from the upstream pool of the calling worker,
+   * @see TcpProxyUpstreamPool::take().
+   * @param cluster_name supplies the cluster to connect to.
+   * @return Upstream::Host::CreateConnectionData the connection and its host, which are both
+   *         nullptr when there is no upstream pool or it has no established connection.
+   */
+  Upstream::Host::CreateConnectionData takeUpstreamConnection(const std::string& cluster_name);
+
 private:
   struct Route {
     Route(const Json::Object& config);
 
+    /**
+     * @return bool whether the downstream connection meets all the criteria of the route.
+     */
+    bool matches(Network::Connection& connection) const;
+
     Network::Address::IpList source_ips_;
     Network::PortRangeList source_port_ranges_;
     Network::Address::IpList destination_ips_;
@@ -74,10 +101,53 @@ private:
     std::string cluster_name_;
   };
 
+  // The upstream pools of a worker, by cluster name.
+  struct ThreadLocalUpstreamPools : public ThreadLocal::ThreadLocalObject {
+    ThreadLocalUpstreamPools(Upstream::ClusterManager& cluster_manager,
+                             Event::Dispatcher& dispatcher,
+                             const TcpProxyUpstreamPoolSettings& settings)
+        : cluster_manager_(cluster_manager), dispatcher_(dispatcher), settings_(settings) {}
+
+    Upstream::ClusterManager& cluster_manager_;
+    Event::Dispatcher& dispatcher_;
+    const TcpProxyUpstreamPoolSettings settings_;
+    std::unordered_map<std::string, TcpProxyUpstreamPoolPtr> pools_;
+  };
+
+  // The start of an interval of destination ports, and the indexes of the routes, in order, whose
+  // destination ports contain the interval. An interval ends where the next one starts.
+  struct PortInterval {
+    uint32_t min_port_;
+    std::vector<uint32_t> routes_;
+  };
+
   static TcpProxyStats generateStats(const std::string& name, Stats::Scope& scope);
+  static const std::vector<uint32_t>& noRoutes();
+  static const std::vector<std::string>& noTags();
+  static uint32_t routeIndex(uint32_t index) { return index; }
+  static uint32_t routeIndex(const std::string& tag) { return std::stoul(tag); }
+
+  void buildRouteIndex(const std::vector<Json::ObjectSharedPtr>& route_descs);
+  const std::vector<uint32_t>&
+  destinationPortRoutes(const Network::Address::Instance& address) const;
+  template <class RouteIndexes>
+  const Route* firstMatchingRoute(const RouteIndexes& indexed,
+                                  const std::vector<uint32_t>& unindexed,
+                                  Network::Connection& connection) const;
 
   std::vector<Route> routes_;
+  // The routes are indexed by their destination IP lists and by their destination ports, so that
+  // a connection only has to be matched against the routes that may apply to its destination.
+  // The tags of the trie are the indexes of the routes with destination IP lists. The trie is
+  // nullptr if no route has one.
+  std::unique_ptr<const Network::Address::LcTrie> destination_ip_routes_;
+  std::vector<uint32_t> any_destination_ip_routes_;
+  std::vector<PortInterval> destination_port_routes_;
+  std::vector<uint32_t> any_destination_port_routes_;
   const TcpProxyStats stats_;
+  const bool splice_;
+  // Only allocated when upstream pooling is configured.
+  ThreadLocal::SlotPtr upstream_pools_;
 };
 
 typedef std::shared_ptr<TcpProxyConfig> TcpProxyConfigSharedPtr;
@@ -104,6 +174,7 @@ public:
   const Network::Connection* downstreamConnection() const override {
     return &read_callbacks_->connection();
   }
+  const Upstream::MetadataMatchCriteria* metadataMatchCriteria() const override { return nullptr; }
 
   // These two functions allow enabling/disabling reads on the upstream and downstream connections.
   // They are called by the Downstream/Upstream Watermark callbacks to limit buffering.
@@ -163,6 +234,9 @@ protected:
   virtual void onUpstreamHostReady() {}
 
   Network::FilterStatus initializeUpstreamConnection();
+  Network::FilterStatus initializePooledUpstreamConnection(
+      Upstream::Host::CreateConnectionData&& conn_info);
+  void onUpstreamConnected();
   void onConnectTimeout();
   void onDownstreamEvent(Network::ConnectionEvent event);
   void onUpstreamData(Buffer::Instance& data);
@@ -0,0 +1,146 @@
+#include "common/filter/tcp_proxy_upstream_pool.h"
+
+#include <list>
+#include <memory>
+#include <string>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Filter {
+
+TcpProxyUpstreamPool::PooledConnection::PooledConnection(
+    TcpProxyUpstreamPool& parent, Upstream::Host::CreateConnectionData&& data)
+    : parent_(parent), connection_(std::move(data.connection_)),
+      host_(std::move(data.host_description_)),
+      timer_(parent.dispatcher_.createTimer([this]() -> void { parent_.onTimeout(*this); })) {}
+
+TcpProxyUpstreamPool::TcpProxyUpstreamPool(Upstream::ClusterManager& cluster_manager,
+                                           const std::string& cluster_name,
+                                           Event::Dispatcher& dispatcher,
+                                           const TcpProxyUpstreamPoolSettings& settings)
+    : cluster_manager_(cluster_manager), cluster_name_(cluster_name), dispatcher_(dispatcher),
+      settings_(settings) {}
+
+TcpProxyUpstreamPool::~TcpProxyUpstreamPool() {
+  for (std::list<PooledConnectionPtr>* list : {&connecting_, &ready_}) {
+    for (const PooledConnectionPtr& pooled : *list) {
+      pooled->connection_->removeConnectionCallbacks(*pooled);
+      pooled->connection_->close(Network::ConnectionCloseType::NoFlush);
+      release(*pooled);
+    }
+  }
+}
+
+Upstream::Host::CreateConnectionData TcpProxyUpstreamPool::take() {
+  if (ready_.empty()) {
+    fill();
+    return {};
+  }
+
+  PooledConnectionPtr pooled = ready_.front()->removeFromList(ready_);
+  pooled->timer_->disableTimer();
+  pooled->connection_->removeConnectionCallbacks(*pooled);
+  Upstream::Host::CreateConnectionData data{std::move(pooled->connection_), pooled->host_};
+  ENVOY_LOG(debug, "took pooled connection to {} of cluster {}",
+            data.host_description_->address()->asString(), cluster_name_);
+
+  fill();
+  return data;
+}
+
+void TcpProxyUpstreamPool::fill() {
+  Upstream::ThreadLocalCluster* cluster = cluster_manager_.get(cluster_name_);
+  if (cluster == nullptr) {
+    return;
+  }
+
+  Upstream::ClusterInfoConstSharedPtr info = cluster->info();
+  while (connecting_.size() + ready_.size() < settings_.size_) {
+    if (!info->resourceManager(Upstream::ResourcePriority::Default).connections().canCreate()) {
+      info->stats().upstream_cx_overflow_.inc();
+      return;
+    }
+
+    Upstream::Host::CreateConnectionData data =
+        cluster_manager_.tcpConnForCluster(cluster_name_, nullptr);
+    if (!data.connection_) {
+      return;
+    }
+
+    PooledConnectionPtr pooled(new PooledConnection(*this, std::move(data)));
+    PooledConnection& entry = *pooled;
+    pooled->moveIntoList(std::move(pooled), connecting_);
+
+    // The same accounting as for the connections of the TCP proxy itself, which takes it over.
+    const Upstream::ClusterInfo& host_cluster = entry.host_->cluster();
+    host_cluster.resourceManager(Upstream::ResourcePriority::Default).connections().inc();
+    entry.connection_->addConnectionCallbacks(entry);
+    entry.connection_->setConnectionStats({host_cluster.stats().upstream_cx_rx_bytes_total_,
+                                           host_cluster.stats().upstream_cx_rx_bytes_buffered_,
+                                           host_cluster.stats().upstream_cx_tx_bytes_total_,
+                                           host_cluster.stats().upstream_cx_tx_bytes_buffered_,
+                                           &host_cluster.stats().bind_errors_});
+    entry.connection_->readDisable(true);
+    entry.connection_->connect();
+    entry.connection_->noDelay(true);
+    entry.timer_->enableTimer(host_cluster.connectTimeout());
+
+    host_cluster.stats().upstream_cx_total_.inc();
+    host_cluster.stats().upstream_cx_active_.inc();
+    entry.host_->stats().cx_total_.inc();
+    entry.host_->stats().cx_active_.inc();
+    entry.connect_timespan_ = host_cluster.stats().upstream_cx_connect_ms_.allocateSpan();
+  }
+}
+
+void TcpProxyUpstreamPool::onEvent(PooledConnection& pooled, Network::ConnectionEvent event) {
+  const bool connecting = !pooled.connected_;
+  if (event == Network::ConnectionEvent::Connected) {
+    ASSERT(connecting);
+    pooled.connected_ = true;
+    pooled.connect_timespan_->complete();
+    pooled.moveBetweenLists(connecting_, ready_);
+    pooled.timer_->enableTimer(settings_.idle_timeout_);
+    return;
+  }
+
+  const Upstream::ClusterInfo& host_cluster = pooled.host_->cluster();
+  if (event == Network::ConnectionEvent::RemoteClose) {
+    host_cluster.stats().upstream_cx_destroy_remote_.inc();
+    if (connecting) {
+      host_cluster.stats().upstream_cx_connect_fail_.inc();
+      pooled.host_->stats().cx_connect_fail_.inc();
+    }
+  } else {
+    host_cluster.stats().upstream_cx_destroy_local_.inc();
+  }
+
+  pooled.timer_->disableTimer();
+  release(pooled);
+  dispatcher_.deferredDelete(pooled.removeFromList(connecting ? connecting_ : ready_));
+}
+
+void TcpProxyUpstreamPool::onTimeout(PooledConnection& pooled) {
+  if (!pooled.connected_) {
+    pooled.host_->cluster().stats().upstream_cx_connect_timeout_.inc();
+    pooled.connection_->close(Network::ConnectionCloseType::NoFlush);
+    return;
+  }
+
+  ENVOY_LOG(debug, "replacing idle pooled connection to {} of cluster {}",
+            pooled.host_->address()->asString(), cluster_name_);
+  pooled.connection_->close(Network::ConnectionCloseType::NoFlush);
+  fill();
+}
+
+void TcpProxyUpstreamPool::release(PooledConnection& pooled) {
+  const Upstream::ClusterInfo& host_cluster = pooled.host_->cluster();
+  host_cluster.stats().upstream_cx_destroy_.inc();
+  host_cluster.stats().upstream_cx_active_.dec();
+  pooled.host_->stats().cx_active_.dec();
+  host_cluster.resourceManager(Upstream::ResourcePriority::Default).connections().dec();
+}
+
+} // namespace Filter
+} // namespace Envoy
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+
+#include "envoy/event/deferred_deletable.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "envoy/network/connection.h"
+#include "envoy/stats/stats.h"
+#include "envoy/upstream/cluster_manager.h"
+#include "envoy/upstream/upstream.h"
+
+#include "common/common/linked_object.h"
+#include "common/common/logger.h"
+
+namespace Envoy {
+namespace Filter {
+
+/**
+ * Settings of the pools of pre-connected TCP proxy upstream connections.
+ */
+struct TcpProxyUpstreamPoolSettings {
+  // The number of connections that a pool keeps established or connecting.
+  uint32_t size_;
+  // How long a connection may wait in a pool before it is replaced.
+  std::chrono::milliseconds idle_timeout_;
+};
+
+/**
+ * A pool of established upstream connections to a cluster, for the TCP proxy filters of one
+ * worker, so that the first bytes of a downstream connection don't wait for an upstream handshake.
+ * The pool starts filling when the first connection is taken from it, and starts a replacement for
+ * each connection taken, or replaced after the idle timeout. A connection that fails or is closed
+ * by the upstream is replaced on the next take, so an unreachable cluster is not retried in a
+ * loop. Pooled connections are read disabled, so that data the upstream sends first waits in the
+ * kernel for the downstream connection that takes it. The hosts of pooled connections are chosen
+ * without a load balancer context, so hash based load balancing doesn't apply to them.
+ */
+class TcpProxyUpstreamPool : Logger::Loggable<Logger::Id::pool> {
+public:
+  TcpProxyUpstreamPool(Upstream::ClusterManager& cluster_manager, const std::string& cluster_name,
+                       Event::Dispatcher& dispatcher, const TcpProxyUpstreamPoolSettings& settings);
+  ~TcpProxyUpstreamPool();
+
+  /**
+   * Take an established connection out of the pool. The connection is read disabled, its
+   * connection stats are set, and it is already accounted in the stats and the connection
+   * resource of the cluster, so that the caller only has to release them when it is done.
+   * @return Upstream::Host::CreateConnectionData the connection and its host, which are both
+   *         nullptr when no connection is established yet.
+   */
+  Upstream::Host::CreateConnectionData take();
+
+private:
+  struct PooledConnection : public Network::ConnectionCallbacks,
+                            public Event::DeferredDeletable,
+                            public LinkedObject<PooledConnection> {
+    PooledConnection(TcpProxyUpstreamPool& parent, Upstream::Host::CreateConnectionData&& data);
+
+    // Network::ConnectionCallbacks
+    void onEvent(Network::ConnectionEvent event) override { parent_.onEvent(*this, event); }
+    void onAboveWriteBufferHighWatermark() override {}
+    void onBelowWriteBufferLowWatermark() override {}
+
+    TcpProxyUpstreamPool& parent_;
+    Network::ClientConnectionPtr connection_;
+    Upstream::HostDescriptionConstSharedPtr host_;
+    // The connect timeout while connecting, and then the idle timeout.
+    Event::TimerPtr timer_;
+    Stats::TimespanPtr connect_timespan_;
+    bool connected_{};
+  };
+
+  typedef std::unique_ptr<PooledConnection> PooledConnectionPtr;
+
+  void fill();
+  void onEvent(PooledConnection& pooled, Network::ConnectionEvent event);
+  void onTimeout(PooledConnection& pooled);
+  // Undo the accounting of a connection that is closed while it is pooled.
+  void release(PooledConnection& pooled);
+
+  Upstream::ClusterManager& cluster_manager_;
+  const std::string cluster_name_;
+  Event::Dispatcher& dispatcher_;
+  const TcpProxyUpstreamPoolSettings settings_;
+  std::list<PooledConnectionPtr> connecting_;
+  std::list<PooledConnectionPtr> ready_;
+};
+
+typedef std::unique_ptr<TcpProxyUpstreamPool> TcpProxyUpstreamPoolPtr;
+
+} // namespace Filter
+} // namespace Envoy
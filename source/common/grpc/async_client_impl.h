@@ -5,10 +5,12 @@
 #include "common/buffer/zero_copy_input_stream_impl.h"
 #include "common/common/enum_to_int.h"
 #include "common/common/linked_object.h"
+#include "common/compressor/zlib_decompressor_impl.h"
 #include "common/grpc/codec.h"
 #include "common/grpc/common.h"
 #include "common/http/async_client_impl.h"
 #include "common/http/header_map_impl.h"
+#include "common/http/headers.h"
 #include "common/http/utility.h"
 
 namespace Envoy {
@@ -17,11 +19,25 @@ namespace Grpc {
 template <class RequestType, class ResponseType> class AsyncStreamImpl;
 template <class RequestType, class ResponseType> class AsyncRequestImpl;
 
+/**
+ * gRPC client on top of the HTTP async client of a cluster. Its streams share the HTTP/2
+ * connections of the cluster with any other stream that the same thread opens to it.
+ */
 template <class RequestType, class ResponseType>
 class AsyncClientImpl final : public AsyncClient<RequestType, ResponseType> {
 public:
-  AsyncClientImpl(Upstream::ClusterManager& cm, const std::string& remote_cluster_name)
-      : cm_(cm), remote_cluster_name_(remote_cluster_name) {}
+  /**
+   * @param cm supplies the cluster manager to get the HTTP async client of the cluster from.
+   * @param remote_cluster_name supplies the name of the cluster.
+   * @param accept_compression supplies the compression that the streams advertise in
+   *        grpc-accept-encoding, so that the server may compress the messages that it sends.
+   *        Compressed messages are decompressed whatever was advertised, and messages are always
+   *        sent uncompressed.
+   */
+  AsyncClientImpl(Upstream::ClusterManager& cm, const std::string& remote_cluster_name,
+                  CompressionAlgorithm accept_compression = CompressionAlgorithm::None)
+      : cm_(cm), remote_cluster_name_(remote_cluster_name),
+        accept_compression_(accept_compression) {}
 
   ~AsyncClientImpl() override {
     while (!active_streams_.empty()) {
@@ -65,6 +81,7 @@ public:
 private:
   Upstream::ClusterManager& cm_;
   const std::string remote_cluster_name_;
+  const CompressionAlgorithm accept_compression_;
   std::list<std::unique_ptr<AsyncStreamImpl<RequestType, ResponseType>>> active_streams_;
 
   friend class AsyncStreamImpl<RequestType, ResponseType>;
@@ -97,6 +114,10 @@ public:
     headers_message_ =
         Common::prepareHeaders(parent_.remote_cluster_name_, service_method_.service()->full_name(),
                                service_method_.name());
+    if (parent_.accept_compression_ == CompressionAlgorithm::Gzip) {
+      headers_message_->headers().insertGrpcAcceptEncoding().value().setReference(
+          Http::Headers::get().GrpcAcceptEncodingValues.Gzip);
+    }
     callbacks_.onCreateInitialMetadata(headers_message_->headers());
     stream_->sendHeaders(headers_message_->headers(), false);
   }
@@ -119,6 +140,12 @@ public:
       onTrailers(std::move(headers));
       return;
     }
+    const Http::HeaderEntry* grpc_encoding = headers->GrpcEncoding();
+    if (grpc_encoding != nullptr &&
+        grpc_encoding->value() == Http::Headers::get().GrpcEncodingValues.Gzip.c_str()) {
+      decompressor_.reset(
+          new Compressor::ZlibDecompressorImpl(15, GRPC_MAX_DECOMPRESSED_MESSAGE_SIZE));
+    }
     callbacks_.onReceiveInitialMetadata(std::move(headers));
   }
 
@@ -137,11 +164,14 @@ public:
 
     for (auto& frame : decoded_frames_) {
       std::unique_ptr<ResponseType> response(new ResponseType());
-      // TODO(htuch): Need to add support for compressed responses as well here.
       if (frame.length_ > 0) {
+        if (frame.flags_ == GRPC_FH_COMPRESSED && !decompress(*frame.data_)) {
+          streamError(Status::GrpcStatus::Internal);
+          return;
+        }
         Buffer::ZeroCopyInputStreamImpl stream(std::move(frame.data_));
 
-        if (frame.flags_ != GRPC_FH_DEFAULT || !response->ParseFromZeroCopyStream(&stream)) {
+        if (!response->ParseFromZeroCopyStream(&stream)) {
           streamError(Status::GrpcStatus::Internal);
           return;
         }
@@ -209,6 +239,16 @@ private:
 
   void streamError(Status::GrpcStatus grpc_status) { streamError(grpc_status, EMPTY_STRING); }
 
+  bool decompress(Buffer::Instance& data) {
+    // Only a stream whose response headers declare gzip may send compressed messages.
+    if (decompressor_ == nullptr) {
+      return false;
+    }
+    // Each message is compressed on its own.
+    decompressor_->reset();
+    return decompressor_->decompress(data) && decompressor_->finished();
+  }
+
   void cleanup() {
     if (!http_reset_) {
       http_reset_ = true;
@@ -251,6 +291,7 @@ private:
   bool http_reset_{};
   Http::AsyncClient::Stream* stream_{};
   Decoder decoder_;
+  Compressor::DecompressorPtr decompressor_;
   // This is a member to avoid reallocation on every onData().
   std::vector<Frame> decoded_frames_;
 
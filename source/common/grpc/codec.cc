@@ -1,10 +1,12 @@
 #include "common/grpc/codec.h"
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <vector>
 
 #include "common/buffer/buffer_impl.h"
+#include "common/common/assert.h"
 
 namespace Envoy {
 namespace Grpc {
@@ -19,82 +21,133 @@ void Encoder::newFrame(uint8_t flags, uint64_t length, std::array<uint8_t, 5>& o
   output[4] = static_cast<uint8_t>(length);
 }
 
+const uint32_t Decoder::FH_SIZE;
+
 Decoder::Decoder() : state_(State::FH_FLAG) {}
 
 bool Decoder::decode(Buffer::Instance& input, std::vector<Frame>& output) {
+  // Check the whole input first, so that it is left unchanged on error.
+  if (!validate(input)) {
+    return false;
+  }
+
+  while (input.length() > 0) {
+    if (state_ == State::DATA) {
+      const uint64_t remain_in_frame = frame_.length_ - frame_.data_->length();
+      frame_.data_->move(input, std::min(remain_in_frame, input.length()));
+      if (frame_.length_ == frame_.data_->length()) {
+        output.push_back(std::move(frame_));
+        frame_.flags_ = 0;
+        frame_.length_ = 0;
+        state_ = State::FH_FLAG;
+      }
+      continue;
+    }
+
+    // The rest of the header is read at once, as the states are in header order. Linearizing
+    // these few bytes only copies when the header spans slices.
+    const uint32_t header_size =
+        std::min<uint64_t>(FH_SIZE - static_cast<uint32_t>(state_), input.length());
+    const uint8_t* header = static_cast<const uint8_t*>(input.linearize(header_size));
+    for (uint32_t i = 0; i < header_size; i++) {
+      onHeaderByte(header[i], output);
+    }
+    input.drain(header_size);
+  }
+  return true;
+}
+
+bool Decoder::validate(const Buffer::Instance& input) const {
+  State state = state_;
+  uint32_t length = frame_.length_;
+  uint64_t remain_in_frame = state_ == State::DATA ? frame_.length_ - frame_.data_->length() : 0;
+
   uint64_t count = input.getRawSlices(nullptr, 0);
   Buffer::RawSlice slices[count];
   input.getRawSlices(slices, count);
-  for (Buffer::RawSlice& slice : slices) {
-    uint8_t* mem = reinterpret_cast<uint8_t*>(slice.mem_);
-    for (uint64_t j = 0; j < slice.len_;) {
-      uint8_t c = *mem;
-      switch (state_) {
+  for (const Buffer::RawSlice& slice : slices) {
+    const uint8_t* mem = reinterpret_cast<const uint8_t*>(slice.mem_);
+    uint64_t remain_in_slice = slice.len_;
+    while (remain_in_slice > 0) {
+      if (state == State::DATA) {
+        // Only the headers are checked, the data is skipped.
+        const uint64_t skip = std::min(remain_in_slice, remain_in_frame);
+        mem += skip;
+        remain_in_slice -= skip;
+        remain_in_frame -= skip;
+        if (remain_in_frame == 0) {
+          state = State::FH_FLAG;
+        }
+        continue;
+      }
+
+      const uint8_t c = *mem++;
+      remain_in_slice--;
+      switch (state) {
       case State::FH_FLAG:
         if (c & ~GRPC_FH_COMPRESSED) {
           // Unsupported flags.
           return false;
         }
-        frame_.flags_ = c;
-        state_ = State::FH_LEN_0;
-        mem++;
-        j++;
+        state = State::FH_LEN_0;
         break;
       case State::FH_LEN_0:
-        frame_.length_ = static_cast<uint32_t>(c) << 24;
-        state_ = State::FH_LEN_1;
-        mem++;
-        j++;
+        length = static_cast<uint32_t>(c) << 24;
+        state = State::FH_LEN_1;
         break;
       case State::FH_LEN_1:
-        frame_.length_ |= static_cast<uint32_t>(c) << 16;
-        state_ = State::FH_LEN_2;
-        mem++;
-        j++;
+        length |= static_cast<uint32_t>(c) << 16;
+        state = State::FH_LEN_2;
         break;
       case State::FH_LEN_2:
-        frame_.length_ |= static_cast<uint32_t>(c) << 8;
-        state_ = State::FH_LEN_3;
-        mem++;
-        j++;
+        length |= static_cast<uint32_t>(c) << 8;
+        state = State::FH_LEN_3;
         break;
       case State::FH_LEN_3:
-        frame_.length_ |= static_cast<uint32_t>(c);
-        if (frame_.length_ == 0) {
-          output.push_back(std::move(frame_));
-          state_ = State::FH_FLAG;
-        } else {
-          frame_.data_.reset(new Buffer::OwnedImpl());
-          state_ = State::DATA;
-        }
-        mem++;
-        j++;
+        length |= static_cast<uint32_t>(c);
+        remain_in_frame = length;
+        state = length == 0 ? State::FH_FLAG : State::DATA;
         break;
       case State::DATA:
-        uint64_t remain_in_buffer = slice.len_ - j;
-        uint64_t remain_in_frame = frame_.length_ - frame_.data_->length();
-        if (remain_in_buffer <= remain_in_frame) {
-          frame_.data_->add(mem, remain_in_buffer);
-          mem += remain_in_buffer;
-          j += remain_in_buffer;
-        } else {
-          frame_.data_->add(mem, remain_in_frame);
-          mem += remain_in_frame;
-          j += remain_in_frame;
-        }
-        if (frame_.length_ == frame_.data_->length()) {
-          output.push_back(std::move(frame_));
-          frame_.flags_ = 0;
-          frame_.length_ = 0;
-          state_ = State::FH_FLAG;
-        }
-        break;
+        NOT_REACHED;
       }
     }
   }
-  input.drain(input.length());
   return true;
 }
 
+void Decoder::onHeaderByte(uint8_t c, std::vector<Frame>& output) {
+  switch (state_) {
+  case State::FH_FLAG:
+    frame_.flags_ = c;
+    state_ = State::FH_LEN_0;
+    break;
+  case State::FH_LEN_0:
+    frame_.length_ = static_cast<uint32_t>(c) << 24;
+    state_ = State::FH_LEN_1;
+    break;
+  case State::FH_LEN_1:
+    frame_.length_ |= static_cast<uint32_t>(c) << 16;
+    state_ = State::FH_LEN_2;
+    break;
+  case State::FH_LEN_2:
+    frame_.length_ |= static_cast<uint32_t>(c) << 8;
+    state_ = State::FH_LEN_3;
+    break;
+  case State::FH_LEN_3:
+    frame_.length_ |= static_cast<uint32_t>(c);
+    if (frame_.length_ == 0) {
+      output.push_back(std::move(frame_));
+      state_ = State::FH_FLAG;
+    } else {
+      frame_.data_.reset(new Buffer::OwnedImpl());
+      state_ = State::DATA;
+    }
+    break;
+  case State::DATA:
+    NOT_REACHED;
+  }
+}
+
 } // namespace Grpc
 } // namespace Envoy
@@ -12,6 +12,8 @@ namespace Grpc {
 const uint8_t GRPC_FH_DEFAULT = 0b0u;
 // Last bit for a compressed message.
 const uint8_t GRPC_FH_COMPRESSED = 0b1u;
+// The largest size that a compressed message may inflate to.
+const uint64_t GRPC_MAX_DECOMPRESSED_MESSAGE_SIZE = 64 * 1024 * 1024;
 
 enum class CompressionAlgorithm { None, Gzip };
 
@@ -39,7 +41,10 @@ public:
   // Decodes the given buffer with GRPC data frame. Drains the input buffer when
   // decoding succeeded (returns true). If the input is not sufficient to make a
   // complete GRPC data frame, it will be buffered in the decoder. If a decoding
-  // error happened, the input buffer remains unchanged.
+  // error happened, the input buffer remains unchanged and no frame is output.
+  // The frame data is moved out of the input rather than copied, so that the
+  // frames share the slices of the input buffer except where a slice and a frame
+  // boundary overlap.
   // @param input supplies the binary octets wrapped in a GRPC data frame.
   // @param output supplies the buffer to store the decoded data.
   // @return bool whether the decoding succeeded or not.
@@ -83,6 +88,14 @@ private:
     DATA,
   };
 
+  // Size of the fixed frame header.
+  static const uint32_t FH_SIZE = 5;
+
+  // Checks the frame headers in the input, without changing the state of the decoder.
+  bool validate(const Buffer::Instance& input) const;
+  // Advances the state with one byte of a frame header that was validated.
+  void onHeaderByte(uint8_t c, std::vector<Frame>& output);
+
   State state_;
   Frame frame_;
 };
@@ -82,30 +82,22 @@ Http::FilterDataStatus GrpcWebFilter::decodeData(Buffer::Instance& data, bool) {
     return Http::FilterDataStatus::Continue;
   }
 
-  // Parse application/grpc-web-text format.
-  if (data.length() + decoding_buffer_.length() < 4) {
-    decoding_buffer_.move(data);
-    return Http::FilterDataStatus::StopIterationNoBuffer;
-  }
-
-  const uint64_t needed =
-      (data.length() + decoding_buffer_.length()) / 4 * 4 - decoding_buffer_.length();
-  decoding_buffer_.move(data, needed);
-  const std::string decoded = Base64::decode(
-      std::string(static_cast<const char*>(decoding_buffer_.linearize(decoding_buffer_.length())),
-                  decoding_buffer_.length()));
-  if (decoded.empty()) {
+  // Parse application/grpc-web-text format. The decoder drains the data, and keeps the characters
+  // of an incomplete quantum until more data comes in.
+  Buffer::OwnedImpl decoded;
+  if (!base64_decoder_.decode(data, decoded)) {
     // Error happened when decoding base64.
     Http::Utility::sendLocalReply(*decoder_callbacks_, stream_destroyed_, Http::Code::BadRequest,
                                   "Bad gRPC-web request, invalid base64 data.");
     return Http::FilterDataStatus::StopIterationNoBuffer;
   }
-
-  decoding_buffer_.drain(decoding_buffer_.length());
-  decoding_buffer_.move(data);
-  data.add(decoded);
   // Any block of 4 bytes or more should have been decoded and passed through.
-  ASSERT(decoding_buffer_.length() < 4);
+  ASSERT(base64_decoder_.pendingLength() < 4);
+  if (decoded.length() == 0) {
+    return Http::FilterDataStatus::StopIterationNoBuffer;
+  }
+
+  data.move(decoded);
   return Http::FilterDataStatus::Continue;
 }
 
@@ -155,9 +147,9 @@ Http::FilterDataStatus GrpcWebFilter::encodeData(Buffer::Instance& data, bool) {
     const uint32_t length = htonl(frame.length_);
     temp.add(&length, 4);
     if (frame.length_ > 0) {
-      temp.add(*frame.data_);
+      temp.move(*frame.data_);
     }
-    data.add(Base64::encode(temp, temp.length()));
+    Base64::encode(temp, data);
   }
   return Http::FilterDataStatus::Continue;
 }
@@ -191,7 +183,8 @@ Http::FilterTrailersStatus GrpcWebFilter::encodeTrailers(Http::HeaderMap& traile
   buffer.add(&length, 4);
   buffer.move(temp);
   if (is_text_response_) {
-    Buffer::OwnedImpl encoded(Base64::encode(buffer, buffer.length()));
+    Buffer::OwnedImpl encoded;
+    Base64::encode(buffer, encoded);
     encoder_callbacks_->addEncodedData(encoded, true);
   } else {
     encoder_callbacks_->addEncodedData(buffer, true);
@@ -6,6 +6,7 @@
 #include "envoy/upstream/cluster_manager.h"
 
 #include "common/buffer/buffer_impl.h"
+#include "common/common/base64.h"
 #include "common/common/non_copyable.h"
 #include "common/grpc/codec.h"
 
@@ -57,7 +58,7 @@ private:
   Http::StreamEncoderFilterCallbacks* encoder_callbacks_{};
   bool is_text_request_{};
   bool is_text_response_{};
-  Buffer::OwnedImpl decoding_buffer_;
+  Base64StreamDecoder base64_decoder_;
   Decoder decoder_;
   std::string grpc_service_;
   std::string grpc_method_;
@@ -4,16 +4,19 @@
 #include "envoy/http/filter.h"
 
 #include "common/common/assert.h"
+#include "common/common/empty_string.h"
 #include "common/common/enum_to_int.h"
 #include "common/common/utility.h"
 #include "common/filesystem/filesystem_impl.h"
 #include "common/grpc/common.h"
+#include "common/http/codes.h"
 #include "common/http/headers.h"
 #include "common/http/utility.h"
 #include "common/protobuf/protobuf.h"
 
 #include "google/api/annotations.pb.h"
 #include "google/api/http.pb.h"
+#include "grpc_transcoding/http_template.h"
 #include "grpc_transcoding/json_request_translator.h"
 #include "grpc_transcoding/path_matcher_utility.h"
 #include "grpc_transcoding/response_to_json_translator.h"
@@ -24,6 +27,8 @@ using Envoy::Protobuf::FileDescriptorSet;
 using Envoy::Protobuf::io::ZeroCopyInputStream;
 using Envoy::ProtobufUtil::Status;
 using Envoy::ProtobufUtil::error::Code;
+using google::api::HttpRule;
+using google::grpc::transcoding::HttpTemplate;
 using google::grpc::transcoding::JsonRequestTranslator;
 using google::grpc::transcoding::PathMatcherBuilder;
 using google::grpc::transcoding::PathMatcherUtility;
@@ -70,6 +75,32 @@ private:
   std::unique_ptr<TranscoderInputStream> response_stream_;
 };
 
+// The number of bytes that were moved into the stream since the transcoder last output a message.
+// These are either still in the stream, or held by the transcoder as the message in progress.
+uint64_t pendingBytes(const TranscoderInputStreamImpl& stream, uint64_t message_start) {
+  return stream.ByteCount() + stream.BytesAvailable() - message_start;
+}
+
+// The path template of an HTTP rule, or an empty string if the rule does not have a pattern.
+const ProtobufTypes::String& rulePath(const HttpRule& rule) {
+  switch (rule.pattern_case()) {
+  case HttpRule::kGet:
+    return rule.get();
+  case HttpRule::kPut:
+    return rule.put();
+  case HttpRule::kPost:
+    return rule.post();
+  case HttpRule::kDelete:
+    return rule.delete_();
+  case HttpRule::kPatch:
+    return rule.patch();
+  case HttpRule::kCustom:
+    return rule.custom().path();
+  default:
+    return EMPTY_STRING;
+  }
+}
+
 } // namespace
 
 JsonTranscoderConfig::JsonTranscoderConfig(const Json::Object& config) {
@@ -85,7 +116,11 @@ JsonTranscoderConfig::JsonTranscoderConfig(const Json::Object& config) {
     }
   }
 
-  PathMatcherBuilder<const Protobuf::MethodDescriptor*> pmb;
+  type_helper_.reset(
+      new google::grpc::transcoding::TypeHelper(Protobuf::util::NewTypeResolverForDescriptorPool(
+          Common::typeUrlPrefix(), &descriptor_pool_)));
+
+  PathMatcherBuilder<const MethodInfo*> pmb;
 
   for (const auto& service_name : config.getStringArray("services")) {
     auto service = descriptor_pool_.FindServiceByName(service_name);
@@ -95,8 +130,10 @@ JsonTranscoderConfig::JsonTranscoderConfig(const Json::Object& config) {
     }
     for (int i = 0; i < service->method_count(); ++i) {
       auto method = service->method(i);
-      if (!PathMatcherUtility::RegisterByHttpRule(
-              pmb, method->options().GetExtension(google::api::http), method)) {
+      const HttpRule& http_rule = method->options().GetExtension(google::api::http);
+      methods_.emplace_back(createMethodInfo(method, http_rule));
+      const MethodInfo* method_info = methods_.back().get();
+      if (!PathMatcherUtility::RegisterByHttpRule(pmb, http_rule, method_info)) {
         throw EnvoyException("transcoding_filter: Cannot register '" + method->full_name() +
                              "' to path matcher");
       }
@@ -105,10 +142,6 @@ JsonTranscoderConfig::JsonTranscoderConfig(const Json::Object& config) {
 
   path_matcher_ = pmb.Build();
 
-  type_helper_.reset(
-      new google::grpc::transcoding::TypeHelper(Protobuf::util::NewTypeResolverForDescriptorPool(
-          Common::typeUrlPrefix(), &descriptor_pool_)));
-
   const auto print_config = config.getObject("print_options", true);
   print_options_.add_whitespace = print_config->getBoolean("add_whitespace", false);
   print_options_.always_print_primitive_fields =
@@ -135,26 +168,36 @@ ProtobufUtil::Status JsonTranscoderConfig::createTranscoder(
 
   RequestInfo request_info;
   std::vector<VariableBinding> variable_bindings;
-  method_descriptor =
+  const MethodInfo* method_info =
       path_matcher_->Lookup(method, path, args, &variable_bindings, &request_info.body_field_path);
-  if (!method_descriptor) {
+  if (!method_info) {
     return ProtobufUtil::Status(Code::NOT_FOUND, "Could not resolve " + path + " to a method");
   }
 
-  auto status = methodToRequestInfo(method_descriptor, &request_info);
-  if (!status.ok()) {
-    return status;
+  method_descriptor = method_info->descriptor_;
+  if (method_info->request_type_ == nullptr) {
+    return ProtobufUtil::Status(Code::NOT_FOUND, "Could not resolve type: " +
+                                                     method_descriptor->input_type()->full_name());
   }
+  request_info.message_type = method_info->request_type_;
 
-  for (const auto& binding : variable_bindings) {
+  request_info.variable_bindings.reserve(variable_bindings.size());
+  for (auto& binding : variable_bindings) {
     google::grpc::transcoding::RequestWeaver::BindingInfo resolved_binding;
-    status = type_helper_->ResolveFieldPath(*request_info.message_type, binding.field_path,
-                                            &resolved_binding.field_path);
-    if (!status.ok()) {
-      return status;
+    // The variables of the path templates were resolved when the config was loaded, only the
+    // fields bound by query parameters are resolved here.
+    const auto field_path = method_info->template_field_paths_.find(binding.field_path);
+    if (field_path != method_info->template_field_paths_.end()) {
+      resolved_binding.field_path = field_path->second;
+    } else {
+      const auto status = type_helper_->ResolveFieldPath(
+          *request_info.message_type, binding.field_path, &resolved_binding.field_path);
+      if (!status.ok()) {
+        return status;
+      }
     }
 
-    resolved_binding.value = binding.value;
+    resolved_binding.value = std::move(binding.value);
 
     request_info.variable_bindings.emplace_back(std::move(resolved_binding));
   }
@@ -163,28 +206,51 @@ ProtobufUtil::Status JsonTranscoderConfig::createTranscoder(
       new JsonRequestTranslator(type_helper_->Resolver(), &request_input, request_info,
                                 method_descriptor->client_streaming(), true)};
 
-  const auto response_type_url = Common::typeUrl(method_descriptor->output_type()->full_name());
   std::unique_ptr<ResponseToJsonTranslator> response_translator{new ResponseToJsonTranslator(
-      type_helper_->Resolver(), response_type_url, method_descriptor->server_streaming(),
-      &response_input, print_options_)};
+      type_helper_->Resolver(), method_info->response_type_url_,
+      method_descriptor->server_streaming(), &response_input, print_options_)};
 
   transcoder.reset(
       new TranscoderImpl(std::move(request_translator), std::move(response_translator)));
   return ProtobufUtil::Status();
 }
 
-ProtobufUtil::Status
-JsonTranscoderConfig::methodToRequestInfo(const Protobuf::MethodDescriptor* method,
-                                          google::grpc::transcoding::RequestInfo* info) {
-  auto request_type_url = Common::typeUrl(method->input_type()->full_name());
-  info->message_type = type_helper_->Info()->GetTypeByTypeUrl(request_type_url);
-  if (info->message_type == nullptr) {
+JsonTranscoderConfig::MethodInfoPtr
+JsonTranscoderConfig::createMethodInfo(const Protobuf::MethodDescriptor* method,
+                                       const HttpRule& http_rule) {
+  MethodInfoPtr method_info(new MethodInfo());
+  method_info->descriptor_ = method;
+  method_info->response_type_url_ = Common::typeUrl(method->output_type()->full_name());
+
+  const auto request_type_url = Common::typeUrl(method->input_type()->full_name());
+  method_info->request_type_ = type_helper_->Info()->GetTypeByTypeUrl(request_type_url);
+  if (method_info->request_type_ == nullptr) {
+    // Requests to the method are rejected, as they were before the type was cached.
     ENVOY_LOG(debug, "Cannot resolve input-type: {}", method->input_type()->full_name());
-    return ProtobufUtil::Status(Code::NOT_FOUND,
-                                "Could not resolve type: " + method->input_type()->full_name());
+    return method_info;
   }
 
-  return ProtobufUtil::Status();
+  std::vector<const HttpRule*> rules{&http_rule};
+  for (const auto& additional_binding : http_rule.additional_bindings()) {
+    rules.push_back(&additional_binding);
+  }
+  for (const HttpRule* rule : rules) {
+    // Templates that do not parse fail to register in the path matcher.
+    const auto http_template = HttpTemplate::Parse(rulePath(*rule));
+    if (http_template == nullptr) {
+      continue;
+    }
+    for (const auto& variable : http_template->Variables()) {
+      std::vector<const ProtobufWkt::Field*> field_path;
+      // A variable that does not resolve is left to fail in createTranscoder().
+      if (type_helper_->ResolveFieldPath(*method_info->request_type_, variable.field_path,
+                                         &field_path)
+              .ok()) {
+        method_info->template_field_paths_.emplace(variable.field_path, std::move(field_path));
+      }
+    }
+  }
+  return method_info;
 }
 
 JsonTranscoderFilter::JsonTranscoderFilter(JsonTranscoderConfig& config) : config_(config) {}
@@ -246,6 +312,9 @@ Http::FilterDataStatus JsonTranscoderFilter::decodeData(Buffer::Instance& data,
   }
 
   readToBuffer(*transcoder_->RequestOutput(), data);
+  if (data.length() > 0) {
+    request_message_start_ = request_in_.ByteCount();
+  }
 
   const auto& request_status = transcoder_->RequestStatus();
 
@@ -257,6 +326,19 @@ Http::FilterDataStatus JsonTranscoderFilter::decodeData(Buffer::Instance& data,
 
     return Http::FilterDataStatus::StopIterationNoBuffer;
   }
+
+  // The transcoder holds the request message in progress until it is complete, so the memory of
+  // the stream is only bounded if the size of the message is.
+  const uint32_t limit = decoder_callbacks_->decoderBufferLimit();
+  if (limit > 0 && pendingBytes(request_in_, request_message_start_) > limit) {
+    ENVOY_LOG(debug, "Transcoding request message is larger than the buffer limit {}", limit);
+    error_ = true;
+    Http::Utility::sendLocalReply(*decoder_callbacks_, stream_reset_,
+                                  Http::Code::PayloadTooLarge,
+                                  Http::CodeUtility::toString(Http::Code::PayloadTooLarge));
+
+    return Http::FilterDataStatus::StopIterationNoBuffer;
+  }
   return Http::FilterDataStatus::Continue;
 }
 
@@ -309,6 +391,20 @@ Http::FilterDataStatus JsonTranscoderFilter::encodeData(Buffer::Instance& data,
   }
 
   readToBuffer(*transcoder_->ResponseOutput(), data);
+  if (data.length() > 0) {
+    response_message_start_ = response_in_.ByteCount();
+  }
+
+  const uint32_t limit = encoder_callbacks_->encoderBufferLimit();
+  if (limit > 0 && pendingBytes(response_in_, response_message_start_) > limit) {
+    // The response headers of a streaming call have already been sent, so the stream is reset
+    // instead of replying with an error.
+    ENVOY_LOG(debug, "Transcoding response message is larger than the buffer limit {}", limit);
+    error_ = true;
+    encoder_callbacks_->resetStream();
+
+    return Http::FilterDataStatus::StopIterationNoBuffer;
+  }
 
   if (!method_->server_streaming()) {
     // Buffer until the response is complete.
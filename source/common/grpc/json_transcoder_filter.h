@@ -1,5 +1,9 @@
 #pragma once
 
+#include <map>
+#include <memory>
+#include <vector>
+
 #include "envoy/buffer/buffer.h"
 #include "envoy/http/filter.h"
 #include "envoy/http/header_map.h"
@@ -9,6 +13,7 @@
 #include "common/grpc/transcoder_input_stream_impl.h"
 #include "common/protobuf/protobuf.h"
 
+#include "google/api/http.pb.h"
 #include "grpc_transcoding/path_matcher.h"
 #include "grpc_transcoding/request_message_translator.h"
 #include "grpc_transcoding/transcoder.h"
@@ -62,14 +67,30 @@ public:
 
 private:
   /**
-   * Convert method descriptor to RequestInfo that needed for transcoding library
+   * The transcoding metadata of a method, which is resolved once when the config is loaded.
+   */
+  struct MethodInfo {
+    const Protobuf::MethodDescriptor* descriptor_{nullptr};
+    // nullptr if the request type could not be resolved.
+    const ProtobufWkt::Type* request_type_{nullptr};
+    ProtobufTypes::String response_type_url_;
+    // The resolved field paths of the variables in the path templates of the method.
+    std::map<std::vector<ProtobufTypes::String>, std::vector<const ProtobufWkt::Field*>>
+        template_field_paths_;
+  };
+
+  typedef std::unique_ptr<MethodInfo> MethodInfoPtr;
+
+  /**
+   * Resolve the transcoding metadata of a method and of the variables in its HTTP rule.
    */
-  ProtobufUtil::Status methodToRequestInfo(const Protobuf::MethodDescriptor* method,
-                                           google::grpc::transcoding::RequestInfo* info);
+  MethodInfoPtr createMethodInfo(const Protobuf::MethodDescriptor* method,
+                                 const google::api::HttpRule& http_rule);
 
 private:
   Protobuf::DescriptorPool descriptor_pool_;
-  google::grpc::transcoding::PathMatcherPtr<const Protobuf::MethodDescriptor*> path_matcher_;
+  std::vector<MethodInfoPtr> methods_;
+  google::grpc::transcoding::PathMatcherPtr<const MethodInfo*> path_matcher_;
   std::unique_ptr<google::grpc::transcoding::TypeHelper> type_helper_;
   Protobuf::util::JsonPrintOptions print_options_;
 };
@@ -109,6 +130,9 @@ private:
   Http::StreamEncoderFilterCallbacks* encoder_callbacks_{nullptr};
   const Protobuf::MethodDescriptor* method_{nullptr};
   Http::HeaderMap* response_headers_{nullptr};
+  // The byte counts of the input streams when the transcoder last output a message.
+  uint64_t request_message_start_{0};
+  uint64_t response_message_start_{0};
 
   bool error_{false};
   bool stream_reset_{false};
@@ -1,5 +1,6 @@
 #include "common/http/access_log/access_log_formatter.h"
 
+#include <chrono>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -27,66 +28,74 @@ const std::string ResponseFlagUtils::DELAY_INJECTED = "DI";
 const std::string ResponseFlagUtils::FAULT_INJECTED = "FI";
 const std::string ResponseFlagUtils::RATE_LIMITED = "RL";
 
-void ResponseFlagUtils::appendString(std::string& result, const std::string& append) {
-  if (result.empty()) {
-    result = append;
-  } else {
-    result += "," + append;
+void ResponseFlagUtils::appendString(std::string& result, size_t start,
+                                     const std::string& append) {
+  if (result.size() > start) {
+    result += ',';
   }
+  result += append;
 }
 
 const std::string ResponseFlagUtils::toShortString(const RequestInfo& request_info) {
   std::string result;
+  appendShortString(request_info, result);
+  return result;
+}
+
+void ResponseFlagUtils::appendShortString(const RequestInfo& request_info, std::string& result) {
+  const size_t start = result.size();
 
   if (request_info.getResponseFlag(ResponseFlag::FailedLocalHealthCheck)) {
-    appendString(result, FAILED_LOCAL_HEALTH_CHECK);
+    appendString(result, start, FAILED_LOCAL_HEALTH_CHECK);
   }
 
   if (request_info.getResponseFlag(ResponseFlag::NoHealthyUpstream)) {
-    appendString(result, NO_HEALTHY_UPSTREAM);
+    appendString(result, start, NO_HEALTHY_UPSTREAM);
   }
 
   if (request_info.getResponseFlag(ResponseFlag::UpstreamRequestTimeout)) {
-    appendString(result, UPSTREAM_REQUEST_TIMEOUT);
+    appendString(result, start, UPSTREAM_REQUEST_TIMEOUT);
   }
 
   if (request_info.getResponseFlag(ResponseFlag::LocalReset)) {
-    appendString(result, LOCAL_RESET);
+    appendString(result, start, LOCAL_RESET);
   }
 
   if (request_info.getResponseFlag(ResponseFlag::UpstreamRemoteReset)) {
-    appendString(result, UPSTREAM_REMOTE_RESET);
+    appendString(result, start, UPSTREAM_REMOTE_RESET);
   }
 
   if (request_info.getResponseFlag(ResponseFlag::UpstreamConnectionFailure)) {
-    appendString(result, UPSTREAM_CONNECTION_FAILURE);
+    appendString(result, start, UPSTREAM_CONNECTION_FAILURE);
   }
 
   if (request_info.getResponseFlag(ResponseFlag::UpstreamConnectionTermination)) {
-    appendString(result, UPSTREAM_CONNECTION_TERMINATION);
+    appendString(result, start, UPSTREAM_CONNECTION_TERMINATION);
   }
 
   if (request_info.getResponseFlag(ResponseFlag::UpstreamOverflow)) {
-    appendString(result, UPSTREAM_OVERFLOW);
+    appendString(result, start, UPSTREAM_OVERFLOW);
   }
 
   if (request_info.getResponseFlag(ResponseFlag::NoRouteFound)) {
-    appendString(result, NO_ROUTE_FOUND);
+    appendString(result, start, NO_ROUTE_FOUND);
   }
 
   if (request_info.getResponseFlag(ResponseFlag::DelayInjected)) {
-    appendString(result, DELAY_INJECTED);
+    appendString(result, start, DELAY_INJECTED);
   }
 
   if (request_info.getResponseFlag(ResponseFlag::FaultInjected)) {
-    appendString(result, FAULT_INJECTED);
+    appendString(result, start, FAULT_INJECTED);
   }
 
   if (request_info.getResponseFlag(ResponseFlag::RateLimited)) {
-    appendString(result, RATE_LIMITED);
+    appendString(result, start, RATE_LIMITED);
   }
 
-  return result.empty() ? NONE : result;
+  if (result.size() == start) {
+    result += NONE;
+  }
 }
 
 const std::string AccessLogFormatUtils::DEFAULT_FORMAT =
@@ -117,6 +126,24 @@ const std::string& AccessLogFormatUtils::protocolToString(Protocol protocol) {
   NOT_REACHED;
 }
 
+namespace {
+
+void appendInteger(std::string& output, uint64_t value) {
+  char buffer[32];
+  output.append(buffer, StringUtil::itoa(buffer, sizeof(buffer), value));
+}
+
+void appendMilliseconds(std::string& output, std::chrono::microseconds duration) {
+  const int64_t milliseconds =
+      std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+  if (milliseconds < 0) {
+    output += '-';
+  }
+  appendInteger(output, milliseconds < 0 ? -static_cast<uint64_t>(milliseconds) : milliseconds);
+}
+
+} // namespace
+
 FormatterImpl::FormatterImpl(const std::string& format) {
   formatters_ = AccessLogFormatParser::parse(format);
 }
@@ -126,12 +153,16 @@ std::string FormatterImpl::format(const Http::HeaderMap& request_headers,
                                   const RequestInfo& request_info) const {
   std::string log_line;
   log_line.reserve(256);
+  formatAppend(request_headers, response_headers, request_info, log_line);
+  return log_line;
+}
 
+void FormatterImpl::formatAppend(const Http::HeaderMap& request_headers,
+                                 const Http::HeaderMap& response_headers,
+                                 const RequestInfo& request_info, std::string& output) const {
   for (const FormatterPtr& formatter : formatters_) {
-    log_line += formatter->format(request_headers, response_headers, request_info);
+    formatter->formatAppend(request_headers, response_headers, request_info, output);
   }
-
-  return log_line;
 }
 
 void AccessLogFormatParser::parseCommand(const std::string& token, const size_t start,
@@ -228,64 +259,58 @@ std::vector<FormatterPtr> AccessLogFormatParser::parse(const std::string& format
 
 RequestInfoFormatter::RequestInfoFormatter(const std::string& field_name) {
   if (field_name == "START_TIME") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      return AccessLogDateTimeFormatter::fromTime(request_info.startTime());
+    field_appender_ = [](const RequestInfo& request_info, std::string& output) {
+      output += AccessLogDateTimeFormatter::fromTime(request_info.startTime());
     };
   } else if (field_name == "REQUEST_DURATION") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      return std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
-                                request_info.requestReceivedDuration())
-                                .count());
+    field_appender_ = [](const RequestInfo& request_info, std::string& output) {
+      appendMilliseconds(output, request_info.requestReceivedDuration());
     };
   } else if (field_name == "RESPONSE_DURATION") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      return std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
-                                request_info.responseReceivedDuration())
-                                .count());
+    field_appender_ = [](const RequestInfo& request_info, std::string& output) {
+      appendMilliseconds(output, request_info.responseReceivedDuration());
     };
   } else if (field_name == "BYTES_RECEIVED") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      return std::to_string(request_info.bytesReceived());
+    field_appender_ = [](const RequestInfo& request_info, std::string& output) {
+      appendInteger(output, request_info.bytesReceived());
     };
   } else if (field_name == "PROTOCOL") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      return AccessLogFormatUtils::protocolToString(request_info.protocol());
+    field_appender_ = [](const RequestInfo& request_info, std::string& output) {
+      output += AccessLogFormatUtils::protocolToString(request_info.protocol());
     };
   } else if (field_name == "RESPONSE_CODE") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      return request_info.responseCode().valid()
-                 ? std::to_string(request_info.responseCode().value())
-                 : "0";
+    field_appender_ = [](const RequestInfo& request_info, std::string& output) {
+      appendInteger(output,
+                    request_info.responseCode().valid() ? request_info.responseCode().value() : 0);
     };
   } else if (field_name == "BYTES_SENT") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      return std::to_string(request_info.bytesSent());
+    field_appender_ = [](const RequestInfo& request_info, std::string& output) {
+      appendInteger(output, request_info.bytesSent());
     };
   } else if (field_name == "DURATION") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      return std::to_string(
-          std::chrono::duration_cast<std::chrono::milliseconds>(request_info.duration()).count());
+    field_appender_ = [](const RequestInfo& request_info, std::string& output) {
+      appendMilliseconds(output, request_info.duration());
     };
   } else if (field_name == "RESPONSE_FLAGS") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      return ResponseFlagUtils::toShortString(request_info);
+    field_appender_ = [](const RequestInfo& request_info, std::string& output) {
+      ResponseFlagUtils::appendShortString(request_info, output);
     };
   } else if (field_name == "UPSTREAM_HOST") {
-    field_extractor_ = [](const RequestInfo& request_info) {
+    field_appender_ = [](const RequestInfo& request_info, std::string& output) {
       if (request_info.upstreamHost()) {
-        return request_info.upstreamHost()->address()->asString();
+        output += request_info.upstreamHost()->address()->asString();
       } else {
-        return std::string("-");
+        output += '-';
       }
     };
   } else if (field_name == "UPSTREAM_CLUSTER") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      std::string upstream_cluster_name;
-      if (nullptr != request_info.upstreamHost()) {
-        upstream_cluster_name = request_info.upstreamHost()->cluster().name();
+    field_appender_ = [](const RequestInfo& request_info, std::string& output) {
+      if (nullptr != request_info.upstreamHost() &&
+          !request_info.upstreamHost()->cluster().name().empty()) {
+        output += request_info.upstreamHost()->cluster().name();
+      } else {
+        output += '-';
       }
-
-      return upstream_cluster_name.empty() ? "-" : upstream_cluster_name;
     };
   } else {
     throw EnvoyException(fmt::format("Not supported field in RequestInfo: {}", field_name));
@@ -294,7 +319,15 @@ RequestInfoFormatter::RequestInfoFormatter(const std::string& field_name) {
 
 std::string RequestInfoFormatter::format(const HeaderMap&, const HeaderMap&,
                                          const RequestInfo& request_info) const {
-  return field_extractor_(request_info);
+  std::string output;
+  field_appender_(request_info, output);
+  return output;
+}
+
+void RequestInfoFormatter::formatAppend(const HeaderMap&, const HeaderMap&,
+                                        const RequestInfo& request_info,
+                                        std::string& output) const {
+  field_appender_(request_info, output);
 }
 
 PlainStringFormatter::PlainStringFormatter(const std::string& str) : str_(str) {}
@@ -304,30 +337,40 @@ std::string PlainStringFormatter::format(const Http::HeaderMap&, const Http::Hea
   return str_;
 }
 
+void PlainStringFormatter::formatAppend(const Http::HeaderMap&, const Http::HeaderMap&,
+                                        const RequestInfo&, std::string& output) const {
+  output += str_;
+}
+
 HeaderFormatter::HeaderFormatter(const std::string& main_header,
                                  const std::string& alternative_header,
                                  const Optional<size_t>& max_length)
     : main_header_(main_header), alternative_header_(alternative_header), max_length_(max_length) {}
 
 std::string HeaderFormatter::format(const HeaderMap& headers) const {
+  std::string output;
+  formatAppend(headers, output);
+  return output;
+}
+
+void HeaderFormatter::formatAppend(const HeaderMap& headers, std::string& output) const {
   const HeaderEntry* header = headers.get(main_header_);
 
   if (!header && !alternative_header_.get().empty()) {
     header = headers.get(alternative_header_);
   }
 
-  std::string header_value_string;
-  if (!header) {
-    header_value_string = "-";
-  } else {
-    header_value_string = header->value().c_str();
+  const char* value = "-";
+  size_t length = 1;
+  if (header) {
+    value = header->value().c_str();
+    length = header->value().size();
   }
 
-  if (max_length_.valid() && header_value_string.length() > max_length_.value()) {
-    return header_value_string.substr(0, max_length_.value());
+  if (max_length_.valid() && length > max_length_.value()) {
+    length = max_length_.value();
   }
-
-  return header_value_string;
+  output.append(value, length);
 }
 
 ResponseHeaderFormatter::ResponseHeaderFormatter(const std::string& main_header,
@@ -341,6 +384,12 @@ std::string ResponseHeaderFormatter::format(const Http::HeaderMap&,
   return HeaderFormatter::format(response_headers);
 }
 
+void ResponseHeaderFormatter::formatAppend(const Http::HeaderMap&,
+                                           const Http::HeaderMap& response_headers,
+                                           const RequestInfo&, std::string& output) const {
+  HeaderFormatter::formatAppend(response_headers, output);
+}
+
 RequestHeaderFormatter::RequestHeaderFormatter(const std::string& main_header,
                                                const std::string& alternative_header,
                                                const Optional<size_t>& max_length)
@@ -351,6 +400,12 @@ std::string RequestHeaderFormatter::format(const Http::HeaderMap& request_header
   return HeaderFormatter::format(request_headers);
 }
 
+void RequestHeaderFormatter::formatAppend(const Http::HeaderMap& request_headers,
+                                          const Http::HeaderMap&, const RequestInfo&,
+                                          std::string& output) const {
+  HeaderFormatter::formatAppend(request_headers, output);
+}
+
 } // namespace AccessLog
 } // namespace Http
 } // namespace Envoy
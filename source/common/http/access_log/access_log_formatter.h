@@ -17,9 +17,14 @@ class ResponseFlagUtils {
 public:
   static const std::string toShortString(const RequestInfo& request_info);
 
+  /**
+   * Append the short string of the response flags to result.
+   */
+  static void appendShortString(const RequestInfo& request_info, std::string& result);
+
 private:
   ResponseFlagUtils();
-  static void appendString(std::string& result, const std::string& append);
+  static void appendString(std::string& result, size_t start, const std::string& append);
 
   const static std::string NONE;
   const static std::string FAILED_LOCAL_HEALTH_CHECK;
@@ -63,7 +68,8 @@ private:
 };
 
 /**
- * Composite formatter implementation.
+ * Composite formatter implementation. The format is parsed once into a list of formatters, each of
+ * which appends its part of the line to the output in turn.
  */
 class FormatterImpl : public Formatter {
 public:
@@ -72,6 +78,8 @@ public:
   // Formatter::format
   std::string format(const HeaderMap& request_headers, const HeaderMap& response_headers,
                      const RequestInfo& request_info) const override;
+  void formatAppend(const HeaderMap& request_headers, const HeaderMap& response_headers,
+                    const RequestInfo& request_info, std::string& output) const override;
 
 private:
   std::vector<FormatterPtr> formatters_;
@@ -87,6 +95,8 @@ public:
 
   // Formatter::format
   std::string format(const HeaderMap&, const HeaderMap&, const RequestInfo&) const override;
+  void formatAppend(const HeaderMap&, const HeaderMap&, const RequestInfo&,
+                    std::string& output) const override;
 
 private:
   std::string str_;
@@ -98,6 +108,7 @@ public:
                   const Optional<size_t>& max_length);
 
   std::string format(const HeaderMap& headers) const;
+  void formatAppend(const HeaderMap& headers, std::string& output) const;
 
 private:
   LowerCaseString main_header_;
@@ -116,6 +127,8 @@ public:
   // Formatter::format
   std::string format(const HeaderMap& request_headers, const HeaderMap&,
                      const RequestInfo&) const override;
+  void formatAppend(const HeaderMap& request_headers, const HeaderMap&, const RequestInfo&,
+                    std::string& output) const override;
 };
 
 /**
@@ -129,6 +142,8 @@ public:
   // Formatter::format
   std::string format(const HeaderMap&, const HeaderMap& response_headers,
                      const RequestInfo&) const override;
+  void formatAppend(const HeaderMap&, const HeaderMap& response_headers, const RequestInfo&,
+                    std::string& output) const override;
 };
 
 /**
@@ -141,9 +156,12 @@ public:
   // Formatter::format
   std::string format(const HeaderMap&, const HeaderMap&,
                      const RequestInfo& request_info) const override;
+  void formatAppend(const HeaderMap&, const HeaderMap&, const RequestInfo& request_info,
+                    std::string& output) const override;
 
 private:
-  std::function<std::string(const RequestInfo&)> field_extractor_;
+  // Appends the field to the output, formatting numbers in place.
+  std::function<void(const RequestInfo&, std::string&)> field_appender_;
 };
 
 } // namespace AccessLog
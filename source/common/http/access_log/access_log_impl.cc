@@ -2,6 +2,8 @@
 
 #include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "envoy/filesystem/filesystem.h"
 #include "envoy/http/header_map.h"
@@ -24,13 +26,17 @@ namespace AccessLog {
 
 ComparisonFilter::ComparisonFilter(const envoy::api::v2::filter::ComparisonFilter& config,
                                    Runtime::Loader& runtime)
-    : config_(config), runtime_(runtime) {}
+    : config_(config) {
+  if (!config_.value().runtime_key().empty()) {
+    runtime_ = runtime.featureHandle(config_.value().runtime_key());
+  }
+}
 
 bool ComparisonFilter::compareAgainstValue(uint64_t lhs) {
   uint64_t value = config_.value().default_value();
 
-  if (!config_.value().runtime_key().empty()) {
-    value = runtime_.snapshot().getInteger(config_.value().runtime_key(), value);
+  if (runtime_) {
+    value = runtime_->getInteger(value);
   }
 
   switch (config_.op()) {
@@ -86,18 +92,17 @@ bool DurationFilter::evaluate(const RequestInfo& info, const HeaderMap&) {
 
 RuntimeFilter::RuntimeFilter(const envoy::api::v2::filter::RuntimeFilter& config,
                              Runtime::Loader& runtime)
-    : runtime_(runtime), runtime_key_(config.runtime_key()) {}
+    : runtime_(runtime.featureHandle(config.runtime_key())) {}
 
 bool RuntimeFilter::evaluate(const RequestInfo&, const HeaderMap& request_header) {
   const HeaderEntry* uuid = request_header.RequestId();
   uint16_t sampled_value;
   if (uuid && UuidUtils::uuidModBy(uuid->value().c_str(), sampled_value, 100)) {
-    uint64_t runtime_value =
-        std::min<uint64_t>(runtime_.snapshot().getInteger(runtime_key_, 0), 100);
+    uint64_t runtime_value = std::min<uint64_t>(runtime_->getInteger(0), 100);
 
     return sampled_value < static_cast<uint16_t>(runtime_value);
   } else {
-    return runtime_.snapshot().featureEnabled(runtime_key_, 0);
+    return runtime_->featureEnabled(0);
   }
 }
 
@@ -145,6 +150,55 @@ bool NotHealthCheckFilter::evaluate(const RequestInfo& info, const HeaderMap&) {
   return !info.healthCheck();
 }
 
+namespace {
+
+struct SharedFilterResult {
+  const Filter* filter_;
+  const RequestInfo* info_;
+  bool result_;
+};
+
+// The results of the shared filters for the request being logged on this thread. There are only a
+// few shared filters, and the vector keeps its capacity from one request to the next.
+thread_local std::vector<SharedFilterResult> shared_filter_results;
+
+InstanceSharedPtr createInstance(const envoy::api::v2::filter::AccessLog& config,
+                                 FilterPtr&& filter,
+                                 Server::Configuration::FactoryContext& context) {
+  auto& factory =
+      Config::Utility::getAndCheckFactory<Server::Configuration::AccessLogInstanceFactory>(
+          config.name());
+  ProtobufTypes::MessagePtr message = Config::Utility::translateToFactoryConfig(config, factory);
+
+  return factory.createAccessLogInstance(*message, std::move(filter), context);
+}
+
+} // namespace
+
+void SharedFilter::newRequest() { shared_filter_results.clear(); }
+
+bool SharedFilter::evaluate(const RequestInfo& info, const HeaderMap& request_headers) {
+  for (const SharedFilterResult& result : shared_filter_results) {
+    if (result.filter_ == filter_.get() && result.info_ == &info) {
+      return result.result_;
+    }
+  }
+
+  const bool result = filter_->evaluate(info, request_headers);
+  shared_filter_results.push_back({filter_.get(), &info, result});
+  return result;
+}
+
+FilterPtr FilterCache::fromProto(const envoy::api::v2::filter::AccessLogFilter& config,
+                                 Runtime::Loader& runtime) {
+  FilterSharedPtr& filter = filters_[config.SerializeAsString()];
+  if (!filter) {
+    filter = FilterFactory::fromProto(config, runtime);
+  }
+
+  return FilterPtr{new SharedFilter(filter)};
+}
+
 InstanceSharedPtr AccessLogFactory::fromProto(const envoy::api::v2::filter::AccessLog& config,
                                               Server::Configuration::FactoryContext& context) {
   FilterPtr filter;
@@ -152,12 +206,18 @@ InstanceSharedPtr AccessLogFactory::fromProto(const envoy::api::v2::filter::Acce
     filter = FilterFactory::fromProto(config.filter(), context.runtime());
   }
 
-  auto& factory =
-      Config::Utility::getAndCheckFactory<Server::Configuration::AccessLogInstanceFactory>(
-          config.name());
-  ProtobufTypes::MessagePtr message = Config::Utility::translateToFactoryConfig(config, factory);
+  return createInstance(config, std::move(filter), context);
+}
 
-  return factory.createAccessLogInstance(*message, std::move(filter), context);
+InstanceSharedPtr AccessLogFactory::fromProto(const envoy::api::v2::filter::AccessLog& config,
+                                              Server::Configuration::FactoryContext& context,
+                                              FilterCache& filter_cache) {
+  FilterPtr filter;
+  if (config.has_filter()) {
+    filter = filter_cache.fromProto(config.filter(), context.runtime());
+  }
+
+  return createInstance(config, std::move(filter), context);
 }
 
 FileAccessLog::FileAccessLog(const std::string& access_log_path, FilterPtr&& filter,
@@ -183,8 +243,11 @@ void FileAccessLog::log(const HeaderMap* request_headers, const HeaderMap* respo
     }
   }
 
-  std::string access_log_line =
-      formatter_->format(*request_headers, *response_headers, request_info);
+  // Each thread builds its lines in the same string, which stops allocating once it has grown to
+  // the size of the longest line.
+  static thread_local std::string access_log_line;
+  access_log_line.clear();
+  formatter_->formatAppend(*request_headers, *response_headers, request_info, access_log_line);
   log_file_->write(access_log_line);
 }
 
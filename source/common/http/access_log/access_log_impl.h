@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "envoy/access_log/access_log.h"
@@ -40,7 +41,8 @@ protected:
   bool compareAgainstValue(uint64_t lhs);
 
   envoy::api::v2::filter::ComparisonFilter config_;
-  Runtime::Loader& runtime_;
+  // Only set if the comparison value has a runtime key.
+  Runtime::FeatureHandleSharedPtr runtime_;
 };
 
 /**
@@ -132,8 +134,41 @@ public:
   bool evaluate(const RequestInfo& info, const HeaderMap& request_headers) override;
 
 private:
-  Runtime::Loader& runtime_;
-  const std::string runtime_key_;
+  const Runtime::FeatureHandleSharedPtr runtime_;
+};
+
+/**
+ * Filter shared by the access logs that have the same filter configuration. The wrapped filter is
+ * evaluated once for a request, the other logs reuse its result. newRequest() must be called on the
+ * logging thread before the logs of each request are written.
+ */
+class SharedFilter : public Filter {
+public:
+  SharedFilter(FilterSharedPtr filter) : filter_(filter) {}
+
+  /**
+   * Forget the results of the request previously logged on this thread.
+   */
+  static void newRequest();
+
+  // Http::AccessLog::Filter
+  bool evaluate(const RequestInfo& info, const HeaderMap& request_headers) override;
+
+private:
+  FilterSharedPtr filter_;
+};
+
+/**
+ * Builds the filters of a group of access logs, such as those of a connection manager, sharing the
+ * filters that have the same configuration.
+ */
+class FilterCache {
+public:
+  FilterPtr fromProto(const envoy::api::v2::filter::AccessLogFilter& config,
+                      Runtime::Loader& runtime);
+
+private:
+  std::unordered_map<std::string, FilterSharedPtr> filters_;
 };
 
 InstanceSharedPtr instanceFromProto(const envoy::api::v2::filter::AccessLog& config,
@@ -150,6 +185,13 @@ public:
    */
   static InstanceSharedPtr fromProto(const envoy::api::v2::filter::AccessLog& config,
                                      Server::Configuration::FactoryContext& context);
+
+  /**
+   * Same as above, sharing the filter with the logs built from the same cache.
+   */
+  static InstanceSharedPtr fromProto(const envoy::api::v2::filter::AccessLog& config,
+                                     Server::Configuration::FactoryContext& context,
+                                     FilterCache& filter_cache);
 };
 
 /**
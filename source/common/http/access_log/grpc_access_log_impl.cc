@@ -0,0 +1,179 @@
+#include "common/http/access_log/grpc_access_log_impl.h"
+
+#include <chrono>
+#include <string>
+
+#include "common/common/assert.h"
+#include "common/http/access_log/access_log_formatter.h"
+#include "common/http/header_map_impl.h"
+
+#include "fmt/format.h"
+
+namespace Envoy {
+namespace Http {
+namespace AccessLog {
+
+namespace {
+
+void setHeader(const HeaderEntry* header, std::string* value) {
+  if (header) {
+    value->assign(header->value().c_str(), header->value().size());
+  }
+}
+
+envoy::accesslog::HttpAccessLogEntry::Protocol toProto(Protocol protocol) {
+  switch (protocol) {
+  case Protocol::Http10:
+    return envoy::accesslog::HttpAccessLogEntry::HTTP10;
+  case Protocol::Http11:
+    return envoy::accesslog::HttpAccessLogEntry::HTTP11;
+  case Protocol::Http2:
+    return envoy::accesslog::HttpAccessLogEntry::HTTP2;
+  }
+
+  NOT_REACHED;
+}
+
+} // namespace
+
+GrpcAccessLog::SharedState::SharedState(const envoy::accesslog::GrpcAccessLogConfig& config,
+                                        Stats::Scope& scope,
+                                        const LocalInfo::LocalInfo& local_info)
+    : log_name_(config.log_name()),
+      max_batch_size_(config.max_batch_size() > 0 ? config.max_batch_size() : 100),
+      flush_interval_(config.flush_interval_ms() > 0 ? config.flush_interval_ms() : 1000),
+      max_pending_entries_(config.max_pending_entries() > 0 ? config.max_pending_entries()
+                                                            : 10000),
+      service_method_(*Protobuf::DescriptorPool::generated_pool()->FindMethodByName(
+          "envoy.accesslog.AccessLogService.StreamAccessLogs")),
+      stats_{ALL_GRPC_ACCESS_LOG_STATS(
+          POOL_COUNTER_PREFIX(scope, fmt::format("access_log.grpc.{}.", config.log_name())))},
+      local_info_(local_info) {}
+
+GrpcAccessLog::GrpcAccessLog(FilterPtr&& filter,
+                             const envoy::accesslog::GrpcAccessLogConfig& config,
+                             GrpcAccessLogAsyncClientFactory async_client_factory,
+                             ThreadLocal::SlotAllocator& tls, Stats::Scope& scope,
+                             const LocalInfo::LocalInfo& local_info)
+    : filter_(std::move(filter)),
+      shared_state_(std::make_shared<const SharedState>(config, scope, local_info)),
+      tls_slot_(tls.allocateSlot()) {
+  SharedStateConstSharedPtr shared_state = shared_state_;
+  tls_slot_->set([shared_state, async_client_factory](Event::Dispatcher& dispatcher)
+                     -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<ThreadLocalStreamer>(shared_state, async_client_factory(), dispatcher);
+  });
+}
+
+void GrpcAccessLog::log(const HeaderMap* request_headers, const HeaderMap*,
+                        const RequestInfo& request_info) {
+  static HeaderMapImpl empty_headers;
+  if (!request_headers) {
+    request_headers = &empty_headers;
+  }
+
+  if (filter_ && !filter_->evaluate(request_info, *request_headers)) {
+    return;
+  }
+
+  ThreadLocalStreamer& streamer = tls_slot_->getTyped<ThreadLocalStreamer>();
+  envoy::accesslog::HttpAccessLogEntry* entry = streamer.addEntry();
+  if (entry == nullptr) {
+    return;
+  }
+
+  fillEntry(*request_headers, request_info, *entry);
+  // Only the request that fills the batch sends it. If there is no stream the entries wait for the
+  // flush timer, rather than every later request trying to start one.
+  if (static_cast<uint32_t>(streamer.message_.entries_size()) == shared_state_->max_batch_size_) {
+    streamer.flush();
+  }
+}
+
+void GrpcAccessLog::fillEntry(const HeaderMap& request_headers, const RequestInfo& request_info,
+                              envoy::accesslog::HttpAccessLogEntry& entry) {
+  entry.set_start_time_us(std::chrono::duration_cast<std::chrono::microseconds>(
+                              request_info.startTime().time_since_epoch())
+                              .count());
+  entry.set_duration_us(request_info.duration().count());
+  entry.set_protocol(toProto(request_info.protocol()));
+  setHeader(request_headers.Method(), entry.mutable_method());
+  setHeader(request_headers.EnvoyOriginalPath() ? request_headers.EnvoyOriginalPath()
+                                                : request_headers.Path(),
+            entry.mutable_path());
+  setHeader(request_headers.Host(), entry.mutable_authority());
+  setHeader(request_headers.UserAgent(), entry.mutable_user_agent());
+  setHeader(request_headers.ForwardedFor(), entry.mutable_forwarded_for());
+  setHeader(request_headers.RequestId(), entry.mutable_request_id());
+  if (request_info.responseCode().valid()) {
+    entry.set_response_code(request_info.responseCode().value());
+  }
+  ResponseFlagUtils::appendShortString(request_info, *entry.mutable_response_flags());
+  entry.set_bytes_received(request_info.bytesReceived());
+  entry.set_bytes_sent(request_info.bytesSent());
+  if (request_info.upstreamHost()) {
+    entry.set_upstream_host(request_info.upstreamHost()->address()->asString());
+    entry.set_upstream_cluster(request_info.upstreamHost()->cluster().name());
+  }
+}
+
+GrpcAccessLog::ThreadLocalStreamer::ThreadLocalStreamer(SharedStateConstSharedPtr shared_state,
+                                                        GrpcAccessLogAsyncClientPtr&& async_client,
+                                                        Event::Dispatcher& dispatcher)
+    : shared_state_(shared_state), async_client_(std::move(async_client)),
+      flush_timer_(dispatcher.createTimer([this]() -> void {
+        flush();
+        flush_timer_->enableTimer(shared_state_->flush_interval_);
+      })) {
+  flush_timer_->enableTimer(shared_state_->flush_interval_);
+}
+
+GrpcAccessLog::ThreadLocalStreamer::~ThreadLocalStreamer() {
+  if (stream_) {
+    stream_->resetStream();
+  }
+}
+
+envoy::accesslog::HttpAccessLogEntry* GrpcAccessLog::ThreadLocalStreamer::addEntry() {
+  // Entries only pile up when they cannot be sent.
+  if (static_cast<uint32_t>(message_.entries_size()) >= shared_state_->max_pending_entries_) {
+    shared_state_->stats_.entries_dropped_.inc();
+    return nullptr;
+  }
+
+  return message_.add_entries();
+}
+
+void GrpcAccessLog::ThreadLocalStreamer::flush() {
+  if (message_.entries_size() == 0) {
+    return;
+  }
+
+  if (!stream_) {
+    stream_ = async_client_->start(shared_state_->service_method_, *this);
+    if (!stream_) {
+      // onRemoteClose() has already been called. The entries are kept for the next flush.
+      return;
+    }
+
+    auto* identifier = message_.mutable_identifier();
+    identifier->set_node(shared_state_->local_info_.nodeName());
+    identifier->set_cluster(shared_state_->local_info_.clusterName());
+    identifier->set_log_name(shared_state_->log_name_);
+  }
+
+  stream_->sendMessage(message_, false);
+  shared_state_->stats_.entries_sent_.add(message_.entries_size());
+  message_.Clear();
+}
+
+void GrpcAccessLog::ThreadLocalStreamer::onRemoteClose(Grpc::Status::GrpcStatus status,
+                                                       const std::string& message) {
+  ENVOY_LOG(debug, "access log service stream closed: {} {}", status, message);
+  shared_state_->stats_.stream_closed_.inc();
+  stream_ = nullptr;
+}
+
+} // namespace AccessLog
+} // namespace Http
+} // namespace Envoy
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "envoy/grpc/async_client.h"
+#include "envoy/http/access_log.h"
+#include "envoy/local_info/local_info.h"
+#include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
+
+#include "common/common/logger.h"
+#include "common/http/access_log/access_log_service.pb.h"
+
+namespace Envoy {
+namespace Http {
+namespace AccessLog {
+
+typedef Grpc::AsyncClient<envoy::accesslog::StreamAccessLogsMessage,
+                          envoy::accesslog::StreamAccessLogsResponse>
+    GrpcAccessLogAsyncClient;
+typedef std::unique_ptr<GrpcAccessLogAsyncClient> GrpcAccessLogAsyncClientPtr;
+
+/**
+ * Creates the async client of a worker. Clients are bound to the thread they are created on.
+ */
+typedef std::function<GrpcAccessLogAsyncClientPtr()> GrpcAccessLogAsyncClientFactory;
+
+/**
+ * All gRPC access log stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_GRPC_ACCESS_LOG_STATS(COUNTER)                                                         \
+  COUNTER(entries_sent)                                                                            \
+  COUNTER(entries_dropped)                                                                         \
+  COUNTER(stream_closed)
+// clang-format on
+
+/**
+ * Struct definition for all gRPC access log stats. @see stats_macros.h
+ */
+struct GrpcAccessLogStats {
+  ALL_GRPC_ACCESS_LOG_STATS(GENERATE_COUNTER_STRUCT)
+};
+
+/**
+ * Access log Instance that streams structured entries to an access log service over gRPC, rather
+ * than writing them to a local file. Every worker batches the entries of its requests and sends
+ * them on its own long lived stream, either when the batch is full or when its flush timer fires.
+ * If the stream closes a new one is started with the next batch. The entries a worker holds while
+ * it has no stream are bounded, later ones are dropped.
+ */
+class GrpcAccessLog : public Instance {
+public:
+  GrpcAccessLog(FilterPtr&& filter, const envoy::accesslog::GrpcAccessLogConfig& config,
+                GrpcAccessLogAsyncClientFactory async_client_factory,
+                ThreadLocal::SlotAllocator& tls, Stats::Scope& scope,
+                const LocalInfo::LocalInfo& local_info);
+
+  // Http::AccessLog::Instance
+  void log(const HeaderMap* request_headers, const HeaderMap* response_headers,
+           const RequestInfo& request_info) override;
+
+  /**
+   * Fill a log entry from a request.
+   */
+  static void fillEntry(const HeaderMap& request_headers, const RequestInfo& request_info,
+                        envoy::accesslog::HttpAccessLogEntry& entry);
+
+private:
+  /**
+   * The settings of the log, shared with the workers since their streamers can outlive the log
+   * until their thread local slots are released.
+   */
+  struct SharedState {
+    SharedState(const envoy::accesslog::GrpcAccessLogConfig& config, Stats::Scope& scope,
+                const LocalInfo::LocalInfo& local_info);
+
+    const std::string log_name_;
+    const uint32_t max_batch_size_;
+    const std::chrono::milliseconds flush_interval_;
+    const uint32_t max_pending_entries_;
+    const Protobuf::MethodDescriptor& service_method_;
+    GrpcAccessLogStats stats_;
+    const LocalInfo::LocalInfo& local_info_;
+  };
+
+  typedef std::shared_ptr<const SharedState> SharedStateConstSharedPtr;
+
+  /**
+   * The stream and pending batch of a worker.
+   */
+  struct ThreadLocalStreamer
+      : public ThreadLocal::ThreadLocalObject,
+        public Grpc::AsyncStreamCallbacks<envoy::accesslog::StreamAccessLogsResponse>,
+        Logger::Loggable<Logger::Id::upstream> {
+    ThreadLocalStreamer(SharedStateConstSharedPtr shared_state,
+                        GrpcAccessLogAsyncClientPtr&& async_client, Event::Dispatcher& dispatcher);
+    ~ThreadLocalStreamer();
+
+    /**
+     * @return the entry to fill for a request, or nullptr if the entry is dropped.
+     */
+    envoy::accesslog::HttpAccessLogEntry* addEntry();
+    void flush();
+
+    // Grpc::AsyncStreamCallbacks
+    void onCreateInitialMetadata(Http::HeaderMap&) override {}
+    void onReceiveInitialMetadata(Http::HeaderMapPtr&&) override {}
+    void onReceiveMessage(std::unique_ptr<envoy::accesslog::StreamAccessLogsResponse>&&) override {
+    }
+    void onReceiveTrailingMetadata(Http::HeaderMapPtr&&) override {}
+    void onRemoteClose(Grpc::Status::GrpcStatus status, const std::string& message) override;
+
+    const SharedStateConstSharedPtr shared_state_;
+    GrpcAccessLogAsyncClientPtr async_client_;
+    Grpc::AsyncStream<envoy::accesslog::StreamAccessLogsMessage>* stream_{};
+    envoy::accesslog::StreamAccessLogsMessage message_;
+    Event::TimerPtr flush_timer_;
+  };
+
+  FilterPtr filter_;
+  const SharedStateConstSharedPtr shared_state_;
+  ThreadLocal::SlotPtr tls_slot_;
+};
+
+} // namespace AccessLog
+} // namespace Http
+} // namespace Envoy
@@ -29,7 +29,7 @@ AsyncClientImpl::AsyncClientImpl(const Upstream::ClusterInfo& cluster, Stats::St
                                  Runtime::RandomGenerator& random,
                                  Router::ShadowWriterPtr&& shadow_writer)
     : cluster_(cluster), config_("http.async-client.", local_info, stats_store, cm, runtime, random,
-                                 std::move(shadow_writer), true),
+                                 std::move(shadow_writer), true, 0),
       dispatcher_(dispatcher) {}
 
 AsyncClientImpl::~AsyncClientImpl() {
@@ -88,6 +88,7 @@ private:
   struct NullCorsPolicy : public Router::CorsPolicy {
     // Router::CorsPolicy
     const std::list<std::string>& allowOrigins() const override { return allow_origin_; };
+    bool originAllowed(const Http::HeaderString&) const override { return false; }
     const std::string& allowMethods() const override { return EMPTY_STRING; };
     const std::string& allowHeaders() const override { return EMPTY_STRING; };
     const std::string& exposeHeaders() const override { return EMPTY_STRING; };
@@ -142,6 +143,7 @@ private:
 
     // Router::RouteEntry
     const std::string& clusterName() const override { return cluster_name_; }
+    const Upstream::ClusterHandle* clusterHandle() const override { return nullptr; }
     const Router::CorsPolicy* corsPolicy() const override { return nullptr; }
     void finalizeRequestHeaders(Http::HeaderMap&) const override {}
     const Router::HashPolicy* hashPolicy() const override { return nullptr; }
@@ -168,6 +170,10 @@ private:
     bool autoHostRewrite() const override { return false; }
     bool useWebSocket() const override { return false; }
     bool includeVirtualHostRateLimits() const override { return true; }
+    const Upstream::MetadataMatchCriteria* metadataMatchCriteria() const override {
+      return nullptr;
+    }
+    Optional<uint32_t> perRequestBufferLimit() const override { return {}; }
 
     static const NullRateLimitPolicy rate_limit_policy_;
     static const NullRetryPolicy retry_policy_;
@@ -12,6 +12,7 @@
 #include "common/common/assert.h"
 #include "common/common/linked_object.h"
 #include "common/common/logger.h"
+#include "common/common/object_pool.h"
 #include "common/http/codec_wrappers.h"
 #include "common/network/filter_impl.h"
 
@@ -42,6 +43,7 @@ public:
  * across multiple HTTP codec types.
  */
 class CodecClient : Logger::Loggable<Logger::Id::client>,
+                    public PooledObject<CodecClient>,
                     public Http::ConnectionCallbacks,
                     public Network::ConnectionCallbacks,
                     public Event::DeferredDeletable {
@@ -104,6 +106,11 @@ public:
 
   bool remoteClosed() const { return remote_closed_; }
 
+  /**
+   * @return Type the codec type of the client.
+   */
+  Type type() const { return type_; }
+
 protected:
   /**
    * Create a codec client and connect to a remote host/port.
@@ -6,6 +6,7 @@
 #include "envoy/http/header_map.h"
 #include "envoy/stats/stats.h"
 
+#include "common/common/assert.h"
 #include "common/common/enum_to_int.h"
 #include "common/common/utility.h"
 #include "common/http/headers.h"
@@ -26,10 +27,32 @@ void CodeUtility::chargeBasicResponseStat(Stats::Scope& scope, const std::string
 
 void CodeUtility::chargeResponseStat(const ResponseStatInfo& info) {
   uint64_t response_code = Utility::getResponseStatus(info.response_headers_);
-  chargeBasicResponseStat(info.cluster_scope_, info.prefix_, static_cast<Code>(response_code));
-
   std::string group_string = groupStringForResponseCode(static_cast<Code>(response_code));
 
+  if (info.code_stats_ != nullptr) {
+    ASSERT(info.prefix_.empty());
+    const Code code = static_cast<Code>(response_code);
+    info.code_stats_->upstream().charge(code);
+    if (info.upstream_canary_) {
+      info.code_stats_->canary().charge(code);
+    }
+    if (info.internal_request_) {
+      info.code_stats_->internal().charge(code);
+    } else {
+      info.code_stats_->external().charge(code);
+    }
+    if (!info.from_zone_.empty() && !info.to_zone_.empty()) {
+      info.code_stats_->zone(info.from_zone_, info.to_zone_).charge(code);
+    }
+
+    // The virtual cluster counters live in the global scope, which the cluster may outlive, so
+    // they are not cached with the cluster.
+    chargeVirtualClusterStat(info, response_code, group_string);
+    return;
+  }
+
+  chargeBasicResponseStat(info.cluster_scope_, info.prefix_, static_cast<Code>(response_code));
+
   // If the response is from a canary, also create canary stats.
   if (info.upstream_canary_) {
     info.cluster_scope_.counter(fmt::format("{}canary.upstream_rq_{}", info.prefix_, group_string))
@@ -55,17 +78,7 @@ void CodeUtility::chargeResponseStat(const ResponseStatInfo& info) {
         .inc();
   }
 
-  // Handle request virtual cluster.
-  if (!info.request_vcluster_name_.empty()) {
-    info.global_scope_
-        .counter(fmt::format("vhost.{}.vcluster.{}.upstream_rq_{}", info.request_vhost_name_,
-                             info.request_vcluster_name_, group_string))
-        .inc();
-    info.global_scope_
-        .counter(fmt::format("vhost.{}.vcluster.{}.upstream_rq_{}", info.request_vhost_name_,
-                             info.request_vcluster_name_, response_code))
-        .inc();
-  }
+  chargeVirtualClusterStat(info, response_code, group_string);
 
   // Handle per zone stats.
   if (!info.from_zone_.empty() && !info.to_zone_.empty()) {
@@ -80,6 +93,20 @@ void CodeUtility::chargeResponseStat(const ResponseStatInfo& info) {
   }
 }
 
+void CodeUtility::chargeVirtualClusterStat(const ResponseStatInfo& info, uint64_t response_code,
+                                           const std::string& group_string) {
+  if (!info.request_vcluster_name_.empty()) {
+    info.global_scope_
+        .counter(fmt::format("vhost.{}.vcluster.{}.upstream_rq_{}", info.request_vhost_name_,
+                             info.request_vcluster_name_, group_string))
+        .inc();
+    info.global_scope_
+        .counter(fmt::format("vhost.{}.vcluster.{}.upstream_rq_{}", info.request_vhost_name_,
+                             info.request_vcluster_name_, response_code))
+        .inc();
+  }
+}
+
 void CodeUtility::chargeResponseTiming(const ResponseTimingInfo& info) {
   info.cluster_scope_.deliverTimingToSinks(info.prefix_ + "upstream_rq_time", info.response_time_);
   if (info.upstream_canary_) {
@@ -197,5 +224,63 @@ const char* CodeUtility::toString(Code code) {
   return "Unknown";
 }
 
+CodeStatsImpl::CodeStatsImpl(Stats::Scope& scope, const std::string& prefix)
+    : scope_(scope), prefix_(prefix) {}
+
+CodeStatsImpl::~CodeStatsImpl() {
+  for (auto& codes : code_counters_) {
+    delete codes.load();
+  }
+}
+
+Stats::Counter& CodeStatsImpl::counter(std::atomic<Stats::Counter*>& slot,
+                                       const std::string& suffix) {
+  Stats::Counter* counter = slot.load(std::memory_order_acquire);
+  if (counter == nullptr) {
+    // Threads that race here look up the same counter, so whichever store wins is fine.
+    counter = &scope_.counter(prefix_ + suffix);
+    slot.store(counter, std::memory_order_release);
+  }
+  return *counter;
+}
+
+void CodeStatsImpl::charge(Code code) {
+  const uint64_t value = enumToInt(code);
+  if (value < 100 || value >= 100 * (NUM_CLASSES + 1)) {
+    scope_.counter(prefix_ + CodeUtility::groupStringForResponseCode(code)).inc();
+    scope_.counter(prefix_ + std::to_string(value)).inc();
+    return;
+  }
+
+  const size_t index = value / 100 - 1;
+  counter(class_counters_[index], CodeUtility::groupStringForResponseCode(code)).inc();
+
+  ClassCounters* codes = code_counters_[index].load(std::memory_order_acquire);
+  if (codes == nullptr) {
+    // A thread that loses the race to allocate the slots uses those of the winner.
+    std::unique_ptr<ClassCounters> new_codes(new ClassCounters());
+    if (code_counters_[index].compare_exchange_strong(codes, new_codes.get(),
+                                                      std::memory_order_acq_rel)) {
+      codes = new_codes.release();
+    }
+  }
+  counter((*codes)[value % 100], std::to_string(value)).inc();
+}
+
+UpstreamCodeStatsImpl::UpstreamCodeStatsImpl(Stats::Scope& scope)
+    : scope_(scope), upstream_(scope, "upstream_rq_"), canary_(scope, "canary.upstream_rq_"),
+      internal_(scope, "internal.upstream_rq_"), external_(scope, "external.upstream_rq_"),
+      retry_(scope, "retry.upstream_rq_") {}
+
+CodeStats& UpstreamCodeStatsImpl::zone(const std::string& from_zone, const std::string& to_zone) {
+  std::unique_lock<std::mutex> lock(zone_lock_);
+  std::unique_ptr<CodeStatsImpl>& stats = zone_stats_[from_zone][to_zone];
+  if (!stats) {
+    stats.reset(new CodeStatsImpl(scope_, fmt::format("zone.{}.{}.upstream_rq_", from_zone,
+                                                      to_zone)));
+  }
+  return *stats;
+}
+
 } // namespace Http
 } // namespace Envoy
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 #include "envoy/http/codes.h"
 #include "envoy/http/header_map.h"
@@ -33,6 +38,9 @@ public:
     const std::string& from_zone_;
     const std::string& to_zone_;
     bool upstream_canary_;
+    // The cached counters of cluster_scope_, or nullptr to look the counters up by name. Only
+    // used with an empty prefix_.
+    UpstreamCodeStats* code_stats_;
   };
 
   /**
@@ -74,6 +82,70 @@ public:
   static bool is5xx(uint64_t code) { return code >= 500 && code < 600; }
 
   static std::string groupStringForResponseCode(Code response_code);
+
+private:
+  static void chargeVirtualClusterStat(const ResponseStatInfo& info, uint64_t response_code,
+                                       const std::string& group_string);
+};
+
+/**
+ * Implementation of CodeStats. The counters are held in fixed slots indexed by code, so that
+ * charging a code that was charged before does no string work or map lookup. The slots of the
+ * codes of a class are only allocated once a code of the class is charged.
+ */
+class CodeStatsImpl : public CodeStats {
+public:
+  /**
+   * @param scope supplies the scope of the counters, which must outlive this object.
+   * @param prefix supplies the prefix of the names of the counters, e.g. "canary.upstream_rq_".
+   */
+  CodeStatsImpl(Stats::Scope& scope, const std::string& prefix);
+  ~CodeStatsImpl();
+
+  // Http::CodeStats
+  void charge(Code code) override;
+
+private:
+  // The classes from 1xx to 5xx, and the codes of each class.
+  static const size_t NUM_CLASSES = 5;
+  static const size_t CODES_PER_CLASS = 100;
+
+  typedef std::array<std::atomic<Stats::Counter*>, CODES_PER_CLASS> ClassCounters;
+
+  Stats::Counter& counter(std::atomic<Stats::Counter*>& slot, const std::string& suffix);
+
+  Stats::Scope& scope_;
+  const std::string prefix_;
+  std::array<std::atomic<Stats::Counter*>, NUM_CLASSES> class_counters_{};
+  std::array<std::atomic<ClassCounters*>, NUM_CLASSES> code_counters_{};
+};
+
+/**
+ * Implementation of UpstreamCodeStats. The zone counters are created for each pair of zones the
+ * first time it is charged, and are found in a map after that.
+ */
+class UpstreamCodeStatsImpl : public UpstreamCodeStats {
+public:
+  UpstreamCodeStatsImpl(Stats::Scope& scope);
+
+  // Http::UpstreamCodeStats
+  CodeStats& upstream() override { return upstream_; }
+  CodeStats& canary() override { return canary_; }
+  CodeStats& internal() override { return internal_; }
+  CodeStats& external() override { return external_; }
+  CodeStats& retry() override { return retry_; }
+  CodeStats& zone(const std::string& from_zone, const std::string& to_zone) override;
+
+private:
+  Stats::Scope& scope_;
+  CodeStatsImpl upstream_;
+  CodeStatsImpl canary_;
+  CodeStatsImpl internal_;
+  CodeStatsImpl external_;
+  CodeStatsImpl retry_;
+  std::mutex zone_lock_;
+  std::unordered_map<std::string, std::unordered_map<std::string, std::unique_ptr<CodeStatsImpl>>>
+      zone_stats_;
 };
 
 } // namespace Http
@@ -1,5 +1,6 @@
 #include "common/http/conn_manager_impl.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <functional>
 #include <list>
@@ -19,6 +20,7 @@
 #include "common/common/assert.h"
 #include "common/common/enum_to_int.h"
 #include "common/common/utility.h"
+#include "common/http/access_log/access_log_impl.h"
 #include "common/http/codes.h"
 #include "common/http/conn_manager_utility.h"
 #include "common/http/exception.h"
@@ -34,6 +36,9 @@
 namespace Envoy {
 namespace Http {
 
+const std::string ConnectionManagerImpl::MAX_PIPELINE_DEPTH_KEY = "http.http1.max_pipeline_depth";
+const uint32_t ConnectionManagerImpl::MAX_PIPELINE_DEPTH;
+
 ConnectionManagerStats ConnectionManagerImpl::generateStats(const std::string& prefix,
                                                             Stats::Scope& scope) {
   return {
@@ -53,13 +58,16 @@ ConnectionManagerImpl::ConnectionManagerImpl(ConnectionManagerConfig& config,
                                              Runtime::RandomGenerator& random_generator,
                                              Tracing::HttpTracer& tracer, Runtime::Loader& runtime,
                                              const LocalInfo::LocalInfo& local_info,
-                                             Upstream::ClusterManager& cluster_manager)
+                                             Upstream::ClusterManager& cluster_manager,
+                                             const Server::OverloadManager* overload_manager)
     : config_(config), stats_(config_.stats()),
       conn_length_(stats_.named_.downstream_cx_length_ms_.allocateSpan()),
       drain_close_(drain_close), random_generator_(random_generator), tracer_(tracer),
-      runtime_(runtime), local_info_(local_info), cluster_manager_(cluster_manager) {}
+      runtime_(runtime), local_info_(local_info), cluster_manager_(cluster_manager),
+      overload_manager_(overload_manager) {}
 
 void ConnectionManagerImpl::initializeReadFilterCallbacks(Network::ReadFilterCallbacks& callbacks) {
+  Memory::AllocationScope allocation_scope(allocation_counts_);
   read_callbacks_ = &callbacks;
   stats_.named_.downstream_cx_total_.inc();
   stats_.named_.downstream_cx_active_.inc();
@@ -72,7 +80,7 @@ void ConnectionManagerImpl::initializeReadFilterCallbacks(Network::ReadFilterCal
 
   if (config_.idleTimeout().valid()) {
     idle_timer_ = read_callbacks_->connection().dispatcher().createTimer(
-        [this]() -> void { onIdleTimeout(); });
+        [this]() -> void { onIdleTimeout(); }, Event::TimerPrecision::Coarse);
     idle_timer_->enableTimer(config_.idleTimeout().value());
   }
 
@@ -103,6 +111,15 @@ ConnectionManagerImpl::~ConnectionManagerImpl() {
 
   conn_length_->complete();
   user_agent_.completeConnectionLength(*conn_length_);
+
+  // The allocations of the connection itself, such as of its codec, outside of the processing of
+  // its requests, which is counted per request.
+  if (Memory::AllocationTracker::enabled()) {
+    stats_.scope_.histogram(stats_.prefix_ + "downstream_cx_allocations")
+        .recordValue(allocation_counts_.allocations_);
+    stats_.scope_.histogram(stats_.prefix_ + "downstream_cx_allocated_bytes")
+        .recordValue(allocation_counts_.bytes_);
+  }
 }
 
 void ConnectionManagerImpl::checkForDeferredClose() {
@@ -153,17 +170,7 @@ void ConnectionManagerImpl::doEndStream(ActiveStream& stream) {
 
 void ConnectionManagerImpl::doDeferredStreamDestroy(ActiveStream& stream) {
   stream.state_.destroyed_ = true;
-  for (auto& filter : stream.decoder_filters_) {
-    filter->handle_->onDestroy();
-  }
-
-  for (auto& filter : stream.encoder_filters_) {
-    // Do not call on destroy twice for dual registered filters.
-    if (!filter->dual_filter_) {
-      filter->handle_->onDestroy();
-    }
-  }
-
+  stream.destroyFilters();
   read_callbacks_->connection().dispatcher().deferredDelete(stream.removeFromList(streams_));
 }
 
@@ -174,6 +181,7 @@ StreamDecoder& ConnectionManagerImpl::newStream(StreamEncoder& response_encoder)
 
   ENVOY_CONN_LOG(debug, "new stream", read_callbacks_->connection());
   ActiveStreamPtr new_stream(new ActiveStream(*this));
+  Memory::AllocationScope allocation_scope(new_stream->allocation_counts_);
   new_stream->response_encoder_ = &response_encoder;
   new_stream->response_encoder_->getStream().addCallbacks(*new_stream);
   new_stream->buffer_limit_ = new_stream->response_encoder_->getStream().bufferLimit();
@@ -187,6 +195,7 @@ StreamDecoder& ConnectionManagerImpl::newStream(StreamEncoder& response_encoder)
 }
 
 Network::FilterStatus ConnectionManagerImpl::onData(Buffer::Instance& data) {
+  Memory::AllocationScope allocation_scope(allocation_counts_);
   // Send the data through WebSocket handlers if this connection is a
   // WebSocket connection.  N.B. The first request from the client to Envoy
   // will still be processed as a normal HTTP/1.1 request, where Envoy will
@@ -231,10 +240,11 @@ Network::FilterStatus ConnectionManagerImpl::onData(Buffer::Instance& data) {
     // Processing incoming data may release outbound data so check for closure here as well.
     checkForDeferredClose();
 
-    // The HTTP/1 codec will pause dispatch after a single message is complete. We want to
-    // either redispatch if there are no streams and we have more data. If we have a single
-    // complete non-WebSocket stream but have not responded yet we will pause socket reads
-    // to apply back pressure.
+    // The HTTP/1 codec will pause dispatch once the pipeline is full, which by default is after a
+    // single message is complete. We want to either redispatch if there are no streams and we have
+    // more data. If the newest non-WebSocket stream is complete but we have not responded yet and
+    // either the pipeline is full or the codec left data behind, we will pause socket reads to
+    // apply back pressure. Reads are enabled again when a stream ends.
     if (codec_->protocol() != Protocol::Http2) {
       if (read_callbacks_->connection().state() == Network::Connection::State::Open &&
           data.length() > 0 && streams_.empty()) {
@@ -242,6 +252,7 @@ Network::FilterStatus ConnectionManagerImpl::onData(Buffer::Instance& data) {
       }
 
       if (!streams_.empty() && streams_.front()->state_.remote_complete_ &&
+          (streams_.size() >= codec_->maxPipelineDepth() || data.length() > 0) &&
           !isWebSocketConnection()) {
         read_callbacks_->connection().readDisable(true);
       }
@@ -259,6 +270,7 @@ void ConnectionManagerImpl::resetAllStreams() {
 }
 
 void ConnectionManagerImpl::onEvent(Network::ConnectionEvent event) {
+  Memory::AllocationScope allocation_scope(allocation_counts_);
   if (event == Network::ConnectionEvent::LocalClose) {
     stats_.named_.downstream_cx_destroy_local_.inc();
   }
@@ -354,34 +366,74 @@ ConnectionManagerImpl::ActiveStream::ActiveStream(ConnectionManagerImpl& connect
 }
 
 ConnectionManagerImpl::ActiveStream::~ActiveStream() {
-  connection_manager_.stats_.named_.downstream_rq_active_.dec();
-  for (const AccessLog::InstanceSharedPtr& access_log : connection_manager_.config_.accessLogs()) {
-    access_log->log(request_headers_.get(), response_headers_.get(), request_info_);
-  }
-  for (const auto& log_handler : access_log_handlers_) {
-    log_handler->log(request_headers_.get(), response_headers_.get(), request_info_);
+  {
+    Memory::AllocationScope allocation_scope(allocation_counts_);
+    connection_manager_.stats_.named_.downstream_rq_active_.dec();
+    AccessLog::SharedFilter::newRequest();
+    for (const AccessLog::InstanceSharedPtr& access_log :
+         connection_manager_.config_.accessLogs()) {
+      access_log->log(request_headers_.get(), response_headers_.get(), request_info_);
+    }
+    for (const auto& log_handler : access_log_handlers_) {
+      log_handler->log(request_headers_.get(), response_headers_.get(), request_info_);
+    }
+
+    if (request_info_.healthCheck()) {
+      connection_manager_.config_.tracingStats().health_check_.inc();
+    } else if (active_span_) {
+      Tracing::HttpConnManFinalizerImpl finalizer(request_headers_.get(), request_info_, *this);
+      active_span_->finishSpan(finalizer);
+    }
   }
 
-  if (request_info_.healthCheck()) {
-    connection_manager_.config_.tracingStats().health_check_.inc();
-  } else {
-    Tracing::HttpConnManFinalizerImpl finalizer(request_headers_.get(), request_info_, *this);
-    active_span_->finishSpan(finalizer);
+  // Destroying the members below frees memory but rarely allocates, so nothing is lost by
+  // recording the counts here.
+  if (Memory::AllocationTracker::enabled()) {
+    Stats::Scope& scope = connection_manager_.stats_.scope_;
+    const std::string& prefix = connection_manager_.stats_.prefix_;
+    scope.histogram(prefix + "downstream_rq_allocations")
+        .recordValue(allocation_counts_.allocations_);
+    scope.histogram(prefix + "downstream_rq_allocated_bytes")
+        .recordValue(allocation_counts_.bytes_);
   }
 
   ASSERT(state_.filter_call_state_ == 0);
 }
 
+void ConnectionManagerImpl::ActiveStream::destroyFilters() {
+  for (auto& filter : decoder_filters_) {
+    filter->handle_->onDestroy();
+  }
+
+  for (auto& filter : encoder_filters_) {
+    // Do not call on destroy twice for dual registered filters.
+    if (!filter->dual_filter_) {
+      filter->handle_->onDestroy();
+    }
+  }
+}
+
+void ConnectionManagerImpl::ActiveStream::onUpstreamConnected() {
+  // The filters never see the data of a WebSocket connection, and no response goes through them
+  // once the upstream connection is up. Free them rather than keep them for the life of what may be
+  // a long lived and mostly idle connection.
+  destroyFilters();
+  decoder_filters_.clear();
+  encoder_filters_.clear();
+}
+
 void ConnectionManagerImpl::ActiveStream::addStreamDecoderFilterWorker(
     StreamDecoderFilterSharedPtr filter, bool dual_filter) {
-  ActiveStreamDecoderFilterPtr wrapper(new ActiveStreamDecoderFilter(*this, filter, dual_filter));
+  ActiveStreamDecoderFilterPtr wrapper(
+      new (arena_) ActiveStreamDecoderFilter(*this, filter, dual_filter));
   filter->setDecoderFilterCallbacks(*wrapper);
   wrapper->moveIntoListBack(std::move(wrapper), decoder_filters_);
 }
 
 void ConnectionManagerImpl::ActiveStream::addStreamEncoderFilterWorker(
     StreamEncoderFilterSharedPtr filter, bool dual_filter) {
-  ActiveStreamEncoderFilterPtr wrapper(new ActiveStreamEncoderFilter(*this, filter, dual_filter));
+  ActiveStreamEncoderFilterPtr wrapper(
+      new (arena_) ActiveStreamEncoderFilter(*this, filter, dual_filter));
   filter->setEncoderFilterCallbacks(*wrapper);
   wrapper->moveIntoListBack(std::move(wrapper), encoder_filters_);
 }
@@ -423,6 +475,7 @@ Ssl::Connection* ConnectionManagerImpl::ActiveStream::ssl() {
 }
 
 void ConnectionManagerImpl::ActiveStream::decodeHeaders(HeaderMapPtr&& headers, bool end_stream) {
+  Memory::AllocationScope allocation_scope(allocation_counts_);
   ASSERT(!state_.remote_complete_);
   state_.remote_complete_ = end_stream;
 
@@ -440,6 +493,16 @@ void ConnectionManagerImpl::ActiveStream::decodeHeaders(HeaderMapPtr&& headers,
   connection_manager_.user_agent_.initializeFromHeaders(
       *request_headers_, connection_manager_.stats_.prefix_, connection_manager_.stats_.scope_);
 
+  // Under overload new streams are rejected before they reach the filters, which is as cheap as a
+  // response gets.
+  if (connection_manager_.overloadActive(Server::OverloadAction::RejectNewStreams)) {
+    connection_manager_.stats_.named_.downstream_rq_overload_close_.inc();
+    HeaderMapImpl headers{
+        {Headers::get().Status, std::to_string(enumToInt(Code::ServiceUnavailable))}};
+    encodeHeaders(nullptr, headers, true);
+    return;
+  }
+
   // Make sure we are getting a codec version we support.
   Protocol protocol = connection_manager_.codec_->protocol();
   if (protocol == Protocol::Http10) {
@@ -458,14 +521,13 @@ void ConnectionManagerImpl::ActiveStream::decodeHeaders(HeaderMapPtr&& headers,
     return;
   }
 
-  // Check for maximum incoming header size. Both codecs have some amount of checking for maximum
-  // header size. For HTTP/1.1 the entire headers data has be less than ~80K (hard coded in
-  // http_parser). For HTTP/2 the default allowed header block length is 64k.
-  // In order to have generally uniform behavior we also check total header size here and keep it
-  // under 60K.  Ultimately it would be nice to have a configuration option ranging from the largest
-  // header size http_parser and nghttp2 will allow, down to 16k or 8k for
-  // envoy users who do not wish to proxy large headers.
-  if (request_headers_->byteSize() > (60 * 1024)) {
+  // Check for maximum incoming header size. The codecs already reject requests whose headers go
+  // over the limit while they are decoded, this catches codecs that do not and keeps the behavior
+  // uniform. Both codecs also have hard limits of their own: for HTTP/1.1 the entire headers data
+  // has to be less than ~80K (hard coded in http_parser). For HTTP/2 nghttp2 does not allow
+  // headers larger than ~64K.
+  if (request_headers_->byteSize() >
+      static_cast<uint64_t>(connection_manager_.config_.maxRequestHeadersKb()) * 1024) {
     HeaderMapImpl headers{
         {Headers::get().Status, std::to_string(enumToInt(Code::RequestHeaderFieldsTooLarge))}};
     encodeHeaders(nullptr, headers, true);
@@ -543,6 +605,8 @@ void ConnectionManagerImpl::ActiveStream::decodeHeaders(HeaderMapPtr&& headers,
 
     if (tracing_decision.is_tracing) {
       active_span_ = connection_manager_.tracer_.startSpan(*this, *request_headers_, request_info_);
+    }
+    if (active_span_) {
       if (cached_route_.value() && cached_route_.value()->decorator()) {
         cached_route_.value()->decorator()->apply(*active_span_);
       }
@@ -557,6 +621,7 @@ void ConnectionManagerImpl::ActiveStream::decodeHeaders(HeaderMapPtr&& headers,
 
 void ConnectionManagerImpl::ActiveStream::decodeHeaders(ActiveStreamDecoderFilter* filter,
                                                         HeaderMap& headers, bool end_stream) {
+  Memory::AllocationScope allocation_scope(allocation_counts_);
   std::list<ActiveStreamDecoderFilterPtr>::iterator entry;
   std::list<ActiveStreamDecoderFilterPtr>::iterator continue_data_entry = decoder_filters_.end();
   if (!filter) {
@@ -598,6 +663,7 @@ void ConnectionManagerImpl::ActiveStream::decodeHeaders(ActiveStreamDecoderFilte
 }
 
 void ConnectionManagerImpl::ActiveStream::decodeData(Buffer::Instance& data, bool end_stream) {
+  Memory::AllocationScope allocation_scope(allocation_counts_);
   request_info_.bytes_received_ += data.length();
   ASSERT(!state_.remote_complete_);
   state_.remote_complete_ = end_stream;
@@ -610,6 +676,7 @@ void ConnectionManagerImpl::ActiveStream::decodeData(Buffer::Instance& data, boo
 
 void ConnectionManagerImpl::ActiveStream::decodeData(ActiveStreamDecoderFilter* filter,
                                                      Buffer::Instance& data, bool end_stream) {
+  Memory::AllocationScope allocation_scope(allocation_counts_);
   // If a response is complete or a reset has been sent, filters do not care about further body
   // data. Just drop it.
   if (state_.local_complete_) {
@@ -657,6 +724,7 @@ void ConnectionManagerImpl::ActiveStream::addDecodedData(ActiveStreamDecoderFilt
 }
 
 void ConnectionManagerImpl::ActiveStream::decodeTrailers(HeaderMapPtr&& trailers) {
+  Memory::AllocationScope allocation_scope(allocation_counts_);
   request_trailers_ = std::move(trailers);
   ASSERT(!state_.remote_complete_);
   state_.remote_complete_ = true;
@@ -665,6 +733,7 @@ void ConnectionManagerImpl::ActiveStream::decodeTrailers(HeaderMapPtr&& trailers
 
 void ConnectionManagerImpl::ActiveStream::decodeTrailers(ActiveStreamDecoderFilter* filter,
                                                          HeaderMap& trailers) {
+  Memory::AllocationScope allocation_scope(allocation_counts_);
   // See decodeData() above for why we check local_complete_ here.
   if (state_.local_complete_) {
     return;
@@ -718,6 +787,7 @@ void ConnectionManagerImpl::startDrainSequence() {
 
 void ConnectionManagerImpl::ActiveStream::encodeHeaders(ActiveStreamEncoderFilter* filter,
                                                         HeaderMap& headers, bool end_stream) {
+  Memory::AllocationScope allocation_scope(allocation_counts_);
   std::list<ActiveStreamEncoderFilterPtr>::iterator entry = commonEncodePrefix(filter, end_stream);
   std::list<ActiveStreamEncoderFilterPtr>::iterator continue_data_entry = encoder_filters_.end();
 
@@ -749,6 +819,19 @@ void ConnectionManagerImpl::ActiveStream::encodeHeaders(ActiveStreamEncoderFilte
 
   // See if we want to drain/close the connection. Send the go away frame prior to encoding the
   // header block.
+  if (connection_manager_.drain_state_ == DrainState::NotDraining &&
+      connection_manager_.overloadActive(Server::OverloadAction::DisableHttpKeepAlive)) {
+    // An HTTP/2 connection gets a go away frame so that its other streams can finish, any other
+    // one is closed once the response is done, as with a connection close header.
+    connection_manager_.stats_.named_.downstream_cx_overload_disable_keepalive_.inc();
+    ENVOY_STREAM_LOG(debug, "closing connection due to overload", *this);
+    if (connection_manager_.codec_->protocol() == Protocol::Http2) {
+      connection_manager_.startDrainSequence();
+    } else {
+      connection_manager_.drain_state_ = DrainState::Closing;
+    }
+  }
+
   if (connection_manager_.drain_state_ == DrainState::NotDraining &&
       connection_manager_.drain_close_.drainClose()) {
 
@@ -831,6 +914,7 @@ void ConnectionManagerImpl::ActiveStream::addEncodedData(ActiveStreamEncoderFilt
 
 void ConnectionManagerImpl::ActiveStream::encodeData(ActiveStreamEncoderFilter* filter,
                                                      Buffer::Instance& data, bool end_stream) {
+  Memory::AllocationScope allocation_scope(allocation_counts_);
   std::list<ActiveStreamEncoderFilterPtr>::iterator entry = commonEncodePrefix(filter, end_stream);
   for (; entry != encoder_filters_.end(); entry++) {
     ASSERT(!(state_.filter_call_state_ & FilterCallState::EncodeData));
@@ -854,6 +938,7 @@ void ConnectionManagerImpl::ActiveStream::encodeData(ActiveStreamEncoderFilter*
 
 void ConnectionManagerImpl::ActiveStream::encodeTrailers(ActiveStreamEncoderFilter* filter,
                                                          HeaderMap& trailers) {
+  Memory::AllocationScope allocation_scope(allocation_counts_);
   std::list<ActiveStreamEncoderFilterPtr>::iterator entry = commonEncodePrefix(filter, true);
   for (; entry != encoder_filters_.end(); entry++) {
     ASSERT(!(state_.filter_call_state_ & FilterCallState::EncodeTrailers));
@@ -889,6 +974,7 @@ void ConnectionManagerImpl::ActiveStream::maybeEndEncode(bool end_stream) {
 }
 
 void ConnectionManagerImpl::ActiveStream::onResetStream(StreamResetReason) {
+  Memory::AllocationScope allocation_scope(allocation_counts_);
   // NOTE: This function gets called in all of the following cases:
   //       1) We TX an app level reset
   //       2) The codec TX a codec level reset
@@ -1056,7 +1142,10 @@ AccessLog::RequestInfo& ConnectionManagerImpl::ActiveStreamFilterBase::requestIn
 }
 
 Tracing::Span& ConnectionManagerImpl::ActiveStreamFilterBase::activeSpan() {
-  return *parent_.active_span_;
+  if (parent_.active_span_) {
+    return *parent_.active_span_;
+  }
+  return Tracing::NullSpan::instance();
 }
 
 Router::RouteConstSharedPtr ConnectionManagerImpl::ActiveStreamFilterBase::route() {
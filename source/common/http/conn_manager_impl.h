@@ -18,17 +18,21 @@
 #include "envoy/network/filter.h"
 #include "envoy/router/rds.h"
 #include "envoy/runtime/runtime.h"
+#include "envoy/server/overload_manager.h"
 #include "envoy/ssl/connection.h"
 #include "envoy/stats/stats_macros.h"
 #include "envoy/tracing/http_tracer.h"
 #include "envoy/upstream/upstream.h"
 
 #include "common/buffer/watermark_buffer.h"
+#include "common/common/arena.h"
 #include "common/common/linked_object.h"
+#include "common/common/object_pool.h"
 #include "common/http/access_log/request_info_impl.h"
 #include "common/http/date_provider.h"
 #include "common/http/user_agent.h"
 #include "common/http/websocket/ws_handler_impl.h"
+#include "common/memory/allocation_tracker.h"
 #include "common/tracing/http_tracer_impl.h"
 
 namespace Envoy {
@@ -63,6 +67,7 @@ namespace Http {
   GAUGE  (downstream_cx_tx_bytes_buffered)                                                         \
   COUNTER(downstream_cx_drain_close)                                                               \
   COUNTER(downstream_cx_idle_timeout)                                                              \
+  COUNTER(downstream_cx_overload_disable_keepalive)                                                \
   COUNTER(downstream_flow_control_paused_reading_total)                                            \
   COUNTER(downstream_flow_control_resumed_reading_total)                                           \
   COUNTER(downstream_rq_total)                                                                     \
@@ -73,6 +78,7 @@ namespace Http {
   COUNTER(downstream_rq_rx_reset)                                                                  \
   COUNTER(downstream_rq_tx_reset)                                                                  \
   COUNTER(downstream_rq_non_relative_path)                                                         \
+  COUNTER(downstream_rq_overload_close)                                                            \
   COUNTER(downstream_rq_ws_on_non_ws_route)                                                        \
   COUNTER(downstream_rq_non_ws_on_ws_route)                                                        \
   COUNTER(downstream_rq_too_large)                                                              \
@@ -198,6 +204,12 @@ public:
    */
   virtual const Optional<std::chrono::milliseconds>& idleTimeout() PURE;
 
+  /**
+   * @return uint32_t the maximum size in KiB of the headers of a request. Larger requests are
+   *         rejected with a 431.
+   */
+  virtual uint32_t maxRequestHeadersKb() PURE;
+
   /**
    * @return Router::RouteConfigProvider& the configuration provider used to acquire a route
    *         config for each request flow.
@@ -265,12 +277,23 @@ class ConnectionManagerImpl : Logger::Loggable<Logger::Id::http>,
                               public ServerConnectionCallbacks,
                               public Network::ConnectionCallbacks {
 public:
+  /**
+   * @param overload_manager supplies the overload manager that disables keep alive and rejects new
+   *        streams, or nullptr for connections that are never shed, such as the admin ones.
+   */
   ConnectionManagerImpl(ConnectionManagerConfig& config, const Network::DrainDecision& drain_close,
                         Runtime::RandomGenerator& random_generator, Tracing::HttpTracer& tracer,
                         Runtime::Loader& runtime, const LocalInfo::LocalInfo& local_info,
-                        Upstream::ClusterManager& cluster_manager);
+                        Upstream::ClusterManager& cluster_manager,
+                        const Server::OverloadManager* overload_manager);
   ~ConnectionManagerImpl();
 
+  // Runtime key for the maximum number of pipelined HTTP/1.1 requests processed concurrently on a
+  // connection. Read by the config when it creates the codec for a connection, which then reports
+  // it through ServerConnection::maxPipelineDepth(). Values are clamped to [1, MAX_PIPELINE_DEPTH].
+  static const std::string MAX_PIPELINE_DEPTH_KEY;
+  static const uint32_t MAX_PIPELINE_DEPTH = 100;
+
   static ConnectionManagerStats generateStats(const std::string& prefix, Stats::Scope& scope);
   static ConnectionManagerTracingStats generateTracingStats(const std::string& prefix,
                                                             Stats::Scope& scope);
@@ -304,7 +327,7 @@ private:
   /**
    * Base class wrapper for both stream encoder and decoder filters.
    */
-  struct ActiveStreamFilterBase : public virtual StreamFilterCallbacks {
+  struct ActiveStreamFilterBase : public virtual StreamFilterCallbacks, public ArenaObject {
     ActiveStreamFilterBase(ActiveStream& parent, bool dual_filter)
         : parent_(parent), headers_continued_(false), stopped_(false), dual_filter_(dual_filter) {}
 
@@ -436,6 +459,7 @@ private:
    * or pushes.
    */
   struct ActiveStream : LinkedObject<ActiveStream>,
+                        public PooledObject<ActiveStream>,
                         public Event::DeferredDeletable,
                         public StreamCallbacks,
                         public StreamDecoder,
@@ -447,6 +471,7 @@ private:
 
     void addStreamDecoderFilterWorker(StreamDecoderFilterSharedPtr filter, bool dual_filter);
     void addStreamEncoderFilterWorker(StreamEncoderFilterSharedPtr filter, bool dual_filter);
+    void destroyFilters();
     void chargeStats(HeaderMap& headers);
     std::list<ActiveStreamEncoderFilterPtr>::iterator
     commonEncodePrefix(ActiveStreamEncoderFilter* filter, bool end_stream);
@@ -491,6 +516,7 @@ private:
     void sendHeadersOnlyResponse(HeaderMap& headers) override {
       encodeHeaders(nullptr, headers, true);
     }
+    void onUpstreamConnected() override;
 
     // Tracing::TracingConfig
     virtual Tracing::OperationName operationName() const override;
@@ -535,8 +561,12 @@ private:
     void setBufferLimit(uint32_t limit);
 
     ConnectionManagerImpl& connection_manager_;
+    // Backs per-stream allocations such as the filter wrappers. Declared before anything that
+    // allocates from it so that it is destroyed last.
+    Arena arena_;
     Router::ConfigConstSharedPtr snapped_route_config_;
-    Tracing::SpanPtr active_span_{new Tracing::NullSpan()};
+    // Only set when the request is traced, so that untraced requests do not allocate a span.
+    Tracing::SpanPtr active_span_;
     const uint64_t stream_id_;
     StreamEncoder* response_encoder_{};
     HeaderMapPtr response_headers_;
@@ -547,7 +577,9 @@ private:
     HeaderMapPtr request_trailers_;
     std::list<ActiveStreamDecoderFilterPtr> decoder_filters_;
     std::list<ActiveStreamEncoderFilterPtr> encoder_filters_;
-    std::list<Http::AccessLog::InstanceSharedPtr> access_log_handlers_;
+    std::list<Http::AccessLog::InstanceSharedPtr,
+              ArenaAllocator<Http::AccessLog::InstanceSharedPtr>>
+        access_log_handlers_{ArenaAllocator<Http::AccessLog::InstanceSharedPtr>(&arena_)};
     Stats::TimespanPtr request_timer_;
     State state_;
     AccessLog::RequestInfoImpl request_info_;
@@ -556,6 +588,8 @@ private:
     DownstreamWatermarkCallbacks* watermark_callbacks_{nullptr};
     uint32_t buffer_limit_{0};
     uint32_t high_watermark_count_{0};
+    // The allocations made for the stream while tracking is on. @see Memory::AllocationTracker.
+    Memory::AllocationCounts allocation_counts_;
   };
 
   typedef std::unique_ptr<ActiveStream> ActiveStreamPtr;
@@ -586,6 +620,10 @@ private:
 
   enum class DrainState { NotDraining, Draining, Closing };
 
+  bool overloadActive(Server::OverloadAction action) const {
+    return overload_manager_ != nullptr && overload_manager_->isActive(action);
+  }
+
   ConnectionManagerConfig& config_;
   ConnectionManagerStats& stats_; // We store a reference here to avoid an extra stats() call on the
                                   // config in the hot path.
@@ -602,8 +640,10 @@ private:
   Runtime::Loader& runtime_;
   const LocalInfo::LocalInfo& local_info_;
   Upstream::ClusterManager& cluster_manager_;
+  const Server::OverloadManager* const overload_manager_;
   WebSocket::WsHandlerImplPtr ws_connection_{};
   Network::ReadFilterCallbacks* read_callbacks_{};
+  Memory::AllocationCounts allocation_counts_;
 };
 
 } // Http
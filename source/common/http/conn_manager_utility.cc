@@ -90,6 +90,7 @@ void ConnectionManagerUtility::mutateRequestHeaders(
     request_headers.removeEnvoyUpstreamAltStatName();
     request_headers.removeEnvoyUpstreamRequestTimeoutMs();
     request_headers.removeEnvoyUpstreamRequestPerTryTimeoutMs();
+    request_headers.removeEnvoyUpstreamRequestHedgeDelayMs();
     request_headers.removeEnvoyUpstreamRequestTimeoutAltResponse();
     request_headers.removeEnvoyExpectedRequestTimeoutMs();
     request_headers.removeEnvoyForceTrace();
@@ -100,16 +101,18 @@ void ConnectionManagerUtility::mutateRequestHeaders(
   }
 
   if (config.userAgent().valid()) {
-    request_headers.insertEnvoyDownstreamServiceCluster().value(config.userAgent().value());
+    // The following setReference() calls are safe because the user agent is constant for the life
+    // of the listener.
+    request_headers.insertEnvoyDownstreamServiceCluster().value().setReference(
+        config.userAgent().value());
     HeaderEntry& user_agent_header = request_headers.insertUserAgent();
     if (user_agent_header.value().empty()) {
-      // Following setReference() is safe because user agent is constant for the life of the
-      // listener.
       user_agent_header.value().setReference(config.userAgent().value());
     }
 
-    if (!local_info.nodeName().empty()) {
-      request_headers.insertEnvoyDownstreamServiceNode().value(local_info.nodeName());
+    const std::string node_name = local_info.nodeName();
+    if (!node_name.empty()) {
+      request_headers.insertEnvoyDownstreamServiceNode().value(node_name);
     }
   }
 
@@ -122,10 +125,10 @@ void ConnectionManagerUtility::mutateRequestHeaders(
 
   // Generate x-request-id for all edge requests, or if there is none.
   if (config.generateRequestId() && (edge_request || !request_headers.RequestId())) {
-    // TODO(PiotrSikora) PERF: Write UUID directly to the header map.
-    const std::string uuid = random.uuid();
-    ASSERT(!uuid.empty());
-    request_headers.insertRequestId().value(uuid);
+    // The uuid fits in the inline buffer of the header value, so no allocation is needed.
+    char uuid[Runtime::RandomGenerator::UUID_LENGTH];
+    random.uuid(uuid);
+    request_headers.insertRequestId().value(uuid, sizeof(uuid));
   }
 
   if (config.tracingConfig()) {
@@ -161,11 +164,14 @@ void ConnectionManagerUtility::mutateXfccRequestHeader(Http::HeaderMap& request_
   // the XFCC header.
   if (config.forwardClientCert() == Http::ForwardClientCertType::AppendForward ||
       config.forwardClientCert() == Http::ForwardClientCertType::SanitizeSet) {
-    if (!connection.ssl()->uriSanLocalCertificate().empty()) {
-      client_cert_details.push_back("By=" + connection.ssl()->uriSanLocalCertificate());
+    const std::string uri_san_local_certificate = connection.ssl()->uriSanLocalCertificate();
+    if (!uri_san_local_certificate.empty()) {
+      client_cert_details.push_back("By=" + uri_san_local_certificate);
     }
-    if (!connection.ssl()->sha256PeerCertificateDigest().empty()) {
-      client_cert_details.push_back("Hash=" + connection.ssl()->sha256PeerCertificateDigest());
+    const std::string sha256_peer_certificate_digest =
+        connection.ssl()->sha256PeerCertificateDigest();
+    if (!sha256_peer_certificate_digest.empty()) {
+      client_cert_details.push_back("Hash=" + sha256_peer_certificate_digest);
     }
     for (const auto& detail : config.setCurrentClientCertDetails()) {
       switch (detail) {
@@ -34,7 +34,11 @@ FilterHeadersStatus BufferFilter::decodeHeaders(HeaderMap&, bool end_stream) {
   }
 }
 
-FilterDataStatus BufferFilter::decodeData(Buffer::Instance&, bool end_stream) {
+FilterDataStatus BufferFilter::decodeData(Buffer::Instance& data, bool end_stream) {
+  if (config_->spill_) {
+    return spillData(data, end_stream);
+  }
+
   if (end_stream) {
     resetInternalState();
     return FilterDataStatus::Continue;
@@ -45,6 +49,21 @@ FilterDataStatus BufferFilter::decodeData(Buffer::Instance&, bool end_stream) {
 }
 
 FilterTrailersStatus BufferFilter::decodeTrailers(HeaderMap&) {
+  if (config_->spill_) {
+    // The body can't be added to the stream from the trailers callback while the headers are
+    // stopped, so it is added once the callback is over.
+    request_complete_ = true;
+    if (pending_write_bytes_ == 0) {
+      std::shared_ptr<bool> active = active_;
+      callbacks_->dispatcher().post([this, active]() -> void {
+        if (*active) {
+          continueWithBody();
+        }
+      });
+    }
+    return FilterTrailersStatus::StopIteration;
+  }
+
   resetInternalState();
   return FilterTrailersStatus::Continue;
 }
@@ -60,12 +79,134 @@ void BufferFilter::onDestroy() {
 }
 
 void BufferFilter::onRequestTimeout() {
+  resetSpillState();
   Http::Utility::sendLocalReply(*callbacks_, stream_destroyed_, Http::Code::RequestTimeout,
                                 "buffer request timeout");
   config_->stats_.rq_timeout_.inc();
 }
 
-void BufferFilter::resetInternalState() { request_timeout_.reset(); }
+void BufferFilter::resetInternalState() {
+  request_timeout_.reset();
+  resetSpillState();
+}
+
+void BufferFilter::resetSpillState() {
+  if (!config_->spill_) {
+    return;
+  }
+  *active_ = false;
+  config_->spill_->releaseMemory(memory_reserved_);
+  memory_reserved_ = 0;
+  memory_.drain(memory_.length());
+  spill_file_.reset();
+}
+
+FilterDataStatus BufferFilter::spillData(Buffer::Instance& data, bool end_stream) {
+  BufferSpillConfig& spill_config = *config_->spill_;
+  body_bytes_ += data.length();
+  if (body_bytes_ > config_->max_request_bytes_) {
+    config_->stats_.rq_too_large_.inc();
+    resetInternalState();
+    Http::Utility::sendLocalReply(*callbacks_, stream_destroyed_, Http::Code::PayloadTooLarge,
+                                  CodeUtility::toString(Http::Code::PayloadTooLarge));
+    return FilterDataStatus::StopIterationNoBuffer;
+  }
+
+  // The body stays in memory until the stream or the filter runs out of memory budget. Once a
+  // stream spills, the rest of its body is spilled too so that the file follows the memory.
+  if (!spill_file_ && memory_.length() + data.length() <= spill_config.stream_memory_bytes_ &&
+      spill_config.reserveMemory(data.length())) {
+    memory_reserved_ += data.length();
+    memory_.move(data);
+  } else if (data.length() > 0) {
+    if (!spill_file_) {
+      spill_file_ = SpillFile::create(spill_config.directory_);
+      if (!spill_file_) {
+        sendSpillError();
+        return FilterDataStatus::StopIterationNoBuffer;
+      }
+      config_->stats_.rq_spilled_.inc();
+    }
+    spill(data);
+  }
+
+  if (!end_stream) {
+    return FilterDataStatus::StopIterationNoBuffer;
+  }
+  request_complete_ = true;
+  if (pending_write_bytes_ > 0) {
+    return FilterDataStatus::StopIterationNoBuffer;
+  }
+  if (!restoreBody(data)) {
+    sendSpillError();
+    return FilterDataStatus::StopIterationNoBuffer;
+  }
+  resetInternalState();
+  return FilterDataStatus::Continue;
+}
+
+void BufferFilter::spill(Buffer::Instance& data) {
+  const uint64_t bytes = data.length();
+  pending_write_bytes_ += bytes;
+  spilled_bytes_ += bytes;
+  std::shared_ptr<bool> active = active_;
+  config_->spill_->writer().write(spill_file_, data, [this, active, bytes](bool success) -> void {
+    if (*active) {
+      onSpillWriteComplete(bytes, success);
+    }
+  });
+
+  // The writes that are queued are in memory, so the downstream stops reading once they take more
+  // than the memory of a stream.
+  if (!above_write_high_watermark_ &&
+      pending_write_bytes_ > config_->spill_->stream_memory_bytes_) {
+    above_write_high_watermark_ = true;
+    callbacks_->onDecoderFilterAboveWriteBufferHighWatermark();
+  }
+}
+
+void BufferFilter::onSpillWriteComplete(uint64_t bytes, bool success) {
+  pending_write_bytes_ -= bytes;
+  if (!success) {
+    sendSpillError();
+    return;
+  }
+  config_->stats_.spilled_bytes_.add(bytes);
+
+  if (above_write_high_watermark_ &&
+      pending_write_bytes_ <= config_->spill_->stream_memory_bytes_ / 2) {
+    above_write_high_watermark_ = false;
+    callbacks_->onDecoderFilterBelowWriteBufferLowWatermark();
+  }
+  if (request_complete_ && pending_write_bytes_ == 0) {
+    continueWithBody();
+  }
+}
+
+bool BufferFilter::restoreBody(Buffer::Instance& body) {
+  body.move(memory_);
+  return !spill_file_ || spill_file_->mapInto(body, spilled_bytes_);
+}
+
+void BufferFilter::continueWithBody() {
+  Buffer::OwnedImpl body;
+  if (!restoreBody(body)) {
+    sendSpillError();
+    return;
+  }
+  resetInternalState();
+  if (body.length() > 0) {
+    callbacks_->addDecodedData(body, false);
+  }
+  callbacks_->continueDecoding();
+}
+
+void BufferFilter::sendSpillError() {
+  config_->stats_.spill_error_.inc();
+  resetInternalState();
+  Http::Utility::sendLocalReply(*callbacks_, stream_destroyed_, Http::Code::InternalServerError,
+                                "buffer spill error");
+}
 
 void BufferFilter::setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callbacks) {
   callbacks_ = &callbacks;
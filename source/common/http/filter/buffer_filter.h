@@ -9,6 +9,7 @@
 #include "envoy/stats/stats_macros.h"
 
 #include "common/buffer/buffer_impl.h"
+#include "common/http/filter/buffer_spill.h"
 
 namespace Envoy {
 namespace Http {
@@ -18,7 +19,11 @@ namespace Http {
  */
 // clang-format off
 #define ALL_BUFFER_FILTER_STATS(COUNTER)                                                           \
-  COUNTER(rq_timeout)
+  COUNTER(rq_timeout)                                                                              \
+  COUNTER(rq_too_large)                                                                            \
+  COUNTER(rq_spilled)                                                                              \
+  COUNTER(spilled_bytes)                                                                           \
+  COUNTER(spill_error)
 // clang-format on
 
 /**
@@ -35,6 +40,9 @@ struct BufferFilterConfig {
   BufferFilterStats stats_;
   uint64_t max_request_bytes_;
   std::chrono::seconds max_request_time_;
+  // Set when the body is buffered by the filter and spilled to disk past its memory budget, rather
+  // than buffered in memory by the connection manager.
+  BufferSpillConfigSharedPtr spill_;
 };
 
 typedef std::shared_ptr<const BufferFilterConfig> BufferFilterConfigConstSharedPtr;
@@ -61,11 +69,30 @@ public:
 private:
   void onRequestTimeout();
   void resetInternalState();
+  void resetSpillState();
+  FilterDataStatus spillData(Buffer::Instance& data, bool end_stream);
+  void spill(Buffer::Instance& data);
+  void onSpillWriteComplete(uint64_t bytes, bool success);
+  bool restoreBody(Buffer::Instance& body);
+  void continueWithBody();
+  void sendSpillError();
 
   BufferFilterConfigConstSharedPtr config_;
   StreamDecoderFilterCallbacks* callbacks_{};
   Event::TimerPtr request_timeout_;
   bool stream_destroyed_{};
+
+  // Spill mode state. The body is memory_ followed by the spilled_bytes_ of spill_file_.
+  Buffer::OwnedImpl memory_;
+  uint64_t memory_reserved_{};
+  uint64_t body_bytes_{};
+  SpillFileSharedPtr spill_file_;
+  uint64_t spilled_bytes_{};
+  uint64_t pending_write_bytes_{};
+  bool above_write_high_watermark_{};
+  bool request_complete_{};
+  // Shared with the completions of the writes. Cleared once they must not touch the filter.
+  std::shared_ptr<bool> active_{std::make_shared<bool>(true)};
 };
 
 } // Http
@@ -0,0 +1,170 @@
+#include "common/http/filter/buffer_spill.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Http {
+
+namespace {
+
+/**
+ * A fragment that references a mapping of a spill file, and unmaps it once it is done.
+ */
+class MappedFileFragment : public Buffer::BufferFragment {
+public:
+  MappedFileFragment(void* data, size_t size) : data_(data), size_(size) {}
+
+  // Buffer::BufferFragment
+  const void* data() const override { return data_; }
+  size_t size() const override { return size_; }
+  void done() override {
+    munmap(data_, size_);
+    delete this;
+  }
+
+private:
+  void* const data_;
+  const size_t size_;
+};
+
+} // namespace
+
+SpillFile::~SpillFile() { close(fd_); }
+
+SpillFileSharedPtr SpillFile::create(const std::string& directory) {
+  std::vector<char> path(directory.begin(), directory.end());
+  const std::string name = "/envoy_buffer_XXXXXX";
+  path.insert(path.end(), name.begin(), name.end());
+  path.push_back('\0');
+  const int fd = mkstemp(path.data());
+  if (fd == -1) {
+    return nullptr;
+  }
+  unlink(path.data());
+  return SpillFileSharedPtr{new SpillFile(fd)};
+}
+
+bool SpillFile::write(const Buffer::Instance& data) {
+  const uint64_t num_slices = data.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  data.getRawSlices(slices, num_slices);
+  for (const Buffer::RawSlice& slice : slices) {
+    const char* mem = static_cast<const char*>(slice.mem_);
+    size_t remaining = slice.len_;
+    while (remaining > 0) {
+      const ssize_t rc = ::write(fd_, mem, remaining);
+      if (rc == -1 && errno == EINTR) {
+        continue;
+      }
+      if (rc <= 0) {
+        return false;
+      }
+      mem += rc;
+      remaining -= rc;
+    }
+  }
+  return true;
+}
+
+bool SpillFile::mapInto(Buffer::Instance& buffer, uint64_t size) {
+  if (size == 0) {
+    return true;
+  }
+  void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd_, 0);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  // The kernel can drop the pages of the mapping under memory pressure and read them back later,
+  // which anonymous memory can't do without swap.
+  buffer.addBufferFragment(*new MappedFileFragment(data, size));
+  return true;
+}
+
+SpillWriter::SpillWriter(Event::Dispatcher& dispatcher)
+    : dispatcher_(dispatcher), thread_(new Thread::Thread([this]() -> void { threadRoutine(); })) {
+}
+
+SpillWriter::~SpillWriter() {
+  {
+    std::unique_lock<std::mutex> lock(queue_lock_);
+    shutdown_ = true;
+  }
+  queue_event_.notify_one();
+  thread_->join();
+}
+
+void SpillWriter::write(SpillFileSharedPtr file, Buffer::Instance& data, WriteCompleteCb cb) {
+  // The data is copied rather than moved or shared, since the buffer fragments it may reference
+  // must not be released by the writer thread.
+  std::unique_ptr<Buffer::Instance> copy{new Buffer::OwnedImpl()};
+  const uint64_t num_slices = data.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  data.getRawSlices(slices, num_slices);
+  for (const Buffer::RawSlice& slice : slices) {
+    copy->add(slice.mem_, slice.len_);
+  }
+  data.drain(data.length());
+  {
+    std::unique_lock<std::mutex> lock(queue_lock_);
+    queue_.push_back({file, std::move(copy), cb});
+  }
+  queue_event_.notify_one();
+}
+
+void SpillWriter::threadRoutine() {
+  while (true) {
+    Write write;
+    {
+      std::unique_lock<std::mutex> lock(queue_lock_);
+      queue_event_.wait(lock, [this]() -> bool { return shutdown_ || !queue_.empty(); });
+      // The writes that are still queued belong to streams that are gone.
+      if (shutdown_) {
+        return;
+      }
+      write = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    const bool success = write.file_->write(*write.data_);
+    WriteCompleteCb cb = write.cb_;
+    dispatcher_.post([cb, success]() -> void { cb(success); });
+  }
+}
+
+BufferSpillConfig::BufferSpillConfig(const Json::Object& json_config,
+                                     ThreadLocal::SlotAllocator& tls)
+    : directory_(json_config.getString("directory", "/tmp")),
+      max_memory_bytes_(json_config.getInteger("max_memory_bytes", 64 * 1024 * 1024)),
+      stream_memory_bytes_(json_config.getInteger("stream_memory_bytes", 64 * 1024)),
+      tls_(tls.allocateSlot()) {
+  tls_->set([](Event::Dispatcher& dispatcher) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return ThreadLocal::ThreadLocalObjectSharedPtr{new SpillWriter(dispatcher)};
+  });
+}
+
+bool BufferSpillConfig::reserveMemory(uint64_t bytes) {
+  uint64_t current = memory_bytes_.load();
+  do {
+    if (current + bytes > max_memory_bytes_) {
+      return false;
+    }
+  } while (!memory_bytes_.compare_exchange_weak(current, current + bytes));
+  return true;
+}
+
+void BufferSpillConfig::releaseMemory(uint64_t bytes) {
+  ASSERT(memory_bytes_ >= bytes);
+  memory_bytes_ -= bytes;
+}
+
+} // namespace Http
+} // namespace Envoy
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "envoy/buffer/buffer.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/json/json_object.h"
+#include "envoy/thread_local/thread_local.h"
+
+#include "common/common/non_copyable.h"
+#include "common/common/thread.h"
+
+namespace Envoy {
+namespace Http {
+
+class SpillFile;
+typedef std::shared_ptr<SpillFile> SpillFileSharedPtr;
+
+/**
+ * A temporary file that holds the part of a request body that does not fit in memory. The file
+ * is unlinked as soon as it is created, so that it goes away with its last descriptor and mapping
+ * whatever happens to the process.
+ */
+class SpillFile : NonCopyable {
+public:
+  ~SpillFile();
+
+  /**
+   * @param directory supplies the directory of the file.
+   * @return SpillFileSharedPtr a new empty file, or nullptr if it could not be created.
+   */
+  static SpillFileSharedPtr create(const std::string& directory);
+
+  /**
+   * Append data to the file. Only called by the thread of a SpillWriter.
+   * @return bool whether all of the data was written.
+   */
+  bool write(const Buffer::Instance& data);
+
+  /**
+   * Add the first bytes of the file to a buffer without copying them. The buffer references a
+   * read only mapping of the file, which is unmapped once the buffer is done with it.
+   * @param buffer supplies the buffer to add the bytes to.
+   * @param size supplies the number of bytes to add.
+   * @return bool whether the file could be mapped.
+   */
+  bool mapInto(Buffer::Instance& buffer, uint64_t size);
+
+private:
+  SpillFile(int fd) : fd_(fd) {}
+
+  const int fd_;
+};
+
+/**
+ * Writes spill files on a thread of its own, so that the worker that owns the writer does not
+ * block on the disk. The completion of a write is posted back to the dispatcher of the worker.
+ */
+class SpillWriter : public ThreadLocal::ThreadLocalObject {
+public:
+  /**
+   * Called on the dispatcher once a write is done.
+   * @param success supplies whether all of the data was written.
+   */
+  typedef std::function<void(bool success)> WriteCompleteCb;
+
+  SpillWriter(Event::Dispatcher& dispatcher);
+  ~SpillWriter();
+
+  /**
+   * Queue the data to append to a file. The writes of a file are done in order.
+   * @param file supplies the file to write to.
+   * @param data supplies the data to write, which is drained from the buffer.
+   * @param cb supplies the callback to post once the write is done.
+   */
+  void write(SpillFileSharedPtr file, Buffer::Instance& data, WriteCompleteCb cb);
+
+private:
+  struct Write {
+    SpillFileSharedPtr file_;
+    std::unique_ptr<Buffer::Instance> data_;
+    WriteCompleteCb cb_;
+  };
+
+  void threadRoutine();
+
+  Event::Dispatcher& dispatcher_;
+  std::list<Write> queue_;
+  std::mutex queue_lock_;
+  std::condition_variable queue_event_;
+  bool shutdown_{};
+  Thread::ThreadPtr thread_;
+};
+
+/**
+ * Configuration of the spill mode of the buffer filter.
+ */
+class BufferSpillConfig {
+public:
+  BufferSpillConfig(const Json::Object& json_config, ThreadLocal::SlotAllocator& tls);
+
+  SpillWriter& writer() { return tls_->getTyped<SpillWriter>(); }
+
+  /**
+   * Take bytes from the memory budget that is shared by all the streams on all the workers.
+   * @return bool whether the budget had room for them.
+   */
+  bool reserveMemory(uint64_t bytes);
+
+  /**
+   * Return bytes to the memory budget.
+   */
+  void releaseMemory(uint64_t bytes);
+
+  uint64_t memoryBytes() const { return memory_bytes_; }
+
+  const std::string directory_;
+  const uint64_t max_memory_bytes_;
+  const uint64_t stream_memory_bytes_;
+
+private:
+  std::atomic<uint64_t> memory_bytes_{};
+  ThreadLocal::SlotPtr tls_;
+};
+
+typedef std::shared_ptr<BufferSpillConfig> BufferSpillConfigSharedPtr;
+
+} // namespace Http
+} // namespace Envoy
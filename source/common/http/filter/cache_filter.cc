@@ -0,0 +1,461 @@
+#include "common/http/filter/cache_filter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "envoy/http/codes.h"
+
+#include "common/buffer/buffer_impl.h"
+#include "common/common/assert.h"
+#include "common/common/enum_to_int.h"
+#include "common/common/utility.h"
+#include "common/http/header_map_impl.h"
+#include "common/http/headers.h"
+
+namespace Envoy {
+namespace Http {
+
+namespace {
+
+std::string trim(const std::string& value) {
+  const size_t start = value.find_first_not_of(" \t");
+  if (start == std::string::npos) {
+    return "";
+  }
+  return value.substr(start, value.find_last_not_of(" \t") - start + 1);
+}
+
+std::string toLower(std::string value) {
+  std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+  return value;
+}
+
+// The trimmed elements of a comma separated header value.
+std::vector<std::string> headerList(const char* value) {
+  std::vector<std::string> elements;
+  for (const std::string& element : StringUtil::split(value, ',')) {
+    std::string trimmed = trim(element);
+    if (!trimmed.empty()) {
+      elements.push_back(std::move(trimmed));
+    }
+  }
+  return elements;
+}
+
+// The header names of a Vary header, lower cased.
+std::vector<std::string> varyHeaders(const HeaderMap& response_headers) {
+  std::vector<std::string> names;
+  const HeaderEntry* vary = response_headers.get(Headers::get().Vary);
+  if (vary != nullptr) {
+    for (const std::string& name : headerList(vary->value().c_str())) {
+      names.push_back(toLower(name));
+    }
+  }
+  return names;
+}
+
+/**
+ * A fragment of the body of a cached response. It keeps the body alive until the buffers that
+ * reference it are done.
+ */
+class CachedBodyFragment : public Buffer::BufferFragment {
+public:
+  CachedBodyFragment(std::shared_ptr<const std::string> body) : body_(body) {}
+
+  // Buffer::BufferFragment
+  const void* data() const override { return body_->data(); }
+  size_t size() const override { return body_->size(); }
+  void done() override { delete this; }
+
+private:
+  const std::shared_ptr<const std::string> body_;
+};
+
+} // namespace
+
+CacheControl::CacheControl(const std::string& value) {
+  Optional<std::chrono::seconds> max_age;
+  Optional<std::chrono::seconds> s_maxage;
+  for (const std::string& directive : headerList(value.c_str())) {
+    const size_t equals = directive.find('=');
+    const std::string name = toLower(trim(directive.substr(0, equals)));
+    std::string argument = equals == std::string::npos ? "" : trim(directive.substr(equals + 1));
+    if (argument.size() >= 2 && argument.front() == '"' && argument.back() == '"') {
+      argument = argument.substr(1, argument.size() - 2);
+    }
+
+    // The field names of no-cache and private are not supported, they apply to the whole
+    // response.
+    uint64_t seconds;
+    if (name == "no-store") {
+      no_store_ = true;
+    } else if (name == "no-cache") {
+      no_cache_ = true;
+    } else if (name == "private") {
+      private_ = true;
+    } else if (name == "max-age" && StringUtil::atoul(argument.c_str(), seconds)) {
+      max_age.value(std::chrono::seconds(seconds));
+    } else if (name == "s-maxage" && StringUtil::atoul(argument.c_str(), seconds)) {
+      s_maxage.value(std::chrono::seconds(seconds));
+    }
+  }
+  max_age_ = s_maxage.valid() ? s_maxage : max_age;
+}
+
+ResponseCache::ResponseCache(uint64_t max_bytes, CacheFilterStats& stats,
+                             Event::Dispatcher& dispatcher)
+    : max_bytes_(max_bytes), stats_(stats), dispatcher_(dispatcher) {}
+
+CachedResponseConstSharedPtr ResponseCache::lookup(const std::string& key,
+                                                   const HeaderMap& request_headers,
+                                                   MonotonicTime now) {
+  auto entry = entries_.find(key);
+  if (entry == entries_.end()) {
+    return nullptr;
+  }
+
+  const CachedResponse& response = *entry->second->response_;
+  if (now - response.response_time_ + response.initial_age_ >= response.freshness_lifetime_) {
+    erase(entry->second);
+    return nullptr;
+  }
+  for (const auto& vary : response.vary_) {
+    const HeaderEntry* header = request_headers.get(vary.first);
+    const bool matches = header == nullptr
+                             ? !vary.second.valid()
+                             : vary.second.valid() && vary.second.value() == header->value().c_str();
+    if (!matches) {
+      return nullptr;
+    }
+  }
+
+  lru_.splice(lru_.begin(), lru_, entry->second);
+  return entry->second->response_;
+}
+
+void ResponseCache::insert(const std::string& key, CachedResponseConstSharedPtr&& response) {
+  auto existing = entries_.find(key);
+  if (existing != entries_.end()) {
+    erase(existing->second);
+  }
+
+  const uint64_t bytes = responseBytes(key, *response);
+  if (bytes > max_bytes_) {
+    return;
+  }
+  while (bytes_ + bytes > max_bytes_) {
+    stats_.evict_.inc();
+    erase(std::prev(lru_.end()));
+  }
+
+  lru_.push_front({key, std::move(response), bytes});
+  entries_[key] = lru_.begin();
+  bytes_ += bytes;
+  stats_.bytes_.add(bytes);
+  stats_.insert_.inc();
+}
+
+bool ResponseCache::startFill(const std::string& key) {
+  return fills_.emplace(key, std::list<CacheFillCallbacks*>()).second;
+}
+
+void ResponseCache::finishFill(const std::string& key) {
+  auto fill = fills_.find(key);
+  ASSERT(fill != fills_.end());
+  if (fill->second.empty()) {
+    fills_.erase(fill);
+    return;
+  }
+
+  // The waiters are not called back on the stack of the request that filled the cache, since it
+  // may be in the middle of encoding its response.
+  ready_.splice(ready_.end(), fill->second);
+  fills_.erase(fill);
+  if (!resume_timer_) {
+    resume_timer_ = dispatcher_.createTimer([this]() -> void { onResumeTimer(); });
+  }
+  resume_timer_->enableTimer(std::chrono::milliseconds(0));
+}
+
+void ResponseCache::waitForFill(const std::string& key, CacheFillCallbacks& callbacks) {
+  auto fill = fills_.find(key);
+  ASSERT(fill != fills_.end());
+  fill->second.push_back(&callbacks);
+}
+
+void ResponseCache::cancelWait(const std::string& key, CacheFillCallbacks& callbacks) {
+  auto fill = fills_.find(key);
+  if (fill != fills_.end()) {
+    fill->second.remove(&callbacks);
+  }
+  ready_.remove(&callbacks);
+}
+
+uint64_t ResponseCache::responseBytes(const std::string& key, const CachedResponse& response) {
+  uint64_t bytes = key.size() + response.headers_->byteSize() + response.body_->size();
+  for (const auto& vary : response.vary_) {
+    bytes += vary.first.get().size() + (vary.second.valid() ? vary.second.value().size() : 0);
+  }
+  return bytes;
+}
+
+void ResponseCache::erase(std::list<Entry>::iterator entry) {
+  bytes_ -= entry->bytes_;
+  stats_.bytes_.sub(entry->bytes_);
+  entries_.erase(entry->key_);
+  lru_.erase(entry);
+}
+
+void ResponseCache::onResumeTimer() {
+  // A request that is called back may serve a response, which can cancel other waiters.
+  while (!ready_.empty()) {
+    CacheFillCallbacks* callbacks = ready_.front();
+    ready_.pop_front();
+    callbacks->onFillComplete();
+  }
+}
+
+CacheFilterConfig::CacheFilterConfig(const Json::Object& json_config,
+                                     const std::string& stats_prefix, Stats::Scope& scope,
+                                     ThreadLocal::SlotAllocator& tls,
+                                     MonotonicTimeSource& time_source)
+    : stats_(generateStats(stats_prefix, scope)),
+      max_bytes_(json_config.getInteger("max_bytes", 64 * 1024 * 1024)),
+      max_entry_bytes_(json_config.getInteger("max_entry_bytes", 1024 * 1024)),
+      time_source_(time_source), tls_(tls.allocateSlot()) {
+  tls_->set([this](Event::Dispatcher& dispatcher) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return ThreadLocal::ThreadLocalObjectSharedPtr{
+        new ResponseCache(max_bytes_, stats_, dispatcher)};
+  });
+}
+
+CacheFilterStats CacheFilterConfig::generateStats(const std::string& prefix,
+                                                  Stats::Scope& scope) {
+  std::string final_prefix = prefix + "cache.";
+  return {ALL_CACHE_FILTER_STATS(POOL_COUNTER_PREFIX(scope, final_prefix),
+                                 POOL_GAUGE_PREFIX(scope, final_prefix))};
+}
+
+CacheFilter::CacheFilter(CacheFilterConfigSharedPtr config) : config_(config) {}
+
+bool CacheFilter::cacheable(const HeaderMap& response_headers, std::chrono::seconds& lifetime) {
+  // Only the responses with an explicit freshness lifetime are cached, there is no heuristic
+  // freshness.
+  if (response_headers.Status() == nullptr || response_headers.Status()->value() != "200" ||
+      response_headers.get(Headers::get().SetCookie) != nullptr) {
+    return false;
+  }
+  const HeaderEntry* cache_control = response_headers.get(Headers::get().CacheControl);
+  if (cache_control == nullptr) {
+    return false;
+  }
+  const CacheControl directives(cache_control->value().c_str());
+  if (directives.no_store_ || directives.no_cache_ || directives.private_ ||
+      !directives.max_age_.valid() || directives.max_age_.value().count() == 0) {
+    return false;
+  }
+  const std::vector<std::string> vary = varyHeaders(response_headers);
+  if (std::find(vary.begin(), vary.end(), "*") != vary.end()) {
+    return false;
+  }
+
+  lifetime = directives.max_age_.value();
+  return true;
+}
+
+void CacheFilter::onDestroy() {
+  if (state_ == State::Filling) {
+    endFill();
+  } else if (state_ == State::Waiting) {
+    config_->cache().cancelWait(key_, *this);
+  }
+  state_ = State::PassThrough;
+}
+
+FilterHeadersStatus CacheFilter::decodeHeaders(HeaderMap& headers, bool end_stream) {
+  // Requests with a body or credentials are not cached.
+  if (!end_stream || headers.Method() == nullptr ||
+      headers.Method()->value() != Headers::get().MethodValues.Get.c_str() ||
+      headers.Host() == nullptr || headers.Path() == nullptr ||
+      headers.Authorization() != nullptr) {
+    return FilterHeadersStatus::Continue;
+  }
+
+  lookup_allowed_ = true;
+  const HeaderEntry* cache_control = headers.get(Headers::get().CacheControl);
+  if (cache_control != nullptr) {
+    const CacheControl directives(cache_control->value().c_str());
+    if (directives.no_store_) {
+      return FilterHeadersStatus::Continue;
+    }
+    // The response of a request that does not accept a cached response can still fill the cache.
+    lookup_allowed_ = !directives.no_cache_;
+  }
+
+  request_headers_ = &headers;
+  key_ = std::string(headers.Host()->value().c_str()) + headers.Path()->value().c_str();
+  return lookup();
+}
+
+FilterHeadersStatus CacheFilter::lookup() {
+  ResponseCache& cache = config_->cache();
+  if (lookup_allowed_ && serveFromCache()) {
+    return FilterHeadersStatus::StopIteration;
+  }
+
+  if (cache.startFill(key_)) {
+    config_->stats().miss_.inc();
+    state_ = State::Filling;
+    return FilterHeadersStatus::Continue;
+  }
+  if (!lookup_allowed_) {
+    config_->stats().miss_.inc();
+    return FilterHeadersStatus::Continue;
+  }
+
+  // Another request is already filling the key, it may fill it for this request as well. The
+  // request counts as a hit or a miss once the fill is done.
+  config_->stats().coalesced_.inc();
+  state_ = State::Waiting;
+  cache.waitForFill(key_, *this);
+  return FilterHeadersStatus::StopIteration;
+}
+
+bool CacheFilter::serveFromCache() {
+  const MonotonicTime now = config_->timeSource().currentTime();
+  CachedResponseConstSharedPtr response = config_->cache().lookup(key_, *request_headers_, now);
+  if (!response) {
+    return false;
+  }
+
+  config_->stats().hit_.inc();
+  state_ = State::Served;
+  HeaderMapPtr headers{new HeaderMapImpl(*response->headers_)};
+  const std::chrono::seconds age =
+      std::chrono::duration_cast<std::chrono::seconds>(now - response->response_time_) +
+      response->initial_age_;
+  headers->remove(Headers::get().Age);
+  headers->addCopy(Headers::get().Age, age.count());
+
+  const HeaderEntry* etag = headers->get(Headers::get().Etag);
+  const HeaderEntry* if_none_match = request_headers_->get(Headers::get().IfNoneMatch);
+  if (etag != nullptr && if_none_match != nullptr) {
+    for (const std::string& tag : headerList(if_none_match->value().c_str())) {
+      if (tag == "*" || tag == etag->value().c_str()) {
+        headers->Status()->value(enumToInt(Code::NotModified));
+        headers->removeContentLength();
+        decoder_callbacks_->encodeHeaders(std::move(headers), true);
+        return true;
+      }
+    }
+  }
+
+  if (response->body_->empty()) {
+    decoder_callbacks_->encodeHeaders(std::move(headers), true);
+    return true;
+  }
+  decoder_callbacks_->encodeHeaders(std::move(headers), false);
+  Buffer::OwnedImpl body;
+  body.addBufferFragment(*new CachedBodyFragment(response->body_));
+  decoder_callbacks_->encodeData(body, true);
+  return true;
+}
+
+void CacheFilter::onFillComplete() {
+  ASSERT(state_ == State::Waiting);
+  state_ = State::PassThrough;
+
+  // When the request that filled the key did not insert a response that this request accepts,
+  // the request goes upstream on its own.
+  if (!serveFromCache()) {
+    config_->stats().miss_.inc();
+    decoder_callbacks_->continueDecoding();
+  }
+}
+
+FilterHeadersStatus CacheFilter::encodeHeaders(HeaderMap& headers, bool end_stream) {
+  if (state_ != State::Filling) {
+    return FilterHeadersStatus::Continue;
+  }
+
+  std::chrono::seconds lifetime;
+  if (!cacheable(headers, lifetime)) {
+    endFill();
+    return FilterHeadersStatus::Continue;
+  }
+
+  response_.reset(new CachedResponse());
+  response_->headers_.reset(new HeaderMapImpl(headers));
+  for (const std::string& name : varyHeaders(headers)) {
+    LowerCaseString header_name(name);
+    const HeaderEntry* request_header = request_headers_->get(header_name);
+    response_->vary_.emplace_back(std::move(header_name),
+                                  request_header == nullptr
+                                      ? Optional<std::string>()
+                                      : Optional<std::string>(request_header->value().c_str()));
+  }
+  response_->response_time_ = config_->timeSource().currentTime();
+  uint64_t age = 0;
+  const HeaderEntry* age_header = headers.get(Headers::get().Age);
+  if (age_header != nullptr) {
+    StringUtil::atoul(age_header->value().c_str(), age);
+  }
+  response_->initial_age_ = std::chrono::seconds(age);
+  response_->freshness_lifetime_ = lifetime;
+
+  if (end_stream) {
+    insert();
+  }
+  return FilterHeadersStatus::Continue;
+}
+
+FilterDataStatus CacheFilter::encodeData(Buffer::Instance& data, bool end_stream) {
+  if (state_ != State::Filling) {
+    return FilterDataStatus::Continue;
+  }
+
+  if (body_.size() + data.length() > config_->maxEntryBytes()) {
+    endFill();
+    return FilterDataStatus::Continue;
+  }
+  uint64_t num_slices = data.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  data.getRawSlices(slices, num_slices);
+  for (const Buffer::RawSlice& slice : slices) {
+    body_.append(static_cast<const char*>(slice.mem_), slice.len_);
+  }
+
+  if (end_stream) {
+    insert();
+  }
+  return FilterDataStatus::Continue;
+}
+
+FilterTrailersStatus CacheFilter::encodeTrailers(HeaderMap&) {
+  // Responses with trailers are not cached.
+  if (state_ == State::Filling) {
+    endFill();
+  }
+  return FilterTrailersStatus::Continue;
+}
+
+void CacheFilter::insert() {
+  ASSERT(state_ == State::Filling);
+  response_->body_ = std::make_shared<const std::string>(std::move(body_));
+  config_->cache().insert(key_, std::move(response_));
+  endFill();
+}
+
+void CacheFilter::endFill() {
+  ASSERT(state_ == State::Filling);
+  state_ = State::PassThrough;
+  response_.reset();
+  body_.clear();
+  config_->cache().finishFill(key_);
+}
+
+} // namespace Http
+} // namespace Envoy
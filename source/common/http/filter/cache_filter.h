@@ -0,0 +1,254 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "envoy/buffer/buffer.h"
+#include "envoy/common/optional.h"
+#include "envoy/common/time.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "envoy/http/filter.h"
+#include "envoy/http/header_map.h"
+#include "envoy/json/json_object.h"
+#include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
+
+namespace Envoy {
+namespace Http {
+
+/**
+ * All stats for the cache filter. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_CACHE_FILTER_STATS(COUNTER, GAUGE)                                                     \
+  COUNTER(hit)                                                                                     \
+  COUNTER(miss)                                                                                    \
+  COUNTER(coalesced)                                                                               \
+  COUNTER(insert)                                                                                  \
+  COUNTER(evict)                                                                                   \
+  GAUGE  (bytes)
+// clang-format on
+
+/**
+ * Wrapper struct for cache filter stats. @see stats_macros.h
+ */
+struct CacheFilterStats {
+  ALL_CACHE_FILTER_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT)
+};
+
+/**
+ * The directives of a Cache-Control header that the cache filter honors.
+ */
+struct CacheControl {
+  /**
+   * @param value supplies the value of a Cache-Control header.
+   */
+  CacheControl(const std::string& value);
+
+  bool no_store_{};
+  bool no_cache_{};
+  bool private_{};
+  // The s-maxage directive if both s-maxage and max-age are set.
+  Optional<std::chrono::seconds> max_age_;
+};
+
+/**
+ * A response in the cache. It is immutable once inserted, so hits can share its body.
+ */
+struct CachedResponse {
+  HeaderMapPtr headers_;
+  std::shared_ptr<const std::string> body_;
+  // The request headers the response varies on, with their values in the request that filled it.
+  // An absent header has no value.
+  std::vector<std::pair<LowerCaseString, Optional<std::string>>> vary_;
+  MonotonicTime response_time_;
+  // The age of the response when it was received, from its Age header.
+  std::chrono::seconds initial_age_;
+  std::chrono::seconds freshness_lifetime_;
+};
+
+typedef std::shared_ptr<const CachedResponse> CachedResponseConstSharedPtr;
+
+/**
+ * Callbacks for a request that waits for another request to fill the cache.
+ */
+class CacheFillCallbacks {
+public:
+  virtual ~CacheFillCallbacks() {}
+
+  /**
+   * Called on a later dispatcher iteration once the fill the request waits for is done, whether
+   * or not it inserted a response.
+   */
+  virtual void onFillComplete() PURE;
+};
+
+/**
+ * The responses cached by a worker, evicted in LRU order once they take more than the memory
+ * limit. Every worker has its own cache, so the cache is not locked. The cache also tracks the
+ * requests that fill it, so that concurrent misses on the same key make a single upstream request.
+ */
+class ResponseCache : public ThreadLocal::ThreadLocalObject {
+public:
+  ResponseCache(uint64_t max_bytes, CacheFilterStats& stats, Event::Dispatcher& dispatcher);
+
+  /**
+   * @return CachedResponseConstSharedPtr the fresh response of a key that matches the request
+   *         headers, or nullptr.
+   */
+  CachedResponseConstSharedPtr lookup(const std::string& key, const HeaderMap& request_headers,
+                                      MonotonicTime now);
+
+  /**
+   * Insert the response of a key, replacing any previous one.
+   */
+  void insert(const std::string& key, CachedResponseConstSharedPtr&& response);
+
+  /**
+   * Start filling a key.
+   * @return bool false if another request is already filling it.
+   */
+  bool startFill(const std::string& key);
+
+  /**
+   * Finish filling a key. The requests that wait for it are called back on a later dispatcher
+   * iteration.
+   */
+  void finishFill(const std::string& key);
+
+  /**
+   * Wait for the fill of a key that another request started.
+   */
+  void waitForFill(const std::string& key, CacheFillCallbacks& callbacks);
+
+  /**
+   * Stop waiting for the fill of a key.
+   */
+  void cancelWait(const std::string& key, CacheFillCallbacks& callbacks);
+
+  uint64_t bytes() const { return bytes_; }
+  uint64_t size() const { return entries_.size(); }
+
+  /**
+   * @return uint64_t the number of bytes a response takes in the cache.
+   */
+  static uint64_t responseBytes(const std::string& key, const CachedResponse& response);
+
+private:
+  struct Entry {
+    std::string key_;
+    CachedResponseConstSharedPtr response_;
+    uint64_t bytes_;
+  };
+
+  void erase(std::list<Entry>::iterator entry);
+  void onResumeTimer();
+
+  const uint64_t max_bytes_;
+  CacheFilterStats& stats_;
+  Event::Dispatcher& dispatcher_;
+  // Most recently used first.
+  std::list<Entry> lru_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+  uint64_t bytes_{};
+  // The requests that wait for each key being filled.
+  std::unordered_map<std::string, std::list<CacheFillCallbacks*>> fills_;
+  // The requests whose fill is done, called back on the next dispatcher iteration.
+  std::list<CacheFillCallbacks*> ready_;
+  Event::TimerPtr resume_timer_;
+};
+
+/**
+ * Configuration for the cache filter.
+ */
+class CacheFilterConfig {
+public:
+  CacheFilterConfig(const Json::Object& json_config, const std::string& stats_prefix,
+                    Stats::Scope& scope, ThreadLocal::SlotAllocator& tls,
+                    MonotonicTimeSource& time_source);
+
+  ResponseCache& cache() { return tls_->getTyped<ResponseCache>(); }
+  CacheFilterStats& stats() { return stats_; }
+  MonotonicTimeSource& timeSource() { return time_source_; }
+  uint64_t maxEntryBytes() const { return max_entry_bytes_; }
+
+private:
+  static CacheFilterStats generateStats(const std::string& prefix, Stats::Scope& scope);
+
+  CacheFilterStats stats_;
+  const uint64_t max_bytes_;
+  const uint64_t max_entry_bytes_;
+  MonotonicTimeSource& time_source_;
+  ThreadLocal::SlotPtr tls_;
+};
+
+typedef std::shared_ptr<CacheFilterConfig> CacheFilterConfigSharedPtr;
+
+/**
+ * A filter that caches the cacheable responses of GET requests, following the Cache-Control,
+ * Vary and ETag semantics of a shared cache. Hits are served by the filter without going further
+ * down the filter chain.
+ */
+class CacheFilter : public StreamFilter, public CacheFillCallbacks {
+public:
+  CacheFilter(CacheFilterConfigSharedPtr config);
+
+  /**
+   * @return bool whether a response can be cached, and its freshness lifetime when it can.
+   */
+  static bool cacheable(const HeaderMap& response_headers, std::chrono::seconds& lifetime);
+
+  // Http::StreamFilterBase
+  void onDestroy() override;
+
+  // Http::StreamDecoderFilter
+  FilterHeadersStatus decodeHeaders(HeaderMap& headers, bool end_stream) override;
+  FilterDataStatus decodeData(Buffer::Instance&, bool) override {
+    return FilterDataStatus::Continue;
+  }
+  FilterTrailersStatus decodeTrailers(HeaderMap&) override {
+    return FilterTrailersStatus::Continue;
+  }
+  void setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callbacks) override {
+    decoder_callbacks_ = &callbacks;
+  }
+
+  // Http::StreamEncoderFilter
+  FilterHeadersStatus encodeHeaders(HeaderMap& headers, bool end_stream) override;
+  FilterDataStatus encodeData(Buffer::Instance& data, bool end_stream) override;
+  FilterTrailersStatus encodeTrailers(HeaderMap& trailers) override;
+  void setEncoderFilterCallbacks(StreamEncoderFilterCallbacks& callbacks) override {
+    encoder_callbacks_ = &callbacks;
+  }
+
+  // Http::CacheFillCallbacks
+  void onFillComplete() override;
+
+private:
+  enum class State { PassThrough, Filling, Waiting, Served };
+
+  FilterHeadersStatus lookup();
+  bool serveFromCache();
+  void insert();
+  void endFill();
+
+  CacheFilterConfigSharedPtr config_;
+  StreamDecoderFilterCallbacks* decoder_callbacks_{};
+  StreamEncoderFilterCallbacks* encoder_callbacks_{};
+  State state_{State::PassThrough};
+  HeaderMap* request_headers_{};
+  std::string key_;
+  bool lookup_allowed_{};
+  std::unique_ptr<CachedResponse> response_;
+  std::string body_;
+};
+
+} // namespace Http
+} // namespace Envoy
@@ -101,24 +101,13 @@ void CorsFilter::setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callbac
 };
 
 bool CorsFilter::isOriginAllowed(const Http::HeaderString& origin) {
-  if (allowOrigins() == nullptr) {
-    return false;
-  }
-  for (const auto& o : *allowOrigins()) {
-    if (o == "*" || origin == o.c_str()) {
-      return true;
-    }
-  }
-  return false;
-}
-
-const std::list<std::string>* CorsFilter::allowOrigins() {
+  // The origins of the first policy that has any are matched.
   for (const auto policy : policies_) {
     if (policy && !policy->allowOrigins().empty()) {
-      return &policy->allowOrigins();
+      return policy->originAllowed(origin);
     }
   }
-  return nullptr;
+  return false;
 }
 
 const std::string& CorsFilter::allowMethods() {
@@ -24,15 +24,91 @@
 namespace Envoy {
 namespace Http {
 
-const std::string FaultFilter::DELAY_PERCENT_KEY = "fault.http.delay.fixed_delay_percent";
-const std::string FaultFilter::ABORT_PERCENT_KEY = "fault.http.abort.abort_percent";
-const std::string FaultFilter::DELAY_DURATION_KEY = "fault.http.delay.fixed_duration_ms";
-const std::string FaultFilter::ABORT_HTTP_STATUS_KEY = "fault.http.abort.http_status";
+DownstreamClusterFault::DownstreamClusterFault(const std::string& cluster)
+    : cluster_(cluster),
+      delay_percent_key_(fmt::format("fault.http.{}.delay.fixed_delay_percent", cluster)),
+      abort_percent_key_(fmt::format("fault.http.{}.abort.abort_percent", cluster)),
+      delay_duration_key_(fmt::format("fault.http.{}.delay.fixed_duration_ms", cluster)),
+      abort_http_status_key_(fmt::format("fault.http.{}.abort.http_status", cluster)) {}
+
+FaultFilterThreadLocalState::FaultFilterThreadLocalState(Event::Dispatcher& dispatcher,
+                                                         MonotonicTimeSource& time_source)
+    : time_source_(time_source), timer_(dispatcher.createTimer([this]() -> void { onTimer(); })) {}
+
+FaultFilterThreadLocalState::DelayQueue::iterator
+FaultFilterThreadLocalState::addDelay(FaultFilter& filter, std::chrono::milliseconds delay) {
+  DelayQueue::iterator entry = delays_.emplace(time_source_.currentTime() + delay, &filter);
+  if (entry == delays_.begin()) {
+    enableTimer();
+  }
+  return entry;
+}
+
+void FaultFilterThreadLocalState::removeDelay(DelayQueue::iterator delay) {
+  const bool earliest = delay == delays_.begin();
+  delays_.erase(delay);
+  if (earliest) {
+    enableTimer();
+  }
+}
+
+DownstreamClusterFault* FaultFilterThreadLocalState::downstreamCluster(const std::string& cluster) {
+  auto entry = downstream_clusters_.find(cluster);
+  if (entry != downstream_clusters_.end()) {
+    return &entry->second;
+  }
+  if (downstream_clusters_.size() >= MAX_DOWNSTREAM_CLUSTERS) {
+    return nullptr;
+  }
+  return &downstream_clusters_.emplace(cluster, cluster).first->second;
+}
+
+void FaultFilterThreadLocalState::onTimer() {
+  const MonotonicTime now = time_source_.currentTime();
+  // The delay is removed before the filter continues, since continuing may destroy the stream.
+  while (!delays_.empty() && delays_.begin()->first <= now) {
+    FaultFilter& filter = *delays_.begin()->second;
+    delays_.erase(delays_.begin());
+    filter.postDelayInjection();
+  }
+  enableTimer();
+}
+
+void FaultFilterThreadLocalState::enableTimer() {
+  if (delays_.empty()) {
+    timer_->disableTimer();
+    return;
+  }
+
+  // Round up, so that the timer does not fire just before the deadline and have to be re-armed.
+  const MonotonicTime now = time_source_.currentTime();
+  const MonotonicTime deadline = delays_.begin()->first;
+  std::chrono::milliseconds timeout(0);
+  if (deadline > now) {
+    const auto remaining = deadline - now;
+    timeout = std::chrono::duration_cast<std::chrono::milliseconds>(remaining);
+    if (timeout < remaining) {
+      timeout += std::chrono::milliseconds(1);
+    }
+  }
+  timer_->enableTimer(timeout);
+}
+
+const std::string FaultFilterConfig::DELAY_PERCENT_KEY = "fault.http.delay.fixed_delay_percent";
+const std::string FaultFilterConfig::ABORT_PERCENT_KEY = "fault.http.abort.abort_percent";
+const std::string FaultFilterConfig::DELAY_DURATION_KEY = "fault.http.delay.fixed_duration_ms";
+const std::string FaultFilterConfig::ABORT_HTTP_STATUS_KEY = "fault.http.abort.http_status";
 
 FaultFilterConfig::FaultFilterConfig(const Json::Object& json_config, Runtime::Loader& runtime,
-                                     const std::string& stats_prefix, Stats::Scope& scope)
-    : runtime_(runtime), stats_(generateStats(stats_prefix, scope)), stats_prefix_(stats_prefix),
-      scope_(scope) {
+                                     const std::string& stats_prefix, Stats::Scope& scope,
+                                     ThreadLocal::SlotAllocator& tls,
+                                     MonotonicTimeSource& time_source)
+    : runtime_(runtime), delay_percent_runtime_(runtime.featureHandle(DELAY_PERCENT_KEY)),
+      abort_percent_runtime_(runtime.featureHandle(ABORT_PERCENT_KEY)),
+      delay_duration_runtime_(runtime.featureHandle(DELAY_DURATION_KEY)),
+      abort_http_status_runtime_(runtime.featureHandle(ABORT_HTTP_STATUS_KEY)),
+      stats_(generateStats(stats_prefix, scope)), stats_prefix_(stats_prefix), scope_(scope),
+      tls_(tls.allocateSlot()) {
 
   json_config.validateSchema(Json::Schema::FAULT_HTTP_FILTER_SCHEMA);
 
@@ -72,11 +148,17 @@ FaultFilterConfig::FaultFilterConfig(const Json::Object& json_config, Runtime::L
     std::vector<std::string> nodes = json_config.getStringArray("downstream_nodes");
     downstream_nodes_.insert(nodes.begin(), nodes.end());
   }
+
+  tls_->set([&time_source](Event::Dispatcher& dispatcher)
+                -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return ThreadLocal::ThreadLocalObjectSharedPtr{
+        new FaultFilterThreadLocalState(dispatcher, time_source)};
+  });
 }
 
 FaultFilter::FaultFilter(FaultFilterConfigSharedPtr config) : config_(config) {}
 
-FaultFilter::~FaultFilter() { ASSERT(!delay_timer_); }
+FaultFilter::~FaultFilter() { ASSERT(!delayed_); }
 
 // Delays and aborts are independent events. One can inject a delay
 // followed by an abort or inject just a delay or abort. In this callback,
@@ -97,22 +179,19 @@ FilterHeadersStatus FaultFilter::decodeHeaders(HeaderMap& headers, bool) {
   }
 
   if (headers.EnvoyDownstreamServiceCluster()) {
-    downstream_cluster_ = headers.EnvoyDownstreamServiceCluster()->value().c_str();
-
-    downstream_cluster_delay_percent_key_ =
-        fmt::format("fault.http.{}.delay.fixed_delay_percent", downstream_cluster_);
-    downstream_cluster_abort_percent_key_ =
-        fmt::format("fault.http.{}.abort.abort_percent", downstream_cluster_);
-    downstream_cluster_delay_duration_key_ =
-        fmt::format("fault.http.{}.delay.fixed_duration_ms", downstream_cluster_);
-    downstream_cluster_abort_http_status_key_ =
-        fmt::format("fault.http.{}.abort.http_status", downstream_cluster_);
+    const std::string cluster = headers.EnvoyDownstreamServiceCluster()->value().c_str();
+    downstream_cluster_ = config_->threadLocalState().downstreamCluster(cluster);
+    if (downstream_cluster_ == nullptr) {
+      uncached_downstream_cluster_.reset(new DownstreamClusterFault(cluster));
+      downstream_cluster_ = uncached_downstream_cluster_.get();
+    }
   }
 
   Optional<uint64_t> duration_ms = delayDuration();
   if (duration_ms.valid()) {
-    delay_timer_ = callbacks_->dispatcher().createTimer([this]() -> void { postDelayInjection(); });
-    delay_timer_->enableTimer(std::chrono::milliseconds(duration_ms.value()));
+    delay_ = config_->threadLocalState().addDelay(
+        *this, std::chrono::milliseconds(duration_ms.value()));
+    delayed_ = true;
     recordDelaysInjectedStats();
     callbacks_->requestInfo().setResponseFlag(Http::AccessLog::ResponseFlag::DelayInjected);
     return FilterHeadersStatus::StopIteration;
@@ -127,24 +206,22 @@ FilterHeadersStatus FaultFilter::decodeHeaders(HeaderMap& headers, bool) {
 }
 
 bool FaultFilter::isDelayEnabled() {
-  bool enabled =
-      config_->runtime().snapshot().featureEnabled(DELAY_PERCENT_KEY, config_->delayPercent());
+  bool enabled = config_->delayPercentRuntime().featureEnabled(config_->delayPercent());
 
-  if (!downstream_cluster_delay_percent_key_.empty()) {
-    enabled |= config_->runtime().snapshot().featureEnabled(downstream_cluster_delay_percent_key_,
-                                                            config_->delayPercent());
+  if (downstream_cluster_) {
+    enabled |= config_->runtime().snapshot().featureEnabled(
+        downstream_cluster_->delay_percent_key_, config_->delayPercent());
   }
 
   return enabled;
 }
 
 bool FaultFilter::isAbortEnabled() {
-  bool enabled =
-      config_->runtime().snapshot().featureEnabled(ABORT_PERCENT_KEY, config_->abortPercent());
+  bool enabled = config_->abortPercentRuntime().featureEnabled(config_->abortPercent());
 
-  if (!downstream_cluster_abort_percent_key_.empty()) {
-    enabled |= config_->runtime().snapshot().featureEnabled(downstream_cluster_abort_percent_key_,
-                                                            config_->abortPercent());
+  if (downstream_cluster_) {
+    enabled |= config_->runtime().snapshot().featureEnabled(
+        downstream_cluster_->abort_percent_key_, config_->abortPercent());
   }
 
   return enabled;
@@ -157,11 +234,10 @@ Optional<uint64_t> FaultFilter::delayDuration() {
     return ret;
   }
 
-  uint64_t duration =
-      config_->runtime().snapshot().getInteger(DELAY_DURATION_KEY, config_->delayDuration());
-  if (!downstream_cluster_delay_duration_key_.empty()) {
-    duration =
-        config_->runtime().snapshot().getInteger(downstream_cluster_delay_duration_key_, duration);
+  uint64_t duration = config_->delayDurationRuntime().getInteger(config_->delayDuration());
+  if (downstream_cluster_) {
+    duration = config_->runtime().snapshot().getInteger(downstream_cluster_->delay_duration_key_,
+                                                        duration);
   }
 
   // Delay only if the duration is >0ms
@@ -174,12 +250,11 @@ Optional<uint64_t> FaultFilter::delayDuration() {
 
 uint64_t FaultFilter::abortHttpStatus() {
   // TODO(mattklein123): check http status codes obtained from runtime.
-  uint64_t http_status =
-      config_->runtime().snapshot().getInteger(ABORT_HTTP_STATUS_KEY, config_->abortCode());
+  uint64_t http_status = config_->abortHttpStatusRuntime().getInteger(config_->abortCode());
 
-  if (!downstream_cluster_abort_http_status_key_.empty()) {
+  if (downstream_cluster_) {
     http_status = config_->runtime().snapshot().getInteger(
-        downstream_cluster_abort_http_status_key_, http_status);
+        downstream_cluster_->abort_http_status_key_, http_status);
   }
 
   return http_status;
@@ -187,11 +262,13 @@ uint64_t FaultFilter::abortHttpStatus() {
 
 void FaultFilter::recordDelaysInjectedStats() {
   // Downstream specific stats.
-  if (!downstream_cluster_.empty()) {
-    const std::string stats_counter =
-        fmt::format("{}fault.{}.delays_injected", config_->statsPrefix(), downstream_cluster_);
-
-    config_->scope().counter(stats_counter).inc();
+  if (downstream_cluster_) {
+    if (!downstream_cluster_->delays_injected_) {
+      downstream_cluster_->delays_injected_ = &config_->scope().counter(
+          fmt::format("{}fault.{}.delays_injected", config_->statsPrefix(),
+                      config_->downstreamClusterStatNames().admit(downstream_cluster_->cluster_)));
+    }
+    downstream_cluster_->delays_injected_->inc();
   }
 
   // General stats.
@@ -200,11 +277,13 @@ void FaultFilter::recordDelaysInjectedStats() {
 
 void FaultFilter::recordAbortsInjectedStats() {
   // Downstream specific stats.
-  if (!downstream_cluster_.empty()) {
-    const std::string stats_counter =
-        fmt::format("{}fault.{}.aborts_injected", config_->statsPrefix(), downstream_cluster_);
-
-    config_->scope().counter(stats_counter).inc();
+  if (downstream_cluster_) {
+    if (!downstream_cluster_->aborts_injected_) {
+      downstream_cluster_->aborts_injected_ = &config_->scope().counter(
+          fmt::format("{}fault.{}.aborts_injected", config_->statsPrefix(),
+                      config_->downstreamClusterStatNames().admit(downstream_cluster_->cluster_)));
+    }
+    downstream_cluster_->aborts_injected_->inc();
   }
 
   // General stats.
@@ -212,7 +291,7 @@ void FaultFilter::recordAbortsInjectedStats() {
 }
 
 FilterDataStatus FaultFilter::decodeData(Buffer::Instance&, bool) {
-  if (delay_timer_ == nullptr) {
+  if (!delayed_) {
     return FilterDataStatus::Continue;
   }
   // If the request is too large, stop reading new data until the buffer drains.
@@ -220,8 +299,7 @@ FilterDataStatus FaultFilter::decodeData(Buffer::Instance&, bool) {
 }
 
 FilterTrailersStatus FaultFilter::decodeTrailers(HeaderMap&) {
-  return delay_timer_ == nullptr ? FilterTrailersStatus::Continue
-                                 : FilterTrailersStatus::StopIteration;
+  return delayed_ ? FilterTrailersStatus::StopIteration : FilterTrailersStatus::Continue;
 }
 
 FaultFilterStats FaultFilterConfig::generateStats(const std::string& prefix, Stats::Scope& scope) {
@@ -235,7 +313,8 @@ void FaultFilter::onDestroy() {
 }
 
 void FaultFilter::postDelayInjection() {
-  resetTimerState();
+  // The delay has already been removed from the queue of the worker.
+  delayed_ = false;
 
   // Delays can be followed by aborts
   if (isAbortEnabled()) {
@@ -279,9 +358,9 @@ bool FaultFilter::matchesDownstreamNodes(const HeaderMap& headers) {
 }
 
 void FaultFilter::resetTimerState() {
-  if (delay_timer_) {
-    delay_timer_->disableTimer();
-    delay_timer_.reset();
+  if (delayed_) {
+    config_->threadLocalState().removeDelay(delay_);
+    delayed_ = false;
   }
 }
 
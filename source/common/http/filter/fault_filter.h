@@ -1,16 +1,24 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "envoy/common/time.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
 #include "envoy/http/filter.h"
 #include "envoy/runtime/runtime.h"
 #include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
 
 #include "common/router/config_impl.h"
+#include "common/stats/cardinality_limiter.h"
 
 namespace Envoy {
 namespace Http {
@@ -31,13 +39,81 @@ struct FaultFilterStats {
   ALL_FAULT_FILTER_STATS(GENERATE_COUNTER_STRUCT)
 };
 
+/**
+ * The runtime keys and stats of the faults of the requests from one downstream cluster, so that
+ * they are formatted once per cluster rather than for every request.
+ */
+struct DownstreamClusterFault {
+  DownstreamClusterFault(const std::string& cluster);
+
+  const std::string cluster_;
+  const std::string delay_percent_key_;
+  const std::string abort_percent_key_;
+  const std::string delay_duration_key_;
+  const std::string abort_http_status_key_;
+  // Looked up when the first fault of the cluster is injected, so that clusters without faults
+  // do not get stats.
+  Stats::Counter* delays_injected_{};
+  Stats::Counter* aborts_injected_{};
+};
+
+typedef std::unique_ptr<DownstreamClusterFault> DownstreamClusterFaultPtr;
+
+class FaultFilter;
+
+/**
+ * The state of a fault filter configuration on a worker. The requests delayed on the worker share
+ * a single timer armed for the earliest deadline, rather than each creating their own. Every worker
+ * has its own state, so it is not locked.
+ */
+class FaultFilterThreadLocalState : public ThreadLocal::ThreadLocalObject {
+public:
+  typedef std::multimap<MonotonicTime, FaultFilter*> DelayQueue;
+
+  FaultFilterThreadLocalState(Event::Dispatcher& dispatcher, MonotonicTimeSource& time_source);
+
+  /**
+   * Delay a request. The filter's postDelayInjection() is called when the delay ends, unless the
+   * delay is removed first.
+   * @return DelayQueue::iterator the handle with which to remove the delay.
+   */
+  DelayQueue::iterator addDelay(FaultFilter& filter, std::chrono::milliseconds delay);
+
+  /**
+   * Remove a delay that has not ended yet.
+   */
+  void removeDelay(DelayQueue::iterator delay);
+
+  /**
+   * @return DownstreamClusterFault* the cached keys and stats of a downstream cluster, or nullptr
+   *         if the cache is full.
+   */
+  DownstreamClusterFault* downstreamCluster(const std::string& cluster);
+
+  size_t delays() const { return delays_.size(); }
+
+  // The most downstream clusters cached per worker, so that the cache is bounded if the
+  // downstream cluster header of untrusted clients is not sanitized.
+  static const size_t MAX_DOWNSTREAM_CLUSTERS = 1024;
+
+private:
+  void onTimer();
+  void enableTimer();
+
+  MonotonicTimeSource& time_source_;
+  const Event::TimerPtr timer_;
+  DelayQueue delays_;
+  std::unordered_map<std::string, DownstreamClusterFault> downstream_clusters_;
+};
+
 /**
  * Configuration for the fault filter.
  */
 class FaultFilterConfig {
 public:
   FaultFilterConfig(const Json::Object& json_config, Runtime::Loader& runtime,
-                    const std::string& stats_prefix, Stats::Scope& scope);
+                    const std::string& stats_prefix, Stats::Scope& scope,
+                    ThreadLocal::SlotAllocator& tls, MonotonicTimeSource& time_source);
 
   const std::vector<Router::ConfigUtility::HeaderData>& filterHeaders() {
     return fault_filter_headers_;
@@ -48,14 +124,28 @@ public:
   uint64_t abortCode() { return http_status_; }
   const std::string& upstreamCluster() { return upstream_cluster_; }
   Runtime::Loader& runtime() { return runtime_; }
+  const Runtime::FeatureHandle& delayPercentRuntime() { return *delay_percent_runtime_; }
+  const Runtime::FeatureHandle& abortPercentRuntime() { return *abort_percent_runtime_; }
+  const Runtime::FeatureHandle& delayDurationRuntime() { return *delay_duration_runtime_; }
+  const Runtime::FeatureHandle& abortHttpStatusRuntime() { return *abort_http_status_runtime_; }
   FaultFilterStats& stats() { return stats_; }
   const std::unordered_set<std::string>& downstreamNodes() { return downstream_nodes_; }
   const std::string& statsPrefix() { return stats_prefix_; }
   Stats::Scope& scope() { return scope_; }
+  Stats::CardinalityLimiter& downstreamClusterStatNames() { return downstream_cluster_stat_names_; }
+  FaultFilterThreadLocalState& threadLocalState() {
+    return tls_->getTyped<FaultFilterThreadLocalState>();
+  }
 
 private:
   static FaultFilterStats generateStats(const std::string& prefix, Stats::Scope& scope);
 
+  const static std::string DELAY_PERCENT_KEY;
+  const static std::string ABORT_PERCENT_KEY;
+  const static std::string DELAY_DURATION_KEY;
+  const static std::string ABORT_HTTP_STATUS_KEY;
+  static const size_t MAX_DOWNSTREAM_CLUSTER_STATS = 1024;
+
   uint64_t abort_percent_{};       // 0-100
   uint64_t http_status_{};         // HTTP or gRPC return codes
   uint64_t fixed_delay_percent_{}; // 0-100
@@ -65,9 +155,17 @@ private:
   std::unordered_set<std::string> downstream_nodes_{}; // Inject failures for specific downstream
                                                        // nodes. If not set then inject for all.
   Runtime::Loader& runtime_;
+  const Runtime::FeatureHandleSharedPtr delay_percent_runtime_;
+  const Runtime::FeatureHandleSharedPtr abort_percent_runtime_;
+  const Runtime::FeatureHandleSharedPtr delay_duration_runtime_;
+  const Runtime::FeatureHandleSharedPtr abort_http_status_runtime_;
   FaultFilterStats stats_;
   const std::string stats_prefix_;
   Stats::Scope& scope_;
+  // The downstream clusters of requests come from a request header, so the number of clusters
+  // with stats is bounded.
+  Stats::CardinalityLimiter downstream_cluster_stat_names_{MAX_DOWNSTREAM_CLUSTER_STATS};
+  ThreadLocal::SlotPtr tls_;
 };
 
 typedef std::shared_ptr<FaultFilterConfig> FaultFilterConfigSharedPtr;
@@ -89,11 +187,15 @@ public:
   FilterTrailersStatus decodeTrailers(HeaderMap& trailers) override;
   void setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callbacks) override;
 
+  /**
+   * Called by FaultFilterThreadLocalState when the delay of the request ends.
+   */
+  void postDelayInjection();
+
 private:
   void recordAbortsInjectedStats();
   void recordDelaysInjectedStats();
   void resetTimerState();
-  void postDelayInjection();
   void abortWithHTTPStatus();
   bool matchesTargetUpstreamCluster();
   bool matchesDownstreamNodes(const HeaderMap& headers);
@@ -105,19 +207,12 @@ private:
 
   FaultFilterConfigSharedPtr config_;
   StreamDecoderFilterCallbacks* callbacks_{};
-  Event::TimerPtr delay_timer_;
-  std::string downstream_cluster_{};
+  bool delayed_{};
+  FaultFilterThreadLocalState::DelayQueue::iterator delay_;
+  DownstreamClusterFault* downstream_cluster_{};
+  // The keys and stats of a downstream cluster that did not fit the cache of the worker.
+  DownstreamClusterFaultPtr uncached_downstream_cluster_;
   bool stream_destroyed_{};
-
-  std::string downstream_cluster_delay_percent_key_{};
-  std::string downstream_cluster_abort_percent_key_{};
-  std::string downstream_cluster_delay_duration_key_{};
-  std::string downstream_cluster_abort_http_status_key_{};
-
-  const static std::string DELAY_PERCENT_KEY;
-  const static std::string ABORT_PERCENT_KEY;
-  const static std::string DELAY_DURATION_KEY;
-  const static std::string ABORT_HTTP_STATUS_KEY;
 };
 
 } // Http
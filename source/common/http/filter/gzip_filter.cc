@@ -0,0 +1,243 @@
+#include "common/http/filter/gzip_filter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/common/assert.h"
+#include "common/common/utility.h"
+#include "common/compressor/zlib_compressor_impl.h"
+#include "common/http/headers.h"
+
+namespace Envoy {
+namespace Http {
+
+namespace {
+
+std::string trim(const std::string& value) {
+  const size_t start = value.find_first_not_of(" \t");
+  if (start == std::string::npos) {
+    return "";
+  }
+  return value.substr(start, value.find_last_not_of(" \t") - start + 1);
+}
+
+std::string toLower(std::string value) {
+  std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+  return value;
+}
+
+// The lower cased media type of a Content-Type header value, without its parameters.
+std::string mediaType(const std::string& content_type) {
+  return toLower(trim(content_type.substr(0, content_type.find(';'))));
+}
+
+const std::vector<std::string>& defaultContentTypes() {
+  static const std::vector<std::string>* content_types = new std::vector<std::string>(
+      {"application/javascript", "application/json", "application/xhtml+xml", "application/xml",
+       "image/svg+xml", "text/css", "text/html", "text/javascript", "text/plain", "text/xml"});
+  return *content_types;
+}
+
+} // namespace
+
+CompressorPool::CompressorPool(CompressorFactory factory, uint64_t max_size,
+                               GzipFilterStats& stats)
+    : factory_(factory), max_size_(max_size), stats_(stats) {}
+
+Compressor::CompressorPtr CompressorPool::acquire() {
+  if (compressors_.empty()) {
+    stats_.compressor_created_.inc();
+    return factory_();
+  }
+  Compressor::CompressorPtr compressor = std::move(compressors_.back());
+  compressors_.pop_back();
+  return compressor;
+}
+
+void CompressorPool::release(Compressor::CompressorPtr&& compressor) {
+  if (compressors_.size() >= max_size_) {
+    return;
+  }
+  compressor->reset();
+  compressors_.push_back(std::move(compressor));
+}
+
+GzipFilterConfig::GzipFilterConfig(const Json::Object& json_config,
+                                   const std::string& stats_prefix, Stats::Scope& scope,
+                                   ThreadLocal::SlotAllocator& tls,
+                                   MonotonicTimeSource& time_source)
+    : stats_(generateStats(stats_prefix, scope)),
+      compression_level_(json_config.getInteger("compression_level", 6)),
+      window_bits_(json_config.getInteger("window_bits", 15)),
+      memory_level_(json_config.getInteger("memory_level", 8)),
+      min_content_length_(json_config.getInteger("min_content_length", 30)),
+      max_pooled_compressors_(json_config.getInteger("max_pooled_compressors", 16)),
+      time_source_(time_source), tls_(tls.allocateSlot()) {
+  const std::vector<std::string> content_types =
+      json_config.hasObject("content_types") ? json_config.getStringArray("content_types")
+                                             : defaultContentTypes();
+  for (const std::string& content_type : content_types) {
+    content_types_.insert(mediaType(content_type));
+  }
+
+  tls_->set([this](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return ThreadLocal::ThreadLocalObjectSharedPtr{new CompressorPool(
+        [this]() -> Compressor::CompressorPtr {
+          return Compressor::CompressorPtr{new Compressor::ZlibCompressorImpl(
+              compression_level_, window_bits_, memory_level_)};
+        },
+        max_pooled_compressors_, stats_)};
+  });
+}
+
+bool GzipFilterConfig::compressibleContentType(const std::string& content_type) const {
+  return content_types_.count(mediaType(content_type)) > 0;
+}
+
+GzipFilterStats GzipFilterConfig::generateStats(const std::string& prefix, Stats::Scope& scope) {
+  std::string final_prefix = prefix + "gzip.";
+  return {ALL_GZIP_FILTER_STATS(POOL_COUNTER_PREFIX(scope, final_prefix))};
+}
+
+GzipFilter::GzipFilter(GzipFilterConfigSharedPtr config) : config_(config) {}
+
+bool GzipFilter::acceptsGzip(const HeaderMap& request_headers) {
+  const HeaderEntry* accept_encoding = request_headers.get(Headers::get().AcceptEncoding);
+  if (accept_encoding == nullptr) {
+    return false;
+  }
+
+  // An explicit gzip coding takes precedence over the wildcard, whatever their order.
+  bool wildcard = false;
+  for (const std::string& element : StringUtil::split(accept_encoding->value().c_str(), ',')) {
+    const std::vector<std::string> parameters = StringUtil::split(element, ';');
+    if (parameters.empty()) {
+      continue;
+    }
+    double quality = 1;
+    for (size_t i = 1; i < parameters.size(); i++) {
+      const std::string parameter = toLower(trim(parameters[i]));
+      if (parameter.compare(0, 2, "q=") == 0) {
+        quality = std::strtod(parameter.c_str() + 2, nullptr);
+      }
+    }
+
+    const std::string coding = toLower(trim(parameters[0]));
+    if (coding == Headers::get().ContentEncodingValues.Gzip) {
+      return quality > 0;
+    }
+    if (coding == "*") {
+      wildcard = quality > 0;
+    }
+  }
+  return wildcard;
+}
+
+void GzipFilter::onDestroy() {
+  if (compressor_) {
+    config_->compressorPool().release(std::move(compressor_));
+  }
+}
+
+FilterHeadersStatus GzipFilter::decodeHeaders(HeaderMap& headers, bool) {
+  accepts_gzip_ = acceptsGzip(headers);
+  return FilterHeadersStatus::Continue;
+}
+
+FilterHeadersStatus GzipFilter::encodeHeaders(HeaderMap& headers, bool end_stream) {
+  if (end_stream || !accepts_gzip_) {
+    return FilterHeadersStatus::Continue;
+  }
+  if (!compressible(headers)) {
+    config_->stats().not_compressed_.inc();
+    return FilterHeadersStatus::Continue;
+  }
+
+  config_->stats().compressed_.inc();
+  headers.removeContentLength();
+  headers.addReference(Headers::get().ContentEncoding, Headers::get().ContentEncodingValues.Gzip);
+
+  // The compressed body is a different representation, so a strong validator becomes weak.
+  const HeaderEntry* etag = headers.get(Headers::get().Etag);
+  if (etag != nullptr && strncmp(etag->value().c_str(), "W/", 2) != 0) {
+    const std::string weak_etag = std::string("W/") + etag->value().c_str();
+    headers.remove(Headers::get().Etag);
+    headers.addCopy(Headers::get().Etag, weak_etag);
+  }
+
+  const HeaderEntry* vary = headers.get(Headers::get().Vary);
+  if (vary == nullptr) {
+    headers.addReferenceKey(Headers::get().Vary, Headers::get().AcceptEncoding.get());
+  } else {
+    const std::string value = toLower(vary->value().c_str());
+    if (value.find(Headers::get().AcceptEncoding.get()) == std::string::npos &&
+        trim(value) != "*") {
+      const std::string new_value = std::string(vary->value().c_str()) + ", " +
+                                    Headers::get().AcceptEncoding.get();
+      headers.remove(Headers::get().Vary);
+      headers.addCopy(Headers::get().Vary, new_value);
+    }
+  }
+
+  compressor_ = config_->compressorPool().acquire();
+  return FilterHeadersStatus::Continue;
+}
+
+FilterDataStatus GzipFilter::encodeData(Buffer::Instance& data, bool end_stream) {
+  // An empty chunk in the middle of the stream has nothing to flush.
+  if (compressor_ && (end_stream || data.length() > 0)) {
+    compress(data, end_stream);
+  }
+  return FilterDataStatus::Continue;
+}
+
+FilterTrailersStatus GzipFilter::encodeTrailers(HeaderMap&) {
+  if (compressor_) {
+    Buffer::OwnedImpl data;
+    compress(data, true);
+    encoder_callbacks_->addEncodedData(data, true);
+  }
+  return FilterTrailersStatus::Continue;
+}
+
+bool GzipFilter::compressible(const HeaderMap& response_headers) const {
+  if (response_headers.get(Headers::get().ContentEncoding) != nullptr) {
+    return false;
+  }
+  const HeaderEntry* cache_control = response_headers.get(Headers::get().CacheControl);
+  if (cache_control != nullptr &&
+      toLower(cache_control->value().c_str()).find("no-transform") != std::string::npos) {
+    return false;
+  }
+  if (response_headers.ContentType() == nullptr ||
+      !config_->compressibleContentType(response_headers.ContentType()->value().c_str())) {
+    return false;
+  }
+  uint64_t content_length;
+  if (response_headers.ContentLength() != nullptr &&
+      StringUtil::atoul(response_headers.ContentLength()->value().c_str(), content_length) &&
+      content_length < config_->minContentLength()) {
+    return false;
+  }
+  return true;
+}
+
+void GzipFilter::compress(Buffer::Instance& data, bool end_stream) {
+  GzipFilterStats& stats = config_->stats();
+  stats.total_uncompressed_bytes_.add(data.length());
+  const MonotonicTime start = config_->timeSource().currentTime();
+  compressor_->compress(data, end_stream);
+  stats.compression_time_us_.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                                     config_->timeSource().currentTime() - start)
+                                     .count());
+  stats.total_compressed_bytes_.add(data.length());
+}
+
+} // namespace Http
+} // namespace Envoy
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "envoy/buffer/buffer.h"
+#include "envoy/common/time.h"
+#include "envoy/compressor/compressor.h"
+#include "envoy/http/filter.h"
+#include "envoy/http/header_map.h"
+#include "envoy/json/json_object.h"
+#include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
+
+namespace Envoy {
+namespace Http {
+
+/**
+ * All stats for the gzip filter. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_GZIP_FILTER_STATS(COUNTER)                                                             \
+  COUNTER(compressed)                                                                              \
+  COUNTER(not_compressed)                                                                          \
+  COUNTER(total_uncompressed_bytes)                                                                \
+  COUNTER(total_compressed_bytes)                                                                  \
+  COUNTER(compression_time_us)                                                                     \
+  COUNTER(compressor_created)
+// clang-format on
+
+/**
+ * Wrapper struct for gzip filter stats. @see stats_macros.h
+ */
+struct GzipFilterStats {
+  ALL_GZIP_FILTER_STATS(GENERATE_COUNTER_STRUCT)
+};
+
+typedef std::function<Compressor::CompressorPtr()> CompressorFactory;
+
+/**
+ * The idle compressors of a worker. Compressors are reset rather than freed when their stream
+ * ends, so that a stream does not pay for allocating the compressor state. Every worker has its
+ * own pool, so the pool is not locked.
+ */
+class CompressorPool : public ThreadLocal::ThreadLocalObject {
+public:
+  CompressorPool(CompressorFactory factory, uint64_t max_size, GzipFilterStats& stats);
+
+  /**
+   * @return Compressor::CompressorPtr an idle compressor, or a new one if there is none.
+   */
+  Compressor::CompressorPtr acquire();
+
+  /**
+   * Return a compressor to the pool. It is freed if the pool is full.
+   */
+  void release(Compressor::CompressorPtr&& compressor);
+
+  uint64_t size() const { return compressors_.size(); }
+
+private:
+  const CompressorFactory factory_;
+  const uint64_t max_size_;
+  GzipFilterStats& stats_;
+  std::vector<Compressor::CompressorPtr> compressors_;
+};
+
+/**
+ * Configuration for the gzip filter.
+ */
+class GzipFilterConfig {
+public:
+  GzipFilterConfig(const Json::Object& json_config, const std::string& stats_prefix,
+                   Stats::Scope& scope, ThreadLocal::SlotAllocator& tls,
+                   MonotonicTimeSource& time_source);
+
+  CompressorPool& compressorPool() { return tls_->getTyped<CompressorPool>(); }
+  GzipFilterStats& stats() { return stats_; }
+  MonotonicTimeSource& timeSource() { return time_source_; }
+  uint64_t minContentLength() const { return min_content_length_; }
+
+  /**
+   * @return bool whether responses of a content type are compressed.
+   * @param content_type supplies the value of a Content-Type header.
+   */
+  bool compressibleContentType(const std::string& content_type) const;
+
+private:
+  static GzipFilterStats generateStats(const std::string& prefix, Stats::Scope& scope);
+
+  GzipFilterStats stats_;
+  const int compression_level_;
+  const int window_bits_;
+  const int memory_level_;
+  const uint64_t min_content_length_;
+  const uint64_t max_pooled_compressors_;
+  std::unordered_set<std::string> content_types_;
+  MonotonicTimeSource& time_source_;
+  ThreadLocal::SlotPtr tls_;
+};
+
+typedef std::shared_ptr<GzipFilterConfig> GzipFilterConfigSharedPtr;
+
+/**
+ * A filter that gzips response bodies for the clients that accept it. The body is compressed
+ * chunk by chunk as it streams through the filter.
+ */
+class GzipFilter : public StreamFilter {
+public:
+  GzipFilter(GzipFilterConfigSharedPtr config);
+
+  /**
+   * @return bool whether the Accept-Encoding header of a request accepts gzip.
+   */
+  static bool acceptsGzip(const HeaderMap& request_headers);
+
+  // Http::StreamFilterBase
+  void onDestroy() override;
+
+  // Http::StreamDecoderFilter
+  FilterHeadersStatus decodeHeaders(HeaderMap& headers, bool end_stream) override;
+  FilterDataStatus decodeData(Buffer::Instance&, bool) override {
+    return FilterDataStatus::Continue;
+  }
+  FilterTrailersStatus decodeTrailers(HeaderMap&) override {
+    return FilterTrailersStatus::Continue;
+  }
+  void setDecoderFilterCallbacks(StreamDecoderFilterCallbacks&) override {}
+
+  // Http::StreamEncoderFilter
+  FilterHeadersStatus encodeHeaders(HeaderMap& headers, bool end_stream) override;
+  FilterDataStatus encodeData(Buffer::Instance& data, bool end_stream) override;
+  FilterTrailersStatus encodeTrailers(HeaderMap& trailers) override;
+  void setEncoderFilterCallbacks(StreamEncoderFilterCallbacks& callbacks) override {
+    encoder_callbacks_ = &callbacks;
+  }
+
+private:
+  bool compressible(const HeaderMap& response_headers) const;
+  void compress(Buffer::Instance& data, bool end_stream);
+
+  GzipFilterConfigSharedPtr config_;
+  StreamEncoderFilterCallbacks* encoder_callbacks_{};
+  bool accepts_gzip_{};
+  Compressor::CompressorPtr compressor_;
+};
+
+} // namespace Http
+} // namespace Envoy
@@ -1,15 +1,101 @@
 #include "common/http/filter/ip_tagging_filter.h"
 
+#include <string>
+#include <vector>
+
+#include "envoy/common/exception.h"
+
+#include "common/common/utility.h"
+#include "common/http/headers.h"
+#include "common/network/utility.h"
+
+#include "fmt/format.h"
+
 namespace Envoy {
 namespace Http {
 
+IpTaggingFilterConfig::IpTaggingFilterConfig(const Json::Object& json_config,
+                                             const std::string& stat_prefix, Stats::Scope& scope)
+    : Json::Validator(json_config, Json::Schema::IP_TAGGING_HTTP_FILTER_SCHEMA),
+      request_type_(stringToType(json_config.getString("request_type", "both"))),
+      stat_prefix_(stat_prefix + "ip_tagging."), scope_(scope),
+      stats_{ALL_IP_TAGGING_FILTER_STATS(POOL_COUNTER_PREFIX(scope, stat_prefix_))},
+      trie_(new Network::Address::LcTrie(parseTags(json_config))) {}
+
+void IpTaggingFilterConfig::incHit(const std::string& tag) {
+  scope_.counter(fmt::format("{}{}.hit", stat_prefix_, tag)).inc();
+}
+
+std::vector<std::pair<std::string, std::vector<Network::Address::CidrRange>>>
+IpTaggingFilterConfig::parseTags(const Json::Object& json_config) {
+  std::vector<std::pair<std::string, std::vector<Network::Address::CidrRange>>> tag_data;
+  for (const Json::ObjectSharedPtr& ip_tag : json_config.getObjectArray("ip_tags", true)) {
+    std::vector<Network::Address::CidrRange> ranges;
+    for (const std::string& entry : ip_tag->getStringArray("ip_list")) {
+      ranges.push_back(parseRange(entry));
+    }
+    tag_data.emplace_back(ip_tag->getString("ip_tag_name"), std::move(ranges));
+  }
+  return tag_data;
+}
+
+Network::Address::CidrRange IpTaggingFilterConfig::parseRange(const std::string& entry) {
+  // An address without a mask is the range of that single address.
+  if (entry.find('/') == std::string::npos) {
+    return Network::Address::CidrRange::create(Network::Utility::parseInternetAddress(entry),
+                                               128);
+  }
+  Network::Address::CidrRange range = Network::Address::CidrRange::create(entry);
+  if (!range.isValid()) {
+    throw EnvoyException(
+        fmt::format("invalid ip/mask combo '{}' (format is <ip>/<# mask bits>)", entry));
+  }
+  return range;
+}
+
 IpTaggingFilter::IpTaggingFilter(IpTaggingFilterConfigSharedPtr config) : config_(config) {}
 
 IpTaggingFilter::~IpTaggingFilter() {}
 
 void IpTaggingFilter::onDestroy() {}
 
-FilterHeadersStatus IpTaggingFilter::decodeHeaders(HeaderMap&, bool) {
+FilterHeadersStatus IpTaggingFilter::decodeHeaders(HeaderMap& headers, bool) {
+  const bool is_internal_request =
+      headers.EnvoyInternalRequest() &&
+      (headers.EnvoyInternalRequest()->value() ==
+       Headers::get().EnvoyInternalRequestValues.True.c_str());
+  if ((is_internal_request && config_->requestType() == FilterRequestType::External) ||
+      (!is_internal_request && config_->requestType() == FilterRequestType::Internal)) {
+    return FilterHeadersStatus::Continue;
+  }
+
+  config_->stats().total_.inc();
+  Network::Address::InstanceConstSharedPtr address;
+  try {
+    address = Network::Utility::parseInternetAddress(callbacks_->downstreamAddress());
+  } catch (const EnvoyException&) {
+    config_->stats().no_hit_.inc();
+    return FilterHeadersStatus::Continue;
+  }
+
+  const std::vector<std::string>& tags = config_->trie().getData(*address);
+  if (tags.empty()) {
+    config_->stats().no_hit_.inc();
+    return FilterHeadersStatus::Continue;
+  }
+
+  const std::string value = StringUtil::join(tags, ",");
+  HeaderString& header = headers.insertEnvoyIpTags().value();
+  if (!header.empty()) {
+    header.append(",", 1);
+  }
+  header.append(value.c_str(), value.size());
+  for (const std::string& tag : tags) {
+    config_->incHit(tag);
+  }
+
+  // The tags may be used to select the route.
+  callbacks_->clearRouteCache();
   return FilterHeadersStatus::Continue;
 }
 
@@ -7,10 +7,12 @@
 
 #include "envoy/http/filter.h"
 #include "envoy/json/json_object.h"
+#include "envoy/stats/stats_macros.h"
 
 #include "common/common/assert.h"
 #include "common/json/config_schemas.h"
 #include "common/json/json_validator.h"
+#include "common/network/lc_trie.h"
 
 namespace Envoy {
 namespace Http {
@@ -20,18 +22,40 @@ namespace Http {
  */
 enum class FilterRequestType { Internal, External, Both };
 
+/**
+ * All stats for the ip tagging filter. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_IP_TAGGING_FILTER_STATS(COUNTER)                                                       \
+  COUNTER(total)                                                                                   \
+  COUNTER(no_hit)
+// clang-format on
+
+/**
+ * Wrapper struct for ip tagging filter stats. @see stats_macros.h
+ */
+struct IpTaggingFilterStats {
+  ALL_IP_TAGGING_FILTER_STATS(GENERATE_COUNTER_STRUCT)
+};
+
 /**
  * Configuration for the ip tagging filter.
  */
 class IpTaggingFilterConfig : Json::Validator {
 public:
-  IpTaggingFilterConfig(const Json::Object& json_config)
-      : Json::Validator(json_config, Json::Schema::IP_TAGGING_HTTP_FILTER_SCHEMA),
-        request_type_(stringToType(json_config.getString("request_type", "both"))) {}
+  IpTaggingFilterConfig(const Json::Object& json_config, const std::string& stat_prefix,
+                        Stats::Scope& scope);
 
   FilterRequestType requestType() const { return request_type_; }
+  const Network::Address::LcTrie& trie() const { return *trie_; }
+  IpTaggingFilterStats& stats() { return stats_; }
+  void incHit(const std::string& tag);
 
 private:
+  static std::vector<std::pair<std::string, std::vector<Network::Address::CidrRange>>>
+  parseTags(const Json::Object& json_config);
+  static Network::Address::CidrRange parseRange(const std::string& entry);
+
   static FilterRequestType stringToType(const std::string& request_type) {
     if (request_type == "internal") {
       return FilterRequestType::Internal;
@@ -44,6 +68,10 @@ private:
   }
 
   const FilterRequestType request_type_;
+  const std::string stat_prefix_;
+  Stats::Scope& scope_;
+  IpTaggingFilterStats stats_;
+  std::unique_ptr<const Network::Address::LcTrie> trie_;
 };
 
 typedef std::shared_ptr<IpTaggingFilterConfig> IpTaggingFilterConfigSharedPtr;
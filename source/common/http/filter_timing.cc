@@ -0,0 +1,171 @@
+#include "common/http/filter_timing.h"
+
+#include <time.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace Envoy {
+namespace Http {
+
+namespace {
+
+/**
+ * Forwards the decoder callbacks of a filter and times them.
+ */
+class TimedStreamDecoderFilter : public StreamDecoderFilter {
+public:
+  TimedStreamDecoderFilter(StreamDecoderFilterSharedPtr filter, FilterTimingStats& stats)
+      : filter_(filter), stats_(stats) {}
+
+  // Http::StreamFilterBase
+  void onDestroy() override { filter_->onDestroy(); }
+
+  // Http::StreamDecoderFilter
+  FilterHeadersStatus decodeHeaders(HeaderMap& headers, bool end_stream) override {
+    FilterCallTimer timer(stats_.decode_headers_);
+    return filter_->decodeHeaders(headers, end_stream);
+  }
+  FilterDataStatus decodeData(Buffer::Instance& data, bool end_stream) override {
+    FilterCallTimer timer(stats_.decode_data_);
+    return filter_->decodeData(data, end_stream);
+  }
+  FilterTrailersStatus decodeTrailers(HeaderMap& trailers) override {
+    return filter_->decodeTrailers(trailers);
+  }
+  void setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callbacks) override {
+    filter_->setDecoderFilterCallbacks(callbacks);
+  }
+
+private:
+  const StreamDecoderFilterSharedPtr filter_;
+  FilterTimingStats& stats_;
+};
+
+/**
+ * Forwards the encoder callbacks of a filter and times them.
+ */
+class TimedStreamEncoderFilter : public StreamEncoderFilter {
+public:
+  TimedStreamEncoderFilter(StreamEncoderFilterSharedPtr filter, FilterTimingStats& stats)
+      : filter_(filter), stats_(stats) {}
+
+  // Http::StreamFilterBase
+  void onDestroy() override { filter_->onDestroy(); }
+
+  // Http::StreamEncoderFilter
+  FilterHeadersStatus encodeHeaders(HeaderMap& headers, bool end_stream) override {
+    FilterCallTimer timer(stats_.encode_headers_);
+    return filter_->encodeHeaders(headers, end_stream);
+  }
+  FilterDataStatus encodeData(Buffer::Instance& data, bool end_stream) override {
+    FilterCallTimer timer(stats_.encode_data_);
+    return filter_->encodeData(data, end_stream);
+  }
+  FilterTrailersStatus encodeTrailers(HeaderMap& trailers) override {
+    return filter_->encodeTrailers(trailers);
+  }
+  void setEncoderFilterCallbacks(StreamEncoderFilterCallbacks& callbacks) override {
+    filter_->setEncoderFilterCallbacks(callbacks);
+  }
+
+private:
+  const StreamEncoderFilterSharedPtr filter_;
+  FilterTimingStats& stats_;
+};
+
+/**
+ * Forwards both the decoder and the encoder callbacks of a filter and times them.
+ */
+class TimedStreamFilter : public StreamFilter {
+public:
+  TimedStreamFilter(StreamFilterSharedPtr filter, FilterTimingStats& stats)
+      : filter_(filter), stats_(stats) {}
+
+  // Http::StreamFilterBase
+  void onDestroy() override { static_cast<StreamDecoderFilter&>(*filter_).onDestroy(); }
+
+  // Http::StreamDecoderFilter
+  FilterHeadersStatus decodeHeaders(HeaderMap& headers, bool end_stream) override {
+    FilterCallTimer timer(stats_.decode_headers_);
+    return filter_->decodeHeaders(headers, end_stream);
+  }
+  FilterDataStatus decodeData(Buffer::Instance& data, bool end_stream) override {
+    FilterCallTimer timer(stats_.decode_data_);
+    return filter_->decodeData(data, end_stream);
+  }
+  FilterTrailersStatus decodeTrailers(HeaderMap& trailers) override {
+    return filter_->decodeTrailers(trailers);
+  }
+  void setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callbacks) override {
+    filter_->setDecoderFilterCallbacks(callbacks);
+  }
+
+  // Http::StreamEncoderFilter
+  FilterHeadersStatus encodeHeaders(HeaderMap& headers, bool end_stream) override {
+    FilterCallTimer timer(stats_.encode_headers_);
+    return filter_->encodeHeaders(headers, end_stream);
+  }
+  FilterDataStatus encodeData(Buffer::Instance& data, bool end_stream) override {
+    FilterCallTimer timer(stats_.encode_data_);
+    return filter_->encodeData(data, end_stream);
+  }
+  FilterTrailersStatus encodeTrailers(HeaderMap& trailers) override {
+    return filter_->encodeTrailers(trailers);
+  }
+  void setEncoderFilterCallbacks(StreamEncoderFilterCallbacks& callbacks) override {
+    filter_->setEncoderFilterCallbacks(callbacks);
+  }
+
+private:
+  const StreamFilterSharedPtr filter_;
+  FilterTimingStats& stats_;
+};
+
+} // namespace
+
+FilterCallTimingStats::FilterCallTimingStats(Stats::Scope& scope, const std::string& prefix)
+    : wall_us_(scope.histogram(prefix + "_wall_us")), cpu_us_(scope.histogram(prefix + "_cpu_us")) {
+}
+
+FilterTimingStats::FilterTimingStats(Stats::Scope& scope, const std::string& prefix,
+                                     const std::string& filter_name)
+    : decode_headers_(scope, prefix + "filter." + filter_name + ".decode_headers"),
+      decode_data_(scope, prefix + "filter." + filter_name + ".decode_data"),
+      encode_headers_(scope, prefix + "filter." + filter_name + ".encode_headers"),
+      encode_data_(scope, prefix + "filter." + filter_name + ".encode_data") {}
+
+FilterCallTimer::FilterCallTimer(FilterCallTimingStats& stats)
+    : stats_(stats), wall_start_(std::chrono::steady_clock::now()), cpu_start_(threadCpuTime()) {}
+
+FilterCallTimer::~FilterCallTimer() {
+  const std::chrono::nanoseconds cpu = threadCpuTime() - cpu_start_;
+  const std::chrono::steady_clock::duration wall = std::chrono::steady_clock::now() - wall_start_;
+  stats_.wall_us_.recordValue(
+      std::chrono::duration_cast<std::chrono::microseconds>(wall).count());
+  stats_.cpu_us_.recordValue(std::chrono::duration_cast<std::chrono::microseconds>(cpu).count());
+}
+
+std::chrono::nanoseconds FilterCallTimer::threadCpuTime() {
+  timespec now;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0) {
+    return std::chrono::nanoseconds(0);
+  }
+  return std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec);
+}
+
+void TimedFilterChainFactoryCallbacks::addStreamDecoderFilter(StreamDecoderFilterSharedPtr filter) {
+  parent_.addStreamDecoderFilter(std::make_shared<TimedStreamDecoderFilter>(filter, stats_));
+}
+
+void TimedFilterChainFactoryCallbacks::addStreamEncoderFilter(StreamEncoderFilterSharedPtr filter) {
+  parent_.addStreamEncoderFilter(std::make_shared<TimedStreamEncoderFilter>(filter, stats_));
+}
+
+void TimedFilterChainFactoryCallbacks::addStreamFilter(StreamFilterSharedPtr filter) {
+  parent_.addStreamFilter(std::make_shared<TimedStreamFilter>(filter, stats_));
+}
+
+} // namespace Http
+} // namespace Envoy
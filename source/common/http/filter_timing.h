@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "envoy/http/filter.h"
+#include "envoy/stats/stats.h"
+
+namespace Envoy {
+namespace Http {
+
+/**
+ * The histograms of the wall and CPU time, in microseconds, that a filter spends in one of its
+ * callbacks.
+ */
+struct FilterCallTimingStats {
+  FilterCallTimingStats(Stats::Scope& scope, const std::string& prefix);
+
+  Stats::Histogram& wall_us_;
+  Stats::Histogram& cpu_us_;
+};
+
+/**
+ * The timing histograms of the callbacks of a filter, which are named
+ * <prefix>filter.<filter name>.<callback>_{wall,cpu}_us. The time of a callback includes the time
+ * of the filters that it calls into, e.g. of the encoder filters when a decoder filter sends a
+ * local reply.
+ */
+struct FilterTimingStats {
+  FilterTimingStats(Stats::Scope& scope, const std::string& prefix, const std::string& filter_name);
+
+  FilterCallTimingStats decode_headers_;
+  FilterCallTimingStats decode_data_;
+  FilterCallTimingStats encode_headers_;
+  FilterCallTimingStats encode_data_;
+};
+
+typedef std::unique_ptr<FilterTimingStats> FilterTimingStatsPtr;
+
+/**
+ * Times a filter callback from construction to destruction.
+ */
+class FilterCallTimer {
+public:
+  FilterCallTimer(FilterCallTimingStats& stats);
+  ~FilterCallTimer();
+
+  /**
+   * @return std::chrono::nanoseconds the CPU time of the calling thread.
+   */
+  static std::chrono::nanoseconds threadCpuTime();
+
+private:
+  FilterCallTimingStats& stats_;
+  const std::chrono::steady_clock::time_point wall_start_;
+  const std::chrono::nanoseconds cpu_start_;
+};
+
+/**
+ * Filter chain factory callbacks that add the filters of one filter factory wrapped in filters
+ * that time their callbacks. The connection manager uses them for a sample of its streams, so that
+ * unsampled streams do not pay for the clock reads.
+ */
+class TimedFilterChainFactoryCallbacks : public FilterChainFactoryCallbacks {
+public:
+  TimedFilterChainFactoryCallbacks(FilterChainFactoryCallbacks& parent, FilterTimingStats& stats)
+      : parent_(parent), stats_(stats) {}
+
+  // Http::FilterChainFactoryCallbacks
+  void addStreamDecoderFilter(StreamDecoderFilterSharedPtr filter) override;
+  void addStreamEncoderFilter(StreamEncoderFilterSharedPtr filter) override;
+  void addStreamFilter(StreamFilterSharedPtr filter) override;
+  void addAccessLogHandler(AccessLog::InstanceSharedPtr handler) override {
+    parent_.addAccessLogHandler(handler);
+  }
+
+private:
+  FilterChainFactoryCallbacks& parent_;
+  FilterTimingStats& stats_;
+};
+
+} // namespace Http
+} // namespace Envoy
@@ -1,7 +1,9 @@
 #include "common/http/header_map_impl.h"
 
+#include <atomic>
 #include <cstdint>
-#include <list>
+#include <cstring>
+#include <new>
 #include <string>
 
 #include "common/common/assert.h"
@@ -12,6 +14,49 @@
 namespace Envoy {
 namespace Http {
 
+namespace {
+
+// Heap allocated storage is prefixed with a count of the strings that share it. Header maps can be
+// copied across threads (e.g., into a cache), so the count is atomic.
+typedef std::atomic<uint32_t> StorageRefCount;
+
+StorageRefCount& storageRefCount(char* data) {
+  return *reinterpret_cast<StorageRefCount*>(data - sizeof(StorageRefCount));
+}
+
+char* allocateStorage(uint32_t capacity) {
+  char* storage = static_cast<char*>(malloc(sizeof(StorageRefCount) + capacity));
+  new (storage) StorageRefCount(1);
+  return storage + sizeof(StorageRefCount);
+}
+
+void releaseStorage(char* data) {
+  if (--storageRefCount(data) == 0) {
+    free(data - sizeof(StorageRefCount));
+  }
+}
+
+bool storageShared(char* data) { return storageRefCount(data) > 1; }
+
+/**
+ * Grow storage to a new capacity, keeping the first size bytes. Storage that is shared is copied
+ * rather than reallocated, and is left to the other strings that share it.
+ */
+char* reallocateStorage(char* data, uint32_t size, uint32_t capacity) {
+  if (!storageShared(data)) {
+    return static_cast<char*>(
+               realloc(data - sizeof(StorageRefCount), sizeof(StorageRefCount) + capacity)) +
+           sizeof(StorageRefCount);
+  }
+
+  char* new_data = allocateStorage(capacity);
+  memcpy(new_data, data, size);
+  releaseStorage(data);
+  return new_data;
+}
+
+} // namespace
+
 HeaderString::HeaderString() : type_(Type::Inline) {
   buffer_.dynamic_ = inline_buffer_;
   clear();
@@ -58,7 +103,13 @@ HeaderString::~HeaderString() { freeDynamic(); }
 
 void HeaderString::freeDynamic() {
   if (type_ == Type::Dynamic) {
-    free(buffer_.dynamic_);
+    releaseStorage(buffer_.dynamic_);
+  }
+}
+
+void HeaderString::unshare() {
+  if (type_ == Type::Dynamic && storageShared(buffer_.dynamic_)) {
+    buffer_.dynamic_ = reallocateStorage(buffer_.dynamic_, string_length_ + 1, dynamic_capacity_);
   }
 }
 
@@ -87,7 +138,7 @@ void HeaderString::append(const char* data, uint32_t size) {
     // We can get here either because we didn't fit in inline or we are already dynamic.
     if (type_ == Type::Inline) {
       uint32_t new_capacity = (string_length_ + size) * 2;
-      buffer_.dynamic_ = static_cast<char*>(malloc(new_capacity));
+      buffer_.dynamic_ = allocateStorage(new_capacity);
       memcpy(buffer_.dynamic_, inline_buffer_, string_length_);
       dynamic_capacity_ = new_capacity;
       type_ = Type::Dynamic;
@@ -95,7 +146,9 @@ void HeaderString::append(const char* data, uint32_t size) {
       if (size + 1 + string_length_ > dynamic_capacity_) {
         // Need to reallocate.
         dynamic_capacity_ = (string_length_ + size) * 2;
-        buffer_.dynamic_ = static_cast<char*>(realloc(buffer_.dynamic_, dynamic_capacity_));
+        buffer_.dynamic_ = reallocateStorage(buffer_.dynamic_, string_length_, dynamic_capacity_);
+      } else {
+        unshare();
       }
     }
   }
@@ -144,14 +197,17 @@ void HeaderString::setCopy(const char* data, uint32_t size) {
     // We can get here either because we didn't fit in inline or we are already dynamic.
     if (type_ == Type::Inline) {
       dynamic_capacity_ = size * 2;
-      buffer_.dynamic_ = static_cast<char*>(malloc(dynamic_capacity_));
+      buffer_.dynamic_ = allocateStorage(dynamic_capacity_);
       type_ = Type::Dynamic;
     } else {
-      if (size + 1 > dynamic_capacity_) {
-        // Need to reallocate. Use free/malloc to avoid the copy since we are about to overwrite.
-        dynamic_capacity_ = size * 2;
-        free(buffer_.dynamic_);
-        buffer_.dynamic_ = static_cast<char*>(malloc(dynamic_capacity_));
+      if (size + 1 > dynamic_capacity_ || storageShared(buffer_.dynamic_)) {
+        // Need to reallocate. Use release/allocate to avoid the copy since we are about to
+        // overwrite. Shared storage keeps its capacity, which setInteger() relies on.
+        if (size + 1 > dynamic_capacity_) {
+          dynamic_capacity_ = size * 2;
+        }
+        releaseStorage(buffer_.dynamic_);
+        buffer_.dynamic_ = allocateStorage(dynamic_capacity_);
       }
     }
   }
@@ -175,6 +231,7 @@ void HeaderString::setInteger(uint64_t value) {
   case Type::Inline:
   case Type::Dynamic: {
     // Whether dynamic or inline the buffer is guaranteed to be large enough.
+    unshare();
     string_length_ = StringUtil::itoa(buffer_.dynamic_, 32, value);
   }
   }
@@ -187,6 +244,24 @@ void HeaderString::setReference(const std::string& ref_value) {
   string_length_ = ref_value.size();
 }
 
+void HeaderString::setShared(const HeaderString& value) {
+  if (this == &value) {
+    return;
+  }
+
+  if (value.type_ != Type::Dynamic) {
+    setCopy(value.c_str(), value.size());
+    return;
+  }
+
+  freeDynamic();
+  type_ = Type::Dynamic;
+  buffer_.dynamic_ = value.buffer_.dynamic_;
+  dynamic_capacity_ = value.dynamic_capacity_;
+  string_length_ = value.string_length_;
+  ++storageRefCount(buffer_.dynamic_);
+}
+
 HeaderMapImpl::HeaderEntryImpl::HeaderEntryImpl(const LowerCaseString& key) : key_(key) {}
 
 HeaderMapImpl::HeaderEntryImpl::HeaderEntryImpl(const LowerCaseString& key, HeaderString&& value)
@@ -206,7 +281,7 @@ void HeaderMapImpl::HeaderEntryImpl::value(const std::string& value) {
 void HeaderMapImpl::HeaderEntryImpl::value(uint64_t value) { value_.setInteger(value); }
 
 void HeaderMapImpl::HeaderEntryImpl::value(const HeaderEntry& header) {
-  value(header.value().c_str(), header.value().size());
+  value_.setShared(header.value());
 }
 
 #define INLINE_HEADER_STATIC_MAP_ENTRY(name)                                                       \
@@ -214,6 +289,42 @@ void HeaderMapImpl::HeaderEntryImpl::value(const HeaderEntry& header) {
     return {&h.inline_headers_.name##_, &Headers::get().name};                                     \
   });
 
+namespace {
+
+// Common header names that are not O(1) headers. Header keys with these names reference a single
+// static copy of the name.
+const char* const INTERNED_HEADER_NAMES[] = {
+    "accept",
+    "accept-encoding",
+    "accept-language",
+    "accept-ranges",
+    "age",
+    "cache-control",
+    "content-encoding",
+    "content-language",
+    "cookie",
+    "etag",
+    "expires",
+    "if-modified-since",
+    "if-none-match",
+    "last-modified",
+    "location",
+    "pragma",
+    "referer",
+    "set-cookie",
+    "strict-transport-security",
+    "vary",
+    "via",
+    "x-content-type-options",
+    "x-forwarded-host",
+    "x-frame-options",
+    "x-real-ip",
+};
+
+} // namespace
+
+const uint32_t HeaderMapImpl::StaticLookupTable::TABLE_SIZE;
+
 HeaderMapImpl::StaticLookupTable::StaticLookupTable() {
   ALL_INLINE_HEADERS(INLINE_HEADER_STATIC_MAP_ENTRY)
 
@@ -221,47 +332,141 @@ HeaderMapImpl::StaticLookupTable::StaticLookupTable() {
   add(Headers::get().HostLegacy.get().c_str(), [](HeaderMapImpl& h) -> StaticLookupResponse {
     return {&h.inline_headers_.Host_, &Headers::get().Host};
   });
+
+  // The entries point into interned_names_, so it must not grow once they are added.
+  interned_names_.reserve(sizeof(INTERNED_HEADER_NAMES) / sizeof(INTERNED_HEADER_NAMES[0]));
+  for (const char* name : INTERNED_HEADER_NAMES) {
+    interned_names_.emplace_back(name);
+    add(interned_names_.back());
+  }
+
+  build();
 }
 
 void HeaderMapImpl::StaticLookupTable::add(const char* key, StaticLookupEntry::EntryCb cb) {
-  StaticLookupEntry* current = &root_;
-  while (uint8_t c = *key) {
-    if (!current->entries_[c]) {
-      current->entries_[c].reset(new StaticLookupEntry());
+  StaticLookupEntry entry;
+  entry.key_ = key;
+  entry.size_ = strlen(key);
+  entry.cb_ = cb;
+  entries_.push_back(entry);
+}
+
+void HeaderMapImpl::StaticLookupTable::add(const LowerCaseString& interned) {
+  StaticLookupEntry entry;
+  entry.key_ = interned.get().c_str();
+  entry.size_ = interned.get().size();
+  entry.interned_ = &interned;
+  entries_.push_back(entry);
+}
+
+uint32_t HeaderMapImpl::StaticLookupTable::hash(const char* key, uint32_t size, uint32_t seed) {
+  // FNV-1a with the seed mixed into the offset basis.
+  uint32_t hash = 2166136261U ^ seed;
+  for (uint32_t i = 0; i < size; i++) {
+    hash ^= static_cast<uint8_t>(key[i]);
+    hash *= 16777619U;
+  }
+
+  return hash ^ (hash >> 16);
+}
+
+void HeaderMapImpl::StaticLookupTable::build() {
+  for (seed_ = 0;; seed_++) {
+    RELEASE_ASSERT(seed_ < 100000);
+    table_.fill(nullptr);
+    bool collision = false;
+    for (const StaticLookupEntry& entry : entries_) {
+      const StaticLookupEntry*& slot =
+          table_[hash(entry.key_, entry.size_, seed_) & (TABLE_SIZE - 1)];
+      if (slot) {
+        collision = true;
+        break;
+      }
+
+      slot = &entry;
     }
 
-    current = current->entries_[c].get();
-    key++;
+    if (!collision) {
+      return;
+    }
   }
+}
 
-  current->cb_ = cb;
+const HeaderMapImpl::StaticLookupEntry*
+HeaderMapImpl::StaticLookupTable::find(const char* key, uint32_t size) const {
+  const StaticLookupEntry* entry = table_[hash(key, size, seed_) & (TABLE_SIZE - 1)];
+  if (entry && entry->size_ == size && memcmp(entry->key_, key, size) == 0) {
+    return entry;
+  }
+
+  return nullptr;
 }
 
-HeaderMapImpl::StaticLookupEntry::EntryCb
-HeaderMapImpl::StaticLookupTable::find(const char* key) const {
-  const StaticLookupEntry* current = &root_;
-  while (uint8_t c = *key) {
-    current = current->entries_[c].get();
-    if (current) {
-      key++;
-    } else {
-      return nullptr;
+HeaderMapImpl::HeaderList::~HeaderList() {
+  clear();
+
+  ArenaAllocator<Block> allocator(overflow_blocks_.get_allocator());
+  for (Block* block : overflow_blocks_) {
+    allocator.deallocate(block, 1);
+  }
+}
+
+void HeaderMapImpl::HeaderList::erase(HeaderEntryImpl& entry) {
+  Slot& slot = slotAt(entry.index_);
+  ASSERT(slot.live_ && &slot.entry() == &entry);
+  entry.~HeaderEntryImpl();
+  slot.live_ = false;
+  size_--;
+
+  while (used_ > 0 && !slotAt(used_ - 1).live_) {
+    used_--;
+  }
+}
+
+void HeaderMapImpl::HeaderList::clear() {
+  for (uint32_t i = 0; i < used_; i++) {
+    Slot& slot = slotAt(i);
+    if (slot.live_) {
+      slot.entry().~HeaderEntryImpl();
+      slot.live_ = false;
     }
   }
 
-  return current->cb_;
+  used_ = 0;
+  size_ = 0;
 }
 
 HeaderMapImpl::HeaderMapImpl() { memset(&inline_headers_, 0, sizeof(inline_headers_)); }
 
+HeaderMapImpl::HeaderMapImpl(Arena& arena) : headers_(&arena) {
+  memset(&inline_headers_, 0, sizeof(inline_headers_));
+}
+
+HeaderMapImpl::HeaderMapImpl(HeaderMapImpl&& rhs) : HeaderMapImpl() {
+  // Entries cannot move between maps since they live inside the map's storage, so move the
+  // strings instead. This also rebuilds the inline header pointers for this map.
+  for (uint32_t i = 0; i < rhs.headers_.usedSlots(); i++) {
+    HeaderEntryImpl* header = rhs.headers_.at(i);
+    if (header) {
+      addViaMove(std::move(header->key_), std::move(header->value_));
+    }
+  }
+
+  rhs.headers_.clear();
+  memset(&rhs.inline_headers_, 0, sizeof(rhs.inline_headers_));
+  rhs.added_byte_size_ = 0;
+  rhs.added_count_ = 0;
+}
+
 HeaderMapImpl::HeaderMapImpl(const HeaderMap& rhs) : HeaderMapImpl() {
   rhs.iterate(
       [](const HeaderEntry& header, void* context) -> void {
-        // TODO(mattklein123) PERF: Avoid copying here is not necessary.
+        // Heap allocated values (e.g., long cookies) are shared with the copied map rather than
+        // copied, which matters for the copies made for retries and shadows.
         HeaderString key_string;
-        key_string.setCopy(header.key().c_str(), header.key().size());
+        key_string.setShared(header.key());
         HeaderString value_string;
-        value_string.setCopy(header.value().c_str(), header.value().size());
+        value_string.setShared(header.value());
 
         static_cast<HeaderMapImpl*>(context)->addViaMove(std::move(key_string),
                                                          std::move(value_string));
@@ -287,7 +492,7 @@ bool HeaderMapImpl::operator==(const HeaderMapImpl& rhs) const {
   }
 
   for (auto i = headers_.begin(), j = rhs.headers_.begin(); i != headers_.end(); ++i, ++j) {
-    if (i->key() != j->key().c_str() || i->value() != j->value().c_str()) {
+    if ((*i).key() != (*j).key().c_str() || (*i).value() != (*j).value().c_str()) {
       return false;
     }
   }
@@ -296,20 +501,24 @@ bool HeaderMapImpl::operator==(const HeaderMapImpl& rhs) const {
 }
 
 void HeaderMapImpl::insertByKey(HeaderString&& key, HeaderString&& value) {
-  StaticLookupEntry::EntryCb cb = ConstSingleton<StaticLookupTable>::get().find(key.c_str());
-  if (cb) {
+  added_byte_size_ += key.size() + value.size();
+  added_count_++;
+  const StaticLookupEntry* entry =
+      ConstSingleton<StaticLookupTable>::get().find(key.c_str(), key.size());
+  if (entry && entry->cb_) {
     // TODO(mattklein123): Currently, for all of the inline headers, we don't support appending. The
     // only inline header where we should be converting multiple headers into a comma delimited
     // list is XFF. This is not a crisis for now but we should allow an inline header to indicate
     // that it should be appended to. In that case, we would do an append here. We can do this in
     // a follow up.
     key.clear();
-    StaticLookupResponse ref_lookup_response = cb(*this);
+    StaticLookupResponse ref_lookup_response = entry->cb_(*this);
     maybeCreateInline(ref_lookup_response.entry_, *ref_lookup_response.key_, std::move(value));
   } else {
-    std::list<HeaderEntryImpl>::iterator i =
-        headers_.emplace(headers_.end(), std::move(key), std::move(value));
-    i->entry_ = i;
+    if (entry && key.type() != HeaderString::Type::Reference) {
+      key.setReference(entry->interned_->get());
+    }
+    headers_.emplaceBack(std::move(key), std::move(value));
   }
 }
 
@@ -386,16 +595,17 @@ void HeaderMapImpl::iterate(ConstIterateCb cb, void* context) const {
 }
 
 void HeaderMapImpl::remove(const LowerCaseString& key) {
-  StaticLookupEntry::EntryCb cb = ConstSingleton<StaticLookupTable>::get().find(key.get().c_str());
-  if (cb) {
-    StaticLookupResponse ref_lookup_response = cb(*this);
+  const StaticLookupEntry* entry =
+      ConstSingleton<StaticLookupTable>::get().find(key.get().c_str(), key.get().size());
+  if (entry && entry->cb_) {
+    StaticLookupResponse ref_lookup_response = entry->cb_(*this);
     removeInline(ref_lookup_response.entry_);
   } else {
-    for (auto i = headers_.begin(); i != headers_.end();) {
-      if (i->key() == key.get().c_str()) {
-        i = headers_.erase(i);
-      } else {
-        ++i;
+    // Erasing can only shrink usedSlots(), so checking the bound on each pass is safe.
+    for (uint32_t i = 0; i < headers_.usedSlots(); i++) {
+      HeaderEntryImpl* header = headers_.at(i);
+      if (header && header->key() == key.get().c_str()) {
+        headers_.erase(*header);
       }
     }
   }
@@ -407,9 +617,7 @@ HeaderMapImpl::HeaderEntryImpl& HeaderMapImpl::maybeCreateInline(HeaderEntryImpl
     return **entry;
   }
 
-  std::list<HeaderEntryImpl>::iterator i = headers_.emplace(headers_.end(), key);
-  i->entry_ = i;
-  *entry = &(*i);
+  *entry = &headers_.emplaceBack(key);
   return **entry;
 }
 
@@ -421,9 +629,7 @@ HeaderMapImpl::HeaderEntryImpl& HeaderMapImpl::maybeCreateInline(HeaderEntryImpl
     return **entry;
   }
 
-  std::list<HeaderEntryImpl>::iterator i = headers_.emplace(headers_.end(), key, std::move(value));
-  i->entry_ = i;
-  *entry = &(*i);
+  *entry = &headers_.emplaceBack(key, std::move(value));
   return **entry;
 }
 
@@ -434,7 +640,7 @@ void HeaderMapImpl::removeInline(HeaderEntryImpl** ptr_to_entry) {
 
   HeaderEntryImpl* entry = *ptr_to_entry;
   *ptr_to_entry = nullptr;
-  headers_.erase(entry->entry_);
+  headers_.erase(*entry);
 }
 
 } // namespace Http
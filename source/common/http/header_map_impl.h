@@ -2,12 +2,14 @@
 
 #include <array>
 #include <cstdint>
-#include <list>
 #include <memory>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 #include "envoy/http/header_map.h"
 
+#include "common/common/arena.h"
 #include "common/common/non_copyable.h"
 #include "common/http/headers.h"
 
@@ -38,8 +40,14 @@ public:
 class HeaderMapImpl : public HeaderMap {
 public:
   HeaderMapImpl();
+  /**
+   * Construct a header map whose entry storage beyond the first block comes from an arena. The
+   * arena must outlive the header map.
+   */
+  explicit HeaderMapImpl(Arena& arena);
   HeaderMapImpl(const std::initializer_list<std::pair<LowerCaseString, std::string>>& values);
   HeaderMapImpl(const HeaderMap& rhs);
+  HeaderMapImpl(HeaderMapImpl&& rhs);
 
   /**
    * Add a header via full move. This is the expected high performance paths for codecs populating
@@ -47,6 +55,21 @@ public:
    */
   void addViaMove(HeaderString&& key, HeaderString&& value);
 
+  /**
+   * @return uint64_t the byte size of the keys and values of all of the headers added to the map,
+   *         kept as they are added. Unlike byteSize() this does not walk the headers, so codecs
+   *         can check it against their limits on every header they decode. It includes the
+   *         repeats of O(1) headers that the map drops, and is not reduced by removing headers or
+   *         by changing values in place.
+   */
+  uint64_t addedByteSize() const { return added_byte_size_; }
+
+  /**
+   * @return uint32_t the number of headers added to the map, counted the same way as
+   *         addedByteSize().
+   */
+  uint32_t addedCount() const { return added_count_; }
+
   /**
    * For testing. Equality is based on equality of the backing list. This is an exact match
    * comparison (order matters).
@@ -83,7 +106,125 @@ protected:
 
     HeaderString key_;
     HeaderString value_;
-    std::list<HeaderEntryImpl>::iterator entry_;
+    uint32_t index_{};
+  };
+
+  /**
+   * Insertion ordered storage for header entries. Entries are constructed in place inside fixed
+   * size blocks, the first of which is embedded in the header map, so that a typical request or
+   * response needs no allocations for header bookkeeping and iteration walks contiguous memory.
+   * Entries never move once created, which keeps the inline header pointers and any HeaderEntry
+   * handed out valid until that entry is removed. Removing an entry leaves a hole that iteration
+   * skips; holes at the tail are reclaimed immediately so add/remove pairs do not grow the list.
+   */
+  class HeaderList : NonCopyable {
+  private:
+    struct Slot;
+
+  public:
+    class ConstIterator {
+    public:
+      ConstIterator(const HeaderList& list, uint32_t index) : list_(list), index_(index) {
+        skipHoles();
+      }
+
+      const HeaderEntryImpl& operator*() const { return list_.slotAt(index_).entry(); }
+      ConstIterator& operator++() {
+        index_++;
+        skipHoles();
+        return *this;
+      }
+      bool operator!=(const ConstIterator& rhs) const { return index_ != rhs.index_; }
+
+    private:
+      void skipHoles() {
+        while (index_ < list_.used_ && !list_.slotAt(index_).live_) {
+          index_++;
+        }
+      }
+
+      const HeaderList& list_;
+      uint32_t index_;
+    };
+
+    HeaderList(Arena* arena) : overflow_blocks_(ArenaAllocator<Block*>(arena)) {}
+    ~HeaderList();
+
+    /**
+     * Construct a new entry at the end of the list.
+     */
+    template <class... Args> HeaderEntryImpl& emplaceBack(Args&&... args) {
+      if (used_ == (overflow_blocks_.size() + 1) * BLOCK_SIZE) {
+        Block* block = ArenaAllocator<Block>(overflow_blocks_.get_allocator()).allocate(1);
+        overflow_blocks_.push_back(block);
+      }
+
+      const uint32_t index = used_++;
+      Slot& slot = slotAt(index);
+      HeaderEntryImpl* entry = new (&slot.storage_) HeaderEntryImpl(std::forward<Args>(args)...);
+      entry->index_ = index;
+      slot.live_ = true;
+      size_++;
+      return *entry;
+    }
+
+    /**
+     * Destroy an entry previously returned by emplaceBack().
+     */
+    void erase(HeaderEntryImpl& entry);
+
+    /**
+     * Destroy all entries. Overflow blocks are retained for reuse.
+     */
+    void clear();
+
+    /**
+     * @return the entry at a given index or nullptr if it has been removed. Indexes are in
+     *         [0, usedSlots()) and are stable for the lifetime of the entry.
+     */
+    HeaderEntryImpl* at(uint32_t index) {
+      Slot& slot = slotAt(index);
+      return slot.live_ ? &slot.entry() : nullptr;
+    }
+
+    ConstIterator begin() const { return ConstIterator(*this, 0); }
+    ConstIterator end() const { return ConstIterator(*this, used_); }
+    size_t size() const { return size_; }
+    uint32_t usedSlots() const { return used_; }
+
+  private:
+    // Sized so that a block is a few KB and most requests fit in the embedded block plus at most
+    // one or two overflow blocks.
+    static const uint32_t BLOCK_SIZE = 16;
+
+    struct Slot {
+      HeaderEntryImpl& entry() { return *reinterpret_cast<HeaderEntryImpl*>(&storage_); }
+      const HeaderEntryImpl& entry() const {
+        return *reinterpret_cast<const HeaderEntryImpl*>(&storage_);
+      }
+
+      typename std::aligned_storage<sizeof(HeaderEntryImpl), alignof(HeaderEntryImpl)>::type
+          storage_;
+      bool live_;
+    };
+
+    struct Block {
+      Slot slots_[BLOCK_SIZE];
+    };
+
+    Slot& slotAt(uint32_t index) {
+      return index < BLOCK_SIZE
+                 ? inline_block_.slots_[index]
+                 : overflow_blocks_[index / BLOCK_SIZE - 1]->slots_[index % BLOCK_SIZE];
+    }
+    const Slot& slotAt(uint32_t index) const {
+      return const_cast<HeaderList*>(this)->slotAt(index);
+    }
+
+    Block inline_block_;
+    std::vector<Block*, ArenaAllocator<Block*>> overflow_blocks_;
+    uint32_t used_{};
+    uint32_t size_{};
   };
 
   struct StaticLookupResponse {
@@ -94,20 +235,37 @@ protected:
   struct StaticLookupEntry {
     typedef StaticLookupResponse (*EntryCb)(HeaderMapImpl&);
 
+    const char* key_{};
+    uint32_t size_{};
+    // Set for the O(1) headers.
     EntryCb cb_{};
-    std::array<std::unique_ptr<StaticLookupEntry>, 256> entries_;
+    // Set for common names that are not O(1) headers. Keys with such a name reference this string
+    // instead of holding a copy.
+    const LowerCaseString* interned_{};
   };
 
   /**
    * This is the static lookup table that is used to determine whether a header is one of the O(1)
-   * headers. This uses a trie for lookup time at most equal to the size of the incoming string.
+   * headers or one of the interned common header names. The table is a perfect hash: the hash seed
+   * is chosen when the table is built so that every known name has its own slot, which makes a
+   * lookup a hash of the key plus a single compare.
    */
   struct StaticLookupTable {
     StaticLookupTable();
     void add(const char* key, StaticLookupEntry::EntryCb cb);
-    StaticLookupEntry::EntryCb find(const char* key) const;
+    void add(const LowerCaseString& interned);
+    const StaticLookupEntry* find(const char* key, uint32_t size) const;
+
+    // Must be a power of two. Sized so that a collision free seed is found after a few attempts.
+    static const uint32_t TABLE_SIZE = 1024;
+
+    static uint32_t hash(const char* key, uint32_t size, uint32_t seed);
+    void build();
 
-    StaticLookupEntry root_;
+    std::vector<StaticLookupEntry> entries_;
+    std::vector<LowerCaseString> interned_names_;
+    std::array<const StaticLookupEntry*, TABLE_SIZE> table_;
+    uint32_t seed_{};
   };
 
   struct AllInlineHeaders {
@@ -121,7 +279,9 @@ protected:
   void removeInline(HeaderEntryImpl** entry);
 
   AllInlineHeaders inline_headers_;
-  std::list<HeaderEntryImpl> headers_;
+  HeaderList headers_{nullptr};
+  uint64_t added_byte_size_{};
+  uint32_t added_count_{};
 
   ALL_INLINE_HEADERS(DEFINE_INLINE_HEADER_FUNCS)
 };
@@ -1,5 +1,6 @@
 #include "common/http/http1/codec_impl.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <string>
 
@@ -21,6 +22,7 @@ namespace Http1 {
 
 const std::string StreamEncoderImpl::CRLF = "\r\n";
 const std::string StreamEncoderImpl::LAST_CHUNK = "0\r\n\r\n";
+const std::string StreamEncoderImpl::CRLF_LAST_CHUNK = "\r\n0\r\n\r\n";
 
 void StreamEncoderImpl::encodeHeader(const char* key, uint32_t key_size, const char* value,
                                      uint32_t value_size) {
@@ -88,53 +90,76 @@ void StreamEncoderImpl::encodeHeaders(const HeaderMap& headers, bool end_stream)
   connection_.addCharToBuffer('\n');
 
   if (end_stream) {
-    endEncode();
+    endEncode(false);
   } else {
-    connection_.flushOutput();
+    connection_.flushOutput(held_output_);
   }
 }
 
 void StreamEncoderImpl::encodeData(Buffer::Instance& data, bool end_stream) {
   // end_stream may be indicated with a zero length data buffer. If that is the case, so not
   // atually write the zero length buffer out.
-  if (data.length() > 0) {
+  const bool has_data = data.length() > 0;
+  if (has_data) {
     if (chunk_encoding_) {
-      connection_.buffer().add(fmt::format("{:x}\r\n", data.length()));
+      addChunkHeader(data.length());
     }
 
+    // The slices of the body are moved behind the chunk header rather than copied. Only slices
+    // too small to be worth their own iovec are copied, into the tail of the slice before them.
     connection_.buffer().move(data);
 
-    if (chunk_encoding_) {
+    if (chunk_encoding_ && !end_stream) {
       connection_.buffer().add(CRLF);
     }
   }
 
   if (end_stream) {
-    endEncode();
+    endEncode(has_data);
   } else {
-    connection_.flushOutput();
+    connection_.flushOutput(held_output_);
   }
 }
 
-void StreamEncoderImpl::encodeTrailers(const HeaderMap&) { endEncode(); }
+void StreamEncoderImpl::encodeTrailers(const HeaderMap&) { endEncode(false); }
+
+void StreamEncoderImpl::addChunkHeader(uint64_t length) {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  // Formatted back to front, which needs no more than 16 hex digits and the CRLF.
+  char header[18];
+  char* const end = header + sizeof(header);
+  char* start = end - 2;
+  start[0] = '\r';
+  start[1] = '\n';
+  do {
+    *--start = HEX_DIGITS[length & 0xf];
+    length >>= 4;
+  } while (length != 0);
+  connection_.buffer().add(start, end - start);
+}
 
-void StreamEncoderImpl::endEncode() {
+void StreamEncoderImpl::endEncode(bool after_chunk) {
   if (chunk_encoding_) {
-    connection_.buffer().add(LAST_CHUNK);
+    // The CRLF that ends the body of the chunk before goes out with the last chunk.
+    connection_.buffer().add(after_chunk ? CRLF_LAST_CHUNK : LAST_CHUNK);
   }
 
-  connection_.flushOutput();
-  connection_.onEncodeComplete();
+  connection_.flushOutput(held_output_);
+  connection_.onEncodeComplete(*this);
 }
 
-void ConnectionImpl::flushOutput() {
+void ConnectionImpl::flushOutput(Buffer::Instance* held_output) {
   if (reserved_current_) {
     reserved_iovec_.len_ = reserved_current_ - static_cast<char*>(reserved_iovec_.mem_);
     output_buffer_.commit(&reserved_iovec_, 1);
     reserved_current_ = nullptr;
   }
 
-  connection().write(output_buffer_);
+  if (held_output) {
+    held_output->move(output_buffer_);
+  } else {
+    connection().write(output_buffer_);
+  }
   ASSERT(0UL == output_buffer_.length());
 }
 
@@ -277,6 +302,7 @@ void ConnectionImpl::completeLastHeader() {
     toLowerTable().toLowerCase(current_header_field_.buffer(), current_header_field_.size());
     current_header_map_->addViaMove(std::move(current_header_field_),
                                     std::move(current_header_value_));
+    checkHeaderLimits();
   }
 
   header_parsing_state_ = HeaderParsingState::Field;
@@ -284,6 +310,16 @@ void ConnectionImpl::completeLastHeader() {
   ASSERT(current_header_value_.empty());
 }
 
+void ConnectionImpl::checkHeaderLimits() {
+  const uint64_t size = current_header_map_->addedByteSize() + current_header_field_.size() +
+                        current_header_value_.size();
+  if (size > max_headers_bytes_ || current_header_map_->addedCount() > max_headers_count_) {
+    error_code_ = Http::Code::RequestHeaderFieldsTooLarge;
+    sendProtocolError();
+    throw CodecProtocolException("http/1.1 protocol error: headers over the limits");
+  }
+}
+
 void ConnectionImpl::dispatch(Buffer::Instance& data) {
   ENVOY_CONN_LOG(trace, "parsing {} bytes", connection_, data.length());
 
@@ -328,6 +364,7 @@ void ConnectionImpl::onHeaderField(const char* data, size_t length) {
   }
 
   current_header_field_.append(data, length);
+  checkHeaderLimits();
 }
 
 void ConnectionImpl::onHeaderValue(const char* data, size_t length) {
@@ -338,6 +375,7 @@ void ConnectionImpl::onHeaderValue(const char* data, size_t length) {
 
   header_parsing_state_ = HeaderParsingState::Value;
   current_header_value_.append(data, length);
+  checkHeaderLimits();
 }
 
 int ConnectionImpl::onHeadersCompleteBase() {
@@ -371,15 +409,46 @@ void ConnectionImpl::onResetStreamBase(StreamResetReason reason) {
 ServerConnectionImpl::ServerConnectionImpl(Network::Connection& connection,
                                            ServerConnectionCallbacks& callbacks,
                                            Http1Settings settings)
-    : ConnectionImpl(connection, HTTP_REQUEST), callbacks_(callbacks), codec_settings_(settings) {}
+    : ConnectionImpl(connection, HTTP_REQUEST), callbacks_(callbacks), codec_settings_(settings) {
+  max_headers_bytes_ = static_cast<uint64_t>(settings.max_request_headers_kb_) * 1024;
+  max_headers_count_ = settings.max_request_headers_count_;
+}
+
+void ServerConnectionImpl::onEncodeComplete(StreamEncoderImpl& encoder) {
+  auto request = std::find_if(active_requests_.begin(), active_requests_.end(),
+                              [&encoder](const ActiveRequestPtr& active) -> bool {
+                                return &active->response_encoder_ == &encoder;
+                              });
+  ASSERT(request != active_requests_.end());
+  // No more watermark callbacks once the response is complete. The stream may be gone before a
+  // held response is written.
+  (*request)->response_encoder_.local_end_stream_ = true;
+  if (request != active_requests_.begin()) {
+    // The response stays held until the responses ahead of it are complete.
+    return;
+  }
 
-void ServerConnectionImpl::onEncodeComplete() {
-  ASSERT(active_request_);
-  if (active_request_->remote_complete_) {
-    // Only do this if remote is complete. If we are replying before the request is complete the
-    // only logical thing to do is for higher level code to reset() / close the connection so we
-    // leave the request around so that it can fire reset callbacks.
-    active_request_.reset();
+  // Only remove requests whose remote is complete. If we are replying before the request is
+  // complete the only logical thing to do is for higher level code to reset() / close the
+  // connection so we leave the request around so that it can fire reset callbacks.
+  while (!active_requests_.empty() && active_requests_.front()->remote_complete_ &&
+         active_requests_.front()->response_encoder_.local_end_stream_) {
+    active_requests_.pop_front();
+    if (!active_requests_.empty()) {
+      ActiveRequest& next = *active_requests_.front();
+      next.response_encoder_.holdOutput(nullptr);
+      if (next.held_output_.length() > 0) {
+        connection_.write(next.held_output_);
+      }
+    }
+  }
+}
+
+void ServerConnectionImpl::writeInOrder(ActiveRequest& request, Buffer::Instance& data) {
+  if (&request == active_requests_.front().get()) {
+    connection_.write(data);
+  } else {
+    request.held_output_.move(data);
   }
 }
 
@@ -389,28 +458,28 @@ void ServerConnectionImpl::handlePath(HeaderMapImpl& headers, unsigned int metho
   bool is_connect = (method == HTTP_CONNECT);
 
   // The url is relative or a wildcard when the method is OPTIONS. Nothing to do here.
-  if (active_request_->request_url_.c_str()[0] == '/' ||
-      ((method == HTTP_OPTIONS) && active_request_->request_url_.c_str()[0] == '*')) {
-    headers.addViaMove(std::move(path), std::move(active_request_->request_url_));
+  if (decoding_request_->request_url_.c_str()[0] == '/' ||
+      ((method == HTTP_OPTIONS) && decoding_request_->request_url_.c_str()[0] == '*')) {
+    headers.addViaMove(std::move(path), std::move(decoding_request_->request_url_));
     return;
   }
 
   // If absolute_urls and/or connect are not going be handled, copy the url and return.
   // This forces the behavior to be backwards compatible with the old codec behavior.
   if (!codec_settings_.allow_absolute_url_) {
-    headers.addViaMove(std::move(path), std::move(active_request_->request_url_));
+    headers.addViaMove(std::move(path), std::move(decoding_request_->request_url_));
     return;
   }
 
   if (is_connect) {
-    headers.addViaMove(std::move(path), std::move(active_request_->request_url_));
+    headers.addViaMove(std::move(path), std::move(decoding_request_->request_url_));
     return;
   }
 
   struct http_parser_url u;
   http_parser_url_init(&u);
-  int result = http_parser_parse_url(active_request_->request_url_.buffer(),
-                                     active_request_->request_url_.size(), is_connect, &u);
+  int result = http_parser_parse_url(decoding_request_->request_url_.buffer(),
+                                     decoding_request_->request_url_.size(), is_connect, &u);
 
   if (result != 0) {
     sendProtocolError();
@@ -434,7 +503,7 @@ void ServerConnectionImpl::handlePath(HeaderMapImpl& headers, unsigned int metho
       }
 
       // Insert the host header, this will later be converted to :authority
-      std::string new_host(active_request_->request_url_.c_str() + u.field_data[UF_HOST].off,
+      std::string new_host(decoding_request_->request_url_.c_str() + u.field_data[UF_HOST].off,
                            authority_len);
 
       headers.insertHost().value(new_host);
@@ -443,8 +512,8 @@ void ServerConnectionImpl::handlePath(HeaderMapImpl& headers, unsigned int metho
       // must start with /
       if ((u.field_set & (1 << UF_PATH)) == (1 << UF_PATH) && u.field_data[UF_PATH].len > 0) {
         HeaderString new_path;
-        new_path.setCopy(active_request_->request_url_.c_str() + u.field_data[UF_PATH].off,
-                         active_request_->request_url_.size() - u.field_data[UF_PATH].off);
+        new_path.setCopy(decoding_request_->request_url_.c_str() + u.field_data[UF_PATH].off,
+                         decoding_request_->request_url_.size() - u.field_data[UF_PATH].off);
         headers.addViaMove(std::move(path), std::move(new_path));
       } else {
         HeaderString new_path;
@@ -452,7 +521,7 @@ void ServerConnectionImpl::handlePath(HeaderMapImpl& headers, unsigned int metho
         headers.addViaMove(std::move(path), std::move(new_path));
       }
 
-      active_request_->request_url_.clear();
+      decoding_request_->request_url_.clear();
       return;
     }
     sendProtocolError();
@@ -464,23 +533,25 @@ int ServerConnectionImpl::onHeadersComplete(HeaderMapImplPtr&& headers) {
   // Handle the case where response happens prior to request complete. It's up to upper layer code
   // to disconnect the connection but we shouldn't fire any more events since it doesn't make
   // sense.
-  if (active_request_) {
+  if (decoding_request_) {
     const char* method_string = http_method_str(static_cast<http_method>(parser_.method));
 
     // Currently, CONNECT is not supported, however; http_parser_parse_url needs to know about
     // CONNECT
     handlePath(*headers, parser_.method);
-    ASSERT(active_request_->request_url_.empty());
+    ASSERT(decoding_request_->request_url_.empty());
 
     headers->insertMethod().value(method_string, strlen(method_string));
 
     // Deal with expect: 100-continue here since higher layers are never going to do anything other
     // than say to continue so that we can respond before request complete if necessary.
-    if (headers->Expect() &&
-        0 == StringUtil::caseInsensitiveCompare(headers->Expect()->value().c_str(),
-                                                Headers::get().ExpectValues._100Continue.c_str())) {
+    const HeaderEntry* expect = headers->Expect();
+    const std::string& continue_value = Headers::get().ExpectValues._100Continue;
+    if (expect && expect->value().size() == continue_value.size() &&
+        toLowerTable().equalsIgnoreCase(expect->value().c_str(), continue_value.data(),
+                                        continue_value.size())) {
       Buffer::OwnedImpl continue_response("HTTP/1.1 100 Continue\r\n\r\n");
-      connection_.write(continue_response);
+      writeInOrder(*decoding_request_, continue_response);
       headers->removeExpect();
     }
 
@@ -492,7 +563,7 @@ int ServerConnectionImpl::onHeadersComplete(HeaderMapImplPtr&& headers) {
     // encoding because end stream with zero body length has not yet been indicated.
     if (parser_.flags & F_CHUNKED ||
         (parser_.content_length > 0 && parser_.content_length != ULLONG_MAX)) {
-      active_request_->request_decoder_->decodeHeaders(std::move(headers), false);
+      decoding_request_->request_decoder_->decodeHeaders(std::move(headers), false);
 
       // If the connection has been closed (or is closing) after decoding headers, pause the parser
       // so we return control to the caller.
@@ -510,52 +581,71 @@ int ServerConnectionImpl::onHeadersComplete(HeaderMapImplPtr&& headers) {
 
 void ServerConnectionImpl::onMessageBegin() {
   if (!resetStreamCalled()) {
-    ASSERT(!active_request_);
-    active_request_.reset(new ActiveRequest(*this));
-    active_request_->request_decoder_ = &callbacks_.newStream(active_request_->response_encoder_);
+    ASSERT(!decoding_request_);
+    ActiveRequestPtr request(new ActiveRequest(*this));
+    if (!active_requests_.empty()) {
+      // Held output counts against the buffer limit like connection output does.
+      request->held_output_.setWatermarks(bufferLimit());
+      request->response_encoder_.holdOutput(&request->held_output_);
+    }
+    decoding_request_ = request.get();
+    active_requests_.emplace_back(std::move(request));
+    decoding_request_->request_decoder_ =
+        &callbacks_.newStream(decoding_request_->response_encoder_);
   }
 }
 
 void ServerConnectionImpl::onUrl(const char* data, size_t length) {
-  if (active_request_) {
-    active_request_->request_url_.append(data, length);
+  if (decoding_request_) {
+    decoding_request_->request_url_.append(data, length);
   }
 }
 
 void ServerConnectionImpl::onBody(const char* data, size_t length) {
   ASSERT(!deferred_end_stream_headers_);
-  if (active_request_) {
+  if (decoding_request_) {
     ENVOY_CONN_LOG(trace, "body size={}", connection_, length);
     Buffer::OwnedImpl buffer(data, length);
-    active_request_->request_decoder_->decodeData(buffer, false);
+    decoding_request_->request_decoder_->decodeData(buffer, false);
   }
 }
 
 void ServerConnectionImpl::onMessageComplete() {
-  if (active_request_) {
+  if (decoding_request_) {
     ENVOY_CONN_LOG(trace, "message complete", connection_);
     Buffer::OwnedImpl buffer;
-    active_request_->remote_complete_ = true;
+    ActiveRequest& request = *decoding_request_;
+    decoding_request_ = nullptr;
+    request.remote_complete_ = true;
 
     if (deferred_end_stream_headers_) {
-      active_request_->request_decoder_->decodeHeaders(std::move(deferred_end_stream_headers_),
-                                                       true);
-      deferred_end_stream_headers_.reset();
+      HeaderMapPtr headers = std::move(deferred_end_stream_headers_);
+      request.request_decoder_->decodeHeaders(std::move(headers), true);
     } else {
-      active_request_->request_decoder_->decodeData(buffer, true);
+      request.request_decoder_->decodeData(buffer, true);
     }
   }
 
-  // Always pause the parser so that the calling code can process 1 request at a time and apply
-  // back pressure. However this means that the calling code needs to detect if there is more data
-  // in the buffer and dispatch it again.
-  http_parser_pause(&parser_, 1);
+  // Pause the parser once the pipeline is full so that the calling code can process a bounded
+  // number of requests at a time and apply back pressure. However this means that the calling code
+  // needs to detect if there is more data in the buffer and dispatch it again.
+  if (active_requests_.size() >= codec_settings_.max_pipeline_depth_) {
+    http_parser_pause(&parser_, 1);
+  }
 }
 
 void ServerConnectionImpl::onResetStream(StreamResetReason reason) {
-  ASSERT(active_request_);
-  active_request_->response_encoder_.runResetCallbacks(reason);
-  active_request_.reset();
+  ASSERT(!active_requests_.empty());
+  // Resetting any stream resets the connection, so every pipelined request is reset. Requests
+  // whose response is only held are already complete and have no stream left to notify.
+  std::list<ActiveRequestPtr> requests = std::move(active_requests_);
+  active_requests_.clear();
+  decoding_request_ = nullptr;
+  for (ActiveRequestPtr& request : requests) {
+    if (!request->remote_complete_ || !request->response_encoder_.local_end_stream_) {
+      request->response_encoder_.runResetCallbacks(reason);
+    }
+  }
 }
 
 void ServerConnectionImpl::sendProtocolError() {
@@ -563,7 +653,7 @@ void ServerConnectionImpl::sendProtocolError() {
   // layers can only operate on streams, so there is no coherent way to allow them to send an error
   // "out of band." On one hand this is kind of a hack but on the other hand it normalizes HTTP/1.1
   // to look more like HTTP/2 to higher layers.
-  if (!active_request_ || !active_request_->response_encoder_.startedResponse()) {
+  if (active_requests_.empty() || !active_requests_.front()->response_encoder_.startedResponse()) {
     Buffer::OwnedImpl bad_request_response(
         fmt::format("HTTP/1.1 {} {}\r\ncontent-length: 0\r\nconnection: close\r\n\r\n",
                     std::to_string(enumToInt(error_code_)), CodeUtility::toString(error_code_)));
@@ -573,13 +663,14 @@ void ServerConnectionImpl::sendProtocolError() {
 }
 
 void ServerConnectionImpl::onAboveHighWatermark() {
-  if (active_request_) {
-    active_request_->response_encoder_.runHighWatermarkCallbacks();
+  // All pipelined requests share the connection.
+  for (ActiveRequestPtr& request : active_requests_) {
+    request->response_encoder_.runHighWatermarkCallbacks();
   }
 }
 void ServerConnectionImpl::onBelowLowWatermark() {
-  if (active_request_) {
-    active_request_->response_encoder_.runLowWatermarkCallbacks();
+  for (ActiveRequestPtr& request : active_requests_) {
+    request->response_encoder_.runLowWatermarkCallbacks();
   }
 }
 
@@ -611,7 +702,7 @@ StreamEncoder& ClientConnectionImpl::newStream(StreamDecoder& response_decoder)
   return *request_encoder_;
 }
 
-void ClientConnectionImpl::onEncodeComplete() {
+void ClientConnectionImpl::onEncodeComplete(StreamEncoderImpl&) {
   // Transfer head request state into the pending response before we reuse the encoder.
   pending_responses_.back().head_request_ = request_encoder_->headRequest();
 }
@@ -2,6 +2,7 @@
 
 #include <array>
 #include <cstdint>
+#include <limits>
 #include <list>
 #include <memory>
 #include <string>
@@ -50,8 +51,11 @@ protected:
 
   static const std::string CRLF;
   static const std::string LAST_CHUNK;
+  static const std::string CRLF_LAST_CHUNK;
 
   ConnectionImpl& connection_;
+  // If set, encoded output is moved here instead of being written to the connection.
+  Buffer::Instance* held_output_{};
 
 private:
   /**
@@ -63,10 +67,18 @@ private:
    */
   void encodeHeader(const char* key, uint32_t key_size, const char* value, uint32_t value_size);
 
+  /**
+   * Called to add the header of a chunk, i.e. its length in hex and CRLF.
+   * @param length supplies the length of the body of the chunk.
+   */
+  void addChunkHeader(uint64_t length);
+
   /**
    * Called to finalize a stream encode.
+   * @param after_chunk supplies whether the body of a chunk was just added, whose CRLF is then
+   *        added with the last chunk.
    */
-  void endEncode();
+  void endEncode(bool after_chunk);
 
   bool chunk_encoding_{true};
 };
@@ -80,6 +92,14 @@ public:
 
   bool startedResponse() { return started_response_; }
 
+  /**
+   * Hold the encoded response instead of writing it to the connection. Used for a pipelined
+   * response that must wait for the responses ahead of it.
+   * @param held_output supplies the buffer to move the output to, or nullptr to write the output
+   *        to the connection again.
+   */
+  void holdOutput(Buffer::Instance* held_output) { held_output_ = held_output; }
+
   // Http::StreamEncoder
   void encodeHeaders(const HeaderMap& headers, bool end_stream) override;
 
@@ -114,9 +134,10 @@ public:
   Network::Connection& connection() { return connection_; }
 
   /**
-   * Called when the active encoder has completed encoding the outbound half of the stream.
+   * Called when an encoder has completed encoding the outbound half of the stream.
+   * @param encoder supplies the encoder.
    */
-  virtual void onEncodeComplete() PURE;
+  virtual void onEncodeComplete(StreamEncoderImpl& encoder) PURE;
 
   /**
    * Called when resetStream() has been called on an active stream. In HTTP/1.1 the only
@@ -127,8 +148,10 @@ public:
 
   /**
    * Flush all pending output from encoding.
+   * @param held_output supplies a buffer to move the output to instead of writing it to the
+   *        connection, or nullptr.
    */
-  void flushOutput();
+  void flushOutput(Buffer::Instance* held_output);
 
   void addCharToBuffer(char c);
   void addIntToBuffer(uint64_t i);
@@ -153,11 +176,15 @@ protected:
   ConnectionImpl(Network::Connection& connection, http_parser_type type);
 
   bool resetStreamCalled() { return reset_stream_called_; }
+  static const ToLowerTable& toLowerTable();
 
   Network::Connection& connection_;
   http_parser parser_;
   HeaderMapPtr deferred_end_stream_headers_;
   Http::Code error_code_{Http::Code::BadRequest};
+  // Limits on the headers of each message that is decoded, checked as they are parsed.
+  uint64_t max_headers_bytes_{std::numeric_limits<uint64_t>::max()};
+  uint32_t max_headers_count_{std::numeric_limits<uint32_t>::max()};
 
 private:
   enum class HeaderParsingState { Field, Value, Done };
@@ -167,6 +194,12 @@ private:
    */
   void completeLastHeader();
 
+  /**
+   * Check the headers decoded so far, including the one in progress, against the limits.
+   * @throws CodecProtocolException if they are over one of them.
+   */
+  void checkHeaderLimits();
+
   /**
    * Dispatch a memory span.
    * @param slice supplies the start address.
@@ -245,7 +278,6 @@ private:
   virtual void onBelowLowWatermark() PURE;
 
   static http_parser_settings settings_;
-  static const ToLowerTable& toLowerTable();
 
   HeaderMapImplPtr current_header_map_;
   HeaderParsingState header_parsing_state_{HeaderParsingState::Field};
@@ -266,19 +298,30 @@ public:
   ServerConnectionImpl(Network::Connection& connection, ServerConnectionCallbacks& callbacks,
                        Http1Settings settings);
 
+  // Http::ServerConnection
+  uint32_t maxPipelineDepth() const override { return codec_settings_.max_pipeline_depth_; }
+
 private:
   /**
    * An active HTTP/1.1 request.
    */
   struct ActiveRequest {
-    ActiveRequest(ConnectionImpl& connection) : response_encoder_(connection) {}
+    ActiveRequest(ConnectionImpl& connection)
+        : response_encoder_(connection),
+          held_output_([this]() -> void { response_encoder_.runLowWatermarkCallbacks(); },
+                       [this]() -> void { response_encoder_.runHighWatermarkCallbacks(); }) {}
 
     HeaderString request_url_;
     StreamDecoder* request_decoder_{};
     ResponseStreamEncoderImpl response_encoder_;
+    // Output of a pipelined response that is encoded while the responses ahead of it are not
+    // complete.
+    Buffer::WatermarkBuffer held_output_;
     bool remote_complete_{};
   };
 
+  typedef std::unique_ptr<ActiveRequest> ActiveRequestPtr;
+
   /**
    * Manipulate the request's first line, parsing the url and converting to a relative path if
    * neccessary. Compute Host / :authority headers based on 7230#5.7 and 7230#6
@@ -289,8 +332,13 @@ private:
    */
   void handlePath(HeaderMapImpl& headers, unsigned int method);
 
+  /**
+   * Write output that is not part of a response body, such as 100-continue, in response order.
+   */
+  void writeInOrder(ActiveRequest& request, Buffer::Instance& data);
+
   // ConnectionImpl
-  void onEncodeComplete() override;
+  void onEncodeComplete(StreamEncoderImpl& encoder) override;
   void onMessageBegin() override;
   void onUrl(const char* data, size_t length) override;
   int onHeadersComplete(HeaderMapImplPtr&& headers) override;
@@ -302,7 +350,11 @@ private:
   void onBelowLowWatermark() override;
 
   ServerConnectionCallbacks& callbacks_;
-  std::unique_ptr<ActiveRequest> active_request_;
+  // Requests in the order they were received. Only the response of the first request is written
+  // to the connection; the others are held until they reach the front.
+  std::list<ActiveRequestPtr> active_requests_;
+  // The request being decoded, if any.
+  ActiveRequest* decoding_request_{};
   Http1Settings codec_settings_;
 };
 
@@ -327,7 +379,7 @@ private:
   bool cannotHaveBody();
 
   // ConnectionImpl
-  void onEncodeComplete() override;
+  void onEncodeComplete(StreamEncoderImpl& encoder) override;
   void onMessageBegin() override {}
   void onUrl(const char*, size_t) override { NOT_IMPLEMENTED; }
   int onHeadersComplete(HeaderMapImplPtr&& headers) override;
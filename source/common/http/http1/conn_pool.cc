@@ -1,5 +1,7 @@
 #include "common/http/http1/conn_pool.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <list>
 
@@ -42,6 +44,10 @@ void ConnPoolImpl::attachRequestToClient(ActiveClient& client, StreamDecoder& re
                                          ConnectionPool::Callbacks& callbacks) {
   ASSERT(!client.stream_wrapper_);
   client.stream_wrapper_.reset(new StreamWrapper(response_decoder, client));
+  if (client.used_) {
+    host_->cluster().stats().upstream_rq_reused_.inc();
+  }
+  client.used_ = true;
   callbacks.onPoolReady(*client.stream_wrapper_, client.real_host_description_);
 }
 
@@ -66,9 +72,16 @@ void ConnPoolImpl::createNewConnection() {
 ConnectionPool::Cancellable* ConnPoolImpl::newStream(StreamDecoder& response_decoder,
                                                      ConnectionPool::Callbacks& callbacks) {
   if (!ready_clients_.empty()) {
-    ready_clients_.front()->moveBetweenLists(ready_clients_, busy_clients_);
+    // Ready clients are pushed onto the front, so the back has been idle the longest.
+    ActiveClient& client =
+        host_->cluster().connectionReuseFifo() ? *ready_clients_.back() : *ready_clients_.front();
+    if (client.idle_timer_) {
+      client.idle_timer_->disableTimer();
+    }
+    client.moveBetweenLists(ready_clients_, busy_clients_);
     ENVOY_CONN_LOG(debug, "using existing connection", *busy_clients_.front()->codec_client_);
     attachRequestToClient(*busy_clients_.front(), response_decoder, callbacks);
+    prefetchConnections();
     return nullptr;
   }
 
@@ -87,6 +100,7 @@ ConnectionPool::Cancellable* ConnPoolImpl::newStream(StreamDecoder& response_dec
     ENVOY_LOG(debug, "queueing request due to no available connections");
     PendingRequestPtr pending_request(new PendingRequest(*this, response_decoder, callbacks));
     pending_request->moveIntoList(std::move(pending_request), pending_requests_);
+    prefetchConnections();
     return pending_requests_.front().get();
   } else {
     ENVOY_LOG(debug, "max pending requests overflow");
@@ -121,6 +135,9 @@ void ConnPoolImpl::onConnectionEvent(ActiveClient& client, Network::ConnectionEv
     } else if (!client.connect_timer_) {
       // The connect timer is destroyed on connect. The lack of a connect timer means that this
       // client is idle and in the ready pool.
+      if (client.idle_timer_) {
+        client.idle_timer_->disableTimer();
+      }
       removed = client.removeFromList(ready_clients_);
       check_for_drained = false;
     } else {
@@ -201,12 +218,49 @@ void ConnPoolImpl::onResponseComplete(ActiveClient& client) {
   }
 }
 
+void ConnPoolImpl::prefetchConnections() {
+  // Prefetching is driven by new requests, so connections that idle out upstream are only replaced
+  // when the next request arrives. Nothing is prefetched once the pool drains.
+  const uint32_t min_idle_connections = host_->cluster().minIdleConnections();
+  const uint32_t prefetch_percent = host_->cluster().connectionPrefetchPercent();
+  if ((min_idle_connections == 0 && prefetch_percent <= 100) || !drained_callbacks_.empty()) {
+    return;
+  }
+
+  uint64_t requests = pending_requests_.size();
+  for (const ActiveClientPtr& client : busy_clients_) {
+    if (client->stream_wrapper_) {
+      requests++;
+    }
+  }
+
+  const uint64_t wanted_connections = std::max<uint64_t>(
+      requests + min_idle_connections, (requests * prefetch_percent + 99) / 100);
+  uint64_t connections = ready_clients_.size() + busy_clients_.size();
+  while (connections < wanted_connections &&
+         host_->cluster().resourceManager(priority_).connections().canCreate()) {
+    // Until they connect, prefetched connections sit in the busy list like the connections that
+    // are created for pending requests. They move to the ready list if nothing is pending then.
+    createNewConnection();
+    host_->cluster().stats().upstream_cx_prefetch_.inc();
+    connections++;
+  }
+}
+
 void ConnPoolImpl::processIdleClient(ActiveClient& client) {
   client.stream_wrapper_.reset();
   if (pending_requests_.empty()) {
     // There is nothing to service so just move the connection into the ready list.
     ENVOY_CONN_LOG(debug, "moving to ready", *client.codec_client_);
     client.moveBetweenLists(busy_clients_, ready_clients_);
+    const std::chrono::milliseconds idle_timeout = host_->cluster().idleConnectionTimeout();
+    if (idle_timeout.count() > 0) {
+      if (!client.idle_timer_) {
+        client.idle_timer_ =
+            dispatcher_.createTimer([&client]() -> void { client.onIdleTimeout(); });
+      }
+      client.idle_timer_->enableTimer(idle_timeout);
+    }
   } else {
     // There is work to do so bind a request to the client and move it to the busy list. Pending
     // requests are pushed onto the front, so pull from the back.
@@ -310,6 +364,13 @@ void ConnPoolImpl::ActiveClient::onConnectTimeout() {
   codec_client_->close();
 }
 
+void ConnPoolImpl::ActiveClient::onIdleTimeout() {
+  // Closing an idle client removes it from the ready list like any other close of a ready client.
+  ENVOY_CONN_LOG(debug, "idle timeout", *codec_client_);
+  parent_.host_->cluster().stats().upstream_cx_idle_timeout_.inc();
+  codec_client_->close();
+}
+
 CodecClientPtr ConnPoolImplProd::createCodecClient(Upstream::Host::CreateConnectionData& data) {
   CodecClientPtr codec{new CodecClientProd(CodecClient::Type::HTTP1, std::move(data.connection_),
                                            data.host_description_)};
@@ -20,7 +20,11 @@ namespace Http {
 namespace Http1 {
 
 /**
- * A connection pool implementation for HTTP/1.1 connections.
+ * A connection pool implementation for HTTP/1.1 connections. When the cluster asks for idle or
+ * prefetched connections, new requests also open connections ahead of the requests that will use
+ * them, see prefetchConnections(). Ready connections are reused most recently used first unless the
+ * cluster asks for FIFO reuse, and are closed once they have been idle for the idle connection
+ * timeout of the cluster.
  * NOTE: The connection pool does NOT do DNS resolution. It assumes it is being given a numeric IP
  *       address. Higher layer code should handle resolving DNS on error and creating a new pool
  *       bound to a different IP address.
@@ -75,6 +79,7 @@ protected:
     ~ActiveClient();
 
     void onConnectTimeout();
+    void onIdleTimeout();
 
     // Network::ConnectionCallbacks
     void onEvent(Network::ConnectionEvent event) override {
@@ -88,8 +93,10 @@ protected:
     Upstream::HostDescriptionConstSharedPtr real_host_description_;
     StreamWrapperPtr stream_wrapper_;
     Event::TimerPtr connect_timer_;
+    Event::TimerPtr idle_timer_;
     Stats::TimespanPtr conn_length_;
     uint64_t remaining_requests_;
+    bool used_{};
   };
 
   typedef std::unique_ptr<ActiveClient> ActiveClientPtr;
@@ -118,6 +125,7 @@ protected:
   void onDownstreamReset(ActiveClient& client);
   void onPendingRequestCancel(PendingRequest& request);
   void onResponseComplete(ActiveClient& client);
+  void prefetchConnections();
   void processIdleClient(ActiveClient& client);
 
   Stats::TimespanPtr conn_connect_ms_;
@@ -38,7 +38,6 @@ bool Utility::reconstituteCrumbledCookies(const HeaderString& key, const HeaderS
 }
 
 ConnectionImpl::Http2Callbacks ConnectionImpl::http2_callbacks_;
-ConnectionImpl::Http2Options ConnectionImpl::http2_options_;
 const std::unique_ptr<const Http::HeaderMap> ConnectionImpl::CONTINUE_HEADER{
     new Http::HeaderMapImpl{
         {Http::Headers::get().Status, std::to_string(enumToInt(Code::Continue))}}};
@@ -218,16 +217,44 @@ int ConnectionImpl::StreamImpl::onDataSourceSend(const uint8_t* framehd, size_t
   // https://nghttp2.org/documentation/types.html#c.nghttp2_send_data_callback
   static const uint64_t FRAME_HEADER_SIZE = 9;
 
-  Buffer::OwnedImpl output(framehd, FRAME_HEADER_SIZE);
-  output.move(pending_send_data_, length);
-  parent_.connection_.write(output);
+  // Once a send has serialized a quantum of output, the rest of the DATA frames wait in nghttp2
+  // where they are scheduled across the streams by weight, instead of queueing in the order they
+  // were serialized behind the output already in the connection. nghttp2 retries the frame on the
+  // next nghttp2_session_send().
+  if (parent_.output_buffer_.length() >= MAX_OUTPUT_PER_SEND) {
+    parent_.send_blocked_ = true;
+    return NGHTTP2_ERR_WOULDBLOCK;
+  }
+
+  // The payload slices are moved from the pending data to the connection output, so large bodies
+  // are never copied.
+  parent_.output_buffer_.add(framehd, FRAME_HEADER_SIZE);
+  parent_.output_buffer_.move(pending_send_data_, length);
+
+  if (boost_bytes_left_ > 0) {
+    if (length >= boost_bytes_left_) {
+      boost_bytes_left_ = 0;
+      parent_.unboosted_streams_.emplace_back(stream_id_, unboosted_weight_);
+    } else {
+      boost_bytes_left_ -= length;
+    }
+  }
   return 0;
 }
 
 void ConnectionImpl::ClientStreamImpl::submitHeaders(const std::vector<nghttp2_nv>& final_headers,
                                                      nghttp2_data_provider* provider) {
   ASSERT(stream_id_ == -1);
-  stream_id_ = nghttp2_submit_request(parent_.session_, nullptr, &final_headers.data()[0],
+  nghttp2_priority_spec boosted;
+  nghttp2_priority_spec* priority = nullptr;
+  if (provider != nullptr && parent_.small_stream_boost_bytes_ > 0) {
+    // The weight is sent with the request, so the upstream host schedules the stream's response
+    // the same way until it changes its own view of the stream.
+    nghttp2_priority_spec_init(&boosted, 0, NGHTTP2_MAX_WEIGHT, 0);
+    priority = &boosted;
+    boost_bytes_left_ = parent_.small_stream_boost_bytes_;
+  }
+  stream_id_ = nghttp2_submit_request(parent_.session_, priority, &final_headers.data()[0],
                                       final_headers.size(), provider, base());
   ASSERT(stream_id_ > 0);
 }
@@ -235,6 +262,16 @@ void ConnectionImpl::ClientStreamImpl::submitHeaders(const std::vector<nghttp2_n
 void ConnectionImpl::ServerStreamImpl::submitHeaders(const std::vector<nghttp2_nv>& final_headers,
                                                      nghttp2_data_provider* provider) {
   ASSERT(stream_id_ != -1);
+  if (provider != nullptr && parent_.small_stream_boost_bytes_ > 0) {
+    // Keep the weight the client gave the stream, so that the boost only reorders the streams
+    // until they have sent their first bytes.
+    nghttp2_stream* stream = nghttp2_session_find_stream(parent_.session_, stream_id_);
+    if (stream != nullptr) {
+      unboosted_weight_ = nghttp2_stream_get_weight(stream);
+      boost_bytes_left_ = parent_.small_stream_boost_bytes_;
+      parent_.setStreamWeight(stream_id_, NGHTTP2_MAX_WEIGHT);
+    }
+  }
   int rc = nghttp2_submit_response(parent_.session_, stream_id_, &final_headers.data()[0],
                                    final_headers.size(), provider);
   ASSERT(rc == 0);
@@ -315,6 +352,16 @@ ConnectionImpl::StreamImpl* ConnectionImpl::getStream(int32_t stream_id) {
   return static_cast<StreamImpl*>(nghttp2_session_get_stream_user_data(session_, stream_id));
 }
 
+int ConnectionImpl::onBeginFrame(const nghttp2_frame_hd* hd) {
+  // Counted per frame since a header block that is split into CONTINUATION frames is only reported
+  // once when it is complete.
+  if (hd->type == NGHTTP2_HEADERS || hd->type == NGHTTP2_CONTINUATION) {
+    stats_.header_bytes_received_encoded_.add(hd->length);
+  }
+
+  return 0;
+}
+
 int ConnectionImpl::onData(int32_t stream_id, const uint8_t* data, size_t len) {
   StreamImpl* stream = getStream(stream_id);
   // If this results in buffering too much data, the watermark buffer will call
@@ -477,7 +524,18 @@ int ConnectionImpl::onFrameSend(const nghttp2_frame* frame) {
     break;
   }
 
-  case NGHTTP2_HEADERS:
+  case NGHTTP2_HEADERS: {
+    // The frame length covers the whole header block, including any CONTINUATION frames nghttp2
+    // split it into.
+    stats_.header_bytes_sent_encoded_.add(frame->hd.length);
+    uint64_t plain_size = 0;
+    for (size_t i = 0; i < frame->headers.nvlen; i++) {
+      plain_size += frame->headers.nva[i].namelen + frame->headers.nva[i].valuelen;
+    }
+    stats_.header_bytes_sent_plain_.add(plain_size);
+    FALLTHRU;
+  }
+
   case NGHTTP2_DATA: {
     StreamImpl* stream = getStream(frame->hd.stream_id);
     stream->local_end_stream_sent_ = frame->hd.flags & NGHTTP2_FLAG_END_STREAM;
@@ -503,8 +561,7 @@ int ConnectionImpl::onInvalidFrame(int error_code) {
 
 ssize_t ConnectionImpl::onSend(const uint8_t* data, size_t length) {
   ENVOY_CONN_LOG(trace, "send data: bytes={}", connection_, length);
-  Buffer::OwnedImpl buffer(data, length);
-  connection_.write(buffer);
+  output_buffer_.add(data, length);
   return length;
 }
 
@@ -534,6 +591,7 @@ int ConnectionImpl::onStreamClose(int32_t stream_id, uint32_t error_code) {
 
 int ConnectionImpl::saveHeader(const nghttp2_frame* frame, HeaderString&& name,
                                HeaderString&& value) {
+  stats_.header_bytes_received_plain_.add(name.size() + value.size());
   StreamImpl* stream = getStream(frame->hd.stream_id);
   if (!stream) {
     // We have seen 1 or 2 crashes where we get a headers callback but there is no associated
@@ -547,7 +605,9 @@ int ConnectionImpl::saveHeader(const nghttp2_frame* frame, HeaderString&& name,
   }
 
   stream->saveHeader(std::move(name), std::move(value));
-  if (stream->headers_->byteSize() > StreamImpl::MAX_HEADER_SIZE) {
+  // Crumbled cookies are only added to the headers once they are complete.
+  if (stream->headers_->addedByteSize() + stream->cookies_.size() > max_headers_bytes_ ||
+      stream->headers_->addedCount() > max_headers_count_) {
     // This will cause the library to reset/close the stream.
     stats_.header_overflow_.inc();
     return NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE;
@@ -561,7 +621,29 @@ void ConnectionImpl::sendPendingFrames() {
     return;
   }
 
-  int rc = nghttp2_session_send(session_);
+  // Output is serialized and written a quantum at a time while the connection takes it. Once it is
+  // above its high watermark the remaining DATA frames are held back until it drains, see
+  // onUnderlyingConnectionBelowWriteBufferLowWatermark().
+  int rc;
+  do {
+    send_blocked_ = false;
+    rc = nghttp2_session_send(session_);
+    for (const auto& stream : unboosted_streams_) {
+      setStreamWeight(stream.first, stream.second);
+    }
+    unboosted_streams_.clear();
+
+    if (output_buffer_.length() > 0) {
+      // Writing can synchronously call back into the codec, which may serialize more frames, so
+      // the output is moved out of output_buffer_ first. This is also done when sending failed so
+      // that a GOAWAY that caused the failure still goes out.
+      Buffer::OwnedImpl output;
+      output.move(output_buffer_);
+      connection_.write(output);
+    }
+  } while (rc == 0 && send_blocked_ && !connection_.aboveHighWatermark() &&
+           connection_.state() != Network::Connection::State::Closed);
+
   if (rc != 0) {
     ASSERT(rc == NGHTTP2_ERR_CALLBACK_FAILURE);
     throw CodecProtocolException(fmt::format("{}", nghttp2_strerror(rc)));
@@ -590,6 +672,22 @@ void ConnectionImpl::sendPendingFrames() {
   }
 }
 
+void ConnectionImpl::setStreamWeight(int32_t stream_id, int32_t weight) {
+  nghttp2_stream* stream = nghttp2_session_find_stream(session_, stream_id);
+  if (stream == nullptr) {
+    // The stream was closed in the meantime.
+    return;
+  }
+  // Only the weight changes, the stream keeps its place in the dependency tree.
+  nghttp2_stream* parent = nghttp2_stream_get_parent(stream);
+  const int32_t parent_id = parent != nullptr ? nghttp2_stream_get_stream_id(parent) : 0;
+  nghttp2_priority_spec priority;
+  nghttp2_priority_spec_init(&priority, parent_id, weight, 0);
+  int rc = nghttp2_session_change_stream_priority(session_, stream_id, &priority);
+  ASSERT(rc == 0);
+  UNREFERENCED_PARAMETER(rc);
+}
+
 void ConnectionImpl::sendSettings(const Http2Settings& http2_settings, bool disable_push) {
   ASSERT(http2_settings.hpack_table_size_ <= Http2Settings::MAX_HPACK_TABLE_SIZE);
   ASSERT(Http2Settings::MIN_MAX_CONCURRENT_STREAMS <= http2_settings.max_concurrent_streams_ &&
@@ -601,6 +699,8 @@ void ConnectionImpl::sendSettings(const Http2Settings& http2_settings, bool disa
              http2_settings.initial_connection_window_size_ &&
          http2_settings.initial_connection_window_size_ <=
              Http2Settings::MAX_INITIAL_CONNECTION_WINDOW_SIZE);
+  ASSERT(Http2Settings::MIN_MAX_FRAME_SIZE <= http2_settings.max_frame_size_ &&
+         http2_settings.max_frame_size_ <= Http2Settings::MAX_MAX_FRAME_SIZE);
 
   std::vector<nghttp2_settings_entry> iv;
 
@@ -623,6 +723,12 @@ void ConnectionImpl::sendSettings(const Http2Settings& http2_settings, bool disa
                    http2_settings.initial_stream_window_size_);
   }
 
+  if (http2_settings.max_frame_size_ != Http2Settings::DEFAULT_MAX_FRAME_SIZE) {
+    iv.push_back({NGHTTP2_SETTINGS_MAX_FRAME_SIZE, http2_settings.max_frame_size_});
+    ENVOY_CONN_LOG(debug, "setting max frame size to {}", connection_,
+                   http2_settings.max_frame_size_);
+  }
+
   if (disable_push) {
     // Universally disable receiving push promise frames as we don't currently support them. nghttp2
     // will fail the connection if the other side still sends them.
@@ -670,6 +776,11 @@ ConnectionImpl::Http2Callbacks::Http2Callbacks() {
         return static_cast<StreamImpl*>(source->ptr)->onDataSourceSend(framehd, length);
       });
 
+  nghttp2_session_callbacks_set_on_begin_frame_callback(
+      callbacks_, [](nghttp2_session*, const nghttp2_frame_hd* hd, void* user_data) -> int {
+        return static_cast<ConnectionImpl*>(user_data)->onBeginFrame(hd);
+      });
+
   nghttp2_session_callbacks_set_on_begin_headers_callback(
       callbacks_, [](nghttp2_session*, const nghttp2_frame* frame, void* user_data) -> int {
         return static_cast<ConnectionImpl*>(user_data)->onBeginHeaders(frame);
@@ -728,14 +839,17 @@ ConnectionImpl::Http2Callbacks::Http2Callbacks() {
 
 ConnectionImpl::Http2Callbacks::~Http2Callbacks() { nghttp2_session_callbacks_del(callbacks_); }
 
-ConnectionImpl::Http2Options::Http2Options() {
+ConnectionImpl::Http2Options::Http2Options(const Http2Settings& http2_settings) {
   nghttp2_option_new(&options_);
-  // Currently we do not do anything with stream priority. Setting the following option prevents
-  // nghttp2 from keeping around closed streams for use during stream priority dependency graph
-  // calculations. This saves a tremendous amount of memory in cases where there are a large number
-  // of kept alive HTTP/2 connections.
+  // Stream priority only schedules the DATA frames of the open streams. Setting the following
+  // option prevents nghttp2 from keeping around closed streams for use during stream priority
+  // dependency graph calculations. This saves a tremendous amount of memory in cases where there
+  // are a large number of kept alive HTTP/2 connections.
   nghttp2_option_set_no_closed_streams(options_, 1);
   nghttp2_option_set_no_auto_window_update(options_, 1);
+  // Our encoder uses the smaller of this and the table size the peer advertises, so that the HPACK
+  // table size configures the dynamic tables of both directions.
+  nghttp2_option_set_max_deflate_dynamic_table_size(options_, http2_settings.hpack_table_size_);
 }
 
 ConnectionImpl::Http2Options::~Http2Options() { nghttp2_option_del(options_); }
@@ -744,8 +858,9 @@ ClientConnectionImpl::ClientConnectionImpl(Network::Connection& connection,
                                            Http::ConnectionCallbacks& callbacks,
                                            Stats::Scope& stats, const Http2Settings& http2_settings)
     : ConnectionImpl(connection, stats, http2_settings), callbacks_(callbacks) {
+  Http2Options http2_options(http2_settings);
   nghttp2_session_client_new2(&session_, http2_callbacks_.callbacks(), base(),
-                              http2_options_.options());
+                              http2_options.options());
   sendSettings(http2_settings, true);
 }
 
@@ -788,8 +903,11 @@ ServerConnectionImpl::ServerConnectionImpl(Network::Connection& connection,
                                            Http::ServerConnectionCallbacks& callbacks,
                                            Stats::Scope& scope, const Http2Settings& http2_settings)
     : ConnectionImpl(connection, scope, http2_settings), callbacks_(callbacks) {
+  max_headers_bytes_ = static_cast<uint64_t>(http2_settings.max_request_headers_kb_) * 1024;
+  max_headers_count_ = http2_settings.max_request_headers_count_;
+  Http2Options http2_options(http2_settings);
   nghttp2_session_server_new2(&session_, http2_callbacks_.callbacks(), base(),
-                              http2_options_.options());
+                              http2_options.options());
   sendSettings(http2_settings, false);
 }
 
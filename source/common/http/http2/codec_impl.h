@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <limits>
 #include <list>
 #include <memory>
 #include <string>
@@ -41,7 +42,11 @@ const std::string CLIENT_MAGIC_PREFIX = "PRI * HTTP/2";
   COUNTER(tx_reset)                                                                                \
   COUNTER(header_overflow)                                                                         \
   COUNTER(trailers)                                                                                \
-  COUNTER(headers_cb_no_stream)
+  COUNTER(headers_cb_no_stream)                                                                    \
+  COUNTER(header_bytes_received_encoded)                                                           \
+  COUNTER(header_bytes_received_plain)                                                             \
+  COUNTER(header_bytes_sent_encoded)                                                               \
+  COUNTER(header_bytes_sent_plain)
 // clang-format on
 
 /**
@@ -73,8 +78,11 @@ public:
                  const Http2Settings& http2_settings)
       : stats_{ALL_HTTP2_CODEC_STATS(POOL_COUNTER_PREFIX(stats, "http2."))},
         connection_(connection),
-        per_stream_buffer_limit_(http2_settings.initial_stream_window_size_), dispatching_(false),
-        raised_goaway_(false), pending_deferred_reset_(false) {}
+        per_stream_buffer_limit_(http2_settings.initial_stream_window_size_),
+        max_headers_bytes_(StreamImpl::MAX_HEADER_SIZE),
+        max_headers_count_(std::numeric_limits<uint32_t>::max()),
+        small_stream_boost_bytes_(http2_settings.small_stream_boost_bytes_), send_blocked_(false),
+        dispatching_(false), raised_goaway_(false), pending_deferred_reset_(false) {}
 
   ~ConnectionImpl();
 
@@ -94,6 +102,10 @@ public:
     for (auto& stream : active_streams_) {
       stream->runLowWatermarkCallbacks();
     }
+    // Resume the DATA frames that were held back while the connection was backed up.
+    if (send_blocked_) {
+      sendPendingFrames();
+    }
   }
 
 protected:
@@ -112,11 +124,11 @@ protected:
   };
 
   /**
-   * Wrapper for static nghttp2 session options.
+   * Wrapper for nghttp2 session options.
    */
   class Http2Options {
   public:
-    Http2Options();
+    Http2Options(const Http2Settings& http2_settings);
     ~Http2Options();
 
     const nghttp2_option* options() { return options_; }
@@ -177,6 +189,8 @@ protected:
     // appear to transmit headers greater than approximtely 64K (NGHTTP2_MAX_HEADERSLEN) for reasons
     // I don't fully understand.
     static const uint64_t MAX_HEADER_SIZE = 63 * 1024;
+    // The output that one nghttp2_session_send() serializes before it holds back DATA frames.
+    static const uint64_t MAX_OUTPUT_PER_SEND = 64 * 1024;
 
     bool buffers_overrun() const { return read_disable_count_ > 0; }
 
@@ -195,6 +209,9 @@ protected:
     HeaderMapPtr pending_trailers_;
     Optional<StreamResetReason> deferred_reset_;
     HeaderString cookies_;
+    // The DATA bytes left to send at the boosted weight, and the weight to go back to after.
+    uint32_t boost_bytes_left_{0};
+    int32_t unboosted_weight_{NGHTTP2_DEFAULT_WEIGHT};
     bool local_end_stream_sent_ : 1;
     bool remote_end_stream_ : 1;
     bool data_deferred_ : 1;
@@ -231,20 +248,33 @@ protected:
   StreamImpl* getStream(int32_t stream_id);
   int saveHeader(const nghttp2_frame* frame, HeaderString&& name, HeaderString&& value);
   void sendPendingFrames();
+  void setStreamWeight(int32_t stream_id, int32_t weight);
   void sendSettings(const Http2Settings& http2_settings, bool disable_push);
 
   static Http2Callbacks http2_callbacks_;
-  static Http2Options http2_options_;
 
   std::list<StreamImplPtr> active_streams_;
   nghttp2_session* session_{};
   CodecStats stats_;
   Network::Connection& connection_;
   uint32_t per_stream_buffer_limit_;
+  // Limits on the headers that each stream receives, checked as they are decoded.
+  uint64_t max_headers_bytes_;
+  uint32_t max_headers_count_;
+  // The frames serialized by one nghttp2_session_send(). They are written to the connection at once
+  // when it returns instead of one write per frame.
+  Buffer::OwnedImpl output_buffer_;
+  uint32_t small_stream_boost_bytes_;
+  // Streams, with their weights, whose boost ran out during the current nghttp2_session_send(). The
+  // priority tree isn't changed while nghttp2 walks it, so they are restored once it returns.
+  std::vector<std::pair<int32_t, int32_t>> unboosted_streams_;
+  // Whether a DATA frame was held back because output_buffer_ was full.
+  bool send_blocked_ : 1;
 
 private:
   virtual ConnectionCallbacks& callbacks() PURE;
   virtual int onBeginHeaders(const nghttp2_frame* frame) PURE;
+  int onBeginFrame(const nghttp2_frame_hd* hd);
   int onData(int32_t stream_id, const uint8_t* data, size_t len);
   int onFrameReceived(const nghttp2_frame* frame);
   int onFrameSend(const nghttp2_frame* frame);
@@ -288,6 +318,9 @@ public:
   ServerConnectionImpl(Network::Connection& connection, ServerConnectionCallbacks& callbacks,
                        Stats::Scope& scope, const Http2Settings& http2_settings);
 
+  // Http::ServerConnection
+  uint32_t maxPipelineDepth() const override { return 1; }
+
 private:
   // ConnectionImpl
   ConnectionCallbacks& callbacks() override { return callbacks_; }
@@ -1,6 +1,7 @@
 #include "common/http/http2/conn_pool.h"
 
 #include <cstdint>
+#include <vector>
 
 #include "envoy/event/dispatcher.h"
 #include "envoy/event/timer.h"
@@ -19,12 +20,13 @@ ConnPoolImpl::ConnPoolImpl(Event::Dispatcher& dispatcher, Upstream::HostConstSha
     : dispatcher_(dispatcher), host_(host), priority_(priority) {}
 
 ConnPoolImpl::~ConnPoolImpl() {
-  if (primary_client_) {
-    primary_client_->client_->close();
+  // Closing a client removes it from its list.
+  while (!primary_clients_.empty()) {
+    primary_clients_.front()->client_->close();
   }
 
-  if (draining_client_) {
-    draining_client_->client_->close();
+  while (!draining_clients_.empty()) {
+    draining_clients_.front()->client_->close();
   }
 
   // Make sure all clients are destroyed before we are destroyed.
@@ -42,17 +44,22 @@ void ConnPoolImpl::checkForDrained() {
   }
 
   bool drained = true;
-  if (primary_client_) {
-    if (primary_client_->client_->numActiveRequests() == 0) {
-      primary_client_->client_->close();
-      ASSERT(!primary_client_);
+  // Closing a client removes it from primary_clients_, so the idle ones are collected first.
+  std::vector<ActiveClient*> idle_clients;
+  for (const ActiveClientPtr& client : primary_clients_) {
+    if (client->client_->numActiveRequests() == 0) {
+      idle_clients.push_back(client.get());
     } else {
       drained = false;
     }
   }
 
-  ASSERT(!draining_client_ || (draining_client_->client_->numActiveRequests() > 0));
-  if (draining_client_ && draining_client_->client_->numActiveRequests() > 0) {
+  for (ActiveClient* client : idle_clients) {
+    client->client_->close();
+  }
+
+  // Draining clients are closed as soon as they have no active requests.
+  if (!draining_clients_.empty()) {
     drained = false;
   }
 
@@ -74,12 +81,35 @@ ConnectionPool::Cancellable* ConnPoolImpl::newStream(Http::StreamDecoder& respon
     max_streams = maxTotalStreams();
   }
 
-  if (primary_client_ && primary_client_->total_streams_ >= max_streams) {
-    movePrimaryClientToDraining();
+  std::vector<ActiveClient*> exhausted_clients;
+  for (const ActiveClientPtr& client : primary_clients_) {
+    if (client->total_streams_ >= max_streams) {
+      exhausted_clients.push_back(client.get());
+    }
+  }
+
+  for (ActiveClient* client : exhausted_clients) {
+    movePrimaryClientToDraining(*client);
+  }
+
+  // Use the least loaded primary, unless every primary is at the stream threshold and the pool can
+  // still open another connection.
+  ActiveClient* primary_client = nullptr;
+  for (const ActiveClientPtr& client : primary_clients_) {
+    if (!primary_client ||
+        client->client_->numActiveRequests() < primary_client->client_->numActiveRequests()) {
+      primary_client = client.get();
+    }
   }
 
-  if (!primary_client_) {
-    primary_client_.reset(new ActiveClient(*this));
+  const Http2Settings& http2_settings = host_->cluster().http2Settings();
+  if (!primary_client ||
+      (primary_client->client_->numActiveRequests() >=
+           http2_settings.connection_stream_threshold_ &&
+       primary_clients_.size() < http2_settings.max_connections_per_host_)) {
+    ActiveClientPtr client(new ActiveClient(*this));
+    client->moveIntoListBack(std::move(client), primary_clients_);
+    primary_client = primary_clients_.back().get();
   }
 
   if (!host_->cluster().resourceManager(priority_).requests().canCreate()) {
@@ -87,15 +117,15 @@ ConnectionPool::Cancellable* ConnPoolImpl::newStream(Http::StreamDecoder& respon
     callbacks.onPoolFailure(ConnectionPool::PoolFailureReason::Overflow, nullptr);
     host_->cluster().stats().upstream_rq_pending_overflow_.inc();
   } else {
-    ENVOY_CONN_LOG(debug, "creating stream", *primary_client_->client_);
-    primary_client_->total_streams_++;
+    ENVOY_CONN_LOG(debug, "creating stream", *primary_client->client_);
+    primary_client->total_streams_++;
     host_->stats().rq_total_.inc();
     host_->stats().rq_active_.inc();
     host_->cluster().stats().upstream_rq_total_.inc();
     host_->cluster().stats().upstream_rq_active_.inc();
     host_->cluster().resourceManager(priority_).requests().inc();
-    callbacks.onPoolReady(primary_client_->client_->newStream(response_decoder),
-                          primary_client_->real_host_description_);
+    callbacks.onPoolReady(primary_client->client_->newStream(response_decoder),
+                          primary_client->real_host_description_);
   }
 
   return nullptr;
@@ -114,12 +144,12 @@ void ConnPoolImpl::onConnectionEvent(ActiveClient& client, Network::ConnectionEv
       }
     }
 
-    if (&client == primary_client_.get()) {
+    if (!client.draining_) {
       ENVOY_CONN_LOG(debug, "destroying primary client", *client.client_);
-      dispatcher_.deferredDelete(std::move(primary_client_));
+      dispatcher_.deferredDelete(client.removeFromList(primary_clients_));
     } else {
       ENVOY_CONN_LOG(debug, "destroying draining client", *client.client_);
-      dispatcher_.deferredDelete(std::move(draining_client_));
+      dispatcher_.deferredDelete(client.removeFromList(draining_clients_));
     }
 
     if (client.connect_timer_) {
@@ -142,25 +172,16 @@ void ConnPoolImpl::onConnectionEvent(ActiveClient& client, Network::ConnectionEv
   }
 }
 
-void ConnPoolImpl::movePrimaryClientToDraining() {
-  ENVOY_CONN_LOG(debug, "moving primary to draining", *primary_client_->client_);
-  if (draining_client_) {
-    // This should pretty much never happen, but is possible if we start draining and then get
-    // a goaway for example. In this case just kill the current draining connection. It's not
-    // worth keeping a list.
-    draining_client_->client_->close();
-  }
-
-  ASSERT(!draining_client_);
-  if (primary_client_->client_->numActiveRequests() == 0) {
-    // If we are making a new connection and the primary does not have any active requests just
-    // close it now.
-    primary_client_->client_->close();
+void ConnPoolImpl::movePrimaryClientToDraining(ActiveClient& client) {
+  ENVOY_CONN_LOG(debug, "moving primary to draining", *client.client_);
+  ASSERT(!client.draining_);
+  if (client.client_->numActiveRequests() == 0) {
+    // If the primary does not have any active requests just close it now.
+    client.client_->close();
   } else {
-    draining_client_ = std::move(primary_client_);
+    client.draining_ = true;
+    client.moveBetweenLists(primary_clients_, draining_clients_);
   }
-
-  ASSERT(!primary_client_);
 }
 
 void ConnPoolImpl::onConnectTimeout(ActiveClient& client) {
@@ -172,8 +193,8 @@ void ConnPoolImpl::onConnectTimeout(ActiveClient& client) {
 void ConnPoolImpl::onGoAway(ActiveClient& client) {
   ENVOY_CONN_LOG(debug, "remote goaway", *client.client_);
   host_->cluster().stats().upstream_cx_close_notify_.inc();
-  if (&client == primary_client_.get()) {
-    movePrimaryClientToDraining();
+  if (!client.draining_) {
+    movePrimaryClientToDraining(client);
   }
 }
 
@@ -183,7 +204,7 @@ void ConnPoolImpl::onStreamDestroy(ActiveClient& client) {
   host_->stats().rq_active_.dec();
   host_->cluster().stats().upstream_rq_active_.dec();
   host_->cluster().resourceManager(priority_).requests().dec();
-  if (&client == draining_client_.get() && client.client_->numActiveRequests() == 0) {
+  if (client.draining_ && client.client_->numActiveRequests() == 0) {
     // Close out the draining client if we no long have active requests.
     client.client_->close();
   }
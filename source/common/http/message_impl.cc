@@ -9,6 +9,7 @@ namespace Http {
 std::string MessageImpl::bodyAsString() const {
   std::string ret;
   if (body_) {
+    ret.reserve(body_->length());
     uint64_t num_slices = body_->getRawSlices(nullptr, 0);
     Buffer::RawSlice slices[num_slices];
     body_->getRawSlices(slices, num_slices);
@@ -20,6 +20,7 @@ public:
   // Http::Message
   HeaderMap& headers() override { return *headers_; }
   Buffer::InstancePtr& body() override { return body_; }
+  const Buffer::InstancePtr& body() const override { return body_; }
   HeaderMap* trailers() override { return trailers_.get(); }
   void trailers(HeaderMapPtr&& trailers) override { trailers_ = std::move(trailers); }
   std::string bodyAsString() const override;
@@ -4,9 +4,11 @@
 #include <cstdint>
 #include <string>
 
+#include "common/common/empty_string.h"
 #include "common/common/enum_to_int.h"
 #include "common/http/message_impl.h"
 #include "common/http/utility.h"
+#include "common/json/json_loader.h"
 
 namespace Envoy {
 namespace Http {
@@ -42,6 +44,13 @@ void RestApiFetcher::onSuccess(Http::MessagePtr&& response) {
   requestComplete();
 }
 
+Json::ObjectSharedPtr RestApiFetcher::parseJsonBody(const Message& response) {
+  if (!response.body()) {
+    return Json::Factory::loadFromString(EMPTY_STRING);
+  }
+  return Json::Factory::loadFromBuffer(*response.body());
+}
+
 void RestApiFetcher::onFailure(Http::AsyncClient::FailureReason) {
   onFetchFailure(nullptr);
   requestComplete();
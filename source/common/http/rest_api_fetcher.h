@@ -4,6 +4,7 @@
 #include <string>
 
 #include "envoy/event/dispatcher.h"
+#include "envoy/json/json_object.h"
 #include "envoy/runtime/runtime.h"
 #include "envoy/upstream/cluster_manager.h"
 
@@ -49,6 +50,13 @@ protected:
    */
   virtual void onFetchFailure(const EnvoyException* e) PURE;
 
+  /**
+   * @return Json::ObjectSharedPtr the JSON body of a response. The body is parsed where it was
+   *         received rather than from a copy, which would double the memory of large responses.
+   * @throw EnvoyException if the body is missing or is not valid JSON.
+   */
+  static Json::ObjectSharedPtr parseJsonBody(const Message& response);
+
 protected:
   const std::string remote_cluster_name_;
   Upstream::ClusterManager& cm_;
@@ -1,6 +1,8 @@
 #include "common/http/utility.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -165,6 +167,21 @@ Http2Settings Utility::parseHttp2Settings(const envoy::api::v2::Http2ProtocolOpt
   return ret;
 }
 
+Http2Settings Utility::parseHttp2Settings(const envoy::api::v2::Http2ProtocolOptions& config,
+                                          Runtime::Loader& runtime,
+                                          const std::string& runtime_prefix) {
+  Http2Settings ret = parseHttp2Settings(config);
+  const uint64_t max_frame_size = runtime.snapshot().getInteger(
+      runtime_prefix + "http2.max_frame_size", Http2Settings::DEFAULT_MAX_FRAME_SIZE);
+  ret.max_frame_size_ = std::min<uint64_t>(
+      std::max<uint64_t>(max_frame_size, Http2Settings::MIN_MAX_FRAME_SIZE),
+      Http2Settings::MAX_MAX_FRAME_SIZE);
+  ret.small_stream_boost_bytes_ = std::min<uint64_t>(
+      runtime.snapshot().getInteger(runtime_prefix + "http2.small_stream_boost_bytes", 0),
+      std::numeric_limits<uint32_t>::max());
+  return ret;
+}
+
 Http1Settings Utility::parseHttp1Settings(const envoy::api::v2::Http1ProtocolOptions& config) {
   Http1Settings ret;
   ret.allow_absolute_url_ = PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, allow_absolute_url, false);
@@ -214,13 +231,18 @@ std::string Utility::getLastAddressFromXFF(const Http::HeaderMap& request_header
     return EMPTY_STRING;
   }
 
-  std::vector<std::string> xff_address_list =
-      StringUtil::split(request_headers.ForwardedFor()->value().c_str(), ", ");
-
-  if (xff_address_list.empty()) {
-    return EMPTY_STRING;
+  // The last address is the trailing run of characters that are neither commas nor spaces. It is
+  // found in place rather than by splitting the header, which is done for every request.
+  const char* xff = request_headers.ForwardedFor()->value().c_str();
+  const char* end = xff + request_headers.ForwardedFor()->value().size();
+  while (end != xff && (end[-1] == ',' || end[-1] == ' ')) {
+    end--;
+  }
+  const char* begin = end;
+  while (begin != xff && begin[-1] != ',' && begin[-1] != ' ') {
+    begin--;
   }
-  return xff_address_list.back();
+  return std::string(begin, end);
 }
 
 } // namespace Http
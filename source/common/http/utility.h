@@ -5,6 +5,7 @@
 
 #include "envoy/http/codes.h"
 #include "envoy/http/filter.h"
+#include "envoy/runtime/runtime.h"
 
 #include "common/json/json_loader.h"
 
@@ -87,6 +88,18 @@ public:
    */
   static Http2Settings parseHttp2Settings(const envoy::api::v2::Http2ProtocolOptions& config);
 
+  /**
+   * @return Http2Settings An Http2Settings populated from the envoy::api::v2::Http2ProtocolOptions
+   *         config, with settings that the config does not have yet read from runtime.
+   * @param runtime supplies the runtime loader.
+   * @param runtime_prefix supplies the prefix of the runtime keys, e.g. "upstream.<cluster>.". The
+   *        maximum frame size is read from <runtime_prefix>http2.max_frame_size and the small
+   *        stream boost from <runtime_prefix>http2.small_stream_boost_bytes.
+   */
+  static Http2Settings parseHttp2Settings(const envoy::api::v2::Http2ProtocolOptions& config,
+                                          Runtime::Loader& runtime,
+                                          const std::string& runtime_prefix);
+
   /**
    * @return Http1Settings An Http1Settings populated from the envoy::api::v2::Http1ProtocolOptions
    *         config.
@@ -78,6 +78,7 @@ void WsHandlerImpl::onConnectionSuccess() {
   Http1::ClientConnectionImpl upstream_http(*upstream_connection_, http_conn_callbacks_);
   Http1::RequestStreamEncoderImpl upstream_request = Http1::RequestStreamEncoderImpl(upstream_http);
   upstream_request.encodeHeaders(request_headers_, false);
+  ws_callbacks_.onUpstreamConnected();
 }
 
 } // namespace WebSocket
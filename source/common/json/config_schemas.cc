@@ -24,7 +24,25 @@ const std::string Json::Schema::LISTENER_SCHEMA(R"EOF(
             }
           },
           "cipher_suites" : {"type" : "string", "minLength" : 1},
-          "ecdh_curves" : {"type" : "string", "minLength" : 1}
+          "ecdh_curves" : {"type" : "string", "minLength" : 1},
+          "session_ticket_key_paths" : {
+            "type" : "array",
+            "items" : {
+              "type" : "string"
+            }
+          },
+          "sni_certificates" : {
+            "type" : "array",
+            "items" : {
+              "type" : "object",
+              "properties" : {
+                "cert_chain_file" : {"type" : "string"},
+                "private_key_file": {"type" : "string"}
+              },
+              "required": ["cert_chain_file", "private_key_file"],
+              "additionalProperties": false
+            }
+          }
         },
         "required": ["cert_chain_file", "private_key_file"],
         "additionalProperties": false
@@ -431,7 +449,29 @@ const std::string Json::Schema::REDIS_PROXY_NETWORK_FILTER_SCHEMA(R"EOF(
     "properties":{
       "cluster_name" : {"type" : "string"},
       "stat_prefix" : {"type" : "string"},
-      "conn_pool" : {"type" : "object"}
+      "conn_pool" : {"type" : "object"},
+      "hot_key_cache" : {
+        "type" : "object",
+        "properties" : {
+          "keys" : {
+            "type" : "array",
+            "minItems" : 1,
+            "uniqueItems" : true,
+            "items" : {"type" : "string"}
+          },
+          "ttl_ms" : {
+            "type" : "integer",
+            "minimum" : 0,
+            "exclusiveMinimum" : true
+          },
+          "max_entries" : {
+            "type" : "integer",
+            "minimum" : 1
+          }
+        },
+        "required" : ["keys", "ttl_ms"],
+        "additionalProperties" : false
+      }
     },
     "required": ["cluster_name", "stat_prefix", "conn_pool"],
     "additionalProperties": false
@@ -447,6 +487,28 @@ const std::string Json::Schema::REDIS_CONN_POOL_SCHEMA(R"EOF(
         "type" : "integer",
         "minimum" : 0,
         "exclusiveMinimum" : true
+      },
+      "max_buffer_size_before_flush" : {
+        "type" : "integer",
+        "minimum" : 0
+      },
+      "max_connections_per_host" : {
+        "type" : "integer",
+        "minimum" : 1
+      },
+      "max_requests_per_connection" : {
+        "type" : "integer",
+        "minimum" : 0
+      },
+      "cluster_mode" : {"type" : "boolean"},
+      "cluster_refresh_interval_ms" : {
+        "type" : "integer",
+        "minimum" : 0,
+        "exclusiveMinimum" : true
+      },
+      "read_policy" : {
+        "type" : "string",
+        "enum" : ["master", "prefer_replica", "any"]
       }
     },
     "required": ["op_timeout_ms"],
@@ -460,6 +522,16 @@ const std::string Json::Schema::TCP_PROXY_NETWORK_FILTER_SCHEMA(R"EOF(
       "type" : "object",
       "properties": {
         "stat_prefix": {"type" : "string"},
+        "splice": {"type" : "boolean"},
+        "upstream_pool": {
+          "type": "object",
+          "properties": {
+            "size": {"type": "integer", "minimum": 1},
+            "idle_timeout_ms": {"type": "integer", "minimum": 1}
+          },
+          "required": ["size"],
+          "additionalProperties": false
+        },
         "route_config": {
           "type": "object",
           "properties": {
@@ -899,13 +971,48 @@ const std::string Json::Schema::BUFFER_HTTP_FILTER_SCHEMA(R"EOF(
     "type" : "object",
     "properties" : {
       "max_request_bytes" : {"type" : "integer"},
-      "max_request_time_s" : {"type" : "integer"}
+      "max_request_time_s" : {"type" : "integer"},
+      "spill" : {
+        "type" : "object",
+        "properties" : {
+          "directory" : {"type" : "string"},
+          "max_memory_bytes" : {
+            "type" : "integer",
+            "minimum" : 0
+          },
+          "stream_memory_bytes" : {
+            "type" : "integer",
+            "minimum" : 0
+          }
+        },
+        "additionalProperties" : false
+      }
     },
     "required" : ["max_request_bytes", "max_request_time_s"],
     "additionalProperties" : false
   }
   )EOF");
 
+const std::string Json::Schema::CACHE_HTTP_FILTER_SCHEMA(R"EOF(
+  {
+    "$schema": "http://json-schema.org/schema#",
+    "type" : "object",
+    "properties" : {
+      "max_bytes" : {
+        "type" : "integer",
+        "minimum" : 0,
+        "exclusiveMinimum" : true
+      },
+      "max_entry_bytes" : {
+        "type" : "integer",
+        "minimum" : 0,
+        "exclusiveMinimum" : true
+      }
+    },
+    "additionalProperties" : false
+  }
+  )EOF");
+
 const std::string Json::Schema::FAULT_HTTP_FILTER_SCHEMA(R"EOF(
   {
     "$schema": "http://json-schema.org/schema#",
@@ -997,6 +1104,43 @@ const std::string Json::Schema::GRPC_JSON_TRANSCODER_FILTER_SCHEMA(R"EOF(
   }
   )EOF");
 
+const std::string Json::Schema::GZIP_HTTP_FILTER_SCHEMA(R"EOF(
+  {
+    "$schema": "http://json-schema.org/schema#",
+    "type" : "object",
+    "properties" : {
+      "compression_level" : {
+        "type" : "integer",
+        "minimum" : 1,
+        "maximum" : 9
+      },
+      "window_bits" : {
+        "type" : "integer",
+        "minimum" : 9,
+        "maximum" : 15
+      },
+      "memory_level" : {
+        "type" : "integer",
+        "minimum" : 1,
+        "maximum" : 9
+      },
+      "min_content_length" : {
+        "type" : "integer",
+        "minimum" : 0
+      },
+      "content_types" : {
+        "type" : "array",
+        "items" : {"type" : "string"}
+      },
+      "max_pooled_compressors" : {
+        "type" : "integer",
+        "minimum" : 0
+      }
+    },
+    "additionalProperties" : false
+  }
+  )EOF");
+
 const std::string Json::Schema::IP_TAGGING_HTTP_FILTER_SCHEMA(R"EOF(
   {
     "$schema": "http://json-schema.org/schema#",
@@ -1037,7 +1181,15 @@ const std::string Json::Schema::HEALTH_CHECK_HTTP_FILTER_SCHEMA(R"EOF(
     "properties" : {
       "pass_through_mode" : {"type" : "boolean"},
       "endpoint" : {"type" : "string"},
-      "cache_time_ms" : {"type" : "integer"}
+      "cache_time_ms" : {"type" : "integer"},
+      "cluster_min_healthy_percentages" : {
+        "type" : "object",
+        "additionalProperties" : {
+          "type" : "integer",
+          "minimum" : 0,
+          "maximum" : 100
+        }
+      }
     },
     "required" : ["pass_through_mode", "endpoint"],
     "additionalProperties" : false
@@ -1063,6 +1215,78 @@ const std::string Json::Schema::RATE_LIMIT_HTTP_FILTER_SCHEMA(R"EOF(
         "type" : "integer",
         "minimum" : 0,
         "exclusiveMinimum" : true
+      },
+      "coalesce" : {
+        "type" : "object",
+        "properties" : {
+          "cache_ttl_ms" : {
+            "type" : "integer",
+            "minimum" : 0
+          },
+          "max_cache_entries" : {
+            "type" : "integer",
+            "minimum" : 0,
+            "exclusiveMinimum" : true
+          }
+        },
+        "additionalProperties" : false
+      },
+      "local" : {
+        "type" : "object",
+        "properties" : {
+          "limits" : {
+            "type" : "array",
+            "minItems" : 1,
+            "items" : {
+              "type" : "object",
+              "properties" : {
+                "descriptor" : {
+                  "type" : "array",
+                  "minItems" : 1,
+                  "items" : {
+                    "type" : "object",
+                    "properties" : {
+                      "key" : {"type" : "string"},
+                      "value" : {"type" : "string"}
+                    },
+                    "required" : ["key", "value"],
+                    "additionalProperties" : false
+                  }
+                },
+                "requests_per_second" : {
+                  "type" : "integer",
+                  "minimum" : 0,
+                  "exclusiveMinimum" : true
+                },
+                "burst" : {
+                  "type" : "integer",
+                  "minimum" : 0,
+                  "exclusiveMinimum" : true
+                }
+              },
+              "required" : ["descriptor", "requests_per_second"],
+              "additionalProperties" : false
+            }
+          },
+          "global_sync" : {
+            "type" : "object",
+            "properties" : {
+              "max_pending" : {
+                "type" : "integer",
+                "minimum" : 0,
+                "exclusiveMinimum" : true
+              },
+              "over_limit_ms" : {
+                "type" : "integer",
+                "minimum" : 0,
+                "exclusiveMinimum" : true
+              }
+            },
+            "additionalProperties" : false
+          }
+        },
+        "required" : ["limits"],
+        "additionalProperties" : false
       }
     },
     "required" : ["domain"],
@@ -1075,7 +1299,9 @@ const std::string Json::Schema::ROUTER_HTTP_FILTER_SCHEMA(R"EOF(
     "$schema": "http://json-schema.org/schema#",
     "type" : "object",
     "properties" : {
-      "dynamic_stats" : {"type" : "boolean"}
+      "dynamic_stats" : {"type" : "boolean"},
+      "retry_buffer_limit_bytes" : {"type" : "integer", "minimum" : 0},
+      "max_shadow_bytes_in_flight" : {"type" : "integer", "minimum" : 0}
     },
     "additionalProperties" : false
   }
@@ -1203,7 +1429,21 @@ const std::string Json::Schema::TOP_LEVEL_CONFIG_SCHEMA(R"EOF(
             "type" : "object",
             "properties" : {
               "collector_cluster" : {"type" : "string"},
-              "collector_endpoint": {"type": "string"}
+              "collector_endpoint": {"type": "string"},
+              "collector_encoding": {
+                "type": "string",
+                "enum": ["json", "proto"]
+              },
+              "tail_sampling": {
+                "type": "object",
+                "properties": {
+                  "latency_threshold_ms": {"type": "integer", "minimum": 0},
+                  "window_ms": {"type": "integer", "minimum": 1},
+                  "max_buffered_spans": {"type": "integer", "minimum": 0}
+                },
+                "required": ["latency_threshold_ms"],
+                "additionalProperties": false
+              }
             },
             "required": ["collector_cluster"],
             "additionalProperties" : false
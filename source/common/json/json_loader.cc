@@ -3,6 +3,8 @@
 #include <cstdint>
 #include <fstream>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <stack>
 #include <string>
@@ -11,6 +13,7 @@
 
 #include "common/common/assert.h"
 #include "common/common/hash.h"
+#include "common/common/thread.h"
 #include "common/common/utility.h"
 #include "common/filesystem/filesystem_impl.h"
 
@@ -43,9 +46,9 @@ public:
   void setLineNumberEnd(uint64_t line_number) { line_number_end_ = line_number; }
 
   // Container factories for handler.
-  static FieldSharedPtr createObject() { return FieldSharedPtr{new Field(Type::Object)}; }
-  static FieldSharedPtr createArray() { return FieldSharedPtr{new Field(Type::Array)}; }
-  static FieldSharedPtr createNull() { return FieldSharedPtr{new Field(Type::Null)}; }
+  static FieldSharedPtr createObject() { return std::make_shared<Field>(Type::Object); }
+  static FieldSharedPtr createArray() { return std::make_shared<Field>(Type::Array); }
+  static FieldSharedPtr createNull() { return std::make_shared<Field>(Type::Null); }
 
   bool isNull() const override { return type_ == Type::Null; }
   bool isArray() const { return type_ == Type::Array; }
@@ -53,16 +56,16 @@ public:
 
   // Value factory.
   template <typename T> static FieldSharedPtr createValue(T value) {
-    return FieldSharedPtr{new Field(value)};
+    return std::make_shared<Field>(std::move(value));
   }
 
   void append(FieldSharedPtr field_ptr) {
     checkType(Type::Array);
-    value_.array_value_.push_back(field_ptr);
+    value_.array_value_.push_back(std::move(field_ptr));
   }
-  void insert(const std::string& key, FieldSharedPtr field_ptr) {
+  void insert(std::string&& key, FieldSharedPtr field_ptr) {
     checkType(Type::Object);
-    value_.object_value_[key] = field_ptr;
+    value_.object_value_[std::move(key)] = std::move(field_ptr);
   }
 
   uint64_t hash() const override;
@@ -91,7 +94,13 @@ public:
   void iterate(const ObjectCallback& callback) const override;
   void validateSchema(const std::string& schema) const override;
 
-private:
+  /**
+   * Send the SAX events of the field to a rapidjson handler, e.g. a writer or a schema validator,
+   * so that no rapidjson document needs to be built.
+   * @return bool whether the handler accepted all the events.
+   */
+  template <typename Handler> bool accept(Handler& handler) const;
+
   enum class Type {
     Array,
     Boolean,
@@ -101,6 +110,16 @@ private:
     Object,
     String,
   };
+  // Public for std::make_shared. Use the factories above instead.
+  explicit Field(Type type) : type_(type) {}
+  explicit Field(std::string&& value) : type_(Type::String) {
+    value_.string_value_ = std::move(value);
+  }
+  explicit Field(int64_t value) : type_(Type::Integer) { value_.integer_value_ = value; }
+  explicit Field(double value) : type_(Type::Double) { value_.double_value_ = value; }
+  explicit Field(bool value) : type_(Type::Boolean) { value_.boolean_value_ = value; }
+
+private:
   static const char* typeAsString(Type t) {
     switch (t) {
     case Type::Array:
@@ -131,12 +150,6 @@ private:
     std::string string_value_;
   };
 
-  explicit Field(Type type) : type_(type) {}
-  explicit Field(const std::string& value) : type_(Type::String) { value_.string_value_ = value; }
-  explicit Field(int64_t value) : type_(Type::Integer) { value_.integer_value_ = value; }
-  explicit Field(double value) : type_(Type::Double) { value_.double_value_ = value; }
-  explicit Field(bool value) : type_(Type::Boolean) { value_.boolean_value_ = value; }
-
   bool isType(Type type) const { return type == type_; }
   void checkType(Type type) const {
     if (!isType(type)) {
@@ -151,7 +164,7 @@ private:
     checkType(Type::String);
     return value_.string_value_;
   }
-  std::vector<FieldSharedPtr> arrayValue() const {
+  const std::vector<FieldSharedPtr>& arrayValue() const {
     checkType(Type::Array);
     return value_.array_value_;
   }
@@ -168,10 +181,6 @@ private:
     return value_.integer_value_;
   }
 
-  rapidjson::Document asRapidJsonDocument() const;
-  static void buildRapidJsonDocument(const Field& field, rapidjson::Value& value,
-                                     rapidjson::Document::AllocatorType& allocator);
-
   uint64_t line_number_start_;
   uint64_t line_number_end_;
   const Type type_;
@@ -179,12 +188,24 @@ private:
 };
 
 /**
- * Custom stream to allow access to the line number for each object.
+ * Line number of the position of a custom stream, to allow access to the line number for each
+ * object.
  */
-class LineCountingStringStream : public rapidjson::StringStream {
+class LineCounter {
+public:
+  uint64_t getLineNumber() const { return line_number_; }
+
+protected:
+  uint64_t line_number_{1};
+};
+
+/**
+ * Custom stream over a string.
+ */
+class LineCountingStringStream : public rapidjson::StringStream, public LineCounter {
   // Ch is typdef in parent class to handle character encoding.
 public:
-  LineCountingStringStream(const Ch* src) : rapidjson::StringStream(src), line_number_(1) {}
+  LineCountingStringStream(const Ch* src) : rapidjson::StringStream(src) {}
   Ch Take() {
     Ch ret = rapidjson::StringStream::Take();
     if (ret == '\n') {
@@ -192,10 +213,57 @@ public:
     }
     return ret;
   }
-  uint64_t getLineNumber() const { return line_number_; }
+};
+
+/**
+ * Custom read only stream over the slices of a buffer, so that a buffer is parsed without being
+ * copied into a string. Like rapidjson::StringStream, it ends at the first null character.
+ */
+class LineCountingSliceStream : public LineCounter {
+public:
+  typedef char Ch;
+
+  LineCountingSliceStream(const Buffer::RawSlice* slices, uint64_t num_slices)
+      : slice_(slices), end_(slices + num_slices) {
+    skipEmptySlices();
+  }
+
+  Ch Peek() const { return slice_ == end_ ? '\0' : static_cast<const Ch*>(slice_->mem_)[offset_]; }
+  Ch Take() {
+    const Ch ret = Peek();
+    if (ret == '\0') {
+      return ret;
+    }
+    if (ret == '\n') {
+      line_number_++;
+    }
+    tell_++;
+    if (++offset_ == slice_->len_) {
+      slice_++;
+      skipEmptySlices();
+    }
+    return ret;
+  }
+  size_t Tell() const { return tell_; }
+
+  // Required by the rapidjson stream concept, but only used for parsing in place.
+  Ch* PutBegin() { NOT_REACHED; }
+  void Put(Ch) { NOT_REACHED; }
+  void Flush() { NOT_REACHED; }
+  size_t PutEnd(Ch*) { NOT_REACHED; }
 
 private:
-  uint64_t line_number_;
+  void skipEmptySlices() {
+    offset_ = 0;
+    while (slice_ != end_ && slice_->len_ == 0) {
+      slice_++;
+    }
+  }
+
+  const Buffer::RawSlice* slice_;
+  const Buffer::RawSlice* const end_;
+  uint64_t offset_{0};
+  size_t tell_{0};
 };
 
 /**
@@ -203,7 +271,7 @@ private:
  */
 class ObjectHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, ObjectHandler> {
 public:
-  ObjectHandler(LineCountingStringStream& stream) : state_(expectRoot), stream_(stream){};
+  ObjectHandler(const LineCounter& stream) : state_(expectRoot), stream_(stream){};
 
   bool StartObject();
   bool EndObject(rapidjson::SizeType);
@@ -233,7 +301,7 @@ private:
     expectFinished,
   };
   State state_;
-  LineCountingStringStream& stream_;
+  const LineCounter& stream_;
 
   std::stack<FieldSharedPtr> stack_;
   std::string key_;
@@ -241,89 +309,78 @@ private:
   FieldSharedPtr root_;
 };
 
-void Field::buildRapidJsonDocument(const Field& field, rapidjson::Value& value,
-                                   rapidjson::Document::AllocatorType& allocator) {
-
-  switch (field.type_) {
-  case Type::Array: {
-    value.SetArray();
-    value.Reserve(field.value_.array_value_.size(), allocator);
-    for (const auto& element : field.value_.array_value_) {
-      switch (element->type_) {
-      case Type::Array:
-      case Type::Object: {
-        rapidjson::Value nested_value;
-        buildRapidJsonDocument(*element, nested_value, allocator);
-        value.PushBack(nested_value, allocator);
-        break;
-      }
-      case Type::Boolean:
-        value.PushBack(element->value_.boolean_value_, allocator);
-        break;
-      case Type::Double:
-        value.PushBack(element->value_.double_value_, allocator);
-        break;
-      case Type::Integer:
-        value.PushBack(element->value_.integer_value_, allocator);
-        break;
-      case Type::Null:
-        value.PushBack(rapidjson::Value(), allocator);
-        break;
-      case Type::String:
-        value.PushBack(rapidjson::StringRef(element->value_.string_value_.c_str()), allocator);
-      }
+template <typename Handler> bool Field::accept(Handler& handler) const {
+  switch (type_) {
+  case Type::Array:
+    if (!handler.StartArray()) {
+      return false;
     }
-    break;
-  }
-  case Type::Object: {
-    value.SetObject();
-    for (const auto& item : field.value_.object_value_) {
-      auto name = rapidjson::StringRef(item.first.c_str());
-
-      switch (item.second->type_) {
-      case Type::Array:
-      case Type::Object: {
-        rapidjson::Value nested_value;
-        buildRapidJsonDocument(*item.second, nested_value, allocator);
-        value.AddMember(name, nested_value, allocator);
-        break;
+    for (const auto& element : value_.array_value_) {
+      if (!element->accept(handler)) {
+        return false;
       }
-      case Type::Boolean:
-        value.AddMember(name, item.second->value_.boolean_value_, allocator);
-        break;
-      case Type::Double:
-        value.AddMember(name, item.second->value_.double_value_, allocator);
-        break;
-      case Type::Integer:
-        value.AddMember(name, item.second->value_.integer_value_, allocator);
-        break;
-      case Type::Null:
-        value.AddMember(name, rapidjson::Value(), allocator);
-        break;
-      case Type::String:
-        value.AddMember(name, rapidjson::StringRef(item.second->value_.string_value_.c_str()),
-                        allocator);
-        break;
+    }
+    return handler.EndArray(value_.array_value_.size());
+  case Type::Boolean:
+    return handler.Bool(value_.boolean_value_);
+  case Type::Double:
+    return handler.Double(value_.double_value_);
+  case Type::Integer:
+    return handler.Int64(value_.integer_value_);
+  case Type::Null:
+    return handler.Null();
+  case Type::Object:
+    if (!handler.StartObject()) {
+      return false;
+    }
+    for (const auto& item : value_.object_value_) {
+      if (!handler.Key(item.first.c_str(), item.first.size(), false) ||
+          !item.second->accept(handler)) {
+        return false;
       }
     }
-    break;
-  }
-  default:
-    NOT_REACHED;
+    return handler.EndObject(value_.object_value_.size());
+  case Type::String:
+    return handler.String(value_.string_value_.c_str(), value_.string_value_.size(), false);
   }
+
+  NOT_REACHED;
 }
 
-rapidjson::Document Field::asRapidJsonDocument() const {
-  rapidjson::Document document;
-  rapidjson::Document::AllocatorType& allocator = document.GetAllocator();
-  buildRapidJsonDocument(*this, document, allocator);
-  return document;
+/**
+ * The same few schemas are used to validate the many objects of a large config, so each schema is
+ * only parsed once. A SchemaDocument is immutable, so it can be shared by validators on any thread.
+ */
+const rapidjson::SchemaDocument& schemaDocument(const std::string& schema) {
+  struct ParsedSchema {
+    rapidjson::Document document_;
+    std::unique_ptr<rapidjson::SchemaDocument> schema_document_;
+  };
+  static Thread::MutexBasicLockable lock;
+  static std::unordered_map<std::string, std::unique_ptr<ParsedSchema>> schemas;
+
+  std::unique_lock<Thread::BasicLockable> guard(lock);
+  auto schema_itr = schemas.find(schema);
+  if (schema_itr != schemas.end()) {
+    return *schema_itr->second->schema_document_;
+  }
+
+  std::unique_ptr<ParsedSchema> parsed(new ParsedSchema());
+  if (parsed->document_.Parse<0>(schema.c_str()).HasParseError()) {
+    throw std::invalid_argument(fmt::format(
+        "Schema supplied to validateSchema is not valid JSON\n Error(offset {}) : {}\n",
+        parsed->document_.GetErrorOffset(), GetParseError_En(parsed->document_.GetParseError())));
+  }
+  parsed->schema_document_.reset(new rapidjson::SchemaDocument(parsed->document_));
+  const rapidjson::SchemaDocument& schema_document = *parsed->schema_document_;
+  schemas.emplace(schema, std::move(parsed));
+  return schema_document;
 }
 
 uint64_t Field::hash() const {
   rapidjson::StringBuffer buffer;
   rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-  asRapidJsonDocument().Accept(writer);
+  accept(writer);
   return HashUtil::xxHash64(buffer.GetString());
 }
 
@@ -417,7 +474,7 @@ std::vector<ObjectSharedPtr> Field::getObjectArray(const std::string& name,
                                 line_number_start_, line_number_end_));
   }
 
-  std::vector<FieldSharedPtr> array_value = value_itr->second->arrayValue();
+  const std::vector<FieldSharedPtr>& array_value = value_itr->second->arrayValue();
   return {array_value.begin(), array_value.end()};
 }
 
@@ -453,7 +510,7 @@ std::vector<std::string> Field::getStringArray(const std::string& name, bool all
                                 line_number_start_, line_number_end_));
   }
 
-  std::vector<FieldSharedPtr> array = value_itr->second->arrayValue();
+  const std::vector<FieldSharedPtr>& array = value_itr->second->arrayValue();
   string_array.reserve(array.size());
   for (const auto& element : array) {
     if (!element->isType(Type::String)) {
@@ -474,8 +531,7 @@ std::vector<ObjectSharedPtr> Field::asObjectArray() const {
 std::string Field::asJsonString() const {
   rapidjson::StringBuffer buffer;
   rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-  rapidjson::Document document = asRapidJsonDocument();
-  document.Accept(writer);
+  accept(writer);
   return buffer.GetString();
 }
 
@@ -507,17 +563,9 @@ void Field::iterate(const ObjectCallback& callback) const {
 }
 
 void Field::validateSchema(const std::string& schema) const {
-  rapidjson::Document schema_document;
-  if (schema_document.Parse<0>(schema.c_str()).HasParseError()) {
-    throw std::invalid_argument(fmt::format(
-        "Schema supplied to validateSchema is not valid JSON\n Error(offset {}) : {}\n",
-        schema_document.GetErrorOffset(), GetParseError_En(schema_document.GetParseError())));
-  }
-
-  rapidjson::SchemaDocument schema_document_for_validator(schema_document);
-  rapidjson::SchemaValidator schema_validator(schema_document_for_validator);
+  rapidjson::SchemaValidator schema_validator(schemaDocument(schema));
 
-  if (!asRapidJsonDocument().Accept(schema_validator)) {
+  if (!accept(schema_validator)) {
     rapidjson::StringBuffer schema_string_buffer;
     rapidjson::StringBuffer document_string_buffer;
 
@@ -539,7 +587,7 @@ bool ObjectHandler::StartObject() {
 
   switch (state_) {
   case expectValueOrStartObjectArray:
-    stack_.top()->insert(key_, object);
+    stack_.top()->insert(std::move(key_), object);
     stack_.push(object);
     state_ = expectKeyOrEndObject;
     return true;
@@ -580,7 +628,7 @@ bool ObjectHandler::EndObject(rapidjson::SizeType) {
 bool ObjectHandler::Key(const char* value, rapidjson::SizeType size, bool) {
   switch (state_) {
   case expectKeyOrEndObject:
-    key_ = std::string(value, size);
+    key_.assign(value, size);
     state_ = expectValueOrStartObjectArray;
     return true;
   default:
@@ -594,7 +642,7 @@ bool ObjectHandler::StartArray() {
 
   switch (state_) {
   case expectValueOrStartObjectArray:
-    stack_.top()->insert(key_, array);
+    stack_.top()->insert(std::move(key_), array);
     stack_.push(array);
     state_ = expectArrayValueOrEndArray;
     return true;
@@ -667,7 +715,7 @@ bool ObjectHandler::handleValueEvent(FieldSharedPtr ptr) {
   switch (state_) {
   case expectValueOrStartObjectArray:
     state_ = expectKeyOrEndObject;
-    stack_.top()->insert(key_, ptr);
+    stack_.top()->insert(std::move(key_), std::move(ptr));
     return true;
   case expectArrayValueOrEndArray:
     stack_.top()->append(ptr);
@@ -677,6 +725,20 @@ bool ObjectHandler::handleValueEvent(FieldSharedPtr ptr) {
   }
 }
 
+template <typename Stream> ObjectSharedPtr parseJsonStream(Stream& json_stream) {
+  ObjectHandler handler(json_stream);
+  rapidjson::Reader reader;
+  reader.Parse(json_stream, handler);
+
+  if (reader.HasParseError()) {
+    throw Exception(fmt::format("JSON supplied is not valid. Error(offset {}, line {}): {}\n",
+                                reader.GetErrorOffset(), json_stream.getLineNumber(),
+                                GetParseError_En(reader.GetParseErrorCode())));
+  }
+
+  return handler.getRoot();
+}
+
 } // namespace
 
 ObjectSharedPtr Factory::loadFromFile(const std::string& file_path) {
@@ -749,18 +811,15 @@ ObjectSharedPtr Factory::loadFromYamlString(const std::string& yaml) {
 
 ObjectSharedPtr Factory::loadFromString(const std::string& json) {
   LineCountingStringStream json_stream(json.c_str());
+  return parseJsonStream(json_stream);
+}
 
-  ObjectHandler handler(json_stream);
-  rapidjson::Reader reader;
-  reader.Parse(json_stream, handler);
-
-  if (reader.HasParseError()) {
-    throw Exception(fmt::format("JSON supplied is not valid. Error(offset {}, line {}): {}\n",
-                                reader.GetErrorOffset(), json_stream.getLineNumber(),
-                                GetParseError_En(reader.GetParseErrorCode())));
-  }
-
-  return handler.getRoot();
+ObjectSharedPtr Factory::loadFromBuffer(const Buffer::Instance& json) {
+  const uint64_t num_slices = json.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  json.getRawSlices(slices, num_slices);
+  LineCountingSliceStream json_stream(slices, num_slices);
+  return parseJsonStream(json_stream);
 }
 
 const std::string Factory::listAsJsonString(const std::list<std::string>& items) {
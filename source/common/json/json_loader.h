@@ -3,6 +3,7 @@
 #include <list>
 #include <string>
 
+#include "envoy/buffer/buffer.h"
 #include "envoy/json/json_object.h"
 
 namespace Envoy {
@@ -20,6 +21,11 @@ public:
    */
   static ObjectSharedPtr loadFromString(const std::string& json);
 
+  /**
+   * Constructs a Json Object from the contents of a buffer, without copying them into a string.
+   */
+  static ObjectSharedPtr loadFromBuffer(const Buffer::Instance& json);
+
   /**
    * Constructs a Json Object from a YAML string.
    */
@@ -0,0 +1,119 @@
+#include "common/memory/allocation_tracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef TCMALLOC
+#include "gperftools/malloc_hook.h"
+#endif
+
+namespace Envoy {
+namespace Memory {
+
+namespace {
+
+/**
+ * The counts of a registered thread. Only the thread itself writes them, so the hook does not need
+ * atomic read-modify-writes, but they are atomic so that other threads can read them.
+ */
+struct ThreadCounters {
+  ThreadCounters(const std::string& name) : name_(name) {}
+
+  const std::string name_;
+  std::atomic<uint64_t> allocations_{};
+  std::atomic<uint64_t> bytes_{};
+};
+
+thread_local AllocationCounts* current_scope{};
+thread_local ThreadCounters* current_thread{};
+
+std::atomic<bool> tracking_enabled{};
+
+// Guards the state below, but is never taken by the hook.
+std::mutex tracker_lock;
+std::vector<std::unique_ptr<ThreadCounters>> registered_threads;
+
+#ifdef TCMALLOC
+void onNew(const void*, size_t size) {
+  ThreadCounters* thread = current_thread;
+  if (thread != nullptr) {
+    thread->allocations_.store(thread->allocations_.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
+    thread->bytes_.store(thread->bytes_.load(std::memory_order_relaxed) + size,
+                         std::memory_order_relaxed);
+  }
+
+  AllocationCounts* scope = current_scope;
+  if (scope != nullptr) {
+    scope->allocations_++;
+    scope->bytes_ += size;
+  }
+}
+#endif
+
+} // namespace
+
+bool AllocationTracker::enable() {
+#ifdef TCMALLOC
+  std::unique_lock<std::mutex> guard(tracker_lock);
+  if (!tracking_enabled && MallocHook::AddNewHook(&onNew)) {
+    tracking_enabled = true;
+  }
+#endif
+  return tracking_enabled;
+}
+
+void AllocationTracker::disable() {
+#ifdef TCMALLOC
+  std::unique_lock<std::mutex> guard(tracker_lock);
+  if (tracking_enabled) {
+    MallocHook::RemoveNewHook(&onNew);
+    tracking_enabled = false;
+  }
+#endif
+}
+
+bool AllocationTracker::enabled() { return tracking_enabled; }
+
+void AllocationTracker::registerThread(const std::string& name) {
+  std::unique_ptr<ThreadCounters> thread(new ThreadCounters(name));
+  std::unique_lock<std::mutex> guard(tracker_lock);
+  current_thread = thread.get();
+  registered_threads.push_back(std::move(thread));
+}
+
+void AllocationTracker::unregisterThread() {
+  ThreadCounters* thread = current_thread;
+  current_thread = nullptr;
+  std::unique_lock<std::mutex> guard(tracker_lock);
+  registered_threads.erase(
+      std::remove_if(registered_threads.begin(), registered_threads.end(),
+                     [thread](const std::unique_ptr<ThreadCounters>& registered) {
+                       return registered.get() == thread;
+                     }),
+      registered_threads.end());
+}
+
+std::vector<ThreadAllocationCounts> AllocationTracker::threadCounts() {
+  std::vector<ThreadAllocationCounts> counts;
+  std::unique_lock<std::mutex> guard(tracker_lock);
+  for (const std::unique_ptr<ThreadCounters>& thread : registered_threads) {
+    counts.push_back({thread->name_,
+                      {thread->allocations_.load(std::memory_order_relaxed),
+                       thread->bytes_.load(std::memory_order_relaxed)}});
+  }
+  return counts;
+}
+
+AllocationScope::AllocationScope(AllocationCounts& counts) : previous_(current_scope) {
+  current_scope = &counts;
+}
+
+AllocationScope::~AllocationScope() { current_scope = previous_; }
+
+} // namespace Memory
+} // namespace Envoy
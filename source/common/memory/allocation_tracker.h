@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Envoy {
+namespace Memory {
+
+/**
+ * A count of heap allocations and of the bytes that they requested.
+ */
+struct AllocationCounts {
+  uint64_t allocations_{};
+  uint64_t bytes_{};
+};
+
+/**
+ * The allocation counts of a registered thread.
+ */
+struct ThreadAllocationCounts {
+  std::string name_;
+  AllocationCounts counts_;
+};
+
+/**
+ * Counts the heap allocations of the registered threads, and attributes them to the innermost
+ * AllocationScope of the allocating thread, e.g. to the request that the code runs for. Tracking
+ * is off by default, and needs tcmalloc, whose allocation hooks it uses. While it is off the
+ * scopes cost two thread local writes, and nothing is counted.
+ */
+class AllocationTracker {
+public:
+  /**
+   * Start counting allocations.
+   * @return bool whether tracking is on, which it is not without tcmalloc.
+   */
+  static bool enable();
+
+  /**
+   * Stop counting allocations. The counts so far are kept.
+   */
+  static void disable();
+
+  /**
+   * @return bool whether allocations are being counted.
+   */
+  static bool enabled();
+
+  /**
+   * Register the calling thread, so that its total allocations are counted. A thread must
+   * unregister itself before it exits.
+   * @param name supplies the name that the counts of the thread are reported under.
+   */
+  static void registerThread(const std::string& name);
+
+  /**
+   * Stop counting the total allocations of the calling thread.
+   */
+  static void unregisterThread();
+
+  /**
+   * @return std::vector<ThreadAllocationCounts> the allocations of the registered threads since
+   *         they registered, counted while tracking was on.
+   */
+  static std::vector<ThreadAllocationCounts> threadCounts();
+};
+
+/**
+ * Adds the allocations of the calling thread to a count while in scope. A nested scope takes over
+ * until it ends, so each allocation is counted once. Scopes must be destroyed on the thread that
+ * created them, in the reverse order of their creation.
+ */
+class AllocationScope {
+public:
+  AllocationScope(AllocationCounts& counts);
+  ~AllocationScope();
+
+private:
+  AllocationCounts* const previous_;
+};
+
+} // namespace Memory
+} // namespace Envoy
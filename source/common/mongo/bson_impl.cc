@@ -1,8 +1,10 @@
 #include "common/mongo/bson_impl.h"
 
 #include <cstdint>
+#include <cstring>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "common/common/assert.h"
 #include "common/common/byte_order.h"
@@ -355,130 +357,293 @@ std::string FieldImpl::toString() const {
   NOT_REACHED;
 }
 
-void DocumentImpl::fromBuffer(Buffer::Instance& data) {
+namespace {
+
+int32_t readInt32(const uint8_t* data) {
+  int32_t val;
+  std::memcpy(reinterpret_cast<void*>(&val), data, sizeof(int32_t));
+  return le32toh(val);
+}
+
+int64_t readInt64(const uint8_t* data) {
+  int64_t val;
+  std::memcpy(reinterpret_cast<void*>(&val), data, sizeof(int64_t));
+  return le64toh(val);
+}
+
+double readDouble(const uint8_t* data) {
+  // See BufferHelper::removeDouble().
+  union {
+    int64_t i;
+    double d;
+  } memory;
+
+  static_assert(sizeof(memory.i) == sizeof(memory.d), "invalid type size");
+  memory.i = readInt64(data);
+  return memory.d;
+}
+
+// Find the end of the CString at the offset, within the first length bytes of the data.
+uint32_t cStringEnd(const uint8_t* data, uint32_t offset, uint32_t length) {
+  const void* end = std::memchr(data + offset, '\0', length - offset);
+  if (!end) {
+    throw EnvoyException("invalid CString");
+  }
+
+  return static_cast<const uint8_t*>(end) - data;
+}
+
+// Check that there are size more bytes at the offset, within the first length bytes of the data.
+void checkSize(uint32_t offset, uint64_t size, uint32_t length) {
+  if (offset + size > length) {
+    throw EnvoyException("invalid buffer size");
+  }
+}
+
+} // namespace
+
+DocumentSharedPtr DocumentImpl::create(Buffer::Instance& data) {
   uint64_t original_buffer_length = data.length();
-  int32_t message_length = BufferHelper::removeInt32(data);
-  if (static_cast<uint64_t>(message_length) > original_buffer_length) {
+  int32_t message_length = BufferHelper::peakInt32(data);
+  if (message_length < static_cast<int32_t>(sizeof(int32_t) + 1) ||
+      static_cast<uint64_t>(message_length) > original_buffer_length) {
     throw EnvoyException("invalid BSON message length");
   }
 
   ENVOY_LOG(trace, "BSON document length: {} data length: {}", message_length,
             original_buffer_length);
 
+  // The document is checked and indexed before it is drained, so that it is only copied once.
+  const uint8_t* start = static_cast<const uint8_t*>(data.linearize(message_length));
+  std::vector<RawField> fields;
+  index(start, message_length, &fields, true);
+
+  std::shared_ptr<const std::string> raw{
+      new std::string(reinterpret_cast<const char*>(start), message_length)};
+  data.drain(message_length);
+
+  std::shared_ptr<DocumentImpl> new_doc{new DocumentImpl(raw, 0, message_length)};
+  new_doc->raw_fields_.swap(fields);
+  new_doc->parsed_fields_.resize(new_doc->raw_fields_.size());
+  return new_doc;
+}
+
+DocumentImpl::DocumentImpl(std::shared_ptr<const std::string> raw, uint32_t raw_offset,
+                           uint32_t raw_length)
+    : raw_(raw), raw_offset_(raw_offset), raw_length_(raw_length) {}
+
+void DocumentImpl::index(const uint8_t* data, uint32_t length, std::vector<RawField>* fields,
+                         bool check_nested) {
+  uint32_t offset = sizeof(int32_t);
   while (true) {
-    uint64_t document_bytes_remaining = data.length() - (original_buffer_length - message_length);
-    ENVOY_LOG(trace, "BSON document bytes remaining: {}", document_bytes_remaining);
-    if (document_bytes_remaining == 1) {
-      uint8_t last_byte = BufferHelper::removeByte(data);
-      if (last_byte != 0) {
+    ENVOY_LOG(trace, "BSON document bytes remaining: {}", length - offset);
+    if (length - offset == 1) {
+      if (data[offset] != 0) {
         throw EnvoyException("invalid document");
       }
 
       return;
     }
 
-    uint8_t element_type = BufferHelper::removeByte(data);
-    std::string key = BufferHelper::removeCString(data);
-    ENVOY_LOG(trace, "BSON element type: {:#x} key: {}", element_type, key);
-    switch (static_cast<Field::Type>(element_type)) {
-    case Field::Type::DOUBLE: {
-      double value = BufferHelper::removeDouble(data);
-      ENVOY_LOG(trace, "BSON double: {}", value);
-      addDouble(key, value);
+    // The last byte of the document is the terminator.
+    const uint32_t fields_length = length - 1;
+    checkSize(offset, 1, fields_length);
+    RawField field;
+    field.type_ = static_cast<Field::Type>(data[offset]);
+    field.key_offset_ = offset + 1;
+    field.key_size_ = cStringEnd(data, field.key_offset_, fields_length) - field.key_offset_;
+    field.value_offset_ = field.key_offset_ + field.key_size_ + 1;
+
+    offset = field.value_offset_;
+    switch (field.type_) {
+    case Field::Type::DOUBLE:
+    case Field::Type::DATETIME:
+    case Field::Type::TIMESTAMP:
+    case Field::Type::INT64: {
+      checkSize(offset, sizeof(int64_t), fields_length);
+      offset += sizeof(int64_t);
       break;
     }
 
     case Field::Type::STRING: {
-      std::string value = BufferHelper::removeString(data);
-      ENVOY_LOG(trace, "BSON string: {}", value);
-      addString(key, std::move(value));
-      break;
-    }
+      checkSize(offset, sizeof(int32_t), fields_length);
+      const int32_t string_length = readInt32(data + offset);
+      if (string_length < 1) {
+        throw EnvoyException("invalid BSON string length");
+      }
 
-    case Field::Type::DOCUMENT: {
-      ENVOY_LOG(trace, "BSON document");
-      addDocument(key, DocumentImpl::create(data));
+      offset += sizeof(int32_t);
+      checkSize(offset, string_length, fields_length);
+      offset += string_length;
       break;
     }
 
+    case Field::Type::DOCUMENT:
     case Field::Type::ARRAY: {
-      ENVOY_LOG(trace, "BSON array");
-      addArray(key, DocumentImpl::create(data));
+      checkSize(offset, sizeof(int32_t), fields_length);
+      const int32_t document_length = readInt32(data + offset);
+      if (document_length < static_cast<int32_t>(sizeof(int32_t) + 1)) {
+        throw EnvoyException("invalid BSON message length");
+      }
+
+      checkSize(offset, document_length, fields_length);
+      if (check_nested) {
+        index(data + offset, document_length, nullptr, true);
+      }
+      offset += document_length;
       break;
     }
 
     case Field::Type::BINARY: {
-      std::string value = BufferHelper::removeBinary(data);
-      ENVOY_LOG(trace, "BSON binary: {}", value);
-      addBinary(key, std::move(value));
+      checkSize(offset, sizeof(int32_t) + 1, fields_length);
+      const int32_t binary_length = readInt32(data + offset);
+      if (binary_length < 0) {
+        throw EnvoyException("invalid BSON binary length");
+      }
+
+      offset += sizeof(int32_t) + 1;
+      checkSize(offset, binary_length, fields_length);
+      offset += binary_length;
       break;
     }
 
     case Field::Type::OBJECT_ID: {
-      Field::ObjectId value;
-      BufferHelper::removeBytes(data, &value[0], value.size());
-      addObjectId(key, std::move(value));
+      checkSize(offset, sizeof(Field::ObjectId), fields_length);
+      offset += sizeof(Field::ObjectId);
       break;
     }
 
     case Field::Type::BOOLEAN: {
-      bool value = BufferHelper::removeByte(data) != 0;
-      ENVOY_LOG(trace, "BSON boolean: {}", value);
-      addBoolean(key, value);
-      break;
-    }
-
-    case Field::Type::DATETIME: {
-      int64_t value = BufferHelper::removeInt64(data);
-      ENVOY_LOG(trace, "BSON datetime: {}", value);
-      addDatetime(key, value);
+      checkSize(offset, 1, fields_length);
+      offset += 1;
       break;
     }
 
     case Field::Type::NULL_VALUE: {
-      ENVOY_LOG(trace, "BSON null value");
-      addNull(key);
       break;
     }
 
     case Field::Type::REGEX: {
-      Field::Regex value;
-      value.pattern_ = BufferHelper::removeCString(data);
-      value.options_ = BufferHelper::removeCString(data);
-      ENVOY_LOG(trace, "BSON regex pattern: {} options: {}", value.pattern_, value.options_);
-      addRegex(key, std::move(value));
+      offset = cStringEnd(data, offset, fields_length) + 1;
+      offset = cStringEnd(data, offset, fields_length) + 1;
       break;
     }
 
     case Field::Type::INT32: {
-      int32_t value = BufferHelper::removeInt32(data);
-      ENVOY_LOG(trace, "BSON int32: {}", value);
-      addInt32(key, value);
+      checkSize(offset, sizeof(int32_t), fields_length);
+      offset += sizeof(int32_t);
       break;
     }
 
-    case Field::Type::TIMESTAMP: {
-      int64_t value = BufferHelper::removeInt64(data);
-      ENVOY_LOG(trace, "BSON timestamp: {}", value);
-      addTimestamp(key, value);
-      break;
+    default:
+      throw EnvoyException(fmt::format(
+          "invalid BSON element type: {:#x} key: {}", static_cast<uint8_t>(field.type_),
+          std::string(reinterpret_cast<const char*>(data + field.key_offset_), field.key_size_)));
     }
 
-    case Field::Type::INT64: {
-      int64_t value = BufferHelper::removeInt64(data);
-      ENVOY_LOG(trace, "BSON int64: {}", value);
-      addInt64(key, value);
-      break;
+    if (fields) {
+      fields->push_back(field);
     }
+  }
+}
 
-    default:
-      throw EnvoyException(
-          fmt::format("invalid BSON element type: {:#x} key: {}", element_type, key));
-    }
+FieldPtr DocumentImpl::parseField(const RawField& field) const {
+  const uint8_t* data = rawData();
+  const std::string key(reinterpret_cast<const char*>(data + field.key_offset_), field.key_size_);
+  const uint8_t* value = data + field.value_offset_;
+  switch (field.type_) {
+  case Field::Type::DOUBLE: {
+    return FieldPtr{new FieldImpl(key, readDouble(value))};
+  }
+
+  case Field::Type::STRING: {
+    // The string ends at its first null byte, like a CString.
+    const char* start = reinterpret_cast<const char*>(value + sizeof(int32_t));
+    std::string string_value(start, strnlen(start, readInt32(value)));
+    return FieldPtr{new FieldImpl(Field::Type::STRING, key, std::move(string_value))};
+  }
+
+  case Field::Type::DOCUMENT:
+  case Field::Type::ARRAY: {
+    const uint32_t document_length = readInt32(value);
+    std::shared_ptr<DocumentImpl> document{
+        new DocumentImpl(raw_, raw_offset_ + field.value_offset_, document_length)};
+    // The nested documents were checked with this one.
+    index(value, document_length, &document->raw_fields_, false);
+    document->parsed_fields_.resize(document->raw_fields_.size());
+    return FieldPtr{new FieldImpl(field.type_, key, document)};
+  }
+
+  case Field::Type::BINARY: {
+    // The subtype is not stored for now.
+    std::string binary_value(reinterpret_cast<const char*>(value + sizeof(int32_t) + 1),
+                             readInt32(value));
+    return FieldPtr{new FieldImpl(Field::Type::BINARY, key, std::move(binary_value))};
+  }
+
+  case Field::Type::OBJECT_ID: {
+    Field::ObjectId object_id;
+    std::memcpy(&object_id[0], value, object_id.size());
+    return FieldPtr{new FieldImpl(key, std::move(object_id))};
+  }
+
+  case Field::Type::BOOLEAN: {
+    return FieldPtr{new FieldImpl(key, *value != 0)};
+  }
+
+  case Field::Type::DATETIME:
+  case Field::Type::TIMESTAMP:
+  case Field::Type::INT64: {
+    return FieldPtr{new FieldImpl(field.type_, key, readInt64(value))};
+  }
+
+  case Field::Type::NULL_VALUE: {
+    return FieldPtr{new FieldImpl(key)};
+  }
+
+  case Field::Type::REGEX: {
+    Field::Regex regex;
+    regex.pattern_ = reinterpret_cast<const char*>(value);
+    regex.options_ = reinterpret_cast<const char*>(value + regex.pattern_.size() + 1);
+    return FieldPtr{new FieldImpl(key, std::move(regex))};
+  }
+
+  case Field::Type::INT32: {
+    return FieldPtr{new FieldImpl(key, readInt32(value))};
+  }
   }
+
+  NOT_REACHED;
+}
+
+bool DocumentImpl::rawKeyEquals(const RawField& field, const std::string& name) const {
+  return field.key_size_ == name.size() &&
+         std::memcmp(rawData() + field.key_offset_, name.data(), name.size()) == 0;
+}
+
+const Field* DocumentImpl::parsedField(size_t index) const {
+  if (!parsed_fields_[index]) {
+    parsed_fields_[index] = parseField(raw_fields_[index]);
+  }
+
+  return parsed_fields_[index].get();
+}
+
+void DocumentImpl::parseAll() const {
+  for (size_t i = 0; i < raw_fields_.size(); i++) {
+    parsedField(i);
+    fields_.emplace_back(std::move(parsed_fields_[i]));
+  }
+
+  raw_fields_.clear();
+  parsed_fields_.clear();
 }
 
 int32_t DocumentImpl::byteSize() const {
+  if (raw_) {
+    return raw_length_;
+  }
+
   // Minimum size is 5.
   int32_t total_size = sizeof(int32_t) + 1;
   for (const FieldPtr& field : fields_) {
@@ -489,6 +654,11 @@ int32_t DocumentImpl::byteSize() const {
 }
 
 void DocumentImpl::encode(Buffer::Instance& output) const {
+  if (raw_) {
+    output.add(rawData(), raw_length_);
+    return;
+  }
+
   BufferHelper::writeInt32(output, byteSize());
   for (const FieldPtr& field : fields_) {
     field->encode(output);
@@ -519,7 +689,7 @@ std::string DocumentImpl::toString() const {
   out << "{";
 
   bool first = true;
-  for (const FieldPtr& field : fields_) {
+  for (const FieldPtr& field : values()) {
     if (!first) {
       out << ", ";
     }
@@ -533,6 +703,12 @@ std::string DocumentImpl::toString() const {
 }
 
 const Field* DocumentImpl::find(const std::string& name) const {
+  for (size_t i = 0; i < raw_fields_.size(); i++) {
+    if (rawKeyEquals(raw_fields_[i], name)) {
+      return parsedField(i);
+    }
+  }
+
   for (const FieldPtr& field : fields_) {
     if (field->key() == name) {
       return field.get();
@@ -543,6 +719,12 @@ const Field* DocumentImpl::find(const std::string& name) const {
 }
 
 const Field* DocumentImpl::find(const std::string& name, Field::Type type) const {
+  for (size_t i = 0; i < raw_fields_.size(); i++) {
+    if (raw_fields_[i].type_ == type && rawKeyEquals(raw_fields_[i], name)) {
+      return parsedField(i);
+    }
+  }
+
   for (const FieldPtr& field : fields_) {
     if (field->key() == name && field->type() == type) {
       return field.get();
@@ -3,6 +3,7 @@
 #include <list>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "envoy/buffer/buffer.h"
 #include "envoy/common/exception.h"
@@ -168,81 +169,70 @@ private:
   Value value_;
 };
 
+/**
+ * A BSON document. A document that is decoded from a buffer keeps its encoded bytes, and only
+ * indexes where its fields are while it is decoded. A field is only parsed when it is found, and
+ * all of them are when the values are listed. Nested documents share the bytes of the top level
+ * document. The bytes are dropped once the document is modified.
+ */
 class DocumentImpl : public Document,
                      Logger::Loggable<Logger::Id::mongo>,
                      public std::enable_shared_from_this<DocumentImpl> {
 public:
   static DocumentSharedPtr create() { return DocumentSharedPtr{new DocumentImpl()}; }
-  static DocumentSharedPtr create(Buffer::Instance& data) {
-    std::shared_ptr<DocumentImpl> new_doc{new DocumentImpl()};
-    new_doc->fromBuffer(data);
-    return new_doc;
-  }
+  static DocumentSharedPtr create(Buffer::Instance& data);
 
   // Mongo::Document
   DocumentSharedPtr addDouble(const std::string& key, double value) override {
-    fields_.emplace_back(new FieldImpl(key, value));
-    return shared_from_this();
+    return addField(new FieldImpl(key, value));
   }
 
   DocumentSharedPtr addString(const std::string& key, std::string&& value) override {
-    fields_.emplace_back(new FieldImpl(Field::Type::STRING, key, std::move(value)));
-    return shared_from_this();
+    return addField(new FieldImpl(Field::Type::STRING, key, std::move(value)));
   }
 
   DocumentSharedPtr addDocument(const std::string& key, DocumentSharedPtr value) override {
-    fields_.emplace_back(new FieldImpl(Field::Type::DOCUMENT, key, value));
-    return shared_from_this();
+    return addField(new FieldImpl(Field::Type::DOCUMENT, key, value));
   }
 
   DocumentSharedPtr addArray(const std::string& key, DocumentSharedPtr value) override {
-    fields_.emplace_back(new FieldImpl(Field::Type::ARRAY, key, value));
-    return shared_from_this();
+    return addField(new FieldImpl(Field::Type::ARRAY, key, value));
   }
 
   DocumentSharedPtr addBinary(const std::string& key, std::string&& value) override {
-    fields_.emplace_back(new FieldImpl(Field::Type::BINARY, key, std::move(value)));
-    return shared_from_this();
+    return addField(new FieldImpl(Field::Type::BINARY, key, std::move(value)));
   }
 
   DocumentSharedPtr addObjectId(const std::string& key, Field::ObjectId&& value) override {
-    fields_.emplace_back(new FieldImpl(key, std::move(value)));
-    return shared_from_this();
+    return addField(new FieldImpl(key, std::move(value)));
   }
 
   DocumentSharedPtr addBoolean(const std::string& key, bool value) override {
-    fields_.emplace_back(new FieldImpl(key, value));
-    return shared_from_this();
+    return addField(new FieldImpl(key, value));
   }
 
   DocumentSharedPtr addDatetime(const std::string& key, int64_t value) override {
-    fields_.emplace_back(new FieldImpl(Field::Type::DATETIME, key, value));
-    return shared_from_this();
+    return addField(new FieldImpl(Field::Type::DATETIME, key, value));
   }
 
   DocumentSharedPtr addNull(const std::string& key) override {
-    fields_.emplace_back(new FieldImpl(key));
-    return shared_from_this();
+    return addField(new FieldImpl(key));
   }
 
   DocumentSharedPtr addRegex(const std::string& key, Field::Regex&& value) override {
-    fields_.emplace_back(new FieldImpl(key, std::move(value)));
-    return shared_from_this();
+    return addField(new FieldImpl(key, std::move(value)));
   }
 
   DocumentSharedPtr addInt32(const std::string& key, int32_t value) override {
-    fields_.emplace_back(new FieldImpl(key, value));
-    return shared_from_this();
+    return addField(new FieldImpl(key, value));
   }
 
   DocumentSharedPtr addTimestamp(const std::string& key, int64_t value) override {
-    fields_.emplace_back(new FieldImpl(Field::Type::TIMESTAMP, key, value));
-    return shared_from_this();
+    return addField(new FieldImpl(Field::Type::TIMESTAMP, key, value));
   }
 
   DocumentSharedPtr addInt64(const std::string& key, int64_t value) override {
-    fields_.emplace_back(new FieldImpl(Field::Type::INT64, key, value));
-    return shared_from_this();
+    return addField(new FieldImpl(Field::Type::INT64, key, value));
   }
 
   bool operator==(const Document& rhs) const override;
@@ -251,14 +241,58 @@ public:
   const Field* find(const std::string& name) const override;
   const Field* find(const std::string& name, Field::Type type) const override;
   std::string toString() const override;
-  const std::list<FieldPtr>& values() const override { return fields_; }
+  const std::list<FieldPtr>& values() const override {
+    parseAll();
+    return fields_;
+  }
 
 private:
+  /**
+   * Where a field that is not parsed yet is in the encoded bytes of its document.
+   */
+  struct RawField {
+    Field::Type type_;
+    uint32_t key_offset_;
+    uint32_t key_size_;
+    uint32_t value_offset_;
+  };
+
   DocumentImpl() {}
+  DocumentImpl(std::shared_ptr<const std::string> raw, uint32_t raw_offset, uint32_t raw_length);
 
-  void fromBuffer(Buffer::Instance& data);
+  DocumentSharedPtr addField(FieldImpl* field) {
+    parseAll();
+    raw_.reset();
+    fields_.emplace_back(field);
+    return shared_from_this();
+  }
 
-  std::list<FieldPtr> fields_;
+  /**
+   * Check the encoding of a document and find where its fields are.
+   * @param data supplies the encoded document.
+   * @param length supplies the length of the document, as read from the document.
+   * @param fields supplies where to add the fields, or nullptr to only check the document.
+   * @param check_nested supplies whether to check the nested documents too.
+   */
+  static void index(const uint8_t* data, uint32_t length, std::vector<RawField>* fields,
+                    bool check_nested);
+  const uint8_t* rawData() const {
+    return reinterpret_cast<const uint8_t*>(raw_->data()) + raw_offset_;
+  }
+  bool rawKeyEquals(const RawField& field, const std::string& name) const;
+  FieldPtr parseField(const RawField& field) const;
+  const Field* parsedField(size_t index) const;
+  void parseAll() const;
+
+  // The parsed fields, in order, once all of them are parsed.
+  mutable std::list<FieldPtr> fields_;
+  // The encoded document while it is not modified.
+  std::shared_ptr<const std::string> raw_;
+  uint32_t raw_offset_{};
+  uint32_t raw_length_{};
+  // The fields, and the ones that were found, until all of them are parsed.
+  mutable std::vector<RawField> raw_fields_;
+  mutable std::vector<FieldPtr> parsed_fields_;
 };
 
 } // namespace Bson
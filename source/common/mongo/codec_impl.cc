@@ -229,6 +229,9 @@ bool DecoderImpl::decode(Buffer::Instance& data) {
 
   uint32_t message_length = Bson::BufferHelper::peakInt32(data);
   ENVOY_LOG(trace, "message is {} bytes", message_length);
+  if (message_length < 16) {
+    throw EnvoyException(fmt::format("invalid mongo message length {}", message_length));
+  }
   if (data.length() < message_length) {
     return false;
   }
@@ -243,6 +246,23 @@ bool DecoderImpl::decode(Buffer::Instance& data) {
   // parsed off before passing the final value.
   message_length -= 16;
 
+  switch (op_code) {
+  case Message::OpCode::OP_REPLY:
+  case Message::OpCode::OP_QUERY:
+  case Message::OpCode::OP_GET_MORE:
+  case Message::OpCode::OP_INSERT:
+  case Message::OpCode::OP_KILL_CURSORS:
+    break;
+  default:
+    throw EnvoyException(fmt::format("invalid mongo op {}", static_cast<int32_t>(op_code)));
+  }
+
+  if (!callbacks_.decodeHeader(request_id, response_to, op_code)) {
+    ENVOY_LOG(trace, "skipping message");
+    data.drain(message_length);
+    return true;
+  }
+
   switch (op_code) {
   case Message::OpCode::OP_REPLY: {
     std::unique_ptr<ReplyMessageImpl> message(new ReplyMessageImpl(request_id, response_to));
@@ -281,7 +301,7 @@ bool DecoderImpl::decode(Buffer::Instance& data) {
   }
 
   default:
-    throw EnvoyException(fmt::format("invalid mongo op {}", static_cast<int32_t>(op_code)));
+    NOT_REACHED;
   }
 
   ENVOY_LOG(trace, "{} bytes remaining after decoding", data.length());
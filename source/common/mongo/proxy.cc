@@ -51,6 +51,28 @@ ProxyFilter::ProxyFilter(const std::string& stat_prefix, Stats::Scope& scope,
 
 ProxyFilter::~ProxyFilter() { ASSERT(!delay_timer_); }
 
+bool ProxyFilter::decodeHeader(int32_t, int32_t response_to, Message::OpCode op_code) {
+  if (op_code == Message::OpCode::OP_REPLY) {
+    // The replies to the decoded queries are always decoded, so that the queries are complete.
+    for (const ActiveQueryPtr& active_query : active_query_list_) {
+      if (active_query->query_info_.requestId() == response_to) {
+        return true;
+      }
+    }
+  }
+
+  if (runtime_.snapshot().featureEnabled(MongoRuntimeConfig::get().DecodingEnabled, 100)) {
+    return true;
+  }
+
+  stats_.decoding_skipped_.inc();
+  if (op_code != Message::OpCode::OP_REPLY) {
+    // Faults are injected into the requests that are not decoded too.
+    tryInjectDelay();
+  }
+  return false;
+}
+
 void ProxyFilter::decodeGetMore(GetMoreMessagePtr&& message) {
   tryInjectDelay();
 
@@ -64,7 +86,10 @@ void ProxyFilter::decodeInsert(InsertMessagePtr&& message) {
 
   stats_.op_insert_.inc();
   logMessage(*message, true);
-  ENVOY_LOG(debug, "decoded INSERT: {}", message->toString(true));
+  // Formatting the documents parses all of their fields.
+  if (ENVOY_LOG_ENABLED(debug)) {
+    ENVOY_LOG(debug, "decoded INSERT: {}", message->toString(true));
+  }
 }
 
 void ProxyFilter::decodeKillCursors(KillCursorsMessagePtr&& message) {
@@ -80,7 +105,9 @@ void ProxyFilter::decodeQuery(QueryMessagePtr&& message) {
 
   stats_.op_query_.inc();
   logMessage(*message, true);
-  ENVOY_LOG(debug, "decoded QUERY: {}", message->toString(true));
+  if (ENVOY_LOG_ENABLED(debug)) {
+    ENVOY_LOG(debug, "decoded QUERY: {}", message->toString(true));
+  }
 
   if (message->flags() & QueryMessage::Flags::TailableCursor) {
     stats_.op_query_tailable_cursor_.inc();
@@ -142,7 +169,9 @@ void ProxyFilter::chargeQueryStats(const std::string& prefix,
 void ProxyFilter::decodeReply(ReplyMessagePtr&& message) {
   stats_.op_reply_.inc();
   logMessage(*message, false);
-  ENVOY_LOG(debug, "decoded REPLY: {}", message->toString(true));
+  if (ENVOY_LOG_ENABLED(debug)) {
+    ENVOY_LOG(debug, "decoded REPLY: {}", message->toString(true));
+  }
 
   if (message->cursorId() != 0) {
     stats_.op_reply_valid_cursor_.inc();
@@ -33,6 +33,7 @@ public:
   const std::string LoggingEnabled{"mongo.logging_enabled"};
   const std::string ProxyEnabled{"mongo.proxy_enabled"};
   const std::string ConnectionLoggingEnabled{"mongo.connection_logging_enabled"};
+  const std::string DecodingEnabled{"mongo.decoding_enabled"};
 };
 
 typedef ConstSingleton<MongoRuntimeConfigKeys> MongoRuntimeConfig;
@@ -43,6 +44,7 @@ typedef ConstSingleton<MongoRuntimeConfigKeys> MongoRuntimeConfig;
 // clang-format off
 #define ALL_MONGO_PROXY_STATS(COUNTER, GAUGE, TIMER)                                               \
   COUNTER(decoding_error)                                                                          \
+  COUNTER(decoding_skipped)                                                                        \
   COUNTER(delays_injected)                                                                         \
   COUNTER(op_get_more)                                                                             \
   COUNTER(op_insert)                                                                               \
@@ -110,7 +112,8 @@ typedef std::shared_ptr<const FaultConfig> FaultConfigSharedPtr;
 
 /**
  * A sniffing filter for mongo traffic. The current implementation makes a copy of read/written
- * data, decodes it, and generates stats.
+ * data, decodes it, and generates stats. Only a runtime controlled fraction of the messages may be
+ * decoded, the others are skipped once their header is decoded.
  */
 class ProxyFilter : public Network::Filter,
                     public DecoderCallbacks,
@@ -135,6 +138,7 @@ public:
   Network::FilterStatus onWrite(Buffer::Instance& data) override;
 
   // Mongo::DecoderCallback
+  bool decodeHeader(int32_t request_id, int32_t response_to, Message::OpCode op_code) override;
   void decodeGetMore(GetMoreMessagePtr&& message) override;
   void decodeInsert(InsertMessagePtr&& message) override;
   void decodeKillCursors(KillCursorsMessagePtr&& message) override;
@@ -119,12 +119,15 @@ int InstanceBase::socketFromSocketType(SocketType socketType) const {
   return fd;
 }
 
+std::string Ipv4Instance::Ipv4Helper::makeFriendlyAddress() const {
+  char str[INET_ADDRSTRLEN];
+  const char* ptr = inet_ntop(AF_INET, &address_.sin_addr, str, INET_ADDRSTRLEN);
+  ASSERT(str == ptr);
+  return ptr;
+}
+
 Ipv4Instance::Ipv4Instance(const sockaddr_in* address) : InstanceBase(Type::Ip) {
   ip_.ipv4_.address_ = *address;
-  char str[INET_ADDRSTRLEN];
-  inet_ntop(AF_INET, &address->sin_addr, str, INET_ADDRSTRLEN);
-  friendly_name_ = fmt::format("{}:{}", str, ntohs(address->sin_port));
-  ip_.friendly_address_ = str;
 }
 
 Ipv4Instance::Ipv4Instance(const std::string& address) : Ipv4Instance(address, 0) {}
@@ -137,9 +140,6 @@ Ipv4Instance::Ipv4Instance(const std::string& address, uint32_t port) : Instance
   if (1 != rc) {
     throw EnvoyException(fmt::format("invalid ipv4 address '{}'", address));
   }
-
-  friendly_name_ = fmt::format("{}:{}", address, port);
-  ip_.friendly_address_ = address;
 }
 
 Ipv4Instance::Ipv4Instance(uint32_t port) : InstanceBase(Type::Ip) {
@@ -147,8 +147,12 @@ Ipv4Instance::Ipv4Instance(uint32_t port) : InstanceBase(Type::Ip) {
   ip_.ipv4_.address_.sin_family = AF_INET;
   ip_.ipv4_.address_.sin_port = htons(port);
   ip_.ipv4_.address_.sin_addr.s_addr = INADDR_ANY;
-  friendly_name_ = fmt::format("0.0.0.0:{}", port);
-  ip_.friendly_address_ = "0.0.0.0";
+}
+
+bool Ipv4Instance::operator==(const Instance& rhs) const {
+  const Ip* rhs_ip = rhs.ip();
+  return rhs_ip != nullptr && rhs_ip->version() == IpVersion::v4 &&
+         rhs_ip->ipv4()->address() == ip_.ipv4_.address() && rhs_ip->port() == ip_.port();
 }
 
 int Ipv4Instance::bind(int fd) const {
@@ -163,6 +167,10 @@ int Ipv4Instance::connect(int fd) const {
 
 int Ipv4Instance::socket(SocketType type) const { return socketFromSocketType(type); }
 
+std::string Ipv4Instance::formatFriendlyName() const {
+  return fmt::format("{}:{}", ip_.addressAsString(), ip_.port());
+}
+
 std::array<uint8_t, 16> Ipv6Instance::Ipv6Helper::address() const {
   std::array<uint8_t, 16> result;
   std::copy(std::begin(address_.sin6_addr.s6_addr), std::end(address_.sin6_addr.s6_addr),
@@ -181,8 +189,6 @@ std::string Ipv6Instance::Ipv6Helper::makeFriendlyAddress() const {
 
 Ipv6Instance::Ipv6Instance(const sockaddr_in6& address) : InstanceBase(Type::Ip) {
   ip_.ipv6_.address_ = address;
-  ip_.friendly_address_ = ip_.ipv6_.makeFriendlyAddress();
-  friendly_name_ = fmt::format("[{}]:{}", ip_.friendly_address_, ip_.port());
 }
 
 Ipv6Instance::Ipv6Instance(const std::string& address) : Ipv6Instance(address, 0) {}
@@ -198,13 +204,16 @@ Ipv6Instance::Ipv6Instance(const std::string& address, uint32_t port) : Instance
   } else {
     ip_.ipv6_.address_.sin6_addr = in6addr_any;
   }
-  // Just in case address is in a non-canonical format, format from network address.
-  ip_.friendly_address_ = ip_.ipv6_.makeFriendlyAddress();
-  friendly_name_ = fmt::format("[{}]:{}", ip_.friendly_address_, ip_.port());
 }
 
 Ipv6Instance::Ipv6Instance(uint32_t port) : Ipv6Instance("", port) {}
 
+bool Ipv6Instance::operator==(const Instance& rhs) const {
+  const Ip* rhs_ip = rhs.ip();
+  return rhs_ip != nullptr && rhs_ip->version() == IpVersion::v6 &&
+         rhs_ip->ipv6()->address() == ip_.ipv6_.address() && rhs_ip->port() == ip_.port();
+}
+
 int Ipv6Instance::bind(int fd) const {
   return ::bind(fd, reinterpret_cast<const sockaddr*>(&ip_.ipv6_.address_),
                 sizeof(ip_.ipv6_.address_));
@@ -224,19 +233,21 @@ int Ipv6Instance::socket(SocketType type) const {
   return fd;
 }
 
+std::string Ipv6Instance::formatFriendlyName() const {
+  return fmt::format("[{}]:{}", ip_.addressAsString(), ip_.port());
+}
+
 PipeInstance::PipeInstance(const sockaddr_un* address) : InstanceBase(Type::Pipe) {
   if (address->sun_path[0] == '\0') {
     throw EnvoyException("Abstract AF_UNIX sockets not supported.");
   }
   address_ = *address;
-  friendly_name_ = address_.sun_path;
 }
 
 PipeInstance::PipeInstance(const std::string& pipe_path) : InstanceBase(Type::Pipe) {
   memset(&address_, 0, sizeof(address_));
   address_.sun_family = AF_UNIX;
   StringUtil::strlcpy(&address_.sun_path[0], pipe_path.c_str(), sizeof(address_.sun_path));
-  friendly_name_ = address_.sun_path;
 }
 
 int PipeInstance::bind(int fd) const {
@@ -7,6 +7,7 @@
 
 #include <array>
 #include <cstdint>
+#include <mutex>
 #include <string>
 
 #include "envoy/network/address.h"
@@ -47,17 +48,29 @@ class InstanceBase : public Instance {
 public:
   // Network::Address::Instance
   bool operator==(const Instance& rhs) const override { return asString() == rhs.asString(); }
-  const std::string& asString() const override { return friendly_name_; }
+  const std::string& asString() const override {
+    std::call_once(friendly_name_once_,
+                   [this]() -> void { friendly_name_ = formatFriendlyName(); });
+    return friendly_name_;
+  }
   Type type() const override { return type_; }
 
 protected:
   InstanceBase(Type type) : type_(type) {}
+  // The cached name is deliberately not copied, since a once flag cannot be.
+  InstanceBase(const InstanceBase& other) : Instance(other), type_(other.type_) {}
   int socketFromSocketType(SocketType type) const;
 
-  std::string friendly_name_;
+  /**
+   * Format the name returned by asString(). This is only done the first time the name is needed,
+   * since most addresses, such as those of accepted connections, are never printed.
+   */
+  virtual std::string formatFriendlyName() const PURE;
 
 private:
   const Type type_;
+  mutable std::once_flag friendly_name_once_;
+  mutable std::string friendly_name_;
 };
 
 /**
@@ -87,6 +100,7 @@ public:
   explicit Ipv4Instance(uint32_t port);
 
   // Network::Address::Instance
+  bool operator==(const Instance& rhs) const override;
   int bind(int fd) const override;
   int connect(int fd) const override;
   const Ip* ip() const override { return &ip_; }
@@ -96,11 +110,21 @@ private:
   struct Ipv4Helper : public Ipv4 {
     uint32_t address() const override { return address_.sin_addr.s_addr; }
 
+    std::string makeFriendlyAddress() const;
+
     sockaddr_in address_;
   };
 
   struct IpHelper : public Ip {
-    const std::string& addressAsString() const override { return friendly_address_; }
+    IpHelper() {}
+    // The cached address string is deliberately not copied.
+    IpHelper(const IpHelper& other) : Ip(other), ipv4_(other.ipv4_) {}
+
+    const std::string& addressAsString() const override {
+      std::call_once(friendly_address_once_,
+                     [this]() -> void { friendly_address_ = ipv4_.makeFriendlyAddress(); });
+      return friendly_address_;
+    }
     bool isAnyAddress() const override { return ipv4_.address_.sin_addr.s_addr == INADDR_ANY; }
     bool isUnicastAddress() const override {
       return !isAnyAddress() && (ipv4_.address_.sin_addr.s_addr != INADDR_BROADCAST) &&
@@ -113,9 +137,13 @@ private:
     IpVersion version() const override { return IpVersion::v4; }
 
     Ipv4Helper ipv4_;
-    std::string friendly_address_;
+    mutable std::once_flag friendly_address_once_;
+    mutable std::string friendly_address_;
   };
 
+  // InstanceBase
+  std::string formatFriendlyName() const override;
+
   IpHelper ip_;
 };
 
@@ -146,6 +174,7 @@ public:
   explicit Ipv6Instance(uint32_t port);
 
   // Network::Address::Instance
+  bool operator==(const Instance& rhs) const override;
   int bind(int fd) const override;
   int connect(int fd) const override;
   const Ip* ip() const override { return &ip_; }
@@ -162,7 +191,15 @@ private:
   };
 
   struct IpHelper : public Ip {
-    const std::string& addressAsString() const override { return friendly_address_; }
+    IpHelper() {}
+    // The cached address string is deliberately not copied.
+    IpHelper(const IpHelper& other) : Ip(other), ipv6_(other.ipv6_) {}
+
+    const std::string& addressAsString() const override {
+      std::call_once(friendly_address_once_,
+                     [this]() -> void { friendly_address_ = ipv6_.makeFriendlyAddress(); });
+      return friendly_address_;
+    }
     bool isAnyAddress() const override {
       return 0 == memcmp(&ipv6_.address_.sin6_addr, &in6addr_any, sizeof(struct in6_addr));
     }
@@ -175,9 +212,13 @@ private:
     IpVersion version() const override { return IpVersion::v6; }
 
     Ipv6Helper ipv6_;
-    std::string friendly_address_;
+    mutable std::once_flag friendly_address_once_;
+    mutable std::string friendly_address_;
   };
 
+  // InstanceBase
+  std::string formatFriendlyName() const override;
+
   IpHelper ip_;
 };
 
@@ -203,6 +244,9 @@ public:
   int socket(SocketType type) const override;
 
 private:
+  // InstanceBase
+  std::string formatFriendlyName() const override { return address_.sun_path; }
+
   sockaddr_un address_;
 };
 
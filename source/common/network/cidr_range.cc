@@ -14,6 +14,7 @@
 #include "common/common/assert.h"
 #include "common/common/utility.h"
 #include "common/network/address_impl.h"
+#include "common/network/lc_trie.h"
 #include "common/network/utility.h"
 
 #include "fmt/format.h"
@@ -224,24 +225,25 @@ InstanceConstSharedPtr CidrRange::truncateIpAddressAndLength(InstanceConstShared
 }
 
 IpList::IpList(const std::vector<std::string>& subnets) {
+  std::vector<CidrRange> ip_list;
   for (const std::string& entry : subnets) {
     CidrRange list_entry = CidrRange::create(entry);
     if (list_entry.isValid()) {
-      ip_list_.push_back(list_entry);
+      ip_list.push_back(list_entry);
     } else {
       throw EnvoyException(
           fmt::format("invalid ip/mask combo '{}' (format is <ip>/<# mask bits>)", entry));
     }
   }
+  if (!ip_list.empty()) {
+    // All of the ranges get the same (empty) tag, so that any match is a non empty tag list.
+    trie_ = std::make_shared<const LcTrie>(
+        std::vector<std::pair<std::string, std::vector<CidrRange>>>{{"", ip_list}});
+  }
 }
 
 bool IpList::contains(const Instance& address) const {
-  for (const CidrRange& entry : ip_list_) {
-    if (entry.isInRange(address)) {
-      return true;
-    }
-  }
-  return false;
+  return trie_ != nullptr && !trie_->getData(address).empty();
 }
 
 IpList::IpList(const Json::Object& config, const std::string& member_name)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -119,9 +120,12 @@ private:
   int length_;
 };
 
+class LcTrie;
+
 /**
  * Class for keeping a list of CidrRanges, and then determining whether an
- * IP address is in the CidrRange list.
+ * IP address is in the CidrRange list. The ranges are kept in an LcTrie, so lookups do not
+ * depend on the size of the list.
  */
 class IpList {
 public:
@@ -130,10 +134,11 @@ public:
   IpList(){};
 
   bool contains(const Instance& address) const;
-  bool empty() const { return ip_list_.empty(); }
+  bool empty() const { return trie_ == nullptr; }
 
 private:
-  std::vector<CidrRange> ip_list_;
+  // nullptr if the list is empty. Copies of the list share the immutable trie.
+  std::shared_ptr<const LcTrie> trie_;
 };
 
 } // namespace Address
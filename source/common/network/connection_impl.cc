@@ -1,10 +1,12 @@
 #include "common/network/connection_impl.h"
 
+#include <fcntl.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 
@@ -32,6 +34,24 @@ Address::InstanceConstSharedPtr getNullLocalAddress(const Address::Instance& add
   // Default to IPv4 any address.
   return Utility::getIpv4AnyAddress();
 }
+
+#ifdef __linux__
+int openPipe(int fds[2]) { return ::pipe2(fds, O_NONBLOCK | O_CLOEXEC); }
+
+ssize_t spliceFd(int from, int to, size_t length) {
+  return ::splice(from, nullptr, to, nullptr, length, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+}
+#else
+int openPipe(int[2]) {
+  errno = ENOSYS;
+  return -1;
+}
+
+ssize_t spliceFd(int, int, size_t) {
+  errno = ENOSYS;
+  return -1;
+}
+#endif
 } // namespace
 
 void ConnectionImplUtility::updateBufferStats(uint64_t delta, uint64_t new_total,
@@ -53,6 +73,9 @@ void ConnectionImplUtility::updateBufferStats(uint64_t delta, uint64_t new_total
 }
 
 std::atomic<uint64_t> ConnectionImpl::next_global_id_;
+const uint64_t ConnectionImpl::INITIAL_READ_SIZE;
+const uint64_t ConnectionImpl::MIN_READ_SIZE;
+const uint64_t ConnectionImpl::MAX_READ_SIZE;
 
 ConnectionImpl::ConnectionImpl(Event::DispatcherImpl& dispatcher, int fd,
                                Address::InstanceConstSharedPtr remote_address,
@@ -63,7 +86,8 @@ ConnectionImpl::ConnectionImpl(Event::DispatcherImpl& dispatcher, int fd,
       write_buffer_(
           dispatcher.getWatermarkFactory().create([this]() -> void { this->onLowWatermark(); },
                                                   [this]() -> void { this->onHighWatermark(); })),
-      dispatcher_(dispatcher), fd_(fd), id_(++next_global_id_),
+      dispatcher_(dispatcher), read_budget_(dispatcher.connectionReadBudget()), fd_(fd),
+      id_(++next_global_id_),
       using_original_dst_(using_original_dst) {
 
   // Treat the lack of a valid fd (which in practice only happens if we run out of FDs) as an OOM
@@ -122,13 +146,13 @@ void ConnectionImpl::close(ConnectionCloseType type) {
     return;
   }
 
-  uint64_t data_to_write = write_buffer_->length();
+  uint64_t data_to_write = write_buffer_->length() + splice_pipe_length_;
   ENVOY_CONN_LOG(debug, "closing data_to_write={} type={}", *this, data_to_write, enumToInt(type));
   if (data_to_write == 0 || type == ConnectionCloseType::NoFlush) {
     if (data_to_write > 0) {
       // We aren't going to wait to flush, but try to write as much as we can if there is pending
       // data.
-      doWriteToSocket();
+      writePendingData();
     }
 
     closeSocket(ConnectionEvent::LocalClose);
@@ -163,6 +187,16 @@ void ConnectionImpl::closeSocket(ConnectionEvent close_type) {
   updateWriteBufferStats(0, 0);
   connection_stats_.reset();
 
+  if (splice_destination_ != nullptr) {
+    splice_destination_->splice_source_ = nullptr;
+    splice_destination_ = nullptr;
+  }
+  if (splice_source_ != nullptr) {
+    splice_source_->splice_destination_ = nullptr;
+    splice_source_ = nullptr;
+  }
+  closeSplicePipe();
+
   file_event_.reset();
   ::close(fd_);
   fd_ = -1;
@@ -281,6 +315,8 @@ bool ConnectionImpl::readEnabled() const { return state_ & InternalState::ReadEn
 
 void ConnectionImpl::addConnectionCallbacks(ConnectionCallbacks& cb) { callbacks_.push_back(&cb); }
 
+void ConnectionImpl::removeConnectionCallbacks(ConnectionCallbacks& cb) { callbacks_.remove(&cb); }
+
 void ConnectionImpl::write(Buffer::Instance& data) {
   // NOTE: This is kind of a hack, but currently we don't support restart/continue on the write
   //       path, so we just pass around the buffer passed to us in this function. If we ever support
@@ -303,6 +339,9 @@ void ConnectionImpl::write(Buffer::Instance& data) {
     // to SSL_write(). That code will have to change if we ever copy here.
     write_buffer_->move(data);
 
+    // The write happens when the activated write event runs, so all the writes made during one
+    // iteration of the event loop (e.g. pipelined HTTP/1 responses) go out with a single writev().
+    //
     // Activating a write event before the socket is connected has the side-effect of tricking
     // doWriteReady into thinking the socket is connected. On OS X, the underlying write may fail
     // with a connection error if a call to write(2) occurs before the connection is completed.
@@ -312,6 +351,51 @@ void ConnectionImpl::write(Buffer::Instance& data) {
   }
 }
 
+bool ConnectionImpl::spliceWith(Connection& peer) {
+  ConnectionImpl* peer_impl = dynamic_cast<ConnectionImpl*>(&peer);
+  if (peer_impl == nullptr || peer_impl == this || !canSplice() || !peer_impl->canSplice()) {
+    return false;
+  }
+
+  if (openPipe(splice_pipe_) != 0) {
+    ENVOY_CONN_LOG(debug, "unable to create splice pipe: {}", *this, strerror(errno));
+    return false;
+  }
+  if (openPipe(peer_impl->splice_pipe_) != 0) {
+    ENVOY_CONN_LOG(debug, "unable to create splice pipe: {}", *this, strerror(errno));
+    closeSplicePipe();
+    return false;
+  }
+
+  ENVOY_CONN_LOG(debug, "splicing with [C{}]", *this, peer_impl->id());
+  splice_destination_ = peer_impl;
+  splice_source_ = peer_impl;
+  peer_impl->splice_destination_ = this;
+  peer_impl->splice_source_ = this;
+
+  // Either socket may already have data that no further edge will announce.
+  setReadBufferReady();
+  peer_impl->setReadBufferReady();
+  return true;
+}
+
+bool ConnectionImpl::canSplice() const {
+  // The connection must be open and connected, though reads may be disabled.
+  return fd_ != -1 && !(state_ & ~InternalState::ReadEnabled) && ssl() == nullptr &&
+         splice_destination_ == nullptr && filter_manager_.readFilterCount() <= 1 &&
+         filter_manager_.writeFilterCount() == 0 && read_buffer_.length() == 0;
+}
+
+void ConnectionImpl::closeSplicePipe() {
+  for (int& fd : splice_pipe_) {
+    if (fd != -1) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+  splice_pipe_length_ = 0;
+}
+
 void ConnectionImpl::setBufferLimits(uint32_t limit) {
   read_buffer_limit_ = limit;
 
@@ -402,12 +486,7 @@ ConnectionImpl::IoResult ConnectionImpl::doReadFromSocket() {
   PostIoAction action = PostIoAction::KeepOpen;
   uint64_t bytes_read = 0;
   do {
-    // 16K read is arbitrary. IIRC, libevent will currently clamp this to 4K. libevent will also
-    // use an ioctl() before every read to figure out how much data there is to read.
-    //
-    // TODO(mattklein123) PERF: Tune the read size and figure out a way of getting rid of the
-    // ioctl(). The extra syscall is not worth it.
-    int rc = read_buffer_.read(fd_, 16384);
+    int rc = read_buffer_.read(fd_, read_size_);
     ENVOY_CONN_LOG(trace, "read returns: {}", *this, rc);
 
     // Remote close. Might need to raise data before raising close.
@@ -428,15 +507,43 @@ ConnectionImpl::IoResult ConnectionImpl::doReadFromSocket() {
         setReadBufferReady();
         break;
       }
+
+      if (shouldYieldRead(bytes_read)) {
+        break;
+      }
     }
   } while (true);
 
+  updateReadSize(bytes_read);
   return {action, bytes_read};
 }
 
+void ConnectionImpl::updateReadSize(uint64_t bytes_read) {
+  if (bytes_read >= read_size_) {
+    read_size_ = std::min(read_size_ * 2, MAX_READ_SIZE);
+  } else if (bytes_read < read_size_ / 4) {
+    read_size_ = std::max(read_size_ / 2, MIN_READ_SIZE);
+  }
+}
+
 void ConnectionImpl::onReadReady() {
   ASSERT(!(state_ & InternalState::Connecting));
 
+  // Data is spliced only when nothing read before it waits in user space, so that it stays in
+  // order. Everything in the destination's write buffer was written after its pipe last emptied,
+  // which is why the pipe is written first, and why nothing is read while the pipe is not empty.
+  if (splice_destination_ != nullptr && read_buffer_.length() == 0) {
+    if (splice_destination_->splice_pipe_length_ > 0) {
+      // The destination resumes reads once the pipe is written.
+      return;
+    }
+    if (splice_destination_->write_buffer_->length() == 0 &&
+        splice_destination_->state() == State::Open) {
+      onSpliceReady();
+      return;
+    }
+  }
+
   IoResult result = doReadFromSocket();
   uint64_t new_buffer_size = read_buffer_.length();
   updateReadBufferStats(result.bytes_processed_, new_buffer_size);
@@ -449,6 +556,92 @@ void ConnectionImpl::onReadReady() {
   }
 }
 
+void ConnectionImpl::onSpliceReady() {
+  if (!(state_ & InternalState::ReadEnabled)) {
+    return;
+  }
+
+  ConnectionImpl& destination = *splice_destination_;
+  IoResult result = doSpliceFromSocket(destination);
+  updateReadBufferStats(result.bytes_processed_, 0);
+  if (result.bytes_processed_ > 0) {
+    destination.file_event_->activate(Event::FileReadyType::Write);
+  }
+
+  if (result.action_ == PostIoAction::Close) {
+    ENVOY_CONN_LOG(debug, "remote close", *this);
+    closeSocket(ConnectionEvent::RemoteClose);
+  }
+}
+
+ConnectionImpl::IoResult ConnectionImpl::doSpliceFromSocket(ConnectionImpl& destination) {
+  PostIoAction action = PostIoAction::KeepOpen;
+  uint64_t bytes_read = 0;
+  do {
+    ssize_t rc = spliceFd(fd_, destination.splice_pipe_[1], MAX_READ_SIZE);
+    ENVOY_CONN_LOG(trace, "splice from socket returns: {}", *this, rc);
+
+    if (rc == 0) {
+      action = PostIoAction::Close;
+      break;
+    } else if (rc == -1) {
+      // Either there's no data, or the pipe is full, in which case the destination resumes reads
+      // once it has written the pipe.
+      ENVOY_CONN_LOG(trace, "splice error: {}", *this, errno);
+      if (errno != EAGAIN) {
+        action = PostIoAction::Close;
+      }
+
+      break;
+    } else {
+      bytes_read += rc;
+      destination.splice_pipe_length_ += rc;
+      if (shouldYieldRead(bytes_read)) {
+        break;
+      }
+    }
+  } while (true);
+
+  return {action, bytes_read};
+}
+
+ConnectionImpl::IoResult ConnectionImpl::doSpliceToSocket() {
+  PostIoAction action = PostIoAction::KeepOpen;
+  uint64_t bytes_written = 0;
+  while (splice_pipe_length_ > 0) {
+    ssize_t rc = spliceFd(splice_pipe_[0], fd_, splice_pipe_length_);
+    ENVOY_CONN_LOG(trace, "splice to socket returns: {}", *this, rc);
+    if (rc <= 0) {
+      ENVOY_CONN_LOG(trace, "splice error: {}", *this, errno);
+      if (rc == -1 && errno != EAGAIN) {
+        action = PostIoAction::Close;
+      }
+
+      break;
+    }
+    bytes_written += rc;
+    splice_pipe_length_ -= rc;
+  }
+
+  if (splice_pipe_length_ == 0 && bytes_written > 0 && splice_source_ != nullptr) {
+    splice_source_->setReadBufferReady();
+  }
+  return {action, bytes_written};
+}
+
+ConnectionImpl::IoResult ConnectionImpl::writePendingData() {
+  IoResult spliced{PostIoAction::KeepOpen, 0};
+  if (splice_pipe_length_ > 0) {
+    spliced = doSpliceToSocket();
+    if (spliced.action_ == PostIoAction::Close || splice_pipe_length_ > 0) {
+      return spliced;
+    }
+  }
+
+  IoResult written = doWriteToSocket();
+  return {written.action_, spliced.bytes_processed_ + written.bytes_processed_};
+}
+
 ConnectionImpl::IoResult ConnectionImpl::doWriteToSocket() {
   PostIoAction action;
   uint64_t bytes_written = 0;
@@ -504,8 +697,8 @@ void ConnectionImpl::onWriteReady() {
     }
   }
 
-  IoResult result = doWriteToSocket();
-  uint64_t new_buffer_size = write_buffer_->length();
+  IoResult result = writePendingData();
+  uint64_t new_buffer_size = write_buffer_->length() + splice_pipe_length_;
   updateWriteBufferStats(result.bytes_processed_, new_buffer_size);
 
   if (result.action_ == PostIoAction::Close) {
@@ -539,6 +732,11 @@ void ConnectionImpl::doConnect() {
   }
 }
 
+void ConnectionImpl::doSetSocketOptions(const SocketOptions& options) {
+  ASSERT(state_ & InternalState::Connecting);
+  Utility::setClientSocketOptions(fd_, options);
+}
+
 void ConnectionImpl::setConnectionStats(const ConnectionStats& stats) {
   ASSERT(!connection_stats_);
   connection_stats_.reset(new ConnectionStats(stats));
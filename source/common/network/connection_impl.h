@@ -11,6 +11,7 @@
 
 #include "common/buffer/watermark_buffer.h"
 #include "common/common/logger.h"
+#include "common/common/object_pool.h"
 #include "common/event/dispatcher_impl.h"
 #include "common/event/libevent.h"
 #include "common/network/filter_manager_impl.h"
@@ -41,6 +42,7 @@ public:
  * Implementation of Network::Connection.
  */
 class ConnectionImpl : public virtual Connection,
+                       public PooledObject<ConnectionImpl>,
                        public BufferSource,
                        protected Logger::Loggable<Logger::Id::connection> {
 public:
@@ -60,6 +62,7 @@ public:
 
   // Network::Connection
   void addConnectionCallbacks(ConnectionCallbacks& cb) override;
+  void removeConnectionCallbacks(ConnectionCallbacks& cb) override;
   void close(ConnectionCloseType type) override;
   Event::Dispatcher& dispatcher() override;
   uint64_t id() const override;
@@ -79,6 +82,7 @@ public:
   uint32_t bufferLimit() const override { return read_buffer_limit_; }
   bool usingOriginalDst() const override { return using_original_dst_; }
   bool aboveHighWatermark() const override { return above_high_watermark_; }
+  bool spliceWith(Connection& peer) override;
 
   // Network::BufferSource
   Buffer::Instance& getReadBuffer() override { return read_buffer_; }
@@ -94,6 +98,7 @@ protected:
 
   virtual void closeSocket(ConnectionEvent close_type);
   void doConnect();
+  void doSetSocketOptions(const SocketOptions& options);
   void raiseEvent(ConnectionEvent event);
   // Should the read buffer be drained?
   bool shouldDrainReadBuffer() {
@@ -105,6 +110,15 @@ protected:
   // fair sharing of CPU resources, the underlying event loop does not make any fairness guarantees.
   // Reconsider how to make fairness happen.
   void setReadBufferReady() { file_event_->activate(Event::FileReadyType::Read); }
+  // Has this read event read as much as it may before yielding to the other connections on the
+  // dispatcher? If it has, the read is rescheduled in the event loop.
+  bool shouldYieldRead(uint64_t bytes_read) {
+    if (read_budget_ > 0 && bytes_read >= read_budget_) {
+      setReadBufferReady();
+      return true;
+    }
+    return false;
+  }
 
   void onLowWatermark();
   void onHighWatermark();
@@ -119,6 +133,10 @@ protected:
   uint32_t read_buffer_limit_ = 0;
 
 private:
+  static const uint64_t INITIAL_READ_SIZE = 16384;
+  static const uint64_t MIN_READ_SIZE = 4096;
+  static const uint64_t MAX_READ_SIZE = 65536;
+
   // clang-format off
   struct InternalState {
     static const uint32_t ReadEnabled              = 0x1;
@@ -132,16 +150,31 @@ private:
   virtual IoResult doReadFromSocket();
   virtual IoResult doWriteToSocket();
   virtual void onConnected();
+  bool canSplice() const;
+  void closeSplicePipe();
+  IoResult doSpliceFromSocket(ConnectionImpl& destination);
+  IoResult doSpliceToSocket();
+  // Write the spliced data and then the write buffer.
+  IoResult writePendingData();
   void onFileEvent(uint32_t events);
   void onRead(uint64_t read_buffer_size);
   void onReadReady();
+  void onSpliceReady();
   void onWriteReady();
   void updateReadBufferStats(uint64_t num_read, uint64_t new_size);
+  // Adapt the read size to the bytes read by the last read event. It grows when the event read at
+  // least a full read and shrinks when it read much less, so busy connections use fewer syscalls
+  // and idle ones reserve less buffer memory.
+  void updateReadSize(uint64_t bytes_read);
   void updateWriteBufferStats(uint64_t num_written, uint64_t new_size);
 
   static std::atomic<uint64_t> next_global_id_;
 
   Event::DispatcherImpl& dispatcher_;
+  // The maximum number of bytes read per read event, or 0 for no limit.
+  const uint64_t read_budget_;
+  // The maximum size of the next read from the socket.
+  uint64_t read_size_{INITIAL_READ_SIZE};
   int fd_{-1};
   Event::FileEventPtr file_event_;
   const uint64_t id_;
@@ -158,6 +191,13 @@ private:
   const bool using_original_dst_;
   bool above_high_watermark_{false};
   bool detect_early_close_{true};
+  // The connection that the data read from this one is spliced to, and the one whose data is
+  // spliced to this one. Both are the peer of spliceWith(), and are reset when either closes.
+  ConnectionImpl* splice_destination_{};
+  ConnectionImpl* splice_source_{};
+  // The pipe that data spliced to this connection passes through, and the bytes in it.
+  int splice_pipe_[2]{-1, -1};
+  uint64_t splice_pipe_length_{};
 };
 
 /**
@@ -171,6 +211,7 @@ public:
 
   // Network::ClientConnection
   void connect() override { doConnect(); }
+  void setSocketOptions(const SocketOptions& options) override { doSetSocketOptions(options); }
 };
 
 } // namespace Network
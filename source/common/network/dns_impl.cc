@@ -1,9 +1,12 @@
 #include "common/network/dns_impl.h"
 
+#include <arpa/inet.h>
+#include <arpa/nameser.h>
 #include <netdb.h>
 #include <netinet/ip.h>
 #include <sys/socket.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <list>
@@ -19,11 +22,28 @@
 namespace Envoy {
 namespace Network {
 
+namespace {
+
+// The most addresses whose TTLs are parsed from an answer.
+const int MAX_ADDRTTLS = 32;
+
+template <class AddrTtl> std::chrono::seconds minimumTtl(const AddrTtl* addrttls, int naddrttls) {
+  int ttl = naddrttls > 0 ? addrttls[0].ttl : 0;
+  for (int i = 1; i < naddrttls; ++i) {
+    ttl = std::min(ttl, addrttls[i].ttl);
+  }
+  return std::chrono::seconds(std::max(ttl, 0));
+}
+
+} // namespace
+
 DnsResolverImpl::DnsResolverImpl(
     Event::Dispatcher& dispatcher,
-    const std::vector<Network::Address::InstanceConstSharedPtr>& resolvers)
+    const std::vector<Network::Address::InstanceConstSharedPtr>& resolvers,
+    const DnsCacheConfig& cache_config, MonotonicTimeSource& time_source)
     : dispatcher_(dispatcher),
-      timer_(dispatcher.createTimer([this] { onEventCallback(ARES_SOCKET_BAD, 0); })) {
+      timer_(dispatcher.createTimer([this] { onEventCallback(ARES_SOCKET_BAD, 0); })),
+      cache_config_(cache_config), time_source_(time_source) {
   // This is also done in main(), to satisfy the requirement that c-ares is
   // initialized prior to threading. The additional call to ares_library_init()
   // here is a nop in normal execution, but exists for testing where we don't
@@ -59,19 +79,79 @@ void DnsResolverImpl::initializeChannel(ares_options* options, int optmask) {
   ares_init_options(&channel_, options, optmask | ARES_OPT_SOCK_STATE_CB);
 }
 
-void DnsResolverImpl::PendingResolution::onAresHostCallback(int status, int timeouts,
-                                                            hostent* hostent) {
+void DnsResolverImpl::PendingResolution::start() {
+  switch (dns_lookup_family_) {
+  case DnsLookupFamily::V4Only:
+    pending_lookups_ = 1;
+    getHostByName(AF_INET);
+    break;
+  case DnsLookupFamily::V6Only:
+    pending_lookups_ = 1;
+    getHostByName(AF_INET6);
+    break;
+  case DnsLookupFamily::Auto:
+  case DnsLookupFamily::All:
+    // The A query is not held up by the AAAA query, which only matters to Auto if it fails.
+    pending_lookups_ = 2;
+    getHostByName(AF_INET6);
+    if (completed_) {
+      // IPv6 was answered without a query, so IPv4 is not needed.
+      pending_lookups_--;
+    } else {
+      getHostByName(AF_INET);
+    }
+    break;
+  }
+}
+
+void DnsResolverImpl::PendingResolution::onAresSearchCallback(int family, int status,
+                                                              int timeouts, unsigned char* abuf,
+                                                              int alen) {
+  hostent* hostent = nullptr;
+  Optional<std::chrono::seconds> ttl;
+  if (status == ARES_SUCCESS) {
+    int naddrttls = MAX_ADDRTTLS;
+    if (family == AF_INET) {
+      ares_addrttl addrttls[MAX_ADDRTTLS];
+      status = ares_parse_a_reply(abuf, alen, &hostent, addrttls, &naddrttls);
+      if (status == ARES_SUCCESS) {
+        ttl.value(minimumTtl(addrttls, naddrttls));
+      }
+    } else {
+      ares_addr6ttl addrttls[MAX_ADDRTTLS];
+      status = ares_parse_aaaa_reply(abuf, alen, &hostent, addrttls, &naddrttls);
+      if (status == ARES_SUCCESS) {
+        ttl.value(minimumTtl(addrttls, naddrttls));
+      }
+    }
+  }
+
+  onAresHostCallback(family, status, timeouts, hostent, ttl);
+  // Note: This object may have been deleted by onAresHostCallback().
+  if (hostent != nullptr) {
+    ares_free_hostent(hostent);
+  }
+}
+
+void DnsResolverImpl::PendingResolution::onAresHostCallback(int family, int status, int timeouts,
+                                                            hostent* hostent,
+                                                            Optional<std::chrono::seconds> ttl) {
+  ASSERT(pending_lookups_ > 0);
+  pending_lookups_--;
+
   // We receive ARES_EDESTRUCTION when destructing with pending queries.
   if (status == ARES_EDESTRUCTION) {
     ASSERT(owned_);
-    delete this;
+    if (pending_lookups_ == 0 && !in_callback_) {
+      delete this;
+    }
     return;
   }
-  if (status == ARES_SUCCESS || !fallback_if_failed_) {
-    completed_ = true;
-  }
 
-  std::list<Address::InstanceConstSharedPtr> address_list;
+  LookupResult& result = family == AF_INET ? v4_ : v6_;
+  result.done_ = true;
+  result.status_ = status;
+  result.ttl_ = ttl;
   if (status == ARES_SUCCESS) {
     if (hostent->h_addrtype == AF_INET) {
       for (int i = 0; hostent->h_addr_list[i] != nullptr; ++i) {
@@ -81,7 +161,7 @@ void DnsResolverImpl::PendingResolution::onAresHostCallback(int status, int time
         address.sin_family = AF_INET;
         address.sin_port = 0;
         address.sin_addr = *reinterpret_cast<in_addr*>(hostent->h_addr_list[i]);
-        address_list.emplace_back(new Address::Ipv4Instance(&address));
+        result.address_list_.emplace_back(new Address::Ipv4Instance(&address));
       }
     } else if (hostent->h_addrtype == AF_INET6) {
       for (int i = 0; hostent->h_addr_list[i] != nullptr; ++i) {
@@ -91,7 +171,7 @@ void DnsResolverImpl::PendingResolution::onAresHostCallback(int status, int time
         address.sin6_family = AF_INET6;
         address.sin6_port = 0;
         address.sin6_addr = *reinterpret_cast<in6_addr*>(hostent->h_addr_list[i]);
-        address_list.emplace_back(new Address::Ipv6Instance(address));
+        result.address_list_.emplace_back(new Address::Ipv6Instance(address));
       }
     }
   }
@@ -100,22 +180,74 @@ void DnsResolverImpl::PendingResolution::onAresHostCallback(int status, int time
     ENVOY_LOG(debug, "DNS request timed out {} times", timeouts);
   }
 
-  if (completed_) {
-    if (!cancelled_) {
-      callback_(std::move(address_list));
+  if (!completed_ && readyToComplete()) {
+    complete();
+  }
+
+  // The other family may still be outstanding after an Auto resolution completed with IPv6.
+  if (completed_ && owned_ && pending_lookups_ == 0) {
+    delete this;
+  }
+}
+
+bool DnsResolverImpl::PendingResolution::readyToComplete() const {
+  switch (dns_lookup_family_) {
+  case DnsLookupFamily::V4Only:
+    return v4_.done_;
+  case DnsLookupFamily::V6Only:
+    return v6_.done_;
+  case DnsLookupFamily::Auto:
+    // IPv4 is only used if IPv6 fails.
+    return v6_.done_ && (v6_.status_ == ARES_SUCCESS || v4_.done_);
+  case DnsLookupFamily::All:
+    return v6_.done_ && v4_.done_;
+  }
+
+  NOT_REACHED;
+}
+
+void DnsResolverImpl::PendingResolution::complete() {
+  completed_ = true;
+
+  std::list<Address::InstanceConstSharedPtr> address_list;
+  int status;
+  Optional<std::chrono::seconds> ttl;
+  if (dns_lookup_family_ == DnsLookupFamily::All) {
+    // The families are interleaved starting with IPv6, so that a client trying the addresses in
+    // order alternates between them. RFC 8305 section 4.
+    auto v6 = v6_.address_list_.begin();
+    auto v4 = v4_.address_list_.begin();
+    while (v6 != v6_.address_list_.end() || v4 != v4_.address_list_.end()) {
+      if (v6 != v6_.address_list_.end()) {
+        address_list.push_back(*v6++);
+      }
+      if (v4 != v4_.address_list_.end()) {
+        address_list.push_back(*v4++);
+      }
     }
-    if (owned_) {
-      delete this;
-      return;
+    status = v6_.status_ == ARES_SUCCESS ? v6_.status_ : v4_.status_;
+    for (const LookupResult* result : {&v6_, &v4_}) {
+      if (result->status_ == ARES_SUCCESS && result->ttl_.valid() &&
+          (!ttl.valid() || result->ttl_.value() < ttl.value())) {
+        ttl = result->ttl_;
+      }
     }
+  } else {
+    const LookupResult& result =
+        dns_lookup_family_ == DnsLookupFamily::V4Only ||
+                (dns_lookup_family_ == DnsLookupFamily::Auto && v6_.status_ != ARES_SUCCESS)
+            ? v4_
+            : v6_;
+    address_list = result.address_list_;
+    status = result.status_;
+    ttl = result.ttl_;
   }
 
-  if (status != ARES_SUCCESS && fallback_if_failed_) {
-    fallback_if_failed_ = false;
-    getHostByName(AF_INET);
-    // Note: Nothing can follow this call to getHostByName due to deletion of this
-    // object upon synchronous resolution.
-    return;
+  parent_.onResolution(dns_name_, dns_lookup_family_, status, address_list, ttl);
+  if (!cancelled_ && callback_) {
+    in_callback_ = true;
+    callback_(std::move(address_list));
+    in_callback_ = false;
   }
 }
 
@@ -163,24 +295,48 @@ void DnsResolverImpl::onAresSocketStateChange(int fd, int read, int write) {
 
 ActiveDnsQuery* DnsResolverImpl::resolve(const std::string& dns_name,
                                          DnsLookupFamily dns_lookup_family, ResolveCb callback) {
-  // TODO(hennna): Add DNS caching which will allow testing the edge case of a
-  // failed intial call to getHostbyName followed by a synchronous IPv4
-  // resolution.
-  std::unique_ptr<PendingResolution> pending_resolution(
-      new PendingResolution(callback, channel_, dns_name));
-  if (dns_lookup_family == DnsLookupFamily::Auto) {
-    pending_resolution->fallback_if_failed_ = true;
+  if (cache_config_.max_ttl_.count() > 0) {
+    auto it = cache_.find(cacheKey(dns_name, dns_lookup_family));
+    if (it != cache_.end()) {
+      const CacheEntry& entry = it->second;
+      const MonotonicTime now = time_source_.currentTime();
+      // Names that do not resolve are not served once they expire.
+      if (now < entry.expiry_ ||
+          (!entry.address_list_.empty() && now < entry.expiry_ + cache_config_.stale_ttl_)) {
+        std::list<Address::InstanceConstSharedPtr> address_list = entry.address_list_;
+        if (now >= entry.expiry_ && !entry.refreshing_) {
+          // The stale answer is served while the name is resolved again, so that the caller does
+          // not wait for DNS.
+          it->second.refreshing_ = true;
+          startResolution(dns_name, dns_lookup_family, nullptr);
+        }
+        callback(std::move(address_list));
+        return nullptr;
+      }
+      cache_.erase(it);
+    }
   }
 
-  if (dns_lookup_family == DnsLookupFamily::V4Only) {
-    pending_resolution->getHostByName(AF_INET);
-  } else {
-    pending_resolution->getHostByName(AF_INET6);
-  }
+  return startResolution(dns_name, dns_lookup_family, callback);
+}
+
+ActiveDnsQuery* DnsResolverImpl::startResolution(const std::string& dns_name,
+                                                 DnsLookupFamily dns_lookup_family,
+                                                 ResolveCb callback) {
+  std::unique_ptr<PendingResolution> pending_resolution(
+      new PendingResolution(*this, callback, channel_, dns_name, dns_lookup_family));
+  pending_resolution->start();
 
   if (pending_resolution->completed_) {
     // Resolution does not need asynchronous behavior or network events. For
     // example, localhost lookup.
+    if (pending_resolution->pending_lookups_ > 0) {
+      // The other family is still being looked up, and the resolution deletes itself once it
+      // completes.
+      updateAresTimer();
+      pending_resolution->owned_ = true;
+      pending_resolution.release();
+    }
     return nullptr;
   } else {
     // Enable timer to wake us up if the request times out.
@@ -193,13 +349,88 @@ ActiveDnsQuery* DnsResolverImpl::resolve(const std::string& dns_name,
   }
 }
 
+void DnsResolverImpl::onResolution(const std::string& dns_name,
+                                   DnsLookupFamily dns_lookup_family, int status,
+                                   const std::list<Address::InstanceConstSharedPtr>& address_list,
+                                   Optional<std::chrono::seconds> ttl) {
+  if (cache_config_.max_ttl_.count() == 0) {
+    return;
+  }
+
+  const std::string key = cacheKey(dns_name, dns_lookup_family);
+  std::chrono::seconds cache_ttl;
+  if (status == ARES_SUCCESS && ttl.valid()) {
+    cache_ttl = std::max(cache_config_.min_ttl_, std::min(cache_config_.max_ttl_, ttl.value()));
+  } else if (status == ARES_ENOTFOUND || status == ARES_ENODATA) {
+    cache_ttl = cache_config_.negative_ttl_;
+  } else {
+    // Answers from the hosts file and failures such as timeouts are not cached. A stale answer is
+    // kept, and resolved again the next time it is used.
+    auto it = cache_.find(key);
+    if (it != cache_.end()) {
+      it->second.refreshing_ = false;
+    }
+    return;
+  }
+
+  if (cache_ttl.count() == 0) {
+    cache_.erase(key);
+    return;
+  }
+  CacheEntry& entry = cache_[key];
+  entry.address_list_ = address_list;
+  entry.expiry_ = time_source_.currentTime() + cache_ttl;
+  entry.refreshing_ = false;
+}
+
+std::string DnsResolverImpl::cacheKey(const std::string& dns_name,
+                                      DnsLookupFamily dns_lookup_family) {
+  return dns_name + "|" + std::to_string(static_cast<int>(dns_lookup_family));
+}
+
 void DnsResolverImpl::PendingResolution::getHostByName(int family) {
-  ares_gethostbyname(channel_, dns_name_.c_str(), family,
-                     [](void* arg, int status, int timeouts, hostent* hostent) {
-                       static_cast<PendingResolution*>(arg)->onAresHostCallback(status, timeouts,
-                                                                                hostent);
-                     },
-                     this);
+  // Address literals and the hosts file are answered without a query, as ares_gethostbyname()
+  // does. Their addresses do not expire.
+  union {
+    in_addr v4;
+    in6_addr v6;
+  } address;
+  if (inet_pton(family, dns_name_.c_str(), &address) == 1) {
+    char* address_list[] = {reinterpret_cast<char*>(&address), nullptr};
+    hostent literal;
+    memset(&literal, 0, sizeof(literal));
+    literal.h_addrtype = family;
+    literal.h_length = family == AF_INET ? sizeof(in_addr) : sizeof(in6_addr);
+    literal.h_addr_list = address_list;
+    onAresHostCallback(family, ARES_SUCCESS, 0, &literal, Optional<std::chrono::seconds>());
+    return;
+  }
+
+  hostent* file_hostent;
+  if (ares_gethostbyname_file(channel_, dns_name_.c_str(), family, &file_hostent) ==
+      ARES_SUCCESS) {
+    onAresHostCallback(family, ARES_SUCCESS, 0, file_hostent, Optional<std::chrono::seconds>());
+    ares_free_hostent(file_hostent);
+    return;
+  }
+
+  // ares_gethostbyname() does not return the TTLs of the addresses, so the records are parsed
+  // here.
+  if (family == AF_INET) {
+    ares_search(channel_, dns_name_.c_str(), C_IN, T_A,
+                [](void* arg, int status, int timeouts, unsigned char* abuf, int alen) {
+                  static_cast<PendingResolution*>(arg)->onAresSearchCallback(AF_INET, status,
+                                                                             timeouts, abuf, alen);
+                },
+                this);
+  } else {
+    ares_search(channel_, dns_name_.c_str(), C_IN, T_AAAA,
+                [](void* arg, int status, int timeouts, unsigned char* abuf, int alen) {
+                  static_cast<PendingResolution*>(arg)->onAresSearchCallback(AF_INET6, status,
+                                                                             timeouts, abuf, alen);
+                },
+                this);
+  }
 }
 
 } // namespace Network
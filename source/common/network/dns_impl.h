@@ -2,10 +2,14 @@
 
 #include <netdb.h>
 
+#include <chrono>
 #include <cstdint>
+#include <list>
 #include <string>
 #include <unordered_map>
 
+#include "envoy/common/optional.h"
+#include "envoy/common/time.h"
 #include "envoy/event/dispatcher.h"
 #include "envoy/event/file_event.h"
 #include "envoy/network/dns.h"
@@ -23,12 +27,15 @@ class DnsResolverImplPeer;
 
 /**
  * Implementation of DnsResolver that uses c-ares. All calls and callbacks are assumed to
- * happen on the thread that owns the creating dispatcher.
+ * happen on the thread that owns the creating dispatcher. Answers are cached as configured by
+ * DnsCacheConfig, and cached answers are delivered before resolve() returns.
  */
 class DnsResolverImpl : public DnsResolver, protected Logger::Loggable<Logger::Id::upstream> {
 public:
   DnsResolverImpl(Event::Dispatcher& dispatcher,
-                  const std::vector<Network::Address::InstanceConstSharedPtr>& resolvers);
+                  const std::vector<Network::Address::InstanceConstSharedPtr>& resolvers,
+                  const DnsCacheConfig& cache_config = {},
+                  MonotonicTimeSource& time_source = ProdMonotonicTimeSource::instance_);
   ~DnsResolverImpl() override;
 
   // Network::DnsResolver
@@ -39,8 +46,10 @@ private:
   friend class DnsResolverImplPeer;
   struct PendingResolution : public ActiveDnsQuery {
     // Network::ActiveDnsQuery
-    PendingResolution(ResolveCb callback, ares_channel channel, const std::string& dns_name)
-        : callback_(callback), channel_(channel), dns_name_(dns_name) {}
+    PendingResolution(DnsResolverImpl& parent, ResolveCb callback, ares_channel channel,
+                      const std::string& dns_name, DnsLookupFamily dns_lookup_family)
+        : parent_(parent), callback_(callback), channel_(channel), dns_name_(dns_name),
+          dns_lookup_family_(dns_lookup_family) {}
 
     void cancel() override {
       // c-ares only supports channel-wide cancellation, so we just allow the
@@ -49,34 +58,86 @@ private:
     }
 
     /**
-     * c-ares ares_gethostbyname() query callback.
-     * @param status return status of call to ares_gethostbyname.
+     * Start the lookups of the resolution. Both families are looked up at the same time for
+     * DnsLookupFamily::Auto and DnsLookupFamily::All.
+     */
+    void start();
+    /**
+     * c-ares ares_search() query callback, which parses the answer.
+     * @param family the family of the query, AF_INET or AF_INET6.
+     * @param status return status of call to ares_search.
+     * @param timeouts the number of times the request timed out.
+     * @param abuf the answer.
+     * @param alen the length of the answer.
+     */
+    void onAresSearchCallback(int family, int status, int timeouts, unsigned char* abuf,
+                              int alen);
+    /**
+     * Called with the result of the lookup of a family.
+     * @param family the family of the lookup, AF_INET or AF_INET6.
+     * @param status return status of the lookup.
      * @param timeouts the number of times the request timed out.
      * @param hostent structure that stores information about a given host.
+     * @param ttl the TTL of the addresses, if they came from DNS records.
      */
-    void onAresHostCallback(int status, int timeouts, hostent* hostent);
+    void onAresHostCallback(int family, int status, int timeouts, hostent* hostent,
+                            Optional<std::chrono::seconds> ttl);
     /**
-     * wrapper function of call to ares_gethostbyname.
+     * Look up a name in the hosts file or as an address literal, and otherwise query DNS for it.
      * @param family currently AF_INET and AF_INET6 are supported.
      */
     void getHostByName(int family);
-
-    // Caller supplied callback to invoke on query completion or error.
+    // Have the lookups needed for the result of the resolution completed?
+    bool readyToComplete() const;
+    // Deliver the result of the resolution.
+    void complete();
+
+    // The result of the lookup of one family.
+    struct LookupResult {
+      bool done_{};
+      int status_{ARES_ENODATA};
+      std::list<Address::InstanceConstSharedPtr> address_list_;
+      Optional<std::chrono::seconds> ttl_;
+    };
+
+    DnsResolverImpl& parent_;
+    // Caller supplied callback to invoke on query completion or error. Empty for the background
+    // resolution of a stale cached answer.
     const ResolveCb callback_;
-    // Does the object own itself? Resource reclamation occurs via self-deleting
-    // on query completion or error.
+    // Does the object own itself? Resource reclamation occurs via self-deleting once the
+    // resolution has completed and none of its lookups are outstanding.
     bool owned_ = false;
     // Has the query completed? Only meaningful if !owned_;
     bool completed_ = false;
     // Was the query cancelled via cancel()?
     bool cancelled_ = false;
-    // If dns_lookup_family is "fallback", fallback to v4 address if v6
-    // resolution failed.
-    bool fallback_if_failed_ = false;
+    // Is the callback running? Lookups that are destroyed meanwhile leave the deletion to it.
+    bool in_callback_ = false;
+    // The lookups that have been started and not yet completed.
+    uint32_t pending_lookups_ = 0;
+    LookupResult v4_;
+    LookupResult v6_;
     const ares_channel channel_;
     const std::string dns_name_;
+    const DnsLookupFamily dns_lookup_family_;
+  };
+
+  struct CacheEntry {
+    std::list<Address::InstanceConstSharedPtr> address_list_;
+    MonotonicTime expiry_;
+    // Is the answer being resolved again, because it went stale?
+    bool refreshing_{};
   };
 
+  // Start a resolution, whose callback may be empty.
+  ActiveDnsQuery* startResolution(const std::string& dns_name, DnsLookupFamily dns_lookup_family,
+                                  ResolveCb callback);
+  // Update the cache with the result of a resolution.
+  void onResolution(const std::string& dns_name, DnsLookupFamily dns_lookup_family, int status,
+                    const std::list<Address::InstanceConstSharedPtr>& address_list,
+                    Optional<std::chrono::seconds> ttl);
+  static std::string cacheKey(const std::string& dns_name, DnsLookupFamily dns_lookup_family);
+
   // Callback for events on sockets tracked in events_.
   void onEventCallback(int fd, uint32_t events);
   // c-ares callback when a socket state changes, indicating that libevent
@@ -91,6 +152,9 @@ private:
   Event::TimerPtr timer_;
   ares_channel channel_;
   std::unordered_map<int, Event::FileEventPtr> events_;
+  const DnsCacheConfig cache_config_;
+  MonotonicTimeSource& time_source_;
+  std::unordered_map<std::string, CacheEntry> cache_;
 };
 
 } // namespace Network
@@ -0,0 +1,301 @@
+#include "common/network/happy_eyeballs_connection_impl.h"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Network {
+
+HappyEyeballsConnectionImpl::HappyEyeballsConnectionImpl(
+    Event::Dispatcher& dispatcher, const std::vector<Address::InstanceConstSharedPtr>& addresses,
+    std::chrono::milliseconds delay, ConnectionFactory factory)
+    : dispatcher_(dispatcher), addresses_(addresses), delay_(delay), factory_(factory),
+      next_attempt_timer_(dispatcher.createTimer([this]() -> void { startNextAttempt(); })) {
+  ASSERT(!addresses_.empty());
+  createAttempt();
+  id_ = attempts_.front()->connection_->id();
+}
+
+HappyEyeballsConnectionImpl::~HappyEyeballsConnectionImpl() {
+  // A connection that is destroyed without being closed may still have attempts connecting.
+  closed_ = true;
+  closeAttempts();
+}
+
+void HappyEyeballsConnectionImpl::addWriteFilter(WriteFilterSharedPtr filter) {
+  if (winner_) {
+    winner_->connection_->addWriteFilter(filter);
+  } else {
+    write_filters_.push_back(filter);
+  }
+}
+
+void HappyEyeballsConnectionImpl::addFilter(FilterSharedPtr filter) {
+  addReadFilter(filter);
+  addWriteFilter(filter);
+}
+
+void HappyEyeballsConnectionImpl::addReadFilter(ReadFilterSharedPtr filter) {
+  if (winner_) {
+    winner_->connection_->addReadFilter(filter);
+  } else {
+    read_filters_.push_back(filter);
+  }
+}
+
+bool HappyEyeballsConnectionImpl::initializeReadFilters() {
+  if (winner_) {
+    return winner_->connection_->initializeReadFilters();
+  }
+
+  // The filters only see the connection once it has been handed to them.
+  initialize_read_filters_ = true;
+  return !read_filters_.empty();
+}
+
+void HappyEyeballsConnectionImpl::addConnectionCallbacks(ConnectionCallbacks& cb) {
+  callbacks_.push_back(&cb);
+}
+
+void HappyEyeballsConnectionImpl::close(ConnectionCloseType type) {
+  if (winner_) {
+    winner_->connection_->close(type);
+    return;
+  }
+
+  if (closed_) {
+    return;
+  }
+
+  // There is nothing to flush before connecting.
+  closed_ = true;
+  next_attempt_timer_->disableTimer();
+  closeAttempts();
+  raiseEvent(ConnectionEvent::LocalClose);
+}
+
+void HappyEyeballsConnectionImpl::noDelay(bool enable) {
+  no_delay_ = enable;
+  if (winner_) {
+    winner_->connection_->noDelay(enable);
+    return;
+  }
+  for (AttemptPtr& attempt : attempts_) {
+    if (attempt->connecting_) {
+      attempt->connection_->noDelay(enable);
+    }
+  }
+}
+
+void HappyEyeballsConnectionImpl::readDisable(bool disable) {
+  if (winner_) {
+    winner_->connection_->readDisable(disable);
+    return;
+  }
+
+  if (disable) {
+    read_disable_count_++;
+  } else {
+    ASSERT(read_disable_count_ > 0);
+    read_disable_count_--;
+  }
+}
+
+void HappyEyeballsConnectionImpl::detectEarlyCloseWhenReadDisabled(bool should_detect) {
+  detect_early_close_ = should_detect;
+  if (winner_) {
+    winner_->connection_->detectEarlyCloseWhenReadDisabled(should_detect);
+  }
+}
+
+bool HappyEyeballsConnectionImpl::readEnabled() const {
+  return winner_ ? winner_->connection_->readEnabled() : read_disable_count_ == 0;
+}
+
+void HappyEyeballsConnectionImpl::setConnectionStats(const ConnectionStats& stats) {
+  ASSERT(!connection_stats_);
+  connection_stats_.reset(new ConnectionStats(stats));
+  if (winner_) {
+    winner_->connection_->setConnectionStats(stats);
+    return;
+  }
+  for (AttemptPtr& attempt : attempts_) {
+    if (attempt->connecting_) {
+      attempt->connection_->setConnectionStats(stats);
+    }
+  }
+}
+
+Connection::State HappyEyeballsConnectionImpl::state() const {
+  if (winner_) {
+    return winner_->connection_->state();
+  }
+  return closed_ ? State::Closed : State::Open;
+}
+
+void HappyEyeballsConnectionImpl::write(Buffer::Instance& data) {
+  if (winner_) {
+    winner_->connection_->write(data);
+  } else {
+    write_buffer_.move(data);
+  }
+}
+
+void HappyEyeballsConnectionImpl::setBufferLimits(uint32_t limit) {
+  buffer_limit_.value(limit);
+  if (winner_) {
+    winner_->connection_->setBufferLimits(limit);
+    return;
+  }
+  for (AttemptPtr& attempt : attempts_) {
+    if (attempt->connecting_) {
+      attempt->connection_->setBufferLimits(limit);
+    }
+  }
+}
+
+void HappyEyeballsConnectionImpl::connect() {
+  ASSERT(!connect_called_);
+  connect_called_ = true;
+  attempts_.front()->connection_->connect();
+  if (attempts_.size() < addresses_.size()) {
+    next_attempt_timer_->enableTimer(delay_);
+  }
+}
+
+void HappyEyeballsConnectionImpl::setSocketOptions(const SocketOptions& options) {
+  // Only the first attempt exists before connect(). The others are created with the options.
+  ASSERT(!connect_called_);
+  socket_options_ = options;
+  attempts_.front()->connection_->setSocketOptions(options);
+}
+
+void HappyEyeballsConnectionImpl::Attempt::onAboveWriteBufferHighWatermark() {
+  if (parent_.winner_ == this) {
+    for (ConnectionCallbacks* callback : parent_.callbacks_) {
+      callback->onAboveWriteBufferHighWatermark();
+    }
+  }
+}
+
+void HappyEyeballsConnectionImpl::Attempt::onBelowWriteBufferLowWatermark() {
+  if (parent_.winner_ == this) {
+    for (ConnectionCallbacks* callback : parent_.callbacks_) {
+      callback->onBelowWriteBufferLowWatermark();
+    }
+  }
+}
+
+void HappyEyeballsConnectionImpl::createAttempt() {
+  ClientConnectionPtr connection = factory_(addresses_[attempts_.size()]);
+  AttemptPtr attempt(new Attempt(*this, std::move(connection)));
+  attempt->connection_->addConnectionCallbacks(*attempt);
+  if (no_delay_) {
+    attempt->connection_->noDelay(true);
+  }
+  if (connection_stats_) {
+    attempt->connection_->setConnectionStats(*connection_stats_);
+  }
+  if (buffer_limit_.valid()) {
+    attempt->connection_->setBufferLimits(buffer_limit_.value());
+  }
+  if (!socket_options_.empty()) {
+    attempt->connection_->setSocketOptions(socket_options_);
+  }
+  attempts_.emplace_back(std::move(attempt));
+}
+
+void HappyEyeballsConnectionImpl::startNextAttempt() {
+  if (attempts_.size() == addresses_.size()) {
+    return;
+  }
+
+  ENVOY_CONN_LOG(debug, "trying {}", *this, addresses_[attempts_.size()]->asString());
+  createAttempt();
+  attempts_.back()->connection_->connect();
+  if (attempts_.size() < addresses_.size()) {
+    next_attempt_timer_->enableTimer(delay_);
+  }
+}
+
+void HappyEyeballsConnectionImpl::onAttemptEvent(Attempt& attempt, ConnectionEvent event) {
+  if (winner_) {
+    // Only the winner is still listened to. The losers are closed by onWin().
+    if (winner_ == &attempt) {
+      raiseEvent(event);
+    }
+    return;
+  }
+
+  if (closed_ || !attempt.connecting_) {
+    return;
+  }
+
+  if (event == ConnectionEvent::Connected) {
+    onWin(attempt);
+    return;
+  }
+
+  // The attempt failed. The next address is tried instead of waiting for the delay.
+  ENVOY_CONN_LOG(debug, "connect to {} failed", *this,
+                 attempt.connection_->remoteAddress().asString());
+  attempt.connecting_ = false;
+  if (attempts_.size() < addresses_.size()) {
+    next_attempt_timer_->disableTimer();
+    startNextAttempt();
+  } else if (!connecting()) {
+    closed_ = true;
+    raiseEvent(ConnectionEvent::RemoteClose);
+  }
+}
+
+void HappyEyeballsConnectionImpl::onWin(Attempt& attempt) {
+  winner_ = &attempt;
+  next_attempt_timer_->disableTimer();
+  ENVOY_CONN_LOG(debug, "connected to {}", *this, attempt.connection_->remoteAddress().asString());
+  closeAttempts();
+
+  ClientConnection& connection = *attempt.connection_;
+  connection.detectEarlyCloseWhenReadDisabled(detect_early_close_);
+  for (uint32_t i = 0; i < read_disable_count_; i++) {
+    connection.readDisable(true);
+  }
+  for (const WriteFilterSharedPtr& filter : write_filters_) {
+    connection.addWriteFilter(filter);
+  }
+  for (const ReadFilterSharedPtr& filter : read_filters_) {
+    connection.addReadFilter(filter);
+  }
+  read_filters_.clear();
+  write_filters_.clear();
+  if (initialize_read_filters_) {
+    connection.initializeReadFilters();
+  }
+  if (write_buffer_.length() > 0) {
+    connection.write(write_buffer_);
+  }
+
+  raiseEvent(ConnectionEvent::Connected);
+}
+
+void HappyEyeballsConnectionImpl::closeAttempts() {
+  for (AttemptPtr& attempt : attempts_) {
+    if (attempt.get() != winner_ && attempt->connecting_) {
+      // The close event is ignored, since the attempt is no longer connecting.
+      attempt->connecting_ = false;
+      attempt->connection_->close(ConnectionCloseType::NoFlush);
+    }
+  }
+}
+
+void HappyEyeballsConnectionImpl::raiseEvent(ConnectionEvent event) {
+  for (ConnectionCallbacks* callback : callbacks_) {
+    callback->onEvent(event);
+  }
+}
+
+} // namespace Network
+} // namespace Envoy
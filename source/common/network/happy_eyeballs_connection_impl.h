@@ -0,0 +1,150 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "envoy/common/optional.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "envoy/network/address.h"
+#include "envoy/network/connection.h"
+#include "envoy/network/filter.h"
+
+#include "common/buffer/buffer_impl.h"
+#include "common/common/logger.h"
+
+namespace Envoy {
+namespace Network {
+
+/**
+ * A client connection that races connects to a list of addresses, as described by RFC 8305
+ * ("Happy Eyeballs"). The first address is tried first, and each following address is tried when
+ * the previous attempt fails or after a delay, whichever comes first. The first attempt that
+ * connects is used and the others are closed.
+ *
+ * Until an attempt connects, filters, writes and read disables are held by this connection and
+ * handed to the winning attempt before its Connected event is raised. The connection keeps the id
+ * of its first attempt, and the addresses of the first attempt until one wins. Closed attempts are
+ * kept until the connection is destroyed.
+ */
+class HappyEyeballsConnectionImpl : public ClientConnection,
+                                    protected Logger::Loggable<Logger::Id::connection> {
+public:
+  typedef std::function<ClientConnectionPtr(Address::InstanceConstSharedPtr address)>
+      ConnectionFactory;
+
+  /**
+   * @param dispatcher supplies the dispatcher of the connection.
+   * @param addresses supplies the addresses to try, in order. Must not be empty.
+   * @param delay supplies the time after which the next address is tried while an attempt is
+   *        still connecting.
+   * @param factory supplies the function that creates the connection of an attempt.
+   */
+  HappyEyeballsConnectionImpl(Event::Dispatcher& dispatcher,
+                              const std::vector<Address::InstanceConstSharedPtr>& addresses,
+                              std::chrono::milliseconds delay, ConnectionFactory factory);
+  ~HappyEyeballsConnectionImpl();
+
+  // Network::FilterManager
+  void addWriteFilter(WriteFilterSharedPtr filter) override;
+  void addFilter(FilterSharedPtr filter) override;
+  void addReadFilter(ReadFilterSharedPtr filter) override;
+  bool initializeReadFilters() override;
+
+  // Network::Connection
+  void addConnectionCallbacks(ConnectionCallbacks& cb) override;
+  void removeConnectionCallbacks(ConnectionCallbacks& cb) override { callbacks_.remove(&cb); }
+  void close(ConnectionCloseType type) override;
+  Event::Dispatcher& dispatcher() override { return dispatcher_; }
+  uint64_t id() const override { return id_; }
+  std::string nextProtocol() const override { return connection().nextProtocol(); }
+  void noDelay(bool enable) override;
+  void readDisable(bool disable) override;
+  void detectEarlyCloseWhenReadDisabled(bool should_detect) override;
+  bool readEnabled() const override;
+  const Address::Instance& remoteAddress() const override {
+    return connection().remoteAddress();
+  }
+  const Address::Instance& localAddress() const override { return connection().localAddress(); }
+  void setConnectionStats(const ConnectionStats& stats) override;
+  Ssl::Connection* ssl() override { return connection().ssl(); }
+  const Ssl::Connection* ssl() const override { return connection().ssl(); }
+  State state() const override;
+  void write(Buffer::Instance& data) override;
+  void setBufferLimits(uint32_t limit) override;
+  uint32_t bufferLimit() const override { return connection().bufferLimit(); }
+  bool usingOriginalDst() const override { return false; }
+  bool aboveHighWatermark() const override { return connection().aboveHighWatermark(); }
+  bool spliceWith(Connection& peer) override { return connection().spliceWith(peer); }
+
+  // Network::ClientConnection
+  void connect() override;
+  void setSocketOptions(const SocketOptions& options) override;
+
+private:
+  struct Attempt : public ConnectionCallbacks {
+    Attempt(HappyEyeballsConnectionImpl& parent, ClientConnectionPtr&& connection)
+        : parent_(parent), connection_(std::move(connection)) {}
+
+    // Network::ConnectionCallbacks
+    void onEvent(ConnectionEvent event) override { parent_.onAttemptEvent(*this, event); }
+    void onAboveWriteBufferHighWatermark() override;
+    void onBelowWriteBufferLowWatermark() override;
+
+    HappyEyeballsConnectionImpl& parent_;
+    ClientConnectionPtr connection_;
+    bool connecting_{true};
+  };
+
+  typedef std::unique_ptr<Attempt> AttemptPtr;
+
+  // The connection of the winning attempt, or of the first attempt until one wins.
+  ClientConnection& connection() const {
+    return winner_ ? *winner_->connection_ : *attempts_.front()->connection_;
+  }
+  bool connecting() const {
+    return std::any_of(attempts_.begin(), attempts_.end(),
+                       [](const AttemptPtr& attempt) -> bool { return attempt->connecting_; });
+  }
+  void createAttempt();
+  void startNextAttempt();
+  void onAttemptEvent(Attempt& attempt, ConnectionEvent event);
+  void onWin(Attempt& attempt);
+  void closeAttempts();
+  void raiseEvent(ConnectionEvent event);
+
+  Event::Dispatcher& dispatcher_;
+  const std::vector<Address::InstanceConstSharedPtr> addresses_;
+  const std::chrono::milliseconds delay_;
+  const ConnectionFactory factory_;
+  Event::TimerPtr next_attempt_timer_;
+  // The attempts in the order of their addresses. The first attempt is created by the constructor,
+  // and the others as their turns come once connect() is called.
+  std::vector<AttemptPtr> attempts_;
+  uint64_t id_;
+  bool connect_called_{};
+  bool closed_{};
+  Attempt* winner_{};
+  std::list<ConnectionCallbacks*> callbacks_;
+
+  // State that is handed to the winning attempt.
+  std::list<ReadFilterSharedPtr> read_filters_;
+  std::list<WriteFilterSharedPtr> write_filters_;
+  Buffer::OwnedImpl write_buffer_;
+  uint32_t read_disable_count_{};
+  bool initialize_read_filters_{};
+  bool no_delay_{};
+  bool detect_early_close_{true};
+  std::unique_ptr<ConnectionStats> connection_stats_;
+  Optional<uint32_t> buffer_limit_;
+  SocketOptions socket_options_;
+};
+
+} // namespace Network
+} // namespace Envoy
@@ -0,0 +1,293 @@
+#include "common/network/lc_trie.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "envoy/common/exception.h"
+
+#include "common/common/assert.h"
+
+#include "fmt/format.h"
+
+namespace Envoy {
+namespace Network {
+namespace Address {
+
+template <class IpType, uint32_t address_size>
+LcTrieInternal<IpType, address_size>::LcTrieInternal(std::vector<Prefix>& prefixes,
+                                                     const TagSetInterner& interner,
+                                                     double fill_factor)
+    : interner_(&interner), fill_factor_(fill_factor) {
+  ASSERT(fill_factor_ > 0 && fill_factor_ <= 1);
+
+  // Sort the prefixes so that a prefix comes right before the prefixes it contains, and merge
+  // the tags of identical prefixes.
+  std::sort(prefixes.begin(), prefixes.end(), [](const Prefix& a, const Prefix& b) {
+    if (a.address_ != b.address_) {
+      return a.address_ < b.address_;
+    }
+    return a.length_ != b.length_ ? a.length_ < b.length_ : a.tag_ < b.tag_;
+  });
+  for (const Prefix& prefix : prefixes) {
+    ASSERT(mask(prefix.address_, prefix.length_) == prefix.address_);
+    if (groups_.empty() || groups_.back().address_ != prefix.address_ ||
+        groups_.back().length_ != prefix.length_) {
+      groups_.push_back({prefix.address_, prefix.length_, {}});
+    }
+    if (groups_.back().tags_.empty() || groups_.back().tags_.back() != prefix.tag_) {
+      groups_.back().tags_.push_back(prefix.tag_);
+    }
+  }
+
+  // Split the prefixes into disjoint leaves, in address order.
+  descend(0, 0, 0, groups_.size(), {}, 0, 0);
+  groups_.clear();
+  groups_.shrink_to_fit();
+  interner_ = nullptr;
+
+  if (!leaves_.empty()) {
+    trie_.resize(1);
+    build(0, leaves_.size(), 0, 0);
+  }
+}
+
+template <class IpType, uint32_t address_size>
+uint32_t LcTrieInternal<IpType, address_size>::commonPrefixLength(IpType a, IpType b) {
+  const IpType diff = a ^ b;
+  uint32_t length = 0;
+  while (length < address_size && ((diff >> (address_size - length - 1)) & 1) == 0) {
+    length++;
+  }
+  return length;
+}
+
+template <class IpType, uint32_t address_size>
+void LcTrieInternal<IpType, address_size>::descend(IpType address, uint32_t length, size_t first,
+                                                   size_t last,
+                                                   const std::vector<uint32_t>& all_tags,
+                                                   uint32_t all_tags_index,
+                                                   uint32_t longest_tags_index) {
+  // Groups [first, last) are within the range. If the range itself is a configured prefix, it
+  // sorts first and its tags apply to the whole range.
+  if (first < last && groups_[first].address_ == address && groups_[first].length_ == length) {
+    const std::vector<uint32_t>& tags = groups_[first].tags_;
+    std::vector<uint32_t> merged_tags;
+    std::set_union(all_tags.begin(), all_tags.end(), tags.begin(), tags.end(),
+                   std::back_inserter(merged_tags));
+    const uint32_t merged_tags_index = (*interner_)(merged_tags);
+    split(address, length, first + 1, last, merged_tags, merged_tags_index, (*interner_)(tags));
+  } else {
+    split(address, length, first, last, all_tags, all_tags_index, longest_tags_index);
+  }
+}
+
+template <class IpType, uint32_t address_size>
+void LcTrieInternal<IpType, address_size>::split(IpType address, uint32_t length, size_t first,
+                                                 size_t last,
+                                                 const std::vector<uint32_t>& all_tags,
+                                                 uint32_t all_tags_index,
+                                                 uint32_t longest_tags_index) {
+  // Groups [first, last) are strictly within the range.
+  if (first == last) {
+    if (all_tags_index != 0) {
+      leaves_.push_back({address, length, all_tags_index, longest_tags_index});
+    }
+    return;
+  }
+
+  if (all_tags_index == 0) {
+    // Nothing to emit for the parts of the range outside of the groups, so go straight to the
+    // longest range that still contains all of them. The first group is the shortest one of any
+    // that end within it.
+    const uint32_t common_length = std::min(
+        commonPrefixLength(groups_[first].address_, groups_[last - 1].address_),
+        groups_[first].length_);
+    if (common_length > length) {
+      descend(mask(groups_[first].address_, common_length), common_length, first, last, all_tags,
+              all_tags_index, longest_tags_index);
+      return;
+    }
+  }
+
+  // Split the range in halves, each of which gets the groups it contains.
+  const IpType right_address = address | (static_cast<IpType>(1) << (address_size - length - 1));
+  size_t middle = first;
+  while (middle < last && groups_[middle].address_ < right_address) {
+    middle++;
+  }
+  descend(address, length + 1, first, middle, all_tags, all_tags_index, longest_tags_index);
+  descend(right_address, length + 1, middle, last, all_tags, all_tags_index, longest_tags_index);
+}
+
+template <class IpType, uint32_t address_size>
+void LcTrieInternal<IpType, address_size>::build(uint32_t first, uint32_t count, uint32_t prefix,
+                                                 uint32_t position) {
+  // Leaves [first, first + count) share their first prefix bits, and go below node position.
+  if (count == 1) {
+    trie_[position] = {first, 0, 0};
+    return;
+  }
+
+  // Distinct leaves are disjoint, so none of them ends within the bits they have in common.
+  const uint32_t common_length =
+      commonPrefixLength(leaves_[first].address_, leaves_[first + count - 1].address_);
+  const uint32_t skip = common_length - prefix;
+  const uint32_t branch = computeBranch(first, count, common_length);
+  const uint32_t children = trie_.size();
+  trie_.resize(children + (1U << branch));
+  trie_[position] = {children, static_cast<uint8_t>(branch), static_cast<uint8_t>(skip)};
+
+  uint32_t leaf = first;
+  for (uint32_t pattern = 0; pattern < (1U << branch); pattern++) {
+    uint32_t matching = 0;
+    while (leaf + matching < first + count &&
+           extractBits(common_length, branch, leaves_[leaf + matching].address_) == pattern) {
+      matching++;
+    }
+    if (matching == 0) {
+      // No leaf starts within the child. The previous leaf might still cover it if it is shorter
+      // than the bits branched on, and otherwise no leaf does. Lookups compare the leaf with the
+      // address either way.
+      trie_[children + pattern] = {leaf > first ? leaf - 1 : first, 0, 0};
+    } else {
+      build(leaf, matching, common_length + branch, children + pattern);
+    }
+    leaf += matching;
+  }
+}
+
+template <class IpType, uint32_t address_size>
+uint32_t LcTrieInternal<IpType, address_size>::computeBranch(uint32_t first, uint32_t count,
+                                                             uint32_t position) const {
+  // The leaves differ at bit position, so branching on a single bit fills both children.
+  // The number of children is also kept well within the range of the node indexes.
+  uint32_t branch = 1;
+  while (position + branch < address_size && branch < MAX_BRANCH) {
+    const uint32_t next_branch = branch + 1;
+    uint32_t patterns = 1;
+    for (uint32_t i = first + 1; i < first + count; i++) {
+      if (extractBits(position, next_branch, leaves_[i].address_) !=
+          extractBits(position, next_branch, leaves_[i - 1].address_)) {
+        patterns++;
+      }
+    }
+    if (patterns < fill_factor_ * (1U << next_branch)) {
+      break;
+    }
+    branch = next_branch;
+  }
+  return branch;
+}
+
+template <class IpType, uint32_t address_size>
+const typename LcTrieInternal<IpType, address_size>::Leaf*
+LcTrieInternal<IpType, address_size>::find(IpType address) const {
+  if (leaves_.empty()) {
+    return nullptr;
+  }
+
+  Node node = trie_[0];
+  uint32_t position = node.skip_;
+  uint32_t branch = node.branch_;
+  uint32_t index = node.address_;
+  while (branch != 0) {
+    node = trie_[index + extractBits(position, branch, address)];
+    position += branch + node.skip_;
+    branch = node.branch_;
+    index = node.address_;
+  }
+
+  const Leaf& leaf = leaves_[index];
+  if (leaf.length_ != 0 && ((address ^ leaf.address_) >> (address_size - leaf.length_)) != 0) {
+    return nullptr;
+  }
+  return &leaf;
+}
+
+constexpr double LcTrie::DEFAULT_FILL_FACTOR;
+
+LcTrie::LcTrie(const std::vector<std::pair<std::string, std::vector<CidrRange>>>& tag_data,
+               double fill_factor) {
+  std::vector<std::string> tag_names;
+  std::unordered_map<std::string, uint32_t> tag_indexes;
+  std::vector<LcTrieInternal<Ipv4Bits>::Prefix> ipv4_prefixes;
+  std::vector<LcTrieInternal<Ipv6Bits>::Prefix> ipv6_prefixes;
+  for (const auto& entry : tag_data) {
+    auto inserted = tag_indexes.emplace(entry.first, tag_names.size());
+    if (inserted.second) {
+      tag_names.push_back(entry.first);
+    }
+    const uint32_t tag = inserted.first->second;
+
+    for (const CidrRange& range : entry.second) {
+      if (!range.isValid()) {
+        throw EnvoyException(fmt::format("invalid CIDR range for tag '{}'", entry.first));
+      }
+      const uint32_t length = range.length();
+      if (range.version() == IpVersion::v4) {
+        ipv4_prefixes.push_back({ntohl(range.ipv4()->address()), length, tag});
+      } else {
+        Ipv6Bits address = 0;
+        for (uint8_t byte : range.ipv6()->address()) {
+          address = (address << 8) | byte;
+        }
+        ipv6_prefixes.push_back({address, length, tag});
+      }
+    }
+  }
+
+  // Tag sets are only needed per distinct set, and are stored once as names so that lookups can
+  // return them by reference.
+  std::map<std::vector<uint32_t>, uint32_t> tag_set_indexes{{{}, 0}};
+  tag_sets_.emplace_back();
+  const LcTrieInternal<Ipv4Bits>::TagSetInterner interner =
+      [&](const std::vector<uint32_t>& tags) -> uint32_t {
+    auto inserted = tag_set_indexes.emplace(tags, tag_sets_.size());
+    if (inserted.second) {
+      std::vector<std::string> names;
+      names.reserve(tags.size());
+      for (uint32_t tag : tags) {
+        names.push_back(tag_names[tag]);
+      }
+      tag_sets_.push_back(std::move(names));
+    }
+    return inserted.first->second;
+  };
+
+  ipv4_trie_.reset(new LcTrieInternal<Ipv4Bits>(ipv4_prefixes, interner, fill_factor));
+  ipv6_trie_.reset(new LcTrieInternal<Ipv6Bits>(ipv6_prefixes, interner, fill_factor));
+}
+
+uint32_t LcTrie::findTagSet(const Instance& address, bool longest) const {
+  if (address.type() != Type::Ip) {
+    return 0;
+  }
+  if (address.ip()->version() == IpVersion::v4) {
+    return tagSet(ipv4_trie_->find(ntohl(address.ip()->ipv4()->address())), longest);
+  }
+  Ipv6Bits bits = 0;
+  for (uint8_t byte : address.ip()->ipv6()->address()) {
+    bits = (bits << 8) | byte;
+  }
+  return tagSet(ipv6_trie_->find(bits), longest);
+}
+
+const std::vector<std::string>& LcTrie::getData(const Instance& address) const {
+  return tag_sets_[findTagSet(address, false)];
+}
+
+const std::vector<std::string>& LcTrie::getLongestPrefixData(const Instance& address) const {
+  return tag_sets_[findTagSet(address, true)];
+}
+
+} // namespace Address
+} // namespace Network
+} // namespace Envoy
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "envoy/network/address.h"
+
+#include "common/network/cidr_range.h"
+
+namespace Envoy {
+namespace Network {
+namespace Address {
+
+/**
+ * Level compressed trie of disjoint address ranges, for a single IP version. IpType is an unsigned
+ * integer holding the address in host byte order. See "IP-address lookup using LC-tries" by S.
+ * Nilsson and G. Karlsson, IEEE Journal on Selected Areas in Communications, June 1999.
+ *
+ * The configured prefixes may nest. They are first split into disjoint leaves, each of which
+ * carries the tags of every prefix containing it, so that a lookup always ends at a single leaf
+ * which is then compared with the address. Tag sets are referred to by the indexes handed out by
+ * the TagSetInterner.
+ */
+template <class IpType, uint32_t address_size = CHAR_BIT * sizeof(IpType)> class LcTrieInternal {
+public:
+  /**
+   * A configured prefix and one of its tags.
+   */
+  struct Prefix {
+    IpType address_;
+    uint32_t length_;
+    uint32_t tag_;
+  };
+
+  /**
+   * A range of addresses that is covered by the same set of prefixes.
+   */
+  struct Leaf {
+    IpType address_;
+    uint32_t length_;
+    // Index of the tags of all the prefixes that contain the leaf.
+    uint32_t all_tags_;
+    // Index of the tags of the longest prefix that contains the leaf.
+    uint32_t longest_tags_;
+  };
+
+  /**
+   * Returns the index of a set of tags, given as sorted tag indexes. Index 0 must be the empty set.
+   */
+  typedef std::function<uint32_t(const std::vector<uint32_t>& tags)> TagSetInterner;
+
+  /**
+   * @param prefixes supplies the prefixes. They are sorted in place.
+   * @param interner supplies the interner of the tag sets of the leaves.
+   * @param fill_factor supplies the fraction (0, 1] of the children of a node that must contain a
+   *        leaf for the node to branch on one more bit.
+   */
+  LcTrieInternal(std::vector<Prefix>& prefixes, const TagSetInterner& interner,
+                 double fill_factor);
+
+  /**
+   * @return const Leaf* the leaf that contains the address, or nullptr if no prefix contains it.
+   */
+  const Leaf* find(IpType address) const;
+
+  /**
+   * @return size_t the number of leaves the prefixes were split into.
+   */
+  size_t leaves() const { return leaves_.size(); }
+
+private:
+  /**
+   * A prefix with all of its tags.
+   */
+  struct Group {
+    IpType address_;
+    uint32_t length_;
+    std::vector<uint32_t> tags_;
+  };
+
+  /**
+   * Trie node. A node with a branch of 0 is a leaf and address_ is the index of the leaf. Otherwise
+   * the node skips skip_ bits, and its 2^branch_ children start at the node index address_.
+   */
+  struct Node {
+    uint32_t address_;
+    uint8_t branch_;
+    uint8_t skip_;
+  };
+
+  // Maximum number of bits a node branches on.
+  static const uint32_t MAX_BRANCH = 24;
+
+  static uint32_t extractBits(uint32_t position, uint32_t count, IpType input) {
+    return static_cast<uint32_t>((input << position) >> (address_size - count));
+  }
+  static IpType mask(IpType address, uint32_t length) {
+    return length == 0 ? 0 : address & (~static_cast<IpType>(0) << (address_size - length));
+  }
+  static uint32_t commonPrefixLength(IpType a, IpType b);
+
+  void descend(IpType address, uint32_t length, size_t first, size_t last,
+               const std::vector<uint32_t>& all_tags, uint32_t all_tags_index,
+               uint32_t longest_tags_index);
+  void split(IpType address, uint32_t length, size_t first, size_t last,
+             const std::vector<uint32_t>& all_tags, uint32_t all_tags_index,
+             uint32_t longest_tags_index);
+  void build(uint32_t first, uint32_t count, uint32_t prefix, uint32_t position);
+  uint32_t computeBranch(uint32_t first, uint32_t count, uint32_t position) const;
+
+  // Only used while building the trie.
+  std::vector<Group> groups_;
+  const TagSetInterner* interner_;
+  const double fill_factor_;
+
+  std::vector<Leaf> leaves_;
+  std::vector<Node> trie_;
+};
+
+/**
+ * Maps CIDR ranges to tags for fast lookups of the tags of an IP address. IPv4 and IPv6 ranges are
+ * kept in separate LC-tries, and each lookup takes one step per trie level followed by a single
+ * comparison, without any allocation. The trie is immutable once built.
+ */
+class LcTrie {
+public:
+  // Default fraction of the children of a node that must be non empty for the node to branch on
+  // one more bit.
+  static constexpr double DEFAULT_FILL_FACTOR = 0.5;
+
+  /**
+   * @param tag_data supplies the tags and the ranges each of them applies to. Ranges may be
+   *        repeated and may nest. A tag that is given more than once applies to the ranges of all
+   *        of its entries.
+   * @param fill_factor supplies the fraction (0, 1] of the children of a node that must be non
+   *        empty for the node to branch on one more bit. Lower values give shallower and larger
+   *        tries.
+   */
+  LcTrie(const std::vector<std::pair<std::string, std::vector<CidrRange>>>& tag_data,
+         double fill_factor = DEFAULT_FILL_FACTOR);
+
+  /**
+   * @return the tags of all the ranges that contain the address, in the order in which the tags
+   *         were first given, or an empty vector if no range contains it or the address is not an
+   *         IP address.
+   */
+  const std::vector<std::string>& getData(const Instance& address) const;
+
+  /**
+   * @return the tags of the longest range that contains the address, in the order in which the
+   *         tags were first given, or an empty vector if no range contains it or the address is
+   *         not an IP address.
+   */
+  const std::vector<std::string>& getLongestPrefixData(const Instance& address) const;
+
+private:
+  typedef uint32_t Ipv4Bits;
+  typedef unsigned __int128 Ipv6Bits;
+
+  template <class Leaf> static uint32_t tagSet(const Leaf* leaf, bool longest) {
+    return leaf == nullptr ? 0 : (longest ? leaf->longest_tags_ : leaf->all_tags_);
+  }
+  uint32_t findTagSet(const Instance& address, bool longest) const;
+
+  std::unique_ptr<LcTrieInternal<Ipv4Bits>> ipv4_trie_;
+  std::unique_ptr<LcTrieInternal<Ipv6Bits>> ipv6_trie_;
+  // Distinct tag sets of the leaves. The first one is empty.
+  std::vector<std::vector<std::string>> tag_sets_;
+};
+
+} // namespace Address
+} // namespace Network
+} // namespace Envoy
@@ -39,7 +39,14 @@ protected:
  */
 class TcpListenSocket : public ListenSocketImpl {
 public:
-  TcpListenSocket(Address::InstanceConstSharedPtr address, bool bind_to_port);
+  TcpListenSocket(Address::InstanceConstSharedPtr address, bool bind_to_port)
+      : TcpListenSocket(address, bind_to_port, false) {}
+
+  /**
+   * @param reuse_port supplies whether to set SO_REUSEPORT so that several sockets can be bound to
+   *        the same address, with the kernel distributing new connections among them.
+   */
+  TcpListenSocket(Address::InstanceConstSharedPtr address, bool bind_to_port, bool reuse_port);
   TcpListenSocket(int fd, Address::InstanceConstSharedPtr address);
 };
 
@@ -1,5 +1,7 @@
 #include "common/network/listener_impl.h"
 
+#include <fcntl.h>
+#include <sys/socket.h>
 #include <sys/un.h>
 
 #include "envoy/common/exception.h"
@@ -13,7 +15,6 @@
 #include "common/network/utility.h"
 #include "common/ssl/connection_impl.h"
 
-#include "event2/listener.h"
 #include "fmt/format.h"
 
 namespace Envoy {
@@ -27,9 +28,36 @@ Address::InstanceConstSharedPtr ListenerImpl::getOriginalDst(int fd) {
   return Utility::getOriginalDst(fd);
 }
 
-void ListenerImpl::listenCallback(evconnlistener*, evutil_socket_t fd, sockaddr* remote_addr,
-                                  int remote_addr_len, void* arg) {
-  ListenerImpl* listener = static_cast<ListenerImpl*>(arg);
+void ListenerImpl::onSocketEvent() {
+  const uint32_t max_accepts = options_.max_accepts_per_event_;
+  for (uint32_t accepted = 0; max_accepts == 0 || accepted < max_accepts; accepted++) {
+    if (!cb_.canAccept()) {
+      return;
+    }
+
+    sockaddr_storage remote_addr;
+    socklen_t remote_addr_len = sizeof(remote_addr);
+    const int fd = accept4(socket_.fd(), reinterpret_cast<sockaddr*>(&remote_addr),
+                           &remote_addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return;
+      }
+      if (errno == EINTR || errno == ECONNABORTED) {
+        // The connection was reset while in the accept queue. Move on to the next one.
+        continue;
+      }
+      // This can happen if we run out of FDs or memory. In those cases just crash.
+      PANIC(fmt::format("listener accept failure: {}", strerror(errno)));
+    }
+
+    acceptSocket(fd, remote_addr, remote_addr_len);
+  }
+}
+
+void ListenerImpl::acceptSocket(int fd, const sockaddr_storage& remote_addr,
+                                socklen_t remote_addr_len) {
+  ListenerImpl* listener = this;
   Address::InstanceConstSharedPtr final_local_address = listener->socket_.localAddress();
   bool using_original_dst = false;
 
@@ -67,20 +95,19 @@ void ListenerImpl::listenCallback(evconnlistener*, evutil_socket_t fd, sockaddr*
     listener->proxy_protocol_.newConnection(listener->dispatcher_, fd, *listener);
   } else {
     Address::InstanceConstSharedPtr final_remote_address;
-    if (remote_addr->sa_family == AF_UNIX) {
+    if (remote_addr.ss_family == AF_UNIX) {
       // The accept() call that filled in remote_addr doesn't fill in more than the sa_family field
       // for Unix domain sockets; apparently there isn't a mechanism in the kernel to get the
       // sockaddr_un associated with the client socket when starting from the server socket.
       // We work around this by using our own name for the socket in this case.
       final_remote_address = Address::peerAddressFromFd(fd);
     } else {
-      final_remote_address = Address::addressFromSockAddr(
-          *reinterpret_cast<const sockaddr_storage*>(remote_addr), remote_addr_len);
+      final_remote_address = Address::addressFromSockAddr(remote_addr, remote_addr_len);
     }
     // TODO(jamessynge): We need to keep per-family stats. BUT, should it be based on the original
     // family or the local family? Probably local family, as the original proxy can take care of
     // stats for the original family.
-    listener->newConnection(fd, final_remote_address, final_local_address, using_original_dst);
+    listener->acceptConnection(fd, final_remote_address, final_local_address, using_original_dst);
   }
 }
 
@@ -89,25 +116,41 @@ ListenerImpl::ListenerImpl(Network::ConnectionHandler& conn_handler,
                            ListenerCallbacks& cb, Stats::Scope& scope,
                            const Network::ListenerOptions& listener_options)
     : connection_handler_(conn_handler), dispatcher_(dispatcher), socket_(socket), cb_(cb),
-      proxy_protocol_(scope), options_(listener_options), listener_(nullptr) {
+      proxy_protocol_(scope), options_(listener_options) {
 
   if (options_.bind_to_port_) {
-    listener_.reset(
-        evconnlistener_new(&dispatcher_.base(), listenCallback, this, 0, -1, socket.fd()));
-
-    if (!listener_) {
+    // The socket may be shared with the listeners of other workers, in which case it is already
+    // listening and non-blocking. Both calls are harmless then.
+    if (listen(socket.fd(), SOMAXCONN) == -1 ||
+        fcntl(socket.fd(), F_SETFL, fcntl(socket.fd(), F_GETFL, 0) | O_NONBLOCK) == -1) {
       throw CreateListenerException(
           fmt::format("cannot listen on socket: {}", socket.localAddress()->asString()));
     }
 
-    evconnlistener_set_error_cb(listener_.get(), errorCallback);
+    file_event_ = dispatcher_.createFileEvent(socket.fd(), [this](uint32_t) { onSocketEvent(); },
+                                              Event::FileTriggerType::Level,
+                                              Event::FileReadyType::Read);
   }
 }
 
-void ListenerImpl::errorCallback(evconnlistener*, void*) {
-  // We should never get an error callback. This can happen if we run out of FDs or memory. In those
-  // cases just crash.
-  PANIC(fmt::format("listener accept failure: {}", strerror(errno)));
+void ListenerImpl::disable() {
+  if (file_event_) {
+    file_event_->setEnabled(0);
+  }
+}
+
+void ListenerImpl::enable() {
+  if (file_event_) {
+    file_event_->setEnabled(Event::FileReadyType::Read);
+  }
+}
+
+void ListenerImpl::acceptConnection(int fd, Address::InstanceConstSharedPtr remote_address,
+                                    Address::InstanceConstSharedPtr local_address,
+                                    bool using_original_dst) {
+  if (!cb_.onAccept(fd, remote_address, local_address, using_original_dst)) {
+    newConnection(fd, remote_address, local_address, using_original_dst);
+  }
 }
 
 void ListenerImpl::newConnection(int fd, Address::InstanceConstSharedPtr remote_address,
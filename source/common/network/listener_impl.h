@@ -1,20 +1,23 @@
 #pragma once
 
+#include <sys/socket.h>
+
+#include "envoy/event/file_event.h"
 #include "envoy/network/connection_handler.h"
 #include "envoy/network/listener.h"
 
 #include "common/event/dispatcher_impl.h"
-#include "common/event/libevent.h"
 #include "common/network/listen_socket_impl.h"
 #include "common/network/proxy_protocol.h"
 
-#include "event2/event.h"
-
 namespace Envoy {
 namespace Network {
 
 /**
- * libevent implementation of Network::Listener.
+ * libevent implementation of Network::Listener. Connections are accepted with accept4() in a loop
+ * that runs until the accept queue is empty, the listener's accept limit is reached or the
+ * callbacks stop accepting. Any connections left in the queue are accepted in the next iteration of
+ * the event loop, so that a burst of new connections does not starve the dispatcher's other events.
  */
 class ListenerImpl : public Listener {
 public:
@@ -23,14 +26,21 @@ public:
                const ListenerOptions& listener_options);
 
   /**
-   * Accept/process a new connection.
+   * Offer a new socket to the listener callbacks, and create a connection for it unless they take
+   * it over.
    * @param fd supplies the new connection's fd.
    * @param remote_address supplies the remote address for the new connection.
    * @param local_address supplies the local address for the new connection.
    */
-  virtual void newConnection(int fd, Address::InstanceConstSharedPtr remote_address,
-                             Address::InstanceConstSharedPtr local_address,
-                             bool using_original_dst);
+  void acceptConnection(int fd, Address::InstanceConstSharedPtr remote_address,
+                        Address::InstanceConstSharedPtr local_address, bool using_original_dst);
+
+  // Network::Listener
+  void newConnection(int fd, Address::InstanceConstSharedPtr remote_address,
+                     Address::InstanceConstSharedPtr local_address,
+                     bool using_original_dst) override;
+  void disable() override;
+  void enable() override;
 
   /**
    * @return the socket supplied to the listener at construction time
@@ -49,11 +59,10 @@ protected:
   const ListenerOptions options_;
 
 private:
-  static void errorCallback(evconnlistener* listener, void* context);
-  static void listenCallback(evconnlistener*, evutil_socket_t fd, sockaddr* remote_addr,
-                             int remote_addr_len, void* arg);
+  void onSocketEvent();
+  void acceptSocket(int fd, const sockaddr_storage& remote_addr, socklen_t remote_addr_len);
 
-  Event::Libevent::ListenerPtr listener_;
+  Event::FileEventPtr file_event_;
 };
 
 class SslListenerImpl : public ListenerImpl {
@@ -64,7 +73,7 @@ public:
       : ListenerImpl(conn_handler, dispatcher, socket, cb, scope, listener_options),
         ssl_ctx_(ssl_ctx) {}
 
-  // ListenerImpl
+  // Network::Listener
   void newConnection(int fd, Address::InstanceConstSharedPtr remote_address,
                      Address::InstanceConstSharedPtr local_address,
                      bool using_original_dst) override;
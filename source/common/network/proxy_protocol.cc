@@ -1,8 +1,11 @@
 #include "common/network/proxy_protocol.h"
 
+#include <netinet/in.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 #include <cstdint>
+#include <cstring>
 #include <memory>
 #include <string>
 
@@ -20,6 +23,9 @@
 namespace Envoy {
 namespace Network {
 
+const char ProxyProtocol::ActiveConnection::PROXY_PROTO_V2_SIGNATURE[] =
+    "\r\n\r\n\0\r\nQUIT\n";
+
 ProxyProtocol::ProxyProtocol(Stats::Scope& scope)
     : stats_{ALL_PROXY_PROTOCOL_STATS(POOL_COUNTER(scope))} {}
 
@@ -31,7 +37,7 @@ void ProxyProtocol::newConnection(Event::Dispatcher& dispatcher, int fd, Listene
 ProxyProtocol::ActiveConnection::ActiveConnection(ProxyProtocol& parent,
                                                   Event::Dispatcher& dispatcher, int fd,
                                                   ListenerImpl& listener)
-    : parent_(parent), fd_(fd), listener_(listener), search_index_(1) {
+    : parent_(parent), fd_(fd), listener_(listener) {
   file_event_ =
       dispatcher.createFileEvent(fd,
                                  [this](uint32_t events) {
@@ -58,11 +64,33 @@ void ProxyProtocol::ActiveConnection::onRead() {
 }
 
 void ProxyProtocol::ActiveConnection::onReadWorker() {
-  std::string proxy_line;
-  if (!readLine(fd_, proxy_line)) {
+  std::string header;
+  if (!readHeader(header)) {
     return;
   }
 
+  Address::InstanceConstSharedPtr remote_address;
+  Address::InstanceConstSharedPtr local_address;
+  if (header[0] == PROXY_PROTO_V2_SIGNATURE[0]) {
+    parseV2Header(header, remote_address, local_address);
+  } else {
+    parseV1Header(header, remote_address, local_address);
+  }
+
+  ListenerImpl& listener = listener_;
+  int fd = fd_;
+  fd_ = -1;
+
+  removeFromList(parent_.connections_);
+
+  listener.acceptConnection(fd, remote_address, local_address, true);
+}
+
+void ProxyProtocol::ActiveConnection::parseV1Header(
+    const std::string& header, Address::InstanceConstSharedPtr& remote_address,
+    Address::InstanceConstSharedPtr& local_address) {
+  std::string proxy_line = header;
+
   // Remove the line feed at the end
   StringUtil::rtrim(proxy_line);
 
@@ -75,8 +103,6 @@ void ProxyProtocol::ActiveConnection::onReadWorker() {
   }
 
   Address::IpVersion protocol_version;
-  Address::InstanceConstSharedPtr remote_address;
-  Address::InstanceConstSharedPtr local_address;
   if (line_parts[1] == "TCP4") {
     protocol_version = Address::IpVersion::v4;
     remote_address = Utility::parseInternetAddressAndPort(line_parts[2] + ":" + line_parts[4]);
@@ -100,17 +126,94 @@ void ProxyProtocol::ActiveConnection::onReadWorker() {
   if (remote_version != protocol_version || local_version != protocol_version) {
     throw EnvoyException("failed to read proxy protocol");
   }
-  // Check that both addresses are valid unicast addresses, as required for TCP
-  if (!remote_address->ip()->isUnicastAddress() || !local_address->ip()->isUnicastAddress()) {
+  checkUnicastAddresses(*remote_address, *local_address);
+}
+
+void ProxyProtocol::ActiveConnection::checkUnicastAddresses(
+    const Address::Instance& remote_address, const Address::Instance& local_address) {
+  if (!remote_address.ip()->isUnicastAddress() || !local_address.ip()->isUnicastAddress()) {
     throw EnvoyException("failed to read proxy protocol");
   }
-  ListenerImpl& listener = listener_;
-  int fd = fd_;
-  fd_ = -1;
+}
 
-  removeFromList(parent_.connections_);
+void ProxyProtocol::ActiveConnection::parseV2Header(
+    const std::string& header, Address::InstanceConstSharedPtr& remote_address,
+    Address::InstanceConstSharedPtr& local_address) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(header.data());
+  if ((data[12] >> 4) != PROXY_PROTO_V2_VERSION) {
+    throw EnvoyException("failed to read proxy protocol");
+  }
+  const uint8_t command = data[12] & 0xf;
+  const uint8_t family = data[13] >> 4;
+  const uint8_t transport = data[13] & 0xf;
+  if (command != PROXY_PROTO_V2_LOCAL && command != PROXY_PROTO_V2_PROXY) {
+    throw EnvoyException("failed to read proxy protocol");
+  }
 
-  listener.newConnection(fd, remote_address, local_address, true);
+  size_t address_length;
+  switch (family) {
+  case PROXY_PROTO_V2_AF_INET:
+    address_length = PROXY_PROTO_V2_INET_ADDRESS_LEN;
+    break;
+  case PROXY_PROTO_V2_AF_INET6:
+    address_length = PROXY_PROTO_V2_INET6_ADDRESS_LEN;
+    break;
+  case PROXY_PROTO_V2_AF_UNIX:
+    address_length = PROXY_PROTO_V2_UNIX_ADDRESS_LEN;
+    break;
+  default:
+    address_length = 0;
+  }
+  if (header.size() < PROXY_PROTO_V2_HEADER_LEN + address_length) {
+    throw EnvoyException("failed to read proxy protocol");
+  }
+
+  // The TLVs that follow the addresses are checked for consistency, but are otherwise skipped, as
+  // nothing consumes them yet.
+  if (command == PROXY_PROTO_V2_PROXY && family != PROXY_PROTO_V2_AF_UNSPEC) {
+    size_t offset = PROXY_PROTO_V2_HEADER_LEN + address_length;
+    while (offset < header.size()) {
+      if (offset + 3 > header.size()) {
+        throw EnvoyException("failed to read proxy protocol");
+      }
+      offset += 3 + ((data[offset + 1] << 8) | data[offset + 2]);
+    }
+    if (offset != header.size()) {
+      throw EnvoyException("failed to read proxy protocol");
+    }
+  }
+
+  const uint8_t* addresses = data + PROXY_PROTO_V2_HEADER_LEN;
+  if (command == PROXY_PROTO_V2_PROXY && transport == PROXY_PROTO_V2_STREAM &&
+      family == PROXY_PROTO_V2_AF_INET) {
+    sockaddr_in remote{};
+    sockaddr_in local{};
+    remote.sin_family = local.sin_family = AF_INET;
+    memcpy(&remote.sin_addr, addresses, 4);
+    memcpy(&local.sin_addr, addresses + 4, 4);
+    memcpy(&remote.sin_port, addresses + 8, 2);
+    memcpy(&local.sin_port, addresses + 10, 2);
+    remote_address = std::make_shared<Address::Ipv4Instance>(&remote);
+    local_address = std::make_shared<Address::Ipv4Instance>(&local);
+    checkUnicastAddresses(*remote_address, *local_address);
+  } else if (command == PROXY_PROTO_V2_PROXY && transport == PROXY_PROTO_V2_STREAM &&
+             family == PROXY_PROTO_V2_AF_INET6) {
+    sockaddr_in6 remote{};
+    sockaddr_in6 local{};
+    remote.sin6_family = local.sin6_family = AF_INET6;
+    memcpy(&remote.sin6_addr, addresses, 16);
+    memcpy(&local.sin6_addr, addresses + 16, 16);
+    memcpy(&remote.sin6_port, addresses + 32, 2);
+    memcpy(&local.sin6_port, addresses + 34, 2);
+    remote_address = std::make_shared<Address::Ipv6Instance>(remote);
+    local_address = std::make_shared<Address::Ipv6Instance>(local);
+    checkUnicastAddresses(*remote_address, *local_address);
+  } else {
+    // The connections of the proxy itself, such as its health checks, and the connections of
+    // other families or transports keep the addresses of the socket, as the protocol asks.
+    remote_address = Address::peerAddressFromFd(fd_);
+    local_address = Address::addressFromFd(fd_);
+  }
 }
 
 void ProxyProtocol::ActiveConnection::close() {
@@ -119,41 +222,69 @@ void ProxyProtocol::ActiveConnection::close() {
   removeFromList(parent_.connections_);
 }
 
-bool ProxyProtocol::ActiveConnection::readLine(int fd, std::string& s) {
-  while (buf_off_ < MAX_PROXY_PROTO_LEN) {
-    ssize_t nread = recv(fd, buf_ + buf_off_, MAX_PROXY_PROTO_LEN - buf_off_, MSG_PEEK);
+bool ProxyProtocol::ActiveConnection::readHeader(std::string& s) {
+  ssize_t nread = recv(fd_, buf_, MAX_PEEK_LEN, MSG_PEEK);
+  if (nread == -1 && errno == EAGAIN) {
+    return false;
+  } else if (nread < 1) {
+    throw EnvoyException("failed to read proxy protocol");
+  }
+  const size_t peeked = nread;
 
-    if (nread == -1 && errno == EAGAIN) {
-      return false;
-    } else if (nread < 1) {
+  size_t length;
+  if (buf_[0] == PROXY_PROTO_V2_SIGNATURE[0]) {
+    // The length of a V2 header is in its fixed part.
+    const size_t signature_length =
+        peeked < PROXY_PROTO_V2_SIGNATURE_LEN ? peeked : PROXY_PROTO_V2_SIGNATURE_LEN;
+    if (memcmp(buf_, PROXY_PROTO_V2_SIGNATURE, signature_length) != 0) {
       throw EnvoyException("failed to read proxy protocol");
     }
-
-    bool found = false;
-    // continue searching buf_ from where we left off
-    for (; search_index_ < buf_off_ + nread; search_index_++) {
-      if (buf_[search_index_] == '\n' && buf_[search_index_ - 1] == '\r') {
-        search_index_++;
-        found = true;
+    if (peeked < PROXY_PROTO_V2_HEADER_LEN) {
+      return false;
+    }
+    length = PROXY_PROTO_V2_HEADER_LEN +
+             ((static_cast<uint8_t>(buf_[14]) << 8) | static_cast<uint8_t>(buf_[15]));
+  } else {
+    // A V1 header ends with the first '\r\n'.
+    const size_t search_length = peeked < MAX_PROXY_PROTO_LEN ? peeked : MAX_PROXY_PROTO_LEN;
+    const char* end = nullptr;
+    for (size_t i = 1; i < search_length; i++) {
+      if (buf_[i] == '\n' && buf_[i - 1] == '\r') {
+        end = buf_ + i + 1;
         break;
       }
     }
+    if (end == nullptr) {
+      if (peeked >= MAX_PROXY_PROTO_LEN) {
+        throw EnvoyException("failed to read proxy protocol");
+      }
+      return false;
+    }
+    length = end - buf_;
+  }
 
-    // Read the data upto and including the line feed, if available, but not past it.
-    // This should never fail, as search_index_ - buf_off_ <= nread, so we're asking
-    // only for bytes we have already seen.
-    nread = recv(fd, buf_ + buf_off_, search_index_ - buf_off_, 0);
-    ASSERT(size_t(nread) == search_index_ - buf_off_);
-
-    buf_off_ += nread;
+  s.resize(length);
+  if (length > peeked) {
+    if (peeked < MAX_PEEK_LEN) {
+      return false;
+    }
 
-    if (found) {
-      s.assign(buf_, buf_off_);
-      return true;
+    // Only a V2 header with large TLVs doesn't fit in the buffer.
+    nread = recv(fd_, &s[0], length, MSG_PEEK);
+    if (nread == -1 && errno == EAGAIN) {
+      return false;
+    } else if (nread < 1) {
+      throw EnvoyException("failed to read proxy protocol");
+    } else if (size_t(nread) < length) {
+      return false;
     }
   }
 
-  throw EnvoyException("failed to read proxy protocol");
+  // Read the header only, the data after it is the connection's. This should never fail, as
+  // we're only asking for bytes we have already seen.
+  nread = recv(fd_, &s[0], length, 0);
+  ASSERT(size_t(nread) == length);
+  return true;
 }
 
 } // namespace Network
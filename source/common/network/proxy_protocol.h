@@ -1,10 +1,12 @@
 #pragma once
 
+#include <cstdint>
 #include <list>
 #include <memory>
 #include <string>
 
 #include "envoy/event/dispatcher.h"
+#include "envoy/network/address.h"
 #include "envoy/stats/stats_macros.h"
 
 #include "common/common/linked_object.h"
@@ -30,8 +32,8 @@ struct ProxyProtocolStats {
 };
 
 /**
- * Implementation the PROXY Protocol V1
- * (http://www.haproxy.org/download/1.5/doc/proxy-protocol.txt)
+ * Implementation the PROXY Protocol V1 and V2
+ * (http://www.haproxy.org/download/1.8/doc/proxy-protocol.txt)
  */
 class ProxyProtocol {
 public:
@@ -42,17 +44,46 @@ public:
     ~ActiveConnection();
 
   private:
+    // The longest V1 header, including the '\r\n'.
     static const size_t MAX_PROXY_PROTO_LEN = 108;
+    // The fixed part of a V2 header, which ends with the length of the rest of the header.
+    static const size_t PROXY_PROTO_V2_HEADER_LEN = 16;
+    // A V2 header starts with a signature that can't start a V1 header, followed by the version
+    // and command, the address family and transport, and the length of the addresses and TLVs.
+    static const char PROXY_PROTO_V2_SIGNATURE[];
+    static const size_t PROXY_PROTO_V2_SIGNATURE_LEN = 12;
+    static const uint8_t PROXY_PROTO_V2_VERSION = 0x2;
+    static const uint8_t PROXY_PROTO_V2_LOCAL = 0x0;
+    static const uint8_t PROXY_PROTO_V2_PROXY = 0x1;
+    static const uint8_t PROXY_PROTO_V2_AF_UNSPEC = 0x0;
+    static const uint8_t PROXY_PROTO_V2_AF_INET = 0x1;
+    static const uint8_t PROXY_PROTO_V2_AF_INET6 = 0x2;
+    static const uint8_t PROXY_PROTO_V2_AF_UNIX = 0x3;
+    static const uint8_t PROXY_PROTO_V2_STREAM = 0x1;
+    static const size_t PROXY_PROTO_V2_INET_ADDRESS_LEN = 12;
+    static const size_t PROXY_PROTO_V2_INET6_ADDRESS_LEN = 36;
+    static const size_t PROXY_PROTO_V2_UNIX_ADDRESS_LEN = 216;
+    // How much of the socket is peeked at once. V2 headers up to this length, which leaves room for
+    // TLVs after IPv6 addresses, take a single peek.
+    static const size_t MAX_PEEK_LEN = 536;
 
     void onRead();
     void onReadWorker();
 
     /**
-     * Helper function that attempts to read a line (delimited by '\r\n') from the socket.
-     * throws EnvoyException on any socket errors.
-     * @return bool true if a line should be read, false if more data is needed.
+     * Helper function that peeks at the socket until it holds a complete header, and then reads
+     * the header only.
+     * throws EnvoyException on any socket errors, or if the data can't start a header.
+     * @return bool true if a header was read into s, false if more data is needed.
      */
-    bool readLine(int fd, std::string& s);
+    bool readHeader(std::string& s);
+    void parseV1Header(const std::string& header, Address::InstanceConstSharedPtr& remote_address,
+                       Address::InstanceConstSharedPtr& local_address);
+    void parseV2Header(const std::string& header, Address::InstanceConstSharedPtr& remote_address,
+                       Address::InstanceConstSharedPtr& local_address);
+    // Both addresses must be unicast addresses, as required for TCP.
+    static void checkUnicastAddresses(const Address::Instance& remote_address,
+                                      const Address::Instance& local_address);
     void close();
 
     ProxyProtocol& parent_;
@@ -60,14 +91,8 @@ public:
     ListenerImpl& listener_;
     Event::FileEventPtr file_event_;
 
-    // The offset in buf_ that has been fully read
-    size_t buf_off_{};
-
-    // The index in buf_ where the search for '\r\n' should continue from
-    size_t search_index_;
-
-    // Stores the portion of the first line that has been read so far.
-    char buf_[MAX_PROXY_PROTO_LEN];
+    // Stores what was last peeked from the socket.
+    char buf_[MAX_PEEK_LEN];
   };
 
   ProxyProtocol(Stats::Scope& scope);
@@ -8,6 +8,7 @@
 #endif
 
 #include <netinet/ip.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 
 #include <cstdint>
@@ -21,6 +22,7 @@
 #include "envoy/stats/stats.h"
 
 #include "common/common/assert.h"
+#include "common/common/logger.h"
 #include "common/common/utility.h"
 #include "common/network/address_impl.h"
 #include "common/protobuf/protobuf.h"
@@ -358,5 +360,85 @@ bool Utility::portInRangeList(const Address::Instance& address, const std::list<
   return false;
 }
 
+namespace {
+
+// The options that the platform lacks are -1.
+#ifdef TCP_FASTOPEN
+const int TcpFastOpen = TCP_FASTOPEN;
+#else
+const int TcpFastOpen = -1;
+#endif
+#ifdef TCP_FASTOPEN_CONNECT
+const int TcpFastOpenConnect = TCP_FASTOPEN_CONNECT;
+#else
+const int TcpFastOpenConnect = -1;
+#endif
+#ifdef TCP_DEFER_ACCEPT
+const int TcpDeferAccept = TCP_DEFER_ACCEPT;
+#else
+const int TcpDeferAccept = -1;
+#endif
+#ifdef TCP_NOTSENT_LOWAT
+const int TcpNotSentLowat = TCP_NOTSENT_LOWAT;
+#else
+const int TcpNotSentLowat = -1;
+#endif
+#ifdef SO_BUSY_POLL
+const int SoBusyPoll = SO_BUSY_POLL;
+#else
+const int SoBusyPoll = -1;
+#endif
+
+void setSocketOption(int fd, int level, int option, const char* option_name, uint32_t value) {
+  if (option == -1) {
+    ENVOY_LOG_MISC(warn, "{} is not supported on this platform", option_name);
+    return;
+  }
+  const int int_value = static_cast<int>(value);
+  if (setsockopt(fd, level, option, &int_value, sizeof(int_value)) == -1) {
+    ENVOY_LOG_MISC(warn, "unable to set {} to {} on fd {}: {}", option_name, value, fd,
+                   strerror(errno));
+  }
+}
+
+void setSharedSocketOptions(int fd, const SocketOptions& options) {
+  if (options.notsent_lowat_bytes_ != 0) {
+    setSocketOption(fd, IPPROTO_TCP, TcpNotSentLowat, "TCP_NOTSENT_LOWAT",
+                    options.notsent_lowat_bytes_);
+  }
+  if (options.busy_poll_us_ != 0) {
+    setSocketOption(fd, SOL_SOCKET, SoBusyPoll, "SO_BUSY_POLL", options.busy_poll_us_);
+  }
+  if (options.receive_buffer_bytes_ != 0) {
+    setSocketOption(fd, SOL_SOCKET, SO_RCVBUF, "SO_RCVBUF", options.receive_buffer_bytes_);
+  }
+  if (options.send_buffer_bytes_ != 0) {
+    setSocketOption(fd, SOL_SOCKET, SO_SNDBUF, "SO_SNDBUF", options.send_buffer_bytes_);
+  }
+}
+
+} // namespace
+
+void Utility::setListenSocketOptions(int fd, const SocketOptions& options) {
+  if (options.tcp_fast_open_queue_length_ != 0) {
+    setSocketOption(fd, IPPROTO_TCP, TcpFastOpen, "TCP_FASTOPEN",
+                    options.tcp_fast_open_queue_length_);
+  }
+  if (options.defer_accept_seconds_ != 0) {
+    setSocketOption(fd, IPPROTO_TCP, TcpDeferAccept, "TCP_DEFER_ACCEPT",
+                    options.defer_accept_seconds_);
+  }
+  setSharedSocketOptions(fd, options);
+}
+
+void Utility::setClientSocketOptions(int fd, const SocketOptions& options) {
+  if (options.tcp_fast_open_connect_) {
+    // connect() then succeeds at once, and the first write goes out with the SYN if the host
+    // handed out a cookie before. Otherwise the kernel falls back to a regular handshake.
+    setSocketOption(fd, IPPROTO_TCP, TcpFastOpenConnect, "TCP_FASTOPEN_CONNECT", 1);
+  }
+  setSharedSocketOptions(fd, options);
+}
+
 } // namespace Network
 } // namespace Envoy
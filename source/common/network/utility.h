@@ -20,6 +20,8 @@ public:
   PortRange(uint32_t min, uint32_t max) : min_(min), max_(max) {}
 
   bool contains(uint32_t port) const { return (port >= min_ && port <= max_); }
+  uint32_t min() const { return min_; }
+  uint32_t max() const { return max_; }
 
 private:
   const uint32_t min_;
@@ -184,6 +186,22 @@ public:
    */
   static bool portInRangeList(const Address::Instance& address, const std::list<PortRange>& list);
 
+  /**
+   * Set the socket options of a listen socket. Options that are rejected by the kernel or that the
+   * platform lacks are logged and left unset.
+   * @param fd supplies the listen socket.
+   * @param options supplies the options to set. The options of upstream connections are ignored.
+   */
+  static void setListenSocketOptions(int fd, const SocketOptions& options);
+
+  /**
+   * Set the socket options of an upstream connection before it connects. Options that are
+   * rejected by the kernel or that the platform lacks are logged and left unset.
+   * @param fd supplies the socket of the connection.
+   * @param options supplies the options to set. The options of listen sockets are ignored.
+   */
+  static void setClientSocketOptions(int fd, const SocketOptions& options);
+
 private:
   static void throwWithMalformedIp(const std::string& ip_address);
 };
@@ -5,6 +5,7 @@
 #ifdef TCMALLOC
 
 #include "gperftools/heap-profiler.h"
+#include "gperftools/malloc_extension.h"
 #include "gperftools/profiler.h"
 
 namespace Envoy {
@@ -13,11 +14,20 @@ namespace Profiler {
 bool Cpu::profilerEnabled() { return ProfilingIsEnabledForAllThreads(); }
 
 bool Cpu::startProfiler(const std::string& output_path) {
+  // Both profilers use SIGPROF.
+  if (CpuSampler::running()) {
+    return false;
+  }
   return ProfilerStart(output_path.c_str());
 }
 
 void Cpu::stopProfiler() { ProfilerStop(); }
 
+bool Heap::heapSample(std::string& profile) {
+  MallocExtension::instance()->GetHeapSample(&profile);
+  return true;
+}
+
 void Heap::forceLink() {
   // Currently this is here to force the inclusion of the heap profiler during static linking.
   // Without this call the heap profiler will not be included and cannot be started via env
@@ -37,7 +47,281 @@ bool Cpu::profilerEnabled() { return false; }
 bool Cpu::startProfiler(const std::string&) { return false; }
 void Cpu::stopProfiler() {}
 
+bool Heap::heapSample(std::string&) { return false; }
+
 } // namespace Profiler
 } // namespace Envoy
 
 #endif // #ifdef TCMALLOC
+
+#ifdef __linux__
+
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace Envoy {
+namespace Profiler {
+
+namespace {
+
+// The frames of the signal handler and of the signal trampoline, which lead every sampled stack.
+const int SKIPPED_FRAMES = 2;
+
+// How many slots of the table a sample probes for its stack before it is dropped, which bounds the
+// time spent in the signal handler.
+const uint32_t MAX_PROBES = 64;
+
+enum StackState : uint32_t { Empty, Writing, Ready };
+
+/**
+ * A slot of the table of sampled stacks. The signal handler claims an empty slot by moving it to
+ * Writing, and then publishes the stack by moving it to Ready. A Ready stack does not change until
+ * the table is cleared, so only its count is updated concurrently.
+ */
+struct SampledStack {
+  std::atomic<uint32_t> state_;
+  uint64_t hash_;
+  uint32_t depth_;
+  void* pcs_[CpuSampler::MAX_DEPTH];
+  std::atomic<uint64_t> count_;
+};
+
+struct SampledThread {
+  pid_t tid_;
+  clockid_t clock_;
+  timer_t timer_;
+  bool has_timer_;
+};
+
+SampledStack stacks[CpuSampler::MAX_STACKS];
+std::atomic<uint64_t> dropped_samples{};
+// Signals that are delivered after the sampler stops are ignored.
+std::atomic<bool> recording{};
+
+// Guards the state below, but is never taken by the signal handler.
+std::mutex sampler_lock;
+std::vector<SampledThread> sampled_threads;
+bool sampler_running{};
+uint32_t sampler_hz{};
+
+uint64_t hashStack(void* const* pcs, uint32_t depth) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (uint32_t i = 0; i < depth; i++) {
+    hash = (hash ^ reinterpret_cast<uintptr_t>(pcs[i])) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+void recordStack(void* const* pcs, uint32_t depth) {
+  const uint64_t hash = hashStack(pcs, depth);
+  for (uint32_t probe = 0; probe < MAX_PROBES; probe++) {
+    SampledStack& stack = stacks[(hash + probe) % CpuSampler::MAX_STACKS];
+    uint32_t state = stack.state_.load(std::memory_order_acquire);
+    if (state == Empty &&
+        stack.state_.compare_exchange_strong(state, Writing, std::memory_order_acquire)) {
+      stack.hash_ = hash;
+      stack.depth_ = depth;
+      std::copy(pcs, pcs + depth, stack.pcs_);
+      stack.count_.store(1, std::memory_order_relaxed);
+      stack.state_.store(Ready, std::memory_order_release);
+      return;
+    }
+
+    if (state == Ready && stack.hash_ == hash && stack.depth_ == depth &&
+        std::equal(pcs, pcs + depth, stack.pcs_)) {
+      stack.count_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+
+  dropped_samples++;
+}
+
+void onSignal(int, siginfo_t*, void*) {
+  if (!recording.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  const int saved_errno = errno;
+  void* pcs[CpuSampler::MAX_DEPTH + SKIPPED_FRAMES];
+  const int depth = backtrace(pcs, CpuSampler::MAX_DEPTH + SKIPPED_FRAMES);
+  if (depth > SKIPPED_FRAMES) {
+    recordStack(pcs + SKIPPED_FRAMES, depth - SKIPPED_FRAMES);
+  }
+  errno = saved_errno;
+}
+
+void armTimer(SampledThread& thread) {
+  sigevent event{};
+  event.sigev_notify = SIGEV_THREAD_ID;
+  event.sigev_signo = SIGPROF;
+  event.sigev_notify_thread_id = thread.tid_;
+  if (timer_create(thread.clock_, &event, &thread.timer_) != 0) {
+    return;
+  }
+
+  const uint64_t period_ns = 1000000000ULL / sampler_hz;
+  itimerspec spec{};
+  spec.it_interval.tv_sec = period_ns / 1000000000ULL;
+  spec.it_interval.tv_nsec = period_ns % 1000000000ULL;
+  spec.it_value = spec.it_interval;
+  timer_settime(thread.timer_, 0, &spec, nullptr);
+  thread.has_timer_ = true;
+}
+
+void disarmTimer(SampledThread& thread) {
+  if (thread.has_timer_) {
+    timer_delete(thread.timer_);
+    thread.has_timer_ = false;
+  }
+}
+
+} // namespace
+
+void CpuSampler::registerThread() {
+  SampledThread thread{static_cast<pid_t>(syscall(SYS_gettid)), {}, {}, false};
+  if (pthread_getcpuclockid(pthread_self(), &thread.clock_) != 0) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> guard(sampler_lock);
+  sampled_threads.push_back(thread);
+  if (sampler_running) {
+    armTimer(sampled_threads.back());
+  }
+}
+
+void CpuSampler::unregisterThread() {
+  const pid_t tid = syscall(SYS_gettid);
+  std::unique_lock<std::mutex> guard(sampler_lock);
+  auto it = std::find_if(sampled_threads.begin(), sampled_threads.end(),
+                         [tid](const SampledThread& thread) { return thread.tid_ == tid; });
+  if (it != sampled_threads.end()) {
+    disarmTimer(*it);
+    sampled_threads.erase(it);
+  }
+}
+
+bool CpuSampler::start(uint32_t hz) {
+  std::unique_lock<std::mutex> guard(sampler_lock);
+  if (sampler_running || hz == 0 || Cpu::profilerEnabled()) {
+    return false;
+  }
+
+  // The first backtrace loads the unwinder, which must not happen in the handler. The handler is
+  // installed on every start, as the CPU profiler replaces it, and then stays, since a signal that
+  // is already pending when the sampler stops would otherwise kill the process.
+  void* pc;
+  backtrace(&pc, 1);
+  struct sigaction action {};
+  action.sa_sigaction = onSignal;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, nullptr) != 0) {
+    return false;
+  }
+
+  for (SampledStack& stack : stacks) {
+    stack.state_.store(Empty, std::memory_order_relaxed);
+  }
+  dropped_samples = 0;
+  sampler_hz = hz;
+  sampler_running = true;
+  recording = true;
+  for (SampledThread& thread : sampled_threads) {
+    armTimer(thread);
+  }
+  return true;
+}
+
+void CpuSampler::stop() {
+  std::unique_lock<std::mutex> guard(sampler_lock);
+  for (SampledThread& thread : sampled_threads) {
+    disarmTimer(thread);
+  }
+  recording = false;
+  sampler_running = false;
+}
+
+bool CpuSampler::running() {
+  std::unique_lock<std::mutex> guard(sampler_lock);
+  return sampler_running;
+}
+
+uint64_t CpuSampler::droppedSamples() { return dropped_samples; }
+
+std::string CpuSampler::profile() {
+  std::string profile;
+  auto add_word = [&profile](uintptr_t word) -> void {
+    profile.append(reinterpret_cast<const char*>(&word), sizeof(word));
+  };
+
+  uint32_t hz;
+  {
+    std::unique_lock<std::mutex> guard(sampler_lock);
+    hz = sampler_hz == 0 ? 1 : sampler_hz;
+  }
+
+  // The header holds the format version and the sampling period in microseconds.
+  add_word(0);
+  add_word(3);
+  add_word(0);
+  add_word(1000000 / hz);
+  add_word(0);
+
+  for (const SampledStack& stack : stacks) {
+    if (stack.state_.load(std::memory_order_acquire) != Ready) {
+      continue;
+    }
+    add_word(stack.count_.load(std::memory_order_relaxed));
+    add_word(stack.depth_);
+    for (uint32_t i = 0; i < stack.depth_; i++) {
+      add_word(reinterpret_cast<uintptr_t>(stack.pcs_[i]));
+    }
+  }
+
+  // The trailer is followed by the memory map of the process, which pprof symbolizes with.
+  add_word(0);
+  add_word(1);
+  add_word(0);
+  std::ifstream maps("/proc/self/maps");
+  profile.append(std::istreambuf_iterator<char>(maps), std::istreambuf_iterator<char>());
+  return profile;
+}
+
+} // namespace Profiler
+} // namespace Envoy
+
+#else
+
+namespace Envoy {
+namespace Profiler {
+
+void CpuSampler::registerThread() {}
+void CpuSampler::unregisterThread() {}
+bool CpuSampler::start(uint32_t) { return false; }
+void CpuSampler::stop() {}
+bool CpuSampler::running() { return false; }
+uint64_t CpuSampler::droppedSamples() { return 0; }
+std::string CpuSampler::profile() { return ""; }
+
+} // namespace Profiler
+} // namespace Envoy
+
+#endif // #ifdef __linux__
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 namespace Envoy {
@@ -27,10 +28,80 @@ public:
   static void stopProfiler();
 };
 
+/**
+ * Continuous CPU profiling that samples the stacks of the registered threads in memory. Each
+ * thread is interrupted at a fixed rate of its own CPU time, so the overhead is bounded per thread
+ * and idle threads are not sampled. The samples of identical stacks are aggregated into a fixed
+ * size table, so the memory use does not grow with the length of the profile. Only supported on
+ * Linux. Cannot run while the CPU profiler runs, since both use SIGPROF.
+ */
+class CpuSampler {
+public:
+  /**
+   * The deepest stack that is sampled. Deeper stacks are truncated.
+   */
+  static const uint32_t MAX_DEPTH = 64;
+
+  /**
+   * The number of distinct stacks that are aggregated. Samples of further stacks are dropped.
+   */
+  static const uint32_t MAX_STACKS = 4096;
+
+  /**
+   * Register the calling thread to be sampled while the sampler runs. A thread must unregister
+   * itself before it exits.
+   */
+  static void registerThread();
+
+  /**
+   * Stop sampling the calling thread.
+   */
+  static void unregisterThread();
+
+  /**
+   * Clear the samples and start sampling the registered threads.
+   * @param hz supplies the number of samples per second of CPU time of each thread.
+   * @return bool whether the sampler started. It does not start if it is not supported, is
+   *         already running, or the CPU profiler is running.
+   */
+  static bool start(uint32_t hz);
+
+  /**
+   * Stop sampling. The samples are kept until the next start().
+   */
+  static void stop();
+
+  /**
+   * @return bool whether the sampler is running.
+   */
+  static bool running();
+
+  /**
+   * @return uint64_t the number of samples that were dropped because the table of stacks was full.
+   */
+  static uint64_t droppedSamples();
+
+  /**
+   * @return std::string the samples since the last start() in the binary CPU profile format of
+   *         gperftools, which pprof reads. May be called while the sampler runs.
+   */
+  static std::string profile();
+};
+
 /**
  * Process wide heap profiling
  */
 class Heap {
+public:
+  /**
+   * Get a sample of the live heap allocations in the heap profile format of gperftools, which
+   * pprof reads. The allocations are only sampled if the process was started with
+   * TCMALLOC_SAMPLE_PARAMETER set to the average number of bytes between samples.
+   * @param profile supplies the string to write the profile to.
+   * @return bool whether heap samples are supported by the build.
+   */
+  static bool heapSample(std::string& profile);
+
 private:
   static void forceLink();
 };
@@ -1,5 +1,7 @@
 #include "common/protobuf/utility.h"
 
+#include <limits>
+
 #include "common/common/assert.h"
 #include "common/filesystem/filesystem_impl.h"
 #include "common/json/json_loader.h"
@@ -27,16 +29,23 @@ void MessageUtil::loadFromYaml(const std::string& yaml, Protobuf::Message& messa
 }
 
 void MessageUtil::loadFromFile(const std::string& path, Protobuf::Message& message) {
-  const std::string contents = Filesystem::fileReadToEnd(path);
-  // If the filename ends with .pb, attempt to parse it as a binary proto.
+  // If the filename ends with .pb, attempt to parse it as a binary proto. Binary files are parsed
+  // straight from a mapping of the file, since they may be large and need no other processing.
   if (StringUtil::endsWith(path, ".pb")) {
-    // Attempt to parse the binary format.
-    if (message.ParseFromString(contents)) {
-      return;
+    const Filesystem::MappedFile file(path);
+    if (file.size() <= static_cast<size_t>(std::numeric_limits<int>::max())) {
+      Protobuf::io::CodedInputStream stream(reinterpret_cast<const uint8_t*>(file.data()),
+                                            static_cast<int>(file.size()));
+      // A file may well be larger than the default limit, which is meant for network input.
+      stream.SetTotalBytesLimit(std::numeric_limits<int>::max(), -1);
+      if (message.ParseFromCodedStream(&stream) && stream.ConsumedEntireMessage()) {
+        return;
+      }
     }
     throw EnvoyException("Unable to parse file \"" + path + "\" as a binary protobuf (type " +
                          message.GetTypeName() + ")");
   }
+  const std::string contents = Filesystem::fileReadToEnd(path);
   // If the filename ends with .pb_text, attempt to parse it as a text proto.
   if (StringUtil::endsWith(path, ".pb_text")) {
     if (Protobuf::TextFormat::ParseFromString(contents, &message)) {
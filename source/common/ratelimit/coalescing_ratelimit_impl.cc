@@ -0,0 +1,174 @@
+#include "common/ratelimit/coalescing_ratelimit_impl.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace RateLimit {
+
+CoalescingConfig::CoalescingConfig(const Json::Object& config)
+    : cache_ttl_(config.getInteger("cache_ttl_ms", 0)),
+      max_cache_entries_(config.getInteger("max_cache_entries", 1024)) {}
+
+RequestCoalescer::RequestCoalescer(const CoalescingConfig& config,
+                                   MonotonicTimeSource& time_source, Event::Dispatcher& dispatcher,
+                                   ClientCreateCb client)
+    : config_(config), time_source_(time_source), dispatcher_(dispatcher), client_(client) {}
+
+RequestCoalescer::~RequestCoalescer() {
+  for (auto& call : pending_calls_) {
+    call.second->client_->cancel();
+  }
+}
+
+void RequestCoalescer::limit(CoalescingClientImpl& client, const std::string& domain,
+                             const std::vector<Descriptor>& descriptors,
+                             const Tracing::TransportContext& context) {
+  ASSERT(client.callbacks_ != nullptr);
+  const std::string key = requestKey(domain, descriptors);
+  if (cached(key, time_source_.currentTime())) {
+    RequestCallbacks& callbacks = *client.callbacks_;
+    client.callbacks_ = nullptr;
+    callbacks.complete(LimitStatus::OK);
+    return;
+  }
+
+  auto existing_call = pending_calls_.find(key);
+  if (existing_call != pending_calls_.end()) {
+    std::list<CoalescingClientImpl*>& waiters = existing_call->second->waiters_;
+    client.waiters_ = &waiters;
+    client.waiter_ = waiters.insert(waiters.end(), &client);
+    return;
+  }
+
+  // The call is in the map before it starts, since it may complete inline.
+  PendingCall* call = new PendingCall(*this, key, client_());
+  pending_calls_.emplace(key, PendingCallPtr{call});
+  client.waiters_ = &call->waiters_;
+  client.waiter_ = call->waiters_.insert(call->waiters_.end(), &client);
+  call->client_->limit(*call, domain, descriptors, context);
+}
+
+void RequestCoalescer::cancel(CoalescingClientImpl& client) {
+  // The call goes on without the request, its response is still cached.
+  if (client.waiters_ != nullptr) {
+    client.waiters_->erase(client.waiter_);
+    client.waiters_ = nullptr;
+  }
+  client.callbacks_ = nullptr;
+}
+
+std::string RequestCoalescer::requestKey(const std::string& domain,
+                                         const std::vector<Descriptor>& descriptors) {
+  // Every string is prefixed with its length, so that different requests never share a key.
+  std::string key;
+  const auto append = [&key](const std::string& value) -> void {
+    key.append(std::to_string(value.size()));
+    key.push_back(':');
+    key.append(value);
+  };
+
+  append(domain);
+  for (const Descriptor& descriptor : descriptors) {
+    key.append(std::to_string(descriptor.entries_.size()));
+    key.push_back(';');
+    for (const DescriptorEntry& entry : descriptor.entries_) {
+      append(entry.key_);
+      append(entry.value_);
+    }
+  }
+  return key;
+}
+
+bool RequestCoalescer::cached(const std::string& key, MonotonicTime now) {
+  auto entry = cache_.find(key);
+  if (entry == cache_.end()) {
+    return false;
+  }
+  if (entry->second <= now) {
+    cache_.erase(entry);
+    return false;
+  }
+  return true;
+}
+
+void RequestCoalescer::cache(const std::string& key, MonotonicTime now) {
+  if (config_.cache_ttl_.count() == 0) {
+    return;
+  }
+
+  if (cache_.size() >= config_.max_cache_entries_ && cache_.find(key) == cache_.end()) {
+    for (auto entry = cache_.begin(); entry != cache_.end();) {
+      if (entry->second <= now) {
+        entry = cache_.erase(entry);
+      } else {
+        ++entry;
+      }
+    }
+    if (cache_.size() >= config_.max_cache_entries_) {
+      return;
+    }
+  }
+  cache_[key] = now + config_.cache_ttl_;
+}
+
+void RequestCoalescer::PendingCall::complete(LimitStatus status) {
+  if (status == LimitStatus::OK) {
+    parent_.cache(key_, parent_.time_source_.currentTime());
+  }
+
+  // The client may still be on the stack. Once the call is out of the map, the requests that the
+  // waiters trigger start a new call.
+  auto call = parent_.pending_calls_.find(key_);
+  ASSERT(call != parent_.pending_calls_.end() && call->second.get() == this);
+  parent_.dispatcher_.deferredDelete(std::move(call->second));
+  parent_.pending_calls_.erase(call);
+
+  // A waiter may cancel the other waiters when it completes.
+  while (!waiters_.empty()) {
+    CoalescingClientImpl* waiter = waiters_.front();
+    waiters_.pop_front();
+    waiter->waiters_ = nullptr;
+    RequestCallbacks& callbacks = *waiter->callbacks_;
+    waiter->callbacks_ = nullptr;
+    callbacks.complete(status);
+  }
+}
+
+CoalescingClientImpl::~CoalescingClientImpl() { ASSERT(!callbacks_); }
+
+void CoalescingClientImpl::cancel() {
+  ASSERT(callbacks_ != nullptr);
+  coalescer_.cancel(*this);
+}
+
+void CoalescingClientImpl::limit(RequestCallbacks& callbacks, const std::string& domain,
+                                 const std::vector<Descriptor>& descriptors,
+                                 const Tracing::TransportContext& context) {
+  ASSERT(callbacks_ == nullptr);
+  callbacks_ = &callbacks;
+  coalescer_.limit(*this, domain, descriptors, context);
+}
+
+CoalescingFactoryImpl::CoalescingFactoryImpl(const Json::Object& config,
+                                             ThreadLocal::SlotAllocator& tls,
+                                             MonotonicTimeSource& time_source,
+                                             ClientCreateCb client)
+    : config_(config), tls_(tls.allocateSlot()) {
+  tls_->set([this, &time_source, client](
+                Event::Dispatcher& dispatcher) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return ThreadLocal::ThreadLocalObjectSharedPtr{
+        new RequestCoalescer(config_, time_source, dispatcher, client)};
+  });
+}
+
+ClientPtr CoalescingFactoryImpl::create(const Optional<std::chrono::milliseconds>&) {
+  return ClientPtr{new CoalescingClientImpl(tls_->getTyped<RequestCoalescer>())};
+}
+
+} // namespace RateLimit
+} // namespace Envoy
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "envoy/common/optional.h"
+#include "envoy/common/time.h"
+#include "envoy/event/deferred_deletable.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/json/json_object.h"
+#include "envoy/ratelimit/ratelimit.h"
+#include "envoy/thread_local/thread_local.h"
+
+namespace Envoy {
+namespace RateLimit {
+
+class CoalescingClientImpl;
+
+/**
+ * Configuration of the coalescing of the rate limit service calls, shared by all of the workers.
+ */
+struct CoalescingConfig {
+  CoalescingConfig(const Json::Object& config);
+
+  // How long a descriptor set that the rate limit service found under limit is not checked again.
+  const std::chrono::milliseconds cache_ttl_;
+  const uint64_t max_cache_entries_;
+};
+
+/**
+ * The rate limit service calls of a worker. Concurrent requests with the same domain and
+ * descriptors share one call, and the descriptors that are under limit are cached for a while.
+ * Errors and over limit responses are not cached.
+ */
+class RequestCoalescer : public ThreadLocal::ThreadLocalObject {
+public:
+  /**
+   * @param client supplies the callback that creates the clients of the calls.
+   */
+  RequestCoalescer(const CoalescingConfig& config, MonotonicTimeSource& time_source,
+                   Event::Dispatcher& dispatcher, ClientCreateCb client);
+  ~RequestCoalescer();
+
+  /**
+   * Limit a request. The request is either completed inline from the cache, or waits for the call
+   * of its domain and descriptors.
+   */
+  void limit(CoalescingClientImpl& client, const std::string& domain,
+             const std::vector<Descriptor>& descriptors, const Tracing::TransportContext& context);
+
+  /**
+   * Stop waiting for the call of a request.
+   */
+  void cancel(CoalescingClientImpl& client);
+
+  /**
+   * @return uint64_t the number of calls in flight.
+   */
+  uint64_t pendingCalls() const { return pending_calls_.size(); }
+
+  /**
+   * @return uint64_t the number of cached descriptor sets, including the expired ones.
+   */
+  uint64_t cacheSize() const { return cache_.size(); }
+
+  static std::string requestKey(const std::string& domain,
+                                const std::vector<Descriptor>& descriptors);
+
+private:
+  struct PendingCall : public RequestCallbacks, public Event::DeferredDeletable {
+    PendingCall(RequestCoalescer& parent, const std::string& key, ClientPtr&& client)
+        : parent_(parent), key_(key), client_(std::move(client)) {}
+
+    // RateLimit::RequestCallbacks
+    void complete(LimitStatus status) override;
+
+    RequestCoalescer& parent_;
+    const std::string key_;
+    ClientPtr client_;
+    std::list<CoalescingClientImpl*> waiters_;
+  };
+
+  typedef std::unique_ptr<PendingCall> PendingCallPtr;
+
+  bool cached(const std::string& key, MonotonicTime now);
+  void cache(const std::string& key, MonotonicTime now);
+
+  const CoalescingConfig& config_;
+  MonotonicTimeSource& time_source_;
+  Event::Dispatcher& dispatcher_;
+  ClientCreateCb client_;
+  std::unordered_map<std::string, PendingCallPtr> pending_calls_;
+  // The expiration time of the descriptor sets that are under limit.
+  std::unordered_map<std::string, MonotonicTime> cache_;
+};
+
+/**
+ * A client that waits for the call of its request in the coalescer of the worker.
+ */
+class CoalescingClientImpl : public Client {
+public:
+  CoalescingClientImpl(RequestCoalescer& coalescer) : coalescer_(coalescer) {}
+  ~CoalescingClientImpl();
+
+  // RateLimit::Client
+  void cancel() override;
+  void limit(RequestCallbacks& callbacks, const std::string& domain,
+             const std::vector<Descriptor>& descriptors,
+             const Tracing::TransportContext& context) override;
+
+private:
+  RequestCoalescer& coalescer_;
+  RequestCallbacks* callbacks_{};
+  // The waiter entry of the client in the call, while the request waits for it.
+  std::list<CoalescingClientImpl*>* waiters_{};
+  std::list<CoalescingClientImpl*>::iterator waiter_;
+
+  friend class RequestCoalescer;
+};
+
+class CoalescingFactoryImpl : public ClientFactory {
+public:
+  /**
+   * @param client supplies the callback that creates the clients of the calls. It is called on the
+   *        workers.
+   */
+  CoalescingFactoryImpl(const Json::Object& config, ThreadLocal::SlotAllocator& tls,
+                        MonotonicTimeSource& time_source, ClientCreateCb client);
+
+  // RateLimit::ClientFactory
+  // The timeout of the calls is the one of the clients that the callback creates.
+  ClientPtr create(const Optional<std::chrono::milliseconds>& timeout) override;
+
+private:
+  const CoalescingConfig config_;
+  ThreadLocal::SlotPtr tls_;
+};
+
+typedef std::shared_ptr<CoalescingFactoryImpl> CoalescingFactoryImplSharedPtr;
+
+} // namespace RateLimit
+} // namespace Envoy
@@ -0,0 +1,163 @@
+#include "common/ratelimit/local_ratelimit_impl.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "envoy/common/exception.h"
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace RateLimit {
+
+TokenBucket::TokenBucket(uint64_t size, uint64_t fill_rate, MonotonicTime now)
+    : size_(size), fill_rate_(fill_rate), tokens_(size), last_fill_(now) {}
+
+bool TokenBucket::consume(MonotonicTime now) {
+  const std::chrono::duration<double> elapsed = now - last_fill_;
+  tokens_ = std::min(size_, tokens_ + elapsed.count() * fill_rate_);
+  last_fill_ = now;
+  if (tokens_ < 1) {
+    return false;
+  }
+  tokens_--;
+  return true;
+}
+
+LocalRateLimitConfig::LocalRateLimitConfig(const Json::Object& config) {
+  for (const Json::ObjectSharedPtr& limit : config.getObjectArray("limits")) {
+    LocalLimit local_limit;
+    for (const Json::ObjectSharedPtr& entry : limit->getObjectArray("descriptor")) {
+      local_limit.descriptor_.entries_.push_back(
+          {entry->getString("key"), entry->getString("value")});
+    }
+    local_limit.requests_per_second_ = limit->getInteger("requests_per_second");
+    local_limit.burst_ = limit->getInteger("burst", local_limit.requests_per_second_);
+
+    if (!limit_indexes_.emplace(descriptorKey(local_limit.descriptor_), limits_.size()).second) {
+      throw EnvoyException("rate limit: duplicate local limit descriptor");
+    }
+    limits_.push_back(std::move(local_limit));
+  }
+
+  if (config.hasObject("global_sync")) {
+    const Json::ObjectSharedPtr global_sync = config.getObject("global_sync");
+    global_sync_ = true;
+    max_pending_global_checks_ = global_sync->getInteger("max_pending", 64);
+    global_over_limit_duration_ =
+        std::chrono::milliseconds(global_sync->getInteger("over_limit_ms", 1000));
+  }
+}
+
+Optional<size_t> LocalRateLimitConfig::limitIndex(const Descriptor& descriptor) const {
+  auto index = limit_indexes_.find(descriptorKey(descriptor));
+  if (index == limit_indexes_.end()) {
+    return Optional<size_t>();
+  }
+  return Optional<size_t>(index->second);
+}
+
+std::string LocalRateLimitConfig::descriptorKey(const Descriptor& descriptor) {
+  std::string key;
+  for (const DescriptorEntry& entry : descriptor.entries_) {
+    key.append(entry.key_);
+    key.push_back('\0');
+    key.append(entry.value_);
+    key.push_back('\0');
+  }
+  return key;
+}
+
+LocalRateLimiter::LocalRateLimiter(const LocalRateLimitConfig& config,
+                                   MonotonicTimeSource& time_source, Event::Dispatcher& dispatcher,
+                                   ClientCreateCb global_client)
+    : config_(config), time_source_(time_source), dispatcher_(dispatcher),
+      global_client_(global_client) {
+  const MonotonicTime now = time_source_.currentTime();
+  for (const LocalLimit& limit : config_.limits()) {
+    states_.push_back({TokenBucket(limit.burst_, limit.requests_per_second_, now), now});
+  }
+}
+
+LocalRateLimiter::~LocalRateLimiter() {
+  for (const GlobalCheckPtr& check : pending_checks_) {
+    check->client_->cancel();
+  }
+}
+
+LimitStatus LocalRateLimiter::limit(const std::string& domain,
+                                    const std::vector<Descriptor>& descriptors,
+                                    const Tracing::TransportContext& context) {
+  matched_limits_.clear();
+  for (const Descriptor& descriptor : descriptors) {
+    const Optional<size_t> index = config_.limitIndex(descriptor);
+    if (index.valid()) {
+      matched_limits_.push_back(index.value());
+    }
+  }
+  if (matched_limits_.empty()) {
+    return LimitStatus::OK;
+  }
+
+  const MonotonicTime now = time_source_.currentTime();
+  for (size_t index : matched_limits_) {
+    if (states_[index].global_over_limit_until_ > now) {
+      return LimitStatus::OverLimit;
+    }
+  }
+  bool over_limit = false;
+  for (size_t index : matched_limits_) {
+    if (!states_[index].bucket_.consume(now)) {
+      over_limit = true;
+    }
+  }
+  if (over_limit) {
+    return LimitStatus::OverLimit;
+  }
+
+  // When too many checks are in flight, the request is only limited locally.
+  if (global_client_ && pending_checks_.size() < config_.maxPendingGlobalChecks()) {
+    GlobalCheckPtr new_check(new GlobalCheck(*this, global_client_(), matched_limits_));
+    GlobalCheck& check = *new_check;
+    new_check->moveIntoList(std::move(new_check), pending_checks_);
+    check.client_->limit(check, domain, descriptors, context);
+  }
+  return LimitStatus::OK;
+}
+
+void LocalRateLimiter::GlobalCheck::complete(LimitStatus status) {
+  // Errors fail open, the local limits still apply.
+  if (status == LimitStatus::OverLimit) {
+    const MonotonicTime until =
+        parent_.time_source_.currentTime() + parent_.config_.globalOverLimitDuration();
+    for (size_t index : limits_) {
+      parent_.states_[index].global_over_limit_until_ = until;
+    }
+  }
+
+  // The client may still be on the stack.
+  parent_.dispatcher_.deferredDelete(removeFromList(parent_.pending_checks_));
+}
+
+LocalFactoryImpl::LocalFactoryImpl(const Json::Object& config, ThreadLocal::SlotAllocator& tls,
+                                   MonotonicTimeSource& time_source, ClientCreateCb global_client)
+    : config_(config), tls_(tls.allocateSlot()) {
+  if (!config_.globalSync()) {
+    global_client = nullptr;
+  }
+  tls_->set([this, &time_source, global_client](
+                Event::Dispatcher& dispatcher) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return ThreadLocal::ThreadLocalObjectSharedPtr{
+        new LocalRateLimiter(config_, time_source, dispatcher, global_client)};
+  });
+}
+
+ClientPtr LocalFactoryImpl::create(const Optional<std::chrono::milliseconds>&) {
+  return ClientPtr{new LocalClientImpl(tls_->getTyped<LocalRateLimiter>())};
+}
+
+} // namespace RateLimit
+} // namespace Envoy
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "envoy/common/optional.h"
+#include "envoy/common/time.h"
+#include "envoy/event/deferred_deletable.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/json/json_object.h"
+#include "envoy/ratelimit/ratelimit.h"
+#include "envoy/thread_local/thread_local.h"
+
+#include "common/common/linked_object.h"
+
+namespace Envoy {
+namespace RateLimit {
+
+/**
+ * A bucket of tokens that is refilled at a constant rate, up to its size. The bucket is not thread
+ * safe, every worker has its own buckets.
+ */
+class TokenBucket {
+public:
+  /**
+   * @param size supplies the maximum number of tokens, which the bucket starts with.
+   * @param fill_rate supplies the number of tokens added per second.
+   * @param now supplies the current time.
+   */
+  TokenBucket(uint64_t size, uint64_t fill_rate, MonotonicTime now);
+
+  /**
+   * Take a token if one is available.
+   * @param now supplies the current time.
+   * @return bool whether a token was taken.
+   */
+  bool consume(MonotonicTime now);
+
+private:
+  const double size_;
+  const double fill_rate_;
+  double tokens_;
+  MonotonicTime last_fill_;
+};
+
+/**
+ * A local limit on the requests that have a descriptor.
+ */
+struct LocalLimit {
+  Descriptor descriptor_;
+  uint64_t requests_per_second_;
+  uint64_t burst_;
+};
+
+/**
+ * Configuration of the local rate limits, shared by all of the workers.
+ */
+class LocalRateLimitConfig {
+public:
+  LocalRateLimitConfig(const Json::Object& config);
+
+  const std::vector<LocalLimit>& limits() const { return limits_; }
+
+  /**
+   * @return Optional<size_t> the index of the limit of a descriptor, if it has one.
+   */
+  Optional<size_t> limitIndex(const Descriptor& descriptor) const;
+
+  /**
+   * @return bool whether the requests that are under the local limits are also checked with the
+   *         global rate limit service.
+   */
+  bool globalSync() const { return global_sync_; }
+
+  /**
+   * @return uint64_t the maximum number of global checks that a worker has in flight.
+   */
+  uint64_t maxPendingGlobalChecks() const { return max_pending_global_checks_; }
+
+  /**
+   * @return std::chrono::milliseconds how long the limits of a request that the global rate limit
+   *         service found over limit reject every request.
+   */
+  std::chrono::milliseconds globalOverLimitDuration() const {
+    return global_over_limit_duration_;
+  }
+
+private:
+  static std::string descriptorKey(const Descriptor& descriptor);
+
+  std::vector<LocalLimit> limits_;
+  std::unordered_map<std::string, size_t> limit_indexes_;
+  bool global_sync_{};
+  uint64_t max_pending_global_checks_{};
+  std::chrono::milliseconds global_over_limit_duration_{};
+};
+
+/**
+ * The local rate limits of a worker. Every limit of a request takes a token from the bucket of
+ * the worker. A request that is under its local limits is optionally checked with the global rate
+ * limit service in the background. The request is not delayed by the check, but if the global
+ * service finds it over limit, its limits reject every request for a while.
+ */
+class LocalRateLimiter : public ThreadLocal::ThreadLocalObject {
+public:
+  /**
+   * @param global_client supplies the callback that creates a global rate limit client, if the
+   *        requests are checked with the global rate limit service.
+   */
+  LocalRateLimiter(const LocalRateLimitConfig& config, MonotonicTimeSource& time_source,
+                   Event::Dispatcher& dispatcher, ClientCreateCb global_client);
+  ~LocalRateLimiter();
+
+  /**
+   * Limit a request. The descriptors without a local limit are not limited.
+   * @return LimitStatus OverLimit if any of the limits of the request is over limit, OK otherwise.
+   */
+  LimitStatus limit(const std::string& domain, const std::vector<Descriptor>& descriptors,
+                    const Tracing::TransportContext& context);
+
+  /**
+   * @return uint64_t the number of global checks in flight.
+   */
+  uint64_t pendingGlobalChecks() const { return pending_checks_.size(); }
+
+private:
+  struct LimitState {
+    TokenBucket bucket_;
+    MonotonicTime global_over_limit_until_;
+  };
+
+  class GlobalCheck : public RequestCallbacks,
+                      public Event::DeferredDeletable,
+                      public LinkedObject<GlobalCheck> {
+  public:
+    GlobalCheck(LocalRateLimiter& parent, ClientPtr&& client, const std::vector<size_t>& limits)
+        : parent_(parent), client_(std::move(client)), limits_(limits) {}
+
+    // RateLimit::RequestCallbacks
+    void complete(LimitStatus status) override;
+
+    LocalRateLimiter& parent_;
+    ClientPtr client_;
+    const std::vector<size_t> limits_;
+  };
+
+  typedef std::unique_ptr<GlobalCheck> GlobalCheckPtr;
+
+  const LocalRateLimitConfig& config_;
+  MonotonicTimeSource& time_source_;
+  Event::Dispatcher& dispatcher_;
+  ClientCreateCb global_client_;
+  std::vector<LimitState> states_;
+  std::list<GlobalCheckPtr> pending_checks_;
+  // The indexes of the limits of the current request.
+  std::vector<size_t> matched_limits_;
+};
+
+/**
+ * A client that completes every limit request with the local rate limits of the worker.
+ */
+class LocalClientImpl : public Client {
+public:
+  LocalClientImpl(LocalRateLimiter& limiter) : limiter_(limiter) {}
+
+  // RateLimit::Client
+  // The limit request is always complete by the time limit() returns.
+  void cancel() override {}
+  void limit(RequestCallbacks& callbacks, const std::string& domain,
+             const std::vector<Descriptor>& descriptors,
+             const Tracing::TransportContext& context) override {
+    callbacks.complete(limiter_.limit(domain, descriptors, context));
+  }
+
+private:
+  LocalRateLimiter& limiter_;
+};
+
+class LocalFactoryImpl : public ClientFactory {
+public:
+  /**
+   * @param global_client supplies the callback that creates a global rate limit client, used if
+   *        the config enables the global sync. It is called on the workers.
+   */
+  LocalFactoryImpl(const Json::Object& config, ThreadLocal::SlotAllocator& tls,
+                   MonotonicTimeSource& time_source, ClientCreateCb global_client);
+
+  // RateLimit::ClientFactory
+  // The local client never times out.
+  ClientPtr create(const Optional<std::chrono::milliseconds>& timeout) override;
+
+private:
+  const LocalRateLimitConfig config_;
+  ThreadLocal::SlotPtr tls_;
+};
+
+typedef std::shared_ptr<LocalFactoryImpl> LocalFactoryImplSharedPtr;
+
+} // namespace RateLimit
+} // namespace Envoy
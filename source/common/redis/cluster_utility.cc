@@ -0,0 +1,166 @@
+#include "common/redis/cluster_utility.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/common/utility.h"
+
+#include "fmt/format.h"
+
+namespace Envoy {
+namespace Redis {
+
+const uint16_t ClusterUtility::NUM_SLOTS;
+
+namespace {
+
+// CRC16 XMODEM, which is the variant the cluster specification uses.
+const std::array<uint16_t, 256>& crc16Table() {
+  static const std::array<uint16_t, 256> table = []() -> std::array<uint16_t, 256> {
+    std::array<uint16_t, 256> table;
+    for (uint32_t i = 0; i < table.size(); i++) {
+      uint16_t crc = i << 8;
+      for (uint32_t bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+      table[i] = crc;
+    }
+    return table;
+  }();
+  return table;
+}
+
+} // namespace
+
+uint16_t ClusterUtility::hashSlot(const std::string& key) {
+  // Keys with a non empty hash tag, e.g. "{user1000}.following", only hash the tag.
+  size_t start = 0;
+  size_t length = key.size();
+  const size_t open = key.find('{');
+  if (open != std::string::npos) {
+    const size_t close = key.find('}', open + 1);
+    if (close != std::string::npos && close != open + 1) {
+      start = open + 1;
+      length = close - start;
+    }
+  }
+
+  const std::array<uint16_t, 256>& table = crc16Table();
+  uint16_t crc = 0;
+  for (size_t i = start; i < start + length; i++) {
+    crc = (crc << 8) ^ table[((crc >> 8) ^ static_cast<uint8_t>(key[i])) & 0xff];
+  }
+
+  return crc % NUM_SLOTS;
+}
+
+std::vector<ClusterUtility::SlotRange> ClusterUtility::parseClusterSlots(const RespValue& value) {
+  // Each entry looks like: [start, end, [master ip, master port, ...], replicas...]
+  if (value.type() != RespType::Array) {
+    throw ProtocolError("invalid cluster slots response");
+  }
+
+  std::vector<SlotRange> ranges;
+  for (const RespValue& entry : value.asArray()) {
+    if (entry.type() != RespType::Array || entry.asArray().size() < 3) {
+      throw ProtocolError("invalid cluster slots entry");
+    }
+
+    const RespValue& start = entry.asArray()[0];
+    const RespValue& end = entry.asArray()[1];
+    if (start.type() != RespType::Integer || end.type() != RespType::Integer ||
+        start.asInteger() < 0 || start.asInteger() > end.asInteger() ||
+        end.asInteger() >= NUM_SLOTS) {
+      throw ProtocolError("invalid cluster slots range");
+    }
+
+    ranges.push_back({static_cast<uint16_t>(start.asInteger()),
+                      static_cast<uint16_t>(end.asInteger()), parseNode(entry.asArray()[2]),
+                      {}});
+    for (uint64_t i = 3; i < entry.asArray().size(); i++) {
+      ranges.back().replicas_.push_back(parseNode(entry.asArray()[i]));
+    }
+  }
+
+  return ranges;
+}
+
+bool ClusterUtility::parseRedirect(const RespValue& value, Redirect& redirect) {
+  // Redirections look like: "MOVED 3999 127.0.0.1:6381" or "ASK 3999 127.0.0.1:6381"
+  if (value.type() != RespType::Error) {
+    return false;
+  }
+
+  const std::vector<std::string> parts = StringUtil::split(value.asString(), ' ');
+  if (parts.size() != 3 || (parts[0] != "MOVED" && parts[0] != "ASK")) {
+    return false;
+  }
+
+  uint64_t slot;
+  const size_t colon = parts[2].rfind(':');
+  uint64_t port;
+  if (!StringUtil::atoul(parts[1].c_str(), slot) || slot >= NUM_SLOTS ||
+      colon == std::string::npos || !StringUtil::atoul(parts[2].c_str() + colon + 1, port)) {
+    return false;
+  }
+
+  std::string ip = parts[2].substr(0, colon);
+  if (ip.size() > 1 && ip.front() == '[' && ip.back() == ']') {
+    ip = ip.substr(1, ip.size() - 2);
+  }
+
+  redirect.ask_ = parts[0] == "ASK";
+  redirect.slot_ = slot;
+  redirect.address_ = formatAddress(ip, port);
+  return true;
+}
+
+const RespValue& ClusterUtility::clusterSlotsRequest() {
+  static const RespValue* request = makeRequest({"cluster", "slots"});
+  return *request;
+}
+
+const RespValue& ClusterUtility::askingRequest() {
+  static const RespValue* request = makeRequest({"asking"});
+  return *request;
+}
+
+const RespValue& ClusterUtility::readOnlyRequest() {
+  static const RespValue* request = makeRequest({"readonly"});
+  return *request;
+}
+
+std::string ClusterUtility::formatAddress(const std::string& ip, uint64_t port) {
+  return ip.find(':') == std::string::npos ? fmt::format("{}:{}", ip, port)
+                                           : fmt::format("[{}]:{}", ip, port);
+}
+
+std::string ClusterUtility::parseNode(const RespValue& node) {
+  // Nodes look like: [ip, port, ...]
+  if (node.type() != RespType::Array || node.asArray().size() < 2 ||
+      node.asArray()[0].type() != RespType::BulkString ||
+      node.asArray()[1].type() != RespType::Integer) {
+    throw ProtocolError("invalid cluster slots node");
+  }
+
+  return formatAddress(node.asArray()[0].asString(),
+                       static_cast<uint64_t>(node.asArray()[1].asInteger()));
+}
+
+RespValue* ClusterUtility::makeRequest(const std::vector<std::string>& arguments) {
+  std::vector<RespValue> values(arguments.size());
+  for (uint64_t i = 0; i < arguments.size(); i++) {
+    values[i].type(RespType::BulkString);
+    values[i].asString() = arguments[i];
+  }
+
+  RespValue* request = new RespValue();
+  request->type(RespType::Array);
+  request->asArray().swap(values);
+  return request;
+}
+
+} // namespace Redis
+} // namespace Envoy
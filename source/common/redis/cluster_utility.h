@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "envoy/redis/codec.h"
+
+namespace Envoy {
+namespace Redis {
+
+/**
+ * Helpers for Redis Cluster, as defined here: https://redis.io/topics/cluster-spec
+ */
+class ClusterUtility {
+public:
+  static const uint16_t NUM_SLOTS = 16384;
+
+  /**
+   * A range of slots and the addresses of the master and replica nodes serving them.
+   */
+  struct SlotRange {
+    uint16_t start_;
+    uint16_t end_;
+    std::string address_;
+    std::vector<std::string> replicas_;
+  };
+
+  /**
+   * A MOVED or ASK redirection.
+   */
+  struct Redirect {
+    bool ask_;
+    uint16_t slot_;
+    std::string address_;
+  };
+
+  /**
+   * @return uint16_t the slot of a key. Only the hash tag of the key is hashed if it has one.
+   */
+  static uint16_t hashSlot(const std::string& key);
+
+  /**
+   * Parse the response to a CLUSTER SLOTS request.
+   * @param value supplies the response.
+   * @return std::vector<SlotRange> the slot ranges, their masters and replicas. Addresses are
+   *         formatted like Network::Address::Instance::asString(), e.g. "10.0.0.1:6379" or
+   *         "[::1]:6379".
+   * @throw ProtocolError if the response is not a valid CLUSTER SLOTS response.
+   */
+  static std::vector<SlotRange> parseClusterSlots(const RespValue& value);
+
+  /**
+   * Parse a MOVED or ASK redirection error.
+   * @param value supplies the response to parse.
+   * @param redirect supplies the redirection to fill in.
+   * @return bool whether the response is a redirection.
+   */
+  static bool parseRedirect(const RespValue& value, Redirect& redirect);
+
+  /**
+   * @return const RespValue& a CLUSTER SLOTS request.
+   */
+  static const RespValue& clusterSlotsRequest();
+
+  /**
+   * @return const RespValue& an ASKING request, which precedes a request following an ASK
+   *         redirection.
+   */
+  static const RespValue& askingRequest();
+
+  /**
+   * @return const RespValue& a READONLY request, which allows a connection to a replica to serve
+   *         reads.
+   */
+  static const RespValue& readOnlyRequest();
+
+private:
+  static std::string formatAddress(const std::string& ip, uint64_t port);
+  static std::string parseNode(const RespValue& node);
+  static RespValue* makeRequest(const std::vector<std::string>& arguments);
+};
+
+} // namespace Redis
+} // namespace Envoy
@@ -12,6 +12,42 @@
 namespace Envoy {
 namespace Redis {
 
+RespValue::RespValue(const RespValue& other) : type_(RespType::Null) { *this = other; }
+
+RespValue& RespValue::operator=(const RespValue& other) {
+  if (&other == this) {
+    return *this;
+  }
+
+  type(other.type());
+  switch (type_) {
+  case RespType::Array: {
+    array_ = other.array_;
+    break;
+  }
+  case RespType::SimpleString:
+  case RespType::BulkString:
+  case RespType::Error: {
+    string_ = other.string_;
+    break;
+  }
+  case RespType::Integer: {
+    integer_ = other.integer_;
+    break;
+  }
+  case RespType::Null: {
+    break;
+  }
+  }
+
+  if (other.raw_) {
+    raw_.reset(new Buffer::OwnedImpl());
+    raw_->add(*other.raw_);
+  }
+
+  return *this;
+}
+
 std::string RespValue::toString() const {
   switch (type_) {
   case RespType::Array: {
@@ -38,6 +74,7 @@ std::string RespValue::toString() const {
 }
 
 std::vector<RespValue>& RespValue::asArray() {
+  raw_.reset();
   ASSERT(type_ == RespType::Array);
   return array_;
 }
@@ -48,6 +85,7 @@ const std::vector<RespValue>& RespValue::asArray() const {
 }
 
 std::string& RespValue::asString() {
+  raw_.reset();
   ASSERT(type_ == RespType::BulkString || type_ == RespType::Error ||
          type_ == RespType::SimpleString);
   return string_;
@@ -60,6 +98,7 @@ const std::string& RespValue::asString() const {
 }
 
 int64_t& RespValue::asInteger() {
+  raw_.reset();
   ASSERT(type_ == RespType::Integer);
   return integer_;
 }
@@ -91,6 +130,7 @@ void RespValue::cleanup() {
 
 void RespValue::type(RespType type) {
   cleanup();
+  raw_.reset();
 
   // Need to use placement new because of the union.
   type_ = type;
@@ -113,17 +153,24 @@ void RespValue::type(RespType type) {
 }
 
 void DecoderImpl::decode(Buffer::Instance& data) {
-  uint64_t num_slices = data.getRawSlices(nullptr, 0);
-  Buffer::RawSlice slices[num_slices];
-  data.getRawSlices(slices, num_slices);
-  for (const Buffer::RawSlice& slice : slices) {
-    parseSlice(slice);
+  while (data.length() > 0) {
+    Buffer::RawSlice slice;
+    data.getRawSlices(&slice, 1);
+    // The parsed bytes are moved rather than copied, so the encoded form of large values shares
+    // the slabs of the buffer being decoded.
+    pending_raw_.move(data, parseSlice(slice));
+
+    if (state_ == State::ValueRootStart) {
+      Buffer::InstancePtr raw(new Buffer::OwnedImpl());
+      raw->move(pending_raw_);
+      RespValuePtr value = std::move(pending_value_root_);
+      value->raw(std::move(raw));
+      callbacks_.onRespValue(std::move(value));
+    }
   }
-
-  data.drain(data.length());
 }
 
-void DecoderImpl::parseSlice(const Buffer::RawSlice& slice) {
+uint64_t DecoderImpl::parseSlice(const Buffer::RawSlice& slice) {
   const char* buffer = reinterpret_cast<const char*>(slice.mem_);
   uint64_t remaining = slice.len_;
 
@@ -314,8 +361,8 @@ void DecoderImpl::parseSlice(const Buffer::RawSlice& slice) {
       ASSERT(!pending_value_stack_.empty());
       pending_value_stack_.pop_front();
       if (pending_value_stack_.empty()) {
-        callbacks_.onRespValue(std::move(pending_value_root_));
         state_ = State::ValueRootStart;
+        return slice.len_ - remaining;
       } else {
         PendingValue& current_value = pending_value_stack_.front();
         ASSERT(current_value.value_->type() == RespType::Array);
@@ -331,9 +378,16 @@ void DecoderImpl::parseSlice(const Buffer::RawSlice& slice) {
     }
     }
   }
+
+  return slice.len_;
 }
 
 void EncoderImpl::encode(const RespValue& value, Buffer::Instance& out) {
+  if (value.raw()) {
+    out.add(*value.raw());
+    return;
+  }
+
   switch (value.type()) {
   case RespType::Array: {
     encodeArray(value.asArray(), out);
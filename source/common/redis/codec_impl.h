@@ -7,6 +7,7 @@
 
 #include "envoy/redis/codec.h"
 
+#include "common/buffer/buffer_impl.h"
 #include "common/common/logger.h"
 
 namespace Envoy {
@@ -16,6 +17,7 @@ namespace Redis {
  * Decoder implementation of https://redis.io/topics/protocol
  *
  * This implementation buffers when needed and will always consume all bytes passed for decoding.
+ * Each top level value carries the bytes it was decoded from, see RespValue::raw().
  */
 class DecoderImpl : public Decoder, Logger::Loggable<Logger::Id::redis> {
 public:
@@ -53,13 +55,17 @@ private:
     uint64_t current_array_element_;
   };
 
-  void parseSlice(const Buffer::RawSlice& slice);
+  // Parses the slice until it is exhausted or a top level value is complete, in which case the
+  // value is left in pending_value_root_ and state_ is ValueRootStart. @return the bytes parsed.
+  uint64_t parseSlice(const Buffer::RawSlice& slice);
 
   DecoderCallbacks& callbacks_;
   State state_{State::ValueRootStart};
   PendingInteger pending_integer_;
   RespValuePtr pending_value_root_;
   std::forward_list<PendingValue> pending_value_stack_;
+  // The bytes of the value being decoded.
+  Buffer::OwnedImpl pending_raw_;
 };
 
 /**
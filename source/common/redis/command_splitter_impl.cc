@@ -1,8 +1,10 @@
 #include "common/redis/command_splitter_impl.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "common/common/assert.h"
@@ -59,6 +61,41 @@ SplitRequestPtr SimpleRequest::create(ConnPool::Instance& conn_pool,
   return std::move(request_ptr);
 }
 
+SplitRequestPtr SimpleReadRequest::create(ConnPool::Instance& conn_pool,
+                                          const RespValue& incoming_request,
+                                          SplitCallbacks& callbacks) {
+  std::unique_ptr<SimpleReadRequest> request_ptr{new SimpleReadRequest(callbacks)};
+
+  request_ptr->handle_ = conn_pool.makeReadRequest(incoming_request.asArray()[1].asString(),
+                                                   incoming_request, *request_ptr);
+  if (!request_ptr->handle_) {
+    request_ptr->callbacks_.onResponse(Utility::makeError("no upstream host"));
+    return nullptr;
+  }
+
+  return std::move(request_ptr);
+}
+
+SplitRequestPtr CachedGetRequest::create(ConnPool::Instance& conn_pool, HotKeyCache& cache,
+                                         const RespValue& incoming_request,
+                                         SplitCallbacks& callbacks) {
+  const std::string& key = incoming_request.asArray()[1].asString();
+  std::unique_ptr<CachedGetRequest> request_ptr{new CachedGetRequest(callbacks, cache, key)};
+
+  request_ptr->handle_ = conn_pool.makeReadRequest(key, incoming_request, *request_ptr);
+  if (!request_ptr->handle_) {
+    request_ptr->callbacks_.onResponse(Utility::makeError("no upstream host"));
+    return nullptr;
+  }
+
+  return std::move(request_ptr);
+}
+
+void CachedGetRequest::onResponse(RespValuePtr&& response) {
+  cache_.insert(key_, *response);
+  SingleServerRequest::onResponse(std::move(response));
+}
+
 SplitRequestPtr EvalRequest::create(ConnPool::Instance& conn_pool,
                                     const RespValue& incoming_request, SplitCallbacks& callbacks) {
 
@@ -101,34 +138,72 @@ void FragmentedRequest::onChildFailure(uint32_t index) {
   onChildResponse(Utility::makeError("upstream failure"), index);
 }
 
+void FragmentedRequest::groupKeys(ConnPool::Instance& conn_pool, const RespValue& incoming_request,
+                                  uint32_t step) {
+  const uint32_t num_keys = (incoming_request.asArray().size() - 1) / step;
+
+  // Number the upstreams in the order that their first key appears in, so that the upstream
+  // requests are made in the order of the command.
+  std::vector<uint32_t> fragment_of_key(num_keys);
+  std::unordered_map<uint64_t, uint32_t> fragment_of_upstream;
+  for (uint32_t key = 0; key < num_keys; key++) {
+    const std::string& hash_key = incoming_request.asArray()[1 + key * step].asString();
+    auto fragment = fragment_of_upstream.emplace(conn_pool.upstreamId(hash_key),
+                                                 fragment_of_upstream.size());
+    fragment_of_key[key] = fragment.first->second;
+  }
+
+  pending_requests_.reserve(fragment_of_upstream.size());
+  for (uint32_t fragment = 0; fragment < fragment_of_upstream.size(); fragment++) {
+    pending_requests_.emplace_back(*this, fragment);
+  }
+  for (uint32_t fragment : fragment_of_key) {
+    pending_requests_[fragment].num_keys_++;
+  }
+
+  // Lay the keys out by fragment, keeping the order of the command within each fragment.
+  uint32_t first_key = 0;
+  for (PendingRequest& request : pending_requests_) {
+    request.first_key_ = first_key;
+    first_key += request.num_keys_;
+  }
+  fragment_keys_.resize(num_keys);
+  std::vector<uint32_t> next_key(pending_requests_.size());
+  for (uint32_t key = 0; key < num_keys; key++) {
+    const uint32_t fragment = fragment_of_key[key];
+    fragment_keys_[pending_requests_[fragment].first_key_ + next_key[fragment]++] = key;
+  }
+
+  num_pending_responses_ = pending_requests_.size();
+}
+
 SplitRequestPtr MGETRequest::create(ConnPool::Instance& conn_pool,
                                     const RespValue& incoming_request, SplitCallbacks& callbacks) {
   std::unique_ptr<MGETRequest> request_ptr{new MGETRequest(callbacks)};
-
-  request_ptr->num_pending_responses_ = incoming_request.asArray().size() - 1;
-  request_ptr->pending_requests_.reserve(request_ptr->num_pending_responses_);
+  request_ptr->groupKeys(conn_pool, incoming_request, 1);
 
   request_ptr->pending_response_.reset(new RespValue());
   request_ptr->pending_response_->type(RespType::Array);
-  std::vector<RespValue> responses(request_ptr->num_pending_responses_);
+  std::vector<RespValue> responses(incoming_request.asArray().size() - 1);
   request_ptr->pending_response_->asArray().swap(responses);
 
-  std::vector<RespValue> values(2);
-  values[0].type(RespType::BulkString);
-  values[0].asString() = "get";
-  values[1].type(RespType::BulkString);
-  RespValue single_mget;
-  single_mget.type(RespType::Array);
-  single_mget.asArray().swap(values);
-
-  for (uint64_t i = 1; i < incoming_request.asArray().size(); i++) {
-    request_ptr->pending_requests_.emplace_back(*request_ptr, i - 1);
-    PendingRequest& pending_request = request_ptr->pending_requests_.back();
+  // The same request is reused for each upstream, as the connection pool encodes it right away.
+  RespValue fragment_request;
+  fragment_request.type(RespType::Array);
+  std::vector<RespValue>& values = fragment_request.asArray();
+  for (PendingRequest& pending_request : request_ptr->pending_requests_) {
+    values.resize(1 + pending_request.num_keys_);
+    values[0].type(RespType::BulkString);
+    values[0].asString() = pending_request.num_keys_ == 1 ? "get" : "mget";
+    for (uint32_t i = 0; i < pending_request.num_keys_; i++) {
+      const uint32_t key = request_ptr->keyIndex(pending_request, i);
+      values[1 + i].type(RespType::BulkString);
+      values[1 + i].asString() = incoming_request.asArray()[1 + key].asString();
+    }
 
-    single_mget.asArray()[1].asString() = incoming_request.asArray()[i].asString();
-    ENVOY_LOG(debug, "redis: parallel get: '{}'", single_mget.toString());
-    pending_request.handle_ = conn_pool.makeRequest(incoming_request.asArray()[i].asString(),
-                                                    single_mget, pending_request);
+    ENVOY_LOG(debug, "redis: parallel get: '{}'", fragment_request.toString());
+    pending_request.handle_ =
+        conn_pool.makeReadRequest(values[1].asString(), fragment_request, pending_request);
     if (!pending_request.handle_) {
       pending_request.onResponse(Utility::makeError("no upstream host"));
     }
@@ -137,16 +212,15 @@ SplitRequestPtr MGETRequest::create(ConnPool::Instance& conn_pool,
   return request_ptr->num_pending_responses_ > 0 ? std::move(request_ptr) : nullptr;
 }
 
-void MGETRequest::onChildResponse(RespValuePtr&& value, uint32_t index) {
-  pending_requests_[index].handle_ = nullptr;
-
-  pending_response_->asArray()[index].type(value->type());
-  switch (value->type()) {
+void MGETRequest::onKeyResponse(uint32_t key, RespValue& value) {
+  RespValue& response = pending_response_->asArray()[key];
+  response.type(value.type());
+  switch (value.type()) {
   case RespType::Array:
   case RespType::Integer:
   case RespType::SimpleString: {
-    pending_response_->asArray()[index].type(RespType::Error);
-    pending_response_->asArray()[index].asString() = "upstream protocol error";
+    response.type(RespType::Error);
+    response.asString() = "upstream protocol error";
     error_count_++;
     break;
   }
@@ -155,12 +229,36 @@ void MGETRequest::onChildResponse(RespValuePtr&& value, uint32_t index) {
     FALLTHRU;
   }
   case RespType::BulkString: {
-    pending_response_->asArray()[index].asString().swap(value->asString());
+    response.asString().swap(value.asString());
     break;
   }
   case RespType::Null:
     break;
   }
+}
+
+void MGETRequest::onChildResponse(RespValuePtr&& value, uint32_t index) {
+  PendingRequest& pending_request = pending_requests_[index];
+  pending_request.handle_ = nullptr;
+
+  if (pending_request.num_keys_ == 1) {
+    onKeyResponse(keyIndex(pending_request, 0), *value);
+  } else if (value->type() == RespType::Array &&
+             value->asArray().size() == pending_request.num_keys_) {
+    for (uint32_t i = 0; i < pending_request.num_keys_; i++) {
+      onKeyResponse(keyIndex(pending_request, i), value->asArray()[i]);
+    }
+  } else {
+    // The whole MGET failed, so each of its keys gets the error.
+    RespValue error;
+    error.type(RespType::Error);
+    error.asString() =
+        value->type() == RespType::Error ? value->asString() : "upstream protocol error";
+    for (uint32_t i = 0; i < pending_request.num_keys_; i++) {
+      RespValue key_error(error);
+      onKeyResponse(keyIndex(pending_request, i), key_error);
+    }
+  }
 
   ASSERT(num_pending_responses_ > 0);
   if (--num_pending_responses_ == 0) {
@@ -177,33 +275,30 @@ SplitRequestPtr MSETRequest::create(ConnPool::Instance& conn_pool,
   }
 
   std::unique_ptr<MSETRequest> request_ptr{new MSETRequest(callbacks)};
-
-  request_ptr->num_pending_responses_ = (incoming_request.asArray().size() - 1) / 2;
-  request_ptr->pending_requests_.reserve(request_ptr->num_pending_responses_);
+  request_ptr->groupKeys(conn_pool, incoming_request, 2);
 
   request_ptr->pending_response_.reset(new RespValue());
   request_ptr->pending_response_->type(RespType::SimpleString);
 
-  std::vector<RespValue> values(3);
-  values[0].type(RespType::BulkString);
-  values[0].asString() = "set";
-  values[1].type(RespType::BulkString);
-  values[2].type(RespType::BulkString);
-  RespValue single_mset;
-  single_mset.type(RespType::Array);
-  single_mset.asArray().swap(values);
-
-  uint64_t fragment_index = 0;
-  for (uint64_t i = 1; i < incoming_request.asArray().size(); i += 2) {
-    request_ptr->pending_requests_.emplace_back(*request_ptr, fragment_index++);
-    PendingRequest& pending_request = request_ptr->pending_requests_.back();
-
-    single_mset.asArray()[1].asString() = incoming_request.asArray()[i].asString();
-    single_mset.asArray()[2].asString() = incoming_request.asArray()[i + 1].asString();
+  // The same request is reused for each upstream, as the connection pool encodes it right away.
+  RespValue fragment_request;
+  fragment_request.type(RespType::Array);
+  std::vector<RespValue>& values = fragment_request.asArray();
+  for (PendingRequest& pending_request : request_ptr->pending_requests_) {
+    values.resize(1 + pending_request.num_keys_ * 2);
+    values[0].type(RespType::BulkString);
+    values[0].asString() = pending_request.num_keys_ == 1 ? "set" : "mset";
+    for (uint32_t i = 0; i < pending_request.num_keys_; i++) {
+      const uint32_t key = request_ptr->keyIndex(pending_request, i);
+      values[1 + i * 2].type(RespType::BulkString);
+      values[1 + i * 2].asString() = incoming_request.asArray()[1 + key * 2].asString();
+      values[2 + i * 2].type(RespType::BulkString);
+      values[2 + i * 2].asString() = incoming_request.asArray()[2 + key * 2].asString();
+    }
 
-    ENVOY_LOG(debug, "redis: parallel set: '{}'", single_mset.toString());
-    pending_request.handle_ = conn_pool.makeRequest(incoming_request.asArray()[i].asString(),
-                                                    single_mset, pending_request);
+    ENVOY_LOG(debug, "redis: parallel set: '{}'", fragment_request.toString());
+    pending_request.handle_ =
+        conn_pool.makeRequest(values[1].asString(), fragment_request, pending_request);
     if (!pending_request.handle_) {
       pending_request.onResponse(Utility::makeError("no upstream host"));
     }
@@ -213,7 +308,8 @@ SplitRequestPtr MSETRequest::create(ConnPool::Instance& conn_pool,
 }
 
 void MSETRequest::onChildResponse(RespValuePtr&& value, uint32_t index) {
-  pending_requests_[index].handle_ = nullptr;
+  PendingRequest& pending_request = pending_requests_[index];
+  pending_request.handle_ = nullptr;
 
   switch (value->type()) {
   case RespType::SimpleString: {
@@ -223,7 +319,8 @@ void MSETRequest::onChildResponse(RespValuePtr&& value, uint32_t index) {
     FALLTHRU;
   }
   default: {
-    error_count_++;
+    // Each of the keys of a failed MSET counts as an error.
+    error_count_ += pending_request.num_keys_;
     break;
   }
   }
@@ -303,14 +400,23 @@ void SplitKeysSumResultRequest::onChildResponse(RespValuePtr&& value, uint32_t i
 }
 
 InstanceImpl::InstanceImpl(ConnPool::InstancePtr&& conn_pool, Stats::Scope& scope,
-                           const std::string& stat_prefix)
+                           const std::string& stat_prefix, ThreadLocal::SlotAllocator& tls,
+                           const HotKeyCacheConfig& hot_key_cache_config,
+                           MonotonicTimeSource& time_source)
     : conn_pool_(std::move(conn_pool)), simple_command_handler_(*conn_pool_),
-      eval_command_handler_(*conn_pool_), mget_handler_(*conn_pool_), mset_handler_(*conn_pool_),
+      simple_read_command_handler_(*conn_pool_), eval_command_handler_(*conn_pool_),
+      mget_handler_(*conn_pool_), mset_handler_(*conn_pool_),
       split_keys_sum_result_handler_(*conn_pool_),
       stats_{ALL_COMMAND_SPLITTER_STATS(POOL_COUNTER_PREFIX(scope, stat_prefix + "splitter."))} {
   // TODO(mattklein123) PERF: Make this a trie (like in header_map_impl).
+  const std::vector<std::string>& read_only_commands = SupportedCommands::readOnlyCommands();
   for (const std::string& command : SupportedCommands::simpleCommands()) {
-    addHandler(scope, stat_prefix, command, simple_command_handler_);
+    if (std::find(read_only_commands.begin(), read_only_commands.end(), command) !=
+        read_only_commands.end()) {
+      addHandler(scope, stat_prefix, command, simple_read_command_handler_);
+    } else {
+      addHandler(scope, stat_prefix, command, simple_command_handler_);
+    }
   }
 
   for (const std::string& command : SupportedCommands::evalCommands()) {
@@ -323,6 +429,14 @@ InstanceImpl::InstanceImpl(ConnPool::InstancePtr&& conn_pool, Stats::Scope& scop
 
   addHandler(scope, stat_prefix, SupportedCommands::mget(), mget_handler_);
   addHandler(scope, stat_prefix, SupportedCommands::mset(), mset_handler_);
+
+  if (!hot_key_cache_config.keys_.empty()) {
+    hot_key_cache_ = tls.allocateSlot();
+    hot_key_cache_->set([hot_key_cache_config, &time_source](
+                            Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+      return std::make_shared<HotKeyCache>(hot_key_cache_config, time_source);
+    });
+  }
 }
 
 SplitRequestPtr InstanceImpl::makeRequest(const RespValue& request, SplitCallbacks& callbacks) {
@@ -351,9 +465,36 @@ SplitRequestPtr InstanceImpl::makeRequest(const RespValue& request, SplitCallbac
 
   ENVOY_LOG(debug, "redis: splitting '{}'", request.toString());
   handler->second.total_.inc();
+  if (hot_key_cache_) {
+    HotKeyCache& cache = hot_key_cache_->getTyped<HotKeyCache>();
+    if (to_lower_string == SupportedCommands::get()) {
+      if (request.asArray().size() == 2 && cache.isHot(request.asArray()[1].asString())) {
+        return makeHotKeyRequest(cache, request, callbacks);
+      }
+    } else {
+      // Any other command may write the hot keys it names.
+      for (uint64_t i = 1; i < request.asArray().size(); i++) {
+        cache.invalidate(request.asArray()[i].asString());
+      }
+    }
+  }
+
   return handler->second.handler_.get().startRequest(request, callbacks);
 }
 
+SplitRequestPtr InstanceImpl::makeHotKeyRequest(HotKeyCache& cache, const RespValue& request,
+                                                SplitCallbacks& callbacks) {
+  const RespValue* value = cache.lookup(request.asArray()[1].asString());
+  if (value) {
+    stats_.hot_key_cache_hit_.inc();
+    callbacks.onResponse(RespValuePtr{new RespValue(*value)});
+    return nullptr;
+  }
+
+  stats_.hot_key_cache_miss_.inc();
+  return CachedGetRequest::create(*conn_pool_, cache, request, callbacks);
+}
+
 void InstanceImpl::onInvalidRequest(SplitCallbacks& callbacks) {
   stats_.invalid_request_.inc();
   callbacks.onResponse(Utility::makeError("invalid request"));
@@ -5,11 +5,15 @@
 #include <unordered_map>
 #include <vector>
 
+#include "envoy/common/time.h"
 #include "envoy/redis/command_splitter.h"
 #include "envoy/redis/conn_pool.h"
+#include "envoy/thread_local/thread_local.h"
 
 #include "common/common/logger.h"
 #include "common/common/to_lower_table.h"
+#include "common/common/utility.h"
+#include "common/redis/hot_key_cache.h"
 
 namespace Envoy {
 namespace Redis {
@@ -72,6 +76,37 @@ private:
   SimpleRequest(SplitCallbacks& callbacks) : SingleServerRequest(callbacks) {}
 };
 
+/**
+ * SimpleReadRequest is a SimpleRequest for a read-only command, which may be sent to a replica.
+ */
+class SimpleReadRequest : public SingleServerRequest {
+public:
+  static SplitRequestPtr create(ConnPool::Instance& conn_pool, const RespValue& incoming_request,
+                                SplitCallbacks& callbacks);
+
+private:
+  SimpleReadRequest(SplitCallbacks& callbacks) : SingleServerRequest(callbacks) {}
+};
+
+/**
+ * CachedGetRequest is a GET of a hot key that is not cached yet. Its response is cached.
+ */
+class CachedGetRequest : public SingleServerRequest {
+public:
+  static SplitRequestPtr create(ConnPool::Instance& conn_pool, HotKeyCache& cache,
+                                const RespValue& incoming_request, SplitCallbacks& callbacks);
+
+  // Redis::ConnPool::PoolCallbacks
+  void onResponse(RespValuePtr&& response) override;
+
+private:
+  CachedGetRequest(SplitCallbacks& callbacks, HotKeyCache& cache, const std::string& key)
+      : SingleServerRequest(callbacks), cache_(cache), key_(key) {}
+
+  HotKeyCache& cache_;
+  const std::string key_;
+};
+
 /**
  * EvalRequest hashes the fourth argument as the key.
  */
@@ -111,21 +146,44 @@ protected:
     FragmentedRequest& parent_;
     const uint32_t index_;
     ConnPool::PoolRequest* handle_{};
+    // The keys of the request when keys are grouped, see groupKeys().
+    uint32_t first_key_{};
+    uint32_t num_keys_{};
   };
 
   virtual void onChildResponse(RespValuePtr&& value, uint32_t index) PURE;
   void onChildFailure(uint32_t index);
 
+  /**
+   * Create a pending request per upstream of the keys of a command, without allocating anything
+   * per key besides the order of the keys.
+   * @param conn_pool supplies the connection pool that finds the upstreams of the keys.
+   * @param incoming_request supplies the command. Its keys are its arguments at 1 + i * step.
+   * @param step supplies how many arguments there are for each key.
+   */
+  void groupKeys(ConnPool::Instance& conn_pool, const RespValue& incoming_request, uint32_t step);
+
+  /**
+   * @return uint32_t the index of a key of a pending request made by groupKeys(), among all the
+   *         keys of the command.
+   */
+  uint32_t keyIndex(const PendingRequest& request, uint32_t i) const {
+    return fragment_keys_[request.first_key_ + i];
+  }
+
   SplitCallbacks& callbacks_;
   RespValuePtr pending_response_;
   std::vector<PendingRequest> pending_requests_;
+  // The indexes of the keys, ordered by the pending request that they are sent in.
+  std::vector<uint32_t> fragment_keys_;
   uint32_t num_pending_responses_;
   uint32_t error_count_{0};
 };
 
 /**
- * MGETRequest takes each key from the command and sends a GET for each to the appropriate Redis
- * server. The response contains the result from each command.
+ * MGETRequest groups the keys of the command by Redis server, and sends an MGET of the keys of each
+ * server (or a GET if there is only one) to it, as a read. The response contains the result for
+ * each key.
  */
 class MGETRequest : public FragmentedRequest, Logger::Loggable<Logger::Id::redis> {
 public:
@@ -135,6 +193,8 @@ public:
 private:
   MGETRequest(SplitCallbacks& callbacks) : FragmentedRequest(callbacks) {}
 
+  void onKeyResponse(uint32_t key, RespValue& value);
+
   // Redis::CommandSplitter::FragmentedRequest
   void onChildResponse(RespValuePtr&& value, uint32_t index) override;
 };
@@ -160,9 +220,9 @@ private:
 };
 
 /**
- * MSETRequest takes each key and value pair from the command and sends a SET for each to the
- * appropriate Redis server. The response is an OK if all commands succeeded or an ERR if any
- * failed.
+ * MSETRequest groups the key and value pairs of the command by Redis server, and sends an MSET of
+ * the pairs of each server (or a SET if there is only one) to it. The response is an OK if all
+ * commands succeeded or an ERR if any failed.
  */
 class MSETRequest : public FragmentedRequest, Logger::Loggable<Logger::Id::redis> {
 public:
@@ -195,7 +255,9 @@ public:
 // clang-format off
 #define ALL_COMMAND_SPLITTER_STATS(COUNTER)                                                        \
   COUNTER(invalid_request)                                                                         \
-  COUNTER(unsupported_command)
+  COUNTER(unsupported_command)                                                                     \
+  COUNTER(hot_key_cache_hit)                                                                       \
+  COUNTER(hot_key_cache_miss)
 // clang-format on
 
 /**
@@ -207,8 +269,20 @@ struct InstanceStats {
 
 class InstanceImpl : public Instance, Logger::Loggable<Logger::Id::redis> {
 public:
+  /**
+   * @param conn_pool supplies the connection pool to send the requests to.
+   * @param scope supplies the scope of the stats.
+   * @param stat_prefix supplies the prefix of the stats.
+   * @param tls supplies the slot allocator of the per worker hot key caches.
+   * @param hot_key_cache_config supplies the configuration of the hot key caches. GET requests
+   *        for the configured keys are served from the cache of the worker, and the other commands
+   *        that name them drop their cached values. No keys disables the caches.
+   * @param time_source supplies the time source for the expiry of cached values.
+   */
   InstanceImpl(ConnPool::InstancePtr&& conn_pool, Stats::Scope& scope,
-               const std::string& stat_prefix);
+               const std::string& stat_prefix, ThreadLocal::SlotAllocator& tls,
+               const HotKeyCacheConfig& hot_key_cache_config,
+               MonotonicTimeSource& time_source = ProdMonotonicTimeSource::instance_);
 
   // Redis::CommandSplitter::Instance
   SplitRequestPtr makeRequest(const RespValue& request, SplitCallbacks& callbacks) override;
@@ -222,9 +296,12 @@ private:
   void addHandler(Stats::Scope& scope, const std::string& stat_prefix, const std::string& name,
                   CommandHandler& handler);
   void onInvalidRequest(SplitCallbacks& callbacks);
+  SplitRequestPtr makeHotKeyRequest(HotKeyCache& cache, const RespValue& request,
+                                    SplitCallbacks& callbacks);
 
   ConnPool::InstancePtr conn_pool_;
   CommandHandlerFactory<SimpleRequest> simple_command_handler_;
+  CommandHandlerFactory<SimpleReadRequest> simple_read_command_handler_;
   CommandHandlerFactory<EvalRequest> eval_command_handler_;
   CommandHandlerFactory<MGETRequest> mget_handler_;
   CommandHandlerFactory<MSETRequest> mset_handler_;
@@ -232,6 +309,8 @@ private:
   std::unordered_map<std::string, HandlerData> command_map_;
   InstanceStats stats_;
   const ToLowerTable to_lower_table_;
+  // Only allocated when there are hot keys.
+  ThreadLocal::SlotPtr hot_key_cache_;
 };
 
 } // namespace CommandSplitter
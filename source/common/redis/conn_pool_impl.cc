@@ -1,5 +1,6 @@
 #include "common/redis/conn_pool_impl.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -9,6 +10,7 @@
 #include "common/common/enum_to_int.h"
 #include "common/http/codes.h"
 #include "common/json/config_schemas.h"
+#include "common/redis/cluster_utility.h"
 
 namespace Envoy {
 namespace Redis {
@@ -16,7 +18,25 @@ namespace ConnPool {
 
 ConfigImpl::ConfigImpl(const Json::Object& config)
     : Validator(config, Json::Schema::REDIS_CONN_POOL_SCHEMA),
-      op_timeout_(config.getInteger("op_timeout_ms")) {}
+      op_timeout_(config.getInteger("op_timeout_ms")),
+      max_buffer_size_before_flush_(config.getInteger("max_buffer_size_before_flush", 0)),
+      max_connections_per_host_(config.getInteger("max_connections_per_host", 1)),
+      max_requests_per_connection_(config.getInteger("max_requests_per_connection", 0)),
+      cluster_mode_(config.getBoolean("cluster_mode", false)),
+      cluster_refresh_interval_(config.getInteger("cluster_refresh_interval_ms", 5000)),
+      read_policy_(parseReadPolicy(config.getString("read_policy", "master"))) {}
+
+ReadPolicy ConfigImpl::parseReadPolicy(const std::string& policy) {
+  // The schema only allows the known policies.
+  if (policy == "master") {
+    return ReadPolicy::Master;
+  } else if (policy == "prefer_replica") {
+    return ReadPolicy::PreferReplica;
+  } else if (policy == "any") {
+    return ReadPolicy::Any;
+  }
+  NOT_REACHED;
+}
 
 ClientPtr ClientImpl::create(Upstream::HostConstSharedPtr host, Event::Dispatcher& dispatcher,
                              EncoderPtr&& encoder, DecoderFactory& decoder_factory,
@@ -42,6 +62,9 @@ ClientImpl::ClientImpl(Upstream::HostConstSharedPtr host, Event::Dispatcher& dis
   host->stats().cx_total_.inc();
   host->stats().cx_active_.inc();
   connect_or_op_timer_->enableTimer(host->cluster().connectTimeout());
+  if (config_.maxBufferSizeBeforeFlush() > 0) {
+    flush_timer_ = dispatcher.createTimer([this]() -> void { flushBuffer(); });
+  }
 }
 
 ClientImpl::~ClientImpl() {
@@ -55,9 +78,17 @@ void ClientImpl::close() { connection_->close(Network::ConnectionCloseType::NoFl
 
 PoolRequest* ClientImpl::makeRequest(const RespValue& request, PoolCallbacks& callbacks) {
   ASSERT(connection_->state() == Network::Connection::State::Open);
+  const bool empty_buffer = encoder_buffer_.length() == 0;
   pending_requests_.emplace_back(*this, callbacks);
   encoder_->encode(request, encoder_buffer_);
-  connection_->write(encoder_buffer_);
+
+  // Requests made during the same event loop iteration are coalesced into a single write, unless
+  // the buffer grows large enough to be worth writing right away.
+  if (!flush_timer_ || encoder_buffer_.length() >= config_.maxBufferSizeBeforeFlush()) {
+    flushBuffer();
+  } else if (empty_buffer) {
+    flush_timer_->enableTimer(std::chrono::milliseconds(0));
+  }
 
   // Only boost the op timeout if we are not already connected. Otherwise, we are governed by
   // the connect timeout and the timer will be reset when/if connection occurs. This allows a
@@ -69,6 +100,13 @@ PoolRequest* ClientImpl::makeRequest(const RespValue& request, PoolCallbacks& ca
   return &pending_requests_.back();
 }
 
+void ClientImpl::flushBuffer() {
+  if (flush_timer_) {
+    flush_timer_->disableTimer();
+  }
+  connection_->write(encoder_buffer_);
+}
+
 void ClientImpl::onConnectOrOpTimeout() {
   host_->outlierDetector().putHttpResponseCode(enumToInt(Http::Code::GatewayTimeout));
   if (connected_) {
@@ -115,6 +153,9 @@ void ClientImpl::onEvent(Network::ConnectionEvent event) {
     }
 
     connect_or_op_timer_->disableTimer();
+    if (flush_timer_) {
+      flush_timer_->disableTimer();
+    }
   } else if (event == Network::ConnectionEvent::Connected) {
     connected_ = true;
     ASSERT(!pending_requests_.empty());
@@ -186,7 +227,16 @@ InstanceImpl::InstanceImpl(const std::string& cluster_name, Upstream::ClusterMan
 
 PoolRequest* InstanceImpl::makeRequest(const std::string& hash_key, const RespValue& value,
                                        PoolCallbacks& callbacks) {
-  return tls_->getTyped<ThreadLocalPool>().makeRequest(hash_key, value, callbacks);
+  return tls_->getTyped<ThreadLocalPool>().makeRequest(hash_key, value, callbacks, false);
+}
+
+PoolRequest* InstanceImpl::makeReadRequest(const std::string& hash_key, const RespValue& value,
+                                           PoolCallbacks& callbacks) {
+  return tls_->getTyped<ThreadLocalPool>().makeRequest(hash_key, value, callbacks, true);
+}
+
+uint64_t InstanceImpl::upstreamId(const std::string& hash_key) {
+  return tls_->getTyped<ThreadLocalPool>().upstreamId(hash_key);
 }
 
 InstanceImpl::ThreadLocalPool::ThreadLocalPool(InstanceImpl& parent, Event::Dispatcher& dispatcher,
@@ -200,59 +250,302 @@ InstanceImpl::ThreadLocalPool::ThreadLocalPool(InstanceImpl& parent, Event::Disp
   local_host_set_member_update_cb_handle_ = cluster_->hostSet().addMemberUpdateCb(
       [this](const std::vector<Upstream::HostSharedPtr>&,
              const std::vector<Upstream::HostSharedPtr>& hosts_removed) -> void {
+        if (parent_.config_.clusterMode()) {
+          updateHostsByAddress();
+        }
         onHostsRemoved(hosts_removed);
       });
+
+  if (parent_.config_.clusterMode()) {
+    updateHostsByAddress();
+    refresh_timer_ = dispatcher.createTimer([this]() -> void { refreshSlots(); });
+    refresh_timer_->enableTimer(std::chrono::milliseconds(0));
+  }
 }
 
 InstanceImpl::ThreadLocalPool::~ThreadLocalPool() {
   local_host_set_member_update_cb_handle_->remove();
   while (!client_map_.empty()) {
-    client_map_.begin()->second->redis_client_->close();
+    client_map_.begin()->second.front()->redis_client_->close();
   }
 }
 
 void InstanceImpl::ThreadLocalPool::onHostsRemoved(
     const std::vector<Upstream::HostSharedPtr>& hosts_removed) {
   for (const auto& host : hosts_removed) {
+    // We don't currently support any type of draining for redis connections. If a host is gone,
+    // we just close its connections. This will fail any pending requests. Closing a connection
+    // removes it from the map.
     auto it = client_map_.find(host);
-    if (it != client_map_.end()) {
-      // We don't currently support any type of draining for redis connections. If a host is gone,
-      // we just close the connection. This will fail any pending requests.
-      it->second->redis_client_->close();
+    while (it != client_map_.end()) {
+      it->second.front()->redis_client_->close();
+      it = client_map_.find(host);
+    }
+  }
+
+  if (slots_.empty() || hosts_removed.empty()) {
+    return;
+  }
+
+  // The slots of the removed masters are load balanced until their new masters are discovered.
+  // Removed replicas just stop serving reads.
+  auto removed = [&hosts_removed](const Upstream::HostConstSharedPtr& host) -> bool {
+    return std::find(hosts_removed.begin(), hosts_removed.end(), host) != hosts_removed.end();
+  };
+  for (ShardSharedPtr& shard : slots_) {
+    if (!shard) {
+      continue;
+    }
+    if (removed(shard->master_)) {
+      shard = nullptr;
+      continue;
     }
+    shard->replicas_.erase(
+        std::remove_if(shard->replicas_.begin(), shard->replicas_.end(), removed),
+        shard->replicas_.end());
+  }
+  if (!slots_request_) {
+    refresh_timer_->enableTimer(std::chrono::milliseconds(0));
   }
 }
 
 PoolRequest* InstanceImpl::ThreadLocalPool::makeRequest(const std::string& hash_key,
                                                         const RespValue& request,
-                                                        PoolCallbacks& callbacks) {
+                                                        PoolCallbacks& callbacks,
+                                                        bool read_only) {
+  // The slot map is only populated in cluster mode.
+  Upstream::HostConstSharedPtr host;
+  if (!slots_.empty()) {
+    Shard* shard = slots_[ClusterUtility::hashSlot(hash_key)].get();
+    if (shard) {
+      host = chooseShardHost(*shard, read_only);
+    }
+  }
+
+  if (!host) {
+    LbContextImpl lb_context(hash_key);
+    host = cluster_->loadBalancer().chooseHost(&lb_context);
+    if (!host) {
+      return nullptr;
+    }
+  }
+
+  if (parent_.config_.clusterMode()) {
+    return makeClusterRequest(host, request, callbacks);
+  }
+  return chooseClient(host).redis_client_->makeRequest(request, callbacks);
+}
+
+uint64_t InstanceImpl::ThreadLocalPool::upstreamId(const std::string& hash_key) {
+  if (parent_.config_.clusterMode()) {
+    return ClusterUtility::hashSlot(hash_key);
+  }
+
+  // The load balancer hashes the key the same way for the combined request.
   LbContextImpl lb_context(hash_key);
   Upstream::HostConstSharedPtr host = cluster_->loadBalancer().chooseHost(&lb_context);
-  if (!host) {
+  return reinterpret_cast<uintptr_t>(host.get());
+}
+
+PoolRequest* InstanceImpl::ThreadLocalPool::makeClusterRequest(Upstream::HostConstSharedPtr host,
+                                                               const RespValue& request,
+                                                               PoolCallbacks& callbacks) {
+  ClusterRequestPtr cluster_request(new ClusterRequest(*this, request, callbacks));
+  ClusterRequest& active_request = *cluster_request;
+  active_request.handle_ =
+      chooseClient(host).redis_client_->makeRequest(active_request.request_, active_request);
+  if (!active_request.handle_) {
     return nullptr;
   }
 
-  ThreadLocalActiveClientPtr& client = client_map_[host];
-  if (!client) {
-    client.reset(new ThreadLocalActiveClient(*this));
-    client->host_ = host;
-    client->redis_client_ = parent_.client_factory_.create(host, dispatcher_, parent_.config_);
-    client->redis_client_->addConnectionCallbacks(*client);
+  active_request.moveIntoList(std::move(cluster_request), cluster_requests_);
+  return &active_request;
+}
+
+Upstream::HostConstSharedPtr InstanceImpl::ThreadLocalPool::chooseShardHost(Shard& shard,
+                                                                          bool read_only) {
+  const ReadPolicy policy = parent_.config_.readPolicy();
+  if (!read_only || policy == ReadPolicy::Master || shard.replicas_.empty()) {
+    return shard.master_;
+  }
+
+  // The reads of a shard take turns over its replicas, and over its master too with
+  // ReadPolicy::Any.
+  const uint64_t num_hosts = shard.replicas_.size() + (policy == ReadPolicy::Any ? 1 : 0);
+  const uint64_t index = shard.next_read_host_++ % num_hosts;
+  return index < shard.replicas_.size() ? shard.replicas_[index] : shard.master_;
+}
+
+Upstream::HostConstSharedPtr
+InstanceImpl::ThreadLocalPool::hostByAddress(const std::string& address) const {
+  auto host = hosts_by_address_.find(address);
+  return host != hosts_by_address_.end() ? host->second : nullptr;
+}
+
+void InstanceImpl::ThreadLocalPool::onMoved(uint16_t slot, Upstream::HostConstSharedPtr host) {
+  // The replicas of the new master are not known until the next discovery.
+  if (!slots_.empty()) {
+    slots_[slot] = host ? std::make_shared<Shard>(host) : nullptr;
+  }
+
+  // A slot moved, so others likely did too.
+  if (!slots_request_) {
+    refresh_timer_->enableTimer(std::chrono::milliseconds(0));
+  }
+}
+
+void InstanceImpl::ThreadLocalPool::refreshSlots() {
+  if (slots_request_) {
+    return;
+  }
+
+  const std::vector<Upstream::HostSharedPtr>& hosts = cluster_->hostSet().hosts();
+  if (hosts.empty()) {
+    refresh_timer_->enableTimer(parent_.config_.clusterRefreshInterval());
+    return;
+  }
+
+  // Ask the hosts in turn, so that a host that is down does not stop the discovery.
+  Upstream::HostConstSharedPtr host = hosts[slots_host_index_++ % hosts.size()];
+  slots_request_ = chooseClient(host).redis_client_->makeRequest(
+      ClusterUtility::clusterSlotsRequest(), slots_callbacks_);
+}
+
+void InstanceImpl::ThreadLocalPool::onSlots(const RespValue& value) {
+  try {
+    std::vector<ShardSharedPtr> slots(ClusterUtility::NUM_SLOTS);
+    for (const ClusterUtility::SlotRange& range : ClusterUtility::parseClusterSlots(value)) {
+      Upstream::HostConstSharedPtr master = hostByAddress(range.address_);
+      if (!master) {
+        continue;
+      }
+
+      ShardSharedPtr shard = std::make_shared<Shard>(master);
+      for (const std::string& address : range.replicas_) {
+        Upstream::HostConstSharedPtr replica = hostByAddress(address);
+        if (replica) {
+          shard->replicas_.push_back(replica);
+        }
+      }
+      for (uint32_t slot = range.start_; slot <= range.end_; slot++) {
+        slots[slot] = shard;
+      }
+    }
+    slots_.swap(slots);
+  } catch (ProtocolError&) {
+    // Keep the current slot map until the next discovery.
   }
 
-  return client->redis_client_->makeRequest(request, callbacks);
+  refresh_timer_->enableTimer(parent_.config_.clusterRefreshInterval());
+}
+
+void InstanceImpl::ThreadLocalPool::updateHostsByAddress() {
+  hosts_by_address_.clear();
+  for (const Upstream::HostSharedPtr& host : cluster_->hostSet().hosts()) {
+    hosts_by_address_[host->address()->asString()] = host;
+  }
+}
+
+InstanceImpl::ThreadLocalActiveClient&
+InstanceImpl::ThreadLocalPool::chooseClient(Upstream::HostConstSharedPtr host) {
+  ThreadLocalActiveClientList& clients = client_map_[host];
+  ThreadLocalActiveClient* least_loaded = nullptr;
+  for (const ThreadLocalActiveClientPtr& client : clients) {
+    if (!least_loaded || client->redis_client_->numPendingRequests() <
+                             least_loaded->redis_client_->numPendingRequests()) {
+      least_loaded = client.get();
+    }
+  }
+
+  const uint32_t max_requests = parent_.config_.maxRequestsPerConnection();
+  if (least_loaded &&
+      (clients.size() >= parent_.config_.maxConnectionsPerHost() || max_requests == 0 ||
+       least_loaded->redis_client_->numPendingRequests() < max_requests)) {
+    return *least_loaded;
+  }
+
+  ThreadLocalActiveClientPtr client(new ThreadLocalActiveClient(*this));
+  client->host_ = host;
+  client->redis_client_ = parent_.client_factory_.create(host, dispatcher_, parent_.config_);
+  client->redis_client_->addConnectionCallbacks(*client);
+  if (parent_.config_.clusterMode() && parent_.config_.readPolicy() != ReadPolicy::Master) {
+    // Replicas only serve reads on the connections that sent READONLY, which masters ignore.
+    client->redis_client_->makeRequest(ClusterUtility::readOnlyRequest(), noop_callbacks_);
+  }
+  clients.emplace_back(std::move(client));
+  return *clients.back();
 }
 
 void InstanceImpl::ThreadLocalActiveClient::onEvent(Network::ConnectionEvent event) {
   if (event == Network::ConnectionEvent::RemoteClose ||
       event == Network::ConnectionEvent::LocalClose) {
-    auto client_to_delete = parent_.client_map_.find(host_);
-    ASSERT(client_to_delete != parent_.client_map_.end());
-    parent_.dispatcher_.deferredDelete(std::move(client_to_delete->second->redis_client_));
-    parent_.client_map_.erase(client_to_delete);
+    // Erasing the client destroys this object, so nothing past that may use its members.
+    ThreadLocalPool& parent = parent_;
+    auto host_clients = parent.client_map_.find(host_);
+    ASSERT(host_clients != parent.client_map_.end());
+    auto client_to_delete =
+        std::find_if(host_clients->second.begin(), host_clients->second.end(),
+                     [this](const ThreadLocalActiveClientPtr& client) -> bool {
+                       return client.get() == this;
+                     });
+    ASSERT(client_to_delete != host_clients->second.end());
+    parent.dispatcher_.deferredDelete(std::move((*client_to_delete)->redis_client_));
+    host_clients->second.erase(client_to_delete);
+    if (host_clients->second.empty()) {
+      parent.client_map_.erase(host_clients);
+    }
   }
 }
 
+const uint32_t InstanceImpl::ClusterRequest::MAX_REDIRECTS;
+
+void InstanceImpl::ClusterRequest::cancel() {
+  handle_->cancel();
+  removeFromList(parent_.cluster_requests_);
+}
+
+void InstanceImpl::ClusterRequest::onResponse(RespValuePtr&& value) {
+  handle_ = nullptr;
+  ClusterUtility::Redirect redirect;
+  if (redirects_ < MAX_REDIRECTS && ClusterUtility::parseRedirect(*value, redirect)) {
+    Upstream::HostConstSharedPtr host = parent_.hostByAddress(redirect.address_);
+    if (!redirect.ask_) {
+      parent_.onMoved(redirect.slot_, host);
+    }
+
+    // Redirections to nodes that are not hosts of the cluster are returned to the caller.
+    if (host) {
+      redirects_++;
+      Client& client = *parent_.chooseClient(host).redis_client_;
+      if (redirect.ask_) {
+        // The request must follow ASKING on the same connection.
+        client.makeRequest(ClusterUtility::askingRequest(), parent_.noop_callbacks_);
+      }
+      handle_ = client.makeRequest(request_, *this);
+      return;
+    }
+  }
+
+  ClusterRequestPtr request = removeFromList(parent_.cluster_requests_);
+  callbacks_.onResponse(std::move(value));
+}
+
+void InstanceImpl::ClusterRequest::onFailure() {
+  handle_ = nullptr;
+  ClusterRequestPtr request = removeFromList(parent_.cluster_requests_);
+  callbacks_.onFailure();
+}
+
+void InstanceImpl::SlotsCallbacks::onResponse(RespValuePtr&& value) {
+  parent_.slots_request_ = nullptr;
+  parent_.onSlots(*value);
+}
+
+void InstanceImpl::SlotsCallbacks::onFailure() {
+  parent_.slots_request_ = nullptr;
+  parent_.refresh_timer_->enableTimer(parent_.parent_.config_.clusterRefreshInterval());
+}
+
 } // namespace ConnPool
 } // namespace Redis
 } // namespace Envoy
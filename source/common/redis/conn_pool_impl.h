@@ -13,6 +13,7 @@
 #include "envoy/upstream/cluster_manager.h"
 
 #include "common/buffer/buffer_impl.h"
+#include "common/common/linked_object.h"
 #include "common/json/json_validator.h"
 #include "common/network/filter_impl.h"
 #include "common/redis/codec_impl.h"
@@ -28,9 +29,25 @@ public:
   ConfigImpl(const Json::Object& config);
 
   std::chrono::milliseconds opTimeout() const override { return op_timeout_; }
+  uint32_t maxBufferSizeBeforeFlush() const override { return max_buffer_size_before_flush_; }
+  uint32_t maxConnectionsPerHost() const override { return max_connections_per_host_; }
+  uint32_t maxRequestsPerConnection() const override { return max_requests_per_connection_; }
+  bool clusterMode() const override { return cluster_mode_; }
+  std::chrono::milliseconds clusterRefreshInterval() const override {
+    return cluster_refresh_interval_;
+  }
+  ReadPolicy readPolicy() const override { return read_policy_; }
 
 private:
+  static ReadPolicy parseReadPolicy(const std::string& policy);
+
   const std::chrono::milliseconds op_timeout_;
+  const uint32_t max_buffer_size_before_flush_;
+  const uint32_t max_connections_per_host_;
+  const uint32_t max_requests_per_connection_;
+  const bool cluster_mode_;
+  const std::chrono::milliseconds cluster_refresh_interval_;
+  const ReadPolicy read_policy_;
 };
 
 class ClientImpl : public Client, public DecoderCallbacks, public Network::ConnectionCallbacks {
@@ -47,6 +64,7 @@ public:
   }
   void close() override;
   PoolRequest* makeRequest(const RespValue& request, PoolCallbacks& callbacks) override;
+  uint64_t numPendingRequests() const override { return pending_requests_.size(); }
 
 private:
   struct UpstreamReadFilter : public Network::ReadFilterBaseImpl {
@@ -75,6 +93,7 @@ private:
 
   ClientImpl(Upstream::HostConstSharedPtr host, Event::Dispatcher& dispatcher, EncoderPtr&& encoder,
              DecoderFactory& decoder_factory, const Config& config);
+  void flushBuffer();
   void onConnectOrOpTimeout();
   void onData(Buffer::Instance& data);
 
@@ -94,6 +113,8 @@ private:
   const Config& config_;
   std::list<PendingRequest> pending_requests_;
   Event::TimerPtr connect_or_op_timer_;
+  // Only created when requests are coalesced, see Config::maxBufferSizeBeforeFlush().
+  Event::TimerPtr flush_timer_;
   bool connected_{};
 };
 
@@ -118,6 +139,9 @@ public:
   // Redis::ConnPool::Instance
   PoolRequest* makeRequest(const std::string& hash_key, const RespValue& request,
                            PoolCallbacks& callbacks) override;
+  PoolRequest* makeReadRequest(const std::string& hash_key, const RespValue& request,
+                               PoolCallbacks& callbacks) override;
+  uint64_t upstreamId(const std::string& hash_key) override;
 
 private:
   struct ThreadLocalPool;
@@ -136,20 +160,102 @@ private:
   };
 
   typedef std::unique_ptr<ThreadLocalActiveClient> ThreadLocalActiveClientPtr;
+  typedef std::list<ThreadLocalActiveClientPtr> ThreadLocalActiveClientList;
+
+  /**
+   * A request made in cluster mode. It keeps a copy of the request to follow redirections.
+   */
+  struct ClusterRequest : public PoolRequest,
+                          public PoolCallbacks,
+                          public LinkedObject<ClusterRequest> {
+    ClusterRequest(ThreadLocalPool& parent, const RespValue& request, PoolCallbacks& callbacks)
+        : parent_(parent), request_(request), callbacks_(callbacks) {}
+
+    // Enough to follow a slot that is being migrated, without bouncing between misconfigured
+    // nodes forever.
+    static const uint32_t MAX_REDIRECTS = 5;
+
+    // Redis::ConnPool::PoolRequest
+    void cancel() override;
+
+    // Redis::ConnPool::PoolCallbacks
+    void onResponse(RespValuePtr&& value) override;
+    void onFailure() override;
+
+    ThreadLocalPool& parent_;
+    const RespValue request_;
+    PoolCallbacks& callbacks_;
+    PoolRequest* handle_{};
+    uint32_t redirects_{};
+  };
+
+  typedef std::unique_ptr<ClusterRequest> ClusterRequestPtr;
+
+  struct SlotsCallbacks : public PoolCallbacks {
+    SlotsCallbacks(ThreadLocalPool& parent) : parent_(parent) {}
+
+    // Redis::ConnPool::PoolCallbacks
+    void onResponse(RespValuePtr&& value) override;
+    void onFailure() override;
+
+    ThreadLocalPool& parent_;
+  };
+
+  // Drops the responses to ASKING and READONLY requests.
+  struct NoopCallbacks : public PoolCallbacks {
+    // Redis::ConnPool::PoolCallbacks
+    void onResponse(RespValuePtr&&) override {}
+    void onFailure() override {}
+  };
+
+  // A master and its replicas, which serve one or more ranges of slots.
+  struct Shard {
+    Shard(Upstream::HostConstSharedPtr master) : master_(master) {}
+
+    Upstream::HostConstSharedPtr master_;
+    std::vector<Upstream::HostConstSharedPtr> replicas_;
+    uint64_t next_read_host_{};
+  };
+
+  typedef std::shared_ptr<Shard> ShardSharedPtr;
 
   struct ThreadLocalPool : public ThreadLocal::ThreadLocalObject {
     ThreadLocalPool(InstanceImpl& parent, Event::Dispatcher& dispatcher,
                     const std::string& cluster_name);
     ~ThreadLocalPool();
     PoolRequest* makeRequest(const std::string& hash_key, const RespValue& request,
-                             PoolCallbacks& callbacks);
+                             PoolCallbacks& callbacks, bool read_only);
+    uint64_t upstreamId(const std::string& hash_key);
     void onHostsRemoved(const std::vector<Upstream::HostSharedPtr>& hosts_removed);
+    ThreadLocalActiveClient& chooseClient(Upstream::HostConstSharedPtr host);
+
+    // Cluster mode.
+    PoolRequest* makeClusterRequest(Upstream::HostConstSharedPtr host, const RespValue& request,
+                                    PoolCallbacks& callbacks);
+    Upstream::HostConstSharedPtr chooseShardHost(Shard& shard, bool read_only);
+    Upstream::HostConstSharedPtr hostByAddress(const std::string& address) const;
+    void onMoved(uint16_t slot, Upstream::HostConstSharedPtr host);
+    void refreshSlots();
+    void onSlots(const RespValue& value);
+    void updateHostsByAddress();
 
     InstanceImpl& parent_;
     Event::Dispatcher& dispatcher_;
     Upstream::ThreadLocalCluster* cluster_;
-    std::unordered_map<Upstream::HostConstSharedPtr, ThreadLocalActiveClientPtr> client_map_;
+    std::unordered_map<Upstream::HostConstSharedPtr, ThreadLocalActiveClientList> client_map_;
     Common::CallbackHandle* local_host_set_member_update_cb_handle_;
+
+    // Cluster mode. The slot map has an entry per slot, or is empty until it is first discovered.
+    // Slots whose master is not one of the cluster's hosts have no entry, and are load balanced.
+    // Replicas that are not hosts of the cluster are left out of their shard.
+    std::vector<ShardSharedPtr> slots_;
+    std::unordered_map<std::string, Upstream::HostConstSharedPtr> hosts_by_address_;
+    std::list<ClusterRequestPtr> cluster_requests_;
+    SlotsCallbacks slots_callbacks_{*this};
+    NoopCallbacks noop_callbacks_;
+    PoolRequest* slots_request_{};
+    uint64_t slots_host_index_{};
+    Event::TimerPtr refresh_timer_;
   };
 
   struct LbContextImpl : public Upstream::LoadBalancerContext {
@@ -158,6 +264,9 @@ private:
     // Upstream::LoadBalancerContext
     Optional<uint64_t> hashKey() const override { return hash_key_; }
     const Network::Connection* downstreamConnection() const override { return nullptr; }
+    const Upstream::MetadataMatchCriteria* metadataMatchCriteria() const override {
+      return nullptr;
+    }
 
     const Optional<uint64_t> hash_key_;
   };
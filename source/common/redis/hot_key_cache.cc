@@ -0,0 +1,60 @@
+#include "common/redis/hot_key_cache.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Envoy {
+namespace Redis {
+
+HotKeyCacheConfig::HotKeyCacheConfig(const Json::Object& config)
+    : ttl_(config.getInteger("ttl_ms")) {
+  const std::vector<std::string> keys = config.getStringArray("keys");
+  keys_.insert(keys.begin(), keys.end());
+  max_entries_ = config.getInteger("max_entries", keys_.size());
+}
+
+HotKeyCache::HotKeyCache(const HotKeyCacheConfig& config, MonotonicTimeSource& time_source)
+    : config_(config), time_source_(time_source) {}
+
+const RespValue* HotKeyCache::lookup(const std::string& key) {
+  auto entry = entries_by_key_.find(key);
+  if (entry == entries_by_key_.end()) {
+    return nullptr;
+  }
+
+  if (time_source_.currentTime() >= entry->second->expiry_) {
+    entries_.erase(entry->second);
+    entries_by_key_.erase(entry);
+    return nullptr;
+  }
+
+  entries_.splice(entries_.begin(), entries_, entry->second);
+  return &entry->second->value_;
+}
+
+void HotKeyCache::insert(const std::string& key, const RespValue& value) {
+  if (!isHot(key) || (value.type() != RespType::BulkString && value.type() != RespType::Null)) {
+    return;
+  }
+
+  invalidate(key);
+  entries_.emplace_front(key, value, time_source_.currentTime() + config_.ttl_);
+  entries_by_key_[key] = entries_.begin();
+  if (entries_.size() > config_.max_entries_) {
+    entries_by_key_.erase(entries_.back().key_);
+    entries_.pop_back();
+  }
+}
+
+void HotKeyCache::invalidate(const std::string& key) {
+  auto entry = entries_by_key_.find(key);
+  if (entry != entries_by_key_.end()) {
+    entries_.erase(entry->second);
+    entries_by_key_.erase(entry);
+  }
+}
+
+} // namespace Redis
+} // namespace Envoy
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "envoy/common/time.h"
+#include "envoy/json/json_object.h"
+#include "envoy/redis/codec.h"
+#include "envoy/thread_local/thread_local.h"
+
+namespace Envoy {
+namespace Redis {
+
+/**
+ * Configuration of a hot key cache.
+ */
+struct HotKeyCacheConfig {
+  HotKeyCacheConfig() : max_entries_(0), ttl_(0) {}
+  HotKeyCacheConfig(const Json::Object& config);
+
+  // The keys whose values are cached. No keys disables the cache.
+  std::unordered_set<std::string> keys_;
+  uint32_t max_entries_;
+  std::chrono::milliseconds ttl_;
+};
+
+/**
+ * A cache of the values of a fixed set of hot keys, so that the GET requests for a key that is
+ * read far more than the others do not all load the same upstream server. Values expire after a
+ * short TTL, and the least recently used values are evicted once the cache is full.
+ *
+ * The cache is not synchronized, so each worker has its own. It only sees the writes made through
+ * its worker, so a value may be stale by up to the TTL.
+ */
+class HotKeyCache : public ThreadLocal::ThreadLocalObject {
+public:
+  HotKeyCache(const HotKeyCacheConfig& config, MonotonicTimeSource& time_source);
+
+  /**
+   * @return bool whether the values of a key are cached.
+   */
+  bool isHot(const std::string& key) const { return config_.keys_.count(key) > 0; }
+
+  /**
+   * Look up the cached value of a key.
+   * @param key supplies the key.
+   * @return const RespValue* the value, or nullptr if it is not cached or expired.
+   */
+  const RespValue* lookup(const std::string& key);
+
+  /**
+   * Cache the value of a hot key, as returned by GET. Other keys and error responses are ignored.
+   * @param key supplies the key.
+   * @param value supplies the value, which is copied.
+   */
+  void insert(const std::string& key, const RespValue& value);
+
+  /**
+   * Drop the cached value of a key, e.g. because it is being written.
+   * @param key supplies the key.
+   */
+  void invalidate(const std::string& key);
+
+  /**
+   * @return uint64_t the number of cached values, including the expired ones.
+   */
+  uint64_t size() const { return entries_.size(); }
+
+private:
+  struct Entry {
+    Entry(const std::string& key, const RespValue& value, MonotonicTime expiry)
+        : key_(key), value_(value), expiry_(expiry) {}
+
+    const std::string key_;
+    const RespValue value_;
+    const MonotonicTime expiry_;
+  };
+
+  // The most recently used entry is at the front.
+  typedef std::list<Entry> EntryList;
+
+  const HotKeyCacheConfig config_;
+  MonotonicTimeSource& time_source_;
+  EntryList entries_;
+  std::unordered_map<std::string, EntryList::iterator> entries_by_key_;
+};
+
+} // namespace Redis
+} // namespace Envoy
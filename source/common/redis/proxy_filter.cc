@@ -19,6 +19,9 @@ ProxyFilterConfig::ProxyFilterConfig(const Json::Object& config, Upstream::Clust
     : Json::Validator(config, Json::Schema::REDIS_PROXY_NETWORK_FILTER_SCHEMA),
       cluster_name_(config.getString("cluster_name")),
       stat_prefix_(fmt::format("redis.{}.", config.getString("stat_prefix"))),
+      hot_key_cache_config_(config.hasObject("hot_key_cache")
+                                ? HotKeyCacheConfig(*config.getObject("hot_key_cache"))
+                                : HotKeyCacheConfig()),
       stats_(generateStats(stat_prefix_, scope)) {
   Config::Utility::checkCluster("redis", cluster_name_, cm);
 }
@@ -13,6 +13,7 @@
 #include "common/buffer/buffer_impl.h"
 #include "common/json/json_loader.h"
 #include "common/json/json_validator.h"
+#include "common/redis/hot_key_cache.h"
 
 namespace Envoy {
 namespace Redis {
@@ -49,6 +50,7 @@ public:
 
   const std::string& clusterName() { return cluster_name_; }
   const std::string& statPrefix() { return stat_prefix_; }
+  const HotKeyCacheConfig& hotKeyCacheConfig() { return hot_key_cache_config_; }
   ProxyStats& stats() { return stats_; }
 
 private:
@@ -56,6 +58,7 @@ private:
 
   const std::string cluster_name_;
   const std::string stat_prefix_;
+  const HotKeyCacheConfig hot_key_cache_config_;
   ProxyStats stats_;
 };
 
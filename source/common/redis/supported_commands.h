@@ -28,6 +28,19 @@ struct SupportedCommands {
         "zrevrangebylex", "zrevrangebyscore", "zrevrank", "zscan", "zscore");
   }
 
+  /**
+   * @return simple commands which only read, and may be sent to replicas
+   */
+  static const std::vector<std::string>& readOnlyCommands() {
+    CONSTRUCT_ON_FIRST_USE(
+        std::vector<std::string>, "bitcount", "bitpos", "dump", "geodist", "geohash", "geopos",
+        "get", "getbit", "getrange", "hexists", "hget", "hgetall", "hkeys", "hlen", "hmget",
+        "hscan", "hstrlen", "hvals", "lindex", "llen", "lrange", "pttl", "scard", "sismember",
+        "smembers", "srandmember", "sscan", "strlen", "ttl", "type", "zcard", "zcount",
+        "zlexcount", "zrange", "zrangebylex", "zrangebyscore", "zrank", "zrevrange",
+        "zrevrangebylex", "zrevrangebyscore", "zrevrank", "zscan", "zscore");
+  }
+
   /**
    * @return commands which hash on the fourth argument
    */
@@ -42,6 +55,11 @@ struct SupportedCommands {
     CONSTRUCT_ON_FIRST_USE(std::vector<std::string>, "del", "exists", "touch", "unlink");
   }
 
+  /**
+   * @return get command
+   */
+  static const std::string& get() { CONSTRUCT_ON_FIRST_USE(std::string, "get"); }
+
   /**
    * @return mget command
    */
@@ -1,10 +1,11 @@
 #include "common/router/config_impl.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <limits>
 #include <map>
 #include <memory>
-#include <regex>
 #include <string>
 #include <vector>
 
@@ -49,7 +50,17 @@ RetryPolicyImpl::RetryPolicyImpl(const envoy::api::v2::RouteAction& config) {
 CorsPolicyImpl::CorsPolicyImpl(const envoy::api::v2::CorsPolicy& config) {
   for (const auto& origin : config.allow_origin()) {
     allow_origin_.push_back(origin);
+
+    const size_t wildcard = origin.find('*');
+    if (origin == "*") {
+      allow_any_origin_ = true;
+    } else if (wildcard != std::string::npos && origin.rfind('*') == wildcard) {
+      wildcard_origins_.emplace_back(origin.substr(0, wildcard), origin.substr(wildcard + 1));
+    } else {
+      exact_origins_.push_back(origin);
+    }
   }
+  std::sort(exact_origins_.begin(), exact_origins_.end());
   allow_methods_ = config.allow_methods();
   allow_headers_ = config.allow_headers();
   expose_headers_ = config.expose_headers();
@@ -60,6 +71,33 @@ CorsPolicyImpl::CorsPolicyImpl(const envoy::api::v2::CorsPolicy& config) {
   enabled_ = PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, enabled, true);
 }
 
+bool CorsPolicyImpl::originAllowed(const Http::HeaderString& origin) const {
+  if (allow_any_origin_) {
+    return true;
+  }
+
+  const char* value = origin.c_str();
+  const size_t length = origin.size();
+  const auto exact = std::lower_bound(exact_origins_.begin(), exact_origins_.end(), value,
+                                      [](const std::string& allowed, const char* key) -> bool {
+                                        return allowed.compare(key) < 0;
+                                      });
+  if (exact != exact_origins_.end() && exact->compare(value) == 0) {
+    return true;
+  }
+
+  for (const auto& wildcard : wildcard_origins_) {
+    const std::string& prefix = wildcard.first;
+    const std::string& suffix = wildcard.second;
+    if (length >= prefix.size() + suffix.size() &&
+        prefix.compare(0, prefix.size(), value, prefix.size()) == 0 &&
+        suffix.compare(0, suffix.size(), value + length - suffix.size(), suffix.size()) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 ShadowPolicyImpl::ShadowPolicyImpl(const envoy::api::v2::RouteAction& config) {
   if (!config.has_request_mirror_policy()) {
     return;
@@ -84,11 +122,26 @@ Optional<uint64_t> HashPolicyImpl::generateHash(const Http::HeaderMap& headers)
   Optional<uint64_t> hash;
   const Http::HeaderEntry* header = headers.get(header_name_);
   if (header) {
-    hash.value(HashUtil::xxHash64(header->value().c_str()));
+    const Http::HeaderString& value = header->value();
+    hash.value(HashUtil::xxHash64(value.c_str(), value.size()));
   }
   return hash;
 }
 
+MetadataMatchCriteriaImpl::MetadataMatchCriteriaImpl(const envoy::api::v2::Metadata& metadata) {
+  const std::string& filter = Envoy::Config::MetadataFilters::get().ENVOY_LB;
+  std::vector<std::string> keys;
+  for (const auto& field : metadata.filter_metadata().at(filter).fields()) {
+    keys.push_back(field.first);
+  }
+  std::sort(keys.begin(), keys.end());
+
+  if (!Envoy::Config::Metadata::subsetKey(metadata, filter, keys, subset_key_)) {
+    throw EnvoyException(
+        fmt::format("route: {} metadata values must be strings, numbers or bools", filter));
+  }
+}
+
 DecoratorImpl::DecoratorImpl(const envoy::api::v2::Decorator& decorator)
     : operation_(decorator.operation()) {}
 
@@ -107,14 +160,17 @@ RouteEntryImplBase::RouteEntryImplBase(const VirtualHostImpl& vhost,
       vhost_(vhost),
       auto_host_rewrite_(PROTOBUF_GET_WRAPPED_OR_DEFAULT(route.route(), auto_host_rewrite, false)),
       use_websocket_(PROTOBUF_GET_WRAPPED_OR_DEFAULT(route.route(), use_websocket, false)),
-      cluster_name_(route.route().cluster()), cluster_header_name_(route.route().cluster_header()),
+      cluster_name_(route.route().cluster()), cluster_handle_(cluster_name_),
+      cluster_header_name_(route.route().cluster_header()),
       timeout_(PROTOBUF_GET_MS_OR_DEFAULT(route.route(), timeout, DEFAULT_ROUTE_TIMEOUT_MS)),
       runtime_(loadRuntimeData(route.match())), loader_(loader),
       host_redirect_(route.redirect().host_redirect()),
       path_redirect_(route.redirect().path_redirect()), retry_policy_(route.route()),
       rate_limit_policy_(route.route().rate_limits()), shadow_policy_(route.route()),
       priority_(ConfigUtility::parsePriority(route.route().priority())),
-      opaque_config_(parseOpaqueConfig(route)), decorator_(parseDecorator(route)) {
+      opaque_config_(parseOpaqueConfig(route)), decorator_(parseDecorator(route)),
+      metadata_match_criteria_(parseMetadataMatchCriteria(route)),
+      per_request_buffer_limit_(parsePerRequestBufferLimit(route)) {
   // If this is a weighted_cluster, we create N internal route entries
   // (called WeightedClusterEntry), such that each object is a simple
   // single cluster, pointing back to the parent.
@@ -150,6 +206,19 @@ RouteEntryImplBase::RouteEntryImplBase(const VirtualHostImpl& vhost,
                                        header_value_option.header().value()});
   }
 
+  // The headers of the route, the virtual host and the route table are flattened into one list in
+  // the order they are appended. The virtual host and the route table load their headers before
+  // their routes and do not change them afterwards, so the pointers stay valid.
+  const auto flatten =
+      [this](const std::vector<std::pair<Http::LowerCaseString, std::string>>& headers_to_add) {
+        for (const std::pair<Http::LowerCaseString, std::string>& to_add : headers_to_add) {
+          all_request_headers_to_add_.push_back(&to_add);
+        }
+      };
+  flatten(request_headers_to_add_);
+  flatten(vhost_.requestHeadersToAdd());
+  flatten(vhost_.globalRouteConfig().requestHeadersToAdd());
+
   // Only set include_vh_rate_limits_ to true if the rate limit policy for the route is empty
   // or the route set `include_vh_rate_limits` to true.
   include_vh_rate_limits_ =
@@ -179,15 +248,8 @@ const std::string& RouteEntryImplBase::clusterName() const { return cluster_name
 void RouteEntryImplBase::finalizeRequestHeaders(Http::HeaderMap& headers) const {
   // Append user-specified request headers in the following order: route-level headers,
   // virtual host level headers and finally global connection manager level headers.
-  for (const std::pair<Http::LowerCaseString, std::string>& to_add : requestHeadersToAdd()) {
-    headers.addReference(to_add.first, to_add.second);
-  }
-  for (const std::pair<Http::LowerCaseString, std::string>& to_add : vhost_.requestHeadersToAdd()) {
-    headers.addReference(to_add.first, to_add.second);
-  }
-  for (const std::pair<Http::LowerCaseString, std::string>& to_add :
-       vhost_.globalRouteConfig().requestHeadersToAdd()) {
-    headers.addReference(to_add.first, to_add.second);
+  for (const std::pair<Http::LowerCaseString, std::string>* to_add : all_request_headers_to_add_) {
+    headers.addReference(to_add->first, to_add->second);
   }
 
   if (host_rewrite_.empty()) {
@@ -201,10 +263,8 @@ Optional<RouteEntryImplBase::RuntimeData>
 RouteEntryImplBase::loadRuntimeData(const envoy::api::v2::RouteMatch& route_match) {
   Optional<RuntimeData> runtime;
   if (route_match.has_runtime()) {
-    RuntimeData data;
-    data.key_ = route_match.runtime().runtime_key();
-    data.default_ = route_match.runtime().default_value();
-    runtime.value(data);
+    runtime.value(RuntimeData{Runtime::Key(route_match.runtime().runtime_key()),
+                              route_match.runtime().default_value()});
   }
 
   return runtime;
@@ -272,6 +332,43 @@ DecoratorConstPtr RouteEntryImplBase::parseDecorator(const envoy::api::v2::Route
   return ret;
 }
 
+std::unique_ptr<const MetadataMatchCriteriaImpl>
+RouteEntryImplBase::parseMetadataMatchCriteria(const envoy::api::v2::Route& route) {
+  const auto filter_metadata =
+      route.metadata().filter_metadata().find(Envoy::Config::MetadataFilters::get().ENVOY_LB);
+  if (filter_metadata == route.metadata().filter_metadata().end() ||
+      filter_metadata->second.fields().empty()) {
+    return nullptr;
+  }
+  return std::unique_ptr<const MetadataMatchCriteriaImpl>(
+      new MetadataMatchCriteriaImpl(route.metadata()));
+}
+
+Optional<uint32_t>
+RouteEntryImplBase::parsePerRequestBufferLimit(const envoy::api::v2::Route& route) {
+  const std::string& key = Envoy::Config::MetadataEnvoyRouterKeys::get().PER_REQUEST_BUFFER_LIMIT;
+  const ProtobufWkt::Value& value = Envoy::Config::Metadata::metadataValue(
+      route.metadata(), Envoy::Config::HttpFilterNames::get().ROUTER, key);
+  if (value.kind_case() == ProtobufWkt::Value::KIND_NOT_SET) {
+    return {};
+  }
+
+  // A string value is accepted as well, so that v1 routes can set the limit via opaque_config.
+  uint64_t limit = 0;
+  bool valid = false;
+  if (value.kind_case() == ProtobufWkt::Value::kNumberValue) {
+    valid = value.number_value() >= 0 &&
+            value.number_value() <= std::numeric_limits<uint32_t>::max();
+    limit = valid ? static_cast<uint64_t>(value.number_value()) : 0;
+  } else if (value.kind_case() == ProtobufWkt::Value::kStringValue) {
+    valid = StringUtil::atoul(value.string_value().c_str(), limit);
+  }
+  if (!valid || limit > std::numeric_limits<uint32_t>::max()) {
+    throw EnvoyException(fmt::format("route: {} must be a number of bytes", key));
+  }
+  return static_cast<uint32_t>(limit);
+}
+
 const RedirectEntry* RouteEntryImplBase::redirectEntry() const {
   // A route for a request can exclusively be a route entry or a redirect entry.
   if (isRedirect()) {
@@ -422,14 +519,14 @@ RegexRouteEntryImpl::RegexRouteEntryImpl(const VirtualHostImpl& vhost,
                                          const envoy::api::v2::Route& route,
                                          Runtime::Loader& loader)
     : RouteEntryImplBase(vhost, route, loader),
-      regex_(std::regex{route.match().regex().c_str(), std::regex::optimize}) {}
+      regex_(Regex::Utility::parseRegex(route.match().regex())) {}
 
 void RegexRouteEntryImpl::finalizeRequestHeaders(Http::HeaderMap& headers) const {
   RouteEntryImplBase::finalizeRequestHeaders(headers);
 
   const Http::HeaderString& path = headers.Path()->value();
   const char* query_string_start = Http::Utility::findQueryStringStart(path);
-  ASSERT(std::regex_match(path.c_str(), query_string_start, regex_));
+  ASSERT(regex_->match(path.c_str(), query_string_start));
   std::string matched_path(path.c_str(), query_string_start);
   finalizePathHeader(headers, matched_path);
 }
@@ -439,7 +536,7 @@ RouteConstSharedPtr RegexRouteEntryImpl::matches(const Http::HeaderMap& headers,
   if (RouteEntryImplBase::matchRoute(headers, random_value)) {
     const Http::HeaderString& path = headers.Path()->value();
     const char* query_string_start = Http::Utility::findQueryStringStart(path);
-    if (std::regex_match(path.c_str(), query_string_start, regex_)) {
+    if (regex_->match(path.c_str(), query_string_start)) {
       return clusterEntry(headers, random_value);
     }
   }
@@ -447,8 +544,7 @@ RouteConstSharedPtr RegexRouteEntryImpl::matches(const Http::HeaderMap& headers,
 }
 
 VirtualHostImpl::VirtualHostImpl(const envoy::api::v2::VirtualHost& virtual_host,
-                                 const ConfigImpl& global_route_config, Runtime::Loader& runtime,
-                                 Upstream::ClusterManager& cm, bool validate_clusters)
+                                 const ConfigImpl& global_route_config, Runtime::Loader& runtime)
     : name_(virtual_host.name()), rate_limit_policy_(virtual_host.rate_limits()),
       global_route_config_(global_route_config) {
   switch (virtual_host.require_tls()) {
@@ -476,24 +572,22 @@ VirtualHostImpl::VirtualHostImpl(const envoy::api::v2::VirtualHost& virtual_host
     const bool has_path = route.match().path_specifier_case() == envoy::api::v2::RouteMatch::kPath;
     const bool has_regex =
         route.match().path_specifier_case() == envoy::api::v2::RouteMatch::kRegex;
+    const uint32_t index = routes_.size();
+    PathMatchTrie& trie =
+        PROTOBUF_GET_WRAPPED_OR_DEFAULT(route.match(), case_sensitive, true)
+            ? case_sensitive_routes_
+            : case_insensitive_routes_;
     if (has_prefix) {
       routes_.emplace_back(new PrefixRouteEntryImpl(*this, route, runtime));
+      trie.addPrefix(route.match().prefix(), index);
     } else if (has_path) {
       routes_.emplace_back(new PathRouteEntryImpl(*this, route, runtime));
+      trie.addPath(route.match().path(), index);
     } else {
       ASSERT(has_regex);
       UNREFERENCED_PARAMETER(has_regex);
       routes_.emplace_back(new RegexRouteEntryImpl(*this, route, runtime));
-    }
-
-    if (validate_clusters) {
-      routes_.back()->validateClusters(cm);
-      if (!routes_.back()->shadowPolicy().cluster().empty()) {
-        if (!cm.get(routes_.back()->shadowPolicy().cluster())) {
-          throw EnvoyException(fmt::format("route: unknown shadow cluster '{}'",
-                                           routes_.back()->shadowPolicy().cluster()));
-        }
-      }
+      regex_routes_.push_back(index);
     }
   }
 
@@ -516,44 +610,36 @@ bool VirtualHostImpl::usesRuntime() const {
   return uses;
 }
 
+void VirtualHostImpl::validateClusters(Upstream::ClusterManager& cm) const {
+  for (const RouteEntryImplBaseConstSharedPtr& route : routes_) {
+    route->validateClusters(cm);
+    if (!route->shadowPolicy().cluster().empty()) {
+      if (!cm.get(route->shadowPolicy().cluster())) {
+        throw EnvoyException(
+            fmt::format("route: unknown shadow cluster '{}'", route->shadowPolicy().cluster()));
+      }
+    }
+  }
+}
+
 VirtualHostImpl::VirtualClusterEntry::VirtualClusterEntry(
     const envoy::api::v2::VirtualCluster& virtual_cluster) {
   if (virtual_cluster.method() != envoy::api::v2::RequestMethod::METHOD_UNSPECIFIED) {
     method_ = envoy::api::v2::RequestMethod_Name(virtual_cluster.method());
   }
 
-  const std::string pattern = virtual_cluster.pattern();
-  pattern_ = std::regex{pattern, std::regex::optimize};
+  pattern_ = Regex::Utility::parseRegex(virtual_cluster.pattern());
   name_ = virtual_cluster.name();
 }
 
-const VirtualHostImpl* RouteMatcher::findWildcardVirtualHost(const std::string& host) const {
-  // We do a longest wildcard suffix match against the host that's passed in.
-  // (e.g. foo-bar.baz.com should match *-bar.baz.com before matching *.baz.com)
-  // This is done by scanning the length => wildcards map looking for every
-  // wildcard whose size is < length.
-  for (const auto& iter : wildcard_virtual_host_suffixes_) {
-    const uint32_t wildcard_length = iter.first;
-    const auto& wildcard_map = iter.second;
-    // >= because *.foo.com shouldn't match .foo.com.
-    if (wildcard_length >= host.size()) {
-      continue;
-    }
-    const auto& match = wildcard_map.find(host.substr(host.size() - wildcard_length));
-    if (match != wildcard_map.end()) {
-      return match->second.get();
-    }
-  }
-  return nullptr;
-}
-
 RouteMatcher::RouteMatcher(const envoy::api::v2::RouteConfiguration& route_config,
-                           const ConfigImpl& global_route_config, Runtime::Loader& runtime,
-                           Upstream::ClusterManager& cm, bool validate_clusters) {
+                           const ConfigImpl& global_route_config, Runtime::Loader& runtime) {
   for (const auto& virtual_host_config : route_config.virtual_hosts()) {
-    VirtualHostSharedPtr virtual_host(new VirtualHostImpl(virtual_host_config, global_route_config,
-                                                          runtime, cm, validate_clusters));
+    VirtualHostSharedPtr virtual_host(
+        new VirtualHostImpl(virtual_host_config, global_route_config, runtime));
     uses_runtime_ |= virtual_host->usesRuntime();
+    const uint32_t id = virtual_hosts_.size();
+    virtual_hosts_.push_back(virtual_host);
 
     for (const std::string& domain : virtual_host_config.domains()) {
       if ("*" == domain) {
@@ -562,14 +648,10 @@ RouteMatcher::RouteMatcher(const envoy::api::v2::RouteConfiguration& route_confi
         }
         default_virtual_host_ = virtual_host;
       } else if (domain.size() > 0 && '*' == domain[0]) {
-        wildcard_virtual_host_suffixes_[domain.size() - 1].emplace(domain.substr(1), virtual_host);
-      } else {
-        if (virtual_hosts_.find(domain) != virtual_hosts_.end()) {
-          throw EnvoyException(fmt::format(
-              "Only unique values for domains are permitted. Duplicate entry of domain {}",
-              domain));
-        }
-        virtual_hosts_.emplace(domain, virtual_host);
+        domains_.addWildcardSuffix(domain.substr(1), id);
+      } else if (!domains_.addDomain(domain, id)) {
+        throw EnvoyException(fmt::format(
+            "Only unique values for domains are permitted. Duplicate entry of domain {}", domain));
       }
     }
   }
@@ -585,39 +667,63 @@ RouteConstSharedPtr VirtualHostImpl::getRouteFromEntries(const Http::HeaderMap&
     return SSL_REDIRECT_ROUTE;
   }
 
-  // Check for a route that matches the request.
-  for (const RouteEntryImplBaseConstSharedPtr& route : routes_) {
-    RouteConstSharedPtr route_entry = route->matches(headers, random_value);
-    if (nullptr != route_entry) {
-      return route_entry;
-    }
+  if (routes_.empty()) {
+    return nullptr;
   }
 
-  return nullptr;
+  // Routes are matched in configuration order, so we want the matching route with the lowest
+  // index. Only routes that the tries report as candidates for this path (plus all regex routes)
+  // are evaluated. Within a candidate list ids are ascending, so a list can be abandoned as soon
+  // as it reaches the best match found so far.
+  uint32_t best_index = routes_.size();
+  RouteConstSharedPtr best_route;
+  auto evaluate = [&](const std::vector<uint32_t>& candidates) -> void {
+    for (uint32_t index : candidates) {
+      if (index >= best_index) {
+        return;
+      }
+      RouteConstSharedPtr route_entry = routes_[index]->matches(headers, random_value);
+      if (nullptr != route_entry) {
+        best_index = index;
+        best_route = std::move(route_entry);
+        return;
+      }
+    }
+  };
+
+  const Http::HeaderString& path = headers.Path()->value();
+  const size_t exact_length = Http::Utility::findQueryStringStart(path) - path.c_str();
+  case_sensitive_routes_.forEachCandidate(path.c_str(), path.size(), exact_length, evaluate);
+  case_insensitive_routes_.forEachCandidate(path.c_str(), path.size(), exact_length, evaluate);
+  evaluate(regex_routes_);
+
+  return best_route;
 }
 
 const VirtualHostImpl* RouteMatcher::findVirtualHost(const Http::HeaderMap& headers) const {
   // Fast path the case where we only have a default virtual host.
-  if (virtual_hosts_.empty() && default_virtual_host_) {
+  if (domains_.empty()) {
     return default_virtual_host_.get();
   }
 
+  // Exact domains take precedence over wildcards, and longer wildcard suffixes over shorter ones
+  // (e.g. foo-bar.baz.com matches *-bar.baz.com before *.baz.com).
   // TODO (@rshriram) Match Origin header in WebSocket
   // request with VHost, using wildcard match
-  const char* host = headers.Host()->value().c_str();
-  const auto& iter = virtual_hosts_.find(host);
-  if (iter != virtual_hosts_.end()) {
-    return iter->second.get();
-  }
-  if (!wildcard_virtual_host_suffixes_.empty()) {
-    const VirtualHostImpl* vhost = findWildcardVirtualHost(host);
-    if (vhost != nullptr) {
-      return vhost;
-    }
+  const Http::HeaderString& host = headers.Host()->value();
+  const uint32_t id = domains_.find(host.c_str(), host.size());
+  if (id != DomainMatchTrie::NO_MATCH) {
+    return virtual_hosts_[id].get();
   }
   return default_virtual_host_.get();
 }
 
+void RouteMatcher::validateClusters(Upstream::ClusterManager& cm) const {
+  for (const VirtualHostSharedPtr& virtual_host : virtual_hosts_) {
+    virtual_host->validateClusters(cm);
+  }
+}
+
 RouteConstSharedPtr RouteMatcher::route(const Http::HeaderMap& headers,
                                         uint64_t random_value) const {
   const VirtualHostImpl* virtual_host = findVirtualHost(headers);
@@ -639,7 +745,8 @@ VirtualHostImpl::virtualClusterFromEntries(const Http::HeaderMap& headers) const
     bool method_matches =
         !entry.method_.valid() || headers.Method()->value().c_str() == entry.method_.value();
 
-    if (method_matches && std::regex_match(headers.Path()->value().c_str(), entry.pattern_)) {
+    const Http::HeaderString& path = headers.Path()->value();
+    if (method_matches && entry.pattern_->match(path.c_str(), path.c_str() + path.size())) {
       return &entry;
     }
   }
@@ -653,10 +760,7 @@ VirtualHostImpl::virtualClusterFromEntries(const Http::HeaderMap& headers) const
 
 ConfigImpl::ConfigImpl(const envoy::api::v2::RouteConfiguration& config, Runtime::Loader& runtime,
                        Upstream::ClusterManager& cm, bool validate_clusters_default) {
-  route_matcher_.reset(new RouteMatcher(
-      config, *this, runtime, cm,
-      PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, validate_clusters, validate_clusters_default)));
-
+  internal_only_headers_.reserve(config.internal_only_headers().size());
   for (const std::string& header : config.internal_only_headers()) {
     internal_only_headers_.push_back(Http::LowerCaseString(header));
   }
@@ -674,6 +778,12 @@ ConfigImpl::ConfigImpl(const envoy::api::v2::RouteConfiguration& config, Runtime
     request_headers_to_add_.push_back({Http::LowerCaseString(header_value_option.header().key()),
                                        header_value_option.header().value()});
   }
+
+  // The routes are loaded last, as they refer to the request headers of the route table.
+  route_matcher_.reset(new RouteMatcher(config, *this, runtime));
+  if (PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, validate_clusters, validate_clusters_default)) {
+    validateClusters(cm);
+  }
 }
 
 } // namespace Router
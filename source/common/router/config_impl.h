@@ -5,9 +5,8 @@
 #include <list>
 #include <map>
 #include <memory>
-#include <regex>
 #include <string>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "envoy/common/optional.h"
@@ -15,7 +14,10 @@
 #include "envoy/runtime/runtime.h"
 #include "envoy/upstream/cluster_manager.h"
 
+#include "common/common/regex.h"
 #include "common/router/config_utility.h"
+#include "common/router/domain_match_trie.h"
+#include "common/router/path_match_trie.h"
 #include "common/router/router_ratelimit.h"
 
 #include "api/rds.pb.h"
@@ -65,7 +67,11 @@ private:
 };
 
 /**
- * Implementation of CorsPolicy that reads from the proto route and virtual host config.
+ * Implementation of CorsPolicy that reads from the proto route and virtual host config. An allowed
+ * origin of "*" matches any origin, and one with a single other '*', like
+ * "https://*.example.com", matches the origins with its prefix and suffix. Other origins are
+ * matched exactly, with a binary search of the sorted origins, so that lists of hundreds of
+ * origins do not cost a scan per request.
  */
 class CorsPolicyImpl : public CorsPolicy {
 public:
@@ -73,6 +79,7 @@ public:
 
   // Router::CorsPolicy
   const std::list<std::string>& allowOrigins() const override { return allow_origin_; };
+  bool originAllowed(const Http::HeaderString& origin) const override;
   const std::string& allowMethods() const override { return allow_methods_; };
   const std::string& allowHeaders() const override { return allow_headers_; };
   const std::string& exposeHeaders() const override { return expose_headers_; };
@@ -82,6 +89,10 @@ public:
 
 private:
   std::list<std::string> allow_origin_;
+  bool allow_any_origin_{};
+  std::vector<std::string> exact_origins_;
+  // The prefix and suffix of each wildcard origin.
+  std::vector<std::pair<std::string, std::string>> wildcard_origins_;
   std::string allow_methods_;
   std::string allow_headers_;
   std::string expose_headers_;
@@ -97,14 +108,14 @@ class ConfigImpl;
 class VirtualHostImpl : public VirtualHost {
 public:
   VirtualHostImpl(const envoy::api::v2::VirtualHost& virtual_host,
-                  const ConfigImpl& global_route_config, Runtime::Loader& runtime,
-                  Upstream::ClusterManager& cm, bool validate_clusters);
+                  const ConfigImpl& global_route_config, Runtime::Loader& runtime);
 
   RouteConstSharedPtr getRouteFromEntries(const Http::HeaderMap& headers,
                                           uint64_t random_value) const;
   bool usesRuntime() const;
+  void validateClusters(Upstream::ClusterManager& cm) const;
   const VirtualCluster* virtualClusterFromEntries(const Http::HeaderMap& headers) const;
-  const std::list<std::pair<Http::LowerCaseString, std::string>>& requestHeadersToAdd() const {
+  const std::vector<std::pair<Http::LowerCaseString, std::string>>& requestHeadersToAdd() const {
     return request_headers_to_add_;
   }
   const ConfigImpl& globalRouteConfig() const { return global_route_config_; }
@@ -123,7 +134,7 @@ private:
     // Router::VirtualCluster
     const std::string& name() const override { return name_; }
 
-    std::regex pattern_;
+    Regex::CompiledMatcherPtr pattern_;
     Optional<std::string> method_;
     std::string name_;
   };
@@ -140,13 +151,18 @@ private:
 
   const std::string name_;
   std::vector<RouteEntryImplBaseConstSharedPtr> routes_;
+  // Index over routes_ by prefix and exact path so that only routes which can match a request's
+  // path are evaluated. Regex routes are not indexed and are always evaluated.
+  PathMatchTrie case_sensitive_routes_{true};
+  PathMatchTrie case_insensitive_routes_{false};
+  std::vector<uint32_t> regex_routes_;
   std::vector<VirtualClusterEntry> virtual_clusters_;
   SslRequirements ssl_requirements_;
   const RateLimitPolicyImpl rate_limit_policy_;
   std::unique_ptr<const CorsPolicyImpl> cors_policy_;
   const ConfigImpl& global_route_config_; // See note in RouteEntryImplBase::clusterEntry() on why
                                           // raw ref to the top level config is currently safe.
-  std::list<std::pair<Http::LowerCaseString, std::string>> request_headers_to_add_;
+  std::vector<std::pair<Http::LowerCaseString, std::string>> request_headers_to_add_;
 };
 
 typedef std::shared_ptr<VirtualHostImpl> VirtualHostSharedPtr;
@@ -201,6 +217,21 @@ private:
   const Http::LowerCaseString header_name_;
 };
 
+/**
+ * Implementation of MetadataMatchCriteria that reads the envoy.lb filter metadata of the proto
+ * route. Each of its string, number or bool values is required of the upstream host.
+ */
+class MetadataMatchCriteriaImpl : public Upstream::MetadataMatchCriteria {
+public:
+  MetadataMatchCriteriaImpl(const envoy::api::v2::Metadata& metadata);
+
+  // Upstream::MetadataMatchCriteria
+  const std::string& subsetKey() const override { return subset_key_; }
+
+private:
+  std::string subset_key_;
+};
+
 /**
  * Implementation of Decorator that reads from the proto route decorator.
  */
@@ -232,12 +263,15 @@ public:
 
   bool matchRoute(const Http::HeaderMap& headers, uint64_t random_value) const;
   void validateClusters(Upstream::ClusterManager& cm) const;
-  const std::list<std::pair<Http::LowerCaseString, std::string>>& requestHeadersToAdd() const {
+  const std::vector<std::pair<Http::LowerCaseString, std::string>>& requestHeadersToAdd() const {
     return request_headers_to_add_;
   }
 
   // Router::RouteEntry
   const std::string& clusterName() const override;
+  const Upstream::ClusterHandle* clusterHandle() const override {
+    return cluster_name_.empty() ? nullptr : &cluster_handle_;
+  }
   const CorsPolicy* corsPolicy() const override { return cors_policy_.get(); }
   void finalizeRequestHeaders(Http::HeaderMap& headers) const override;
   const HashPolicy* hashPolicy() const override { return hash_policy_.get(); }
@@ -256,6 +290,10 @@ public:
     return opaque_config_;
   }
   bool includeVirtualHostRateLimits() const override { return include_vh_rate_limits_; }
+  const Upstream::MetadataMatchCriteria* metadataMatchCriteria() const override {
+    return metadata_match_criteria_.get();
+  }
+  Optional<uint32_t> perRequestBufferLimit() const override { return per_request_buffer_limit_; }
 
   // Router::RedirectEntry
   std::string newPath(const Http::HeaderMap& headers) const override;
@@ -276,7 +314,7 @@ protected:
 
 private:
   struct RuntimeData {
-    std::string key_;
+    Runtime::Key key_;
     uint64_t default_;
   };
 
@@ -287,6 +325,8 @@ private:
 
     // Router::RouteEntry
     const std::string& clusterName() const override { return cluster_name_; }
+    // The cluster of a header is only known for one request, so it is found by its name.
+    const Upstream::ClusterHandle* clusterHandle() const override { return nullptr; }
 
     void finalizeRequestHeaders(Http::HeaderMap& headers) const override {
       return parent_->finalizeRequestHeaders(headers);
@@ -314,6 +354,12 @@ private:
     bool includeVirtualHostRateLimits() const override {
       return parent_->includeVirtualHostRateLimits();
     }
+    const Upstream::MetadataMatchCriteria* metadataMatchCriteria() const override {
+      return parent_->metadataMatchCriteria();
+    }
+    Optional<uint32_t> perRequestBufferLimit() const override {
+      return parent_->perRequestBufferLimit();
+    }
 
     // Router::Route
     const RedirectEntry* redirectEntry() const override { return nullptr; }
@@ -336,7 +382,10 @@ private:
     WeightedClusterEntry(const RouteEntryImplBase* parent, const std::string runtime_key,
                          Runtime::Loader& loader, const std::string& name, uint64_t weight)
         : DynamicRouteEntry(parent, name), runtime_key_(runtime_key), loader_(loader),
-          cluster_weight_(weight) {}
+          cluster_weight_(weight), cluster_handle_(name) {}
+
+    // Router::RouteEntry
+    const Upstream::ClusterHandle* clusterHandle() const override { return &cluster_handle_; }
 
     uint64_t clusterWeight() const {
       return loader_.snapshot().getInteger(runtime_key_, cluster_weight_);
@@ -345,9 +394,10 @@ private:
     static const uint64_t MAX_CLUSTER_WEIGHT;
 
   private:
-    const std::string runtime_key_;
+    const Runtime::Key runtime_key_;
     Runtime::Loader& loader_;
     const uint64_t cluster_weight_;
+    const Upstream::ClusterHandle cluster_handle_;
   };
 
   typedef std::shared_ptr<WeightedClusterEntry> WeightedClusterEntrySharedPtr;
@@ -359,6 +409,11 @@ private:
 
   static DecoratorConstPtr parseDecorator(const envoy::api::v2::Route& route);
 
+  static std::unique_ptr<const MetadataMatchCriteriaImpl>
+  parseMetadataMatchCriteria(const envoy::api::v2::Route& route);
+
+  static Optional<uint32_t> parsePerRequestBufferLimit(const envoy::api::v2::Route& route);
+
   // Default timeout is 15s if nothing is specified in the route config.
   static const uint64_t DEFAULT_ROUTE_TIMEOUT_MS = 15000;
 
@@ -368,6 +423,7 @@ private:
   const bool auto_host_rewrite_;
   const bool use_websocket_;
   const std::string cluster_name_;
+  const Upstream::ClusterHandle cluster_handle_;
   const Http::LowerCaseString cluster_header_name_;
   const std::chrono::milliseconds timeout_;
   const Optional<RuntimeData> runtime_;
@@ -381,12 +437,16 @@ private:
   std::vector<ConfigUtility::HeaderData> config_headers_;
   std::vector<WeightedClusterEntrySharedPtr> weighted_clusters_;
   std::unique_ptr<const HashPolicyImpl> hash_policy_;
-  std::list<std::pair<Http::LowerCaseString, std::string>> request_headers_to_add_;
+  std::vector<std::pair<Http::LowerCaseString, std::string>> request_headers_to_add_;
+  // The request headers of the route, the virtual host and the route table, in the order added.
+  std::vector<const std::pair<Http::LowerCaseString, std::string>*> all_request_headers_to_add_;
 
   // TODO(danielhochman): refactor multimap into unordered_map since JSON is unordered map.
   const std::multimap<std::string, std::string> opaque_config_;
 
   const DecoratorConstPtr decorator_;
+  const std::unique_ptr<const MetadataMatchCriteriaImpl> metadata_match_criteria_;
+  const Optional<uint32_t> per_request_buffer_limit_;
 };
 
 /**
@@ -440,7 +500,7 @@ public:
   RouteConstSharedPtr matches(const Http::HeaderMap& headers, uint64_t random_value) const override;
 
 private:
-  const std::regex regex_;
+  const Regex::CompiledMatcherPtr regex_;
 };
 
 /**
@@ -450,28 +510,18 @@ private:
 class RouteMatcher {
 public:
   RouteMatcher(const envoy::api::v2::RouteConfiguration& config,
-               const ConfigImpl& global_http_config, Runtime::Loader& runtime,
-               Upstream::ClusterManager& cm, bool validate_clusters);
+               const ConfigImpl& global_http_config, Runtime::Loader& runtime);
 
   RouteConstSharedPtr route(const Http::HeaderMap& headers, uint64_t random_value) const;
   bool usesRuntime() const { return uses_runtime_; }
+  void validateClusters(Upstream::ClusterManager& cm) const;
 
 private:
   const VirtualHostImpl* findVirtualHost(const Http::HeaderMap& headers) const;
-  const VirtualHostImpl* findWildcardVirtualHost(const std::string& host) const;
-
-  std::unordered_map<std::string, VirtualHostSharedPtr> virtual_hosts_;
-  // std::greater as a minor optimization to iterate from more to less specific
-  //
-  // A note on using an unordered_map versus a vector of (string, VirtualHostSharedPtr) pairs:
-  //
-  // Based on local benchmarks, each vector entry costs around 20ns for recall and (string)
-  // comparison with a fixed cost of about 25ns. For unordered_map, the empty map costs about 65ns
-  // and climbs to about 110ns once there are any entries.
-  //
-  // The break-even is 4 entries.
-  std::map<int64_t, std::unordered_map<std::string, VirtualHostSharedPtr>, std::greater<int64_t>>
-      wildcard_virtual_host_suffixes_;
+
+  // In configuration order. The domains trie identifies virtual hosts by their position here.
+  std::vector<VirtualHostSharedPtr> virtual_hosts_;
+  DomainMatchTrie domains_;
   VirtualHostSharedPtr default_virtual_host_;
   bool uses_runtime_{};
 };
@@ -484,7 +534,7 @@ public:
   ConfigImpl(const envoy::api::v2::RouteConfiguration& config, Runtime::Loader& runtime,
              Upstream::ClusterManager& cm, bool validate_clusters_default);
 
-  const std::list<std::pair<Http::LowerCaseString, std::string>>& requestHeadersToAdd() const {
+  const std::vector<std::pair<Http::LowerCaseString, std::string>>& requestHeadersToAdd() const {
     return request_headers_to_add_;
   }
 
@@ -493,27 +543,38 @@ public:
     return route_matcher_->route(headers, random_value);
   }
 
-  const std::list<Http::LowerCaseString>& internalOnlyHeaders() const override {
+  const std::vector<Http::LowerCaseString>& internalOnlyHeaders() const override {
     return internal_only_headers_;
   }
 
-  const std::list<std::pair<Http::LowerCaseString, std::string>>&
+  const std::vector<std::pair<Http::LowerCaseString, std::string>>&
   responseHeadersToAdd() const override {
     return response_headers_to_add_;
   }
 
-  const std::list<Http::LowerCaseString>& responseHeadersToRemove() const override {
+  const std::vector<Http::LowerCaseString>& responseHeadersToRemove() const override {
     return response_headers_to_remove_;
   }
 
   bool usesRuntime() const override { return route_matcher_->usesRuntime(); }
 
+  /**
+   * Check that the clusters that the routes refer to are known to the cluster manager. This is
+   * done on construction if the configuration asks for it, and again by each user of a shared
+   * configuration.
+   * @param cm supplies the cluster manager to check the clusters against.
+   * @throw EnvoyException if a cluster is unknown.
+   */
+  void validateClusters(Upstream::ClusterManager& cm) const {
+    route_matcher_->validateClusters(cm);
+  }
+
 private:
   std::unique_ptr<RouteMatcher> route_matcher_;
-  std::list<Http::LowerCaseString> internal_only_headers_;
-  std::list<std::pair<Http::LowerCaseString, std::string>> response_headers_to_add_;
-  std::list<Http::LowerCaseString> response_headers_to_remove_;
-  std::list<std::pair<Http::LowerCaseString, std::string>> request_headers_to_add_;
+  std::vector<Http::LowerCaseString> internal_only_headers_;
+  std::vector<std::pair<Http::LowerCaseString, std::string>> response_headers_to_add_;
+  std::vector<Http::LowerCaseString> response_headers_to_remove_;
+  std::vector<std::pair<Http::LowerCaseString, std::string>> request_headers_to_add_;
 };
 
 /**
@@ -524,25 +585,25 @@ public:
   // Router::Config
   RouteConstSharedPtr route(const Http::HeaderMap&, uint64_t) const override { return nullptr; }
 
-  const std::list<Http::LowerCaseString>& internalOnlyHeaders() const override {
+  const std::vector<Http::LowerCaseString>& internalOnlyHeaders() const override {
     return internal_only_headers_;
   }
 
-  const std::list<std::pair<Http::LowerCaseString, std::string>>&
+  const std::vector<std::pair<Http::LowerCaseString, std::string>>&
   responseHeadersToAdd() const override {
     return response_headers_to_add_;
   }
 
-  const std::list<Http::LowerCaseString>& responseHeadersToRemove() const override {
+  const std::vector<Http::LowerCaseString>& responseHeadersToRemove() const override {
     return response_headers_to_remove_;
   }
 
   bool usesRuntime() const override { return false; }
 
 private:
-  std::list<Http::LowerCaseString> internal_only_headers_;
-  std::list<std::pair<Http::LowerCaseString, std::string>> response_headers_to_add_;
-  std::list<Http::LowerCaseString> response_headers_to_remove_;
+  std::vector<Http::LowerCaseString> internal_only_headers_;
+  std::vector<std::pair<Http::LowerCaseString, std::string>> response_headers_to_add_;
+  std::vector<Http::LowerCaseString> response_headers_to_remove_;
 };
 
 } // namespace Router
@@ -1,13 +1,14 @@
 #pragma once
 
-#include <regex>
 #include <string>
 #include <vector>
 
+#include "envoy/common/regex.h"
 #include "envoy/json/json_object.h"
 #include "envoy/upstream/resource_manager.h"
 
 #include "common/common/empty_string.h"
+#include "common/common/regex.h"
 #include "common/config/rds_json.h"
 #include "common/http/headers.h"
 #include "common/protobuf/utility.h"
@@ -28,8 +29,11 @@ public:
     // exact string matching.
     HeaderData(const envoy::api::v2::HeaderMatcher& config)
         : name_(config.name()), value_(config.value()),
-          regex_pattern_(value_, std::regex::optimize),
-          is_regex_(PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, regex, false)) {}
+          is_regex_(PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, regex, false)) {
+      if (is_regex_) {
+        regex_ = Regex::Utility::parseRegex(value_);
+      }
+    }
     HeaderData(const Json::Object& config)
         : HeaderData([&config] {
             envoy::api::v2::HeaderMatcher header_matcher;
@@ -39,8 +43,9 @@ public:
 
     const Http::LowerCaseString name_;
     const std::string value_;
-    const std::regex regex_pattern_;
     const bool is_regex_;
+    // Only set if is_regex_.
+    Regex::CompiledMatcherPtr regex_;
   };
 
   /**
@@ -0,0 +1,101 @@
+#include "common/router/domain_match_trie.h"
+
+#include <algorithm>
+
+namespace Envoy {
+namespace Router {
+
+const uint32_t DomainMatchTrie::NO_MATCH;
+
+const DomainMatchTrie::Node* DomainMatchTrie::Node::findChild(char c) const {
+  auto it = std::lower_bound(children_.begin(), children_.end(), c,
+                             [](const NodePtr& child, char c) { return child->label_[0] < c; });
+  if (it != children_.end() && (*it)->label_[0] == c) {
+    return it->get();
+  }
+  return nullptr;
+}
+
+uint32_t DomainMatchTrie::find(const char* host, size_t length) const {
+  const Node* node = &root_;
+  // The number of characters at the end of the host that the walk has matched so far.
+  size_t matched = 0;
+  uint32_t wildcard_id = NO_MATCH;
+  while (true) {
+    // A wildcard must match at least one character, so *.foo.com doesn't match .foo.com.
+    if (node->wildcard_id_ != NO_MATCH && matched < length) {
+      wildcard_id = node->wildcard_id_;
+    }
+    if (matched == length) {
+      return node->domain_id_ != NO_MATCH ? node->domain_id_ : wildcard_id;
+    }
+
+    const size_t remaining = length - matched;
+    node = node->findChild(host[remaining - 1]);
+    if (node == nullptr || node->label_.size() > remaining) {
+      return wildcard_id;
+    }
+    for (size_t i = 1; i < node->label_.size(); i++) {
+      if (node->label_[i] != host[remaining - 1 - i]) {
+        return wildcard_id;
+      }
+    }
+    matched += node->label_.size();
+  }
+}
+
+void DomainMatchTrie::addChild(Node& parent, NodePtr&& child) {
+  const char c = child->label_[0];
+  auto it =
+      std::lower_bound(parent.children_.begin(), parent.children_.end(), c,
+                       [](const NodePtr& existing, char c) { return existing->label_[0] < c; });
+  parent.children_.insert(it, std::move(child));
+  node_count_++;
+}
+
+DomainMatchTrie::Node* DomainMatchTrie::insert(const std::string& key) {
+  const std::string reversed(key.rbegin(), key.rend());
+
+  Node* node = &root_;
+  size_t position = 0;
+  while (position < reversed.size()) {
+    Node* child = node->findChild(reversed[position]);
+    if (child == nullptr) {
+      NodePtr leaf(new Node());
+      leaf->label_ = reversed.substr(position);
+      Node* raw = leaf.get();
+      addChild(*node, std::move(leaf));
+      return raw;
+    }
+
+    // Find how much of the child's label is shared with the rest of the key.
+    size_t common = 0;
+    while (common < child->label_.size() && position + common < reversed.size() &&
+           child->label_[common] == reversed[position + common]) {
+      common++;
+    }
+
+    if (common < child->label_.size()) {
+      // Split the edge: the child keeps the unshared tail of its label below a new intermediate
+      // node which takes the shared head.
+      NodePtr split(new Node());
+      split->label_ = child->label_.substr(0, common);
+      auto it = std::find_if(node->children_.begin(), node->children_.end(),
+                             [child](const NodePtr& existing) { return existing.get() == child; });
+      NodePtr tail = std::move(*it);
+      tail->label_ = tail->label_.substr(common);
+      split->children_.push_back(std::move(tail));
+      *it = std::move(split);
+      node_count_++;
+      child = it->get();
+    }
+
+    node = child;
+    position += common;
+  }
+
+  return node;
+}
+
+} // namespace Router
+} // namespace Envoy
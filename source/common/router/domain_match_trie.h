@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/common/non_copyable.h"
+
+namespace Envoy {
+namespace Router {
+
+/**
+ * Radix tree over virtual host domains, keyed by the domains read back to front. Each domain is
+ * identified by the position of its virtual host. A lookup walks the host once from its last
+ * character and yields the exact domain equal to the host, or else the longest wildcard suffix
+ * of the host, without copying the host. Lookups are linear in the length of the host rather than
+ * in the number of domains or of distinct wildcard lengths.
+ */
+class DomainMatchTrie : NonCopyable {
+public:
+  static const uint32_t NO_MATCH = std::numeric_limits<uint32_t>::max();
+
+  /**
+   * Add a domain that matches a host equal to it.
+   * @return bool false if the domain was already added, in which case its id is kept.
+   */
+  bool addDomain(const std::string& domain, uint32_t id) {
+    Node* node = insert(domain);
+    if (node->domain_id_ != NO_MATCH) {
+      return false;
+    }
+    node->domain_id_ = id;
+    return true;
+  }
+
+  /**
+   * Add a wildcard domain, given without its leading '*', that matches any host that ends with
+   * suffix and is longer than it. The id of the first of several equal suffixes is kept.
+   */
+  void addWildcardSuffix(const std::string& suffix, uint32_t id) {
+    Node* node = insert(suffix);
+    if (node->wildcard_id_ == NO_MATCH) {
+      node->wildcard_id_ = id;
+    }
+  }
+
+  /**
+   * @param host supplies the host to match.
+   * @param length supplies the length of host.
+   * @return uint32_t the id of the domain equal to host, or else of the longest wildcard suffix
+   *         that host ends with, or else NO_MATCH.
+   */
+  uint32_t find(const char* host, size_t length) const;
+
+  /**
+   * @return bool whether no domain has been added.
+   */
+  bool empty() const { return root_.children_.empty() && root_.domain_id_ == NO_MATCH; }
+
+  /**
+   * @return uint32_t the number of nodes in the tree, including the root.
+   */
+  uint32_t nodeCount() const { return node_count_; }
+
+private:
+  struct Node;
+  typedef std::unique_ptr<Node> NodePtr;
+
+  struct Node {
+    const Node* findChild(char c) const;
+    Node* findChild(char c) {
+      return const_cast<Node*>(static_cast<const Node*>(this)->findChild(c));
+    }
+
+    // Edge label leading into this node, back to front. Empty only for the root.
+    std::string label_;
+    // Sorted by the first character of each child's label, which is unique among siblings.
+    std::vector<NodePtr> children_;
+    uint32_t domain_id_{NO_MATCH};
+    uint32_t wildcard_id_{NO_MATCH};
+  };
+
+  Node* insert(const std::string& key);
+  void addChild(Node& parent, NodePtr&& child);
+
+  Node root_;
+  uint32_t node_count_{1};
+};
+
+} // namespace Router
+} // namespace Envoy
@@ -0,0 +1,86 @@
+#include "common/router/path_match_trie.h"
+
+#include <algorithm>
+
+namespace Envoy {
+namespace Router {
+
+const PathMatchTrie::Node* PathMatchTrie::Node::findChild(char c) const {
+  auto it = std::lower_bound(children_.begin(), children_.end(), c,
+                             [](const NodePtr& child, char c) { return child->label_[0] < c; });
+  if (it != children_.end() && (*it)->label_[0] == c) {
+    return it->get();
+  }
+  return nullptr;
+}
+
+bool PathMatchTrie::labelMatches(const Node& node, const char* path, size_t remaining) const {
+  if (node.label_.size() > remaining) {
+    return false;
+  }
+  for (size_t i = 0; i < node.label_.size(); i++) {
+    if (fold(path[i]) != node.label_[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PathMatchTrie::addChild(Node& parent, NodePtr&& child) {
+  const char c = child->label_[0];
+  auto it =
+      std::lower_bound(parent.children_.begin(), parent.children_.end(), c,
+                       [](const NodePtr& existing, char c) { return existing->label_[0] < c; });
+  parent.children_.insert(it, std::move(child));
+  node_count_++;
+}
+
+PathMatchTrie::Node* PathMatchTrie::insert(const std::string& key) {
+  std::string folded(key);
+  for (char& c : folded) {
+    c = fold(c);
+  }
+
+  Node* node = &root_;
+  size_t position = 0;
+  while (position < folded.size()) {
+    Node* child = node->findChild(folded[position]);
+    if (child == nullptr) {
+      NodePtr leaf(new Node());
+      leaf->label_ = folded.substr(position);
+      Node* raw = leaf.get();
+      addChild(*node, std::move(leaf));
+      return raw;
+    }
+
+    // Find how much of the child's label is shared with the rest of the key.
+    size_t common = 0;
+    while (common < child->label_.size() && position + common < folded.size() &&
+           child->label_[common] == folded[position + common]) {
+      common++;
+    }
+
+    if (common < child->label_.size()) {
+      // Split the edge: the child keeps the unshared tail of its label below a new intermediate
+      // node which takes the shared head.
+      NodePtr split(new Node());
+      split->label_ = child->label_.substr(0, common);
+      auto it = std::find_if(node->children_.begin(), node->children_.end(),
+                             [child](const NodePtr& existing) { return existing.get() == child; });
+      NodePtr tail = std::move(*it);
+      tail->label_ = tail->label_.substr(common);
+      split->children_.push_back(std::move(tail));
+      *it = std::move(split);
+      node_count_++;
+      child = it->get();
+    }
+
+    node = child;
+    position += common;
+  }
+
+  return node;
+}
+
+} // namespace Router
+} // namespace Envoy
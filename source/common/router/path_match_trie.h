@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/common/non_copyable.h"
+
+namespace Envoy {
+namespace Router {
+
+/**
+ * Radix tree over route prefix and exact path matchers. Each matcher is identified by the
+ * position of its route in the virtual host, and a lookup yields the matchers that can possibly
+ * match a request path so that only those routes need to be evaluated. Lookups are linear in the
+ * length of the path rather than in the number of routes.
+ */
+class PathMatchTrie : NonCopyable {
+public:
+  PathMatchTrie(bool case_sensitive) : case_sensitive_(case_sensitive) {}
+
+  /**
+   * Add a matcher that matches any path that starts with prefix.
+   */
+  void addPrefix(const std::string& prefix, uint32_t id) {
+    insert(prefix)->prefix_ids_.push_back(id);
+  }
+
+  /**
+   * Add a matcher that matches a path (excluding the query string) that equals path.
+   */
+  void addPath(const std::string& path, uint32_t id) { insert(path)->path_ids_.push_back(id); }
+
+  /**
+   * Walk the trie along a path, invoking cb with each list of candidate ids. Every list is in
+   * insertion order, but lists are not ordered with respect to each other.
+   * @param path supplies the request path including any query string.
+   * @param path_length supplies the length of path.
+   * @param exact_length supplies the length of the path excluding any query string, which is the
+   *        portion that exact path matchers compare.
+   * @param cb supplies the callback, of the form void(const std::vector<uint32_t>&).
+   */
+  template <class Callback>
+  void forEachCandidate(const char* path, size_t path_length, size_t exact_length,
+                        Callback cb) const {
+    const Node* node = &root_;
+    size_t position = 0;
+    while (true) {
+      if (!node->prefix_ids_.empty()) {
+        cb(node->prefix_ids_);
+      }
+      if (position == exact_length && !node->path_ids_.empty()) {
+        cb(node->path_ids_);
+      }
+      if (position == path_length) {
+        return;
+      }
+
+      node = node->findChild(fold(path[position]));
+      if (node == nullptr || !labelMatches(*node, path + position, path_length - position)) {
+        return;
+      }
+      position += node->label_.size();
+    }
+  }
+
+  /**
+   * @return uint32_t the number of nodes in the tree, including the root.
+   */
+  uint32_t nodeCount() const { return node_count_; }
+
+private:
+  struct Node;
+  typedef std::unique_ptr<Node> NodePtr;
+
+  struct Node {
+    const Node* findChild(char c) const;
+    Node* findChild(char c) {
+      return const_cast<Node*>(static_cast<const Node*>(this)->findChild(c));
+    }
+
+    // Edge label leading into this node. Empty only for the root.
+    std::string label_;
+    // Sorted by the first character of each child's label, which is unique among siblings.
+    std::vector<NodePtr> children_;
+    std::vector<uint32_t> prefix_ids_;
+    std::vector<uint32_t> path_ids_;
+  };
+
+  char fold(char c) const {
+    return case_sensitive_ ? c : static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  }
+  bool labelMatches(const Node& node, const char* path, size_t remaining) const;
+  Node* insert(const std::string& key);
+  void addChild(Node& parent, NodePtr&& child);
+
+  const bool case_sensitive_;
+  Node root_;
+  uint32_t node_count_{1};
+};
+
+} // namespace Router
+} // namespace Envoy
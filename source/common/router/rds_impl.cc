@@ -1,9 +1,13 @@
 #include "common/router/rds_impl.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 #include "common/common/assert.h"
 #include "common/config/rds_json.h"
@@ -23,8 +27,8 @@ RouteConfigProviderSharedPtr RouteConfigProviderUtil::create(
     Init::Manager& init_manager, RouteConfigProviderManager& route_config_provider_manager) {
   switch (config.route_specifier_case()) {
   case envoy::api::v2::filter::HttpConnectionManager::kRouteConfig:
-    return RouteConfigProviderSharedPtr{
-        new StaticRouteConfigProviderImpl(config.route_config(), runtime, cm)};
+    return route_config_provider_manager.getStaticRouteConfigProvider(config.route_config(),
+                                                                      runtime, cm);
   case envoy::api::v2::filter::HttpConnectionManager::kRds:
     return route_config_provider_manager.getRouteConfigProvider(config.rds(), cm, scope,
                                                                 stat_prefix, init_manager);
@@ -33,10 +37,52 @@ RouteConfigProviderSharedPtr RouteConfigProviderUtil::create(
   }
 }
 
-StaticRouteConfigProviderImpl::StaticRouteConfigProviderImpl(
-    const envoy::api::v2::RouteConfiguration& config, Runtime::Loader& runtime,
-    Upstream::ClusterManager& cm)
-    : config_(new ConfigImpl(config, runtime, cm, true)) {}
+RouteConfigCompiler::RouteConfigCompiler(Event::Dispatcher& dispatcher)
+    : dispatcher_(dispatcher), thread_(new Thread::Thread([this]() -> void { threadRoutine(); })) {}
+
+RouteConfigCompiler::~RouteConfigCompiler() {
+  {
+    std::unique_lock<std::mutex> lock(queue_lock_);
+    shutdown_ = true;
+    queue_event_.notify_one();
+  }
+  thread_->join();
+}
+
+void RouteConfigCompiler::compile(RouteConfigurationSharedPtr config, Runtime::Loader& runtime,
+                                  Upstream::ClusterManager& cm, CompletionCb cb) {
+  std::unique_lock<std::mutex> lock(queue_lock_);
+  queue_.push_back({config, &runtime, &cm, cb});
+  queue_event_.notify_one();
+}
+
+void RouteConfigCompiler::threadRoutine() {
+  while (true) {
+    Compilation compilation;
+    {
+      std::unique_lock<std::mutex> lock(queue_lock_);
+      queue_event_.wait(lock, [this]() -> bool { return shutdown_ || !queue_.empty(); });
+      if (shutdown_) {
+        // Whatever is still queued is dropped, the providers are going away with the server.
+        return;
+      }
+      compilation = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    ConfigConstSharedPtr config;
+    std::string error;
+    try {
+      config.reset(new ConfigImpl(*compilation.config_, *compilation.runtime_, *compilation.cm_,
+                                  false));
+    } catch (const EnvoyException& e) {
+      error = e.what();
+    }
+
+    CompletionCb cb = std::move(compilation.cb_);
+    dispatcher_.post([cb, config, error]() -> void { cb(config, error); });
+  }
+}
 
 // TODO(htuch): If support for multiple clusters is added per #1170 cluster_name_
 // initialization needs to be fixed.
@@ -46,16 +92,12 @@ RdsRouteConfigProviderImpl::RdsRouteConfigProviderImpl(
     Runtime::RandomGenerator& random, const LocalInfo::LocalInfo& local_info, Stats::Scope& scope,
     const std::string& stat_prefix, ThreadLocal::SlotAllocator& tls,
     RouteConfigProviderManagerImpl& route_config_provider_manager)
-    : runtime_(runtime), cm_(cm), tls_(tls.allocateSlot()),
+    : runtime_(runtime), cm_(cm), tls_(tls, std::make_shared<NullConfigImpl>()),
       route_config_name_(rds.route_config_name()), scope_(scope.createScope(stat_prefix + "rds.")),
       stats_({ALL_RDS_STATS(POOL_COUNTER(*scope_))}),
       route_config_provider_manager_(route_config_provider_manager),
       manager_identifier_(manager_identifier) {
   ::Envoy::Config::Utility::checkLocalInfo("rds", local_info);
-  ConfigConstSharedPtr initial_config(new NullConfigImpl());
-  tls_->set([initial_config](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
-    return std::make_shared<ThreadLocalConfig>(initial_config);
-  });
   subscription_ = Envoy::Config::SubscriptionFactory::subscriptionFromConfigSource<
       envoy::api::v2::RouteConfiguration>(
       rds.config_source(), local_info.node(), dispatcher, cm, random, *scope_,
@@ -89,7 +131,7 @@ RdsRouteConfigProviderImpl::~RdsRouteConfigProviderImpl() {
 }
 
 Router::ConfigConstSharedPtr RdsRouteConfigProviderImpl::config() {
-  return tls_->getTyped<ThreadLocalConfig>().config_;
+  return tls_.getShared();
 }
 
 void RdsRouteConfigProviderImpl::onConfigUpdate(const ResourceVector& resources) {
@@ -109,20 +151,77 @@ void RdsRouteConfigProviderImpl::onConfigUpdate(const ResourceVector& resources)
                                      route_config_name_, route_config.name()));
   }
   const uint64_t new_hash = MessageUtil::hash(route_config);
-  if (new_hash != last_config_hash_ || !initialized_) {
-    ConfigConstSharedPtr new_config(new ConfigImpl(route_config, runtime_, cm_, false));
-    initialized_ = true;
-    last_config_hash_ = new_hash;
-    stats_.config_reload_.inc();
-    ENVOY_LOG(debug, "rds: loading new configuration: config_name={} hash={}", route_config_name_,
-              new_hash);
-    tls_->runOnAllThreads(
-        [this, new_config]() -> void { tls_->getTyped<ThreadLocalConfig>().config_ = new_config; });
-    route_config_proto_ = route_config;
+  if (pending_config_hash_.valid() && pending_config_hash_.value() == new_hash) {
+    // The same configuration is already being compiled, and initialization finishes with it.
+    return;
   }
+  if (initialized_ && new_hash == last_config_hash_) {
+    // A newer configuration that is still being compiled is superseded by this one.
+    pending_config_hash_ = Optional<uint64_t>();
+    runInitializeCallbackIfAny();
+    return;
+  }
+
+  if (compileInBackground(route_config)) {
+    pending_config_hash_.value(new_hash);
+    std::weak_ptr<RdsRouteConfigProviderImpl> weak_this = shared_from_this();
+    auto config_proto = std::make_shared<const envoy::api::v2::RouteConfiguration>(route_config);
+    route_config_provider_manager_.compiler().compile(
+        config_proto, runtime_, cm_,
+        [weak_this, new_hash, config_proto](ConfigConstSharedPtr config,
+                                            const std::string& error) -> void {
+          std::shared_ptr<RdsRouteConfigProviderImpl> provider = weak_this.lock();
+          if (provider) {
+            provider->onConfigCompiled(new_hash, *config_proto, config, error);
+          }
+        });
+    return;
+  }
+
+  pending_config_hash_ = Optional<uint64_t>();
+  ConfigConstSharedPtr new_config(new ConfigImpl(route_config, runtime_, cm_, false));
+  publishConfig(new_hash, route_config, new_config);
   runInitializeCallbackIfAny();
 }
 
+bool RdsRouteConfigProviderImpl::compileInBackground(
+    const envoy::api::v2::RouteConfiguration& route_config) {
+  // Validating clusters needs the cluster manager, which can only be used on the main thread.
+  return runtime_.snapshot().getInteger("rds.compile_in_background", 0) != 0 &&
+         !PROTOBUF_GET_WRAPPED_OR_DEFAULT(route_config, validate_clusters, false);
+}
+
+void RdsRouteConfigProviderImpl::onConfigCompiled(
+    uint64_t hash, const envoy::api::v2::RouteConfiguration& route_config,
+    ConfigConstSharedPtr config, const std::string& error) {
+  if (!pending_config_hash_.valid() || pending_config_hash_.value() != hash) {
+    // A later update has superseded this configuration in the meantime.
+    return;
+  }
+  pending_config_hash_ = Optional<uint64_t>();
+
+  if (config) {
+    publishConfig(hash, route_config, config);
+  } else {
+    ENVOY_LOG(warn, "rds: rejecting configuration: config_name={} hash={}: {}",
+              route_config_name_, hash, error);
+    stats_.update_rejected_.inc();
+  }
+  runInitializeCallbackIfAny();
+}
+
+void RdsRouteConfigProviderImpl::publishConfig(
+    uint64_t hash, const envoy::api::v2::RouteConfiguration& route_config,
+    ConfigConstSharedPtr config) {
+  initialized_ = true;
+  last_config_hash_ = hash;
+  stats_.config_reload_.inc();
+  ENVOY_LOG(debug, "rds: loading new configuration: config_name={} hash={}", route_config_name_,
+            hash);
+  tls_.publish(config);
+  route_config_proto_ = route_config;
+}
+
 void RdsRouteConfigProviderImpl::onConfigUpdateFailed(const EnvoyException*) {
   // We need to allow server startup to continue, even if we have a bad
   // config.
@@ -153,6 +252,13 @@ RouteConfigProviderManagerImpl::~RouteConfigProviderManagerImpl() {
   admin_.removeHandler("/routes");
 }
 
+RouteConfigCompiler& RouteConfigProviderManagerImpl::compiler() {
+  if (!compiler_) {
+    compiler_.reset(new RouteConfigCompiler(dispatcher_));
+  }
+  return *compiler_;
+}
+
 std::vector<RdsRouteConfigProviderSharedPtr>
 RouteConfigProviderManagerImpl::rdsRouteConfigProviders() {
   std::vector<RdsRouteConfigProviderSharedPtr> ret;
@@ -201,6 +307,89 @@ Router::RouteConfigProviderSharedPtr RouteConfigProviderManagerImpl::getRouteCon
   return new_provider;
 };
 
+Router::RouteConfigProviderSharedPtr RouteConfigProviderManagerImpl::getStaticRouteConfigProvider(
+    const envoy::api::v2::RouteConfiguration& route_config, Runtime::Loader& runtime,
+    Upstream::ClusterManager& cm) {
+  // All of the configurations are compiled against the runtime of the server, so the hash of the
+  // proto configuration identifies a compiled configuration.
+  const uint64_t hash = MessageUtil::hash(route_config);
+  auto it = static_route_configs_.find(hash);
+  if (it != static_route_configs_.end()) {
+    ConfigConstSharedPtr config = it->second.lock();
+    if (config) {
+      // The clusters may have changed since the configuration was compiled.
+      if (PROTOBUF_GET_WRAPPED_OR_DEFAULT(route_config, validate_clusters, true)) {
+        static_cast<const ConfigImpl&>(*config).validateClusters(cm);
+      }
+      return std::make_shared<StaticRouteConfigProviderImpl>(config);
+    }
+  }
+
+  ConfigConstSharedPtr config(new ConfigImpl(route_config, runtime, cm, true));
+  cacheStaticRouteConfig(hash, config);
+  return std::make_shared<StaticRouteConfigProviderImpl>(config);
+}
+
+std::vector<ConfigConstSharedPtr> RouteConfigProviderManagerImpl::precompileStaticRouteConfigs(
+    const std::vector<envoy::api::v2::RouteConfiguration>& route_configs, Runtime::Loader& runtime,
+    Upstream::ClusterManager& cm, uint32_t concurrency) {
+  // Identical configurations, and the ones that are already compiled, are compiled only once.
+  std::unordered_set<uint64_t> seen;
+  std::vector<uint64_t> hashes;
+  std::vector<const envoy::api::v2::RouteConfiguration*> to_compile;
+  for (const auto& route_config : route_configs) {
+    const uint64_t hash = MessageUtil::hash(route_config);
+    auto it = static_route_configs_.find(hash);
+    if (seen.insert(hash).second && (it == static_route_configs_.end() || it->second.expired())) {
+      hashes.push_back(hash);
+      to_compile.push_back(&route_config);
+    }
+  }
+
+  // ConfigImpl only uses the cluster manager to validate clusters, so the configurations can be
+  // compiled off the main thread as in RouteConfigCompiler. Each thread takes the next
+  // configuration that no other thread has taken yet.
+  std::vector<ConfigConstSharedPtr> configs(to_compile.size());
+  std::atomic<size_t> next{0};
+  std::vector<Thread::ThreadPtr> threads;
+  const size_t thread_count = std::min<size_t>(std::max<uint32_t>(concurrency, 1), configs.size());
+  for (size_t i = 0; i < thread_count; i++) {
+    threads.emplace_back(new Thread::Thread([&]() -> void {
+      for (size_t index = next++; index < configs.size(); index = next++) {
+        try {
+          configs[index].reset(new ConfigImpl(*to_compile[index], runtime, cm, false));
+        } catch (const EnvoyException&) {
+        }
+      }
+    }));
+  }
+  for (Thread::ThreadPtr& thread : threads) {
+    thread->join();
+  }
+
+  std::vector<ConfigConstSharedPtr> compiled;
+  for (size_t i = 0; i < configs.size(); i++) {
+    if (configs[i]) {
+      cacheStaticRouteConfig(hashes[i], configs[i]);
+      compiled.push_back(configs[i]);
+    }
+  }
+  return compiled;
+}
+
+void RouteConfigProviderManagerImpl::cacheStaticRouteConfig(uint64_t hash,
+                                                            ConfigConstSharedPtr config) {
+  // Drop the entries of configurations that are no longer used by any provider.
+  for (auto entry = static_route_configs_.begin(); entry != static_route_configs_.end();) {
+    if (entry->second.expired()) {
+      entry = static_route_configs_.erase(entry);
+    } else {
+      ++entry;
+    }
+  }
+  static_route_configs_[hash] = config;
+}
+
 void RouteConfigProviderManagerImpl::addRouteInfo(const RdsRouteConfigProvider& provider,
                                                   Buffer::Instance& response) {
   // TODO(junr03): change this to proto with JSON transcoding when #1522 is done.
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <condition_variable>
 #include <cstdint>
 #include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "envoy/common/optional.h"
 #include "envoy/config/subscription.h"
+#include "envoy/event/dispatcher.h"
 #include "envoy/http/codes.h"
 #include "envoy/init/init.h"
 #include "envoy/local_info/local_info.h"
@@ -16,7 +23,9 @@
 #include "envoy/thread_local/thread_local.h"
 
 #include "common/common/logger.h"
+#include "common/common/thread.h"
 #include "common/protobuf/utility.h"
+#include "common/thread_local/rcu_slot.h"
 
 #include "api/filter/http_connection_manager.pb.h"
 #include "api/rds.pb.h"
@@ -44,8 +53,7 @@ public:
  */
 class StaticRouteConfigProviderImpl : public RouteConfigProvider {
 public:
-  StaticRouteConfigProviderImpl(const envoy::api::v2::RouteConfiguration& config,
-                                Runtime::Loader& runtime, Upstream::ClusterManager& cm);
+  StaticRouteConfigProviderImpl(ConfigConstSharedPtr config) : config_(config) {}
 
   // Router::RouteConfigProvider
   Router::ConfigConstSharedPtr config() override { return config_; }
@@ -61,7 +69,8 @@ private:
 // clang-format off
 #define ALL_RDS_STATS(COUNTER)                                                                     \
   COUNTER(config_reload)                                                                           \
-  COUNTER(update_empty)
+  COUNTER(update_empty)                                                                            \
+  COUNTER(update_rejected)
 
 // clang-format on
 
@@ -74,6 +83,54 @@ struct RdsStats {
 
 class RouteConfigProviderManagerImpl;
 
+/**
+ * Compiles route configurations on a thread of its own, so that large route tables do not stall
+ * the main thread. Configurations are compiled in the order in which they are queued, and each
+ * result is posted back to the dispatcher of the main thread.
+ */
+class RouteConfigCompiler {
+public:
+  typedef std::shared_ptr<const envoy::api::v2::RouteConfiguration> RouteConfigurationSharedPtr;
+
+  /**
+   * Called on the main thread once a configuration is compiled.
+   * @param config supplies the compiled configuration, or nullptr if it is invalid.
+   * @param error supplies why the configuration is invalid.
+   */
+  typedef std::function<void(ConfigConstSharedPtr config, const std::string& error)> CompletionCb;
+
+  RouteConfigCompiler(Event::Dispatcher& dispatcher);
+  ~RouteConfigCompiler();
+
+  /**
+   * Queue a configuration to compile. It must not validate its clusters, since the cluster
+   * manager can only be used on the main thread.
+   * @param config supplies the configuration to compile.
+   * @param runtime supplies the runtime that the configuration refers to.
+   * @param cm supplies the cluster manager that the configuration refers to.
+   * @param cb supplies the callback to post once the configuration is compiled.
+   */
+  void compile(RouteConfigurationSharedPtr config, Runtime::Loader& runtime,
+               Upstream::ClusterManager& cm, CompletionCb cb);
+
+private:
+  struct Compilation {
+    RouteConfigurationSharedPtr config_;
+    Runtime::Loader* runtime_;
+    Upstream::ClusterManager* cm_;
+    CompletionCb cb_;
+  };
+
+  void threadRoutine();
+
+  Event::Dispatcher& dispatcher_;
+  std::list<Compilation> queue_;
+  std::mutex queue_lock_;
+  std::condition_variable queue_event_;
+  bool shutdown_{};
+  Thread::ThreadPtr thread_;
+};
+
 /**
  * Implementation of RdsRouteConfigProvider that fetches the route configuration dynamically using
  * the RDS API.
@@ -82,6 +139,7 @@ class RdsRouteConfigProviderImpl
     : public RdsRouteConfigProvider,
       public Init::Target,
       Envoy::Config::SubscriptionCallbacks<envoy::api::v2::RouteConfiguration>,
+      public std::enable_shared_from_this<RdsRouteConfigProviderImpl>,
       Logger::Loggable<Logger::Id::router> {
 public:
   ~RdsRouteConfigProviderImpl();
@@ -108,12 +166,6 @@ public:
   void onConfigUpdateFailed(const EnvoyException* e) override;
 
 private:
-  struct ThreadLocalConfig : public ThreadLocal::ThreadLocalObject {
-    ThreadLocalConfig(ConfigConstSharedPtr initial_config) : config_(initial_config) {}
-
-    ConfigConstSharedPtr config_;
-  };
-
   RdsRouteConfigProviderImpl(const envoy::api::v2::filter::Rds& rds,
                              const std::string& manager_identifier, Runtime::Loader& runtime,
                              Upstream::ClusterManager& cm, Event::Dispatcher& dispatcher,
@@ -124,15 +176,22 @@ private:
 
   void registerInitTarget(Init::Manager& init_manager);
   void runInitializeCallbackIfAny();
+  bool compileInBackground(const envoy::api::v2::RouteConfiguration& route_config);
+  void onConfigCompiled(uint64_t hash, const envoy::api::v2::RouteConfiguration& route_config,
+                        ConfigConstSharedPtr config, const std::string& error);
+  void publishConfig(uint64_t hash, const envoy::api::v2::RouteConfiguration& route_config,
+                     ConfigConstSharedPtr config);
 
   Runtime::Loader& runtime_;
   Upstream::ClusterManager& cm_;
   std::unique_ptr<Envoy::Config::Subscription<envoy::api::v2::RouteConfiguration>> subscription_;
-  ThreadLocal::SlotPtr tls_;
+  ThreadLocal::RcuSlot<Config> tls_;
   std::string cluster_name_;
   const std::string route_config_name_;
   bool initialized_{};
   uint64_t last_config_hash_{};
+  // The hash of the configuration that is compiled in the background, if any.
+  Optional<uint64_t> pending_config_hash_;
   Stats::ScopePtr scope_;
   RdsStats stats_;
   std::function<void()> initialize_callback_;
@@ -160,6 +219,26 @@ public:
                                                       Stats::Scope& scope,
                                                       const std::string& stat_prefix,
                                                       Init::Manager& init_manager) override;
+  RouteConfigProviderSharedPtr
+  getStaticRouteConfigProvider(const envoy::api::v2::RouteConfiguration& route_config,
+                               Runtime::Loader& runtime, Upstream::ClusterManager& cm) override;
+
+  /**
+   * Compile static route configurations on several threads at once, ahead of the
+   * getStaticRouteConfigProvider() calls that use them. Clusters are not validated here, that is
+   * left to getStaticRouteConfigProvider() on the main thread. A configuration that fails to
+   * compile is skipped, and fails again with its error once its provider is created.
+   * @param route_configs supplies the configurations to compile.
+   * @param runtime supplies the runtime that the configurations refer to.
+   * @param cm supplies the cluster manager that the configurations refer to.
+   * @param concurrency supplies the maximum number of threads to compile on.
+   * @return std::vector<ConfigConstSharedPtr> the compiled configurations, which are only found by
+   *         getStaticRouteConfigProvider() for as long as they are kept.
+   */
+  std::vector<ConfigConstSharedPtr>
+  precompileStaticRouteConfigs(const std::vector<envoy::api::v2::RouteConfiguration>& route_configs,
+                               Runtime::Loader& runtime, Upstream::ClusterManager& cm,
+                               uint32_t concurrency);
 
 private:
   /**
@@ -179,14 +258,25 @@ private:
    */
   Http::Code handlerRoutes(const std::string& url, Buffer::Instance& response);
 
+  /**
+   * @return RouteConfigCompiler& the compiler shared by all of the providers, whose thread is
+   *         started the first time that it is used.
+   */
+  RouteConfigCompiler& compiler();
+
+  void cacheStaticRouteConfig(uint64_t hash, ConfigConstSharedPtr config);
+
   std::unordered_map<std::string, std::weak_ptr<RdsRouteConfigProviderImpl>>
       route_config_providers_;
+  // Compiled static route configurations by the hash of their proto configuration.
+  std::unordered_map<uint64_t, std::weak_ptr<const Config>> static_route_configs_;
   Runtime::Loader& runtime_;
   Event::Dispatcher& dispatcher_;
   Runtime::RandomGenerator& random_;
   const LocalInfo::LocalInfo& local_info_;
   ThreadLocal::SlotAllocator& tls_;
   Server::Admin& admin_;
+  std::unique_ptr<RouteConfigCompiler> compiler_;
 
   friend class RdsRouteConfigProviderImpl;
 };
@@ -43,8 +43,7 @@ void RdsSubscription::createRequest(Http::Message& request) {
 
 void RdsSubscription::parseResponse(const Http::Message& response) {
   ENVOY_LOG(debug, "rds: parsing response");
-  const std::string response_body = response.bodyAsString();
-  Json::ObjectSharedPtr response_json = Json::Factory::loadFromString(response_body);
+  Json::ObjectSharedPtr response_json = parseJsonBody(response);
   Protobuf::RepeatedPtrField<envoy::api::v2::RouteConfiguration> resources;
   Envoy::Config::RdsJson::translateRouteConfiguration(*response_json, *resources.Add());
   resources[0].set_name(route_config_name_);
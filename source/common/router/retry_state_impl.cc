@@ -157,6 +157,11 @@ RetryStatus RetryStateImpl::shouldRetry(const Http::HeaderMap* response_headers,
     return RetryStatus::NoOverflow;
   }
 
+  if (!cluster_.resourceManager(priority_).retryBudget().canCreate()) {
+    cluster_.stats().upstream_rq_retry_budget_exhausted_.inc();
+    return RetryStatus::NoOverflow;
+  }
+
   ASSERT(!callback_);
   callback_ = callback;
   cluster_.resourceManager(priority_).retries().inc();
@@ -1,5 +1,6 @@
 #include "common/router/router.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <string>
@@ -19,7 +20,6 @@
 #include "common/http/codes.h"
 #include "common/http/header_map_impl.h"
 #include "common/http/headers.h"
-#include "common/http/message_impl.h"
 #include "common/http/utility.h"
 #include "common/router/config_impl.h"
 #include "common/router/retry_state_impl.h"
@@ -82,6 +82,19 @@ FilterUtility::TimeoutData FilterUtility::finalTimeout(const RouteEntry& route,
     timeout.per_try_timeout_ = std::chrono::milliseconds(0);
   }
 
+  // See if the request should be hedged. If the delay is >= global we just ignore it.
+  Http::HeaderEntry* hedge_delay_entry = request_headers.EnvoyUpstreamRequestHedgeDelayMs();
+  if (hedge_delay_entry) {
+    if (StringUtil::atoul(hedge_delay_entry->value().c_str(), header_timeout)) {
+      timeout.hedge_delay_ = std::chrono::milliseconds(header_timeout);
+    }
+    request_headers.removeEnvoyUpstreamRequestHedgeDelayMs();
+  }
+
+  if (timeout.global_timeout_.count() > 0 && timeout.hedge_delay_ >= timeout.global_timeout_) {
+    timeout.hedge_delay_ = std::chrono::milliseconds(0);
+  }
+
   // See if there is any timeout to write in the expected timeout header.
   uint64_t expected_timeout = timeout.per_try_timeout_.count();
   if (expected_timeout == 0) {
@@ -98,6 +111,7 @@ FilterUtility::TimeoutData FilterUtility::finalTimeout(const RouteEntry& route,
 Filter::~Filter() {
   // Upstream resources should already have been cleaned.
   ASSERT(!upstream_request_);
+  ASSERT(!hedge_request_);
   ASSERT(!retry_state_);
 }
 
@@ -129,7 +143,8 @@ void Filter::chargeUpstreamCode(const Http::HeaderMap& response_headers,
                                                                : EMPTY_STRING,
                                              zone_name,
                                              upstreamZone(upstream_host),
-                                             is_canary};
+                                             is_canary,
+                                             &cluster_->codeStats()};
 
     Http::CodeUtility::chargeResponseStat(info);
 
@@ -143,7 +158,8 @@ void Filter::chargeUpstreamCode(const Http::HeaderMap& response_headers,
                                                EMPTY_STRING,
                                                zone_name,
                                                upstreamZone(upstream_host),
-                                               is_canary};
+                                               is_canary,
+                                               nullptr};
 
       Http::CodeUtility::chargeResponseStat(info);
     }
@@ -187,7 +203,10 @@ Http::FilterHeadersStatus Filter::decodeHeaders(Http::HeaderMap& headers, bool e
 
   // A route entry matches for the request.
   route_entry_ = route_->routeEntry();
-  Upstream::ThreadLocalCluster* cluster = config_.cm_.get(route_entry_->clusterName());
+  const Upstream::ClusterHandle* cluster_handle = route_entry_->clusterHandle();
+  Upstream::ThreadLocalCluster* cluster = cluster_handle
+                                              ? config_.cm_.getByHandle(*cluster_handle)
+                                              : config_.cm_.get(route_entry_->clusterName());
   if (!cluster) {
     config_.stats_.no_cluster_.inc();
     ENVOY_STREAM_LOG(debug, "unknown cluster '{}'", *callbacks_, route_entry_->clusterName());
@@ -200,6 +219,15 @@ Http::FilterHeadersStatus Filter::decodeHeaders(Http::HeaderMap& headers, bool e
   }
   cluster_ = cluster->info();
 
+  // A route can bound the buffering of its requests below or above the limit of the connection.
+  // The limit applies to the buffers of all of the filters of the stream, and to the upstream
+  // request, which is created below.
+  const Optional<uint32_t> buffer_limit = route_entry_->perRequestBufferLimit();
+  if (buffer_limit.valid()) {
+    callbacks_->setDecoderBufferLimit(buffer_limit.value());
+    setBufferLimit(buffer_limit.value());
+  }
+
   // Set up stat prefixes, etc.
   request_vcluster_ = route_entry_->virtualCluster(headers);
   ENVOY_STREAM_LOG(debug, "cluster '{}' match for URL '{}'", *callbacks_,
@@ -207,7 +235,7 @@ Http::FilterHeadersStatus Filter::decodeHeaders(Http::HeaderMap& headers, bool e
 
   const Http::HeaderEntry* request_alt_name = headers.EnvoyUpstreamAltStatName();
   if (request_alt_name) {
-    alt_stat_prefix_ = std::string(request_alt_name->value().c_str()) + ".";
+    alt_stat_prefix_ = config_.alt_stat_names_.admit(request_alt_name->value().c_str()) + ".";
     headers.removeEnvoyUpstreamAltStatName();
   }
 
@@ -261,6 +289,12 @@ Http::FilterHeadersStatus Filter::decodeHeaders(Http::HeaderMap& headers, bool e
   ASSERT(headers.Host());
   ASSERT(headers.Path());
 
+  // The shadow request is streamed along with the request rather than sent once it is complete.
+  if (do_shadowing_) {
+    shadow_stream_ = config_.shadowWriter().streamShadow(
+        route_entry_->shadowPolicy().cluster(), headers, end_stream, timeout_.global_timeout_);
+  }
+
   upstream_request_.reset(new UpstreamRequest(*this, *conn_pool));
   upstream_request_->encodeHeaders(end_stream);
   if (end_stream) {
@@ -271,6 +305,10 @@ Http::FilterHeadersStatus Filter::decodeHeaders(Http::HeaderMap& headers, bool e
 }
 
 Http::ConnectionPool::Instance* Filter::getConnPool() {
+  const Upstream::ClusterHandle* cluster_handle = route_entry_->clusterHandle();
+  if (cluster_handle) {
+    return config_.cm_.httpConnPoolForHandle(*cluster_handle, route_entry_->priority(), this);
+  }
   return config_.cm_.httpConnPoolForCluster(route_entry_->clusterName(), route_entry_->priority(),
                                             this);
 }
@@ -283,17 +321,29 @@ void Filter::sendNoHealthyUpstreamResponse() {
 }
 
 Http::FilterDataStatus Filter::decodeData(Buffer::Instance& data, bool end_stream) {
-  bool buffering = (retry_state_ && retry_state_->enabled()) || do_shadowing_;
-  if (buffering && buffer_limit_ > 0 &&
-      getLength(callbacks_->decodingBuffer()) + data.length() > buffer_limit_) {
-    // The request is larger than we should buffer.  Give up on the retry/shadow
+  // The shadow request shares the slabs of the data, so this must happen before the data is moved
+  // upstream.
+  if (shadow_stream_) {
+    if (!shadow_stream_->sendData(data, end_stream)) {
+      // Too many shadowed bytes are in flight. Give up on the shadow.
+      cluster_->stats().retry_or_shadow_abandoned_.inc();
+      shadow_stream_.reset();
+    } else if (end_stream) {
+      shadow_stream_.reset();
+    }
+  }
+
+  bool buffering = (retry_state_ && retry_state_->enabled()) || timeout_.hedge_delay_.count() > 0;
+  if (buffering && retry_buffer_limit_ > 0 &&
+      getLength(callbacks_->decodingBuffer()) + data.length() > retry_buffer_limit_) {
+    // The request is larger than we should buffer.  Give up on the retry/hedge
     cluster_->stats().retry_or_shadow_abandoned_.inc();
     retry_state_.reset();
     buffering = false;
-    do_shadowing_ = false;
+    timeout_.hedge_delay_ = std::chrono::milliseconds(0);
   }
 
-  // If we are going to buffer for retries or shadowing, we need to make a copy before encoding
+  // If we are going to buffer for retries or hedging, we need to make a copy before encoding
   // since it's all moves from here on.
   if (buffering) {
     Buffer::OwnedImpl copy(data);
@@ -306,7 +356,7 @@ Http::FilterDataStatus Filter::decodeData(Buffer::Instance& data, bool end_strea
     onRequestComplete();
   }
 
-  // If we are potentially going to retry or shadow this request we need to buffer.
+  // If we are potentially going to retry or hedge this request we need to buffer.
   // This will not cause the connection manager to 413 because before we hit the
   // buffer limit we give up on retries and buffering.
   return buffering ? Http::FilterDataStatus::StopIterationAndBuffer
@@ -315,6 +365,10 @@ Http::FilterDataStatus Filter::decodeData(Buffer::Instance& data, bool end_strea
 
 Http::FilterTrailersStatus Filter::decodeTrailers(Http::HeaderMap& trailers) {
   downstream_trailers_ = &trailers;
+  if (shadow_stream_) {
+    shadow_stream_->sendTrailers(trailers);
+    shadow_stream_.reset();
+  }
   upstream_request_->encodeTrailers(trailers);
   onRequestComplete();
   return Http::FilterTrailersStatus::StopIteration;
@@ -325,37 +379,35 @@ void Filter::setDecoderFilterCallbacks(Http::StreamDecoderFilterCallbacks& callb
   // As the decoder filter only pushes back via watermarks once data has reached
   // it, it can latch the current buffer limit and does not need to update the
   // limit if another filter increases it.
-  buffer_limit_ = callbacks_->decoderBufferLimit();
+  setBufferLimit(callbacks_->decoderBufferLimit());
+}
+
+void Filter::setBufferLimit(uint32_t limit) {
+  buffer_limit_ = limit;
+
+  // The body is always streamed upstream as it arrives. What is kept for replay can be bounded
+  // below the decoder buffer limit, in which case larger requests are not retried.
+  retry_buffer_limit_ = buffer_limit_;
+  if (config_.retry_buffer_limit_ > 0 &&
+      (buffer_limit_ == 0 || config_.retry_buffer_limit_ < buffer_limit_)) {
+    retry_buffer_limit_ = config_.retry_buffer_limit_;
+  }
 }
 
 void Filter::cleanup() {
   upstream_request_.reset();
+  hedge_request_.reset();
   retry_state_.reset();
+  if (hedge_timer_) {
+    hedge_timer_->disableTimer();
+    hedge_timer_.reset();
+  }
   if (response_timeout_) {
     response_timeout_->disableTimer();
     response_timeout_.reset();
   }
 }
 
-void Filter::maybeDoShadowing() {
-  if (!do_shadowing_) {
-    return;
-  }
-
-  ASSERT(!route_entry_->shadowPolicy().cluster().empty());
-  Http::MessagePtr request(new Http::RequestMessageImpl(
-      Http::HeaderMapPtr{new Http::HeaderMapImpl(*downstream_headers_)}));
-  if (callbacks_->decodingBuffer()) {
-    request->body().reset(new Buffer::OwnedImpl(*callbacks_->decodingBuffer()));
-  }
-  if (downstream_trailers_) {
-    request->trailers(Http::HeaderMapPtr{new Http::HeaderMapImpl(*downstream_trailers_)});
-  }
-
-  config_.shadowWriter().shadow(route_entry_->shadowPolicy().cluster(), std::move(request),
-                                timeout_.global_timeout_);
-}
-
 void Filter::onRequestComplete() {
   downstream_end_stream_ = true;
   downstream_request_complete_time_ = std::chrono::steady_clock::now();
@@ -363,16 +415,17 @@ void Filter::onRequestComplete() {
 
   // Possible that we got an immediate reset.
   if (upstream_request_) {
-    // Even if we got an immediate reset, we could still shadow, but that is a riskier change and
-    // seems unnecessary right now.
-    maybeDoShadowing();
-
     upstream_request_->setupPerTryTimeout();
     if (timeout_.global_timeout_.count() > 0) {
-      response_timeout_ =
-          callbacks_->dispatcher().createTimer([this]() -> void { onResponseTimeout(); });
+      response_timeout_ = callbacks_->dispatcher().createTimer(
+          [this]() -> void { onResponseTimeout(); }, Event::TimerPrecision::Coarse);
       response_timeout_->enableTimer(timeout_.global_timeout_);
     }
+
+    if (timeout_.hedge_delay_.count() > 0) {
+      hedge_timer_ = callbacks_->dispatcher().createTimer([this]() -> void { onHedgeTimeout(); });
+      hedge_timer_->enableTimer(timeout_.hedge_delay_);
+    }
   }
 }
 
@@ -380,6 +433,11 @@ void Filter::onDestroy() {
   if (upstream_request_) {
     upstream_request_->resetStream();
   }
+  if (hedge_request_) {
+    hedge_request_->resetStream();
+  }
+  // This resets the shadow request if the request did not complete.
+  shadow_stream_.reset();
   stream_destroyed_ = true;
   cleanup();
 }
@@ -396,10 +454,90 @@ void Filter::onResponseTimeout() {
     }
     upstream_request_->resetStream();
   }
+  if (hedge_request_) {
+    hedge_request_->resetStream();
+  }
 
   onUpstreamReset(UpstreamResetType::GlobalTimeout, Optional<Http::StreamResetReason>());
 }
 
+void Filter::onHedgeTimeout() {
+  // The request may have been reset or answered in the meantime.
+  if (!upstream_request_ || hedge_request_ || downstream_response_started_) {
+    return;
+  }
+
+  // The load balancer picks the host again, which usually is not the one that is being slow.
+  Http::ConnectionPool::Instance* conn_pool = getConnPool();
+  if (!conn_pool) {
+    return;
+  }
+
+  ENVOY_STREAM_LOG(debug, "hedging request", *callbacks_);
+  cluster_->stats().upstream_rq_hedge_.inc();
+  hedge_request_.reset(new UpstreamRequest(*this, *conn_pool));
+  hedge_request_->encodeHeaders(!callbacks_->decodingBuffer() && !downstream_trailers_);
+  // It's possible we got immediately reset.
+  if (hedge_request_) {
+    if (callbacks_->decodingBuffer()) {
+      Buffer::OwnedImpl copy(*callbacks_->decodingBuffer());
+      hedge_request_->encodeData(copy, !downstream_trailers_);
+    }
+
+    if (downstream_trailers_) {
+      hedge_request_->encodeTrailers(*downstream_trailers_);
+    }
+
+    hedge_request_->setupPerTryTimeout();
+  }
+}
+
+void Filter::onUpstreamRequestHeaders(UpstreamRequest& upstream_request) {
+  // The first request to get response headers is used, and the other one is reset.
+  if (hedge_timer_) {
+    hedge_timer_->disableTimer();
+    hedge_timer_.reset();
+  }
+
+  if (!hedge_request_) {
+    return;
+  }
+
+  if (&upstream_request == hedge_request_.get()) {
+    ENVOY_STREAM_LOG(debug, "hedged request won", *callbacks_);
+    cluster_->stats().upstream_rq_hedge_win_.inc();
+    upstream_request_->resetStream();
+    upstream_request_ = std::move(hedge_request_);
+  } else {
+    hedge_request_->resetStream();
+    hedge_request_.reset();
+  }
+
+  // Both requests reported their host as they got one.
+  callbacks_->requestInfo().onUpstreamHostSelected(upstream_request_->upstream_host_);
+}
+
+bool Filter::dropHedgedRequest(UpstreamRequest& upstream_request, Http::Code code) {
+  // While the other request is outstanding, a failed one is dropped rather than failing (or
+  // retrying) the downstream request. This destroys upstream_request.
+  if (!hedge_request_) {
+    return false;
+  }
+
+  ENVOY_STREAM_LOG(debug, "dropping failed hedged request", *callbacks_);
+  if (upstream_request.upstream_host_) {
+    upstream_request.upstream_host_->outlierDetector().putHttpResponseCode(enumToInt(code));
+  }
+
+  if (&upstream_request == upstream_request_.get()) {
+    upstream_request_ = std::move(hedge_request_);
+  } else {
+    hedge_request_.reset();
+  }
+
+  return true;
+}
+
 void Filter::onUpstreamReset(UpstreamResetType type,
                              const Optional<Http::StreamResetReason>& reset_reason) {
   ASSERT(type == UpstreamResetType::GlobalTimeout || upstream_request_);
@@ -488,12 +626,13 @@ void Filter::onUpstreamHeaders(Http::HeaderMapPtr&& headers, bool end_stream) {
     upstream_request_->upstream_host_->healthChecker().setUnhealthy();
   }
 
+  reportUpstreamLoad(*headers, *upstream_request_->upstream_host_);
+
   if (retry_state_) {
     RetryStatus retry_status = retry_state_->shouldRetry(
         headers.get(), Optional<Http::StreamResetReason>(), [this]() -> void { doRetry(); });
     if (retry_status == RetryStatus::Yes && setupRetry(end_stream)) {
-      Http::CodeUtility::chargeBasicResponseStat(
-          cluster_->statsScope(), "retry.",
+      cluster_->codeStats().retry().charge(
           static_cast<Http::Code>(Http::Utility::getResponseStatus(*headers)));
       return;
     } else if (retry_status == RetryStatus::NoOverflow) {
@@ -537,15 +676,39 @@ void Filter::onUpstreamData(Buffer::Instance& data, bool end_stream) {
 }
 
 void Filter::onUpstreamTrailers(Http::HeaderMapPtr&& trailers) {
+  // Upstreams that only know their load once the response is done can report it in the trailers.
+  reportUpstreamLoad(*trailers, *upstream_request_->upstream_host_);
   onUpstreamComplete();
   callbacks_->encodeTrailers(std::move(trailers));
 }
 
+void Filter::reportUpstreamLoad(Http::HeaderMap& headers,
+                                const Upstream::HostDescription& upstream_host) {
+  const Http::HeaderEntry* load_entry = headers.EnvoyUpstreamLoad();
+  if (load_entry == nullptr) {
+    return;
+  }
+
+  // The load report is meant for the proxy, so it is not forwarded downstream.
+  uint64_t load;
+  if (StringUtil::atoul(load_entry->value().c_str(), load)) {
+    upstream_host.reportLoad(static_cast<uint32_t>(std::min<uint64_t>(load, 100)));
+  }
+  headers.removeEnvoyUpstreamLoad();
+}
+
 void Filter::onUpstreamComplete() {
   if (!downstream_end_stream_) {
     upstream_request_->resetStream();
   }
 
+  if (!callbacks_->requestInfo().healthCheck() &&
+      DateUtil::timePointValid(downstream_request_complete_time_)) {
+    cluster_->resourceManager(route_entry_->priority())
+        .putRequestLatency(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - downstream_request_complete_time_));
+  }
+
   if (config_.emit_dynamic_stats_ && !callbacks_->requestInfo().healthCheck() &&
       DateUtil::timePointValid(downstream_request_complete_time_)) {
     std::chrono::milliseconds response_time = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -604,6 +767,12 @@ bool Filter::setupRetry(bool end_stream) {
   }
 
   ENVOY_STREAM_LOG(debug, "performing retry", *callbacks_);
+  // Only the first try is hedged.
+  if (hedge_timer_) {
+    hedge_timer_->disableTimer();
+    hedge_timer_.reset();
+  }
+
   if (!end_stream) {
     upstream_request_->resetStream();
   }
@@ -649,6 +818,7 @@ Filter::UpstreamRequest::~UpstreamRequest() {
 }
 
 void Filter::UpstreamRequest::decodeHeaders(Http::HeaderMapPtr&& headers, bool end_stream) {
+  parent_.onUpstreamRequestHeaders(*this);
   parent_.onUpstreamHeaders(std::move(headers), end_stream);
 }
 
@@ -709,6 +879,9 @@ void Filter::UpstreamRequest::encodeTrailers(const Http::HeaderMap& trailers) {
 void Filter::UpstreamRequest::onResetStream(Http::StreamResetReason reason) {
   clearRequestEncoder();
   if (!calling_encode_headers_) {
+    if (parent_.dropHedgedRequest(*this, Http::Code::ServiceUnavailable)) {
+      return;
+    }
     parent_.onUpstreamReset(UpstreamResetType::Reset, Optional<Http::StreamResetReason>(reason));
   } else {
     deferred_reset_reason_ = reason;
@@ -733,8 +906,8 @@ void Filter::UpstreamRequest::resetStream() {
 void Filter::UpstreamRequest::setupPerTryTimeout() {
   ASSERT(!per_try_timeout_);
   if (parent_.timeout_.per_try_timeout_.count() > 0) {
-    per_try_timeout_ =
-        parent_.callbacks_->dispatcher().createTimer([this]() -> void { onPerTryTimeout(); });
+    per_try_timeout_ = parent_.callbacks_->dispatcher().createTimer(
+        [this]() -> void { onPerTryTimeout(); }, Event::TimerPrecision::Coarse);
     per_try_timeout_->enableTimer(parent_.timeout_.per_try_timeout_);
   }
 }
@@ -746,6 +919,9 @@ void Filter::UpstreamRequest::onPerTryTimeout() {
     upstream_host_->stats().rq_timeout_.inc();
   }
   resetStream();
+  if (parent_.dropHedgedRequest(*this, parent_.timeout_response_code_)) {
+    return;
+  }
   parent_.onUpstreamReset(UpstreamResetType::PerTryTimeout,
                           Optional<Http::StreamResetReason>(Http::StreamResetReason::LocalReset));
 }
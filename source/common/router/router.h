@@ -16,6 +16,8 @@
 
 #include "common/buffer/watermark_buffer.h"
 #include "common/common/logger.h"
+#include "common/common/object_pool.h"
+#include "common/stats/cardinality_limiter.h"
 
 namespace Envoy {
 namespace Router {
@@ -46,6 +48,7 @@ public:
   struct TimeoutData {
     std::chrono::milliseconds global_timeout_{0};
     std::chrono::milliseconds per_try_timeout_{0};
+    std::chrono::milliseconds hedge_delay_{0};
   };
 
   /**
@@ -68,7 +71,7 @@ public:
    * Determine the final timeout to use based on the route as well as the request headers.
    * @param route supplies the request route.
    * @param request_headers supplies the request headers.
-   * @return TimeoutData for both the global and per try timeouts.
+   * @return TimeoutData for the global and per try timeouts, and the hedge delay.
    */
   static TimeoutData finalTimeout(const RouteEntry& route, Http::HeaderMap& request_headers);
 };
@@ -81,10 +84,11 @@ public:
   FilterConfig(const std::string& stat_prefix, const LocalInfo::LocalInfo& local_info,
                Stats::Scope& scope, Upstream::ClusterManager& cm, Runtime::Loader& runtime,
                Runtime::RandomGenerator& random, ShadowWriterPtr&& shadow_writer,
-               bool emit_dynamic_stats)
+               bool emit_dynamic_stats, uint32_t retry_buffer_limit)
       : scope_(scope), local_info_(local_info), cm_(cm), runtime_(runtime),
         random_(random), stats_{ALL_ROUTER_STATS(POOL_COUNTER_PREFIX(scope, stat_prefix))},
-        emit_dynamic_stats_(emit_dynamic_stats), shadow_writer_(std::move(shadow_writer)) {}
+        emit_dynamic_stats_(emit_dynamic_stats), retry_buffer_limit_(retry_buffer_limit),
+        shadow_writer_(std::move(shadow_writer)) {}
 
   ShadowWriter& shadowWriter() { return *shadow_writer_; }
 
@@ -95,6 +99,12 @@ public:
   Runtime::RandomGenerator& random_;
   FilterStats stats_;
   const bool emit_dynamic_stats_;
+  // The most request body that is kept for retries, shadowing and hedging, or 0 to keep up to the
+  // decoder buffer limit.
+  const uint32_t retry_buffer_limit_;
+  // The alternate stat names of requests come from a request header, so their number is bounded.
+  static const size_t MAX_ALT_STAT_NAMES = 256;
+  Stats::CardinalityLimiter alt_stat_names_{MAX_ALT_STAT_NAMES};
 
 private:
   ShadowWriterPtr shadow_writer_;
@@ -137,12 +147,16 @@ public:
   const Network::Connection* downstreamConnection() const override {
     return callbacks_->connection();
   }
+  const Upstream::MetadataMatchCriteria* metadataMatchCriteria() const override {
+    return route_entry_ ? route_entry_->metadataMatchCriteria() : nullptr;
+  }
 
 protected:
   RetryStatePtr retry_state_;
 
 private:
-  struct UpstreamRequest : public Http::StreamDecoder,
+  struct UpstreamRequest : public PooledObject<UpstreamRequest>,
+                           public Http::StreamDecoder,
                            public Http::StreamCallbacks,
                            public Http::ConnectionPool::Callbacks {
     UpstreamRequest(Filter& parent, Http::ConnectionPool::Instance& pool)
@@ -227,6 +241,8 @@ private:
   streamResetReasonToResponseFlag(Http::StreamResetReason reset_reason);
 
   static const std::string& upstreamZone(Upstream::HostDescriptionConstSharedPtr upstream_host);
+  static void reportUpstreamLoad(Http::HeaderMap& headers,
+                                 const Upstream::HostDescription& upstream_host);
   void chargeUpstreamCode(const Http::HeaderMap& response_headers,
                           Upstream::HostDescriptionConstSharedPtr upstream_host);
   void chargeUpstreamCode(Http::Code code, Upstream::HostDescriptionConstSharedPtr upstream_host);
@@ -238,7 +254,6 @@ private:
                                          Event::Dispatcher& dispatcher,
                                          Upstream::ResourcePriority priority) PURE;
   Http::ConnectionPool::Instance* getConnPool();
-  void maybeDoShadowing();
   void onRequestComplete();
   void onResponseTimeout();
   void onUpstreamHeaders(Http::HeaderMapPtr&& headers, bool end_stream);
@@ -247,7 +262,11 @@ private:
   void onUpstreamComplete();
   void onUpstreamReset(UpstreamResetType type,
                        const Optional<Http::StreamResetReason>& reset_reason);
+  void onHedgeTimeout();
+  void onUpstreamRequestHeaders(UpstreamRequest& upstream_request);
+  bool dropHedgedRequest(UpstreamRequest& upstream_request, Http::Code code);
   void sendNoHealthyUpstreamResponse();
+  void setBufferLimit(uint32_t limit);
   bool setupRetry(bool end_stream);
   void doRetry();
 
@@ -262,10 +281,16 @@ private:
   FilterUtility::TimeoutData timeout_;
   Http::Code timeout_response_code_ = Http::Code::GatewayTimeout;
   UpstreamRequestPtr upstream_request_;
+  ShadowStreamPtr shadow_stream_;
+  // A second request for the same downstream request, raced against upstream_request_ until one
+  // of them gets response headers.
+  UpstreamRequestPtr hedge_request_;
+  Event::TimerPtr hedge_timer_;
   Http::HeaderMap* downstream_headers_{};
   Http::HeaderMap* downstream_trailers_{};
   MonotonicTime downstream_request_complete_time_;
   uint32_t buffer_limit_{0};
+  uint32_t retry_buffer_limit_{0};
   bool stream_destroyed_{};
 
   bool downstream_response_started_ : 1;
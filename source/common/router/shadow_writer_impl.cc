@@ -3,20 +3,26 @@
 #include <chrono>
 #include <string>
 
+#include "common/buffer/buffer_impl.h"
 #include "common/common/assert.h"
+#include "common/http/header_map_impl.h"
 #include "common/http/headers.h"
 
 namespace Envoy {
 namespace Router {
 
-void ShadowWriterImpl::shadow(const std::string& cluster, Http::MessagePtr&& request,
-                              std::chrono::milliseconds timeout) {
+void ShadowWriterImpl::addShadowPostfix(Http::HeaderMap& headers) {
   // Switch authority to add a shadow postfix. This allows upstream logging to make a more sense.
   // TODO PERF: Avoid copy.
-  std::string host = request->headers().Host()->value().c_str();
+  std::string host = headers.Host()->value().c_str();
   ASSERT(!host.empty());
   host += "-shadow";
-  request->headers().Host()->value(host);
+  headers.Host()->value(host);
+}
+
+void ShadowWriterImpl::shadow(const std::string& cluster, Http::MessagePtr&& request,
+                              std::chrono::milliseconds timeout) {
+  addShadowPostfix(request->headers());
 
   // Configuration should guarantee that cluster exists before calling here. This is basically
   // fire and forget. We don't handle cancelling.
@@ -24,5 +30,124 @@ void ShadowWriterImpl::shadow(const std::string& cluster, Http::MessagePtr&& req
                                               Optional<std::chrono::milliseconds>(timeout));
 }
 
+ShadowStreamPtr ShadowWriterImpl::streamShadow(const std::string& cluster,
+                                               const Http::HeaderMap& headers, bool end_stream,
+                                               std::chrono::milliseconds timeout) {
+  Http::AsyncClient& client = cm_.httpAsyncClientForCluster(cluster);
+  ActiveShadowPtr active(new ActiveShadow(*this, client, headers));
+  ActiveShadow& shadow = *active;
+  // Destroying the stream resets or detaches the shadow request as appropriate.
+  std::unique_ptr<ShadowStreamImpl> stream(new ShadowStreamImpl(std::move(active)));
+
+  shadow.stream_ = client.start(shadow, Optional<std::chrono::milliseconds>(timeout));
+  if (shadow.stream_) {
+    shadow.local_complete_ = end_stream;
+    shadow.stream_->sendHeaders(*shadow.headers_, end_stream);
+  }
+
+  if (!shadow.stream_ || end_stream) {
+    return nullptr;
+  }
+  return std::move(stream);
+}
+
+ShadowWriterImpl::ActiveShadow::ActiveShadow(ShadowWriterImpl& parent, Http::AsyncClient& client,
+                                             const Http::HeaderMap& headers)
+    : parent_(parent), client_(client), headers_(new Http::HeaderMapImpl(headers)) {
+  addShadowPostfix(*headers_);
+}
+
+ShadowWriterImpl::ActiveShadow::~ActiveShadow() { parent_.bytes_in_flight_ -= bytes_in_flight_; }
+
+bool ShadowWriterImpl::ActiveShadow::canSend() {
+  if (stream_ && remote_complete_) {
+    // The shadow cluster already responded, so the rest of the request is of no use.
+    reset();
+  }
+  return stream_ != nullptr;
+}
+
+void ShadowWriterImpl::ActiveShadow::reset() {
+  stream_->reset();
+  stream_ = nullptr;
+}
+
+void ShadowWriterImpl::ActiveShadow::onRemoteComplete() {
+  remote_complete_ = true;
+  if (local_complete_) {
+    // The async client stream ends once both directions are complete.
+    onStreamDone();
+  }
+}
+
+void ShadowWriterImpl::ActiveShadow::onStreamDone() {
+  if (!stream_) {
+    return;
+  }
+
+  stream_ = nullptr;
+  if (detached_) {
+    client_.dispatcher().deferredDelete(Event::DeferredDeletablePtr{this});
+  }
+}
+
+void ShadowWriterImpl::ActiveShadow::onHeaders(Http::HeaderMapPtr&&, bool end_stream) {
+  if (end_stream) {
+    onRemoteComplete();
+  }
+}
+
+void ShadowWriterImpl::ActiveShadow::onData(Buffer::Instance&, bool end_stream) {
+  if (end_stream) {
+    onRemoteComplete();
+  }
+}
+
+ShadowWriterImpl::ShadowStreamImpl::~ShadowStreamImpl() {
+  if (active_->stream_ && !active_->local_complete_) {
+    // The request did not complete, so neither can the shadow request.
+    active_->reset();
+  }
+
+  if (active_->stream_) {
+    // Fire and forget. The shadow request deletes itself once the async client stream ends.
+    active_->detached_ = true;
+    active_.release();
+  }
+}
+
+bool ShadowWriterImpl::ShadowStreamImpl::sendData(const Buffer::Instance& data, bool end_stream) {
+  ActiveShadow& shadow = *active_;
+  if (!shadow.canSend()) {
+    return true;
+  }
+
+  ShadowWriterImpl& parent = shadow.parent_;
+  if (parent.max_bytes_in_flight_ > 0 &&
+      parent.bytes_in_flight_ + data.length() > parent.max_bytes_in_flight_) {
+    shadow.reset();
+    return false;
+  }
+
+  shadow.bytes_in_flight_ += data.length();
+  parent.bytes_in_flight_ += data.length();
+  // The copy shares the slabs of the data instead of copying it.
+  Buffer::OwnedImpl copy(data);
+  shadow.local_complete_ = end_stream;
+  shadow.stream_->sendData(copy, end_stream);
+  return true;
+}
+
+void ShadowWriterImpl::ShadowStreamImpl::sendTrailers(const Http::HeaderMap& trailers) {
+  ActiveShadow& shadow = *active_;
+  if (!shadow.canSend()) {
+    return;
+  }
+
+  shadow.trailers_.reset(new Http::HeaderMapImpl(trailers));
+  shadow.local_complete_ = true;
+  shadow.stream_->sendTrailers(*shadow.trailers_);
+}
+
 } // namespace Router
 } // namespace Envoy
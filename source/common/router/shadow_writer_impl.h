@@ -1,8 +1,13 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <memory>
 #include <string>
 
+#include "envoy/event/deferred_deletable.h"
+#include "envoy/http/async_client.h"
 #include "envoy/router/shadow_writer.h"
 #include "envoy/upstream/cluster_manager.h"
 
@@ -11,22 +16,90 @@ namespace Router {
 
 /**
  * Implementation of ShadowWriter that takes incoming requests to shadow and implements "fire and
- * forget" behavior using an async client.
+ * forget" behavior using an async client. Streamed shadow requests share the slabs of the data
+ * they are given rather than copying it.
  */
 class ShadowWriterImpl : public ShadowWriter, public Http::AsyncClient::Callbacks {
 public:
-  ShadowWriterImpl(Upstream::ClusterManager& cm) : cm_(cm) {}
+  /**
+   * @param cm supplies the cluster manager to get the async clients from.
+   * @param max_bytes_in_flight supplies the limit on the body bytes sent by all the streamed shadow
+   *        requests that have not ended yet, or 0 for no limit. A shadow request that would go
+   *        over the limit is reset.
+   */
+  ShadowWriterImpl(Upstream::ClusterManager& cm, uint64_t max_bytes_in_flight)
+      : cm_(cm), max_bytes_in_flight_(max_bytes_in_flight) {}
 
   // Router::ShadowWriter
   void shadow(const std::string& cluster, Http::MessagePtr&& request,
               std::chrono::milliseconds timeout) override;
+  ShadowStreamPtr streamShadow(const std::string& cluster, const Http::HeaderMap& headers,
+                               bool end_stream, std::chrono::milliseconds timeout) override;
 
   // Http::AsyncClient::Callbacks
   void onSuccess(Http::MessagePtr&&) override {}
   void onFailure(Http::AsyncClient::FailureReason) override {}
 
+  /**
+   * @return uint64_t the body bytes sent by the streamed shadow requests that have not ended yet.
+   */
+  uint64_t bytesInFlight() const { return bytes_in_flight_; }
+
 private:
+  /**
+   * A streamed shadow request. It is owned by its ShadowStreamImpl until the request is complete,
+   * and then by itself until the async client stream ends.
+   */
+  struct ActiveShadow : public Http::AsyncClient::StreamCallbacks, public Event::DeferredDeletable {
+    ActiveShadow(ShadowWriterImpl& parent, Http::AsyncClient& client,
+                 const Http::HeaderMap& headers);
+    ~ActiveShadow();
+
+    // Resets the stream if the response is complete. @return whether more can be sent.
+    bool canSend();
+    void reset();
+    void onRemoteComplete();
+    void onStreamDone();
+
+    // Http::AsyncClient::StreamCallbacks
+    void onHeaders(Http::HeaderMapPtr&&, bool end_stream) override;
+    void onData(Buffer::Instance&, bool end_stream) override;
+    void onTrailers(Http::HeaderMapPtr&&) override { onRemoteComplete(); }
+    void onReset() override { onStreamDone(); }
+
+    ShadowWriterImpl& parent_;
+    Http::AsyncClient& client_;
+    // The async client router references the headers and trailers until the stream ends.
+    Http::HeaderMapPtr headers_;
+    Http::HeaderMapPtr trailers_;
+    Http::AsyncClient::Stream* stream_{};
+    uint64_t bytes_in_flight_{};
+    bool local_complete_{};
+    bool remote_complete_{};
+    bool detached_{};
+  };
+
+  typedef std::unique_ptr<ActiveShadow> ActiveShadowPtr;
+
+  class ShadowStreamImpl : public ShadowStream {
+  public:
+    ShadowStreamImpl(ActiveShadowPtr&& active) : active_(std::move(active)) {}
+    ~ShadowStreamImpl();
+
+    // Router::ShadowStream
+    bool sendData(const Buffer::Instance& data, bool end_stream) override;
+    void sendTrailers(const Http::HeaderMap& trailers) override;
+
+  private:
+    ActiveShadowPtr active_;
+  };
+
+  static void addShadowPostfix(Http::HeaderMap& headers);
+
   Upstream::ClusterManager& cm_;
+  const uint64_t max_bytes_in_flight_;
+  // Shared by the workers that use this writer.
+  std::atomic<uint64_t> bytes_in_flight_{};
 };
 
 } // namespace Router
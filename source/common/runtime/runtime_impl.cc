@@ -1,10 +1,13 @@
 #include "common/runtime/runtime_impl.h"
 
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstdint>
-#include <random>
+#include <cstring>
 #include <string>
 
 #include "envoy/event/dispatcher.h"
@@ -21,9 +24,58 @@
 namespace Envoy {
 namespace Runtime {
 
-const size_t RandomGeneratorImpl::UUID_LENGTH = 36;
+namespace {
+
+bool isWhitespace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+/**
+ * Read only mapping of a whole file.
+ */
+struct MappedFile {
+  MappedFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+      throw EnvoyException(fmt::format("unable to open file: {}", path));
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+      ::close(fd);
+      throw EnvoyException(fmt::format("unable to stat file: {}", path));
+    }
+
+    size_ = info.st_size;
+    if (size_ > 0) {
+      void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (data == MAP_FAILED) {
+        throw EnvoyException(fmt::format("unable to map file: {}", path));
+      }
+      data_ = static_cast<const char*>(data);
+    } else {
+      ::close(fd);
+    }
+  }
+
+  ~MappedFile() {
+    if (data_ != nullptr) {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  const char* data_{};
+  size_t size_{};
+};
+
+} // namespace
 
 std::string RandomGeneratorImpl::uuid() {
+  char uuid[UUID_LENGTH];
+  RandomGeneratorImpl::uuid(uuid);
+  return std::string(uuid, UUID_LENGTH);
+}
+
+void RandomGeneratorImpl::uuid(char* uuid) {
   static thread_local uint8_t buffered[2048];
   static thread_local size_t buffered_idx = sizeof(buffered);
 
@@ -49,7 +101,6 @@ std::string RandomGeneratorImpl::uuid() {
 
   // Convert UUID to a string representation, e.g. a121e9e1-feae-4136-9e0e-6fac343d56c9.
   static const char* const hex = "0123456789abcdef";
-  char uuid[UUID_LENGTH];
 
   for (uint8_t i = 0; i < 4; i++) {
     const uint8_t d = rand[i];
@@ -88,17 +139,69 @@ std::string RandomGeneratorImpl::uuid() {
     uuid[2 * i + 4] = hex[d >> 4];
     uuid[2 * i + 5] = hex[d & 0x0f];
   }
+}
 
-  return std::string(uuid, UUID_LENGTH);
+void LayerImpl::add(const std::string& key, std::string&& value) {
+  Entry entry;
+  entry.string_value_ = std::move(value);
+  StringUtil::rtrim(entry.string_value_);
+
+  // As a perf optimization, attempt to convert the string into an integer. If we don't
+  // succeed that's fine.
+  uint64_t converted;
+  if (StringUtil::atoul(entry.string_value_.c_str(), converted)) {
+    entry.uint_value_.value(converted);
+  }
+
+  values_[key] = std::move(entry);
 }
 
-SnapshotImpl::SnapshotImpl(const std::string& root_path, const std::string& override_path,
-                           RuntimeStats& stats, RandomGenerator& generator)
-    : generator_(generator) {
+void LayerImpl::buildIndex() {
+  index_.clear();
+  if (values_.empty()) {
+    return;
+  }
+
+  size_t size = 2;
+  while (size < values_.size() * 2) {
+    size *= 2;
+  }
+  index_.assign(size, IndexSlot{0, nullptr, nullptr});
+
+  const size_t mask = size - 1;
+  for (const auto& value : values_) {
+    const size_t hash = std::hash<std::string>()(value.first);
+    size_t i = hash & mask;
+    while (index_[i].entry_ != nullptr) {
+      i = (i + 1) & mask;
+    }
+    index_[i] = {hash, &value.first, &value.second};
+  }
+}
+
+const LayerImpl::Entry* LayerImpl::find(const std::string& key, size_t hash) const {
+  if (index_.empty()) {
+    return nullptr;
+  }
+
+  // The index is at most half full so the probing always ends at an empty slot.
+  const size_t mask = index_.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    const IndexSlot& slot = index_[i];
+    if (slot.entry_ == nullptr) {
+      return nullptr;
+    } else if (slot.hash_ == hash && *slot.key_ == key) {
+      return slot.entry_;
+    }
+  }
+}
+
+DiskLayerImpl::DiskLayerImpl(const std::string& root_path, const std::string& override_path,
+                             RuntimeStats& stats) {
   try {
-    walkDirectory(root_path, "");
-    if (Filesystem::directoryExists(override_path)) {
-      walkDirectory(override_path, "");
+    load(root_path);
+    if (Filesystem::directoryExists(override_path) || Filesystem::fileExists(override_path)) {
+      load(override_path);
       stats.override_dir_exists_.inc();
     } else {
       stats.override_dir_not_exists_.inc();
@@ -110,28 +213,62 @@ SnapshotImpl::SnapshotImpl(const std::string& root_path, const std::string& over
     ENVOY_LOG(debug, "error creating runtime snapshot: {}", e.what());
   }
 
-  stats.num_keys_.set(values_.size());
+  buildIndex();
 }
 
-const std::string& SnapshotImpl::get(const std::string& key) const {
-  auto entry = values_.find(key);
-  if (entry == values_.end()) {
-    return EMPTY_STRING;
+void DiskLayerImpl::load(const std::string& path) {
+  struct stat info;
+  if (::stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+    loadIndexFile(path);
   } else {
-    return entry->second.string_value_;
+    walkDirectory(path, "");
   }
 }
 
-uint64_t SnapshotImpl::getInteger(const std::string& key, uint64_t default_value) const {
-  auto entry = values_.find(key);
-  if (entry == values_.end() || !entry->second.uint_value_.valid()) {
-    return default_value;
-  } else {
-    return entry->second.uint_value_.value();
+void DiskLayerImpl::loadIndexFile(const std::string& path) {
+  ENVOY_LOG(debug, "reading runtime index: {}", path);
+  MappedFile file(path);
+  const char* current = file.data_;
+  const char* const end = file.data_ + file.size_;
+  while (current < end) {
+    const char* line_end = static_cast<const char*>(memchr(current, '\n', end - current));
+    if (line_end == nullptr) {
+      line_end = end;
+    }
+
+    // Each line is "<key> <value>", blank lines and lines starting with '#' are skipped.
+    const char* key_end = current;
+    while (key_end < line_end && !isWhitespace(*key_end)) {
+      key_end++;
+    }
+    if (key_end == current) {
+      if (std::find_if(current, line_end, [](char c) { return !isWhitespace(c); }) != line_end) {
+        throw EnvoyException(fmt::format("invalid runtime index line in {}", path));
+      }
+    } else if (*current != '#') {
+      const char* value_start = key_end;
+      while (value_start < line_end && isWhitespace(*value_start)) {
+        value_start++;
+      }
+
+      // The value is on one line, so newlines and backslashes are escaped.
+      std::string value;
+      value.reserve(line_end - value_start);
+      for (const char* c = value_start; c < line_end; c++) {
+        if (*c == '\\' && c + 1 < line_end && (c[1] == 'n' || c[1] == '\\')) {
+          value.push_back(*++c == 'n' ? '\n' : '\\');
+        } else {
+          value.push_back(*c);
+        }
+      }
+      add(std::string(current, key_end), std::move(value));
+    }
+
+    current = line_end + 1;
   }
 }
 
-void SnapshotImpl::walkDirectory(const std::string& path, const std::string& prefix) {
+void DiskLayerImpl::walkDirectory(const std::string& path, const std::string& prefix) {
   ENVOY_LOG(debug, "walking directory: {}", path);
   Directory current_dir(path);
   while (true) {
@@ -159,22 +296,64 @@ void SnapshotImpl::walkDirectory(const std::string& path, const std::string& pre
     } else if (entry->d_type == DT_REG) {
       // Suck the file into a string. This is not very efficient but it should be good enough
       // for small files. Also, as noted elsewhere, none of this is non-blocking which could
-      // theoretically lead to issues.
+      // theoretically lead to issues. Large runtimes can use a single index file instead.
       ENVOY_LOG(debug, "reading file: {}", full_path);
-      Entry entry;
-      entry.string_value_ = Filesystem::fileReadToEnd(full_path);
-      StringUtil::rtrim(entry.string_value_);
-
-      // As a perf optimization, attempt to convert the string into an integer. If we don't
-      // succeed that's fine.
-      uint64_t converted;
-      if (StringUtil::atoul(entry.string_value_.c_str(), converted)) {
-        entry.uint_value_.value(converted);
-      }
+      add(full_prefix, Filesystem::fileReadToEnd(full_path));
+    }
+  }
+}
 
-      values_[full_prefix] = entry;
+SnapshotImpl::SnapshotImpl(LayerConstSharedPtr disk_layer, LayerConstSharedPtr admin_layer,
+                           const std::vector<Key>& handle_keys, RandomGenerator& generator)
+    : disk_layer_(disk_layer), admin_layer_(admin_layer), generator_(generator) {
+  handle_entries_.reserve(handle_keys.size());
+  for (const Key& key : handle_keys) {
+    handle_entries_.push_back(find(key.name(), key.hash()));
+  }
+}
+
+uint64_t SnapshotImpl::numKeys() const {
+  uint64_t num_keys = disk_layer_->values().size();
+  for (const auto& value : admin_layer_->values()) {
+    if (disk_layer_->values().count(value.first) == 0) {
+      num_keys++;
     }
   }
+  return num_keys;
+}
+
+bool SnapshotImpl::isEnabled(const Entry* entry, uint64_t default_value) const {
+  // Avoid PNRG if we know we don't need it.
+  uint64_t cutoff = std::min(integerValue(entry, default_value), static_cast<uint64_t>(100));
+  if (cutoff == 0) {
+    return false;
+  } else if (cutoff == 100) {
+    return true;
+  } else {
+    return generator_.random() % 100 < cutoff;
+  }
+}
+
+bool SnapshotImpl::isEnabled(const Entry* entry, uint64_t default_value, uint64_t random_value,
+                             uint16_t num_buckets) const {
+  return random_value % static_cast<uint64_t>(num_buckets) <
+         std::min(integerValue(entry, default_value), static_cast<uint64_t>(num_buckets));
+}
+
+const std::string& SnapshotImpl::stringValue(const Entry* entry) const {
+  if (entry == nullptr) {
+    return EMPTY_STRING;
+  } else {
+    return entry->string_value_;
+  }
+}
+
+uint64_t SnapshotImpl::integerValue(const Entry* entry, uint64_t default_value) const {
+  if (entry == nullptr || !entry->uint_value_.valid()) {
+    return default_value;
+  } else {
+    return entry->uint_value_.value();
+  }
 }
 
 LoaderImpl::LoaderImpl(Event::Dispatcher& dispatcher, ThreadLocal::SlotAllocator& tls,
@@ -183,7 +362,8 @@ LoaderImpl::LoaderImpl(Event::Dispatcher& dispatcher, ThreadLocal::SlotAllocator
                        RandomGenerator& generator)
     : watcher_(dispatcher.createFilesystemWatcher()), tls_(tls.allocateSlot()),
       generator_(generator), root_path_(root_symlink_path + "/" + subdir),
-      override_path_(root_symlink_path + "/" + override_dir), stats_(generateStats(store)) {
+      override_path_(root_symlink_path + "/" + override_dir),
+      admin_layer_(std::make_shared<LayerImpl>()), stats_(generateStats(store)) {
   watcher_->addWatch(root_symlink_path, Filesystem::Watcher::Events::MovedTo,
                      [this](uint32_t) -> void { onSymlinkSwap(); });
 
@@ -198,7 +378,15 @@ RuntimeStats LoaderImpl::generateStats(Stats::Store& store) {
 }
 
 void LoaderImpl::onSymlinkSwap() {
-  current_snapshot_.reset(new SnapshotImpl(root_path_, override_path_, stats_, generator_));
+  disk_layer_ = std::make_shared<DiskLayerImpl>(root_path_, override_path_, stats_);
+  createSnapshot();
+}
+
+void LoaderImpl::createSnapshot() {
+  current_snapshot_.reset(new SnapshotImpl(disk_layer_, admin_layer_, handle_keys_, generator_));
+  stats_.num_keys_.set(current_snapshot_->numKeys());
+  stats_.admin_overrides_active_.set(admin_layer_->values().size());
+
   ThreadLocal::ThreadLocalObjectSharedPtr ptr_copy = current_snapshot_;
   tls_->set([ptr_copy](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
     return ptr_copy;
@@ -207,5 +395,35 @@ void LoaderImpl::onSymlinkSwap() {
 
 Snapshot& LoaderImpl::snapshot() { return tls_->getTyped<Snapshot>(); }
 
+FeatureHandleSharedPtr LoaderImpl::featureHandle(const std::string& key) {
+  auto handle = handles_.find(key);
+  if (handle != handles_.end()) {
+    return handle->second;
+  }
+
+  // The key is resolved by the snapshots created from now on. Until the next one, the handle looks
+  // the key up in the current snapshot.
+  FeatureHandleSharedPtr new_handle =
+      std::make_shared<FeatureHandleImpl>(*tls_, key, handle_keys_.size());
+  handle_keys_.emplace_back(key);
+  handles_.emplace(key, new_handle);
+  return new_handle;
+}
+
+void LoaderImpl::mergeValues(const std::unordered_map<std::string, std::string>& values) {
+  // Only the merged values are copied, the disk layer is shared with the previous snapshot.
+  std::shared_ptr<LayerImpl> admin_layer = std::make_shared<LayerImpl>(*admin_layer_);
+  for (const auto& value : values) {
+    if (value.second.empty()) {
+      admin_layer->remove(value.first);
+    } else {
+      admin_layer->add(value.first, std::string(value.second));
+    }
+  }
+  admin_layer->buildIndex();
+  admin_layer_ = admin_layer;
+  createSnapshot();
+}
+
 } // namespace Runtime
 } // namespace Envoy
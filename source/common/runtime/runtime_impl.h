@@ -5,9 +5,9 @@
 #include <chrono>
 #include <cstdint>
 #include <memory>
-#include <random>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "envoy/common/exception.h"
 #include "envoy/common/optional.h"
@@ -25,22 +25,53 @@ namespace Envoy {
 namespace Runtime {
 
 /**
- * Implementation of RandomGenerator that uses per-thread RANLUX generators seeded with current
- * time.
+ * Implementation of RandomGenerator that uses per-thread xoroshiro128+ generators seeded with
+ * current time. The uuids use OpenSSL randomness.
  */
 class RandomGeneratorImpl : public RandomGenerator {
 public:
   // Runtime::RandomGenerator
-  uint64_t random() override { return threadLocalGenerator()(); }
+  uint64_t random() override { return threadLocalGenerator().next(); }
   std::string uuid() override;
-
-  static const size_t UUID_LENGTH;
+  void uuid(char* buffer) override;
 
 private:
-  static std::ranlux48& threadLocalGenerator() {
+  /**
+   * xoroshiro128+, see http://xoroshiro.di.unimi.it. It is much faster than the standard library
+   * engines and its statistical quality is good enough for load balancing and sampling.
+   */
+  class Xoroshiro128Plus {
+  public:
+    explicit Xoroshiro128Plus(uint64_t seed) {
+      // The state is seeded with splitmix64, so that it is never all zeros.
+      for (uint64_t& state : state_) {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        state = z ^ (z >> 31);
+      }
+    }
+
+    uint64_t next() {
+      const uint64_t s0 = state_[0];
+      uint64_t s1 = state_[1];
+      const uint64_t result = s0 + s1;
+      s1 ^= s0;
+      state_[0] = rotl(s0, 55) ^ s1 ^ (s1 << 14);
+      state_[1] = rotl(s1, 36);
+      return result;
+    }
+
+  private:
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    uint64_t state_[2];
+  };
+
+  static Xoroshiro128Plus& threadLocalGenerator() {
     std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
         std::chrono::system_clock::now().time_since_epoch());
-    static thread_local std::ranlux48 generator(now.count() ^ Thread::Thread::currentThreadId());
+    static thread_local Xoroshiro128Plus generator(now.count() ^ Thread::Thread::currentThreadId());
 
     return generator;
   }
@@ -55,7 +86,8 @@ private:
   COUNTER(override_dir_not_exists)                                                                 \
   COUNTER(override_dir_exists)                                                                     \
   COUNTER(load_success)                                                                            \
-  GAUGE  (num_keys)
+  GAUGE  (num_keys)                                                                                \
+  GAUGE  (admin_overrides_active)
 // clang-format on
 
 /**
@@ -66,41 +98,62 @@ struct RuntimeStats {
 };
 
 /**
- * Implementation of Snapshot that reads from disk.
+ * An immutable set of runtime values once it is shared. Snapshots share their layers, so that a
+ * snapshot that only changes a few values does not reload or copy the others.
  */
-class SnapshotImpl : public Snapshot,
-                     public ThreadLocal::ThreadLocalObject,
-                     Logger::Loggable<Logger::Id::runtime> {
+class LayerImpl {
 public:
-  SnapshotImpl(const std::string& root_path, const std::string& override_path, RuntimeStats& stats,
-               RandomGenerator& generator);
+  struct Entry {
+    std::string string_value_;
+    Optional<uint64_t> uint_value_;
+  };
 
-  // Runtime::Snapshot
-  bool featureEnabled(const std::string& key, uint64_t default_value, uint64_t random_value,
-                      uint16_t num_buckets) const override {
-    return random_value % static_cast<uint64_t>(num_buckets) <
-           std::min(getInteger(key, default_value), static_cast<uint64_t>(num_buckets));
-  }
+  virtual ~LayerImpl() {}
 
-  bool featureEnabled(const std::string& key, uint64_t default_value) const override {
-    // Avoid PNRG if we know we don't need it.
-    uint64_t cutoff = std::min(getInteger(key, default_value), static_cast<uint64_t>(100));
-    if (cutoff == 0) {
-      return false;
-    } else if (cutoff == 100) {
-      return true;
-    } else {
-      return generator_.random() % 100 < cutoff;
-    }
-  }
+  /**
+   * Add or replace a value. The index must be rebuilt before the next lookup.
+   */
+  void add(const std::string& key, std::string&& value);
 
-  bool featureEnabled(const std::string& key, uint64_t default_value,
-                      uint64_t random_value) const override {
-    return featureEnabled(key, default_value, random_value, 100);
-  }
+  /**
+   * Remove a value. The index must be rebuilt before the next lookup.
+   */
+  void remove(const std::string& key) { values_.erase(key); }
 
-  const std::string& get(const std::string& key) const override;
-  uint64_t getInteger(const std::string&, uint64_t default_value) const override;
+  /**
+   * Build the index used for lookups.
+   */
+  void buildIndex();
+
+  /**
+   * @return const Entry* the entry for a key and its hash, or nullptr if there is none.
+   */
+  const Entry* find(const std::string& key, size_t hash) const;
+
+  const std::unordered_map<std::string, Entry>& values() const { return values_; }
+
+private:
+  // Open addressed index of values_. Lookups with a prehashed key only compare the key strings of
+  // the entries with the same hash.
+  struct IndexSlot {
+    size_t hash_;
+    const std::string* key_;
+    const Entry* entry_;
+  };
+
+  std::unordered_map<std::string, Entry> values_;
+  std::vector<IndexSlot> index_;
+};
+
+typedef std::shared_ptr<const LayerImpl> LayerConstSharedPtr;
+
+/**
+ * Layer with the values read from disk.
+ */
+class DiskLayerImpl : public LayerImpl, Logger::Loggable<Logger::Id::runtime> {
+public:
+  DiskLayerImpl(const std::string& root_path, const std::string& override_path,
+                RuntimeStats& stats);
 
 private:
   struct Directory {
@@ -116,14 +169,102 @@ private:
     DIR* dir_;
   };
 
-  struct Entry {
-    std::string string_value_;
-    Optional<uint64_t> uint_value_;
-  };
-
+  void load(const std::string& path);
+  void loadIndexFile(const std::string& path);
   void walkDirectory(const std::string& path, const std::string& prefix);
+};
 
-  std::unordered_map<std::string, Entry> values_;
+/**
+ * Implementation of Snapshot that is made of a layer read from disk, and a layer of admin
+ * overrides on top of it.
+ */
+class SnapshotImpl : public Snapshot, public ThreadLocal::ThreadLocalObject {
+public:
+  /**
+   * @param handle_keys supplies the keys of the loader's feature handles, which are resolved once
+   *        when the snapshot is created.
+   */
+  SnapshotImpl(LayerConstSharedPtr disk_layer, LayerConstSharedPtr admin_layer,
+               const std::vector<Key>& handle_keys, RandomGenerator& generator);
+
+  /**
+   * Lookups for feature handles. @param index supplies the index of the handle's key in the
+   * handle_keys the snapshot was created with. Handles created after the snapshot fall back to a
+   * lookup of the key.
+   */
+  bool handleEnabled(uint32_t index, const Key& key, uint64_t default_value) const {
+    return isEnabled(findHandle(index, key), default_value);
+  }
+  bool handleEnabled(uint32_t index, const Key& key, uint64_t default_value,
+                     uint64_t random_value) const {
+    return isEnabled(findHandle(index, key), default_value, random_value, 100);
+  }
+  uint64_t handleInteger(uint32_t index, const Key& key, uint64_t default_value) const {
+    return integerValue(findHandle(index, key), default_value);
+  }
+
+  /**
+   * @return uint64_t the number of distinct keys in the snapshot.
+   */
+  uint64_t numKeys() const;
+
+  // Runtime::Snapshot
+  bool featureEnabled(const std::string& key, uint64_t default_value) const override {
+    return isEnabled(find(key), default_value);
+  }
+  bool featureEnabled(const std::string& key, uint64_t default_value,
+                      uint64_t random_value) const override {
+    return isEnabled(find(key), default_value, random_value, 100);
+  }
+  bool featureEnabled(const std::string& key, uint64_t default_value, uint64_t random_value,
+                      uint16_t num_buckets) const override {
+    return isEnabled(find(key), default_value, random_value, num_buckets);
+  }
+  const std::string& get(const std::string& key) const override { return stringValue(find(key)); }
+  uint64_t getInteger(const std::string& key, uint64_t default_value) const override {
+    return integerValue(find(key), default_value);
+  }
+  bool featureEnabled(const Key& key, uint64_t default_value) const override {
+    return isEnabled(find(key.name(), key.hash()), default_value);
+  }
+  bool featureEnabled(const Key& key, uint64_t default_value,
+                      uint64_t random_value) const override {
+    return isEnabled(find(key.name(), key.hash()), default_value, random_value, 100);
+  }
+  bool featureEnabled(const Key& key, uint64_t default_value, uint64_t random_value,
+                      uint16_t num_buckets) const override {
+    return isEnabled(find(key.name(), key.hash()), default_value, random_value, num_buckets);
+  }
+  const std::string& get(const Key& key) const override {
+    return stringValue(find(key.name(), key.hash()));
+  }
+  uint64_t getInteger(const Key& key, uint64_t default_value) const override {
+    return integerValue(find(key.name(), key.hash()), default_value);
+  }
+
+private:
+  typedef LayerImpl::Entry Entry;
+
+  const Entry* find(const std::string& key) const {
+    return find(key, std::hash<std::string>()(key));
+  }
+  const Entry* find(const std::string& key, size_t hash) const {
+    const Entry* entry = admin_layer_->find(key, hash);
+    return entry != nullptr ? entry : disk_layer_->find(key, hash);
+  }
+  const Entry* findHandle(uint32_t index, const Key& key) const {
+    return index < handle_entries_.size() ? handle_entries_[index]
+                                          : find(key.name(), key.hash());
+  }
+  bool isEnabled(const Entry* entry, uint64_t default_value) const;
+  bool isEnabled(const Entry* entry, uint64_t default_value, uint64_t random_value,
+                 uint16_t num_buckets) const;
+  const std::string& stringValue(const Entry* entry) const;
+  uint64_t integerValue(const Entry* entry, uint64_t default_value) const;
+
+  const LayerConstSharedPtr disk_layer_;
+  const LayerConstSharedPtr admin_layer_;
+  std::vector<const Entry*> handle_entries_;
   RandomGenerator& generator_;
 };
 
@@ -131,7 +272,8 @@ private:
  * Implementation of Loader that watches a symlink for swapping and loads a specified subdirectory
  * from disk. A single snapshot is shared among all threads and referenced by shared_ptr such that
  * a new runtime can be swapped in by the main thread while workers are still using the previous
- * version.
+ * version. Merged values are kept in a separate layer, so that applying them neither reloads nor
+ * copies the values read from disk, which survive symlink swaps.
  */
 class LoaderImpl : public Loader {
 public:
@@ -141,10 +283,38 @@ public:
 
   // Runtime::Loader
   Snapshot& snapshot() override;
+  FeatureHandleSharedPtr featureHandle(const std::string& key) override;
+  void mergeValues(const std::unordered_map<std::string, std::string>& values) override;
 
 private:
+  class FeatureHandleImpl : public FeatureHandle {
+  public:
+    FeatureHandleImpl(ThreadLocal::Slot& tls, const std::string& key, uint32_t index)
+        : tls_(tls), key_(key), index_(index) {}
+
+    // Runtime::FeatureHandle
+    bool featureEnabled(uint64_t default_value) const override {
+      return snapshot().handleEnabled(index_, key_, default_value);
+    }
+    bool featureEnabled(uint64_t default_value, uint64_t random_value) const override {
+      return snapshot().handleEnabled(index_, key_, default_value, random_value);
+    }
+    uint64_t getInteger(uint64_t default_value) const override {
+      return snapshot().handleInteger(index_, key_, default_value);
+    }
+    const std::string& key() const override { return key_.name(); }
+
+  private:
+    SnapshotImpl& snapshot() const { return tls_.getTyped<SnapshotImpl>(); }
+
+    ThreadLocal::Slot& tls_;
+    const Key key_;
+    const uint32_t index_;
+  };
+
   RuntimeStats generateStats(Stats::Store& store);
   void onSymlinkSwap();
+  void createSnapshot();
 
   Filesystem::WatcherPtr watcher_;
   ThreadLocal::SlotPtr tls_;
@@ -152,7 +322,11 @@ private:
   std::string root_path_;
   std::string override_path_;
   std::shared_ptr<SnapshotImpl> current_snapshot_;
+  LayerConstSharedPtr disk_layer_;
+  LayerConstSharedPtr admin_layer_;
   RuntimeStats stats_;
+  std::vector<Key> handle_keys_;
+  std::unordered_map<std::string, FeatureHandleSharedPtr> handles_;
 };
 
 /**
@@ -164,6 +338,12 @@ public:
 
   // Runtime::Loader
   Snapshot& snapshot() override { return snapshot_; }
+  FeatureHandleSharedPtr featureHandle(const std::string& key) override {
+    return std::make_shared<NullFeatureHandleImpl>(snapshot_, key);
+  }
+  void mergeValues(const std::unordered_map<std::string, std::string>&) override {
+    throw EnvoyException("runtime values cannot be changed, runtime is not configured");
+  }
 
 private:
   struct NullSnapshotImpl : public Snapshot {
@@ -197,9 +377,47 @@ private:
       return default_value;
     }
 
+    bool featureEnabled(const Key& key, uint64_t default_value) const override {
+      return featureEnabled(key.name(), default_value);
+    }
+
+    bool featureEnabled(const Key& key, uint64_t default_value,
+                        uint64_t random_value) const override {
+      return featureEnabled(key.name(), default_value, random_value);
+    }
+
+    bool featureEnabled(const Key& key, uint64_t default_value, uint64_t random_value,
+                        uint16_t num_buckets) const override {
+      return featureEnabled(key.name(), default_value, random_value, num_buckets);
+    }
+
+    const std::string& get(const Key&) const override { return EMPTY_STRING; }
+
+    uint64_t getInteger(const Key&, uint64_t default_value) const override {
+      return default_value;
+    }
+
     RandomGenerator& generator_;
   };
 
+  struct NullFeatureHandleImpl : public FeatureHandle {
+    NullFeatureHandleImpl(const NullSnapshotImpl& snapshot, const std::string& key)
+        : snapshot_(snapshot), key_(key) {}
+
+    // Runtime::FeatureHandle
+    bool featureEnabled(uint64_t default_value) const override {
+      return snapshot_.featureEnabled(key_, default_value);
+    }
+    bool featureEnabled(uint64_t default_value, uint64_t random_value) const override {
+      return snapshot_.featureEnabled(key_, default_value, random_value);
+    }
+    uint64_t getInteger(uint64_t default_value) const override { return default_value; }
+    const std::string& key() const override { return key_; }
+
+    const NullSnapshotImpl& snapshot_;
+    const std::string key_;
+  };
+
   NullSnapshotImpl snapshot_;
 };
 
@@ -7,6 +7,7 @@
 #include "common/common/assert.h"
 #include "common/common/empty_string.h"
 #include "common/common/hex.h"
+#include "common/common/utility.h"
 #include "common/network/utility.h"
 
 #include "openssl/err.h"
@@ -44,10 +45,22 @@ ConnectionImpl::ConnectionImpl(Event::DispatcherImpl& dispatcher, int fd,
   SSL_set_mode(ssl_.get(), SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
   if (state == InitialState::Client) {
     SSL_set_connect_state(ssl_.get());
+    // Connections to the same server resume the sessions that it issued to the earlier ones.
+    ClientContextImpl* client_ctx = dynamic_cast<ClientContextImpl*>(&ctx_);
+    if (client_ctx != nullptr) {
+      session_key_ = remote_address->asString();
+      client_ctx->resumeSession(ssl_.get(), session_key_);
+    }
   } else {
     ASSERT(state == InitialState::Server);
     SSL_set_accept_state(ssl_.get());
   }
+
+  if (ctx_.privateKeyOperationProvider() != nullptr) {
+    private_key_operation_.reset(
+        new PrivateKeyOperationState(*ctx_.privateKeyOperationProvider(), dispatcher, *this));
+    SSL_set_app_data(ssl_.get(), private_key_operation_.get());
+  }
 }
 
 ConnectionImpl::~ConnectionImpl() {
@@ -65,6 +78,11 @@ Network::ConnectionImpl::IoResult ConnectionImpl::doReadFromSocket() {
     }
   }
 
+  if (kernel_tls_.rx_) {
+    // Alerts fail the read, which closes the connection.
+    return Network::ConnectionImpl::doReadFromSocket();
+  }
+
   bool keep_reading = true;
   PostIoAction action = PostIoAction::KeepOpen;
   uint64_t bytes_read = 0;
@@ -104,6 +122,8 @@ Network::ConnectionImpl::IoResult ConnectionImpl::doReadFromSocket() {
       if (shouldDrainReadBuffer()) {
         setReadBufferReady();
         keep_reading = false;
+      } else if (keep_reading && shouldYieldRead(bytes_read)) {
+        keep_reading = false;
       }
     }
   }
@@ -118,6 +138,9 @@ Network::ConnectionImpl::PostIoAction ConnectionImpl::doHandshake() {
     ENVOY_CONN_LOG(debug, "handshake complete", *this);
     handshake_complete_ = true;
     ctx_.logHandshake(ssl_.get());
+    if (ctx_.kernelTls()) {
+      installKernelTls();
+    }
     raiseEvent(Network::ConnectionEvent::Connected);
 
     // It's possible that we closed during the handshake callback.
@@ -128,6 +151,8 @@ Network::ConnectionImpl::PostIoAction ConnectionImpl::doHandshake() {
     switch (err) {
     case SSL_ERROR_WANT_READ:
     case SSL_ERROR_WANT_WRITE:
+    // The handshake is resumed by onPrivateKeyOperationComplete().
+    case SSL_ERROR_WANT_PRIVATE_KEY_OPERATION:
       return PostIoAction::KeepOpen;
     default:
       drainErrorQueue();
@@ -136,6 +161,21 @@ Network::ConnectionImpl::PostIoAction ConnectionImpl::doHandshake() {
   }
 }
 
+void ConnectionImpl::installKernelTls() {
+  kernel_tls_ = KernelTls::install(*ssl_, fd_);
+  ENVOY_CONN_LOG(debug, "kernel TLS: tx={} rx={}", *this, kernel_tls_.tx_, kernel_tls_.rx_);
+  if (kernel_tls_.tx_) {
+    ctx_.stats().kernel_tls_.inc();
+  } else {
+    ctx_.stats().kernel_tls_fallback_.inc();
+  }
+}
+
+void ConnectionImpl::onPrivateKeyOperationComplete() {
+  // The handshake continues from the read path, just as it does when more data arrives.
+  setReadBufferReady();
+}
+
 void ConnectionImpl::drainErrorQueue() {
   bool saw_error = false;
   bool saw_counted_error = false;
@@ -167,6 +207,23 @@ Network::ConnectionImpl::IoResult ConnectionImpl::doWriteToSocket() {
     }
   }
 
+  if (kernel_tls_.tx_) {
+    // The kernel frames the records.
+    return Network::ConnectionImpl::doWriteToSocket();
+  }
+
+  // Records are small while the connection starts and after it was idle. They do not become small
+  // while a write is pending, since it must be retried with at least the same length.
+  const DynamicRecordSizing& record_sizing = ctx_.dynamicRecordSizing();
+  const bool size_records = record_sizing.initial_record_size_ > 0;
+  MonotonicTime now;
+  if (size_records) {
+    now = ProdMonotonicTimeSource::instance_.currentTime();
+    if (!write_pending_ && now - last_write_time_ >= record_sizing.idle_timeout_) {
+      small_record_bytes_ = 0;
+    }
+  }
+
   uint64_t original_buffer_length = write_buffer_->length();
   uint64_t total_bytes_written = 0;
   bool keep_writing = true;
@@ -188,15 +245,32 @@ Network::ConnectionImpl::IoResult ConnectionImpl::doWriteToSocket() {
       // buffers. b) We only move() into the write buffer, which means that it's impossible for a
       // particular chain to increase in size. So as long as we start writing where we left off we
       // are guaranteed to call SSL_write() with the same parameters.
-      int rc = SSL_write(ssl_.get(), slices[i].mem_, slices[i].len_);
+      const bool small_record = size_records && small_record_bytes_ < record_sizing.ramp_bytes_;
+      const uint64_t write_size =
+          small_record ? std::min(slices[i].len_, record_sizing.initial_record_size_)
+                       : slices[i].len_;
+      int rc = SSL_write(ssl_.get(), slices[i].mem_, write_size);
       ENVOY_CONN_LOG(trace, "ssl write returns: {}", *this, rc);
       if (rc > 0) {
         inner_bytes_written += rc;
         total_bytes_written += rc;
+        write_pending_ = false;
+        if (small_record) {
+          ctx_.stats().small_record_.inc();
+          small_record_bytes_ += rc;
+          if (small_record_bytes_ >= record_sizing.ramp_bytes_) {
+            ctx_.stats().record_size_ramped_.inc();
+          }
+        }
+        if (write_size < slices[i].len_) {
+          // The rest of the slice is written in the next records.
+          break;
+        }
       } else {
         int err = SSL_get_error(ssl_.get(), rc);
         switch (err) {
         case SSL_ERROR_WANT_WRITE:
+          write_pending_ = true;
           keep_writing = false;
           break;
         case SSL_ERROR_WANT_READ:
@@ -217,6 +291,9 @@ Network::ConnectionImpl::IoResult ConnectionImpl::doWriteToSocket() {
     }
   }
 
+  if (size_records && total_bytes_written > 0) {
+    last_write_time_ = now;
+  }
   return {PostIoAction::KeepOpen, total_bytes_written};
 }
 
@@ -228,38 +305,50 @@ bool ConnectionImpl::peerCertificatePresented() {
 }
 
 std::string ConnectionImpl::uriSanLocalCertificate() {
-  // The cert object is not owned.
-  X509* cert = SSL_get_certificate(ssl_.get());
-  if (!cert) {
-    return "";
-  }
-  return getUriSanFromCertificate(cert);
+  return cachedCertificateField(uri_san_local_certificate_, [this]() -> std::string {
+    // The cert object is not owned.
+    X509* cert = SSL_get_certificate(ssl_.get());
+    return cert ? getUriSanFromCertificate(cert) : EMPTY_STRING;
+  });
 }
 
 std::string ConnectionImpl::sha256PeerCertificateDigest() {
+  return cachedCertificateField(sha256_peer_certificate_digest_, [this]() -> std::string {
+    Sha256Digest digest;
+    if (!rawSha256PeerCertificateDigest(digest)) {
+      return EMPTY_STRING;
+    }
+    return Hex::encode(digest.data(), digest.size());
+  });
+}
+
+bool ConnectionImpl::rawSha256PeerCertificateDigest(Sha256Digest& digest) {
   bssl::UniquePtr<X509> cert(SSL_get_peer_certificate(ssl_.get()));
   if (!cert) {
-    return "";
+    return false;
   }
 
-  std::vector<uint8_t> computed_hash(SHA256_DIGEST_LENGTH);
+  static_assert(SHA256_DIGEST_LENGTH == std::tuple_size<Sha256Digest>::value,
+                "SHA256 digest size mismatch");
   unsigned int n;
-  X509_digest(cert.get(), EVP_sha256(), computed_hash.data(), &n);
-  RELEASE_ASSERT(n == computed_hash.size());
-  return Hex::encode(computed_hash);
+  X509_digest(cert.get(), EVP_sha256(), digest.data(), &n);
+  RELEASE_ASSERT(n == digest.size());
+  return true;
 }
 
 std::string ConnectionImpl::subjectPeerCertificate() {
-  bssl::UniquePtr<X509> cert(SSL_get_peer_certificate(ssl_.get()));
-  if (!cert) {
-    return "";
-  }
+  return cachedCertificateField(subject_peer_certificate_, [this]() -> std::string {
+    bssl::UniquePtr<X509> cert(SSL_get_peer_certificate(ssl_.get()));
+    return cert ? subjectFromCertificate(cert.get()) : EMPTY_STRING;
+  });
+}
 
+std::string ConnectionImpl::subjectFromCertificate(X509* cert) {
   bssl::UniquePtr<BIO> buf(BIO_new(BIO_s_mem()));
   RELEASE_ASSERT(buf != nullptr);
 
   // flags=XN_FLAG_RFC2253 is the documented parameter for single-line output in RFC 2253 format.
-  X509_NAME_print_ex(buf.get(), X509_get_subject_name(cert.get()), 0 /* indent */, XN_FLAG_RFC2253);
+  X509_NAME_print_ex(buf.get(), X509_get_subject_name(cert), 0 /* indent */, XN_FLAG_RFC2253);
 
   const uint8_t* data;
   size_t data_len;
@@ -270,11 +359,10 @@ std::string ConnectionImpl::subjectPeerCertificate() {
 }
 
 std::string ConnectionImpl::uriSanPeerCertificate() {
-  bssl::UniquePtr<X509> cert(SSL_get_peer_certificate(ssl_.get()));
-  if (!cert) {
-    return "";
-  }
-  return getUriSanFromCertificate(cert.get());
+  return cachedCertificateField(uri_san_peer_certificate_, [this]() -> std::string {
+    bssl::UniquePtr<X509> cert(SSL_get_peer_certificate(ssl_.get()));
+    return cert ? getUriSanFromCertificate(cert.get()) : EMPTY_STRING;
+  });
 }
 
 std::string ConnectionImpl::getUriSanFromCertificate(X509* cert) {
@@ -315,7 +403,17 @@ ClientConnectionImpl::ClientConnectionImpl(Event::DispatcherImpl& dispatcher, Co
 void ClientConnectionImpl::connect() { doConnect(); }
 
 void ConnectionImpl::closeSocket(Network::ConnectionEvent close_type) {
-  if (handshake_complete_ && state() != State::Closed) {
+  // Destroying a pending operation cancels it.
+  if (private_key_operation_) {
+    private_key_operation_->operation_.reset();
+  }
+
+  if (handshake_complete_ && state() != State::Closed && kernel_tls_.tx_) {
+    // The SSL can no longer write records, so the alert is written by the kernel.
+    bool sent = KernelTls::sendCloseNotify(fd_);
+    ENVOY_CONN_LOG(debug, "kernel TLS shutdown: sent={}", *this, sent);
+    UNREFERENCED_PARAMETER(sent);
+  } else if (handshake_complete_ && state() != State::Closed) {
     // Attempt to send a shutdown before closing the socket. It's possible this won't go out if
     // there is no room on the socket. We can extend the state machine to handle this at some point
     // if needed.
@@ -3,15 +3,22 @@
 #include <cstdint>
 #include <string>
 
+#include "envoy/common/optional.h"
+#include "envoy/common/time.h"
+#include "envoy/ssl/private_key.h"
+
 #include "common/network/connection_impl.h"
 #include "common/ssl/context_impl.h"
+#include "common/ssl/kernel_tls.h"
 
 #include "openssl/ssl.h"
 
 namespace Envoy {
 namespace Ssl {
 
-class ConnectionImpl : public Network::ConnectionImpl, public Connection {
+class ConnectionImpl : public Network::ConnectionImpl,
+                       public Connection,
+                       public PrivateKeyOperationCallbacks {
 public:
   enum class InitialState { Client, Server };
 
@@ -31,15 +38,39 @@ public:
   bool peerCertificatePresented() override;
   std::string uriSanLocalCertificate() override;
   std::string sha256PeerCertificateDigest() override;
+  bool rawSha256PeerCertificateDigest(Sha256Digest& digest) override;
   std::string subjectPeerCertificate() override;
   std::string uriSanPeerCertificate() override;
 
+  // Ssl::PrivateKeyOperationCallbacks
+  void onPrivateKeyOperationComplete() override;
+
   SSL* rawSslForTest() { return ssl_.get(); }
 
 private:
   PostIoAction doHandshake();
+  void installKernelTls();
   void drainErrorQueue();
   std::string getUriSanFromCertificate(X509* cert);
+  std::string subjectFromCertificate(X509* cert);
+
+  /**
+   * The certificates of the connection do not change once the handshake is complete, so the fields
+   * derived from them are only computed the first time they are asked for after that.
+   * @param field supplies the cached field.
+   * @param compute supplies the function that derives the field.
+   */
+  template <class Compute>
+  std::string cachedCertificateField(Optional<std::string>& field, Compute compute) {
+    if (field.valid()) {
+      return field.value();
+    }
+    std::string value = compute();
+    if (handshake_complete_) {
+      field.value(value);
+    }
+    return value;
+  }
 
   // Network::ConnectionImpl
   void closeSocket(Network::ConnectionEvent close_type) override;
@@ -48,8 +79,23 @@ private:
   void onConnected() override;
 
   ContextImpl& ctx_;
+  // The key of the cached sessions of a client connection, which the SSL refers to and so
+  // outlives it. @see ClientContextImpl::resumeSession().
+  std::string session_key_;
   bssl::UniquePtr<SSL> ssl_;
   bool handshake_complete_{};
+  std::unique_ptr<PrivateKeyOperationState> private_key_operation_;
+  // Dynamic record sizing. @see DynamicRecordSizing.
+  uint64_t small_record_bytes_{};
+  MonotonicTime last_write_time_;
+  bool write_pending_{};
+  // The directions whose records are handled by the kernel, which plaintext is read from and
+  // written to.
+  KernelTls::Offload kernel_tls_;
+  Optional<std::string> uri_san_local_certificate_;
+  Optional<std::string> sha256_peer_certificate_digest_;
+  Optional<std::string> subject_peer_certificate_;
+  Optional<std::string> uri_san_peer_certificate_;
 };
 
 class ClientConnectionImpl final : public ConnectionImpl, public Network::ClientConnection {
@@ -60,6 +106,9 @@ public:
 
   // Network::ClientConnection
   void connect() override;
+  void setSocketOptions(const Network::SocketOptions& options) override {
+    doSetSocketOptions(options);
+  }
 };
 
 } // namespace Ssl
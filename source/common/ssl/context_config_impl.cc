@@ -1,6 +1,7 @@
 #include "common/ssl/context_config_impl.h"
 
 #include <string>
+#include <vector>
 
 #include "common/common/assert.h"
 #include "common/config/tls_context_json.h"
@@ -61,25 +62,62 @@ ContextConfigImpl::ContextConfigImpl(const envoy::api::v2::CommonTlsContext& con
   }
 }
 
-ClientContextConfigImpl::ClientContextConfigImpl(const envoy::api::v2::UpstreamTlsContext& config)
-    : ContextConfigImpl(config.common_tls_context()), server_name_indication_(config.sni()) {
+ClientContextConfigImpl::ClientContextConfigImpl(const envoy::api::v2::UpstreamTlsContext& config,
+                                                 uint32_t max_session_cache_size)
+    : ContextConfigImpl(config.common_tls_context()), server_name_indication_(config.sni()),
+      max_session_cache_size_(max_session_cache_size) {
   // TODO(PiotrSikora): Support multiple TLS certificates.
   ASSERT(config.common_tls_context().tls_certificates().size() <= 1);
 }
 
-ClientContextConfigImpl::ClientContextConfigImpl(const Json::Object& config)
-    : ClientContextConfigImpl([&config] {
-        envoy::api::v2::UpstreamTlsContext upstream_tls_context;
-        Config::TlsContextJson::translateUpstreamTlsContext(config, upstream_tls_context);
-        return upstream_tls_context;
-      }()) {}
+ClientContextConfigImpl::ClientContextConfigImpl(const Json::Object& config,
+                                                 uint32_t max_session_cache_size)
+    : ClientContextConfigImpl(
+          [&config] {
+            envoy::api::v2::UpstreamTlsContext upstream_tls_context;
+            Config::TlsContextJson::translateUpstreamTlsContext(config, upstream_tls_context);
+            return upstream_tls_context;
+          }(),
+          max_session_cache_size) {}
 
-ServerContextConfigImpl::ServerContextConfigImpl(const envoy::api::v2::DownstreamTlsContext& config)
+ServerContextConfigImpl::ServerContextConfigImpl(const envoy::api::v2::DownstreamTlsContext& config,
+                                                 const DynamicRecordSizing& dynamic_record_sizing,
+                                                 bool kernel_tls)
     : ContextConfigImpl(config.common_tls_context()),
       require_client_certificate_(
-          PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, require_client_certificate, false)) {
-  // TODO(PiotrSikora): Support multiple TLS certificates.
-  ASSERT(config.common_tls_context().tls_certificates().size() == 1);
+          PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, require_client_certificate, false)),
+      session_ticket_key_paths_(getSessionTicketKeyPaths(config)),
+      sni_certificates_(getSniCertificates(config)),
+      dynamic_record_sizing_(dynamic_record_sizing), kernel_tls_(kernel_tls) {
+  ASSERT(config.common_tls_context().tls_certificates().size() >= 1);
+}
+
+std::vector<std::string> ServerContextConfigImpl::getSessionTicketKeyPaths(
+    const envoy::api::v2::DownstreamTlsContext& config) {
+  std::vector<std::string> paths;
+  for (const auto& key : config.session_ticket_keys().keys()) {
+    // TODO(PiotrSikora): Support inline key material delivery.
+    ASSERT(key.specifier_case() == envoy::api::v2::DataSource::kFilename);
+    paths.push_back(key.filename());
+  }
+  return paths;
+}
+
+std::vector<CertificateFiles>
+ServerContextConfigImpl::getSniCertificates(const envoy::api::v2::DownstreamTlsContext& config) {
+  // The first certificate is the default one, the rest are selected by SNI.
+  std::vector<CertificateFiles> certificates;
+  const auto& tls_certificates = config.common_tls_context().tls_certificates();
+  for (int i = 1; i < tls_certificates.size(); i++) {
+    // TODO(htuch): Support inline cert material delivery.
+    ASSERT(tls_certificates[i].certificate_chain().specifier_case() ==
+           envoy::api::v2::DataSource::kFilename);
+    ASSERT(tls_certificates[i].private_key().specifier_case() ==
+           envoy::api::v2::DataSource::kFilename);
+    certificates.push_back({tls_certificates[i].certificate_chain().filename(),
+                            tls_certificates[i].private_key().filename()});
+  }
+  return certificates;
 }
 
 ServerContextConfigImpl::ServerContextConfigImpl(const Json::Object& config)
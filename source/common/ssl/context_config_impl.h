@@ -47,26 +47,50 @@ private:
 
 class ClientContextConfigImpl : public ContextConfigImpl, public ClientContextConfig {
 public:
-  ClientContextConfigImpl(const envoy::api::v2::UpstreamTlsContext& config);
-  ClientContextConfigImpl(const Json::Object& config);
+  ClientContextConfigImpl(const envoy::api::v2::UpstreamTlsContext& config,
+                          uint32_t max_session_cache_size = 0);
+  ClientContextConfigImpl(const Json::Object& config, uint32_t max_session_cache_size = 0);
 
   // Ssl::ClientContextConfig
   const std::string& serverNameIndication() const override { return server_name_indication_; }
+  uint32_t maxSessionCacheSize() const override { return max_session_cache_size_; }
 
 private:
   const std::string server_name_indication_;
+  const uint32_t max_session_cache_size_;
 };
 
 class ServerContextConfigImpl : public ContextConfigImpl, public ServerContextConfig {
 public:
-  ServerContextConfigImpl(const envoy::api::v2::DownstreamTlsContext& config);
+  ServerContextConfigImpl(const envoy::api::v2::DownstreamTlsContext& config,
+                          const DynamicRecordSizing& dynamic_record_sizing = {},
+                          bool kernel_tls = false);
   ServerContextConfigImpl(const Json::Object& config);
 
   // Ssl::ServerContextConfig
   bool requireClientCertificate() const override { return require_client_certificate_; }
+  const std::vector<std::string>& sessionTicketKeyPaths() const override {
+    return session_ticket_key_paths_;
+  }
+  const std::vector<CertificateFiles>& sniCertificates() const override {
+    return sni_certificates_;
+  }
+  const DynamicRecordSizing& dynamicRecordSizing() const override {
+    return dynamic_record_sizing_;
+  }
+  bool kernelTls() const override { return kernel_tls_; }
 
 private:
+  static std::vector<std::string>
+  getSessionTicketKeyPaths(const envoy::api::v2::DownstreamTlsContext& config);
+  static std::vector<CertificateFiles>
+  getSniCertificates(const envoy::api::v2::DownstreamTlsContext& config);
+
   const bool require_client_certificate_;
+  const std::vector<std::string> session_ticket_key_paths_;
+  const std::vector<CertificateFiles> sni_certificates_;
+  const DynamicRecordSizing dynamic_record_sizing_;
+  const bool kernel_tls_;
 };
 
 } // namespace Ssl
@@ -1,6 +1,8 @@
 #include "common/ssl/context_impl.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <memory>
 #include <string>
 #include <vector>
@@ -10,13 +12,81 @@
 
 #include "common/common/assert.h"
 #include "common/common/hex.h"
+#include "common/common/macros.h"
+#include "common/filesystem/filesystem_impl.h"
 
 #include "fmt/format.h"
+#include "openssl/evp.h"
+#include "openssl/hmac.h"
+#include "openssl/rand.h"
 #include "openssl/x509v3.h"
 
 namespace Envoy {
 namespace Ssl {
 
+namespace {
+
+/**
+ * The configuration of the context of an SNI certificate, which is that of the listener context
+ * with the certificate in place of the default one.
+ */
+class SniCertificateConfig : public ServerContextConfig {
+public:
+  SniCertificateConfig(const ServerContextConfig& config, const CertificateFiles& certificate)
+      : config_(config), certificate_(certificate) {}
+
+  // Ssl::ContextConfig
+  const std::string& alpnProtocols() const override { return config_.alpnProtocols(); }
+  const std::string& altAlpnProtocols() const override { return config_.altAlpnProtocols(); }
+  const std::string& cipherSuites() const override { return config_.cipherSuites(); }
+  const std::string& ecdhCurves() const override { return config_.ecdhCurves(); }
+  const std::string& caCertFile() const override { return config_.caCertFile(); }
+  const std::string& certChainFile() const override { return certificate_.cert_chain_file_; }
+  const std::string& privateKeyFile() const override { return certificate_.private_key_file_; }
+  const std::vector<std::string>& verifySubjectAltNameList() const override {
+    return config_.verifySubjectAltNameList();
+  }
+  const std::string& verifyCertificateHash() const override {
+    return config_.verifyCertificateHash();
+  }
+
+  // Ssl::ServerContextConfig
+  bool requireClientCertificate() const override { return config_.requireClientCertificate(); }
+  const std::vector<std::string>& sessionTicketKeyPaths() const override {
+    return config_.sessionTicketKeyPaths();
+  }
+  const std::vector<CertificateFiles>& sniCertificates() const override {
+    static const std::vector<CertificateFiles> no_certificates;
+    return no_certificates;
+  }
+  const DynamicRecordSizing& dynamicRecordSizing() const override {
+    return config_.dynamicRecordSizing();
+  }
+  bool kernelTls() const override { return config_.kernelTls(); }
+
+private:
+  const ServerContextConfig& config_;
+  const CertificateFiles& certificate_;
+};
+
+void toLowerCase(std::string& value) {
+  std::transform(value.begin(), value.end(), value.begin(),
+                 [](char c) -> char { return std::tolower(static_cast<unsigned char>(c)); });
+}
+
+/**
+ * @return uint32_t a number that is handed out round robin to the threads that connect with the
+ *         client contexts, and that stays the same for each thread. It picks the session cache
+ *         shard of the thread.
+ */
+uint32_t threadShardIndex() {
+  static std::atomic<uint32_t> next_index{};
+  static thread_local const uint32_t index = next_index++;
+  return index;
+}
+
+} // namespace
+
 const unsigned char ContextImpl::SERVER_SESSION_ID_CONTEXT = 1;
 
 ContextImpl::ContextImpl(ContextManagerImpl& parent, Stats::Scope& scope, ContextConfig& config)
@@ -92,6 +162,48 @@ ContextImpl::ContextImpl(ContextManagerImpl& parent, Stats::Scope& scope, Contex
   parsed_alpn_protocols_ = parseAlpnProtocols(config.alpnProtocols());
 }
 
+const SSL_PRIVATE_KEY_METHOD* ContextImpl::privateKeyMethod() {
+  static const SSL_PRIVATE_KEY_METHOD* method = []() -> const SSL_PRIVATE_KEY_METHOD* {
+    SSL_PRIVATE_KEY_METHOD* method = new SSL_PRIVATE_KEY_METHOD();
+    method->sign = privateKeySign;
+    method->decrypt = privateKeyDecrypt;
+    method->complete = privateKeyComplete;
+    return method;
+  }();
+  return method;
+}
+
+ssl_private_key_result_t ContextImpl::privateKeySign(SSL* ssl, uint8_t*, size_t*, size_t,
+                                                     uint16_t signature_algorithm,
+                                                     const uint8_t* in, size_t in_len) {
+  PrivateKeyOperationState* state = static_cast<PrivateKeyOperationState*>(SSL_get_app_data(ssl));
+  ASSERT(state->operation_ == nullptr);
+  // The key is that of the certificate being served, which SNI may have changed.
+  state->operation_ = state->provider_.sign(*SSL_get_privatekey(ssl), signature_algorithm, in,
+                                            in_len, state->dispatcher_, state->callbacks_);
+  return state->operation_ ? ssl_private_key_retry : ssl_private_key_failure;
+}
+
+ssl_private_key_result_t ContextImpl::privateKeyDecrypt(SSL* ssl, uint8_t*, size_t*, size_t,
+                                                        const uint8_t* in, size_t in_len) {
+  PrivateKeyOperationState* state = static_cast<PrivateKeyOperationState*>(SSL_get_app_data(ssl));
+  ASSERT(state->operation_ == nullptr);
+  state->operation_ = state->provider_.decrypt(*SSL_get_privatekey(ssl), in, in_len,
+                                               state->dispatcher_, state->callbacks_);
+  return state->operation_ ? ssl_private_key_retry : ssl_private_key_failure;
+}
+
+ssl_private_key_result_t ContextImpl::privateKeyComplete(SSL* ssl, uint8_t* out, size_t* out_len,
+                                                         size_t max_out) {
+  PrivateKeyOperationState* state = static_cast<PrivateKeyOperationState*>(SSL_get_app_data(ssl));
+  ASSERT(state->operation_ != nullptr);
+  ssl_private_key_result_t result = state->operation_->complete(out, out_len, max_out);
+  if (result != ssl_private_key_retry) {
+    state->operation_.reset();
+  }
+  return result;
+}
+
 int ServerContextImpl::alpnSelectCallback(const unsigned char** out, unsigned char* outlen,
                                           const unsigned char* in, unsigned int inlen) {
   // Currently this uses the standard selection algorithm in priority order.
@@ -182,6 +294,10 @@ void ContextImpl::logHandshake(SSL* ssl) const {
   if (!cert.get()) {
     stats_.no_certificate_.inc();
   }
+
+  if (SSL_session_reused(ssl)) {
+    stats_.session_reused_.inc();
+  }
 }
 
 bool ContextImpl::verifySubjectAltName(X509* cert,
@@ -320,7 +436,8 @@ bssl::UniquePtr<X509> ContextImpl::loadCert(const std::string& cert_file) {
 
 ClientContextImpl::ClientContextImpl(ContextManagerImpl& parent, Stats::Scope& scope,
                                      ClientContextConfig& config)
-    : ContextImpl(parent, scope, config) {
+    : ContextImpl(parent, scope, config),
+      max_session_cache_size_(config.maxSessionCacheSize()) {
   if (!parsed_alpn_protocols_.empty()) {
     int rc = SSL_CTX_set_alpn_protos(ctx_.get(), &parsed_alpn_protocols_[0],
                                      parsed_alpn_protocols_.size());
@@ -329,6 +446,19 @@ ClientContextImpl::ClientContextImpl(ContextManagerImpl& parent, Stats::Scope& s
   }
 
   server_name_indication_ = config.serverNameIndication();
+
+  if (max_session_cache_size_ > 0) {
+    // The internal cache of the SSL_CTX finds sessions by their id, which a client does not know
+    // before it resumes one, so the sessions are only kept by server address in session_caches_.
+    session_caches_.reset(new SessionCache[SESSION_CACHE_SHARDS]);
+    SSL_CTX_set_session_cache_mode(ctx_.get(), SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL);
+    SSL_CTX_set_app_data(ctx_.get(), this);
+    SSL_CTX_sess_set_new_cb(ctx_.get(), [](SSL* ssl, SSL_SESSION* session) -> int {
+      ClientContextImpl* context_impl =
+          static_cast<ClientContextImpl*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+      return context_impl->newSession(ssl, session);
+    });
+  }
 }
 
 bssl::UniquePtr<SSL> ClientContextImpl::newSsl() const {
@@ -343,9 +473,67 @@ bssl::UniquePtr<SSL> ClientContextImpl::newSsl() const {
   return ssl_con;
 }
 
+void ClientContextImpl::resumeSession(SSL* ssl, const std::string& session_key) {
+  if (!session_caches_) {
+    return;
+  }
+
+  SSL_set_ex_data(ssl, sessionKeyIndex(), const_cast<std::string*>(&session_key));
+  SessionCache& cache = sessionCache();
+  std::unique_lock<std::mutex> lock(cache.lock_);
+  auto session = cache.sessions_.find(session_key);
+  if (session == cache.sessions_.end()) {
+    stats_.session_cache_miss_.inc();
+    return;
+  }
+
+  // The session stays cached until the server issues a newer one, which replaces it.
+  stats_.session_cache_hit_.inc();
+  int rc = SSL_set_session(ssl, session->second.get());
+  RELEASE_ASSERT(rc == 1);
+  UNREFERENCED_PARAMETER(rc);
+}
+
+int ClientContextImpl::sessionKeyIndex() {
+  CONSTRUCT_ON_FIRST_USE(int, SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr));
+}
+
+ClientContextImpl::SessionCache& ClientContextImpl::sessionCache() {
+  return session_caches_[threadShardIndex() % SESSION_CACHE_SHARDS];
+}
+
+int ClientContextImpl::newSession(SSL* ssl, SSL_SESSION* session) {
+  const std::string* session_key =
+      static_cast<const std::string*>(SSL_get_ex_data(ssl, sessionKeyIndex()));
+  if (session_key == nullptr) {
+    return 0;
+  }
+
+  // Sessions are issued during the reads of the connection, on the thread that resumed it.
+  SessionCache& cache = sessionCache();
+  std::unique_lock<std::mutex> lock(cache.lock_);
+  auto existing = cache.sessions_.find(*session_key);
+  if (existing != cache.sessions_.end()) {
+    existing->second.reset(session);
+    return 1;
+  }
+
+  if (cache.sessions_.size() >= max_session_cache_size_) {
+    // The next connection to the server of the evicted session does a full handshake.
+    cache.sessions_.erase(cache.sessions_.begin());
+  }
+  cache.sessions_.emplace(*session_key, bssl::UniquePtr<SSL_SESSION>(session));
+  // The cache holds the reference to the session that the callback is handed.
+  return 1;
+}
+
 ServerContextImpl::ServerContextImpl(ContextManagerImpl& parent, Stats::Scope& scope,
                                      ServerContextConfig& config, Runtime::Loader& runtime)
-    : ContextImpl(parent, scope, config), runtime_(runtime) {
+    : ContextImpl(parent, scope, config), runtime_(runtime),
+      session_ticket_key_paths_(config.sessionTicketKeyPaths()) {
+  dynamic_record_sizing_ = config.dynamicRecordSizing();
+  kernel_tls_ = config.kernelTls();
+
   if (!config.caCertFile().empty()) {
     bssl::UniquePtr<STACK_OF(X509_NAME)> list(SSL_load_client_CA_file(config.caCertFile().c_str()));
     if (nullptr == list) {
@@ -359,6 +547,12 @@ ServerContextImpl::ServerContextImpl(ContextManagerImpl& parent, Stats::Scope& s
     }
   }
 
+  // The key stays loaded in the context, the provider only decides where the operations run.
+  if (!config.certChainFile().empty() && parent.privateKeyOperationProvider() != nullptr) {
+    private_key_provider_ = parent.privateKeyOperationProvider();
+    SSL_CTX_set_private_key_method(ctx_.get(), privateKeyMethod());
+  }
+
   parsed_alt_alpn_protocols_ = parseAlpnProtocols(config.altAlpnProtocols());
 
   if (!parsed_alpn_protocols_.empty()) {
@@ -370,6 +564,175 @@ ServerContextImpl::ServerContextImpl(ContextManagerImpl& parent, Stats::Scope& s
                                },
                                this);
   }
+
+  if (!session_ticket_key_paths_.empty()) {
+    reloadSessionTicketKeys();
+    SSL_CTX_set_app_data(ctx_.get(), this);
+    SSL_CTX_set_tlsext_ticket_key_cb(
+        ctx_.get(), [](SSL* ssl, uint8_t* key_name, uint8_t* iv, EVP_CIPHER_CTX* ctx,
+                       HMAC_CTX* hmac_ctx, int encrypt) -> int {
+          ServerContextImpl* context_impl =
+              static_cast<ServerContextImpl*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+          return context_impl->sessionTicketProcess(key_name, iv, ctx, hmac_ctx, encrypt);
+        });
+  }
+
+  // The connection switches to the context of the SNI certificate, keeping the session cache and
+  // the session ticket keys of this one. Every SNI context is built from the same configuration as
+  // this one, since the rest of the handshake uses the callbacks of the context it switched to.
+  for (const CertificateFiles& certificate : config.sniCertificates()) {
+    SniCertificateConfig sni_config(config, certificate);
+    addSniContext(parent.createSslServerContext(scope, sni_config));
+  }
+  if (!sni_contexts_.empty()) {
+    SSL_CTX_set_tlsext_servername_callback(ctx_.get(), [](SSL* ssl, int*, void* arg) -> int {
+      const char* server_name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+      if (server_name != nullptr) {
+        SSL_CTX* ctx = static_cast<ServerContextImpl*>(arg)->findSniContext(server_name);
+        if (ctx != nullptr) {
+          SSL_set_SSL_CTX(ssl, ctx);
+        }
+      }
+      return SSL_TLSEXT_ERR_OK;
+    });
+    SSL_CTX_set_tlsext_servername_arg(ctx_.get(), this);
+  }
+}
+
+void ServerContextImpl::addSniContext(ServerContextPtr&& context) {
+  ServerContextImpl& context_impl = dynamic_cast<ServerContextImpl&>(*context);
+  X509* cert = context_impl.cert_chain_.get();
+  std::vector<std::string> names;
+  STACK_OF(GENERAL_NAME)* altnames = static_cast<STACK_OF(GENERAL_NAME)*>(
+      X509_get_ext_d2i(cert, NID_subject_alt_name, nullptr, nullptr));
+  if (altnames) {
+    for (size_t i = 0; i < sk_GENERAL_NAME_num(altnames); i++) {
+      GENERAL_NAME* altname = sk_GENERAL_NAME_value(altnames, i);
+      if (altname->type == GEN_DNS) {
+        ASN1_STRING* str = altname->d.dNSName;
+        names.emplace_back(reinterpret_cast<const char*>(ASN1_STRING_data(str)),
+                           ASN1_STRING_length(str));
+      }
+    }
+    sk_GENERAL_NAME_pop_free(altnames, GENERAL_NAME_free);
+  }
+
+  if (names.empty()) {
+    X509_NAME* subject = X509_get_subject_name(cert);
+    const int index = X509_NAME_get_index_by_NID(subject, NID_commonName, -1);
+    if (index >= 0) {
+      ASN1_STRING* str = X509_NAME_ENTRY_get_data(X509_NAME_get_entry(subject, index));
+      names.emplace_back(reinterpret_cast<const char*>(ASN1_STRING_data(str)),
+                         ASN1_STRING_length(str));
+    }
+  }
+
+  // Earlier certificates win a name.
+  for (std::string& name : names) {
+    toLowerCase(name);
+    if (name.compare(0, 2, "*.") == 0) {
+      sni_wildcard_contexts_.emplace(name.substr(2), context_impl.ctx_.get());
+    } else {
+      sni_exact_contexts_.emplace(name, context_impl.ctx_.get());
+    }
+  }
+  sni_contexts_.push_back(std::move(context));
+}
+
+SSL_CTX* ServerContextImpl::findSniContext(const char* server_name) const {
+  // Reused by the handshakes of the thread, so that the lookups do not allocate.
+  static thread_local std::string name;
+  name.assign(server_name);
+  toLowerCase(name);
+
+  auto exact = sni_exact_contexts_.find(name);
+  if (exact != sni_exact_contexts_.end()) {
+    return exact->second;
+  }
+
+  // A wildcard only matches the first label.
+  const size_t dot = name.find('.');
+  if (dot == std::string::npos || sni_wildcard_contexts_.empty()) {
+    return nullptr;
+  }
+  name.erase(0, dot + 1);
+  auto wildcard = sni_wildcard_contexts_.find(name);
+  return wildcard != sni_wildcard_contexts_.end() ? wildcard->second : nullptr;
+}
+
+void ServerContextImpl::reloadSessionTicketKeys() {
+  auto keys = std::make_shared<std::vector<SessionTicketKey>>();
+  for (const std::string& path : session_ticket_key_paths_) {
+    keys->push_back(loadSessionTicketKey(path));
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(session_ticket_keys_lock_);
+    session_ticket_keys_ = keys;
+  }
+
+  // The ticket callback finds the keys through the context the connection switched to.
+  for (ServerContextPtr& context : sni_contexts_) {
+    context->reloadSessionTicketKeys();
+  }
+}
+
+ServerContextImpl::SessionTicketKey
+ServerContextImpl::loadSessionTicketKey(const std::string& path) {
+  const std::string key_data = Filesystem::fileReadToEnd(path);
+  SessionTicketKey key;
+  const size_t expected_size = key.name_.size() + key.hmac_key_.size() + key.aes_key_.size();
+  if (key_data.size() != expected_size) {
+    throw EnvoyException(fmt::format("invalid TLS session ticket key length in {}: {}, expected {}",
+                                     path, key_data.size(), expected_size));
+  }
+
+  auto data = key_data.begin();
+  std::copy_n(data, key.name_.size(), key.name_.begin());
+  data += key.name_.size();
+  std::copy_n(data, key.hmac_key_.size(), key.hmac_key_.begin());
+  data += key.hmac_key_.size();
+  std::copy_n(data, key.aes_key_.size(), key.aes_key_.begin());
+  return key;
+}
+
+int ServerContextImpl::sessionTicketProcess(uint8_t* key_name, uint8_t* iv, EVP_CIPHER_CTX* ctx,
+                                            HMAC_CTX* hmac_ctx, int encrypt) {
+  SessionTicketKeysConstSharedPtr keys;
+  {
+    std::unique_lock<std::mutex> lock(session_ticket_keys_lock_);
+    keys = session_ticket_keys_;
+  }
+
+  const EVP_MD* hash = EVP_sha256();
+  const EVP_CIPHER* cipher = EVP_aes_256_cbc();
+  if (encrypt == 1) {
+    // New tickets are always encrypted with the first key.
+    const SessionTicketKey& key = keys->front();
+    std::copy(key.name_.begin(), key.name_.end(), key_name);
+    if (!RAND_bytes(iv, EVP_CIPHER_iv_length(cipher)) ||
+        !EVP_EncryptInit_ex(ctx, cipher, nullptr, key.aes_key_.data(), iv) ||
+        !HMAC_Init_ex(hmac_ctx, key.hmac_key_.data(), key.hmac_key_.size(), hash, nullptr)) {
+      return -1;
+    }
+    return 1;
+  }
+
+  for (const SessionTicketKey& key : *keys) {
+    if (!std::equal(key.name_.begin(), key.name_.end(), key_name)) {
+      continue;
+    }
+
+    if (!HMAC_Init_ex(hmac_ctx, key.hmac_key_.data(), key.hmac_key_.size(), hash, nullptr) ||
+        !EVP_DecryptInit_ex(ctx, cipher, nullptr, key.aes_key_.data(), iv)) {
+      return -1;
+    }
+    // A ticket that is not encrypted with the current key is renewed.
+    return &key == &keys->front() ? 1 : 2;
+  }
+
+  // The ticket was encrypted with a key that has been rotated out, so a full handshake is done.
+  return 0;
 }
 
 } // namespace Ssl
@@ -1,17 +1,24 @@
 #pragma once
 
+#include <array>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "envoy/event/dispatcher.h"
 #include "envoy/runtime/runtime.h"
 #include "envoy/ssl/context.h"
 #include "envoy/ssl/context_config.h"
+#include "envoy/ssl/private_key.h"
 #include "envoy/stats/stats.h"
 #include "envoy/stats/stats_macros.h"
 
 #include "common/ssl/context_impl.h"
 #include "common/ssl/context_manager_impl.h"
 
+#include "openssl/sha.h"
 #include "openssl/ssl.h"
 
 namespace Envoy {
@@ -29,7 +36,14 @@ namespace Ssl {
   COUNTER(fail_verify_no_cert)                                                                     \
   COUNTER(fail_verify_error)                                                                       \
   COUNTER(fail_verify_san)                                                                         \
-  COUNTER(fail_verify_cert_hash)
+  COUNTER(fail_verify_cert_hash)                                                                   \
+  COUNTER(session_reused)                                                                          \
+  COUNTER(session_cache_hit)                                                                       \
+  COUNTER(session_cache_miss)                                                                      \
+  COUNTER(small_record)                                                                            \
+  COUNTER(record_size_ramped)                                                                      \
+  COUNTER(kernel_tls)                                                                              \
+  COUNTER(kernel_tls_fallback)
 // clang-format on
 
 /**
@@ -39,6 +53,21 @@ struct SslStats {
   ALL_SSL_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT, GENERATE_TIMER_STRUCT)
 };
 
+/**
+ * The private key operation of a handshake, for connections whose context has a private key
+ * operation provider. It is the app data of the SSL of the connection.
+ */
+struct PrivateKeyOperationState {
+  PrivateKeyOperationState(PrivateKeyOperationProvider& provider, Event::Dispatcher& dispatcher,
+                           PrivateKeyOperationCallbacks& callbacks)
+      : provider_(provider), dispatcher_(dispatcher), callbacks_(callbacks) {}
+
+  PrivateKeyOperationProvider& provider_;
+  Event::Dispatcher& dispatcher_;
+  PrivateKeyOperationCallbacks& callbacks_;
+  PrivateKeyOperationPtr operation_;
+};
+
 class ContextImpl : public virtual Context {
 public:
   ~ContextImpl() { parent_.releaseContext(this); }
@@ -70,6 +99,25 @@ public:
 
   SslStats& stats() { return stats_; }
 
+  /**
+   * @return the provider that runs the private key operations of the handshakes, or nullptr if
+   *         they run inline.
+   */
+  PrivateKeyOperationProvider* privateKeyOperationProvider() const {
+    return private_key_provider_.get();
+  }
+
+  /**
+   * @return the sizing of the TLS records written to the connections.
+   */
+  const DynamicRecordSizing& dynamicRecordSizing() const { return dynamic_record_sizing_; }
+
+  /**
+   * @return whether established connections try to hand their record encryption over to the
+   *         kernel.
+   */
+  bool kernelTls() const { return kernel_tls_; }
+
   // Ssl::Context
   size_t daysUntilFirstCertExpires() override;
   std::string getCaCertInformation() override;
@@ -84,6 +132,21 @@ protected:
    */
   static const unsigned char SERVER_SESSION_ID_CONTEXT;
 
+  /**
+   * The private key method of contexts with a private key operation provider. It starts the
+   * operations with the provider and copies their results when they complete.
+   * @see PrivateKeyOperationState.
+   */
+  static const SSL_PRIVATE_KEY_METHOD* privateKeyMethod();
+  static ssl_private_key_result_t privateKeySign(SSL* ssl, uint8_t* out, size_t* out_len,
+                                                 size_t max_out, uint16_t signature_algorithm,
+                                                 const uint8_t* in, size_t in_len);
+  static ssl_private_key_result_t privateKeyDecrypt(SSL* ssl, uint8_t* out, size_t* out_len,
+                                                    size_t max_out, const uint8_t* in,
+                                                    size_t in_len);
+  static ssl_private_key_result_t privateKeyComplete(SSL* ssl, uint8_t* out, size_t* out_len,
+                                                     size_t max_out);
+
   static int verifyCallback(X509_STORE_CTX* store_ctx, void* arg);
   int verifyCertificate(X509* cert);
 
@@ -118,6 +181,9 @@ protected:
   bssl::UniquePtr<X509> cert_chain_;
   std::string ca_file_path_;
   std::string cert_chain_file_path_;
+  PrivateKeyOperationProviderSharedPtr private_key_provider_;
+  DynamicRecordSizing dynamic_record_sizing_;
+  bool kernel_tls_{};
 };
 
 class ClientContextImpl : public ContextImpl, public ClientContext {
@@ -126,8 +192,37 @@ public:
 
   bssl::UniquePtr<SSL> newSsl() const override;
 
+  /**
+   * Offers a connection the session that was cached last for its server address by the thread, if
+   * any, and caches the sessions that the server issues to the connection.
+   * @param ssl supplies the connection, before its handshake.
+   * @param session_key supplies the server address, which must outlive the SSL.
+   */
+  void resumeSession(SSL* ssl, const std::string& session_key);
+
 private:
+  /**
+   * The sessions cached by some of the threads that connect with the context, by server address.
+   * The cache is sharded by thread, so that each worker mostly has a shard of its own.
+   */
+  struct SessionCache {
+    std::mutex lock_;
+    std::unordered_map<std::string, bssl::UniquePtr<SSL_SESSION>> sessions_;
+  };
+
+  static const uint32_t SESSION_CACHE_SHARDS = 16;
+
+  /**
+   * @return int the index of the ex data of the SSL that points to the session key of the
+   *         connection, @see resumeSession().
+   */
+  static int sessionKeyIndex();
+  SessionCache& sessionCache();
+  int newSession(SSL* ssl, SSL_SESSION* session);
+
   std::string server_name_indication_;
+  const uint32_t max_session_cache_size_;
+  std::unique_ptr<SessionCache[]> session_caches_;
 };
 
 class ServerContextImpl : public ContextImpl, public ServerContext {
@@ -135,12 +230,40 @@ public:
   ServerContextImpl(ContextManagerImpl& parent, Stats::Scope& scope, ServerContextConfig& config,
                     Runtime::Loader& runtime);
 
+  // Ssl::ServerContext
+  void reloadSessionTicketKeys() override;
+
 private:
+  /**
+   * A session ticket key file holds the name of the key, its HMAC secret and its AES secret.
+   */
+  struct SessionTicketKey {
+    std::array<uint8_t, SSL_TICKET_KEY_NAME_LEN> name_;
+    std::array<uint8_t, SHA256_DIGEST_LENGTH> hmac_key_;
+    std::array<uint8_t, 256 / 8> aes_key_;
+  };
+
+  typedef std::shared_ptr<const std::vector<SessionTicketKey>> SessionTicketKeysConstSharedPtr;
+
   int alpnSelectCallback(const unsigned char** out, unsigned char* outlen, const unsigned char* in,
                          unsigned int inlen);
+  void addSniContext(ServerContextPtr&& context);
+  SSL_CTX* findSniContext(const char* server_name) const;
+  int sessionTicketProcess(uint8_t* key_name, uint8_t* iv, EVP_CIPHER_CTX* ctx, HMAC_CTX* hmac_ctx,
+                           int encrypt);
+  static SessionTicketKey loadSessionTicketKey(const std::string& path);
 
   Runtime::Loader& runtime_;
   std::vector<uint8_t> parsed_alt_alpn_protocols_;
+  const std::vector<std::string> session_ticket_key_paths_;
+  // Replaced on the main thread when the keys are reloaded, read by the workers during handshakes.
+  SessionTicketKeysConstSharedPtr session_ticket_keys_;
+  std::mutex session_ticket_keys_lock_;
+  // The contexts of the SNI certificates, and their contexts by exact name and by the domain of
+  // their wildcard names. The names are lower case.
+  std::vector<ServerContextPtr> sni_contexts_;
+  std::unordered_map<std::string, SSL_CTX*> sni_exact_contexts_;
+  std::unordered_map<std::string, SSL_CTX*> sni_wildcard_contexts_;
 };
 
 } // Ssl
@@ -6,6 +6,7 @@
 
 #include "envoy/runtime/runtime.h"
 #include "envoy/ssl/context_manager.h"
+#include "envoy/ssl/private_key.h"
 
 namespace Envoy {
 namespace Ssl {
@@ -19,9 +20,19 @@ namespace Ssl {
  */
 class ContextManagerImpl final : public ContextManager {
 public:
-  ContextManagerImpl(Runtime::Loader& runtime) : runtime_(runtime) {}
+  ContextManagerImpl(Runtime::Loader& runtime,
+                     PrivateKeyOperationProviderSharedPtr private_key_provider = nullptr)
+      : runtime_(runtime), private_key_provider_(private_key_provider) {}
   ~ContextManagerImpl();
 
+  /**
+   * @return the provider that runs the private key operations of server handshakes, or nullptr if
+   *         they run on the thread of the connection.
+   */
+  const PrivateKeyOperationProviderSharedPtr& privateKeyOperationProvider() const {
+    return private_key_provider_;
+  }
+
   /**
    * Allocated contexts are owned by the caller. However, we need to be able to iterate them for
    * admin purposes. When a caller frees a context it will tell us to release it also from the list
@@ -39,6 +50,7 @@ public:
 
 private:
   Runtime::Loader& runtime_;
+  const PrivateKeyOperationProviderSharedPtr private_key_provider_;
   std::list<Context*> contexts_;
   std::mutex contexts_lock_;
 };
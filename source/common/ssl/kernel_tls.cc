@@ -0,0 +1,140 @@
+#include "common/ssl/kernel_tls.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/tls.h>
+#endif
+
+#include "common/common/macros.h"
+
+namespace Envoy {
+namespace Ssl {
+
+#if defined(__linux__) && defined(TLS_TX)
+
+namespace {
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+// The TLS 1.2 AES-GCM key block has no MAC keys, and only the implicit part of the nonces.
+// RFC 5246 section 6.3.
+constexpr size_t KEY_LENGTH = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+constexpr size_t SALT_LENGTH = TLS_CIPHER_AES_GCM_128_SALT_SIZE;
+constexpr size_t KEY_BLOCK_LENGTH = 2 * (KEY_LENGTH + SALT_LENGTH);
+
+void setSequence(uint64_t sequence, unsigned char* out) {
+  for (int i = 7; i >= 0; i--) {
+    out[i] = sequence & 0xff;
+    sequence >>= 8;
+  }
+}
+
+bool installDirection(int fd, int direction, const uint8_t* key, const uint8_t* salt,
+                      uint64_t sequence) {
+  tls12_crypto_info_aes_gcm_128 crypto_info;
+  memset(&crypto_info, 0, sizeof(crypto_info));
+  crypto_info.info.version = TLS_1_2_VERSION;
+  crypto_info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+  memcpy(crypto_info.key, key, KEY_LENGTH);
+  memcpy(crypto_info.salt, salt, SALT_LENGTH);
+  setSequence(sequence, crypto_info.rec_seq);
+  // The explicit part of the nonces is the sequence number, as BoringSSL writes it.
+  setSequence(sequence, crypto_info.iv);
+  int rc = setsockopt(fd, SOL_TLS, direction, &crypto_info, sizeof(crypto_info));
+  memset(&crypto_info, 0, sizeof(crypto_info));
+  return rc == 0;
+}
+
+} // namespace
+
+KernelTls::Offload KernelTls::install(SSL& ssl, int fd) {
+  Offload offload;
+  if (SSL_version(&ssl) != TLS1_2_VERSION || SSL_pending(&ssl) != 0) {
+    return offload;
+  }
+  const SSL_CIPHER* cipher = SSL_get_current_cipher(&ssl);
+  if (cipher == nullptr || !SSL_CIPHER_is_AES128GCM(cipher) ||
+      SSL_get_key_block_len(&ssl) != KEY_BLOCK_LENGTH) {
+    return offload;
+  }
+
+  std::vector<uint8_t> key_block(KEY_BLOCK_LENGTH);
+  if (!SSL_generate_key_block(&ssl, key_block.data(), key_block.size())) {
+    return offload;
+  }
+  const uint8_t* client_key = key_block.data();
+  const uint8_t* server_key = client_key + KEY_LENGTH;
+  const uint8_t* client_salt = server_key + KEY_LENGTH;
+  const uint8_t* server_salt = client_salt + SALT_LENGTH;
+  const bool server = SSL_is_server(&ssl);
+
+  static const char ulp[] = "tls";
+  if (setsockopt(fd, SOL_TCP, TCP_ULP, ulp, sizeof(ulp)) == 0) {
+    offload.tx_ = installDirection(fd, TLS_TX, server ? server_key : client_key,
+                                   server ? server_salt : client_salt,
+                                   SSL_get_write_sequence(&ssl));
+  }
+#ifdef TLS_RX
+  if (offload.tx_) {
+    offload.rx_ = installDirection(fd, TLS_RX, server ? client_key : server_key,
+                                   server ? client_salt : server_salt,
+                                   SSL_get_read_sequence(&ssl));
+  }
+#endif
+
+  std::fill(key_block.begin(), key_block.end(), 0);
+  return offload;
+}
+
+bool KernelTls::sendCloseNotify(int fd) {
+#ifdef TLS_SET_RECORD_TYPE
+  // An alert record is written by giving its content type in a control message.
+  static const unsigned char ALERT = 21;
+  static const unsigned char CLOSE_NOTIFY[] = {1 /* warning */, 0 /* close_notify */};
+  char control[CMSG_SPACE(sizeof(ALERT))];
+  memset(control, 0, sizeof(control));
+  iovec iov{const_cast<unsigned char*>(CLOSE_NOTIFY), sizeof(CLOSE_NOTIFY)};
+  msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  cmsghdr* header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_TLS;
+  header->cmsg_type = TLS_SET_RECORD_TYPE;
+  header->cmsg_len = CMSG_LEN(sizeof(ALERT));
+  *CMSG_DATA(header) = ALERT;
+  return sendmsg(fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL) ==
+         static_cast<ssize_t>(sizeof(CLOSE_NOTIFY));
+#else
+  // Older kernels cannot write records other than application data.
+  UNREFERENCED_PARAMETER(fd);
+  return false;
+#endif
+}
+
+#else
+
+KernelTls::Offload KernelTls::install(SSL&, int) { return {}; }
+
+bool KernelTls::sendCloseNotify(int) { return false; }
+
+#endif
+
+} // namespace Ssl
+} // namespace Envoy
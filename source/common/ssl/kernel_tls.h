@@ -0,0 +1,43 @@
+#pragma once
+
+#include "openssl/ssl.h"
+
+namespace Envoy {
+namespace Ssl {
+
+/**
+ * Hands the record encryption of established TLS connections over to the kernel (kTLS), so that
+ * plaintext can be read and written on their sockets.
+ */
+class KernelTls {
+public:
+  /**
+   * The directions of a connection whose records are handled by the kernel.
+   */
+  struct Offload {
+    bool tx_{};
+    bool rx_{};
+  };
+
+  /**
+   * Install the negotiated keys of a connection in the kernel. Only TLS 1.2 with AES-128-GCM is
+   * supported. Nothing is installed if the kernel does not support the transmit direction, and
+   * the receive direction is only installed on top of it. Once a direction is installed, the SSL
+   * must not be used for it any more.
+   * @param ssl supplies the connection, which must have completed its handshake and have no
+   *        buffered data.
+   * @param fd supplies the socket of the connection.
+   * @return the directions that were installed.
+   */
+  static Offload install(SSL& ssl, int fd);
+
+  /**
+   * Send a close_notify alert on a socket whose transmit direction is handled by the kernel.
+   * @param fd supplies the socket of the connection.
+   * @return whether the alert was queued on the socket.
+   */
+  static bool sendCloseNotify(int fd);
+};
+
+} // namespace Ssl
+} // namespace Envoy
@@ -0,0 +1,176 @@
+#include "common/ssl/private_key_operation_impl.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "common/common/assert.h"
+
+#include "openssl/evp.h"
+#include "openssl/rsa.h"
+
+namespace Envoy {
+namespace Ssl {
+
+ThreadPoolPrivateKeyOperationProvider::ThreadPoolPrivateKeyOperationProvider(uint32_t threads) {
+  ASSERT(threads > 0);
+  for (uint32_t i = 0; i < threads; i++) {
+    threads_.emplace_back(new Thread::Thread([this]() -> void { threadRoutine(); }));
+  }
+}
+
+ThreadPoolPrivateKeyOperationProvider::~ThreadPoolPrivateKeyOperationProvider() {
+  {
+    std::unique_lock<std::mutex> lock(queue_lock_);
+    shutdown_ = true;
+  }
+  queue_event_.notify_all();
+  for (Thread::ThreadPtr& thread : threads_) {
+    thread->join();
+  }
+}
+
+PrivateKeyOperationPtr ThreadPoolPrivateKeyOperationProvider::sign(
+    EVP_PKEY& key, uint16_t signature_algorithm, const uint8_t* in, size_t in_len,
+    Event::Dispatcher& dispatcher, PrivateKeyOperationCallbacks& callbacks) {
+  // The key is referenced rather than borrowed, in case the context goes away first.
+  EVP_PKEY_up_ref(&key);
+  std::shared_ptr<EVP_PKEY> shared_key(&key, EVP_PKEY_free);
+  std::vector<uint8_t> input(in, in + in_len);
+  return start(
+      [shared_key, signature_algorithm, input](std::vector<uint8_t>& out) -> bool {
+        return sign(*shared_key, signature_algorithm, input.data(), input.size(), out);
+      },
+      dispatcher, callbacks);
+}
+
+PrivateKeyOperationPtr ThreadPoolPrivateKeyOperationProvider::decrypt(
+    EVP_PKEY& key, const uint8_t* in, size_t in_len, Event::Dispatcher& dispatcher,
+    PrivateKeyOperationCallbacks& callbacks) {
+  EVP_PKEY_up_ref(&key);
+  std::shared_ptr<EVP_PKEY> shared_key(&key, EVP_PKEY_free);
+  std::vector<uint8_t> input(in, in + in_len);
+  return start([shared_key, input](std::vector<uint8_t>& out)
+                   -> bool { return decrypt(*shared_key, input.data(), input.size(), out); },
+               dispatcher, callbacks);
+}
+
+bool ThreadPoolPrivateKeyOperationProvider::sign(EVP_PKEY& key, uint16_t signature_algorithm,
+                                                 const uint8_t* in, size_t in_len,
+                                                 std::vector<uint8_t>& out) {
+  const EVP_MD* md = SSL_get_signature_algorithm_digest(signature_algorithm);
+  bssl::ScopedEVP_MD_CTX ctx;
+  EVP_PKEY_CTX* pkey_ctx;
+  if (md == nullptr || !EVP_DigestSignInit(ctx.get(), &pkey_ctx, md, nullptr, &key)) {
+    return false;
+  }
+
+  // Salt length -1 is the length of the digest, which is what TLS requires.
+  if (SSL_is_signature_algorithm_rsa_pss(signature_algorithm) &&
+      (!EVP_PKEY_CTX_set_rsa_padding(pkey_ctx, RSA_PKCS1_PSS_PADDING) ||
+       !EVP_PKEY_CTX_set_rsa_pss_saltlen(pkey_ctx, -1))) {
+    return false;
+  }
+
+  size_t out_len;
+  if (!EVP_DigestSign(ctx.get(), nullptr, &out_len, in, in_len)) {
+    return false;
+  }
+  out.resize(out_len);
+  if (!EVP_DigestSign(ctx.get(), out.data(), &out_len, in, in_len)) {
+    return false;
+  }
+  out.resize(out_len);
+  return true;
+}
+
+bool ThreadPoolPrivateKeyOperationProvider::decrypt(EVP_PKEY& key, const uint8_t* in,
+                                                    size_t in_len, std::vector<uint8_t>& out) {
+  RSA* rsa = EVP_PKEY_get0_RSA(&key);
+  if (rsa == nullptr) {
+    return false;
+  }
+
+  size_t out_len;
+  out.resize(RSA_size(rsa));
+  if (!RSA_decrypt(rsa, &out_len, out.data(), out.size(), in, in_len, RSA_NO_PADDING)) {
+    return false;
+  }
+  out.resize(out_len);
+  return true;
+}
+
+PrivateKeyOperationPtr
+ThreadPoolPrivateKeyOperationProvider::start(std::function<bool(std::vector<uint8_t>&)> work,
+                                             Event::Dispatcher& dispatcher,
+                                             PrivateKeyOperationCallbacks& callbacks) {
+  OperationStateSharedPtr state = std::make_shared<OperationState>(work, dispatcher, callbacks);
+  {
+    std::unique_lock<std::mutex> lock(queue_lock_);
+    queue_.push_back(state);
+  }
+  queue_event_.notify_one();
+  return PrivateKeyOperationPtr{new OperationImpl(state)};
+}
+
+void ThreadPoolPrivateKeyOperationProvider::threadRoutine() {
+  while (true) {
+    OperationStateSharedPtr state;
+    {
+      std::unique_lock<std::mutex> lock(queue_lock_);
+      queue_event_.wait(lock, [this]() -> bool { return shutdown_ || !queue_.empty(); });
+      if (shutdown_) {
+        return;
+      }
+      state = queue_.front();
+      queue_.pop_front();
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(state->lock_);
+      if (state->cancelled_) {
+        continue;
+      }
+    }
+
+    const bool success = state->work_(state->output_);
+
+    // The lock is held while posting so that the connection cannot cancel the operation and go
+    // away in between. The posted callback runs on the same thread as cancel(), so it only needs
+    // to check the flag again.
+    std::unique_lock<std::mutex> lock(state->lock_);
+    if (state->cancelled_) {
+      continue;
+    }
+    state->success_ = success;
+    state->dispatcher_.post([state]() -> void {
+      if (!state->cancelled_) {
+        state->done_ = true;
+        state->callbacks_.onPrivateKeyOperationComplete();
+      }
+    });
+  }
+}
+
+void ThreadPoolPrivateKeyOperationProvider::OperationImpl::cancel() {
+  std::unique_lock<std::mutex> lock(state_->lock_);
+  state_->cancelled_ = true;
+}
+
+ssl_private_key_result_t
+ThreadPoolPrivateKeyOperationProvider::OperationImpl::complete(uint8_t* out, size_t* out_len,
+                                                              size_t max_out) {
+  if (!state_->done_) {
+    return ssl_private_key_retry;
+  }
+  if (!state_->success_ || state_->output_.size() > max_out) {
+    return ssl_private_key_failure;
+  }
+
+  std::copy(state_->output_.begin(), state_->output_.end(), out);
+  *out_len = state_->output_.size();
+  return ssl_private_key_success;
+}
+
+} // namespace Ssl
+} // namespace Envoy
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "envoy/event/dispatcher.h"
+#include "envoy/ssl/private_key.h"
+
+#include "common/common/thread.h"
+
+#include "openssl/ssl.h"
+
+namespace Envoy {
+namespace Ssl {
+
+/**
+ * Runs the private key operations of handshakes on a pool of threads, with the keys in memory. The
+ * result of an operation is posted back to the dispatcher that started it.
+ */
+class ThreadPoolPrivateKeyOperationProvider : public PrivateKeyOperationProvider {
+public:
+  ThreadPoolPrivateKeyOperationProvider(uint32_t threads);
+  ~ThreadPoolPrivateKeyOperationProvider();
+
+  // Ssl::PrivateKeyOperationProvider
+  PrivateKeyOperationPtr sign(EVP_PKEY& key, uint16_t signature_algorithm, const uint8_t* in,
+                              size_t in_len, Event::Dispatcher& dispatcher,
+                              PrivateKeyOperationCallbacks& callbacks) override;
+  PrivateKeyOperationPtr decrypt(EVP_PKEY& key, const uint8_t* in, size_t in_len,
+                                 Event::Dispatcher& dispatcher,
+                                 PrivateKeyOperationCallbacks& callbacks) override;
+
+  /**
+   * Sign with a private key on the calling thread. @see SSL_PRIVATE_KEY_METHOD.
+   * @return whether the signature was written to out.
+   */
+  static bool sign(EVP_PKEY& key, uint16_t signature_algorithm, const uint8_t* in, size_t in_len,
+                   std::vector<uint8_t>& out);
+
+  /**
+   * Decrypt with an RSA private key, without padding, on the calling thread.
+   * @see SSL_PRIVATE_KEY_METHOD.
+   * @return whether the plaintext was written to out.
+   */
+  static bool decrypt(EVP_PKEY& key, const uint8_t* in, size_t in_len, std::vector<uint8_t>& out);
+
+private:
+  /**
+   * An operation shared by the pool thread that runs it and the connection that waits for it.
+   */
+  struct OperationState {
+    OperationState(std::function<bool(std::vector<uint8_t>&)> work, Event::Dispatcher& dispatcher,
+                   PrivateKeyOperationCallbacks& callbacks)
+        : work_(work), dispatcher_(dispatcher), callbacks_(callbacks) {}
+
+    const std::function<bool(std::vector<uint8_t>&)> work_;
+    Event::Dispatcher& dispatcher_;
+    PrivateKeyOperationCallbacks& callbacks_;
+    // Set on the dispatcher, checked by the pool thread before it posts the result.
+    std::mutex lock_;
+    bool cancelled_{};
+    // Written by the pool thread before the result is posted, read on the dispatcher after.
+    bool success_{};
+    std::vector<uint8_t> output_;
+    // Only used on the dispatcher.
+    bool done_{};
+  };
+
+  typedef std::shared_ptr<OperationState> OperationStateSharedPtr;
+
+  class OperationImpl : public PrivateKeyOperation {
+  public:
+    OperationImpl(OperationStateSharedPtr state) : state_(state) {}
+    ~OperationImpl() { cancel(); }
+
+    // Ssl::PrivateKeyOperation
+    void cancel() override;
+    ssl_private_key_result_t complete(uint8_t* out, size_t* out_len, size_t max_out) override;
+
+  private:
+    OperationStateSharedPtr state_;
+  };
+
+  PrivateKeyOperationPtr start(std::function<bool(std::vector<uint8_t>&)> work,
+                               Event::Dispatcher& dispatcher,
+                               PrivateKeyOperationCallbacks& callbacks);
+  void threadRoutine();
+
+  std::vector<Thread::ThreadPtr> threads_;
+  std::list<OperationStateSharedPtr> queue_;
+  std::mutex queue_lock_;
+  std::condition_variable queue_event_;
+  bool shutdown_{};
+};
+
+} // namespace Ssl
+} // namespace Envoy
@@ -0,0 +1,33 @@
+#include "common/stats/cardinality_limiter.h"
+
+#include <mutex>
+#include <string>
+
+#include "common/common/macros.h"
+
+namespace Envoy {
+namespace Stats {
+
+const std::string& CardinalityLimiter::admit(const std::string& value) {
+  std::unique_lock<std::mutex> lock(lock_);
+  auto entry = values_.find(value);
+  if (entry != values_.end()) {
+    return *entry;
+  }
+  if (values_.size() >= max_values_) {
+    return overflowValue();
+  }
+  return *values_.insert(value).first;
+}
+
+size_t CardinalityLimiter::size() const {
+  std::unique_lock<std::mutex> lock(lock_);
+  return values_.size();
+}
+
+const std::string& CardinalityLimiter::overflowValue() {
+  CONSTRUCT_ON_FIRST_USE(std::string, "other");
+}
+
+} // namespace Stats
+} // namespace Envoy
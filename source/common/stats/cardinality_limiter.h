@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+#include "common/common/non_copyable.h"
+
+namespace Envoy {
+namespace Stats {
+
+/**
+ * Bounds the number of distinct values of a dynamic part of stat names, such as a name taken from
+ * a request header. The first values seen are admitted, up to a maximum, and later values are all
+ * folded into the overflow value "other". Stats cannot be freed from a store one at a time, so
+ * values are never evicted: an evicted value that came back would allocate new stats and the
+ * store would grow without bound anyway.
+ */
+class CardinalityLimiter : NonCopyable {
+public:
+  CardinalityLimiter(size_t max_values) : max_values_(max_values) {}
+
+  /**
+   * @param value supplies a dynamic part of a stat name.
+   * @return const std::string& the value, if it is admitted, or overflowValue(). The reference
+   *         remains valid for the lifetime of the limiter.
+   */
+  const std::string& admit(const std::string& value);
+
+  /**
+   * @return size_t the number of admitted values.
+   */
+  size_t size() const;
+
+  /**
+   * @return const std::string& the value that values past the maximum are folded into.
+   */
+  static const std::string& overflowValue();
+
+private:
+  const size_t max_values_;
+  mutable std::mutex lock_;
+  // Nodes are never moved, so references to the values remain valid.
+  std::unordered_set<std::string> values_;
+};
+
+} // namespace Stats
+} // namespace Envoy
@@ -0,0 +1,170 @@
+#include "common/stats/histogram_impl.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "common/common/assert.h"
+
+#include "fmt/format.h"
+
+namespace Envoy {
+namespace Stats {
+
+uint32_t HistogramBuckets::bucketIndex(uint64_t value) {
+  if (value < SUB_BUCKET_COUNT) {
+    return value;
+  }
+
+  // For a value whose highest set bit is msb, the SUB_BUCKET_BITS bits below it select the linear
+  // sub bucket and everything below those is dropped.
+  const uint32_t msb = 63 - __builtin_clzll(value);
+  const uint32_t shift = msb - SUB_BUCKET_BITS;
+  const uint32_t sub_bucket = (value >> shift) & (SUB_BUCKET_COUNT - 1);
+  return (shift + 1) * SUB_BUCKET_COUNT + sub_bucket;
+}
+
+uint64_t HistogramBuckets::bucketLowerBound(uint32_t index) {
+  if (index < SUB_BUCKET_COUNT) {
+    return index;
+  }
+
+  const uint32_t shift = index / SUB_BUCKET_COUNT - 1;
+  const uint64_t sub_bucket = index % SUB_BUCKET_COUNT;
+  return (SUB_BUCKET_COUNT + sub_bucket) << shift;
+}
+
+uint64_t HistogramBuckets::bucketWidth(uint32_t index) {
+  if (index < SUB_BUCKET_COUNT) {
+    return 1;
+  }
+
+  return 1ULL << (index / SUB_BUCKET_COUNT - 1);
+}
+
+void HistogramBuckets::recordValue(uint64_t value) {
+  const uint32_t index = bucketIndex(value);
+  if (index >= counts_.size()) {
+    counts_.resize(index + 1);
+  }
+
+  counts_[index]++;
+  sample_count_++;
+  sample_sum_ += value;
+}
+
+void HistogramBuckets::merge(const HistogramBuckets& other) {
+  if (other.counts_.size() > counts_.size()) {
+    counts_.resize(other.counts_.size());
+  }
+
+  for (size_t i = 0; i < other.counts_.size(); i++) {
+    counts_[i] += other.counts_[i];
+  }
+  sample_count_ += other.sample_count_;
+  sample_sum_ += other.sample_sum_;
+}
+
+void HistogramBuckets::clear() {
+  // Keep the storage since the same buckets are likely to be recorded into again.
+  std::fill(counts_.begin(), counts_.end(), 0);
+  sample_count_ = 0;
+  sample_sum_ = 0;
+}
+
+double HistogramBuckets::quantile(double q) const {
+  ASSERT(q >= 0 && q <= 1);
+  if (sample_count_ == 0) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  // Find the bucket holding the sample at the requested rank and interpolate between the smallest
+  // and largest value of the bucket, so that values in exact buckets are reported exactly.
+  const double rank = q * sample_count_;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < counts_.size(); i++) {
+    if (counts_[i] == 0) {
+      continue;
+    }
+
+    if (seen + counts_[i] >= rank) {
+      const double fraction = (rank - seen) / counts_[i];
+      return bucketLowerBound(i) + fraction * (bucketWidth(i) - 1);
+    }
+    seen += counts_[i];
+  }
+
+  NOT_REACHED;
+}
+
+uint64_t HistogramBuckets::countAtMost(double bound) const {
+  uint64_t count = 0;
+  for (size_t i = 0; i < counts_.size(); i++) {
+    const uint64_t lower_bound = bucketLowerBound(i);
+    if (lower_bound > bound) {
+      break;
+    }
+
+    // The bucket holds the integers from lower_bound to lower_bound + width - 1.
+    const uint64_t width = bucketWidth(i);
+    const uint64_t covered = static_cast<uint64_t>(bound - lower_bound) + 1;
+    if (covered >= width) {
+      count += counts_[i];
+    } else {
+      count += static_cast<uint64_t>(static_cast<double>(counts_[i]) * covered / width);
+    }
+  }
+
+  return count;
+}
+
+HistogramStatisticsImpl::HistogramStatisticsImpl(const HistogramBuckets& buckets)
+    : sample_count_(buckets.sampleCount()), sample_sum_(buckets.sampleSum()) {
+  for (double q : supportedQuantiles()) {
+    computed_quantiles_.push_back(buckets.quantile(q));
+  }
+  for (double bound : supportedBuckets()) {
+    computed_buckets_.push_back(buckets.countAtMost(bound));
+  }
+}
+
+const std::vector<double>& HistogramStatisticsImpl::supportedQuantiles() const {
+  static const std::vector<double> supported_quantiles = {0.5, 0.9, 0.99, 0.999};
+  return supported_quantiles;
+}
+
+const std::vector<double>& HistogramStatisticsImpl::supportedBuckets() const {
+  // Suited to latencies in milliseconds, which most histograms record.
+  static const std::vector<double> supported_buckets = {
+      0.5,  1,    5,     10,    25,    50,     100,    250,     500,    1000,
+      2500, 5000, 10000, 30000, 60000, 300000, 600000, 1800000, 3600000};
+  return supported_buckets;
+}
+
+std::string HistogramStatisticsImpl::summary() const {
+  std::string summary;
+  for (size_t i = 0; i < supportedQuantiles().size(); i++) {
+    if (!summary.empty()) {
+      summary += " ";
+    }
+    summary += fmt::format("P{:g}: {:.1f}", 100 * supportedQuantiles()[i], computed_quantiles_[i]);
+  }
+
+  return summary;
+}
+
+void HistogramImpl::merge() {
+  mergeInterval(pending_);
+  pending_.clear();
+}
+
+void HistogramImpl::mergeInterval(const HistogramBuckets& interval) {
+  cumulative_.merge(interval);
+  interval_statistics_ = HistogramStatisticsImpl(interval);
+  cumulative_statistics_ = HistogramStatisticsImpl(cumulative_);
+}
+
+} // namespace Stats
+} // namespace Envoy
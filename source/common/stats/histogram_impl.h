@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "envoy/stats/stats.h"
+
+namespace Envoy {
+namespace Stats {
+
+/**
+ * Log-linear histogram buckets. Values below SUB_BUCKET_COUNT get their own bucket. Above that,
+ * each power of 2 range is split into SUB_BUCKET_COUNT linear buckets, which bounds the relative
+ * error of a bucket to 1 / SUB_BUCKET_COUNT. Storage grows to the largest bucket recorded so far,
+ * so typical latency histograms only use a few hundred bytes.
+ *
+ * This class does no synchronization. Callers record into a buffer owned by a single thread and
+ * hand off buffers for merging.
+ */
+class HistogramBuckets {
+public:
+  static const uint32_t SUB_BUCKET_BITS = 4;
+  static const uint32_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+
+  /**
+   * @return uint32_t the index of the bucket that a value falls into.
+   */
+  static uint32_t bucketIndex(uint64_t value);
+
+  /**
+   * @return uint64_t the smallest value that falls into a bucket.
+   */
+  static uint64_t bucketLowerBound(uint32_t index);
+
+  /**
+   * @return uint64_t the number of distinct values that fall into a bucket.
+   */
+  static uint64_t bucketWidth(uint32_t index);
+
+  void recordValue(uint64_t value);
+  void merge(const HistogramBuckets& other);
+  void clear();
+
+  /**
+   * @return double the estimated value of a quantile (between 0 and 1), interpolating linearly
+   *         within the bucket that contains it. NaN if there are no samples.
+   */
+  double quantile(double q) const;
+
+  /**
+   * @return uint64_t the estimated number of samples that are at most a bound, assuming that the
+   *         samples of the bucket that contains the bound are spread evenly across it.
+   */
+  uint64_t countAtMost(double bound) const;
+
+  uint64_t sampleCount() const { return sample_count_; }
+  uint64_t sampleSum() const { return sample_sum_; }
+
+private:
+  std::vector<uint64_t> counts_;
+  uint64_t sample_count_{};
+  uint64_t sample_sum_{};
+};
+
+/**
+ * Computed statistics for a set of histogram buckets.
+ */
+class HistogramStatisticsImpl : public HistogramStatistics {
+public:
+  HistogramStatisticsImpl() : HistogramStatisticsImpl(HistogramBuckets()) {}
+  HistogramStatisticsImpl(const HistogramBuckets& buckets);
+
+  // Stats::HistogramStatistics
+  std::string summary() const override;
+  const std::vector<double>& supportedQuantiles() const override;
+  const std::vector<double>& computedQuantiles() const override { return computed_quantiles_; }
+  const std::vector<double>& supportedBuckets() const override;
+  const std::vector<uint64_t>& computedBuckets() const override { return computed_buckets_; }
+  uint64_t sampleCount() const override { return sample_count_; }
+  uint64_t sampleSum() const override { return sample_sum_; }
+
+private:
+  std::vector<double> computed_quantiles_;
+  std::vector<uint64_t> computed_buckets_;
+  uint64_t sample_count_;
+  uint64_t sample_sum_;
+};
+
+/**
+ * Histogram implementation that records values directly into a single buffer. It is not thread
+ * safe and is used by the isolated store. Statistics are updated when merge() is called.
+ */
+class HistogramImpl : public ParentHistogram {
+public:
+  HistogramImpl(const std::string& name) : HistogramImpl(name, std::string(name), {}) {}
+  HistogramImpl(const std::string& name, std::string&& tag_extracted_name, std::vector<Tag>&& tags)
+      : name_(name), tag_extracted_name_(std::move(tag_extracted_name)), tags_(std::move(tags)) {}
+
+  /**
+   * Update the interval and cumulative statistics with the values recorded since the last merge.
+   */
+  virtual void merge();
+
+  // Stats::Histogram
+  void recordValue(uint64_t value) override { pending_.recordValue(value); }
+  std::string name() const override { return name_; }
+
+  // Stats::ParentHistogram
+  const HistogramStatistics& intervalStatistics() const override { return interval_statistics_; }
+  const HistogramStatistics& cumulativeStatistics() const override {
+    return cumulative_statistics_;
+  }
+  bool used() const override { return cumulative_.sampleCount() > 0; }
+  std::string tagExtractedName() const override { return tag_extracted_name_; }
+  const std::vector<Tag>& tags() const override { return tags_; }
+
+protected:
+  /**
+   * Update the statistics with the buckets recorded during the last interval.
+   */
+  void mergeInterval(const HistogramBuckets& interval);
+
+  const std::string name_;
+  HistogramBuckets pending_;
+
+private:
+  const std::string tag_extracted_name_;
+  const std::vector<Tag> tags_;
+  HistogramBuckets cumulative_;
+  HistogramStatisticsImpl interval_statistics_;
+  HistogramStatisticsImpl cumulative_statistics_;
+};
+
+} // namespace Stats
+} // namespace Envoy
@@ -0,0 +1,119 @@
+#include "common/stats/metrics_service_sink.h"
+
+#include <string>
+
+namespace Envoy {
+namespace Stats {
+namespace Metrics {
+
+MetricsServiceSink::MetricsServiceSink(GrpcMetricsAsyncClientPtr&& async_client,
+                                       const LocalInfo::LocalInfo& local_info)
+    : service_method_(*Protobuf::DescriptorPool::generated_pool()->FindMethodByName(
+          "envoy.metrics.MetricsService.StreamMetrics")),
+      async_client_(std::move(async_client)), local_info_(local_info) {}
+
+MetricsServiceSink::~MetricsServiceSink() {
+  if (stream_) {
+    stream_->resetStream();
+  }
+}
+
+void MetricsServiceSink::beginFlush() {
+  message_.Clear();
+  new_stream_ = false;
+  if (!stream_) {
+    stream_ = async_client_->start(service_method_, *this);
+    if (!stream_) {
+      // onRemoteClose() has already been called. The metrics of this flush are dropped.
+      flushing_ = false;
+      return;
+    }
+
+    // Ids are scoped to a stream, so a new stream starts over with the names.
+    stat_ids_.clear();
+    quantiles_sent_ = false;
+    new_stream_ = true;
+    auto* identifier = message_.mutable_identifier();
+    identifier->set_node(local_info_.nodeName());
+    identifier->set_cluster(local_info_.clusterName());
+  }
+
+  flushing_ = true;
+}
+
+void MetricsServiceSink::flushCounter(const Counter& counter, uint64_t delta) {
+  if (flushing_) {
+    auto* message_counter = message_.add_counters();
+    message_counter->set_id(statId(counter));
+    message_counter->set_delta(delta);
+  }
+}
+
+void MetricsServiceSink::flushGauge(const Gauge& gauge, uint64_t value) {
+  if (flushing_) {
+    auto* message_gauge = message_.add_gauges();
+    message_gauge->set_id(statId(gauge));
+    message_gauge->set_value(value);
+  }
+}
+
+void MetricsServiceSink::flushHistogram(const ParentHistogram& histogram) {
+  const HistogramStatistics& statistics = histogram.intervalStatistics();
+  if (!flushing_ || statistics.sampleCount() == 0) {
+    return;
+  }
+
+  if (!quantiles_sent_) {
+    for (double quantile : statistics.supportedQuantiles()) {
+      message_.add_quantiles(quantile);
+    }
+    quantiles_sent_ = true;
+  }
+
+  auto* summary = message_.add_histograms();
+  summary->set_id(statId(histogram));
+  summary->set_sample_count(statistics.sampleCount());
+  summary->set_sample_sum(statistics.sampleSum());
+  for (double value : statistics.computedQuantiles()) {
+    summary->add_quantile_values(value);
+  }
+}
+
+void MetricsServiceSink::endFlush() {
+  if (flushing_) {
+    stream_->sendMessage(message_, false);
+    flushing_ = false;
+  }
+}
+
+void MetricsServiceSink::onRemoteClose(Grpc::Status::GrpcStatus status,
+                                       const std::string& message) {
+  ENVOY_LOG(debug, "metrics service stream closed: {} {}", status, message);
+  stream_ = nullptr;
+  flushing_ = false;
+}
+
+template <class StatType> uint32_t MetricsServiceSink::statId(const StatType& stat) {
+  std::string name = stat.name();
+  auto it = stat_ids_.find(name);
+  if (it != stat_ids_.end()) {
+    return it->second;
+  }
+
+  const uint32_t id = stat_ids_.size();
+  auto* stat_name = message_.add_stat_names();
+  stat_name->set_id(id);
+  stat_name->set_name(name);
+  stat_name->set_tag_extracted_name(stat.tagExtractedName());
+  for (const Tag& tag : stat.tags()) {
+    auto* message_tag = stat_name->add_tags();
+    message_tag->set_name(tag.name_);
+    message_tag->set_value(tag.value_);
+  }
+  stat_ids_.emplace(std::move(name), id);
+  return id;
+}
+
+} // namespace Metrics
+} // namespace Stats
+} // namespace Envoy
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "envoy/grpc/async_client.h"
+#include "envoy/local_info/local_info.h"
+#include "envoy/stats/stats.h"
+
+#include "common/common/logger.h"
+#include "common/stats/metrics_service.pb.h"
+
+namespace Envoy {
+namespace Stats {
+namespace Metrics {
+
+typedef Grpc::AsyncClient<envoy::metrics::StreamMetricsMessage,
+                          envoy::metrics::StreamMetricsResponse>
+    GrpcMetricsAsyncClient;
+typedef std::unique_ptr<GrpcMetricsAsyncClient> GrpcMetricsAsyncClientPtr;
+
+/**
+ * Stats sink that streams counter deltas, gauges and histogram summaries to a metrics service over
+ * a long lived gRPC stream. Each stats flush is sent as a single message. Stat names are only sent
+ * the first time they are used on a stream and are referred to by integer ids afterwards. If the
+ * stream closes a new one is started on the next flush, which starts over with names. The first
+ * flush of each stream sends every gauge, so the collector also learns the gauges that do not
+ * change.
+ *
+ * Flushing happens on the main thread only, so unlike the statsd sinks there is no per thread
+ * state. Individual timer and histogram values are not streamed, the merged histograms are sent
+ * with every flush instead.
+ */
+class MetricsServiceSink
+    : public Sink,
+      public Grpc::AsyncStreamCallbacks<envoy::metrics::StreamMetricsResponse>,
+      Logger::Loggable<Logger::Id::upstream> {
+public:
+  MetricsServiceSink(GrpcMetricsAsyncClientPtr&& async_client,
+                     const LocalInfo::LocalInfo& local_info);
+  ~MetricsServiceSink();
+
+  // Stats::Sink
+  void beginFlush() override;
+  bool wantsAllGauges() const override { return flushing_ && new_stream_; }
+  void flushCounter(const Counter& counter, uint64_t delta) override;
+  void flushGauge(const Gauge& gauge, uint64_t value) override;
+  void flushHistogram(const ParentHistogram& histogram) override;
+  void endFlush() override;
+  void onHistogramComplete(const std::string&, uint64_t) override {}
+  void onTimespanComplete(const std::string&, std::chrono::milliseconds) override {}
+
+  // Grpc::AsyncStreamCallbacks
+  void onCreateInitialMetadata(Http::HeaderMap&) override {}
+  void onReceiveInitialMetadata(Http::HeaderMapPtr&&) override {}
+  void onReceiveMessage(std::unique_ptr<envoy::metrics::StreamMetricsResponse>&&) override {}
+  void onReceiveTrailingMetadata(Http::HeaderMapPtr&&) override {}
+  void onRemoteClose(Grpc::Status::GrpcStatus status, const std::string& message) override;
+
+private:
+  /**
+   * @return the stream id of a stat. The name and tags of the stat are added to the pending
+   *         message if this is the first time it is used on the current stream.
+   */
+  template <class StatType> uint32_t statId(const StatType& stat);
+
+  const Protobuf::MethodDescriptor& service_method_;
+  GrpcMetricsAsyncClientPtr async_client_;
+  const LocalInfo::LocalInfo& local_info_;
+  Grpc::AsyncStream<envoy::metrics::StreamMetricsMessage>* stream_{};
+  // Whether the message being built by the current flush has a stream to go to.
+  bool flushing_{};
+  // Whether the current flush is the first one of its stream.
+  bool new_stream_{};
+  // Whether the quantiles have been sent on the current stream.
+  bool quantiles_sent_{};
+  envoy::metrics::StreamMetricsMessage message_;
+  std::unordered_map<std::string, uint32_t> stat_ids_;
+};
+
+} // namespace Metrics
+} // namespace Stats
+} // namespace Envoy
@@ -37,6 +37,82 @@ void RawStatData::initialize(const std::string& name) {
   StringUtil::strlcpy(name_, name.substr(0, MAX_NAME_SIZE).c_str(), MAX_NAME_SIZE + 1);
 }
 
+void CounterImpl::markChanged() {
+  // Racing adds may both get here, only the one that flips the state registers the counter.
+  if (!changed_.exchange(true)) {
+    if (!(data_.flags_ & RawStatData::Flags::Used)) {
+      data_.flags_ |= RawStatData::Flags::Used;
+    }
+    if (tracker_) {
+      tracker_->counterChanged(shared_from_this());
+    }
+  }
+}
+
+void GaugeImpl::markChanged() {
+  // See CounterImpl::markChanged().
+  if (!changed_.exchange(true)) {
+    if (!(data_.flags_ & RawStatData::Flags::Used)) {
+      data_.flags_ |= RawStatData::Flags::Used;
+    }
+    if (tracker_) {
+      tracker_->gaugeChanged(shared_from_this());
+    }
+  }
+}
+
+void ChangedStatsTracker::counterChanged(const std::shared_ptr<CounterImpl>& counter) {
+  std::unique_lock<std::mutex> lock(lock_);
+  counters_.emplace_back(counter);
+}
+
+void ChangedStatsTracker::gaugeChanged(const std::shared_ptr<GaugeImpl>& gauge) {
+  std::unique_lock<std::mutex> lock(lock_);
+  gauges_.emplace_back(gauge);
+}
+
+std::vector<CounterSharedPtr> ChangedStatsTracker::latchChangedCounters() {
+  std::vector<std::weak_ptr<CounterImpl>> changed;
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    changed.swap(counters_);
+  }
+
+  // The changed state is cleared before the caller reads the counter so that a concurrent change
+  // is either part of this latch or registers the counter for the next one.
+  std::vector<CounterSharedPtr> ret;
+  ret.reserve(changed.size());
+  for (const std::weak_ptr<CounterImpl>& weak_counter : changed) {
+    std::shared_ptr<CounterImpl> counter = weak_counter.lock();
+    if (counter) {
+      counter->clearChanged();
+      ret.emplace_back(std::move(counter));
+    }
+  }
+
+  return ret;
+}
+
+std::vector<GaugeSharedPtr> ChangedStatsTracker::latchChangedGauges() {
+  std::vector<std::weak_ptr<GaugeImpl>> changed;
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    changed.swap(gauges_);
+  }
+
+  std::vector<GaugeSharedPtr> ret;
+  ret.reserve(changed.size());
+  for (const std::weak_ptr<GaugeImpl>& weak_gauge : changed) {
+    std::shared_ptr<GaugeImpl> gauge = weak_gauge.lock();
+    if (gauge) {
+      gauge->clearChanged();
+      ret.emplace_back(std::move(gauge));
+    }
+  }
+
+  return ret;
+}
+
 bool RawStatData::matches(const std::string& name) {
   // In case a stat got truncated, match on the truncated name.
   return 0 == strcmp(name.substr(0, MAX_NAME_SIZE).c_str(), name_);
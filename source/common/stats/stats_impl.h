@@ -6,13 +6,17 @@
 #include <functional>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "envoy/common/time.h"
 #include "envoy/stats/stats.h"
 
 #include "common/common/assert.h"
+#include "common/common/macros.h"
+#include "common/stats/histogram_impl.h"
 
 namespace Envoy {
 namespace Stats {
@@ -63,64 +67,200 @@ public:
   virtual void free(RawStatData& data) PURE;
 };
 
+class CounterImpl;
+class GaugeImpl;
+
+/**
+ * Tracks the counters and gauges that changed since they were last latched, so that a stats flush
+ * only visits stats that have something new to report. A stat registers itself the first time it
+ * changes after a latch. Only weak references are held so tracking never extends stat lifetime.
+ */
+class ChangedStatsTracker {
+public:
+  void counterChanged(const std::shared_ptr<CounterImpl>& counter);
+  void gaugeChanged(const std::shared_ptr<GaugeImpl>& gauge);
+
+  /**
+   * @return the counters that changed since the previous call. Their changed state is reset so
+   *         that any later change registers them again.
+   */
+  std::vector<CounterSharedPtr> latchChangedCounters();
+
+  /**
+   * @return the gauges that changed since the previous call. See latchChangedCounters().
+   */
+  std::vector<GaugeSharedPtr> latchChangedGauges();
+
+private:
+  std::mutex lock_;
+  std::vector<std::weak_ptr<CounterImpl>> counters_;
+  std::vector<std::weak_ptr<GaugeImpl>> gauges_;
+};
+
 /**
- * Counter implementation that wraps a RawStatData.
+ * Counter implementation that wraps a RawStatData. The changed state is kept per process rather
+ * than in the RawStatData so that hot restarted processes track their own flushes.
  */
-class CounterImpl : public Counter {
+class CounterImpl : public Counter, public std::enable_shared_from_this<CounterImpl> {
 public:
-  CounterImpl(RawStatData& data, RawStatDataAllocator& alloc) : data_(data), alloc_(alloc) {}
+  CounterImpl(RawStatData& data, RawStatDataAllocator& alloc,
+              ChangedStatsTracker* tracker = nullptr)
+      : CounterImpl(data, alloc, tracker, data.name_, {}) {}
+  CounterImpl(RawStatData& data, RawStatDataAllocator& alloc, ChangedStatsTracker* tracker,
+              std::string&& tag_extracted_name, std::vector<Tag>&& tags)
+      : data_(data), alloc_(alloc), tracker_(tracker),
+        tag_extracted_name_(std::move(tag_extracted_name)), tags_(std::move(tags)) {}
   ~CounterImpl() { alloc_.free(data_); }
 
+  void clearChanged() { changed_ = false; }
+
   // Stats::Counter
   void add(uint64_t amount) override {
     data_.value_ += amount;
     data_.pending_increment_ += amount;
-    data_.flags_ |= RawStatData::Flags::Used;
+    if (!changed_) {
+      markChanged();
+    }
   }
 
   void inc() override { add(1); }
   uint64_t latch() override { return data_.pending_increment_.exchange(0); }
-  std::string name() override { return data_.name_; }
+  std::string name() const override { return data_.name_; }
   void reset() override { data_.value_ = 0; }
   bool used() override { return data_.flags_ & RawStatData::Flags::Used; }
   uint64_t value() override { return data_.value_; }
+  std::string tagExtractedName() const override { return tag_extracted_name_; }
+  const std::vector<Tag>& tags() const override { return tags_; }
 
 private:
+  void markChanged();
+
   RawStatData& data_;
   RawStatDataAllocator& alloc_;
+  ChangedStatsTracker* tracker_;
+  const std::string tag_extracted_name_;
+  const std::vector<Tag> tags_;
+  std::atomic<bool> changed_{};
 };
 
 /**
- * Gauge implementation that wraps a RawStatData.
+ * Gauge implementation that wraps a RawStatData. See CounterImpl for how changes are tracked.
  */
-class GaugeImpl : public Gauge {
+class GaugeImpl : public Gauge, public std::enable_shared_from_this<GaugeImpl> {
 public:
-  GaugeImpl(RawStatData& data, RawStatDataAllocator& alloc) : data_(data), alloc_(alloc) {}
+  GaugeImpl(RawStatData& data, RawStatDataAllocator& alloc, ChangedStatsTracker* tracker = nullptr)
+      : GaugeImpl(data, alloc, tracker, data.name_, {}) {}
+  GaugeImpl(RawStatData& data, RawStatDataAllocator& alloc, ChangedStatsTracker* tracker,
+            std::string&& tag_extracted_name, std::vector<Tag>&& tags)
+      : data_(data), alloc_(alloc), tracker_(tracker),
+        tag_extracted_name_(std::move(tag_extracted_name)), tags_(std::move(tags)) {}
   ~GaugeImpl() { alloc_.free(data_); }
 
+  void clearChanged() { changed_ = false; }
+
   // Stats::Gauge
   virtual void add(uint64_t amount) override {
     data_.value_ += amount;
-    data_.flags_ |= RawStatData::Flags::Used;
+    onChange();
   }
   virtual void dec() override { sub(1); }
   virtual void inc() override { add(1); }
-  virtual std::string name() override { return data_.name_; }
+  virtual std::string name() const override { return data_.name_; }
   virtual void set(uint64_t value) override {
     data_.value_ = value;
-    data_.flags_ |= RawStatData::Flags::Used;
+    onChange();
   }
   virtual void sub(uint64_t amount) override {
     ASSERT(data_.value_ >= amount);
     ASSERT(used());
     data_.value_ -= amount;
+    onChange();
   }
   bool used() override { return data_.flags_ & RawStatData::Flags::Used; }
   virtual uint64_t value() override { return data_.value_; }
+  std::string tagExtractedName() const override { return tag_extracted_name_; }
+  const std::vector<Tag>& tags() const override { return tags_; }
 
 private:
+  void onChange() {
+    if (!changed_) {
+      markChanged();
+    }
+  }
+  void markChanged();
+
   RawStatData& data_;
   RawStatDataAllocator& alloc_;
+  ChangedStatsTracker* tracker_;
+  const std::string tag_extracted_name_;
+  const std::vector<Tag> tags_;
+  std::atomic<bool> changed_{};
+};
+
+/**
+ * Counter that is not part of a store, for stats that exist in very large numbers such as the per
+ * host stats. It only has its value and a static name: there is no RawStatData allocation, it has
+ * no tags and it is never tracked for flushes.
+ */
+class StandaloneCounterImpl : public Counter {
+public:
+  StandaloneCounterImpl(const char* name) : name_(name) {}
+
+  // Stats::Counter
+  void add(uint64_t amount) override {
+    value_ += amount;
+    pending_increment_ += amount;
+    used_ = true;
+  }
+  void inc() override { add(1); }
+  uint64_t latch() override { return pending_increment_.exchange(0); }
+  std::string name() const override { return name_; }
+  void reset() override { value_ = 0; }
+  bool used() override { return used_; }
+  uint64_t value() override { return value_; }
+  std::string tagExtractedName() const override { return name_; }
+  const std::vector<Tag>& tags() const override { CONSTRUCT_ON_FIRST_USE(std::vector<Tag>); }
+
+private:
+  const char* name_;
+  std::atomic<uint64_t> value_{};
+  std::atomic<uint64_t> pending_increment_{};
+  std::atomic<bool> used_{};
+};
+
+/**
+ * Gauge counterpart of StandaloneCounterImpl.
+ */
+class StandaloneGaugeImpl : public Gauge {
+public:
+  StandaloneGaugeImpl(const char* name) : name_(name) {}
+
+  // Stats::Gauge
+  void add(uint64_t amount) override {
+    value_ += amount;
+    used_ = true;
+  }
+  void dec() override { sub(1); }
+  void inc() override { add(1); }
+  std::string name() const override { return name_; }
+  void set(uint64_t value) override {
+    value_ = value;
+    used_ = true;
+  }
+  void sub(uint64_t amount) override {
+    ASSERT(value_ >= amount);
+    ASSERT(used());
+    value_ -= amount;
+  }
+  bool used() override { return used_; }
+  uint64_t value() override { return value_; }
+  std::string tagExtractedName() const override { return name_; }
+  const std::vector<Tag>& tags() const override { CONSTRUCT_ON_FIRST_USE(std::vector<Tag>); }
+
+private:
+  const char* name_;
+  std::atomic<uint64_t> value_{};
+  std::atomic<bool> used_{};
 };
 
 /**
@@ -171,7 +311,7 @@ public:
  */
 template <class Base, class Impl> class IsolatedStatsCache {
 public:
-  typedef std::function<Impl*(const std::string& name)> Allocator;
+  typedef std::function<std::shared_ptr<Impl>(const std::string& name)> Allocator;
 
   IsolatedStatsCache(Allocator alloc) : alloc_(alloc) {}
 
@@ -181,8 +321,8 @@ public:
       return *stat->second;
     }
 
-    Impl* new_stat = alloc_(name);
-    stats_.emplace(name, std::shared_ptr<Impl>{new_stat});
+    std::shared_ptr<Impl> new_stat = alloc_(name);
+    stats_.emplace(name, new_stat);
     return *new_stat;
   }
 
@@ -206,14 +346,18 @@ private:
 class IsolatedStoreImpl : public Store {
 public:
   IsolatedStoreImpl()
-      : counters_([this](const std::string& name) -> CounterImpl* {
-          return new CounterImpl(*alloc_.alloc(name), alloc_);
+      : counters_([this](const std::string& name) -> std::shared_ptr<CounterImpl> {
+          return std::make_shared<CounterImpl>(*alloc_.alloc(name), alloc_, &changed_stats_);
+        }),
+        gauges_([this](const std::string& name) -> std::shared_ptr<GaugeImpl> {
+          return std::make_shared<GaugeImpl>(*alloc_.alloc(name), alloc_, &changed_stats_);
         }),
-        gauges_([this](const std::string& name) -> GaugeImpl* {
-          return new GaugeImpl(*alloc_.alloc(name), alloc_);
+        timers_([this](const std::string& name) -> std::shared_ptr<TimerImpl> {
+          return std::make_shared<TimerImpl>(name, *this);
         }),
-        timers_(
-            [this](const std::string& name) -> TimerImpl* { return new TimerImpl(name, *this); }) {}
+        histograms_([](const std::string& name) -> std::shared_ptr<HistogramImpl> {
+          return std::make_shared<HistogramImpl>(name);
+        }) {}
 
   // Stats::Scope
   Counter& counter(const std::string& name) override { return counters_.get(name); }
@@ -224,10 +368,20 @@ public:
   void deliverTimingToSinks(const std::string&, std::chrono::milliseconds) override {}
   Gauge& gauge(const std::string& name) override { return gauges_.get(name); }
   Timer& timer(const std::string& name) override { return timers_.get(name); }
+  Histogram& histogram(const std::string& name) override { return histograms_.get(name); }
 
   // Stats::Store
   std::list<CounterSharedPtr> counters() const override { return counters_.toList(); }
   std::list<GaugeSharedPtr> gauges() const override { return gauges_.toList(); }
+  std::list<ParentHistogramSharedPtr> histograms() const override {
+    return histograms_.toList();
+  }
+  std::vector<CounterSharedPtr> latchChangedCounters() override {
+    return changed_stats_.latchChangedCounters();
+  }
+  std::vector<GaugeSharedPtr> latchChangedGauges() override {
+    return changed_stats_.latchChangedGauges();
+  }
 
 private:
   struct ScopeImpl : public Scope {
@@ -243,15 +397,20 @@ private:
     Counter& counter(const std::string& name) override { return parent_.counter(prefix_ + name); }
     Gauge& gauge(const std::string& name) override { return parent_.gauge(prefix_ + name); }
     Timer& timer(const std::string& name) override { return parent_.timer(prefix_ + name); }
+    Histogram& histogram(const std::string& name) override {
+      return parent_.histogram(prefix_ + name);
+    }
 
     IsolatedStoreImpl& parent_;
     const std::string prefix_;
   };
 
   HeapRawStatDataAllocator alloc_;
+  ChangedStatsTracker changed_stats_;
   IsolatedStatsCache<Counter, CounterImpl> counters_;
   IsolatedStatsCache<Gauge, GaugeImpl> gauges_;
   IsolatedStatsCache<Timer, TimerImpl> timers_;
+  IsolatedStatsCache<ParentHistogram, HistogramImpl> histograms_;
 };
 
 } // namespace Stats
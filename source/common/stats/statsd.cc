@@ -1,8 +1,12 @@
 #include "common/stats/statsd.h"
 
+#include <sys/socket.h>
+
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "envoy/common/exception.h"
 #include "envoy/event/dispatcher.h"
@@ -18,7 +22,13 @@ namespace Envoy {
 namespace Stats {
 namespace Statsd {
 
-Writer::Writer(Network::Address::InstanceConstSharedPtr address) {
+const uint32_t Writer::MAX_PACKETS_PER_SEND;
+const std::chrono::milliseconds Writer::TIMER_FLUSH_DELAY(100);
+
+Writer::Writer(Network::Address::InstanceConstSharedPtr address, Event::Dispatcher& dispatcher,
+               uint64_t max_packet_size)
+    : max_packet_size_(max_packet_size),
+      flush_timer_(dispatcher.createTimer([this]() -> void { flush(); })) {
   fd_ = address->socket(Network::Address::SocketType::Datagram);
   ASSERT(fd_ != -1);
 
@@ -29,43 +39,99 @@ Writer::Writer(Network::Address::InstanceConstSharedPtr address) {
 
 Writer::~Writer() {
   if (fd_ != -1) {
+    flush();
     RELEASE_ASSERT(close(fd_) == 0);
   }
 }
 
 void Writer::writeCounter(const std::string& name, uint64_t increment) {
   std::string message(fmt::format("envoy.{}:{}|c", name, increment));
-  send(message);
+  write(message);
 }
 
 void Writer::writeGauge(const std::string& name, uint64_t value) {
   std::string message(fmt::format("envoy.{}:{}|g", name, value));
-  send(message);
+  write(message);
 }
 
 void Writer::writeTimer(const std::string& name, const std::chrono::milliseconds& ms) {
   std::string message(fmt::format("envoy.{}:{}|ms", name, ms.count()));
-  send(message);
+  write(message);
 }
 
-void Writer::send(const std::string& message) {
-  ::send(fd_, message.c_str(), message.size(), MSG_DONTWAIT);
+void Writer::write(const std::string& message) {
+  // Start a new packet if the message does not fit in the current one. A message which is larger
+  // than a packet on its own is still sent, by itself.
+  if (packets_.empty() || packets_.back().size() + 1 + message.size() > max_packet_size_) {
+    if (packets_.size() == MAX_PACKETS_PER_SEND) {
+      // The pending packets are all full and make up a whole send, so they do not wait for the
+      // flush or the timer.
+      sendPackets(0, packets_.size());
+      packets_.clear();
+    }
+    packets_.emplace_back(message);
+  } else {
+    packets_.back().push_back('\n');
+    packets_.back().append(message);
+  }
+
+  // Metrics written on worker threads between flushes do not wait for the stats flush. Make sure
+  // they go out soon even if the packet does not fill up.
+  if (!flush_timer_enabled_) {
+    flush_timer_->enableTimer(TIMER_FLUSH_DELAY);
+    flush_timer_enabled_ = true;
+  }
+}
+
+void Writer::flush() {
+  if (flush_timer_enabled_) {
+    flush_timer_->disableTimer();
+    flush_timer_enabled_ = false;
+  }
+
+  for (size_t first = 0; first < packets_.size(); first += MAX_PACKETS_PER_SEND) {
+    sendPackets(first, std::min<size_t>(MAX_PACKETS_PER_SEND, packets_.size() - first));
+  }
+
+  packets_.clear();
+}
+
+void Writer::sendPackets(size_t first, size_t num_packets) {
+  // Sends are best effort, as before. If the socket buffer is full the remaining packets are
+  // dropped.
+#if defined(__linux__)
+  std::vector<iovec> iovecs(num_packets);
+  std::vector<mmsghdr> messages(num_packets);
+  for (size_t i = 0; i < num_packets; i++) {
+    const std::string& packet = packets_[first + i];
+    iovecs[i].iov_base = const_cast<char*>(packet.data());
+    iovecs[i].iov_len = packet.size();
+    messages[i].msg_hdr.msg_iov = &iovecs[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+  ::sendmmsg(fd_, messages.data(), num_packets, MSG_DONTWAIT);
+#else
+  for (size_t i = first; i < first + num_packets; i++) {
+    ::send(fd_, packets_[i].data(), packets_[i].size(), MSG_DONTWAIT);
+  }
+#endif
 }
 
 UdpStatsdSink::UdpStatsdSink(ThreadLocal::SlotAllocator& tls,
-                             Network::Address::InstanceConstSharedPtr address)
-    : tls_(tls.allocateSlot()), server_address_(address) {
-  tls_->set([this](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
-    return std::make_shared<Writer>(this->server_address_);
+                             Network::Address::InstanceConstSharedPtr address,
+                             uint64_t max_packet_size)
+    : tls_(tls.allocateSlot()), server_address_(address), max_packet_size_(max_packet_size) {
+  tls_->set([this](Event::Dispatcher& dispatcher) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<Writer>(this->server_address_, dispatcher, this->max_packet_size_);
   });
 }
 
-void UdpStatsdSink::flushCounter(const std::string& name, uint64_t delta) {
-  tls_->getTyped<Writer>().writeCounter(name, delta);
+void UdpStatsdSink::flushCounter(const Counter& counter, uint64_t delta) {
+  tls_->getTyped<Writer>().writeCounter(counter.name(), delta);
 }
 
-void UdpStatsdSink::flushGauge(const std::string& name, uint64_t value) {
-  tls_->getTyped<Writer>().writeGauge(name, value);
+void UdpStatsdSink::flushGauge(const Gauge& gauge, uint64_t value) {
+  tls_->getTyped<Writer>().writeGauge(gauge.name(), value);
 }
 
 void UdpStatsdSink::onTimespanComplete(const std::string& name, std::chrono::milliseconds ms) {
@@ -3,7 +3,10 @@
 #include <chrono>
 #include <cstdint>
 #include <string>
+#include <vector>
 
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
 #include "envoy/local_info/local_info.h"
 #include "envoy/network/connection.h"
 #include "envoy/stats/stats.h"
@@ -17,24 +20,46 @@ namespace Stats {
 namespace Statsd {
 
 /**
- * This is a simple UDP localhost writer for statsd messages.
+ * This is a simple UDP localhost writer for statsd messages. Metrics are joined with newlines into
+ * packets of up to max_packet_size bytes, and all pending packets are sent together on flush()
+ * with as few system calls as possible. Once MAX_PACKETS_PER_SEND packets are full they are sent
+ * without waiting for the flush. Metrics written outside of a flush (timers) are otherwise sent
+ * shortly after via a timer.
  */
 class Writer : public ThreadLocal::ThreadLocalObject {
 public:
-  Writer(Network::Address::InstanceConstSharedPtr address);
+  // The maximum number of packets handed to the kernel in a single system call.
+  static const uint32_t MAX_PACKETS_PER_SEND = 64;
+
+  Writer(Network::Address::InstanceConstSharedPtr address, Event::Dispatcher& dispatcher,
+         uint64_t max_packet_size);
   ~Writer();
 
   void writeCounter(const std::string& name, uint64_t increment);
   void writeGauge(const std::string& name, uint64_t value);
   void writeTimer(const std::string& name, const std::chrono::milliseconds& ms);
 
+  /**
+   * Send all pending packets.
+   */
+  void flush();
+
   // Called in unit test to validate address.
   int getFdForTests() const { return fd_; };
 
 private:
-  void send(const std::string& message);
+  // How long a metric written outside of a flush may wait for its packet to fill up.
+  static const std::chrono::milliseconds TIMER_FLUSH_DELAY;
+
+  void write(const std::string& message);
+  void sendPackets(size_t first, size_t num_packets);
 
   int fd_;
+  const uint64_t max_packet_size_;
+  Event::TimerPtr flush_timer_;
+  bool flush_timer_enabled_{};
+  // Full packets followed by the packet currently being filled, if any.
+  std::vector<std::string> packets_;
 };
 
 /**
@@ -42,13 +67,23 @@ private:
  */
 class UdpStatsdSink : public Sink {
 public:
-  UdpStatsdSink(ThreadLocal::SlotAllocator& tls, Network::Address::InstanceConstSharedPtr address);
+  /**
+   * A statsd packet size that fits in a single frame on typical ethernet networks.
+   */
+  static const uint64_t DEFAULT_MAX_PACKET_SIZE = 1432;
+
+  UdpStatsdSink(ThreadLocal::SlotAllocator& tls, Network::Address::InstanceConstSharedPtr address,
+                uint64_t max_packet_size = DEFAULT_MAX_PACKET_SIZE);
 
   // Stats::Sink
   void beginFlush() override {}
-  void flushCounter(const std::string& name, uint64_t delta) override;
-  void flushGauge(const std::string& name, uint64_t value) override;
-  void endFlush() override {}
+  bool wantsAllGauges() const override { return false; }
+  void flushCounter(const Counter& counter, uint64_t delta) override;
+  void flushGauge(const Gauge& gauge, uint64_t value) override;
+  void flushHistogram(const ParentHistogram&) override {
+    // statsd computes quantiles itself from the individual values sent by onHistogramComplete().
+  }
+  void endFlush() override { tls_->getTyped<Writer>().flush(); }
   void onHistogramComplete(const std::string& name, uint64_t value) override {
     // For statsd histograms are just timers.
     onTimespanComplete(name, std::chrono::milliseconds(value));
@@ -60,6 +95,7 @@ public:
 private:
   ThreadLocal::SlotPtr tls_;
   Network::Address::InstanceConstSharedPtr server_address_;
+  const uint64_t max_packet_size_;
 };
 
 /**
@@ -74,12 +110,18 @@ public:
   // Stats::Sink
   void beginFlush() override { tls_->getTyped<TlsSink>().beginFlush(true); }
 
-  void flushCounter(const std::string& name, uint64_t delta) override {
-    tls_->getTyped<TlsSink>().flushCounter(name, delta);
+  bool wantsAllGauges() const override { return false; }
+
+  void flushCounter(const Counter& counter, uint64_t delta) override {
+    tls_->getTyped<TlsSink>().flushCounter(counter.name(), delta);
+  }
+
+  void flushGauge(const Gauge& gauge, uint64_t value) override {
+    tls_->getTyped<TlsSink>().flushGauge(gauge.name(), value);
   }
 
-  void flushGauge(const std::string& name, uint64_t value) override {
-    tls_->getTyped<TlsSink>().flushGauge(name, value);
+  void flushHistogram(const ParentHistogram&) override {
+    // statsd computes quantiles itself from the individual values sent by onHistogramComplete().
   }
 
   void endFlush() override { tls_->getTyped<TlsSink>().endFlush(true); }
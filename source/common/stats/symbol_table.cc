@@ -0,0 +1,43 @@
+#include "common/stats/symbol_table.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Stats {
+
+StatNameRef SymbolTable::intern(const std::string& name) {
+  Shard& shard = this->shard(name);
+  std::unique_lock<std::mutex> lock(shard.lock_);
+  auto entry = shard.names_.emplace(name, 0).first;
+  entry->second++;
+  return StatNameRef(entry->first);
+}
+
+void SymbolTable::free(StatNameRef ref) {
+  Shard& shard = this->shard(ref.str());
+  std::unique_lock<std::mutex> lock(shard.lock_);
+  auto entry = shard.names_.find(ref.str());
+  ASSERT(entry != shard.names_.end());
+  ASSERT(&entry->first == &ref.str());
+  ASSERT(entry->second > 0);
+  if (--entry->second == 0) {
+    shard.names_.erase(entry);
+  }
+}
+
+size_t SymbolTable::size() const {
+  size_t size = 0;
+  for (const Shard& shard : shards_) {
+    std::unique_lock<std::mutex> lock(shard.lock_);
+    size += shard.names_.size();
+  }
+
+  return size;
+}
+
+} // namespace Stats
+} // namespace Envoy
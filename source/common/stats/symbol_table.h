@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "common/common/non_copyable.h"
+
+namespace Envoy {
+namespace Stats {
+
+/**
+ * A pointer sized reference to a stat name. References returned by SymbolTable::intern() point at
+ * the single copy of the name held by the table, so maps keyed by them do not duplicate the name.
+ * A reference constructed directly from a string does not own anything and is only meant to be
+ * used as a lookup key while the string is alive.
+ */
+class StatNameRef {
+public:
+  explicit StatNameRef(const std::string& name) : name_(&name) {}
+
+  const std::string& str() const { return *name_; }
+
+  bool operator==(const StatNameRef& rhs) const {
+    return name_ == rhs.name_ || *name_ == *rhs.name_;
+  }
+
+private:
+  const std::string* name_;
+};
+
+struct StatNameRefHash {
+  size_t operator()(const StatNameRef& ref) const { return std::hash<std::string>()(ref.str()); }
+};
+
+template <class Value> using StatNameRefMap = std::unordered_map<StatNameRef, Value, StatNameRefHash>;
+
+/**
+ * A reference counted table of interned stat names. The table is sharded by name hash so that
+ * threads interning different names rarely contend on the same lock.
+ */
+class SymbolTable : NonCopyable {
+public:
+  SymbolTable() {}
+
+  /**
+   * Intern a name, adding a reference to it.
+   * @param name supplies the name to intern.
+   * @return StatNameRef a reference to the interned copy of the name. The reference remains valid
+   *         until a matching call to free().
+   */
+  StatNameRef intern(const std::string& name);
+
+  /**
+   * Drop a reference obtained from intern(). The name is removed from the table once the last
+   * reference is dropped.
+   */
+  void free(StatNameRef ref);
+
+  /**
+   * @return size_t the number of distinct names in the table.
+   */
+  size_t size() const;
+
+private:
+  static const size_t NUM_SHARDS = 16;
+
+  struct Shard {
+    mutable std::mutex lock_;
+    // Map from name to reference count. Nodes are never moved, so references to the keys remain
+    // valid until the entry is erased.
+    std::unordered_map<std::string, uint32_t> names_;
+  };
+
+  Shard& shard(const std::string& name) {
+    return shards_[std::hash<std::string>()(name) % NUM_SHARDS];
+  }
+
+  std::array<Shard, NUM_SHARDS> shards_;
+};
+
+} // namespace Stats
+} // namespace Envoy
@@ -0,0 +1,83 @@
+#include "common/stats/tag_extractor_impl.h"
+
+#include <string>
+#include <vector>
+
+#include "envoy/common/exception.h"
+
+#include "fmt/format.h"
+
+namespace Envoy {
+namespace Stats {
+
+namespace {
+
+std::regex compileRegex(const std::string& name, const std::string& regex) {
+  try {
+    std::regex compiled(regex);
+    if (compiled.mark_count() == 0) {
+      throw EnvoyException(
+          fmt::format("tag extractor '{}' regex '{}' has no capture group", name, regex));
+    }
+    return compiled;
+  } catch (const std::regex_error& e) {
+    throw EnvoyException(
+        fmt::format("tag extractor '{}' regex '{}' is invalid: {}", name, regex, e.what()));
+  }
+}
+
+} // namespace
+
+TagExtractorImpl::TagExtractorImpl(const std::string& name, const std::string& regex)
+    : name_(name), regex_(compileRegex(name, regex)) {}
+
+std::vector<TagExtractorPtr> TagExtractorImpl::createTagExtractors(
+    const std::vector<std::pair<std::string, std::string>>& tag_specifiers) {
+  std::vector<TagExtractorPtr> tag_extractors;
+  for (const auto& tag_specifier : tag_specifiers) {
+    tag_extractors.emplace_back(new TagExtractorImpl(tag_specifier.first, tag_specifier.second));
+  }
+
+  // The prefix tags come first so that the tags of the remaining name can be anchored to them
+  // (e.g., the virtual cluster follows the virtual host).
+  const TagNameValues& names = TagNames::get();
+  tag_extractors.emplace_back(new TagExtractorImpl(names.CLUSTER_NAME, "^cluster\\.((.+?)\\.)"));
+  tag_extractors.emplace_back(
+      new TagExtractorImpl(names.LISTENER_ADDRESS, "^listener\\.((.+?:\\d+)\\.)"));
+  tag_extractors.emplace_back(
+      new TagExtractorImpl(names.HTTP_CONN_MANAGER_PREFIX, "^http\\.((.*?)\\.)"));
+  tag_extractors.emplace_back(new TagExtractorImpl(names.VIRTUAL_HOST, "^vhost\\.((.*?)\\.)"));
+  tag_extractors.emplace_back(
+      new TagExtractorImpl(names.VIRTUAL_CLUSTER, "^vhost\\.vcluster\\.((.*?)\\.)"));
+  tag_extractors.emplace_back(new TagExtractorImpl(names.RESPONSE_CODE, "_rq(_(\\d{3}))$"));
+  tag_extractors.emplace_back(
+      new TagExtractorImpl(names.RESPONSE_CODE_CLASS, "_rq(_(\\dxx))$"));
+  return tag_extractors;
+}
+
+std::string TagExtractorImpl::extractTags(const std::string& name,
+                                          const std::vector<TagExtractorPtr>& tag_extractors,
+                                          std::vector<Tag>& tags) {
+  std::string tag_extracted_name = name;
+  for (const TagExtractorPtr& tag_extractor : tag_extractors) {
+    tag_extractor->extractTag(tag_extracted_name, tags);
+  }
+
+  return tag_extracted_name;
+}
+
+bool TagExtractorImpl::extractTag(std::string& tag_extracted_name, std::vector<Tag>& tags) const {
+  std::smatch match;
+  if (!std::regex_search(tag_extracted_name, match, regex_)) {
+    return false;
+  }
+
+  const std::ssub_match& remove = match[1];
+  const std::ssub_match& value = match[match.size() - 1];
+  tags.push_back({name_, value.str()});
+  tag_extracted_name.erase(remove.first - tag_extracted_name.cbegin(), remove.length());
+  return true;
+}
+
+} // namespace Stats
+} // namespace Envoy
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "envoy/stats/stats.h"
+
+#include "common/common/singleton.h"
+
+namespace Envoy {
+namespace Stats {
+
+/**
+ * Names of the tags that are extracted from stat names by default.
+ */
+class TagNameValues {
+public:
+  // The cluster of cluster.<name>. stats.
+  const std::string CLUSTER_NAME = "envoy.cluster_name";
+  // The listener address of listener.<address>. stats.
+  const std::string LISTENER_ADDRESS = "envoy.listener_address";
+  // The stat prefix of http.<stat_prefix>. stats.
+  const std::string HTTP_CONN_MANAGER_PREFIX = "envoy.http_conn_manager_prefix";
+  // The virtual host of vhost.<name>. stats.
+  const std::string VIRTUAL_HOST = "envoy.virtual_host";
+  // The virtual cluster of vhost.<name>.vcluster.<name>. stats.
+  const std::string VIRTUAL_CLUSTER = "envoy.virtual_cluster";
+  // The response code of <prefix>_rq_<code> stats.
+  const std::string RESPONSE_CODE = "envoy.response_code";
+  // The response code class of <prefix>_rq_<class>xx stats.
+  const std::string RESPONSE_CODE_CLASS = "envoy.response_code_class";
+};
+
+typedef ConstSingleton<TagNameValues> TagNames;
+
+/**
+ * Extracts a tag with a regular expression. The first capture group of the expression is the part
+ * of the name that is removed with the tag, and the last capture group is the value of the tag.
+ * They are the same group if the expression has only one. For example, ^cluster\.((.+?)\.) tags
+ * cluster.foo.upstream_rq_total with foo, and leaves cluster.upstream_rq_total.
+ */
+class TagExtractorImpl : public TagExtractor {
+public:
+  /**
+   * @param name supplies the name of the tags.
+   * @param regex supplies the regular expression. Throws EnvoyException if it is invalid or has no
+   *        capture group.
+   */
+  TagExtractorImpl(const std::string& name, const std::string& regex);
+
+  /**
+   * Create the extractors that the stats of a server are tagged with.
+   * @param tag_specifiers supplies the name and regular expression of each extractor to create in
+   *        addition to the default ones. They are applied before the default ones, in order.
+   * @return std::vector<TagExtractorPtr> the extractors. Throws EnvoyException if a regular
+   *         expression is invalid.
+   */
+  static std::vector<TagExtractorPtr>
+  createTagExtractors(const std::vector<std::pair<std::string, std::string>>& tag_specifiers);
+
+  /**
+   * Tag a stat name.
+   * @param name supplies the stat name.
+   * @param tag_extractors supplies the extractors to apply in order.
+   * @param tags receives the extracted tags.
+   * @return std::string the name with the tags removed.
+   */
+  static std::string extractTags(const std::string& name,
+                                 const std::vector<TagExtractorPtr>& tag_extractors,
+                                 std::vector<Tag>& tags);
+
+  // Stats::TagExtractor
+  const std::string& name() const override { return name_; }
+  bool extractTag(std::string& tag_extracted_name, std::vector<Tag>& tags) const override;
+
+private:
+  const std::string name_;
+  const std::regex regex_;
+};
+
+} // namespace Stats
+} // namespace Envoy
@@ -7,10 +7,15 @@
 #include <mutex>
 #include <string>
 #include <unordered_set>
+#include <vector>
+
+#include "common/stats/tag_extractor_impl.h"
 
 namespace Envoy {
 namespace Stats {
 
+std::atomic<uint64_t> ThreadLocalStoreImpl::ScopeImpl::next_scope_id_;
+
 ThreadLocalStoreImpl::ThreadLocalStoreImpl(RawStatDataAllocator& alloc)
     : alloc_(alloc), default_scope_(createScope("")),
       num_last_resort_stats_(default_scope_->counter("stats.overflow")) {}
@@ -22,13 +27,15 @@ ThreadLocalStoreImpl::~ThreadLocalStoreImpl() {
 }
 
 std::list<CounterSharedPtr> ThreadLocalStoreImpl::counters() const {
-  // Handle de-dup due to overlapping scopes.
+  // Handle de-dup due to overlapping scopes. Names are interned so identical names share the same
+  // storage.
   std::list<CounterSharedPtr> ret;
-  std::unordered_set<std::string> names;
+  std::unordered_set<const std::string*> names;
   std::unique_lock<std::mutex> lock(lock_);
   for (ScopeImpl* scope : scopes_) {
-    for (auto counter : scope->central_cache_.counters_) {
-      if (names.insert(counter.first).second) {
+    std::unique_lock<std::mutex> scope_lock(scope->lock_);
+    for (auto& counter : scope->central_cache_.counters_) {
+      if (names.insert(&counter.first.str()).second) {
         ret.push_back(counter.second);
       }
     }
@@ -47,11 +54,12 @@ ScopePtr ThreadLocalStoreImpl::createScope(const std::string& name) {
 std::list<GaugeSharedPtr> ThreadLocalStoreImpl::gauges() const {
   // Handle de-dup due to overlapping scopes.
   std::list<GaugeSharedPtr> ret;
-  std::unordered_set<std::string> names;
+  std::unordered_set<const std::string*> names;
   std::unique_lock<std::mutex> lock(lock_);
   for (ScopeImpl* scope : scopes_) {
-    for (auto gauge : scope->central_cache_.gauges_) {
-      if (names.insert(gauge.first).second) {
+    std::unique_lock<std::mutex> scope_lock(scope->lock_);
+    for (auto& gauge : scope->central_cache_.gauges_) {
+      if (names.insert(&gauge.first.str()).second) {
         ret.push_back(gauge.second);
       }
     }
@@ -60,6 +68,23 @@ std::list<GaugeSharedPtr> ThreadLocalStoreImpl::gauges() const {
   return ret;
 }
 
+std::list<ParentHistogramSharedPtr> ThreadLocalStoreImpl::histograms() const {
+  // Handle de-dup due to overlapping scopes.
+  std::list<ParentHistogramSharedPtr> ret;
+  std::unordered_set<const std::string*> names;
+  std::unique_lock<std::mutex> lock(lock_);
+  for (ScopeImpl* scope : scopes_) {
+    std::unique_lock<std::mutex> scope_lock(scope->lock_);
+    for (auto& histogram : scope->central_cache_.parent_histograms_) {
+      if (names.insert(&histogram.first.str()).second) {
+        ret.push_back(histogram.second);
+      }
+    }
+  }
+
+  return ret;
+}
+
 void ThreadLocalStoreImpl::initializeThreading(Event::Dispatcher& main_thread_dispatcher,
                                                ThreadLocal::Instance& tls) {
   main_thread_dispatcher_ = &main_thread_dispatcher;
@@ -74,6 +99,42 @@ void ThreadLocalStoreImpl::shutdownThreading() {
   shutting_down_ = true;
 }
 
+void ThreadLocalStoreImpl::mergeHistograms(std::function<void()> merge_complete_cb) {
+  if (shutting_down_ || !tls_) {
+    mergeParentHistograms(merge_complete_cb);
+    return;
+  }
+
+  ASSERT(!merge_in_progress_);
+  // Swap the buffers of every per thread histogram on its own thread. Once all threads are done
+  // the inactive buffers are no longer written to and can be merged on the main thread.
+  merge_in_progress_ = true;
+  tls_->runOnAllThreads(
+      [this]() -> void {
+        for (auto& scope_cache : tls_->getTyped<TlsCache>().scope_cache_) {
+          for (auto& histogram : scope_cache.second.histograms_) {
+            histogram.second->beginMerge();
+          }
+        }
+      },
+      [this, merge_complete_cb]() -> void { mergeParentHistograms(merge_complete_cb); });
+}
+
+void ThreadLocalStoreImpl::mergeParentHistograms(std::function<void()> merge_complete_cb) {
+  if (!shutting_down_) {
+    std::unique_lock<std::mutex> lock(lock_);
+    for (ScopeImpl* scope : scopes_) {
+      std::unique_lock<std::mutex> scope_lock(scope->lock_);
+      for (auto& histogram : scope->central_cache_.parent_histograms_) {
+        histogram.second->merge();
+      }
+    }
+  }
+
+  merge_in_progress_ = false;
+  merge_complete_cb();
+}
+
 void ThreadLocalStoreImpl::releaseScopeCrossThread(ScopeImpl* scope) {
   std::unique_lock<std::mutex> lock(lock_);
   ASSERT(scopes_.count(scope) == 1);
@@ -82,17 +143,18 @@ void ThreadLocalStoreImpl::releaseScopeCrossThread(ScopeImpl* scope) {
   // This can happen from any thread. We post() back to the main thread which will initiate the
   // cache flush operation.
   if (!shutting_down_ && main_thread_dispatcher_) {
-    main_thread_dispatcher_->post([this, scope]() -> void { clearScopeFromCaches(scope); });
+    const uint64_t scope_id = scope->scope_id_;
+    main_thread_dispatcher_->post([this, scope_id]() -> void { clearScopeFromCaches(scope_id); });
   }
 }
 
-void ThreadLocalStoreImpl::clearScopeFromCaches(ScopeImpl* scope) {
+void ThreadLocalStoreImpl::clearScopeFromCaches(uint64_t scope_id) {
   // If we are shutting down we no longer perform cache flushes as workers may be shutting down
   // at the same time.
   if (!shutting_down_) {
     // Perform a cache flush on all threads.
     tls_->runOnAllThreads(
-        [this, scope]() -> void { tls_->getTyped<TlsCache>().scope_cache_.erase(scope); });
+        [this, scope_id]() -> void { tls_->getTyped<TlsCache>().scope_cache_.erase(scope_id); });
   }
 }
 
@@ -109,41 +171,81 @@ ThreadLocalStoreImpl::SafeAllocData ThreadLocalStoreImpl::safeAlloc(const std::s
   }
 }
 
-ThreadLocalStoreImpl::ScopeImpl::~ScopeImpl() { parent_.releaseScopeCrossThread(this); }
+ThreadLocalStoreImpl::ScopeImpl::~ScopeImpl() {
+  parent_.releaseScopeCrossThread(this);
 
-Counter& ThreadLocalStoreImpl::ScopeImpl::counter(const std::string& name) {
-  // Determine the final name based on the prefix and the passed name.
-  std::string final_name = prefix_ + name;
+  // Per thread caches for this scope are never accessed again, so the interned names can be
+  // released now. The stats themselves may live on in per thread caches until they are flushed.
+  for (auto& counter : central_cache_.counters_) {
+    parent_.symbol_table_.free(counter.first);
+  }
+  for (auto& gauge : central_cache_.gauges_) {
+    parent_.symbol_table_.free(gauge.first);
+  }
+  for (auto& timer : central_cache_.timers_) {
+    parent_.symbol_table_.free(timer.first);
+  }
+  for (auto& histogram : central_cache_.parent_histograms_) {
+    parent_.symbol_table_.free(histogram.first);
+  }
+}
 
-  // We now try to acquire a *reference* to the TLS cache shared pointer. This might remain null
-  // if we don't have TLS initialized currently. The de-referenced pointer might be null if there
-  // is no cache entry.
-  CounterSharedPtr* tls_ref = nullptr;
+ThreadLocalStoreImpl::TlsCacheEntry* ThreadLocalStoreImpl::ScopeImpl::tlsCache() {
   if (!parent_.shutting_down_ && parent_.tls_) {
-    tls_ref = &parent_.tls_->getTyped<TlsCache>().scope_cache_[this].counters_[final_name];
+    return &parent_.tls_->getTyped<TlsCache>().scope_cache_[scope_id_];
   }
 
-  // If we have a valid cache entry, return it.
-  if (tls_ref && *tls_ref) {
-    return **tls_ref;
+  return nullptr;
+}
+
+template <class StatType>
+StatType& ThreadLocalStoreImpl::ScopeImpl::findOrCreate(
+    const std::string& name, StatNameRefMap<std::shared_ptr<StatType>>& central_cache_map,
+    StatNameRefMap<std::shared_ptr<StatType>>* tls_cache_map,
+    std::function<std::shared_ptr<StatType>(const std::string& name)> make_stat) {
+  // The lookup key refers to the caller's string. Only interned keys are stored in a cache.
+  const StatNameRef lookup_key(name);
+
+  // If we have a valid per thread cache entry, return it. This does not take any locks.
+  if (tls_cache_map) {
+    auto tls_stat = tls_cache_map->find(lookup_key);
+    if (tls_stat != tls_cache_map->end()) {
+      return *tls_stat->second;
+    }
   }
 
-  // We must now look in the central store so we must be locked. We grab a reference to the
-  // central store location. It might contain nothing. In this case, we allocate a new stat.
-  std::unique_lock<std::mutex> lock(parent_.lock_);
-  CounterSharedPtr& central_ref = central_cache_.counters_[final_name];
-  if (!central_ref) {
-    SafeAllocData alloc = parent_.safeAlloc(final_name);
-    central_ref.reset(new CounterImpl(alloc.data_, alloc.free_));
+  // We must now look in the central cache of this scope so we must be locked. If there is no entry,
+  // we intern the name and allocate a new stat.
+  std::unique_lock<std::mutex> lock(lock_);
+  auto central_stat = central_cache_map.find(lookup_key);
+  if (central_stat == central_cache_map.end()) {
+    std::shared_ptr<StatType> stat = make_stat(name);
+    central_stat = central_cache_map.emplace(parent_.symbol_table_.intern(name), stat).first;
   }
 
-  // If we have a TLS location to store or allocation into, do it.
-  if (tls_ref) {
-    *tls_ref = central_ref;
+  // If we have a per thread cache, store the stat there keyed by the interned name.
+  if (tls_cache_map) {
+    tls_cache_map->emplace(central_stat->first, central_stat->second);
   }
 
-  // Finally we return the reference.
-  return *central_ref;
+  return *central_stat->second;
+}
+
+Counter& ThreadLocalStoreImpl::ScopeImpl::counter(const std::string& name) {
+  // Determine the final name based on the prefix and the passed name.
+  const std::string final_name = prefix_ + name;
+  TlsCacheEntry* tls_cache = tlsCache();
+  return findOrCreate<Counter>(final_name, central_cache_.counters_,
+                               tls_cache ? &tls_cache->counters_ : nullptr,
+                               [this](const std::string& stat_name) -> CounterSharedPtr {
+                                 std::vector<Tag> tags;
+                                 std::string tag_extracted_name = TagExtractorImpl::extractTags(
+                                     stat_name, parent_.tag_extractors_, tags);
+                                 SafeAllocData alloc = parent_.safeAlloc(stat_name);
+                                 return std::make_shared<CounterImpl>(
+                                     alloc.data_, alloc.free_, &parent_.changed_stats_,
+                                     std::move(tag_extracted_name), std::move(tags));
+                               });
 }
 
 void ThreadLocalStoreImpl::ScopeImpl::deliverHistogramToSinks(const std::string& name,
@@ -157,6 +259,7 @@ void ThreadLocalStoreImpl::ScopeImpl::deliverHistogramToSinks(const std::string&
     return;
   }
 
+  histogram(name).recordValue(value);
   const std::string final_name = prefix_ + name;
   for (Sink& sink : parent_.timer_sinks_) {
     sink.onHistogramComplete(final_name, value);
@@ -170,6 +273,7 @@ void ThreadLocalStoreImpl::ScopeImpl::deliverTimingToSinks(const std::string& na
     return;
   }
 
+  histogram(name).recordValue(ms.count());
   const std::string final_name = prefix_ + name;
   for (Sink& sink : parent_.timer_sinks_) {
     sink.onTimespanComplete(final_name, ms);
@@ -177,56 +281,95 @@ void ThreadLocalStoreImpl::ScopeImpl::deliverTimingToSinks(const std::string& na
 }
 
 Gauge& ThreadLocalStoreImpl::ScopeImpl::gauge(const std::string& name) {
-  // See comments in counter(). There is no super clean way (via templates or otherwise) to
-  // share this code so I'm leaving it largely duplicated for now.
-  std::string final_name = prefix_ + name;
-  GaugeSharedPtr* tls_ref = nullptr;
-  if (!parent_.shutting_down_ && parent_.tls_) {
-    tls_ref = &parent_.tls_->getTyped<TlsCache>().scope_cache_[this].gauges_[final_name];
-  }
+  // See comments in counter().
+  const std::string final_name = prefix_ + name;
+  TlsCacheEntry* tls_cache = tlsCache();
+  return findOrCreate<Gauge>(final_name, central_cache_.gauges_,
+                             tls_cache ? &tls_cache->gauges_ : nullptr,
+                             [this](const std::string& stat_name) -> GaugeSharedPtr {
+                               std::vector<Tag> tags;
+                               std::string tag_extracted_name = TagExtractorImpl::extractTags(
+                                   stat_name, parent_.tag_extractors_, tags);
+                               SafeAllocData alloc = parent_.safeAlloc(stat_name);
+                               return std::make_shared<GaugeImpl>(
+                                   alloc.data_, alloc.free_, &parent_.changed_stats_,
+                                   std::move(tag_extracted_name), std::move(tags));
+                             });
+}
+
+Timer& ThreadLocalStoreImpl::ScopeImpl::timer(const std::string& name) {
+  // See comments in counter().
+  const std::string final_name = prefix_ + name;
+  TlsCacheEntry* tls_cache = tlsCache();
+  return findOrCreate<Timer>(final_name, central_cache_.timers_,
+                             tls_cache ? &tls_cache->timers_ : nullptr,
+                             [this](const std::string& stat_name) -> TimerSharedPtr {
+                               return std::make_shared<TimerImpl>(stat_name, parent_);
+                             });
+}
 
-  if (tls_ref && *tls_ref) {
-    return **tls_ref;
+Histogram& ThreadLocalStoreImpl::ScopeImpl::histogram(const std::string& name) {
+  // See comments in counter(). The parent histogram lives in the central cache and each thread
+  // gets its own histogram which is registered with the parent so that it can be merged.
+  const std::string final_name = prefix_ + name;
+  const StatNameRef lookup_key(final_name);
+  TlsCacheEntry* tls_cache = tlsCache();
+  if (tls_cache) {
+    auto tls_histogram = tls_cache->histograms_.find(lookup_key);
+    if (tls_histogram != tls_cache->histograms_.end()) {
+      return *tls_histogram->second;
+    }
   }
 
-  std::unique_lock<std::mutex> lock(parent_.lock_);
-  GaugeSharedPtr& central_ref = central_cache_.gauges_[final_name];
-  if (!central_ref) {
-    SafeAllocData alloc = parent_.safeAlloc(final_name);
-    central_ref.reset(new GaugeImpl(alloc.data_, alloc.free_));
+  std::unique_lock<std::mutex> lock(lock_);
+  auto central_histogram = central_cache_.parent_histograms_.find(lookup_key);
+  if (central_histogram == central_cache_.parent_histograms_.end()) {
+    std::vector<Tag> tags;
+    std::string tag_extracted_name =
+        TagExtractorImpl::extractTags(final_name, parent_.tag_extractors_, tags);
+    central_histogram =
+        central_cache_.parent_histograms_
+            .emplace(parent_.symbol_table_.intern(final_name),
+                     std::make_shared<ParentHistogramImpl>(
+                         final_name, std::move(tag_extracted_name), std::move(tags)))
+            .first;
   }
 
-  if (tls_ref) {
-    *tls_ref = central_ref;
+  if (!tls_cache) {
+    return *central_histogram->second;
   }
 
-  return *central_ref;
+  ThreadLocalHistogramSharedPtr tls_histogram =
+      std::make_shared<ThreadLocalHistogramImpl>(final_name);
+  central_histogram->second->addTlsHistogram(tls_histogram);
+  tls_cache->histograms_.emplace(central_histogram->first, tls_histogram);
+  return *tls_histogram;
 }
 
-Timer& ThreadLocalStoreImpl::ScopeImpl::timer(const std::string& name) {
-  // See comments in counter(). There is no super clean way (via templates or otherwise) to
-  // share this code so I'm leaving it largely duplicated for now.
-  std::string final_name = prefix_ + name;
-  TimerSharedPtr* tls_ref = nullptr;
-  if (!parent_.shutting_down_ && parent_.tls_) {
-    tls_ref = &parent_.tls_->getTyped<TlsCache>().scope_cache_[this].timers_[final_name];
-  }
-
-  if (tls_ref && *tls_ref) {
-    return **tls_ref;
-  }
+void ThreadLocalStoreImpl::ThreadLocalHistogramImpl::mergeInactiveInto(HistogramBuckets& target) {
+  HistogramBuckets& inactive = buffers_[1 - current_active_];
+  target.merge(inactive);
+  inactive.clear();
+}
 
-  std::unique_lock<std::mutex> lock(parent_.lock_);
-  TimerSharedPtr& central_ref = central_cache_.timers_[final_name];
-  if (!central_ref) {
-    central_ref.reset(new TimerImpl(final_name, parent_));
-  }
+void ThreadLocalStoreImpl::ParentHistogramImpl::addTlsHistogram(
+    const ThreadLocalHistogramSharedPtr& tls_histogram) {
+  std::unique_lock<std::mutex> lock(lock_);
+  tls_histograms_.push_back(tls_histogram);
+}
 
-  if (tls_ref) {
-    *tls_ref = central_ref;
+void ThreadLocalStoreImpl::ParentHistogramImpl::merge() {
+  std::unique_lock<std::mutex> lock(lock_);
+  for (const ThreadLocalHistogramSharedPtr& tls_histogram : tls_histograms_) {
+    tls_histogram->mergeInactiveInto(pending_);
   }
+  mergeInterval(pending_);
+  pending_.clear();
+}
 
-  return *central_ref;
+void ThreadLocalStoreImpl::ParentHistogramImpl::recordValue(uint64_t value) {
+  std::unique_lock<std::mutex> lock(lock_);
+  pending_.recordValue(value);
 }
 
 } // namespace Stats
@@ -1,17 +1,23 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "envoy/thread_local/thread_local.h"
 
+#include "common/stats/histogram_impl.h"
 #include "common/stats/stats_impl.h"
+#include "common/stats/symbol_table.h"
 
 namespace Envoy {
 namespace Stats {
@@ -31,15 +37,28 @@ namespace Stats {
  * - Scopes can be deleted from any thread, and they are in practice as scopes are likely to be
  *   shared across all worker threads.
  * - Per thread caches are checked, and if empty, they are populated from the central cache.
+ * - Each scope has its own central cache and lock, so cache fills for different scopes (for
+ *   example, different clusters) do not contend with each other.
  * - Scopes are entirely owned by the caller. The store only keeps weak pointers.
  * - When a scope is destroyed, a cache flush operation is run on all threads to flush any cached
- *   data owned by the destroyed scope.
- * - NOTE: It is theoretically possible that when a scope is deleted, it could be reallocated
- *         with the same address, and a cache flush operation could race and delete cache data
- *         for the new scope. This is extremely unlikely, and if it happens the cache will be
- *         repopulated on the next access.
- * - Since it's possible to have overlapping scopes, we de-dup stats when counters() or gauges() is
- *   called since these are very uncommon operations.
+ *   data owned by the destroyed scope. Per thread caches are keyed by a scope ID that is never
+ *   reused, so a new scope can never observe the cache of a destroyed one.
+ * - Stat names are interned in a symbol table. Central and per thread caches are keyed by
+ *   references to the interned names, so each name is stored once no matter how many threads
+ *   cache it. The central cache holds the references; per thread caches borrow them and are only
+ *   accessed while the owning scope is alive.
+ * - Since it's possible to have overlapping scopes, we de-dup stats when counters(), gauges(), or
+ *   histograms() is called since these are very uncommon operations.
+ * - Counters and gauges register themselves with a store wide tracker the first time they change
+ *   after a flush, so stat flushing via latchChangedCounters() and latchChangedGauges() never
+ *   walks the scopes. This only takes a lock on the first change of each stat per flush interval.
+ * - Histograms are recorded into per thread histograms without any synchronization. Each per
+ *   thread histogram is registered with a parent histogram in the central cache. During
+ *   mergeHistograms() every thread swaps the active buffer of its histograms, and the main thread
+ *   then merges the inactive buffers into the parents, which compute the quantiles. Overlapping
+ *   scopes do not share histograms, so histograms() returns only one of them.
+ * - Stats are tagged once, when they are created, with the extractors set by setTagExtractors().
+ *   The tag extracted name and the tags are kept with the stat so that sinks never parse names.
  * - Though this implementation is designed to work with a fixed shared memory space, it will fall
  *   back to heap allocated stats if needed. NOTE: In this case, overlapping scopes will not share
  *   the same backing store. This is to keep things simple, it could be done in the future if
@@ -61,27 +80,94 @@ public:
   }
   Gauge& gauge(const std::string& name) override { return default_scope_->gauge(name); }
   Timer& timer(const std::string& name) override { return default_scope_->timer(name); }
+  Histogram& histogram(const std::string& name) override {
+    return default_scope_->histogram(name);
+  }
 
   // Stats::Store
   std::list<CounterSharedPtr> counters() const override;
   std::list<GaugeSharedPtr> gauges() const override;
+  std::list<ParentHistogramSharedPtr> histograms() const override;
+  std::vector<CounterSharedPtr> latchChangedCounters() override {
+    return changed_stats_.latchChangedCounters();
+  }
+  std::vector<GaugeSharedPtr> latchChangedGauges() override {
+    return changed_stats_.latchChangedGauges();
+  }
 
   // Stats::StoreRoot
   void addSink(Sink& sink) override { timer_sinks_.push_back(sink); }
   void initializeThreading(Event::Dispatcher& main_thread_dispatcher,
                            ThreadLocal::Instance& tls) override;
   void shutdownThreading() override;
+  void mergeHistograms(std::function<void()> merge_complete_cb) override;
+  void setTagExtractors(std::vector<TagExtractorPtr>&& tag_extractors) override {
+    tag_extractors_ = std::move(tag_extractors);
+  }
 
 private:
+  /**
+   * A histogram that is only recorded into by a single thread. Values go into the active buffer.
+   * beginMerge() runs on the owning thread and swaps the buffers, after which the main thread can
+   * safely merge the inactive buffer until the next swap.
+   */
+  class ThreadLocalHistogramImpl : public Histogram {
+  public:
+    ThreadLocalHistogramImpl(const std::string& name) : name_(name) {}
+
+    void beginMerge() { current_active_ = 1 - current_active_; }
+    void mergeInactiveInto(HistogramBuckets& target);
+
+    // Stats::Histogram
+    void recordValue(uint64_t value) override { buffers_[current_active_].recordValue(value); }
+    std::string name() const override { return name_; }
+
+  private:
+    const std::string name_;
+    std::array<HistogramBuckets, 2> buffers_;
+    uint32_t current_active_{};
+  };
+
+  typedef std::shared_ptr<ThreadLocalHistogramImpl> ThreadLocalHistogramSharedPtr;
+
+  /**
+   * The histogram in the central cache that aggregates the per thread histograms.
+   */
+  class ParentHistogramImpl : public HistogramImpl {
+  public:
+    ParentHistogramImpl(const std::string& name, std::string&& tag_extracted_name,
+                        std::vector<Tag>&& tags)
+        : HistogramImpl(name, std::move(tag_extracted_name), std::move(tags)) {}
+
+    void addTlsHistogram(const ThreadLocalHistogramSharedPtr& tls_histogram);
+
+    // Stats::HistogramImpl
+    void merge() override;
+
+    // Stats::Histogram
+    // This is only used when per thread caching is not available.
+    void recordValue(uint64_t value) override;
+
+  private:
+    std::mutex lock_;
+    std::vector<ThreadLocalHistogramSharedPtr> tls_histograms_;
+  };
+
+  typedef std::shared_ptr<ParentHistogramImpl> ParentHistogramImplSharedPtr;
+
   struct TlsCacheEntry {
-    std::unordered_map<std::string, CounterSharedPtr> counters_;
-    std::unordered_map<std::string, GaugeSharedPtr> gauges_;
-    std::unordered_map<std::string, TimerSharedPtr> timers_;
+    StatNameRefMap<CounterSharedPtr> counters_;
+    StatNameRefMap<GaugeSharedPtr> gauges_;
+    StatNameRefMap<TimerSharedPtr> timers_;
+    // Only used by the central cache.
+    StatNameRefMap<ParentHistogramImplSharedPtr> parent_histograms_;
+    // Only used by per thread caches.
+    StatNameRefMap<ThreadLocalHistogramSharedPtr> histograms_;
   };
 
   struct ScopeImpl : public Scope {
     ScopeImpl(ThreadLocalStoreImpl& parent, const std::string& prefix)
-        : parent_(parent), prefix_(prefix) {}
+        : parent_(parent), scope_id_(next_scope_id_++), prefix_(prefix) {}
     ~ScopeImpl();
 
     // Stats::Scope
@@ -93,14 +179,40 @@ private:
     void deliverTimingToSinks(const std::string& name, std::chrono::milliseconds ms) override;
     Gauge& gauge(const std::string& name) override;
     Timer& timer(const std::string& name) override;
+    Histogram& histogram(const std::string& name) override;
+
+    /**
+     * Find a stat in the per thread cache or the central cache, creating it if needed.
+     * @param name supplies the final stat name.
+     * @param central_cache_map supplies the central cache map for the stat type.
+     * @param tls_cache_map supplies the per thread cache map for the stat type, or nullptr if
+     *        there is no per thread cache.
+     * @param make_stat supplies a function that creates a new stat.
+     */
+    template <class StatType>
+    StatType& findOrCreate(const std::string& name,
+                           StatNameRefMap<std::shared_ptr<StatType>>& central_cache_map,
+                           StatNameRefMap<std::shared_ptr<StatType>>* tls_cache_map,
+                           std::function<std::shared_ptr<StatType>(const std::string& name)>
+                               make_stat);
+
+    /**
+     * @return TlsCacheEntry* the per thread cache entry for this scope or nullptr if per thread
+     *         caching is not available.
+     */
+    TlsCacheEntry* tlsCache();
+
+    static std::atomic<uint64_t> next_scope_id_;
 
     ThreadLocalStoreImpl& parent_;
+    const uint64_t scope_id_;
     const std::string prefix_;
+    std::mutex lock_;
     TlsCacheEntry central_cache_;
   };
 
   struct TlsCache : public ThreadLocal::ThreadLocalObject {
-    std::unordered_map<ScopeImpl*, TlsCacheEntry> scope_cache_;
+    std::unordered_map<uint64_t, TlsCacheEntry> scope_cache_;
   };
 
   struct SafeAllocData {
@@ -108,11 +220,14 @@ private:
     RawStatDataAllocator& free_;
   };
 
-  void clearScopeFromCaches(ScopeImpl* scope);
+  void clearScopeFromCaches(uint64_t scope_id);
+  void mergeParentHistograms(std::function<void()> merge_complete_cb);
   void releaseScopeCrossThread(ScopeImpl* scope);
   SafeAllocData safeAlloc(const std::string& name);
 
   RawStatDataAllocator& alloc_;
+  ChangedStatsTracker changed_stats_;
+  SymbolTable symbol_table_;
   Event::Dispatcher* main_thread_dispatcher_{};
   ThreadLocal::SlotPtr tls_;
   mutable std::mutex lock_;
@@ -120,6 +235,8 @@ private:
   ScopePtr default_scope_;
   std::list<std::reference_wrapper<Sink>> timer_sinks_;
   std::atomic<bool> shutting_down_{};
+  bool merge_in_progress_{};
+  std::vector<TagExtractorPtr> tag_extractors_;
   Counter& num_last_resort_stats_;
   HeapRawStatDataAllocator heap_allocator_;
 };
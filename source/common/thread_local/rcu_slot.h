@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+
+#include "envoy/thread_local/thread_local.h"
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace ThreadLocal {
+
+/**
+ * Read-copy-update of an immutable object on top of a thread local slot. The main thread publishes
+ * new versions of the object, and every thread reads the version it last picked up through
+ * get(), which costs a slot lookup and no reference counting or locking.
+ *
+ * Threads pick up a new version in a post, which runs while no other callback of the thread does.
+ * A reference returned by get() is therefore never used past the point where its thread switches
+ * to a newer version. Once every thread has switched, the grace period of the previous version
+ * has ended, and the main thread drops its last reference to it, so that retired versions are
+ * always freed on the main thread. All methods but get() must be called on the main thread.
+ */
+template <class T> class RcuSlot {
+public:
+  typedef std::shared_ptr<const T> VersionSharedPtr;
+
+  /**
+   * @param tls supplies the slot allocator.
+   * @param initial supplies the first version of the object.
+   */
+  RcuSlot(SlotAllocator& tls, VersionSharedPtr initial)
+      : slot_(tls.allocateSlot()), retired_(std::make_shared<RetiredList>()) {
+    publish(std::move(initial));
+  }
+
+  /**
+   * Publish a new version of the object. Threads keep reading the previous version until they
+   * pick up the new one.
+   * @param value supplies the new version.
+   */
+  void publish(VersionSharedPtr value) {
+    ASSERT(value != nullptr);
+    const bool retire = current_ != nullptr;
+    if (retire) {
+      retired_->push_back(std::move(current_));
+    }
+    current_ = std::move(value);
+    version_++;
+
+    const VersionSharedPtr current = current_;
+    const uint64_t version = version_;
+    slot_->set([current, version](Event::Dispatcher&) -> ThreadLocalObjectSharedPtr {
+      return std::make_shared<ThreadVersion>(current, version);
+    });
+
+    if (retire) {
+      // The posts of a thread run in order, so the completion runs once every thread has switched
+      // away from the retired version. Grace periods end in publication order. The retired list
+      // outlives this slot until then.
+      std::shared_ptr<RetiredList> retired = retired_;
+      slot_->runOnAllThreads([]() -> void {}, [retired]() -> void { retired->pop_front(); });
+    }
+  }
+
+  /**
+   * @return const T& the version of the object that the calling thread last picked up. The
+   *         reference is valid until the calling thread returns to its event loop.
+   */
+  const T& get() { return *slot_->getTyped<ThreadVersion>().value_; }
+
+  /**
+   * @return const VersionSharedPtr& the version of the object that the calling thread last picked
+   *         up, for callers that keep it past the current callback. A version that a thread keeps
+   *         this way is freed where its last reference goes away.
+   */
+  const VersionSharedPtr& getShared() { return slot_->getTyped<ThreadVersion>().value_; }
+
+  /**
+   * @return uint64_t the version that the calling thread last picked up. Versions are numbered
+   *         from 1 in publication order.
+   */
+  uint64_t threadVersion() { return slot_->getTyped<ThreadVersion>().version_; }
+
+  /**
+   * @return const VersionSharedPtr& the latest published version.
+   */
+  const VersionSharedPtr& latest() const { return current_; }
+
+  /**
+   * @return uint64_t the number of the latest published version.
+   */
+  uint64_t version() const { return version_; }
+
+  /**
+   * @return uint64_t the number of retired versions whose grace period has not ended yet.
+   */
+  uint64_t retiredVersions() const { return retired_->size(); }
+
+private:
+  typedef std::list<VersionSharedPtr> RetiredList;
+
+  struct ThreadVersion : public ThreadLocalObject {
+    ThreadVersion(VersionSharedPtr value, uint64_t version)
+        : value_(std::move(value)), version_(version) {}
+
+    const VersionSharedPtr value_;
+    const uint64_t version_;
+  };
+
+  SlotPtr slot_;
+  VersionSharedPtr current_;
+  uint64_t version_{};
+  std::shared_ptr<RetiredList> retired_;
+};
+
+} // namespace ThreadLocal
+} // namespace Envoy
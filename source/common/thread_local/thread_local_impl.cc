@@ -3,6 +3,7 @@
 #include <atomic>
 #include <cstdint>
 #include <list>
+#include <memory>
 
 #include "envoy/event/dispatcher.h"
 
@@ -42,6 +43,11 @@ ThreadLocalObjectSharedPtr InstanceImpl::SlotImpl::get() {
   return thread_local_data_.data_[index_];
 }
 
+ThreadLocalObject& InstanceImpl::SlotImpl::getRef() {
+  ASSERT(thread_local_data_.data_.size() > index_ && thread_local_data_.data_[index_]);
+  return *thread_local_data_.data_[index_];
+}
+
 void InstanceImpl::registerThread(Event::Dispatcher& dispatcher, bool main_thread) {
   ASSERT(std::this_thread::get_id() == main_thread_id_);
   ASSERT(!shutdown_);
@@ -89,6 +95,30 @@ void InstanceImpl::runOnAllThreads(Event::PostCb cb) {
   cb();
 }
 
+void InstanceImpl::runOnAllThreads(Event::PostCb cb, Event::PostCb all_threads_complete_cb) {
+  ASSERT(std::this_thread::get_id() == main_thread_id_);
+  ASSERT(!shutdown_);
+  // Handle main thread first so that the completion callback can only be posted after it.
+  cb();
+  if (registered_threads_.empty()) {
+    all_threads_complete_cb();
+    return;
+  }
+
+  // The last worker to run the callback posts the completion back to the main thread.
+  std::shared_ptr<std::atomic<uint64_t>> worker_count =
+      std::make_shared<std::atomic<uint64_t>>(registered_threads_.size());
+  Event::Dispatcher& main_thread_dispatcher = *main_thread_dispatcher_;
+  for (Event::Dispatcher& dispatcher : registered_threads_) {
+    dispatcher.post([cb, all_threads_complete_cb, worker_count, &main_thread_dispatcher]() -> void {
+      cb();
+      if (--*worker_count == 0) {
+        main_thread_dispatcher.post(all_threads_complete_cb);
+      }
+    });
+  }
+}
+
 void InstanceImpl::SlotImpl::set(InitializeCb cb) {
   ASSERT(std::this_thread::get_id() == parent_.main_thread_id_);
   ASSERT(!parent_.shutdown_);
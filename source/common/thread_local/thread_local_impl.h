@@ -33,7 +33,11 @@ private:
 
     // ThreadLocal::Slot
     ThreadLocalObjectSharedPtr get() override;
+    ThreadLocalObject& getRef() override;
     void runOnAllThreads(Event::PostCb cb) override { parent_.runOnAllThreads(cb); }
+    void runOnAllThreads(Event::PostCb cb, Event::PostCb all_threads_complete_cb) override {
+      parent_.runOnAllThreads(cb, all_threads_complete_cb);
+    }
     void set(InitializeCb cb) override;
 
     InstanceImpl& parent_;
@@ -46,6 +50,7 @@ private:
 
   void removeSlot(SlotImpl& slot);
   void runOnAllThreads(Event::PostCb cb);
+  void runOnAllThreads(Event::PostCb cb, Event::PostCb all_threads_complete_cb);
   static void setThreadLocal(uint32_t index, ThreadLocalObjectSharedPtr object);
 
   static thread_local ThreadLocalData thread_local_data_;
@@ -115,6 +115,11 @@ Decision HttpTracerUtility::isTracing(const Http::AccessLog::RequestInfo& reques
   NOT_REACHED;
 }
 
+NullSpan& NullSpan::instance() {
+  static NullSpan* instance = new NullSpan();
+  return *instance;
+}
+
 HttpConnManFinalizerImpl::HttpConnManFinalizerImpl(Http::HeaderMap* request_headers,
                                                    Http::AccessLog::RequestInfo& request_info,
                                                    Config& tracing_config)
@@ -124,18 +129,18 @@ HttpConnManFinalizerImpl::HttpConnManFinalizerImpl(Http::HeaderMap* request_head
 void HttpConnManFinalizerImpl::finalize(Span& span) {
   // Pre response data.
   if (request_headers_) {
-    span.setTag("guid:x-request-id", std::string(request_headers_->RequestId()->value().c_str()));
-    span.setTag("http.url", buildUrl(*request_headers_));
-    span.setTag("http.method", request_headers_->Method()->value().c_str());
-    span.setTag("downstream_cluster",
+    span.setTag(Tags::get().GuidXRequestId, request_headers_->RequestId()->value().c_str());
+    span.setTag(Tags::get().HttpUrl, buildUrl(*request_headers_));
+    span.setTag(Tags::get().HttpMethod, request_headers_->Method()->value().c_str());
+    span.setTag(Tags::get().DownstreamCluster,
                 valueOrDefault(request_headers_->EnvoyDownstreamServiceCluster(), "-"));
-    span.setTag("user_agent", valueOrDefault(request_headers_->UserAgent(), "-"));
-    span.setTag("http.protocol",
+    span.setTag(Tags::get().UserAgent, valueOrDefault(request_headers_->UserAgent(), "-"));
+    span.setTag(Tags::get().HttpProtocol,
                 Http::AccessLog::AccessLogFormatUtils::protocolToString(request_info_.protocol()));
 
     if (request_headers_->ClientTraceId()) {
-      span.setTag("guid:x-client-trace-id",
-                  std::string(request_headers_->ClientTraceId()->value().c_str()));
+      span.setTag(Tags::get().GuidXClientTraceId,
+                  request_headers_->ClientTraceId()->value().c_str());
     }
 
     // Build tags based on the custom headers.
@@ -146,20 +151,21 @@ void HttpConnManFinalizerImpl::finalize(Span& span) {
       }
     }
   }
-  span.setTag("request_size", std::to_string(request_info_.bytesReceived()));
+  span.setTag(Tags::get().RequestSize, std::to_string(request_info_.bytesReceived()));
 
   if (nullptr != request_info_.upstreamHost()) {
-    span.setTag("upstream_cluster", request_info_.upstreamHost()->cluster().name());
+    span.setTag(Tags::get().UpstreamCluster, request_info_.upstreamHost()->cluster().name());
   }
 
   // Post response data.
-  span.setTag("http.status_code", buildResponseCode(request_info_));
-  span.setTag("response_size", std::to_string(request_info_.bytesSent()));
-  span.setTag("response_flags", Http::AccessLog::ResponseFlagUtils::toShortString(request_info_));
+  span.setTag(Tags::get().HttpStatusCode, buildResponseCode(request_info_));
+  span.setTag(Tags::get().ResponseSize, std::to_string(request_info_.bytesSent()));
+  span.setTag(Tags::get().ResponseFlags,
+              Http::AccessLog::ResponseFlagUtils::toShortString(request_info_));
 
   if (!request_info_.responseCode().valid() ||
       Http::CodeUtility::is5xx(request_info_.responseCode().value())) {
-    span.setTag("error", "true");
+    span.setTag(Tags::get().Error, Tags::get().True);
   }
 }
 
@@ -178,8 +184,8 @@ SpanPtr HttpTracerImpl::startSpan(const Config& config, Http::HeaderMap& request
   SpanPtr active_span =
       driver_->startSpan(config, request_headers, span_name, request_info.startTime());
   if (active_span) {
-    active_span->setTag("node_id", local_info_.nodeName());
-    active_span->setTag("zone", local_info_.zoneName());
+    active_span->setTag(Tags::get().NodeId, local_info_.nodeName());
+    active_span->setTag(Tags::get().Zone, local_info_.zoneName());
   }
 
   return active_span;
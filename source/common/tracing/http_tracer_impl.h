@@ -8,6 +8,7 @@
 #include "envoy/tracing/http_tracer.h"
 #include "envoy/upstream/cluster_manager.h"
 
+#include "common/common/singleton.h"
 #include "common/http/header_map_impl.h"
 #include "common/json/json_loader.h"
 
@@ -27,6 +28,33 @@ struct Decision {
   bool is_tracing;
 };
 
+/**
+ * Names of the tags that are set on the spans of HTTP requests. They are kept as strings, so that
+ * a temporary string does not have to be built from a literal for every tag of every span.
+ */
+class TracingTagValues {
+public:
+  const std::string DownstreamCluster = "downstream_cluster";
+  const std::string Error = "error";
+  const std::string GuidXClientTraceId = "guid:x-client-trace-id";
+  const std::string GuidXRequestId = "guid:x-request-id";
+  const std::string HttpMethod = "http.method";
+  const std::string HttpProtocol = "http.protocol";
+  const std::string HttpStatusCode = "http.status_code";
+  const std::string HttpUrl = "http.url";
+  const std::string NodeId = "node_id";
+  const std::string RequestSize = "request_size";
+  const std::string ResponseFlags = "response_flags";
+  const std::string ResponseSize = "response_size";
+  const std::string UpstreamCluster = "upstream_cluster";
+  const std::string UserAgent = "user_agent";
+  const std::string Zone = "zone";
+
+  const std::string True = "true";
+};
+
+typedef ConstSingleton<TracingTagValues> Tags;
+
 class HttpTracerUtility {
 public:
   /**
@@ -64,6 +92,12 @@ public:
 
 class NullSpan : public Span {
 public:
+  /**
+   * @return NullSpan& a span that is shared by all the requests that are not traced. It has no
+   *         state, so it can be used from any thread.
+   */
+  static NullSpan& instance();
+
   // Tracing::Span
   void setOperation(const std::string&) override {}
   void setTag(const std::string&, const std::string&) override {}
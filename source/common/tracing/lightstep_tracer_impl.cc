@@ -51,20 +51,23 @@ LightStepRecorder::LightStepRecorder(const lightstep::TracerImpl& tracer, LightS
     : builder_(tracer), driver_(driver) {
   flush_timer_ = dispatcher.createTimer([this]() -> void {
     driver_.tracerStats().timer_flushed_.inc();
-    flushSpans();
+    flushSpans(true);
     enableTimer();
   });
 
   enableTimer();
+  driver_.addRecorder();
 }
 
+LightStepRecorder::~LightStepRecorder() { driver_.removeRecorder(); }
+
 void LightStepRecorder::RecordSpan(lightstep::collector::Span&& span) {
   builder_.addSpan(std::move(span));
 
   uint64_t min_flush_spans =
       driver_.runtime().snapshot().getInteger("tracing.lightstep.min_flush_spans", 5U);
   if (builder_.pendingSpans() == min_flush_spans) {
-    flushSpans();
+    flushSpans(false);
   }
 }
 
@@ -86,24 +89,36 @@ void LightStepRecorder::enableTimer() {
   flush_timer_->enableTimer(std::chrono::milliseconds(flush_interval));
 }
 
-void LightStepRecorder::flushSpans() {
+void LightStepRecorder::flushSpans(bool timer) {
+  lightstep::collector::ReportRequest request;
   if (builder_.pendingSpans() != 0) {
-    driver_.tracerStats().spans_sent_.add(builder_.pendingSpans());
-    lightstep::collector::ReportRequest request;
     std::swap(request, builder_.pending());
+  }
 
-    Http::MessagePtr message = Grpc::Common::prepareHeaders(driver_.cluster()->name(),
-                                                            lightstep::CollectorServiceFullName(),
-                                                            lightstep::CollectorMethodName());
+  if (driver_.runtime().snapshot().getInteger("tracing.lightstep.shared_report", 0) != 0) {
+    if (!driver_.shareReport(request, timer)) {
+      return;
+    }
+  } else if (request.spans_size() == 0) {
+    return;
+  }
+  sendReport(std::move(request));
+}
 
-    message->body() = Grpc::Common::serializeBody(std::move(request));
+void LightStepRecorder::sendReport(lightstep::collector::ReportRequest&& request) {
+  driver_.tracerStats().spans_sent_.add(request.spans_size());
 
-    uint64_t timeout =
-        driver_.runtime().snapshot().getInteger("tracing.lightstep.request_timeout", 5000U);
-    driver_.clusterManager()
-        .httpAsyncClientForCluster(driver_.cluster()->name())
-        .send(std::move(message), *this, std::chrono::milliseconds(timeout));
-  }
+  Http::MessagePtr message = Grpc::Common::prepareHeaders(driver_.cluster()->name(),
+                                                          lightstep::CollectorServiceFullName(),
+                                                          lightstep::CollectorMethodName());
+
+  message->body() = Grpc::Common::serializeBody(std::move(request));
+
+  uint64_t timeout =
+      driver_.runtime().snapshot().getInteger("tracing.lightstep.request_timeout", 5000U);
+  driver_.clusterManager()
+      .httpAsyncClientForCluster(driver_.cluster()->name())
+      .send(std::move(message), *this, std::chrono::milliseconds(timeout));
 }
 
 LightStepDriver::TlsLightStepTracer::TlsLightStepTracer(lightstep::Tracer tracer,
@@ -139,6 +154,45 @@ LightStepDriver::LightStepDriver(const Json::Object& config,
   });
 }
 
+bool LightStepDriver::shareReport(lightstep::collector::ReportRequest& request, bool timer) {
+  const uint64_t max_spans =
+      runtime_.snapshot().getInteger("tracing.lightstep.shared_report_max_spans", 5000U);
+
+  std::unique_lock<std::mutex> lock(shared_report_lock_);
+  if (shared_report_.spans_size() == 0) {
+    // The first report keeps its reporter and auth fields for the shared report.
+    std::swap(shared_report_, request);
+  } else {
+    shared_report_.mutable_spans()->Reserve(shared_report_.spans_size() + request.spans_size());
+    for (auto& span : *request.mutable_spans()) {
+      shared_report_.add_spans()->Swap(&span);
+    }
+  }
+  request.Clear();
+
+  bool round_done = false;
+  if (timer && ++timer_flushes_ >= recorders_) {
+    round_done = true;
+    timer_flushes_ = 0;
+  }
+  if (shared_report_.spans_size() == 0 ||
+      (!round_done && static_cast<uint64_t>(shared_report_.spans_size()) < max_spans)) {
+    return false;
+  }
+  std::swap(shared_report_, request);
+  return true;
+}
+
+void LightStepDriver::addRecorder() {
+  std::unique_lock<std::mutex> lock(shared_report_lock_);
+  recorders_++;
+}
+
+void LightStepDriver::removeRecorder() {
+  std::unique_lock<std::mutex> lock(shared_report_lock_);
+  recorders_--;
+}
+
 SpanPtr LightStepDriver::startSpan(const Config&, Http::HeaderMap& request_headers,
                                    const std::string& operation_name, SystemTime start_time) {
   lightstep::Tracer& tracer = *tls_->getTyped<TlsLightStepTracer>().tracer_;
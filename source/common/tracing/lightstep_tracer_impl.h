@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 
 #include "envoy/runtime/runtime.h"
@@ -68,6 +69,21 @@ public:
   Runtime::Loader& runtime() { return runtime_; }
   LightstepTracerStats& tracerStats() { return tracer_stats_; }
 
+  /**
+   * Hand the spans of a worker's report over to the report that is shared by the workers, which
+   * is used when the tracing.lightstep.shared_report runtime key is set. The shared report is due
+   * once every worker's flush timer has fired since it was last sent, or once it holds
+   * tracing.lightstep.shared_report_max_spans spans.
+   * @param request supplies the worker's report, whose spans are moved out of it.
+   * @param timer supplies whether the worker flushes because its flush timer fired.
+   * @return bool whether the shared report is due, in which case it is moved into request for the
+   *         calling worker to send.
+   */
+  bool shareReport(lightstep::collector::ReportRequest& request, bool timer);
+
+  void addRecorder();
+  void removeRecorder();
+
 private:
   struct TlsLightStepTracer : ThreadLocal::ThreadLocalObject {
     TlsLightStepTracer(lightstep::Tracer tracer, LightStepDriver& driver);
@@ -79,6 +95,11 @@ private:
   Upstream::ClusterManager& cm_;
   Upstream::ClusterInfoConstSharedPtr cluster_;
   LightstepTracerStats tracer_stats_;
+  // Declared ahead of tls_, as the recorders of the workers use them until they are destroyed.
+  std::mutex shared_report_lock_;
+  lightstep::collector::ReportRequest shared_report_;
+  uint32_t recorders_{};
+  uint32_t timer_flushes_{};
   ThreadLocal::SlotPtr tls_;
   Runtime::Loader& runtime_;
   std::unique_ptr<lightstep::TracerOptions> options_;
@@ -88,6 +109,7 @@ class LightStepRecorder : public lightstep::Recorder, Http::AsyncClient::Callbac
 public:
   LightStepRecorder(const lightstep::TracerImpl& tracer, LightStepDriver& driver,
                     Event::Dispatcher& dispatcher);
+  ~LightStepRecorder();
 
   // lightstep::Recorder
   void RecordSpan(lightstep::collector::Span&& span) override;
@@ -103,7 +125,8 @@ public:
 
 private:
   void enableTimer();
-  void flushSpans();
+  void flushSpans(bool timer);
+  void sendReport(lightstep::collector::ReportRequest&& request);
 
   lightstep::ReportBuilder builder_;
   LightStepDriver& driver_;
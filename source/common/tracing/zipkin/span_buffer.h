@@ -1,5 +1,6 @@
 #pragma once
 
+#include "common/tracing/zipkin/span_proto_encoder.h"
 #include "common/tracing/zipkin/zipkin_core_types.h"
 
 namespace Envoy {
@@ -57,9 +58,19 @@ public:
    */
   std::string toStringifiedJsonArray();
 
+  /**
+   * Appends the contents of the buffer to the output, encoded as a Zipkin v2 ListOfSpans protobuf.
+   *
+   * @param output The string to append to. Its capacity can be reused between flushes.
+   */
+  void toProtoListOfSpans(std::string& output) {
+    proto_encoder_.encodeListOfSpans(span_buffer_, output);
+  }
+
 private:
   // We use a pre-allocated vector to improve performance
   std::vector<Span> span_buffer_;
+  SpanProtoEncoder proto_encoder_;
 };
 } // namespace Zipkin
 } // namespace Envoy
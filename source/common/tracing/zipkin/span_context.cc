@@ -1,6 +1,7 @@
 #include "common/tracing/zipkin/span_context.h"
 
 #include "common/common/macros.h"
+#include "common/common/regex.h"
 #include "common/common/utility.h"
 #include "common/tracing/zipkin/zipkin_core_constants.h"
 
@@ -54,8 +55,8 @@ static const std::string& spanContextRegexStr() {
  * Note that a function is needed because the string used to build the regex
  * cannot be initialized statically.
  */
-static const std::regex& spanContextRegex() {
-  CONSTRUCT_ON_FIRST_USE(std::regex, spanContextRegexStr());
+static const Regex::CompiledMatcher& spanContextRegex() {
+  CONSTRUCT_ON_FIRST_USE(Regex::Re2Matcher, spanContextRegexStr());
 }
 } // namespace
 
@@ -80,15 +81,15 @@ const std::string SpanContext::serializeToString() {
 }
 
 void SpanContext::populateFromString(const std::string& span_context_str) {
-  std::smatch match;
+  std::vector<std::string> match;
 
   trace_id_ = parent_id_ = id_ = 0;
 
-  if (std::regex_search(span_context_str, match, spanContextRegex())) {
+  if (spanContextRegex().match(span_context_str, match)) {
     // This is a valid string encoding of the context
-    trace_id_ = std::stoull(match.str(1), nullptr, 16);
-    id_ = std::stoull(match.str(2), nullptr, 16);
-    parent_id_ = std::stoull(match.str(3), nullptr, 16);
+    trace_id_ = std::stoull(match[0], nullptr, 16);
+    id_ = std::stoull(match[1], nullptr, 16);
+    parent_id_ = std::stoull(match[2], nullptr, 16);
 
     is_initialized_ = true;
   } else {
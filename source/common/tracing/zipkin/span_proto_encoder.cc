@@ -0,0 +1,213 @@
+#include "common/tracing/zipkin/span_proto_encoder.h"
+
+#include <array>
+#include <cstring>
+
+#include "common/tracing/zipkin/zipkin_core_constants.h"
+
+namespace Envoy {
+namespace Zipkin {
+
+namespace {
+
+// Field numbers of zipkin.proto3.
+const uint32_t LIST_OF_SPANS_SPANS = 1;
+
+const uint32_t SPAN_TRACE_ID = 1;
+const uint32_t SPAN_PARENT_ID = 2;
+const uint32_t SPAN_ID = 3;
+const uint32_t SPAN_KIND = 4;
+const uint32_t SPAN_NAME = 5;
+const uint32_t SPAN_TIMESTAMP = 6;
+const uint32_t SPAN_DURATION = 7;
+const uint32_t SPAN_LOCAL_ENDPOINT = 8;
+const uint32_t SPAN_ANNOTATIONS = 10;
+const uint32_t SPAN_TAGS = 11;
+const uint32_t SPAN_DEBUG = 12;
+const uint32_t SPAN_SHARED = 13;
+
+const uint32_t ENDPOINT_SERVICE_NAME = 1;
+const uint32_t ENDPOINT_IPV4 = 2;
+const uint32_t ENDPOINT_IPV6 = 3;
+const uint32_t ENDPOINT_PORT = 4;
+
+const uint32_t ANNOTATION_TIMESTAMP = 1;
+const uint32_t ANNOTATION_VALUE = 2;
+
+const uint32_t MAP_ENTRY_KEY = 1;
+const uint32_t MAP_ENTRY_VALUE = 2;
+
+bool isCoreAnnotation(const std::string& value) {
+  const ZipkinCoreConstantValues& constants = ZipkinCoreConstants::get();
+  return value == constants.CLIENT_SEND || value == constants.CLIENT_RECV ||
+         value == constants.SERVER_SEND || value == constants.SERVER_RECV;
+}
+
+} // namespace
+
+void SpanProtoEncoder::encodeListOfSpans(const std::vector<Span>& spans, std::string& output) {
+  for (const Span& span : spans) {
+    encodeSpanFields(span);
+    appendBytes(LIST_OF_SPANS_SPANS, span_.data(), span_.size(), output);
+  }
+}
+
+void SpanProtoEncoder::encodeSpan(const Span& span, std::string& output) {
+  encodeSpanFields(span);
+  output.append(span_);
+}
+
+void SpanProtoEncoder::encodeSpanFields(const Span& span) {
+  const ZipkinCoreConstantValues& constants = ZipkinCoreConstants::get();
+  span_.clear();
+
+  // The kind, the local endpoint, and the timestamps when the span does not have its own, all come
+  // from the core annotations.
+  Kind kind = Kind::Unspecified;
+  const Annotation* start = nullptr;
+  const Annotation* server_send = nullptr;
+  for (const Annotation& annotation : span.annotations()) {
+    if (start == nullptr && annotation.value() == constants.CLIENT_SEND) {
+      kind = Kind::Client;
+      start = &annotation;
+    } else if (start == nullptr && annotation.value() == constants.SERVER_RECV) {
+      kind = Kind::Server;
+      start = &annotation;
+    } else if (annotation.value() == constants.SERVER_SEND) {
+      server_send = &annotation;
+    }
+  }
+
+  appendId(SPAN_TRACE_ID, span.isSetTraceIdHigh() ? span.traceIdHigh() : 0, span.traceId(),
+           span.isSetTraceIdHigh(), span_);
+  if (span.isSetParentId()) {
+    appendId(SPAN_PARENT_ID, 0, span.parentId(), false, span_);
+  }
+  appendId(SPAN_ID, 0, span.id(), false, span_);
+  if (kind != Kind::Unspecified) {
+    appendTag(SPAN_KIND, WireType::Varint, span_);
+    appendVarint(static_cast<uint64_t>(kind), span_);
+  }
+  if (!span.name().empty()) {
+    appendString(SPAN_NAME, span.name(), span_);
+  }
+
+  if (span.isSetTimestamp()) {
+    appendFixed64(SPAN_TIMESTAMP, span.timestamp(), span_);
+  } else if (start != nullptr) {
+    appendFixed64(SPAN_TIMESTAMP, start->timestamp(), span_);
+  }
+  if (span.isSetDuration()) {
+    appendTag(SPAN_DURATION, WireType::Varint, span_);
+    appendVarint(span.duration(), span_);
+  } else if (kind == Kind::Server && server_send != nullptr &&
+             server_send->timestamp() >= start->timestamp()) {
+    appendTag(SPAN_DURATION, WireType::Varint, span_);
+    appendVarint(server_send->timestamp() - start->timestamp(), span_);
+  }
+
+  if (start != nullptr && start->isSetEndpoint()) {
+    appendEndpoint(SPAN_LOCAL_ENDPOINT, start->endpoint(), span_);
+  }
+
+  for (const Annotation& annotation : span.annotations()) {
+    if (isCoreAnnotation(annotation.value())) {
+      continue;
+    }
+    nested_.clear();
+    appendFixed64(ANNOTATION_TIMESTAMP, annotation.timestamp(), nested_);
+    appendString(ANNOTATION_VALUE, annotation.value(), nested_);
+    appendBytes(SPAN_ANNOTATIONS, nested_.data(), nested_.size(), span_);
+  }
+
+  for (const BinaryAnnotation& binary_annotation : span.binaryAnnotations()) {
+    nested_.clear();
+    appendString(MAP_ENTRY_KEY, binary_annotation.key(), nested_);
+    appendString(MAP_ENTRY_VALUE, binary_annotation.value(), nested_);
+    appendBytes(SPAN_TAGS, nested_.data(), nested_.size(), span_);
+  }
+
+  if (span.debug()) {
+    appendTag(SPAN_DEBUG, WireType::Varint, span_);
+    appendVarint(1, span_);
+  }
+  if (kind == Kind::Server && !span.isSetTimestamp()) {
+    appendTag(SPAN_SHARED, WireType::Varint, span_);
+    appendVarint(1, span_);
+  }
+}
+
+void SpanProtoEncoder::appendVarint(uint64_t value, std::string& output) {
+  while (value >= 0x80) {
+    output.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  output.push_back(static_cast<char>(value));
+}
+
+void SpanProtoEncoder::appendTag(uint32_t field, WireType type, std::string& output) {
+  appendVarint((static_cast<uint64_t>(field) << 3) | static_cast<uint32_t>(type), output);
+}
+
+void SpanProtoEncoder::appendFixed64(uint32_t field, uint64_t value, std::string& output) {
+  appendTag(field, WireType::Fixed64, output);
+  // Fixed width values are little endian.
+  for (uint32_t i = 0; i < 8; i++) {
+    output.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+void SpanProtoEncoder::appendBytes(uint32_t field, const void* data, size_t size,
+                                   std::string& output) {
+  appendTag(field, WireType::LengthDelimited, output);
+  appendVarint(size, output);
+  output.append(static_cast<const char*>(data), size);
+}
+
+void SpanProtoEncoder::appendString(uint32_t field, const std::string& value,
+                                    std::string& output) {
+  appendBytes(field, value.data(), value.size(), output);
+}
+
+void SpanProtoEncoder::appendId(uint32_t field, uint64_t high, uint64_t low, bool has_high,
+                                std::string& output) {
+  // Ids are 8 or 16 bytes in big endian order, with the high bits of a 128-bit trace id first.
+  std::array<uint8_t, 16> bytes;
+  size_t size = 0;
+  if (has_high) {
+    for (int32_t shift = 56; shift >= 0; shift -= 8) {
+      bytes[size++] = static_cast<uint8_t>(high >> shift);
+    }
+  }
+  for (int32_t shift = 56; shift >= 0; shift -= 8) {
+    bytes[size++] = static_cast<uint8_t>(low >> shift);
+  }
+  appendBytes(field, bytes.data(), size, output);
+}
+
+void SpanProtoEncoder::appendEndpoint(uint32_t field, const Endpoint& endpoint,
+                                      std::string& output) {
+  nested_.clear();
+  if (!endpoint.serviceName().empty()) {
+    appendString(ENDPOINT_SERVICE_NAME, endpoint.serviceName(), nested_);
+  }
+  if (endpoint.address() != nullptr && endpoint.address()->ip() != nullptr) {
+    const Network::Address::Ip& ip = *endpoint.address()->ip();
+    if (ip.version() == Network::Address::IpVersion::v4) {
+      // The address is in network byte order already.
+      const uint32_t address = ip.ipv4()->address();
+      appendBytes(ENDPOINT_IPV4, &address, sizeof(address), nested_);
+    } else {
+      const std::array<uint8_t, 16> address = ip.ipv6()->address();
+      appendBytes(ENDPOINT_IPV6, address.data(), address.size(), nested_);
+    }
+    if (ip.port() != 0) {
+      appendTag(ENDPOINT_PORT, WireType::Varint, nested_);
+      appendVarint(ip.port(), nested_);
+    }
+  }
+  appendBytes(field, nested_.data(), nested_.size(), output);
+}
+
+} // namespace Zipkin
+} // namespace Envoy
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/tracing/zipkin/zipkin_core_types.h"
+
+namespace Envoy {
+namespace Zipkin {
+
+/**
+ * Encodes spans in the protobuf3 wire format of the Zipkin v2 ListOfSpans message, as accepted by
+ * the /api/v2/spans collector endpoint with the application/x-protobuf content type. See
+ * https://github.com/openzipkin/zipkin-api/blob/master/zipkin.proto
+ *
+ * Envoy spans follow the v1 model, where the kind of a span is given by its core annotations. Each
+ * span is mapped to one v2 span: a span that starts with CS is a CLIENT span and a span that starts
+ * with SR a SERVER span, with the endpoint of that annotation as the local endpoint. The core
+ * annotations themselves are not encoded, the other annotations are, and the binary annotations
+ * become the tags. A SERVER span without a timestamp joined the context of its client, and is
+ * marked as shared.
+ */
+class SpanProtoEncoder {
+public:
+  /**
+   * Appends the encoding of a ListOfSpans message to the output.
+   * @param spans supplies the spans to encode.
+   * @param output supplies the string to append to. Nothing is removed from it, so that the caller
+   *        can reuse the capacity of a string between encodings.
+   */
+  void encodeListOfSpans(const std::vector<Span>& spans, std::string& output);
+
+  /**
+   * Appends the encoding of a single Span message, without the ListOfSpans framing.
+   */
+  void encodeSpan(const Span& span, std::string& output);
+
+private:
+  enum class WireType : uint32_t { Varint = 0, Fixed64 = 1, LengthDelimited = 2 };
+  enum class Kind : uint64_t { Unspecified = 0, Client = 1, Server = 2 };
+
+  static void appendVarint(uint64_t value, std::string& output);
+  static void appendTag(uint32_t field, WireType type, std::string& output);
+  static void appendFixed64(uint32_t field, uint64_t value, std::string& output);
+  static void appendBytes(uint32_t field, const void* data, size_t size, std::string& output);
+  static void appendString(uint32_t field, const std::string& value, std::string& output);
+  static void appendId(uint32_t field, uint64_t high, uint64_t low, bool has_high,
+                       std::string& output);
+  void appendEndpoint(uint32_t field, const Endpoint& endpoint, std::string& output);
+  void encodeSpanFields(const Span& span);
+
+  // Scratch space for the nested messages, whose length has to be known before they are appended.
+  // The strings are kept so that their capacity is reused from span to span.
+  std::string span_;
+  std::string nested_;
+};
+
+} // namespace Zipkin
+} // namespace Envoy
@@ -0,0 +1,130 @@
+#include "common/tracing/zipkin/tail_sampler.h"
+
+#include "common/tracing/zipkin/zipkin_core_constants.h"
+
+namespace Envoy {
+namespace Zipkin {
+
+TailSampler::TailSampler(std::chrono::milliseconds latency_threshold,
+                         std::chrono::milliseconds window, uint64_t max_buffered_spans,
+                         MonotonicTimeSource& time_source)
+    : latency_threshold_(latency_threshold), window_(window),
+      max_buffered_spans_(max_buffered_spans), time_source_(time_source) {}
+
+uint64_t TailSampler::onSpan(const Span& span, std::vector<Span>& exported) {
+  const MonotonicTime now = time_source_.currentTime();
+  uint64_t discarded = expire(now);
+
+  if (isLocalRoot(span)) {
+    auto trace = traces_.find(span.traceId());
+    if (keep(span)) {
+      if (trace != traces_.end()) {
+        exported.insert(exported.end(), trace->second.spans_.begin(), trace->second.spans_.end());
+        erase(trace);
+      }
+      exported.push_back(span);
+    } else {
+      if (trace != traces_.end()) {
+        discarded += erase(trace);
+      }
+      discarded++;
+    }
+    return discarded;
+  }
+
+  if (max_buffered_spans_ == 0) {
+    return discarded + 1;
+  }
+  if (buffered_spans_ >= max_buffered_spans_) {
+    discarded += evictOldest();
+  }
+
+  auto inserted = traces_.emplace(span.traceId(), BufferedTrace{next_sequence_, {}});
+  if (inserted.second) {
+    arrivals_.push_back({span.traceId(), next_sequence_++, now});
+  }
+  inserted.first->second.spans_.push_back(span);
+  buffered_spans_++;
+  return discarded;
+}
+
+bool TailSampler::isLocalRoot(const Span& span) {
+  if (!span.isSetParentId()) {
+    return true;
+  }
+  for (const Annotation& annotation : span.annotations()) {
+    if (annotation.value() == ZipkinCoreConstants::get().SERVER_RECV) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::chrono::microseconds TailSampler::duration(const Span& span) {
+  if (span.isSetDuration()) {
+    return std::chrono::microseconds(span.duration());
+  }
+
+  // Shared context spans do not have their own duration.
+  const Annotation* server_recv = nullptr;
+  const Annotation* server_send = nullptr;
+  for (const Annotation& annotation : span.annotations()) {
+    if (annotation.value() == ZipkinCoreConstants::get().SERVER_RECV) {
+      server_recv = &annotation;
+    } else if (annotation.value() == ZipkinCoreConstants::get().SERVER_SEND) {
+      server_send = &annotation;
+    }
+  }
+  if (server_recv == nullptr || server_send == nullptr ||
+      server_send->timestamp() < server_recv->timestamp()) {
+    return std::chrono::microseconds(0);
+  }
+  return std::chrono::microseconds(server_send->timestamp() - server_recv->timestamp());
+}
+
+bool TailSampler::keep(const Span& root) const {
+  if (duration(root) >= latency_threshold_) {
+    return true;
+  }
+  for (const BinaryAnnotation& binary_annotation : root.binaryAnnotations()) {
+    if (binary_annotation.key() == ZipkinCoreConstants::get().ERROR) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t TailSampler::expire(MonotonicTime now) {
+  uint64_t discarded = 0;
+  while (!arrivals_.empty() && now - arrivals_.front().time_ >= window_) {
+    const Arrival arrival = arrivals_.front();
+    arrivals_.pop_front();
+    auto trace = traces_.find(arrival.trace_id_);
+    if (trace != traces_.end() && trace->second.sequence_ == arrival.sequence_) {
+      discarded += erase(trace);
+    }
+  }
+  return discarded;
+}
+
+uint64_t TailSampler::evictOldest() {
+  while (!arrivals_.empty()) {
+    const Arrival arrival = arrivals_.front();
+    arrivals_.pop_front();
+    auto trace = traces_.find(arrival.trace_id_);
+    if (trace != traces_.end() && trace->second.sequence_ == arrival.sequence_) {
+      return erase(trace);
+    }
+  }
+  return 0;
+}
+
+uint64_t TailSampler::erase(std::unordered_map<uint64_t, BufferedTrace>::iterator trace) {
+  const uint64_t spans = trace->second.spans_.size();
+  buffered_spans_ -= spans;
+  traces_.erase(trace);
+  return spans;
+}
+
+} // namespace Zipkin
+} // namespace Envoy
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "envoy/common/time.h"
+
+#include "common/tracing/zipkin/zipkin_core_types.h"
+
+namespace Envoy {
+namespace Zipkin {
+
+/**
+ * Tail-based sampler for the spans finished on one worker. The export decision of a trace is
+ * taken when its local root span finishes, which is the ingress (SR) span of the trace, or a span
+ * without a parent. The trace is kept if the root span took at least the latency threshold, or
+ * carries the error tag (which the HTTP connection manager sets on 5xx and reset requests), and
+ * is discarded otherwise.
+ *
+ * The other spans of a trace finish before its root span, and are buffered until the decision.
+ * The buffer is bounded both in time and in size: spans that have been buffered for longer than
+ * the window, or that are the oldest when the buffer is full, are discarded. Only the spans that
+ * finished on the same worker as the root span are part of its decision.
+ */
+class TailSampler {
+public:
+  TailSampler(std::chrono::milliseconds latency_threshold, std::chrono::milliseconds window,
+              uint64_t max_buffered_spans, MonotonicTimeSource& time_source);
+
+  /**
+   * Takes a finished span.
+   * @param span supplies the span.
+   * @param exported supplies the vector to which the spans of a kept trace are appended, with the
+   *        root span last.
+   * @return uint64_t the number of spans that were discarded, including the given span when its
+   *         trace was not kept.
+   */
+  uint64_t onSpan(const Span& span, std::vector<Span>& exported);
+
+  /**
+   * @return uint64_t the number of buffered spans.
+   */
+  uint64_t bufferedSpans() const { return buffered_spans_; }
+
+  /**
+   * @return bool whether the span is the local root of its trace.
+   */
+  static bool isLocalRoot(const Span& span);
+
+  /**
+   * @return std::chrono::microseconds the duration of the span, from the span itself or from its
+   *         SR and SS annotations.
+   */
+  static std::chrono::microseconds duration(const Span& span);
+
+private:
+  struct BufferedTrace {
+    uint64_t sequence_;
+    std::vector<Span> spans_;
+  };
+
+  // A buffered trace is identified by the sequence number of its first span, so that an arrival
+  // does not match a newer buffered trace with the same id.
+  struct Arrival {
+    uint64_t trace_id_;
+    uint64_t sequence_;
+    MonotonicTime time_;
+  };
+
+  bool keep(const Span& root) const;
+  uint64_t expire(MonotonicTime now);
+  uint64_t evictOldest();
+  uint64_t erase(std::unordered_map<uint64_t, BufferedTrace>::iterator trace);
+
+  const std::chrono::microseconds latency_threshold_;
+  const std::chrono::milliseconds window_;
+  const uint64_t max_buffered_spans_;
+  MonotonicTimeSource& time_source_;
+  std::unordered_map<uint64_t, BufferedTrace> traces_;
+  // The traces in the order in which their first span was buffered. The entries of the traces that
+  // have since been decided or discarded are skipped when they reach the front.
+  std::deque<Arrival> arrivals_;
+  uint64_t buffered_spans_{};
+  uint64_t next_sequence_{};
+};
+
+typedef std::unique_ptr<TailSampler> TailSamplerPtr;
+
+} // namespace Zipkin
+} // namespace Envoy
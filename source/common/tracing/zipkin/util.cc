@@ -2,7 +2,6 @@
 
 #include <chrono>
 #include <random>
-#include <regex>
 
 #include "common/common/hex.h"
 #include "common/common/utility.h"
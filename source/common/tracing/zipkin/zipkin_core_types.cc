@@ -254,7 +254,9 @@ void Span::finish() {
 
 void Span::setTag(const std::string& name, const std::string& value) {
   if (name.size() > 0 && value.size() > 0) {
-    addBinaryAnnotation(BinaryAnnotation(name, value));
+    // Construct the annotation in place. The user defined copy constructor of BinaryAnnotation
+    // means that it has no move constructor, so adding a temporary copies both strings again.
+    binary_annotations_.emplace_back(name, value);
   }
 }
 } // namespace Zipkin
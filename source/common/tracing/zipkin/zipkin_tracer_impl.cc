@@ -1,6 +1,7 @@
 #include "common/tracing/zipkin/zipkin_tracer_impl.h"
 
 #include "common/common/enum_to_int.h"
+#include "common/common/utility.h"
 #include "common/http/headers.h"
 #include "common/http/message_impl.h"
 #include "common/http/utility.h"
@@ -67,15 +68,49 @@ Driver::Driver(const Json::Object& config, Upstream::ClusterManager& cluster_man
   }
   cluster_ = cluster->info();
 
-  const std::string collector_endpoint =
-      config.getString("collector_endpoint", ZipkinCoreConstants::get().DEFAULT_COLLECTOR_ENDPOINT);
+  const ZipkinCoreConstantValues& constants = ZipkinCoreConstants::get();
+  const std::string encoding =
+      config.getString("collector_encoding", constants.COLLECTOR_ENCODING_JSON);
+  CollectorEncoding collector_encoding;
+  if (encoding == constants.COLLECTOR_ENCODING_JSON) {
+    collector_encoding = CollectorEncoding::Json;
+  } else if (encoding == constants.COLLECTOR_ENCODING_PROTO) {
+    collector_encoding = CollectorEncoding::Proto;
+  } else {
+    throw EnvoyException(fmt::format("unknown zipkin collector encoding '{}'", encoding));
+  }
 
-  tls_->set([this, collector_endpoint, &random_generator](
+  // The v1 API only accepts JSON, so the protobuf encoding defaults to the v2 API.
+  const std::string collector_endpoint = config.getString(
+      "collector_endpoint", collector_encoding == CollectorEncoding::Proto
+                                ? constants.DEFAULT_PROTO_COLLECTOR_ENDPOINT
+                                : constants.DEFAULT_COLLECTOR_ENDPOINT);
+
+  const bool tail_sampling = config.hasObject("tail_sampling");
+  std::chrono::milliseconds latency_threshold{};
+  std::chrono::milliseconds window{};
+  uint64_t max_buffered_spans = 0;
+  if (tail_sampling) {
+    const Json::ObjectSharedPtr tail_sampling_config = config.getObject("tail_sampling");
+    latency_threshold =
+        std::chrono::milliseconds(tail_sampling_config->getInteger("latency_threshold_ms"));
+    window = std::chrono::milliseconds(tail_sampling_config->getInteger("window_ms", 5000));
+    max_buffered_spans = tail_sampling_config->getInteger("max_buffered_spans", 1024);
+  }
+
+  tls_->set([this, collector_endpoint, collector_encoding, tail_sampling, latency_threshold,
+             window, max_buffered_spans, &random_generator](
                 Event::Dispatcher& dispatcher) -> ThreadLocal::ThreadLocalObjectSharedPtr {
     TracerPtr tracer(
         new Tracer(local_info_.clusterName(), local_info_.address(), random_generator));
-    tracer->setReporter(
-        ReporterImpl::NewInstance(std::ref(*this), std::ref(dispatcher), collector_endpoint));
+    TailSamplerPtr tail_sampler;
+    if (tail_sampling) {
+      tail_sampler.reset(new TailSampler(latency_threshold, window, max_buffered_spans,
+                                         ProdMonotonicTimeSource::instance_));
+    }
+    tracer->setReporter(ReporterImpl::NewInstance(std::ref(*this), std::ref(dispatcher),
+                                                  collector_endpoint, collector_encoding,
+                                                  std::move(tail_sampler)));
     return ThreadLocal::ThreadLocalObjectSharedPtr{new TlsTracer(std::move(tracer), *this)};
   });
 }
@@ -117,8 +152,11 @@ Tracing::SpanPtr Driver::startSpan(const Tracing::Config& config, Http::HeaderMa
 }
 
 ReporterImpl::ReporterImpl(Driver& driver, Event::Dispatcher& dispatcher,
-                           const std::string& collector_endpoint)
-    : driver_(driver), collector_endpoint_(collector_endpoint) {
+                           const std::string& collector_endpoint,
+                           CollectorEncoding collector_encoding,
+                           TailSamplerPtr&& tail_sampler)
+    : driver_(driver), collector_endpoint_(collector_endpoint),
+      collector_encoding_(collector_encoding), tail_sampler_(std::move(tail_sampler)) {
   flush_timer_ = dispatcher.createTimer([this]() -> void {
     driver_.tracerStats().timer_flushed_.inc();
     flushSpans();
@@ -133,22 +171,48 @@ ReporterImpl::ReporterImpl(Driver& driver, Event::Dispatcher& dispatcher,
 }
 
 ReporterPtr ReporterImpl::NewInstance(Driver& driver, Event::Dispatcher& dispatcher,
-                                      const std::string& collector_endpoint) {
-  return ReporterPtr(new ReporterImpl(driver, dispatcher, collector_endpoint));
+                                      const std::string& collector_endpoint,
+                                      CollectorEncoding collector_encoding,
+                                      TailSamplerPtr&& tail_sampler) {
+  return ReporterPtr(new ReporterImpl(driver, dispatcher, collector_endpoint, collector_encoding,
+                                      std::move(tail_sampler)));
 }
 
 // TODO(fabolive): Need to avoid the copy to improve performance.
 void ReporterImpl::reportSpan(const Span& span) {
-  span_buffer_.addSpan(span);
+  if (tail_sampler_) {
+    tail_sampled_spans_.clear();
+    driver_.tracerStats().tail_discarded_.add(tail_sampler_->onSpan(span, tail_sampled_spans_));
+    if (tail_sampled_spans_.empty()) {
+      return;
+    }
+    driver_.tracerStats().tail_sampled_.inc();
+    bufferTailSampledSpans();
+  } else if (!span_buffer_.addSpan(span)) {
+    driver_.tracerStats().spans_dropped_.inc();
+  }
 
   const uint64_t min_flush_spans =
       driver_.runtime().snapshot().getInteger("tracing.zipkin.min_flush_spans", 5U);
 
-  if (span_buffer_.pendingSpans() == min_flush_spans) {
+  // The flush threshold may have been lowered below the number of pending spans at runtime.
+  if (span_buffer_.pendingSpans() >= min_flush_spans) {
     flushSpans();
   }
 }
 
+void ReporterImpl::bufferTailSampledSpans() {
+  for (const Span& span : tail_sampled_spans_) {
+    if (span_buffer_.addSpan(span)) {
+      continue;
+    }
+    flushSpans();
+    if (!span_buffer_.addSpan(span)) {
+      driver_.tracerStats().spans_dropped_.inc();
+    }
+  }
+}
+
 void ReporterImpl::enableTimer() {
   const uint64_t flush_interval =
       driver_.runtime().snapshot().getInteger("tracing.zipkin.flush_interval_ms", 5000U);
@@ -159,16 +223,24 @@ void ReporterImpl::flushSpans() {
   if (span_buffer_.pendingSpans()) {
     driver_.tracerStats().spans_sent_.add(span_buffer_.pendingSpans());
 
-    const std::string request_body = span_buffer_.toStringifiedJsonArray();
     Http::MessagePtr message(new Http::RequestMessageImpl());
     message->headers().insertMethod().value().setReference(Http::Headers::get().MethodValues.Post);
     message->headers().insertPath().value(collector_endpoint_);
     message->headers().insertHost().value(driver_.cluster()->name());
-    message->headers().insertContentType().value().setReference(
-        Http::Headers::get().ContentTypeValues.Json);
+
+    request_body_.clear();
+    if (collector_encoding_ == CollectorEncoding::Proto) {
+      span_buffer_.toProtoListOfSpans(request_body_);
+      message->headers().insertContentType().value().setReference(
+          Http::Headers::get().ContentTypeValues.Protobuf);
+    } else {
+      request_body_ = span_buffer_.toStringifiedJsonArray();
+      message->headers().insertContentType().value().setReference(
+          Http::Headers::get().ContentTypeValues.Json);
+    }
 
     Buffer::InstancePtr body(new Buffer::OwnedImpl());
-    body->add(request_body);
+    body->add(request_body_);
     message->body() = std::move(body);
 
     const uint64_t timeout =
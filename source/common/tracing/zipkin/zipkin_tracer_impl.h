@@ -9,6 +9,7 @@
 #include "common/http/header_map_impl.h"
 #include "common/json/json_loader.h"
 #include "common/tracing/zipkin/span_buffer.h"
+#include "common/tracing/zipkin/tail_sampler.h"
 #include "common/tracing/zipkin/tracer.h"
 
 namespace Envoy {
@@ -16,10 +17,13 @@ namespace Zipkin {
 
 #define ZIPKIN_TRACER_STATS(COUNTER)                                                               \
   COUNTER(spans_sent)                                                                              \
+  COUNTER(spans_dropped)                                                                           \
   COUNTER(timer_flushed)                                                                           \
   COUNTER(reports_sent)                                                                            \
   COUNTER(reports_dropped)                                                                         \
-  COUNTER(reports_failed)
+  COUNTER(reports_failed)                                                                          \
+  COUNTER(tail_sampled)                                                                            \
+  COUNTER(tail_discarded)
 
 struct ZipkinTracerStats {
   ZIPKIN_TRACER_STATS(GENERATE_COUNTER_STRUCT)
@@ -77,6 +81,16 @@ private:
 
 typedef std::unique_ptr<ZipkinSpan> ZipkinSpanPtr;
 
+/**
+ * The encoding of the spans sent to the Zipkin collector.
+ */
+enum class CollectorEncoding {
+  // A JSON array of Zipkin v1 spans.
+  Json,
+  // A protobuf ListOfSpans message of Zipkin v2 spans.
+  Proto
+};
+
 /**
  * Class for a Zipkin-specific Driver.
  */
@@ -131,7 +145,7 @@ private:
 /**
  * This class derives from the abstract Zipkin::Reporter.
  * It buffers spans and relies on Http::AsyncClient to send spans to
- * Zipkin using JSON over HTTP.
+ * Zipkin using either JSON or protobuf over HTTP.
  *
  * Two runtime parameters control the span buffering/flushing behavior, namely:
  * tracing.zipkin.min_flush_spans and tracing.zipkin.flush_interval_ms.
@@ -141,6 +155,13 @@ private:
  * expires, whichever happens first.
  *
  * The default values for the runtime parameters are 5 spans and 5000ms.
+ *
+ * Each worker has its own reporter. The span buffer is sized for `tracing.zipkin.min_flush_spans`
+ * when the reporter is created, and spans that are reported while it is full are dropped and
+ * counted, rather than growing the buffer.
+ *
+ * With tail sampling, the reported spans go through a per-worker TailSampler first, and only the
+ * spans of the traces that it keeps are buffered.
  */
 class ReporterImpl : public Reporter, Http::AsyncClient::Callbacks {
 public:
@@ -152,9 +173,12 @@ public:
    * @param collector_endpoint String representing the Zipkin endpoint to be used
    * when making HTTP POST requests carrying spans. This value comes from the
    * Zipkin-related tracing configuration.
+   * @param collector_encoding The encoding of the spans in the HTTP POST requests.
+   * @param tail_sampler The tail sampler that decides which spans are sent, or nullptr to send all
+   * the reported spans.
    */
-  ReporterImpl(Driver& driver, Event::Dispatcher& dispatcher,
-               const std::string& collector_endpoint);
+  ReporterImpl(Driver& driver, Event::Dispatcher& dispatcher, const std::string& collector_endpoint,
+               CollectorEncoding collector_encoding, TailSamplerPtr&& tail_sampler);
 
   /**
    * Implementation of Zipkin::Reporter::reportSpan().
@@ -178,11 +202,16 @@ public:
    * @param collector_endpoint String representing the Zipkin endpoint to be used
    * when making HTTP POST requests carrying spans. This value comes from the
    * Zipkin-related tracing configuration.
+   * @param collector_encoding The encoding of the spans in the HTTP POST requests.
+   * @param tail_sampler The tail sampler that decides which spans are sent, or nullptr to send all
+   * the reported spans.
    *
    * @return Pointer to the newly-created ZipkinReporter.
    */
   static ReporterPtr NewInstance(Driver& driver, Event::Dispatcher& dispatcher,
-                                 const std::string& collector_endpoint);
+                                 const std::string& collector_endpoint,
+                                 CollectorEncoding collector_encoding,
+                                 TailSamplerPtr&& tail_sampler);
 
 private:
   /**
@@ -195,10 +224,21 @@ private:
    */
   void flushSpans();
 
+  /**
+   * Adds the spans of a trace that the tail sampler kept to the span buffer, flushing it when it
+   * fills up, since a whole trace is added at once.
+   */
+  void bufferTailSampledSpans();
+
   Driver& driver_;
   Event::TimerPtr flush_timer_;
   SpanBuffer span_buffer_;
   const std::string collector_endpoint_;
+  const CollectorEncoding collector_encoding_;
+  // The encoded request body. It is kept so that its capacity is reused from flush to flush.
+  std::string request_body_;
+  TailSamplerPtr tail_sampler_;
+  std::vector<Span> tail_sampled_spans_;
 };
 } // Zipkin
 } // namespace Envoy
@@ -41,8 +41,7 @@ void CdsSubscription::createRequest(Http::Message& request) {
 
 void CdsSubscription::parseResponse(const Http::Message& response) {
   ENVOY_LOG(debug, "cds: parsing response");
-  const std::string response_body = response.bodyAsString();
-  Json::ObjectSharedPtr response_json = Json::Factory::loadFromString(response_body);
+  Json::ObjectSharedPtr response_json = parseJsonBody(response);
   response_json->validateSchema(Json::Schema::CDS_SCHEMA);
   std::vector<Json::ObjectSharedPtr> clusters = response_json->getObjectArray("clusters");
 
@@ -1,10 +1,14 @@
 #include "common/upstream/cluster_manager_impl.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <functional>
 #include <list>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "envoy/event/dispatcher.h"
@@ -24,14 +28,54 @@
 #include "common/router/shadow_writer_impl.h"
 #include "common/upstream/cds_api_impl.h"
 #include "common/upstream/load_balancer_impl.h"
+#include "common/upstream/maglev_lb.h"
 #include "common/upstream/original_dst_cluster.h"
 #include "common/upstream/ring_hash_lb.h"
+#include "common/upstream/subset_lb.h"
 
 #include "fmt/format.h"
 
 namespace Envoy {
 namespace Upstream {
 
+namespace {
+
+// Appends hosts to pending, except for the hosts that are in opposite, which are dropped from
+// opposite instead as the two changes cancel out.
+void mergeHostUpdates(const std::vector<HostSharedPtr>& hosts, std::vector<HostSharedPtr>& pending,
+                      std::vector<HostSharedPtr>& opposite) {
+  if (opposite.empty()) {
+    pending.insert(pending.end(), hosts.begin(), hosts.end());
+    return;
+  }
+
+  std::unordered_set<HostSharedPtr> remaining(hosts.begin(), hosts.end());
+  opposite.erase(std::remove_if(opposite.begin(), opposite.end(),
+                                [&remaining](const HostSharedPtr& host) -> bool {
+                                  return remaining.erase(host) > 0;
+                                }),
+                 opposite.end());
+  for (const HostSharedPtr& host : hosts) {
+    if (remaining.count(host) > 0) {
+      pending.push_back(host);
+    }
+  }
+}
+
+// The ids of the cluster names, @see ClusterManagerImpl::clusterId().
+struct ClusterIds {
+  std::mutex lock_;
+  std::unordered_map<std::string, uint32_t> ids_;
+};
+
+// Never destroyed, since the cluster managers of the process may use it until it exits.
+ClusterIds& clusterIds() {
+  static ClusterIds* ids = new ClusterIds();
+  return *ids;
+}
+
+} // namespace
+
 void ClusterManagerInitHelper::addCluster(Cluster& cluster) {
   if (state_ == State::AllClustersInitialized) {
     cluster.initialize();
@@ -44,10 +88,11 @@ void ClusterManagerInitHelper::addCluster(Cluster& cluster) {
   } else {
     ASSERT(cluster.initializePhase() == Cluster::InitializePhase::Secondary);
     secondary_init_clusters_.push_back(&cluster);
+    secondary_init_queue_.push_back(&cluster);
     if (started_secondary_initialize_) {
       // This can happen if we get a second CDS update that adds new clusters after we have
-      // already started secondary init. In this case, just immediately initialize.
-      cluster.initialize();
+      // already started secondary init. In this case, just initialize as soon as allowed.
+      initializeSecondaryClusters();
     }
   }
 
@@ -55,10 +100,24 @@ void ClusterManagerInitHelper::addCluster(Cluster& cluster) {
             primary_init_clusters_.size(), secondary_init_clusters_.size());
   cluster.setInitializedCb([&cluster, this]() -> void {
     ASSERT(state_ != State::AllClustersInitialized);
+    pending_critical_clusters_.erase(cluster.info()->name());
     removeCluster(cluster);
   });
 }
 
+void ClusterManagerInitHelper::initializeSecondaryClusters() {
+  // Cluster::initialize() can complete, or remove, the cluster being initialized before it returns,
+  // and so call back into here, so each cluster is taken off the queue before it is initialized.
+  while (!secondary_init_queue_.empty() &&
+         (max_concurrent_secondary_init_ == 0 ||
+          secondary_init_clusters_.size() - secondary_init_queue_.size() <
+              max_concurrent_secondary_init_)) {
+    Cluster* cluster = secondary_init_queue_.front();
+    secondary_init_queue_.pop_front();
+    cluster->initialize();
+  }
+}
+
 void ClusterManagerInitHelper::removeCluster(Cluster& cluster) {
   if (state_ == State::AllClustersInitialized) {
     return;
@@ -77,12 +136,22 @@ void ClusterManagerInitHelper::removeCluster(Cluster& cluster) {
   // It is possible that the cluster we are removing has already been initialized, and is not
   // present in the initializer list. If so, this is fine.
   cluster_list->remove(&cluster);
+  secondary_init_queue_.remove(&cluster);
   ENVOY_LOG(info, "cm init: init complete: cluster={} primary={} secondary={}",
             cluster.info()->name(), primary_init_clusters_.size(), secondary_init_clusters_.size());
   maybeFinishInitialize();
 }
 
 void ClusterManagerInitHelper::maybeFinishInitialize() {
+  // Once the critical clusters have initialized, which can be before CDS has, initialization is
+  // reported while the other clusters carry on.
+  if (state_ != State::Loading && waiting_for_critical_clusters_ &&
+      pending_critical_clusters_.empty()) {
+    ENVOY_LOG(info, "cm init: critical clusters initialized");
+    waiting_for_critical_clusters_ = false;
+    reportInitialized();
+  }
+
   // Do not do anything if we are still doing the initial static load or if we are waiting for
   // CDS initialize.
   if (state_ == State::Loading || state_ == State::WaitingForCdsInitialize) {
@@ -101,16 +170,10 @@ void ClusterManagerInitHelper::maybeFinishInitialize() {
     if (!started_secondary_initialize_) {
       ENVOY_LOG(info, "cm init: initializing secondary clusters");
       started_secondary_initialize_ = true;
-      // Cluster::initialize() method can modify the list of secondary_init_clusters_ to remove
-      // the item currently being initialized, so we eschew range-based-for and do this complicated
-      // dance to increment the iterator before calling initialize.
-      for (auto iter = secondary_init_clusters_.begin(); iter != secondary_init_clusters_.end();) {
-        Cluster* cluster = *iter;
-        ++iter;
-        cluster->initialize();
-      }
     }
 
+    // This also starts the next queued clusters as others finish, when their number is limited.
+    initializeSecondaryClusters();
     return;
   }
 
@@ -124,9 +187,18 @@ void ClusterManagerInitHelper::maybeFinishInitialize() {
   } else {
     ENVOY_LOG(info, "cm init: all clusters initialized");
     state_ = State::AllClustersInitialized;
-    if (initialized_callback_) {
-      initialized_callback_();
-    }
+    reportInitialized();
+  }
+}
+
+void ClusterManagerInitHelper::reportInitialized() {
+  if (reported_initialized_) {
+    return;
+  }
+
+  reported_initialized_ = true;
+  if (initialized_callback_) {
+    initialized_callback_();
   }
 }
 
@@ -149,7 +221,7 @@ void ClusterManagerInitHelper::setCds(CdsApi* cds) {
 }
 
 void ClusterManagerInitHelper::setInitializedCb(std::function<void()> callback) {
-  if (state_ == State::AllClustersInitialized) {
+  if (reported_initialized_) {
     callback();
   } else {
     initialized_callback_ = callback;
@@ -164,7 +236,8 @@ ClusterManagerImpl::ClusterManagerImpl(const envoy::api::v2::Bootstrap& bootstra
                                        AccessLog::AccessLogManager& log_manager,
                                        Event::Dispatcher& primary_dispatcher)
     : factory_(factory), runtime_(runtime), stats_(stats), tls_(tls.allocateSlot()),
-      random_(random), local_info_(local_info), cm_stats_(generateStats(stats)) {
+      random_(random), local_info_(local_info), primary_dispatcher_(primary_dispatcher),
+      cm_stats_(generateStats(stats)) {
   const auto& ads_config = bootstrap.dynamic_resources().ads_config();
   if (ads_config.cluster_name().empty()) {
     ENVOY_LOG(debug, "No ADS clusters defined, ADS will not be initialized.");
@@ -200,6 +273,16 @@ ClusterManagerImpl::ClusterManagerImpl(const envoy::api::v2::Bootstrap& bootstra
         bootstrap.cluster_manager().upstream_bind_config().source_address());
   }
 
+  if (!cm_config.local_cluster_name().empty()) {
+    local_cluster_name_.value(cm_config.local_cluster_name());
+  }
+
+  init_helper_.setMaxConcurrentSecondaryInit(
+      runtime_.snapshot().getInteger("upstream.init.max_concurrent_secondary", 0));
+  const std::vector<std::string> critical_clusters =
+      StringUtil::split(runtime_.snapshot().get("upstream.init.critical_clusters"), ',');
+  init_helper_.setCriticalClusters({critical_clusters.begin(), critical_clusters.end()});
+
   for (const auto& cluster : bootstrap.static_resources().clusters()) {
     loadCluster(cluster, false);
   }
@@ -212,13 +295,11 @@ ClusterManagerImpl::ClusterManagerImpl(const envoy::api::v2::Bootstrap& bootstra
     init_helper_.setCds(nullptr);
   }
 
-  Optional<std::string> local_cluster_name;
-  if (!cm_config.local_cluster_name().empty()) {
-    local_cluster_name.value(cm_config.local_cluster_name());
-    if (primary_clusters_.find(local_cluster_name.value()) == primary_clusters_.end()) {
-      throw EnvoyException(
-          fmt::format("local cluster '{}' must be defined", local_cluster_name.value()));
-    }
+  const Optional<std::string>& local_cluster_name = local_cluster_name_;
+  if (local_cluster_name.valid() &&
+      primary_clusters_.find(local_cluster_name.value()) == primary_clusters_.end()) {
+    throw EnvoyException(
+        fmt::format("local cluster '{}' must be defined", local_cluster_name.value()));
   }
 
   tls_->set([this, local_cluster_name](
@@ -275,14 +356,14 @@ bool ClusterManagerImpl::addOrUpdatePrimaryCluster(const envoy::api::v2::Cluster
     ThreadLocalClusterManagerImpl& cluster_manager =
         tls_->getTyped<ThreadLocalClusterManagerImpl>();
 
-    if (cluster_manager.thread_local_clusters_.count(new_cluster->name()) > 0) {
+    if (cluster_manager.thread_local_clusters_.count(new_cluster->name()) > 0 ||
+        cluster_manager.pending_clusters_.count(new_cluster->name()) > 0) {
       ENVOY_LOG(debug, "updating TLS cluster {}", new_cluster->name());
     } else {
       ENVOY_LOG(debug, "adding TLS cluster {}", new_cluster->name());
     }
 
-    cluster_manager.thread_local_clusters_[new_cluster->name()].reset(
-        new ThreadLocalClusterManagerImpl::ClusterEntry(cluster_manager, new_cluster));
+    cluster_manager.addCluster(new_cluster);
   });
 
   postInitializeCluster(*primary_clusters_.at(cluster_name).cluster_);
@@ -304,9 +385,13 @@ bool ClusterManagerImpl::removePrimaryCluster(const std::string& cluster_name) {
     ThreadLocalClusterManagerImpl& cluster_manager =
         tls_->getTyped<ThreadLocalClusterManagerImpl>();
 
-    ASSERT(cluster_manager.thread_local_clusters_.count(cluster_name) == 1);
+    ASSERT(cluster_manager.thread_local_clusters_.count(cluster_name) +
+               cluster_manager.pending_clusters_.count(cluster_name) ==
+           1);
     ENVOY_LOG(debug, "removing TLS cluster {}", cluster_name);
+    cluster_manager.forgetClusterId(cluster_name);
     cluster_manager.thread_local_clusters_.erase(cluster_name);
+    cluster_manager.pending_clusters_.erase(cluster_name);
   });
 
   return true;
@@ -330,7 +415,7 @@ void ClusterManagerImpl::loadCluster(const envoy::api::v2::Cluster& cluster, boo
                                          const std::vector<HostSharedPtr>& hosts_removed) {
         // This fires when a cluster is about to have an updated member set. We need to send this
         // out to all of the thread local configurations.
-        postThreadLocalClusterUpdate(primary_cluster_reference, hosts_added, hosts_removed);
+        scheduleThreadLocalClusterUpdate(primary_cluster_reference, hosts_added, hosts_removed);
       });
 
   // emplace() will do nothing if the key already exists. Always erase first.
@@ -349,13 +434,12 @@ void ClusterManagerImpl::loadCluster(const envoy::api::v2::Cluster& cluster, boo
 
 ThreadLocalCluster* ClusterManagerImpl::get(const std::string& cluster) {
   ThreadLocalClusterManagerImpl& cluster_manager = tls_->getTyped<ThreadLocalClusterManagerImpl>();
+  return cluster_manager.getOrCreateCluster(cluster);
+}
 
-  auto entry = cluster_manager.thread_local_clusters_.find(cluster);
-  if (entry != cluster_manager.thread_local_clusters_.end()) {
-    return entry->second.get();
-  } else {
-    return nullptr;
-  }
+ThreadLocalCluster* ClusterManagerImpl::getByHandle(const ClusterHandle& cluster) {
+  ThreadLocalClusterManagerImpl& cluster_manager = tls_->getTyped<ThreadLocalClusterManagerImpl>();
+  return cluster_manager.getOrCreateCluster(cluster);
 }
 
 Http::ConnectionPool::Instance*
@@ -363,32 +447,180 @@ ClusterManagerImpl::httpConnPoolForCluster(const std::string& cluster, ResourceP
                                            LoadBalancerContext* context) {
   ThreadLocalClusterManagerImpl& cluster_manager = tls_->getTyped<ThreadLocalClusterManagerImpl>();
 
-  auto entry = cluster_manager.thread_local_clusters_.find(cluster);
-  if (entry == cluster_manager.thread_local_clusters_.end()) {
+  ThreadLocalClusterManagerImpl::ClusterEntry* entry = cluster_manager.getOrCreateCluster(cluster);
+  if (entry == nullptr) {
     return nullptr;
   }
 
   // Select a host and create a connection pool for it if it does not already exist.
-  return entry->second->connPool(priority, context);
+  return entry->connPool(priority, context);
+}
+
+Http::ConnectionPool::Instance*
+ClusterManagerImpl::httpConnPoolForHandle(const ClusterHandle& cluster, ResourcePriority priority,
+                                          LoadBalancerContext* context) {
+  ThreadLocalClusterManagerImpl& cluster_manager = tls_->getTyped<ThreadLocalClusterManagerImpl>();
+
+  ThreadLocalClusterManagerImpl::ClusterEntry* entry = cluster_manager.getOrCreateCluster(cluster);
+  if (entry == nullptr) {
+    return nullptr;
+  }
+
+  return entry->connPool(priority, context);
+}
+
+uint32_t ClusterManagerImpl::clusterId(const std::string& name) {
+  ClusterIds& ids = clusterIds();
+  std::unique_lock<std::mutex> lock(ids.lock_);
+  // Ids are never reused, which is what makes a resolved handle valid for as long as it lives.
+  return ids.ids_.emplace(name, ids.ids_.size()).first->second;
+}
+
+uint32_t ClusterManagerImpl::findClusterId(const std::string& name) {
+  ClusterIds& ids = clusterIds();
+  std::unique_lock<std::mutex> lock(ids.lock_);
+  auto id = ids.ids_.find(name);
+  return id != ids.ids_.end() ? id->second : ClusterHandle::UNRESOLVED;
+}
+
+void ClusterManagerImpl::scheduleThreadLocalClusterUpdate(
+    const Cluster& primary_cluster, const std::vector<HostSharedPtr>& hosts_added,
+    const std::vector<HostSharedPtr>& hosts_removed) {
+  const uint64_t merge_window_ms =
+      runtime_.snapshot().getInteger("upstream.update_merge_window_ms", 0);
+  auto entry = primary_clusters_.find(primary_cluster.info()->name());
+  if (merge_window_ms == 0 || entry == primary_clusters_.end() ||
+      entry->second.cluster_.get() != &primary_cluster) {
+    postThreadLocalClusterUpdate(primary_cluster, hosts_added, hosts_removed);
+    return;
+  }
+
+  // Bursts of membership changes, e.g. during a rolling deploy of the upstream, are merged into a
+  // single update so that the workers do not rebuild their load balancers for every change. The
+  // window starts with the first change, which bounds how late any change reaches the workers.
+  PrimaryClusterData& data = entry->second;
+  if (data.update_pending_) {
+    cm_stats_.update_merged_.inc();
+  } else {
+    if (!data.update_merge_timer_) {
+      const std::string cluster_name = entry->first;
+      data.update_merge_timer_ = primary_dispatcher_.createTimer(
+          [this, cluster_name]() -> void { postMergedThreadLocalClusterUpdate(cluster_name); });
+    }
+    data.update_merge_timer_->enableTimer(std::chrono::milliseconds(merge_window_ms));
+    data.update_pending_ = true;
+  }
+
+  // A host that is added and removed again within the window is never seen by the workers.
+  mergeHostUpdates(hosts_removed, data.pending_hosts_removed_, data.pending_hosts_added_);
+  mergeHostUpdates(hosts_added, data.pending_hosts_added_, data.pending_hosts_removed_);
+}
+
+void ClusterManagerImpl::postMergedThreadLocalClusterUpdate(const std::string& cluster_name) {
+  auto entry = primary_clusters_.find(cluster_name);
+  ASSERT(entry != primary_clusters_.end());
+  PrimaryClusterData& data = entry->second;
+  ASSERT(data.update_pending_);
+
+  std::vector<HostSharedPtr> hosts_added;
+  std::vector<HostSharedPtr> hosts_removed;
+  hosts_added.swap(data.pending_hosts_added_);
+  hosts_removed.swap(data.pending_hosts_removed_);
+  data.update_pending_ = false;
+  postThreadLocalClusterUpdate(*data.cluster_, hosts_added, hosts_removed);
 }
 
 void ClusterManagerImpl::postThreadLocalClusterUpdate(
     const Cluster& primary_cluster, const std::vector<HostSharedPtr>& hosts_added,
     const std::vector<HostSharedPtr>& hosts_removed) {
   const std::string& name = primary_cluster.info()->name();
-  HostVectorConstSharedPtr hosts_copy(new std::vector<HostSharedPtr>(primary_cluster.hosts()));
-  HostVectorConstSharedPtr healthy_hosts_copy(
-      new std::vector<HostSharedPtr>(primary_cluster.healthyHosts()));
-  HostListsConstSharedPtr hosts_per_zone_copy(
-      new std::vector<std::vector<HostSharedPtr>>(primary_cluster.hostsPerZone()));
-  HostListsConstSharedPtr healthy_hosts_per_zone_copy(
-      new std::vector<std::vector<HostSharedPtr>>(primary_cluster.healthyHostsPerZone()));
-
-  tls_->runOnAllThreads([this, name, hosts_copy, healthy_hosts_copy, hosts_per_zone_copy,
-                         healthy_hosts_per_zone_copy, hosts_added, hosts_removed]() -> void {
+  // The host lists of the primary cluster are never modified once published, so the workers share
+  // them rather than each update copying every list for large clusters.
+  HostVectorConstSharedPtr hosts = primary_cluster.hostsPtr();
+  HostVectorConstSharedPtr healthy_hosts = primary_cluster.healthyHostsPtr();
+  HostListsConstSharedPtr hosts_per_zone = primary_cluster.hostsPerZonePtr();
+  HostListsConstSharedPtr healthy_hosts_per_zone = primary_cluster.healthyHostsPerZonePtr();
+
+  // Hashing rings are expensive to build, so build them once here and share them with all of the
+  // workers rather than having each worker build identical copies.
+  // The same applies to Maglev lookup tables.
+  RingHashLoadBalancer::RingsConstSharedPtr rings;
+  MaglevLoadBalancer::TablesConstSharedPtr maglev_tables;
+  if (primary_cluster.info()->lbType() == LoadBalancerType::RingHash) {
+    rings = RingHashLoadBalancer::createRings(runtime_, primary_cluster);
+  } else if (primary_cluster.info()->lbType() == LoadBalancerType::Maglev) {
+    maglev_tables = MaglevLoadBalancer::createTables(primary_cluster);
+  }
+
+  // Zone aware routing decisions depend on the upstream and the local cluster, so they are also
+  // computed once here. A change to the local cluster affects every zone aware cluster.
+  const Cluster* local_cluster = localCluster();
+  LoadBalancerBase::ZoneRoutingConstSharedPtr zone_routing;
+  if (local_cluster && &primary_cluster != local_cluster &&
+      isZoneAware(primary_cluster.info()->lbType())) {
+    zone_routing = LoadBalancerBase::createZoneRouting(primary_cluster, *local_cluster,
+                                                       primary_cluster.info()->stats(), runtime_);
+  }
+
+  // Priority and locality routing only depends on the upstream cluster.
+  LoadBalancerBase::PriorityRoutingConstSharedPtr priority_routing;
+  if (isZoneAware(primary_cluster.info()->lbType())) {
+    priority_routing = LoadBalancerBase::createPriorityRouting(primary_cluster, runtime_);
+  }
+
+  tls_->runOnAllThreads([this, name, hosts, healthy_hosts, hosts_per_zone, healthy_hosts_per_zone,
+                         hosts_added, hosts_removed, rings, maglev_tables, zone_routing,
+                         priority_routing]() -> void {
     ThreadLocalClusterManagerImpl::updateClusterMembership(
-        name, hosts_copy, healthy_hosts_copy, hosts_per_zone_copy, healthy_hosts_per_zone_copy,
-        hosts_added, hosts_removed, *tls_);
+        name, hosts, healthy_hosts, hosts_per_zone, healthy_hosts_per_zone, hosts_added,
+        hosts_removed, rings, maglev_tables, zone_routing, priority_routing, *tls_);
+  });
+
+  if (&primary_cluster == local_cluster) {
+    postThreadLocalZoneRoutingUpdate(*local_cluster);
+  }
+}
+
+const Cluster* ClusterManagerImpl::localCluster() const {
+  if (!local_cluster_name_.valid()) {
+    return nullptr;
+  }
+
+  auto local_cluster = primary_clusters_.find(local_cluster_name_.value());
+  return local_cluster != primary_clusters_.end() ? local_cluster->second.cluster_.get() : nullptr;
+}
+
+bool ClusterManagerImpl::isZoneAware(LoadBalancerType lb_type) {
+  switch (lb_type) {
+  case LoadBalancerType::LeastRequest:
+  case LoadBalancerType::Random:
+  case LoadBalancerType::RoundRobin:
+    return true;
+  default:
+    return false;
+  }
+}
+
+void ClusterManagerImpl::postThreadLocalZoneRoutingUpdate(const Cluster& local_cluster) {
+  std::shared_ptr<ZoneRoutingUpdates> updates(new ZoneRoutingUpdates());
+  for (const auto& cluster : primary_clusters_) {
+    const Cluster& primary_cluster = *cluster.second.cluster_;
+    if (&primary_cluster == &local_cluster || !isZoneAware(primary_cluster.info()->lbType())) {
+      continue;
+    }
+
+    updates->emplace_back(cluster.first,
+                          LoadBalancerBase::createZoneRouting(primary_cluster, local_cluster,
+                                                              primary_cluster.info()->stats(),
+                                                              runtime_));
+  }
+
+  if (updates->empty()) {
+    return;
+  }
+
+  tls_->runOnAllThreads([this, updates]() -> void {
+    ThreadLocalClusterManagerImpl::updateZoneRouting(*updates, *tls_);
   });
 }
 
@@ -396,25 +628,25 @@ Host::CreateConnectionData ClusterManagerImpl::tcpConnForCluster(const std::stri
                                                                  LoadBalancerContext* context) {
   ThreadLocalClusterManagerImpl& cluster_manager = tls_->getTyped<ThreadLocalClusterManagerImpl>();
 
-  auto entry = cluster_manager.thread_local_clusters_.find(cluster);
-  if (entry == cluster_manager.thread_local_clusters_.end()) {
+  ThreadLocalClusterManagerImpl::ClusterEntry* entry = cluster_manager.getOrCreateCluster(cluster);
+  if (entry == nullptr) {
     throw EnvoyException(fmt::format("unknown cluster '{}'", cluster));
   }
 
-  HostConstSharedPtr logical_host = entry->second->lb_->chooseHost(context);
+  HostConstSharedPtr logical_host = entry->lb_->chooseHost(context);
   if (logical_host) {
     return logical_host->createConnection(cluster_manager.thread_local_dispatcher_);
   } else {
-    entry->second->cluster_info_->stats().upstream_cx_none_healthy_.inc();
+    entry->cluster_info_->stats().upstream_cx_none_healthy_.inc();
     return {nullptr, nullptr};
   }
 }
 
 Http::AsyncClient& ClusterManagerImpl::httpAsyncClientForCluster(const std::string& cluster) {
   ThreadLocalClusterManagerImpl& cluster_manager = tls_->getTyped<ThreadLocalClusterManagerImpl>();
-  auto entry = cluster_manager.thread_local_clusters_.find(cluster);
-  if (entry != cluster_manager.thread_local_clusters_.end()) {
-    return entry->second->http_async_client_;
+  ThreadLocalClusterManagerImpl::ClusterEntry* entry = cluster_manager.getOrCreateCluster(cluster);
+  if (entry != nullptr) {
+    return entry->http_async_client_;
   } else {
     throw EnvoyException(fmt::format("unknown cluster '{}'", cluster));
   }
@@ -444,8 +676,7 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::ThreadLocalClusterManagerImpl
 
     ENVOY_LOG(debug, "adding TLS initial cluster {}", cluster.first);
     ASSERT(thread_local_clusters_.count(cluster.first) == 0);
-    thread_local_clusters_[cluster.first].reset(
-        new ClusterEntry(*this, cluster.second.cluster_->info()));
+    addCluster(cluster.second.cluster_->info());
   }
 }
 
@@ -458,6 +689,7 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::~ThreadLocalClusterManagerImp
   //                     redis/conn_pool_impl.cc. Will fix at the same time.
   ENVOY_LOG(debug, "shutting down thread local cluster manager");
   host_http_conn_pool_map_.clear();
+  clusters_by_id_.clear();
   for (auto& cluster : thread_local_clusters_) {
     if (&cluster.second->host_set_ != local_host_set_) {
       cluster.second.reset();
@@ -466,6 +698,85 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::~ThreadLocalClusterManagerImp
   thread_local_clusters_.clear();
 }
 
+void ClusterManagerImpl::ThreadLocalClusterManagerImpl::addCluster(
+    ClusterInfoConstSharedPtr cluster) {
+  const std::string& name = cluster->name();
+  pending_clusters_.erase(name);
+
+  // A cluster that is already in use on this thread is replaced right away. Original destination
+  // clusters are also never deferred, as their load balancer uses the primary cluster.
+  if (thread_local_clusters_.count(name) > 0 ||
+      cluster->lbType() == LoadBalancerType::OriginalDst) {
+    forgetClusterId(name);
+    thread_local_clusters_[name].reset(new ClusterEntry(*this, cluster));
+  } else {
+    pending_clusters_.emplace(name, PendingCluster(cluster));
+  }
+}
+
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry*
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::getOrCreateCluster(const std::string& name) {
+  auto entry = thread_local_clusters_.find(name);
+  if (entry != thread_local_clusters_.end()) {
+    return entry->second.get();
+  }
+
+  auto pending = pending_clusters_.find(name);
+  if (pending == pending_clusters_.end()) {
+    return nullptr;
+  }
+
+  ENVOY_LOG(debug, "creating TLS cluster {} on first use", name);
+  PendingCluster cluster = std::move(pending->second);
+  pending_clusters_.erase(pending);
+  ClusterEntry* new_entry = new ClusterEntry(*this, cluster.info_);
+  thread_local_clusters_[name].reset(new_entry);
+  if (cluster.hosts_) {
+    new_entry->updateHosts(cluster.hosts_, cluster.healthy_hosts_, cluster.hosts_per_zone_,
+                           cluster.healthy_hosts_per_zone_, *cluster.hosts_, {}, cluster.rings_,
+                           cluster.maglev_tables_, cluster.zone_routing_,
+                           cluster.priority_routing_);
+  }
+  return new_entry;
+}
+
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry*
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::getOrCreateCluster(
+    const ClusterHandle& handle) {
+  // Handles are shared by the workers, which may all resolve the same one at once. They can only
+  // ever store the same id, so a relaxed order is enough.
+  uint32_t id = handle.id().load(std::memory_order_relaxed);
+  if (id == ClusterHandle::UNRESOLVED) {
+    id = clusterId(handle.name());
+    handle.id().store(id, std::memory_order_relaxed);
+  }
+
+  if (id < clusters_by_id_.size() && clusters_by_id_[id] != nullptr) {
+    return clusters_by_id_[id];
+  }
+
+  ClusterEntry* entry = getOrCreateCluster(handle.name());
+  if (entry != nullptr) {
+    if (id >= clusters_by_id_.size()) {
+      clusters_by_id_.resize(id + 1, nullptr);
+    }
+    clusters_by_id_[id] = entry;
+  }
+  return entry;
+}
+
+void ClusterManagerImpl::ThreadLocalClusterManagerImpl::forgetClusterId(
+    const std::string& name) {
+  if (thread_local_clusters_.count(name) == 0) {
+    return;
+  }
+
+  const uint32_t id = findClusterId(name);
+  if (id < clusters_by_id_.size()) {
+    clusters_by_id_[id] = nullptr;
+  }
+}
+
 void ClusterManagerImpl::ThreadLocalClusterManagerImpl::drainConnPools(
     const std::vector<HostSharedPtr>& hosts) {
   for (const HostSharedPtr& host : hosts) {
@@ -514,13 +825,53 @@ void ClusterManagerImpl::ThreadLocalClusterManagerImpl::updateClusterMembership(
     const std::string& name, HostVectorConstSharedPtr hosts, HostVectorConstSharedPtr healthy_hosts,
     HostListsConstSharedPtr hosts_per_zone, HostListsConstSharedPtr healthy_hosts_per_zone,
     const std::vector<HostSharedPtr>& hosts_added, const std::vector<HostSharedPtr>& hosts_removed,
-    ThreadLocal::Slot& tls) {
+    RingHashLoadBalancer::RingsConstSharedPtr rings,
+    MaglevLoadBalancer::TablesConstSharedPtr maglev_tables,
+    LoadBalancerBase::ZoneRoutingConstSharedPtr zone_routing,
+    LoadBalancerBase::PriorityRoutingConstSharedPtr priority_routing, ThreadLocal::Slot& tls) {
+
+  ThreadLocalClusterManagerImpl& config = tls.getTyped<ThreadLocalClusterManagerImpl>();
+
+  auto entry = config.thread_local_clusters_.find(name);
+  if (entry != config.thread_local_clusters_.end()) {
+    entry->second->updateHosts(hosts, healthy_hosts, hosts_per_zone, healthy_hosts_per_zone,
+                               hosts_added, hosts_removed, rings, maglev_tables, zone_routing,
+                               priority_routing);
+    return;
+  }
+
+  // The cluster has not been used on this thread yet, only keep its latest state.
+  auto pending = config.pending_clusters_.find(name);
+  ASSERT(pending != config.pending_clusters_.end());
+  PendingCluster& cluster = pending->second;
+  cluster.hosts_ = hosts;
+  cluster.healthy_hosts_ = healthy_hosts;
+  cluster.hosts_per_zone_ = hosts_per_zone;
+  cluster.healthy_hosts_per_zone_ = healthy_hosts_per_zone;
+  cluster.rings_ = rings;
+  cluster.maglev_tables_ = maglev_tables;
+  cluster.zone_routing_ = zone_routing;
+  cluster.priority_routing_ = priority_routing;
+}
 
+void ClusterManagerImpl::ThreadLocalClusterManagerImpl::updateZoneRouting(
+    const ZoneRoutingUpdates& updates, ThreadLocal::Slot& tls) {
   ThreadLocalClusterManagerImpl& config = tls.getTyped<ThreadLocalClusterManagerImpl>();
 
-  ASSERT(config.thread_local_clusters_.find(name) != config.thread_local_clusters_.end());
-  config.thread_local_clusters_[name]->host_set_.updateHosts(
-      hosts, healthy_hosts, hosts_per_zone, healthy_hosts_per_zone, hosts_added, hosts_removed);
+  for (const auto& update : updates) {
+    auto entry = config.thread_local_clusters_.find(update.first);
+    if (entry != config.thread_local_clusters_.end()) {
+      if (entry->second->zone_aware_lb_) {
+        entry->second->zone_aware_lb_->setZoneRouting(update.second);
+      }
+      continue;
+    }
+
+    auto pending = config.pending_clusters_.find(update.first);
+    if (pending != config.pending_clusters_.end()) {
+      pending->second.zone_routing_ = update.second;
+    }
+  }
 }
 
 ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::ClusterEntry(
@@ -529,27 +880,48 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::ClusterEntry(
       http_async_client_(*cluster, parent.parent_.stats_, parent.thread_local_dispatcher_,
                          parent.parent_.local_info_, parent.parent_, parent.parent_.runtime_,
                          parent.parent_.random_,
-                         Router::ShadowWriterPtr{new Router::ShadowWriterImpl(parent.parent_)}) {
+                         Router::ShadowWriterPtr{new Router::ShadowWriterImpl(parent.parent_, 0)}) {
 
+  // Zone routing is computed by the main thread and delivered with each membership update. The
+  // local cluster is created before local_host_set_ is set, so it does not do zone routing itself.
+  const HostSet* local_host_set = parent.local_host_set_;
   switch (cluster->lbType()) {
   case LoadBalancerType::LeastRequest: {
-    lb_.reset(new LeastRequestLoadBalancer(host_set_, parent.local_host_set_, cluster->stats(),
-                                           parent.parent_.runtime_, parent.parent_.random_));
+    LeastRequestLoadBalancer* lb =
+        new LeastRequestLoadBalancer(host_set_, local_host_set, cluster->stats(),
+                                     parent.parent_.runtime_, parent.parent_.random_, nullptr);
+    zone_aware_lb_ = lb;
+    lb_.reset(lb);
     break;
   }
   case LoadBalancerType::Random: {
-    lb_.reset(new RandomLoadBalancer(host_set_, parent.local_host_set_, cluster->stats(),
-                                     parent.parent_.runtime_, parent.parent_.random_));
+    RandomLoadBalancer* lb =
+        new RandomLoadBalancer(host_set_, local_host_set, cluster->stats(),
+                               parent.parent_.runtime_, parent.parent_.random_, nullptr);
+    zone_aware_lb_ = lb;
+    lb_.reset(lb);
     break;
   }
   case LoadBalancerType::RoundRobin: {
-    lb_.reset(new RoundRobinLoadBalancer(host_set_, parent.local_host_set_, cluster->stats(),
-                                         parent.parent_.runtime_, parent.parent_.random_));
+    RoundRobinLoadBalancer* lb =
+        new RoundRobinLoadBalancer(host_set_, local_host_set, cluster->stats(),
+                                   parent.parent_.runtime_, parent.parent_.random_, nullptr);
+    zone_aware_lb_ = lb;
+    lb_.reset(lb);
     break;
   }
   case LoadBalancerType::RingHash: {
-    lb_.reset(new RingHashLoadBalancer(host_set_, cluster->stats(), parent.parent_.runtime_,
-                                       parent.parent_.random_));
+    // Rings are built by the main thread and delivered with each membership update.
+    ring_hash_lb_ = new RingHashLoadBalancer(host_set_, cluster->stats(), parent.parent_.runtime_,
+                                             parent.parent_.random_, nullptr);
+    lb_.reset(ring_hash_lb_);
+    break;
+  }
+  case LoadBalancerType::Maglev: {
+    // Tables are built by the main thread and delivered with each membership update.
+    maglev_lb_ = new MaglevLoadBalancer(host_set_, cluster->stats(), parent.parent_.runtime_,
+                                        parent.parent_.random_, nullptr);
+    lb_.reset(maglev_lb_);
     break;
   }
   case LoadBalancerType::OriginalDst: {
@@ -559,6 +931,13 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::ClusterEntry(
   }
   }
 
+  // Each worker builds the subsets of its own host set. The load balancer of the whole cluster
+  // stays in use for the requests that don't select a subset.
+  if (!cluster->lbSubsetKeys().empty() && cluster->lbType() != LoadBalancerType::OriginalDst) {
+    lb_.reset(new SubsetLoadBalancer(*cluster, host_set_, std::move(lb_), parent.parent_.runtime_,
+                                     parent.parent_.random_));
+  }
+
   host_set_.addMemberUpdateCb([this](const std::vector<HostSharedPtr>&,
                                      const std::vector<HostSharedPtr>& hosts_removed) -> void {
     // We need to go through and purge any connection pools for hosts that got deleted.
@@ -578,6 +957,28 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::~ClusterEntry()
   parent_.drainConnPools(host_set_.hosts());
 }
 
+void ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::updateHosts(
+    HostVectorConstSharedPtr hosts, HostVectorConstSharedPtr healthy_hosts,
+    HostListsConstSharedPtr hosts_per_zone, HostListsConstSharedPtr healthy_hosts_per_zone,
+    const std::vector<HostSharedPtr>& hosts_added, const std::vector<HostSharedPtr>& hosts_removed,
+    RingHashLoadBalancer::RingsConstSharedPtr rings,
+    MaglevLoadBalancer::TablesConstSharedPtr maglev_tables,
+    LoadBalancerBase::ZoneRoutingConstSharedPtr zone_routing,
+    LoadBalancerBase::PriorityRoutingConstSharedPtr priority_routing) {
+  if (ring_hash_lb_) {
+    ring_hash_lb_->setRings(rings);
+  }
+  if (maglev_lb_) {
+    maglev_lb_->setTables(maglev_tables);
+  }
+  if (zone_aware_lb_) {
+    zone_aware_lb_->setZoneRouting(zone_routing);
+    zone_aware_lb_->setPriorityRouting(priority_routing);
+  }
+  host_set_.updateHosts(hosts, healthy_hosts, hosts_per_zone, healthy_hosts_per_zone, hosts_added,
+                        hosts_removed);
+}
+
 Http::ConnectionPool::Instance*
 ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::connPool(
     ResourcePriority priority, LoadBalancerContext* context) {
@@ -623,7 +1024,7 @@ ClusterSharedPtr ProdClusterManagerFactory::clusterFromProto(
     Outlier::EventLoggerSharedPtr outlier_event_logger, bool added_via_api) {
   return ClusterImplBase::create(cluster, cm, stats_, tls_, dns_resolver_, ssl_context_manager_,
                                  runtime_, random_, primary_dispatcher_, local_info_,
-                                 outlier_event_logger, added_via_api);
+                                 outlier_event_logger, added_via_api, maintenance_dispatcher_);
 }
 
 CdsApiPtr
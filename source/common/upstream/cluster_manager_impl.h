@@ -7,8 +7,13 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "envoy/common/optional.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
 #include "envoy/http/codes.h"
 #include "envoy/local_info/local_info.h"
 #include "envoy/runtime/runtime.h"
@@ -18,6 +23,9 @@
 
 #include "common/config/grpc_mux_impl.h"
 #include "common/http/async_client_impl.h"
+#include "common/upstream/load_balancer_impl.h"
+#include "common/upstream/maglev_lb.h"
+#include "common/upstream/ring_hash_lb.h"
 #include "common/upstream/upstream_impl.h"
 
 #include "api/bootstrap.pb.h"
@@ -26,7 +34,8 @@ namespace Envoy {
 namespace Upstream {
 
 /**
- * Production implementation of ClusterManagerFactory.
+ * Production implementation of ClusterManagerFactory. The health checks of the clusters may run on
+ * maintenance_dispatcher, the dispatcher of a thread other than the main one, if it is supplied.
  */
 class ProdClusterManagerFactory : public ClusterManagerFactory {
 public:
@@ -35,10 +44,13 @@ public:
                             Network::DnsResolverSharedPtr dns_resolver,
                             Ssl::ContextManager& ssl_context_manager,
                             Event::Dispatcher& primary_dispatcher,
-                            const LocalInfo::LocalInfo& local_info)
+                            const LocalInfo::LocalInfo& local_info,
+                            const std::string& xds_cache_directory,
+                            Event::Dispatcher* maintenance_dispatcher = nullptr)
       : primary_dispatcher_(primary_dispatcher), runtime_(runtime), stats_(stats), tls_(tls),
         random_(random), dns_resolver_(dns_resolver), ssl_context_manager_(ssl_context_manager),
-        local_info_(local_info) {}
+        local_info_(local_info), xds_cache_directory_(xds_cache_directory),
+        maintenance_dispatcher_(maintenance_dispatcher) {}
 
   // Upstream::ClusterManagerFactory
   ClusterManagerPtr clusterManagerFromProto(const envoy::api::v2::Bootstrap& bootstrap,
@@ -56,6 +68,7 @@ public:
   CdsApiPtr createCds(const envoy::api::v2::ConfigSource& cds_config,
                       const Optional<envoy::api::v2::ConfigSource>& eds_config,
                       ClusterManager& cm) override;
+  const std::string& xdsCacheDirectory() override { return xds_cache_directory_; }
 
 protected:
   Event::Dispatcher& primary_dispatcher_;
@@ -68,6 +81,8 @@ private:
   Network::DnsResolverSharedPtr dns_resolver_;
   Ssl::ContextManager& ssl_context_manager_;
   const LocalInfo::LocalInfo& local_info_;
+  const std::string xds_cache_directory_;
+  Event::Dispatcher* maintenance_dispatcher_;
 };
 
 /**
@@ -82,6 +97,24 @@ public:
   void setCds(CdsApi* cds);
   void setInitializedCb(std::function<void()> callback);
 
+  /**
+   * Limit the number of secondary clusters that initialize at the same time, e.g. to bound the
+   * number of concurrent EDS fetches. Must be called before any cluster is added.
+   * @param limit supplies the limit, or 0 for no limit.
+   */
+  void setMaxConcurrentSecondaryInit(uint32_t limit) { max_concurrent_secondary_init_ = limit; }
+
+  /**
+   * Report initialization as complete as soon as the named clusters have initialized, rather than
+   * once all clusters have. The remaining clusters keep initializing afterwards. Must be called
+   * before any cluster is added.
+   * @param names supplies the names of the critical clusters, or an empty set to wait for all.
+   */
+  void setCriticalClusters(const std::unordered_set<std::string>& names) {
+    waiting_for_critical_clusters_ = !names.empty();
+    pending_critical_clusters_ = names;
+  }
+
 private:
   enum class State {
     Loading,
@@ -91,14 +124,23 @@ private:
     AllClustersInitialized
   };
 
+  void initializeSecondaryClusters();
   void maybeFinishInitialize();
+  void reportInitialized();
 
   CdsApi* cds_{};
   std::function<void()> initialized_callback_;
   std::list<Cluster*> primary_init_clusters_;
+  // All of the secondary clusters that have not finished initializing, and those of them that have
+  // yet to start.
   std::list<Cluster*> secondary_init_clusters_;
+  std::list<Cluster*> secondary_init_queue_;
+  uint32_t max_concurrent_secondary_init_{};
+  std::unordered_set<std::string> pending_critical_clusters_;
+  bool waiting_for_critical_clusters_{};
   State state_{State::Loading};
   bool started_secondary_initialize_{};
+  bool reported_initialized_{};
 };
 
 /**
@@ -109,6 +151,7 @@ private:
   COUNTER(cluster_added)                                                                           \
   COUNTER(cluster_modified)                                                                        \
   COUNTER(cluster_removed)                                                                         \
+  COUNTER(update_merged)                                                                           \
   GAUGE  (total_clusters)
 // clang-format on
 
@@ -145,9 +188,13 @@ public:
     return clusters_map;
   }
   ThreadLocalCluster* get(const std::string& cluster) override;
+  ThreadLocalCluster* getByHandle(const ClusterHandle& cluster) override;
   Http::ConnectionPool::Instance* httpConnPoolForCluster(const std::string& cluster,
                                                          ResourcePriority priority,
                                                          LoadBalancerContext* context) override;
+  Http::ConnectionPool::Instance* httpConnPoolForHandle(const ClusterHandle& cluster,
+                                                        ResourcePriority priority,
+                                                        LoadBalancerContext* context) override;
   Host::CreateConnectionData tcpConnForCluster(const std::string& cluster,
                                                LoadBalancerContext* context) override;
   Http::AsyncClient& httpAsyncClientForCluster(const std::string& cluster) override;
@@ -162,8 +209,13 @@ public:
   }
 
   Config::GrpcMux& adsMux() override { return *ads_mux_; }
+  const std::string& xdsCacheDirectory() override { return factory_.xdsCacheDirectory(); }
 
 private:
+  // Zone routing for each zone aware cluster by name, computed after a local cluster update.
+  typedef std::vector<std::pair<std::string, LoadBalancerBase::ZoneRoutingConstSharedPtr>>
+      ZoneRoutingUpdates;
+
   /**
    * Thread local cached cluster data. Each thread local cluster gets updates from the parent
    * central dynamic cluster (if applicable). It maintains load balancer state and any created
@@ -183,6 +235,15 @@ private:
 
       Http::ConnectionPool::Instance* connPool(ResourcePriority priority,
                                                LoadBalancerContext* context);
+      void updateHosts(HostVectorConstSharedPtr hosts, HostVectorConstSharedPtr healthy_hosts,
+                       HostListsConstSharedPtr hosts_per_zone,
+                       HostListsConstSharedPtr healthy_hosts_per_zone,
+                       const std::vector<HostSharedPtr>& hosts_added,
+                       const std::vector<HostSharedPtr>& hosts_removed,
+                       RingHashLoadBalancer::RingsConstSharedPtr rings,
+                       MaglevLoadBalancer::TablesConstSharedPtr maglev_tables,
+                       LoadBalancerBase::ZoneRoutingConstSharedPtr zone_routing,
+                       LoadBalancerBase::PriorityRoutingConstSharedPtr priority_routing);
 
       // Upstream::ThreadLocalCluster
       const HostSet& hostSet() override { return host_set_; }
@@ -192,15 +253,47 @@ private:
       ThreadLocalClusterManagerImpl& parent_;
       HostSetImpl host_set_;
       LoadBalancerPtr lb_;
+      // Set if lb_ is a ring hash load balancer, which uses rings built on the main thread.
+      RingHashLoadBalancer* ring_hash_lb_{};
+      // Set if lb_ is a Maglev load balancer, which uses tables built on the main thread.
+      MaglevLoadBalancer* maglev_lb_{};
+      // Set if lb_ is a zone aware load balancer, which uses zone and priority routing computed
+      // on the main thread.
+      LoadBalancerBase* zone_aware_lb_{};
       ClusterInfoConstSharedPtr cluster_info_;
       Http::AsyncClientImpl http_async_client_;
     };
 
     typedef std::unique_ptr<ClusterEntry> ClusterEntryPtr;
 
+    /**
+     * The latest state of a cluster that has not been used on this thread yet. Most threads only
+     * ever use some of the clusters, so the ClusterEntry, with its load balancer and async client,
+     * is only created from this state on first use. All of the state is shared with the main
+     * thread and the other threads.
+     */
+    struct PendingCluster {
+      PendingCluster(ClusterInfoConstSharedPtr info) : info_(info) {}
+
+      ClusterInfoConstSharedPtr info_;
+      HostVectorConstSharedPtr hosts_;
+      HostVectorConstSharedPtr healthy_hosts_;
+      HostListsConstSharedPtr hosts_per_zone_;
+      HostListsConstSharedPtr healthy_hosts_per_zone_;
+      RingHashLoadBalancer::RingsConstSharedPtr rings_;
+      MaglevLoadBalancer::TablesConstSharedPtr maglev_tables_;
+      LoadBalancerBase::ZoneRoutingConstSharedPtr zone_routing_;
+      LoadBalancerBase::PriorityRoutingConstSharedPtr priority_routing_;
+    };
+
     ThreadLocalClusterManagerImpl(ClusterManagerImpl& parent, Event::Dispatcher& dispatcher,
                                   const Optional<std::string>& local_cluster_name);
     ~ThreadLocalClusterManagerImpl();
+    void addCluster(ClusterInfoConstSharedPtr cluster);
+    ClusterEntry* getOrCreateCluster(const std::string& name);
+    ClusterEntry* getOrCreateCluster(const ClusterHandle& handle);
+    // Called before the entry of a cluster is removed or replaced, @see clusters_by_id_.
+    void forgetClusterId(const std::string& name);
     void drainConnPools(const std::vector<HostSharedPtr>& hosts);
     void drainConnPools(HostSharedPtr old_host, ConnPoolsContainer& container);
     static void updateClusterMembership(const std::string& name, HostVectorConstSharedPtr hosts,
@@ -209,11 +302,21 @@ private:
                                         HostListsConstSharedPtr healthy_hosts_per_zone,
                                         const std::vector<HostSharedPtr>& hosts_added,
                                         const std::vector<HostSharedPtr>& hosts_removed,
+                                        RingHashLoadBalancer::RingsConstSharedPtr rings,
+                                        MaglevLoadBalancer::TablesConstSharedPtr maglev_tables,
+                                        LoadBalancerBase::ZoneRoutingConstSharedPtr zone_routing,
+                                        LoadBalancerBase::PriorityRoutingConstSharedPtr
+                                            priority_routing,
                                         ThreadLocal::Slot& tls);
+    static void updateZoneRouting(const ZoneRoutingUpdates& updates, ThreadLocal::Slot& tls);
 
     ClusterManagerImpl& parent_;
     Event::Dispatcher& thread_local_dispatcher_;
     std::unordered_map<std::string, ClusterEntryPtr> thread_local_clusters_;
+    std::unordered_map<std::string, PendingCluster> pending_clusters_;
+    // The entries of thread_local_clusters_ by the id of their name, @see clusterId(). A slot is
+    // filled the first time that its cluster is found by handle, and cleared when the entry goes.
+    std::vector<ClusterEntry*> clusters_by_id_;
     std::unordered_map<HostConstSharedPtr, ConnPoolsContainer> host_http_conn_pool_map_;
     const HostSet* local_host_set_{};
   };
@@ -225,14 +328,38 @@ private:
     const uint64_t config_hash_;
     const bool added_via_api_;
     ClusterSharedPtr cluster_;
+    // Membership changes that are merged until the update is posted to the workers, see
+    // scheduleThreadLocalClusterUpdate().
+    Event::TimerPtr update_merge_timer_;
+    bool update_pending_{};
+    std::vector<HostSharedPtr> pending_hosts_added_;
+    std::vector<HostSharedPtr> pending_hosts_removed_;
   };
 
+  /**
+   * @return uint32_t the id of a cluster name, which is the same for all of the cluster managers
+   *         of the process and never used for another name. The ids are dense, so that each worker
+   *         can keep its clusters in a vector indexed by them, @see ClusterHandle.
+   */
+  static uint32_t clusterId(const std::string& name);
+  /**
+   * @return uint32_t the id of a cluster name, or ClusterHandle::UNRESOLVED if it has none yet.
+   */
+  static uint32_t findClusterId(const std::string& name);
+
   static ClusterManagerStats generateStats(Stats::Scope& scope);
   void loadCluster(const envoy::api::v2::Cluster& cluster, bool added_via_api);
   void postInitializeCluster(Cluster& cluster);
+  void scheduleThreadLocalClusterUpdate(const Cluster& primary_cluster,
+                                        const std::vector<HostSharedPtr>& hosts_added,
+                                        const std::vector<HostSharedPtr>& hosts_removed);
+  void postMergedThreadLocalClusterUpdate(const std::string& cluster_name);
   void postThreadLocalClusterUpdate(const Cluster& primary_cluster,
                                     const std::vector<HostSharedPtr>& hosts_added,
                                     const std::vector<HostSharedPtr>& hosts_removed);
+  void postThreadLocalZoneRoutingUpdate(const Cluster& local_cluster);
+  const Cluster* localCluster() const;
+  static bool isZoneAware(LoadBalancerType lb_type);
 
   ClusterManagerFactory& factory_;
   Runtime::Loader& runtime_;
@@ -240,10 +367,12 @@ private:
   ThreadLocal::SlotPtr tls_;
   Runtime::RandomGenerator& random_;
   std::unordered_map<std::string, PrimaryClusterData> primary_clusters_;
+  Optional<std::string> local_cluster_name_;
   Optional<envoy::api::v2::ConfigSource> eds_config_;
   Network::Address::InstanceConstSharedPtr source_address_;
   Outlier::EventLoggerSharedPtr outlier_event_logger_;
   const LocalInfo::LocalInfo& local_info_;
+  Event::Dispatcher& primary_dispatcher_;
   CdsApiPtr cds_api_;
   ClusterManagerStats cm_stats_;
   ClusterManagerInitHelper init_helper_;
@@ -8,6 +8,7 @@
 #include "common/config/well_known_names.h"
 #include "common/network/address_impl.h"
 #include "common/network/utility.h"
+#include "common/protobuf/utility.h"
 #include "common/upstream/sds_subscription.h"
 
 #include "fmt/format.h"
@@ -57,6 +58,16 @@ void EdsClusterImpl::onConfigUpdate(const ResourceVector& resources) {
     throw EnvoyException(fmt::format("Unexpected EDS cluster (expecting {}): {}", cluster_name_,
                                      cluster_load_assignment.cluster_name()));
   }
+
+  const uint64_t config_hash = MessageUtil::hash(cluster_load_assignment);
+  if (config_hash_.valid() && config_hash_.value() == config_hash) {
+    ENVOY_LOG(debug, "EDS hosts unchanged for cluster: {}", info_->name());
+    info_->stats().update_no_rebuild_.inc();
+    runInitializeCallbackIfAny();
+    return;
+  }
+  config_hash_.value(config_hash);
+
   for (const auto& locality_lb_endpoint : cluster_load_assignment.endpoints()) {
     const std::string& zone = locality_lb_endpoint.locality().zone();
 
@@ -64,6 +75,17 @@ void EdsClusterImpl::onConfigUpdate(const ResourceVector& resources) {
       new_hosts.emplace_back(new HostImpl(
           info_, "", Network::Utility::fromProtoAddress(lb_endpoint.endpoint().address()),
           lb_endpoint.metadata(), lb_endpoint.load_balancing_weight().value(), zone));
+      // The management server may aggregate health checking across the fleet and publish the
+      // result, so that not every Envoy has to check every host.
+      switch (lb_endpoint.health_status()) {
+      case envoy::api::v2::HealthStatus::UNHEALTHY:
+      case envoy::api::v2::HealthStatus::DRAINING:
+      case envoy::api::v2::HealthStatus::TIMEOUT:
+        new_hosts.back()->healthFlagSet(Host::HealthFlag::FAILED_EDS_HEALTH);
+        break;
+      default:
+        break;
+      }
     }
   }
 
@@ -85,11 +107,12 @@ void EdsClusterImpl::onConfigUpdate(const ResourceVector& resources) {
 
       // Populate per_zone hosts only if upstream cluster has hosts in the same zone.
       if (hosts_per_zone.find(local_info_.zoneName()) != hosts_per_zone.end()) {
-        per_zone->push_back(hosts_per_zone[local_info_.zoneName()]);
+        per_zone->reserve(hosts_per_zone.size());
+        per_zone->push_back(std::move(hosts_per_zone[local_info_.zoneName()]));
 
         for (auto& entry : hosts_per_zone) {
           if (local_info_.zoneName() != entry.first) {
-            per_zone->push_back(entry.second);
+            per_zone->push_back(std::move(entry.second));
           }
         }
       }
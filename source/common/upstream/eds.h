@@ -1,5 +1,6 @@
 #pragma once
 
+#include "envoy/common/optional.h"
 #include "envoy/config/subscription.h"
 #include "envoy/local_info/local_info.h"
 
@@ -40,6 +41,9 @@ private:
   const LocalInfo::LocalInfo& local_info_;
   const std::string cluster_name_;
   uint64_t pending_health_checks_{};
+  // The hash of the last ClusterLoadAssignment applied. A state of the world update resends the
+  // assignments of all the clusters, so most updates do not change this cluster's.
+  Optional<uint64_t> config_hash_;
 };
 
 } // namespace Upstream
@@ -1,5 +1,6 @@
 #include "common/upstream/health_checker_impl.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <string>
@@ -14,6 +15,7 @@
 #include "common/buffer/buffer_impl.h"
 #include "common/common/empty_string.h"
 #include "common/common/enum_to_int.h"
+#include "common/common/hash.h"
 #include "common/common/hex.h"
 #include "common/common/utility.h"
 #include "common/http/codec_client.h"
@@ -31,20 +33,70 @@ HealthCheckerSharedPtr HealthCheckerFactory::create(const envoy::api::v2::Health
                                                     Upstream::Cluster& cluster,
                                                     Runtime::Loader& runtime,
                                                     Runtime::RandomGenerator& random,
-                                                    Event::Dispatcher& dispatcher) {
+                                                    Event::Dispatcher& dispatcher,
+                                                    const LocalInfo::LocalInfo& local_info,
+                                                    Event::Dispatcher* health_check_dispatcher) {
+  Event::Dispatcher& check_dispatcher =
+      health_check_dispatcher != nullptr ? *health_check_dispatcher : dispatcher;
+  std::shared_ptr<HealthCheckerImplBase> health_checker;
   switch (hc_config.health_checker_case()) {
   case envoy::api::v2::HealthCheck::HealthCheckerCase::kHttpHealthCheck:
-    return std::make_shared<ProdHttpHealthCheckerImpl>(cluster, hc_config, dispatcher, runtime,
-                                                       random);
+    health_checker = std::make_shared<ProdHttpHealthCheckerImpl>(cluster, hc_config,
+                                                                 check_dispatcher, runtime, random);
+    break;
   case envoy::api::v2::HealthCheck::HealthCheckerCase::kTcpHealthCheck:
-    return std::make_shared<TcpHealthCheckerImpl>(cluster, hc_config, dispatcher, runtime, random);
+    health_checker = std::make_shared<TcpHealthCheckerImpl>(cluster, hc_config, check_dispatcher,
+                                                            runtime, random);
+    break;
   case envoy::api::v2::HealthCheck::HealthCheckerCase::kRedisHealthCheck:
-    return std::make_shared<RedisHealthCheckerImpl>(cluster, hc_config, dispatcher, runtime, random,
-                                                    Redis::ConnPool::ClientFactoryImpl::instance_);
+    health_checker = std::make_shared<RedisHealthCheckerImpl>(
+        cluster, hc_config, check_dispatcher, runtime, random,
+        Redis::ConnPool::ClientFactoryImpl::instance_);
+    break;
   default:
     // TODO(htuch): This should be subsumed eventually by the constraint checking in #1308.
     throw EnvoyException("Health checker type not set");
   }
+
+  health_checker->subsetSeed(HashUtil::xxHash64(local_info.nodeName()));
+  if (health_check_dispatcher != nullptr) {
+    return DispatchedHealthChecker::create(health_checker, *health_check_dispatcher, dispatcher);
+  }
+  return health_checker;
+}
+
+HealthCheckerSharedPtr
+DispatchedHealthChecker::create(const std::shared_ptr<HealthCheckerImplBase>& health_checker,
+                                Event::Dispatcher& health_check_dispatcher,
+                                Event::Dispatcher& main_dispatcher) {
+  std::shared_ptr<DispatchedHealthChecker> dispatched_health_checker(
+      new DispatchedHealthChecker(health_checker, health_check_dispatcher));
+  health_checker->runOnOwnDispatcher();
+
+  // Only the main thread holds the dispatched health checker, so it is still there when the
+  // results get to the main thread for as long as the cluster that owns it is.
+  std::weak_ptr<DispatchedHealthChecker> weak_dispatched = dispatched_health_checker;
+  health_checker->addHostCheckCompleteCb(
+      [weak_dispatched, &main_dispatcher](HostSharedPtr host, bool changed_state) -> void {
+        main_dispatcher.post([weak_dispatched, host, changed_state]() -> void {
+          std::shared_ptr<DispatchedHealthChecker> shared_dispatched = weak_dispatched.lock();
+          if (shared_dispatched == nullptr) {
+            return;
+          }
+
+          for (const HostStatusCb& cb : shared_dispatched->callbacks_) {
+            cb(host, changed_state);
+          }
+        });
+      });
+  return dispatched_health_checker;
+}
+
+DispatchedHealthChecker::~DispatchedHealthChecker() {
+  // The sessions own timers and connections of the health check dispatcher, so the health checker
+  // is released on its thread. This is queued after everything that the main thread posted to it.
+  std::shared_ptr<HealthCheckerImplBase> health_checker = std::move(health_checker_);
+  health_check_dispatcher_.post([health_checker]() mutable -> void { health_checker.reset(); });
 }
 
 const std::chrono::milliseconds HealthCheckerImplBase::NO_TRAFFIC_INTERVAL{60000};
@@ -54,7 +106,7 @@ HealthCheckerImplBase::HealthCheckerImplBase(const Cluster& cluster,
                                              Event::Dispatcher& dispatcher,
                                              Runtime::Loader& runtime,
                                              Runtime::RandomGenerator& random)
-    : cluster_(cluster), dispatcher_(dispatcher),
+    : cluster_(cluster), cluster_info_(cluster.info()), dispatcher_(dispatcher),
       timeout_(PROTOBUF_GET_MS_REQUIRED(config, timeout)),
       unhealthy_threshold_(PROTOBUF_GET_WRAPPED_REQUIRED(config, unhealthy_threshold)),
       healthy_threshold_(PROTOBUF_GET_WRAPPED_REQUIRED(config, healthy_threshold)),
@@ -63,7 +115,14 @@ HealthCheckerImplBase::HealthCheckerImplBase(const Cluster& cluster,
       interval_jitter_(PROTOBUF_GET_MS_OR_DEFAULT(config, interval_jitter, 0)) {
   cluster_.addMemberUpdateCb([this](const std::vector<HostSharedPtr>& hosts_added,
                                     const std::vector<HostSharedPtr>& hosts_removed) -> void {
-    onClusterMemberUpdate(hosts_added, hosts_removed);
+    if (!run_on_own_dispatcher_) {
+      onClusterMemberUpdate(hosts_added, hosts_removed);
+      return;
+    }
+
+    post([hosts_added, hosts_removed](HealthCheckerImplBase& health_checker) -> void {
+      health_checker.onClusterMemberUpdate(hosts_added, hosts_removed);
+    });
   });
 }
 
@@ -84,22 +143,42 @@ void HealthCheckerImplBase::incHealthy() {
   refreshHealthyStat();
 }
 
-std::chrono::milliseconds HealthCheckerImplBase::interval() const {
+std::chrono::milliseconds HealthCheckerImplBase::interval(uint64_t subset_position,
+                                                          bool healthy,
+                                                          bool first_interval) const {
   // See if the cluster has ever made a connection. If so, we use the defined HC interval. If not,
   // we use a much slower interval to keep the host info relatively up to date in case we suddenly
   // start sending traffic to this cluster. In general host updates are rare and this should
   // greatly smooth out needless health checking.
   uint64_t base_time_ms;
-  if (cluster_.info()->stats().upstream_cx_total_.used()) {
+  if (cluster_info_->stats().upstream_cx_total_.used()) {
     base_time_ms = interval_.count();
   } else {
     base_time_ms = NO_TRAFFIC_INTERVAL.count();
   }
 
+  // Every process health checks its own subset of the hosts at the full rate, and the healthy hosts
+  // outside of it proportionally less often. Across many processes every host is still checked
+  // about as often as by one process with the full rate, and health_check.max_interval bounds how
+  // long this process takes to notice a failure. Unhealthy hosts are always checked at the full
+  // rate so that they come back quickly.
+  const uint64_t subset_percent =
+      std::min<uint64_t>(100, runtime_.snapshot().getInteger("health_check.subset_percent", 100));
+  if (healthy && subset_position >= subset_percent) {
+    base_time_ms = base_time_ms * 100 / std::max<uint64_t>(1, subset_percent);
+  }
+
   if (interval_jitter_.count() > 0) {
     base_time_ms += (random_.random() % interval_jitter_.count());
   }
 
+  // All the hosts get their first check right away, and the jitter alone takes many intervals to
+  // spread them out again, if it is configured at all. So the interval after the first check is
+  // extended by a random part of itself, to spread the checks evenly over the interval.
+  if (first_interval && base_time_ms > 0) {
+    base_time_ms += (random_.random() % base_time_ms);
+  }
+
   uint64_t min_interval = runtime_.snapshot().getInteger("health_check.min_interval", 0);
   uint64_t max_interval = runtime_.snapshot().getInteger("health_check.max_interval",
                                                          std::numeric_limits<uint64_t>::max());
@@ -128,6 +207,17 @@ void HealthCheckerImplBase::onClusterMemberUpdate(const std::vector<HostSharedPt
   }
 }
 
+void HealthCheckerImplBase::post(std::function<void(HealthCheckerImplBase&)> callback) {
+  // The health checker might be gone by the time the callback gets to its dispatcher.
+  std::weak_ptr<HealthCheckerImplBase> weak_this = shared_from_this();
+  dispatcher_.post([weak_this, callback]() -> void {
+    std::shared_ptr<HealthCheckerImplBase> shared_this = weak_this.lock();
+    if (shared_this != nullptr) {
+      callback(*shared_this);
+    }
+  });
+}
+
 void HealthCheckerImplBase::refreshHealthyStat() {
   // Each hot restarted process health checks independently. To make the stats easier to read,
   // we assume that both processes will converge and the last one that writes wins for the host.
@@ -178,13 +268,25 @@ void HealthCheckerImplBase::setUnhealthyCrossThread(const HostSharedPtr& host) {
   });
 }
 
-void HealthCheckerImplBase::start() { addHosts(cluster_.hosts()); }
+void HealthCheckerImplBase::start() {
+  if (!run_on_own_dispatcher_) {
+    addHosts(cluster_.hosts());
+    return;
+  }
+
+  // The hosts of the cluster are only read on the main thread.
+  const std::vector<HostSharedPtr> hosts = cluster_.hosts();
+  post([hosts](HealthCheckerImplBase& health_checker) -> void { health_checker.addHosts(hosts); });
+}
 
 HealthCheckerImplBase::ActiveHealthCheckSession::ActiveHealthCheckSession(
     HealthCheckerImplBase& parent, HostSharedPtr host)
     : host_(host), parent_(parent),
-      interval_timer_(parent.dispatcher_.createTimer([this]() -> void { onIntervalBase(); })),
-      timeout_timer_(parent.dispatcher_.createTimer([this]() -> void { onTimeoutBase(); })) {
+      subset_position_(HashUtil::xxHash64(host->address()->asString(), parent.subset_seed_) % 100),
+      interval_timer_(parent.dispatcher_.createTimer([this]() -> void { onIntervalBase(); },
+                                                     Event::TimerPrecision::Coarse)),
+      timeout_timer_(parent.dispatcher_.createTimer([this]() -> void { onTimeoutBase(); },
+                                                    Event::TimerPrecision::Coarse)) {
 
   if (!host->healthFlagGet(Host::HealthFlag::FAILED_ACTIVE_HC)) {
     parent.incHealthy();
@@ -218,7 +320,7 @@ void HealthCheckerImplBase::ActiveHealthCheckSession::handleSuccess() {
   parent_.runCallbacks(host_, changed_state);
 
   timeout_timer_->disableTimer();
-  interval_timer_->enableTimer(parent_.interval());
+  interval_timer_->enableTimer(interval());
 }
 
 void HealthCheckerImplBase::ActiveHealthCheckSession::setUnhealthy(FailureType type) {
@@ -248,7 +350,15 @@ void HealthCheckerImplBase::ActiveHealthCheckSession::setUnhealthy(FailureType t
 void HealthCheckerImplBase::ActiveHealthCheckSession::handleFailure(FailureType type) {
   setUnhealthy(type);
   timeout_timer_->disableTimer();
-  interval_timer_->enableTimer(parent_.interval());
+  interval_timer_->enableTimer(interval());
+}
+
+std::chrono::milliseconds HealthCheckerImplBase::ActiveHealthCheckSession::interval() {
+  const bool first_interval = first_interval_;
+  first_interval_ = false;
+  return parent_.interval(subset_position_,
+                          !host_->healthFlagGet(Host::HealthFlag::FAILED_ACTIVE_HC),
+                          first_interval);
 }
 
 void HealthCheckerImplBase::ActiveHealthCheckSession::onIntervalBase() {
@@ -318,15 +428,17 @@ void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onInterval() {
 
   Http::HeaderMapImpl request_headers{
       {Http::Headers::get().Method, "GET"},
-      {Http::Headers::get().Host, parent_.cluster_.info()->name()},
+      {Http::Headers::get().Host, parent_.cluster_info_->name()},
       {Http::Headers::get().Path, parent_.path_},
       {Http::Headers::get().UserAgent, Http::Headers::get().UserAgentValues.EnvoyHealthChecker}};
 
+  // The encoder is kept until the response completes so that a timed out HTTP/2 stream can be
+  // reset on its own.
   request_encoder_->encodeHeaders(request_headers, true);
-  request_encoder_ = nullptr;
 }
 
 void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onResetStream(Http::StreamResetReason) {
+  request_encoder_ = nullptr;
   if (expect_reset_) {
     return;
   }
@@ -360,6 +472,7 @@ bool HttpHealthCheckerImpl::HttpActiveHealthCheckSession::isHealthCheckSucceeded
 }
 
 void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onResponseComplete() {
+  request_encoder_ = nullptr;
   if (isHealthCheckSucceeded()) {
     handleSuccess();
   } else {
@@ -382,12 +495,26 @@ void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onTimeout() {
 
   // If there is an active request it will get reset, so make sure we ignore the reset.
   expect_reset_ = true;
-  client_->close();
+  if (client_->type() == Http::CodecClient::Type::HTTP2 && request_encoder_ != nullptr) {
+    // Only the stream timed out. The connection carries the next checks unless it dies too.
+    request_encoder_->getStream().resetStream(Http::StreamResetReason::LocalReset);
+    expect_reset_ = false;
+  } else {
+    client_->close();
+  }
+}
+
+Http::CodecClient::Type HttpHealthCheckerImpl::codecClientType() const {
+  if ((cluster_info_->features() & ClusterInfo::Features::HTTP2) &&
+      runtime_.snapshot().featureEnabled("health_check.use_http2", 0)) {
+    return Http::CodecClient::Type::HTTP2;
+  }
+  return Http::CodecClient::Type::HTTP1;
 }
 
 Http::CodecClient*
 ProdHttpHealthCheckerImpl::createCodecClient(Upstream::Host::CreateConnectionData& data) {
-  return new Http::CodecClientProd(Http::CodecClient::Type::HTTP1, std::move(data.connection_),
+  return new Http::CodecClientProd(codecClientType(), std::move(data.connection_),
                                    data.host_description_);
 }
 
@@ -404,14 +531,25 @@ TcpHealthCheckMatcher::MatchSegments TcpHealthCheckMatcher::loadProtoBytes(
 }
 
 bool TcpHealthCheckMatcher::match(const MatchSegments& expected, const Buffer::Instance& buffer) {
-  uint64_t start_index = 0;
-  for (const std::vector<uint8_t>& segment : expected) {
-    ssize_t search_result = buffer.search(&segment[0], segment.size(), start_index);
+  MatchProgress progress;
+  return match(expected, buffer, progress);
+}
+
+bool TcpHealthCheckMatcher::match(const MatchSegments& expected, const Buffer::Instance& buffer,
+                                  MatchProgress& progress) {
+  for (; progress.segments_ < expected.size(); progress.segments_++) {
+    const std::vector<uint8_t>& segment = expected[progress.segments_];
+    const ssize_t search_result = buffer.search(segment.data(), segment.size(), progress.start_);
     if (search_result == -1) {
+      // Only a match that starts in the last bytes of the buffer can still be completed by more
+      // data, so the next search starts there.
+      if (buffer.length() >= segment.size()) {
+        progress.start_ = std::max(progress.start_, buffer.length() - segment.size() + 1);
+      }
       return false;
     }
 
-    start_index = search_result + segment.size();
+    progress.start_ = search_result + segment.size();
   }
 
   return true;
@@ -438,8 +576,9 @@ TcpHealthCheckerImpl::TcpActiveHealthCheckSession::~TcpActiveHealthCheckSession(
 
 void TcpHealthCheckerImpl::TcpActiveHealthCheckSession::onData(Buffer::Instance& data) {
   ENVOY_CONN_LOG(trace, "total pending buffer={}", *client_, data.length());
-  if (TcpHealthCheckMatcher::match(parent_.receive_bytes_, data)) {
+  if (TcpHealthCheckMatcher::match(parent_.receive_bytes_, data, match_progress_)) {
     data.drain(data.length());
+    match_progress_.reset();
     handleSuccess();
   }
 }
@@ -477,6 +616,7 @@ void TcpHealthCheckerImpl::TcpActiveHealthCheckSession::onEvent(Network::Connect
 void TcpHealthCheckerImpl::TcpActiveHealthCheckSession::onInterval() {
   if (!client_) {
     client_ = host_->createConnection(parent_.dispatcher_).connection_;
+    match_progress_.reset();
     session_callbacks_.reset(new TcpSessionCallbacks(*this));
     client_->addConnectionCallbacks(*session_callbacks_);
     client_->addReadFilter(session_callbacks_);
@@ -2,6 +2,7 @@
 
 #include <chrono>
 #include <cstdint>
+#include <functional>
 #include <list>
 #include <memory>
 #include <string>
@@ -10,6 +11,7 @@
 
 #include "envoy/event/timer.h"
 #include "envoy/http/codec.h"
+#include "envoy/local_info/local_info.h"
 #include "envoy/network/connection.h"
 #include "envoy/network/filter.h"
 #include "envoy/redis/conn_pool.h"
@@ -38,12 +40,18 @@ public:
    * @param runtime supplies the runtime loader.
    * @param random supplies the random generator.
    * @param dispatcher supplies the dispatcher.
+   * @param local_info supplies the local info, whose node name selects the subset of hosts that
+   *        is health checked at the full rate.
+   * @param health_check_dispatcher supplies the dispatcher of a thread other than the main one to
+   *        run the health checks on, or nullptr to run them on dispatcher.
    * @return a health checker.
    */
   static HealthCheckerSharedPtr create(const envoy::api::v2::HealthCheck& hc_config,
                                        Upstream::Cluster& cluster, Runtime::Loader& runtime,
                                        Runtime::RandomGenerator& random,
-                                       Event::Dispatcher& dispatcher);
+                                       Event::Dispatcher& dispatcher,
+                                       const LocalInfo::LocalInfo& local_info,
+                                       Event::Dispatcher* health_check_dispatcher = nullptr);
 };
 
 /**
@@ -78,6 +86,21 @@ public:
   void addHostCheckCompleteCb(HostStatusCb callback) override { callbacks_.push_back(callback); }
   void start() override;
 
+  /**
+   * Set the seed that selects the subset of hosts that this process health checks at the full
+   * rate when the health_check.subset_percent runtime setting is below 100. Processes with
+   * different seeds select different subsets. Must be called before start().
+   * @param seed supplies the seed, usually a hash of the node name.
+   */
+  void subsetSeed(uint64_t seed) { subset_seed_ = seed; }
+
+  /**
+   * Run the health checker on a dispatcher that belongs to a thread other than the main one.
+   * start() and the cluster member updates, which come from the main thread, are then posted to
+   * the dispatcher, and the callbacks run on its thread. Must be called before start().
+   */
+  void runOnOwnDispatcher() { run_on_own_dispatcher_ = true; }
+
 protected:
   class ActiveHealthCheckSession {
   public:
@@ -101,12 +124,18 @@ protected:
     virtual void onTimeout() PURE;
     void onTimeoutBase();
 
+    std::chrono::milliseconds interval();
+
     HealthCheckerImplBase& parent_;
+    // Position of the host in [0, 100), the hosts below health_check.subset_percent are checked at
+    // the full rate.
+    const uint64_t subset_position_;
     Event::TimerPtr interval_timer_;
     Event::TimerPtr timeout_timer_;
     uint32_t num_unhealthy_{};
     uint32_t num_healthy_{};
     bool first_check_{true};
+    bool first_interval_{true};
   };
 
   typedef std::unique_ptr<ActiveHealthCheckSession> ActiveHealthCheckSessionPtr;
@@ -118,6 +147,9 @@ protected:
   virtual ActiveHealthCheckSessionPtr makeSession(HostSharedPtr host) PURE;
 
   const Cluster& cluster_;
+  // The checks may still run for a short while after the cluster is gone when they run on a
+  // thread of their own, so they only use the cluster info.
+  const ClusterInfoConstSharedPtr cluster_info_;
   Event::Dispatcher& dispatcher_;
   const std::chrono::milliseconds timeout_;
   const uint32_t unhealthy_threshold_;
@@ -143,9 +175,11 @@ private:
   void decHealthy();
   HealthCheckerStats generateStats(Stats::Scope& scope);
   void incHealthy();
-  std::chrono::milliseconds interval() const;
+  std::chrono::milliseconds interval(uint64_t subset_position, bool healthy,
+                                     bool first_interval) const;
   void onClusterMemberUpdate(const std::vector<HostSharedPtr>& hosts_added,
                              const std::vector<HostSharedPtr>& hosts_removed);
+  void post(std::function<void(HealthCheckerImplBase&)> callback);
   void refreshHealthyStat();
   void runCallbacks(HostSharedPtr host, bool changed_state);
   void setUnhealthyCrossThread(const HostSharedPtr& host);
@@ -157,6 +191,41 @@ private:
   const std::chrono::milliseconds interval_jitter_;
   std::unordered_map<HostSharedPtr, ActiveHealthCheckSessionPtr> active_sessions_;
   uint64_t local_process_healthy_{};
+  uint64_t subset_seed_{};
+  bool run_on_own_dispatcher_{};
+};
+
+/**
+ * Health checker that is owned by the main thread and runs another health checker on the
+ * dispatcher of a thread of its own, so that the checks are not delayed by the work of the main
+ * thread. The results of the checks are posted back to the main thread, where the callbacks run.
+ */
+class DispatchedHealthChecker : public HealthChecker {
+public:
+  ~DispatchedHealthChecker();
+
+  /**
+   * @param health_checker supplies the health checker to run, which must not have been started.
+   * @param health_check_dispatcher supplies the dispatcher to run health_checker on.
+   * @param main_dispatcher supplies the dispatcher of the main thread.
+   * @return a health checker that runs health_checker on health_check_dispatcher.
+   */
+  static HealthCheckerSharedPtr create(const std::shared_ptr<HealthCheckerImplBase>& health_checker,
+                                       Event::Dispatcher& health_check_dispatcher,
+                                       Event::Dispatcher& main_dispatcher);
+
+  // Upstream::HealthChecker
+  void addHostCheckCompleteCb(HostStatusCb callback) override { callbacks_.push_back(callback); }
+  void start() override { health_checker_->start(); }
+
+private:
+  DispatchedHealthChecker(const std::shared_ptr<HealthCheckerImplBase>& health_checker,
+                          Event::Dispatcher& health_check_dispatcher)
+      : health_checker_(health_checker), health_check_dispatcher_(health_check_dispatcher) {}
+
+  std::shared_ptr<HealthCheckerImplBase> health_checker_;
+  Event::Dispatcher& health_check_dispatcher_;
+  std::list<HostStatusCb> callbacks_;
 };
 
 /**
@@ -222,6 +291,16 @@ private:
 
   virtual Http::CodecClient* createCodecClient(Upstream::Host::CreateConnectionData& data) PURE;
 
+protected:
+  /**
+   * @return the codec type of a new health checking connection. Clusters with the http2 feature
+   *         are checked over HTTP/2 when the health_check.use_http2 runtime setting is enabled,
+   *         which multiplexes the checks of a host on one connection that is kept across failed
+   *         checks.
+   */
+  Http::CodecClient::Type codecClientType() const;
+
+private:
   // HealthCheckerImplBase
   ActiveHealthCheckSessionPtr makeSession(HostSharedPtr host) override {
     return ActiveHealthCheckSessionPtr{new HttpActiveHealthCheckSession(*this, host)};
@@ -287,11 +366,26 @@ public:
  */
 class TcpHealthCheckMatcher {
 public:
-  typedef std::list<std::vector<uint8_t>> MatchSegments;
+  typedef std::vector<std::vector<uint8_t>> MatchSegments;
+
+  /**
+   * How far a match got in a buffer: the number of segments found and the index that the search
+   * for the next one starts at. A match that carries on from its progress only searches the data
+   * that was added to the buffer since, so a response that arrives in many reads is not searched
+   * from its start for each of them. The progress must be reset when the buffer is drained.
+   */
+  struct MatchProgress {
+    void reset() { *this = MatchProgress(); }
+
+    size_t segments_{};
+    uint64_t start_{};
+  };
 
   static MatchSegments loadProtoBytes(
       const Protobuf::RepeatedPtrField<envoy::api::v2::HealthCheck::Payload>& byte_array);
   static bool match(const MatchSegments& expected, const Buffer::Instance& buffer);
+  static bool match(const MatchSegments& expected, const Buffer::Instance& buffer,
+                    MatchProgress& progress);
 };
 
 /**
@@ -339,6 +433,8 @@ private:
     TcpHealthCheckerImpl& parent_;
     Network::ClientConnectionPtr client_;
     std::shared_ptr<TcpSessionCallbacks> session_callbacks_;
+    // The progress of receive_bytes_ through the read buffer of client_.
+    TcpHealthCheckMatcher::MatchProgress match_progress_;
   };
 
   typedef std::unique_ptr<TcpActiveHealthCheckSession> TcpActiveHealthCheckSessionPtr;
@@ -384,6 +480,17 @@ private:
       // Allow the main HC infra to control timeout.
       return parent_.timeout_ * 2;
     }
+    // Health checks are written as they are made, on their own connection.
+    uint32_t maxBufferSizeBeforeFlush() const override { return 0; }
+    uint32_t maxConnectionsPerHost() const override { return 1; }
+    uint32_t maxRequestsPerConnection() const override { return 0; }
+    bool clusterMode() const override { return false; }
+    std::chrono::milliseconds clusterRefreshInterval() const override {
+      return std::chrono::milliseconds(0);
+    }
+    Redis::ConnPool::ReadPolicy readPolicy() const override {
+      return Redis::ConnPool::ReadPolicy::Master;
+    }
 
     // Redis::ConnPool::PoolCallbacks
     void onResponse(Redis::RespValuePtr&& value) override;
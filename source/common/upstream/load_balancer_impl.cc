@@ -1,6 +1,8 @@
 #include "common/upstream/load_balancer_impl.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -16,61 +18,231 @@ namespace Upstream {
 static const std::string RuntimeZoneEnabled = "upstream.zone_routing.enabled";
 static const std::string RuntimeMinClusterSize = "upstream.zone_routing.min_cluster_size";
 static const std::string RuntimePanicThreshold = "upstream.healthy_panic_threshold";
+static const std::string RuntimeOverprovisioningFactor =
+    "upstream.priority_overprovisioning_factor";
+
+size_t LoadBalancerBase::ZoneRouting::residualCapacityZone(uint64_t threshold) const {
+  ASSERT(!residual_capacity_.empty());
+  ASSERT(threshold < residual_capacity_.back());
+
+  // residual_capacity_ is non-decreasing, so the first zone whose accumulated capacity reaches the
+  // threshold can be found with a binary search.
+  return std::lower_bound(residual_capacity_.begin(), residual_capacity_.end(), threshold) -
+         residual_capacity_.begin();
+}
+
+const LoadBalancerBase::PriorityRouting::Level&
+LoadBalancerBase::PriorityRouting::level(uint64_t sample) const {
+  ASSERT(!load_.empty());
+  ASSERT(sample < load_.back());
+
+  // The first level whose accumulated load exceeds the sample. Levels without load are skipped, as
+  // their accumulated load equals that of the level before them.
+  return levels_[std::upper_bound(load_.begin(), load_.end(), sample) - load_.begin()];
+}
+
+const LoadBalancerBase::PriorityRouting::Locality&
+LoadBalancerBase::PriorityRouting::locality(const Level& level, uint64_t sample) {
+  ASSERT(!level.locality_weights_.empty());
+  ASSERT(sample < level.locality_weights_.back());
+
+  return level.localities_[std::upper_bound(level.locality_weights_.begin(),
+                                            level.locality_weights_.end(), sample) -
+                           level.locality_weights_.begin()];
+}
 
 LoadBalancerBase::LoadBalancerBase(const HostSet& host_set, const HostSet* local_host_set,
                                    ClusterStats& stats, Runtime::Loader& runtime,
                                    Runtime::RandomGenerator& random)
-    : stats_(stats), runtime_(runtime), random_(random), host_set_(host_set),
-      local_host_set_(local_host_set) {
+    : LoadBalancerBase(host_set, local_host_set, stats, runtime, random, nullptr) {
+  setPriorityRouting(createPriorityRouting(host_set_, runtime_));
+  host_set_member_update_cb_handle_ = host_set_.addMemberUpdateCb(
+      [this](const std::vector<HostSharedPtr>&, const std::vector<HostSharedPtr>&) -> void {
+        setPriorityRouting(createPriorityRouting(host_set_, runtime_));
+        if (local_host_set_) {
+          setZoneRouting(createZoneRouting(host_set_, *local_host_set_, stats_, runtime_));
+        }
+      });
   if (local_host_set_) {
-    host_set_.addMemberUpdateCb(
-        [this](const std::vector<HostSharedPtr>&, const std::vector<HostSharedPtr>&) -> void {
-          regenerateZoneRoutingStructures();
-        });
     local_host_set_member_update_cb_handle_ = local_host_set_->addMemberUpdateCb(
         [this](const std::vector<HostSharedPtr>&, const std::vector<HostSharedPtr>&) -> void {
-          regenerateZoneRoutingStructures();
+          setZoneRouting(createZoneRouting(host_set_, *local_host_set_, stats_, runtime_));
         });
   }
 }
 
+LoadBalancerBase::LoadBalancerBase(const HostSet& host_set, const HostSet* local_host_set,
+                                   ClusterStats& stats, Runtime::Loader& runtime,
+                                   Runtime::RandomGenerator& random,
+                                   ZoneRoutingConstSharedPtr zone_routing)
+    : stats_(stats), runtime_(runtime), random_(random), host_set_(host_set),
+      local_host_set_(local_host_set) {
+  setZoneRouting(zone_routing);
+}
+
 LoadBalancerBase::~LoadBalancerBase() {
+  if (host_set_member_update_cb_handle_ != nullptr) {
+    host_set_member_update_cb_handle_->remove();
+  }
   if (local_host_set_member_update_cb_handle_ != nullptr) {
     local_host_set_member_update_cb_handle_->remove();
   }
 }
 
-void LoadBalancerBase::regenerateZoneRoutingStructures() {
-  stats_.lb_recalculate_zone_structures_.inc();
+void LoadBalancerBase::setZoneRouting(ZoneRoutingConstSharedPtr zone_routing) {
+  static const ZoneRoutingConstSharedPtr no_zone_routing(new ZoneRouting());
+  zone_routing_ = zone_routing ? zone_routing : no_zone_routing;
+}
+
+void LoadBalancerBase::setPriorityRouting(PriorityRoutingConstSharedPtr priority_routing) {
+  priority_routing_ = priority_routing;
+}
+
+LoadBalancerBase::PriorityRoutingConstSharedPtr
+LoadBalancerBase::createPriorityRouting(const HostSet& host_set, Runtime::Loader& runtime) {
+  if (std::none_of(host_set.hosts().begin(), host_set.hosts().end(),
+                   [](const HostSharedPtr& host) -> bool {
+                     return host->priority() != 0 || host->localityWeight() != 0;
+                   })) {
+    return nullptr;
+  }
+
+  // Group the hosts by priority and, within a level, by zone. The weight of a locality is the
+  // largest locality weight that one of its hosts sets.
+  struct LevelHosts {
+    PriorityRouting::Level level_;
+    std::map<std::string, size_t> locality_index_;
+    std::vector<uint64_t> locality_weights_;
+  };
+  std::map<uint32_t, LevelHosts> levels;
+  const auto add_host = [&levels](const HostSharedPtr& host, bool healthy) -> void {
+    LevelHosts& level_hosts = levels[host->priority()];
+    PriorityRouting::Level& level = level_hosts.level_;
+    auto index = level_hosts.locality_index_.emplace(host->zone(), level.localities_.size());
+    if (index.second) {
+      level.localities_.emplace_back();
+      level_hosts.locality_weights_.push_back(0);
+    }
+
+    PriorityRouting::Locality& locality = level.localities_[index.first->second];
+    if (healthy) {
+      level.healthy_hosts_.push_back(host);
+      locality.healthy_hosts_.push_back(host);
+    } else {
+      level.hosts_.push_back(host);
+      locality.hosts_.push_back(host);
+      uint64_t& weight = level_hosts.locality_weights_[index.first->second];
+      weight = std::max<uint64_t>(weight, host->localityWeight());
+    }
+  };
+  for (const HostSharedPtr& host : host_set.hosts()) {
+    add_host(host, false);
+  }
+  for (const HostSharedPtr& host : host_set.healthyHosts()) {
+    add_host(host, true);
+  }
+
+  // A group of hosts is considered fully healthy while the share of healthy hosts, scaled by the
+  // overprovisioning factor, is at least 100%. With the default factor of 140%, a level only
+  // starts to shed load to the next level once less than ~71% of its hosts are healthy.
+  const uint64_t factor = runtime.snapshot().getInteger(RuntimeOverprovisioningFactor, 140);
+  const auto health = [factor](size_t healthy_hosts, size_t hosts) -> uint64_t {
+    return hosts == 0 ? 0 : std::min<uint64_t>(100, factor * healthy_hosts / hosts);
+  };
+
+  std::shared_ptr<PriorityRouting> priority_routing(new PriorityRouting());
+  std::vector<uint64_t> level_health;
+  uint64_t total_health = 0;
+  for (auto& entry : levels) {
+    LevelHosts& level_hosts = entry.second;
+    PriorityRouting::Level& level = level_hosts.level_;
+    level.priority_ = entry.first;
+    level_health.push_back(health(level.healthy_hosts_.size(), level.hosts_.size()));
+    total_health += level_health.back();
+
+    // Localities are weighted by their weight scaled by their health, so that the load of a
+    // locality that loses hosts shifts to the other localities of the level.
+    if (std::any_of(level_hosts.locality_weights_.begin(), level_hosts.locality_weights_.end(),
+                    [](uint64_t weight) -> bool { return weight != 0; })) {
+      uint64_t accumulated = 0;
+      for (size_t i = 0; i < level.localities_.size(); i++) {
+        const PriorityRouting::Locality& locality = level.localities_[i];
+        accumulated += level_hosts.locality_weights_[i] *
+                       health(locality.healthy_hosts_.size(), locality.hosts_.size());
+        level.locality_weights_.push_back(accumulated);
+      }
+    }
+
+    priority_routing->levels_.push_back(std::move(level));
+  }
+
+  // Each level takes as much of the load as its health allows, and the rest spills over to the
+  // next level. If the levels together are not healthy enough to take all of the load, it is split
+  // in proportion to their health, with the rounding remainder going to the first level that has
+  // any health. Without any health at all, level 0 takes all of the load.
+  std::vector<uint64_t> level_load(level_health.size());
+  uint64_t assigned = 0;
+  for (size_t i = 0; i < level_health.size(); i++) {
+    if (total_health >= 100) {
+      level_load[i] = std::min(100 - assigned, level_health[i]);
+    } else if (total_health > 0) {
+      level_load[i] = level_health[i] * 100 / total_health;
+    }
+    assigned += level_load[i];
+  }
+  if (assigned < 100) {
+    auto first_healthy =
+        std::find_if(level_health.begin(), level_health.end(),
+                     [](uint64_t value) -> bool { return value > 0; });
+    level_load[first_healthy == level_health.end() ? 0 : first_healthy - level_health.begin()] +=
+        100 - assigned;
+  }
+
+  assigned = 0;
+  for (uint64_t load : level_load) {
+    assigned += load;
+    priority_routing->load_.push_back(assigned);
+  }
+  priority_routing->health_ = std::min<uint64_t>(100, total_health);
+
+  return priority_routing;
+}
+
+LoadBalancerBase::ZoneRoutingConstSharedPtr
+LoadBalancerBase::createZoneRouting(const HostSet& host_set, const HostSet& local_host_set,
+                                    ClusterStats& stats, Runtime::Loader& runtime) {
+  stats.lb_recalculate_zone_structures_.inc();
+
+  std::shared_ptr<ZoneRouting> zone_routing(new ZoneRouting());
 
   // Do not perform any calculations if we cannot perform zone routing based on non runtime params.
-  if (earlyExitNonZoneRouting()) {
-    zone_routing_state_ = ZoneRoutingState::NoZoneRouting;
-    return;
+  if (earlyExitNonZoneRouting(host_set, local_host_set, stats, runtime)) {
+    return zone_routing;
   }
 
-  size_t num_zones = host_set_.healthyHostsPerZone().size();
+  size_t num_zones = host_set.healthyHostsPerZone().size();
   ASSERT(num_zones > 0);
+  zone_routing->num_zones_ = num_zones;
 
   uint64_t local_percentage[num_zones];
-  calculateZonePercentage(local_host_set_->healthyHostsPerZone(), local_percentage);
+  calculateZonePercentage(local_host_set.healthyHostsPerZone(), local_percentage);
 
   uint64_t upstream_percentage[num_zones];
-  calculateZonePercentage(host_set_.healthyHostsPerZone(), upstream_percentage);
+  calculateZonePercentage(host_set.healthyHostsPerZone(), upstream_percentage);
 
   // If we have lower percent of hosts in the local cluster in the same zone,
   // we can push all of the requests directly to upstream cluster in the same zone.
   if (upstream_percentage[0] >= local_percentage[0]) {
-    zone_routing_state_ = ZoneRoutingState::ZoneDirect;
-    return;
+    zone_routing->state_ = ZoneRouting::State::ZoneDirect;
+    return zone_routing;
   }
 
-  zone_routing_state_ = ZoneRoutingState::ZoneResidual;
+  zone_routing->state_ = ZoneRouting::State::ZoneResidual;
 
   // If we cannot route all requests to the same zone, calculate what percentage can be routed.
   // For example, if local percentage is 20% and upstream is 10%
   // we can route only 50% of requests directly.
-  local_percent_to_route_ = upstream_percentage[0] * 10000 / local_percentage[0];
+  zone_routing->local_percent_to_route_ = upstream_percentage[0] * 10000 / local_percentage[0];
 
   // Local zone does not have additional capacity (we have already routed what we could).
   // Now we need to figure out how much traffic we can route cross zone and to which exact zone
@@ -86,44 +258,49 @@ void LoadBalancerBase::regenerateZoneRoutingStructures() {
   // bucket sizes (residual capacity). For simplicity of finding where specific
   // sampled value is, we accumulate values in residual capacity. This is what it will look like:
   // residual_capacity: 0 10000 15000
-  // Now to find a zone to route (bucket) we could simply iterate over residual_capacity searching
-  // where sampled value is placed.
-  residual_capacity_.resize(num_zones);
+  // Now to find a zone to route (bucket) we can binary search residual_capacity for the sampled
+  // value.
+  std::vector<uint64_t>& residual_capacity = zone_routing->residual_capacity_;
+  residual_capacity.resize(num_zones);
 
   // Local zone (index 0) does not have residual capacity as we have routed all we could.
-  residual_capacity_[0] = 0;
+  residual_capacity[0] = 0;
   for (size_t i = 1; i < num_zones; ++i) {
     // Only route to the zones that have additional capacity.
     if (upstream_percentage[i] > local_percentage[i]) {
-      residual_capacity_[i] =
-          residual_capacity_[i - 1] + upstream_percentage[i] - local_percentage[i];
+      residual_capacity[i] =
+          residual_capacity[i - 1] + upstream_percentage[i] - local_percentage[i];
     } else {
       // Zone with index "i" does not have residual capacity, but we keep accumulating previous
       // values to make search easier on the next step.
-      residual_capacity_[i] = residual_capacity_[i - 1];
+      residual_capacity[i] = residual_capacity[i - 1];
     }
   }
-};
 
-bool LoadBalancerBase::earlyExitNonZoneRouting() {
-  if (host_set_.healthyHostsPerZone().size() < 2) {
+  return zone_routing;
+}
+
+bool LoadBalancerBase::earlyExitNonZoneRouting(const HostSet& host_set,
+                                               const HostSet& local_host_set, ClusterStats& stats,
+                                               Runtime::Loader& runtime) {
+  if (host_set.healthyHostsPerZone().size() < 2) {
     return true;
   }
 
-  if (host_set_.healthyHostsPerZone()[0].empty()) {
+  if (host_set.healthyHostsPerZone()[0].empty()) {
     return true;
   }
 
   // Same number of zones should be for local and upstream cluster.
-  if (host_set_.healthyHostsPerZone().size() != local_host_set_->healthyHostsPerZone().size()) {
-    stats_.lb_zone_number_differs_.inc();
+  if (host_set.healthyHostsPerZone().size() != local_host_set.healthyHostsPerZone().size()) {
+    stats.lb_zone_number_differs_.inc();
     return true;
   }
 
   // Do not perform zone routing for small clusters.
-  uint64_t min_cluster_size = runtime_.snapshot().getInteger(RuntimeMinClusterSize, 6U);
-  if (host_set_.healthyHosts().size() < min_cluster_size) {
-    stats_.lb_zone_cluster_too_small_.inc();
+  uint64_t min_cluster_size = runtime.snapshot().getInteger(RuntimeMinClusterSize, 6U);
+  if (host_set.healthyHosts().size() < min_cluster_size) {
+    stats.lb_zone_cluster_too_small_.inc();
     return true;
   }
 
@@ -159,25 +336,26 @@ void LoadBalancerBase::calculateZonePercentage(
 }
 
 const std::vector<HostSharedPtr>& LoadBalancerBase::tryChooseLocalZoneHosts() {
-  ASSERT(zone_routing_state_ != ZoneRoutingState::NoZoneRouting);
+  const ZoneRouting& zone_routing = *zone_routing_;
+  ASSERT(zone_routing.state_ != ZoneRouting::State::NoZoneRouting);
 
   // At this point it's guaranteed to be at least 2 zones.
   size_t number_of_zones = host_set_.healthyHostsPerZone().size();
 
   ASSERT(number_of_zones >= 2U);
-  ASSERT(local_host_set_->healthyHostsPerZone().size() == host_set_.healthyHostsPerZone().size());
+  ASSERT(number_of_zones == zone_routing.num_zones_);
 
   // Try to push all of the requests to the same zone first.
-  if (zone_routing_state_ == ZoneRoutingState::ZoneDirect) {
+  if (zone_routing.state_ == ZoneRouting::State::ZoneDirect) {
     stats_.lb_zone_routing_all_directly_.inc();
     return host_set_.healthyHostsPerZone()[0];
   }
 
-  ASSERT(zone_routing_state_ == ZoneRoutingState::ZoneResidual);
+  ASSERT(zone_routing.state_ == ZoneRouting::State::ZoneResidual);
 
   // If we cannot route all requests to the same zone, we already calculated how much we can
   // push to the local zone, check if we can push to local zone on current iteration.
-  if (random_.random() % 10000 < local_percent_to_route_) {
+  if (random_.random() % 10000 < zone_routing.local_percent_to_route_) {
     stats_.lb_zone_routing_sampled_.inc();
     return host_set_.healthyHostsPerZone()[0];
   }
@@ -187,34 +365,57 @@ const std::vector<HostSharedPtr>& LoadBalancerBase::tryChooseLocalZoneHosts() {
 
   // This is *extremely* unlikely but possible due to rounding errors when calculating
   // zone percentages. In this case just select random zone.
-  if (residual_capacity_[number_of_zones - 1] == 0) {
+  if (zone_routing.residual_capacity_[number_of_zones - 1] == 0) {
     stats_.lb_zone_no_capacity_left_.inc();
     return host_set_.healthyHostsPerZone()[random_.random() % number_of_zones];
   }
 
   // Random sampling to select specific zone for cross zone traffic based on the additional
   // capacity in zones.
-  uint64_t threshold = random_.random() % residual_capacity_[number_of_zones - 1];
+  uint64_t threshold = random_.random() % zone_routing.residual_capacity_[number_of_zones - 1];
+  return host_set_.healthyHostsPerZone()[zone_routing.residualCapacityZone(threshold)];
+}
 
-  // This potentially can be optimized to be O(log(N)) where N is the number of zones.
-  // Linear scan should be faster for smaller N, in most of the scenarios N will be small.
-  int i = 0;
-  while (threshold > residual_capacity_[i]) {
-    i++;
+const std::vector<HostSharedPtr>& LoadBalancerBase::priorityHostsToUse() {
+  const PriorityRouting& priority_routing = *priority_routing_;
+  const PriorityRouting::Level& level = priority_routing.level(random_.random() % 100);
+
+  // The panic threshold applies to the health of all of the levels together, as a level that is
+  // not healthy on its own sheds its load to the others.
+  const uint64_t panic_threshold =
+      std::min<uint64_t>(100, runtime_.snapshot().getInteger(RuntimePanicThreshold, 50));
+  if (priority_routing.health_ < panic_threshold) {
+    stats_.lb_healthy_panic_.inc();
+    return level.hosts_;
   }
 
-  return host_set_.healthyHostsPerZone()[i];
+  if (level.locality_weights_.empty() || level.locality_weights_.back() == 0) {
+    return level.healthy_hosts_;
+  }
+
+  return PriorityRouting::locality(level, random_.random() % level.locality_weights_.back())
+      .healthy_hosts_;
 }
 
 const std::vector<HostSharedPtr>& LoadBalancerBase::hostsToUse() {
   ASSERT(host_set_.healthyHosts().size() <= host_set_.hosts().size());
 
+  if (priority_routing_) {
+    return priorityHostsToUse();
+  }
+
   if (LoadBalancerUtility::isGlobalPanic(host_set_, runtime_)) {
     stats_.lb_healthy_panic_.inc();
     return host_set_.hosts();
   }
 
-  if (zone_routing_state_ == ZoneRoutingState::NoZoneRouting) {
+  if (zone_routing_->state_ == ZoneRouting::State::NoZoneRouting) {
+    return host_set_.healthyHosts();
+  }
+
+  // Shared zone routing is computed from the primary host sets. Fall back to regular routing if
+  // it was computed for a different zone layout than this host set currently has.
+  if (zone_routing_->num_zones_ != host_set_.healthyHostsPerZone().size()) {
     return host_set_.healthyHosts();
   }
 
@@ -230,69 +431,85 @@ const std::vector<HostSharedPtr>& LoadBalancerBase::hostsToUse() {
   return tryChooseLocalZoneHosts();
 }
 
+HostConstSharedPtr LoadBalancerBase::nextUnsaturatedHost(const std::vector<HostSharedPtr>& hosts,
+                                                         size_t index, const HostLimits& limits) {
+  for (size_t i = 0; i < hosts.size(); i++) {
+    const HostSharedPtr& host = hosts[(index + i) % hosts.size()];
+    if (!limits.saturated(*host)) {
+      return host;
+    }
+    stats_.lb_host_saturated_.inc();
+  }
+
+  stats_.upstream_rq_host_overflow_.inc();
+  return nullptr;
+}
+
 HostConstSharedPtr RoundRobinLoadBalancer::chooseHost(const LoadBalancerContext*) {
   const std::vector<HostSharedPtr>& hosts_to_use = hostsToUse();
   if (hosts_to_use.empty()) {
     return nullptr;
   }
 
-  return hosts_to_use[rr_index_++ % hosts_to_use.size()];
+  const size_t index = rr_index_++ % hosts_to_use.size();
+  const HostLimits limits = hostLimits(hosts_to_use);
+  if (!limits.enabled()) {
+    return hosts_to_use[index];
+  }
+  return nextUnsaturatedHost(hosts_to_use, index, limits);
 }
 
-LeastRequestLoadBalancer::LeastRequestLoadBalancer(const HostSet& host_set,
-                                                   const HostSet* local_host_set,
-                                                   ClusterStats& stats, Runtime::Loader& runtime,
-                                                   Runtime::RandomGenerator& random)
-    : LoadBalancerBase(host_set, local_host_set, stats, runtime, random) {
-  host_set.addMemberUpdateCb([this](const std::vector<HostSharedPtr>&,
-                                    const std::vector<HostSharedPtr>& hosts_removed) -> void {
-    if (last_host_) {
-      for (const HostSharedPtr& host : hosts_removed) {
-        if (host == last_host_) {
-          hits_left_ = 0;
-          last_host_.reset();
-
-          break;
-        }
-      }
-    }
-  });
-}
+const uint64_t LeastRequestLoadBalancer::MAX_CHOICE_COUNT;
 
 HostConstSharedPtr LeastRequestLoadBalancer::chooseHost(const LoadBalancerContext*) {
-  bool is_weight_imbalanced = stats_.max_host_weight_.value() != 1;
-  bool is_weight_enabled = runtime_.snapshot().getInteger("upstream.weight_enabled", 1UL) != 0;
-
-  if (is_weight_imbalanced && hits_left_ > 0 && is_weight_enabled) {
-    --hits_left_;
-
-    return last_host_;
-  } else {
-    // To avoid hit stale last_host_ when all hosts become weight balanced.
-    hits_left_ = 0;
-    last_host_.reset();
-  }
-
   const std::vector<HostSharedPtr>& hosts_to_use = hostsToUse();
   if (hosts_to_use.empty()) {
     return nullptr;
   }
 
-  // Make weighed random if we have hosts with non 1 weights.
-  if (is_weight_imbalanced & is_weight_enabled) {
-    last_host_ = hosts_to_use[random_.random() % hosts_to_use.size()];
-    hits_left_ = last_host_->weight() - 1;
-
-    return last_host_;
-  } else {
-    HostSharedPtr host1 = hosts_to_use[random_.random() % hosts_to_use.size()];
-    HostSharedPtr host2 = hosts_to_use[random_.random() % hosts_to_use.size()];
-    if (host1->stats().rq_active_.value() < host2->stats().rq_active_.value()) {
-      return host1;
-    } else {
-      return host2;
+  const bool use_weights = stats_.max_host_weight_.value() != 1 &&
+                           runtime_.snapshot().getInteger("upstream.weight_enabled", 1UL) != 0;
+  const bool use_load_reports =
+      runtime_.snapshot().getInteger("upstream.least_request.load_reports_enabled", 0) != 0;
+  const uint64_t choice_count = std::min<uint64_t>(
+      MAX_CHOICE_COUNT,
+      std::max<uint64_t>(1, runtime_.snapshot().getInteger("upstream.least_request.choice_count",
+                                                           DEFAULT_CHOICE_COUNT)));
+
+  // Candidates are compared by (active requests + 1) / weight so that an idle host with a higher
+  // weight is preferred over an idle host with a lower weight. The comparison is done by cross
+  // multiplying to avoid floating point math. Candidates are referenced in place so that picking
+  // does not touch host reference counts. Ties go to the later candidate.
+  // Candidates at the per host circuit breakers are skipped. If all of them are, the first host
+  // after a random one that isn't is picked.
+  const HostLimits limits = hostLimits(hosts_to_use);
+  const HostSharedPtr* best_host = nullptr;
+  uint64_t best_load = 0;
+  uint64_t best_weight = 1;
+  for (uint64_t i = 0; i < choice_count; i++) {
+    const HostSharedPtr& candidate = hosts_to_use[random_.random() % hosts_to_use.size()];
+    if (limits.enabled() && limits.saturated(*candidate)) {
+      stats_.lb_host_saturated_.inc();
+      continue;
+    }
+    const uint64_t load = candidate->stats().rq_active_.value() + 1;
+    uint64_t weight = use_weights ? candidate->weight() : 1;
+    if (use_load_reports) {
+      // The weight is scaled by the spare capacity that the host reports, a fully loaded host keeps
+      // a small share so that it still gets the requests that report its recovery.
+      weight *= 101 - candidate->reportedLoad();
+    }
+    if (best_host == nullptr || load * best_weight <= best_load * weight) {
+      best_host = &candidate;
+      best_load = load;
+      best_weight = weight;
     }
   }
+
+  if (best_host == nullptr) {
+    return nextUnsaturatedHost(hosts_to_use, random_.random() % hosts_to_use.size(), limits);
+  }
+  return *best_host;
 }
 
 HostConstSharedPtr RandomLoadBalancer::chooseHost(const LoadBalancerContext*) {
@@ -301,7 +518,12 @@ HostConstSharedPtr RandomLoadBalancer::chooseHost(const LoadBalancerContext*) {
     return nullptr;
   }
 
-  return hosts_to_use[random_.random() % hosts_to_use.size()];
+  const size_t index = random_.random() % hosts_to_use.size();
+  const HostLimits limits = hostLimits(hosts_to_use);
+  if (!limits.enabled()) {
+    return hosts_to_use[index];
+  }
+  return nextUnsaturatedHost(hosts_to_use, index, limits);
 }
 
 } // namespace Upstream
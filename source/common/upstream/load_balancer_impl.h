@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "envoy/runtime/runtime.h"
@@ -27,28 +28,168 @@ public:
  * Base class for all LB implementations.
  */
 class LoadBalancerBase {
+public:
+  /**
+   * Immutable zone aware routing decisions for one snapshot of an upstream host set and the local
+   * host set. These only change when either host set changes, so they can be computed once
+   * centrally and shared by all load balancers for the upstream cluster.
+   */
+  struct ZoneRouting {
+    enum class State { NoZoneRouting, ZoneDirect, ZoneResidual };
+
+    /**
+     * @return the index of the zone that a sampled threshold in
+     *         [0, residual_capacity_.back()) falls into. O(log(N)) where N is the number of zones.
+     */
+    size_t residualCapacityZone(uint64_t threshold) const;
+
+    State state_{State::NoZoneRouting};
+    // The number of upstream zones the decisions were computed for.
+    size_t num_zones_{};
+    uint64_t local_percent_to_route_{};
+    // Accumulated residual capacity per zone. Only set in the ZoneResidual state.
+    std::vector<uint64_t> residual_capacity_;
+  };
+
+  typedef std::shared_ptr<const ZoneRouting> ZoneRoutingConstSharedPtr;
+
+  /**
+   * Compute the zone aware routing decisions for the current membership of an upstream host set
+   * with respect to the local host set.
+   */
+  static ZoneRoutingConstSharedPtr createZoneRouting(const HostSet& host_set,
+                                                     const HostSet& local_host_set,
+                                                     ClusterStats& stats, Runtime::Loader& runtime);
+
+  /**
+   * Replace the zone routing decisions of a load balancer created with shared zone routing.
+   * @param zone_routing supplies the new decisions. nullptr disables zone aware routing.
+   */
+  void setZoneRouting(ZoneRoutingConstSharedPtr zone_routing);
+
+  /**
+   * Immutable priority and locality routing decisions for one snapshot of a host set. The hosts
+   * are grouped into priority levels by HostDescription::priority(), and the hosts of a level into
+   * localities by zone. Each level takes as much of the load as its overprovisioned health allows,
+   * the rest spills over to the next level. Within a level, the load is split across the
+   * localities by their weights scaled by their overprovisioned health. The decisions only change
+   * when the host set changes, so choosing a host list does not allocate.
+   */
+  struct PriorityRouting {
+    struct Locality {
+      std::vector<HostSharedPtr> hosts_;
+      std::vector<HostSharedPtr> healthy_hosts_;
+    };
+
+    struct Level {
+      uint32_t priority_{};
+      std::vector<HostSharedPtr> hosts_;
+      std::vector<HostSharedPtr> healthy_hosts_;
+      std::vector<Locality> localities_;
+      // Accumulated effective weight per locality. Empty if no locality of the level has a weight.
+      std::vector<uint64_t> locality_weights_;
+    };
+
+    /**
+     * @return the level that a sampled percentage in [0, 100) falls into. O(log(N)) where N is
+     *         the number of levels.
+     */
+    const Level& level(uint64_t sample) const;
+
+    /**
+     * @return the locality of level that a sampled weight in [0, locality_weights_.back()) falls
+     *         into.
+     */
+    static const Locality& locality(const Level& level, uint64_t sample);
+
+    // The levels in priority order.
+    std::vector<Level> levels_;
+    // Accumulated percentage of the load per level. The last entry is 100.
+    std::vector<uint64_t> load_;
+    // The sum of the overprovisioned health of the levels in percent, capped at 100.
+    uint64_t health_{};
+  };
+
+  typedef std::shared_ptr<const PriorityRouting> PriorityRoutingConstSharedPtr;
+
+  /**
+   * Compute the priority and locality routing decisions for the current membership of a host set.
+   * @return nullptr if all of the hosts are of priority 0 and none sets a locality weight, in
+   *         which case the host set is load balanced as a whole.
+   */
+  static PriorityRoutingConstSharedPtr createPriorityRouting(const HostSet& host_set,
+                                                             Runtime::Loader& runtime);
+
+  /**
+   * Replace the priority routing decisions of a load balancer created with shared zone routing.
+   * @param priority_routing supplies the new decisions. nullptr disables priority routing.
+   */
+  void setPriorityRouting(PriorityRoutingConstSharedPtr priority_routing);
+
 protected:
+  /**
+   * Create a load balancer base that recomputes zone aware routing whenever host_set or
+   * local_host_set changes, and priority routing whenever host_set changes.
+   */
   LoadBalancerBase(const HostSet& host_set, const HostSet* local_host_set, ClusterStats& stats,
                    Runtime::Loader& runtime, Runtime::RandomGenerator& random);
+
+  /**
+   * Create a load balancer base that uses zone and priority routing computed elsewhere.
+   * setZoneRouting() must be called whenever the membership of host_set or local_host_set changes,
+   * and setPriorityRouting() whenever the membership of host_set changes.
+   */
+  LoadBalancerBase(const HostSet& host_set, const HostSet* local_host_set, ClusterStats& stats,
+                   Runtime::Loader& runtime, Runtime::RandomGenerator& random,
+                   ZoneRoutingConstSharedPtr zone_routing);
   ~LoadBalancerBase();
 
+  /**
+   * The per host circuit breakers of the cluster, which are read once per pick.
+   */
+  struct HostLimits {
+    bool enabled() const { return max_connections_ > 0 || max_requests_ > 0; }
+    bool saturated(const Host& host) const {
+      return (max_connections_ > 0 && host.stats().cx_active_.value() >= max_connections_) ||
+             (max_requests_ > 0 && host.stats().rq_active_.value() >= max_requests_);
+    }
+
+    uint64_t max_connections_;
+    uint64_t max_requests_;
+  };
+
   /**
    * Pick the host list to use (healthy or all depending on how many in the set are not healthy).
    */
   const std::vector<HostSharedPtr>& hostsToUse();
 
+  /**
+   * @return the per host circuit breakers of the cluster of a non empty host list.
+   */
+  static HostLimits hostLimits(const std::vector<HostSharedPtr>& hosts) {
+    const ClusterInfo& cluster = hosts[0]->cluster();
+    return {cluster.maxHostConnections(), cluster.maxHostRequests()};
+  }
+
+  /**
+   * @return the first host of hosts at or after index, wrapping around, that has not reached the
+   *         per host circuit breakers, or nullptr if every host has. The host counters are atomic,
+   *         so this takes no locks.
+   */
+  HostConstSharedPtr nextUnsaturatedHost(const std::vector<HostSharedPtr>& hosts, size_t index,
+                                         const HostLimits& limits);
+
   ClusterStats& stats_;
   Runtime::Loader& runtime_;
   Runtime::RandomGenerator& random_;
 
 private:
-  enum class ZoneRoutingState { NoZoneRouting, ZoneDirect, ZoneResidual };
-
   /**
    * @return decision on quick exit from zone aware routing based on cluster configuration.
    * This gets recalculated on update callback.
    */
-  bool earlyExitNonZoneRouting();
+  static bool earlyExitNonZoneRouting(const HostSet& host_set, const HostSet& local_host_set,
+                                      ClusterStats& stats, Runtime::Loader& runtime);
 
   /**
    * Try to select upstream hosts from the same zone.
@@ -56,35 +197,39 @@ private:
   const std::vector<HostSharedPtr>& tryChooseLocalZoneHosts();
 
   /**
-   * @return (number of hosts in a given zone)/(total number of hosts) in ret param.
-   * The result is stored as integer number and scaled by 10000 multiplier for better precision.
-   * Caller is responsible for allocation/de-allocation of ret.
+   * Pick the host list of a priority level and locality. Zone aware routing does not apply.
    */
-  void calculateZonePercentage(const std::vector<std::vector<HostSharedPtr>>& hosts_per_zone,
-                               uint64_t* ret);
+  const std::vector<HostSharedPtr>& priorityHostsToUse();
 
   /**
-   * Regenerate zone aware routing structures for fast decisions on upstream zone selection.
+   * @return (number of hosts in a given zone)/(total number of hosts) in ret param.
+   * The result is stored as integer number and scaled by 10000 multiplier for better precision.
+   * Caller is responsible for allocation/de-allocation of ret.
    */
-  void regenerateZoneRoutingStructures();
+  static void calculateZonePercentage(
+      const std::vector<std::vector<HostSharedPtr>>& hosts_per_zone, uint64_t* ret);
 
   const HostSet& host_set_;
   const HostSet* local_host_set_;
-  uint64_t local_percent_to_route_{};
-  ZoneRoutingState zone_routing_state_{ZoneRoutingState::NoZoneRouting};
-  std::vector<uint64_t> residual_capacity_;
+  ZoneRoutingConstSharedPtr zone_routing_;
+  PriorityRoutingConstSharedPtr priority_routing_;
+  Common::CallbackHandle* host_set_member_update_cb_handle_{};
   Common::CallbackHandle* local_host_set_member_update_cb_handle_{};
 };
 
 /**
  * Implementation of LoadBalancer that performs RR selection across the hosts in the cluster.
  */
-class RoundRobinLoadBalancer : public LoadBalancer, LoadBalancerBase {
+class RoundRobinLoadBalancer : public LoadBalancer, public LoadBalancerBase {
 public:
   RoundRobinLoadBalancer(const HostSet& host_set, const HostSet* local_host_set_,
                          ClusterStats& stats, Runtime::Loader& runtime,
                          Runtime::RandomGenerator& random)
       : LoadBalancerBase(host_set, local_host_set_, stats, runtime, random) {}
+  RoundRobinLoadBalancer(const HostSet& host_set, const HostSet* local_host_set_,
+                         ClusterStats& stats, Runtime::Loader& runtime,
+                         Runtime::RandomGenerator& random, ZoneRoutingConstSharedPtr zone_routing)
+      : LoadBalancerBase(host_set, local_host_set_, stats, runtime, random, zone_routing) {}
 
   // Upstream::LoadBalancer
   HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
@@ -96,38 +241,47 @@ private:
 /**
  * Weighted Least Request load balancer.
  *
- * In a normal setup when all hosts have the same weight of 1 it randomly picks up two healthy hosts
- * and compares number of active requests.
+ * Each pick samples N random healthy hosts (two by default, "power of two choices") and selects the
+ * one with the fewest active requests.
  * Technique is based on http://www.eecs.harvard.edu/~michaelm/postscripts/mythesis.pdf
  *
- * When any of the hosts have non 1 weight, apply random weighted balancing.
- * Randomly pickup the host and send 'weight' number of requests to it.
- * This technique is acceptable for load testing but
- * will not work well in situations where requests take a long time.
- * In that case a different algorithm using a full scan will be required.
+ * When any of the hosts have non 1 weight, the active request count of each candidate is scaled by
+ * its weight so that hosts with more capacity receive proportionally more requests. When load
+ * reports are enabled via runtime, the weight is further scaled by the spare capacity that each
+ * host reports, see HostDescription::reportedLoad().
  */
-class LeastRequestLoadBalancer : public LoadBalancer, LoadBalancerBase {
+class LeastRequestLoadBalancer : public LoadBalancer, public LoadBalancerBase {
 public:
-  LeastRequestLoadBalancer(const HostSet& host_set, const HostSet* local_host_set_,
+  LeastRequestLoadBalancer(const HostSet& host_set, const HostSet* local_host_set,
+                           ClusterStats& stats, Runtime::Loader& runtime,
+                           Runtime::RandomGenerator& random)
+      : LoadBalancerBase(host_set, local_host_set, stats, runtime, random) {}
+  LeastRequestLoadBalancer(const HostSet& host_set, const HostSet* local_host_set,
                            ClusterStats& stats, Runtime::Loader& runtime,
-                           Runtime::RandomGenerator& random);
+                           Runtime::RandomGenerator& random, ZoneRoutingConstSharedPtr zone_routing)
+      : LoadBalancerBase(host_set, local_host_set, stats, runtime, random, zone_routing) {}
+
+  // The number of random hosts compared for each pick unless overridden via runtime.
+  static const uint64_t DEFAULT_CHOICE_COUNT = 2;
+  // The most hosts compared for each pick, as the runtime value bounds the work done per request.
+  static const uint64_t MAX_CHOICE_COUNT = 100;
 
   // Upstream::LoadBalancer
   HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
-
-private:
-  HostSharedPtr last_host_;
-  uint32_t hits_left_{};
 };
 
 /**
  * Random load balancer that picks a random host out of all hosts.
  */
-class RandomLoadBalancer : public LoadBalancer, LoadBalancerBase {
+class RandomLoadBalancer : public LoadBalancer, public LoadBalancerBase {
 public:
   RandomLoadBalancer(const HostSet& host_set, const HostSet* local_host_set, ClusterStats& stats,
                      Runtime::Loader& runtime, Runtime::RandomGenerator& random)
       : LoadBalancerBase(host_set, local_host_set, stats, runtime, random) {}
+  RandomLoadBalancer(const HostSet& host_set, const HostSet* local_host_set, ClusterStats& stats,
+                     Runtime::Loader& runtime, Runtime::RandomGenerator& random,
+                     ZoneRoutingConstSharedPtr zone_routing)
+      : LoadBalancerBase(host_set, local_host_set, stats, runtime, random, zone_routing) {}
 
   // Upstream::LoadBalancer
   HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
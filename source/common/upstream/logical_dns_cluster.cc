@@ -1,5 +1,6 @@
 #include "common/upstream/logical_dns_cluster.h"
 
+#include <algorithm>
 #include <chrono>
 #include <list>
 #include <string>
@@ -7,6 +8,7 @@
 
 #include "common/config/utility.h"
 #include "common/network/address_impl.h"
+#include "common/network/happy_eyeballs_connection_impl.h"
 #include "common/network/utility.h"
 #include "common/protobuf/protobuf.h"
 #include "common/protobuf/utility.h"
@@ -27,6 +29,8 @@ LogicalDnsCluster::LogicalDnsCluster(const envoy::api::v2::Cluster& cluster,
       dns_resolver_(dns_resolver),
       dns_refresh_rate_ms_(
           std::chrono::milliseconds(PROTOBUF_GET_MS_OR_DEFAULT(cluster, dns_refresh_rate, 5000))),
+      happy_eyeballs_delay_(runtime.snapshot().getInteger(
+          fmt::format("upstream.happy_eyeballs_delay_ms.{}", cluster.name()), 0)),
       tls_(tls.allocateSlot()), initialized_(false),
       resolve_timer_(dispatcher.createTimer([this]() -> void { startResolve(); })) {
   const auto& hosts = cluster.hosts();
@@ -42,7 +46,9 @@ LogicalDnsCluster::LogicalDnsCluster(const envoy::api::v2::Cluster& cluster,
     dns_lookup_family_ = Network::DnsLookupFamily::V4Only;
     break;
   case envoy::api::v2::Cluster::AUTO:
-    dns_lookup_family_ = Network::DnsLookupFamily::Auto;
+    // With happy eyeballs both families are resolved and connected to.
+    dns_lookup_family_ = happy_eyeballs_delay_.count() > 0 ? Network::DnsLookupFamily::All
+                                                           : Network::DnsLookupFamily::Auto;
     break;
   default:
     NOT_REACHED;
@@ -87,11 +93,22 @@ void LogicalDnsCluster::startResolve() {
           Network::Address::InstanceConstSharedPtr new_address =
               Network::Utility::getAddressWithPort(*address_list.front(),
                                                    Network::Utility::portFromTcpUrl(dns_url_));
-          if (!current_resolved_address_ || !(*new_address == *current_resolved_address_)) {
+          std::vector<Network::Address::InstanceConstSharedPtr> new_addresses;
+          if (dns_lookup_family_ == Network::DnsLookupFamily::All) {
+            for (const auto& address : address_list) {
+              new_addresses.push_back(Network::Utility::getAddressWithPort(
+                  *address, Network::Utility::portFromTcpUrl(dns_url_)));
+            }
+          }
+          if (!current_resolved_address_ || !(*new_address == *current_resolved_address_) ||
+              !addressesEqual(new_addresses, current_resolved_addresses_)) {
             current_resolved_address_ = new_address;
+            current_resolved_addresses_ = new_addresses;
             // Capture URL to avoid a race with another update.
-            tls_->runOnAllThreads([this, new_address]() -> void {
-              tls_->getTyped<PerThreadCurrentHostData>().current_resolved_address_ = new_address;
+            tls_->runOnAllThreads([this, new_address, new_addresses]() -> void {
+              PerThreadCurrentHostData& data = tls_->getTyped<PerThreadCurrentHostData>();
+              data.current_resolved_address_ = new_address;
+              data.current_resolved_addresses_ = new_addresses;
             });
           }
 
@@ -127,10 +144,33 @@ void LogicalDnsCluster::startResolve() {
       });
 }
 
+bool LogicalDnsCluster::addressesEqual(
+    const std::vector<Network::Address::InstanceConstSharedPtr>& lhs,
+    const std::vector<Network::Address::InstanceConstSharedPtr>& rhs) {
+  return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                    [](const Network::Address::InstanceConstSharedPtr& lhs,
+                       const Network::Address::InstanceConstSharedPtr& rhs) -> bool {
+                      return *lhs == *rhs;
+                    });
+}
+
 Upstream::Host::CreateConnectionData
 LogicalDnsCluster::LogicalHost::createConnection(Event::Dispatcher& dispatcher) const {
   PerThreadCurrentHostData& data = parent_.tls_->getTyped<PerThreadCurrentHostData>();
   ASSERT(data.current_resolved_address_);
+  if (data.current_resolved_addresses_.size() > 1) {
+    // The host description has the first address, since the address that is connected to is not
+    // known yet.
+    ClusterInfoConstSharedPtr info = parent_.info_;
+    return {Network::ClientConnectionPtr{new Network::HappyEyeballsConnectionImpl(
+                dispatcher, data.current_resolved_addresses_, parent_.happy_eyeballs_delay_,
+                [&dispatcher, info](Network::Address::InstanceConstSharedPtr address)
+                    -> Network::ClientConnectionPtr {
+                  return HostImpl::createConnection(dispatcher, *info, address);
+                })},
+            HostDescriptionConstSharedPtr{
+                new RealHostDescription(data.current_resolved_address_, shared_from_this())}};
+  }
   return {HostImpl::createConnection(dispatcher, *parent_.info_, data.current_resolved_address_),
           HostDescriptionConstSharedPtr{
               new RealHostDescription(data.current_resolved_address_, shared_from_this())}};
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "envoy/thread_local/thread_local.h"
 
@@ -25,6 +26,9 @@ namespace Upstream {
  * created that will internally have connections to different backends, while still allowing long
  * connection lengths and keep alive. The cluster type should only be used when an IP address change
  * means that connections using the IP should not drain.
+ *
+ * If happy eyeballs is enabled for an AUTO cluster, the name is resolved to the addresses of both
+ * families, and connections race connects to them as described by RFC 8305.
  */
 class LogicalDnsCluster : public ClusterImplBase {
 public:
@@ -80,6 +84,10 @@ private:
     const std::string& hostname() const override { return logical_host_->hostname(); }
     Network::Address::InstanceConstSharedPtr address() const override { return address_; }
     const std::string& zone() const override { return EMPTY_STRING; }
+    uint32_t priority() const override { return logical_host_->priority(); }
+    uint32_t localityWeight() const override { return logical_host_->localityWeight(); }
+    void reportLoad(uint32_t load) const override { logical_host_->reportLoad(load); }
+    uint32_t reportedLoad() const override { return logical_host_->reportedLoad(); }
 
     Network::Address::InstanceConstSharedPtr address_;
     HostConstSharedPtr logical_host_;
@@ -87,13 +95,19 @@ private:
 
   struct PerThreadCurrentHostData : public ThreadLocal::ThreadLocalObject {
     Network::Address::InstanceConstSharedPtr current_resolved_address_;
+    // All the resolved addresses, if happy eyeballs is enabled.
+    std::vector<Network::Address::InstanceConstSharedPtr> current_resolved_addresses_;
   };
 
   void startResolve();
+  static bool addressesEqual(const std::vector<Network::Address::InstanceConstSharedPtr>& lhs,
+                             const std::vector<Network::Address::InstanceConstSharedPtr>& rhs);
 
   Network::DnsResolverSharedPtr dns_resolver_;
   const std::chrono::milliseconds dns_refresh_rate_ms_;
   Network::DnsLookupFamily dns_lookup_family_;
+  // The delay between the connects to the resolved addresses. 0 disables happy eyeballs.
+  std::chrono::milliseconds happy_eyeballs_delay_;
   ThreadLocal::SlotPtr tls_;
   std::function<void()> initialize_callback_;
   // Set once the first resolve completes.
@@ -102,6 +116,7 @@ private:
   std::string dns_url_;
   std::string hostname_;
   Network::Address::InstanceConstSharedPtr current_resolved_address_;
+  std::vector<Network::Address::InstanceConstSharedPtr> current_resolved_addresses_;
   HostSharedPtr logical_host_;
   Network::ActiveDnsQuery* active_dns_query_{};
 };
@@ -0,0 +1,114 @@
+#include "common/upstream/maglev_lb.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/common/assert.h"
+#include "common/common/hash.h"
+#include "common/upstream/load_balancer_impl.h"
+
+namespace Envoy {
+namespace Upstream {
+
+MaglevLoadBalancer::Table::Table(const std::vector<HostSharedPtr>& hosts, uint64_t table_size)
+    : hosts_(hosts) {
+  if (hosts_.empty()) {
+    return;
+  }
+
+  ENVOY_LOG(trace, "maglev: building table of size {} for {} hosts", table_size, hosts_.size());
+
+  // Each host's preference list is the permutation offset, offset + skip, offset + 2 * skip, ...
+  // (mod table_size). Since table_size is prime and 0 < skip < table_size every permutation
+  // visits every slot. Hosts take turns claiming their next unclaimed preferred slot until the
+  // table is full.
+  struct Permutation {
+    uint64_t offset_;
+    uint64_t skip_;
+    uint64_t next_;
+  };
+
+  std::vector<Permutation> permutations;
+  permutations.reserve(hosts_.size());
+  for (const HostSharedPtr& host : hosts_) {
+    const std::string& address = host->address()->asString();
+    permutations.push_back({HashUtil::xxHash64(address) % table_size,
+                            HashUtil::xxHash64(address, 1) % (table_size - 1) + 1, 0});
+  }
+
+  const uint32_t unclaimed = hosts_.size();
+  table_.assign(table_size, unclaimed);
+  uint64_t claimed = 0;
+  while (true) {
+    for (uint32_t i = 0; i < hosts_.size(); i++) {
+      Permutation& permutation = permutations[i];
+      uint64_t slot;
+      do {
+        slot = (permutation.offset_ + permutation.skip_ * permutation.next_++) % table_size;
+      } while (table_[slot] != unclaimed);
+
+      table_[slot] = i;
+      if (++claimed == table_size) {
+        return;
+      }
+    }
+  }
+}
+
+HostConstSharedPtr MaglevLoadBalancer::Table::chooseHost(uint64_t hash) const {
+  if (table_.empty()) {
+    return nullptr;
+  }
+
+  return hosts_[table_[hash % table_.size()]];
+}
+
+MaglevLoadBalancer::MaglevLoadBalancer(HostSet& host_set, ClusterStats& stats,
+                                       Runtime::Loader& runtime, Runtime::RandomGenerator& random)
+    : MaglevLoadBalancer(host_set, stats, runtime, random, nullptr) {
+  host_set_.addMemberUpdateCb(
+      [this](const std::vector<HostSharedPtr>&, const std::vector<HostSharedPtr>&) -> void {
+        setTables(createTables(host_set_));
+      });
+
+  setTables(createTables(host_set_));
+}
+
+MaglevLoadBalancer::MaglevLoadBalancer(HostSet& host_set, ClusterStats& stats,
+                                       Runtime::Loader& runtime, Runtime::RandomGenerator& random,
+                                       TablesConstSharedPtr tables)
+    : host_set_(host_set), stats_(stats), runtime_(runtime), random_(random) {
+  setTables(tables);
+}
+
+MaglevLoadBalancer::TablesConstSharedPtr
+MaglevLoadBalancer::createTables(const HostSet& host_set, uint64_t table_size) {
+  return std::make_shared<const Tables>(host_set, table_size);
+}
+
+void MaglevLoadBalancer::setTables(TablesConstSharedPtr tables) {
+  static const TablesConstSharedPtr empty_tables(new Tables());
+  tables_ = tables ? tables : empty_tables;
+}
+
+HostConstSharedPtr MaglevLoadBalancer::chooseHost(const LoadBalancerContext* context) {
+  // If there is no hash in the context, just choose a random value (this effectively becomes
+  // the random LB but it won't crash if someone configures it this way).
+  // hashKey() may be computed on demand, so get it only once.
+  Optional<uint64_t> hash;
+  if (context) {
+    hash = context->hashKey();
+  }
+  const uint64_t h = hash.valid() ? hash.value() : random_.random();
+
+  if (LoadBalancerUtility::isGlobalPanic(host_set_, runtime_)) {
+    stats_.lb_healthy_panic_.inc();
+    return tables_->all_hosts_.chooseHost(h);
+  } else {
+    return tables_->healthy_hosts_.chooseHost(h);
+  }
+}
+
+} // namespace Upstream
+} // namespace Envoy
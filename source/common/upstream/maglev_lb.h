@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "envoy/runtime/runtime.h"
+#include "envoy/upstream/load_balancer.h"
+
+#include "common/common/logger.h"
+
+namespace Envoy {
+namespace Upstream {
+
+/**
+ * A consistent hashing load balancer based on Maglev
+ * (https://research.google.com/pubs/pub44824.html).
+ * Each host fills slots of a fixed size, prime length lookup table in the order given by its own
+ * permutation of the table, so host selection is a single table index and a change in host
+ * membership only moves a small fraction of slots. As with the ring hash load balancer, a table is
+ * kept for all hosts as well as for healthy hosts, and the healthy host table is used unless we
+ * are in panic mode. Tables are immutable once built, so they can be built once centrally and
+ * shared (see Tables).
+ */
+class MaglevLoadBalancer : public LoadBalancer, Logger::Loggable<Logger::Id::upstream> {
+private:
+  class Table {
+  public:
+    Table(const std::vector<HostSharedPtr>& hosts, uint64_t table_size);
+
+    HostConstSharedPtr chooseHost(uint64_t hash) const;
+
+  private:
+    std::vector<HostSharedPtr> hosts_;
+    // Indexes into hosts_. Empty if there are no hosts.
+    std::vector<uint32_t> table_;
+  };
+
+public:
+  /**
+   * The lookup tables for one snapshot of a host set.
+   */
+  struct Tables {
+    Tables() : all_hosts_({}, 0), healthy_hosts_({}, 0) {}
+    Tables(const HostSet& host_set, uint64_t table_size)
+        : all_hosts_(host_set.hosts(), table_size),
+          healthy_hosts_(host_set.healthyHosts(), table_size) {}
+
+    const Table all_hosts_;
+    const Table healthy_hosts_;
+  };
+
+  typedef std::shared_ptr<const Tables> TablesConstSharedPtr;
+
+  // Must be prime. Large enough that the load difference between hosts is small for clusters of up
+  // to several hundred hosts.
+  static const uint64_t DEFAULT_TABLE_SIZE = 65537;
+
+  /**
+   * Create a load balancer that builds its own tables whenever host_set changes.
+   */
+  MaglevLoadBalancer(HostSet& host_set, ClusterStats& stats, Runtime::Loader& runtime,
+                     Runtime::RandomGenerator& random);
+
+  /**
+   * Create a load balancer that uses tables built elsewhere. setTables() must be called whenever
+   * the membership of host_set changes.
+   */
+  MaglevLoadBalancer(HostSet& host_set, ClusterStats& stats, Runtime::Loader& runtime,
+                     Runtime::RandomGenerator& random, TablesConstSharedPtr tables);
+
+  /**
+   * Build the tables for the current membership of a host set.
+   */
+  static TablesConstSharedPtr createTables(const HostSet& host_set,
+                                           uint64_t table_size = DEFAULT_TABLE_SIZE);
+
+  /**
+   * Replace the tables used by a load balancer created with shared tables.
+   * @param tables supplies the new tables. nullptr is equivalent to an empty host set.
+   */
+  void setTables(TablesConstSharedPtr tables);
+
+  // Upstream::LoadBalancer
+  HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
+
+private:
+  HostSet& host_set_;
+  ClusterStats& stats_;
+  Runtime::Loader& runtime_;
+  Runtime::RandomGenerator& random_;
+  TablesConstSharedPtr tables_;
+};
+
+} // namespace Upstream
+} // namespace Envoy
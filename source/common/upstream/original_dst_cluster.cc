@@ -38,6 +38,17 @@ OriginalDstCluster::LoadBalancer::LoadBalancer(HostSet& host_set, ClusterSharedP
   });
 }
 
+OriginalDstCluster::LoadBalancer::HostKey::HostKey(const Network::Address::Ip& ip)
+    : address_(), port_(static_cast<uint16_t>(ip.port())),
+      version_(static_cast<uint16_t>(ip.version())) {
+  if (ip.version() == Network::Address::IpVersion::v4) {
+    const uint32_t address = ip.ipv4()->address();
+    memcpy(&address_[12], &address, sizeof(address));
+  } else {
+    address_ = ip.ipv6()->address();
+  }
+}
+
 HostConstSharedPtr
 OriginalDstCluster::LoadBalancer::chooseHost(const LoadBalancerContext* context) {
   if (context) {
@@ -47,17 +58,17 @@ OriginalDstCluster::LoadBalancer::chooseHost(const LoadBalancerContext* context)
     // if usingOriginalDst() returns 'true'.
     if (connection && connection->usingOriginalDst()) {
       const Network::Address::Instance& dst_addr = connection->localAddress();
-
-      // Check if a host with the destination address is already in the host set.
-      HostSharedPtr host = host_map_.find(dst_addr);
-      if (host) {
-        ENVOY_LOG(debug, "Using existing host {}.", host->address()->asString());
-        host->used(true); // Mark as used.
-        return std::move(host);
-      }
-      // Add a new host
       const Network::Address::Ip* dst_ip = dst_addr.ip();
       if (dst_ip) {
+        // Check if a host with the destination address is already in the host set.
+        HostSharedPtr host = host_map_.find(*dst_ip);
+        if (host) {
+          ENVOY_LOG(debug, "Using existing host {}.", host->address()->asString());
+          host->used(true); // Mark as used.
+          return std::move(host);
+        }
+
+        // Add a new host
         Network::Address::InstanceConstSharedPtr host_ip_port(
             Network::Utility::copyInternetAddressAndPort(*dst_ip));
         // Create a host we can use immediately.
@@ -112,23 +123,31 @@ void OriginalDstCluster::addHost(HostSharedPtr& host) {
 }
 
 void OriginalDstCluster::cleanup() {
-  HostVectorSharedPtr new_hosts(new std::vector<HostSharedPtr>);
+  // The host set is only copied when hosts are removed, and the load balancers then only update
+  // their maps for the removed hosts.
+  HostVectorSharedPtr new_hosts;
   std::vector<HostSharedPtr> to_be_removed;
   const auto& host_set = hosts();
 
   ENVOY_LOG(debug, "Cleaning up stale original dst hosts.");
-  for (const HostSharedPtr& host : host_set) {
+  for (auto it = host_set.begin(); it != host_set.end(); it++) {
+    const HostSharedPtr& host = *it;
     if (host->used()) {
       ENVOY_LOG(debug, "Keeping active host {}.", host->address()->asString());
-      new_hosts->emplace_back(host);
+      if (new_hosts) {
+        new_hosts->emplace_back(host);
+      }
       host->used(false); // Mark to be removed during the next round.
     } else {
       ENVOY_LOG(debug, "Removing stale host {}.", host->address()->asString());
+      if (!new_hosts) {
+        new_hosts.reset(new std::vector<HostSharedPtr>(host_set.begin(), it));
+      }
       to_be_removed.emplace_back(host);
     }
   }
 
-  if (to_be_removed.size() > 0) {
+  if (new_hosts) {
     updateHosts(new_hosts, createHealthyHostList(*new_hosts), empty_host_lists_, empty_host_lists_,
                 {}, to_be_removed);
   }
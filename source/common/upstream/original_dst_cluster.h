@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cstring>
 #include <functional>
 #include <string>
 #include <unordered_map>
@@ -11,6 +14,8 @@
 #include "common/common/logger.h"
 #include "common/upstream/upstream_impl.h"
 
+#include "xxhash.h"
+
 namespace Envoy {
 namespace Upstream {
 
@@ -50,6 +55,26 @@ public:
     HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
 
   private:
+    /**
+     * An IP address and port in binary form, so that lookups neither format nor hash strings.
+     */
+    struct HostKey {
+      HostKey(const Network::Address::Ip& ip);
+
+      bool operator==(const HostKey& other) const {
+        return memcmp(this, &other, sizeof(HostKey)) == 0;
+      }
+
+      // IPv4 addresses take the last 4 bytes.
+      std::array<uint8_t, 16> address_;
+      uint16_t port_;
+      uint16_t version_;
+    };
+
+    struct HostKeyHash {
+      size_t operator()(const HostKey& key) const { return XXH64(&key, sizeof(HostKey), 0); }
+    };
+
     /**
      * Map from an host IP address/port to a HostSharedPtr.  Due to races multiple distinct host
      * objects with the same address can be created, so we need to use a multimap.
@@ -57,31 +82,31 @@ public:
     class HostMap {
     public:
       bool insert(const HostSharedPtr& host, bool check = true) {
+        const HostKey key(*host->address()->ip());
         if (check) {
-          auto range = map_.equal_range(host->address()->asString());
+          auto range = map_.equal_range(key);
           auto it = std::find_if(
               range.first, range.second,
-              [&host](const decltype(map_)::value_type pair) { return pair.second == host; });
+              [&host](const decltype(map_)::value_type& pair) { return pair.second == host; });
           if (it != range.second) {
             return false; // 'host' already in the map, no need to insert.
           }
         }
-        map_.emplace(host->address()->asString(), host);
+        map_.emplace(key, host);
         return true;
       }
 
       void remove(const HostSharedPtr& host) {
-        auto range = map_.equal_range(host->address()->asString());
-        auto it =
-            std::find_if(range.first, range.second, [&host](const decltype(map_)::value_type pair) {
-              return pair.second == host;
-            });
+        auto range = map_.equal_range(HostKey(*host->address()->ip()));
+        auto it = std::find_if(
+            range.first, range.second,
+            [&host](const decltype(map_)::value_type& pair) { return pair.second == host; });
         ASSERT(it != range.second);
         map_.erase(it);
       }
 
-      HostSharedPtr find(const Network::Address::Instance& address) {
-        auto it = map_.find(address.asString());
+      HostSharedPtr find(const Network::Address::Ip& ip) {
+        auto it = map_.find(HostKey(ip));
 
         if (it != map_.end()) {
           return it->second;
@@ -90,7 +115,7 @@ public:
       }
 
     private:
-      std::unordered_multimap<std::string, HostSharedPtr> map_;
+      std::unordered_multimap<HostKey, HostSharedPtr, HostKeyHash> map_;
     };
 
     HostSet& host_set_;                        // Thread local host set.
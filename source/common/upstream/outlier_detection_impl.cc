@@ -1,6 +1,8 @@
 #include "common/upstream/outlier_detection_impl.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -45,6 +47,16 @@ void DetectorHostMonitorImpl::updateCurrentSuccessRateBucket() {
   success_rate_accumulator_bucket_.store(success_rate_accumulator_.updateCurrentWriter());
 }
 
+void DetectorHostMonitorImpl::updateCurrentLatencyBucket() {
+  latency_accumulator_bucket_.store(latency_accumulator_.updateCurrentWriter());
+}
+
+void DetectorHostMonitorImpl::putResponseTime(std::chrono::milliseconds time) {
+  const uint64_t response_time_ms = std::max<int64_t>(0, time.count());
+  latency_accumulator_bucket_.load()
+      ->response_time_counters_[LatencyAccumulatorBucket::index(response_time_ms)]++;
+}
+
 void DetectorHostMonitorImpl::putHttpResponseCode(uint64_t response_code) {
   success_rate_accumulator_bucket_.load()->total_request_counter_++;
   if (Http::CodeUtility::is5xx(response_code)) {
@@ -82,7 +94,9 @@ DetectorConfig::DetectorConfig(const envoy::api::v2::Cluster::OutlierDetection&
       enforcing_consecutive_5xx_(static_cast<uint64_t>(
           PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, enforcing_consecutive_5xx, 100))),
       enforcing_success_rate_(static_cast<uint64_t>(
-          PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, enforcing_success_rate, 100))) {}
+          PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, enforcing_success_rate, 100))),
+      latency_percentile_(99), latency_minimum_hosts_(5), latency_request_volume_(100),
+      latency_stdev_factor_(1900), latency_mean_factor_(1500), enforcing_latency_(0) {}
 
 DetectorImpl::DetectorImpl(const Cluster& cluster,
                            const envoy::api::v2::Cluster::OutlierDetection& config,
@@ -91,12 +105,12 @@ DetectorImpl::DetectorImpl(const Cluster& cluster,
     : config_(config), dispatcher_(dispatcher), runtime_(runtime), time_source_(time_source),
       stats_(generateStats(cluster.info()->statsScope())),
       interval_timer_(dispatcher.createTimer([this]() -> void { onIntervalTimer(); })),
-      event_logger_(event_logger), success_rate_average_(-1), success_rate_ejection_threshold_(-1) {
-}
+      event_logger_(event_logger), success_rate_average_(-1), success_rate_ejection_threshold_(-1),
+      latency_average_(-1), latency_ejection_threshold_(-1) {}
 
 DetectorImpl::~DetectorImpl() {
-  for (auto host : host_monitors_) {
-    if (host.first->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
+  for (const HostMonitor& host : host_monitors_) {
+    if (host.host_->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
       ASSERT(stats_.ejections_active_.value() > 0);
       stats_.ejections_active_.dec();
     }
@@ -126,13 +140,12 @@ void DetectorImpl::initialize(const Cluster& cluster) {
     }
 
     for (const HostSharedPtr& host : hosts_removed) {
-      ASSERT(host_monitors_.count(host) == 1);
       if (host->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
         ASSERT(stats_.ejections_active_.value() > 0);
         stats_.ejections_active_.dec();
       }
 
-      host_monitors_.erase(host);
+      removeHostMonitor(host);
     }
   });
 
@@ -140,12 +153,25 @@ void DetectorImpl::initialize(const Cluster& cluster) {
 }
 
 void DetectorImpl::addHostMonitor(HostSharedPtr host) {
-  ASSERT(host_monitors_.count(host) == 0);
+  ASSERT(host_monitor_indexes_.count(host) == 0);
   DetectorHostMonitorImpl* monitor = new DetectorHostMonitorImpl(shared_from_this(), host);
-  host_monitors_[host] = monitor;
+  host_monitor_indexes_[host] = host_monitors_.size();
+  host_monitors_.push_back({host, monitor});
   host->setOutlierDetector(DetectorHostMonitorPtr{monitor});
 }
 
+void DetectorImpl::removeHostMonitor(const HostSharedPtr& host) {
+  auto index = host_monitor_indexes_.find(host);
+  ASSERT(index != host_monitor_indexes_.end());
+  // Move the last monitor into the slot of the removed one to keep the monitors contiguous.
+  if (index->second != host_monitors_.size() - 1) {
+    host_monitors_[index->second] = std::move(host_monitors_.back());
+    host_monitor_indexes_[host_monitors_[index->second].host_] = index->second;
+  }
+  host_monitors_.pop_back();
+  host_monitor_indexes_.erase(index);
+}
+
 void DetectorImpl::armIntervalTimer() {
   interval_timer_->enableTimer(std::chrono::milliseconds(
       runtime_.snapshot().getInteger("outlier_detection.interval_ms", config_.intervalMs())));
@@ -181,6 +207,9 @@ bool DetectorImpl::enforceEjection(EjectionType type) {
   case EjectionType::SuccessRate:
     return runtime_.snapshot().featureEnabled("outlier_detection.enforcing_success_rate",
                                               config_.enforcingSuccessRate());
+  case EjectionType::Latency:
+    return runtime_.snapshot().featureEnabled("outlier_detection.enforcing_latency",
+                                              config_.enforcingLatency());
   }
 
   NOT_REACHED;
@@ -195,7 +224,7 @@ void DetectorImpl::ejectHost(HostSharedPtr host, EjectionType type) {
     stats_.ejections_total_.inc();
     if (enforceEjection(type)) {
       stats_.ejections_active_.inc();
-      host_monitors_[host]->eject(time_source_.currentTime());
+      host_monitors_[host_monitor_indexes_[host]].monitor_->eject(time_source_.currentTime());
       runCallbacks(host);
 
       if (event_logger_) {
@@ -240,9 +269,11 @@ void DetectorImpl::onConsecutive5xx(HostSharedPtr host) {
 void DetectorImpl::onConsecutive5xxWorker(HostSharedPtr host) {
   // This comes in cross thread. There is a chance that the host has already been removed from
   // the set. If so, just ignore it.
-  if (host_monitors_.count(host) == 0) {
+  auto index = host_monitor_indexes_.find(host);
+  if (index == host_monitor_indexes_.end()) {
     return;
   }
+  DetectorHostMonitorImpl* monitor = host_monitors_[index->second].monitor_;
 
   if (host->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
     return;
@@ -255,7 +286,7 @@ void DetectorImpl::onConsecutive5xxWorker(HostSharedPtr host) {
   // on the onConsecutive5xxWorker call to prevent thread thrashing. The consecutive_5xx_
   // counter needs to be reset in order to allow the monitor to detect a bout of consecutive
   // 5xx responses even if the monitor is not charged with an interleaved non-5xx code.
-  host_monitors_[host]->resetConsecutive5xx();
+  monitor->resetConsecutive5xx();
 }
 
 Utility::EjectionPair Utility::successRateEjectionThreshold(
@@ -279,7 +310,7 @@ Utility::EjectionPair Utility::successRateEjectionThreshold(
   double mean = success_rate_sum / valid_success_rate_hosts.size();
   double variance = 0;
   std::for_each(valid_success_rate_hosts.begin(), valid_success_rate_hosts.end(),
-                [&variance, mean](HostSuccessRatePair v) {
+                [&variance, mean](const HostSuccessRatePair& v) {
                   variance += std::pow(v.success_rate_ - mean, 2);
                 });
   variance /= valid_success_rate_hosts.size();
@@ -293,7 +324,6 @@ void DetectorImpl::processSuccessRateEjections() {
       "outlier_detection.success_rate_minimum_hosts", config_.successRateMinimumHosts());
   uint64_t success_rate_request_volume = runtime_.snapshot().getInteger(
       "outlier_detection.success_rate_request_volume", config_.successRateRequestVolume());
-  std::vector<HostSuccessRatePair> valid_success_rate_hosts;
   double success_rate_sum = 0;
 
   // Reset the Detector's success rate mean and stdev.
@@ -306,55 +336,140 @@ void DetectorImpl::processSuccessRateEjections() {
   }
 
   // reserve upper bound of vector size to avoid reallocation.
-  valid_success_rate_hosts.reserve(host_monitors_.size());
+  valid_success_rate_hosts_.reserve(host_monitors_.size());
 
-  for (const auto& host : host_monitors_) {
+  for (const HostMonitor& host : host_monitors_) {
     // Don't do work if the host is already ejected.
-    if (!host.first->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
+    if (!host.host_->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
       Optional<double> host_success_rate =
-          host.second->successRateAccumulator().getSuccessRate(success_rate_request_volume);
+          host.monitor_->successRateAccumulator().getSuccessRate(success_rate_request_volume);
 
       if (host_success_rate.valid()) {
-        valid_success_rate_hosts.emplace_back(
-            HostSuccessRatePair(host.first, host_success_rate.value()));
+        valid_success_rate_hosts_.emplace_back(host.host_, host_success_rate.value());
         success_rate_sum += host_success_rate.value();
-        host.second->successRate(host_success_rate.value());
+        host.monitor_->successRate(host_success_rate.value());
       }
     }
   }
 
-  if (valid_success_rate_hosts.size() >= success_rate_minimum_hosts) {
+  if (valid_success_rate_hosts_.size() >= success_rate_minimum_hosts) {
     double success_rate_stdev_factor =
         runtime_.snapshot().getInteger("outlier_detection.success_rate_stdev_factor",
                                        config_.successRateStdevFactor()) /
         1000.0;
     Utility::EjectionPair ejection_pair = Utility::successRateEjectionThreshold(
-        success_rate_sum, valid_success_rate_hosts, success_rate_stdev_factor);
+        success_rate_sum, valid_success_rate_hosts_, success_rate_stdev_factor);
     success_rate_average_ = ejection_pair.success_rate_average_;
     success_rate_ejection_threshold_ = ejection_pair.ejection_threshold_;
-    for (const auto& host_success_rate_pair : valid_success_rate_hosts) {
+    for (const auto& host_success_rate_pair : valid_success_rate_hosts_) {
       if (host_success_rate_pair.success_rate_ < success_rate_ejection_threshold_) {
         stats_.ejections_success_rate_.inc();
         ejectHost(host_success_rate_pair.host_, EjectionType::SuccessRate);
       }
     }
   }
+
+  // Don't hold on to the hosts until the next interval.
+  valid_success_rate_hosts_.clear();
+}
+
+Utility::LatencyEjectionPair
+Utility::latencyEjectionThreshold(double latency_sum,
+                                  const std::vector<HostLatencyPair>& valid_latency_hosts,
+                                  double latency_stdev_factor, double latency_mean_factor) {
+  // This mirrors successRateEjectionThreshold(), except that outliers are above the mean. The
+  // threshold is also at least the mean multiplied by latency_mean_factor, since the standard
+  // deviation is tiny when all hosts have about the same latency.
+  double mean = latency_sum / valid_latency_hosts.size();
+  double variance = 0;
+  std::for_each(valid_latency_hosts.begin(), valid_latency_hosts.end(),
+                [&variance, mean](const HostLatencyPair& v) {
+                  variance += std::pow(v.latency_ - mean, 2);
+                });
+  variance /= valid_latency_hosts.size();
+  double stdev = std::sqrt(variance);
+
+  return {mean, std::max(mean + (latency_stdev_factor * stdev), mean * latency_mean_factor)};
+}
+
+void DetectorImpl::processLatencyEjections() {
+  uint64_t latency_minimum_hosts = runtime_.snapshot().getInteger(
+      "outlier_detection.latency_minimum_hosts", config_.latencyMinimumHosts());
+  uint64_t latency_request_volume = runtime_.snapshot().getInteger(
+      "outlier_detection.latency_request_volume", config_.latencyRequestVolume());
+  double latency_percentile = std::min<uint64_t>(
+      100, runtime_.snapshot().getInteger("outlier_detection.latency_percentile",
+                                          config_.latencyPercentile()));
+  double latency_sum = 0;
+
+  // Reset the Detector's latency mean and threshold.
+  latency_average_ = -1;
+  latency_ejection_threshold_ = -1;
+
+  // Exit early if there are not enough hosts.
+  if (host_monitors_.size() < latency_minimum_hosts) {
+    return;
+  }
+
+  valid_latency_hosts_.reserve(host_monitors_.size());
+
+  for (const HostMonitor& host : host_monitors_) {
+    // Don't do work if the host is already ejected, including by success rate in this interval.
+    if (!host.host_->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
+      Optional<double> host_latency = host.monitor_->latencyAccumulator().getLatency(
+          latency_request_volume, latency_percentile);
+
+      if (host_latency.valid()) {
+        valid_latency_hosts_.emplace_back(host.host_, host_latency.value());
+        latency_sum += host_latency.value();
+        host.monitor_->latency(host_latency.value());
+      }
+    }
+  }
+
+  if (valid_latency_hosts_.size() >= latency_minimum_hosts) {
+    double latency_stdev_factor = runtime_.snapshot().getInteger(
+                                      "outlier_detection.latency_stdev_factor",
+                                      config_.latencyStdevFactor()) /
+                                  1000.0;
+    double latency_mean_factor = runtime_.snapshot().getInteger(
+                                     "outlier_detection.latency_mean_factor",
+                                     config_.latencyMeanFactor()) /
+                                 1000.0;
+    Utility::LatencyEjectionPair ejection_pair = Utility::latencyEjectionThreshold(
+        latency_sum, valid_latency_hosts_, latency_stdev_factor, latency_mean_factor);
+    latency_average_ = ejection_pair.latency_average_;
+    latency_ejection_threshold_ = ejection_pair.ejection_threshold_;
+    for (const auto& host_latency_pair : valid_latency_hosts_) {
+      if (host_latency_pair.latency_ > latency_ejection_threshold_) {
+        stats_.ejections_latency_.inc();
+        ejectHost(host_latency_pair.host_, EjectionType::Latency);
+      }
+    }
+  }
+
+  // Don't hold on to the hosts until the next interval.
+  valid_latency_hosts_.clear();
 }
 
 void DetectorImpl::onIntervalTimer() {
   MonotonicTime now = time_source_.currentTime();
 
-  for (auto host : host_monitors_) {
-    checkHostForUneject(host.first, host.second, now);
-
-    // Need to update the writer bucket to keep the data valid.
-    host.second->updateCurrentSuccessRateBucket();
-    // Refresh host success rate stat for the /clusters endpoint. If there is a new valid value, it
-    // will get updated in processSuccessRateEjections().
-    host.second->successRate(-1);
+  for (const HostMonitor& host : host_monitors_) {
+    checkHostForUneject(host.host_, host.monitor_, now);
+
+    // Need to update the writer buckets to keep the data valid.
+    host.monitor_->updateCurrentSuccessRateBucket();
+    host.monitor_->updateCurrentLatencyBucket();
+    // Refresh host success rate and latency stats for the /clusters endpoint. If there are new
+    // valid values, they will get updated in processSuccessRateEjections() and
+    // processLatencyEjections().
+    host.monitor_->successRate(-1);
+    host.monitor_->latency(-1);
   }
 
   processSuccessRateEjections();
+  processLatencyEjections();
 
   armIntervalTimer();
 }
@@ -395,6 +510,21 @@ void EventLoggerImpl::logEject(HostDescriptionConstSharedPtr host, Detector& det
     "\"cluster_average_success_rate\": \"{}\", " +
     "\"cluster_success_rate_ejection_threshold\": \"{}\"" +
     "}}\n";
+
+  static const std::string json_latency =
+    std::string("{{") +
+    "\"time\": \"{}\", " +
+    "\"secs_since_last_action\": \"{}\", " +
+    "\"cluster\": \"{}\", " +
+    "\"upstream_url\": \"{}\", " +
+    "\"action\": \"eject\", " +
+    "\"type\": \"{}\", " +
+    "\"num_ejections\": \"{}\", " +
+    "\"enforced\": \"{}\", " +
+    "\"host_latency\": \"{}\", " +
+    "\"cluster_average_latency\": \"{}\", " +
+    "\"cluster_latency_ejection_threshold\": \"{}\"" +
+    "}}\n";
   // clang-format on
   SystemTime now = time_source_.currentTime();
   MonotonicTime monotonic_now = monotonic_time_source_.currentTime();
@@ -415,6 +545,14 @@ void EventLoggerImpl::logEject(HostDescriptionConstSharedPtr host, Detector& det
         host->outlierDetector().numEjections(), enforced, host->outlierDetector().successRate(),
         detector.successRateAverage(), detector.successRateEjectionThreshold()));
     break;
+  case EjectionType::Latency:
+    file_->write(fmt::format(
+        json_latency, AccessLogDateTimeFormatter::fromTime(now),
+        secsSinceLastAction(host->outlierDetector().lastUnejectionTime(), monotonic_now),
+        host->cluster().name(), host->address()->asString(), typeToString(type),
+        host->outlierDetector().numEjections(), enforced, host->outlierDetector().latency(),
+        detector.latencyAverage(), detector.latencyEjectionThreshold()));
+    break;
   }
 }
 
@@ -445,6 +583,8 @@ std::string EventLoggerImpl::typeToString(EjectionType type) {
     return "5xx";
   case EjectionType::SuccessRate:
     return "SuccessRate";
+  case EjectionType::Latency:
+    return "Latency";
   }
 
   NOT_REACHED;
@@ -477,6 +617,59 @@ Optional<double> SuccessRateAccumulator::getSuccessRate(uint64_t success_rate_re
                           backup_success_rate_bucket_->total_request_counter_);
 }
 
+uint32_t LatencyAccumulatorBucket::index(uint64_t response_time_ms) {
+  const uint64_t value =
+      response_time_ms < MAX_RESPONSE_TIME_MS ? response_time_ms : MAX_RESPONSE_TIME_MS;
+  if (value < 8) {
+    return value;
+  }
+  // The highest bit selects the power of 2, and the next two bits the bucket within it.
+  const uint32_t exponent = 63 - __builtin_clzll(value);
+  return 8 + (exponent - 3) * 4 + ((value >> (exponent - 2)) & 3);
+}
+
+uint64_t LatencyAccumulatorBucket::lowerBound(uint32_t index) {
+  if (index < 8) {
+    return index;
+  }
+  const uint32_t exponent = (index - 8) / 4 + 3;
+  return (4 + (index - 8) % 4) << (exponent - 2);
+}
+
+LatencyAccumulatorBucket* LatencyAccumulator::updateCurrentWriter() {
+  // Right now current is being written to and backup is not. Flush the backup and swap.
+  for (std::atomic<uint64_t>& counter : backup_latency_bucket_->response_time_counters_) {
+    counter = 0;
+  }
+
+  current_latency_bucket_.swap(backup_latency_bucket_);
+
+  return current_latency_bucket_.get();
+}
+
+Optional<double> LatencyAccumulator::getLatency(uint64_t latency_request_volume,
+                                                double percentile) {
+  uint64_t total = 0;
+  for (const std::atomic<uint64_t>& counter : backup_latency_bucket_->response_time_counters_) {
+    total += counter;
+  }
+  if (total == 0 || total < latency_request_volume) {
+    return Optional<double>();
+  }
+
+  // The percentile is the response time of the request at this rank (1 based) in sorted order.
+  const uint64_t rank = std::max<uint64_t>(1, std::ceil(total * percentile / 100));
+  uint64_t count = 0;
+  for (uint32_t i = 0; i < LatencyAccumulatorBucket::NUM_BUCKETS; i++) {
+    count += backup_latency_bucket_->response_time_counters_[i];
+    if (count >= rank) {
+      return Optional<double>(LatencyAccumulatorBucket::lowerBound(i));
+    }
+  }
+
+  NOT_REACHED;
+}
+
 } // namespace Outlier
 } // namespace Upstream
 } // namespace Envoy
@@ -33,6 +33,7 @@ public:
   const Optional<MonotonicTime>& lastEjectionTime() override { return time_; }
   const Optional<MonotonicTime>& lastUnejectionTime() override { return time_; }
   double successRate() const override { return -1; }
+  double latency() const override { return -1; }
 
 private:
   const Optional<MonotonicTime> time_;
@@ -96,6 +97,71 @@ private:
   std::unique_ptr<SuccessRateAccumulatorBucket> backup_success_rate_bucket_;
 };
 
+/**
+ * Thin struct to facilitate calculations for latency outlier detection.
+ */
+struct HostLatencyPair {
+  HostLatencyPair(HostSharedPtr host, double latency) : host_(host), latency_(latency) {}
+  HostSharedPtr host_;
+  double latency_;
+};
+
+/**
+ * Histogram of response times in milliseconds. Response times below 8ms have a bucket each, and
+ * every following power of 2 is split in 4 buckets, so a bucket spans at most a quarter of its
+ * lower bound. Response times of MAX_RESPONSE_TIME_MS and above go to the last bucket.
+ */
+struct LatencyAccumulatorBucket {
+  static const uint64_t MAX_RESPONSE_TIME_MS = 1 << 20;
+  static const uint32_t NUM_BUCKETS = 77;
+
+  /**
+   * @return the index of the bucket counting a response time.
+   */
+  static uint32_t index(uint64_t response_time_ms);
+
+  /**
+   * @return the smallest response time counted by a bucket.
+   */
+  static uint64_t lowerBound(uint32_t index);
+
+  std::atomic<uint64_t> response_time_counters_[NUM_BUCKETS];
+};
+
+/**
+ * The LatencyAccumulator uses the LatencyAccumulatorBucket to get per host response time
+ * percentiles. Like the SuccessRateAccumulator, it has a fixed window size of time and only needs
+ * a bucket to write to and a bucket to run stats over.
+ */
+class LatencyAccumulator {
+public:
+  LatencyAccumulator()
+      : current_latency_bucket_(new LatencyAccumulatorBucket()),
+        backup_latency_bucket_(new LatencyAccumulatorBucket()) {}
+
+  /**
+   * This function updates the bucket to write data to.
+   * @return a pointer to the LatencyAccumulatorBucket.
+   */
+  LatencyAccumulatorBucket* updateCurrentWriter();
+
+  /**
+   * This function returns a response time percentile of a host over a window of time if the
+   * request volume is high enough.
+   * @param latency_request_volume the threshold of requests an accumulator has to have in order to
+   *                               be able to return a significant percentile.
+   * @param percentile the percentile (0-100) to return.
+   * @return a valid Optional<double> with the lower bound in milliseconds of the histogram bucket
+   *         that holds the percentile. If there were not enough requests, an invalid
+   *         Optional<double> is returned.
+   */
+  Optional<double> getLatency(uint64_t latency_request_volume, double percentile);
+
+private:
+  std::unique_ptr<LatencyAccumulatorBucket> current_latency_bucket_;
+  std::unique_ptr<LatencyAccumulatorBucket> backup_latency_bucket_;
+};
+
 class DetectorImpl;
 
 /**
@@ -104,9 +170,11 @@ class DetectorImpl;
 class DetectorHostMonitorImpl : public DetectorHostMonitor {
 public:
   DetectorHostMonitorImpl(std::shared_ptr<DetectorImpl> detector, HostSharedPtr host)
-      : detector_(detector), host_(host), success_rate_(-1) {
-    // Point the success_rate_accumulator_bucket_ pointer to a bucket.
+      : detector_(detector), host_(host), success_rate_(-1), latency_(-1) {
+    // Point the success_rate_accumulator_bucket_ and latency_accumulator_bucket_ pointers to a
+    // bucket.
     updateCurrentSuccessRateBucket();
+    updateCurrentLatencyBucket();
   }
 
   void eject(MonotonicTime ejection_time);
@@ -114,15 +182,19 @@ public:
   void updateCurrentSuccessRateBucket();
   SuccessRateAccumulator& successRateAccumulator() { return success_rate_accumulator_; }
   void successRate(double new_success_rate) { success_rate_ = new_success_rate; }
+  void updateCurrentLatencyBucket();
+  LatencyAccumulator& latencyAccumulator() { return latency_accumulator_; }
+  void latency(double new_latency) { latency_ = new_latency; }
   void resetConsecutive5xx() { consecutive_5xx_ = 0; }
 
   // Upstream::Outlier::DetectorHostMonitor
   uint32_t numEjections() override { return num_ejections_; }
   void putHttpResponseCode(uint64_t response_code) override;
-  void putResponseTime(std::chrono::milliseconds) override {}
+  void putResponseTime(std::chrono::milliseconds time) override;
   const Optional<MonotonicTime>& lastEjectionTime() override { return last_ejection_time_; }
   const Optional<MonotonicTime>& lastUnejectionTime() override { return last_unejection_time_; }
   double successRate() const override { return success_rate_; }
+  double latency() const override { return latency_; }
 
 private:
   std::weak_ptr<DetectorImpl> detector_;
@@ -134,6 +206,9 @@ private:
   SuccessRateAccumulator success_rate_accumulator_;
   std::atomic<SuccessRateAccumulatorBucket*> success_rate_accumulator_bucket_;
   double success_rate_;
+  LatencyAccumulator latency_accumulator_;
+  std::atomic<LatencyAccumulatorBucket*> latency_accumulator_bucket_;
+  double latency_;
 };
 
 /**
@@ -145,7 +220,8 @@ private:
   GAUGE  (ejections_active)                                                                        \
   COUNTER(ejections_overflow)                                                                      \
   COUNTER(ejections_consecutive_5xx)                                                               \
-  COUNTER(ejections_success_rate)
+  COUNTER(ejections_success_rate)                                                                  \
+  COUNTER(ejections_latency)
 // clang-format on
 
 /**
@@ -171,6 +247,12 @@ public:
   uint64_t successRateStdevFactor() { return success_rate_stdev_factor_; }
   uint64_t enforcingConsecutive5xx() { return enforcing_consecutive_5xx_; }
   uint64_t enforcingSuccessRate() { return enforcing_success_rate_; }
+  uint64_t latencyPercentile() { return latency_percentile_; }
+  uint64_t latencyMinimumHosts() { return latency_minimum_hosts_; }
+  uint64_t latencyRequestVolume() { return latency_request_volume_; }
+  uint64_t latencyStdevFactor() { return latency_stdev_factor_; }
+  uint64_t latencyMeanFactor() { return latency_mean_factor_; }
+  uint64_t enforcingLatency() { return enforcing_latency_; }
 
 private:
   const uint64_t interval_ms_;
@@ -182,6 +264,14 @@ private:
   const uint64_t success_rate_stdev_factor_;
   const uint64_t enforcing_consecutive_5xx_;
   const uint64_t enforcing_success_rate_;
+  // Latency ejection has no configuration fields yet, so these are the defaults of its runtime
+  // settings.
+  const uint64_t latency_percentile_;
+  const uint64_t latency_minimum_hosts_;
+  const uint64_t latency_request_volume_;
+  const uint64_t latency_stdev_factor_;
+  const uint64_t latency_mean_factor_;
+  const uint64_t enforcing_latency_;
 };
 
 /**
@@ -205,13 +295,24 @@ public:
   void addChangedStateCb(ChangeStateCb cb) override { callbacks_.push_back(cb); }
   double successRateAverage() const override { return success_rate_average_; }
   double successRateEjectionThreshold() const override { return success_rate_ejection_threshold_; }
+  double latencyAverage() const override { return latency_average_; }
+  double latencyEjectionThreshold() const override { return latency_ejection_threshold_; }
 
 private:
   DetectorImpl(const Cluster& cluster, const envoy::api::v2::Cluster::OutlierDetection& config,
                Event::Dispatcher& dispatcher, Runtime::Loader& runtime,
                MonotonicTimeSource& time_source, EventLoggerSharedPtr event_logger);
 
+  /**
+   * A host and the monitor that it owns.
+   */
+  struct HostMonitor {
+    HostSharedPtr host_;
+    DetectorHostMonitorImpl* monitor_;
+  };
+
   void addHostMonitor(HostSharedPtr host);
+  void removeHostMonitor(const HostSharedPtr& host);
   void armIntervalTimer();
   void checkHostForUneject(HostSharedPtr host, DetectorHostMonitorImpl* monitor, MonotonicTime now);
   void ejectHost(HostSharedPtr host, EjectionType type);
@@ -222,6 +323,7 @@ private:
   void runCallbacks(HostSharedPtr host);
   bool enforceEjection(EjectionType type);
   void processSuccessRateEjections();
+  void processLatencyEjections();
 
   DetectorConfig config_;
   Event::Dispatcher& dispatcher_;
@@ -230,10 +332,18 @@ private:
   DetectionStats stats_;
   Event::TimerPtr interval_timer_;
   std::list<ChangeStateCb> callbacks_;
-  std::unordered_map<HostSharedPtr, DetectorHostMonitorImpl*> host_monitors_;
+  // The monitors are stored contiguously so that the interval passes are linear scans, and
+  // host_monitor_indexes_ has the index of the monitor of each host.
+  std::vector<HostMonitor> host_monitors_;
+  std::unordered_map<HostSharedPtr, size_t> host_monitor_indexes_;
+  // Scratch space of the interval passes, which keeps its capacity from one interval to the next.
+  std::vector<HostSuccessRatePair> valid_success_rate_hosts_;
+  std::vector<HostLatencyPair> valid_latency_hosts_;
   EventLoggerSharedPtr event_logger_;
   double success_rate_average_;
   double success_rate_ejection_threshold_;
+  double latency_average_;
+  double latency_ejection_threshold_;
 };
 
 class EventLoggerImpl : public EventLogger {
@@ -267,6 +377,11 @@ public:
     double ejection_threshold_;
   };
 
+  struct LatencyEjectionPair {
+    double latency_average_;
+    double ejection_threshold_;
+  };
+
   /**
    * This function returns an EjectionPair for success rate outlier detection. The pair contains
    * the average success rate of all valid hosts in the cluster and the ejection threshold.
@@ -280,6 +395,23 @@ public:
   successRateEjectionThreshold(double success_rate_sum,
                                const std::vector<HostSuccessRatePair>& valid_success_rate_hosts,
                                double success_rate_stdev_factor);
+
+  /**
+   * This function returns a LatencyEjectionPair for latency outlier detection. The pair contains
+   * the average latency of all valid hosts in the cluster and the ejection threshold. If a host's
+   * latency is above this threshold, the host is an outlier.
+   * @param latency_sum is the sum of the data in the valid_latency_hosts vector.
+   * @param valid_latency_hosts is the vector containing the individual latency data points.
+   * @param latency_stdev_factor is the number of standard deviations above the average that the
+   *        threshold is at.
+   * @param latency_mean_factor is the minimum threshold as a multiple of the average, so that hosts
+   *        are not ejected for small differences when latencies are close to each other.
+   * @return LatencyEjectionPair.
+   */
+  static LatencyEjectionPair
+  latencyEjectionThreshold(double latency_sum,
+                           const std::vector<HostLatencyPair>& valid_latency_hosts,
+                           double latency_stdev_factor, double latency_mean_factor);
 };
 
 } // namespace Outlier
@@ -0,0 +1,109 @@
+#include "common/upstream/resource_manager_impl.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace Envoy {
+namespace Upstream {
+
+const uint64_t ResourceManagerImpl::ConcurrencyLimitImpl::LONG_TERM_WINDOWS;
+constexpr double ResourceManagerImpl::ConcurrencyLimitImpl::LATENCY_TOLERANCE;
+
+ResourceManagerImpl::ConcurrencyLimitImpl::ConcurrencyLimitImpl(ResourceManagerImpl& parent,
+                                                                Runtime::Loader& runtime,
+                                                                const std::string& runtime_key,
+                                                                Stats::Scope& stats_scope)
+    : parent_(parent), runtime_(runtime),
+      enabled_runtime_key_(runtime_key + "adaptive_concurrency_enabled"),
+      min_limit_runtime_key_(runtime_key + "adaptive_concurrency_min_limit"),
+      window_requests_runtime_key_(runtime_key + "adaptive_concurrency_window_requests"),
+      stats_{ALL_CONCURRENCY_LIMIT_STATS(POOL_COUNTER(stats_scope), POOL_GAUGE(stats_scope))} {}
+
+bool ResourceManagerImpl::ConcurrencyLimitImpl::canCreate() {
+  if (!enabled()) {
+    return parent_.requests_.canCreate();
+  }
+  if (parent_.requests_.current_ < limit()) {
+    return true;
+  }
+
+  // Only count the requests that max_requests alone would have allowed.
+  if (parent_.requests_.canCreate()) {
+    stats_.rq_concurrency_limited_.inc();
+  }
+  return false;
+}
+
+uint64_t ResourceManagerImpl::ConcurrencyLimitImpl::limit() {
+  const uint64_t max_requests = parent_.requests_.max();
+  if (limit_ == 0) {
+    return max_requests;
+  }
+  return std::min(max_requests, std::max<uint64_t>(limit_, minLimit()));
+}
+
+uint64_t ResourceManagerImpl::ConcurrencyLimitImpl::minLimit() {
+  return std::max<uint64_t>(1, runtime_.snapshot().getInteger(min_limit_runtime_key_, 20));
+}
+
+void ResourceManagerImpl::ConcurrencyLimitImpl::putLatency(std::chrono::microseconds latency) {
+  if (!enabled()) {
+    return;
+  }
+
+  const uint64_t window =
+      std::max<uint64_t>(1, runtime_.snapshot().getInteger(window_requests_runtime_key_, 100));
+  window_latency_us_ += latency.count();
+  if (++window_requests_ < window) {
+    return;
+  }
+
+  // Requests complete on all of the workers, so the first one to fill the window folds it in
+  // while the others carry on filling the next one.
+  std::unique_lock<std::mutex> lock(update_lock_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return;
+  }
+  const uint64_t requests = window_requests_.exchange(0);
+  const uint64_t total_latency_us = window_latency_us_.exchange(0);
+  if (requests < window) {
+    // Another worker folded the window in between.
+    window_requests_ += requests;
+    window_latency_us_ += total_latency_us;
+    return;
+  }
+
+  update(static_cast<double>(total_latency_us) / requests);
+}
+
+void ResourceManagerImpl::ConcurrencyLimitImpl::update(double window_latency_us) {
+  const double max_limit = parent_.requests_.max();
+  const double min_limit = std::min<double>(minLimit(), max_limit);
+  if (estimated_limit_ == 0) {
+    estimated_limit_ = max_limit;
+  }
+  window_latency_us = std::max(window_latency_us, 1.0);
+  if (long_term_latency_us_ == 0) {
+    long_term_latency_us_ = window_latency_us;
+  } else {
+    long_term_latency_us_ += (window_latency_us - long_term_latency_us_) / LONG_TERM_WINDOWS;
+  }
+
+  const double gradient = std::max(
+      0.5, std::min(1.0, LATENCY_TOLERANCE * long_term_latency_us_ / window_latency_us));
+  double new_limit = estimated_limit_ * gradient + std::sqrt(estimated_limit_);
+  // A limit that the requests do not come close to is not tested by them, so it does not grow.
+  if (new_limit > estimated_limit_ && parent_.requests_.current_ * 2 < estimated_limit_) {
+    new_limit = estimated_limit_;
+  }
+
+  estimated_limit_ = std::max(min_limit, std::min(max_limit, new_limit));
+  limit_ = static_cast<uint64_t>(estimated_limit_);
+  stats_.rq_concurrency_limit_.set(limit_);
+}
+
+} // namespace Upstream
+} // namespace Envoy
@@ -1,11 +1,16 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 
 #include "envoy/runtime/runtime.h"
+#include "envoy/stats/stats.h"
+#include "envoy/stats/stats_macros.h"
 #include "envoy/upstream/resource_manager.h"
 
 #include "common/common/assert.h"
@@ -13,6 +18,22 @@
 namespace Envoy {
 namespace Upstream {
 
+/**
+ * All adaptive concurrency limit stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_CONCURRENCY_LIMIT_STATS(COUNTER, GAUGE)                                                \
+  COUNTER(rq_concurrency_limited)                                                                  \
+  GAUGE  (rq_concurrency_limit)
+// clang-format on
+
+/**
+ * Struct definition for all adaptive concurrency limit stats. @see stats_macros.h
+ */
+struct ConcurrencyLimitStats {
+  ALL_CONCURRENCY_LIMIT_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT)
+};
+
 /**
  * Implementation of ResourceManager.
  * NOTE: This implementation makes some assumptions which favor simplicity over correctness.
@@ -26,17 +47,23 @@ class ResourceManagerImpl : public ResourceManager {
 public:
   ResourceManagerImpl(Runtime::Loader& runtime, const std::string& runtime_key,
                       uint64_t max_connections, uint64_t max_pending_requests,
-                      uint64_t max_requests, uint64_t max_retries)
+                      uint64_t max_requests, uint64_t max_retries, Stats::Scope& stats_scope)
       : connections_(max_connections, runtime, runtime_key + "max_connections"),
         pending_requests_(max_pending_requests, runtime, runtime_key + "max_pending_requests"),
         requests_(max_requests, runtime, runtime_key + "max_requests"),
-        retries_(max_retries, runtime, runtime_key + "max_retries") {}
+        retries_(max_retries, runtime, runtime_key + "max_retries"),
+        retry_budget_(*this, runtime, runtime_key),
+        concurrency_limit_(*this, runtime, runtime_key, stats_scope) {}
 
   // Upstream::ResourceManager
   Resource& connections() override { return connections_; }
   Resource& pendingRequests() override { return pending_requests_; }
-  Resource& requests() override { return requests_; }
+  Resource& requests() override { return concurrency_limit_; }
   Resource& retries() override { return retries_; }
+  Resource& retryBudget() override { return retry_budget_; }
+  void putRequestLatency(std::chrono::microseconds latency) override {
+    concurrency_limit_.putLatency(latency);
+  }
 
 private:
   struct ResourceImpl : public Resource {
@@ -59,10 +86,89 @@ private:
     const std::string runtime_key_;
   };
 
+  /**
+   * Allows active retries up to a runtime percentage of the active and pending requests, but at
+   * least a minimum number, so that retries stay proportional to the traffic instead of being
+   * bounded only by max_retries. A percentage of 0 (the default) disables the budget.
+   */
+  struct RetryBudgetImpl : public Resource {
+    RetryBudgetImpl(ResourceManagerImpl& parent, Runtime::Loader& runtime,
+                    const std::string& runtime_key)
+        : parent_(parent), runtime_(runtime),
+          percent_runtime_key_(runtime_key + "retry_budget_percent"),
+          min_concurrency_runtime_key_(runtime_key + "retry_budget_min_concurrency") {}
+
+    // Upstream::Resource
+    bool canCreate() override {
+      return runtime_.snapshot().getInteger(percent_runtime_key_, 0) == 0 ||
+             parent_.retries_.current_ < max();
+    }
+    void inc() override { parent_.retries_.inc(); }
+    void dec() override { parent_.retries_.dec(); }
+    uint64_t max() override {
+      const uint64_t percent = runtime_.snapshot().getInteger(percent_runtime_key_, 0);
+      const uint64_t active = parent_.requests_.current_ + parent_.pending_requests_.current_;
+      return std::max(runtime_.snapshot().getInteger(min_concurrency_runtime_key_, 3),
+                      active * percent / 100);
+    }
+
+    ResourceManagerImpl& parent_;
+    Runtime::Loader& runtime_;
+    const std::string percent_runtime_key_;
+    const std::string min_concurrency_runtime_key_;
+  };
+
+  /**
+   * Limits the active requests to an adaptive limit when enabled via runtime, in the manner of TCP
+   * Vegas. After every window of completed requests, the limit grows by its square root while the
+   * average latency of the window stays within a tolerance of the long term average latency, and
+   * shrinks as the window latency rises above that. The limit starts at max_requests, stays
+   * between a runtime minimum and max_requests, and only grows while the requests use more than
+   * half of it. It counts the same requests as max_requests.
+   */
+  struct ConcurrencyLimitImpl : public Resource {
+    ConcurrencyLimitImpl(ResourceManagerImpl& parent, Runtime::Loader& runtime,
+                         const std::string& runtime_key, Stats::Scope& stats_scope);
+
+    // Upstream::Resource
+    bool canCreate() override;
+    void inc() override { parent_.requests_.inc(); }
+    void dec() override { parent_.requests_.dec(); }
+    uint64_t max() override { return enabled() ? limit() : parent_.requests_.max(); }
+
+    bool enabled() { return runtime_.snapshot().getInteger(enabled_runtime_key_, 0) != 0; }
+    uint64_t limit();
+    uint64_t minLimit();
+    void putLatency(std::chrono::microseconds latency);
+    void update(double window_latency_us);
+
+    // The number of windows over which the long term latency averages.
+    static const uint64_t LONG_TERM_WINDOWS = 20;
+    // How much the window latency may exceed the long term latency before the limit shrinks.
+    static constexpr double LATENCY_TOLERANCE = 1.5;
+
+    ResourceManagerImpl& parent_;
+    Runtime::Loader& runtime_;
+    const std::string enabled_runtime_key_;
+    const std::string min_limit_runtime_key_;
+    const std::string window_requests_runtime_key_;
+    ConcurrencyLimitStats stats_;
+    // 0 until the first window completes.
+    std::atomic<uint64_t> limit_{};
+    std::atomic<uint64_t> window_requests_{};
+    std::atomic<uint64_t> window_latency_us_{};
+    // Held while a window is folded into the limit. Guards the members below.
+    std::mutex update_lock_;
+    double estimated_limit_{};
+    double long_term_latency_us_{};
+  };
+
   ResourceImpl connections_;
   ResourceImpl pending_requests_;
   ResourceImpl requests_;
   ResourceImpl retries_;
+  RetryBudgetImpl retry_budget_;
+  ConcurrencyLimitImpl concurrency_limit_;
 };
 
 typedef std::unique_ptr<ResourceManagerImpl> ResourceManagerImplPtr;
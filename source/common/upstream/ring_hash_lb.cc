@@ -13,24 +13,47 @@ namespace Upstream {
 RingHashLoadBalancer::RingHashLoadBalancer(HostSet& host_set, ClusterStats& stats,
                                            Runtime::Loader& runtime,
                                            Runtime::RandomGenerator& random)
+    : RingHashLoadBalancer(host_set, stats, runtime, random, nullptr) {
+  host_set_.addMemberUpdateCb(
+      [this](const std::vector<HostSharedPtr>&, const std::vector<HostSharedPtr>&) -> void {
+        setRings(createRings(runtime_, host_set_));
+      });
+
+  setRings(createRings(runtime_, host_set_));
+}
+
+RingHashLoadBalancer::RingHashLoadBalancer(HostSet& host_set, ClusterStats& stats,
+                                           Runtime::Loader& runtime,
+                                           Runtime::RandomGenerator& random,
+                                           RingsConstSharedPtr rings)
     : host_set_(host_set), stats_(stats), runtime_(runtime), random_(random) {
-  host_set_.addMemberUpdateCb([this](const std::vector<HostSharedPtr>&,
-                                     const std::vector<HostSharedPtr>&) -> void { refresh(); });
+  setRings(rings);
+}
+
+RingHashLoadBalancer::RingsConstSharedPtr
+RingHashLoadBalancer::createRings(Runtime::Loader& runtime, const HostSet& host_set) {
+  std::shared_ptr<Rings> rings(new Rings());
+  rings->all_hosts_.create(runtime, host_set.hosts());
+  rings->healthy_hosts_.create(runtime, host_set.healthyHosts());
+  return rings;
+}
 
-  refresh();
+void RingHashLoadBalancer::setRings(RingsConstSharedPtr rings) {
+  static const RingsConstSharedPtr empty_rings(new Rings());
+  rings_ = rings ? rings : empty_rings;
 }
 
 HostConstSharedPtr RingHashLoadBalancer::chooseHost(const LoadBalancerContext* context) {
   if (LoadBalancerUtility::isGlobalPanic(host_set_, runtime_)) {
     stats_.lb_healthy_panic_.inc();
-    return all_hosts_ring_.chooseHost(context, random_);
+    return rings_->all_hosts_.chooseHost(context, random_);
   } else {
-    return healthy_hosts_ring_.chooseHost(context, random_);
+    return rings_->healthy_hosts_.chooseHost(context, random_);
   }
 }
 
 HostConstSharedPtr RingHashLoadBalancer::Ring::chooseHost(const LoadBalancerContext* context,
-                                                          Runtime::RandomGenerator& random) {
+                                                          Runtime::RandomGenerator& random) const {
   if (ring_.empty()) {
     return nullptr;
   }
@@ -87,11 +110,8 @@ void RingHashLoadBalancer::Ring::create(Runtime::Loader& runtime,
   // Currently we specify the minimum size of the ring, and determine the replication factor
   // based on the number of hosts. It's possible we might want to support more sophisticated
   // configuration in the future.
-  // NOTE: Currently we keep a ring for healthy hosts and unhealthy hosts, and this is done per
-  //       thread. This is the simplest implementation, but it's expensive from a memory
-  //       standpoint and duplicates the regeneration computation. In the future we might want
-  //       to generate the rings centrally and then just RCU them out to each thread. This is
-  //       sufficient for getting started.
+  // NOTE: The cluster manager builds rings once on the main thread and shares them with every
+  //       worker, so this is not repeated per thread.
   uint64_t min_ring_size = runtime.snapshot().getInteger("upstream.ring_hash.min_ring_size", 1024);
 
   uint64_t hashes_per_host = 1;
@@ -125,10 +145,5 @@ void RingHashLoadBalancer::Ring::create(Runtime::Loader& runtime,
 #endif
 }
 
-void RingHashLoadBalancer::refresh() {
-  all_hosts_ring_.create(runtime_, host_set_.hosts());
-  healthy_hosts_ring_.create(runtime_, host_set_.healthyHosts());
-}
-
 } // namespace Upstream
 } // namespace Envoy
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "envoy/runtime/runtime.h"
@@ -14,20 +15,14 @@ namespace Upstream {
 /**
  * A load balancer that implements consistent modulo hashing ("ketama"). Currently, zone aware
  * routing is not supported. A ring is kept for all hosts as well as a ring for healthy hosts.
- * Unless we are in panic mode, the healthy host ring is used.
+ * Unless we are in panic mode, the healthy host ring is used. Rings can either be built by each
+ * load balancer or built once centrally and shared (see Rings).
  * In the future it would be nice to support:
  * 1) Weighting.
  * 2) Per-zone rings and optional zone aware routing (not all applications will want this).
  * 3) Max request fallback to support hot shards (not all applications will want this).
  */
 class RingHashLoadBalancer : public LoadBalancer, Logger::Loggable<Logger::Id::upstream> {
-public:
-  RingHashLoadBalancer(HostSet& host_set, ClusterStats& stats, Runtime::Loader& runtime,
-                       Runtime::RandomGenerator& random);
-
-  // Upstream::LoadBalancer
-  HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
-
 private:
   struct RingEntry {
     uint64_t hash_;
@@ -36,20 +31,57 @@ private:
 
   struct Ring {
     HostConstSharedPtr chooseHost(const LoadBalancerContext* context,
-                                  Runtime::RandomGenerator& random);
+                                  Runtime::RandomGenerator& random) const;
     void create(Runtime::Loader& runtime, const std::vector<HostSharedPtr>& hosts);
 
     std::vector<RingEntry> ring_;
   };
 
-  void refresh();
+public:
+  /**
+   * The rings for one snapshot of a host set. Rings are immutable once built, so a single
+   * instance built on the main thread can be shared by the load balancers on every worker.
+   */
+  struct Rings {
+    Ring all_hosts_;
+    Ring healthy_hosts_;
+  };
 
+  typedef std::shared_ptr<const Rings> RingsConstSharedPtr;
+
+  /**
+   * Create a load balancer that builds its own rings whenever host_set changes.
+   */
+  RingHashLoadBalancer(HostSet& host_set, ClusterStats& stats, Runtime::Loader& runtime,
+                       Runtime::RandomGenerator& random);
+
+  /**
+   * Create a load balancer that uses rings built elsewhere. setRings() must be called whenever
+   * the membership of host_set changes.
+   */
+  RingHashLoadBalancer(HostSet& host_set, ClusterStats& stats, Runtime::Loader& runtime,
+                       Runtime::RandomGenerator& random, RingsConstSharedPtr rings);
+
+  /**
+   * Build the rings for the current membership of a host set.
+   */
+  static RingsConstSharedPtr createRings(Runtime::Loader& runtime, const HostSet& host_set);
+
+  /**
+   * Replace the rings used by a load balancer created with shared rings.
+   * @param rings supplies the new rings. nullptr is equivalent to an empty host set.
+   */
+  void setRings(RingsConstSharedPtr rings);
+
+  // Upstream::LoadBalancer
+  HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
+
+private:
   HostSet& host_set_;
   ClusterStats& stats_;
   Runtime::Loader& runtime_;
   Runtime::RandomGenerator& random_;
-  Ring all_hosts_ring_;
-  Ring healthy_hosts_ring_;
+  RingsConstSharedPtr rings_;
 };
 
 } // namespace Upstream
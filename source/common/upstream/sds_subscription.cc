@@ -35,8 +35,7 @@ SdsSubscription::SdsSubscription(ClusterStats& stats,
 }
 
 void SdsSubscription::parseResponse(const Http::Message& response) {
-  const std::string response_body = response.bodyAsString();
-  Json::ObjectSharedPtr json = Json::Factory::loadFromString(response_body);
+  Json::ObjectSharedPtr json = parseJsonBody(response);
   json->validateSchema(Json::Schema::SDS_SCHEMA);
 
   // Since in the v2 EDS API we place all the endpoints for a given zone in the same proto, we first
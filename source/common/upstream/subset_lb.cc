@@ -0,0 +1,132 @@
+#include "common/upstream/subset_lb.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common/common/assert.h"
+#include "common/config/metadata.h"
+#include "common/config/well_known_names.h"
+#include "common/upstream/load_balancer_impl.h"
+#include "common/upstream/maglev_lb.h"
+#include "common/upstream/ring_hash_lb.h"
+
+#include "fmt/format.h"
+
+namespace Envoy {
+namespace Upstream {
+
+SubsetLoadBalancer::SubsetLoadBalancer(const ClusterInfo& cluster, const HostSet& host_set,
+                                       LoadBalancerPtr&& fallback_lb, Runtime::Loader& runtime,
+                                       Runtime::RandomGenerator& random)
+    : lb_type_(cluster.lbType()), subset_keys_(cluster.lbSubsetKeys()),
+      fallback_runtime_key_(fmt::format("upstream.{}.lb_subset_fallback", cluster.name())),
+      host_set_(host_set), fallback_lb_(std::move(fallback_lb)), stats_(cluster.stats()),
+      runtime_(runtime), random_(random),
+      empty_host_lists_(new std::vector<std::vector<HostSharedPtr>>()) {
+  ASSERT(lb_type_ != LoadBalancerType::OriginalDst);
+  member_update_cb_handle_ = host_set_.addMemberUpdateCb(
+      [this](const std::vector<HostSharedPtr>&, const std::vector<HostSharedPtr>&) -> void {
+        update();
+      });
+
+  update();
+}
+
+SubsetLoadBalancer::~SubsetLoadBalancer() { member_update_cb_handle_->remove(); }
+
+HostConstSharedPtr SubsetLoadBalancer::chooseHost(const LoadBalancerContext* context) {
+  const MetadataMatchCriteria* criteria = context ? context->metadataMatchCriteria() : nullptr;
+  if (criteria == nullptr) {
+    return fallback_lb_->chooseHost(context);
+  }
+
+  auto subset = subsets_.find(criteria->subsetKey());
+  if (subset != subsets_.end()) {
+    HostConstSharedPtr host = subset->second->lb_->chooseHost(context);
+    if (host) {
+      stats_.lb_subsets_selected_.inc();
+      return host;
+    }
+  }
+
+  if (runtime_.snapshot().getInteger(fallback_runtime_key_, 1) == 0) {
+    return nullptr;
+  }
+  stats_.lb_subsets_fallback_.inc();
+  return fallback_lb_->chooseHost(context);
+}
+
+void SubsetLoadBalancer::update() {
+  // The hosts and healthy hosts of each subset in the order of the host set, by subset key.
+  std::unordered_map<std::string, std::pair<HostVectorSharedPtr, HostVectorSharedPtr>> members;
+  const std::string& filter = Config::MetadataFilters::get().ENVOY_LB;
+  const auto add_hosts = [&](const std::vector<HostSharedPtr>& hosts, bool healthy) -> void {
+    for (const HostSharedPtr& host : hosts) {
+      for (const std::vector<std::string>& keys : subset_keys_) {
+        std::string subset_key;
+        if (!Config::Metadata::subsetKey(host->metadata(), filter, keys, subset_key)) {
+          continue;
+        }
+
+        std::pair<HostVectorSharedPtr, HostVectorSharedPtr>& lists = members[subset_key];
+        if (!lists.first) {
+          lists.first.reset(new std::vector<HostSharedPtr>());
+          lists.second.reset(new std::vector<HostSharedPtr>());
+        }
+        (healthy ? lists.second : lists.first)->push_back(host);
+      }
+    }
+  };
+  add_hosts(host_set_.hosts(), false);
+  add_hosts(host_set_.healthyHosts(), true);
+
+  // Subsets without hosts are removed, so that subsets of retired metadata values do not pile up.
+  for (auto subset = subsets_.begin(); subset != subsets_.end();) {
+    if (members.count(subset->first) == 0) {
+      subset = subsets_.erase(subset);
+    } else {
+      ++subset;
+    }
+  }
+
+  // The load balancers of the subsets rebuild their state from the host lists alone.
+  const std::vector<HostSharedPtr> no_hosts;
+  for (auto& member : members) {
+    SubsetPtr& subset = subsets_[member.first];
+    if (!subset) {
+      subset.reset(new Subset());
+      subset->lb_ = createLoadBalancer(subset->host_set_);
+    }
+    subset->host_set_.updateHosts(member.second.first, member.second.second, empty_host_lists_,
+                                  empty_host_lists_, no_hosts, no_hosts);
+  }
+
+  ENVOY_LOG(debug, "subset lb: {} subsets of {} hosts", subsets_.size(), host_set_.hosts().size());
+}
+
+LoadBalancerPtr SubsetLoadBalancer::createLoadBalancer(HostSet& host_set) {
+  switch (lb_type_) {
+  case LoadBalancerType::LeastRequest:
+    return LoadBalancerPtr{
+        new LeastRequestLoadBalancer(host_set, nullptr, stats_, runtime_, random_)};
+  case LoadBalancerType::Random:
+    return LoadBalancerPtr{new RandomLoadBalancer(host_set, nullptr, stats_, runtime_, random_)};
+  case LoadBalancerType::RoundRobin:
+    return LoadBalancerPtr{
+        new RoundRobinLoadBalancer(host_set, nullptr, stats_, runtime_, random_)};
+  case LoadBalancerType::RingHash:
+    return LoadBalancerPtr{new RingHashLoadBalancer(host_set, stats_, runtime_, random_)};
+  case LoadBalancerType::Maglev:
+    return LoadBalancerPtr{new MaglevLoadBalancer(host_set, stats_, runtime_, random_)};
+  case LoadBalancerType::OriginalDst:
+    break;
+  }
+
+  NOT_REACHED;
+}
+
+} // namespace Upstream
+} // namespace Envoy
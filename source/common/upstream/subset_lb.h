@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "envoy/runtime/runtime.h"
+#include "envoy/upstream/load_balancer.h"
+#include "envoy/upstream/upstream.h"
+
+#include "common/common/logger.h"
+#include "common/upstream/upstream_impl.h"
+
+namespace Envoy {
+namespace Upstream {
+
+/**
+ * A load balancer that splits the hosts of a cluster into subsets by the values of their envoy.lb
+ * endpoint metadata for each of the key sets of ClusterInfo::lbSubsetKeys(), and chooses the host
+ * of a request with metadata match criteria from the subset that the criteria identify, using a
+ * load balancer of the cluster's type over the hosts of the subset. The subsets are rebuilt when the
+ * membership of the host set changes, so that choosing a subset is a single hash table lookup.
+ * Requests without criteria are load balanced over all of the hosts by the fallback load balancer.
+ * So are requests whose subset is empty or unknown, unless fallback is disabled via runtime. Subsets
+ * do not do zone aware routing.
+ */
+class SubsetLoadBalancer : public LoadBalancer, Logger::Loggable<Logger::Id::upstream> {
+public:
+  SubsetLoadBalancer(const ClusterInfo& cluster, const HostSet& host_set,
+                     LoadBalancerPtr&& fallback_lb, Runtime::Loader& runtime,
+                     Runtime::RandomGenerator& random);
+  ~SubsetLoadBalancer();
+
+  // Upstream::LoadBalancer
+  HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
+
+private:
+  struct Subset {
+    // The load balancer of a subset registers for the updates of its host set, so it must be
+    // destroyed first.
+    HostSetImpl host_set_;
+    LoadBalancerPtr lb_;
+  };
+
+  typedef std::unique_ptr<Subset> SubsetPtr;
+
+  void update();
+  LoadBalancerPtr createLoadBalancer(HostSet& host_set);
+
+  const LoadBalancerType lb_type_;
+  const std::vector<std::vector<std::string>> subset_keys_;
+  const std::string fallback_runtime_key_;
+  const HostSet& host_set_;
+  LoadBalancerPtr fallback_lb_;
+  ClusterStats& stats_;
+  Runtime::Loader& runtime_;
+  Runtime::RandomGenerator& random_;
+  const HostListsConstSharedPtr empty_host_lists_;
+  std::unordered_map<std::string, SubsetPtr> subsets_;
+  Common::CallbackHandle* member_update_cb_handle_;
+};
+
+} // namespace Upstream
+} // namespace Envoy
@@ -1,10 +1,12 @@
 #include "common/upstream/upstream_impl.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <list>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -15,6 +17,7 @@
 #include "envoy/upstream/health_checker.h"
 
 #include "common/common/enum_to_int.h"
+#include "common/common/thread.h"
 #include "common/common/utility.h"
 #include "common/config/protocol_json.h"
 #include "common/config/tls_context_json.h"
@@ -47,8 +50,96 @@ getSourceAddress(const envoy::api::v2::Cluster& cluster,
   // If there's no source address in the cluster config, use any default from the bootstrap proto.
   return source_address;
 }
+
+/**
+ * Values shared by all of the hosts that have an identical value. Only weak references are kept,
+ * so a value is freed with the last host using it. Hosts can be created on any thread.
+ */
+template <class T> class SharedValues {
+public:
+  template <class Create>
+  std::shared_ptr<const T> get(const std::string& key, const Create& create) {
+    std::unique_lock<Thread::BasicLockable> lock(lock_);
+    std::weak_ptr<const T>& entry = values_[key];
+    std::shared_ptr<const T> value = entry.lock();
+    if (!value) {
+      value = std::make_shared<const T>(create());
+      entry = value;
+      if (values_.size() >= purge_size_) {
+        purge();
+      }
+    }
+    return value;
+  }
+
+private:
+  void purge() {
+    for (auto it = values_.begin(); it != values_.end();) {
+      it = it->second.expired() ? values_.erase(it) : std::next(it);
+    }
+    purge_size_ = 2 * values_.size() > MIN_PURGE_SIZE ? 2 * values_.size() : MIN_PURGE_SIZE;
+  }
+
+  static const size_t MIN_PURGE_SIZE = 64;
+
+  Thread::MutexBasicLockable lock_;
+  std::unordered_map<std::string, std::weak_ptr<const T>> values_;
+  size_t purge_size_{MIN_PURGE_SIZE};
+};
+
 } // namespace
 
+void HostDescriptionImpl::reportLoad(uint32_t load) const {
+  // Each report moves the average 1/8 of the way, the first report is used as is. Concurrent
+  // reports from several threads may drop one of the reports, which the average tolerates.
+  const uint32_t sample = std::min(load, 100U) << 8;
+  const uint32_t current = reported_load_;
+  if (current == NO_LOAD_REPORTED) {
+    reported_load_ = sample;
+  } else {
+    reported_load_ = static_cast<uint32_t>(current + (static_cast<int64_t>(sample) - current) / 8);
+  }
+}
+
+uint32_t HostDescriptionImpl::reportedLoad() const {
+  const uint32_t current = reported_load_;
+  return current == NO_LOAD_REPORTED ? 0 : (current + 128) >> 8;
+}
+
+std::shared_ptr<const envoy::api::v2::Metadata>
+HostDescriptionImpl::sharedMetadata(const envoy::api::v2::Metadata& metadata) {
+  static const std::shared_ptr<const envoy::api::v2::Metadata> empty =
+      std::make_shared<const envoy::api::v2::Metadata>();
+  if (metadata.filter_metadata().empty()) {
+    return empty;
+  }
+
+  // Equal serializations are equal metadata. The reverse does not hold for maps, in which case the
+  // metadata is just not shared.
+  static SharedValues<envoy::api::v2::Metadata>* values =
+      new SharedValues<envoy::api::v2::Metadata>();
+  return values->get(metadata.SerializeAsString(),
+                     [&metadata]() -> envoy::api::v2::Metadata { return metadata; });
+}
+
+uint32_t HostDescriptionImpl::envoyLbNumber(const envoy::api::v2::Metadata& metadata,
+                                            const std::string& key) {
+  const double value =
+      Config::Metadata::metadataValue(metadata, Config::MetadataFilters::get().ENVOY_LB, key)
+          .number_value();
+  return value > 0 ? static_cast<uint32_t>(std::min<double>(value, UINT32_MAX)) : 0;
+}
+
+std::shared_ptr<const std::string> HostDescriptionImpl::sharedZone(const std::string& zone) {
+  static const std::shared_ptr<const std::string> empty = std::make_shared<const std::string>();
+  if (zone.empty()) {
+    return empty;
+  }
+
+  static SharedValues<std::string>* values = new SharedValues<std::string>();
+  return values->get(zone, [&zone]() -> std::string { return zone; });
+}
+
 Host::CreateConnectionData HostImpl::createConnection(Event::Dispatcher& dispatcher) const {
   return {createConnection(dispatcher, *cluster_, address_), shared_from_this()};
 }
@@ -61,6 +152,9 @@ HostImpl::createConnection(Event::Dispatcher& dispatcher, const ClusterInfo& clu
                                                                   cluster.sourceAddress())
                            : dispatcher.createClientConnection(address, cluster.sourceAddress());
   connection->setBufferLimits(cluster.perConnectionBufferLimitBytes());
+  if (!cluster.socketOptions().empty()) {
+    connection->setSocketOptions(cluster.socketOptions());
+  }
   return connection;
 }
 
@@ -82,14 +176,32 @@ ClusterInfoImpl::ClusterInfoImpl(const envoy::api::v2::Cluster& config,
       per_connection_buffer_limit_bytes_(
           PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, per_connection_buffer_limit_bytes, 1024 * 1024)),
       stats_scope_(stats.createScope(fmt::format("cluster.{}.", name_))),
-      stats_(generateStats(*stats_scope_)), features_(parseFeatures(config)),
-      http2_settings_(Http::Utility::parseHttp2Settings(config.http2_protocol_options())),
-      resource_managers_(config, runtime, name_),
+      stats_(generateStats(*stats_scope_)), code_stats_(*stats_scope_),
+      features_(parseFeatures(config)),
+      http2_settings_(parseHttp2Settings(config, runtime, name_)),
+      resource_managers_(config, runtime, name_, *stats_scope_),
       maintenance_mode_runtime_key_(fmt::format("upstream.maintenance_mode.{}", name_)),
-      source_address_(getSourceAddress(config, source_address)), added_via_api_(added_via_api) {
+      min_idle_connections_runtime_key_(
+          fmt::format("upstream.{}.http1.min_idle_connections", name_)),
+      connection_prefetch_percent_runtime_key_(
+          fmt::format("upstream.{}.http1.prefetch_percent", name_)),
+      idle_connection_timeout_runtime_key_(
+          fmt::format("upstream.{}.http1.idle_timeout_ms", name_)),
+      connection_reuse_fifo_runtime_key_(fmt::format("upstream.{}.http1.reuse_fifo", name_)),
+      max_host_connections_runtime_key_(
+          fmt::format("circuit_breakers.{}.max_host_connections", name_)),
+      max_host_requests_runtime_key_(fmt::format("circuit_breakers.{}.max_host_requests", name_)),
+      source_address_(getSourceAddress(config, source_address)),
+      lb_subset_keys_(parseLbSubsetKeys(runtime, name_)),
+      socket_options_(parseSocketOptions(runtime, name_)), added_via_api_(added_via_api) {
   ssl_ctx_ = nullptr;
   if (config.has_tls_context()) {
-    Ssl::ClientContextConfigImpl context_config(config.tls_context());
+    // The TLS context API has no session cache settings yet, so they are read from runtime when
+    // the cluster is created.
+    const uint32_t max_session_cache_size = runtime.snapshot().getInteger(
+        fmt::format("upstream.{}.ssl.max_session_cache_size", name_),
+        DEFAULT_MAX_SSL_SESSION_CACHE_SIZE);
+    Ssl::ClientContextConfigImpl context_config(config.tls_context(), max_session_cache_size);
     ssl_ctx_ = ssl_context_manager.createSslClientContext(*stats_scope_, context_config);
   }
 
@@ -104,7 +216,11 @@ ClusterInfoImpl::ClusterInfoImpl(const envoy::api::v2::Cluster& config,
     lb_type_ = LoadBalancerType::Random;
     break;
   case envoy::api::v2::Cluster::RING_HASH:
-    lb_type_ = LoadBalancerType::RingHash;
+    // Maglev is a drop in replacement for the ring hash load balancer that is enabled per cluster
+    // via runtime, as the v2 API does not have a Maglev load balancing policy.
+    lb_type_ = runtime.snapshot().getInteger(fmt::format("upstream.maglev.{}", name_), 0) != 0
+                   ? LoadBalancerType::Maglev
+                   : LoadBalancerType::RingHash;
     break;
   case envoy::api::v2::Cluster::ORIGINAL_DST_LB:
     if (config.type() != envoy::api::v2::Cluster::ORIGINAL_DST) {
@@ -129,7 +245,8 @@ ClusterSharedPtr ClusterImplBase::create(const envoy::api::v2::Cluster& cluster,
                                          Event::Dispatcher& dispatcher,
                                          const LocalInfo::LocalInfo& local_info,
                                          Outlier::EventLoggerSharedPtr outlier_event_logger,
-                                         bool added_via_api) {
+                                         bool added_via_api,
+                                         Event::Dispatcher* maintenance_dispatcher) {
   std::unique_ptr<ClusterImplBase> new_cluster;
 
   // We make this a shared pointer to deal with the distinct ownership
@@ -188,8 +305,14 @@ ClusterSharedPtr ClusterImplBase::create(const envoy::api::v2::Cluster& cluster,
   if (!cluster.health_checks().empty()) {
     // TODO(htuch): Need to support multiple health checks in v2.
     ASSERT(cluster.health_checks().size() == 1);
-    new_cluster->setHealthChecker(HealthCheckerFactory::create(
-        cluster.health_checks()[0], *new_cluster, runtime, random, dispatcher));
+    Event::Dispatcher* health_check_dispatcher = nullptr;
+    if (maintenance_dispatcher != nullptr &&
+        runtime.snapshot().getInteger("health_check.maintenance_thread", 0) != 0) {
+      health_check_dispatcher = maintenance_dispatcher;
+    }
+    new_cluster->setHealthChecker(
+        HealthCheckerFactory::create(cluster.health_checks()[0], *new_cluster, runtime, random,
+                                     dispatcher, local_info, health_check_dispatcher));
   }
 
   new_cluster->setOutlierDetector(Outlier::DetectorImplFactory::createForCluster(
@@ -237,6 +360,31 @@ bool ClusterInfoImpl::maintenanceMode() const {
   return runtime_.snapshot().featureEnabled(maintenance_mode_runtime_key_, 0);
 }
 
+uint32_t ClusterInfoImpl::minIdleConnections() const {
+  return runtime_.snapshot().getInteger(min_idle_connections_runtime_key_, 0);
+}
+
+uint32_t ClusterInfoImpl::connectionPrefetchPercent() const {
+  return runtime_.snapshot().getInteger(connection_prefetch_percent_runtime_key_, 100);
+}
+
+std::chrono::milliseconds ClusterInfoImpl::idleConnectionTimeout() const {
+  return std::chrono::milliseconds(
+      runtime_.snapshot().getInteger(idle_connection_timeout_runtime_key_, 0));
+}
+
+bool ClusterInfoImpl::connectionReuseFifo() const {
+  return runtime_.snapshot().getInteger(connection_reuse_fifo_runtime_key_, 0) != 0;
+}
+
+uint64_t ClusterInfoImpl::maxHostConnections() const {
+  return runtime_.snapshot().getInteger(max_host_connections_runtime_key_, 0);
+}
+
+uint64_t ClusterInfoImpl::maxHostRequests() const {
+  return runtime_.snapshot().getInteger(max_host_requests_runtime_key_, 0);
+}
+
 uint64_t ClusterInfoImpl::parseFeatures(const envoy::api::v2::Cluster& config) {
   uint64_t features = 0;
   if (config.has_http2_protocol_options()) {
@@ -245,6 +393,54 @@ uint64_t ClusterInfoImpl::parseFeatures(const envoy::api::v2::Cluster& config) {
   return features;
 }
 
+Http::Http2Settings ClusterInfoImpl::parseHttp2Settings(const envoy::api::v2::Cluster& config,
+                                                       Runtime::Loader& runtime,
+                                                       const std::string& name) {
+  const std::string runtime_prefix = fmt::format("upstream.{}.", name);
+  Http::Http2Settings settings =
+      Http::Utility::parseHttp2Settings(config.http2_protocol_options(), runtime, runtime_prefix);
+  settings.max_connections_per_host_ = std::max<uint64_t>(
+      1, runtime.snapshot().getInteger(runtime_prefix + "http2.max_connections_per_host",
+                                       Http::Http2Settings::DEFAULT_MAX_CONNECTIONS_PER_HOST));
+  settings.connection_stream_threshold_ = std::max<uint64_t>(
+      1, runtime.snapshot().getInteger(runtime_prefix + "http2.connection_stream_threshold",
+                                       Http::Http2Settings::DEFAULT_CONNECTION_STREAM_THRESHOLD));
+  return settings;
+}
+
+std::vector<std::vector<std::string>>
+ClusterInfoImpl::parseLbSubsetKeys(Runtime::Loader& runtime, const std::string& name) {
+  // The v2 API has no subset configuration, so the key sets are read from runtime when the cluster
+  // is created, e.g. "version,stage;version" splits by version and stage, and by version alone.
+  std::vector<std::vector<std::string>> subset_keys;
+  const std::string& value =
+      runtime.snapshot().get(fmt::format("upstream.{}.lb_subset_keys", name));
+  for (const std::string& key_set : StringUtil::split(value, ';')) {
+    std::vector<std::string> keys = StringUtil::split(key_set, ',');
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    if (!keys.empty() &&
+        std::find(subset_keys.begin(), subset_keys.end(), keys) == subset_keys.end()) {
+      subset_keys.push_back(std::move(keys));
+    }
+  }
+  return subset_keys;
+}
+
+Network::SocketOptions ClusterInfoImpl::parseSocketOptions(Runtime::Loader& runtime,
+                                                           const std::string& name) {
+  // The v2 API has no socket options, so they are read from runtime when the cluster is created.
+  Runtime::Snapshot& snapshot = runtime.snapshot();
+  const std::string prefix = fmt::format("upstream.{}.socket.", name);
+  Network::SocketOptions options;
+  options.tcp_fast_open_connect_ = snapshot.getInteger(prefix + "tcp_fast_open", 0) != 0;
+  options.notsent_lowat_bytes_ = snapshot.getInteger(prefix + "notsent_lowat_bytes", 0);
+  options.busy_poll_us_ = snapshot.getInteger(prefix + "busy_poll_us", 0);
+  options.receive_buffer_bytes_ = snapshot.getInteger(prefix + "receive_buffer_bytes", 0);
+  options.send_buffer_bytes_ = snapshot.getInteger(prefix + "send_buffer_bytes", 0);
+  return options;
+}
+
 ResourceManager& ClusterInfoImpl::resourceManager(ResourcePriority priority) const {
   ASSERT(enumToInt(priority) < resource_managers_.managers_.size());
   return *resource_managers_.managers_[enumToInt(priority)];
@@ -293,17 +489,24 @@ void ClusterImplBase::reloadHealthyHosts() {
 
 ClusterInfoImpl::ResourceManagers::ResourceManagers(const envoy::api::v2::Cluster& config,
                                                     Runtime::Loader& runtime,
-                                                    const std::string& cluster_name) {
+                                                    const std::string& cluster_name,
+                                                    Stats::Scope& stats_scope) {
+  scopes_[enumToInt(ResourcePriority::Default)] =
+      stats_scope.createScope("circuit_breakers.default.");
+  scopes_[enumToInt(ResourcePriority::High)] = stats_scope.createScope("circuit_breakers.high.");
   managers_[enumToInt(ResourcePriority::Default)] =
-      load(config, runtime, cluster_name, envoy::api::v2::RoutingPriority::DEFAULT);
+      load(config, runtime, cluster_name, envoy::api::v2::RoutingPriority::DEFAULT,
+           *scopes_[enumToInt(ResourcePriority::Default)]);
   managers_[enumToInt(ResourcePriority::High)] =
-      load(config, runtime, cluster_name, envoy::api::v2::RoutingPriority::HIGH);
+      load(config, runtime, cluster_name, envoy::api::v2::RoutingPriority::HIGH,
+           *scopes_[enumToInt(ResourcePriority::High)]);
 }
 
 ResourceManagerImplPtr
 ClusterInfoImpl::ResourceManagers::load(const envoy::api::v2::Cluster& config,
                                         Runtime::Loader& runtime, const std::string& cluster_name,
-                                        const envoy::api::v2::RoutingPriority& priority) {
+                                        const envoy::api::v2::RoutingPriority& priority,
+                                        Stats::Scope& stats_scope) {
   uint64_t max_connections = 1024;
   uint64_t max_pending_requests = 1024;
   uint64_t max_requests = 1024;
@@ -324,7 +527,8 @@ ClusterInfoImpl::ResourceManagers::load(const envoy::api::v2::Cluster& config,
     max_retries = PROTOBUF_GET_WRAPPED_OR_DEFAULT(*it, max_retries, max_retries);
   }
   return ResourceManagerImplPtr{new ResourceManagerImpl(
-      runtime, runtime_prefix, max_connections, max_pending_requests, max_requests, max_retries)};
+      runtime, runtime_prefix, max_connections, max_pending_requests, max_requests, max_retries,
+      stats_scope)};
 }
 
 StaticClusterImpl::StaticClusterImpl(const envoy::api::v2::Cluster& cluster,
@@ -350,39 +554,50 @@ bool BaseDynamicClusterImpl::updateDynamicHostList(const std::vector<HostSharedP
                                                    std::vector<HostSharedPtr>& hosts_removed,
                                                    bool depend_on_hc) {
   uint64_t max_host_weight = 1;
+  bool health_changed = false;
 
   // Go through and see if the list we have is different from what we just got. If it is, we
-  // make a new host list and raise a change notification. This uses an N^2 search given that
-  // this does not happen very often and the list sizes should be small. We also check for
-  // duplicates here. It's possible for DNS to return the same address multiple times, and a bad
-  // SDS implementation could do the same thing.
+  // make a new host list and raise a change notification. The current hosts are indexed by
+  // address, so that large EDS clusters are not searched once per host on every update. We also
+  // check for duplicates here. It's possible for DNS to return the same address multiple times,
+  // and a bad SDS implementation could do the same thing.
+  std::unordered_map<std::string, size_t> current_host_indexes;
+  for (size_t i = 0; i < current_hosts.size(); i++) {
+    current_host_indexes.emplace(current_hosts[i]->address()->asString(), i);
+  }
+  std::vector<bool> current_host_kept(current_hosts.size());
+
   std::unordered_set<std::string> host_addresses;
   std::vector<HostSharedPtr> final_hosts;
   for (const HostSharedPtr& host : new_hosts) {
-    if (host_addresses.count(host->address()->asString())) {
+    const std::string& address = host->address()->asString();
+    if (!host_addresses.emplace(address).second) {
       continue;
     }
-    host_addresses.emplace(host->address()->asString());
 
-    bool found = false;
-    for (auto i = current_hosts.begin(); i != current_hosts.end();) {
+    auto current_host_index = current_host_indexes.find(address);
+    if (current_host_index != current_host_indexes.end()) {
       // If we find a host matched based on address, we keep it. However we do change weight inline
       // so do that here.
-      if (*(*i)->address() == *host->address()) {
-        if (host->weight() > max_host_weight) {
-          max_host_weight = host->weight();
-        }
-
-        (*i)->weight(host->weight());
-        final_hosts.push_back(*i);
-        i = current_hosts.erase(i);
-        found = true;
-      } else {
-        i++;
+      const HostSharedPtr& current_host = current_hosts[current_host_index->second];
+      if (host->weight() > max_host_weight) {
+        max_host_weight = host->weight();
       }
-    }
 
-    if (!found) {
+      current_host->weight(host->weight());
+      // The health status given by EDS may also change for an existing host.
+      if (host->healthFlagGet(Host::HealthFlag::FAILED_EDS_HEALTH) !=
+          current_host->healthFlagGet(Host::HealthFlag::FAILED_EDS_HEALTH)) {
+        if (host->healthFlagGet(Host::HealthFlag::FAILED_EDS_HEALTH)) {
+          current_host->healthFlagSet(Host::HealthFlag::FAILED_EDS_HEALTH);
+        } else {
+          current_host->healthFlagClear(Host::HealthFlag::FAILED_EDS_HEALTH);
+        }
+        health_changed = true;
+      }
+      final_hosts.push_back(current_host);
+      current_host_kept[current_host_index->second] = true;
+    } else {
       if (host->weight() > max_host_weight) {
         max_host_weight = host->weight();
       }
@@ -397,25 +612,30 @@ bool BaseDynamicClusterImpl::updateDynamicHostList(const std::vector<HostSharedP
     }
   }
 
-  // If there are removed hosts, check to see if we should only delete if unhealthy.
-  if (!current_hosts.empty() && depend_on_hc) {
-    for (auto i = current_hosts.begin(); i != current_hosts.end();) {
-      if (!(*i)->healthFlagGet(Host::HealthFlag::FAILED_ACTIVE_HC)) {
-        if ((*i)->weight() > max_host_weight) {
-          max_host_weight = (*i)->weight();
-        }
+  // Only the hosts that are gone are left in the current hosts. If there are any, check to see if
+  // we should only delete them if unhealthy.
+  std::vector<HostSharedPtr> removed_hosts;
+  for (size_t i = 0; i < current_hosts.size(); i++) {
+    if (current_host_kept[i]) {
+      continue;
+    }
 
-        final_hosts.push_back(*i);
-        i = current_hosts.erase(i);
-      } else {
-        i++;
+    HostSharedPtr& host = current_hosts[i];
+    if (depend_on_hc && !host->healthFlagGet(Host::HealthFlag::FAILED_ACTIVE_HC)) {
+      if (host->weight() > max_host_weight) {
+        max_host_weight = host->weight();
       }
+
+      final_hosts.push_back(std::move(host));
+    } else {
+      removed_hosts.push_back(std::move(host));
     }
   }
+  current_hosts = std::move(removed_hosts);
 
   info_->stats().max_host_weight_.set(max_host_weight);
 
-  if (!hosts_added.empty() || !current_hosts.empty()) {
+  if (!hosts_added.empty() || !current_hosts.empty() || health_changed) {
     hosts_removed = std::move(current_hosts);
     current_hosts = std::move(final_hosts);
     return true;
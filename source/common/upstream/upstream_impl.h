@@ -26,6 +26,7 @@
 #include "common/common/logger.h"
 #include "common/config/metadata.h"
 #include "common/config/well_known_names.h"
+#include "common/http/codes.h"
 #include "common/stats/stats_impl.h"
 #include "common/upstream/outlier_detection_impl.h"
 #include "common/upstream/resource_manager_impl.h"
@@ -44,6 +45,39 @@ public:
   void setUnhealthy() override {}
 };
 
+#define GENERATE_STANDALONE_COUNTER(NAME) Stats::StandaloneCounterImpl NAME##_{#NAME};
+#define GENERATE_STANDALONE_GAUGE(NAME) Stats::StandaloneGaugeImpl NAME##_{#NAME};
+#define STANDALONE_STAT_REF(NAME) NAME##_,
+#define STANDALONE_STAT_TO_LIST(NAME) list.emplace_back(owner, &NAME##_);
+#define STANDALONE_STAT_IGNORE(NAME)
+
+/**
+ * Backing store for the per host stats. Clusters can have very many hosts, so the stats are a fixed
+ * block of standalone stats rather than an IsolatedStoreImpl with its name maps and allocations.
+ */
+class HostStatsStore {
+public:
+  const HostStats& stats() const { return stats_; }
+
+  /**
+   * @param owner supplies the owner of the store, which the returned stats keep alive.
+   */
+  std::list<Stats::CounterSharedPtr> counters(const std::shared_ptr<const void>& owner) {
+    std::list<Stats::CounterSharedPtr> list;
+    ALL_HOST_STATS(STANDALONE_STAT_TO_LIST, STANDALONE_STAT_IGNORE)
+    return list;
+  }
+  std::list<Stats::GaugeSharedPtr> gauges(const std::shared_ptr<const void>& owner) {
+    std::list<Stats::GaugeSharedPtr> list;
+    ALL_HOST_STATS(STANDALONE_STAT_IGNORE, STANDALONE_STAT_TO_LIST)
+    return list;
+  }
+
+private:
+  ALL_HOST_STATS(GENERATE_STANDALONE_COUNTER, GENERATE_STANDALONE_GAUGE)
+  HostStats stats_{ALL_HOST_STATS(STANDALONE_STAT_REF, STANDALONE_STAT_REF)};
+};
+
 /**
  * Implementation of Upstream::HostDescription.
  */
@@ -56,12 +90,14 @@ public:
         canary_(Config::Metadata::metadataValue(metadata, Config::MetadataFilters::get().ENVOY_LB,
                                                 Config::MetadataEnvoyLbKeys::get().CANARY)
                     .bool_value()),
-        metadata_(metadata),
-        zone_(zone), stats_{ALL_HOST_STATS(POOL_COUNTER(stats_store_), POOL_GAUGE(stats_store_))} {}
+        priority_(envoyLbNumber(metadata, Config::MetadataEnvoyLbKeys::get().PRIORITY)),
+        locality_weight_(
+            envoyLbNumber(metadata, Config::MetadataEnvoyLbKeys::get().LOCALITY_WEIGHT)),
+        metadata_(sharedMetadata(metadata)), zone_(sharedZone(zone)) {}
 
   // Upstream::HostDescription
   bool canary() const override { return canary_; }
-  const envoy::api::v2::Metadata& metadata() const override { return metadata_; }
+  const envoy::api::v2::Metadata& metadata() const override { return *metadata_; }
   const ClusterInfo& cluster() const override { return *cluster_; }
   HealthCheckHostMonitor& healthChecker() const override {
     if (health_checker_) {
@@ -81,20 +117,42 @@ public:
       return *null_outlier_detector;
     }
   }
-  const HostStats& stats() const override { return stats_; }
+  const HostStats& stats() const override { return stats_store_.stats(); }
   const std::string& hostname() const override { return hostname_; }
   Network::Address::InstanceConstSharedPtr address() const override { return address_; }
-  const std::string& zone() const override { return zone_; }
+  const std::string& zone() const override { return *zone_; }
+  uint32_t priority() const override { return priority_; }
+  uint32_t localityWeight() const override { return locality_weight_; }
+  void reportLoad(uint32_t load) const override;
+  uint32_t reportedLoad() const override;
 
 protected:
+  /**
+   * Hosts with identical metadata or zones share a single copy, as there are usually only a few
+   * distinct values across all of the hosts.
+   */
+  static std::shared_ptr<const envoy::api::v2::Metadata>
+  sharedMetadata(const envoy::api::v2::Metadata& metadata);
+  static std::shared_ptr<const std::string> sharedZone(const std::string& zone);
+
+  /**
+   * @return the envoy.lb metadata number value of key as an unsigned integer, 0 if it is unset or
+   *         negative.
+   */
+  static uint32_t envoyLbNumber(const envoy::api::v2::Metadata& metadata, const std::string& key);
+
   ClusterInfoConstSharedPtr cluster_;
   const std::string hostname_;
   Network::Address::InstanceConstSharedPtr address_;
   const bool canary_;
-  const envoy::api::v2::Metadata metadata_;
-  const std::string zone_;
-  Stats::IsolatedStoreImpl stats_store_;
-  HostStats stats_;
+  const uint32_t priority_;
+  const uint32_t locality_weight_;
+  const std::shared_ptr<const envoy::api::v2::Metadata> metadata_;
+  const std::shared_ptr<const std::string> zone_;
+  mutable HostStatsStore stats_store_;
+  static const uint32_t NO_LOAD_REPORTED = UINT32_MAX;
+  // The smoothed load in 1/256 percent, or NO_LOAD_REPORTED.
+  mutable std::atomic<uint32_t> reported_load_{NO_LOAD_REPORTED};
   Outlier::DetectorHostMonitorPtr outlier_detector_;
   HealthCheckHostMonitorPtr health_checker_;
 };
@@ -115,9 +173,13 @@ public:
   }
 
   // Upstream::Host
-  std::list<Stats::CounterSharedPtr> counters() const override { return stats_store_.counters(); }
+  std::list<Stats::CounterSharedPtr> counters() const override {
+    return stats_store_.counters(shared_from_this());
+  }
   CreateConnectionData createConnection(Event::Dispatcher& dispatcher) const override;
-  std::list<Stats::GaugeSharedPtr> gauges() const override { return stats_store_.gauges(); }
+  std::list<Stats::GaugeSharedPtr> gauges() const override {
+    return stats_store_.gauges(shared_from_this());
+  }
   void healthFlagClear(HealthFlag flag) override { health_flags_ &= ~enumToInt(flag); }
   bool healthFlagGet(HealthFlag flag) const override { return health_flags_ & enumToInt(flag); }
   void healthFlagSet(HealthFlag flag) override { health_flags_ |= enumToInt(flag); }
@@ -144,11 +206,6 @@ private:
   std::atomic<bool> used_;
 };
 
-typedef std::shared_ptr<std::vector<HostSharedPtr>> HostVectorSharedPtr;
-typedef std::shared_ptr<const std::vector<HostSharedPtr>> HostVectorConstSharedPtr;
-typedef std::shared_ptr<std::vector<std::vector<HostSharedPtr>>> HostListsSharedPtr;
-typedef std::shared_ptr<const std::vector<std::vector<HostSharedPtr>>> HostListsConstSharedPtr;
-
 /**
  * Base class for all clusters as well as thread local host sets.
  */
@@ -180,6 +237,12 @@ public:
   const std::vector<std::vector<HostSharedPtr>>& healthyHostsPerZone() const override {
     return *healthy_hosts_per_zone_;
   }
+  HostVectorConstSharedPtr hostsPtr() const override { return hosts_; }
+  HostVectorConstSharedPtr healthyHostsPtr() const override { return healthy_hosts_; }
+  HostListsConstSharedPtr hostsPerZonePtr() const override { return hosts_per_zone_; }
+  HostListsConstSharedPtr healthyHostsPerZonePtr() const override {
+    return healthy_hosts_per_zone_;
+  }
   Common::CallbackHandle* addMemberUpdateCb(MemberUpdateCb callback) const override {
     return member_update_cb_helper_.add(callback);
   }
@@ -223,31 +286,54 @@ public:
   uint64_t features() const override { return features_; }
   const Http::Http2Settings& http2Settings() const override { return http2_settings_; }
   LoadBalancerType lbType() const override { return lb_type_; }
+  const std::vector<std::vector<std::string>>& lbSubsetKeys() const override {
+    return lb_subset_keys_;
+  }
   bool maintenanceMode() const override;
   uint64_t maxRequestsPerConnection() const override { return max_requests_per_connection_; }
+  uint32_t minIdleConnections() const override;
+  uint32_t connectionPrefetchPercent() const override;
+  std::chrono::milliseconds idleConnectionTimeout() const override;
+  bool connectionReuseFifo() const override;
+  uint64_t maxHostConnections() const override;
+  uint64_t maxHostRequests() const override;
   const std::string& name() const override { return name_; }
   ResourceManager& resourceManager(ResourcePriority priority) const override;
   Ssl::ClientContext* sslContext() const override { return ssl_ctx_.get(); }
   ClusterStats& stats() const override { return stats_; }
   Stats::Scope& statsScope() const override { return *stats_scope_; }
+  Http::UpstreamCodeStats& codeStats() const override { return code_stats_; }
   const Network::Address::InstanceConstSharedPtr& sourceAddress() const override {
     return source_address_;
   };
+  const Network::SocketOptions& socketOptions() const override { return socket_options_; }
 
 private:
   struct ResourceManagers {
     ResourceManagers(const envoy::api::v2::Cluster& config, Runtime::Loader& runtime,
-                     const std::string& cluster_name);
+                     const std::string& cluster_name, Stats::Scope& stats_scope);
     ResourceManagerImplPtr load(const envoy::api::v2::Cluster& config, Runtime::Loader& runtime,
                                 const std::string& cluster_name,
-                                const envoy::api::v2::RoutingPriority& priority);
+                                const envoy::api::v2::RoutingPriority& priority,
+                                Stats::Scope& stats_scope);
 
     typedef std::array<ResourceManagerImplPtr, NumResourcePriorities> Managers;
 
+    // The stats of each resource manager, which outlive it.
+    std::array<Stats::ScopePtr, NumResourcePriorities> scopes_;
     Managers managers_;
   };
 
+  // The TLS sessions that each worker caches for the hosts of the cluster, one per host.
+  static const uint32_t DEFAULT_MAX_SSL_SESSION_CACHE_SIZE = 1024;
+
   static uint64_t parseFeatures(const envoy::api::v2::Cluster& config);
+  static Http::Http2Settings parseHttp2Settings(const envoy::api::v2::Cluster& config,
+                                                Runtime::Loader& runtime, const std::string& name);
+  static std::vector<std::vector<std::string>> parseLbSubsetKeys(Runtime::Loader& runtime,
+                                                                 const std::string& name);
+  static Network::SocketOptions parseSocketOptions(Runtime::Loader& runtime,
+                                                   const std::string& name);
 
   Runtime::Loader& runtime_;
   const std::string name_;
@@ -256,13 +342,22 @@ private:
   const uint32_t per_connection_buffer_limit_bytes_;
   Stats::ScopePtr stats_scope_;
   mutable ClusterStats stats_;
+  mutable Http::UpstreamCodeStatsImpl code_stats_;
   Ssl::ClientContextPtr ssl_ctx_;
   const uint64_t features_;
   const Http::Http2Settings http2_settings_;
   mutable ResourceManagers resource_managers_;
   const std::string maintenance_mode_runtime_key_;
+  const std::string min_idle_connections_runtime_key_;
+  const std::string connection_prefetch_percent_runtime_key_;
+  const std::string idle_connection_timeout_runtime_key_;
+  const std::string connection_reuse_fifo_runtime_key_;
+  const std::string max_host_connections_runtime_key_;
+  const std::string max_host_requests_runtime_key_;
   const Network::Address::InstanceConstSharedPtr source_address_;
   LoadBalancerType lb_type_;
+  const std::vector<std::vector<std::string>> lb_subset_keys_;
+  const Network::SocketOptions socket_options_;
   const bool added_via_api_;
 };
 
@@ -274,6 +369,11 @@ class ClusterImplBase : public Cluster,
                         protected Logger::Loggable<Logger::Id::upstream> {
 
 public:
+  /**
+   * Create a primary cluster. The health checks of the cluster run on maintenance_dispatcher, if
+   * it is supplied and the health_check.maintenance_thread runtime setting is enabled, and
+   * otherwise on dispatcher.
+   */
   static ClusterSharedPtr create(const envoy::api::v2::Cluster& cluster, ClusterManager& cm,
                                  Stats::Store& stats, ThreadLocal::Instance& tls,
                                  Network::DnsResolverSharedPtr dns_resolver,
@@ -281,7 +381,8 @@ public:
                                  Runtime::RandomGenerator& random, Event::Dispatcher& dispatcher,
                                  const LocalInfo::LocalInfo& local_info,
                                  Outlier::EventLoggerSharedPtr outlier_event_logger,
-                                 bool added_via_api);
+                                 bool added_via_api,
+                                 Event::Dispatcher* maintenance_dispatcher = nullptr);
 
   /**
    * Optionally set the health checker for the primary cluster. This is done after cluster
@@ -32,12 +32,16 @@ int main(int argc, char** argv) {
 
 #ifdef ENVOY_HOT_RESTART
   // Enabled by default, except on OS X. Control with "bazel --define=hot_restart=disabled"
-  const std::string shared_mem_version = Envoy::Server::SharedMemory::version();
+  Envoy::OptionsImpl::HotRestartVersionCb hot_restart_version_cb = [](uint32_t max_stats) {
+    return Envoy::Server::SharedMemory::version(max_stats);
+  };
 #else
-  const std::string shared_mem_version = "disabled";
+  Envoy::OptionsImpl::HotRestartVersionCb hot_restart_version_cb = [](uint32_t) {
+    return "disabled";
+  };
 #endif
 
-  Envoy::OptionsImpl options(argc, argv, shared_mem_version, spdlog::level::warn);
+  Envoy::OptionsImpl options(argc, argv, hot_restart_version_cb, spdlog::level::warn);
 
   return Envoy::main_common(options);
 }
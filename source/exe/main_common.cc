@@ -1,10 +1,13 @@
 #include <iostream>
 #include <memory>
+#include <vector>
 
 #include "common/common/compiler_requirements.h"
+#include "common/common/utility.h"
 #include "common/event/libevent.h"
 #include "common/network/utility.h"
 #include "common/stats/stats_impl.h"
+#include "common/stats/tag_extractor_impl.h"
 #include "common/stats/thread_local_store.h"
 
 #include "server/config_validation/server.h"
@@ -27,7 +30,7 @@ class ProdComponentFactory : public ComponentFactory {
 public:
   // Server::DrainManagerFactory
   DrainManagerPtr createDrainManager(Instance& server) override {
-    return DrainManagerPtr{new DrainManagerImpl(server)};
+    return DrainManagerPtr{new DrainManagerImpl(server, ProdMonotonicTimeSource::instance_)};
   }
 
   Runtime::LoaderPtr createRuntime(Server::Instance& server,
@@ -60,6 +63,11 @@ int main_common(OptionsImpl& options) {
 #endif
 
   Event::Libevent::Global::initialize();
+  if (!Event::Libevent::Global::backendSupported(options.eventBackend())) {
+    std::cerr << "event backend '" << options.eventBackend()
+              << "' is not supported on this platform" << std::endl;
+    return 1;
+  }
   Server::ProdComponentFactory component_factory;
   auto local_address = Network::Utility::getLocalAddress(options.localAddressIpVersion());
   switch (options.mode()) {
@@ -71,15 +79,27 @@ int main_common(OptionsImpl& options) {
     return Server::validateConfig(options, local_address, component_factory) ? 0 : 1;
   }
 
+  std::vector<Stats::TagExtractorPtr> tag_extractors;
+  try {
+    tag_extractors = Stats::TagExtractorImpl::createTagExtractors(options.statsTags());
+  } catch (Envoy::EnvoyException& e) {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  }
+
   ares_library_init(ARES_LIB_INIT_ALL);
 
-  Logger::Registry::initialize(options.logLevel(), log_lock);
+  Logger::Registry::initialize(options.logLevel(), log_lock, options.logAsyncBufferSize());
   DefaultTestHooks default_test_hooks;
   ThreadLocal::InstanceImpl tls;
   Stats::ThreadLocalStoreImpl stats_store(stats_allocator);
+  // Stats are only tagged when they are created, so this must precede the server.
+  stats_store.setTagExtractors(std::move(tag_extractors));
   Server::InstanceImpl server(options, local_address, default_test_hooks, *restarter, stats_store,
                               access_log_lock, component_factory, tls);
   server.run();
+  // The buffered log messages are written with log_lock, which goes away with the restarter.
+  Logger::Registry::getSink()->stopAsync();
   ares_library_cleanup();
   return 0;
 }
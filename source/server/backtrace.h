@@ -63,6 +63,18 @@ public:
    */
   void captureFrom(void* address) { stack_trace_.load_from(address, MAX_STACK_DEPTH); }
 
+  /**
+   * @return size_t the number of frames in the captured trace, including the sentinel frame at
+   *         the end.
+   */
+  size_t size() { return stack_trace_.size(); }
+
+  /**
+   * @param index supplies the index of a frame, from 0 for the innermost one.
+   * @return void* the address of the frame.
+   */
+  void* address(size_t index) { return stack_trace_[index].addr; }
+
   /**
    * Log the stack trace.
    */
@@ -18,10 +18,16 @@ HttpFilterFactoryCb BufferFilterConfig::createFilterFactory(const Json::Object&
                                                             FactoryContext& context) {
   json_config.validateSchema(Json::Schema::BUFFER_HTTP_FILTER_SCHEMA);
 
+  Http::BufferSpillConfigSharedPtr spill_config;
+  if (json_config.hasObject("spill")) {
+    spill_config.reset(
+        new Http::BufferSpillConfig(*json_config.getObject("spill"), context.threadLocal()));
+  }
+
   Http::BufferFilterConfigConstSharedPtr config(new Http::BufferFilterConfig{
       Http::BufferFilter::generateStats(stats_prefix, context.scope()),
       static_cast<uint64_t>(json_config.getInteger("max_request_bytes")),
-      std::chrono::seconds(json_config.getInteger("max_request_time_s"))});
+      std::chrono::seconds(json_config.getInteger("max_request_time_s")), spill_config});
   return [config](Http::FilterChainFactoryCallbacks& callbacks) -> void {
     callbacks.addStreamDecoderFilter(
         Http::StreamDecoderFilterSharedPtr{new Http::BufferFilter(config)});
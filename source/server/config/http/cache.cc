@@ -0,0 +1,35 @@
+#include "server/config/http/cache.h"
+
+#include <string>
+
+#include "envoy/registry/registry.h"
+
+#include "common/common/utility.h"
+#include "common/http/filter/cache_filter.h"
+#include "common/json/config_schemas.h"
+
+namespace Envoy {
+namespace Server {
+namespace Configuration {
+
+HttpFilterFactoryCb CacheFilterConfig::createFilterFactory(const Json::Object& json_config,
+                                                           const std::string& stat_prefix,
+                                                           FactoryContext& context) {
+  json_config.validateSchema(Json::Schema::CACHE_HTTP_FILTER_SCHEMA);
+
+  Http::CacheFilterConfigSharedPtr config(
+      new Http::CacheFilterConfig(json_config, stat_prefix, context.scope(),
+                                  context.threadLocal(), ProdMonotonicTimeSource::instance_));
+  return [config](Http::FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addStreamFilter(Http::StreamFilterSharedPtr{new Http::CacheFilter(config)});
+  };
+}
+
+/**
+ * Static registration for the cache filter. @see RegisterFactory.
+ */
+static Registry::RegisterFactory<CacheFilterConfig, NamedHttpFilterConfigFactory> register_;
+
+} // namespace Configuration
+} // namespace Server
+} // namespace Envoy
@@ -1,5 +1,6 @@
 #include "server/config/http/dynamo.h"
 
+#include <memory>
 #include <string>
 
 #include "envoy/registry/registry.h"
@@ -13,9 +14,11 @@ namespace Configuration {
 HttpFilterFactoryCb DynamoFilterConfig::createFilterFactory(const Json::Object&,
                                                             const std::string& stat_prefix,
                                                             FactoryContext& context) {
-  return [&context, stat_prefix](Http::FilterChainFactoryCallbacks& callbacks) -> void {
-    callbacks.addStreamFilter(Http::StreamFilterSharedPtr{
-        new Dynamo::DynamoFilter(context.runtime(), stat_prefix, context.scope())});
+  Dynamo::DynamoFilterConfigSharedPtr config = std::make_shared<Dynamo::DynamoFilterConfig>(
+      stat_prefix, context.scope(), context.threadLocal());
+  return [&context, config](Http::FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addStreamFilter(
+        Http::StreamFilterSharedPtr{new Dynamo::DynamoFilter(context.runtime(), config)});
   };
 }
 
@@ -4,6 +4,7 @@
 
 #include "envoy/registry/registry.h"
 
+#include "common/common/utility.h"
 #include "common/http/filter/fault_filter.h"
 #include "common/json/config_schemas.h"
 
@@ -15,7 +16,8 @@ HttpFilterFactoryCb FaultFilterConfig::createFilterFactory(const Json::Object& j
                                                            const std::string& stats_prefix,
                                                            FactoryContext& context) {
   Http::FaultFilterConfigSharedPtr config(
-      new Http::FaultFilterConfig(json_config, context.runtime(), stats_prefix, context.scope()));
+      new Http::FaultFilterConfig(json_config, context.runtime(), stats_prefix, context.scope(),
+                                  context.threadLocal(), ProdMonotonicTimeSource::instance_));
   return [config](Http::FilterChainFactoryCallbacks& callbacks) -> void {
     callbacks.addStreamDecoderFilter(
         Http::StreamDecoderFilterSharedPtr{new Http::FaultFilter(config)});
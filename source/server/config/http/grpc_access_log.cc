@@ -0,0 +1,54 @@
+#include "server/config/http/grpc_access_log.h"
+
+#include <string>
+
+#include "envoy/registry/registry.h"
+#include "envoy/server/filter_config.h"
+
+#include "common/config/utility.h"
+#include "common/config/well_known_names.h"
+#include "common/grpc/async_client_impl.h"
+#include "common/http/access_log/access_log_service.pb.h"
+#include "common/http/access_log/grpc_access_log_impl.h"
+
+namespace Envoy {
+namespace Server {
+namespace Configuration {
+
+Http::AccessLog::InstanceSharedPtr GrpcAccessLogFactory::createAccessLogInstance(
+    const Protobuf::Message& config, Http::AccessLog::FilterPtr&& filter, FactoryContext& context) {
+  const auto& gal_config = dynamic_cast<const envoy::accesslog::GrpcAccessLogConfig&>(config);
+  const std::string cluster_name = gal_config.cluster_name();
+  Config::Utility::checkClusterAndLocalInfo("gRPC access log", cluster_name,
+                                            context.clusterManager(), context.localInfo());
+  if (gal_config.log_name().empty()) {
+    throw EnvoyException("gRPC access log requires a log_name");
+  }
+  ENVOY_LOG(info, "gRPC access log {} cluster: {}", gal_config.log_name(), cluster_name);
+
+  Upstream::ClusterManager& cluster_manager = context.clusterManager();
+  return Http::AccessLog::InstanceSharedPtr{new Http::AccessLog::GrpcAccessLog(
+      std::move(filter), gal_config,
+      [&cluster_manager, cluster_name]() -> Http::AccessLog::GrpcAccessLogAsyncClientPtr {
+        return Http::AccessLog::GrpcAccessLogAsyncClientPtr{
+            new Grpc::AsyncClientImpl<envoy::accesslog::StreamAccessLogsMessage,
+                                      envoy::accesslog::StreamAccessLogsResponse>(cluster_manager,
+                                                                                 cluster_name)};
+      },
+      context.threadLocal(), context.scope(), context.localInfo())};
+}
+
+ProtobufTypes::MessagePtr GrpcAccessLogFactory::createEmptyConfigProto() {
+  return ProtobufTypes::MessagePtr{new envoy::accesslog::GrpcAccessLogConfig()};
+}
+
+std::string GrpcAccessLogFactory::name() const { return Config::AccessLogNames::get().GRPC; }
+
+/**
+ * Static registration for the gRPC access log. @see RegisterFactory.
+ */
+static Registry::RegisterFactory<GrpcAccessLogFactory, AccessLogInstanceFactory> register_;
+
+} // namespace Configuration
+} // namespace Server
+} // namespace Envoy
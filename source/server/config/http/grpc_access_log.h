@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+#include "envoy/server/access_log_config.h"
+
+#include "common/common/logger.h"
+
+namespace Envoy {
+namespace Server {
+namespace Configuration {
+
+/**
+ * Config registration for the gRPC access log. @see AccessLogInstanceFactory.
+ */
+class GrpcAccessLogFactory : Logger::Loggable<Logger::Id::config>,
+                             public AccessLogInstanceFactory {
+public:
+  Http::AccessLog::InstanceSharedPtr createAccessLogInstance(const Protobuf::Message& config,
+                                                             Http::AccessLog::FilterPtr&& filter,
+                                                             FactoryContext& context) override;
+
+  ProtobufTypes::MessagePtr createEmptyConfigProto() override;
+
+  std::string name() const override;
+};
+
+} // namespace Configuration
+} // namespace Server
+} // namespace Envoy
@@ -0,0 +1,35 @@
+#include "server/config/http/gzip.h"
+
+#include <string>
+
+#include "envoy/registry/registry.h"
+
+#include "common/common/utility.h"
+#include "common/http/filter/gzip_filter.h"
+#include "common/json/config_schemas.h"
+
+namespace Envoy {
+namespace Server {
+namespace Configuration {
+
+HttpFilterFactoryCb GzipFilterConfig::createFilterFactory(const Json::Object& json_config,
+                                                           const std::string& stat_prefix,
+                                                           FactoryContext& context) {
+  json_config.validateSchema(Json::Schema::GZIP_HTTP_FILTER_SCHEMA);
+
+  Http::GzipFilterConfigSharedPtr config(
+      new Http::GzipFilterConfig(json_config, stat_prefix, context.scope(),
+                                 context.threadLocal(), ProdMonotonicTimeSource::instance_));
+  return [config](Http::FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addStreamFilter(Http::StreamFilterSharedPtr{new Http::GzipFilter(config)});
+  };
+}
+
+/**
+ * Static registration for the gzip filter. @see RegisterFactory.
+ */
+static Registry::RegisterFactory<GzipFilterConfig, NamedHttpFilterConfigFactory> register_;
+
+} // namespace Configuration
+} // namespace Server
+} // namespace Envoy
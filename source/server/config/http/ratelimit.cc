@@ -5,7 +5,10 @@
 
 #include "envoy/registry/registry.h"
 
+#include "common/common/utility.h"
 #include "common/http/filter/ratelimit.h"
+#include "common/ratelimit/coalescing_ratelimit_impl.h"
+#include "common/ratelimit/local_ratelimit_impl.h"
 
 namespace Envoy {
 namespace Server {
@@ -17,10 +20,35 @@ HttpFilterFactoryCb RateLimitFilterConfig::createFilterFactory(const Json::Objec
   Http::RateLimit::FilterConfigSharedPtr filter_config(new Http::RateLimit::FilterConfig(
       config, context.localInfo(), context.scope(), context.runtime(), context.clusterManager()));
   const uint32_t timeout_ms = config.getInteger("timeout_ms", 20);
-  return [filter_config, timeout_ms,
-          &context](Http::FilterChainFactoryCallbacks& callbacks) -> void {
-    callbacks.addStreamDecoderFilter(Http::StreamDecoderFilterSharedPtr{new Http::RateLimit::Filter(
-        filter_config, context.rateLimitClient(std::chrono::milliseconds(timeout_ms)))});
+
+  Envoy::RateLimit::ClientCreateCb client = [timeout_ms, &context]() {
+    return context.rateLimitClient(std::chrono::milliseconds(timeout_ms));
+  };
+
+  if (config.hasObject("coalesce")) {
+    Envoy::RateLimit::CoalescingFactoryImplSharedPtr coalescing_factory{
+        new Envoy::RateLimit::CoalescingFactoryImpl(*config.getObject("coalesce"),
+                                                   context.threadLocal(),
+                                                   ProdMonotonicTimeSource::instance_, client)};
+    client = [coalescing_factory]() {
+      return coalescing_factory->create(Optional<std::chrono::milliseconds>());
+    };
+  }
+
+  if (config.hasObject("local")) {
+    // The filter only calls the local client, which checks with the global rate limit service in
+    // the background if the global sync is enabled.
+    Envoy::RateLimit::LocalFactoryImplSharedPtr local_factory{
+        new Envoy::RateLimit::LocalFactoryImpl(*config.getObject("local"), context.threadLocal(),
+                                              ProdMonotonicTimeSource::instance_, client)};
+    client = [local_factory]() {
+      return local_factory->create(Optional<std::chrono::milliseconds>());
+    };
+  }
+
+  return [filter_config, client](Http::FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addStreamDecoderFilter(
+        Http::StreamDecoderFilterSharedPtr{new Http::RateLimit::Filter(filter_config, client())});
   };
 }
 
@@ -20,8 +20,10 @@ HttpFilterFactoryCb RouterFilterConfig::createFilterFactory(const Json::Object&
   Router::FilterConfigSharedPtr config(new Router::FilterConfig(
       stat_prefix, context.localInfo(), context.scope(), context.clusterManager(),
       context.runtime(), context.random(),
-      Router::ShadowWriterPtr{new Router::ShadowWriterImpl(context.clusterManager())},
-      json_config.getBoolean("dynamic_stats", true)));
+      Router::ShadowWriterPtr{new Router::ShadowWriterImpl(
+          context.clusterManager(), json_config.getInteger("max_shadow_bytes_in_flight", 0))},
+      json_config.getBoolean("dynamic_stats", true),
+      json_config.getInteger("retry_buffer_limit_bytes", 0)));
 
   return [config](Http::FilterChainFactoryCallbacks& callbacks) -> void {
     callbacks.addStreamDecoderFilter(std::make_shared<Router::ProdFilter>(*config));
@@ -1,6 +1,8 @@
 #include "server/config/network/http_connection_manager.h"
 
+#include <algorithm>
 #include <chrono>
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
@@ -30,6 +32,9 @@ namespace Server {
 namespace Configuration {
 
 const std::string HttpConnectionManagerConfig::DEFAULT_SERVER_STRING = "envoy";
+const uint64_t HttpConnectionManagerConfig::MAX_REQUEST_HEADERS_KB;
+const std::string HttpConnectionManagerConfig::FILTER_TIMING_SAMPLE_KEY =
+    "http.filter_timing.sample_one_in";
 
 // Singleton registration via macro defined in envoy/singleton/manager.h
 SINGLETON_MANAGER_REGISTRATION(date_provider);
@@ -48,12 +53,7 @@ NetworkFilterFactoryCb createHttpConnectionManagerFilterFactory(
           });
 
   std::shared_ptr<Router::RouteConfigProviderManager> route_config_provider_manager =
-      context.singletonManager().getTyped<Router::RouteConfigProviderManager>(
-          SINGLETON_MANAGER_REGISTERED_NAME(route_config_provider_manager), [&context] {
-            return std::make_shared<Router::RouteConfigProviderManagerImpl>(
-                context.runtime(), context.dispatcher(), context.random(), context.localInfo(),
-                context.threadLocal(), context.admin());
-          });
+      HttpConnectionManagerFilterConfigFactory::routeConfigProviderManager(context);
 
   std::shared_ptr<HttpConnectionManagerConfig> http_config(new HttpConnectionManagerConfig(
       http_connection_manager, context, *date_provider, *route_config_provider_manager));
@@ -65,7 +65,8 @@ NetworkFilterFactoryCb createHttpConnectionManagerFilterFactory(
           date_provider](Network::FilterManager& filter_manager) -> void {
     filter_manager.addReadFilter(Network::ReadFilterSharedPtr{new Http::ConnectionManagerImpl(
         *http_config, context.drainDecision(), context.random(), context.httpTracer(),
-        context.runtime(), context.localInfo(), context.clusterManager())});
+        context.runtime(), context.localInfo(), context.clusterManager(),
+        &context.overloadManager())});
   };
 }
 
@@ -85,6 +86,16 @@ NetworkFilterFactoryCb HttpConnectionManagerFilterConfigFactory::createFilterFac
       dynamic_cast<const envoy::api::v2::filter::HttpConnectionManager&>(config), context);
 }
 
+std::shared_ptr<Router::RouteConfigProviderManagerImpl>
+HttpConnectionManagerFilterConfigFactory::routeConfigProviderManager(FactoryContext& context) {
+  return context.singletonManager().getTyped<Router::RouteConfigProviderManagerImpl>(
+      SINGLETON_MANAGER_REGISTERED_NAME(route_config_provider_manager), [&context] {
+        return std::make_shared<Router::RouteConfigProviderManagerImpl>(
+            context.runtime(), context.dispatcher(), context.random(), context.localInfo(),
+            context.threadLocal(), context.admin());
+      });
+}
+
 /**
  * Static registration for the HTTP connection manager filter.
  */
@@ -114,19 +125,38 @@ HttpConnectionManagerConfig::HttpConnectionManagerConfig(
     const envoy::api::v2::filter::HttpConnectionManager& config, FactoryContext& context,
     Http::DateProvider& date_provider,
     Router::RouteConfigProviderManager& route_config_provider_manager)
-    : context_(context), stats_prefix_(fmt::format("http.{}.", config.stat_prefix())),
+    : context_(context),
+      filter_timing_sample_(context_.runtime().featureHandle(FILTER_TIMING_SAMPLE_KEY)),
+      stats_prefix_(fmt::format("http.{}.", config.stat_prefix())),
       stats_(Http::ConnectionManagerImpl::generateStats(stats_prefix_, context_.scope())),
       tracing_stats_(
           Http::ConnectionManagerImpl::generateTracingStats(stats_prefix_, context_.scope())),
       use_remote_address_(PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, use_remote_address, false)),
       route_config_provider_manager_(route_config_provider_manager),
-      http2_settings_(Http::Utility::parseHttp2Settings(config.http2_protocol_options())),
+      http2_settings_(Http::Utility::parseHttp2Settings(config.http2_protocol_options(),
+                                                        context_.runtime(), stats_prefix_)),
       http1_settings_(Http::Utility::parseHttp1Settings(config.http_protocol_options())),
       drain_timeout_(PROTOBUF_GET_MS_OR_DEFAULT(config, drain_timeout, 5000)),
       generate_request_id_(PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, generate_request_id, true)),
 
       date_provider_(date_provider) {
 
+  // The limits on request headers are not in the config yet, so they are read from runtime.
+  const uint32_t max_request_headers_kb = std::max<uint64_t>(
+      1, std::min<uint64_t>(context_.runtime().snapshot().getInteger(
+                                stats_prefix_ + "max_request_headers_kb",
+                                Http::DEFAULT_MAX_REQUEST_HEADERS_KB),
+                            MAX_REQUEST_HEADERS_KB));
+  const uint32_t max_request_headers_count = std::max<uint64_t>(
+      1, std::min<uint64_t>(context_.runtime().snapshot().getInteger(
+                                stats_prefix_ + "max_request_headers_count",
+                                Http::DEFAULT_MAX_REQUEST_HEADERS_COUNT),
+                            std::numeric_limits<uint32_t>::max()));
+  http1_settings_.max_request_headers_kb_ = max_request_headers_kb;
+  http1_settings_.max_request_headers_count_ = max_request_headers_count;
+  http2_settings_.max_request_headers_kb_ = max_request_headers_kb;
+  http2_settings_.max_request_headers_count_ = max_request_headers_count;
+
   route_config_provider_ = Router::RouteConfigProviderUtil::create(
       config, context_.runtime(), context_.clusterManager(), context_.scope(), stats_prefix_,
       context_.initManager(), route_config_provider_manager_);
@@ -192,9 +222,11 @@ HttpConnectionManagerConfig::HttpConnectionManagerConfig(
     idle_timeout_.value(std::chrono::milliseconds(PROTOBUF_GET_MS_REQUIRED(config, idle_timeout)));
   }
 
+  // Logs with the same filter evaluate it once per request.
+  Http::AccessLog::FilterCache filter_cache;
   for (const auto& access_log : config.access_log()) {
     Http::AccessLog::InstanceSharedPtr current_access_log =
-        Http::AccessLog::AccessLogFactory::fromProto(access_log, context_);
+        Http::AccessLog::AccessLogFactory::fromProto(access_log, context_, filter_cache);
     access_logs_.push_back(current_access_log);
   }
 
@@ -240,7 +272,9 @@ HttpConnectionManagerConfig::HttpConnectionManagerConfig(
           Config::Utility::translateToFactoryConfig(proto_config, factory);
       callback = factory.createFilterFactoryFromProto(*message, stats_prefix_, context);
     }
-    filter_factories_.push_back(callback);
+    filter_factories_.push_back(
+        {callback, Http::FilterTimingStatsPtr{new Http::FilterTimingStats(
+                       context_.scope(), stats_prefix_, string_name)}});
   }
 }
 
@@ -248,10 +282,17 @@ Http::ServerConnectionPtr
 HttpConnectionManagerConfig::createCodec(Network::Connection& connection,
                                          const Buffer::Instance& data,
                                          Http::ServerConnectionCallbacks& callbacks) {
+  // The connection manager gets the depth from the codec, so the runtime key is read once.
+  Http::Http1Settings http1_settings = http1_settings_;
+  http1_settings.max_pipeline_depth_ = std::max<uint64_t>(
+      1, std::min<uint64_t>(context_.runtime().snapshot().getInteger(
+                                Http::ConnectionManagerImpl::MAX_PIPELINE_DEPTH_KEY, 1),
+                            Http::ConnectionManagerImpl::MAX_PIPELINE_DEPTH));
+
   switch (codec_type_) {
   case CodecType::HTTP1:
     return Http::ServerConnectionPtr{
-        new Http::Http1::ServerConnectionImpl(connection, callbacks, http1_settings_)};
+        new Http::Http1::ServerConnectionImpl(connection, callbacks, http1_settings)};
   case CodecType::HTTP2:
     return Http::ServerConnectionPtr{new Http::Http2::ServerConnectionImpl(
         connection, callbacks, context_.scope(), http2_settings_)};
@@ -262,7 +303,7 @@ HttpConnectionManagerConfig::createCodec(Network::Connection& connection,
           connection, callbacks, context_.scope(), http2_settings_)};
     } else {
       return Http::ServerConnectionPtr{
-          new Http::Http1::ServerConnectionImpl(connection, callbacks, http1_settings_)};
+          new Http::Http1::ServerConnectionImpl(connection, callbacks, http1_settings)};
     }
   }
 
@@ -270,8 +311,18 @@ HttpConnectionManagerConfig::createCodec(Network::Connection& connection,
 }
 
 void HttpConnectionManagerConfig::createFilterChain(Http::FilterChainFactoryCallbacks& callbacks) {
-  for (const HttpFilterFactoryCb& factory : filter_factories_) {
-    factory(callbacks);
+  // Only a sample of the streams is timed, so that the others do not pay for the clock reads.
+  const uint64_t sample_one_in = filter_timing_sample_->getInteger(0);
+  if (sample_one_in == 0 || context_.random().random() % sample_one_in != 0) {
+    for (const FilterFactory& factory : filter_factories_) {
+      factory.cb_(callbacks);
+    }
+    return;
+  }
+
+  for (const FilterFactory& factory : filter_factories_) {
+    Http::TimedFilterChainFactoryCallbacks timed_callbacks(callbacks, *factory.timing_stats_);
+    factory.cb_(timed_callbacks);
   }
 }
 
@@ -13,7 +13,9 @@
 #include "common/common/logger.h"
 #include "common/config/well_known_names.h"
 #include "common/http/conn_manager_impl.h"
+#include "common/http/filter_timing.h"
 #include "common/json/json_loader.h"
+#include "common/router/rds_impl.h"
 
 namespace Envoy {
 namespace Server {
@@ -36,6 +38,13 @@ public:
         new envoy::api::v2::filter::HttpConnectionManager());
   }
   std::string name() override { return Config::NetworkFilterNames::get().HTTP_CONNECTION_MANAGER; }
+
+  /**
+   * @return the route configuration provider manager that the HTTP connection managers of a server
+   *         share, which is created the first time that it is needed.
+   */
+  static std::shared_ptr<Router::RouteConfigProviderManagerImpl>
+  routeConfigProviderManager(FactoryContext& context);
 };
 
 /**
@@ -78,6 +87,7 @@ public:
   FilterChainFactory& filterFactory() override { return *this; }
   bool generateRequestId() override { return generate_request_id_; }
   const Optional<std::chrono::milliseconds>& idleTimeout() override { return idle_timeout_; }
+  uint32_t maxRequestHeadersKb() override { return http1_settings_.max_request_headers_kb_; }
   Router::RouteConfigProvider& routeConfigProvider() override { return *route_config_provider_; }
   const std::string& serverName() override { return server_name_; }
   Http::ConnectionManagerStats& stats() override { return stats_; }
@@ -95,11 +105,23 @@ public:
 
   static const std::string DEFAULT_SERVER_STRING;
 
+  // Runtime key for timing the filters of one in this many streams. 0, the default, disables the
+  // timing. @see Http::FilterTimingStats.
+  static const std::string FILTER_TIMING_SAMPLE_KEY;
+  // The largest limit on the size of request headers. http_parser rejects larger headers anyway.
+  static const uint64_t MAX_REQUEST_HEADERS_KB = 80;
+
 private:
   enum class CodecType { HTTP1, HTTP2, AUTO };
 
+  struct FilterFactory {
+    HttpFilterFactoryCb cb_;
+    Http::FilterTimingStatsPtr timing_stats_;
+  };
+
   FactoryContext& context_;
-  std::list<HttpFilterFactoryCb> filter_factories_;
+  std::list<FilterFactory> filter_factories_;
+  Runtime::FeatureHandleSharedPtr filter_timing_sample_;
   std::list<Http::AccessLog::InstanceSharedPtr> access_logs_;
   const std::string stats_prefix_;
   Http::ConnectionManagerStats stats_;
@@ -109,8 +131,8 @@ private:
   std::vector<Http::ClientCertDetailsType> set_current_client_cert_details_;
   Router::RouteConfigProviderManager& route_config_provider_manager_;
   CodecType codec_type_;
-  const Http::Http2Settings http2_settings_;
-  const Http::Http1Settings http1_settings_;
+  Http::Http2Settings http2_settings_;
+  Http::Http1Settings http1_settings_;
   std::string server_name_;
   Http::TracingConnectionManagerConfigPtr tracing_config_;
   Optional<std::string> user_agent_;
@@ -25,7 +25,8 @@ RedisProxyFilterConfigFactory::createFilterFactory(const Json::Object& config,
                                         context.threadLocal(), *config.getObject("conn_pool")));
   std::shared_ptr<Redis::CommandSplitter::Instance> splitter(
       new Redis::CommandSplitter::InstanceImpl(std::move(conn_pool), context.scope(),
-                                               filter_config->statPrefix()));
+                                               filter_config->statPrefix(), context.threadLocal(),
+                                               filter_config->hotKeyCacheConfig()));
   return [splitter, filter_config](Network::FilterManager& filter_manager) -> void {
     Redis::DecoderFactoryImpl factory;
     filter_manager.addReadFilter(std::make_shared<Redis::ProxyFilter>(
@@ -0,0 +1,49 @@
+#include "server/config/stats/metrics_service.h"
+
+#include <string>
+
+#include "envoy/registry/registry.h"
+
+#include "common/config/utility.h"
+#include "common/config/well_known_names.h"
+#include "common/grpc/async_client_impl.h"
+#include "common/stats/metrics_service.pb.h"
+#include "common/stats/metrics_service_sink.h"
+
+namespace Envoy {
+namespace Server {
+namespace Configuration {
+
+Stats::SinkPtr MetricsServiceSinkFactory::createStatsSink(const Protobuf::Message& config,
+                                                          Server::Instance& server) {
+  const auto& sink_config = dynamic_cast<const envoy::metrics::MetricsServiceSinkConfig&>(config);
+  const std::string& cluster_name = sink_config.cluster_name();
+  Config::Utility::checkClusterAndLocalInfo("metrics service", cluster_name,
+                                            server.clusterManager(), server.localInfo());
+  ENVOY_LOG(info, "metrics service cluster: {}", cluster_name);
+
+  return Stats::SinkPtr(new Stats::Metrics::MetricsServiceSink(
+      Stats::Metrics::GrpcMetricsAsyncClientPtr{
+          new Grpc::AsyncClientImpl<envoy::metrics::StreamMetricsMessage,
+                                    envoy::metrics::StreamMetricsResponse>(server.clusterManager(),
+                                                                           cluster_name)},
+      server.localInfo()));
+}
+
+ProtobufTypes::MessagePtr MetricsServiceSinkFactory::createEmptyConfigProto() {
+  return std::unique_ptr<envoy::metrics::MetricsServiceSinkConfig>(
+      new envoy::metrics::MetricsServiceSinkConfig());
+}
+
+std::string MetricsServiceSinkFactory::name() {
+  return Config::StatsSinkNames::get().METRICS_SERVICE;
+}
+
+/**
+ * Static registration for the metrics service sink factory. @see RegisterFactory.
+ */
+static Registry::RegisterFactory<MetricsServiceSinkFactory, StatsSinkFactory> register_;
+
+} // namespace Configuration
+} // namespace Server
+} // namespace Envoy
@@ -6,7 +6,7 @@ namespace Envoy {
 namespace Api {
 
 ValidationImpl::ValidationImpl(std::chrono::milliseconds file_flush_interval_msec)
-    : Impl(file_flush_interval_msec) {}
+    : Impl(file_flush_interval_msec, Event::DispatcherImpl::DEFAULT_CONNECTION_READ_BUDGET, "") {}
 
 Event::DispatcherPtr ValidationImpl::allocateDispatcher() {
   return Event::DispatcherPtr{new Event::ValidationDispatcher()};
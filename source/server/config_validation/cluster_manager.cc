@@ -1,15 +1,18 @@
 #include "server/config_validation/cluster_manager.h"
 
+#include "common/common/empty_string.h"
+
 namespace Envoy {
 namespace Upstream {
 
+// Validation neither reads nor writes the xDS cache.
 ValidationClusterManagerFactory::ValidationClusterManagerFactory(
     Runtime::Loader& runtime, Stats::Store& stats, ThreadLocal::Instance& tls,
     Runtime::RandomGenerator& random, Network::DnsResolverSharedPtr dns_resolver,
     Ssl::ContextManager& ssl_context_manager, Event::Dispatcher& primary_dispatcher,
     const LocalInfo::LocalInfo& local_info)
     : ProdClusterManagerFactory(runtime, stats, tls, random, dns_resolver, ssl_context_manager,
-                                primary_dispatcher, local_info) {}
+                                primary_dispatcher, local_info, EMPTY_STRING) {}
 
 ClusterManagerPtr ValidationClusterManagerFactory::clusterManagerFromProto(
     const envoy::api::v2::Bootstrap& bootstrap, Stats::Store& stats, ThreadLocal::Instance& tls,
@@ -2,13 +2,18 @@
 
 #include "common/common/version.h"
 #include "common/config/bootstrap_json.h"
+#include "common/config/filter_json.h"
+#include "common/config/well_known_names.h"
+#include "common/json/json_loader.h"
 #include "common/local_info/local_info_impl.h"
 #include "common/protobuf/utility.h"
 #include "common/singleton/manager_impl.h"
 
+#include "server/config/network/http_connection_manager.h"
 #include "server/configuration_impl.h"
 
 #include "api/bootstrap.pb.h"
+#include "api/filter/http_connection_manager.pb.h"
 
 namespace Envoy {
 namespace Server {
@@ -36,7 +41,11 @@ ValidationInstance::ValidationInstance(Options& options,
                                        ComponentFactory& component_factory)
     : options_(options), stats_store_(store),
       api_(new Api::ValidationImpl(options.fileFlushIntervalMsec())),
-      dispatcher_(api_->allocateDispatcher()), singleton_manager_(new Singleton::ManagerImpl()),
+      dispatcher_(api_->allocateDispatcher()),
+      overload_manager_(new OverloadManagerImpl(
+          *dispatcher_, store, options.overloadConfig(),
+          []() -> OverloadResourceUsage { return {0, 0, 0}; })),
+      singleton_manager_(new Singleton::ManagerImpl()),
       access_log_manager_(*api_, *dispatcher_, access_log_lock, store),
       listener_manager_(*this, *this, *this) {
   try {
@@ -87,14 +96,68 @@ void ValidationInstance::initialize(Options& options,
       runtime(), stats(), threadLocal(), random(), dnsResolver(), sslContextManager(), dispatcher(),
       localInfo()));
 
+  collectStaticRouteConfigs(bootstrap);
   Configuration::MainImpl* main_config = new Configuration::MainImpl();
   config_.reset(main_config);
   main_config->initialize(bootstrap, *this, *cluster_manager_factory_);
+  // The listeners now hold the route configurations that they use.
+  compiled_route_configs_.clear();
 
   clusterManager().setInitializedCb(
       [this]() -> void { init_manager_.initialize([]() -> void {}); });
 }
 
+void ValidationInstance::collectStaticRouteConfigs(const envoy::api::v2::Bootstrap& bootstrap) {
+  for (const auto& listener : bootstrap.static_resources().listeners()) {
+    for (const auto& filter_chain : listener.filter_chains()) {
+      for (const auto& filter : filter_chain.filters()) {
+        if (filter.name() != Config::NetworkFilterNames::get().HTTP_CONNECTION_MANAGER) {
+          continue;
+        }
+        // A filter whose config is invalid is reported, with its error, once its listener is
+        // created.
+        envoy::api::v2::filter::HttpConnectionManager http_connection_manager;
+        try {
+          const Json::ObjectSharedPtr filter_config =
+              MessageUtil::getJsonObjectFromMessage(filter.config());
+          if (filter_config->getBoolean("deprecated_v1", false)) {
+            Config::FilterJson::translateHttpConnectionManager(
+                *filter_config->getObject("value", true), http_connection_manager);
+          } else {
+            MessageUtil::jsonConvert(filter.config(), http_connection_manager);
+          }
+        } catch (const EnvoyException&) {
+          continue;
+        }
+        if (http_connection_manager.has_route_config()) {
+          static_route_configs_.push_back(http_connection_manager.route_config());
+        }
+      }
+    }
+  }
+}
+
+std::vector<Configuration::NetworkFilterFactoryCb> ValidationInstance::createFilterFactoryList(
+    const Protobuf::RepeatedPtrField<envoy::api::v2::Filter>& filters,
+    Configuration::FactoryContext& context) {
+  if (!static_route_configs_.empty()) {
+    // Route tables are the bulk of large configurations. They don't depend on each other, so they
+    // are all compiled on several threads at once before the first listener is created. The
+    // cluster manager exists by now, and the clusters of each table are still validated on the
+    // main thread when its listener is created.
+    std::vector<envoy::api::v2::RouteConfiguration> route_configs;
+    route_configs.swap(static_route_configs_);
+    compiled_route_configs_ =
+        Configuration::HttpConnectionManagerFilterConfigFactory::routeConfigProviderManager(
+            context)
+            ->precompileStaticRouteConfigs(route_configs, context.runtime(),
+                                           context.clusterManager(), options_.concurrency());
+    ENVOY_LOG(debug, "compiled {} of {} static route configuration(s) on up to {} thread(s)",
+              compiled_route_configs_.size(), route_configs.size(), options_.concurrency());
+  }
+  return ProdListenerComponentFactory::createFilterFactoryList_(filters, context);
+}
+
 void ValidationInstance::shutdown() {
   // This normally happens at the bottom of InstanceImpl::run(), but we don't have a run(). We can
   // do an abbreviated shutdown here since there's less to clean up -- for example, no workers to
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <vector>
 
 #include "envoy/common/optional.h"
 #include "envoy/server/drain_manager.h"
@@ -22,8 +23,11 @@
 #include "server/config_validation/dns.h"
 #include "server/http/admin.h"
 #include "server/listener_manager_impl.h"
+#include "server/overload_manager_impl.h"
 #include "server/server.h"
 
+#include "api/bootstrap.pb.h"
+
 namespace Envoy {
 namespace Server {
 
@@ -81,6 +85,7 @@ public:
   Singleton::Manager& singletonManager() override { return *singleton_manager_; }
   bool healthCheckFailed() override { NOT_IMPLEMENTED; }
   Options& options() override { return options_; }
+  OverloadManager& overloadManager() override { return *overload_manager_; }
   time_t startTimeCurrentEpoch() override { NOT_IMPLEMENTED; }
   time_t startTimeFirstEpoch() override { NOT_IMPLEMENTED; }
   Stats::Store& stats() override { return stats_store_; }
@@ -91,15 +96,17 @@ public:
   // Server::ListenerComponentFactory
   std::vector<Configuration::NetworkFilterFactoryCb>
   createFilterFactoryList(const Protobuf::RepeatedPtrField<envoy::api::v2::Filter>& filters,
-                          Configuration::FactoryContext& context) override {
-    return ProdListenerComponentFactory::createFilterFactoryList_(filters, context);
-  }
+                          Configuration::FactoryContext& context) override;
   Network::ListenSocketSharedPtr createListenSocket(Network::Address::InstanceConstSharedPtr,
                                                     bool) override {
     // Returned sockets are not currently used so we can return nothing here safely vs. a
     // validation mock.
     return nullptr;
   }
+  Network::ListenSocketSharedPtr
+  createReusePortListenSocket(Network::Address::InstanceConstSharedPtr, uint32_t) override {
+    return nullptr;
+  }
   DrainManagerPtr createDrainManager() override { return nullptr; }
   uint64_t nextListenerTag() override { return 0; }
 
@@ -113,12 +120,15 @@ public:
 private:
   void initialize(Options& options, Network::Address::InstanceConstSharedPtr local_address,
                   ComponentFactory& component_factory);
+  void collectStaticRouteConfigs(const envoy::api::v2::Bootstrap& bootstrap);
 
   Options& options_;
   Stats::IsolatedStoreImpl& stats_store_;
   ThreadLocal::InstanceImpl thread_local_;
   Api::ApiPtr api_;
   Event::DispatcherPtr dispatcher_;
+  // Never started, since the validation server does not serve.
+  std::unique_ptr<OverloadManagerImpl> overload_manager_;
   Server::ValidationAdmin admin_;
   Singleton::ManagerPtr singleton_manager_;
   Runtime::LoaderPtr runtime_loader_;
@@ -131,6 +141,11 @@ private:
   std::unique_ptr<Upstream::ValidationClusterManagerFactory> cluster_manager_factory_;
   InitManagerImpl init_manager_;
   ListenerManagerImpl listener_manager_;
+  // The route configurations of the static listeners, which are compiled in parallel before the
+  // first listener is created. The compiled configurations are kept until all of the static
+  // listeners have been created.
+  std::vector<envoy::api::v2::RouteConfiguration> static_route_configs_;
+  std::vector<Router::ConfigConstSharedPtr> compiled_route_configs_;
 };
 
 } // namespace Server
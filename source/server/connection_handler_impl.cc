@@ -1,5 +1,9 @@
 #include "server/connection_handler_impl.h"
 
+#include <unistd.h>
+
+#include <algorithm>
+
 #include "envoy/event/dispatcher.h"
 #include "envoy/event/timer.h"
 #include "envoy/network/filter.h"
@@ -10,12 +14,32 @@ namespace Server {
 ConnectionHandlerImpl::ConnectionHandlerImpl(spdlog::logger& logger, Event::Dispatcher& dispatcher)
     : logger_(logger), dispatcher_(dispatcher) {}
 
+ConnectionHandlerImpl::ConnectionHandlerImpl(spdlog::logger& logger, Event::Dispatcher& dispatcher,
+                                             Stats::Scope& scope, ConnectionBalancerImpl* balancer)
+    : logger_(logger), dispatcher_(dispatcher),
+      stats_(new ConnectionHandlerStats{
+          ALL_CONNECTION_HANDLER_STATS(POOL_COUNTER(scope), POOL_GAUGE(scope))}),
+      balancer_(balancer) {
+  if (balancer_) {
+    balancer_->registerHandler(*this);
+  }
+}
+
+ConnectionHandlerImpl::~ConnectionHandlerImpl() {
+  if (balancer_) {
+    balancer_->unregisterHandler(*this);
+  }
+}
+
 void ConnectionHandlerImpl::addListener(Network::FilterChainFactory& factory,
                                         Network::ListenSocket& socket, Stats::Scope& scope,
                                         uint64_t listener_tag,
                                         const Network::ListenerOptions& listener_options) {
   ActiveListenerPtr l(
       new ActiveListener(*this, socket, factory, scope, listener_tag, listener_options));
+  if (listeners_disabled_) {
+    l->listener_->disable();
+  }
   listeners_.emplace_back(socket.localAddress(), std::move(l));
 }
 
@@ -26,13 +50,49 @@ void ConnectionHandlerImpl::addSslListener(Network::FilterChainFactory& factory,
                                            const Network::ListenerOptions& listener_options) {
   ActiveListenerPtr l(new SslActiveListener(*this, ssl_ctx, socket, factory, scope, listener_tag,
                                             listener_options));
+  if (listeners_disabled_) {
+    l->listener_->disable();
+  }
   listeners_.emplace_back(socket.localAddress(), std::move(l));
 }
 
 void ConnectionHandlerImpl::removeListeners(uint64_t listener_tag) {
   for (auto listener = listeners_.begin(); listener != listeners_.end();) {
     if (listener->second->listener_tag_ == listener_tag) {
-      listener = listeners_.erase(listener);
+      listener = eraseListener(listener);
+    } else {
+      ++listener;
+    }
+  }
+}
+
+void ConnectionHandlerImpl::retireListeners(uint64_t listener_tag,
+                                            std::function<void()> completion) {
+  for (auto& listener : listeners_) {
+    if (listener.second->listener_tag_ == listener_tag) {
+      listener.second->listener_.reset();
+      listener.second->retired_completion_ = completion;
+    }
+  }
+  removeIdleRetiredListeners(listener_tag);
+}
+
+ConnectionHandlerImpl::ListenerList::iterator
+ConnectionHandlerImpl::eraseListener(ListenerList::iterator listener) {
+  std::function<void()> completion = std::move(listener->second->retired_completion_);
+  listener->second->retired_completion_ = nullptr;
+  ListenerList::iterator next = listeners_.erase(listener);
+  if (completion) {
+    completion();
+  }
+  return next;
+}
+
+void ConnectionHandlerImpl::removeIdleRetiredListeners(uint64_t listener_tag) {
+  for (auto listener = listeners_.begin(); listener != listeners_.end();) {
+    if (listener->second->listener_tag_ == listener_tag &&
+        listener->second->retired_completion_ && listener->second->connections_.empty()) {
+      listener = eraseListener(listener);
     } else {
       ++listener;
     }
@@ -53,6 +113,33 @@ void ConnectionHandlerImpl::stopListeners() {
   }
 }
 
+void ConnectionHandlerImpl::disableListeners() {
+  listeners_disabled_ = true;
+  for (auto& listener : listeners_) {
+    if (listener.second->listener_) {
+      listener.second->listener_->disable();
+    }
+  }
+}
+
+void ConnectionHandlerImpl::enableListeners() {
+  listeners_disabled_ = false;
+  for (auto& listener : listeners_) {
+    if (listener.second->listener_ && !listener.second->paused_) {
+      listener.second->listener_->enable();
+    }
+  }
+}
+
+void ConnectionHandlerImpl::resumeListener(const ActiveListener* listener) {
+  for (auto& active_listener : listeners_) {
+    if (active_listener.second.get() == listener) {
+      active_listener.second->resume();
+      return;
+    }
+  }
+}
+
 void ConnectionHandlerImpl::ActiveListener::removeConnection(ActiveConnection& connection) {
   ENVOY_CONN_LOG_TO_LOGGER(parent_.logger_, info, "adding to cleanup list",
                            *connection.connection_);
@@ -60,6 +147,15 @@ void ConnectionHandlerImpl::ActiveListener::removeConnection(ActiveConnection& c
   parent_.dispatcher_.deferredDelete(std::move(removed));
   ASSERT(parent_.num_connections_ > 0);
   parent_.num_connections_--;
+
+  // The connection is still in its close callbacks, so a retired listener is removed on the next
+  // dispatcher iteration, when destroying it no longer destroys the connection under its feet.
+  if (retired_completion_ && connections_.empty()) {
+    ConnectionHandlerImpl& parent = parent_;
+    const uint64_t listener_tag = listener_tag_;
+    parent_.dispatcher_.post(
+        [&parent, listener_tag]() -> void { parent.removeIdleRetiredListeners(listener_tag); });
+  }
 }
 
 ConnectionHandlerImpl::ActiveListener::ActiveListener(
@@ -68,16 +164,24 @@ ConnectionHandlerImpl::ActiveListener::ActiveListener(
     const Network::ListenerOptions& listener_options)
     : ActiveListener(
           parent, parent.dispatcher_.createListener(parent, socket, *this, scope, listener_options),
-          factory, scope, listener_tag) {}
+          factory, scope, listener_tag, listener_options.connection_limit_) {}
 
-ConnectionHandlerImpl::ActiveListener::ActiveListener(ConnectionHandlerImpl& parent,
-                                                      Network::ListenerPtr&& listener,
-                                                      Network::FilterChainFactory& factory,
-                                                      Stats::Scope& scope, uint64_t listener_tag)
+ConnectionHandlerImpl::ActiveListener::ActiveListener(
+    ConnectionHandlerImpl& parent, Network::ListenerPtr&& listener,
+    Network::FilterChainFactory& factory, Stats::Scope& scope, uint64_t listener_tag,
+    Network::ConnectionLimitSharedPtr connection_limit)
     : parent_(parent), factory_(factory), listener_(std::move(listener)),
-      stats_(generateStats(scope)), listener_tag_(listener_tag) {}
+      stats_(generateStats(scope)), listener_tag_(listener_tag),
+      connection_limit_(connection_limit) {}
 
 ConnectionHandlerImpl::ActiveListener::~ActiveListener() {
+  // A resume that is already posted finds the listener gone.
+  if (paused_) {
+    connection_limit_->cancelPause(this);
+  }
+
+  // The connections closed below must not schedule the removal of a retired listener.
+  retired_completion_ = nullptr;
   while (!connections_.empty()) {
     connections_.front()->connection_->close(Network::ConnectionCloseType::NoFlush);
   }
@@ -92,7 +196,7 @@ ConnectionHandlerImpl::SslActiveListener::SslActiveListener(
     : ActiveListener(parent,
                      parent.dispatcher_.createSslListener(parent, ssl_ctx, socket, *this, scope,
                                                           listener_options),
-                     factory, scope, listener_tag) {}
+                     factory, scope, listener_tag, listener_options.connection_limit_) {}
 
 Network::Listener*
 ConnectionHandlerImpl::findListenerByAddress(const Network::Address::Instance& address) {
@@ -123,9 +227,85 @@ ConnectionHandlerImpl::findListenerByAddress(const Network::Address::Instance& a
   return (listener != listeners_.end()) ? listener->second->listener_.get() : nullptr;
 }
 
+void ConnectionHandlerImpl::postConnection(uint64_t listener_tag, int fd,
+                                           Network::Address::InstanceConstSharedPtr remote_address,
+                                           Network::Address::InstanceConstSharedPtr local_address,
+                                           bool using_original_dst) {
+  num_pending_connections_++;
+  dispatcher_.post([this, listener_tag, fd, remote_address, local_address,
+                    using_original_dst]() -> void {
+    num_pending_connections_--;
+    for (auto& listener : listeners_) {
+      if (listener.second->listener_tag_ == listener_tag && listener.second->listener_) {
+        listener.second->listener_->newConnection(fd, remote_address, local_address,
+                                                  using_original_dst);
+        return;
+      }
+    }
+
+    // The listener was stopped or removed on this worker in the meantime, which means that it is
+    // draining or going away on all workers.
+    ::close(fd);
+  });
+}
+
+bool ConnectionHandlerImpl::ActiveListener::onAccept(
+    int fd, Network::Address::InstanceConstSharedPtr remote_address,
+    Network::Address::InstanceConstSharedPtr local_address, bool using_original_dst) {
+  if (!parent_.balancer_ || !parent_.balancer_->balance(parent_, listener_tag_, fd, remote_address,
+                                                         local_address, using_original_dst)) {
+    return false;
+  }
+
+  if (parent_.stats_) {
+    parent_.stats_->downstream_cx_balanced_.inc();
+  }
+  return true;
+}
+
+bool ConnectionHandlerImpl::ActiveListener::canAccept() {
+  if (!connection_limit_) {
+    return true;
+  }
+
+  // The resume is posted, since the connection that falls below the limit may be released on
+  // another worker.
+  ConnectionHandlerImpl& parent = parent_;
+  const ActiveListener* listener = this;
+  if (!connection_limit_->pause(this, [&parent, listener]() -> void {
+        parent.dispatcher_.post([&parent, listener]() -> void { parent.resumeListener(listener); });
+      })) {
+    return true;
+  }
+
+  listener_->disable();
+  paused_ = true;
+  stats_.downstream_cx_overflow_.inc();
+  overflow_span_ = stats_.downstream_cx_overflow_ms_.allocateSpan();
+  return false;
+}
+
+void ConnectionHandlerImpl::ActiveListener::resume() {
+  if (!paused_) {
+    return;
+  }
+
+  paused_ = false;
+  overflow_span_->complete();
+  overflow_span_.reset();
+  if (listener_ && !parent_.listeners_disabled_) {
+    listener_->enable();
+  }
+}
+
 void ConnectionHandlerImpl::ActiveListener::onNewConnection(
     Network::ConnectionPtr&& new_connection) {
   ENVOY_CONN_LOG_TO_LOGGER(parent_.logger_, info, "new connection", *new_connection);
+  // The cap is set under overload, so that new connections push back on their peers sooner.
+  const uint32_t cap = parent_.buffer_limit_cap_;
+  if (cap > 0 && (new_connection->bufferLimit() == 0 || new_connection->bufferLimit() > cap)) {
+    new_connection->setBufferLimits(cap);
+  }
   bool empty_filter_chain = !factory_.createFilterChain(*new_connection);
 
   // If the connection is already closed, we can just let this connection immediately die.
@@ -154,11 +334,24 @@ ConnectionHandlerImpl::ActiveConnection::ActiveConnection(ActiveListener& listen
   connection_->addConnectionCallbacks(*this);
   listener_.stats_.downstream_cx_total_.inc();
   listener_.stats_.downstream_cx_active_.inc();
+  if (listener_.connection_limit_) {
+    listener_.connection_limit_->acquire();
+  }
+  if (listener_.parent_.stats_) {
+    listener_.parent_.stats_->downstream_cx_total_.inc();
+    listener_.parent_.stats_->downstream_cx_active_.inc();
+  }
 }
 
 ConnectionHandlerImpl::ActiveConnection::~ActiveConnection() {
   listener_.stats_.downstream_cx_active_.dec();
   listener_.stats_.downstream_cx_destroy_.inc();
+  if (listener_.connection_limit_) {
+    listener_.connection_limit_->release();
+  }
+  if (listener_.parent_.stats_) {
+    listener_.parent_.stats_->downstream_cx_active_.dec();
+  }
   conn_length_->complete();
 }
 
@@ -166,5 +359,85 @@ ListenerStats ConnectionHandlerImpl::generateStats(Stats::Scope& scope) {
   return {ALL_LISTENER_STATS(POOL_COUNTER(scope), POOL_GAUGE(scope), POOL_TIMER(scope))};
 }
 
+void ConnectionLimitImpl::release() {
+  ASSERT(active_connections_ > 0);
+  active_connections_--;
+  if (num_paused_ == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  if (active_connections_ >= max_connections_) {
+    return;
+  }
+
+  // Workers cancel their pause before they go away, so holding the lock while resuming keeps them
+  // alive until the resume is posted to their dispatcher.
+  for (const auto& paused : paused_) {
+    paused.second();
+  }
+  paused_.clear();
+  num_paused_ = 0;
+}
+
+bool ConnectionLimitImpl::pause(const void* key, std::function<void()> resume_cb) {
+  if (active_connections_ < max_connections_) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  paused_[key] = resume_cb;
+  num_paused_ = paused_.size();
+  // A connection released since the check above did not see the pause, and one released from now
+  // on does, so checking again ensures that the worker is not left paused below the limit.
+  if (active_connections_ < max_connections_) {
+    paused_.erase(key);
+    num_paused_ = paused_.size();
+    return false;
+  }
+  return true;
+}
+
+void ConnectionLimitImpl::cancelPause(const void* key) {
+  std::lock_guard<std::mutex> guard(lock_);
+  paused_.erase(key);
+  num_paused_ = paused_.size();
+}
+
+void ConnectionBalancerImpl::registerHandler(ConnectionHandlerImpl& handler) {
+  std::lock_guard<std::mutex> guard(lock_);
+  handlers_.push_back(&handler);
+}
+
+void ConnectionBalancerImpl::unregisterHandler(ConnectionHandlerImpl& handler) {
+  std::lock_guard<std::mutex> guard(lock_);
+  handlers_.erase(std::remove(handlers_.begin(), handlers_.end(), &handler), handlers_.end());
+}
+
+bool ConnectionBalancerImpl::balance(ConnectionHandlerImpl& handler, uint64_t listener_tag, int fd,
+                                     Network::Address::InstanceConstSharedPtr remote_address,
+                                     Network::Address::InstanceConstSharedPtr local_address,
+                                     bool using_original_dst) {
+  // Handlers unregister before they are destroyed, so holding the lock while posting to the
+  // target keeps it alive until the connection is queued on its dispatcher.
+  std::lock_guard<std::mutex> guard(lock_);
+  ConnectionHandlerImpl* target = &handler;
+  uint64_t target_load = handler.load();
+  for (ConnectionHandlerImpl* candidate : handlers_) {
+    const uint64_t load = candidate->load();
+    if (load < target_load) {
+      target = candidate;
+      target_load = load;
+    }
+  }
+
+  if (target == &handler) {
+    return false;
+  }
+
+  target->postConnection(listener_tag, fd, remote_address, local_address, using_original_dst);
+  return true;
+}
+
 } // namespace Server
 } // namespace Envoy
@@ -2,8 +2,12 @@
 
 #include <atomic>
 #include <cstdint>
+#include <functional>
 #include <list>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "envoy/common/time.h"
 #include "envoy/event/deferred_deletable.h"
@@ -26,7 +30,9 @@ namespace Server {
   COUNTER(downstream_cx_total)                                                                     \
   COUNTER(downstream_cx_destroy)                                                                   \
   GAUGE  (downstream_cx_active)                                                                    \
-  TIMER  (downstream_cx_length_ms)
+  TIMER  (downstream_cx_length_ms)                                                                 \
+  COUNTER(downstream_cx_overflow)                                                                  \
+  TIMER  (downstream_cx_overflow_ms)
 // clang-format on
 
 /**
@@ -36,6 +42,22 @@ struct ListenerStats {
   ALL_LISTENER_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT, GENERATE_TIMER_STRUCT)
 };
 
+// clang-format off
+#define ALL_CONNECTION_HANDLER_STATS(COUNTER, GAUGE)                                               \
+  COUNTER(downstream_cx_total)                                                                     \
+  COUNTER(downstream_cx_balanced)                                                                  \
+  GAUGE  (downstream_cx_active)
+// clang-format on
+
+/**
+ * Wrapper struct for the stats of all the listeners of a connection handler. @see stats_macros.h
+ */
+struct ConnectionHandlerStats {
+  ALL_CONNECTION_HANDLER_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT)
+};
+
+class ConnectionBalancerImpl;
+
 /**
  * Server side connection handler. This is used both by workers as well as the
  * main thread for non-threaded listeners.
@@ -44,6 +66,16 @@ class ConnectionHandlerImpl : public Network::ConnectionHandler, NonCopyable {
 public:
   ConnectionHandlerImpl(spdlog::logger& logger, Event::Dispatcher& dispatcher);
 
+  /**
+   * @param scope supplies the scope for stats that count the connections of all listeners of the
+   *        handler, which workers use to report their share of the connections.
+   * @param balancer supplies an optional balancer that moves new connections between this handler
+   *        and the other handlers registered with it. It must outlive the handler.
+   */
+  ConnectionHandlerImpl(spdlog::logger& logger, Event::Dispatcher& dispatcher,
+                        Stats::Scope& scope, ConnectionBalancerImpl* balancer);
+  ~ConnectionHandlerImpl();
+
   // Network::ConnectionHandler
   uint64_t numConnections() override { return num_connections_; }
   void addListener(Network::FilterChainFactory& factory, Network::ListenSocket& socket,
@@ -54,10 +86,21 @@ public:
                       const Network::ListenerOptions& listener_options) override;
   Network::Listener* findListenerByAddress(const Network::Address::Instance& address) override;
   void removeListeners(uint64_t listener_tag) override;
+  void retireListeners(uint64_t listener_tag, std::function<void()> completion) override;
   void stopListeners(uint64_t listener_tag) override;
   void stopListeners() override;
+  void disableListeners() override;
+  void enableListeners() override;
+
+  /**
+   * Cap the buffer limits of the connections that the listeners create from now on.
+   * @param limit supplies the cap, or 0 to remove it.
+   */
+  void setBufferLimitCap(uint32_t limit) { buffer_limit_cap_ = limit; }
 
 private:
+  friend class ConnectionBalancerImpl;
+
   struct ActiveConnection;
   typedef std::unique_ptr<ActiveConnection> ActiveConnectionPtr;
 
@@ -71,10 +114,24 @@ private:
 
     ActiveListener(ConnectionHandlerImpl& parent, Network::ListenerPtr&& listener,
                    Network::FilterChainFactory& factory, Stats::Scope& scope,
-                   uint64_t listener_tag);
+                   uint64_t listener_tag, Network::ConnectionLimitSharedPtr connection_limit);
 
     ~ActiveListener();
 
+    /**
+     * Fires when a new socket is accepted by the listener. Hands the socket to the balancer if the
+     * handler has one.
+     */
+    bool onAccept(int fd, Network::Address::InstanceConstSharedPtr remote_address,
+                  Network::Address::InstanceConstSharedPtr local_address,
+                  bool using_original_dst) override;
+
+    /**
+     * Fires before each socket is accepted. Pauses the listener while its connection limit is
+     * reached.
+     */
+    bool canAccept() override;
+
     /**
      * Fires when a new connection is received from the listener.
      * @param new_connection supplies the connection to take control of.
@@ -87,12 +144,23 @@ private:
      */
     void removeConnection(ActiveConnection& connection);
 
+    /**
+     * Accept again once the connection limit is no longer reached.
+     */
+    void resume();
+
     ConnectionHandlerImpl& parent_;
     Network::FilterChainFactory& factory_;
     Network::ListenerPtr listener_;
     ListenerStats stats_;
     std::list<ActiveConnectionPtr> connections_;
     const uint64_t listener_tag_;
+    // Set while the listener is retired, until it is removed.
+    std::function<void()> retired_completion_;
+    const Network::ConnectionLimitSharedPtr connection_limit_;
+    // Set while the listener is paused by its connection limit.
+    bool paused_{};
+    Stats::TimespanPtr overflow_span_;
   };
 
   struct SslActiveListener : public ActiveListener {
@@ -103,6 +171,8 @@ private:
   };
 
   typedef std::unique_ptr<ActiveListener> ActiveListenerPtr;
+  typedef std::list<std::pair<Network::Address::InstanceConstSharedPtr, ActiveListenerPtr>>
+      ListenerList;
 
   /**
    * Wrapper for an active connection owned by this handler.
@@ -131,10 +201,102 @@ private:
 
   static ListenerStats generateStats(Stats::Scope& scope);
 
+  /**
+   * Remove a listener, and call its retired completion if it was retired.
+   * @return ListenerList::iterator the listener after the removed one.
+   */
+  ListenerList::iterator eraseListener(ListenerList::iterator listener);
+
+  /**
+   * Remove the retired listeners with the tag that have no connections left.
+   */
+  void removeIdleRetiredListeners(uint64_t listener_tag);
+
+  /**
+   * Resume a listener that was paused by its connection limit, unless it was removed since.
+   * @param listener supplies the listener, which is only compared with the current listeners.
+   */
+  void resumeListener(const ActiveListener* listener);
+
+  /**
+   * @return uint64_t the connections of the handler, including those handed to it by the balancer
+   *         that it has not created yet. May be called from any thread.
+   */
+  uint64_t load() const { return num_connections_ + num_pending_connections_; }
+
+  /**
+   * Create a connection for a socket accepted by the listener of another handler. The connection is
+   * created on the dispatcher of this handler by the listener with the same tag. May be called from
+   * any thread.
+   */
+  void postConnection(uint64_t listener_tag, int fd,
+                      Network::Address::InstanceConstSharedPtr remote_address,
+                      Network::Address::InstanceConstSharedPtr local_address,
+                      bool using_original_dst);
+
   spdlog::logger& logger_;
   Event::Dispatcher& dispatcher_;
-  std::list<std::pair<Network::Address::InstanceConstSharedPtr, ActiveListenerPtr>> listeners_;
+  std::unique_ptr<ConnectionHandlerStats> stats_;
+  ConnectionBalancerImpl* const balancer_{};
+  std::atomic<uint64_t> num_pending_connections_{};
+  ListenerList listeners_;
   std::atomic<uint64_t> num_connections_{};
+  bool listeners_disabled_{};
+  uint32_t buffer_limit_cap_{};
+};
+
+/**
+ * Implementation of Network::ConnectionLimit. The active connections are counted with an atomic,
+ * and the lock is only taken while the limit is reached. The limit is soft: workers that check it
+ * at the same time may each accept one more connection, and connections moved between workers by
+ * the balancer are not checked.
+ */
+class ConnectionLimitImpl : public Network::ConnectionLimit, NonCopyable {
+public:
+  ConnectionLimitImpl(uint64_t max_connections) : max_connections_(max_connections) {}
+
+  // Network::ConnectionLimit
+  void acquire() override { active_connections_++; }
+  void release() override;
+  bool pause(const void* key, std::function<void()> resume_cb) override;
+  void cancelPause(const void* key) override;
+
+private:
+  const uint64_t max_connections_;
+  std::atomic<uint64_t> active_connections_{};
+  // Read without the lock, so that releasing a connection only takes the lock when there are
+  // paused workers to resume.
+  std::atomic<uint64_t> num_paused_{};
+  std::mutex lock_;
+  std::unordered_map<const void*, std::function<void()>> paused_;
+};
+
+/**
+ * Balances new connections across the connection handlers of the workers. Connections are pinned
+ * to the worker that creates them, and the kernel does not know how long connections live, so
+ * workers that happen to accept many long lived connections stay more loaded than others. Each
+ * accepted socket is instead handed to the handler with the fewest connections, which creates the
+ * connection on its own dispatcher. Ties are kept by the accepting handler.
+ */
+class ConnectionBalancerImpl : NonCopyable {
+public:
+  void registerHandler(ConnectionHandlerImpl& handler);
+  void unregisterHandler(ConnectionHandlerImpl& handler);
+
+  /**
+   * Hand an accepted socket to the least loaded handler, unless that is the accepting handler.
+   * @param handler supplies the accepting handler.
+   * @param listener_tag supplies the tag of the accepting listener. The listener with the same tag
+   *        on the target handler creates the connection.
+   * @return bool whether the socket was handed to another handler, which then owns it.
+   */
+  bool balance(ConnectionHandlerImpl& handler, uint64_t listener_tag, int fd,
+               Network::Address::InstanceConstSharedPtr remote_address,
+               Network::Address::InstanceConstSharedPtr local_address, bool using_original_dst);
+
+private:
+  std::mutex lock_;
+  std::vector<ConnectionHandlerImpl*> handlers_;
 };
 
 } // Server
@@ -1,5 +1,6 @@
 #include "server/drain_manager_impl.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <functional>
@@ -14,7 +15,32 @@
 namespace Envoy {
 namespace Server {
 
-DrainManagerImpl::DrainManagerImpl(Instance& server) : server_(server) {}
+namespace {
+
+std::chrono::nanoseconds closeInterval(Options& options) {
+  const uint64_t rate = options.drainCloseRate();
+  if (rate == 0) {
+    return std::chrono::nanoseconds(0);
+  }
+  // Each worker may close the rate per second, so that the closes of all workers are spaced by
+  // the second divided by the rate of all workers.
+  const uint64_t workers = std::max(1U, options.concurrency());
+  return std::chrono::nanoseconds(std::max<uint64_t>(1, 1000000000 / (rate * workers)));
+}
+
+} // namespace
+
+DrainManagerImpl::DrainManagerImpl(Instance& server, MonotonicTimeSource& time_source)
+    : server_(server), time_source_(time_source),
+      stats_{ALL_DRAIN_STATS(POOL_COUNTER_PREFIX(server.stats(), "server.drain."),
+                             POOL_GAUGE_PREFIX(server.stats(), "server.drain."))},
+      close_interval_(closeInterval(server.options())) {}
+
+DrainManagerImpl::~DrainManagerImpl() {
+  if (sequence_active_) {
+    stats_.sequences_active_.dec();
+  }
+}
 
 bool DrainManagerImpl::drainClose() const {
   // If we are actively HC failed, always drain close.
@@ -32,8 +58,33 @@ bool DrainManagerImpl::drainClose() const {
   }
 
   // We use the tick time as in increasing chance that we shutdown connections.
-  return static_cast<uint64_t>(drain_time_completed_.load()) >
-         (server_.random().random() % server_.options().drainTime().count());
+  if (static_cast<uint64_t>(drain_time_completed_.load()) <=
+      (server_.random().random() % server_.options().drainTime().count())) {
+    return false;
+  }
+
+  if (close_interval_.count() > 0 && !takeClose()) {
+    stats_.close_rate_limited_.inc();
+    return false;
+  }
+
+  stats_.close_.inc();
+  return true;
+}
+
+bool DrainManagerImpl::takeClose() const {
+  const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          time_source_.currentTime().time_since_epoch())
+                          .count();
+  int64_t next = next_close_ns_.load();
+  do {
+    if (now < next) {
+      return false;
+    }
+    // A close that was not taken in its time is not saved for later, so that connections that ask
+    // at once after a quiet period are still closed one interval apart.
+  } while (!next_close_ns_.compare_exchange_weak(next, now + close_interval_.count()));
+  return true;
 }
 
 void DrainManagerImpl::drainSequenceTick() {
@@ -43,7 +94,12 @@ void DrainManagerImpl::drainSequenceTick() {
 
   if (drain_time_completed_.load() < server_.options().drainTime().count()) {
     drain_tick_timer_->enableTimer(std::chrono::milliseconds(1000));
-  } else if (drain_sequence_completion_) {
+    return;
+  }
+
+  sequence_active_ = false;
+  stats_.sequences_active_.dec();
+  if (drain_sequence_completion_) {
     drain_sequence_completion_();
   }
 }
@@ -52,6 +108,8 @@ void DrainManagerImpl::startDrainSequence(std::function<void()> completion) {
   drain_sequence_completion_ = completion;
   ASSERT(!drain_tick_timer_);
   drain_tick_timer_ = server_.dispatcher().createTimer([this]() -> void { drainSequenceTick(); });
+  sequence_active_ = true;
+  stats_.sequences_active_.inc();
   drainSequenceTick();
 }
 
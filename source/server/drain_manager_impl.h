@@ -1,25 +1,49 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 
+#include "envoy/common/time.h"
 #include "envoy/server/drain_manager.h"
 #include "envoy/server/instance.h"
+#include "envoy/stats/stats_macros.h"
 
 #include "common/common/logger.h"
 
 namespace Envoy {
 namespace Server {
 
+/**
+ * All drain stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_DRAIN_STATS(COUNTER, GAUGE)                                                            \
+  COUNTER(close)                                                                                   \
+  COUNTER(close_rate_limited)                                                                      \
+  GAUGE  (sequences_active)
+// clang-format on
+
+/**
+ * Struct definition for all drain stats. @see stats_macros.h
+ */
+struct DrainStats {
+  ALL_DRAIN_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT)
+};
+
 /**
  * Implementation of drain manager that does the following by default:
  * 1) Terminates the parent process after 15 minutes.
  * 2) Drains the parent process over a period of 10 minutes where drain close becomes more
  *    likely each second that passes.
+ * With a drain close rate, drain closes are also spaced evenly, so that no more than the rate per
+ * worker and second are told to close however many connections ask at once.
  */
 class DrainManagerImpl : Logger::Loggable<Logger::Id::main>, public DrainManager {
 public:
-  DrainManagerImpl(Instance& server);
+  DrainManagerImpl(Instance& server, MonotonicTimeSource& time_source);
+  ~DrainManagerImpl();
 
   // Server::DrainManager
   bool drainClose() const override;
@@ -29,10 +53,22 @@ public:
 private:
   bool draining() const { return drain_tick_timer_ != nullptr; }
   void drainSequenceTick();
+  /**
+   * Take the next drain close of the close rate. May be called from any thread.
+   * @return bool whether a drain close is allowed now.
+   */
+  bool takeClose() const;
 
   Instance& server_;
+  MonotonicTimeSource& time_source_;
+  DrainStats stats_;
+  // The time between two drain closes across all workers, or 0 for no limit.
+  const std::chrono::nanoseconds close_interval_;
+  // The earliest time since the epoch of the time source at which the next drain close is allowed.
+  mutable std::atomic<int64_t> next_close_ns_{};
   Event::TimerPtr drain_tick_timer_;
   std::atomic<uint32_t> drain_time_completed_{};
+  bool sequence_active_{};
   Event::TimerPtr parent_shutdown_timer_;
   std::function<void()> drain_sequence_completion_;
 };
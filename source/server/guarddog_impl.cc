@@ -1,10 +1,23 @@
 #include "server/guarddog_impl.h"
 
+#ifdef __linux__
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <cstring>
 #include <mutex>
+#include <thread>
 
 #include "common/common/assert.h"
+#include "common/common/macros.h"
 
+#include "server/backtrace.h"
 #include "server/watchdog_impl.h"
 
 #include "fmt/format.h"
@@ -12,8 +25,102 @@
 namespace Envoy {
 namespace Server {
 
+const size_t GuardDogImpl::MAX_STALL_SITES;
+
+namespace {
+
+#ifdef __linux__
+/**
+ * Captures the stack of another thread by sending it a SIGURG, which is ignored by default and
+ * not otherwise used, and having the thread capture its own stack in the signal handler. There is
+ * one sampler per process since the handler is, and one stack is sampled at a time.
+ */
+class StackSampler {
+public:
+  static StackSampler& get() {
+    static StackSampler* sampler = new StackSampler();
+    return *sampler;
+  }
+
+  /**
+   * @param thread_id supplies the thread to sample.
+   * @param frames receives the addresses of the frames of the thread's stack.
+   * @return BackwardsTrace* the sampled trace, which is valid until the next sample, or nullptr if
+   *         the thread could not be sampled in time.
+   */
+  BackwardsTrace* sample(int32_t thread_id, std::vector<void*>& frames) {
+    std::lock_guard<std::mutex> guard(lock_);
+    thread_id_ = thread_id;
+    state_ = Requested;
+    if (syscall(SYS_tgkill, getpid(), thread_id, SIGURG) != 0) {
+      state_ = Idle;
+      return nullptr;
+    }
+
+    // The thread may have the signal blocked or be stuck in the kernel, so it is not waited on for
+    // long. Once it has started to capture, it is waited on until it is done.
+    const auto deadline = std::chrono::steady_clock::now() + SAMPLE_TIMEOUT;
+    while (state_ != Done) {
+      int requested = Requested;
+      if (std::chrono::steady_clock::now() > deadline &&
+          state_.compare_exchange_strong(requested, Idle)) {
+        return nullptr;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // The last frame is a sentinel.
+    for (size_t i = 0; i + 1 < trace_.size(); i++) {
+      frames.push_back(trace_.address(i));
+    }
+    state_ = Idle;
+    return &trace_;
+  }
+
+private:
+  enum State { Idle, Requested, Capturing, Done };
+
+  static constexpr std::chrono::milliseconds SAMPLE_TIMEOUT{50};
+
+  StackSampler() {
+    // Capturing once reserves the frames of the trace, so that the signal handler does not
+    // allocate.
+    trace_.capture();
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    action.sa_handler = signalHandler;
+    RELEASE_ASSERT(sigaction(SIGURG, &action, nullptr) == 0);
+  }
+
+  static void signalHandler(int) {
+    const int saved_errno = errno;
+    StackSampler& sampler = get();
+    int requested = Requested;
+    // The signal may arrive late, after the sampler has given up on this thread.
+    if (sampler.thread_id_ == Thread::Thread::currentThreadId() &&
+        sampler.state_.compare_exchange_strong(requested, Capturing)) {
+      sampler.trace_.capture();
+      sampler.state_ = Done;
+    }
+    errno = saved_errno;
+  }
+
+  std::mutex lock_;
+  std::atomic<int> state_{Idle};
+  std::atomic<int32_t> thread_id_{0};
+  BackwardsTrace trace_;
+};
+
+constexpr std::chrono::milliseconds StackSampler::SAMPLE_TIMEOUT;
+#endif
+
+} // namespace
+
 GuardDogImpl::GuardDogImpl(Stats::Scope& stats_scope, const Server::Configuration::Main& config,
-                           MonotonicTimeSource& tsource)
+                           MonotonicTimeSource& tsource, bool sample_stacks)
     : time_source_(tsource), miss_timeout_(config.wdMissTimeout()),
       megamiss_timeout_(config.wdMegaMissTimeout()), kill_timeout_(config.wdKillTimeout()),
       multi_kill_timeout_(config.wdMultiKillTimeout()),
@@ -28,6 +135,9 @@ GuardDogImpl::GuardDogImpl(Stats::Scope& stats_scope, const Server::Configuratio
       }()),
       watchdog_miss_counter_(stats_scope.counter("server.watchdog_miss")),
       watchdog_megamiss_counter_(stats_scope.counter("server.watchdog_mega_miss")),
+      sample_stacks_(sample_stacks),
+      watchdog_stack_samples_counter_(stats_scope.counter("server.watchdog_stack_samples")),
+      watchdog_stall_sites_gauge_(stats_scope.gauge("server.watchdog_stall_sites")),
       run_thread_(true) {
   start();
 }
@@ -38,46 +148,107 @@ void GuardDogImpl::threadRoutine() {
   do {
     const auto now = time_source_.currentTime();
     bool seen_one_multi_timeout(false);
-    std::lock_guard<std::mutex> guard(wd_lock_);
-    for (auto& watched_dog : watched_dogs_) {
-      const auto ltt = watched_dog.dog_->lastTouchTime();
-      const auto delta = now - ltt;
-      if (watched_dog.last_alert_time_.valid() && watched_dog.last_alert_time_.value() < ltt) {
-        watched_dog.miss_alerted_ = false;
-        watched_dog.megamiss_alerted_ = false;
-      }
-      if (delta > miss_timeout_) {
-        if (!watched_dog.miss_alerted_) {
-          watchdog_miss_counter_.inc();
-          watched_dog.last_alert_time_.value(ltt);
-          watched_dog.miss_alerted_ = true;
+    // Stacks are sampled once the dogs are unlocked, so that sampling does not hold up threads
+    // that start or stop being watched.
+    std::vector<int32_t> missed_thread_ids;
+    {
+      std::lock_guard<std::mutex> guard(wd_lock_);
+      for (auto& watched_dog : watched_dogs_) {
+        const auto ltt = watched_dog.dog_->lastTouchTime();
+        const auto delta = now - ltt;
+        if (watched_dog.last_alert_time_.valid() && watched_dog.last_alert_time_.value() < ltt) {
+          watched_dog.miss_alerted_ = false;
+          watched_dog.megamiss_alerted_ = false;
         }
-      }
-      if (delta > megamiss_timeout_) {
-        if (!watched_dog.megamiss_alerted_) {
-          watchdog_megamiss_counter_.inc();
-          watched_dog.last_alert_time_.value(ltt);
-          watched_dog.megamiss_alerted_ = true;
+        if (delta > miss_timeout_) {
+          if (!watched_dog.miss_alerted_) {
+            watchdog_miss_counter_.inc();
+            watched_dog.last_alert_time_.value(ltt);
+            watched_dog.miss_alerted_ = true;
+            if (sample_stacks_) {
+              missed_thread_ids.push_back(watched_dog.dog_->threadId());
+            }
+          }
         }
-      }
-      if (killEnabled() && delta > kill_timeout_) {
-        PANIC(fmt::format("GuardDog: one thread ({}) stuck for more than watchdog_kill_timeout",
-                          watched_dog.dog_->threadId()));
-      }
-      if (multikillEnabled() && delta > multi_kill_timeout_) {
-        if (seen_one_multi_timeout) {
-
-          PANIC(fmt::format(
-              "GuardDog: multiple threads ({},...) stuck for more than watchdog_multikill_timeout",
-              watched_dog.dog_->threadId()));
-        } else {
-          seen_one_multi_timeout = true;
+        if (delta > megamiss_timeout_) {
+          if (!watched_dog.megamiss_alerted_) {
+            watchdog_megamiss_counter_.inc();
+            watched_dog.last_alert_time_.value(ltt);
+            watched_dog.megamiss_alerted_ = true;
+          }
+        }
+        if (killEnabled() && delta > kill_timeout_) {
+          PANIC(fmt::format("GuardDog: one thread ({}) stuck for more than watchdog_kill_timeout",
+                            watched_dog.dog_->threadId()));
+        }
+        if (multikillEnabled() && delta > multi_kill_timeout_) {
+          if (seen_one_multi_timeout) {
+
+            PANIC(fmt::format("GuardDog: multiple threads ({},...) stuck for more than "
+                              "watchdog_multikill_timeout",
+                              watched_dog.dog_->threadId()));
+          } else {
+            seen_one_multi_timeout = true;
+          }
         }
       }
     }
+    for (int32_t thread_id : missed_thread_ids) {
+      sampleStack(thread_id);
+    }
   } while (waitOrDetectStop());
 }
 
+void GuardDogImpl::sampleStack(int32_t thread_id) {
+#ifdef __linux__
+  std::vector<void*> frames;
+  BackwardsTrace* trace = StackSampler::get().sample(thread_id, frames);
+  if (trace == nullptr) {
+    return;
+  }
+  watchdog_stack_samples_counter_.inc();
+
+  std::lock_guard<std::mutex> guard(stall_sites_lock_);
+  auto it = stall_sites_.find(frames);
+  if (it == stall_sites_.end()) {
+    if (stall_sites_.size() >= MAX_STALL_SITES) {
+      return;
+    }
+    // Only the first sample of a site is logged, since resolving the trace is slow.
+    trace->logTrace();
+    it = stall_sites_.emplace(std::move(frames), StallSite()).first;
+    watchdog_stall_sites_gauge_.set(stall_sites_.size());
+  }
+  it->second.samples_++;
+  it->second.last_thread_id_ = thread_id;
+#else
+  UNREFERENCED_PARAMETER(thread_id);
+#endif
+}
+
+std::string GuardDogImpl::stallSites() {
+  std::lock_guard<std::mutex> guard(stall_sites_lock_);
+  typedef std::map<std::vector<void*>, StallSite>::value_type Site;
+  std::vector<const Site*> sites;
+  for (const auto& site : stall_sites_) {
+    sites.push_back(&site);
+  }
+  std::stable_sort(sites.begin(), sites.end(), [](const Site* a, const Site* b) {
+    return a->second.samples_ > b->second.samples_;
+  });
+
+  std::string output;
+  for (const Site* site : sites) {
+    output += fmt::format("{} samples, last on thread {}:", site->second.samples_,
+                          site->second.last_thread_id_);
+    for (void* frame : site->first) {
+      output += fmt::format(" {}", frame);
+    }
+    output += "\n";
+  }
+  return output;
+}
+
 WatchDogSharedPtr GuardDogImpl::createWatchDog(int32_t thread_id) {
   // Timer started by WatchDog will try to fire at 1/2 of the interval of the
   // minimum timeout specified. loop_interval_ is const so all shared state
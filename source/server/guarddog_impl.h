@@ -2,7 +2,9 @@
 
 #include <chrono>
 #include <condition_variable>
+#include <map>
 #include <mutex>
+#include <string>
 #include <vector>
 
 #include "envoy/common/optional.h"
@@ -26,6 +28,10 @@ namespace Server {
  * the appropriate action depending on the config parameters described below.
  *
  * Thread lifetime is tied to GuardDog object lifetime (RAII style).
+ *
+ * If stack sampling is enabled, the stack of a thread is captured when it first misses, and
+ * samples with the same stack are aggregated into stall sites. Sampling is only supported on
+ * Linux.
  */
 class GuardDogImpl : public GuardDog {
 public:
@@ -33,13 +39,20 @@ public:
    * @param stats_scope Statistics scope to write watchdog_miss and
    * watchdog_mega_miss events into.
    * @param config Configuration object.
+   * @param sample_stacks whether to sample the stacks of threads that miss.
    *
    * See the configuration documentation for details on the timeout settings.
    */
   GuardDogImpl(Stats::Scope& stats_scope, const Server::Configuration::Main& config,
-               MonotonicTimeSource& tsource);
+               MonotonicTimeSource& tsource, bool sample_stacks = false);
   ~GuardDogImpl();
 
+  /**
+   * @return std::string the stall sites sampled so far, one per line and most sampled first, with
+   *         the number of samples, the last thread sampled and the frame addresses.
+   */
+  std::string stallSites();
+
   /**
    * Exposed for testing purposes only (but harmless to call):
    */
@@ -66,6 +79,7 @@ private:
   // it is after kill and multikill timeout values are initialized.
   bool killEnabled() const { return kill_timeout_ > std::chrono::milliseconds(0); }
   bool multikillEnabled() const { return multi_kill_timeout_ > std::chrono::milliseconds(0); }
+  void sampleStack(int32_t thread_id);
 
   struct WatchedDog {
     WatchDogSharedPtr dog_;
@@ -74,6 +88,14 @@ private:
     bool megamiss_alerted_{};
   };
 
+  struct StallSite {
+    uint64_t samples_{};
+    int32_t last_thread_id_{};
+  };
+
+  // Bounds the memory taken by stall sites that never recur. Further sites are not recorded.
+  static const size_t MAX_STALL_SITES = 64;
+
   MonotonicTimeSource& time_source_;
   const std::chrono::milliseconds miss_timeout_;
   const std::chrono::milliseconds megamiss_timeout_;
@@ -82,6 +104,12 @@ private:
   const std::chrono::milliseconds loop_interval_;
   Stats::Counter& watchdog_miss_counter_;
   Stats::Counter& watchdog_megamiss_counter_;
+  const bool sample_stacks_;
+  Stats::Counter& watchdog_stack_samples_counter_;
+  Stats::Gauge& watchdog_stall_sites_gauge_;
+  // Keyed by the frame addresses of the sampled stack.
+  std::map<std::vector<void*>, StallSite> stall_sites_;
+  std::mutex stall_sites_lock_;
   std::vector<WatchedDog> watched_dogs_;
   std::mutex wd_lock_;
   Thread::ThreadPtr thread_;
@@ -6,9 +6,11 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/un.h>
+#include <unistd.h>
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "envoy/event/dispatcher.h"
 #include "envoy/event/file_event.h"
@@ -25,9 +27,16 @@ namespace Server {
 
 // Increment this whenever there is a shared memory / RPC change that will prevent a hot restart
 // from working. Operations code can then cope with this and do a full restart.
-const uint64_t SharedMemory::VERSION = 8;
+const uint64_t SharedMemory::VERSION = 10;
+
+uint64_t SharedMemory::totalSize(uint32_t max_stats) {
+  static_assert(sizeof(SharedMemory) % alignof(Stats::RawStatData) == 0,
+                "stats region must be aligned");
+  return sizeof(SharedMemory) + SharedMemoryStatSet::bytesRequired(max_stats);
+}
 
 SharedMemory& SharedMemory::initialize(Options& options) {
+  const uint64_t total_size = totalSize(options.maxStats());
   int flags = O_RDWR;
   std::string shmem_name = fmt::format("/envoy_shared_memory_{}", options.baseId());
   if (options.restartEpoch() == 0) {
@@ -44,25 +53,30 @@ SharedMemory& SharedMemory::initialize(Options& options) {
   }
 
   if (options.restartEpoch() == 0) {
-    int rc = ftruncate(shmem_fd, sizeof(SharedMemory));
+    int rc = ftruncate(shmem_fd, total_size);
     RELEASE_ASSERT(rc != -1);
     UNREFERENCED_PARAMETER(rc);
   }
 
   SharedMemory* shmem = reinterpret_cast<SharedMemory*>(
-      mmap(nullptr, sizeof(SharedMemory), PROT_READ | PROT_WRITE, MAP_SHARED, shmem_fd, 0));
+      mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, shmem_fd, 0));
   RELEASE_ASSERT(shmem != MAP_FAILED);
 
   if (options.restartEpoch() == 0) {
-    shmem->size_ = sizeof(SharedMemory);
+    shmem->size_ = total_size;
     shmem->version_ = VERSION;
+    shmem->max_stats_ = options.maxStats();
     shmem->initializeMutex(shmem->log_lock_);
     shmem->initializeMutex(shmem->access_log_lock_);
     shmem->initializeMutex(shmem->stat_lock_);
     shmem->initializeMutex(shmem->init_lock_);
   } else {
-    RELEASE_ASSERT(shmem->size_ == sizeof(SharedMemory));
     RELEASE_ASSERT(shmem->version_ == VERSION);
+    if (shmem->max_stats_ != options.maxStats()) {
+      throw EnvoyException(fmt::format("--max-stats {} does not match the parent process value {}",
+                                       options.maxStats(), shmem->max_stats_));
+    }
+    RELEASE_ASSERT(shmem->size_ == total_size);
   }
 
   // Here we catch the case where a new Envoy starts up when the current Envoy has not yet fully
@@ -86,12 +100,15 @@ void SharedMemory::initializeMutex(pthread_mutex_t& mutex) {
   pthread_mutex_init(&mutex, &attribute);
 }
 
-std::string SharedMemory::version() { return fmt::format("{}.{}", VERSION, sizeof(SharedMemory)); }
+std::string SharedMemory::version(uint32_t max_stats) {
+  return fmt::format("{}.{}", VERSION, totalSize(max_stats));
+}
 
 HotRestartImpl::HotRestartImpl(Options& options)
     : options_(options), shmem_(SharedMemory::initialize(options)), log_lock_(shmem_.log_lock_),
       access_log_lock_(shmem_.access_log_lock_), stat_lock_(shmem_.stat_lock_),
-      init_lock_(shmem_.init_lock_) {
+      init_lock_(shmem_.init_lock_),
+      stats_set_(shmem_.statsRegion(), options.maxStats(), options.restartEpoch() == 0) {
 
   my_domain_socket_ = bindDomainSocket(options.restartEpoch());
   child_address_ = createDomainSocketAddress((options.restartEpoch() + 1));
@@ -109,17 +126,13 @@ HotRestartImpl::HotRestartImpl(Options& options)
 Stats::RawStatData* HotRestartImpl::alloc(const std::string& name) {
   // Try to find the existing slot in shared memory, otherwise allocate a new one.
   std::unique_lock<Thread::BasicLockable> lock(stat_lock_);
-  for (Stats::RawStatData& data : shmem_.stats_slots_) {
-    if (!data.initialized()) {
-      data.initialize(name);
-      return &data;
-    } else if (data.matches(name)) {
-      data.ref_count_++;
-      return &data;
-    }
+  Stats::RawStatData* data = stats_set_.find(name);
+  if (data != nullptr) {
+    data->ref_count_++;
+    return data;
   }
 
-  return nullptr;
+  return stats_set_.insert(name);
 }
 
 void HotRestartImpl::free(Stats::RawStatData& data) {
@@ -130,7 +143,7 @@ void HotRestartImpl::free(Stats::RawStatData& data) {
     return;
   }
 
-  memset(&data, 0, sizeof(Stats::RawStatData));
+  stats_set_.remove(data);
 }
 
 int HotRestartImpl::bindDomainSocket(uint64_t id) {
@@ -164,7 +177,19 @@ sockaddr_un HotRestartImpl::createDomainSocketAddress(uint64_t id) {
   return address;
 }
 
+void HotRestartImpl::closeParentListenSockets() {
+  for (const auto& socket : parent_sockets_) {
+    ::close(socket.second);
+  }
+  parent_sockets_.clear();
+}
+
 void HotRestartImpl::drainParentListeners() {
+  // Listeners that are added from now on ask the parent for their socket one at a time, as the
+  // parent may have changed since the sockets were fetched.
+  closeParentListenSockets();
+  parent_sockets_state_ = ParentSocketsState::Unavailable;
+
   if (options_.restartEpoch() > 0) {
     // No reply expected.
     RpcBase rpc(RpcMessageType::DrainListenersRequest);
@@ -175,20 +200,72 @@ void HotRestartImpl::drainParentListeners() {
   shmem_.flags_ &= ~SharedMemory::Flags::INITIALIZING;
 }
 
-int HotRestartImpl::duplicateParentListenSocket(const std::string& address) {
+int HotRestartImpl::duplicateParentListenSocket(const std::string& address,
+                                                uint32_t worker_index) {
   if (options_.restartEpoch() == 0 || parent_terminated_) {
     return -1;
   }
 
+  if (parent_sockets_state_ == ParentSocketsState::NotFetched) {
+    fetchParentListenSockets();
+  }
+
+  if (parent_sockets_state_ == ParentSocketsState::Fetched) {
+    // As in onGetListenSocket(), a worker that the parent has no socket of its own for gets the
+    // socket of worker 0, which is also the socket shared by all workers.
+    const std::string key = Network::Utility::resolveUrl(address)->asString();
+    auto socket = parent_sockets_.find({key, worker_index});
+    if (socket == parent_sockets_.end()) {
+      socket = parent_sockets_.find({key, 0});
+    }
+    if (socket == parent_sockets_.end()) {
+      return -1;
+    }
+
+    const int fd = ::dup(socket->second);
+    RELEASE_ASSERT(fd != -1);
+    return fd;
+  }
+
   RpcGetListenSocketRequest rpc;
   ASSERT(address.length() < sizeof(rpc.address_));
   StringUtil::strlcpy(rpc.address_, address.c_str(), sizeof(rpc.address_));
+  rpc.worker_index_ = worker_index;
   sendMessage(parent_address_, rpc);
   RpcGetListenSocketReply* reply =
       receiveTypedRpc<RpcGetListenSocketReply, RpcMessageType::GetListenSocketReply>();
   return reply->fd_;
 }
 
+void HotRestartImpl::fetchParentListenSockets() {
+  // Fetching all of the sockets in batches of MAX_SOCKETS_PER_REPLY takes a round trip to the
+  // parent per batch rather than per socket, which matters with many listeners and workers.
+  RpcGetListenSocketsRequest rpc;
+  do {
+    sendMessage(parent_address_, rpc);
+    RpcBase* base_message = receiveRpc(true);
+    if (base_message->type_ == RpcMessageType::UnknownRequestReply) {
+      // The parent does not batch, so every socket is requested on its own.
+      ENVOY_LOG(info, "parent does not support fetching listen sockets in batches");
+      closeParentListenSockets();
+      parent_sockets_state_ = ParentSocketsState::Unavailable;
+      return;
+    }
+
+    RELEASE_ASSERT(base_message->type_ == RpcMessageType::GetListenSocketsReply);
+    RELEASE_ASSERT(base_message->length_ == sizeof(RpcGetListenSocketsReply));
+    RpcGetListenSocketsReply* reply = reinterpret_cast<RpcGetListenSocketsReply*>(base_message);
+    for (uint32_t i = 0; i < reply->num_sockets_; i++) {
+      const RpcListenSocket& socket = reply->sockets_[i];
+      parent_sockets_[{std::string(socket.address_), socket.worker_index_}] = reply->fds_[i];
+    }
+    rpc.start_index_ = reply->next_index_;
+  } while (rpc.start_index_ != 0);
+
+  ENVOY_LOG(info, "obtained {} listen sockets from parent", parent_sockets_.size());
+  parent_sockets_state_ = ParentSocketsState::Fetched;
+}
+
 void HotRestartImpl::getParentStats(GetParentStatsInfo& info) {
   // There exists a race condition during hot restart involving fetching parent stats. It looks like
   // this:
@@ -245,16 +322,16 @@ HotRestartImpl::RpcBase* HotRestartImpl::receiveRpc(bool block) {
   iov[0].iov_base = &rpc_buffer_[0];
   iov[0].iov_len = rpc_buffer_.size();
 
-  // We always setup to receive an FD even though most messages do not pass one.
-  uint8_t control_buffer[CMSG_SPACE(sizeof(int))];
-  memset(control_buffer, 0, CMSG_SPACE(sizeof(int)));
+  // We always setup to receive a batch of FDs even though most messages do not pass one.
+  uint8_t control_buffer[CMSG_SPACE(sizeof(int) * MAX_SOCKETS_PER_REPLY)];
+  memset(control_buffer, 0, sizeof(control_buffer));
 
   msghdr message;
   memset(&message, 0, sizeof(message));
   message.msg_iov = iov;
   message.msg_iovlen = 1;
   message.msg_control = control_buffer;
-  message.msg_controllen = CMSG_SPACE(sizeof(int));
+  message.msg_controllen = sizeof(control_buffer);
 
   int rc = recvmsg(my_domain_socket_, &message, 0);
   if (!block && rc == -1 && errno == EAGAIN) {
@@ -274,9 +351,9 @@ HotRestartImpl::RpcBase* HotRestartImpl::receiveRpc(bool block) {
   RpcBase* rpc = reinterpret_cast<RpcBase*>(&rpc_buffer_[0]);
   RELEASE_ASSERT(static_cast<uint64_t>(rc) == rpc->length_);
 
-  // We should only get control data in a GetListenSocketReply. If that's the case, pull the
-  // cloned fd out of the control data and stick it into the RPC so that higher level code does
-  // need to deal with any of this.
+  // We should only get control data in a GetListenSocketReply or a GetListenSocketsReply. If
+  // that's the case, pull the cloned fds out of the control data and stick them into the RPC so
+  // that higher level code does need to deal with any of this.
   for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr;
        cmsg = CMSG_NXTHDR(&message, cmsg)) {
 
@@ -285,6 +362,14 @@ HotRestartImpl::RpcBase* HotRestartImpl::receiveRpc(bool block) {
 
       reinterpret_cast<RpcGetListenSocketReply*>(rpc)->fd_ =
           *reinterpret_cast<int*>(CMSG_DATA(cmsg));
+    } else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+               rpc->type_ == RpcMessageType::GetListenSocketsReply) {
+
+      RpcGetListenSocketsReply* reply = reinterpret_cast<RpcGetListenSocketsReply*>(rpc);
+      RELEASE_ASSERT(cmsg->cmsg_len == CMSG_LEN(sizeof(int) * reply->num_sockets_));
+      for (uint32_t i = 0; i < reply->num_sockets_; i++) {
+        reply->fds_[i] = reinterpret_cast<int*>(CMSG_DATA(cmsg))[i];
+      }
     } else {
       RELEASE_ASSERT(false);
     }
@@ -293,7 +378,7 @@ HotRestartImpl::RpcBase* HotRestartImpl::receiveRpc(bool block) {
   return rpc;
 }
 
-void HotRestartImpl::sendMessage(sockaddr_un& address, RpcBase& rpc) {
+void HotRestartImpl::sendMessage(sockaddr_un& address, RpcBase& rpc, const std::vector<int>& fds) {
   iovec iov[1];
   iov[0].iov_base = &rpc;
   iov[0].iov_len = rpc.length_;
@@ -304,6 +389,22 @@ void HotRestartImpl::sendMessage(sockaddr_un& address, RpcBase& rpc) {
   message.msg_namelen = sizeof(address);
   message.msg_iov = iov;
   message.msg_iovlen = 1;
+
+  // The fds, if any, are duplicated into the receiving process as SCM_RIGHTS control data.
+  ASSERT(fds.size() <= MAX_SOCKETS_PER_REPLY);
+  uint8_t control_buffer[CMSG_SPACE(sizeof(int) * MAX_SOCKETS_PER_REPLY)];
+  if (!fds.empty()) {
+    memset(control_buffer, 0, sizeof(control_buffer));
+    message.msg_control = control_buffer;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+    cmsghdr* control_message = CMSG_FIRSTHDR(&message);
+    control_message->cmsg_level = SOL_SOCKET;
+    control_message->cmsg_type = SCM_RIGHTS;
+    control_message->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(control_message), fds.data(), sizeof(int) * fds.size());
+  }
+
   int rc = sendmsg(my_domain_socket_, &message, 0);
   RELEASE_ASSERT(rc != -1);
   UNREFERENCED_PARAMETER(rc);
@@ -317,7 +418,7 @@ void HotRestartImpl::onGetListenSocket(RpcGetListenSocketRequest& rpc) {
       Network::Utility::resolveUrl(std::string(rpc.address_));
   for (const auto& listener : server_->listenerManager().listeners()) {
     if (*listener.get().socket().localAddress() == *addr) {
-      reply.fd_ = listener.get().socket().fd();
+      reply.fd_ = listener.get().workerSocket(rpc.worker_index_).fd();
       break;
     }
   }
@@ -326,32 +427,52 @@ void HotRestartImpl::onGetListenSocket(RpcGetListenSocketRequest& rpc) {
     // In this case there is no fd to duplicate so we just send a normal message.
     sendMessage(child_address_, reply);
   } else {
-    iovec iov[1];
-    iov[0].iov_base = &reply;
-    iov[0].iov_len = reply.length_;
-
-    uint8_t control_buffer[CMSG_SPACE(sizeof(int))];
-    memset(control_buffer, 0, CMSG_SPACE(sizeof(int)));
-
-    msghdr message;
-    memset(&message, 0, sizeof(message));
-    message.msg_name = &child_address_;
-    message.msg_namelen = sizeof(child_address_);
-    message.msg_iov = iov;
-    message.msg_iovlen = 1;
-    message.msg_control = control_buffer;
-    message.msg_controllen = CMSG_SPACE(sizeof(int));
+    sendMessage(child_address_, reply, {reply.fd_});
+  }
+}
 
-    cmsghdr* control_message = CMSG_FIRSTHDR(&message);
-    control_message->cmsg_level = SOL_SOCKET;
-    control_message->cmsg_type = SCM_RIGHTS;
-    control_message->cmsg_len = CMSG_LEN(sizeof(int));
-    *reinterpret_cast<int*>(CMSG_DATA(control_message)) = reply.fd_;
+void HotRestartImpl::onGetListenSockets(RpcGetListenSocketsRequest& rpc) {
+  // The sockets are numbered in the order of the listeners and then of the workers, so that the
+  // child can ask for the batch that follows the last one. Workers that share the socket of worker
+  // 0 are skipped, as the child falls back to it.
+  RpcGetListenSocketsReply reply;
+  std::vector<int> fds;
+  uint32_t index = 0;
+  for (const auto& listener : server_->listenerManager().listeners()) {
+    const Network::Address::InstanceConstSharedPtr& address =
+        listener.get().socket().localAddress();
+    if (address->type() != Network::Address::Type::Ip) {
+      continue;
+    }
 
-    int rc = sendmsg(my_domain_socket_, &message, 0);
-    RELEASE_ASSERT(rc != -1);
-    UNREFERENCED_PARAMETER(rc);
+    for (uint32_t worker_index = 0; worker_index < options_.concurrency(); worker_index++) {
+      const int fd = listener.get().workerSocket(worker_index).fd();
+      if (worker_index > 0 && fd == listener.get().workerSocket(0).fd()) {
+        continue;
+      }
+
+      if (index++ < rpc.start_index_) {
+        continue;
+      }
+
+      if (reply.num_sockets_ == MAX_SOCKETS_PER_REPLY) {
+        reply.next_index_ = index - 1;
+        break;
+      }
+
+      RpcListenSocket& socket = reply.sockets_[reply.num_sockets_++];
+      ASSERT(address->asString().length() < sizeof(socket.address_));
+      StringUtil::strlcpy(socket.address_, address->asString().c_str(), sizeof(socket.address_));
+      socket.worker_index_ = worker_index;
+      fds.push_back(fd);
+    }
+
+    if (reply.next_index_ != 0) {
+      break;
+    }
   }
+
+  sendMessage(child_address_, reply, fds);
 }
 
 void HotRestartImpl::onSocketEvent() {
@@ -377,6 +498,13 @@ void HotRestartImpl::onSocketEvent() {
       break;
     }
 
+    case RpcMessageType::GetListenSocketsRequest: {
+      RpcGetListenSocketsRequest* message =
+          reinterpret_cast<RpcGetListenSocketsRequest*>(base_message);
+      onGetListenSockets(*message);
+      break;
+    }
+
     case RpcMessageType::GetStatsRequest: {
       GetParentStatsInfo info;
       server_->getParentStats(info);
@@ -433,7 +561,7 @@ void HotRestartImpl::terminateParent() {
 
 void HotRestartImpl::shutdown() { socket_event_.reset(); }
 
-std::string HotRestartImpl::version() { return SharedMemory::version(); }
+std::string HotRestartImpl::version() { return SharedMemory::version(options_.maxStats()); }
 
 } // namespace Server
 } // namespace Envoy
@@ -6,7 +6,10 @@
 #include <array>
 #include <atomic>
 #include <cstdint>
+#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "envoy/server/hot_restart.h"
 #include "envoy/server/options.h"
@@ -14,16 +17,23 @@
 #include "common/common/assert.h"
 #include "common/stats/stats_impl.h"
 
+#include "server/shared_memory_stat_set.h"
+
 namespace Envoy {
 namespace Server {
 
 /**
  * Shared memory segment. This structure is laid directly into shared memory and is used amongst
- * all running envoy processes.
+ * all running envoy processes. It is immediately followed in the mapping by the stats region,
+ * whose size depends on the --max-stats option.
  */
 class SharedMemory {
 public:
-  static std::string version();
+  /**
+   * @param max_stats supplies the capacity of the shared memory stats region.
+   * @return std::string the hot restart compatibility version for the given stats capacity.
+   */
+  static std::string version(uint32_t max_stats);
 
 private:
   struct Flags {
@@ -43,6 +53,16 @@ private:
    */
   void initializeMutex(pthread_mutex_t& mutex);
 
+  /**
+   * @return uint64_t the total size of the mapping for the given stats capacity.
+   */
+  static uint64_t totalSize(uint32_t max_stats);
+
+  /**
+   * @return uint8_t* the start of the stats region that follows this structure.
+   */
+  uint8_t* statsRegion() { return reinterpret_cast<uint8_t*>(this) + sizeof(SharedMemory); }
+
   static const uint64_t VERSION;
 
   uint64_t size_;
@@ -52,7 +72,7 @@ private:
   pthread_mutex_t access_log_lock_;
   pthread_mutex_t stat_lock_;
   pthread_mutex_t init_lock_;
-  std::array<Stats::RawStatData, 16384> stats_slots_;
+  uint32_t max_stats_;
 
   friend class HotRestartImpl;
 };
@@ -113,7 +133,7 @@ public:
 
   // Server::HotRestart
   void drainParentListeners() override;
-  int duplicateParentListenSocket(const std::string& address) override;
+  int duplicateParentListenSocket(const std::string& address, uint32_t worker_index) override;
   void getParentStats(GetParentStatsInfo& info) override;
   void initialize(Event::Dispatcher& dispatcher, Server::Instance& server) override;
   void shutdownParentAdmin(ShutdownParentAdminInfo& info) override;
@@ -135,7 +155,9 @@ private:
     TerminateRequest = 6,
     UnknownRequestReply = 7,
     GetStatsRequest = 8,
-    GetStatsReply = 9
+    GetStatsReply = 9,
+    GetListenSocketsRequest = 10,
+    GetListenSocketsReply = 11
   };
 
   struct RpcBase {
@@ -150,6 +172,7 @@ private:
     RpcGetListenSocketRequest() : RpcBase(RpcMessageType::GetListenSocketRequest, sizeof(*this)) {}
 
     char address_[256]{0};
+    uint32_t worker_index_{0};
   } __attribute__((packed));
 
   struct RpcGetListenSocketReply : public RpcBase {
@@ -158,6 +181,33 @@ private:
     int fd_{0};
   } __attribute__((packed));
 
+  struct RpcGetListenSocketsRequest : public RpcBase {
+    RpcGetListenSocketsRequest()
+        : RpcBase(RpcMessageType::GetListenSocketsRequest, sizeof(*this)) {}
+
+    uint32_t start_index_{0};
+  } __attribute__((packed));
+
+  struct RpcListenSocket {
+    char address_[256]{0};
+    uint32_t worker_index_{0};
+  } __attribute__((packed));
+
+  // A reply passes up to this many sockets, which is well below the SCM_RIGHTS limit of the
+  // kernel (253).
+  static const uint32_t MAX_SOCKETS_PER_REPLY = 64;
+
+  struct RpcGetListenSocketsReply : public RpcBase {
+    RpcGetListenSocketsReply() : RpcBase(RpcMessageType::GetListenSocketsReply, sizeof(*this)) {}
+
+    // The index to request the next batch from, or 0 if this is the last batch.
+    uint32_t next_index_{0};
+    uint32_t num_sockets_{0};
+    RpcListenSocket sockets_[MAX_SOCKETS_PER_REPLY];
+    // Filled in from the control data on receipt, in the order of sockets_.
+    int fds_[MAX_SOCKETS_PER_REPLY]{};
+  } __attribute__((packed));
+
   struct RpcShutdownAdminReply : public RpcBase {
     RpcShutdownAdminReply() : RpcBase(RpcMessageType::ShutdownAdminReply, sizeof(*this)) {}
 
@@ -180,11 +230,14 @@ private:
   }
 
   int bindDomainSocket(uint64_t id);
+  void closeParentListenSockets();
   sockaddr_un createDomainSocketAddress(uint64_t id);
+  void fetchParentListenSockets();
   void onGetListenSocket(RpcGetListenSocketRequest& rpc);
+  void onGetListenSockets(RpcGetListenSocketsRequest& rpc);
   void onSocketEvent();
   RpcBase* receiveRpc(bool block);
-  void sendMessage(sockaddr_un& address, RpcBase& rpc);
+  void sendMessage(sockaddr_un& address, RpcBase& rpc, const std::vector<int>& fds = {});
 
   Options& options_;
   SharedMemory& shmem_;
@@ -192,13 +245,22 @@ private:
   ProcessSharedMutex access_log_lock_;
   ProcessSharedMutex stat_lock_;
   ProcessSharedMutex init_lock_;
+  SharedMemoryStatSet stats_set_;
   int my_domain_socket_{-1};
   sockaddr_un parent_address_;
   sockaddr_un child_address_;
   Event::FileEventPtr socket_event_;
-  std::array<uint8_t, 4096> rpc_buffer_;
+  std::array<uint8_t, sizeof(RpcGetListenSocketsReply)> rpc_buffer_;
   Server::Instance* server_{};
   bool parent_terminated_{};
+  // The listen sockets of the parent, fetched in batches on the first request for one and keyed by
+  // address and worker index. They are duplicated as they are handed out, and closed once the
+  // parent is asked to drain.
+  enum class ParentSocketsState { NotFetched, Fetched, Unavailable };
+  ParentSocketsState parent_sockets_state_{ParentSocketsState::NotFetched};
+  std::map<std::pair<std::string, uint32_t>, int> parent_sockets_;
+
+  friend class HotRestartImplTest;
 };
 
 } // namespace Server
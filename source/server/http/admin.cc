@@ -1,8 +1,12 @@
 #include "server/http/admin.h"
 
+#include <algorithm>
+#include <cctype>
 #include <cstdint>
 #include <fstream>
+#include <limits>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "envoy/filesystem/filesystem.h"
@@ -16,6 +20,7 @@
 #include "common/buffer/buffer_impl.h"
 #include "common/common/assert.h"
 #include "common/common/enum_to_int.h"
+#include "common/common/regex.h"
 #include "common/common/utility.h"
 #include "common/common/version.h"
 #include "common/http/access_log/access_log_formatter.h"
@@ -25,6 +30,7 @@
 #include "common/http/headers.h"
 #include "common/http/http1/codec_impl.h"
 #include "common/json/json_loader.h"
+#include "common/memory/allocation_tracker.h"
 #include "common/network/listen_socket_impl.h"
 #include "common/profiler/profiler.h"
 #include "common/router/config_impl.h"
@@ -36,7 +42,161 @@
 namespace Envoy {
 namespace Server {
 
-AdminFilter::AdminFilter(AdminImpl& parent) : parent_(parent) {}
+namespace {
+
+// Responses cross between the main and admin threads as strings, so that the buffers of a thread
+// are only used by it.
+std::string bufferToString(Buffer::Instance& buffer) {
+  const uint64_t length = buffer.length();
+  return length == 0 ? "" : std::string(static_cast<const char*>(buffer.linearize(length)), length);
+}
+
+} // namespace
+
+StatsRenderer::StatsRenderer(Stats::Store& store, Format format, NameFilter filter)
+    : format_(format) {
+  // Prometheus groups the stats that only differ in their tags under one metric, which must be
+  // rendered together.
+  auto by_name = [format](const Entry& a, const Entry& b) -> bool {
+    if (format == Format::Prometheus && a.tag_extracted_name_ != b.tag_extracted_name_) {
+      return a.tag_extracted_name_ < b.tag_extracted_name_;
+    }
+    return a.name_ < b.name_;
+  };
+  for (const Stats::CounterSharedPtr& counter : store.counters()) {
+    std::string name = counter->name();
+    if (filter(name)) {
+      entries_.push_back({std::move(name), counter->tagExtractedName(), counter, nullptr, nullptr});
+    }
+  }
+  for (const Stats::GaugeSharedPtr& gauge : store.gauges()) {
+    std::string name = gauge->name();
+    if (filter(name)) {
+      entries_.push_back({std::move(name), gauge->tagExtractedName(), nullptr, gauge, nullptr});
+    }
+  }
+  std::sort(entries_.begin(), entries_.end(), by_name);
+
+  const size_t num_values = entries_.size();
+  for (const Stats::ParentHistogramSharedPtr& histogram : store.histograms()) {
+    std::string name = histogram->name();
+    if (histogram->used() && filter(name)) {
+      entries_.push_back(
+          {std::move(name), histogram->tagExtractedName(), nullptr, nullptr, histogram});
+    }
+  }
+  std::sort(entries_.begin() + num_values, entries_.end(), by_name);
+}
+
+bool StatsRenderer::nextBatch(Buffer::Instance& response, size_t max_stats) {
+  const size_t end = next_entry_ + std::min(max_stats, entries_.size() - next_entry_);
+  for (; next_entry_ < end; next_entry_++) {
+    if (format_ == Format::Prometheus) {
+      // The type of a metric is only rendered before its first stat.
+      const bool render_type =
+          next_entry_ == 0 || !sameMetric(entries_[next_entry_], entries_[next_entry_ - 1]);
+      renderPrometheus(entries_[next_entry_], render_type, response);
+    } else {
+      renderText(entries_[next_entry_], response);
+    }
+  }
+
+  return next_entry_ == entries_.size();
+}
+
+const std::string& StatsRenderer::contentType() const {
+  if (format_ == Format::Prometheus) {
+    CONSTRUCT_ON_FIRST_USE(std::string, "text/plain; version=0.0.4");
+  }
+  return Http::Headers::get().ContentTypeValues.Text;
+}
+
+std::string StatsRenderer::prometheusName(const std::string& name) {
+  std::string prometheus_name = "envoy_" + name;
+  for (char& c : prometheus_name) {
+    if (!isalnum(static_cast<unsigned char>(c)) && c != '_' && c != ':') {
+      c = '_';
+    }
+  }
+  return prometheus_name;
+}
+
+bool StatsRenderer::sameMetric(const Entry& a, const Entry& b) {
+  return a.tag_extracted_name_ == b.tag_extracted_name_ && !a.counter_ == !b.counter_ &&
+         !a.gauge_ == !b.gauge_;
+}
+
+std::string StatsRenderer::prometheusLabels(const std::vector<Stats::Tag>& tags) {
+  std::string labels;
+  for (const Stats::Tag& tag : tags) {
+    std::string label_name = tag.name_;
+    for (char& c : label_name) {
+      if (!isalnum(static_cast<unsigned char>(c)) && c != '_') {
+        c = '_';
+      }
+    }
+    std::string label_value;
+    for (char c : tag.value_) {
+      if (c == '\\' || c == '"') {
+        label_value += '\\';
+      }
+      label_value += c == '\n' ? std::string("\\n") : std::string(1, c);
+    }
+    labels += fmt::format("{}{}=\"{}\"", labels.empty() ? "" : ",", label_name, label_value);
+  }
+  return labels;
+}
+
+void StatsRenderer::renderText(const Entry& entry, Buffer::Instance& response) {
+  if (entry.counter_) {
+    response.add(fmt::format("{}: {}\n", entry.name_, entry.counter_->value()));
+  } else if (entry.gauge_) {
+    response.add(fmt::format("{}: {}\n", entry.name_, entry.gauge_->value()));
+  } else {
+    response.add(fmt::format("{}: {}\n", entry.name_,
+                             entry.histogram_->cumulativeStatistics().summary()));
+  }
+}
+
+void StatsRenderer::renderPrometheus(const Entry& entry, bool render_type,
+                                     Buffer::Instance& response) {
+  const std::string name = prometheusName(entry.tag_extracted_name_);
+  if (!entry.histogram_) {
+    const std::string labels =
+        prometheusLabels(entry.counter_ ? entry.counter_->tags() : entry.gauge_->tags());
+    if (render_type) {
+      response.add(fmt::format("# TYPE {} {}\n", name, entry.counter_ ? "counter" : "gauge"));
+    }
+    response.add(fmt::format("{}{} {}\n", name, labels.empty() ? "" : "{" + labels + "}",
+                             entry.counter_ ? entry.counter_->value() : entry.gauge_->value()));
+  } else {
+    const Stats::HistogramStatistics& statistics = entry.histogram_->cumulativeStatistics();
+    const std::string labels = prometheusLabels(entry.histogram_->tags());
+    // The labels of the bucket lines are followed by le, the others only have the tags.
+    const std::string bucket_labels = labels.empty() ? "" : labels + ",";
+    const std::string sum_labels = labels.empty() ? "" : "{" + labels + "}";
+    std::string lines = render_type ? fmt::format("# TYPE {} histogram\n", name) : "";
+    for (size_t i = 0; i < statistics.supportedBuckets().size(); i++) {
+      lines += fmt::format("{}_bucket{{{}le=\"{}\"}} {}\n", name, bucket_labels,
+                           statistics.supportedBuckets()[i], statistics.computedBuckets()[i]);
+    }
+    lines += fmt::format("{0}_bucket{{{1}le=\"+Inf\"}} {2}\n{0}_sum{3} {4}\n{0}_count{3} {2}\n",
+                         name, bucket_labels, statistics.sampleCount(), sum_labels,
+                         statistics.sampleSum());
+    response.add(lines);
+  }
+}
+
+AdminFilter::AdminFilter(AdminImpl& parent)
+    : parent_(parent), handle_(std::make_shared<AdminFilter*>(this)) {}
+
+void AdminFilter::onDestroy() {
+  *handle_ = nullptr;
+  if (stats_renderer_) {
+    callbacks_->removeDownstreamWatermarkCallbacks(*this);
+    stats_renderer_.reset();
+  }
+}
 
 Http::FilterHeadersStatus AdminFilter::decodeHeaders(Http::HeaderMap& headers, bool end_stream) {
   request_headers_ = &headers;
@@ -115,6 +275,10 @@ void AdminImpl::addOutlierInfo(const std::string& cluster_name,
                              outlier_detector->successRateAverage()));
     response.add(fmt::format("{}::outlier::success_rate_ejection_threshold::{}\n", cluster_name,
                              outlier_detector->successRateEjectionThreshold()));
+    response.add(fmt::format("{}::outlier::latency_average::{}\n", cluster_name,
+                             outlier_detector->latencyAverage()));
+    response.add(fmt::format("{}::outlier::latency_ejection_threshold::{}\n", cluster_name,
+                             outlier_detector->latencyEjectionThreshold()));
   }
 }
 
@@ -131,48 +295,66 @@ void AdminImpl::addCircuitSettings(const std::string& cluster_name, const std::s
                            resource_manager.retries().max()));
 }
 
-Http::Code AdminImpl::handlerClusters(const std::string&, Buffer::Instance& response) {
+ClustersSnapshotConstSharedPtr AdminImpl::snapshotClusters() {
+  std::shared_ptr<ClustersSnapshot> snapshot = std::make_shared<ClustersSnapshot>();
   for (auto& cluster : server_.clusterManager().clusters()) {
-    addOutlierInfo(cluster.second.get().info()->name(), cluster.second.get().outlierDetector(),
-                   response);
-
+    const std::string& name = cluster.second.get().info()->name();
+    Buffer::OwnedImpl settings;
+    addOutlierInfo(name, cluster.second.get().outlierDetector(), settings);
     addCircuitSettings(
-        cluster.second.get().info()->name(), "default",
+        name, "default",
         cluster.second.get().info()->resourceManager(Upstream::ResourcePriority::Default),
-        response);
+        settings);
     addCircuitSettings(
-        cluster.second.get().info()->name(), "high",
-        cluster.second.get().info()->resourceManager(Upstream::ResourcePriority::High), response);
+        name, "high",
+        cluster.second.get().info()->resourceManager(Upstream::ResourcePriority::High), settings);
 
+    snapshot->push_back({name, bufferToString(settings), {}});
     for (auto& host : cluster.second.get().hosts()) {
+      snapshot->back().hosts_.push_back({host, Upstream::HostUtility::healthFlagsToString(*host),
+                                         host->weight(), host->outlierDetector().successRate(),
+                                         host->outlierDetector().latency()});
+    }
+  }
+
+  return snapshot;
+}
+
+void AdminImpl::renderClusters(const ClustersSnapshot& snapshot, Buffer::Instance& response) {
+  for (const ClusterSnapshot& cluster : snapshot) {
+    response.add(cluster.settings_);
+
+    for (const ClusterSnapshot::HostSnapshot& host : cluster.hosts_) {
       std::map<std::string, uint64_t> all_stats;
-      for (const Stats::CounterSharedPtr& counter : host->counters()) {
+      for (const Stats::CounterSharedPtr& counter : host.host_->counters()) {
         all_stats[counter->name()] = counter->value();
       }
 
-      for (const Stats::GaugeSharedPtr& gauge : host->gauges()) {
+      for (const Stats::GaugeSharedPtr& gauge : host.host_->gauges()) {
         all_stats[gauge->name()] = gauge->value();
       }
 
+      const std::string address = host.host_->address()->asString();
       for (auto stat : all_stats) {
-        response.add(fmt::format("{}::{}::{}::{}\n", cluster.second.get().info()->name(),
-                                 host->address()->asString(), stat.first, stat.second));
+        response.add(
+            fmt::format("{}::{}::{}::{}\n", cluster.name_, address, stat.first, stat.second));
       }
 
-      response.add(fmt::format("{}::{}::health_flags::{}\n", cluster.second.get().info()->name(),
-                               host->address()->asString(),
-                               Upstream::HostUtility::healthFlagsToString(*host)));
-      response.add(fmt::format("{}::{}::weight::{}\n", cluster.second.get().info()->name(),
-                               host->address()->asString(), host->weight()));
-      response.add(fmt::format("{}::{}::zone::{}\n", cluster.second.get().info()->name(),
-                               host->address()->asString(), host->zone()));
-      response.add(fmt::format("{}::{}::canary::{}\n", cluster.second.get().info()->name(),
-                               host->address()->asString(), host->canary()));
-      response.add(fmt::format("{}::{}::success_rate::{}\n", cluster.second.get().info()->name(),
-                               host->address()->asString(), host->outlierDetector().successRate()));
+      response.add(
+          fmt::format("{}::{}::health_flags::{}\n", cluster.name_, address, host.health_flags_));
+      response.add(fmt::format("{}::{}::weight::{}\n", cluster.name_, address, host.weight_));
+      response.add(fmt::format("{}::{}::zone::{}\n", cluster.name_, address, host.host_->zone()));
+      response.add(
+          fmt::format("{}::{}::canary::{}\n", cluster.name_, address, host.host_->canary()));
+      response.add(fmt::format("{}::{}::success_rate::{}\n", cluster.name_, address,
+                               host.success_rate_));
+      response.add(fmt::format("{}::{}::latency::{}\n", cluster.name_, address, host.latency_));
     }
   }
+}
 
+Http::Code AdminImpl::handlerClusters(const std::string&, Buffer::Instance& response) {
+  renderClusters(*snapshotClusters(), response);
   return Http::Code::OK;
 }
 
@@ -199,6 +381,48 @@ Http::Code AdminImpl::handlerCpuProfiler(const std::string& url, Buffer::Instanc
   return Http::Code::OK;
 }
 
+Http::Code AdminImpl::handlerCpuSampler(const std::string& url, Buffer::Instance& response) {
+  Http::Utility::QueryParams query_params = Http::Utility::parseQueryString(url);
+  auto enable = query_params.find("enable");
+  auto hz_param = query_params.find("hz");
+  uint64_t hz = DEFAULT_SAMPLER_HZ;
+  if (enable == query_params.end() || (enable->second != "y" && enable->second != "n") ||
+      query_params.size() != (hz_param == query_params.end() ? 1U : 2U) ||
+      (hz_param != query_params.end() &&
+       (!StringUtil::atoul(hz_param->second.c_str(), hz) || hz == 0 || hz > MAX_SAMPLER_HZ))) {
+    response.add("?enable=<y|n>&hz=<1-1000>\n");
+    return Http::Code::BadRequest;
+  }
+
+  if (enable->second == "y" && !Profiler::CpuSampler::running()) {
+    if (!Profiler::CpuSampler::start(hz)) {
+      response.add("failure to start the sampler\n");
+      return Http::Code::InternalServerError;
+    }
+  } else if (enable->second == "n") {
+    Profiler::CpuSampler::stop();
+  }
+
+  response.add("OK\n");
+  return Http::Code::OK;
+}
+
+Http::Code AdminImpl::handlerCpuSamples(const std::string&, Buffer::Instance& response) {
+  response.add(Profiler::CpuSampler::profile());
+  return Http::Code::OK;
+}
+
+Http::Code AdminImpl::handlerHeapProfiler(const std::string&, Buffer::Instance& response) {
+  std::string profile;
+  if (!Profiler::Heap::heapSample(profile)) {
+    response.add("heap samples require tcmalloc\n");
+    return Http::Code::NotImplemented;
+  }
+
+  response.add(profile);
+  return Http::Code::OK;
+}
+
 Http::Code AdminImpl::handlerHealthcheckFail(const std::string&, Buffer::Instance& response) {
   server_.failHealthcheck(true);
   response.add("OK\n");
@@ -250,6 +474,26 @@ Http::Code AdminImpl::handlerResetCounters(const std::string&, Buffer::Instance&
   return Http::Code::OK;
 }
 
+Http::Code AdminImpl::handlerRuntimeModify(const std::string& url, Buffer::Instance& response) {
+  Http::Utility::QueryParams query_params = Http::Utility::parseQueryString(url);
+  if (query_params.empty()) {
+    response.add("usage: /runtime_modify?<key>=<value>[&<key>=<value>...] (set values)\n");
+    response.add("usage: /runtime_modify?<key>= (remove a previously set value)\n");
+    return Http::Code::BadRequest;
+  }
+
+  std::unordered_map<std::string, std::string> values(query_params.begin(), query_params.end());
+  try {
+    server_.runtime().mergeValues(values);
+  } catch (const EnvoyException& e) {
+    response.add(fmt::format("{}\n", e.what()));
+    return Http::Code::ServiceUnavailable;
+  }
+
+  response.add("OK\n");
+  return Http::Code::OK;
+}
+
 Http::Code AdminImpl::handlerServerInfo(const std::string&, Buffer::Instance& response) {
   time_t current_time = time(nullptr);
   response.add(fmt::format("envoy {} {} {} {} {}\n", VersionInfo::version(),
@@ -260,22 +504,48 @@ Http::Code AdminImpl::handlerServerInfo(const std::string&, Buffer::Instance& re
   return Http::Code::OK;
 }
 
-Http::Code AdminImpl::handlerStats(const std::string&, Buffer::Instance& response) {
-  // We currently don't support timers locally (only via statsd) so just group all the counters
-  // and gauges together, alpha sort them, and spit them out.
-  std::map<std::string, uint64_t> all_stats;
-  for (const Stats::CounterSharedPtr& counter : server_.stats().counters()) {
-    all_stats.emplace(counter->name(), counter->value());
+StatsRendererPtr AdminImpl::createStatsRenderer(const std::string& url,
+                                                Buffer::Instance& response) {
+  StatsRenderer::Format format = StatsRenderer::Format::Text;
+  std::string prefix;
+  std::shared_ptr<const Regex::CompiledMatcher> regex;
+  for (const auto& param : Http::Utility::parseQueryString(url)) {
+    if (param.first == "format" && param.second == "prometheus") {
+      format = StatsRenderer::Format::Prometheus;
+    } else if (param.first == "format" && param.second == "text") {
+      format = StatsRenderer::Format::Text;
+    } else if (param.first == "prefix") {
+      prefix = param.second;
+    } else if (param.first == "filter") {
+      // The filter comes from admin clients, so it is compiled with RE2, which matches in linear
+      // time and reports invalid expressions instead of throwing from the match.
+      try {
+        regex = Regex::Utility::parseRegex(param.second);
+      } catch (const EnvoyException& e) {
+        response.add(fmt::format("invalid filter: {}\n", e.what()));
+        return nullptr;
+      }
+    } else {
+      response.add("?format=<text|prometheus>&prefix=<string>&filter=<regex>\n");
+      return nullptr;
+    }
   }
 
-  for (const Stats::GaugeSharedPtr& gauge : server_.stats().gauges()) {
-    all_stats.emplace(gauge->name(), gauge->value());
-  }
+  return StatsRendererPtr{
+      new StatsRenderer(server_.stats(), format, [prefix, regex](const std::string& name) -> bool {
+        return name.compare(0, prefix.size(), prefix) == 0 && (!regex || regex->search(name));
+      })};
+}
 
-  for (auto stat : all_stats) {
-    response.add(fmt::format("{}: {}\n", stat.first, stat.second));
+Http::Code AdminImpl::handlerStats(const std::string& url, Buffer::Instance& response) {
+  // The admin filter streams /stats responses itself. This renders the whole response at once for
+  // other callers of runCallback().
+  StatsRendererPtr renderer = createStatsRenderer(url, response);
+  if (!renderer) {
+    return Http::Code::BadRequest;
   }
 
+  renderer->nextBatch(response, std::numeric_limits<size_t>::max());
   return Http::Code::OK;
 }
 
@@ -294,6 +564,37 @@ Http::Code AdminImpl::handlerListenerInfo(const std::string&, Buffer::Instance&
   return Http::Code::OK;
 }
 
+Http::Code AdminImpl::handlerAllocationTracker(const std::string& url,
+                                                Buffer::Instance& response) {
+  Http::Utility::QueryParams query_params = Http::Utility::parseQueryString(url);
+  if (query_params.size() != 1 || query_params.begin()->first != "enable" ||
+      (query_params.begin()->second != "y" && query_params.begin()->second != "n")) {
+    response.add("?enable=<y|n>\n");
+    return Http::Code::BadRequest;
+  }
+
+  if (query_params.begin()->second == "y") {
+    if (!Memory::AllocationTracker::enable()) {
+      response.add("allocation tracking requires tcmalloc\n");
+      return Http::Code::NotImplemented;
+    }
+  } else {
+    Memory::AllocationTracker::disable();
+  }
+
+  response.add("OK\n");
+  return Http::Code::OK;
+}
+
+Http::Code AdminImpl::handlerAllocations(const std::string&, Buffer::Instance& response) {
+  response.add(fmt::format("tracking: {}\n", Memory::AllocationTracker::enabled() ? "on" : "off"));
+  for (const Memory::ThreadAllocationCounts& thread : Memory::AllocationTracker::threadCounts()) {
+    response.add(fmt::format("{}: {} allocations, {} bytes\n", thread.name_,
+                             thread.counts_.allocations_, thread.counts_.bytes_));
+  }
+  return Http::Code::OK;
+}
+
 Http::Code AdminImpl::handlerCerts(const std::string&, Buffer::Instance& response) {
   // This set is used to track distinct certificates. We may have multiple listeners, upstreams, etc
   // using the same cert.
@@ -316,9 +617,44 @@ void AdminFilter::onComplete() {
   std::string path = request_headers_->Path()->value().c_str();
   ENVOY_STREAM_LOG(info, "request complete: path: {}", *callbacks_, path);
 
-  Buffer::OwnedImpl response;
-  Http::Code code = parent_.runCallback(path, response);
+  if (path == "/stats" || path.find("/stats?") == 0) {
+    streamStats(path);
+    return;
+  }
+
+  // The main thread only copies the state of the clusters, since the response is large on
+  // servers with many hosts.
+  std::shared_ptr<AdminFilter*> handle = handle_;
+  Event::Dispatcher& dispatcher = callbacks_->dispatcher();
+  AdminImpl& parent = parent_;
+  if (path == "/clusters" || path.find("/clusters?") == 0) {
+    parent_.mainDispatcher().post([handle, &dispatcher, &parent]() -> void {
+      ClustersSnapshotConstSharedPtr snapshot = parent.snapshotClusters();
+      dispatcher.post([handle, snapshot]() -> void {
+        if (*handle) {
+          Buffer::OwnedImpl response;
+          AdminImpl::renderClusters(*snapshot, response);
+          (*handle)->sendResponse(Http::Code::OK, response);
+        }
+      });
+    });
+    return;
+  }
+
+  parent_.mainDispatcher().post([handle, &dispatcher, &parent, path]() -> void {
+    Buffer::OwnedImpl response;
+    const Http::Code code = parent.runCallback(path, response);
+    const std::string body = bufferToString(response);
+    dispatcher.post([handle, code, body]() -> void {
+      if (*handle) {
+        Buffer::OwnedImpl response(body);
+        (*handle)->sendResponse(code, response);
+      }
+    });
+  });
+}
 
+void AdminFilter::sendResponse(Http::Code code, Buffer::Instance& response) {
   Http::HeaderMapPtr headers{
       new Http::HeaderMapImpl{{Http::Headers::get().Status, std::to_string(enumToInt(code))}}};
   callbacks_->encodeHeaders(std::move(headers), response.length() == 0);
@@ -328,6 +664,83 @@ void AdminFilter::onComplete() {
   }
 }
 
+void AdminFilter::streamStats(const std::string& path) {
+  std::shared_ptr<AdminFilter*> handle = handle_;
+  Event::Dispatcher& dispatcher = callbacks_->dispatcher();
+  AdminImpl& parent = parent_;
+  parent_.mainDispatcher().post([handle, &dispatcher, &parent, path]() -> void {
+    Buffer::OwnedImpl error;
+    StatsRendererSharedPtr renderer = parent.createStatsRenderer(path, error);
+    const std::string body = bufferToString(error);
+    dispatcher.post([handle, renderer, body]() -> void {
+      if (*handle) {
+        (*handle)->onStatsRenderer(renderer, body);
+      }
+    });
+  });
+}
+
+void AdminFilter::onStatsRenderer(StatsRendererSharedPtr renderer, const std::string& error) {
+  if (!renderer) {
+    Http::HeaderMapPtr headers{new Http::HeaderMapImpl{
+        {Http::Headers::get().Status, std::to_string(enumToInt(Http::Code::BadRequest))}}};
+    callbacks_->encodeHeaders(std::move(headers), false);
+    Buffer::OwnedImpl response(error);
+    callbacks_->encodeData(response, true);
+    return;
+  }
+
+  // The response has no content length, so HTTP/1.1 sends it chunked as the batches are rendered.
+  stats_renderer_ = renderer;
+  Http::HeaderMapPtr headers{new Http::HeaderMapImpl{
+      {Http::Headers::get().Status, std::to_string(enumToInt(Http::Code::OK))},
+      {Http::Headers::get().ContentType, stats_renderer_->contentType()}}};
+  callbacks_->addDownstreamWatermarkCallbacks(*this);
+  callbacks_->encodeHeaders(std::move(headers), false);
+  requestStatsBatch();
+}
+
+void AdminFilter::requestStatsBatch() {
+  // The renderer is shared with the post, so it outlives a stream that is destroyed while the
+  // main thread renders a batch.
+  std::shared_ptr<AdminFilter*> handle = handle_;
+  Event::Dispatcher& dispatcher = callbacks_->dispatcher();
+  StatsRendererSharedPtr renderer = stats_renderer_;
+  batch_in_flight_ = true;
+  parent_.mainDispatcher().post([handle, &dispatcher, renderer]() -> void {
+    Buffer::OwnedImpl response;
+    const bool done = renderer->nextBatch(response, STATS_PER_BATCH);
+    const std::string batch = bufferToString(response);
+    dispatcher.post([handle, batch, done]() -> void {
+      if (*handle) {
+        (*handle)->onStatsBatch(batch, done);
+      }
+    });
+  });
+}
+
+void AdminFilter::onStatsBatch(const std::string& batch, bool done) {
+  batch_in_flight_ = false;
+  if (done) {
+    callbacks_->removeDownstreamWatermarkCallbacks(*this);
+    stats_renderer_.reset();
+  }
+  Buffer::OwnedImpl response(batch);
+  callbacks_->encodeData(response, done);
+
+  // While the client is not keeping up, the next batch waits for the connection to drain.
+  if (!done && !above_high_watermark_) {
+    requestStatsBatch();
+  }
+}
+
+void AdminFilter::onBelowWriteBufferLowWatermark() {
+  above_high_watermark_ = false;
+  if (stats_renderer_ && !batch_in_flight_) {
+    requestStatsBatch();
+  }
+}
+
 AdminImpl::NullRouteConfigProvider::NullRouteConfigProvider()
     : config_(new Router::NullConfigImpl()) {}
 
@@ -340,10 +753,20 @@ AdminImpl::AdminImpl(const std::string& access_log_path, const std::string& prof
       tracing_stats_(Http::ConnectionManagerImpl::generateTracingStats("http.admin.tracing.",
                                                                        server_.stats())),
       handlers_{
+          {"/allocations", "print the heap allocations of each thread",
+           MAKE_ADMIN_HANDLER(handlerAllocations), false},
+          {"/allocationtracker", "enable/disable counting heap allocations",
+           MAKE_ADMIN_HANDLER(handlerAllocationTracker), false},
           {"/certs", "print certs on machine", MAKE_ADMIN_HANDLER(handlerCerts), false},
           {"/clusters", "upstream cluster status", MAKE_ADMIN_HANDLER(handlerClusters), false},
           {"/cpuprofiler", "enable/disable the CPU profiler",
            MAKE_ADMIN_HANDLER(handlerCpuProfiler), false},
+          {"/cpusampler", "enable/disable the continuous in memory CPU sampler",
+           MAKE_ADMIN_HANDLER(handlerCpuSampler), false},
+          {"/cpusamples", "print the samples of the CPU sampler in pprof format",
+           MAKE_ADMIN_HANDLER(handlerCpuSamples), false},
+          {"/heapprofiler", "print a sample of the heap in pprof format",
+           MAKE_ADMIN_HANDLER(handlerHeapProfiler), false},
           {"/healthcheck/fail", "cause the server to fail health checks",
            MAKE_ADMIN_HANDLER(handlerHealthcheckFail), false},
           {"/healthcheck/ok", "cause the server to pass health checks",
@@ -354,6 +777,8 @@ AdminImpl::AdminImpl(const std::string& access_log_path, const std::string& prof
           {"/quitquitquit", "exit the server", MAKE_ADMIN_HANDLER(handlerQuitQuitQuit), false},
           {"/reset_counters", "reset all counters to zero",
            MAKE_ADMIN_HANDLER(handlerResetCounters), false},
+          {"/runtime_modify", "modify runtime values", MAKE_ADMIN_HANDLER(handlerRuntimeModify),
+           false},
           {"/server_info", "print server version/status information",
            MAKE_ADMIN_HANDLER(handlerServerInfo), false},
           {"/stats", "print server stats", MAKE_ADMIN_HANDLER(handlerStats), false},
@@ -385,7 +810,7 @@ Http::ServerConnectionPtr AdminImpl::createCodec(Network::Connection& connection
 bool AdminImpl::createFilterChain(Network::Connection& connection) {
   connection.addReadFilter(Network::ReadFilterSharedPtr{new Http::ConnectionManagerImpl(
       *this, server_.drainManager(), server_.random(), server_.httpTracer(), server_.runtime(),
-      server_.localInfo(), server_.clusterManager())});
+      server_.localInfo(), server_.clusterManager(), nullptr)});
   return true;
 }
 
@@ -1,15 +1,21 @@
 #pragma once
 
 #include <chrono>
+#include <functional>
 #include <list>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "envoy/event/dispatcher.h"
 #include "envoy/http/filter.h"
 #include "envoy/network/listen_socket.h"
 #include "envoy/server/admin.h"
 #include "envoy/server/instance.h"
+#include "envoy/stats/stats.h"
 #include "envoy/upstream/outlier_detection.h"
 #include "envoy/upstream/resource_manager.h"
+#include "envoy/upstream/upstream.h"
 
 #include "common/common/logger.h"
 #include "common/common/macros.h"
@@ -23,7 +29,95 @@ namespace Envoy {
 namespace Server {
 
 /**
- * Implementation of Server::admin.
+ * Renders the stats selected by a /stats url a batch at a time, so that a large response can be
+ * streamed without holding up the main thread. The stats are found and sorted by name when the
+ * renderer is created, and their values are read as each batch is rendered. The renderer is only
+ * used on the main thread, which owns the statistics of the histograms.
+ */
+class StatsRenderer {
+public:
+  enum class Format { Text, Prometheus };
+
+  /**
+   * @return bool whether a stat with a name is rendered.
+   */
+  typedef std::function<bool(const std::string& name)> NameFilter;
+
+  StatsRenderer(Stats::Store& store, Format format, NameFilter filter);
+
+  /**
+   * Render the next batch of stats.
+   * @param response supplies the buffer to render into.
+   * @param max_stats supplies the largest number of stats to render.
+   * @return bool whether all of the stats have been rendered.
+   */
+  bool nextBatch(Buffer::Instance& response, size_t max_stats);
+
+  /**
+   * @return const std::string& the content type of the rendered response.
+   */
+  const std::string& contentType() const;
+
+  /**
+   * @return std::string a stat name converted to a valid Prometheus metric name.
+   */
+  static std::string prometheusName(const std::string& name);
+
+  /**
+   * @return std::string the tags of a stat rendered as Prometheus labels, without the braces.
+   */
+  static std::string prometheusLabels(const std::vector<Stats::Tag>& tags);
+
+private:
+  struct Entry {
+    std::string name_;
+    // The name of the Prometheus metric that the stat is rendered under.
+    std::string tag_extracted_name_;
+    Stats::CounterSharedPtr counter_;
+    Stats::GaugeSharedPtr gauge_;
+    Stats::ParentHistogramSharedPtr histogram_;
+  };
+
+  static bool sameMetric(const Entry& a, const Entry& b);
+  void renderText(const Entry& entry, Buffer::Instance& response);
+  void renderPrometheus(const Entry& entry, bool render_type, Buffer::Instance& response);
+
+  const Format format_;
+  // The counters and gauges sorted together by name, followed by the sorted histograms. Prometheus
+  // sorts by tag extracted name first.
+  std::vector<Entry> entries_;
+  size_t next_entry_{};
+};
+
+typedef std::unique_ptr<StatsRenderer> StatsRendererPtr;
+typedef std::shared_ptr<StatsRenderer> StatsRendererSharedPtr;
+
+/**
+ * The state of an upstream cluster that /clusters prints, copied on the main thread so that the
+ * response can be rendered on the admin thread.
+ */
+struct ClusterSnapshot {
+  struct HostSnapshot {
+    // The address, zone, canary flag and stats of a host may be read from any thread.
+    Upstream::HostConstSharedPtr host_;
+    std::string health_flags_;
+    uint32_t weight_;
+    double success_rate_;
+    double latency_;
+  };
+
+  std::string name_;
+  // The outlier detection and circuit breaker lines of the cluster.
+  std::string settings_;
+  std::vector<HostSnapshot> hosts_;
+};
+
+typedef std::vector<ClusterSnapshot> ClustersSnapshot;
+typedef std::shared_ptr<const ClustersSnapshot> ClustersSnapshotConstSharedPtr;
+
+/**
+ * Implementation of Server::admin. The admin listener is served by a thread of its own, but the
+ * handlers run on the main thread, which owns the state that they read. @see AdminFilter.
  */
 class AdminImpl : public Admin,
                   public Network::FilterChainFactory,
@@ -35,7 +129,40 @@ public:
             const std::string& address_out_path, Network::Address::InstanceConstSharedPtr address,
             Server::Instance& server);
 
+  /**
+   * The default and the largest rate of the CPU sampler, in samples per second of CPU time of each
+   * sampled thread.
+   */
+  static const uint64_t DEFAULT_SAMPLER_HZ = 100;
+  static const uint64_t MAX_SAMPLER_HZ = 1000;
+
   Http::Code runCallback(const std::string& path, Buffer::Instance& response);
+
+  /**
+   * Parse the query of a /stats url, which may select the stats whose names start with a prefix
+   * or match a regex, and the format of the response.
+   * @param url supplies the url.
+   * @param response supplies the buffer to describe an invalid query in.
+   * @return StatsRendererPtr the renderer of the selected stats, or nullptr if the query is
+   *         invalid.
+   */
+  StatsRendererPtr createStatsRenderer(const std::string& url, Buffer::Instance& response);
+
+  /**
+   * Copy the state of the upstream clusters that /clusters prints. Called on the main thread.
+   */
+  ClustersSnapshotConstSharedPtr snapshotClusters();
+
+  /**
+   * Render a /clusters response from a snapshot. May be called on any thread.
+   */
+  static void renderClusters(const ClustersSnapshot& snapshot, Buffer::Instance& response);
+
+  /**
+   * @return Event::Dispatcher& the dispatcher of the main thread, which the handlers run on.
+   */
+  Event::Dispatcher& mainDispatcher() { return server_.dispatcher(); }
+
   const Network::ListenSocket& socket() override { return *socket_; }
   Network::ListenSocket& mutable_socket() { return *socket_; }
 
@@ -62,6 +189,7 @@ public:
   Http::FilterChainFactory& filterFactory() override { return *this; }
   bool generateRequestId() override { return false; }
   const Optional<std::chrono::milliseconds>& idleTimeout() override { return idle_timeout_; }
+  uint32_t maxRequestHeadersKb() override { return Http::DEFAULT_MAX_REQUEST_HEADERS_KB; }
   Router::RouteConfigProvider& routeConfigProvider() override { return route_config_provider_; }
   const std::string& serverName() override {
     return Server::Configuration::HttpConnectionManagerConfig::DEFAULT_SERVER_STRING;
@@ -118,14 +246,20 @@ private:
   /**
    * URL handlers.
    */
+  Http::Code handlerAllocations(const std::string& url, Buffer::Instance& response);
+  Http::Code handlerAllocationTracker(const std::string& url, Buffer::Instance& response);
   Http::Code handlerCerts(const std::string& url, Buffer::Instance& response);
   Http::Code handlerClusters(const std::string& url, Buffer::Instance& response);
   Http::Code handlerCpuProfiler(const std::string& url, Buffer::Instance& response);
+  Http::Code handlerCpuSampler(const std::string& url, Buffer::Instance& response);
+  Http::Code handlerCpuSamples(const std::string& url, Buffer::Instance& response);
+  Http::Code handlerHeapProfiler(const std::string& url, Buffer::Instance& response);
   Http::Code handlerHealthcheckFail(const std::string& url, Buffer::Instance& response);
   Http::Code handlerHealthcheckOk(const std::string& url, Buffer::Instance& response);
   Http::Code handlerHotRestartVersion(const std::string& url, Buffer::Instance& response);
   Http::Code handlerLogging(const std::string& url, Buffer::Instance& response);
   Http::Code handlerResetCounters(const std::string& url, Buffer::Instance& response);
+  Http::Code handlerRuntimeModify(const std::string& url, Buffer::Instance& response);
   Http::Code handlerServerInfo(const std::string& url, Buffer::Instance& response);
   Http::Code handlerStats(const std::string& url, Buffer::Instance& response);
   Http::Code handlerQuitQuitQuit(const std::string& url, Buffer::Instance& response);
@@ -146,14 +280,25 @@ private:
 };
 
 /**
- * A terminal HTTP filter that implements server admin functionality.
+ * A terminal HTTP filter that implements server admin functionality. The filter runs on the admin
+ * thread and posts the handlers of its requests to the main thread, which posts the responses
+ * back. A /stats response is rendered on the main thread a batch per post, and a /clusters
+ * response is rendered on the admin thread from a snapshot, so that neither holds up the main
+ * thread for long.
  */
-class AdminFilter : public Http::StreamDecoderFilter, Logger::Loggable<Logger::Id::admin> {
+class AdminFilter : public Http::StreamDecoderFilter,
+                    public Http::DownstreamWatermarkCallbacks,
+                    Logger::Loggable<Logger::Id::admin> {
 public:
+  /**
+   * The number of stats rendered per post to the main thread while a /stats response streams.
+   */
+  static const size_t STATS_PER_BATCH = 1000;
+
   AdminFilter(AdminImpl& parent);
 
   // Http::StreamFilterBase
-  void onDestroy() override {}
+  void onDestroy() override;
 
   // Http::StreamDecoderFilter
   Http::FilterHeadersStatus decodeHeaders(Http::HeaderMap& headers, bool end_stream) override;
@@ -163,15 +308,51 @@ public:
     callbacks_ = &callbacks;
   }
 
+  // Http::DownstreamWatermarkCallbacks
+  void onAboveWriteBufferHighWatermark() override { above_high_watermark_ = true; }
+  void onBelowWriteBufferLowWatermark() override;
+
 private:
   /**
    * Called when an admin request has been completely received.
    */
   void onComplete();
 
+  /**
+   * Send the response of a handler.
+   */
+  void sendResponse(Http::Code code, Buffer::Instance& response);
+
+  /**
+   * Start streaming the response of a /stats request.
+   */
+  void streamStats(const std::string& path);
+
+  /**
+   * Called with the renderer that the main thread created for a /stats request, or nullptr and
+   * the description of an invalid query.
+   */
+  void onStatsRenderer(StatsRendererSharedPtr renderer, const std::string& error);
+
+  /**
+   * Post the rendering of the next batch of stats to the main thread.
+   */
+  void requestStatsBatch();
+
+  /**
+   * Send a batch of stats that the main thread rendered.
+   */
+  void onStatsBatch(const std::string& batch, bool done);
+
   AdminImpl& parent_;
+  // Points at the filter until the stream is destroyed, so that the responses that the main thread
+  // posts back are dropped once their stream is gone. Only dereferenced on the admin thread.
+  std::shared_ptr<AdminFilter*> handle_;
   Http::StreamDecoderFilterCallbacks* callbacks_{};
   Http::HeaderMap* request_headers_{};
+  StatsRendererSharedPtr stats_renderer_;
+  bool batch_in_flight_{};
+  bool above_high_watermark_{};
 };
 
 } // namespace Server
@@ -39,16 +39,33 @@ HttpFilterFactoryCb HealthCheckFilterConfig::createFilterFactory(const Json::Obj
     throw EnvoyException("cache_time_ms must not be set when path_through_mode is disabled");
   }
 
+  ClusterMinHealthyPercentagesConstSharedPtr cluster_min_healthy_percentages;
+  if (config.hasObject("cluster_min_healthy_percentages")) {
+    if (pass_through_mode) {
+      throw EnvoyException(
+          "cluster_min_healthy_percentages must not be set when pass_through_mode is enabled");
+    }
+
+    std::shared_ptr<std::list<ClusterMinHealthyPercentage>> percentages =
+        std::make_shared<std::list<ClusterMinHealthyPercentage>>();
+    config.getObject("cluster_min_healthy_percentages")
+        ->iterate([&percentages](const std::string& name, const Json::Object& value) -> bool {
+          percentages->emplace_back(name, value.asInteger());
+          return true;
+        });
+    cluster_min_healthy_percentages = percentages;
+  }
+
   HealthCheckCacheManagerSharedPtr cache_manager;
   if (cache_time_ms > 0) {
     cache_manager.reset(new HealthCheckCacheManager(context.dispatcher(),
                                                     std::chrono::milliseconds(cache_time_ms)));
   }
 
-  return [&context, pass_through_mode, cache_manager,
-          hc_endpoint](Http::FilterChainFactoryCallbacks& callbacks) -> void {
-    callbacks.addStreamFilter(Http::StreamFilterSharedPtr{
-        new HealthCheckFilter(context, pass_through_mode, cache_manager, hc_endpoint)});
+  return [&context, pass_through_mode, cache_manager, hc_endpoint,
+          cluster_min_healthy_percentages](Http::FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addStreamFilter(Http::StreamFilterSharedPtr{new HealthCheckFilter(
+        context, pass_through_mode, cache_manager, hc_endpoint, cluster_min_healthy_percentages)});
   };
 }
 
@@ -127,6 +144,28 @@ Http::FilterHeadersStatus HealthCheckFilter::encodeHeaders(Http::HeaderMap& head
   return Http::FilterHeadersStatus::Continue;
 }
 
+bool HealthCheckFilter::clustersHealthy() {
+  for (const ClusterMinHealthyPercentage& item : *cluster_min_healthy_percentages_) {
+    Upstream::ThreadLocalCluster* cluster = context_.clusterManager().getByHandle(item.cluster_);
+    if (cluster == nullptr) {
+      return false;
+    }
+
+    // The membership gauges are set on the main thread once per change of the hosts of the
+    // cluster, so a health check only reads them. An empty cluster only passes with a minimum of 0.
+    const Upstream::ClusterStats& stats = cluster->info()->stats();
+    const uint64_t total = stats.membership_total_.value();
+    if (total == 0 && item.min_healthy_percentage_ > 0) {
+      return false;
+    }
+    if (100 * stats.membership_healthy_.value() < total * item.min_healthy_percentage_) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 void HealthCheckFilter::onComplete() {
   ASSERT(handling_);
   Http::HeaderMapPtr headers;
@@ -139,6 +178,8 @@ void HealthCheckFilter::onComplete() {
     Http::Code final_status = Http::Code::OK;
     if (cache_manager_) {
       final_status = cache_manager_->getCachedResponseCode();
+    } else if (cluster_min_healthy_percentages_ && !clustersHealthy()) {
+      final_status = Http::Code::ServiceUnavailable;
     }
 
     if (!Http::CodeUtility::is2xx(enumToInt(final_status))) {
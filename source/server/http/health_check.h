@@ -2,12 +2,14 @@
 
 #include <atomic>
 #include <chrono>
+#include <list>
 #include <memory>
 #include <string>
 
 #include "envoy/http/codes.h"
 #include "envoy/http/filter.h"
 #include "envoy/server/filter_config.h"
+#include "envoy/upstream/cluster_manager.h"
 
 namespace Envoy {
 namespace Server {
@@ -52,15 +54,32 @@ private:
 
 typedef std::shared_ptr<HealthCheckCacheManager> HealthCheckCacheManagerSharedPtr;
 
+/**
+ * The minimum % of the hosts of an upstream cluster that must be healthy for the filter to answer
+ * health checks with a 200.
+ */
+struct ClusterMinHealthyPercentage {
+  ClusterMinHealthyPercentage(const std::string& cluster_name, uint64_t min_healthy_percentage)
+      : cluster_(cluster_name), min_healthy_percentage_(min_healthy_percentage) {}
+
+  const Upstream::ClusterHandle cluster_;
+  const uint64_t min_healthy_percentage_;
+};
+
+typedef std::shared_ptr<const std::list<ClusterMinHealthyPercentage>>
+    ClusterMinHealthyPercentagesConstSharedPtr;
+
 /**
  * Health check responder filter.
  */
 class HealthCheckFilter : public Http::StreamFilter {
 public:
   HealthCheckFilter(Server::Configuration::FactoryContext& context, bool pass_through_mode,
-                    HealthCheckCacheManagerSharedPtr cache_manager, const std::string& endpoint)
+                    HealthCheckCacheManagerSharedPtr cache_manager, const std::string& endpoint,
+                    ClusterMinHealthyPercentagesConstSharedPtr cluster_min_healthy_percentages =
+                        nullptr)
       : context_(context), pass_through_mode_(pass_through_mode), cache_manager_(cache_manager),
-        endpoint_(endpoint) {}
+        endpoint_(endpoint), cluster_min_healthy_percentages_(cluster_min_healthy_percentages) {}
 
   // Http::StreamFilterBase
   void onDestroy() override {}
@@ -84,6 +103,7 @@ public:
   void setEncoderFilterCallbacks(Http::StreamEncoderFilterCallbacks&) override {}
 
 private:
+  bool clustersHealthy();
   void onComplete();
 
   Server::Configuration::FactoryContext& context_;
@@ -93,5 +113,6 @@ private:
   bool pass_through_mode_{};
   HealthCheckCacheManagerSharedPtr cache_manager_{};
   const std::string endpoint_;
+  ClusterMinHealthyPercentagesConstSharedPtr cluster_min_healthy_percentages_;
 };
 } // namespace Envoy
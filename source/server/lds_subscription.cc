@@ -41,8 +41,7 @@ void LdsSubscription::createRequest(Http::Message& request) {
 
 void LdsSubscription::parseResponse(const Http::Message& response) {
   ENVOY_LOG(debug, "lds: parsing response");
-  const std::string response_body = response.bodyAsString();
-  Json::ObjectSharedPtr response_json = Json::Factory::loadFromString(response_body);
+  Json::ObjectSharedPtr response_json = parseJsonBody(response);
   response_json->validateSchema(Json::Schema::LDS_SCHEMA);
   std::vector<Json::ObjectSharedPtr> json_listeners = response_json->getObjectArray("listeners");
 
@@ -1,8 +1,15 @@
 #include "server/listener_manager_impl.h"
 
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <cstring>
+
 #include "envoy/registry/registry.h"
 
 #include "common/common/assert.h"
+#include "common/common/macros.h"
+#include "common/common/utility.h"
 #include "common/config/utility.h"
 #include "common/network/listen_socket_impl.h"
 #include "common/network/utility.h"
@@ -10,6 +17,7 @@
 #include "common/ssl/context_config_impl.h"
 
 #include "server/configuration_impl.h"
+#include "server/connection_handler_impl.h"
 #include "server/drain_manager_impl.h"
 
 #include "fmt/format.h"
@@ -51,22 +59,48 @@ Network::ListenSocketSharedPtr
 ProdListenerComponentFactory::createListenSocket(Network::Address::InstanceConstSharedPtr address,
                                                  bool bind_to_port) {
   // For each listener config we share a single TcpListenSocket among all threaded listeners.
+  return createTcpListenSocket(address, bind_to_port, false, 0);
+}
+
+Network::ListenSocketSharedPtr ProdListenerComponentFactory::createReusePortListenSocket(
+    Network::Address::InstanceConstSharedPtr address, uint32_t worker_index) {
+  Network::ListenSocketSharedPtr socket = createTcpListenSocket(address, true, true, worker_index);
+  const std::vector<uint32_t>& worker_cpus = server_.options().workerCpus();
+  if (!worker_cpus.empty()) {
+    // Steer the connections whose packets arrive on the CPU of the worker to the worker's socket,
+    // so that a connection is handled on the same CPU from the NIC queue to the proxy.
+    const int cpu = worker_cpus[worker_index % worker_cpus.size()];
+#ifdef SO_INCOMING_CPU
+    if (setsockopt(socket->fd(), SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) == -1) {
+      ENVOY_LOG(warn, "unable to set SO_INCOMING_CPU {} on listen socket {}: {}", cpu,
+                address->asString(), strerror(errno));
+    }
+#else
+    UNREFERENCED_PARAMETER(cpu);
+#endif
+  }
+  return socket;
+}
+
+Network::ListenSocketSharedPtr ProdListenerComponentFactory::createTcpListenSocket(
+    Network::Address::InstanceConstSharedPtr address, bool bind_to_port, bool reuse_port,
+    uint32_t worker_index) {
   // UdsListenerSockets are not managed and do not participate in hot restart as they are only
   // used for testing. First we try to get the socket from our parent if applicable.
   // TODO(mattklein123): UDS support.
   ASSERT(address->type() == Network::Address::Type::Ip);
   const std::string addr = fmt::format("tcp://{}", address->asString());
-  const int fd = server_.hotRestart().duplicateParentListenSocket(addr);
+  const int fd = server_.hotRestart().duplicateParentListenSocket(addr, worker_index);
   if (fd != -1) {
-    ENVOY_LOG(info, "obtained socket for address {} from parent", addr);
+    ENVOY_LOG(info, "obtained socket for address {} worker {} from parent", addr, worker_index);
     return std::make_shared<Network::TcpListenSocket>(fd, address);
   } else {
-    return std::make_shared<Network::TcpListenSocket>(address, bind_to_port);
+    return std::make_shared<Network::TcpListenSocket>(address, bind_to_port, reuse_port);
   }
 }
 
 DrainManagerPtr ProdListenerComponentFactory::createDrainManager() {
-  return DrainManagerPtr{new DrainManagerImpl(server_)};
+  return DrainManagerPtr{new DrainManagerImpl(server_, ProdMonotonicTimeSource::instance_)};
 }
 
 ListenerImpl::ListenerImpl(const envoy::api::v2::Listener& config, ListenerManagerImpl& parent,
@@ -83,8 +117,10 @@ ListenerImpl::ListenerImpl(const envoy::api::v2::Listener& config, ListenerManag
       use_original_dst_(PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, use_original_dst, false)),
       per_connection_buffer_limit_bytes_(
           PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, per_connection_buffer_limit_bytes, 1024 * 1024)),
+      max_accepts_per_event_(parent_.server_.options().maxAcceptsPerEvent()),
       listener_tag_(parent_.factory_.nextListenerTag()), name_(name),
       workers_started_(workers_started), hash_(hash),
+      hash_without_filter_chains_(computeHashWithoutFilterChains(config)),
       local_drain_manager_(parent.factory_.createDrainManager()) {
   // TODO(htuch): Support multiple filter chains #1280, add constraint to ensure we have at least on
   // filter chain #1308.
@@ -98,12 +134,85 @@ ListenerImpl::ListenerImpl(const envoy::api::v2::Listener& config, ListenerManag
   listener_scope_ = parent_.server_.stats().createScope(final_stat_name);
 
   if (filter_chain.has_tls_context()) {
-    Ssl::ServerContextConfigImpl context_config(filter_chain.tls_context());
+    Ssl::ServerContextConfigImpl context_config(filter_chain.tls_context(),
+                                                dynamicRecordSizing(), kernelTls());
     ssl_context_ = parent_.server_.sslContextManager().createSslServerContext(*listener_scope_,
                                                                               context_config);
+    if (!context_config.sessionTicketKeyPaths().empty()) {
+      // New keys are rotated in by moving their files into place.
+      session_ticket_keys_watcher_ = parent_.server_.dispatcher().createFilesystemWatcher();
+      for (const std::string& path : context_config.sessionTicketKeyPaths()) {
+        session_ticket_keys_watcher_->addWatch(path, Filesystem::Watcher::Events::MovedTo,
+                                               [this](uint32_t) -> void { onTicketKeysChanged(); });
+      }
+    }
   }
 
   filter_factories_ = parent_.factory_.createFilterFactoryList(filter_chain.filters(), *this);
+  connection_limit_ = createConnectionLimit();
+}
+
+uint64_t ListenerImpl::computeHashWithoutFilterChains(const envoy::api::v2::Listener& config) {
+  envoy::api::v2::Listener socket_config(config);
+  socket_config.clear_filter_chains();
+  return MessageUtil::hash(socket_config);
+}
+
+Ssl::DynamicRecordSizing ListenerImpl::dynamicRecordSizing() {
+  // The TLS context API has no record sizing settings yet, so they are read from runtime when the
+  // listener is created.
+  Runtime::Snapshot& snapshot = parent_.server_.runtime().snapshot();
+  const std::string prefix = fmt::format("listener.{}.ssl.", name_);
+  Ssl::DynamicRecordSizing record_sizing;
+  record_sizing.initial_record_size_ = snapshot.getInteger(
+      prefix + "dynamic_record_size_bytes", record_sizing.initial_record_size_);
+  record_sizing.ramp_bytes_ =
+      snapshot.getInteger(prefix + "dynamic_record_ramp_bytes", record_sizing.ramp_bytes_);
+  record_sizing.idle_timeout_ = std::chrono::milliseconds(snapshot.getInteger(
+      prefix + "dynamic_record_idle_ms", record_sizing.idle_timeout_.count()));
+  return record_sizing;
+}
+
+bool ListenerImpl::kernelTls() {
+  return parent_.server_.runtime().snapshot().getInteger(
+             fmt::format("listener.{}.ssl.kernel_tls", name_), 0) != 0;
+}
+
+Network::ConnectionLimitSharedPtr ListenerImpl::createConnectionLimit() {
+  // The listener API has no connection limit yet, so it is read from runtime when the listener is
+  // created.
+  const uint64_t max_connections = parent_.server_.runtime().snapshot().getInteger(
+      fmt::format("listener.{}.max_connections", name_), 0);
+  if (max_connections == 0) {
+    return nullptr;
+  }
+  return std::make_shared<ConnectionLimitImpl>(max_connections);
+}
+
+Network::SocketOptions ListenerImpl::socketOptions() {
+  // The listener API has no socket options yet, so they are read from runtime when the sockets of
+  // the listener are created.
+  Runtime::Snapshot& snapshot = parent_.server_.runtime().snapshot();
+  const std::string prefix = fmt::format("listener.{}.socket.", name_);
+  Network::SocketOptions options;
+  options.tcp_fast_open_queue_length_ =
+      snapshot.getInteger(prefix + "tcp_fast_open_queue_length", 0);
+  options.defer_accept_seconds_ = snapshot.getInteger(prefix + "defer_accept_seconds", 0);
+  options.notsent_lowat_bytes_ = snapshot.getInteger(prefix + "notsent_lowat_bytes", 0);
+  options.busy_poll_us_ = snapshot.getInteger(prefix + "busy_poll_us", 0);
+  options.receive_buffer_bytes_ = snapshot.getInteger(prefix + "receive_buffer_bytes", 0);
+  options.send_buffer_bytes_ = snapshot.getInteger(prefix + "send_buffer_bytes", 0);
+  return options;
+}
+
+void ListenerImpl::onTicketKeysChanged() {
+  try {
+    ssl_context_->reloadSessionTicketKeys();
+    ENVOY_LOG(info, "lds: reloaded TLS session ticket keys of listener '{}'", name_);
+  } catch (const EnvoyException& e) {
+    ENVOY_LOG(warn, "lds: keeping the TLS session ticket keys of listener '{}': {}", name_,
+              e.what());
+  }
 }
 
 ListenerImpl::~ListenerImpl() {
@@ -153,15 +262,17 @@ Init::Manager& ListenerImpl::initManager() {
   }
 }
 
-void ListenerImpl::setSocket(const Network::ListenSocketSharedPtr& socket) {
-  ASSERT(!socket_);
-  socket_ = socket;
+void ListenerImpl::setSockets(const std::vector<Network::ListenSocketSharedPtr>& sockets) {
+  ASSERT(sockets_.empty());
+  ASSERT(!sockets.empty());
+  sockets_ = sockets;
 }
 
 ListenerManagerImpl::ListenerManagerImpl(Instance& server,
                                          ListenerComponentFactory& listener_factory,
                                          WorkerFactory& worker_factory)
-    : server_(server), factory_(listener_factory), stats_(generateStats(server.stats())) {
+    : server_(server), factory_(listener_factory), stats_(generateStats(server.stats())),
+      reuse_port_(server.options().reusePort()) {
   for (uint32_t i = 0; i < std::max(1U, server.options().concurrency()); i++) {
     workers_.emplace_back(worker_factory.createWorker());
   }
@@ -220,12 +331,12 @@ bool ListenerManagerImpl::addOrUpdateListener(const envoy::api::v2::Listener& co
     // In this case we can just replace inline.
     ASSERT(workers_started_);
     new_listener->infoLog("update warming listener");
-    new_listener->setSocket((*existing_warming_listener)->getSocket());
+    new_listener->setSockets((*existing_warming_listener)->getSockets());
     *existing_warming_listener = std::move(new_listener);
   } else if (existing_active_listener != active_listeners_.end()) {
     // In this case we have no warming listener, so what we do depends on whether workers
     // have been started or not. Either way we get the socket from the existing listener.
-    new_listener->setSocket((*existing_active_listener)->getSocket());
+    new_listener->setSockets((*existing_active_listener)->getSockets());
     if (workers_started_) {
       new_listener->infoLog("add warming listener");
       warming_listeners_.emplace_back(std::move(new_listener));
@@ -254,20 +365,19 @@ bool ListenerManagerImpl::addOrUpdateListener(const envoy::api::v2::Listener& co
     // to see if there is a listener that has a socket bound to the address we are configured for.
     // This is an edge case, but may happen if a listener is removed and then added back with a same
     // or different name and intended to listen on the same address. This should work and not fail.
-    Network::ListenSocketSharedPtr draining_listener_socket;
+    std::vector<Network::ListenSocketSharedPtr> draining_listener_sockets;
     auto existing_draining_listener = std::find_if(
         draining_listeners_.cbegin(), draining_listeners_.cend(),
         [&new_listener](const DrainingListener& listener) {
           return *new_listener->address() == *listener.listener_->socket().localAddress();
         });
     if (existing_draining_listener != draining_listeners_.cend()) {
-      draining_listener_socket = existing_draining_listener->listener_->getSocket();
+      draining_listener_sockets = existing_draining_listener->listener_->getSockets();
     }
 
-    new_listener->setSocket(
-        draining_listener_socket
-            ? draining_listener_socket
-            : factory_.createListenSocket(new_listener->address(), new_listener->bindToPort()));
+    new_listener->setSockets(!draining_listener_sockets.empty()
+                                 ? draining_listener_sockets
+                                 : createListenSockets(*new_listener));
     if (workers_started_) {
       new_listener->infoLog("add warming listener");
       warming_listeners_.emplace_back(std::move(new_listener));
@@ -290,6 +400,36 @@ bool ListenerManagerImpl::addOrUpdateListener(const envoy::api::v2::Listener& co
   return true;
 }
 
+std::vector<Network::ListenSocketSharedPtr>
+ListenerManagerImpl::createListenSockets(ListenerImpl& listener) {
+  std::vector<Network::ListenSocketSharedPtr> sockets;
+  if (!reuse_port_ || !listener.bindToPort()) {
+    sockets.push_back(factory_.createListenSocket(listener.address(), listener.bindToPort()));
+  } else {
+    // One socket per worker, in the order in which the workers were created. Their index matches
+    // the worker index that the worker factory assigned.
+    Network::Address::InstanceConstSharedPtr address = listener.address();
+    for (uint32_t i = 0; i < workers_.size(); i++) {
+      sockets.push_back(factory_.createReusePortListenSocket(address, i));
+      // If the configured port is zero the first socket picks the port that the others bind to.
+      // The validation server does not create sockets.
+      if (i == 0 && sockets[0] != nullptr) {
+        address = sockets[0]->localAddress();
+      }
+    }
+  }
+
+  const Network::SocketOptions options = listener.socketOptions();
+  if (!options.empty()) {
+    for (const Network::ListenSocketSharedPtr& socket : sockets) {
+      if (socket != nullptr) {
+        Network::Utility::setListenSocketOptions(socket->fd(), options);
+      }
+    }
+  }
+  return sockets;
+}
+
 bool ListenerManagerImpl::hasListenerWithAddress(const ListenerList& list,
                                                  const Network::Address::Instance& address) {
   for (const auto& listener : list) {
@@ -315,31 +455,66 @@ void ListenerManagerImpl::drainListener(ListenerImplPtr&& listener) {
     worker->stopListener(*draining_it->listener_);
   }
 
+  startDrainSequence(draining_it);
+  updateWarmingActiveGauges();
+}
+
+void ListenerManagerImpl::startDrainSequence(std::list<DrainingListener>::iterator draining_it) {
+  draining_it->drain_started_ = true;
+
   // Start the drain sequence which completes when the listener's drain manager has completed
   // draining at whatever the server configured drain times are.
   draining_it->listener_->localDrainManager().startDrainSequence([this, draining_it]() -> void {
     draining_it->listener_->infoLog("removing listener");
     for (const auto& worker : workers_) {
       // Once the drain time has completed via the drain manager's timer, we tell the workers to
-      // remove the listener.
+      // remove the listener. The removal of a retired listener is reported by its retire
+      // completion.
+      if (draining_it->retired_) {
+        worker->removeListener(*draining_it->listener_, []() -> void {});
+        continue;
+      }
       worker->removeListener(*draining_it->listener_, [this, draining_it]() -> void {
         // The remove listener completion is called on the worker thread. We post back to the main
         // thread to avoid locking. This makes sure that we don't destroy the listener while filters
         // might still be using its context (stats, etc.).
-        server_.dispatcher().post([this, draining_it]() -> void {
-          if (--draining_it->workers_pending_removal_ == 0) {
-            draining_it->listener_->infoLog("listener removal complete");
-            draining_listeners_.erase(draining_it);
-            stats_.total_listeners_draining_.set(draining_listeners_.size());
-          }
-        });
+        server_.dispatcher().post(
+            [this, draining_it]() -> void { onWorkerListenerRemoved(draining_it); });
       });
     }
   });
+}
+
+void ListenerManagerImpl::retireListener(ListenerImplPtr&& listener) {
+  std::list<DrainingListener>::iterator draining_it = draining_listeners_.emplace(
+      draining_listeners_.begin(), std::move(listener), workers_.size());
+  draining_it->retired_ = true;
+  stats_.total_listeners_draining_.set(draining_listeners_.size());
+  stats_.listener_modified_in_place_.inc();
+
+  // New connections go to the listener that replaces this one, while the connections of this one
+  // run to completion without being drained.
+  draining_it->listener_->infoLog("retiring listener");
+  for (const auto& worker : workers_) {
+    worker->retireListener(*draining_it->listener_, [this, draining_it]() -> void {
+      // Called on the worker thread, like the remove listener completion.
+      server_.dispatcher().post(
+          [this, draining_it]() -> void { onWorkerListenerRemoved(draining_it); });
+    });
+  }
 
   updateWarmingActiveGauges();
 }
 
+void ListenerManagerImpl::onWorkerListenerRemoved(
+    std::list<DrainingListener>::iterator draining_it) {
+  if (--draining_it->workers_pending_removal_ == 0) {
+    draining_it->listener_->infoLog("listener removal complete");
+    draining_listeners_.erase(draining_it);
+    stats_.total_listeners_draining_.set(draining_listeners_.size());
+  }
+}
+
 ListenerManagerImpl::ListenerList::iterator
 ListenerManagerImpl::getListenerByName(ListenerList& listeners, const std::string& name) {
   auto ret = listeners.end();
@@ -400,7 +575,16 @@ void ListenerManagerImpl::onListenerWarmed(ListenerImpl& listener) {
   auto existing_warming_listener = getListenerByName(warming_listeners_, listener.name());
   (*existing_warming_listener)->infoLog("warm complete. updating active listener");
   if (existing_active_listener != active_listeners_.end()) {
-    drainListener(std::move(*existing_active_listener));
+    // A listener that only differs in its filter chains takes over the new connections, and the
+    // connections of the old listener keep their filter chains until they close.
+    if ((*existing_active_listener)->hashWithoutFilterChains() ==
+            (*existing_warming_listener)->hashWithoutFilterChains() &&
+        server_.runtime().snapshot().getInteger("listener_manager.drain_on_filter_chain_update",
+                                                0) == 0) {
+      retireListener(std::move(*existing_active_listener));
+    } else {
+      drainListener(std::move(*existing_active_listener));
+    }
     *existing_active_listener = std::move(*existing_warming_listener);
   } else {
     active_listeners_.emplace_back(std::move(*existing_warming_listener));
@@ -442,6 +626,16 @@ bool ListenerManagerImpl::removeListener(const std::string& name) {
     active_listeners_.erase(existing_active_listener);
   }
 
+  // The connections of retired listeners with the name drain along with those of the active one.
+  for (auto draining_it = draining_listeners_.begin(); draining_it != draining_listeners_.end();
+       ++draining_it) {
+    if (draining_it->retired_ && !draining_it->drain_started_ &&
+        draining_it->listener_->name() == name) {
+      draining_it->listener_->infoLog("draining retired listener");
+      startDrainSequence(draining_it);
+    }
+  }
+
   stats_.listener_removed_.inc();
   updateWarmingActiveGauges();
   return true;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "envoy/filesystem/filesystem.h"
 #include "envoy/server/filter_config.h"
 #include "envoy/server/instance.h"
 #include "envoy/server/listener_manager.h"
@@ -39,10 +40,17 @@ public:
   }
   Network::ListenSocketSharedPtr
   createListenSocket(Network::Address::InstanceConstSharedPtr address, bool bind_to_port) override;
+  Network::ListenSocketSharedPtr
+  createReusePortListenSocket(Network::Address::InstanceConstSharedPtr address,
+                              uint32_t worker_index) override;
   DrainManagerPtr createDrainManager() override;
   uint64_t nextListenerTag() override { return next_listener_tag_++; }
 
 private:
+  Network::ListenSocketSharedPtr
+  createTcpListenSocket(Network::Address::InstanceConstSharedPtr address, bool bind_to_port,
+                        bool reuse_port, uint32_t worker_index);
+
   Instance& server_;
   uint64_t next_listener_tag_{1};
 };
@@ -57,6 +65,7 @@ typedef std::unique_ptr<ListenerImpl> ListenerImplPtr;
 #define ALL_LISTENER_MANAGER_STATS(COUNTER, GAUGE)                                                 \
   COUNTER(listener_added)                                                                          \
   COUNTER(listener_modified)                                                                       \
+  COUNTER(listener_modified_in_place)                                                              \
   COUNTER(listener_removed)                                                                        \
   COUNTER(listener_create_success)                                                                 \
   COUNTER(listener_create_failure)                                                                 \
@@ -103,9 +112,14 @@ private:
 
     ListenerImplPtr listener_;
     uint64_t workers_pending_removal_;
+    // Whether the workers remove the listener once its connections have closed, and report the
+    // removal through the retire completion.
+    bool retired_{};
+    bool drain_started_{};
   };
 
   void addListenerToWorker(Worker& worker, ListenerImpl& listener);
+  std::vector<Network::ListenSocketSharedPtr> createListenSockets(ListenerImpl& listener);
   static ListenerManagerStats generateStats(Stats::Scope& scope);
   static bool hasListenerWithAddress(const ListenerList& list,
                                      const Network::Address::Instance& address);
@@ -123,6 +137,24 @@ private:
    */
   void drainListener(ListenerImplPtr&& listener);
 
+  /**
+   * Start the drain sequence of a draining listener, after which the workers remove it.
+   */
+  void startDrainSequence(std::list<DrainingListener>::iterator draining_it);
+
+  /**
+   * Mark a listener for retirement when it is replaced by a listener that only differs in its
+   * filter chains. The workers stop accepting new connections on it without draining its
+   * connections, and remove it once all of its connections have closed.
+   * @param listener supplies the listener to retire.
+   */
+  void retireListener(ListenerImplPtr&& listener);
+
+  /**
+   * Called on the main thread each time a worker has removed a draining listener.
+   */
+  void onWorkerListenerRemoved(std::list<DrainingListener>::iterator draining_it);
+
   /**
    * Get a listener by name. This routine is used because listeners have inherent order in static
    * configuration and especially for tests. Thus, we can't use a map.
@@ -140,11 +172,14 @@ private:
   // Draining listeners are listeners that are in the process of being drained and removed. They
   // go through two phases where first the workers stop accepting new connections and existing
   // connections are drained. Then after that time period the listener is removed from all workers
-  // and any remaining connections are closed.
+  // and any remaining connections are closed. Retired listeners are also kept here, but skip the
+  // drain unless a listener with their name is removed.
   std::list<DrainingListener> draining_listeners_;
   std::list<WorkerPtr> workers_;
   bool workers_started_{};
   ListenerManagerStats stats_;
+  // Whether listeners that bind to a port have a SO_REUSEPORT socket per worker.
+  const bool reuse_port_;
 };
 
 // TODO(mattklein123): Consider getting rid of pre-worker start and post-worker start code by
@@ -183,21 +218,39 @@ public:
   }
 
   Network::Address::InstanceConstSharedPtr address() const { return address_; }
-  const Network::ListenSocketSharedPtr& getSocket() const { return socket_; }
+  const std::vector<Network::ListenSocketSharedPtr>& getSockets() const { return sockets_; }
   uint64_t hash() const { return hash_; }
+  /**
+   * @return uint64_t the hash of the configuration of the listener without its filter chains. A
+   *         listener with the same hash only differs in what applies to new connections.
+   */
+  uint64_t hashWithoutFilterChains() const { return hash_without_filter_chains_; }
   void infoLog(const std::string& message);
   void initialize();
   DrainManager& localDrainManager() const { return *local_drain_manager_; }
-  void setSocket(const Network::ListenSocketSharedPtr& socket);
+  /**
+   * Set the sockets of the listener. This is either a single socket shared by all workers, or one
+   * socket per worker in worker order.
+   */
+  void setSockets(const std::vector<Network::ListenSocketSharedPtr>& sockets);
+  /**
+   * @return the options that are set on the sockets of the listener when they are created.
+   */
+  Network::SocketOptions socketOptions();
 
   // Server::Listener
   Network::FilterChainFactory& filterChainFactory() override { return *this; }
-  Network::ListenSocket& socket() override { return *socket_; }
+  Network::ListenSocket& socket() override { return *sockets_[0]; }
+  Network::ListenSocket& workerSocket(uint32_t worker_index) override {
+    return worker_index < sockets_.size() ? *sockets_[worker_index] : *sockets_[0];
+  }
   bool bindToPort() override { return bind_to_port_; }
   Ssl::ServerContext* sslContext() override { return ssl_context_.get(); }
   bool useProxyProto() override { return use_proxy_proto_; }
   bool useOriginalDst() override { return use_original_dst_; }
   uint32_t perConnectionBufferLimitBytes() override { return per_connection_buffer_limit_bytes_; }
+  uint32_t maxAcceptsPerEvent() override { return max_accepts_per_event_; }
+  Network::ConnectionLimitSharedPtr connectionLimit() override { return connection_limit_; }
   Stats::Scope& listenerScope() override { return *listener_scope_; }
   uint64_t listenerTag() override { return listener_tag_; }
   const std::string& name() const override { return name_; }
@@ -214,6 +267,7 @@ public:
   Init::Manager& initManager() override;
   const LocalInfo::LocalInfo& localInfo() override { return parent_.server_.localInfo(); }
   Envoy::Runtime::RandomGenerator& random() override { return parent_.server_.random(); }
+  OverloadManager& overloadManager() override { return parent_.server_.overloadManager(); }
   RateLimit::ClientPtr
   rateLimitClient(const Optional<std::chrono::milliseconds>& timeout) override {
     return parent_.server_.rateLimitClient(timeout);
@@ -231,20 +285,30 @@ public:
   bool createFilterChain(Network::Connection& connection) override;
 
 private:
+  static uint64_t computeHashWithoutFilterChains(const envoy::api::v2::Listener& config);
+  Ssl::DynamicRecordSizing dynamicRecordSizing();
+  bool kernelTls();
+  Network::ConnectionLimitSharedPtr createConnectionLimit();
+  void onTicketKeysChanged();
+
   ListenerManagerImpl& parent_;
   Network::Address::InstanceConstSharedPtr address_;
-  Network::ListenSocketSharedPtr socket_;
+  std::vector<Network::ListenSocketSharedPtr> sockets_;
   Stats::ScopePtr global_scope_;   // Stats with global named scope, but needed for LDS cleanup.
   Stats::ScopePtr listener_scope_; // Stats with listener named scope.
   Ssl::ServerContextPtr ssl_context_;
+  Filesystem::WatcherPtr session_ticket_keys_watcher_;
   const bool bind_to_port_;
   const bool use_proxy_proto_;
   const bool use_original_dst_;
   const uint32_t per_connection_buffer_limit_bytes_;
+  const uint32_t max_accepts_per_event_;
   const uint64_t listener_tag_;
+  Network::ConnectionLimitSharedPtr connection_limit_;
   const std::string name_;
   const bool workers_started_;
   const uint64_t hash_;
+  const uint64_t hash_without_filter_chains_;
   InitManagerImpl dynamic_init_manager_;
   bool initialize_canceled_{};
   std::vector<Configuration::NetworkFilterFactoryCb> filter_factories_;
@@ -1,11 +1,14 @@
 #include "server/options_impl.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "common/common/macros.h"
+#include "common/common/utility.h"
 #include "common/common/version.h"
 
 #include "fmt/format.h"
@@ -13,7 +16,7 @@
 #include "tclap/CmdLine.h"
 
 namespace Envoy {
-OptionsImpl::OptionsImpl(int argc, char** argv, const std::string& hot_restart_version,
+OptionsImpl::OptionsImpl(int argc, char** argv, const HotRestartVersionCb& hot_restart_version_cb,
                          spdlog::level::level_enum default_log_level) {
   std::string log_levels_string = "Log levels: ";
   for (size_t i = 0; i < ARRAY_SIZE(spdlog::level::level_names); i++) {
@@ -33,6 +36,10 @@ OptionsImpl::OptionsImpl(int argc, char** argv, const std::string& hot_restart_v
                                            "", "string", cmd);
   TCLAP::ValueArg<std::string> admin_address_path("", "admin-address-path", "Admin address path",
                                                   false, "", "string", cmd);
+  TCLAP::ValueArg<std::string> xds_cache_dir(
+      "", "xds-cache-dir",
+      "Directory to cache the last accepted xDS resources in, and to start from on restart", false,
+      "", "string", cmd);
   TCLAP::ValueArg<std::string> local_address_ip_version("", "local-address-ip-version",
                                                         "The local "
                                                         "IP address version (v4 or v6).",
@@ -40,6 +47,10 @@ OptionsImpl::OptionsImpl(int argc, char** argv, const std::string& hot_restart_v
   TCLAP::ValueArg<std::string> log_level("l", "log-level", log_levels_string, false,
                                          spdlog::level::level_names[default_log_level], "string",
                                          cmd);
+  TCLAP::ValueArg<uint32_t> log_async_buffer_size(
+      "", "log-async-buffer-size",
+      "Log messages each thread buffers for a background thread to write (0 logs synchronously)",
+      false, 0, "uint32_t", cmd);
   TCLAP::ValueArg<uint64_t> restart_epoch("", "restart-epoch", "hot restart epoch #", false, 0,
                                           "uint64_t", cmd);
   TCLAP::SwitchArg hot_restart_version_option("", "hot-restart-version",
@@ -55,9 +66,83 @@ OptionsImpl::OptionsImpl(int argc, char** argv, const std::string& hot_restart_v
                                                      10000, "uint64_t", cmd);
   TCLAP::ValueArg<uint64_t> drain_time_s("", "drain-time-s", "Hot restart drain time in seconds",
                                          false, 600, "uint64_t", cmd);
+  TCLAP::ValueArg<uint32_t> drain_close_rate(
+      "", "drain-close-rate",
+      "Maximum connections per second each worker closes while draining (0 for no limit)", false,
+      0, "uint32_t", cmd);
   TCLAP::ValueArg<uint64_t> parent_shutdown_time_s("", "parent-shutdown-time-s",
                                                    "Hot restart parent shutdown time in seconds",
                                                    false, 900, "uint64_t", cmd);
+  TCLAP::ValueArg<uint32_t> max_stats("", "max-stats",
+                                      "Maximum number of stats kept in hot restart shared memory",
+                                      false, 16384, "uint32_t", cmd);
+  TCLAP::ValueArg<uint64_t> connection_read_budget_bytes(
+      "", "connection-read-budget-bytes",
+      "Maximum bytes a connection reads per read event (0 for no limit)", false, 262144,
+      "uint64_t", cmd);
+  TCLAP::ValueArg<std::string> event_backend(
+      "", "event-backend",
+      "Event loop backend: one of 'epoll', 'epoll_changelist', 'poll', 'select' or 'kqueue' "
+      "(default: the best one of the platform)",
+      false, "", "string", cmd);
+  TCLAP::ValueArg<uint32_t> max_accepts_per_event(
+      "", "max-accepts-per-event",
+      "Maximum connections a listener accepts per event loop iteration (0 for no limit)", false, 64,
+      "uint32_t", cmd);
+  TCLAP::SwitchArg balance_connections(
+      "", "balance-connections", "Hand new connections to the worker with the fewest connections",
+      cmd);
+  TCLAP::ValueArg<uint32_t> private_key_threads(
+      "", "private-key-threads",
+      "Threads that run the private key operations of TLS handshakes (0 runs them on the workers)",
+      false, 0, "uint32_t", cmd);
+  TCLAP::ValueArg<std::string> worker_cpus(
+      "", "worker-cpus",
+      "CPUs to pin the workers to, one per worker in round robin order (e.g. '0-3,8-11')", false,
+      "", "string", cmd);
+  TCLAP::ValueArg<uint64_t> dns_cache_max_ttl_s(
+      "", "dns-cache-max-ttl-s",
+      "Longest time in seconds a DNS answer is cached for (0 disables the cache)", false, 0,
+      "uint64_t", cmd);
+  TCLAP::ValueArg<uint64_t> dns_cache_min_ttl_s(
+      "", "dns-cache-min-ttl-s", "Shortest time in seconds a DNS answer is cached for", false, 0,
+      "uint64_t", cmd);
+  TCLAP::ValueArg<uint64_t> dns_cache_negative_ttl_s(
+      "", "dns-cache-negative-ttl-s",
+      "Time in seconds a DNS name that does not resolve is cached for", false, 0, "uint64_t", cmd);
+  TCLAP::ValueArg<uint64_t> dns_cache_stale_ttl_s(
+      "", "dns-cache-stale-ttl-s",
+      "Time in seconds an expired DNS answer is served for while it is resolved again", false, 0,
+      "uint64_t", cmd);
+  TCLAP::ValueArg<uint64_t> overload_max_heap_bytes(
+      "", "overload-max-heap-bytes",
+      "Heap size in bytes that the overload manager sheds load to stay under (0 disables the "
+      "limit)",
+      false, 0, "uint64_t", cmd);
+  TCLAP::ValueArg<uint64_t> overload_max_connections(
+      "", "overload-max-connections",
+      "Downstream connections that the overload manager sheds load to stay under (0 disables the "
+      "limit)",
+      false, 0, "uint64_t", cmd);
+  TCLAP::ValueArg<uint64_t> overload_max_active_streams(
+      "", "overload-max-active-streams",
+      "Active downstream HTTP streams that the overload manager sheds load to stay under (0 "
+      "disables the limit)",
+      false, 0, "uint64_t", cmd);
+  TCLAP::ValueArg<uint64_t> overload_refresh_interval_ms(
+      "", "overload-refresh-interval-ms",
+      "How often the overload manager measures the resources in milliseconds", false, 1000,
+      "uint64_t", cmd);
+  TCLAP::SwitchArg watchdog_sample_stacks(
+      "", "watchdog-sample-stacks",
+      "Sample the stack of a thread that misses its watchdog deadline", cmd);
+  TCLAP::MultiArg<std::string> stats_tag(
+      "", "stats-tag",
+      "A tag to extract from stat names, as <name>=<regex>, in addition to the default tags. The "
+      "first capture group of the regex is removed from the name, the last is the tag value",
+      false, "string", cmd);
+  TCLAP::SwitchArg reuse_port("", "reuse-port",
+                              "Give each worker its own SO_REUSEPORT listen socket", cmd);
   TCLAP::ValueArg<std::string> mode("", "mode",
                                     "One of 'serve' (default; validate configs and then serve "
                                     "traffic normally) or 'validate' (validate configs and exit).",
@@ -70,8 +155,13 @@ OptionsImpl::OptionsImpl(int argc, char** argv, const std::string& hot_restart_v
     exit(1);
   }
 
+  if (max_stats.getValue() == 0 || max_stats.getValue() > MAX_STATS) {
+    std::cerr << "error: --max-stats must be between 1 and " << MAX_STATS << std::endl;
+    exit(1);
+  }
+
   if (hot_restart_version_option.getValue()) {
-    std::cerr << hot_restart_version;
+    std::cerr << hot_restart_version_cb(max_stats.getValue());
     exit(0);
   }
 
@@ -101,17 +191,80 @@ OptionsImpl::OptionsImpl(int argc, char** argv, const std::string& hot_restart_v
     exit(1);
   }
 
+  const std::vector<std::string> event_backends{"",     "epoll",  "epoll_changelist",
+                                                "poll", "select", "kqueue"};
+  if (std::find(event_backends.begin(), event_backends.end(), event_backend.getValue()) ==
+      event_backends.end()) {
+    std::cerr << "error: unknown event backend '" << event_backend.getValue() << "'" << std::endl;
+    exit(1);
+  }
+
+  if (!parseCpuList(worker_cpus.getValue(), worker_cpus_)) {
+    std::cerr << "error: invalid CPU list '" << worker_cpus.getValue() << "'" << std::endl;
+    exit(1);
+  }
+
+  for (const std::string& tag : stats_tag.getValue()) {
+    const size_t separator = tag.find('=');
+    if (separator == 0 || separator == std::string::npos) {
+      std::cerr << "error: invalid stats tag '" << tag << "'" << std::endl;
+      exit(1);
+    }
+    stats_tags_.emplace_back(tag.substr(0, separator), tag.substr(separator + 1));
+  }
+
   // For base ID, scale what the user inputs by 10 so that we have spread for domain sockets.
   base_id_ = base_id.getValue() * 10;
   concurrency_ = concurrency.getValue();
   config_path_ = config_path.getValue();
   admin_address_path_ = admin_address_path.getValue();
+  xds_cache_directory_ = xds_cache_dir.getValue();
+  log_async_buffer_size_ = log_async_buffer_size.getValue();
   restart_epoch_ = restart_epoch.getValue();
   service_cluster_ = service_cluster.getValue();
   service_node_ = service_node.getValue();
   service_zone_ = service_zone.getValue();
   file_flush_interval_msec_ = std::chrono::milliseconds(file_flush_interval_msec.getValue());
   drain_time_ = std::chrono::seconds(drain_time_s.getValue());
+  drain_close_rate_ = drain_close_rate.getValue();
   parent_shutdown_time_ = std::chrono::seconds(parent_shutdown_time_s.getValue());
+  max_stats_ = max_stats.getValue();
+  connection_read_budget_ = connection_read_budget_bytes.getValue();
+  event_backend_ = event_backend.getValue();
+  max_accepts_per_event_ = max_accepts_per_event.getValue();
+  reuse_port_ = reuse_port.getValue();
+  balance_connections_ = balance_connections.getValue();
+  private_key_threads_ = private_key_threads.getValue();
+  dns_cache_config_.max_ttl_ = std::chrono::seconds(dns_cache_max_ttl_s.getValue());
+  dns_cache_config_.min_ttl_ = std::chrono::seconds(dns_cache_min_ttl_s.getValue());
+  dns_cache_config_.negative_ttl_ = std::chrono::seconds(dns_cache_negative_ttl_s.getValue());
+  dns_cache_config_.stale_ttl_ = std::chrono::seconds(dns_cache_stale_ttl_s.getValue());
+  overload_config_.max_heap_bytes_ = overload_max_heap_bytes.getValue();
+  overload_config_.max_connections_ = overload_max_connections.getValue();
+  overload_config_.max_active_streams_ = overload_max_active_streams.getValue();
+  overload_config_.refresh_interval_ =
+      std::chrono::milliseconds(overload_refresh_interval_ms.getValue());
+  watchdog_sample_stacks_ = watchdog_sample_stacks.getValue();
+}
+
+bool OptionsImpl::parseCpuList(const std::string& list, std::vector<uint32_t>& cpus) {
+  cpus.clear();
+  if (list.empty()) {
+    return true;
+  }
+
+  for (const std::string& range : StringUtil::split(list, ",", true)) {
+    const std::vector<std::string> bounds = StringUtil::split(range, "-", true);
+    uint64_t first;
+    uint64_t last;
+    if (bounds.empty() || bounds.size() > 2 || !StringUtil::atoul(bounds[0].c_str(), first) ||
+        !StringUtil::atoul(bounds.back().c_str(), last) || first > last || last > MAX_CPU) {
+      return false;
+    }
+    for (uint64_t cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  return !cpus.empty();
 }
 } // namespace Envoy
@@ -2,7 +2,10 @@
 
 #include <chrono>
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "envoy/server/options.h"
 
@@ -14,7 +17,13 @@ namespace Envoy {
  */
 class OptionsImpl : public Server::Options {
 public:
-  OptionsImpl(int argc, char** argv, const std::string& hot_restart_version,
+  /**
+   * Callback to compute the hot restart compatibility version, which depends on the parsed
+   * --max-stats value.
+   */
+  typedef std::function<std::string(uint32_t max_stats)> HotRestartVersionCb;
+
+  OptionsImpl(int argc, char** argv, const HotRestartVersionCb& hot_restart_version_cb,
               spdlog::level::level_enum default_log_level);
 
   // Server::Options
@@ -22,31 +31,77 @@ public:
   uint32_t concurrency() override { return concurrency_; }
   const std::string& configPath() override { return config_path_; }
   const std::string& adminAddressPath() override { return admin_address_path_; }
+  const std::string& xdsCacheDirectory() override { return xds_cache_directory_; }
   Network::Address::IpVersion localAddressIpVersion() override { return local_address_ip_version_; }
   std::chrono::seconds drainTime() override { return drain_time_; }
+  uint32_t drainCloseRate() override { return drain_close_rate_; }
+  uint32_t maxStats() override { return max_stats_; }
+  uint64_t connectionReadBudget() override { return connection_read_budget_; }
+  const std::string& eventBackend() override { return event_backend_; }
+  uint32_t maxAcceptsPerEvent() override { return max_accepts_per_event_; }
   spdlog::level::level_enum logLevel() override { return log_level_; }
+  uint32_t logAsyncBufferSize() override { return log_async_buffer_size_; }
   std::chrono::seconds parentShutdownTime() override { return parent_shutdown_time_; }
   uint64_t restartEpoch() override { return restart_epoch_; }
+  bool reusePort() override { return reuse_port_; }
+  bool balanceConnections() override { return balance_connections_; }
+  uint32_t privateKeyThreads() override { return private_key_threads_; }
+  const std::vector<uint32_t>& workerCpus() override { return worker_cpus_; }
+  const Network::DnsCacheConfig& dnsCacheConfig() override { return dns_cache_config_; }
+  const Server::OverloadConfig& overloadConfig() override { return overload_config_; }
+  const std::vector<std::pair<std::string, std::string>>& statsTags() override {
+    return stats_tags_;
+  }
+  bool watchdogSampleStacks() override { return watchdog_sample_stacks_; }
   Server::Mode mode() const override { return mode_; }
   std::chrono::milliseconds fileFlushIntervalMsec() override { return file_flush_interval_msec_; }
   const std::string& serviceClusterName() override { return service_cluster_; }
   const std::string& serviceNodeName() override { return service_node_; }
   const std::string& serviceZone() override { return service_zone_; }
 
+  /**
+   * Parse a list of CPUs such as "0-3,8,10-11".
+   * @param list supplies the list.
+   * @param cpus receives the CPUs in list order.
+   * @return bool whether the list is valid. An empty list is valid and has no CPUs.
+   */
+  static bool parseCpuList(const std::string& list, std::vector<uint32_t>& cpus);
+
 private:
+  // The largest CPU number that a CPU list may name.
+  static const uint64_t MAX_CPU = 4095;
+  // The largest --max-stats. It keeps the shared memory stat set's bucket count well within a
+  // uint32_t and its region at a few hundred MB.
+  static const uint32_t MAX_STATS = 1048576;
+
   uint64_t base_id_;
   uint32_t concurrency_;
   std::string config_path_;
   std::string admin_address_path_;
+  std::string xds_cache_directory_;
   Network::Address::IpVersion local_address_ip_version_;
   spdlog::level::level_enum log_level_;
+  uint32_t log_async_buffer_size_;
   uint64_t restart_epoch_;
   std::string service_cluster_;
   std::string service_node_;
   std::string service_zone_;
   std::chrono::milliseconds file_flush_interval_msec_;
   std::chrono::seconds drain_time_;
+  uint32_t drain_close_rate_;
   std::chrono::seconds parent_shutdown_time_;
+  uint32_t max_stats_;
+  uint64_t connection_read_budget_;
+  std::string event_backend_;
+  uint32_t max_accepts_per_event_;
+  bool reuse_port_;
+  bool balance_connections_;
+  uint32_t private_key_threads_;
+  std::vector<uint32_t> worker_cpus_;
+  Network::DnsCacheConfig dns_cache_config_;
+  Server::OverloadConfig overload_config_;
+  std::vector<std::pair<std::string, std::string>> stats_tags_;
+  bool watchdog_sample_stacks_;
   Server::Mode mode_;
 };
 } // namespace Envoy
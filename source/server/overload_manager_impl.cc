@@ -0,0 +1,90 @@
+#include "server/overload_manager_impl.h"
+
+#include <algorithm>
+
+namespace Envoy {
+namespace Server {
+
+namespace {
+
+// How far the pressure has to fall below the threshold of an active action to stop it.
+const double HYSTERESIS = 0.1;
+
+double ratio(uint64_t use, uint64_t limit) {
+  return limit == 0 ? 0 : static_cast<double>(use) / limit;
+}
+
+} // namespace
+
+OverloadManagerImpl::OverloadManagerImpl(Event::Dispatcher& dispatcher, Stats::Scope& scope,
+                                         const OverloadConfig& config,
+                                         OverloadResourceUsageCb usage_cb)
+    : config_(config),
+      stats_{ALL_OVERLOAD_MANAGER_STATS(POOL_GAUGE_PREFIX(scope, "overload."))},
+      usage_cb_(usage_cb) {
+  // In the order of OverloadAction.
+  actions_.emplace_back(new Action("shrink_buffer_limits", config_.shrink_buffer_limits_threshold_,
+                                   stats_.shrink_buffer_limits_active_));
+  actions_.emplace_back(new Action("disable_http_keepalive",
+                                   config_.disable_http_keepalive_threshold_,
+                                   stats_.disable_http_keepalive_active_));
+  actions_.emplace_back(new Action("stop_accepting_connections",
+                                   config_.stop_accepting_connections_threshold_,
+                                   stats_.stop_accepting_connections_active_));
+  actions_.emplace_back(new Action("reject_new_streams", config_.reject_new_streams_threshold_,
+                                   stats_.reject_new_streams_active_));
+
+  if (config_.max_heap_bytes_ > 0 || config_.max_connections_ > 0 ||
+      config_.max_active_streams_ > 0) {
+    refresh_timer_ = dispatcher.createTimer([this]() -> void { refresh(); });
+  }
+}
+
+double OverloadManagerImpl::pressure(const OverloadResourceUsage& usage) const {
+  return std::max({ratio(usage.heap_bytes_, config_.max_heap_bytes_),
+                   ratio(usage.connections_, config_.max_connections_),
+                   ratio(usage.active_streams_, config_.max_active_streams_)});
+}
+
+void OverloadManagerImpl::refresh() {
+  const double current_pressure = pressure(usage_cb_());
+  stats_.pressure_percent_.set(current_pressure * 100);
+
+  for (const auto& action : actions_) {
+    const bool active =
+        current_pressure >= action->threshold_ ||
+        (action->active_ && current_pressure >= action->threshold_ - HYSTERESIS);
+    if (active == action->active_) {
+      continue;
+    }
+
+    ENVOY_LOG(warn, "overload action {} {} at {}% of the resource limits", action->name_,
+              active ? "started" : "stopped", static_cast<uint64_t>(current_pressure * 100));
+    action->active_ = active;
+    action->gauge_.set(active);
+    for (const auto& callback : action->callbacks_) {
+      const ActionCb& cb = callback.second;
+      callback.first->post([cb, active]() -> void { cb(active); });
+    }
+  }
+
+  refresh_timer_->enableTimer(config_.refresh_interval_);
+}
+
+void OverloadManagerImpl::start() {
+  if (refresh_timer_) {
+    refresh_timer_->enableTimer(config_.refresh_interval_);
+  }
+}
+
+void OverloadManagerImpl::registerForAction(OverloadAction action_name,
+                                            Event::Dispatcher& dispatcher, ActionCb callback) {
+  action(action_name).callbacks_.emplace_back(&dispatcher, callback);
+}
+
+bool OverloadManagerImpl::isActive(OverloadAction action_name) const {
+  return action(action_name).active_;
+}
+
+} // namespace Server
+} // namespace Envoy
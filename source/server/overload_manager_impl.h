@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "envoy/server/overload_manager.h"
+#include "envoy/stats/stats.h"
+#include "envoy/stats/stats_macros.h"
+
+#include "common/common/logger.h"
+
+namespace Envoy {
+namespace Server {
+
+/**
+ * All overload manager stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_OVERLOAD_MANAGER_STATS(GAUGE)                                                          \
+  GAUGE(pressure_percent)                                                                          \
+  GAUGE(shrink_buffer_limits_active)                                                               \
+  GAUGE(disable_http_keepalive_active)                                                             \
+  GAUGE(stop_accepting_connections_active)                                                         \
+  GAUGE(reject_new_streams_active)
+// clang-format on
+
+/**
+ * Struct definition for all overload manager stats. @see stats_macros.h
+ */
+struct OverloadManagerStats {
+  ALL_OVERLOAD_MANAGER_STATS(GENERATE_GAUGE_STRUCT)
+};
+
+/**
+ * The use of the resources that the overload manager limits.
+ */
+struct OverloadResourceUsage {
+  uint64_t heap_bytes_;
+  uint64_t connections_;
+  uint64_t active_streams_;
+};
+
+/**
+ * Measures the use of the resources. Called on the main thread.
+ */
+typedef std::function<OverloadResourceUsage()> OverloadResourceUsageCb;
+
+/**
+ * Implementation of OverloadManager that measures the resources on a timer of the main thread.
+ * The state of each action is an atomic, so that the workers can read it without locking, and the
+ * callbacks registered for an action are posted to their dispatchers when the state changes.
+ */
+class OverloadManagerImpl : public OverloadManager, Logger::Loggable<Logger::Id::main> {
+public:
+  OverloadManagerImpl(Event::Dispatcher& dispatcher, Stats::Scope& scope,
+                      const OverloadConfig& config, OverloadResourceUsageCb usage_cb);
+
+  /**
+   * @return double the pressure for a use of the resources, which is the highest ratio of the use
+   *         of a resource to its limit.
+   */
+  double pressure(const OverloadResourceUsage& usage) const;
+
+  /**
+   * Measure the resources and start or stop the actions. Called by the refresh timer.
+   */
+  void refresh();
+
+  // Server::OverloadManager
+  void start() override;
+  void registerForAction(OverloadAction action, Event::Dispatcher& dispatcher,
+                         ActionCb callback) override;
+  bool isActive(OverloadAction action) const override;
+
+private:
+  struct Action {
+    Action(const std::string& name, double threshold, Stats::Gauge& gauge)
+        : name_(name), threshold_(threshold), gauge_(gauge) {}
+
+    const std::string name_;
+    const double threshold_;
+    Stats::Gauge& gauge_;
+    std::atomic<bool> active_{};
+    std::vector<std::pair<Event::Dispatcher*, ActionCb>> callbacks_;
+  };
+
+  Action& action(OverloadAction action) const {
+    return *actions_[static_cast<size_t>(action)];
+  }
+
+  const OverloadConfig config_;
+  OverloadManagerStats stats_;
+  OverloadResourceUsageCb usage_cb_;
+  std::vector<std::unique_ptr<Action>> actions_;
+  Event::TimerPtr refresh_timer_;
+};
+
+} // namespace Server
+} // namespace Envoy
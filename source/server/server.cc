@@ -4,7 +4,9 @@
 
 #include <cstdint>
 #include <functional>
+#include <future>
 #include <string>
+#include <vector>
 
 #include "envoy/event/dispatcher.h"
 #include "envoy/event/signal.h"
@@ -18,12 +20,17 @@
 #include "common/common/version.h"
 #include "common/config/bootstrap_json.h"
 #include "common/local_info/local_info_impl.h"
+#include "common/memory/allocation_tracker.h"
 #include "common/memory/stats.h"
 #include "common/network/address_impl.h"
+#include "common/network/dns_impl.h"
+#include "common/profiler/profiler.h"
 #include "common/protobuf/utility.h"
 #include "common/router/rds_impl.h"
 #include "common/runtime/runtime_impl.h"
 #include "common/singleton/manager_impl.h"
+#include "common/stats/stats_impl.h"
+#include "common/ssl/private_key_operation_impl.h"
 #include "common/upstream/cluster_manager_impl.h"
 
 #include "server/configuration_impl.h"
@@ -44,11 +51,24 @@ InstanceImpl::InstanceImpl(Options& options, Network::Address::InstanceConstShar
       original_start_time_(start_time_),
       stats_store_(store), server_stats_{ALL_SERVER_STATS(
                                POOL_GAUGE_PREFIX(stats_store_, "server."))},
-      thread_local_(tls), api_(new Api::Impl(options.fileFlushIntervalMsec())),
-      dispatcher_(api_->allocateDispatcher()), singleton_manager_(new Singleton::ManagerImpl()),
-      handler_(new ConnectionHandlerImpl(ENVOY_LOGGER(), *dispatcher_)),
-      listener_component_factory_(*this), worker_factory_(thread_local_, *api_, hooks),
-      dns_resolver_(dispatcher_->createDnsResolver({})),
+      thread_local_(tls),
+      api_(new Api::Impl(options.fileFlushIntervalMsec(), options.connectionReadBudget(),
+                         options.eventBackend())),
+      dispatcher_(api_->allocateDispatcher()), admin_dispatcher_(api_->allocateDispatcher()),
+      overload_manager_(new OverloadManagerImpl(
+          *dispatcher_, stats_store_, options.overloadConfig(),
+          [this]() -> OverloadResourceUsage {
+            return {Memory::Stats::totalCurrentlyReserved(), numConnections(), numActiveStreams()};
+          })),
+      singleton_manager_(new Singleton::ManagerImpl()),
+      handler_(new ConnectionHandlerImpl(ENVOY_LOGGER(), *admin_dispatcher_)),
+      listener_component_factory_(*this),
+      worker_factory_(thread_local_, *api_, hooks, store, options.balanceConnections(),
+                      options.workerCpus(), *overload_manager_,
+                      options.overloadConfig().shrunk_buffer_limit_bytes_),
+      dns_resolver_(std::make_shared<Network::DnsResolverImpl>(
+          *dispatcher_, std::vector<Network::Address::InstanceConstSharedPtr>{},
+          options.dnsCacheConfig())),
       access_log_manager_(*api_, *dispatcher_, access_log_lock, store) {
 
   failHealthcheck(false);
@@ -90,25 +110,50 @@ void InstanceImpl::failHealthcheck(bool fail) {
   server_stats_.live_.set(!fail);
 }
 
-void InstanceUtil::flushCountersAndGaugesToSinks(const std::list<Stats::SinkPtr>& sinks,
-                                                 Stats::Store& store) {
+void InstanceUtil::flushMetricsToSinks(const std::list<Stats::SinkPtr>& sinks,
+                                       Stats::Store& store) {
   for (const auto& sink : sinks) {
     sink->beginFlush();
   }
 
-  for (const Stats::CounterSharedPtr& counter : store.counters()) {
+  // Only stats that changed since the previous flush are visited. Changes are tracked per stat
+  // object, so a counter shared by overlapping scopes can show up twice. The second latch() returns
+  // zero and is skipped.
+  for (const Stats::CounterSharedPtr& counter : store.latchChangedCounters()) {
     uint64_t delta = counter->latch();
-    if (counter->used()) {
+    if (delta > 0) {
       for (const auto& sink : sinks) {
-        sink->flushCounter(counter->name(), delta);
+        sink->flushCounter(*counter, delta);
       }
     }
   }
 
-  for (const Stats::GaugeSharedPtr& gauge : store.gauges()) {
-    if (gauge->used()) {
+  // Sinks that start over get every gauge, the others only the gauges that changed. The changes
+  // are latched either way so that the next flush starts from this one.
+  std::vector<Stats::Sink*> all_gauge_sinks;
+  std::vector<Stats::Sink*> changed_gauge_sinks;
+  for (const auto& sink : sinks) {
+    (sink->wantsAllGauges() ? all_gauge_sinks : changed_gauge_sinks).push_back(sink.get());
+  }
+
+  for (const Stats::GaugeSharedPtr& gauge : store.latchChangedGauges()) {
+    for (Stats::Sink* sink : changed_gauge_sinks) {
+      sink->flushGauge(*gauge, gauge->value());
+    }
+  }
+
+  if (!all_gauge_sinks.empty()) {
+    for (const Stats::GaugeSharedPtr& gauge : store.gauges()) {
+      for (Stats::Sink* sink : all_gauge_sinks) {
+        sink->flushGauge(*gauge, gauge->value());
+      }
+    }
+  }
+
+  for (const Stats::ParentHistogramSharedPtr& histogram : store.histograms()) {
+    if (histogram->used()) {
       for (const auto& sink : sinks) {
-        sink->flushGauge(gauge->name(), gauge->value());
+        sink->flushHistogram(*histogram);
       }
     }
   }
@@ -120,6 +165,12 @@ void InstanceUtil::flushCountersAndGaugesToSinks(const std::list<Stats::SinkPtr>
 
 void InstanceImpl::flushStats() {
   ENVOY_LOG(debug, "flushing stats");
+  // Histograms are merged from all worker threads first, which completes asynchronously on the
+  // main thread.
+  stats_store_.mergeHistograms([this]() -> void { flushStatsInternal(); });
+}
+
+void InstanceImpl::flushStatsInternal() {
   HotRestart::GetParentStatsInfo info;
   restarter_.getParentStats(info);
   server_stats_.uptime_.set(time(nullptr) - original_start_time_);
@@ -131,7 +182,7 @@ void InstanceImpl::flushStats() {
   server_stats_.days_until_first_cert_expiring_.set(
       sslContextManager().daysUntilFirstCertExpires());
 
-  InstanceUtil::flushCountersAndGaugesToSinks(config_->statsSinks(), stats_store_);
+  InstanceUtil::flushMetricsToSinks(config_->statsSinks(), stats_store_);
   stat_flush_timer_->enableTimer(config_->statsFlushInterval());
 }
 
@@ -181,6 +232,15 @@ void InstanceImpl::initialize(Options& options,
   handler_->addListener(*admin_, admin_->mutable_socket(), *admin_scope_, 0,
                         Network::ListenerOptions::listenerOptionsWithBindToPort());
 
+  // The admin thread registers for thread local updates before any slot is allocated, like the
+  // workers. Its dispatch loop starts with the main one.
+  thread_local_.registerThread(*admin_dispatcher_, false);
+  // So does the maintenance thread, since the health checks read the runtime and the stats.
+  if (InstanceUtil::maintenanceThreadEnabled(*this, initial_config)) {
+    maintenance_dispatcher_ = api_->allocateDispatcher();
+    thread_local_.registerThread(*maintenance_dispatcher_, false);
+  }
+
   loadServerFlags(initial_config.flagsPath());
 
   // Workers get created first so they register for thread local updates.
@@ -193,17 +253,23 @@ void InstanceImpl::initialize(Options& options,
 
   // We can now initialize stats for threading.
   stats_store_.initializeThreading(*dispatcher_, thread_local_);
+  dispatcher_->initializeStats(stats_store_, "server.dispatcher.");
 
   // Runtime gets initialized before the main configuration since during main configuration
   // load things may grab a reference to the loader for later use.
   runtime_loader_ = component_factory.createRuntime(*this, initial_config);
 
   // Once we have runtime we can initialize the SSL context manager.
-  ssl_context_manager_.reset(new Ssl::ContextManagerImpl(*runtime_loader_));
+  Ssl::PrivateKeyOperationProviderSharedPtr private_key_provider;
+  if (options.privateKeyThreads() > 0) {
+    private_key_provider.reset(
+        new Ssl::ThreadPoolPrivateKeyOperationProvider(options.privateKeyThreads()));
+  }
+  ssl_context_manager_.reset(new Ssl::ContextManagerImpl(*runtime_loader_, private_key_provider));
 
   cluster_manager_factory_.reset(new Upstream::ProdClusterManagerFactory(
       runtime(), stats(), threadLocal(), random(), dnsResolver(), sslContextManager(), dispatcher(),
-      localInfo()));
+      localInfo(), options.xdsCacheDirectory(), maintenance_dispatcher_.get()));
 
   // Now the configuration gets parsed. The configuration may start setting thread local data
   // per above. See MainImpl::initialize() for why we do this pointer dance.
@@ -222,12 +288,22 @@ void InstanceImpl::initialize(Options& options,
 
   // GuardDog (deadlock detection) object and thread setup before workers are
   // started and before our own run() loop runs.
-  guard_dog_.reset(
-      new Server::GuardDogImpl(stats_store_, *config_, ProdMonotonicTimeSource::instance_));
+  GuardDogImpl* guard_dog = new Server::GuardDogImpl(
+      stats_store_, *config_, ProdMonotonicTimeSource::instance_, options.watchdogSampleStacks());
+  guard_dog_.reset(guard_dog);
+  if (options.watchdogSampleStacks()) {
+    admin_->addHandler("/watchdog_stalls", "print the stall sites sampled by the watchdog",
+                       [guard_dog](const std::string&, Buffer::Instance& response) -> Http::Code {
+                         response.add(guard_dog->stallSites());
+                         return Http::Code::OK;
+                       },
+                       false);
+  }
 }
 
 void InstanceImpl::startWorkers() {
   listener_manager_->startWorkers(*guard_dog_);
+  overload_manager_->start();
 
   // At this point we are ready to take traffic and all listening ports are up. Notify our parent
   // if applicable that they can stop listening and drain.
@@ -253,6 +329,26 @@ Runtime::LoaderPtr InstanceUtil::createRuntime(Instance& server,
   }
 }
 
+bool InstanceUtil::maintenanceThreadEnabled(Instance& server,
+                                            Server::Configuration::Initial& config) {
+  if (!config.runtime()) {
+    return false;
+  }
+
+  // The runtime stats only count the loads of the runtime loader.
+  Stats::IsolatedStoreImpl store;
+  Runtime::RuntimeStats stats{ALL_RUNTIME_STATS(POOL_COUNTER_PREFIX(store, "runtime."),
+                                                POOL_GAUGE_PREFIX(store, "runtime."))};
+  const std::string& root = config.runtime()->symlinkRoot();
+  const std::string override_path = root + "/" + config.runtime()->overrideSubdirectory() + "/" +
+                                    server.localInfo().clusterName();
+  const Runtime::SnapshotImpl snapshot(
+      std::make_shared<Runtime::DiskLayerImpl>(root + "/" + config.runtime()->subdirectory(),
+                                               override_path, stats),
+      std::make_shared<Runtime::LayerImpl>(), {}, server.random());
+  return snapshot.getInteger("health_check.maintenance_thread", 0) != 0;
+}
+
 void InstanceImpl::loadServerFlags(const Optional<std::string>& flags_path) {
   if (!flags_path.valid()) {
     return;
@@ -267,6 +363,20 @@ void InstanceImpl::loadServerFlags(const Optional<std::string>& flags_path) {
 
 uint64_t InstanceImpl::numConnections() { return listener_manager_->numConnections(); }
 
+uint64_t InstanceImpl::numActiveStreams() {
+  // Every HTTP connection manager counts its active streams in http.<stat_prefix>.
+  static const std::string suffix = ".downstream_rq_active";
+  uint64_t num_active_streams = 0;
+  for (const Stats::GaugeSharedPtr& gauge : stats_store_.gauges()) {
+    const std::string& name = gauge->name();
+    if (name.compare(0, 5, "http.") == 0 && name.size() > suffix.size() &&
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+      num_active_streams += gauge->value();
+    }
+  }
+  return num_active_streams;
+}
+
 RunHelper::RunHelper(Event::Dispatcher& dispatcher, Upstream::ClusterManager& cm,
                      HotRestart& hot_restart, AccessLog::AccessLogManager& access_log_manager,
                      InitManagerImpl& init_manager, std::function<void()> workers_start_cb) {
@@ -313,11 +423,20 @@ void InstanceImpl::run() {
   RunHelper helper(*dispatcher_, clusterManager(), restarter_, access_log_manager_, init_manager_,
                    [this]() -> void { startWorkers(); });
 
+  admin_thread_.reset(new Thread::Thread([this]() -> void { adminThreadRoutine(); }));
+  if (maintenance_dispatcher_) {
+    maintenance_thread_.reset(new Thread::Thread([this]() -> void { maintenanceThreadRoutine(); }));
+  }
+
   // Run the main dispatch loop waiting to exit.
   ENVOY_LOG(warn, "starting main dispatch loop");
   auto watchdog = guard_dog_->createWatchDog(Thread::Thread::currentThreadId());
   watchdog->startWatchdog(*dispatcher_);
+  Profiler::CpuSampler::registerThread();
+  Memory::AllocationTracker::registerThread("main");
   dispatcher_->run(Event::Dispatcher::RunType::Block);
+  Memory::AllocationTracker::unregisterThread();
+  Profiler::CpuSampler::unregisterThread();
   ENVOY_LOG(warn, "main dispatch loop exited");
   guard_dog_->stopWatching(watchdog);
   watchdog.reset();
@@ -330,6 +449,8 @@ void InstanceImpl::run() {
 
   // Shutdown all the workers now that the main dispatch loop is done.
   listener_manager_->stopWorkers();
+  admin_dispatcher_->exit();
+  admin_thread_->join();
 
   // Only flush if we have not been hot restarted.
   if (stat_flush_timer_) {
@@ -337,12 +458,40 @@ void InstanceImpl::run() {
   }
 
   config_->clusterManager().shutdown();
-  handler_.reset();
+
+  // The health checkers of the clusters are released on the maintenance thread, which exits once
+  // it has run everything that was posted to it before.
+  if (maintenance_thread_) {
+    maintenance_dispatcher_->post([this]() -> void { maintenance_dispatcher_->exit(); });
+    maintenance_thread_->join();
+  }
   thread_local_.shutdownThread();
   ENVOY_LOG(warn, "exiting");
   ENVOY_FLUSH_LOG();
 }
 
+void InstanceImpl::adminThreadRoutine() {
+  Memory::AllocationTracker::registerThread("admin");
+  ENVOY_LOG(info, "admin entering dispatch loop");
+  admin_dispatcher_->run(Event::Dispatcher::RunType::Block);
+  ENVOY_LOG(info, "admin exited dispatch loop");
+
+  // As on the workers, the admin connections are closed on their own thread, so that their
+  // destructors do not run on the main thread.
+  handler_.reset();
+  thread_local_.shutdownThread();
+  Memory::AllocationTracker::unregisterThread();
+}
+
+void InstanceImpl::maintenanceThreadRoutine() {
+  Memory::AllocationTracker::registerThread("maintenance");
+  ENVOY_LOG(info, "maintenance entering dispatch loop");
+  maintenance_dispatcher_->run(Event::Dispatcher::RunType::Block);
+  ENVOY_LOG(info, "maintenance exited dispatch loop");
+  thread_local_.shutdownThread();
+  Memory::AllocationTracker::unregisterThread();
+}
+
 Runtime::Loader& InstanceImpl::runtime() { return *runtime_loader_; }
 
 void InstanceImpl::shutdown() {
@@ -353,8 +502,16 @@ void InstanceImpl::shutdown() {
 void InstanceImpl::shutdownAdmin() {
   ENVOY_LOG(warn, "shutting down admin due to child startup");
   stat_flush_timer_.reset();
-  handler_->stopListeners();
-  admin_->mutable_socket().close();
+
+  // The admin listener belongs to the admin thread. Its socket must be closed before this returns,
+  // so that the child can bind the admin address.
+  std::promise<void> closed;
+  admin_dispatcher_->post([this, &closed]() -> void {
+    handler_->stopListeners();
+    admin_->mutable_socket().close();
+    closed.set_value();
+  });
+  closed.get_future().wait();
 
   ENVOY_LOG(warn, "terminating parent process");
   restarter_.terminateParent();
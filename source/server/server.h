@@ -17,12 +17,14 @@
 #include "envoy/tracing/http_tracer.h"
 
 #include "common/access_log/access_log_manager_impl.h"
+#include "common/common/thread.h"
 #include "common/runtime/runtime_impl.h"
 #include "common/ssl/context_manager_impl.h"
 
 #include "server/http/admin.h"
 #include "server/init_manager_impl.h"
 #include "server/listener_manager_impl.h"
+#include "server/overload_manager_impl.h"
 #include "server/test_hooks.h"
 #include "server/worker_impl.h"
 
@@ -78,13 +80,22 @@ public:
   static Runtime::LoaderPtr createRuntime(Instance& server, Server::Configuration::Initial& config);
 
   /**
-   * Helper for flushing counters and gauges to sinks. This takes care of calling beginFlush(),
-   * latching of counters and flushing, flushing of gauges, and calling endFlush(), on each sink.
+   * Read the health_check.maintenance_thread runtime setting from the runtime directory of the
+   * configuration. The maintenance thread registers for thread local updates before the runtime
+   * loader is created, so the setting is read before the loader can supply it.
+   * @return bool whether the server creates a maintenance thread for the health checks.
+   */
+  static bool maintenanceThreadEnabled(Instance& server, Server::Configuration::Initial& config);
+
+  /**
+   * Helper for flushing counters, gauges, and histograms to sinks. This takes care of calling
+   * beginFlush(), latching of counters and flushing, flushing of gauges and merged histograms, and
+   * calling endFlush(), on each sink. Only counters and gauges that changed since the previous
+   * flush are flushed.
    * @param sinks supplies the list of sinks.
    * @param store supplies the store to flush.
    */
-  static void flushCountersAndGaugesToSinks(const std::list<Stats::SinkPtr>& sinks,
-                                            Stats::Store& store);
+  static void flushMetricsToSinks(const std::list<Stats::SinkPtr>& sinks, Stats::Store& store);
 };
 
 /**
@@ -144,6 +155,7 @@ public:
   Singleton::Manager& singletonManager() override { return *singleton_manager_; }
   bool healthCheckFailed() override;
   Options& options() override { return options_; }
+  OverloadManager& overloadManager() override { return *overload_manager_; }
   time_t startTimeCurrentEpoch() override { return start_time_; }
   time_t startTimeFirstEpoch() override { return original_start_time_; }
   Stats::Store& stats() override { return stats_store_; }
@@ -153,11 +165,15 @@ public:
 
 private:
   void flushStats();
+  void flushStatsInternal();
   void initialize(Options& options, Network::Address::InstanceConstSharedPtr local_address,
                   ComponentFactory& component_factory);
   void loadServerFlags(const Optional<std::string>& flags_path);
   uint64_t numConnections();
+  uint64_t numActiveStreams();
   void startWorkers();
+  void adminThreadRoutine();
+  void maintenanceThreadRoutine();
 
   Options& options_;
   HotRestart& restarter_;
@@ -168,9 +184,17 @@ private:
   ThreadLocal::Instance& thread_local_;
   Api::ApiPtr api_;
   Event::DispatcherPtr dispatcher_;
+  // Serves the admin listener on a thread of its own. @see AdminFilter.
+  Event::DispatcherPtr admin_dispatcher_;
+  // Runs the health checks of the clusters on a thread of their own, so that their intervals are
+  // not delayed by the work of the main thread. Only created if the runtime enables it at startup.
+  Event::DispatcherPtr maintenance_dispatcher_;
+  std::unique_ptr<OverloadManagerImpl> overload_manager_;
   std::unique_ptr<AdminImpl> admin_;
   Singleton::ManagerPtr singleton_manager_;
   Network::ConnectionHandlerPtr handler_;
+  Thread::ThreadPtr admin_thread_;
+  Thread::ThreadPtr maintenance_thread_;
   Runtime::RandomGeneratorImpl random_generator_;
   Runtime::LoaderPtr runtime_loader_;
   std::unique_ptr<Ssl::ContextManagerImpl> ssl_context_manager_;
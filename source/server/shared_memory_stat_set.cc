@@ -0,0 +1,117 @@
+#include "server/shared_memory_stat_set.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "common/common/assert.h"
+#include "common/common/hash.h"
+
+namespace Envoy {
+namespace Server {
+
+namespace {
+
+// Round up to a multiple of the alignment of RawStatData so the slots are properly aligned.
+uint64_t align(uint64_t size) {
+  const uint64_t alignment = alignof(Stats::RawStatData);
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+uint32_t SharedMemoryStatSet::numBuckets(uint32_t capacity) {
+  // Keep the load factor at or below 1/2 so chains stay short. Odd bucket counts spread hashes
+  // better than powers of 2.
+  return capacity * 2 + 1;
+}
+
+uint64_t SharedMemoryStatSet::bytesRequired(uint32_t capacity) {
+  return align(sizeof(Header) + sizeof(uint32_t) * numBuckets(capacity) +
+               sizeof(uint32_t) * capacity) +
+         sizeof(Stats::RawStatData) * capacity;
+}
+
+SharedMemoryStatSet::SharedMemoryStatSet(uint8_t* memory, uint32_t capacity, bool initialize)
+    : header_(reinterpret_cast<Header*>(memory)),
+      buckets_(reinterpret_cast<uint32_t*>(memory + sizeof(Header))),
+      next_(buckets_ + numBuckets(capacity)),
+      slots_(reinterpret_cast<Stats::RawStatData*>(
+          memory + align(sizeof(Header) + sizeof(uint32_t) * numBuckets(capacity) +
+                         sizeof(uint32_t) * capacity))) {
+  if (!initialize) {
+    RELEASE_ASSERT(header_->capacity_ == capacity);
+    RELEASE_ASSERT(header_->num_buckets_ == numBuckets(capacity));
+    return;
+  }
+
+  header_->capacity_ = capacity;
+  header_->num_buckets_ = numBuckets(capacity);
+  header_->size_ = 0;
+  header_->free_head_ = capacity > 0 ? 0 : NONE;
+  for (uint32_t i = 0; i < header_->num_buckets_; i++) {
+    buckets_[i] = NONE;
+  }
+  for (uint32_t i = 0; i < capacity; i++) {
+    next_[i] = i + 1 < capacity ? i + 1 : NONE;
+  }
+  memset(slots_, 0, sizeof(Stats::RawStatData) * capacity);
+}
+
+uint32_t& SharedMemoryStatSet::bucketHead(const std::string& name) {
+  // The hash must be stable across processes and builds, since a hot restarted process may be a
+  // different binary than its parent. Hash the truncated name so that lookups of long names land in
+  // the same bucket as the stored (truncated) copy.
+  const size_t length = std::min<size_t>(name.size(), Stats::RawStatData::MAX_NAME_SIZE);
+  return buckets_[HashUtil::xxHash64(name.data(), length) % header_->num_buckets_];
+}
+
+Stats::RawStatData* SharedMemoryStatSet::find(const std::string& name) {
+  for (uint32_t i = bucketHead(name); i != NONE; i = next_[i]) {
+    if (slots_[i].matches(name)) {
+      return &slots_[i];
+    }
+  }
+
+  return nullptr;
+}
+
+Stats::RawStatData* SharedMemoryStatSet::insert(const std::string& name) {
+  ASSERT(find(name) == nullptr);
+  if (header_->free_head_ == NONE) {
+    return nullptr;
+  }
+
+  const uint32_t index = header_->free_head_;
+  header_->free_head_ = next_[index];
+
+  uint32_t& head = bucketHead(name);
+  next_[index] = head;
+  head = index;
+  header_->size_++;
+
+  slots_[index].initialize(name);
+  return &slots_[index];
+}
+
+void SharedMemoryStatSet::remove(Stats::RawStatData& data) {
+  const uint32_t index = &data - slots_;
+  ASSERT(index < header_->capacity_);
+
+  // Unlink the slot from its bucket chain.
+  uint32_t* link = &bucketHead(data.name_);
+  while (*link != index) {
+    ASSERT(*link != NONE);
+    link = &next_[*link];
+  }
+  *link = next_[index];
+
+  memset(&data, 0, sizeof(Stats::RawStatData));
+  next_[index] = header_->free_head_;
+  header_->free_head_ = index;
+  header_->size_--;
+}
+
+} // namespace Server
+} // namespace Envoy
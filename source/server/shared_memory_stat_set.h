@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "common/stats/stats_impl.h"
+
+namespace Envoy {
+namespace Server {
+
+/**
+ * A fixed capacity hash set of RawStatData laid out in a caller provided block of memory, suitable
+ * for placing in shared memory. Only indexes are stored (never pointers) so that processes that map
+ * the memory at different addresses can share it. Lookup by name is O(1) on average instead of a
+ * linear scan over all slots.
+ *
+ * Layout: a header, then one bucket head per bucket, then one chain link per slot, then the slots.
+ * Unused slots form a free list threaded through the chain links. The caller is responsible for
+ * locking.
+ */
+class SharedMemoryStatSet {
+public:
+  /**
+   * @return uint64_t the number of bytes of memory needed for a set with the given capacity.
+   */
+  static uint64_t bytesRequired(uint32_t capacity);
+
+  /**
+   * @param memory supplies memory of at least bytesRequired(capacity) bytes aligned for
+   *        RawStatData.
+   * @param capacity supplies the maximum number of stats in the set.
+   * @param initialize supplies whether to format the memory (first process) or attach to memory
+   *        formatted by another process, in which case the capacity must match.
+   */
+  SharedMemoryStatSet(uint8_t* memory, uint32_t capacity, bool initialize);
+
+  /**
+   * @return RawStatData* the stat with the given name or nullptr if there is none.
+   */
+  Stats::RawStatData* find(const std::string& name);
+
+  /**
+   * Insert an initialized stat with the given name, which must not be in the set already.
+   * @return RawStatData* the new stat or nullptr if the set is full.
+   */
+  Stats::RawStatData* insert(const std::string& name);
+
+  /**
+   * Remove and clear a stat previously returned by insert().
+   */
+  void remove(Stats::RawStatData& data);
+
+  /**
+   * @return uint32_t the number of stats in the set.
+   */
+  uint32_t size() const { return header_->size_; }
+
+  /**
+   * @return uint32_t the maximum number of stats in the set.
+   */
+  uint32_t capacity() const { return header_->capacity_; }
+
+private:
+  static const uint32_t NONE = UINT32_MAX;
+
+  struct Header {
+    uint32_t capacity_;
+    uint32_t num_buckets_;
+    uint32_t size_;
+    uint32_t free_head_;
+  };
+
+  static uint32_t numBuckets(uint32_t capacity);
+  uint32_t& bucketHead(const std::string& name);
+
+  Header* header_;
+  uint32_t* buckets_;
+  uint32_t* next_;
+  Stats::RawStatData* slots_;
+};
+
+} // namespace Server
+} // namespace Envoy
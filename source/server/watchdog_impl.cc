@@ -8,6 +8,9 @@ namespace Envoy {
 namespace Server {
 
 void WatchDogImpl::startWatchdog(Event::Dispatcher& dispatcher) {
+  // A callback that runs for longer than the touch interval delays the touch, so it is reported as
+  // the likely cause of a watchdog miss.
+  dispatcher.setSlowCallbackThreshold(timer_interval_);
   timer_ = dispatcher.createTimer([this]() -> void {
     this->touch();
     timer_->enableTimer(timer_interval_);
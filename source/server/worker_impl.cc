@@ -8,22 +8,53 @@
 #include "envoy/thread_local/thread_local.h"
 
 #include "common/common/thread.h"
+#include "common/memory/allocation_tracker.h"
+#include "common/profiler/profiler.h"
 
-#include "server/connection_handler_impl.h"
+#include "fmt/format.h"
 
 namespace Envoy {
 namespace Server {
 
 WorkerPtr ProdWorkerFactory::createWorker() {
+  const uint32_t index = next_worker_index_++;
   Event::DispatcherPtr dispatcher(api_.allocateDispatcher());
-  return WorkerPtr{new WorkerImpl(
-      tls_, hooks_, std::move(dispatcher),
-      Network::ConnectionHandlerPtr{new ConnectionHandlerImpl(ENVOY_LOGGER(), *dispatcher)})};
+  Stats::ScopePtr stats_scope = stats_scope_.createScope(fmt::format("server.worker_{}.", index));
+  dispatcher->initializeStats(*stats_scope, "dispatcher.");
+  ConnectionHandlerImpl* handler_impl =
+      new ConnectionHandlerImpl(ENVOY_LOGGER(), *dispatcher, *stats_scope, balancer_.get());
+  Network::ConnectionHandlerPtr handler{handler_impl};
+
+  // The callbacks run on the dispatcher of the worker, which only runs while the worker owns the
+  // handler.
+  overload_manager_.registerForAction(OverloadAction::StopAcceptingConnections, *dispatcher,
+                                      [handler_impl](bool active) -> void {
+                                        if (active) {
+                                          handler_impl->disableListeners();
+                                        } else {
+                                          handler_impl->enableListeners();
+                                        }
+                                      });
+  const uint32_t shrunk_buffer_limit_bytes = shrunk_buffer_limit_bytes_;
+  overload_manager_.registerForAction(
+      OverloadAction::ShrinkBufferLimits, *dispatcher,
+      [handler_impl, shrunk_buffer_limit_bytes](bool active) -> void {
+        handler_impl->setBufferLimitCap(active ? shrunk_buffer_limit_bytes : 0);
+      });
+  Optional<uint32_t> cpu;
+  if (!worker_cpus_.empty()) {
+    cpu.value(worker_cpus_[index % worker_cpus_.size()]);
+  }
+  return WorkerPtr{new WorkerImpl(tls_, hooks_, std::move(dispatcher), std::move(handler), index,
+                                  std::move(stats_scope), cpu)};
 }
 
 WorkerImpl::WorkerImpl(ThreadLocal::Instance& tls, TestHooks& hooks,
-                       Event::DispatcherPtr&& dispatcher, Network::ConnectionHandlerPtr handler)
-    : tls_(tls), hooks_(hooks), dispatcher_(std::move(dispatcher)), handler_(std::move(handler)) {
+                       Event::DispatcherPtr&& dispatcher, Network::ConnectionHandlerPtr handler,
+                       uint32_t index, Stats::ScopePtr&& stats_scope, Optional<uint32_t> cpu)
+    : tls_(tls), hooks_(hooks), index_(index), cpu_(cpu), stats_scope_(std::move(stats_scope)),
+      dispatcher_(std::move(dispatcher)), handler_(std::move(handler)),
+      buffer_stats_{ALL_SLAB_POOL_STATS(POOL_GAUGE_PREFIX(*stats_scope_, "buffer."))} {
   tls_.registerThread(*dispatcher_, false);
 }
 
@@ -47,16 +78,21 @@ void WorkerImpl::addListenerWorker(Listener& listener) {
                                                      .use_proxy_proto_ = listener.useProxyProto(),
                                                      .use_original_dst_ = listener.useOriginalDst(),
                                                      .per_connection_buffer_limit_bytes_ =
-                                                         listener.perConnectionBufferLimitBytes()};
+                                                         listener.perConnectionBufferLimitBytes(),
+                                                     .max_accepts_per_event_ =
+                                                         listener.maxAcceptsPerEvent(),
+                                                     .connection_limit_ =
+                                                         listener.connectionLimit()};
   if (listener.sslContext()) {
     handler_->addSslListener(listener.filterChainFactory(), *listener.sslContext(),
-                             listener.socket(), listener.listenerScope(), listener.listenerTag(),
-                             listener_options);
+                             listener.workerSocket(index_), listener.listenerScope(),
+                             listener.listenerTag(), listener_options);
   } else {
-    handler_->addListener(listener.filterChainFactory(), listener.socket(),
+    handler_->addListener(listener.filterChainFactory(), listener.workerSocket(index_),
                           listener.listenerScope(), listener.listenerTag(), listener_options);
   }
 
+  listener_tags_.insert(listener.listenerTag());
   hooks_.onWorkerListenerAdded();
 }
 
@@ -74,7 +110,21 @@ void WorkerImpl::removeListener(Listener& listener, std::function<void()> comple
   dispatcher_->post([this, listener_tag, completion]() -> void {
     handler_->removeListeners(listener_tag);
     completion();
-    hooks_.onWorkerListenerRemoved();
+    if (listener_tags_.erase(listener_tag) > 0) {
+      hooks_.onWorkerListenerRemoved();
+    }
+  });
+}
+
+void WorkerImpl::retireListener(Listener& listener, std::function<void()> completion) {
+  ASSERT(thread_);
+  const uint64_t listener_tag = listener.listenerTag();
+  dispatcher_->post([this, listener_tag, completion]() -> void {
+    listener_tags_.erase(listener_tag);
+    handler_->retireListeners(listener_tag, [this, completion]() -> void {
+      completion();
+      hooks_.onWorkerListenerRemoved();
+    });
   });
 }
 
@@ -104,6 +154,21 @@ void WorkerImpl::stopListeners() {
 }
 
 void WorkerImpl::threadRoutine(GuardDog& guard_dog) {
+  // Pin the thread before it touches its thread local memory, so that the kernel places the memory
+  // on the NUMA node of the CPU when it is first written.
+  if (cpu_.valid()) {
+    if (Thread::Thread::setCurrentThreadCpu(cpu_.value())) {
+      ENVOY_LOG(info, "worker pinned to CPU {}", cpu_.value());
+    } else {
+      ENVOY_LOG(warn, "unable to pin worker to CPU {}", cpu_.value());
+    }
+  }
+
+  // Connections that the worker owns allocate their buffers from the slab pool of this thread.
+  Buffer::SlabPool* slab_pool = Buffer::SlabPool::threadLocal();
+  slab_pool->setStats(&buffer_stats_);
+  Profiler::CpuSampler::registerThread();
+  Memory::AllocationTracker::registerThread(fmt::format("worker_{}", index_));
   ENVOY_LOG(info, "worker entering dispatch loop");
   auto watchdog = guard_dog.createWatchDog(Thread::Thread::currentThreadId());
   watchdog->startWatchdog(*dispatcher_);
@@ -117,7 +182,10 @@ void WorkerImpl::threadRoutine(GuardDog& guard_dog) {
   // list.
   handler_.reset();
   tls_.shutdownThread();
+  Profiler::CpuSampler::unregisterThread();
+  Memory::AllocationTracker::unregisterThread();
   watchdog.reset();
+  slab_pool->setStats(nullptr);
 }
 
 } // namespace Server
@@ -1,18 +1,26 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <unordered_set>
+#include <vector>
 
 #include "envoy/api/api.h"
+#include "envoy/common/optional.h"
 #include "envoy/network/connection_handler.h"
 #include "envoy/server/guarddog.h"
 #include "envoy/server/listener_manager.h"
+#include "envoy/server/overload_manager.h"
 #include "envoy/server/worker.h"
+#include "envoy/stats/stats.h"
 #include "envoy/thread_local/thread_local.h"
 
+#include "common/buffer/buffer_impl.h"
 #include "common/common/logger.h"
 #include "common/common/thread.h"
 
+#include "server/connection_handler_impl.h"
 #include "server/test_hooks.h"
 
 namespace Envoy {
@@ -20,8 +28,24 @@ namespace Server {
 
 class ProdWorkerFactory : public WorkerFactory, Logger::Loggable<Logger::Id::main> {
 public:
-  ProdWorkerFactory(ThreadLocal::Instance& tls, Api::Api& api, TestHooks& hooks)
-      : tls_(tls), api_(api), hooks_(hooks) {}
+  /**
+   * @param balance_connections supplies whether the workers balance new connections among each
+   *        other. @see ConnectionBalancerImpl.
+   * @param worker_cpus supplies the CPUs to pin the workers to, round robin in creation order, or
+   *        empty to not pin them.
+   * @param overload_manager supplies the overload manager that stops the listeners of the workers
+   *        and shrinks the buffer limits of their new connections.
+   * @param shrunk_buffer_limit_bytes supplies the buffer limit of new connections while the
+   *        buffer limits are shrunk.
+   */
+  ProdWorkerFactory(ThreadLocal::Instance& tls, Api::Api& api, TestHooks& hooks,
+                    Stats::Scope& stats_scope, bool balance_connections,
+                    const std::vector<uint32_t>& worker_cpus, OverloadManager& overload_manager,
+                    uint32_t shrunk_buffer_limit_bytes)
+      : tls_(tls), api_(api), hooks_(hooks), stats_scope_(stats_scope),
+        balancer_(balance_connections ? new ConnectionBalancerImpl() : nullptr),
+        worker_cpus_(worker_cpus), overload_manager_(overload_manager),
+        shrunk_buffer_limit_bytes_(shrunk_buffer_limit_bytes) {}
 
   // Server::WorkerFactory
   WorkerPtr createWorker() override;
@@ -30,6 +54,13 @@ private:
   ThreadLocal::Instance& tls_;
   Api::Api& api_;
   TestHooks& hooks_;
+  Stats::Scope& stats_scope_;
+  // Shared by the connection handlers of all workers, which it must outlive.
+  std::unique_ptr<ConnectionBalancerImpl> balancer_;
+  const std::vector<uint32_t> worker_cpus_;
+  OverloadManager& overload_manager_;
+  const uint32_t shrunk_buffer_limit_bytes_;
+  uint32_t next_worker_index_{};
 };
 
 /**
@@ -37,13 +68,23 @@ private:
  */
 class WorkerImpl : public Worker, Logger::Loggable<Logger::Id::main> {
 public:
+  /**
+   * @param index supplies the index of the worker, which selects the listen socket of listeners
+   *        that have a socket per worker.
+   * @param stats_scope supplies the scope of the per worker stats, which are the gauges of the
+   *        buffer slab pool of the worker thread. The handler may also use it to count the
+   *        connections of the worker, so the scope must outlive the handler.
+   * @param cpu supplies the CPU that the worker thread is pinned to, if any.
+   */
   WorkerImpl(ThreadLocal::Instance& tls, TestHooks& hooks, Event::DispatcherPtr&& dispatcher,
-             Network::ConnectionHandlerPtr handler);
+             Network::ConnectionHandlerPtr handler, uint32_t index, Stats::ScopePtr&& stats_scope,
+             Optional<uint32_t> cpu);
 
   // Server::Worker
   void addListener(Listener& listener, AddListenerCompletion completion) override;
   uint64_t numConnections() override;
   void removeListener(Listener& listener, std::function<void()> completion) override;
+  void retireListener(Listener& listener, std::function<void()> completion) override;
   void start(GuardDog& guard_dog) override;
   void stop() override;
   void stopListener(Listener& listener) override;
@@ -55,8 +96,16 @@ private:
 
   ThreadLocal::Instance& tls_;
   TestHooks& hooks_;
+  const uint32_t index_;
+  const Optional<uint32_t> cpu_;
+  Stats::ScopePtr stats_scope_;
   Event::DispatcherPtr dispatcher_;
   Network::ConnectionHandlerPtr handler_;
+  // The tags of the listeners added on the worker thread that have been neither removed nor
+  // retired. The removal of a retired listener is reported by its retire completion, so that a
+  // retired listener that is also removed is reported once. Only accessed on the worker thread.
+  std::unordered_set<uint64_t> listener_tags_;
+  Buffer::SlabPoolStats buffer_stats_;
   Thread::ThreadPtr thread_;
 };
 
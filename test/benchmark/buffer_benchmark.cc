@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <string>
+
+#include "common/buffer/buffer_impl.h"
+
+#include "benchmark/benchmark.h"
+
+namespace Envoy {
+namespace Buffer {
+namespace {
+
+/**
+ * Append a chunk of the given size and drain it again, the pattern of a proxied body chunk.
+ */
+void BM_BufferAddDrain(benchmark::State& state) {
+  const std::string data(state.range(0), 'a');
+  OwnedImpl buffer;
+  while (state.KeepRunning()) {
+    buffer.add(data);
+    buffer.drain(buffer.length());
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_BufferAddDrain)->Arg(16)->Arg(1024)->Arg(16384)->Arg(1024 * 1024);
+
+/**
+ * Move a full buffer into another buffer, which is how data flows between connections and codecs.
+ */
+void BM_BufferMove(benchmark::State& state) {
+  const std::string data(state.range(0), 'a');
+  OwnedImpl source;
+  OwnedImpl destination;
+  while (state.KeepRunning()) {
+    source.add(data);
+    destination.move(source);
+    destination.drain(destination.length());
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_BufferMove)->Arg(16)->Arg(16384)->Arg(1024 * 1024);
+
+/**
+ * Partial moves are used by the codecs when framing (e.g. HTTP/2 DATA frames).
+ */
+void BM_BufferMovePartial(benchmark::State& state) {
+  const std::string data(1024 * 1024, 'a');
+  const uint64_t chunk = state.range(0);
+  OwnedImpl source;
+  OwnedImpl destination;
+  while (state.KeepRunning()) {
+    if (source.length() < chunk) {
+      source.add(data);
+    }
+    destination.move(source, chunk);
+    destination.drain(destination.length());
+  }
+  state.SetBytesProcessed(state.iterations() * chunk);
+}
+BENCHMARK(BM_BufferMovePartial)->Arg(1024)->Arg(16384);
+
+/**
+ * reserve()/commit() mirrors what Network::ConnectionImpl does when reading from a socket.
+ */
+void BM_BufferReserveCommit(benchmark::State& state) {
+  const uint64_t size = state.range(0);
+  OwnedImpl buffer;
+  while (state.KeepRunning()) {
+    RawSlice slices[2];
+    uint64_t num_slices = buffer.reserve(size, slices, 2);
+    uint64_t remaining = size;
+    for (uint64_t i = 0; i < num_slices; i++) {
+      slices[i].len_ = std::min(slices[i].len_, remaining);
+      remaining -= slices[i].len_;
+    }
+    buffer.commit(slices, num_slices);
+    buffer.drain(buffer.length());
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_BufferReserveCommit)->Arg(1024)->Arg(16384);
+
+/**
+ * Linearize a buffer built up from many small fragments.
+ */
+void BM_BufferLinearize(benchmark::State& state) {
+  const std::string fragment(128, 'a');
+  const uint64_t fragments = state.range(0);
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    OwnedImpl buffer;
+    for (uint64_t i = 0; i < fragments; i++) {
+      OwnedImpl piece(fragment);
+      buffer.move(piece);
+    }
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(buffer.linearize(buffer.length()));
+  }
+}
+BENCHMARK(BM_BufferLinearize)->Arg(8)->Arg(128);
+
+/**
+ * Search for a delimiter at the very end of the buffer, e.g. looking for CRLF in a large HTTP/1
+ * header block or a Redis response.
+ */
+void BM_BufferSearch(benchmark::State& state) {
+  std::string data(state.range(0), 'a');
+  data.append("\r\n");
+  OwnedImpl buffer(data);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(buffer.search("\r\n", 2, 0));
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_BufferSearch)->Arg(64)->Arg(4096)->Arg(65536);
+
+void BM_BufferGetRawSlices(benchmark::State& state) {
+  const std::string fragment(4096, 'a');
+  OwnedImpl buffer;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    OwnedImpl piece(fragment);
+    buffer.move(piece);
+  }
+  while (state.KeepRunning()) {
+    uint64_t num_slices = buffer.getRawSlices(nullptr, 0);
+    RawSlice slices[num_slices];
+    benchmark::DoNotOptimize(buffer.getRawSlices(slices, num_slices));
+  }
+}
+BENCHMARK(BM_BufferGetRawSlices)->Arg(4)->Arg(64);
+
+} // namespace
+} // namespace Buffer
+} // namespace Envoy
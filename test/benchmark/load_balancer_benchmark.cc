@@ -0,0 +1,117 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/runtime/runtime_impl.h"
+#include "common/stats/stats_impl.h"
+#include "common/upstream/load_balancer_impl.h"
+#include "common/upstream/ring_hash_lb.h"
+#include "common/upstream/upstream_impl.h"
+
+#include "test/common/upstream/utility.h"
+#include "test/mocks/upstream/mocks.h"
+
+#include "benchmark/benchmark.h"
+#include "fmt/format.h"
+
+namespace Envoy {
+namespace Upstream {
+namespace {
+
+class TestLoadBalancerContext : public LoadBalancerContext {
+public:
+  // Upstream::LoadBalancerContext
+  Optional<uint64_t> hashKey() const override { return hash_key_; }
+  const Network::Connection* downstreamConnection() const override { return nullptr; }
+  const MetadataMatchCriteria* metadataMatchCriteria() const override { return nullptr; }
+
+  Optional<uint64_t> hash_key_;
+};
+
+/**
+ * A healthy host set of the requested size using real (not mocked) host and host set objects so
+ * that the benchmarks measure the load balancers and not gmock.
+ */
+class LoadBalancerFixture {
+public:
+  LoadBalancerFixture(uint64_t num_hosts)
+      : stats_(ClusterInfoImpl::generateStats(stats_store_)), runtime_(random_) {
+    for (uint64_t i = 0; i < num_hosts; i++) {
+      hosts_->push_back(makeTestHost(
+          info_, fmt::format("tcp://10.{}.{}.{}:6379", i / 65536, (i / 256) % 256, i % 256)));
+    }
+    updateHosts();
+  }
+
+  void updateHosts() {
+    host_set_.updateHosts(hosts_, hosts_, per_zone_, per_zone_, {}, {});
+  }
+
+  std::shared_ptr<MockClusterInfo> info_{new testing::NiceMock<MockClusterInfo>()};
+  Stats::IsolatedStoreImpl stats_store_;
+  ClusterStats stats_;
+  Runtime::RandomGeneratorImpl random_;
+  Runtime::NullLoaderImpl runtime_;
+  HostVectorSharedPtr hosts_{new std::vector<HostSharedPtr>()};
+  HostListsSharedPtr per_zone_{new std::vector<std::vector<HostSharedPtr>>()};
+  HostSetImpl host_set_;
+};
+
+void BM_RoundRobinChooseHost(benchmark::State& state) {
+  LoadBalancerFixture fixture(state.range(0));
+  RoundRobinLoadBalancer lb(fixture.host_set_, nullptr, fixture.stats_, fixture.runtime_,
+                            fixture.random_);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(lb.chooseHost(nullptr));
+  }
+}
+BENCHMARK(BM_RoundRobinChooseHost)->Arg(100)->Arg(10000);
+
+void BM_LeastRequestChooseHost(benchmark::State& state) {
+  LoadBalancerFixture fixture(state.range(0));
+  LeastRequestLoadBalancer lb(fixture.host_set_, nullptr, fixture.stats_, fixture.runtime_,
+                              fixture.random_);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(lb.chooseHost(nullptr));
+  }
+}
+BENCHMARK(BM_LeastRequestChooseHost)->Arg(100)->Arg(10000);
+
+void BM_RandomChooseHost(benchmark::State& state) {
+  LoadBalancerFixture fixture(state.range(0));
+  RandomLoadBalancer lb(fixture.host_set_, nullptr, fixture.stats_, fixture.runtime_,
+                        fixture.random_);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(lb.chooseHost(nullptr));
+  }
+}
+BENCHMARK(BM_RandomChooseHost)->Arg(100)->Arg(10000);
+
+void BM_RingHashChooseHost(benchmark::State& state) {
+  LoadBalancerFixture fixture(state.range(0));
+  RingHashLoadBalancer lb(fixture.host_set_, fixture.stats_, fixture.runtime_, fixture.random_);
+  TestLoadBalancerContext context;
+  uint64_t hash = 0;
+  while (state.KeepRunning()) {
+    // Walk the hash space so that the binary search does not stay hot in one place.
+    context.hash_key_.value(hash += 0x9E3779B97F4A7C15ULL);
+    benchmark::DoNotOptimize(lb.chooseHost(&context));
+  }
+}
+BENCHMARK(BM_RingHashChooseHost)->Arg(100)->Arg(10000);
+
+/**
+ * Cost of rebuilding the rings on a host set change, which today happens on every worker.
+ */
+void BM_RingHashRefresh(benchmark::State& state) {
+  LoadBalancerFixture fixture(state.range(0));
+  RingHashLoadBalancer lb(fixture.host_set_, fixture.stats_, fixture.runtime_, fixture.random_);
+  while (state.KeepRunning()) {
+    fixture.updateHosts();
+  }
+}
+BENCHMARK(BM_RingHashRefresh)->Arg(100)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+} // namespace
+} // namespace Upstream
+} // namespace Envoy
@@ -0,0 +1,20 @@
+// NOLINT(namespace-envoy)
+#include "common/common/logger.h"
+#include "common/common/thread.h"
+#include "common/event/libevent.h"
+
+#include "benchmark/benchmark.h"
+
+// The main entry point (and the rest of this file) should have no logic in it,
+// this allows overriding by site specific versions of main.cc.
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  Envoy::Event::Libevent::Global::initialize();
+
+  // Benchmarks should not be measuring log output, so only surface real problems.
+  Envoy::Thread::MutexBasicLockable lock;
+  Envoy::Logger::Registry::initialize(spdlog::level::warn, lock);
+
+  ::benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,114 @@
+#include <memory>
+#include <string>
+
+#include "common/http/header_map_impl.h"
+#include "common/router/config_impl.h"
+#include "common/runtime/runtime_impl.h"
+
+#include "test/mocks/upstream/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "api/rds.pb.h"
+#include "benchmark/benchmark.h"
+#include "fmt/format.h"
+
+namespace Envoy {
+namespace Router {
+namespace {
+
+enum class RouteType { Prefix, Path, Regex };
+
+/**
+ * Build a single virtual host with num_routes routes of the given type. Each route matches a
+ * distinct path so that the lookup of the last route has to visit every entry.
+ */
+envoy::api::v2::RouteConfiguration makeRouteConfig(RouteType type, uint64_t num_routes) {
+  envoy::api::v2::RouteConfiguration route_config;
+  auto* virtual_host = route_config.add_virtual_hosts();
+  virtual_host->set_name("benchmark");
+  virtual_host->add_domains("*");
+  for (uint64_t i = 0; i < num_routes; i++) {
+    auto* route = virtual_host->add_routes();
+    switch (type) {
+    case RouteType::Prefix:
+      route->mutable_match()->set_prefix(fmt::format("/service_{}/", i));
+      break;
+    case RouteType::Path:
+      route->mutable_match()->set_path(fmt::format("/service_{}/method", i));
+      break;
+    case RouteType::Regex:
+      route->mutable_match()->set_regex(fmt::format("/service_{}/[a-z]+", i));
+      break;
+    }
+    route->mutable_route()->set_cluster(fmt::format("cluster_{}", i));
+  }
+  return route_config;
+}
+
+class RouteMatcherFixture {
+public:
+  RouteMatcherFixture(RouteType type, uint64_t num_routes)
+      : runtime_(random_), config_(makeRouteConfig(type, num_routes), runtime_, cm_, false) {}
+
+  Runtime::RandomGeneratorImpl random_;
+  Runtime::NullLoaderImpl runtime_;
+  testing::NiceMock<Upstream::MockClusterManager> cm_;
+  ConfigImpl config_;
+};
+
+void routeLookup(benchmark::State& state, RouteType type) {
+  const uint64_t num_routes = state.range(0);
+  RouteMatcherFixture fixture(type, num_routes);
+
+  // Worst case for an ordered scan: the only matching route is the last one.
+  Http::TestHeaderMapImpl headers{{":authority", "www.lyft.com"},
+                                  {":path", fmt::format("/service_{}/method", num_routes - 1)},
+                                  {":method", "GET"}};
+  while (state.KeepRunning()) {
+    RouteConstSharedPtr route = fixture.config_.route(headers, 0);
+    benchmark::DoNotOptimize(route);
+  }
+}
+
+void BM_RouteMatcherPrefix(benchmark::State& state) { routeLookup(state, RouteType::Prefix); }
+BENCHMARK(BM_RouteMatcherPrefix)->Arg(10)->Arg(100)->Arg(1000);
+
+void BM_RouteMatcherPath(benchmark::State& state) { routeLookup(state, RouteType::Path); }
+BENCHMARK(BM_RouteMatcherPath)->Arg(10)->Arg(100)->Arg(1000);
+
+void BM_RouteMatcherRegex(benchmark::State& state) { routeLookup(state, RouteType::Regex); }
+BENCHMARK(BM_RouteMatcherRegex)->Arg(10)->Arg(100)->Arg(1000);
+
+/**
+ * Virtual host selection across many exact domains plus a wildcard.
+ */
+void BM_RouteMatcherVirtualHost(benchmark::State& state) {
+  envoy::api::v2::RouteConfiguration route_config;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    auto* virtual_host = route_config.add_virtual_hosts();
+    virtual_host->set_name(fmt::format("vhost_{}", i));
+    virtual_host->add_domains(fmt::format("tenant{}.example.com", i));
+    virtual_host->add_domains(fmt::format("*.tenant{}.example.net", i));
+    auto* route = virtual_host->add_routes();
+    route->mutable_match()->set_prefix("/");
+    route->mutable_route()->set_cluster("cluster");
+  }
+
+  Runtime::RandomGeneratorImpl random;
+  Runtime::NullLoaderImpl runtime(random);
+  testing::NiceMock<Upstream::MockClusterManager> cm;
+  ConfigImpl config(route_config, runtime, cm, false);
+  Http::TestHeaderMapImpl headers{
+      {":authority", fmt::format("www.tenant{}.example.net", state.range(0) - 1)},
+      {":path", "/"},
+      {":method", "GET"}};
+  while (state.KeepRunning()) {
+    RouteConstSharedPtr route = config.route(headers, 0);
+    benchmark::DoNotOptimize(route);
+  }
+}
+BENCHMARK(BM_RouteMatcherVirtualHost)->Arg(10)->Arg(1000);
+
+} // namespace
+} // namespace Router
+} // namespace Envoy
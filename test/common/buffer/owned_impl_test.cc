@@ -0,0 +1,378 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/test_common/utility.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Buffer {
+namespace {
+
+uint64_t numSlices(const Instance& buffer) { return buffer.getRawSlices(nullptr, 0); }
+
+TEST(OwnedImplTest, AddAndDrain) {
+  OwnedImpl buffer;
+  buffer.add("hello");
+  buffer.add(std::string(" world"));
+  EXPECT_EQ(11UL, buffer.length());
+  EXPECT_EQ(1UL, numSlices(buffer));
+  EXPECT_EQ("hello world", TestUtility::bufferToString(buffer));
+
+  buffer.drain(6);
+  EXPECT_EQ("world", TestUtility::bufferToString(buffer));
+  buffer.drain(5);
+  EXPECT_EQ(0UL, buffer.length());
+  EXPECT_EQ(0UL, numSlices(buffer));
+}
+
+TEST(OwnedImplTest, AddSpansSlabs) {
+  const std::string data(Slab::DEFAULT_SIZE * 2 + 100, 'a');
+  OwnedImpl buffer("x");
+  buffer.add(data);
+  EXPECT_EQ(data.size() + 1, buffer.length());
+  EXPECT_EQ("x" + data, TestUtility::bufferToString(buffer));
+
+  buffer.drain(Slab::DEFAULT_SIZE + 1);
+  EXPECT_EQ(data.size() - Slab::DEFAULT_SIZE, buffer.length());
+}
+
+TEST(OwnedImplTest, MoveSharesLargeSlicesAndCopiesSmallOnes) {
+  const std::string large(4096, 'l');
+  OwnedImpl source(large);
+  RawSlice source_slice;
+  source.getRawSlices(&source_slice, 1);
+
+  OwnedImpl destination("small");
+  destination.move(source);
+  EXPECT_EQ(0UL, source.length());
+  EXPECT_EQ("small" + large, TestUtility::bufferToString(destination));
+
+  // The large slice was moved without copying.
+  RawSlice slices[2];
+  ASSERT_EQ(2UL, destination.getRawSlices(slices, 2));
+  EXPECT_EQ(source_slice.mem_, slices[1].mem_);
+
+  // A small buffer is copied into the free space of the last slice.
+  OwnedImpl small("tail");
+  destination.move(small);
+  EXPECT_EQ(2UL, numSlices(destination));
+  EXPECT_EQ("small" + large + "tail", TestUtility::bufferToString(destination));
+}
+
+TEST(OwnedImplTest, PartialMove) {
+  const std::string large(2048, 'l');
+  OwnedImpl source(large + "rest");
+
+  OwnedImpl destination;
+  destination.move(source, large.size());
+  EXPECT_EQ(large, TestUtility::bufferToString(destination));
+  EXPECT_EQ("rest", TestUtility::bufferToString(source));
+
+  // Both buffers share the slab, so neither may write into it anymore.
+  source.add("more");
+  destination.add("more");
+  EXPECT_EQ("restmore", TestUtility::bufferToString(source));
+  EXPECT_EQ(large + "more", TestUtility::bufferToString(destination));
+
+  OwnedImpl small_destination;
+  small_destination.move(source, 2);
+  EXPECT_EQ("re", TestUtility::bufferToString(small_destination));
+  EXPECT_EQ("stmore", TestUtility::bufferToString(source));
+}
+
+TEST(OwnedImplTest, AddBufferSharesSlabs) {
+  const std::string large(Slab::DEFAULT_SIZE, 'l');
+  OwnedImpl source(large);
+  OwnedImpl copy(source);
+  EXPECT_EQ(large, TestUtility::bufferToString(copy));
+  EXPECT_EQ(large, TestUtility::bufferToString(source));
+
+  RawSlice source_slice;
+  RawSlice copy_slice;
+  source.getRawSlices(&source_slice, 1);
+  copy.getRawSlices(&copy_slice, 1);
+  EXPECT_EQ(source_slice.mem_, copy_slice.mem_);
+
+  // Draining one of them does not affect the other.
+  source.drain(large.size());
+  EXPECT_EQ(large, TestUtility::bufferToString(copy));
+
+  // Adding a buffer to itself doubles the data.
+  OwnedImpl self("abc");
+  self.add(self);
+  EXPECT_EQ("abcabc", TestUtility::bufferToString(self));
+}
+
+TEST(OwnedImplTest, ReserveCommit) {
+  OwnedImpl buffer("a");
+  RawSlice iovec;
+  ASSERT_EQ(1UL, buffer.reserve(100, &iovec, 1));
+  ASSERT_GE(iovec.len_, 100UL);
+  memcpy(iovec.mem_, "bcd", 3);
+  iovec.len_ = 3;
+  buffer.commit(&iovec, 1);
+  EXPECT_EQ("abcd", TestUtility::bufferToString(buffer));
+  EXPECT_EQ(1UL, numSlices(buffer));
+
+  // A reservation that does not fit in one default slab.
+  ASSERT_EQ(1UL, buffer.reserve(Slab::DEFAULT_SIZE * 2, &iovec, 1));
+  ASSERT_GE(iovec.len_, Slab::DEFAULT_SIZE * 2);
+  iovec.len_ = 0;
+  buffer.commit(&iovec, 1);
+  EXPECT_EQ("abcd", TestUtility::bufferToString(buffer));
+  EXPECT_EQ(1UL, numSlices(buffer));
+
+  // A split reservation that is only partially used.
+  RawSlice iovecs[3];
+  const uint64_t num_iovecs = buffer.reserve(Slab::DEFAULT_SIZE, iovecs, 3);
+  ASSERT_EQ(2UL, num_iovecs);
+  EXPECT_EQ(Slab::DEFAULT_SIZE - 4, iovecs[0].len_);
+  memset(iovecs[0].mem_, 'e', iovecs[0].len_);
+  memcpy(iovecs[1].mem_, "f", 1);
+  iovecs[1].len_ = 1;
+  buffer.commit(iovecs, num_iovecs);
+  EXPECT_EQ(Slab::DEFAULT_SIZE + 1, buffer.length());
+  EXPECT_EQ(2UL, numSlices(buffer));
+  EXPECT_EQ("abcd" + std::string(Slab::DEFAULT_SIZE - 4, 'e') + "f",
+            TestUtility::bufferToString(buffer));
+}
+
+TEST(OwnedImplTest, Linearize) {
+  const std::string large(Slab::DEFAULT_SIZE, 'l');
+  OwnedImpl buffer(large);
+  OwnedImpl other(large);
+  buffer.move(other);
+  ASSERT_EQ(2UL, numSlices(buffer));
+
+  EXPECT_EQ(0, memcmp(large.data(), buffer.linearize(10), 10));
+  EXPECT_EQ(2UL, numSlices(buffer));
+
+  const std::string expected = large + large;
+  const uint32_t size = Slab::DEFAULT_SIZE + 5;
+  EXPECT_EQ(0, memcmp(expected.data(), buffer.linearize(size), size));
+  EXPECT_EQ(expected, TestUtility::bufferToString(buffer));
+}
+
+TEST(OwnedImplTest, Search) {
+  OwnedImpl buffer("hello ");
+  OwnedImpl other(std::string(1024, 'x') + "needle");
+  buffer.move(other);
+  buffer.add("needle");
+  ASSERT_EQ(2UL, numSlices(buffer));
+
+  EXPECT_EQ(0, buffer.search("hello", 5, 0));
+  EXPECT_EQ(-1, buffer.search("hello", 5, 1));
+  // Spans both slices.
+  EXPECT_EQ(4, buffer.search("o xx", 4, 0));
+  EXPECT_EQ(1030, buffer.search("needle", 6, 0));
+  EXPECT_EQ(1036, buffer.search("needle", 6, 1031));
+  EXPECT_EQ(-1, buffer.search("needles", 7, 0));
+  EXPECT_EQ(-1, buffer.search("a", 1, 10000));
+}
+
+TEST(OwnedImplTest, SearchAcrossSlices) {
+  // Many candidates for the first byte, and a match that starts in the last byte of a slice.
+  OwnedImpl buffer(std::string(600, '\r') + "\n\r");
+  OwnedImpl other(std::string("\n\r\n") + std::string(600, 'x'));
+  buffer.move(other);
+  ASSERT_EQ(2UL, numSlices(buffer));
+
+  EXPECT_EQ(599, buffer.search("\r\n\r\n", 4, 0));
+  EXPECT_EQ(601, buffer.search("\r\n\r\n", 4, 600));
+  EXPECT_EQ(-1, buffer.search("\r\n\r\n", 4, 602));
+  EXPECT_EQ(604, buffer.search("\nx", 2, 0));
+  EXPECT_EQ(1203, buffer.search("xx", 2, 1203));
+  EXPECT_EQ(-1, buffer.search("xx", 2, 1204));
+}
+
+TEST(OwnedImplTest, ReadWrite) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+
+  const std::string data(Slab::DEFAULT_SIZE + 10, 'd');
+  OwnedImpl write_buffer(data);
+  EXPECT_EQ(static_cast<int>(data.size()), write_buffer.write(fds[1]));
+  EXPECT_EQ(0UL, write_buffer.length());
+
+  OwnedImpl read_buffer("prefix");
+  EXPECT_EQ(static_cast<int>(data.size()), read_buffer.read(fds[0], data.size() + 100));
+  EXPECT_EQ("prefix" + data, TestUtility::bufferToString(read_buffer));
+
+  // Nothing to read on a non blocking pipe leaves the buffer unchanged.
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  EXPECT_EQ(-1, read_buffer.read(fds[0], 100));
+  EXPECT_EQ(EAGAIN, errno);
+  EXPECT_EQ("prefix" + data, TestUtility::bufferToString(read_buffer));
+
+  close(fds[1]);
+  EXPECT_EQ(0, read_buffer.read(fds[0], 100));
+  close(fds[0]);
+}
+
+TEST(OwnedImplTest, WriteManySlices) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+
+  // Each moved buffer is a separate slice. All of them are written with one writev().
+  OwnedImpl write_buffer;
+  std::string expected;
+  for (uint32_t i = 0; i < 100; i++) {
+    OwnedImpl slice(std::string(600, 'a' + i % 26));
+    expected += TestUtility::bufferToString(slice);
+    write_buffer.move(slice);
+  }
+  EXPECT_EQ(100UL, numSlices(write_buffer));
+  EXPECT_EQ(static_cast<int>(expected.size()), write_buffer.write(fds[1]));
+  EXPECT_EQ(0UL, write_buffer.length());
+
+  OwnedImpl read_buffer;
+  EXPECT_EQ(static_cast<int>(expected.size()), read_buffer.read(fds[0], expected.size()));
+  EXPECT_EQ(expected, TestUtility::bufferToString(read_buffer));
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(OwnedImplTest, AddBufferFragment) {
+  const std::string data(1024, 'f');
+  bool released = false;
+  BufferFragmentImpl fragment(
+      data.data(), data.size(),
+      [&released, &data](const void* released_data, size_t size, const BufferFragmentImpl*) {
+        EXPECT_EQ(data.data(), released_data);
+        EXPECT_EQ(data.size(), size);
+        released = true;
+      });
+
+  OwnedImpl buffer("a");
+  buffer.addBufferFragment(fragment);
+  EXPECT_EQ(data.size() + 1, buffer.length());
+  RawSlice slices[2];
+  ASSERT_EQ(2UL, buffer.getRawSlices(slices, 2));
+  EXPECT_EQ(data.data(), slices[1].mem_);
+
+  // The fragment is read only, so adding data does not write into it.
+  buffer.add("b");
+  EXPECT_EQ("a" + data + "b", TestUtility::bufferToString(buffer));
+  EXPECT_EQ(std::string(1024, 'f'), data);
+
+  // Moving the fragment keeps referencing the external memory.
+  OwnedImpl destination;
+  buffer.drain(1);
+  destination.move(buffer, data.size());
+  ASSERT_EQ(1UL, destination.getRawSlices(slices, 1));
+  EXPECT_EQ(data.data(), slices[0].mem_);
+  EXPECT_EQ("b", TestUtility::bufferToString(buffer));
+
+  EXPECT_FALSE(released);
+  destination.drain(data.size() - 1);
+  EXPECT_FALSE(released);
+  destination.drain(1);
+  EXPECT_TRUE(released);
+
+  // An empty fragment is done right away.
+  released = false;
+  BufferFragmentImpl empty_fragment(
+      nullptr, 0, [&released](const void*, size_t, const BufferFragmentImpl*) { released = true; });
+  buffer.addBufferFragment(empty_fragment);
+  EXPECT_TRUE(released);
+  EXPECT_EQ(1UL, buffer.length());
+}
+
+TEST(OwnedImplTest, AddAfterPartialFragmentMove) {
+  const std::string data(4096, 'f');
+  bool released = false;
+  BufferFragmentImpl fragment(
+      data.data(), data.size(),
+      [&released](const void*, size_t, const BufferFragmentImpl*) { released = true; });
+
+  OwnedImpl source;
+  source.addBufferFragment(fragment);
+  OwnedImpl destination;
+  // The moved part is large enough to share the fragment rather than be copied.
+  destination.move(source, 1024);
+
+  // Once the source lets go of the fragment, the moved front is its only reference. The fragment
+  // memory after that front must still not be written.
+  source.drain(source.length());
+  EXPECT_FALSE(released);
+  destination.add("header");
+  EXPECT_EQ(std::string(1024, 'f') + "header", TestUtility::bufferToString(destination));
+  EXPECT_EQ(std::string(4096, 'f'), data);
+
+  destination.drain(destination.length());
+  EXPECT_TRUE(released);
+}
+
+TEST(SlabPoolTest, Accounting) {
+  // Use a new thread so that the pool starts out empty.
+  std::thread thread([]() -> void {
+    SlabPool* pool = SlabPool::threadLocal();
+    ASSERT_NE(nullptr, pool);
+    Stats::IsolatedStoreImpl store;
+    SlabPoolStats stats{ALL_SLAB_POOL_STATS(POOL_GAUGE_PREFIX(store, "buffer."))};
+    pool->setStats(&stats);
+
+    std::unique_ptr<OwnedImpl> buffer(new OwnedImpl(std::string(Slab::DEFAULT_SIZE, 'a')));
+    buffer->add("a");
+    EXPECT_EQ(2UL, pool->slabsInUse());
+    EXPECT_EQ(0UL, pool->slabsCached());
+    EXPECT_EQ(Slab::DEFAULT_SIZE * 2, pool->bytesAllocated());
+    EXPECT_EQ(2UL, store.gauge("buffer.slabs_in_use").value());
+
+    // Released default slabs are cached and reused.
+    buffer.reset();
+    EXPECT_EQ(0UL, pool->slabsInUse());
+    EXPECT_EQ(2UL, pool->slabsCached());
+    EXPECT_EQ(Slab::DEFAULT_SIZE * 2, pool->bytesAllocated());
+    EXPECT_EQ(2UL, store.gauge("buffer.slabs_cached").value());
+
+    buffer.reset(new OwnedImpl("a"));
+    EXPECT_EQ(1UL, pool->slabsInUse());
+    EXPECT_EQ(1UL, pool->slabsCached());
+    EXPECT_EQ(Slab::DEFAULT_SIZE * 2, pool->bytesAllocated());
+
+    // Large slabs are not cached.
+    buffer->add(std::string(Slab::DEFAULT_SIZE * 2, 'b'));
+    EXPECT_EQ(2UL, pool->slabsInUse());
+    EXPECT_GT(pool->bytesAllocated(), Slab::DEFAULT_SIZE * 3);
+    buffer.reset();
+    EXPECT_EQ(0UL, pool->slabsInUse());
+    EXPECT_EQ(2UL, pool->slabsCached());
+    EXPECT_EQ(Slab::DEFAULT_SIZE * 2, pool->bytesAllocated());
+    EXPECT_EQ(Slab::DEFAULT_SIZE * 2, store.gauge("buffer.bytes_allocated").value());
+    pool->setStats(nullptr);
+  });
+  thread.join();
+}
+
+TEST(SlabPoolTest, ReleaseOnOtherThread) {
+  SlabPool* pool = SlabPool::threadLocal();
+  const uint64_t in_use = pool->slabsInUse();
+  std::unique_ptr<OwnedImpl> other_thread_buffer;
+  std::thread thread([&other_thread_buffer]() -> void {
+    other_thread_buffer.reset(new OwnedImpl(std::string(100, 'a')));
+  });
+  thread.join();
+
+  // The slab outlives the thread and its pool is freed once it is released.
+  EXPECT_EQ(std::string(100, 'a'), TestUtility::bufferToString(*other_thread_buffer));
+  other_thread_buffer->add("more");
+  other_thread_buffer.reset();
+
+  OwnedImpl buffer("a");
+  std::thread release_thread([&buffer]() -> void { buffer.drain(1); });
+  release_thread.join();
+  EXPECT_EQ(in_use, pool->slabsInUse());
+}
+
+} // namespace
+} // namespace Buffer
+} // namespace Envoy
@@ -46,6 +46,17 @@ TEST_F(WatermarkBufferTest, AddBuffer) {
   EXPECT_EQ(11, buffer_.length());
 }
 
+TEST_F(WatermarkBufferTest, AddBufferFragment) {
+  BufferFragmentImpl fragment(TEN_BYTES, 10, nullptr);
+  buffer_.addBufferFragment(fragment);
+  EXPECT_EQ(0, times_high_watermark_called_);
+  BufferFragmentImpl second_fragment("a", 1, nullptr);
+  buffer_.addBufferFragment(second_fragment);
+  EXPECT_EQ(1, times_high_watermark_called_);
+  EXPECT_EQ(11, buffer_.length());
+  buffer_.drain(11);
+}
+
 TEST_F(WatermarkBufferTest, Commit) {
   buffer_.add(TEN_BYTES, 10);
   EXPECT_EQ(0, times_high_watermark_called_);
@@ -85,6 +85,26 @@ TEST_F(ZeroCopyInputStreamTest, Finish) {
   EXPECT_FALSE(stream_.Next(&data_, &size_));
 }
 
+TEST_F(ZeroCopyInputStreamTest, Skip) {
+  Buffer::OwnedImpl buffer("efgh");
+  stream_.move(buffer);
+
+  EXPECT_TRUE(stream_.Next(&data_, &size_));
+  stream_.BackUp(1);
+  // Skip the rest of the returned slice, and into the next one.
+  EXPECT_TRUE(stream_.Skip(2));
+  EXPECT_EQ(5, stream_.ByteCount());
+  EXPECT_TRUE(stream_.Next(&data_, &size_));
+  EXPECT_EQ(3, size_);
+  EXPECT_EQ(0, memcmp("fgh", data_, size_));
+
+  // Skipping past the end skips what is available.
+  stream_.BackUp(2);
+  EXPECT_FALSE(stream_.Skip(3));
+  EXPECT_EQ(8, stream_.ByteCount());
+  EXPECT_TRUE(stream_.Skip(0));
+}
+
 } // namespace
 } // namespace Buffer
 } // namespace Envoy
@@ -0,0 +1,85 @@
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+
+#include "common/common/arena.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+TEST(Arena, InlineAllocations) {
+  Arena arena;
+  void* first = arena.allocate(16);
+  void* second = arena.allocate(16);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(second) % alignof(std::max_align_t));
+  EXPECT_EQ(32U, arena.bytesAllocated());
+  EXPECT_EQ(0U, arena.heapBlocks());
+}
+
+TEST(Arena, Alignment) {
+  Arena arena;
+  arena.allocate(1, 1);
+  void* aligned = arena.allocate(8, 8);
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(aligned) % 8);
+  arena.allocate(3, 1);
+  aligned = arena.allocate(64, 64);
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(aligned) % 64);
+}
+
+TEST(Arena, HeapBlocks) {
+  Arena arena;
+  arena.allocate(Arena::INLINE_SIZE);
+  EXPECT_EQ(0U, arena.heapBlocks());
+
+  arena.allocate(1);
+  EXPECT_EQ(1U, arena.heapBlocks());
+
+  // Oversized allocations get a block of their own.
+  uint8_t* large = static_cast<uint8_t*>(arena.allocate(Arena::MIN_HEAP_BLOCK_SIZE * 4));
+  EXPECT_EQ(2U, arena.heapBlocks());
+  large[0] = 1;
+  large[Arena::MIN_HEAP_BLOCK_SIZE * 4 - 1] = 1;
+
+  for (size_t i = 0; i < 1000; i++) {
+    arena.allocate(128);
+  }
+  EXPECT_LT(arena.heapBlocks(), 10U);
+}
+
+TEST(Arena, Allocator) {
+  Arena arena;
+  std::list<std::string, ArenaAllocator<std::string>> list{ArenaAllocator<std::string>(&arena)};
+  for (size_t i = 0; i < 100; i++) {
+    list.push_back("hello");
+  }
+  list.clear();
+  EXPECT_GT(arena.bytesAllocated(), 0U);
+
+  // Without an arena the allocator uses the heap.
+  std::list<std::string, ArenaAllocator<std::string>> heap_list;
+  heap_list.push_back("world");
+  EXPECT_EQ("world", heap_list.front());
+}
+
+namespace {
+class TestObject : public ArenaObject {
+public:
+  TestObject(bool& destroyed) : destroyed_(destroyed) {}
+  ~TestObject() { destroyed_ = true; }
+
+  bool& destroyed_;
+};
+} // namespace
+
+TEST(Arena, ArenaObject) {
+  Arena arena;
+  bool destroyed = false;
+  std::unique_ptr<TestObject> object(new (arena) TestObject(destroyed));
+  EXPECT_GT(arena.bytesAllocated(), 0U);
+
+  object.reset();
+  EXPECT_TRUE(destroyed);
+}
+} // namespace Envoy
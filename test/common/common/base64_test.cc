@@ -1,9 +1,12 @@
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "common/buffer/buffer_impl.h"
 #include "common/common/base64.h"
 
 #include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
 
 #include "gtest/gtest.h"
 
@@ -108,4 +111,72 @@ TEST(Base64Test, BinaryBufferEncode) {
   EXPECT_EQ("AAECAwgKCQCqvA==", Base64::encode(buffer, 10));
   EXPECT_EQ("AAECAwgKCQCqvN4=", Base64::encode(buffer, 30));
 }
+
+namespace {
+
+// Builds a buffer with one slice per chunk.
+void addSlices(Buffer::Instance& buffer, const std::vector<std::string>& chunks) {
+  for (const std::string& chunk : chunks) {
+    Buffer::OwnedImpl slice(chunk);
+    buffer.move(slice);
+  }
+}
+
+} // namespace
+
+TEST(Base64Test, BufferToBufferEncode) {
+  Buffer::OwnedImpl output("x");
+  Base64::encode(Buffer::OwnedImpl(), output);
+  EXPECT_EQ("x", TestUtility::bufferToString(output));
+
+  // Triples that span slices, and each amount of padding.
+  const std::vector<std::pair<std::vector<std::string>, std::string>> cases{
+      {{"f", "o", "o"}, "Zm9v"},
+      {{"fo", "obar"}, "Zm9vYmFy"},
+      {{"foob", "a"}, "Zm9vYmE="},
+      {{"foo", "", "b"}, "Zm9vYg=="},
+      {{std::string("\0\1\2\3", 4), "\b\n\t", "\xaa\xbc\xde"}, "AAECAwgKCaq83g=="},
+  };
+  for (const auto& test_case : cases) {
+    Buffer::OwnedImpl input;
+    addSlices(input, test_case.first);
+    Buffer::OwnedImpl output;
+    Base64::encode(input, output);
+    EXPECT_EQ(test_case.second, TestUtility::bufferToString(output));
+    EXPECT_EQ(Base64::encode(input, input.length()), test_case.second);
+  }
+}
+
+TEST(Base64Test, StreamDecode) {
+  const std::string encoded = "Zm9vYmFyZm9vYg==Zg==Zm8=Zm9v";
+  const std::string decoded = "foobarfoobffofoo";
+
+  // Every split of the stream into two chunks, with the first chunk in two slices.
+  for (size_t i = 0; i <= encoded.size(); i++) {
+    Base64StreamDecoder decoder;
+    Buffer::OwnedImpl output;
+
+    Buffer::OwnedImpl first;
+    addSlices(first, {encoded.substr(0, i / 2), encoded.substr(i / 2, i - i / 2)});
+    EXPECT_TRUE(decoder.decode(first, output));
+    EXPECT_EQ(0, first.length());
+    EXPECT_EQ(i % 4, decoder.pendingLength());
+
+    Buffer::OwnedImpl second(encoded.substr(i));
+    EXPECT_TRUE(decoder.decode(second, output));
+    EXPECT_EQ(0, decoder.pendingLength());
+    EXPECT_EQ(decoded, TestUtility::bufferToString(output));
+  }
+}
+
+TEST(Base64Test, StreamDecodeFailure) {
+  for (const std::string& input :
+       {"==Zg", "=Zm8", "Zm=8", "Zg=A", "Zh==", "Zm9=", "Zg..", "..Zg", "A===", "Zm9vZg=Z"}) {
+    Base64StreamDecoder decoder;
+    Buffer::OwnedImpl output;
+    Buffer::OwnedImpl data;
+    addSlices(data, {input.substr(0, 1), input.substr(1)});
+    EXPECT_FALSE(decoder.decode(data, output)) << input;
+  }
+}
 } // namespace Envoy
@@ -1,3 +1,4 @@
+#include "common/buffer/buffer_impl.h"
 #include "common/common/hash.h"
 
 #include "gtest/gtest.h"
@@ -10,4 +11,29 @@ TEST(Hash, xxHash) {
   EXPECT_EQ(4400747396090729504U, HashUtil::xxHash64("lyft"));
   EXPECT_EQ(17241709254077376921U, HashUtil::xxHash64(""));
 }
+
+TEST(Hash, xxHashLength) {
+  const std::string input("foo\nbar");
+  EXPECT_EQ(3728699739546630719U, HashUtil::xxHash64(input.data(), 3));
+  EXPECT_EQ(HashUtil::xxHash64(input, 1), HashUtil::xxHash64(input.data(), input.size(), 1));
+}
+
+// A buffer hashes like its contents as one string, however they are split into slices.
+TEST(Hash, xxHashBuffer) {
+  Buffer::OwnedImpl empty;
+  EXPECT_EQ(17241709254077376921U, HashUtil::xxHash64(empty));
+
+  Buffer::OwnedImpl single("foo\nbar");
+  EXPECT_EQ(8917841378505826757U, HashUtil::xxHash64(single));
+
+  const std::string long_input(100, 'x');
+  Buffer::OwnedImpl sliced;
+  for (const std::string& part : {std::string("foo"), std::string("\n"), long_input}) {
+    Buffer::OwnedImpl slice(part);
+    sliced.move(slice);
+  }
+  ASSERT_LT(1U, sliced.getRawSlices(nullptr, 0));
+  EXPECT_EQ(HashUtil::xxHash64("foo\n" + long_input), HashUtil::xxHash64(sliced));
+  EXPECT_EQ(HashUtil::xxHash64("foo\n" + long_input, 7), HashUtil::xxHash64(sliced, 7));
+}
 } // namespace Envoy
@@ -1,5 +1,8 @@
+#include <chrono>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "common/common/logger.h"
 
@@ -34,4 +37,65 @@ TEST(Logger, All) {
   // Misc logging with no facility.
   ENVOY_LOG_MISC(info, "fake message");
 }
+
+class LockingStderrSinkTest : public testing::Test {
+public:
+  void log(spdlog::level::level_enum level, const std::string& message) {
+    spdlog::details::log_msg msg(&logger_name_, level);
+    msg.formatted << message << "\n";
+    sink_.log(msg);
+  }
+
+  const std::string logger_name_{"test"};
+  Logger::LockingStderrSink sink_;
+};
+
+// Buffered messages are written on flush, and messages that don't fit are counted.
+TEST_F(LockingStderrSinkTest, AsyncBuffer) {
+  sink_.startAsync(2, std::chrono::hours(1));
+  testing::internal::CaptureStderr();
+  log(spdlog::level::info, "one");
+  log(spdlog::level::debug, "two");
+  log(spdlog::level::info, "three");
+  EXPECT_EQ(1U, sink_.droppedMessages());
+
+  // Critical messages are written right away, after the buffered ones.
+  log(spdlog::level::critical, "four");
+  log(spdlog::level::info, "five");
+  EXPECT_EQ("one\ntwo\ndropped 1 log messages as the log buffers were full (1 total)\nfour\n",
+            testing::internal::GetCapturedStderr());
+
+  testing::internal::CaptureStderr();
+  sink_.flush();
+  sink_.stopAsync();
+  log(spdlog::level::info, "six");
+  EXPECT_EQ("five\nsix\n", testing::internal::GetCapturedStderr());
+}
+
+// Each thread logs into its own ring buffer, and all of the messages are either written or counted
+// as dropped.
+TEST_F(LockingStderrSinkTest, AsyncThreads) {
+  sink_.startAsync(16, std::chrono::milliseconds(1));
+  testing::internal::CaptureStderr();
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 4; i++) {
+    threads.emplace_back([this]() -> void {
+      for (size_t j = 0; j < 100; j++) {
+        log(spdlog::level::info, "message");
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  sink_.stopAsync();
+
+  const std::string output = testing::internal::GetCapturedStderr();
+  size_t written = 0;
+  for (size_t pos = output.find("message\n"); pos != std::string::npos;
+       pos = output.find("message\n", pos + 1)) {
+    written++;
+  }
+  EXPECT_EQ(400U, written + sink_.droppedMessages());
+}
 } // namespace Envoy
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "common/common/object_pool.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace {
+
+class Base : public PooledObject<Base, 2> {
+public:
+  virtual ~Base() {}
+
+  uint64_t value_{};
+};
+
+class Derived : public Base {
+public:
+  uint64_t other_value_{};
+};
+
+} // namespace
+
+TEST(ObjectFreeList, ReusesBlocks) {
+  ObjectFreeList free_list(2);
+  void* block = free_list.allocate(64);
+  free_list.deallocate(block, 64);
+  EXPECT_EQ(1U, free_list.freeBlocks(64));
+  EXPECT_EQ(0U, free_list.freeBlocks(32));
+
+  // Only a block of the same size is reused.
+  void* other = free_list.allocate(32);
+  EXPECT_NE(block, other);
+  EXPECT_EQ(block, free_list.allocate(64));
+  EXPECT_EQ(0U, free_list.freeBlocks(64));
+  free_list.deallocate(block, 64);
+  free_list.deallocate(other, 32);
+}
+
+TEST(ObjectFreeList, Limits) {
+  ObjectFreeList free_list(2);
+  void* blocks[3];
+  for (void*& block : blocks) {
+    block = free_list.allocate(64);
+  }
+  for (void* block : blocks) {
+    free_list.deallocate(block, 64);
+  }
+  EXPECT_EQ(2U, free_list.freeBlocks(64));
+
+  // Sizes beyond NUM_SIZES are not kept.
+  for (size_t i = 1; i <= ObjectFreeList::NUM_SIZES; i++) {
+    free_list.deallocate(free_list.allocate(64 + i * 8), 64 + i * 8);
+  }
+  for (size_t i = 1; i < ObjectFreeList::NUM_SIZES; i++) {
+    EXPECT_EQ(1U, free_list.freeBlocks(64 + i * 8));
+  }
+  EXPECT_EQ(0U, free_list.freeBlocks(64 + ObjectFreeList::NUM_SIZES * 8));
+}
+
+TEST(PooledObject, RecyclesPerSize) {
+  Base* base = new Base();
+  Base* derived = new Derived();
+  delete base;
+  delete derived;
+  EXPECT_EQ(1U, Base::freeList().freeBlocks(sizeof(Base)));
+  EXPECT_EQ(1U, Base::freeList().freeBlocks(sizeof(Derived)));
+
+  // Deleting through the base releases the block with the size of the derived class.
+  std::unique_ptr<Base> recycled(new Derived());
+  EXPECT_EQ(derived, recycled.get());
+  EXPECT_EQ(0U, recycled->value_);
+  recycled.reset(new Base());
+  EXPECT_EQ(base, recycled.get());
+}
+
+TEST(PooledObject, PerThread) {
+  delete new Base();
+  EXPECT_EQ(1U, Base::freeList().freeBlocks(sizeof(Base)));
+
+  std::thread thread([]() -> void {
+    EXPECT_EQ(0U, Base::freeList().freeBlocks(sizeof(Base)));
+    delete new Base();
+    EXPECT_EQ(1U, Base::freeList().freeBlocks(sizeof(Base)));
+  });
+  thread.join();
+  EXPECT_EQ(1U, Base::freeList().freeBlocks(sizeof(Base)));
+}
+
+} // namespace Envoy
@@ -0,0 +1,64 @@
+#include <string>
+#include <vector>
+
+#include "envoy/common/exception.h"
+
+#include "common/common/regex.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Regex {
+
+TEST(Regex, FullMatch) {
+  CompiledMatcherPtr regex = Utility::parseRegex("/t[io]c");
+  EXPECT_TRUE(regex->match("/tic"));
+  EXPECT_TRUE(regex->match("/toc"));
+  EXPECT_FALSE(regex->match("/tac"));
+  EXPECT_FALSE(regex->match("/tic/"));
+  EXPECT_FALSE(regex->match("x/tic"));
+
+  const std::string path = "/tic?foo=bar";
+  EXPECT_TRUE(regex->match(path.c_str(), path.c_str() + 4));
+  EXPECT_FALSE(regex->match(path.c_str(), path.c_str() + path.size()));
+}
+
+TEST(Regex, Ecmascript) {
+  EXPECT_TRUE(Utility::parseRegex(".*/\\d{3}$")->match("/foo/123"));
+  EXPECT_TRUE(Utility::parseRegex("^user=test-\\d+$")->match("user=test-1223"));
+  EXPECT_FALSE(Utility::parseRegex("^user=test-\\d+$")->match("user=test-"));
+}
+
+TEST(Regex, Captures) {
+  CompiledMatcherPtr regex = Utility::parseRegex("([a-z]+)-(\\d+)(-x)?");
+  std::vector<std::string> captures;
+  EXPECT_TRUE(regex->match("abc-123", captures));
+  EXPECT_EQ((std::vector<std::string>{"abc", "123", ""}), captures);
+  EXPECT_FALSE(regex->match("abc-123-y", captures));
+}
+
+TEST(Regex, Search) {
+  CompiledMatcherPtr regex = Utility::parseRegex("t[io]c");
+  EXPECT_TRUE(regex->search("/tic/"));
+  EXPECT_TRUE(regex->search("toc"));
+  EXPECT_FALSE(regex->search("/tac/"));
+  EXPECT_TRUE(Utility::parseRegex("^/t")->search("/tic"));
+  EXPECT_FALSE(Utility::parseRegex("^t")->search("/tic"));
+  EXPECT_TRUE(Utility::parseRegex("")->search("/tic"));
+}
+
+TEST(Regex, Invalid) {
+  EXPECT_THROW(Utility::parseRegex("(abc"), EnvoyException);
+  // Back references cannot be matched in linear time and are rejected.
+  EXPECT_THROW(Utility::parseRegex("(a)\\1"), EnvoyException);
+}
+
+TEST(Regex, LinearTime) {
+  // Catastrophic backtracking for a backtracking engine.
+  CompiledMatcherPtr regex = Utility::parseRegex("(a+)+b");
+  EXPECT_FALSE(regex->match(std::string(100000, 'a')));
+  EXPECT_FALSE(regex->search(std::string(100000, 'a')));
+}
+
+} // namespace Regex
+} // namespace Envoy
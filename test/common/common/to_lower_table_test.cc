@@ -26,5 +26,44 @@ TEST(ToLowerTableTest, All) {
     table.toLowerCase(input);
     EXPECT_EQ(input, "\x90hello\x90");
   }
+  {
+    std::string input("X-ENVOY-UPSTREAM-SERVICE-TIME-@[`{\x90\xC0-Hello");
+    table.toLowerCase(input);
+    EXPECT_EQ(input, "x-envoy-upstream-service-time-@[`{\x90\xC0-hello");
+  }
+}
+
+// Every byte value is converted the same way wherever it falls relative to the words.
+TEST(ToLowerTableTest, AllBytes) {
+  ToLowerTable table;
+  std::string bytes;
+  for (int c = 0; c < 256; c++) {
+    bytes.push_back(static_cast<char>(c));
+  }
+
+  for (size_t offset = 0; offset < 8; offset++) {
+    std::string input = bytes.substr(offset);
+    table.toLowerCase(input);
+    for (size_t i = 0; i < input.size(); i++) {
+      const int c = static_cast<uint8_t>(bytes[offset + i]);
+      const int expected = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+      EXPECT_EQ(expected, static_cast<uint8_t>(input[i])) << c;
+    }
+  }
+}
+
+TEST(ToLowerTableTest, EqualsIgnoreCase) {
+  ToLowerTable table;
+  EXPECT_TRUE(table.equalsIgnoreCase("", ""));
+  EXPECT_TRUE(table.equalsIgnoreCase("100-Continue", "100-continue"));
+  EXPECT_TRUE(table.equalsIgnoreCase("WWW.EXAMPLE.COM", "www.example.com"));
+  EXPECT_TRUE(table.equalsIgnoreCase("\x90\xC0Host", "\x90\xC0hOST"));
+  EXPECT_FALSE(table.equalsIgnoreCase("100-continue", "100-continu"));
+  EXPECT_FALSE(table.equalsIgnoreCase("www.example.com", "www.example.org"));
+  EXPECT_FALSE(table.equalsIgnoreCase("www.example.com", "xww.example.com"));
+  // Only ASCII letters differ in case.
+  EXPECT_FALSE(table.equalsIgnoreCase("@[`{@[`{", "`{@[`{@["));
+  EXPECT_FALSE(table.equalsIgnoreCase("\xC0\xC0\xC0\xC0\xC0\xC0\xC0\xC0",
+                                      "\xE0\xE0\xE0\xE0\xE0\xE0\xE0\xE0"));
 }
 } // namespace Envoy
@@ -0,0 +1,75 @@
+#include <string>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/compressor/zlib_compressor_impl.h"
+
+#include "test/test_common/utility.h"
+
+#include "gtest/gtest.h"
+#include "zlib.h"
+
+namespace Envoy {
+namespace Compressor {
+
+std::string gunzip(const std::string& compressed, int& result) {
+  z_stream zstream{};
+  EXPECT_EQ(Z_OK, inflateInit2(&zstream, 31));
+  zstream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+  zstream.avail_in = compressed.size();
+  std::string output;
+  do {
+    char chunk[4096];
+    zstream.next_out = reinterpret_cast<Bytef*>(chunk);
+    zstream.avail_out = sizeof(chunk);
+    result = inflate(&zstream, Z_NO_FLUSH);
+    output.append(chunk, sizeof(chunk) - zstream.avail_out);
+  } while (result == Z_OK && zstream.avail_in > 0);
+  inflateEnd(&zstream);
+  return output;
+}
+
+TEST(ZlibCompressorImplTest, CompressStream) {
+  ZlibCompressorImpl compressor(6, 15, 8);
+  // The body spans several output chunks and input slices.
+  std::string body;
+  for (int i = 0; i < 10000; i++) {
+    body += std::to_string(i * 7919);
+  }
+
+  for (int stream = 0; stream < 2; stream++) {
+    Buffer::OwnedImpl chunk1;
+    chunk1.add(body.substr(0, 100));
+    chunk1.add(body.substr(100, body.size() / 2));
+    compressor.compress(chunk1, false);
+    const std::string compressed1 = TestUtility::bufferToString(chunk1);
+
+    // The first chunk is flushed, so it can be decompressed before the stream ends.
+    int result;
+    EXPECT_EQ(body.substr(0, 100 + body.size() / 2), gunzip(compressed1, result));
+    EXPECT_EQ(Z_OK, result);
+
+    Buffer::OwnedImpl chunk2(body.substr(100 + body.size() / 2));
+    compressor.compress(chunk2, true);
+    EXPECT_EQ(body, gunzip(compressed1 + TestUtility::bufferToString(chunk2), result));
+    EXPECT_EQ(Z_STREAM_END, result);
+
+    // A reset compressor starts a new gzip stream.
+    compressor.reset();
+  }
+}
+
+TEST(ZlibCompressorImplTest, EmptyStream) {
+  ZlibCompressorImpl compressor(1, 9, 1);
+  Buffer::OwnedImpl data;
+  compressor.compress(data, true);
+  int result;
+  EXPECT_EQ("", gunzip(TestUtility::bufferToString(data), result));
+  EXPECT_EQ(Z_STREAM_END, result);
+}
+
+TEST(ZlibCompressorImplTest, BadParameters) {
+  EXPECT_THROW(ZlibCompressorImpl(6, 15, 10), EnvoyException);
+}
+
+} // namespace Compressor
+} // namespace Envoy
@@ -0,0 +1,110 @@
+#include <cstdint>
+#include <string>
+
+#include "envoy/common/exception.h"
+
+#include "common/buffer/buffer_impl.h"
+#include "common/compressor/zlib_compressor_impl.h"
+#include "common/compressor/zlib_decompressor_impl.h"
+
+#include "test/test_common/utility.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Compressor {
+
+std::string gzip(const std::string& body) {
+  ZlibCompressorImpl compressor(6, 15, 8);
+  Buffer::OwnedImpl buffer(body);
+  compressor.compress(buffer, true);
+  return TestUtility::bufferToString(buffer);
+}
+
+TEST(ZlibDecompressorImplTest, DecompressStream) {
+  ZlibDecompressorImpl decompressor(15, UINT64_MAX);
+  // The body spans several output chunks and input slices.
+  std::string body;
+  for (int i = 0; i < 10000; i++) {
+    body += std::to_string(i * 7919);
+  }
+  const std::string compressed = gzip(body);
+
+  for (int stream = 0; stream < 2; stream++) {
+    Buffer::OwnedImpl chunk1;
+    chunk1.add(compressed.substr(0, 10));
+    chunk1.add(compressed.substr(10, compressed.size() / 2));
+    EXPECT_TRUE(decompressor.decompress(chunk1));
+    EXPECT_FALSE(decompressor.finished());
+
+    Buffer::OwnedImpl chunk2(compressed.substr(10 + compressed.size() / 2));
+    EXPECT_TRUE(decompressor.decompress(chunk2));
+    EXPECT_TRUE(decompressor.finished());
+    EXPECT_EQ(body, TestUtility::bufferToString(chunk1) + TestUtility::bufferToString(chunk2));
+
+    // A reset decompressor starts a new gzip stream.
+    decompressor.reset();
+    EXPECT_FALSE(decompressor.finished());
+  }
+}
+
+TEST(ZlibDecompressorImplTest, EmptyStream) {
+  ZlibDecompressorImpl decompressor(15, UINT64_MAX);
+  Buffer::OwnedImpl data(gzip(""));
+  EXPECT_TRUE(decompressor.decompress(data));
+  EXPECT_TRUE(decompressor.finished());
+  EXPECT_EQ(0, data.length());
+}
+
+TEST(ZlibDecompressorImplTest, InvalidStream) {
+  ZlibDecompressorImpl decompressor(15, UINT64_MAX);
+  Buffer::OwnedImpl data("not gzip");
+  EXPECT_FALSE(decompressor.decompress(data));
+  EXPECT_EQ("not gzip", TestUtility::bufferToString(data));
+}
+
+TEST(ZlibDecompressorImplTest, DataAfterEndOfStream) {
+  ZlibDecompressorImpl decompressor(15, UINT64_MAX);
+  Buffer::OwnedImpl data(gzip("hello") + "trailing");
+  EXPECT_FALSE(decompressor.decompress(data));
+
+  decompressor.reset();
+  Buffer::OwnedImpl response(gzip("hello"));
+  EXPECT_TRUE(decompressor.decompress(response));
+  EXPECT_EQ("hello", TestUtility::bufferToString(response));
+  Buffer::OwnedImpl trailing("trailing");
+  EXPECT_FALSE(decompressor.decompress(trailing));
+}
+
+TEST(ZlibDecompressorImplTest, MaxOutputSize) {
+  ZlibDecompressorImpl decompressor(15, 100000);
+  // A few hundred bytes inflate to well over the limit.
+  const std::string compressed = gzip(std::string(1000000, 'a'));
+  Buffer::OwnedImpl data(compressed);
+  EXPECT_FALSE(decompressor.decompress(data));
+  EXPECT_EQ(compressed, TestUtility::bufferToString(data));
+
+  // The limit applies to the whole stream, and starts over on reset.
+  for (int stream = 0; stream < 2; stream++) {
+    decompressor.reset();
+    const std::string body(100000, 'a');
+    const std::string exact = gzip(body);
+    Buffer::OwnedImpl chunk1(exact.substr(0, exact.size() / 2));
+    Buffer::OwnedImpl chunk2(exact.substr(exact.size() / 2));
+    EXPECT_TRUE(decompressor.decompress(chunk1));
+    EXPECT_TRUE(decompressor.decompress(chunk2));
+    EXPECT_TRUE(decompressor.finished());
+    EXPECT_EQ(body, TestUtility::bufferToString(chunk1) + TestUtility::bufferToString(chunk2));
+  }
+
+  decompressor.reset();
+  Buffer::OwnedImpl over(gzip(std::string(100001, 'a')));
+  EXPECT_FALSE(decompressor.decompress(over));
+}
+
+TEST(ZlibDecompressorImplTest, BadParameters) {
+  EXPECT_THROW(ZlibDecompressorImpl(7, UINT64_MAX), EnvoyException);
+}
+
+} // namespace Compressor
+} // namespace Envoy
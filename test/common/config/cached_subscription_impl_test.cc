@@ -0,0 +1,197 @@
+#include <fstream>
+
+#include "common/config/cached_subscription_impl.h"
+
+#include "test/mocks/config/mocks.h"
+#include "test/mocks/event/mocks.h"
+#include "test/test_common/environment.h"
+#include "test/test_common/utility.h"
+
+#include "api/eds.pb.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::Invoke;
+using testing::NiceMock;
+using testing::SaveArg;
+using testing::Throw;
+using testing::_;
+
+namespace Envoy {
+namespace Config {
+
+typedef Subscription<envoy::api::v2::ClusterLoadAssignment> EdsSubscription;
+typedef SubscriptionCallbacks<envoy::api::v2::ClusterLoadAssignment>::ResourceVector
+    EdsResourceVector;
+
+class CachedSubscriptionImplTest : public testing::Test {
+public:
+  CachedSubscriptionImplTest() : directory_(TestEnvironment::temporaryDirectory()) {
+    // Every test starts without a cache.
+    ::unlink(cachePath().c_str());
+    ::unlink((cachePath() + ".tmp").c_str());
+  }
+
+  // Returns the new subscription, whose wrapped subscription is subscription_ and whose write
+  // timer is timer_.
+  std::unique_ptr<EdsSubscription> createSubscription() {
+    subscription_ = new MockSubscription<envoy::api::v2::ClusterLoadAssignment>();
+    timer_ = new NiceMock<Event::MockTimer>(&dispatcher_);
+    return std::unique_ptr<EdsSubscription>(
+        new CachedSubscriptionImpl<envoy::api::v2::ClusterLoadAssignment>(
+            std::unique_ptr<EdsSubscription>(subscription_), dispatcher_, directory_));
+  }
+
+  std::string cachePath() {
+    return fmt::format("{}/envoy.api.v2.ClusterLoadAssignment.{:016x}.pb", directory_,
+                       HashUtil::xxHash64(StringUtil::join(resources_, ",")));
+  }
+
+  EdsResourceVector clusterLoadAssignments(const std::string& cluster_name) {
+    EdsResourceVector resources;
+    resources.Add()->set_cluster_name(cluster_name);
+    return resources;
+  }
+
+  const std::string directory_;
+  const std::vector<std::string> resources_{"cluster0", "cluster1"};
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  MockSubscription<envoy::api::v2::ClusterLoadAssignment>* subscription_;
+  Event::MockTimer* timer_;
+  MockSubscriptionCallbacks<envoy::api::v2::ClusterLoadAssignment> callbacks_;
+};
+
+// Without a cache the subscription waits for the wrapped subscription.
+TEST_F(CachedSubscriptionImplTest, NoCache) {
+  std::unique_ptr<EdsSubscription> subscription = createSubscription();
+  EXPECT_CALL(callbacks_, onConfigUpdate(_)).Times(0);
+  EXPECT_CALL(*subscription_, start(resources_, _));
+  subscription->start(resources_, callbacks_);
+}
+
+// An accepted update is written once the write timer fires, and is delivered by the next
+// subscription before its wrapped subscription starts.
+TEST_F(CachedSubscriptionImplTest, UpdateIsCachedAndReplayed) {
+  {
+    std::unique_ptr<EdsSubscription> subscription = createSubscription();
+    SubscriptionCallbacks<envoy::api::v2::ClusterLoadAssignment>* wrapped_callbacks{};
+    EXPECT_CALL(*subscription_, start(resources_, _)).WillOnce(SaveArg<1>(&wrapped_callbacks));
+    subscription->start(resources_, callbacks_);
+
+    EXPECT_CALL(callbacks_, onConfigUpdate(_));
+    EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(1000)));
+    wrapped_callbacks->onConfigUpdate(clusterLoadAssignments("cluster0"));
+    EXPECT_FALSE(Filesystem::fileExists(cachePath()));
+    timer_->callback_();
+    EXPECT_TRUE(Filesystem::fileExists(cachePath()));
+    EXPECT_FALSE(Filesystem::fileExists(cachePath() + ".tmp"));
+  }
+
+  std::unique_ptr<EdsSubscription> subscription = createSubscription();
+  testing::InSequence s;
+  EXPECT_CALL(callbacks_, onConfigUpdate(_))
+      .WillOnce(Invoke([](const EdsResourceVector& resources) -> void {
+        EXPECT_EQ(1, resources.size());
+        EXPECT_EQ("cluster0", resources[0].cluster_name());
+      }));
+  EXPECT_CALL(*subscription_, start(resources_, _));
+  subscription->start(resources_, callbacks_);
+}
+
+// A pending write is not lost when the subscription is destroyed.
+TEST_F(CachedSubscriptionImplTest, PendingWriteOnDestruction) {
+  std::unique_ptr<EdsSubscription> subscription = createSubscription();
+  SubscriptionCallbacks<envoy::api::v2::ClusterLoadAssignment>* wrapped_callbacks{};
+  EXPECT_CALL(*subscription_, start(resources_, _)).WillOnce(SaveArg<1>(&wrapped_callbacks));
+  subscription->start(resources_, callbacks_);
+
+  EXPECT_CALL(callbacks_, onConfigUpdate(_));
+  wrapped_callbacks->onConfigUpdate(clusterLoadAssignments("cluster0"));
+  subscription.reset();
+  EXPECT_TRUE(Filesystem::fileExists(cachePath()));
+}
+
+// A rejected update is not cached, and the rejection reaches the wrapped subscription.
+TEST_F(CachedSubscriptionImplTest, RejectedUpdateIsNotCached) {
+  std::unique_ptr<EdsSubscription> subscription = createSubscription();
+  SubscriptionCallbacks<envoy::api::v2::ClusterLoadAssignment>* wrapped_callbacks{};
+  EXPECT_CALL(*subscription_, start(resources_, _)).WillOnce(SaveArg<1>(&wrapped_callbacks));
+  subscription->start(resources_, callbacks_);
+
+  EXPECT_CALL(callbacks_, onConfigUpdate(_)).WillOnce(Throw(EnvoyException("bad config")));
+  EXPECT_CALL(*timer_, enableTimer(_)).Times(0);
+  EXPECT_THROW_WITH_MESSAGE(wrapped_callbacks->onConfigUpdate(clusterLoadAssignments("cluster0")),
+                            EnvoyException, "bad config");
+  subscription.reset();
+  EXPECT_FALSE(Filesystem::fileExists(cachePath()));
+}
+
+// A corrupt cache is ignored.
+TEST_F(CachedSubscriptionImplTest, CorruptCache) {
+  {
+    std::ofstream file(cachePath(), std::ios::binary);
+    file << "\xff\xff\xff\xff";
+  }
+
+  std::unique_ptr<EdsSubscription> subscription = createSubscription();
+  EXPECT_CALL(callbacks_, onConfigUpdate(_)).Times(0);
+  EXPECT_CALL(*subscription_, start(resources_, _));
+  subscription->start(resources_, callbacks_);
+}
+
+// A cache that is rejected leaves the subscription waiting for the wrapped subscription, and does
+// not fail the initialization that waits on it.
+TEST_F(CachedSubscriptionImplTest, RejectedCache) {
+  {
+    std::unique_ptr<EdsSubscription> subscription = createSubscription();
+    SubscriptionCallbacks<envoy::api::v2::ClusterLoadAssignment>* wrapped_callbacks{};
+    EXPECT_CALL(*subscription_, start(resources_, _)).WillOnce(SaveArg<1>(&wrapped_callbacks));
+    subscription->start(resources_, callbacks_);
+    EXPECT_CALL(callbacks_, onConfigUpdate(_));
+    wrapped_callbacks->onConfigUpdate(clusterLoadAssignments("cluster0"));
+  }
+
+  std::unique_ptr<EdsSubscription> subscription = createSubscription();
+  EXPECT_CALL(callbacks_, onConfigUpdate(_)).WillOnce(Throw(EnvoyException("bad config")));
+  EXPECT_CALL(callbacks_, onConfigUpdateFailed(_)).Times(0);
+  EXPECT_CALL(*subscription_, start(resources_, _));
+  subscription->start(resources_, callbacks_);
+}
+
+// Resource names select the cache, so a subscription to other resources does not see it.
+TEST_F(CachedSubscriptionImplTest, CacheIsPerResourceNames) {
+  {
+    std::unique_ptr<EdsSubscription> subscription = createSubscription();
+    SubscriptionCallbacks<envoy::api::v2::ClusterLoadAssignment>* wrapped_callbacks{};
+    EXPECT_CALL(*subscription_, start(resources_, _)).WillOnce(SaveArg<1>(&wrapped_callbacks));
+    subscription->start(resources_, callbacks_);
+    EXPECT_CALL(callbacks_, onConfigUpdate(_));
+    wrapped_callbacks->onConfigUpdate(clusterLoadAssignments("cluster0"));
+  }
+
+  std::unique_ptr<EdsSubscription> subscription = createSubscription();
+  const std::vector<std::string> other_resources{"cluster2"};
+  EXPECT_CALL(callbacks_, onConfigUpdate(_)).Times(0);
+  EXPECT_CALL(*subscription_, start(other_resources, _));
+  subscription->start(other_resources, callbacks_);
+}
+
+// Everything else is the wrapped subscription's.
+TEST_F(CachedSubscriptionImplTest, Forwarding) {
+  std::unique_ptr<EdsSubscription> subscription = createSubscription();
+  SubscriptionCallbacks<envoy::api::v2::ClusterLoadAssignment>* wrapped_callbacks{};
+  EXPECT_CALL(*subscription_, start(resources_, _)).WillOnce(SaveArg<1>(&wrapped_callbacks));
+  subscription->start(resources_, callbacks_);
+
+  EXPECT_CALL(*subscription_, updateResources(std::vector<std::string>{"cluster2"}));
+  subscription->updateResources({"cluster2"});
+
+  EXPECT_CALL(*subscription_, versionInfo()).WillOnce(testing::Return("v1"));
+  EXPECT_EQ("v1", subscription->versionInfo());
+
+  EXPECT_CALL(callbacks_, onConfigUpdateFailed(nullptr));
+  wrapped_callbacks->onConfigUpdateFailed(nullptr);
+}
+
+} // namespace Config
+} // namespace Envoy
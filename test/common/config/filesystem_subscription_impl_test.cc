@@ -27,6 +27,38 @@ TEST_F(FilesystemSubscriptionImplTest, InitialFile) {
   verifyStats(1, 1, 0, 0);
 }
 
+// Validate that a file that is moved into place several times before it is read is read once.
+TEST_F(FilesystemSubscriptionImplTest, DebounceMoves) {
+  startSubscription({"cluster0", "cluster1"});
+  verifyStats(1, 0, 0, 0);
+  EXPECT_CALL(callbacks_, onConfigUpdate(_));
+  updateFile("{\"versionInfo\": \"0\", \"resources\": []}", false);
+  updateFile("{\"versionInfo\": \"1\", \"resources\": []}");
+  verifyStats(2, 1, 0, 0);
+  EXPECT_EQ("1", subscription_.versionInfo());
+}
+
+// Validate that a file whose version and resources are unchanged is not delivered again, and that
+// a file with a new version is delivered even if its resources are unchanged.
+TEST_F(FilesystemSubscriptionImplTest, UnchangedFile) {
+  startSubscription({"cluster0", "cluster1"});
+  verifyStats(1, 0, 0, 0);
+  deliverConfigUpdate({"cluster0", "cluster1"}, "0", true);
+  verifyStats(2, 1, 0, 0);
+  EXPECT_CALL(callbacks_, onConfigUpdate(_)).Times(0);
+  updateFile("{\"versionInfo\":\"0\",\"resources\":[{\"@type\":\"type.googleapis.com/"
+             "envoy.api.v2.ClusterLoadAssignment\",\"clusterName\":\"cluster0\"},{\"@type\":"
+             "\"type.googleapis.com/envoy.api.v2.ClusterLoadAssignment\",\"clusterName\":"
+             "\"cluster1\"}]}");
+  verifyStats(3, 2, 0, 0);
+  testing::Mock::VerifyAndClearExpectations(&callbacks_);
+  // Reordered resources are delivered, and the moved resources are delivered intact.
+  deliverConfigUpdate({"cluster1", "cluster0"}, "0", true);
+  verifyStats(4, 3, 0, 0);
+  deliverConfigUpdate({"cluster1", "cluster0"}, "1", true);
+  verifyStats(5, 4, 0, 0);
+}
+
 } // namespace
 } // namespace Config
 } // namespace Envoy
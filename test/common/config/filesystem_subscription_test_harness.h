@@ -27,7 +27,7 @@ class FilesystemSubscriptionTestHarness : public SubscriptionTestHarness {
 public:
   FilesystemSubscriptionTestHarness()
       : path_(TestEnvironment::temporaryPath("eds.json")),
-        subscription_(dispatcher_, path_, stats_) {}
+        subscription_(dispatcher_, path_, stats_, std::chrono::milliseconds(0)) {}
 
   ~FilesystemSubscriptionTestHarness() { EXPECT_EQ(0, ::unlink(path_.c_str())); }
 
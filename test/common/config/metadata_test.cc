@@ -20,6 +20,34 @@ TEST(MetadataTest, MetadataValue) {
       Metadata::metadataValue(metadata, MetadataFilters::get().ENVOY_LB, "bar").bool_value());
 }
 
+TEST(MetadataTest, SubsetKey) {
+  envoy::api::v2::Metadata metadata;
+  const std::string& filter = MetadataFilters::get().ENVOY_LB;
+  Metadata::mutableMetadataValue(metadata, filter, "string").set_string_value("1");
+  Metadata::mutableMetadataValue(metadata, filter, "number").set_number_value(1);
+  Metadata::mutableMetadataValue(metadata, filter, "bool").set_bool_value(true);
+  Metadata::mutableMetadataValue(metadata, filter, "list").mutable_list_value();
+
+  std::string key;
+  EXPECT_TRUE(Metadata::subsetKey(metadata, filter, {"bool", "number", "string"}, key));
+  std::string other_key;
+  EXPECT_TRUE(Metadata::subsetKey(metadata, filter, {"bool", "number", "string"}, other_key));
+  EXPECT_EQ(key, other_key);
+
+  // Values of different kinds are different values.
+  std::string string_key;
+  EXPECT_TRUE(Metadata::subsetKey(metadata, filter, {"string"}, string_key));
+  Metadata::mutableMetadataValue(metadata, filter, "string").set_number_value(1);
+  std::string number_key;
+  EXPECT_TRUE(Metadata::subsetKey(metadata, filter, {"string"}, number_key));
+  EXPECT_NE(string_key, number_key);
+
+  std::string unused;
+  EXPECT_FALSE(Metadata::subsetKey(metadata, filter, {"list"}, unused));
+  EXPECT_FALSE(Metadata::subsetKey(metadata, filter, {"missing"}, unused));
+  EXPECT_FALSE(Metadata::subsetKey(metadata, "foo", {"string"}, unused));
+}
+
 } // namespace
 } // namespace Config
 } // namespace Envoy
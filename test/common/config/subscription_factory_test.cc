@@ -72,6 +72,7 @@ TEST_F(SubscriptionFactoryTest, FilesystemSubscription) {
   config.set_path("/blahblah");
   auto* watcher = new Filesystem::MockWatcher();
   EXPECT_CALL(dispatcher_, createFilesystemWatcher_()).WillOnce(Return(watcher));
+  EXPECT_CALL(dispatcher_, createTimer_(_));
   EXPECT_CALL(*watcher, addWatch("/blahblah", _, _));
   subscriptionFromConfigSource(config)->start({"foo"}, callbacks_);
 }
@@ -2,6 +2,7 @@
 #include "common/protobuf/protobuf.h"
 
 #include "test/mocks/local_info/mocks.h"
+#include "test/test_common/utility.h"
 
 #include "api/eds.pb.h"
 #include "gmock/gmock.h"
@@ -31,6 +32,36 @@ TEST(UtilityTest, GetTypedResources) {
   EXPECT_EQ("1", typed_resources[1].cluster_name());
 }
 
+// The name is read from the serialized resource, whatever the other fields hold.
+TEST(UtilityTest, ResourceName) {
+  envoy::api::v2::ClusterLoadAssignment load_assignment;
+  auto* endpoints = load_assignment.add_endpoints();
+  for (uint32_t port = 80; port < 90; port++) {
+    auto* socket_address = endpoints->add_lb_endpoints()
+                               ->mutable_endpoint()
+                               ->mutable_address()
+                               ->mutable_socket_address();
+    socket_address->set_address("1.2.3.4");
+    socket_address->set_port_value(port);
+  }
+  load_assignment.set_cluster_name("foo");
+  ProtobufWkt::Any resource;
+  resource.PackFrom(load_assignment);
+  EXPECT_EQ("foo", Utility::resourceName(resource));
+
+  load_assignment.clear_cluster_name();
+  resource.PackFrom(load_assignment);
+  EXPECT_EQ("", Utility::resourceName(resource));
+
+  // A truncated resource is rejected.
+  resource.mutable_value()->resize(resource.value().size() - 1);
+  EXPECT_THROW(Utility::resourceName(resource), EnvoyException);
+
+  resource.set_type_url("foo");
+  EXPECT_THROW_WITH_MESSAGE(Utility::resourceName(resource), EnvoyException,
+                            "Unknown type URL foo in DiscoveryResponse");
+}
+
 TEST(UtilityTest, ComputeHashedVersion) {
   EXPECT_EQ("hash_2e1472b57af294d1", Utility::computeHashedVersion("{}"));
   EXPECT_EQ("hash_33bf00a859c4ba3f", Utility::computeHashedVersion("foo"));
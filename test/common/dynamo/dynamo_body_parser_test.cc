@@ -0,0 +1,158 @@
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/dynamo/dynamo_body_parser.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Dynamo {
+
+TEST(DynamoBodyParser, Empty) {
+  BodyParser body;
+  EXPECT_TRUE(body.empty());
+  EXPECT_FALSE(body.finish());
+}
+
+TEST(DynamoBodyParser, ValidBodies) {
+  std::vector<std::string> bodies{
+      "{}",
+      " [ ] ",
+      "\"string\"",
+      "-0.5e+10",
+      "10",
+      "[true, false, null, 1, -2.5, 3E2, \"a\", {}, []]",
+      "{\"a\": {\"b\": [{\"c\": \"\\\"\\\\\\/\\b\\f\\n\\r\\t\\u00e9\"}]}}",
+      "\n{\"key\" :\t\"value\",\r\n\"other\" : null}\n"};
+  for (const std::string& json : bodies) {
+    BodyParser body;
+    body.parse(json.data(), json.size());
+    EXPECT_TRUE(body.finish()) << json;
+  }
+}
+
+TEST(DynamoBodyParser, InvalidBodies) {
+  std::vector<std::string> bodies{"testtest2",
+                                  "{",
+                                  "}",
+                                  "{}}",
+                                  "{} {}",
+                                  "[1,]",
+                                  "[1 2]",
+                                  "{\"a\"}",
+                                  "{\"a\" 1}",
+                                  "{\"a\": 1,}",
+                                  "{1: 2}",
+                                  "{\"a\": tru}",
+                                  "{\"a\": 01}",
+                                  "{\"a\": 1.}",
+                                  "{\"a\": 1e}",
+                                  "{\"a\": -}",
+                                  "{\"a\": \"\\x\"}",
+                                  "{\"a\": \"\\u12g4\"}",
+                                  "{\"a\": \"new\nline\"}",
+                                  "{\"a\": \"unterminated}",
+                                  "[" + std::string(100, '1') + "]"};
+  for (const std::string& json : bodies) {
+    BodyParser body;
+    body.parse(json.data(), json.size());
+    EXPECT_FALSE(body.empty());
+    EXPECT_FALSE(body.finish()) << json;
+  }
+}
+
+TEST(DynamoBodyParser, ExtractValues) {
+  std::string json = R"EOF(
+  {
+    "Key": {"TableName": {"S": "nested"}, "__type": "nested"},
+    "TableName": "Pe\"ts",
+    "__type": "com.amazonaws.dynamodb.v20120810#ValidationException",
+    "RequestItems": {
+      "table_1": {"Keys": [{"RequestItems": {"nested": {}}}]},
+      "table\u005f2": {}
+    },
+    "UnprocessedKeys": {"table_3": {"Keys": []}},
+    "ConsumedCapacity": {
+      "TableName": "nested",
+      "Partitions": {"partition_1": 0.5, "partition_2": 3, "partition_3": "4", "partition_4": {}}
+    },
+    "TableName": "duplicate"
+  }
+  )EOF";
+
+  BodyParser body;
+  body.parse(json.data(), json.size());
+  EXPECT_TRUE(body.finish());
+  EXPECT_EQ("Pe\"ts", body.tableName());
+  EXPECT_EQ("com.amazonaws.dynamodb.v20120810#ValidationException", body.errorType());
+  EXPECT_EQ((std::vector<std::string>{"table_1", "table_2"}), body.requestItems());
+  EXPECT_EQ(std::vector<std::string>{"table_3"}, body.unprocessedKeys());
+  std::vector<std::pair<std::string, double>> partitions{{"partition_1", 0.5},
+                                                         {"partition_2", 3.0}};
+  EXPECT_EQ(partitions, body.partitions());
+}
+
+TEST(DynamoBodyParser, NotObjects) {
+  std::string json = R"EOF(
+  {
+    "TableName": {"Name": "table"},
+    "__type": 1,
+    "RequestItems": ["table_1"],
+    "UnprocessedKeys": "table_2",
+    "ConsumedCapacity": {"Partitions": []}
+  }
+  )EOF";
+
+  BodyParser body;
+  body.parse(json.data(), json.size());
+  EXPECT_TRUE(body.finish());
+  EXPECT_EQ("", body.tableName());
+  EXPECT_EQ("", body.errorType());
+  EXPECT_TRUE(body.requestItems().empty());
+  EXPECT_TRUE(body.unprocessedKeys().empty());
+  EXPECT_TRUE(body.partitions().empty());
+}
+
+TEST(DynamoBodyParser, LongStringNotKept) {
+  std::string json = "{\"TableName\": \"" + std::string(2048, 'a') + "\"}";
+
+  BodyParser body;
+  body.parse(json.data(), json.size());
+  EXPECT_TRUE(body.finish());
+  EXPECT_EQ("", body.tableName());
+}
+
+TEST(DynamoBodyParser, Streamed) {
+  std::string json =
+      "{\"TableName\": \"locations\", \"ConsumedCapacity\": {\"Partitions\": {\"p\\u00e9\": "
+      "1.25}}, \"Limit\": 100}";
+
+  // Feed one byte at a time, so that every token is split.
+  BodyParser body;
+  for (char c : json) {
+    body.parse(&c, 1);
+  }
+  EXPECT_TRUE(body.finish());
+  EXPECT_EQ("locations", body.tableName());
+  std::vector<std::pair<std::string, double>> partitions{{"p\xc3\xa9", 1.25}};
+  EXPECT_EQ(partitions, body.partitions());
+}
+
+TEST(DynamoBodyParser, Buffer) {
+  Buffer::OwnedImpl data1("{\"TableName\"");
+  Buffer::OwnedImpl data2(":\"locations\"");
+  data2.add("}");
+
+  BodyParser body;
+  body.parse(data1);
+  body.parse(data2);
+  EXPECT_TRUE(body.finish());
+  EXPECT_EQ("locations", body.tableName());
+  // The data is only read.
+  EXPECT_EQ(12UL, data1.length());
+}
+
+} // namespace Dynamo
+} // namespace Envoy
@@ -8,6 +8,7 @@
 #include "test/mocks/http/mocks.h"
 #include "test/mocks/runtime/mocks.h"
 #include "test/mocks/stats/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
 #include "test/test_common/printers.h"
 #include "test/test_common/utility.h"
 
@@ -29,7 +30,10 @@ public:
         .WillByDefault(Return(enabled));
     EXPECT_CALL(loader_.snapshot_, featureEnabled("dynamodb.filter_enabled", 100));
 
-    filter_.reset(new DynamoFilter(loader_, stat_prefix_, stats_));
+    if (!config_) {
+      config_ = std::make_shared<DynamoFilterConfig>(stat_prefix_, stats_, tls_);
+    }
+    filter_.reset(new DynamoFilter(loader_, config_));
 
     filter_->setDecoderFilterCallbacks(decoder_callbacks_);
     filter_->setEncoderFilterCallbacks(encoder_callbacks_);
@@ -41,6 +45,8 @@ public:
   NiceMock<Runtime::MockLoader> loader_;
   std::string stat_prefix_{"prefix."};
   Stats::MockStore stats_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  DynamoFilterConfigSharedPtr config_;
   NiceMock<Http::MockStreamDecoderFilterCallbacks> decoder_callbacks_;
   NiceMock<Http::MockStreamEncoderFilterCallbacks> encoder_callbacks_;
 };
@@ -114,15 +120,28 @@ TEST_F(DynamoFilterTest, handleErrorTypeTableMissing) {
   error_data->add(internal_error);
   EXPECT_CALL(stats_, counter("prefix.dynamodb.error.no_table.ValidationException"));
   EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(*error_data, true));
+}
+
+TEST_F(DynamoFilterTest, handleInvalidResponseBodyWithTrailers) {
+  setup(true);
+
+  Http::TestHeaderMapImpl request_headers{{"x-amz-target", "version"}, {"random", "random"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, true));
+
+  Http::TestHeaderMapImpl response_headers{{":status", "400"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->encodeHeaders(response_headers, false));
+
+  // The body is streamed rather than buffered, and is only found invalid in its last part.
+  Buffer::OwnedImpl error_data(
+      "{\"__type\":\"com.amazonaws.dynamodb.v20120810#ValidationException\"}");
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(error_data, false));
+  Buffer::OwnedImpl extra_data("}");
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(extra_data, false));
 
-  error_data->add("}", 1);
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer,
-            filter_->encodeData(*error_data, false));
-  EXPECT_CALL(encoder_callbacks_, encodingBuffer()).WillRepeatedly(Return(error_data.get()));
   EXPECT_CALL(stats_, counter("prefix.dynamodb.invalid_resp_body"));
   EXPECT_CALL(stats_, counter("prefix.dynamodb.operation_missing"));
   EXPECT_CALL(stats_, counter("prefix.dynamodb.table_missing"));
-  EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_->encodeTrailers(request_headers));
+  EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_->encodeTrailers(response_headers));
 }
 
 TEST_F(DynamoFilterTest, HandleErrorTypeTablePresent) {
@@ -186,8 +205,7 @@ TEST_F(DynamoFilterTest, BatchMultipleTables) {
 )EOF";
   buffer->add(buffer_content);
 
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(*buffer, false));
-  EXPECT_CALL(decoder_callbacks_, decodingBuffer()).WillRepeatedly(Return(buffer.get()));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers));
 
   Http::TestHeaderMapImpl response_headers{{":status", "200"}};
@@ -225,8 +243,7 @@ TEST_F(DynamoFilterTest, BatchMultipleTablesUnprocessedKeys) {
 )EOF";
   buffer->add(buffer_content);
 
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(*buffer, false));
-  EXPECT_CALL(decoder_callbacks_, decodingBuffer()).WillRepeatedly(Return(buffer.get()));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers));
 
   Http::TestHeaderMapImpl response_headers{{":status", "200"}};
@@ -245,7 +262,6 @@ TEST_F(DynamoFilterTest, BatchMultipleTablesUnprocessedKeys) {
 
   EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->encodeHeaders(response_headers, false));
 
-  Buffer::OwnedImpl empty_data;
   Buffer::InstancePtr response_data(new Buffer::OwnedImpl());
   std::string response_content = R"EOF(
 {
@@ -259,8 +275,7 @@ TEST_F(DynamoFilterTest, BatchMultipleTablesUnprocessedKeys) {
 
   EXPECT_CALL(stats_, counter("prefix.dynamodb.error.table_1.BatchFailureUnprocessedKeys"));
   EXPECT_CALL(stats_, counter("prefix.dynamodb.error.table_2.BatchFailureUnprocessedKeys"));
-  EXPECT_CALL(encoder_callbacks_, encodingBuffer()).WillRepeatedly(Return(response_data.get()));
-  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(empty_data, true));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(*response_data, true));
 }
 
 TEST_F(DynamoFilterTest, BatchMultipleTablesNoUnprocessedKeys) {
@@ -281,8 +296,7 @@ TEST_F(DynamoFilterTest, BatchMultipleTablesNoUnprocessedKeys) {
 )EOF";
   buffer->add(buffer_content);
 
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(*buffer, false));
-  EXPECT_CALL(decoder_callbacks_, decodingBuffer()).WillRepeatedly(Return(buffer.get()));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers));
 
   Http::TestHeaderMapImpl response_headers{{":status", "200"}};
@@ -301,7 +315,6 @@ TEST_F(DynamoFilterTest, BatchMultipleTablesNoUnprocessedKeys) {
 
   EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->encodeHeaders(response_headers, false));
 
-  Buffer::OwnedImpl empty_data;
   Buffer::InstancePtr response_data(new Buffer::OwnedImpl());
   std::string response_content = R"EOF(
 {
@@ -311,8 +324,7 @@ TEST_F(DynamoFilterTest, BatchMultipleTablesNoUnprocessedKeys) {
 )EOF";
   response_data->add(response_content);
 
-  EXPECT_CALL(encoder_callbacks_, encodingBuffer()).WillOnce(Return(response_data.get()));
-  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(empty_data, true));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(*response_data, true));
 }
 
 TEST_F(DynamoFilterTest, BatchMultipleTablesInvalidResponseBody) {
@@ -333,8 +345,7 @@ TEST_F(DynamoFilterTest, BatchMultipleTablesInvalidResponseBody) {
 )EOF";
   buffer->add(buffer_content);
 
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(*buffer, false));
-  EXPECT_CALL(decoder_callbacks_, decodingBuffer()).WillRepeatedly(Return(buffer.get()));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers));
 
   Http::TestHeaderMapImpl response_headers{{":status", "200"}};
@@ -353,7 +364,6 @@ TEST_F(DynamoFilterTest, BatchMultipleTablesInvalidResponseBody) {
 
   EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->encodeHeaders(response_headers, false));
 
-  Buffer::OwnedImpl empty_data;
   Buffer::InstancePtr response_data(new Buffer::OwnedImpl());
   std::string response_content = R"EOF(
 {
@@ -367,8 +377,7 @@ TEST_F(DynamoFilterTest, BatchMultipleTablesInvalidResponseBody) {
   response_data->add("}", 1);
 
   EXPECT_CALL(stats_, counter("prefix.dynamodb.invalid_resp_body"));
-  EXPECT_CALL(encoder_callbacks_, encodingBuffer()).WillOnce(Return(response_data.get()));
-  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(empty_data, true));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(*response_data, true));
 }
 
 TEST_F(DynamoFilterTest, bothOperationAndTableCorrect) {
@@ -378,12 +387,11 @@ TEST_F(DynamoFilterTest, bothOperationAndTableCorrect) {
   Buffer::InstancePtr buffer(new Buffer::OwnedImpl());
   std::string buffer_content = "{\"TableName\":\"locations\"";
   buffer->add(buffer_content);
-  EXPECT_CALL(decoder_callbacks_, decodingBuffer()).WillRepeatedly(Return(buffer.get()));
   Buffer::OwnedImpl data;
   data.add("}", 1);
 
   EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(data, false));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(data, true));
 
   EXPECT_CALL(stats_, counter("prefix.dynamodb.operation.GetItem.upstream_rq_total_2xx"));
@@ -433,12 +441,11 @@ TEST_F(DynamoFilterTest, PartitionIdStats) {
   Buffer::InstancePtr buffer(new Buffer::OwnedImpl());
   std::string buffer_content = "{\"TableName\":\"locations\"";
   buffer->add(buffer_content);
-  ON_CALL(decoder_callbacks_, decodingBuffer()).WillByDefault(Return(buffer.get()));
   Buffer::OwnedImpl data;
   data.add("}", 1);
 
   EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(data, false));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(data, true));
 
   EXPECT_CALL(stats_, counter("prefix.dynamodb.operation.GetItem.upstream_rq_total_2xx"));
@@ -472,7 +479,6 @@ TEST_F(DynamoFilterTest, PartitionIdStats) {
   Http::TestHeaderMapImpl response_headers{{":status", "200"}};
   EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->encodeHeaders(response_headers, false));
 
-  Buffer::OwnedImpl empty_data;
   Buffer::InstancePtr response_data(new Buffer::OwnedImpl());
   std::string response_content = R"EOF(
     {
@@ -487,8 +493,7 @@ TEST_F(DynamoFilterTest, PartitionIdStats) {
 
   response_data->add(response_content);
 
-  EXPECT_CALL(encoder_callbacks_, encodingBuffer()).WillOnce(Return(response_data.get()));
-  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(empty_data, true));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(*response_data, true));
 }
 
 TEST_F(DynamoFilterTest, NoPartitionIdStatsForMultipleTables) {
@@ -505,10 +510,9 @@ TEST_F(DynamoFilterTest, NoPartitionIdStatsForMultipleTables) {
 }
 )EOF";
   buffer->add(buffer_content);
-  ON_CALL(decoder_callbacks_, decodingBuffer()).WillByDefault(Return(buffer.get()));
 
   EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(*buffer, false));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers));
 
   EXPECT_CALL(stats_, counter("prefix.dynamodb.multiple_tables"));
@@ -536,7 +540,6 @@ TEST_F(DynamoFilterTest, NoPartitionIdStatsForMultipleTables) {
   Http::TestHeaderMapImpl response_headers{{":status", "200"}};
   EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->encodeHeaders(response_headers, false));
 
-  Buffer::OwnedImpl empty_data;
   Buffer::InstancePtr response_data(new Buffer::OwnedImpl());
   std::string response_content = R"EOF(
     {
@@ -551,8 +554,7 @@ TEST_F(DynamoFilterTest, NoPartitionIdStatsForMultipleTables) {
 
   response_data->add(response_content);
 
-  EXPECT_CALL(encoder_callbacks_, encodingBuffer()).WillOnce(Return(response_data.get()));
-  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(empty_data, true));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(*response_data, true));
 }
 
 TEST_F(DynamoFilterTest, PartitionIdStatsForSingleTableBatchOperation) {
@@ -568,10 +570,9 @@ TEST_F(DynamoFilterTest, PartitionIdStatsForSingleTableBatchOperation) {
 }
 )EOF";
   buffer->add(buffer_content);
-  ON_CALL(decoder_callbacks_, decodingBuffer()).WillByDefault(Return(buffer.get()));
 
   EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(*buffer, false));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers));
 
   EXPECT_CALL(stats_, counter("prefix.dynamodb.multiple_tables")).Times(0);
@@ -609,7 +610,6 @@ TEST_F(DynamoFilterTest, PartitionIdStatsForSingleTableBatchOperation) {
   Http::TestHeaderMapImpl response_headers{{":status", "200"}};
   EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->encodeHeaders(response_headers, false));
 
-  Buffer::OwnedImpl empty_data;
   Buffer::InstancePtr response_data(new Buffer::OwnedImpl());
   std::string response_content = R"EOF(
     {
@@ -624,8 +624,55 @@ TEST_F(DynamoFilterTest, PartitionIdStatsForSingleTableBatchOperation) {
 
   response_data->add(response_content);
 
-  EXPECT_CALL(encoder_callbacks_, encodingBuffer()).WillOnce(Return(response_data.get()));
-  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(empty_data, true));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(*response_data, true));
+}
+
+// The stats of a table and an operation are looked up once per worker and then charged by every
+// later request for them.
+TEST_F(DynamoFilterTest, StatsCachedAcrossRequests) {
+  Http::TestHeaderMapImpl request_headers{{"x-amz-target", "version.GetItem"}};
+  Http::TestHeaderMapImpl response_headers{{":status", "200"}};
+  const std::string request_body = "{\"TableName\":\"locations\"}";
+
+  for (const std::string name : {"operation.GetItem", "table.locations"}) {
+    for (const std::string stat : {"upstream_rq_total", "upstream_rq_total_2xx",
+                                   "upstream_rq_total_200"}) {
+      EXPECT_CALL(stats_, counter("prefix.dynamodb." + name + "." + stat));
+    }
+    for (const std::string stat : {"upstream_rq_time", "upstream_rq_time_2xx",
+                                   "upstream_rq_time_200"}) {
+      EXPECT_CALL(stats_, deliverTimingToSinks("prefix.dynamodb." + name + "." + stat, _))
+          .Times(2);
+    }
+  }
+  EXPECT_CALL(stats_.counter_, inc()).Times(12);
+
+  for (int i = 0; i < 2; i++) {
+    setup(true);
+    EXPECT_EQ(Http::FilterHeadersStatus::Continue,
+              filter_->decodeHeaders(request_headers, false));
+    Buffer::OwnedImpl data(request_body);
+    EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(data, true));
+    EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->encodeHeaders(response_headers, true));
+  }
+}
+
+// The cache forgets the stats that it holds once it reaches its size limit.
+TEST(DynamoStatsCacheTest, MaxEntities) {
+  Stats::MockStore stats;
+  DynamoStatsCache cache("prefix.", stats, 2);
+
+  EXPECT_CALL(stats, counter("prefix.dynamodb.table.a.upstream_rq_total")).Times(2);
+  EXPECT_CALL(stats, counter("prefix.dynamodb.table.b.upstream_rq_total"));
+  EXPECT_CALL(stats, counter("prefix.dynamodb.table.c.upstream_rq_total"));
+  EXPECT_CALL(stats, counter("prefix.dynamodb.operation.a.upstream_rq_total"));
+  cache.table("a");
+  cache.table("b");
+  cache.table("a");
+  cache.operation("a");
+  cache.table("c");
+  cache.table("a");
+  EXPECT_EQ("prefix.dynamodb.table.a.upstream_rq_time", cache.table("a").upstream_rq_time_);
 }
 
 } // namespace Dynamo
@@ -3,7 +3,6 @@
 
 #include "common/dynamo/dynamo_request_parser.h"
 #include "common/http/header_map_impl.h"
-#include "common/json/json_loader.h"
 
 #include "test/test_common/printers.h"
 #include "test/test_common/utility.h"
@@ -13,6 +12,13 @@
 namespace Envoy {
 namespace Dynamo {
 
+BodyParser parseBody(const std::string& json) {
+  BodyParser body;
+  body.parse(json.data(), json.size());
+  EXPECT_TRUE(body.finish());
+  return body;
+}
+
 TEST(DynamoRequestParser, parseOperation) {
   // Well formed x-amz-target header, in a format, Version.Operation
   {
@@ -53,40 +59,39 @@ TEST(DynamoRequestParser, parseTableNameSingleOperation) {
       }
     }
     )EOF";
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString(json_string);
+    BodyParser json_data = parseBody(json_string);
 
     // Supported operation
     for (const std::string& operation : supported_single_operations) {
-      EXPECT_EQ("Pets", RequestParser::parseTable(operation, *json_data).table_name);
+      EXPECT_EQ("Pets", RequestParser::parseTable(operation, json_data).table_name);
     }
 
     // Not supported operation
-    EXPECT_EQ("", RequestParser::parseTable("NotSupportedOperation", *json_data).table_name);
+    EXPECT_EQ("", RequestParser::parseTable("NotSupportedOperation", json_data).table_name);
   }
 
   {
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString("{\"TableName\":\"Pets\"}");
-    EXPECT_EQ("Pets", RequestParser::parseTable("GetItem", *json_data).table_name);
+    BodyParser json_data = parseBody("{\"TableName\":\"Pets\"}");
+    EXPECT_EQ("Pets", RequestParser::parseTable("GetItem", json_data).table_name);
   }
 }
 
 TEST(DynamoRequestParser, parseErrorType) {
   {
     EXPECT_EQ("ResourceNotFoundException",
-              RequestParser::parseErrorType(*Json::Factory::loadFromString(
+              RequestParser::parseErrorType(parseBody(
                   "{\"__type\":\"com.amazonaws.dynamodb.v20120810#ResourceNotFoundException\"}")));
   }
 
   {
     EXPECT_EQ("ResourceNotFoundException",
-              RequestParser::parseErrorType(*Json::Factory::loadFromString(
+              RequestParser::parseErrorType(parseBody(
                   "{\"__type\":\"com.amazonaws.dynamodb.v20120810#ResourceNotFoundException\","
                   "\"message\":\"Requested resource not found: Table: tablename not found\"}")));
   }
 
   {
-    EXPECT_EQ("", RequestParser::parseErrorType(
-                      *Json::Factory::loadFromString("{\"__type\":\"UnKnownError\"}")));
+    EXPECT_EQ("", RequestParser::parseErrorType(parseBody("{\"__type\":\"UnKnownError\"}")));
   }
 }
 
@@ -100,9 +105,9 @@ TEST(DynamoRequestParser, parseTableNameBatchOperation) {
       }
     }
     )EOF";
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString(json_string);
+    BodyParser json_data = parseBody(json_string);
 
-    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchGetItem", *json_data);
+    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchGetItem", json_data);
     EXPECT_EQ("", table.table_name);
     EXPECT_FALSE(table.is_single_table);
   }
@@ -116,9 +121,9 @@ TEST(DynamoRequestParser, parseTableNameBatchOperation) {
       }
     }
     )EOF";
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString(json_string);
+    BodyParser json_data = parseBody(json_string);
 
-    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchGetItem", *json_data);
+    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchGetItem", json_data);
     EXPECT_EQ("table_2", table.table_name);
     EXPECT_TRUE(table.is_single_table);
   }
@@ -133,9 +138,9 @@ TEST(DynamoRequestParser, parseTableNameBatchOperation) {
       }
     }
     )EOF";
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString(json_string);
+    BodyParser json_data = parseBody(json_string);
 
-    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchGetItem", *json_data);
+    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchGetItem", json_data);
     EXPECT_EQ("", table.table_name);
     EXPECT_FALSE(table.is_single_table);
   }
@@ -149,51 +154,51 @@ TEST(DynamoRequestParser, parseTableNameBatchOperation) {
       }
     }
     )EOF";
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString(json_string);
+    BodyParser json_data = parseBody(json_string);
 
-    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchWriteItem", *json_data);
+    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchWriteItem", json_data);
     EXPECT_EQ("table_2", table.table_name);
     EXPECT_TRUE(table.is_single_table);
   }
 
   {
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString("{}");
+    BodyParser json_data = parseBody("{}");
     RequestParser::TableDescriptor table =
-        RequestParser::parseTable("BatchWriteItem", *Json::Factory::loadFromString("{}"));
+        RequestParser::parseTable("BatchWriteItem", parseBody("{}"));
     EXPECT_EQ("", table.table_name);
     EXPECT_TRUE(table.is_single_table);
   }
 
   {
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString("{\"RequestItems\":{}}");
-    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchWriteItem", *json_data);
+    BodyParser json_data = parseBody("{\"RequestItems\":{}}");
+    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchWriteItem", json_data);
     EXPECT_EQ("", table.table_name);
     EXPECT_TRUE(table.is_single_table);
   }
 
   {
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString("{}");
-    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchGetItem", *json_data);
+    BodyParser json_data = parseBody("{}");
+    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchGetItem", json_data);
     EXPECT_EQ("", table.table_name);
     EXPECT_TRUE(table.is_single_table);
   }
 }
 TEST(DynamoRequestParser, parseBatchUnProcessedKeys) {
   {
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString("{}");
+    BodyParser json_data = parseBody("{}");
     std::vector<std::string> unprocessed_tables =
-        RequestParser::parseBatchUnProcessedKeys(*json_data);
+        RequestParser::parseBatchUnProcessedKeys(json_data);
     EXPECT_EQ(0u, unprocessed_tables.size());
   }
   {
     std::vector<std::string> unprocessed_tables = RequestParser::parseBatchUnProcessedKeys(
-        *Json::Factory::loadFromString("{\"UnprocessedKeys\":{}}"));
+        parseBody("{\"UnprocessedKeys\":{}}"));
     EXPECT_EQ(0u, unprocessed_tables.size());
   }
 
   {
     std::vector<std::string> unprocessed_tables = RequestParser::parseBatchUnProcessedKeys(
-        *Json::Factory::loadFromString("{\"UnprocessedKeys\":{\"table_1\" :{}}}"));
+        parseBody("{\"UnprocessedKeys\":{\"table_1\" :{}}}"));
     EXPECT_EQ("table_1", unprocessed_tables[0]);
     EXPECT_EQ(1u, unprocessed_tables.size());
   }
@@ -207,10 +212,10 @@ TEST(DynamoRequestParser, parseBatchUnProcessedKeys) {
       }
     }
     )EOF";
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString(json_string);
+    BodyParser json_data = parseBody(json_string);
 
     std::vector<std::string> unprocessed_tables =
-        RequestParser::parseBatchUnProcessedKeys(*json_data);
+        RequestParser::parseBatchUnProcessedKeys(json_data);
     EXPECT_TRUE(find(unprocessed_tables.begin(), unprocessed_tables.end(), "table_1") !=
                 unprocessed_tables.end());
     EXPECT_TRUE(find(unprocessed_tables.begin(), unprocessed_tables.end(), "table_2") !=
@@ -222,17 +227,17 @@ TEST(DynamoRequestParser, parseBatchUnProcessedKeys) {
 TEST(DynamoRequestParser, parsePartitionIds) {
   {
     std::vector<RequestParser::PartitionDescriptor> partitions =
-        RequestParser::parsePartitions(*Json::Factory::loadFromString("{}"));
+        RequestParser::parsePartitions(parseBody("{}"));
     EXPECT_EQ(0u, partitions.size());
   }
   {
     std::vector<RequestParser::PartitionDescriptor> partitions =
-        RequestParser::parsePartitions(*Json::Factory::loadFromString("{\"ConsumedCapacity\":{}}"));
+        RequestParser::parsePartitions(parseBody("{\"ConsumedCapacity\":{}}"));
     EXPECT_EQ(0u, partitions.size());
   }
   {
     std::vector<RequestParser::PartitionDescriptor> partitions = RequestParser::parsePartitions(
-        *Json::Factory::loadFromString("{\"ConsumedCapacity\":{ \"Partitions\":{}}}"));
+        parseBody("{\"ConsumedCapacity\":{ \"Partitions\":{}}}"));
     EXPECT_EQ(0u, partitions.size());
   }
   {
@@ -246,10 +251,10 @@ TEST(DynamoRequestParser, parsePartitionIds) {
       }
     }
     )EOF";
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString(json_string);
+    BodyParser json_data = parseBody(json_string);
 
     std::vector<RequestParser::PartitionDescriptor> partitions =
-        RequestParser::parsePartitions(*json_data);
+        RequestParser::parsePartitions(json_data);
     for (const RequestParser::PartitionDescriptor& partition : partitions) {
       if (partition.partition_id_ == "partition_1") {
         EXPECT_EQ(1u, partition.capacity_);
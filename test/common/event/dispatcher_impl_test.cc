@@ -1,8 +1,16 @@
 #include <functional>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
 
+#include "common/buffer/watermark_buffer.h"
+#include "common/common/thread.h"
 #include "common/event/dispatcher_impl.h"
+#include "common/stats/stats_impl.h"
 
 #include "test/mocks/common.h"
+#include "test/test_common/utility.h"
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -51,5 +59,109 @@ TEST(DispatcherImplTest, DeferredDelete) {
   dispatcher.clearDeferredDeleteList();
 }
 
+TEST(DispatcherImplTest, Post) {
+  DispatcherImpl dispatcher;
+  Stats::IsolatedStoreImpl store;
+  dispatcher.initializeStats(store, "dispatcher.");
+
+  // Callbacks run in order, including the ones posted from a callback.
+  std::vector<int> order;
+  dispatcher.post([&]() -> void {
+    order.push_back(1);
+    dispatcher.post([&]() -> void { order.push_back(3); });
+  });
+  dispatcher.post([&]() -> void { order.push_back(2); });
+  dispatcher.run(Dispatcher::RunType::NonBlock);
+
+  EXPECT_EQ((std::vector<int>{1, 2, 3}), order);
+  EXPECT_EQ(3UL, store.counter("dispatcher.post_callbacks").value());
+  EXPECT_EQ(0UL, store.gauge("dispatcher.post_queue_size").value());
+}
+
+TEST(DispatcherImplTest, PostFromThreads) {
+  DispatcherImpl dispatcher;
+  const uint32_t num_threads = 4;
+  const uint32_t num_posts = 10000;
+  std::vector<uint32_t> next(num_threads);
+  uint32_t total = 0;
+  bool in_order = true;
+
+  std::vector<std::unique_ptr<Thread::Thread>> threads;
+  for (uint32_t i = 0; i < num_threads; i++) {
+    threads.emplace_back(new Thread::Thread([&, i]() -> void {
+      for (uint32_t j = 0; j < num_posts; j++) {
+        dispatcher.post([&, i, j]() -> void {
+          // The callbacks of each thread run in the order they were posted in.
+          in_order = in_order && next[i]++ == j;
+          if (++total == num_threads * num_posts) {
+            dispatcher.exit();
+          }
+        });
+      }
+    }));
+  }
+
+  dispatcher.run(Dispatcher::RunType::Block);
+  for (std::unique_ptr<Thread::Thread>& thread : threads) {
+    thread->join();
+  }
+  EXPECT_TRUE(in_order);
+  EXPECT_EQ(num_threads * num_posts, total);
+}
+
+TEST(DispatcherImplTest, SlowCallbacks) {
+  DispatcherImpl dispatcher;
+  Stats::IsolatedStoreImpl store;
+  dispatcher.initializeStats(store, "dispatcher.");
+  dispatcher.setSlowCallbackThreshold(std::chrono::milliseconds(5));
+
+  // A slow timer, a slow post and a slow deferred delete. The fast post is not reported.
+  auto sleep = []() -> void { std::this_thread::sleep_for(std::chrono::milliseconds(10)); };
+  TimerPtr timer = dispatcher.createTimer(sleep);
+  timer->enableTimer(std::chrono::milliseconds(0));
+  dispatcher.post(sleep);
+  dispatcher.post([]() -> void {});
+  dispatcher.deferredDelete(DeferredDeletablePtr{new TestDeferredDeletable(sleep)});
+  dispatcher.run(Dispatcher::RunType::NonBlock);
+  EXPECT_EQ(3UL, store.counter("dispatcher.slow_callbacks").value());
+  EXPECT_EQ(2UL, store.counter("dispatcher.post_callbacks").value());
+
+  // A zero threshold disables the reporting.
+  dispatcher.setSlowCallbackThreshold(std::chrono::milliseconds(0));
+  timer->enableTimer(std::chrono::milliseconds(0));
+  dispatcher.run(Dispatcher::RunType::NonBlock);
+  EXPECT_EQ(3UL, store.counter("dispatcher.slow_callbacks").value());
+}
+
+TEST(DispatcherImplTest, DestroyWithPendingPosts) {
+  bool ran = false;
+  {
+    DispatcherImpl dispatcher;
+    dispatcher.post([&]() -> void { ran = true; });
+  }
+  EXPECT_FALSE(ran);
+}
+
+TEST(DispatcherImplTest, EventBackends) {
+  for (const std::string backend : {"poll", "select", "epoll", "epoll_changelist"}) {
+    if (!Libevent::Global::backendSupported(backend)) {
+      continue;
+    }
+
+    DispatcherImpl dispatcher(Buffer::WatermarkFactoryPtr{new Buffer::WatermarkBufferFactory},
+                              DispatcherImpl::DEFAULT_CONNECTION_READ_BUDGET, backend);
+    bool ran = false;
+    dispatcher.post([&]() -> void { ran = true; });
+    dispatcher.run(Dispatcher::RunType::NonBlock);
+    EXPECT_TRUE(ran) << backend;
+  }
+
+  EXPECT_FALSE(Libevent::Global::backendSupported("io_uring"));
+  EXPECT_THROW_WITH_MESSAGE(
+      DispatcherImpl(Buffer::WatermarkFactoryPtr{new Buffer::WatermarkBufferFactory},
+                     DispatcherImpl::DEFAULT_CONNECTION_READ_BUDGET, "io_uring"),
+      EnvoyException, "event backend 'io_uring' is not supported");
+}
+
 } // namespace Event
 } // namespace Envoy
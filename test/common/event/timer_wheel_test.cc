@@ -0,0 +1,146 @@
+#include <chrono>
+#include <vector>
+
+#include "common/event/dispatcher_impl.h"
+#include "common/event/timer_wheel.h"
+
+#include "test/mocks/common.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::NiceMock;
+using testing::ReturnPointee;
+
+namespace Envoy {
+namespace Event {
+
+class TimerWheelTest : public testing::Test {
+public:
+  TimerWheelTest() {
+    ON_CALL(time_source_, currentTime()).WillByDefault(ReturnPointee(&now_));
+    wheel_.reset(new TimerWheel(dispatcher_, time_source_));
+  }
+
+  ~TimerWheelTest() {
+    timers_.clear();
+    wheel_.reset();
+  }
+
+  CoarseTimerImpl& addTimer(int id) {
+    timers_.emplace_back(
+        new CoarseTimerImpl(*wheel_, [this, id]() -> void { fired_.push_back(id); }));
+    return *timers_.back();
+  }
+
+  // Advance the time and run the ticks of the wheel as if the libevent tick timer fired.
+  void advance(std::chrono::milliseconds d) {
+    now_ += d;
+    wheel_->onTick();
+  }
+
+  DispatcherImpl dispatcher_;
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  MonotonicTime now_;
+  std::unique_ptr<TimerWheel> wheel_;
+  std::vector<std::unique_ptr<CoarseTimerImpl>> timers_;
+  std::vector<int> fired_;
+};
+
+TEST_F(TimerWheelTest, NeverEarly) {
+  addTimer(1).enableTimer(std::chrono::milliseconds(25));
+  addTimer(2).enableTimer(std::chrono::milliseconds(0));
+  EXPECT_EQ(2UL, wheel_->size());
+
+  advance(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::vector<int>{2}, fired_);
+  advance(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::vector<int>{2}, fired_);
+  advance(std::chrono::milliseconds(10));
+  EXPECT_EQ((std::vector<int>{2, 1}), fired_);
+  EXPECT_EQ(0UL, wheel_->size());
+}
+
+TEST_F(TimerWheelTest, ResetAndDisable) {
+  CoarseTimerImpl& timer1 = addTimer(1);
+  CoarseTimerImpl& timer2 = addTimer(2);
+  timer1.enableTimer(std::chrono::milliseconds(20));
+  timer2.enableTimer(std::chrono::milliseconds(20));
+
+  // Resetting a timer moves it to a later slot.
+  advance(std::chrono::milliseconds(10));
+  timer1.enableTimer(std::chrono::milliseconds(50));
+  timer2.disableTimer();
+  timer2.disableTimer();
+  EXPECT_EQ(1UL, wheel_->size());
+
+  advance(std::chrono::milliseconds(40));
+  EXPECT_TRUE(fired_.empty());
+  advance(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::vector<int>{1}, fired_);
+}
+
+TEST_F(TimerWheelTest, LongerThanRevolution) {
+  const std::chrono::milliseconds revolution = TimerWheel::TICK_DURATION * TimerWheel::NUM_SLOTS;
+  addTimer(1).enableTimer(revolution + std::chrono::milliseconds(20));
+
+  // The slot of the timer comes up before the timer is due.
+  advance(std::chrono::milliseconds(20));
+  advance(revolution - std::chrono::milliseconds(10));
+  EXPECT_TRUE(fired_.empty());
+  advance(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::vector<int>{1}, fired_);
+}
+
+TEST_F(TimerWheelTest, StalledLoop) {
+  addTimer(1).enableTimer(std::chrono::milliseconds(30));
+  addTimer(2).enableTimer(std::chrono::seconds(10));
+
+  // All timers that expired while the loop was stalled fire on the next tick.
+  advance(std::chrono::seconds(100));
+  EXPECT_EQ((std::vector<int>{1, 2}), fired_);
+}
+
+TEST_F(TimerWheelTest, CallbacksModifyTimers) {
+  CoarseTimerImpl& timer1 = addTimer(1);
+  CoarseTimerImpl& timer3 = addTimer(3);
+  timers_.emplace_back(new CoarseTimerImpl(*wheel_, [&]() -> void {
+    fired_.push_back(2);
+    // Disable a timer that expired in the same tick, and re-enable itself.
+    timer3.disableTimer();
+    timers_[2]->enableTimer(std::chrono::milliseconds(0));
+  }));
+  CoarseTimerImpl& timer2 = *timers_.back();
+
+  timer1.enableTimer(std::chrono::milliseconds(10));
+  timer2.enableTimer(std::chrono::milliseconds(10));
+  timer3.enableTimer(std::chrono::milliseconds(10));
+  advance(std::chrono::milliseconds(10));
+  EXPECT_EQ(2U, fired_.size());
+  EXPECT_EQ(1UL, wheel_->size());
+
+  // A timer that re-enables itself with no delay fires at the next tick.
+  advance(std::chrono::milliseconds(10));
+  EXPECT_EQ(3U, fired_.size());
+  timer2.disableTimer();
+}
+
+TEST(CoarseTimerTest, Dispatcher) {
+  DispatcherImpl dispatcher;
+  bool fired = false;
+  const MonotonicTime start = std::chrono::steady_clock::now();
+  TimerPtr timer = dispatcher.createTimer(
+      [&]() -> void {
+        fired = true;
+        dispatcher.exit();
+      },
+      TimerPrecision::Coarse);
+  timer->enableTimer(std::chrono::milliseconds(15));
+  dispatcher.run(Dispatcher::RunType::Block);
+
+  EXPECT_TRUE(fired);
+  EXPECT_LE(std::chrono::milliseconds(15), std::chrono::steady_clock::now() - start);
+}
+
+} // namespace Event
+} // namespace Envoy
@@ -1,5 +1,7 @@
 #include <chrono>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "common/common/thread.h"
 #include "common/event/dispatcher_impl.h"
@@ -10,6 +12,7 @@
 #include "test/mocks/filesystem/mocks.h"
 #include "test/test_common/environment.h"
 
+#include "fmt/format.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
@@ -58,6 +61,21 @@ TEST(FileSystemImpl, fileReadToEndDoesNotExist) {
                EnvoyException);
 }
 
+TEST(FileSystemImpl, mappedFile) {
+  const std::string data = "test string\ntest";
+  const std::string file_path = TestEnvironment::writeStringToFileForTest("test_envoy", data);
+  const Filesystem::MappedFile file(file_path);
+  EXPECT_EQ(data, std::string(file.data(), file.size()));
+
+  const Filesystem::MappedFile empty_file(
+      TestEnvironment::writeStringToFileForTest("test_envoy_empty", ""));
+  EXPECT_EQ(0U, empty_file.size());
+
+  unlink(TestEnvironment::temporaryPath("envoy_this_not_exist").c_str());
+  EXPECT_THROW(Filesystem::MappedFile(TestEnvironment::temporaryPath("envoy_this_not_exist")),
+               EnvoyException);
+}
+
 TEST(FileSystemImpl, flushToLogFilePeriodically) {
   NiceMock<Event::MockDispatcher> dispatcher;
   NiceMock<Event::MockTimer>* timer = new NiceMock<Event::MockTimer>(&dispatcher);
@@ -272,4 +290,77 @@ TEST(FilesystemImpl, bigDataChunkShouldBeFlushedWithoutTimer) {
     }
   }
 }
+
+TEST(FilesystemImpl, writesOverBufferLimitAreDropped) {
+  NiceMock<Event::MockDispatcher> dispatcher;
+  Thread::MutexBasicLockable mutex;
+  Stats::IsolatedStoreImpl stats_store;
+  NiceMock<Filesystem::MockOsSysCalls> os_sys_calls;
+
+  Filesystem::FileImpl file("", dispatcher, mutex, os_sys_calls, stats_store,
+                            std::chrono::milliseconds(40), 10);
+
+  EXPECT_CALL(os_sys_calls, write_(_, _, _))
+      .WillOnce(Invoke([](int, const void* buffer, size_t num_bytes) -> ssize_t {
+        EXPECT_EQ("a", std::string(reinterpret_cast<const char*>(buffer), num_bytes));
+        return num_bytes;
+      }));
+
+  file.write("0123456789a");
+  EXPECT_EQ(1UL, stats_store.counter("filesystem.write_dropped").value());
+  file.write("a");
+
+  {
+    std::unique_lock<Thread::BasicLockable> lock(os_sys_calls.write_mutex_);
+    while (os_sys_calls.num_writes_ != 1) {
+      os_sys_calls.write_event_.wait(os_sys_calls.write_mutex_);
+    }
+  }
+  EXPECT_EQ(1UL, stats_store.counter("filesystem.write_dropped").value());
+}
+
+TEST(FilesystemImpl, concurrentWriters) {
+  NiceMock<Event::MockDispatcher> dispatcher;
+  Thread::MutexBasicLockable mutex;
+  Stats::IsolatedStoreImpl stats_store;
+  NiceMock<Filesystem::MockOsSysCalls> os_sys_calls;
+
+  std::string written;
+  EXPECT_CALL(os_sys_calls, write_(_, _, _))
+      .WillRepeatedly(Invoke([&written](int, const void* buffer, size_t num_bytes) -> ssize_t {
+        written.append(reinterpret_cast<const char*>(buffer), num_bytes);
+        return num_bytes;
+      }));
+
+  const uint32_t num_threads = 8;
+  const uint32_t num_lines = 1000;
+  {
+    Filesystem::FileImpl file("", dispatcher, mutex, os_sys_calls, stats_store,
+                              std::chrono::milliseconds(40));
+    std::vector<Thread::ThreadPtr> threads;
+    for (uint32_t i = 0; i < num_threads; i++) {
+      threads.emplace_back(new Thread::Thread([&file, i]() -> void {
+        for (uint32_t j = 0; j < num_lines; j++) {
+          file.write(fmt::format("{} {}\n", i, j));
+        }
+      }));
+    }
+    for (Thread::ThreadPtr& thread : threads) {
+      thread->join();
+    }
+  }
+
+  // Every line is written once, and the lines of each thread are written in order.
+  std::vector<uint32_t> next_line(num_threads);
+  std::istringstream lines(written);
+  uint32_t thread;
+  uint32_t line;
+  while (lines >> thread >> line) {
+    ASSERT_LT(thread, num_threads);
+    EXPECT_EQ(next_line[thread]++, line);
+  }
+  for (uint32_t i = 0; i < num_threads; i++) {
+    EXPECT_EQ(num_lines, next_line[i]);
+  }
+}
 } // namespace Envoy
@@ -2,6 +2,7 @@
 #include <memory>
 #include <string>
 
+#include "common/common/hex.h"
 #include "common/filesystem/filesystem_impl.h"
 #include "common/filter/auth/client_ssl.h"
 #include "common/http/message_impl.h"
@@ -20,10 +21,12 @@
 #include "gtest/gtest.h"
 
 using testing::InSequence;
+using testing::DoAll;
 using testing::Invoke;
 using testing::Return;
 using testing::ReturnNew;
 using testing::ReturnRef;
+using testing::SetArgReferee;
 using testing::WithArg;
 using testing::_;
 
@@ -32,12 +35,85 @@ namespace Filter {
 namespace Auth {
 namespace ClientSsl {
 
+Ssl::Sha256Digest digestFromHex(const std::string& hex) {
+  const std::vector<uint8_t> bytes = Hex::decode(hex);
+  Ssl::Sha256Digest digest;
+  EXPECT_EQ(digest.size(), bytes.size());
+  std::copy(bytes.begin(), bytes.end(), digest.begin());
+  return digest;
+}
+
+Ssl::Sha256Digest digestFromIndex(uint32_t index) {
+  Ssl::Sha256Digest digest{};
+  for (size_t i = 0; i < digest.size(); i++) {
+    digest[i] = (index >> (8 * (i % 4))) & 0xff;
+  }
+  return digest;
+}
+
 TEST(ClientSslAuthAllowedPrincipalsTest, EmptyString) {
   AllowedPrincipals principals;
   principals.add("");
   EXPECT_EQ(0UL, principals.size());
 }
 
+TEST(ClientSslAuthAllowedPrincipalsTest, MalformedDigest) {
+  AllowedPrincipals principals;
+  principals.add("digest");
+  principals.add("1b7d42ef0025ad89c1c911d6c10d7e86a4cb7c5863b2980abcbad1895f8b531");
+  principals.add("1b7d42ef0025ad89c1c911d6c10d7e86a4cb7c5863b2980abcbad1895f8b5314a");
+  principals.add("1b7d42ef0025ad89c1c911d6c10d7e86a4cb7c5863b2980abcbad1895f8b531g");
+  EXPECT_EQ(0UL, principals.size());
+}
+
+TEST(ClientSslAuthAllowedPrincipalsTest, Lookup) {
+  AllowedPrincipals principals;
+  EXPECT_FALSE(principals.allowed(digestFromIndex(1)));
+
+  // Enough digests that the set grows several times.
+  for (uint32_t i = 1; i <= 1000; i++) {
+    const Ssl::Sha256Digest digest = digestFromIndex(i);
+    principals.add(Hex::encode(digest.data(), digest.size()));
+  }
+  EXPECT_EQ(1000UL, principals.size());
+  for (uint32_t i = 1; i <= 1000; i++) {
+    EXPECT_TRUE(principals.allowed(digestFromIndex(i)));
+  }
+  for (uint32_t i = 1001; i <= 2000; i++) {
+    EXPECT_FALSE(principals.allowed(digestFromIndex(i)));
+  }
+
+  // Upper case digits and duplicates are accepted, and the zero digest is a digest like any other.
+  principals.add("1B7D42EF0025AD89C1C911D6C10D7E86A4CB7C5863B2980ABCBAD1895F8B5314");
+  principals.add("1b7d42ef0025ad89c1c911d6c10d7e86a4cb7c5863b2980abcbad1895f8b5314");
+  EXPECT_EQ(1001UL, principals.size());
+  EXPECT_TRUE(principals.allowed(
+      digestFromHex("1b7d42ef0025ad89c1c911d6c10d7e86a4cb7c5863b2980abcbad1895f8b5314")));
+  EXPECT_FALSE(principals.allowed(digestFromIndex(0)));
+  principals.add(std::string(64, '0'));
+  EXPECT_EQ(1002UL, principals.size());
+  EXPECT_TRUE(principals.allowed(digestFromIndex(0)));
+}
+
+TEST(ClientSslAuthAllowedPrincipalsTest, Equality) {
+  const std::string digest1 = "1b7d42ef0025ad89c1c911d6c10d7e86a4cb7c5863b2980abcbad1895f8b5314";
+  const std::string digest2 = "4c5beecd0b516d9ab53029ae646c4628bc7a1980aaaaaaaaaaaaaaaaaaaaaaaa";
+  AllowedPrincipals principals1;
+  AllowedPrincipals principals2;
+  EXPECT_TRUE(principals1 == principals2);
+
+  principals1.add(digest1);
+  principals1.add(digest2);
+  principals2.add(digest2);
+  EXPECT_FALSE(principals1 == principals2);
+  EXPECT_FALSE(principals2 == principals1);
+  principals2.add(digest1);
+  EXPECT_TRUE(principals1 == principals2);
+
+  principals1.add(std::string(64, '0'));
+  EXPECT_FALSE(principals1 == principals2);
+}
+
 class ClientSslAuthFilterTest : public testing::Test {
 public:
   ClientSslAuthFilterTest()
@@ -151,7 +227,8 @@ TEST_F(ClientSslAuthFilterTest, Ssl) {
   ON_CALL(filter_callbacks_.connection_, ssl()).WillByDefault(Return(&ssl_));
   Network::Address::Ipv4Instance remote_address("192.168.1.1");
   EXPECT_CALL(filter_callbacks_.connection_, remoteAddress()).WillOnce(ReturnRef(remote_address));
-  EXPECT_CALL(ssl_, sha256PeerCertificateDigest()).WillOnce(Return("digest"));
+  EXPECT_CALL(ssl_, rawSha256PeerCertificateDigest(_))
+      .WillOnce(DoAll(SetArgReferee<0>(digestFromIndex(1)), Return(true)));
   EXPECT_CALL(filter_callbacks_.connection_, close(Network::ConnectionCloseType::NoFlush));
   EXPECT_EQ(Network::FilterStatus::StopIteration, instance_->onNewConnection());
   filter_callbacks_.connection_.raiseEvent(Network::ConnectionEvent::Connected);
@@ -169,8 +246,10 @@ TEST_F(ClientSslAuthFilterTest, Ssl) {
   // Create a new filter for an SSL connection with an authorized cert.
   createAuthFilter();
   EXPECT_CALL(filter_callbacks_.connection_, remoteAddress()).WillOnce(ReturnRef(remote_address));
-  EXPECT_CALL(ssl_, sha256PeerCertificateDigest())
-      .WillOnce(Return("1b7d42ef0025ad89c1c911d6c10d7e86a4cb7c5863b2980abcbad1895f8b5314"));
+  EXPECT_CALL(ssl_, rawSha256PeerCertificateDigest(_))
+      .WillOnce(DoAll(SetArgReferee<0>(digestFromHex(
+                          "1b7d42ef0025ad89c1c911d6c10d7e86a4cb7c5863b2980abcbad1895f8b5314")),
+                      Return(true)));
   EXPECT_EQ(Network::FilterStatus::StopIteration, instance_->onNewConnection());
   EXPECT_CALL(filter_callbacks_, continueReading());
   filter_callbacks_.connection_.raiseEvent(Network::ConnectionEvent::Connected);
@@ -250,6 +329,58 @@ TEST_F(ClientSslAuthFilterTest, Ssl) {
   EXPECT_EQ(4U, stats_store_.counter("auth.clientssl.vpn.update_failure").value());
 }
 
+// Connections without a peer certificate are not authorized.
+TEST_F(ClientSslAuthFilterTest, NoPeerCertificate) {
+  setup();
+
+  ON_CALL(filter_callbacks_.connection_, ssl()).WillByDefault(Return(&ssl_));
+  Network::Address::Ipv4Instance remote_address("192.168.1.1");
+  EXPECT_CALL(filter_callbacks_.connection_, remoteAddress()).WillOnce(ReturnRef(remote_address));
+  EXPECT_CALL(ssl_, rawSha256PeerCertificateDigest(_)).WillOnce(Return(false));
+  EXPECT_CALL(filter_callbacks_.connection_, close(Network::ConnectionCloseType::NoFlush));
+  EXPECT_EQ(Network::FilterStatus::StopIteration, instance_->onNewConnection());
+  filter_callbacks_.connection_.raiseEvent(Network::ConnectionEvent::Connected);
+  EXPECT_EQ(1U, stats_store_.counter("auth.clientssl.vpn.auth_digest_no_match").value());
+}
+
+// A refresh that returns the same principals keeps the current set.
+TEST_F(ClientSslAuthFilterTest, UnchangedRefresh) {
+  setup();
+
+  auto respond = [this](const std::string& body) -> void {
+    EXPECT_CALL(*interval_timer_, enableTimer(_));
+    Http::MessagePtr message(new Http::ResponseMessageImpl(
+        Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}));
+    message->body().reset(new Buffer::OwnedImpl(body));
+    callbacks_->onSuccess(std::move(message));
+  };
+  const std::string response = Filesystem::fileReadToEnd(
+      TestEnvironment::runfilesPath("test/common/filter/auth/test_data/vpn_response_1.json"));
+
+  respond(response);
+  const AllowedPrincipals* principals = &config_->allowedPrincipals();
+  EXPECT_EQ(1UL, principals->size());
+
+  setupRequest();
+  interval_timer_->callback_();
+  respond(response);
+  EXPECT_EQ(principals, &config_->allowedPrincipals());
+
+  setupRequest();
+  interval_timer_->callback_();
+  respond(R"EOF(
+    {
+      "certificates": [
+        {"fingerprint_sha256": "4c5beecd0b516d9ab53029ae646c4628bc7a1980aaaaaaaaaaaaaaaaaaaaaaaa"}
+      ]
+    }
+    )EOF");
+  EXPECT_EQ(1UL, config_->allowedPrincipals().size());
+  EXPECT_FALSE(config_->allowedPrincipals().allowed(
+      digestFromHex("1b7d42ef0025ad89c1c911d6c10d7e86a4cb7c5863b2980abcbad1895f8b5314")));
+  EXPECT_EQ(3U, stats_store_.counter("auth.clientssl.vpn.update_success").value());
+}
+
 } // namespace ClientSsl
 } // namespace Auth
 } // namespace Filter
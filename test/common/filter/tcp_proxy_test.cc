@@ -12,14 +12,17 @@
 #include "test/mocks/buffer/mocks.h"
 #include "test/mocks/network/mocks.h"
 #include "test/mocks/runtime/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
 #include "test/mocks/upstream/host.h"
 #include "test/mocks/upstream/mocks.h"
 #include "test/test_common/printers.h"
 
+#include "fmt/format.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
 using testing::NiceMock;
+using testing::Ref;
 using testing::Return;
 using testing::ReturnRef;
 using testing::SaveArg;
@@ -37,8 +40,10 @@ TEST(TcpProxyConfigTest, NoRouteConfig) {
 
   Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
   NiceMock<Upstream::MockClusterManager> cluster_manager;
+  NiceMock<ThreadLocal::MockInstance> tls;
   EXPECT_THROW(TcpProxyConfig(*config, cluster_manager,
-                              cluster_manager.thread_local_cluster_.cluster_.info_->stats_store_),
+                              cluster_manager.thread_local_cluster_.cluster_.info_->stats_store_,
+                              tls),
                EnvoyException);
 }
 
@@ -58,9 +63,11 @@ TEST(TcpProxyConfigTest, NoCluster) {
 
   Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
   NiceMock<Upstream::MockClusterManager> cluster_manager;
+  NiceMock<ThreadLocal::MockInstance> tls;
   EXPECT_CALL(cluster_manager, get("fake_cluster")).WillOnce(Return(nullptr));
   EXPECT_THROW(TcpProxyConfig(*config, cluster_manager,
-                              cluster_manager.thread_local_cluster_.cluster_.info_->stats_store_),
+                              cluster_manager.thread_local_cluster_.cluster_.info_->stats_store_,
+                              tls),
                EnvoyException);
 }
 
@@ -80,8 +87,10 @@ TEST(TcpProxyConfigTest, BadTcpProxyConfig) {
 
   Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
   NiceMock<Upstream::MockClusterManager> cluster_manager;
+  NiceMock<ThreadLocal::MockInstance> tls;
   EXPECT_THROW(TcpProxyConfig(*json_config, cluster_manager,
-                              cluster_manager.thread_local_cluster_.cluster_.info_->stats_store_),
+                              cluster_manager.thread_local_cluster_.cluster_.info_->stats_store_,
+                              tls),
                Json::Exception);
 }
 
@@ -146,9 +155,10 @@ TEST(TcpProxyConfigTest, Routes) {
 
   Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json);
   NiceMock<Upstream::MockClusterManager> cm_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
 
   TcpProxyConfig config_obj(*json_config, cm_,
-                            cm_.thread_local_cluster_.cluster_.info_->stats_store_);
+                            cm_.thread_local_cluster_.cluster_.info_->stats_store_, tls_);
 
   {
     // hit route with destination_ip (10.10.10.10/32)
@@ -326,6 +336,106 @@ TEST(TcpProxyConfigTest, Routes) {
   }
 }
 
+// The indexes of the routes keep the first matching route winning over the later ones.
+TEST(TcpProxyConfigTest, RouteOrder) {
+  std::string json = R"EOF(
+    {
+      "stat_prefix": "name",
+      "route_config": {
+        "routes": [
+          {
+            "destination_ports": "8000-9000",
+            "source_ports": "1",
+            "cluster": "with_destination_ports_and_source_port"
+          },
+          {
+            "destination_ip_list": [
+              "10.0.0.0/8"
+            ],
+            "cluster": "with_destination_ip_list"
+          },
+          {
+            "destination_ip_list": [
+              "10.1.0.0/16"
+            ],
+            "destination_ports": "80,8080",
+            "cluster": "with_destination_ip_list_and_ports"
+          },
+          {
+            "destination_ports": "8080",
+            "cluster": "with_destination_port"
+          },
+          {
+            "cluster": "catch_all"
+          }
+        ]
+      }
+    }
+    )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json);
+  NiceMock<Upstream::MockClusterManager> cm_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+
+  TcpProxyConfig config_obj(*json_config, cm_,
+                            cm_.thread_local_cluster_.cluster_.info_->stats_store_, tls_);
+
+  const auto route = [&config_obj](const std::string& local_ip, uint32_t local_port,
+                                   uint32_t remote_port) -> std::string {
+    NiceMock<Network::MockConnection> connection;
+    Network::Address::Ipv4Instance local_address(local_ip, local_port);
+    EXPECT_CALL(connection, localAddress()).WillRepeatedly(ReturnRef(local_address));
+    Network::Address::Ipv4Instance remote_address("20.0.0.1", remote_port);
+    EXPECT_CALL(connection, remoteAddress()).WillRepeatedly(ReturnRef(remote_address));
+    return config_obj.getRouteFromEntries(connection);
+  };
+
+  EXPECT_EQ("with_destination_ports_and_source_port", route("10.1.1.1", 8080, 1));
+  EXPECT_EQ("with_destination_ip_list", route("10.1.1.1", 8080, 2));
+  EXPECT_EQ("with_destination_ip_list", route("10.1.1.1", 80, 1));
+  EXPECT_EQ("with_destination_port", route("11.0.0.1", 8080, 2));
+  EXPECT_EQ("with_destination_ports_and_source_port", route("11.0.0.1", 9000, 1));
+  EXPECT_EQ("catch_all", route("11.0.0.1", 9001, 1));
+  EXPECT_EQ("catch_all", route("11.0.0.1", 80, 2));
+}
+
+// Many routes that differ in their destinations.
+TEST(TcpProxyConfigTest, ManyRoutes) {
+  std::string routes;
+  for (uint32_t i = 0; i < 1000; i++) {
+    routes += fmt::format(
+        R"EOF({{"destination_ip_list": ["10.0.{}.{}/32"], "cluster": "ip_{}"}},)EOF", i / 256,
+        i % 256, i);
+    routes += fmt::format(R"EOF({{"destination_ports": "{}", "cluster": "port_{}"}},)EOF",
+                          10000 + i, i);
+  }
+  const std::string json =
+      fmt::format(R"EOF({{"stat_prefix": "name", "route_config": {{"routes": [{}{}]}}}})EOF",
+                  routes, R"EOF({"cluster": "catch_all"})EOF");
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json);
+  NiceMock<Upstream::MockClusterManager> cm_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+
+  TcpProxyConfig config_obj(*json_config, cm_,
+                            cm_.thread_local_cluster_.cluster_.info_->stats_store_, tls_);
+
+  const auto route = [&config_obj](const std::string& local_ip,
+                                   uint32_t local_port) -> std::string {
+    NiceMock<Network::MockConnection> connection;
+    Network::Address::Ipv4Instance local_address(local_ip, local_port);
+    EXPECT_CALL(connection, localAddress()).WillRepeatedly(ReturnRef(local_address));
+    return config_obj.getRouteFromEntries(connection);
+  };
+
+  EXPECT_EQ("ip_0", route("10.0.0.0", 10000));
+  EXPECT_EQ("port_0", route("10.0.0.1", 10000));
+  EXPECT_EQ("ip_999", route("10.0.3.231", 10999));
+  EXPECT_EQ("port_999", route("10.0.4.0", 10999));
+  EXPECT_EQ("catch_all", route("10.0.4.0", 11000));
+  EXPECT_EQ("catch_all", route("10.0.4.0", 9999));
+}
+
 TEST(TcpProxyConfigTest, EmptyRouteConfig) {
   std::string json = R"EOF(
     {
@@ -339,9 +449,10 @@ TEST(TcpProxyConfigTest, EmptyRouteConfig) {
 
   Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json);
   NiceMock<Upstream::MockClusterManager> cm_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
 
   TcpProxyConfig config_obj(*json_config, cm_,
-                            cm_.thread_local_cluster_.cluster_.info_->stats_store_);
+                            cm_.thread_local_cluster_.cluster_.info_->stats_store_, tls_);
 
   NiceMock<Network::MockConnection> connection;
   EXPECT_EQ(std::string(""), config_obj.getRouteFromEntries(connection));
@@ -366,7 +477,8 @@ public:
     Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
     config_.reset(
         new TcpProxyConfig(*config, cluster_manager_,
-                           cluster_manager_.thread_local_cluster_.cluster_.info_->stats_store_));
+                           cluster_manager_.thread_local_cluster_.cluster_.info_->stats_store_,
+                           tls_));
   }
 
   void setup(bool return_connection) {
@@ -402,6 +514,7 @@ public:
   TcpProxyConfigSharedPtr config_;
   NiceMock<Network::MockReadFilterCallbacks> filter_callbacks_;
   NiceMock<Upstream::MockClusterManager> cluster_manager_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
   NiceMock<Network::MockClientConnection>* upstream_connection_{};
   Network::ReadFilterSharedPtr upstream_read_filter_;
   NiceMock<Event::MockTimer>* connect_timer_{};
@@ -427,6 +540,161 @@ TEST_F(TcpProxyTest, UpstreamDisconnect) {
   upstream_connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
 }
 
+TEST_F(TcpProxyTest, NoSpliceByDefault) {
+  setup(true);
+
+  EXPECT_CALL(*upstream_connection_, spliceWith(_)).Times(0);
+  upstream_connection_->raiseEvent(Network::ConnectionEvent::Connected);
+  EXPECT_EQ(0U, config_->stats().downstream_cx_spliced_.value());
+}
+
+TEST_F(TcpProxyTest, Splice) {
+  std::string json = R"EOF(
+    {
+      "stat_prefix": "name",
+      "splice": true,
+      "route_config": {
+        "routes": [
+          {
+            "cluster": "fake_cluster"
+          }
+        ]
+      }
+    }
+    )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+  config_.reset(
+      new TcpProxyConfig(*config, cluster_manager_,
+                         cluster_manager_.thread_local_cluster_.cluster_.info_->stats_store_,
+                         tls_));
+  setup(true);
+
+  // Nothing is spliced before the upstream connection is established.
+  Buffer::OwnedImpl buffer("hello");
+  EXPECT_CALL(*upstream_connection_, write(BufferEqual(&buffer)));
+  filter_->onData(buffer);
+
+  EXPECT_CALL(*upstream_connection_, spliceWith(Ref(filter_callbacks_.connection_)))
+      .WillOnce(Return(true));
+  upstream_connection_->raiseEvent(Network::ConnectionEvent::Connected);
+  EXPECT_EQ(1U, config_->stats().downstream_cx_spliced_.value());
+}
+
+TEST_F(TcpProxyTest, SpliceUnsupported) {
+  std::string json = R"EOF(
+    {
+      "stat_prefix": "name",
+      "splice": true,
+      "route_config": {
+        "routes": [
+          {
+            "cluster": "fake_cluster"
+          }
+        ]
+      }
+    }
+    )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+  config_.reset(
+      new TcpProxyConfig(*config, cluster_manager_,
+                         cluster_manager_.thread_local_cluster_.cluster_.info_->stats_store_,
+                         tls_));
+  setup(true);
+
+  EXPECT_CALL(*upstream_connection_, spliceWith(_)).WillOnce(Return(false));
+  upstream_connection_->raiseEvent(Network::ConnectionEvent::Connected);
+  EXPECT_EQ(0U, config_->stats().downstream_cx_spliced_.value());
+
+  // The data still flows through the filter.
+  Buffer::OwnedImpl response("world");
+  EXPECT_CALL(filter_callbacks_.connection_, write(BufferEqual(&response)));
+  upstream_read_filter_->onData(response);
+}
+
+TEST_F(TcpProxyTest, UpstreamPool) {
+  std::string json = R"EOF(
+    {
+      "stat_prefix": "name",
+      "upstream_pool": {
+        "size": 1
+      },
+      "route_config": {
+        "routes": [
+          {
+            "cluster": "fake_cluster"
+          }
+        ]
+      }
+    }
+    )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+  config_.reset(
+      new TcpProxyConfig(*config, cluster_manager_,
+                         cluster_manager_.thread_local_cluster_.cluster_.info_->stats_store_,
+                         tls_));
+
+  // The first connection finds the pool empty, and connects on its own while the pool fills.
+  NiceMock<Network::MockClientConnection>* pooled_connection =
+      new NiceMock<Network::MockClientConnection>();
+  new NiceMock<Event::MockTimer>(&tls_.dispatcher_);
+  Upstream::MockHost::MockCreateConnectionData pooled_info;
+  pooled_info.connection_ = pooled_connection;
+  pooled_info.host_description_ = Upstream::makeTestHost(
+      cluster_manager_.thread_local_cluster_.cluster_.info_, "tcp://127.0.0.1:81");
+  EXPECT_CALL(*pooled_connection, readDisable(true));
+  EXPECT_CALL(*pooled_connection, connect());
+
+  connect_timer_ = new NiceMock<Event::MockTimer>(&filter_callbacks_.connection_.dispatcher_);
+  upstream_connection_ = new NiceMock<Network::MockClientConnection>();
+  Upstream::MockHost::MockCreateConnectionData conn_info;
+  conn_info.connection_ = upstream_connection_;
+  conn_info.host_description_ = Upstream::makeTestHost(
+      cluster_manager_.thread_local_cluster_.cluster_.info_, "tcp://127.0.0.1:80");
+  EXPECT_CALL(cluster_manager_, tcpConnForCluster_("fake_cluster", _))
+      .WillOnce(Return(pooled_info))
+      .WillOnce(Return(conn_info));
+  EXPECT_CALL(*upstream_connection_, connect());
+
+  filter_.reset(new TcpProxy(config_, cluster_manager_));
+  filter_->initializeReadFilterCallbacks(filter_callbacks_);
+  EXPECT_EQ(Network::FilterStatus::Continue, filter_->onNewConnection());
+  EXPECT_EQ(1U, config_->stats().downstream_cx_upstream_pool_miss_.value());
+  pooled_connection->raiseEvent(Network::ConnectionEvent::Connected);
+
+  // The next connection takes the established connection, and the pool replaces it.
+  NiceMock<Network::MockClientConnection>* replacement_connection =
+      new NiceMock<Network::MockClientConnection>();
+  new NiceMock<Event::MockTimer>(&tls_.dispatcher_);
+  Upstream::MockHost::MockCreateConnectionData replacement_info;
+  replacement_info.connection_ = replacement_connection;
+  replacement_info.host_description_ = pooled_info.host_description_;
+  EXPECT_CALL(cluster_manager_, tcpConnForCluster_("fake_cluster", _))
+      .WillOnce(Return(replacement_info));
+  EXPECT_CALL(*replacement_connection, connect());
+
+  NiceMock<Network::MockReadFilterCallbacks> pooled_filter_callbacks;
+  EXPECT_CALL(*pooled_connection, connect()).Times(0);
+  EXPECT_CALL(*pooled_connection, addReadFilter(_));
+  EXPECT_CALL(*pooled_connection, readDisable(false));
+  std::unique_ptr<TcpProxy> pooled_filter(new TcpProxy(config_, cluster_manager_));
+  pooled_filter->initializeReadFilterCallbacks(pooled_filter_callbacks);
+  EXPECT_EQ(Network::FilterStatus::Continue, pooled_filter->onNewConnection());
+  EXPECT_EQ(1U, config_->stats().downstream_cx_upstream_pool_hit_.value());
+  EXPECT_EQ(pooled_info.host_description_, pooled_filter_callbacks.upstreamHost());
+
+  Buffer::OwnedImpl buffer("hello");
+  EXPECT_CALL(*pooled_connection, write(BufferEqual(&buffer)));
+  pooled_filter->onData(buffer);
+
+  // The pool goes with the configuration.
+  pooled_filter.reset();
+  filter_.reset();
+  config_.reset();
+}
+
 TEST_F(TcpProxyTest, DownstreamDisconnectRemote) {
   setup(true);
 
@@ -506,8 +774,9 @@ TEST_F(TcpProxyTest, UpstreamConnectFailure) {
 }
 
 TEST_F(TcpProxyTest, UpstreamConnectionLimit) {
-  cluster_manager_.thread_local_cluster_.cluster_.info_->resource_manager_.reset(
-      new Upstream::ResourceManagerImpl(runtime_, "fake_key", 0, 0, 0, 0));
+  Upstream::MockClusterInfo& info = *cluster_manager_.thread_local_cluster_.cluster_.info_;
+  info.resource_manager_.reset(
+      new Upstream::ResourceManagerImpl(runtime_, "fake_key", 0, 0, 0, 0, info.stats_store_));
 
   // setup sets up expectation for tcpConnForCluster but this test is expected to NOT call that
   filter_.reset(new TcpProxy(config_, cluster_manager_));
@@ -541,7 +810,8 @@ public:
     Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
     config_.reset(
         new TcpProxyConfig(*config, cluster_manager_,
-                           cluster_manager_.thread_local_cluster_.cluster_.info_->stats_store_));
+                           cluster_manager_.thread_local_cluster_.cluster_.info_->stats_store_,
+                           tls_));
   }
 
   void setup() {
@@ -555,6 +825,7 @@ public:
   NiceMock<Network::MockConnection> connection_;
   NiceMock<Network::MockReadFilterCallbacks> filter_callbacks_;
   NiceMock<Upstream::MockClusterManager> cluster_manager_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
   std::unique_ptr<TcpProxy> filter_;
 };
 
@@ -0,0 +1,155 @@
+#include <chrono>
+#include <memory>
+
+#include "common/filter/tcp_proxy_upstream_pool.h"
+#include "common/upstream/resource_manager_impl.h"
+#include "common/upstream/upstream_impl.h"
+
+#include "test/common/upstream/utility.h"
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/network/mocks.h"
+#include "test/mocks/upstream/host.h"
+#include "test/mocks/upstream/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::NiceMock;
+using testing::Return;
+using testing::_;
+
+namespace Envoy {
+namespace Filter {
+
+class TcpProxyUpstreamPoolTest : public testing::Test {
+public:
+  struct Upstream {
+    NiceMock<Network::MockClientConnection>* connection_;
+    NiceMock<Event::MockTimer>* timer_;
+  };
+
+  TcpProxyUpstreamPoolTest()
+      : pool_(new TcpProxyUpstreamPool(cluster_manager_, "fake_cluster", dispatcher_,
+                                       {2, std::chrono::milliseconds(1000)})) {
+    setMaxConnections(1024);
+  }
+
+  void setMaxConnections(uint64_t max_connections) {
+    Envoy::Upstream::MockClusterInfo& info = *cluster_manager_.thread_local_cluster_.cluster_.info_;
+    info.resource_manager_.reset(new Envoy::Upstream::ResourceManagerImpl(
+        info.runtime_, "fake_key", max_connections, 1024, 1024, 1, info.stats_store_));
+  }
+
+  // Expect the pool to connect an upstream connection. The connection of the last call is the
+  // first one that the pool connects.
+  Upstream expectConnect() {
+    Upstream upstream{new NiceMock<Network::MockClientConnection>(),
+                      new NiceMock<Event::MockTimer>(&dispatcher_)};
+    Envoy::Upstream::MockHost::MockCreateConnectionData conn_info;
+    conn_info.connection_ = upstream.connection_;
+    conn_info.host_description_ = Envoy::Upstream::makeTestHost(
+        cluster_manager_.thread_local_cluster_.cluster_.info_, "tcp://127.0.0.1:80");
+    EXPECT_CALL(cluster_manager_, tcpConnForCluster_("fake_cluster", _))
+        .WillOnce(Return(conn_info))
+        .RetiresOnSaturation();
+    EXPECT_CALL(*upstream.connection_, readDisable(true));
+    EXPECT_CALL(*upstream.connection_, connect());
+    EXPECT_CALL(*upstream.timer_, enableTimer(std::chrono::milliseconds(1)));
+    return upstream;
+  }
+
+  uint64_t counter(const std::string& name) {
+    return cluster_manager_.thread_local_cluster_.cluster_.info_->stats_store_.counter(name)
+        .value();
+  }
+
+  NiceMock<Envoy::Upstream::MockClusterManager> cluster_manager_;
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  TcpProxyUpstreamPoolPtr pool_;
+};
+
+// The first take fills the pool, and takes replace the connections they take.
+TEST_F(TcpProxyUpstreamPoolTest, FillAndTake) {
+  Upstream second = expectConnect();
+  Upstream first = expectConnect();
+  EXPECT_EQ(nullptr, pool_->take().connection_);
+  EXPECT_EQ(2U, counter("upstream_cx_total"));
+
+  // A connection that is still connecting is not taken.
+  EXPECT_CALL(*first.timer_, enableTimer(std::chrono::milliseconds(1000)));
+  first.connection_->raiseEvent(Network::ConnectionEvent::Connected);
+
+  Upstream third = expectConnect();
+  EXPECT_CALL(*first.timer_, disableTimer());
+  EXPECT_CALL(*first.connection_, removeConnectionCallbacks(_));
+  Envoy::Upstream::Host::CreateConnectionData conn_info = pool_->take();
+  EXPECT_EQ(first.connection_, conn_info.connection_.get());
+  EXPECT_NE(nullptr, conn_info.host_description_);
+  EXPECT_EQ(3U, counter("upstream_cx_total"));
+
+  // The taken connection is the caller's now.
+  EXPECT_TRUE(first.connection_->callbacks_.empty());
+  EXPECT_EQ(nullptr, pool_->take().connection_);
+  EXPECT_EQ(0U, counter("upstream_cx_destroy"));
+
+  EXPECT_CALL(*second.connection_, close(Network::ConnectionCloseType::NoFlush));
+  EXPECT_CALL(*third.connection_, close(Network::ConnectionCloseType::NoFlush));
+  pool_.reset();
+  EXPECT_EQ(2U, counter("upstream_cx_destroy"));
+}
+
+// A connection that fails is not replaced until the next take.
+TEST_F(TcpProxyUpstreamPoolTest, ConnectFailure) {
+  Upstream second = expectConnect();
+  Upstream first = expectConnect();
+  pool_->take();
+
+  EXPECT_CALL(cluster_manager_, tcpConnForCluster_(_, _)).Times(0);
+  EXPECT_CALL(dispatcher_, deferredDelete_(_));
+  first.connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_EQ(1U, counter("upstream_cx_connect_fail"));
+  EXPECT_EQ(1U, counter("upstream_cx_destroy"));
+  testing::Mock::VerifyAndClearExpectations(&cluster_manager_);
+
+  Upstream third = expectConnect();
+  EXPECT_EQ(nullptr, pool_->take().connection_);
+  EXPECT_EQ(3U, counter("upstream_cx_total"));
+}
+
+// A connection that doesn't connect in time is closed.
+TEST_F(TcpProxyUpstreamPoolTest, ConnectTimeout) {
+  Upstream second = expectConnect();
+  Upstream first = expectConnect();
+  pool_->take();
+
+  EXPECT_CALL(*first.connection_, close(Network::ConnectionCloseType::NoFlush));
+  first.timer_->callback_();
+  EXPECT_EQ(1U, counter("upstream_cx_connect_timeout"));
+  EXPECT_EQ(1U, counter("upstream_cx_destroy"));
+}
+
+// A connection that is idle for too long is replaced.
+TEST_F(TcpProxyUpstreamPoolTest, IdleTimeout) {
+  Upstream second = expectConnect();
+  Upstream first = expectConnect();
+  pool_->take();
+  first.connection_->raiseEvent(Network::ConnectionEvent::Connected);
+
+  Upstream third = expectConnect();
+  EXPECT_CALL(*first.connection_, close(Network::ConnectionCloseType::NoFlush));
+  first.timer_->callback_();
+  EXPECT_EQ(1U, counter("upstream_cx_destroy_local"));
+  EXPECT_EQ(3U, counter("upstream_cx_total"));
+}
+
+// The pool doesn't grow past the connection limit of the cluster.
+TEST_F(TcpProxyUpstreamPoolTest, ConnectionLimit) {
+  setMaxConnections(1);
+  Upstream first = expectConnect();
+  pool_->take();
+  EXPECT_EQ(1U, counter("upstream_cx_total"));
+  EXPECT_EQ(1U, counter("upstream_cx_overflow"));
+}
+
+} // namespace Filter
+} // namespace Envoy
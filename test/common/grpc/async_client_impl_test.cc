@@ -1,3 +1,4 @@
+#include "common/compressor/zlib_compressor_impl.h"
 #include "common/grpc/async_client_impl.h"
 
 #include "test/mocks/buffer/mocks.h"
@@ -36,6 +37,16 @@ const std::string HELLO_REPLY = "DEFG";
 const char HELLO_REPLY_DATA[] = "\x00\x00\x00\x00\x06\x0a\x04\x44\x45\x46\x47";
 const size_t HELLO_REPLY_SIZE = sizeof(HELLO_REPLY_DATA) - 1;
 
+// Frame the reply compressed with gzip.
+std::string compressedReplyData() {
+  Compressor::ZlibCompressorImpl compressor(6, 15, 8);
+  Buffer::OwnedImpl message(HELLO_REPLY_DATA + 5, HELLO_REPLY_SIZE - 5);
+  compressor.compress(message, true);
+  std::array<uint8_t, 5> header;
+  Encoder().newFrame(GRPC_FH_COMPRESSED, message.length(), header);
+  return std::string(header.begin(), header.end()) + TestUtility::bufferToString(message);
+}
+
 MATCHER_P(HelloworldReplyEq, rhs, "") { return arg.message() == rhs; }
 
 typedef std::vector<std::pair<Http::LowerCaseString, std::string>> TestMetadata;
@@ -176,6 +187,9 @@ public:
                                     {":authority", "test_cluster"},
                                     {"content-type", "application/grpc"},
                                     {"te", "trailers"}};
+    if (accept_gzip_) {
+      headers.addCopy("grpc-accept-encoding", "identity,gzip");
+    }
     for (auto& value : initial_metadata) {
       headers.addReference(value.first, value.second);
     }
@@ -254,6 +268,13 @@ public:
     dangling_streams_.push_back(stream->http_stream_);
   }
 
+  void acceptGzip() {
+    grpc_client_.reset(new AsyncClientImpl<helloworld::HelloRequest, helloworld::HelloReply>(
+        cm_, "test_cluster", CompressionAlgorithm::Gzip));
+    accept_gzip_ = true;
+  }
+
+  bool accept_gzip_{};
   std::vector<Http::MockAsyncClientStream*> dangling_streams_;
   std::vector<std::unique_ptr<Http::MockAsyncClientStream>> http_streams_;
   const Protobuf::MethodDescriptor* method_descriptor_;
@@ -273,6 +294,79 @@ TEST_F(GrpcAsyncClientImplTest, BasicStream) {
   stream->closeStream();
 }
 
+// Validate that a stream that accepts gzip advertises it and decompresses the replies.
+TEST_F(GrpcAsyncClientImplTest, CompressedReply) {
+  acceptGzip();
+  TestMetadata empty_metadata;
+  auto stream = createStream(empty_metadata);
+  stream->sendRequest();
+  TestMetadata initial_metadata = {{Http::LowerCaseString("grpc-encoding"), "gzip"}};
+  stream->sendServerInitialMetadata(initial_metadata);
+  // Each message is decompressed on its own.
+  for (int i = 0; i < 2; i++) {
+    Buffer::OwnedImpl reply_buffer(compressedReplyData() + compressedReplyData());
+    EXPECT_CALL(*stream, onReceiveMessage_(HelloworldReplyEq(HELLO_REPLY))).Times(2);
+    stream->http_callbacks_->onData(reply_buffer, false);
+  }
+  stream->sendReply();
+  stream->sendServerTrailers(Status::GrpcStatus::Ok, "", empty_metadata);
+  stream->closeStream();
+}
+
+// Validate that a compressed reply without grpc-encoding is handled as an INTERNAL gRPC error.
+TEST_F(GrpcAsyncClientImplTest, CompressedReplyWithoutEncoding) {
+  acceptGzip();
+  TestMetadata empty_metadata;
+  auto stream = createStream(empty_metadata);
+  stream->sendRequest();
+  stream->sendServerInitialMetadata(empty_metadata);
+  stream->expectGrpcStatus(Status::GrpcStatus::Internal);
+  Buffer::OwnedImpl reply_buffer(compressedReplyData());
+  stream->http_callbacks_->onData(reply_buffer, false);
+}
+
+// Validate that a reply with bad gzip data is handled as an INTERNAL gRPC error.
+TEST_F(GrpcAsyncClientImplTest, BadCompressedReply) {
+  TestMetadata empty_metadata;
+  auto stream = createStream(empty_metadata);
+  stream->sendRequest();
+  TestMetadata initial_metadata = {{Http::LowerCaseString("grpc-encoding"), "gzip"}};
+  stream->sendServerInitialMetadata(initial_metadata);
+  stream->expectGrpcStatus(Status::GrpcStatus::Internal);
+  Buffer::OwnedImpl reply_buffer("\x01\x00\x00\x00\x02\xff\xff", 7);
+  stream->http_callbacks_->onData(reply_buffer, false);
+}
+
+// Validate that a compressed reply that inflates past the limit fails the stream.
+TEST_F(GrpcAsyncClientImplTest, OversizedCompressedReply) {
+  TestMetadata empty_metadata;
+  auto stream = createStream(empty_metadata);
+  stream->sendRequest();
+  TestMetadata initial_metadata = {{Http::LowerCaseString("grpc-encoding"), "gzip"}};
+  stream->sendServerInitialMetadata(initial_metadata);
+
+  // Zeros compress about a thousand to one, so the frame is small.
+  Compressor::ZlibCompressorImpl compressor(6, 15, 8);
+  Buffer::OwnedImpl message;
+  const std::string zeros(1024 * 1024, '\0');
+  for (uint64_t size = 0; size <= GRPC_MAX_DECOMPRESSED_MESSAGE_SIZE; size += zeros.size()) {
+    Buffer::OwnedImpl chunk(zeros);
+    compressor.compress(chunk, false);
+    message.move(chunk);
+  }
+  Buffer::OwnedImpl last;
+  compressor.compress(last, true);
+  message.move(last);
+  EXPECT_LT(message.length(), GRPC_MAX_DECOMPRESSED_MESSAGE_SIZE / 100);
+
+  std::array<uint8_t, 5> header;
+  Encoder().newFrame(GRPC_FH_COMPRESSED, message.length(), header);
+  Buffer::OwnedImpl reply_buffer(header.data(), header.size());
+  reply_buffer.move(message);
+  stream->expectGrpcStatus(Status::GrpcStatus::Internal);
+  stream->http_callbacks_->onData(reply_buffer, false);
+}
+
 // Validate that a simple request-reply unary RPC works.
 TEST_F(GrpcAsyncClientImplTest, BasicRequest) {
   TestMetadata empty_metadata;
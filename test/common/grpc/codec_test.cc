@@ -8,6 +8,7 @@
 
 #include "test/proto/helloworld.pb.h"
 #include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
 
 #include "gtest/gtest.h"
 
@@ -100,6 +101,77 @@ TEST(GrpcCodecTest, decodeInvalidFrame) {
   EXPECT_EQ(size, buffer.length());
 }
 
+TEST(GrpcCodecTest, decodeInvalidFrameAfterValidFrame) {
+  Buffer::OwnedImpl buffer;
+  std::array<uint8_t, 5> header;
+  Encoder encoder;
+  encoder.newFrame(GRPC_FH_DEFAULT, 3, header);
+  buffer.add(header.data(), 5);
+  buffer.add("abc");
+  encoder.newFrame(0b10u, 3, header);
+  buffer.add(header.data(), 5);
+  buffer.add("def");
+  size_t size = buffer.length();
+
+  // Nothing is decoded, not even the valid frame.
+  std::vector<Frame> frames;
+  Decoder decoder;
+  EXPECT_FALSE(decoder.decode(buffer, frames));
+  EXPECT_EQ(size, buffer.length());
+  EXPECT_TRUE(frames.empty());
+}
+
+TEST(GrpcCodecTest, decodeSplitHeaders) {
+  Buffer::OwnedImpl input;
+  std::array<uint8_t, 5> header;
+  Encoder encoder;
+  encoder.newFrame(GRPC_FH_DEFAULT, 3, header);
+  input.add(header.data(), 5);
+  input.add("abc");
+  encoder.newFrame(GRPC_FH_COMPRESSED, 0, header);
+  input.add(header.data(), 5);
+  const std::string data = TestUtility::bufferToString(input);
+
+  // Feed one byte at a time, so that every header is split.
+  std::vector<Frame> frames;
+  Decoder decoder;
+  for (char c : data) {
+    Buffer::OwnedImpl buffer(&c, 1);
+    EXPECT_TRUE(decoder.decode(buffer, frames));
+    EXPECT_EQ(0, buffer.length());
+  }
+  ASSERT_EQ(2, frames.size());
+  EXPECT_EQ(3, frames[0].length_);
+  EXPECT_EQ("abc", TestUtility::bufferToString(*frames[0].data_));
+  EXPECT_EQ(GRPC_FH_COMPRESSED, frames[1].flags_);
+  EXPECT_EQ(0, frames[1].length_);
+}
+
+TEST(GrpcCodecTest, decodeMovesData) {
+  const std::string payload(16384, 'a');
+  Buffer::OwnedImpl data(payload);
+  Buffer::RawSlice slice;
+  ASSERT_EQ(1, data.getRawSlices(&slice, 1));
+
+  Buffer::OwnedImpl buffer;
+  std::array<uint8_t, 5> header;
+  Encoder encoder;
+  encoder.newFrame(GRPC_FH_DEFAULT, payload.size(), header);
+  buffer.add(header.data(), 5);
+  buffer.move(data);
+
+  std::vector<Frame> frames;
+  Decoder decoder;
+  EXPECT_TRUE(decoder.decode(buffer, frames));
+  ASSERT_EQ(1, frames.size());
+
+  // The frame has the slice of the input, rather than a copy of it.
+  Buffer::RawSlice frame_slice;
+  ASSERT_EQ(1, frames[0].data_->getRawSlices(&frame_slice, 1));
+  EXPECT_EQ(slice.mem_, frame_slice.mem_);
+  EXPECT_EQ(payload.size(), frame_slice.len_);
+}
+
 TEST(GrpcCodecTest, decodeEmptyFrame) {
   Buffer::OwnedImpl buffer("\0\0\0\0", 5);
 
@@ -156,6 +156,33 @@ TEST_F(GrpcJsonTranscoderConfigTest, CreateTranscoder) {
   EXPECT_EQ("bookstore.Bookstore.ListShelves", method_descriptor->full_name());
 }
 
+TEST_F(GrpcJsonTranscoderConfigTest, CreateTranscoderWithBindings) {
+  JsonTranscoderConfig config(*configJson(
+      TestEnvironment::runfilesPath("test/proto/bookstore.descriptor"), "bookstore.Bookstore"));
+
+  TranscoderInputStreamImpl request_in, response_in;
+  std::unique_ptr<Transcoder> transcoder;
+  const MethodDescriptor* method_descriptor;
+
+  // Both the nested variable of the path template and the query parameter are bound.
+  Http::TestHeaderMapImpl headers{{":method", "PATCH"},
+                                  {":path", "/shelves/5/books/7?book.title=Hamlet"}};
+  auto status =
+      config.createTranscoder(headers, request_in, response_in, transcoder, method_descriptor);
+  EXPECT_TRUE(status.ok());
+  EXPECT_TRUE(transcoder);
+  EXPECT_EQ("bookstore.Bookstore.UpdateBook", method_descriptor->full_name());
+
+  // A query parameter is still resolved against the request type.
+  Http::TestHeaderMapImpl unknown_field_headers{{":method", "PATCH"},
+                                                {":path", "/shelves/5/books/7?book.pages=1"}};
+  transcoder.reset();
+  status = config.createTranscoder(unknown_field_headers, request_in, response_in, transcoder,
+                                   method_descriptor);
+  EXPECT_EQ(Code::INVALID_ARGUMENT, status.error_code());
+  EXPECT_FALSE(transcoder);
+}
+
 TEST_F(GrpcJsonTranscoderConfigTest, InvalidVariableBinding) {
   HttpRule http_rule;
   http_rule.set_get("/book/{b}");
@@ -313,6 +340,64 @@ TEST_F(GrpcJsonTranscoderFilterTest, TranscodingUnaryError) {
   EXPECT_EQ(0, request_data.length());
 }
 
+TEST_F(GrpcJsonTranscoderFilterTest, TranscodingRequestMessageTooLarge) {
+  Http::TestHeaderMapImpl request_headers{
+      {"content-type", "application/json"}, {":method", "POST"}, {":path", "/shelf"}};
+
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_.decodeHeaders(request_headers, false));
+
+  ON_CALL(decoder_callbacks_, decoderBufferLimit()).WillByDefault(Return(16));
+
+  // The request message is not complete yet, but within the limit.
+  Buffer::OwnedImpl request_data{"{\"theme\": "};
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_.decodeData(request_data, false));
+  EXPECT_EQ(0, request_data.length());
+
+  EXPECT_CALL(decoder_callbacks_, encodeHeaders_(_, false))
+      .WillOnce(Invoke([](Http::HeaderMap& headers, bool end_stream) {
+        EXPECT_STREQ("413", headers.Status()->value().c_str());
+        EXPECT_FALSE(end_stream);
+      }));
+  EXPECT_CALL(decoder_callbacks_, encodeData(_, true));
+
+  request_data.add("\"Children\"");
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationNoBuffer,
+            filter_.decodeData(request_data, false));
+}
+
+TEST_F(GrpcJsonTranscoderFilterTest, TranscodingResponseMessageTooLarge) {
+  Http::TestHeaderMapImpl request_headers{
+      {"content-type", "application/json"}, {":method", "POST"}, {":path", "/shelf"}};
+
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_.decodeHeaders(request_headers, false));
+
+  Http::TestHeaderMapImpl response_headers{{"content-type", "application/grpc"},
+                                           {":status", "200"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration,
+            filter_.encodeHeaders(response_headers, false));
+
+  bookstore::Shelf response;
+  response.set_id(20);
+  response.set_theme("Children");
+  auto response_data = Common::serializeBody(response);
+
+  const uint32_t limit = response_data->length() - 2;
+  ON_CALL(encoder_callbacks_, encoderBufferLimit()).WillByDefault(Return(limit));
+
+  // The response message is not complete yet, but within the limit.
+  Buffer::OwnedImpl partial_data;
+  partial_data.move(*response_data, limit);
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer,
+            filter_.encodeData(partial_data, false));
+  EXPECT_EQ(0, partial_data.length());
+
+  // One more byte of the incomplete message is over the limit.
+  EXPECT_CALL(encoder_callbacks_, resetStream());
+  partial_data.move(*response_data, 1);
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationNoBuffer,
+            filter_.encodeData(partial_data, false));
+}
+
 struct GrpcJsonTranscoderFilterPrintTestParam {
   std::string config_json_;
   std::string expected_response_;
@@ -261,6 +261,26 @@ TEST(AccessLogFormatterTest, CompositeFormatterSuccess) {
   }
 }
 
+TEST(AccessLogFormatterTest, CompositeFormatterAppend) {
+  NiceMock<MockRequestInfo> request_info;
+  TestHeaderMapImpl request_header{{":method", "GET"}};
+  TestHeaderMapImpl response_header;
+  FormatterImpl formatter("%REQ(:METHOD)% %RESPONSE_FLAGS% %BYTES_SENT% %DURATION%\n");
+
+  EXPECT_CALL(request_info, bytesSent()).WillRepeatedly(Return(18446744073709551615UL));
+  EXPECT_CALL(request_info, duration()).WillRepeatedly(Return(std::chrono::microseconds(2500)));
+  ON_CALL(request_info, getResponseFlag(ResponseFlag::RateLimited)).WillByDefault(Return(true));
+
+  // The output is appended to, so the same string can be reused across lines.
+  std::string output = "previous ";
+  formatter.formatAppend(request_header, response_header, request_info, output);
+  EXPECT_EQ("previous GET RL 18446744073709551615 2\n", output);
+  output.clear();
+  formatter.formatAppend(request_header, response_header, request_info, output);
+  EXPECT_EQ("GET RL 18446744073709551615 2\n", output);
+  EXPECT_EQ(output, formatter.format(request_header, response_header, request_info));
+}
+
 TEST(AccessLogFormatterTest, ParserFailures) {
   AccessLogFormatParser parser;
 
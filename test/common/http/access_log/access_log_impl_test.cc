@@ -568,6 +568,42 @@ TEST(AccessLogFilterTest, StatusCodeWithRuntimeKey) {
   EXPECT_FALSE(filter.evaluate(info, request_headers));
 }
 
+TEST(AccessLogFilterTest, SharedFilterEvaluatedOncePerRequest) {
+  std::string filter_json = R"EOF(
+    {
+      "filter": {"type": "runtime", "key": "access_log.sampled"}
+    }
+    )EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(filter_json);
+  NiceMock<Runtime::MockLoader> runtime;
+  envoy::api::v2::filter::AccessLogFilter config;
+  Config::FilterJson::translateAccessLogFilter(*loader->getObject("filter"), config);
+  envoy::api::v2::filter::AccessLogFilter other_config;
+  Config::FilterJson::translateAccessLogFilter(
+      *Json::Factory::loadFromString(R"EOF({"type": "not_healthcheck"})EOF"), other_config);
+
+  FilterCache filter_cache;
+  FilterPtr filter_1 = filter_cache.fromProto(config, runtime);
+  FilterPtr filter_2 = filter_cache.fromProto(config, runtime);
+  FilterPtr other_filter = filter_cache.fromProto(other_config, runtime);
+
+  TestHeaderMapImpl request_headers{{"x-request-id", "000000ff-0000-0000-0000-000000000000"}};
+  TestRequestInfo info;
+
+  SharedFilter::newRequest();
+  EXPECT_CALL(runtime.snapshot_, getInteger("access_log.sampled", 0)).WillOnce(Return(100));
+  EXPECT_TRUE(filter_1->evaluate(info, request_headers));
+  EXPECT_TRUE(filter_2->evaluate(info, request_headers));
+  EXPECT_TRUE(other_filter->evaluate(info, request_headers));
+
+  // The next request evaluates the filter again.
+  SharedFilter::newRequest();
+  EXPECT_CALL(runtime.snapshot_, getInteger("access_log.sampled", 0)).WillOnce(Return(0));
+  EXPECT_FALSE(filter_2->evaluate(info, request_headers));
+  EXPECT_FALSE(filter_1->evaluate(info, request_headers));
+}
+
 } // namespace
 } // namespace AccessLog
 } // namespace Http
@@ -0,0 +1,221 @@
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "common/http/access_log/grpc_access_log_impl.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/grpc/mocks.h"
+#include "test/mocks/http/mocks.h"
+#include "test/mocks/local_info/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+using testing::ReturnRef;
+using testing::SaveArg;
+using testing::_;
+
+namespace Envoy {
+namespace Http {
+namespace AccessLog {
+
+class GrpcAccessLogTest : public testing::Test {
+public:
+  typedef Grpc::MockAsyncClient<envoy::accesslog::StreamAccessLogsMessage,
+                                envoy::accesslog::StreamAccessLogsResponse>
+      MockAsyncClient;
+  typedef Grpc::AsyncStreamCallbacks<envoy::accesslog::StreamAccessLogsResponse> StreamCallbacks;
+  typedef Grpc::AsyncStream<envoy::accesslog::StreamAccessLogsMessage> Stream;
+
+  GrpcAccessLogTest() {
+    ON_CALL(request_info_, responseCode()).WillByDefault(ReturnRef(response_code_));
+    ON_CALL(request_info_, upstreamHost()).WillByDefault(Return(nullptr));
+  }
+
+  void setup(uint32_t max_batch_size, uint32_t max_pending_entries) {
+    envoy::accesslog::GrpcAccessLogConfig config;
+    config.set_cluster_name("access_log_cluster");
+    config.set_log_name("test_log");
+    config.set_max_batch_size(max_batch_size);
+    config.set_flush_interval_ms(500);
+    config.set_max_pending_entries(max_pending_entries);
+
+    flush_timer_ = new Event::MockTimer(&tls_.dispatcher_);
+    EXPECT_CALL(*flush_timer_, enableTimer(std::chrono::milliseconds(500)));
+    access_log_.reset(new GrpcAccessLog(
+        nullptr, config,
+        [this]() -> GrpcAccessLogAsyncClientPtr {
+          async_client_ = new MockAsyncClient();
+          return GrpcAccessLogAsyncClientPtr{async_client_};
+        },
+        tls_, stats_store_, local_info_));
+  }
+
+  void expectStreamStart() {
+    EXPECT_CALL(*async_client_, start(_, _))
+        .WillOnce(Invoke([this](const Protobuf::MethodDescriptor& service_method,
+                                StreamCallbacks& callbacks) -> Stream* {
+          EXPECT_EQ("envoy.accesslog.AccessLogService", service_method.service()->full_name());
+          EXPECT_EQ("StreamAccessLogs", service_method.name());
+          callbacks_ = &callbacks;
+          return &stream_;
+        }));
+  }
+
+  void log() { access_log_->log(&request_headers_, nullptr, request_info_); }
+
+  uint64_t counter(const std::string& name) {
+    return stats_store_.counter("access_log.grpc.test_log." + name).value();
+  }
+
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  Stats::IsolatedStoreImpl stats_store_;
+  NiceMock<LocalInfo::MockLocalInfo> local_info_;
+  NiceMock<MockRequestInfo> request_info_;
+  Optional<uint32_t> response_code_;
+  TestHeaderMapImpl request_headers_{{":method", "GET"}, {":path", "/"}};
+  Event::MockTimer* flush_timer_{};
+  MockAsyncClient* async_client_{};
+  Grpc::MockAsyncStream<envoy::accesslog::StreamAccessLogsMessage> stream_;
+  StreamCallbacks* callbacks_{};
+  std::unique_ptr<GrpcAccessLog> access_log_;
+};
+
+TEST_F(GrpcAccessLogTest, FullBatchIsSent) {
+  setup(2, 100);
+  envoy::accesslog::StreamAccessLogsMessage message;
+
+  log();
+  expectStreamStart();
+  EXPECT_CALL(stream_, sendMessage(_, false)).WillOnce(SaveArg<0>(&message));
+  log();
+
+  EXPECT_EQ("node_name", message.identifier().node());
+  EXPECT_EQ("cluster_name", message.identifier().cluster());
+  EXPECT_EQ("test_log", message.identifier().log_name());
+  ASSERT_EQ(2, message.entries_size());
+  EXPECT_EQ("GET", message.entries(0).method());
+  EXPECT_EQ("/", message.entries(0).path());
+  EXPECT_EQ(2U, counter("entries_sent"));
+
+  // The stream is reused and the identifier is only sent once.
+  log();
+  EXPECT_CALL(stream_, sendMessage(_, false)).WillOnce(SaveArg<0>(&message));
+  log();
+  EXPECT_FALSE(message.has_identifier());
+  EXPECT_EQ(2, message.entries_size());
+  EXPECT_EQ(4U, counter("entries_sent"));
+
+  EXPECT_CALL(stream_, resetStream());
+  access_log_.reset();
+}
+
+TEST_F(GrpcAccessLogTest, PartialBatchSentByTimer) {
+  setup(10, 100);
+  envoy::accesslog::StreamAccessLogsMessage message;
+
+  // Nothing is sent while there are no entries.
+  EXPECT_CALL(*flush_timer_, enableTimer(std::chrono::milliseconds(500)));
+  flush_timer_->callback_();
+
+  log();
+  expectStreamStart();
+  EXPECT_CALL(stream_, sendMessage(_, false)).WillOnce(SaveArg<0>(&message));
+  EXPECT_CALL(*flush_timer_, enableTimer(std::chrono::milliseconds(500)));
+  flush_timer_->callback_();
+  EXPECT_EQ(1, message.entries_size());
+
+  EXPECT_CALL(stream_, resetStream());
+  access_log_.reset();
+}
+
+TEST_F(GrpcAccessLogTest, EntriesDroppedWithoutStream) {
+  setup(2, 3);
+  envoy::accesslog::StreamAccessLogsMessage message;
+
+  // The stream cannot be started, so the entries are kept until the bound is reached.
+  log();
+  EXPECT_CALL(*async_client_, start(_, _))
+      .WillOnce(Invoke(
+          [](const Protobuf::MethodDescriptor&, StreamCallbacks& callbacks) -> Stream* {
+            callbacks.onRemoteClose(Grpc::Status::GrpcStatus::Unavailable, "");
+            return nullptr;
+          }));
+  log();
+  log();
+  log();
+  EXPECT_EQ(1U, counter("entries_dropped"));
+  EXPECT_EQ(1U, counter("stream_closed"));
+
+  // The next flush starts a new stream with all the pending entries.
+  expectStreamStart();
+  EXPECT_CALL(stream_, sendMessage(_, false)).WillOnce(SaveArg<0>(&message));
+  EXPECT_CALL(*flush_timer_, enableTimer(_));
+  flush_timer_->callback_();
+  EXPECT_TRUE(message.has_identifier());
+  EXPECT_EQ(3, message.entries_size());
+  EXPECT_EQ(3U, counter("entries_sent"));
+
+  // A closed stream is replaced by the next batch.
+  callbacks_->onRemoteClose(Grpc::Status::GrpcStatus::Internal, "bad");
+  EXPECT_EQ(2U, counter("stream_closed"));
+  log();
+  expectStreamStart();
+  EXPECT_CALL(stream_, sendMessage(_, false)).WillOnce(SaveArg<0>(&message));
+  log();
+  EXPECT_TRUE(message.has_identifier());
+  EXPECT_EQ(2, message.entries_size());
+
+  EXPECT_CALL(stream_, resetStream());
+  access_log_.reset();
+}
+
+TEST(GrpcAccessLogEntryTest, FillEntry) {
+  NiceMock<MockRequestInfo> request_info;
+  Optional<uint32_t> response_code{200};
+  ON_CALL(request_info, responseCode()).WillByDefault(ReturnRef(response_code));
+  ON_CALL(request_info, protocol()).WillByDefault(Return(Protocol::Http2));
+  ON_CALL(request_info, startTime())
+      .WillByDefault(Return(SystemTime(std::chrono::microseconds(1500000))));
+  ON_CALL(request_info, duration()).WillByDefault(Return(std::chrono::microseconds(2500)));
+  ON_CALL(request_info, bytesReceived()).WillByDefault(Return(10));
+  ON_CALL(request_info, bytesSent()).WillByDefault(Return(20));
+  ON_CALL(request_info, getResponseFlag(ResponseFlag::UpstreamRequestTimeout))
+      .WillByDefault(Return(true));
+  TestHeaderMapImpl request_headers{{":method", "POST"},
+                                    {":path", "/rewritten"},
+                                    {"x-envoy-original-path", "/original"},
+                                    {":authority", "example.com"},
+                                    {"user-agent", "curl"},
+                                    {"x-forwarded-for", "10.0.0.2"},
+                                    {"x-request-id", "id"}};
+
+  envoy::accesslog::HttpAccessLogEntry entry;
+  GrpcAccessLog::fillEntry(request_headers, request_info, entry);
+  EXPECT_EQ(1500000U, entry.start_time_us());
+  EXPECT_EQ(2500U, entry.duration_us());
+  EXPECT_EQ(envoy::accesslog::HttpAccessLogEntry::HTTP2, entry.protocol());
+  EXPECT_EQ("POST", entry.method());
+  EXPECT_EQ("/original", entry.path());
+  EXPECT_EQ("example.com", entry.authority());
+  EXPECT_EQ("curl", entry.user_agent());
+  EXPECT_EQ("10.0.0.2", entry.forwarded_for());
+  EXPECT_EQ("id", entry.request_id());
+  EXPECT_EQ(200U, entry.response_code());
+  EXPECT_EQ("UT", entry.response_flags());
+  EXPECT_EQ(10U, entry.bytes_received());
+  EXPECT_EQ(20U, entry.bytes_sent());
+  EXPECT_EQ("10.0.0.1:443", entry.upstream_host());
+  EXPECT_EQ("fake_cluster", entry.upstream_cluster());
+}
+
+} // namespace AccessLog
+} // namespace Http
+} // namespace Envoy
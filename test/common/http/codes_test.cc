@@ -1,5 +1,6 @@
 #include <chrono>
 #include <cstdint>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -31,7 +32,7 @@ public:
 
     CodeUtility::ResponseStatInfo info{
         global_store_,      cluster_scope_,        "prefix.", headers, internal_request,
-        request_vhost_name, request_vcluster_name, from_az,   to_az,   canary};
+        request_vhost_name, request_vcluster_name, from_az,   to_az,   canary,  nullptr};
 
     CodeUtility::chargeResponseStat(info);
   }
@@ -174,6 +175,59 @@ TEST_F(CodeUtilityTest, PerZoneStats) {
   EXPECT_EQ(1U, cluster_scope_.counter("prefix.zone.from_az.to_az.upstream_rq_2xx").value());
 }
 
+TEST(CodeStatsTest, CachedMatchesNames) {
+  Stats::IsolatedStoreImpl named_global_store;
+  Stats::IsolatedStoreImpl named_cluster_scope;
+  Stats::IsolatedStoreImpl cached_global_store;
+  Stats::IsolatedStoreImpl cached_cluster_scope;
+  UpstreamCodeStatsImpl code_stats(cached_cluster_scope);
+
+  auto add_response = [&](uint64_t code, bool canary, bool internal_request,
+                          const std::string& vcluster, const std::string& to_az) -> void {
+    TestHeaderMapImpl headers{{":status", std::to_string(code)}};
+    CodeUtility::chargeResponseStat({named_global_store, named_cluster_scope, EMPTY_STRING,
+                                     headers, internal_request, "vhost", vcluster, "from_az",
+                                     to_az, canary, nullptr});
+    CodeUtility::chargeResponseStat({cached_global_store, cached_cluster_scope, EMPTY_STRING,
+                                     headers, internal_request, "vhost", vcluster, "from_az",
+                                     to_az, canary, &code_stats});
+  };
+  add_response(200, false, false, "", "");
+  add_response(200, true, true, "vcluster", "to_az");
+  add_response(201, false, true, "", "to_az");
+  add_response(404, true, false, "vcluster", "other_az");
+  add_response(503, false, false, "", "to_az");
+  add_response(503, false, false, "", "to_az");
+  add_response(100, false, false, "", "");
+  add_response(600, false, false, "", "");
+
+  auto values = [](const Stats::Store& store) -> std::map<std::string, uint64_t> {
+    std::map<std::string, uint64_t> values;
+    for (const Stats::CounterSharedPtr& counter : store.counters()) {
+      values[counter->name()] = counter->value();
+    }
+    return values;
+  };
+  EXPECT_EQ(values(named_cluster_scope), values(cached_cluster_scope));
+  EXPECT_EQ(values(named_global_store), values(cached_global_store));
+  EXPECT_EQ(2U, cached_cluster_scope.counter("upstream_rq_503").value());
+  EXPECT_EQ(2U, cached_cluster_scope.counter("zone.from_az.to_az.upstream_rq_5xx").value());
+}
+
+TEST(CodeStatsTest, LookupOnce) {
+  Stats::MockStore scope;
+  CodeStatsImpl code_stats(scope, "prefix.upstream_rq_");
+
+  EXPECT_CALL(scope, counter("prefix.upstream_rq_2xx"));
+  EXPECT_CALL(scope, counter("prefix.upstream_rq_200"));
+  EXPECT_CALL(scope, counter("prefix.upstream_rq_204"));
+  EXPECT_CALL(scope.counter_, inc()).Times(8);
+  code_stats.charge(Code::OK);
+  code_stats.charge(Code::OK);
+  code_stats.charge(Code::NoContent);
+  code_stats.charge(Code::NoContent);
+}
+
 TEST(CodeUtilityResponseTimingTest, All) {
   Stats::MockStore global_store;
   Stats::MockStore cluster_scope;
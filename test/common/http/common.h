@@ -18,8 +18,9 @@ public:
   typedef std::function<void(CodecClient*)> DestroyCb;
 
   CodecClientForTest(Network::ClientConnectionPtr&& connection, Http::ClientConnection* codec,
-                     DestroyCb destroy_cb, Upstream::HostDescriptionConstSharedPtr host)
-      : CodecClient(CodecClient::Type::HTTP1, std::move(connection), host),
+                     DestroyCb destroy_cb, Upstream::HostDescriptionConstSharedPtr host,
+                     CodecClient::Type type = CodecClient::Type::HTTP1)
+      : CodecClient(type, std::move(connection), host),
         destroy_cb_(destroy_cb) {
     codec_.reset(codec);
   }
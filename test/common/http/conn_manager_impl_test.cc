@@ -18,8 +18,11 @@
 #include "common/http/exception.h"
 #include "common/http/header_map_impl.h"
 #include "common/http/headers.h"
+#include "common/memory/allocation_tracker.h"
 #include "common/network/address_impl.h"
+#include "common/stats/histogram_impl.h"
 #include "common/stats/stats_impl.h"
+#include "common/tracing/http_tracer_impl.h"
 #include "common/upstream/upstream_impl.h"
 
 #include "test/mocks/access_log/mocks.h"
@@ -29,6 +32,7 @@
 #include "test/mocks/local_info/mocks.h"
 #include "test/mocks/network/mocks.h"
 #include "test/mocks/runtime/mocks.h"
+#include "test/mocks/server/mocks.h"
 #include "test/mocks/ssl/mocks.h"
 #include "test/mocks/tracing/mocks.h"
 #include "test/mocks/upstream/mocks.h"
@@ -85,6 +89,7 @@ public:
 
   ~HttpConnectionManagerImplTest() {
     filter_callbacks_.connection_.dispatcher_.clearDeferredDeleteList();
+    Memory::AllocationTracker::disable();
   }
 
   void setup(bool ssl, const std::string& server_name) {
@@ -99,7 +104,8 @@ public:
     ON_CALL(filter_callbacks_.connection_, remoteAddress())
         .WillByDefault(ReturnRef(remote_address_));
     conn_manager_.reset(new ConnectionManagerImpl(*this, drain_close_, random_, tracer_, runtime_,
-                                                  local_info_, cluster_manager_));
+                                                  local_info_, cluster_manager_,
+                                                  &overload_manager_));
     conn_manager_->initializeReadFilterCallbacks(filter_callbacks_);
   }
 
@@ -184,6 +190,18 @@ public:
     EXPECT_CALL(filter_callbacks_.connection_.dispatcher_, deferredDelete_(_));
   }
 
+  // Merges the named histogram of fake_stats_, or returns nullptr if nothing created it.
+  Stats::HistogramImpl* mergedHistogram(const std::string& name) {
+    for (const Stats::ParentHistogramSharedPtr& histogram : fake_stats_.histograms()) {
+      if (histogram->name() == name) {
+        Stats::HistogramImpl* impl = dynamic_cast<Stats::HistogramImpl*>(histogram.get());
+        impl->merge();
+        return impl;
+      }
+    }
+    return nullptr;
+  }
+
   void expectOnUpstreamInitFailure() {
     StreamDecoder* decoder = nullptr;
     NiceMock<MockStreamEncoder> encoder;
@@ -222,6 +240,7 @@ public:
   FilterChainFactory& filterFactory() override { return filter_factory_; }
   bool generateRequestId() override { return true; }
   const Optional<std::chrono::milliseconds>& idleTimeout() override { return idle_timeout_; }
+  uint32_t maxRequestHeadersKb() override { return max_request_headers_kb_; }
   Router::RouteConfigProvider& routeConfigProvider() override { return route_config_provider_; }
   const std::string& serverName() override { return server_name_; }
   ConnectionManagerStats& stats() override { return stats_; }
@@ -256,6 +275,7 @@ public:
   std::vector<Http::ClientCertDetailsType> set_current_client_cert_details_;
   Optional<std::string> user_agent_;
   Optional<std::chrono::milliseconds> idle_timeout_;
+  uint32_t max_request_headers_kb_{DEFAULT_MAX_REQUEST_HEADERS_KB};
   NiceMock<Runtime::MockRandomGenerator> random_;
   NiceMock<LocalInfo::MockLocalInfo> local_info_;
   std::unique_ptr<Ssl::MockConnection> ssl_connection_;
@@ -265,6 +285,7 @@ public:
   MockStream stream_;
   Http::StreamCallbacks* stream_callbacks_{nullptr};
   NiceMock<Upstream::MockClusterManager> cluster_manager_;
+  NiceMock<Server::MockOverloadManager> overload_manager_;
   uint32_t initial_buffer_limit_{};
   bool streaming_filter_{false};
 
@@ -367,6 +388,28 @@ TEST_F(HttpConnectionManagerImplTest, InvalidPathWithDualFilter) {
   conn_manager_->onData(fake_input);
 }
 
+// Requests whose headers are larger than the configured limit are rejected with a 431.
+TEST_F(HttpConnectionManagerImplTest, RequestHeadersOverLimit) {
+  max_request_headers_kb_ = 1;
+  setup(false, "");
+
+  EXPECT_CALL(*codec_, dispatch(_)).WillOnce(Invoke([&](Buffer::Instance& data) -> void {
+    StreamDecoder* decoder = &conn_manager_->newStream(response_encoder_);
+    HeaderMapPtr headers{new TestHeaderMapImpl{
+        {":authority", "host"}, {":path", "/"}, {"big", std::string(1024, 'a')}}};
+    decoder->decodeHeaders(std::move(headers), true);
+    data.drain(4);
+  }));
+
+  EXPECT_CALL(response_encoder_, encodeHeaders(_, true))
+      .WillOnce(Invoke([](const HeaderMap& headers, bool) -> void {
+        EXPECT_STREQ("431", headers.Status()->value().c_str());
+      }));
+
+  Buffer::OwnedImpl fake_input("1234");
+  conn_manager_->onData(fake_input);
+}
+
 TEST_F(HttpConnectionManagerImplTest, StartAndFinishSpanNormalFlow) {
   setup(false, "");
 
@@ -402,7 +445,7 @@ TEST_F(HttpConnectionManagerImplTest, StartAndFinishSpanNormalFlow) {
 
   // Treat request as internal, otherwise x-request-id header will be overwritten.
   use_remote_address_ = false;
-  EXPECT_CALL(random_, uuid()).Times(0);
+  EXPECT_CALL(random_, uuid(_)).Times(0);
 
   StreamDecoder* decoder = nullptr;
   NiceMock<MockStreamEncoder> encoder;
@@ -500,6 +543,9 @@ TEST_F(HttpConnectionManagerImplTest, DoNotStartSpanIfTracingIsNotEnabled) {
                               {"x-request-id", "125a4afb-6f55-a4ba-ad80-413f09f48a28"}}};
     decoder->decodeHeaders(std::move(headers), true);
 
+    // Untraced requests share the null span instead of allocating one.
+    EXPECT_EQ(&Tracing::NullSpan::instance(), &filter->callbacks_->activeSpan());
+
     HeaderMapPtr response_headers{new TestHeaderMapImpl{{":status", "200"}}};
     filter->callbacks_->encodeHeaders(std::move(response_headers), true);
 
@@ -536,7 +582,7 @@ TEST_F(HttpConnectionManagerImplTest, StartSpanOnlyHealthCheckRequest) {
 
   // Treat request as internal, otherwise x-request-id header will be overwritten.
   use_remote_address_ = false;
-  EXPECT_CALL(random_, uuid()).Times(0);
+  EXPECT_CALL(random_, uuid(_)).Times(0);
 
   StreamDecoder* decoder = nullptr;
   NiceMock<MockStreamEncoder> encoder;
@@ -589,6 +635,66 @@ TEST_F(HttpConnectionManagerImplTest, NoPath) {
   conn_manager_->onData(fake_input);
 }
 
+TEST_F(HttpConnectionManagerImplTest, OverloadRejectNewStreams) {
+  setup(false, "");
+  ON_CALL(overload_manager_, isActive(Server::OverloadAction::RejectNewStreams))
+      .WillByDefault(Return(true));
+
+  // The filter chain is never created.
+  EXPECT_CALL(filter_factory_, createFilterChain(_)).Times(0);
+
+  NiceMock<MockStreamEncoder> encoder;
+  EXPECT_CALL(*codec_, dispatch(_)).WillOnce(Invoke([&](Buffer::Instance&) -> void {
+    StreamDecoder* decoder = &conn_manager_->newStream(encoder);
+    HeaderMapPtr headers{new TestHeaderMapImpl{{":authority", "host"}, {":path", "/"}}};
+    decoder->decodeHeaders(std::move(headers), true);
+  }));
+
+  EXPECT_CALL(encoder, encodeHeaders(_, true))
+      .WillOnce(Invoke([](const HeaderMap& headers, bool) -> void {
+        EXPECT_STREQ("503", headers.Status()->value().c_str());
+      }));
+
+  Buffer::OwnedImpl fake_input;
+  conn_manager_->onData(fake_input);
+
+  EXPECT_EQ(1U, stats_.named_.downstream_rq_overload_close_.value());
+}
+
+TEST_F(HttpConnectionManagerImplTest, OverloadDisableHttpKeepAlive) {
+  setup(false, "");
+  ON_CALL(overload_manager_, isActive(Server::OverloadAction::DisableHttpKeepAlive))
+      .WillByDefault(Return(true));
+
+  MockStreamDecoderFilter* filter = new NiceMock<MockStreamDecoderFilter>();
+  EXPECT_CALL(filter_factory_, createFilterChain(_))
+      .WillOnce(Invoke([&](FilterChainFactoryCallbacks& callbacks) -> void {
+        callbacks.addStreamDecoderFilter(StreamDecoderFilterSharedPtr{filter});
+      }));
+  EXPECT_CALL(*filter, decodeHeaders(_, true))
+      .WillOnce(Return(FilterHeadersStatus::StopIteration));
+
+  NiceMock<MockStreamEncoder> encoder;
+  EXPECT_CALL(*codec_, dispatch(_)).WillOnce(Invoke([&](Buffer::Instance&) -> void {
+    StreamDecoder* decoder = &conn_manager_->newStream(encoder);
+    HeaderMapPtr headers{new TestHeaderMapImpl{{":authority", "host"}, {":path", "/"}}};
+    decoder->decodeHeaders(std::move(headers), true);
+  }));
+
+  Buffer::OwnedImpl fake_input;
+  conn_manager_->onData(fake_input);
+
+  EXPECT_CALL(encoder, encodeHeaders(_, true))
+      .WillOnce(Invoke([](const HeaderMap& headers, bool) -> void {
+        EXPECT_STREQ("close", headers.Connection()->value().c_str());
+      }));
+  EXPECT_CALL(filter_callbacks_.connection_, close(Network::ConnectionCloseType::FlushWrite));
+  HeaderMapPtr response_headers{new TestHeaderMapImpl{{":status", "200"}}};
+  filter->callbacks_->encodeHeaders(std::move(response_headers), true);
+
+  EXPECT_EQ(1U, stats_.named_.downstream_cx_overload_disable_keepalive_.value());
+}
+
 TEST_F(HttpConnectionManagerImplTest, RejectWebSocketOnNonWebSocketRoute) {
   setup(false, "");
 
@@ -720,6 +826,52 @@ TEST_F(HttpConnectionManagerImplTest, WebSocketPrefixRewrite) {
   EXPECT_EQ(0U, stats_.named_.downstream_cx_websocket_active_.value());
 }
 
+// The filters of a WebSocket stream are freed once the upstream connection is up.
+TEST_F(HttpConnectionManagerImplTest, WebSocketReleasesFilters) {
+  setup(false, "");
+  setupFilterChain(1, 1);
+
+  StreamDecoder* decoder = nullptr;
+  NiceMock<MockStreamEncoder> encoder;
+  NiceMock<Network::MockClientConnection>* upstream_connection_ =
+      new NiceMock<Network::MockClientConnection>();
+  Upstream::MockHost::MockCreateConnectionData conn_info;
+
+  conn_info.connection_ = upstream_connection_;
+  conn_info.host_description_.reset(
+      new Upstream::HostImpl(cluster_manager_.thread_local_cluster_.cluster_.info_, "newhost",
+                             Network::Utility::resolveUrl("tcp://127.0.0.1:80"),
+                             envoy::api::v2::Metadata::default_instance(), 1, ""));
+  EXPECT_CALL(cluster_manager_, tcpConnForCluster_("fake_cluster", _)).WillOnce(Return(conn_info));
+
+  ON_CALL(route_config_provider_.route_config_->route_->route_entry_, useWebSocket())
+      .WillByDefault(Return(true));
+
+  EXPECT_CALL(*codec_, dispatch(_)).WillOnce(Invoke([&](Buffer::Instance& data) -> void {
+    decoder = &conn_manager_->newStream(encoder);
+    HeaderMapPtr headers{new TestHeaderMapImpl{{":authority", "host"},
+                                               {":method", "GET"},
+                                               {":path", "/"},
+                                               {"connection", "Upgrade"},
+                                               {"upgrade", "websocket"}}};
+    decoder->decodeHeaders(std::move(headers), true);
+    data.drain(4);
+  }));
+
+  Buffer::OwnedImpl fake_input("1234");
+  conn_manager_->onData(fake_input);
+
+  EXPECT_CALL(*decoder_filters_[0], onDestroy());
+  EXPECT_CALL(*encoder_filters_[0], onDestroy());
+  upstream_connection_->raiseEvent(Network::ConnectionEvent::Connected);
+  EXPECT_EQ(1U, stats_.named_.downstream_cx_websocket_active_.value());
+
+  // The filters are not destroyed again with the stream.
+  filter_callbacks_.connection_.dispatcher_.clearDeferredDeleteList();
+  conn_manager_.reset();
+  EXPECT_EQ(0U, stats_.named_.downstream_cx_websocket_active_.value());
+}
+
 TEST_F(HttpConnectionManagerImplTest, DrainClose) {
   setup(true, "");
 
@@ -764,6 +916,40 @@ TEST_F(HttpConnectionManagerImplTest, DrainClose) {
   EXPECT_EQ(1U, stats_.named_.downstream_rq_3xx_.value());
 }
 
+TEST_F(HttpConnectionManagerImplTest, PipelinedRequests) {
+  setup(false, "");
+  ON_CALL(*codec_, maxPipelineDepth()).WillByDefault(Return(2));
+
+  EXPECT_CALL(filter_factory_, createFilterChain(_))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](FilterChainFactoryCallbacks& callbacks) -> void {
+        MockStreamDecoderFilter* filter = new NiceMock<MockStreamDecoderFilter>();
+        ON_CALL(*filter, decodeHeaders(_, true))
+            .WillByDefault(Return(FilterHeadersStatus::StopIteration));
+        callbacks.addStreamDecoderFilter(StreamDecoderFilterSharedPtr{filter});
+      }));
+
+  NiceMock<MockStreamEncoder> encoder;
+  EXPECT_CALL(*codec_, dispatch(_))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](Buffer::Instance& data) -> void {
+        StreamDecoder* decoder = &conn_manager_->newStream(encoder);
+        HeaderMapPtr headers{new TestHeaderMapImpl{{":authority", "host"}, {":path", "/"}}};
+        decoder->decodeHeaders(std::move(headers), true);
+        data.drain(data.length());
+      }));
+
+  // The first complete request leaves room in the pipeline, so reads continue.
+  EXPECT_CALL(filter_callbacks_.connection_, readDisable(true)).Times(0);
+  Buffer::OwnedImpl fake_input("1234");
+  conn_manager_->onData(fake_input);
+
+  // The second one fills it.
+  EXPECT_CALL(filter_callbacks_.connection_, readDisable(true));
+  fake_input.add("1234");
+  conn_manager_->onData(fake_input);
+}
+
 TEST_F(HttpConnectionManagerImplTest, ResponseBeforeRequestComplete) {
   InSequence s;
   setup(false, "envoy-server-test");
@@ -1619,6 +1805,51 @@ TEST_F(HttpConnectionManagerImplTest, MultipleFilters) {
   EXPECT_EQ(ssl_connection_.get(), encoder_filters_[1]->callbacks_->connection()->ssl());
 }
 
+TEST_F(HttpConnectionManagerImplTest, ConnectionAllocationsRecordedWhenTracked) {
+  if (!Memory::AllocationTracker::enable()) {
+    return;
+  }
+  setup(false, "");
+
+  // Allocate while the codec dispatches, outside of any stream, through a volatile pointer so
+  // that the allocation cannot be optimized away.
+  EXPECT_CALL(*codec_, dispatch(_)).WillOnce(Invoke([](Buffer::Instance& data) -> void {
+    char* volatile allocation = new char[1000];
+    delete[] allocation;
+    data.drain(data.length());
+  }));
+
+  Buffer::OwnedImpl fake_input("1234");
+  conn_manager_->onData(fake_input);
+  conn_manager_.reset();
+
+  Stats::HistogramImpl* allocations = mergedHistogram("downstream_cx_allocations");
+  ASSERT_NE(nullptr, allocations);
+  EXPECT_EQ(1U, allocations->cumulativeStatistics().sampleCount());
+  EXPECT_LE(1U, allocations->cumulativeStatistics().sampleSum());
+
+  Stats::HistogramImpl* bytes = mergedHistogram("downstream_cx_allocated_bytes");
+  ASSERT_NE(nullptr, bytes);
+  EXPECT_EQ(1U, bytes->cumulativeStatistics().sampleCount());
+  EXPECT_LE(1000U, bytes->cumulativeStatistics().sampleSum());
+}
+
+TEST_F(HttpConnectionManagerImplTest, ConnectionAllocationsNotRecordedWhenUntracked) {
+  ASSERT_FALSE(Memory::AllocationTracker::enabled());
+  setup(false, "");
+
+  EXPECT_CALL(*codec_, dispatch(_)).WillOnce(Invoke([](Buffer::Instance& data) -> void {
+    data.drain(data.length());
+  }));
+
+  Buffer::OwnedImpl fake_input("1234");
+  conn_manager_->onData(fake_input);
+  conn_manager_.reset();
+
+  EXPECT_EQ(nullptr, mergedHistogram("downstream_cx_allocations"));
+  EXPECT_EQ(nullptr, mergedHistogram("downstream_cx_allocated_bytes"));
+}
+
 TEST(HttpConnectionManagerTracingStatsTest, verifyTracingStats) {
   Stats::IsolatedStoreImpl stats;
   ConnectionManagerTracingStats tracing_stats{CONN_MAN_TRACING_STATS(POOL_COUNTER(stats))};
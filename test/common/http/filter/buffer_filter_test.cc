@@ -1,21 +1,31 @@
 #include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <string>
 
 #include "envoy/event/dispatcher.h"
 
 #include "common/http/filter/buffer_filter.h"
 #include "common/http/header_map_impl.h"
+#include "common/json/json_loader.h"
 #include "common/stats/stats_impl.h"
 
 #include "test/mocks/buffer/mocks.h"
 #include "test/mocks/http/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/test_common/environment.h"
 #include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
 using testing::DoAll;
 using testing::InSequence;
+using testing::Invoke;
 using testing::NiceMock;
 using testing::Return;
 using testing::SaveArg;
@@ -99,5 +109,166 @@ TEST_F(BufferFilterTest, TxResetAfterEndStream) {
   filter_.onDestroy();
 }
 
+class BufferFilterSpillTest : public testing::Test {
+public:
+  BufferFilterSpillTest() {
+    // The writer thread and the filter post to the same worker, which the test runs in order.
+    const auto post = [this](std::function<void()> callback) -> void {
+      std::unique_lock<std::mutex> guard(lock_);
+      posted_callbacks_.push_back(callback);
+      posted_.notify_one();
+    };
+    ON_CALL(tls_.dispatcher_, post(_)).WillByDefault(Invoke(post));
+    ON_CALL(callbacks_.dispatcher_, post(_)).WillByDefault(Invoke(post));
+  }
+
+  void setup(uint64_t max_request_bytes, const std::string& spill_json) {
+    spill_config_.reset(new BufferSpillConfig(*Json::Factory::loadFromString(spill_json), tls_));
+    config_.reset(new BufferFilterConfig{BufferFilter::generateStats("", store_), max_request_bytes,
+                                         std::chrono::seconds(0), spill_config_});
+    filter_.reset(new BufferFilter(config_));
+    filter_->setDecoderFilterCallbacks(callbacks_);
+    new NiceMock<Event::MockTimer>(&callbacks_.dispatcher_);
+    TestHeaderMapImpl headers;
+    EXPECT_EQ(FilterHeadersStatus::StopIteration, filter_->decodeHeaders(headers, false));
+  }
+
+  // Wait for the writer thread to post a completion, then run it on the test thread.
+  void runPostedCallback() {
+    std::function<void()> callback;
+    {
+      std::unique_lock<std::mutex> guard(lock_);
+      posted_.wait(guard, [this]() -> bool { return !posted_callbacks_.empty(); });
+      callback = posted_callbacks_.front();
+      posted_callbacks_.pop_front();
+    }
+    callback();
+  }
+
+  std::string directoryJson() {
+    return "\"directory\": \"" + TestEnvironment::temporaryDirectory() + "\"";
+  }
+
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  NiceMock<MockStreamDecoderFilterCallbacks> callbacks_;
+  Stats::IsolatedStoreImpl store_;
+  BufferSpillConfigSharedPtr spill_config_;
+  std::shared_ptr<BufferFilterConfig> config_;
+  std::unique_ptr<BufferFilter> filter_;
+  std::mutex lock_;
+  std::condition_variable posted_;
+  std::list<std::function<void()>> posted_callbacks_;
+};
+
+TEST_F(BufferFilterSpillTest, BodyInMemory) {
+  setup(1024, "{" + directoryJson() + "}");
+
+  Buffer::OwnedImpl data1("hello");
+  EXPECT_EQ(FilterDataStatus::StopIterationNoBuffer, filter_->decodeData(data1, false));
+  EXPECT_EQ(5U, spill_config_->memoryBytes());
+
+  Buffer::OwnedImpl data2(" world");
+  EXPECT_EQ(FilterDataStatus::Continue, filter_->decodeData(data2, true));
+  EXPECT_EQ("hello world", TestUtility::bufferToString(data2));
+  EXPECT_EQ(0U, spill_config_->memoryBytes());
+  EXPECT_EQ(0U, config_->stats_.rq_spilled_.value());
+  filter_->onDestroy();
+}
+
+TEST_F(BufferFilterSpillTest, SpillToDisk) {
+  setup(1024, "{\"stream_memory_bytes\": 5, " + directoryJson() + "}");
+
+  Buffer::OwnedImpl data1("hello");
+  EXPECT_EQ(FilterDataStatus::StopIterationNoBuffer, filter_->decodeData(data1, false));
+
+  // The queued write takes more than the memory of the stream, so the downstream stops reading
+  // until it is done.
+  EXPECT_CALL(callbacks_, onDecoderFilterAboveWriteBufferHighWatermark());
+  Buffer::OwnedImpl data2(" world");
+  EXPECT_EQ(FilterDataStatus::StopIterationNoBuffer, filter_->decodeData(data2, false));
+  EXPECT_EQ(1U, config_->stats_.rq_spilled_.value());
+  EXPECT_CALL(callbacks_, onDecoderFilterBelowWriteBufferLowWatermark());
+  runPostedCallback();
+  EXPECT_EQ(6U, config_->stats_.spilled_bytes_.value());
+
+  // The rest of the body follows the spilled data, even though it would fit in memory.
+  Buffer::OwnedImpl data3("!");
+  EXPECT_EQ(FilterDataStatus::StopIterationNoBuffer, filter_->decodeData(data3, true));
+  EXPECT_EQ(5U, spill_config_->memoryBytes());
+
+  InSequence s;
+  EXPECT_CALL(callbacks_, addDecodedData(_, false))
+      .WillOnce(Invoke([](Buffer::Instance& data, bool) -> void {
+        EXPECT_EQ("hello world!", TestUtility::bufferToString(data));
+      }));
+  EXPECT_CALL(callbacks_, continueDecoding());
+  runPostedCallback();
+  EXPECT_EQ(0U, spill_config_->memoryBytes());
+  filter_->onDestroy();
+}
+
+TEST_F(BufferFilterSpillTest, SpillWithTrailers) {
+  setup(1024, "{\"max_memory_bytes\": 1, " + directoryJson() + "}");
+
+  // The memory budget of the filter has no room for the body.
+  Buffer::OwnedImpl data("hello");
+  EXPECT_EQ(FilterDataStatus::StopIterationNoBuffer, filter_->decodeData(data, false));
+  EXPECT_EQ(0U, spill_config_->memoryBytes());
+  runPostedCallback();
+
+  TestHeaderMapImpl trailers;
+  EXPECT_EQ(FilterTrailersStatus::StopIteration, filter_->decodeTrailers(trailers));
+  InSequence s;
+  EXPECT_CALL(callbacks_, addDecodedData(_, false))
+      .WillOnce(Invoke([](Buffer::Instance& data, bool) -> void {
+        EXPECT_EQ("hello", TestUtility::bufferToString(data));
+      }));
+  EXPECT_CALL(callbacks_, continueDecoding());
+  runPostedCallback();
+  filter_->onDestroy();
+}
+
+TEST_F(BufferFilterSpillTest, DestroyWithPendingWrite) {
+  setup(1024, "{\"stream_memory_bytes\": 0, " + directoryJson() + "}");
+
+  Buffer::OwnedImpl data("hello");
+  EXPECT_EQ(FilterDataStatus::StopIterationNoBuffer, filter_->decodeData(data, true));
+  filter_->onDestroy();
+  filter_.reset();
+
+  // The completion of the write does not touch the filter.
+  EXPECT_CALL(callbacks_, continueDecoding()).Times(0);
+  runPostedCallback();
+}
+
+TEST_F(BufferFilterSpillTest, RequestTooLarge) {
+  setup(8, "{" + directoryJson() + "}");
+
+  Buffer::OwnedImpl data1("hello");
+  EXPECT_EQ(FilterDataStatus::StopIterationNoBuffer, filter_->decodeData(data1, false));
+
+  TestHeaderMapImpl response_headers{
+      {":status", "413"}, {"content-length", "17"}, {"content-type", "text/plain"}};
+  EXPECT_CALL(callbacks_, encodeHeaders_(HeaderMapEqualRef(&response_headers), false));
+  Buffer::OwnedImpl data2(" world");
+  EXPECT_EQ(FilterDataStatus::StopIterationNoBuffer, filter_->decodeData(data2, false));
+  EXPECT_EQ(1U, config_->stats_.rq_too_large_.value());
+  EXPECT_EQ(0U, spill_config_->memoryBytes());
+  filter_->onDestroy();
+}
+
+TEST_F(BufferFilterSpillTest, SpillError) {
+  setup(1024, "{\"stream_memory_bytes\": 0, \"directory\": \"/nonexistent/directory\"}");
+
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, false))
+      .WillOnce(Invoke([](HeaderMap& headers, bool) -> void {
+        EXPECT_STREQ("500", headers.Status()->value().c_str());
+      }));
+  Buffer::OwnedImpl data("hello");
+  EXPECT_EQ(FilterDataStatus::StopIterationNoBuffer, filter_->decodeData(data, false));
+  EXPECT_EQ(1U, config_->stats_.spill_error_.value());
+  filter_->onDestroy();
+}
+
 } // namespace Http
 } // namespace Envoy
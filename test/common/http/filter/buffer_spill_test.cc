@@ -0,0 +1,111 @@
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/http/filter/buffer_spill.h"
+#include "common/json/json_loader.h"
+
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/test_common/environment.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::Invoke;
+using testing::NiceMock;
+using testing::_;
+
+namespace Envoy {
+namespace Http {
+
+TEST(SpillFileTest, WriteAndMap) {
+  SpillFileSharedPtr file = SpillFile::create(TestEnvironment::temporaryDirectory());
+  ASSERT_NE(nullptr, file);
+
+  Buffer::OwnedImpl data1("hello");
+  EXPECT_TRUE(file->write(data1));
+  Buffer::OwnedImpl data2;
+  data2.add(" ");
+  data2.add("world");
+  EXPECT_TRUE(file->write(data2));
+
+  Buffer::OwnedImpl mapped("> ");
+  EXPECT_TRUE(file->mapInto(mapped, 11));
+  EXPECT_EQ("> hello world", TestUtility::bufferToString(mapped));
+
+  // The mapping outlives the file.
+  file.reset();
+  Buffer::OwnedImpl moved;
+  moved.move(mapped);
+  EXPECT_EQ("> hello world", TestUtility::bufferToString(moved));
+
+  Buffer::OwnedImpl empty;
+  EXPECT_TRUE(SpillFile::create(TestEnvironment::temporaryDirectory())->mapInto(empty, 0));
+  EXPECT_EQ(0U, empty.length());
+}
+
+TEST(SpillFileTest, BadDirectory) {
+  EXPECT_EQ(nullptr, SpillFile::create("/nonexistent/directory"));
+}
+
+TEST(SpillWriterTest, WritesInOrder) {
+  NiceMock<Event::MockDispatcher> dispatcher;
+  std::mutex lock;
+  std::condition_variable posted;
+  std::list<std::function<void()>> callbacks;
+  ON_CALL(dispatcher, post(_)).WillByDefault(Invoke([&](std::function<void()> callback) -> void {
+    std::unique_lock<std::mutex> guard(lock);
+    callbacks.push_back(callback);
+    posted.notify_one();
+  }));
+
+  SpillFileSharedPtr file = SpillFile::create(TestEnvironment::temporaryDirectory());
+  std::string completions;
+  {
+    SpillWriter writer(dispatcher);
+    for (const std::string& chunk : {"a", "bc", "def"}) {
+      Buffer::OwnedImpl data(chunk);
+      writer.write(file, data, [&completions, chunk](bool success) -> void {
+        EXPECT_TRUE(success);
+        completions += chunk;
+      });
+      EXPECT_EQ(0U, data.length());
+    }
+
+    // The completions only run on the dispatcher.
+    std::unique_lock<std::mutex> guard(lock);
+    posted.wait(guard, [&callbacks]() -> bool { return callbacks.size() == 3; });
+    EXPECT_EQ("", completions);
+  }
+  for (const auto& callback : callbacks) {
+    callback();
+  }
+  EXPECT_EQ("abcdef", completions);
+
+  Buffer::OwnedImpl mapped;
+  EXPECT_TRUE(file->mapInto(mapped, 6));
+  EXPECT_EQ("abcdef", TestUtility::bufferToString(mapped));
+}
+
+TEST(BufferSpillConfigTest, MemoryBudget) {
+  NiceMock<ThreadLocal::MockInstance> tls;
+  BufferSpillConfig config(*Json::Factory::loadFromString("{\"max_memory_bytes\": 10}"), tls);
+  EXPECT_EQ("/tmp", config.directory_);
+  EXPECT_EQ(64U * 1024, config.stream_memory_bytes_);
+
+  EXPECT_TRUE(config.reserveMemory(6));
+  EXPECT_FALSE(config.reserveMemory(5));
+  EXPECT_TRUE(config.reserveMemory(4));
+  EXPECT_EQ(10U, config.memoryBytes());
+  config.releaseMemory(6);
+  EXPECT_TRUE(config.reserveMemory(5));
+  EXPECT_EQ(9U, config.memoryBytes());
+}
+
+} // namespace Http
+} // namespace Envoy
@@ -0,0 +1,382 @@
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/http/filter/cache_filter.h"
+#include "common/http/header_map_impl.h"
+#include "common/json/json_loader.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/http/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::Invoke;
+using testing::NiceMock;
+using testing::_;
+
+namespace Envoy {
+namespace Http {
+
+class TestTimeSource : public MonotonicTimeSource {
+public:
+  MonotonicTime currentTime() override { return time_; }
+
+  MonotonicTime time_;
+};
+
+TEST(CacheControlTest, Directives) {
+  CacheControl max_age("max-age=10");
+  EXPECT_EQ(std::chrono::seconds(10), max_age.max_age_.value());
+  EXPECT_FALSE(max_age.no_store_);
+
+  CacheControl s_maxage("Public, S-MaxAge=\"20\" ,max-age=10");
+  EXPECT_EQ(std::chrono::seconds(20), s_maxage.max_age_.value());
+
+  CacheControl no_store("no-store, no-cache=\"set-cookie\", private");
+  EXPECT_TRUE(no_store.no_store_);
+  EXPECT_TRUE(no_store.no_cache_);
+  EXPECT_TRUE(no_store.private_);
+  EXPECT_FALSE(no_store.max_age_.valid());
+
+  EXPECT_FALSE(CacheControl("max-age=forever").max_age_.valid());
+  EXPECT_FALSE(CacheControl("").max_age_.valid());
+}
+
+TEST(CacheFilterCacheableTest, Cacheable) {
+  std::chrono::seconds lifetime;
+  EXPECT_TRUE(CacheFilter::cacheable(
+      TestHeaderMapImpl{{":status", "200"}, {"cache-control", "max-age=10"}}, lifetime));
+  EXPECT_EQ(std::chrono::seconds(10), lifetime);
+
+  EXPECT_FALSE(CacheFilter::cacheable(TestHeaderMapImpl{{":status", "200"}}, lifetime));
+  EXPECT_FALSE(CacheFilter::cacheable(
+      TestHeaderMapImpl{{":status", "404"}, {"cache-control", "max-age=10"}}, lifetime));
+  EXPECT_FALSE(CacheFilter::cacheable(
+      TestHeaderMapImpl{{":status", "200"}, {"cache-control", "max-age=0"}}, lifetime));
+  EXPECT_FALSE(CacheFilter::cacheable(
+      TestHeaderMapImpl{{":status", "200"}, {"cache-control", "private, max-age=10"}}, lifetime));
+  EXPECT_FALSE(CacheFilter::cacheable(
+      TestHeaderMapImpl{{":status", "200"}, {"cache-control", "max-age=10"}, {"set-cookie", "a"}},
+      lifetime));
+  EXPECT_FALSE(CacheFilter::cacheable(
+      TestHeaderMapImpl{{":status", "200"}, {"cache-control", "max-age=10"}, {"vary", "a, *"}},
+      lifetime));
+}
+
+class CacheFilterTest : public testing::Test {
+public:
+  CacheFilterTest() { setup("{}"); }
+
+  void setup(const std::string& json) {
+    config_.reset(new CacheFilterConfig(*Json::Factory::loadFromString(json), "", store_, tls_,
+                                        time_source_));
+  }
+
+  struct TestFilter {
+    TestFilter(CacheFilterConfigSharedPtr config) : filter_(config) {
+      filter_.setDecoderFilterCallbacks(decoder_callbacks_);
+      filter_.setEncoderFilterCallbacks(encoder_callbacks_);
+    }
+
+    NiceMock<MockStreamDecoderFilterCallbacks> decoder_callbacks_;
+    NiceMock<MockStreamEncoderFilterCallbacks> encoder_callbacks_;
+    CacheFilter filter_;
+  };
+
+  typedef std::unique_ptr<TestFilter> TestFilterPtr;
+
+  TestFilterPtr filter() { return TestFilterPtr{new TestFilter(config_)}; }
+
+  // Fill the cache with a response to a request.
+  void fill(const HeaderMap& request, const HeaderMap& response, const std::string& body) {
+    TestHeaderMapImpl request_headers(request);
+    TestHeaderMapImpl response_headers(response);
+    TestFilterPtr test_filter = filter();
+    EXPECT_EQ(FilterHeadersStatus::Continue,
+              test_filter->filter_.decodeHeaders(request_headers, true));
+    EXPECT_EQ(FilterHeadersStatus::Continue,
+              test_filter->filter_.encodeHeaders(response_headers, body.empty()));
+    if (!body.empty()) {
+      Buffer::OwnedImpl data(body);
+      EXPECT_EQ(FilterDataStatus::Continue, test_filter->filter_.encodeData(data, true));
+    }
+    test_filter->filter_.onDestroy();
+  }
+
+  // Expect a request to be served from the cache.
+  void expectHit(const HeaderMap& request, const std::string& status, const std::string& age,
+                 const std::string& body) {
+    TestHeaderMapImpl request_headers(request);
+    TestFilterPtr test_filter = filter();
+    EXPECT_CALL(test_filter->decoder_callbacks_, encodeHeaders_(_, body.empty()))
+        .WillOnce(Invoke([&](HeaderMap& headers, bool) -> void {
+          EXPECT_STREQ(status.c_str(), headers.Status()->value().c_str());
+          EXPECT_STREQ(age.c_str(), headers.get(Headers::get().Age)->value().c_str());
+        }));
+    if (!body.empty()) {
+      EXPECT_CALL(test_filter->decoder_callbacks_, encodeData(_, true))
+          .WillOnce(Invoke([&](Buffer::Instance& data, bool) -> void {
+            EXPECT_EQ(body, TestUtility::bufferToString(data));
+          }));
+    }
+    EXPECT_EQ(FilterHeadersStatus::StopIteration,
+              test_filter->filter_.decodeHeaders(request_headers, true));
+    test_filter->filter_.onDestroy();
+  }
+
+  void expectMiss(const HeaderMap& request) {
+    TestHeaderMapImpl request_headers(request);
+    TestFilterPtr test_filter = filter();
+    EXPECT_CALL(test_filter->decoder_callbacks_, encodeHeaders_(_, _)).Times(0);
+    EXPECT_EQ(FilterHeadersStatus::Continue,
+              test_filter->filter_.decodeHeaders(request_headers, true));
+    test_filter->filter_.onDestroy();
+  }
+
+  static TestHeaderMapImpl requestHeaders() {
+    return TestHeaderMapImpl{{":method", "GET"}, {":authority", "host"}, {":path", "/"}};
+  }
+
+  static TestHeaderMapImpl responseHeaders() {
+    return TestHeaderMapImpl{
+        {":status", "200"}, {"cache-control", "max-age=10"}, {"etag", "\"v1\""}};
+  }
+
+  TestHeaderMapImpl request_headers_ = requestHeaders();
+  TestHeaderMapImpl response_headers_ = responseHeaders();
+  Stats::IsolatedStoreImpl store_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  TestTimeSource time_source_;
+  CacheFilterConfigSharedPtr config_;
+};
+
+TEST_F(CacheFilterTest, MissThenHit) {
+  fill(request_headers_, response_headers_, "hello");
+  EXPECT_EQ(1U, config_->stats().miss_.value());
+  EXPECT_EQ(1U, config_->stats().insert_.value());
+  EXPECT_EQ(1U, config_->cache().size());
+
+  expectHit(request_headers_, "200", "0", "hello");
+  EXPECT_EQ(1U, config_->stats().hit_.value());
+
+  // The key is the host and the path.
+  expectMiss(TestHeaderMapImpl{{":method", "GET"}, {":authority", "other"}, {":path", "/"}});
+  expectMiss(TestHeaderMapImpl{{":method", "GET"}, {":authority", "host"}, {":path", "/other"}});
+}
+
+TEST_F(CacheFilterTest, HeaderOnlyResponse) {
+  fill(request_headers_, response_headers_, "");
+  expectHit(request_headers_, "200", "0", "");
+}
+
+TEST_F(CacheFilterTest, AgeAndExpiration) {
+  TestHeaderMapImpl response_headers{{":status", "200"}, {"cache-control", "max-age=10"},
+                                     {"age", "3"}};
+  fill(request_headers_, response_headers, "hello");
+
+  time_source_.time_ += std::chrono::seconds(5);
+  expectHit(request_headers_, "200", "8", "hello");
+
+  time_source_.time_ += std::chrono::seconds(2);
+  expectMiss(request_headers_);
+  EXPECT_EQ(0U, config_->cache().size());
+  EXPECT_EQ(0U, config_->cache().bytes());
+  EXPECT_EQ(0U, config_->stats().bytes_.value());
+}
+
+TEST_F(CacheFilterTest, NotModified) {
+  fill(request_headers_, response_headers_, "hello");
+
+  TestHeaderMapImpl matching_request = requestHeaders();
+  matching_request.addCopy("if-none-match", "\"v0\", \"v1\"");
+  expectHit(matching_request, "304", "0", "");
+
+  TestHeaderMapImpl other_request = requestHeaders();
+  other_request.addCopy("if-none-match", "\"v0\"");
+  expectHit(other_request, "200", "0", "hello");
+}
+
+TEST_F(CacheFilterTest, Vary) {
+  TestHeaderMapImpl response_headers = responseHeaders();
+  response_headers.addCopy("vary", "Accept-Encoding, Accept");
+  TestHeaderMapImpl request_headers = requestHeaders();
+  request_headers.addCopy("accept-encoding", "gzip");
+  fill(request_headers, response_headers, "hello");
+
+  expectHit(request_headers, "200", "0", "hello");
+  expectMiss(request_headers_);
+
+  TestHeaderMapImpl other_request_headers = requestHeaders();
+  other_request_headers.addCopy("accept-encoding", "br");
+  expectMiss(other_request_headers);
+
+  request_headers.addCopy("accept", "text/plain");
+  expectMiss(request_headers);
+}
+
+TEST_F(CacheFilterTest, NotCached) {
+  // The request does not accept a cached response, but its response fills the cache.
+  TestHeaderMapImpl no_cache_request = requestHeaders();
+  no_cache_request.addCopy("cache-control", "no-cache");
+  fill(no_cache_request, response_headers_, "hello");
+  expectHit(request_headers_, "200", "0", "hello");
+  expectMiss(no_cache_request);
+
+  TestFilterPtr test_filter = filter();
+  TestHeaderMapImpl no_store_request = requestHeaders();
+  no_store_request.addCopy("cache-control", "no-store");
+  EXPECT_EQ(FilterHeadersStatus::Continue,
+            test_filter->filter_.decodeHeaders(no_store_request, true));
+
+  TestHeaderMapImpl authorized_request = requestHeaders();
+  authorized_request.addCopy("authorization", "secret");
+  EXPECT_EQ(FilterHeadersStatus::Continue,
+            test_filter->filter_.decodeHeaders(authorized_request, true));
+
+  TestHeaderMapImpl post_request{{":method", "POST"}, {":authority", "host"}, {":path", "/"}};
+  EXPECT_EQ(FilterHeadersStatus::Continue, test_filter->filter_.decodeHeaders(post_request, true));
+  EXPECT_EQ(FilterHeadersStatus::Continue,
+            test_filter->filter_.decodeHeaders(request_headers_, false));
+  EXPECT_EQ(1U, config_->stats().hit_.value());
+}
+
+TEST_F(CacheFilterTest, ResponseNotCached) {
+  TestHeaderMapImpl request_headers{{":method", "GET"}, {":authority", "host"}, {":path", "/a"}};
+  fill(request_headers,
+       TestHeaderMapImpl{{":status", "200"}, {"cache-control", "no-store, max-age=10"}}, "hello");
+  expectMiss(request_headers);
+
+  // Responses with trailers or over the entry limit are not cached.
+  setup("{\"max_entry_bytes\": 4}");
+  fill(request_headers, response_headers_, "hello");
+  expectMiss(request_headers);
+
+  TestFilterPtr test_filter = filter();
+  test_filter->filter_.decodeHeaders(request_headers, true);
+  test_filter->filter_.encodeHeaders(response_headers_, false);
+  Buffer::OwnedImpl data("hey");
+  test_filter->filter_.encodeData(data, false);
+  TestHeaderMapImpl trailers{{"grpc-status", "0"}};
+  EXPECT_EQ(FilterTrailersStatus::Continue, test_filter->filter_.encodeTrailers(trailers));
+  test_filter->filter_.onDestroy();
+  expectMiss(request_headers);
+  EXPECT_EQ(0U, config_->stats().insert_.value());
+}
+
+TEST_F(CacheFilterTest, CoalesceMisses) {
+  TestFilterPtr filling = filter();
+  EXPECT_EQ(FilterHeadersStatus::Continue, filling->filter_.decodeHeaders(request_headers_, true));
+
+  TestFilterPtr waiting1 = filter();
+  TestFilterPtr waiting2 = filter();
+  TestFilterPtr waiting3 = filter();
+  EXPECT_EQ(FilterHeadersStatus::StopIteration,
+            waiting1->filter_.decodeHeaders(request_headers_, true));
+  EXPECT_EQ(FilterHeadersStatus::StopIteration,
+            waiting2->filter_.decodeHeaders(request_headers_, true));
+  EXPECT_EQ(FilterHeadersStatus::StopIteration,
+            waiting3->filter_.decodeHeaders(request_headers_, true));
+  EXPECT_EQ(3U, config_->stats().coalesced_.value());
+  waiting2->filter_.onDestroy();
+
+  // The waiters are called back on a later dispatcher iteration.
+  Event::MockTimer* timer = new Event::MockTimer(&tls_.dispatcher_);
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(0)));
+  filling->filter_.encodeHeaders(response_headers_, true);
+  filling->filter_.onDestroy();
+
+  // The first waiter to be served resets the other one.
+  EXPECT_CALL(waiting1->decoder_callbacks_, encodeHeaders_(_, true))
+      .WillOnce(Invoke([&](HeaderMap&, bool) -> void { waiting3->filter_.onDestroy(); }));
+  EXPECT_CALL(waiting2->decoder_callbacks_, encodeHeaders_(_, _)).Times(0);
+  EXPECT_CALL(waiting3->decoder_callbacks_, encodeHeaders_(_, _)).Times(0);
+  timer->callback_();
+  waiting1->filter_.onDestroy();
+  EXPECT_EQ(1U, config_->stats().hit_.value());
+  EXPECT_EQ(1U, config_->stats().miss_.value());
+}
+
+TEST_F(CacheFilterTest, CoalescedMissNotCached) {
+  TestFilterPtr filling = filter();
+  filling->filter_.decodeHeaders(request_headers_, true);
+  TestFilterPtr waiting = filter();
+  EXPECT_EQ(FilterHeadersStatus::StopIteration,
+            waiting->filter_.decodeHeaders(request_headers_, true));
+
+  Event::MockTimer* timer = new Event::MockTimer(&tls_.dispatcher_);
+  EXPECT_CALL(*timer, enableTimer(_));
+  TestHeaderMapImpl response_headers{{":status", "500"}};
+  filling->filter_.encodeHeaders(response_headers, true);
+
+  // The waiter goes upstream on its own, without filling the cache again.
+  EXPECT_CALL(waiting->decoder_callbacks_, continueDecoding());
+  timer->callback_();
+  EXPECT_EQ(2U, config_->stats().miss_.value());
+
+  TestFilterPtr next = filter();
+  EXPECT_EQ(FilterHeadersStatus::Continue, next->filter_.decodeHeaders(request_headers_, true));
+  next->filter_.onDestroy();
+  waiting->filter_.onDestroy();
+  filling->filter_.onDestroy();
+}
+
+TEST_F(CacheFilterTest, FillingRequestReset) {
+  TestFilterPtr filling = filter();
+  filling->filter_.decodeHeaders(request_headers_, true);
+  filling->filter_.onDestroy();
+
+  expectMiss(request_headers_);
+  EXPECT_EQ(2U, config_->stats().miss_.value());
+}
+
+TEST(ResponseCacheTest, Eviction) {
+  Stats::IsolatedStoreImpl store;
+  std::string prefix;
+  CacheFilterStats stats{ALL_CACHE_FILTER_STATS(POOL_COUNTER_PREFIX(store, prefix),
+                                                POOL_GAUGE_PREFIX(store, prefix))};
+  NiceMock<Event::MockDispatcher> dispatcher;
+
+  const auto response = [](const std::string& body) -> CachedResponseConstSharedPtr {
+    std::shared_ptr<CachedResponse> response(new CachedResponse());
+    response->headers_.reset(new TestHeaderMapImpl{{":status", "200"}});
+    response->body_ = std::make_shared<const std::string>(body);
+    response->initial_age_ = std::chrono::seconds(0);
+    response->freshness_lifetime_ = std::chrono::seconds(10);
+    return response;
+  };
+  const uint64_t entry_bytes = ResponseCache::responseBytes("a", *response("hello"));
+  ResponseCache cache(2 * entry_bytes, stats, dispatcher);
+  TestHeaderMapImpl request_headers;
+  MonotonicTime now;
+
+  cache.insert("a", response("hello"));
+  cache.insert("b", response("hello"));
+  EXPECT_EQ(2 * entry_bytes, cache.bytes());
+  EXPECT_EQ(2 * entry_bytes, stats.bytes_.value());
+
+  // A hit makes an entry the most recently used.
+  EXPECT_NE(nullptr, cache.lookup("a", request_headers, now));
+  cache.insert("c", response("hello"));
+  EXPECT_EQ(1U, stats.evict_.value());
+  EXPECT_NE(nullptr, cache.lookup("a", request_headers, now));
+  EXPECT_EQ(nullptr, cache.lookup("b", request_headers, now));
+  EXPECT_NE(nullptr, cache.lookup("c", request_headers, now));
+
+  // A response that does not fit is not inserted, a replaced one does not count as evicted.
+  cache.insert("d", response(std::string(2 * entry_bytes, 'a')));
+  EXPECT_EQ(nullptr, cache.lookup("d", request_headers, now));
+  cache.insert("a", response("world"));
+  EXPECT_EQ(2U, cache.size());
+  EXPECT_EQ(1U, stats.evict_.value());
+  EXPECT_EQ("world", *cache.lookup("a", request_headers, now)->body_);
+}
+
+} // namespace Http
+} // namespace Envoy
@@ -13,8 +13,10 @@
 #include "common/stats/stats_impl.h"
 
 #include "test/common/http/common.h"
+#include "test/mocks/common.h"
 #include "test/mocks/http/mocks.h"
 #include "test/mocks/runtime/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
 #include "test/test_common/printers.h"
 #include "test/test_common/utility.h"
 
@@ -25,6 +27,7 @@ using testing::DoAll;
 using testing::Invoke;
 using testing::NiceMock;
 using testing::Return;
+using testing::ReturnPointee;
 using testing::ReturnRef;
 using testing::WithArgs;
 using testing::_;
@@ -113,17 +116,30 @@ public:
 
   void SetUpTest(const std::string json) {
     Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
-    config_.reset(new FaultFilterConfig(*config, runtime_, "prefix.", stats_));
+    ON_CALL(time_source_, currentTime()).WillByDefault(ReturnPointee(&now_));
+    // The delay timer of the worker is created with the configuration.
+    timer_ = new Event::MockTimer(&tls_.dispatcher_);
+    config_.reset(new FaultFilterConfig(*config, runtime_, "prefix.", stats_, tls_, time_source_));
     filter_.reset(new FaultFilter(config_));
     filter_->setDecoderFilterCallbacks(filter_callbacks_);
   }
 
   void expectDelayTimer(uint64_t duration_ms) {
-    timer_ = new Event::MockTimer(&filter_callbacks_.dispatcher_);
-    EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(duration_ms)));
+    delay_ = std::chrono::milliseconds(duration_ms);
+    EXPECT_CALL(*timer_, enableTimer(delay_));
     EXPECT_CALL(*timer_, disableTimer());
   }
 
+  // Let the expected delay pass and fire the delay timer.
+  void fireDelayTimer() {
+    now_ += delay_;
+    fireDelayTimer();
+  }
+
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  MonotonicTime now_;
+  std::chrono::milliseconds delay_{};
   FaultFilterConfigSharedPtr config_;
   std::unique_ptr<FaultFilter> filter_;
   NiceMock<MockStreamDecoderFilterCallbacks> filter_callbacks_;
@@ -138,7 +154,9 @@ void faultFilterBadConfigHelper(const std::string& json) {
   Stats::IsolatedStoreImpl stats;
   Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
   NiceMock<Runtime::MockLoader> runtime;
-  EXPECT_THROW(FaultFilterConfig(*config, runtime, "", stats), EnvoyException);
+  NiceMock<ThreadLocal::MockInstance> tls;
+  NiceMock<MockMonotonicTimeSource> time_source;
+  EXPECT_THROW(FaultFilterConfig(*config, runtime, "", stats, tls, time_source), EnvoyException);
 }
 
 TEST(FaultFilterBadConfigTest, EmptyConfig) {
@@ -340,7 +358,7 @@ TEST_F(FaultFilterTest, FixedDelayNonZeroDuration) {
 
   EXPECT_EQ(FilterDataStatus::StopIterationAndWatermark, filter_->decodeData(data_, false));
   EXPECT_EQ(FilterTrailersStatus::StopIteration, filter_->decodeTrailers(request_headers_));
-  timer_->callback_();
+  fireDelayTimer();
 
   EXPECT_EQ(1UL, config_->stats().delays_injected_.value());
   EXPECT_EQ(0UL, config_->stats().aborts_injected_.value());
@@ -384,7 +402,7 @@ TEST_F(FaultFilterTest, DelayForDownstreamCluster) {
   EXPECT_CALL(filter_callbacks_, continueDecoding());
   EXPECT_EQ(FilterDataStatus::StopIterationAndWatermark, filter_->decodeData(data_, false));
 
-  timer_->callback_();
+  fireDelayTimer();
 
   EXPECT_EQ(FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers_));
 
@@ -438,7 +456,7 @@ TEST_F(FaultFilterTest, FixedDelayAndAbortDownstream) {
 
   EXPECT_CALL(filter_callbacks_, continueDecoding()).Times(0);
 
-  timer_->callback_();
+  fireDelayTimer();
 
   EXPECT_EQ(FilterDataStatus::Continue, filter_->decodeData(data_, false));
   EXPECT_EQ(FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers_));
@@ -484,7 +502,7 @@ TEST_F(FaultFilterTest, FixedDelayAndAbort) {
 
   EXPECT_CALL(filter_callbacks_, continueDecoding()).Times(0);
 
-  timer_->callback_();
+  fireDelayTimer();
 
   EXPECT_EQ(FilterDataStatus::Continue, filter_->decodeData(data_, false));
   EXPECT_EQ(FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers_));
@@ -526,7 +544,7 @@ TEST_F(FaultFilterTest, FixedDelayAndAbortDownstreamNodes) {
 
   EXPECT_CALL(filter_callbacks_, continueDecoding()).Times(0);
 
-  timer_->callback_();
+  fireDelayTimer();
 
   EXPECT_EQ(FilterDataStatus::Continue, filter_->decodeData(data_, false));
   EXPECT_EQ(FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers_));
@@ -573,7 +591,7 @@ TEST_F(FaultFilterTest, FixedDelayAndAbortHeaderMatchSuccess) {
 
   EXPECT_CALL(filter_callbacks_, continueDecoding()).Times(0);
 
-  timer_->callback_();
+  fireDelayTimer();
 
   EXPECT_EQ(FilterDataStatus::Continue, filter_->decodeData(data_, false));
   EXPECT_EQ(FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers_));
@@ -616,7 +634,6 @@ TEST_F(FaultFilterTest, TimerResetAfterStreamReset) {
       .WillOnce(Return(5000UL));
 
   SCOPED_TRACE("FixedDelayWithStreamReset");
-  timer_ = new Event::MockTimer(&filter_callbacks_.dispatcher_);
   EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(5000UL)));
 
   EXPECT_CALL(filter_callbacks_.request_info_,
@@ -645,6 +662,45 @@ TEST_F(FaultFilterTest, TimerResetAfterStreamReset) {
   filter_->onDestroy();
 }
 
+// The delayed requests of a worker share a timer armed for the earliest deadline.
+TEST_F(FaultFilterTest, SharedDelayTimer) {
+  SetUpTest(fixed_delay_only_json);
+  ON_CALL(runtime_.snapshot_, featureEnabled("fault.http.delay.fixed_delay_percent", 100))
+      .WillByDefault(Return(true));
+  EXPECT_CALL(runtime_.snapshot_, getInteger("fault.http.delay.fixed_duration_ms", 5000))
+      .WillOnce(Return(5000UL))
+      .WillOnce(Return(1000UL));
+
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(5000)));
+  EXPECT_EQ(FilterHeadersStatus::StopIteration, filter_->decodeHeaders(request_headers_, false));
+
+  // A request that ends before the first one re-arms the timer.
+  now_ += std::chrono::milliseconds(2000);
+  NiceMock<MockStreamDecoderFilterCallbacks> second_callbacks;
+  FaultFilter second_filter(config_);
+  second_filter.setDecoderFilterCallbacks(second_callbacks);
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(1000)));
+  EXPECT_EQ(FilterHeadersStatus::StopIteration,
+            second_filter.decodeHeaders(request_headers_, false));
+  EXPECT_EQ(2UL, config_->threadLocalState().delays());
+
+  // Only the requests whose delay has passed continue.
+  now_ += std::chrono::milliseconds(1000);
+  EXPECT_CALL(second_callbacks, continueDecoding());
+  EXPECT_CALL(filter_callbacks_, continueDecoding()).Times(0);
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(2000)));
+  timer_->callback_();
+  EXPECT_EQ(FilterTrailersStatus::Continue, second_filter.decodeTrailers(request_headers_));
+  EXPECT_EQ(FilterTrailersStatus::StopIteration, filter_->decodeTrailers(request_headers_));
+  second_filter.onDestroy();
+
+  // Resetting the last delayed stream disables the timer.
+  EXPECT_CALL(*timer_, disableTimer());
+  filter_->onDestroy();
+  EXPECT_EQ(0UL, config_->threadLocalState().delays());
+  EXPECT_EQ(2UL, config_->stats().delays_injected_.value());
+}
+
 TEST_F(FaultFilterTest, FaultWithTargetClusterMatchSuccess) {
   SetUpTest(fault_with_target_cluster_json);
   const std::string upstream_cluster("www1");
@@ -677,7 +733,7 @@ TEST_F(FaultFilterTest, FaultWithTargetClusterMatchSuccess) {
               setResponseFlag(Http::AccessLog::ResponseFlag::FaultInjected))
       .Times(0);
   EXPECT_CALL(filter_callbacks_, continueDecoding());
-  timer_->callback_();
+  fireDelayTimer();
 
   EXPECT_EQ(FilterDataStatus::Continue, filter_->decodeData(data_, false));
   EXPECT_EQ(FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers_));
@@ -0,0 +1,246 @@
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/http/filter/gzip_filter.h"
+#include "common/http/header_map_impl.h"
+#include "common/json/json_loader.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/http/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zlib.h"
+
+using testing::Invoke;
+using testing::NiceMock;
+using testing::_;
+
+namespace Envoy {
+namespace Http {
+
+// Every call takes 5us, so that each compression takes 5us.
+class TestTimeSource : public MonotonicTimeSource {
+public:
+  MonotonicTime currentTime() override {
+    time_ += std::chrono::microseconds(5);
+    return time_;
+  }
+
+  MonotonicTime time_;
+};
+
+std::string gunzip(const std::string& compressed) {
+  z_stream zstream{};
+  EXPECT_EQ(Z_OK, inflateInit2(&zstream, 31));
+  zstream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+  zstream.avail_in = compressed.size();
+  std::string output;
+  int result;
+  do {
+    char chunk[4096];
+    zstream.next_out = reinterpret_cast<Bytef*>(chunk);
+    zstream.avail_out = sizeof(chunk);
+    result = inflate(&zstream, Z_NO_FLUSH);
+    EXPECT_TRUE(result == Z_OK || result == Z_STREAM_END);
+    output.append(chunk, sizeof(chunk) - zstream.avail_out);
+  } while (result == Z_OK && zstream.avail_in > 0);
+  EXPECT_EQ(Z_STREAM_END, result);
+  inflateEnd(&zstream);
+  return output;
+}
+
+TEST(GzipFilterAcceptsGzipTest, AcceptEncoding) {
+  EXPECT_TRUE(GzipFilter::acceptsGzip(TestHeaderMapImpl{{"accept-encoding", "gzip"}}));
+  EXPECT_TRUE(GzipFilter::acceptsGzip(TestHeaderMapImpl{{"accept-encoding", "deflate, GZIP"}}));
+  EXPECT_TRUE(GzipFilter::acceptsGzip(TestHeaderMapImpl{{"accept-encoding", "gzip;q=0.5"}}));
+  EXPECT_TRUE(GzipFilter::acceptsGzip(TestHeaderMapImpl{{"accept-encoding", "br, *"}}));
+  EXPECT_FALSE(GzipFilter::acceptsGzip(TestHeaderMapImpl{}));
+  EXPECT_FALSE(GzipFilter::acceptsGzip(TestHeaderMapImpl{{"accept-encoding", "deflate, br"}}));
+  EXPECT_FALSE(GzipFilter::acceptsGzip(TestHeaderMapImpl{{"accept-encoding", "gzip; q=0"}}));
+  EXPECT_FALSE(GzipFilter::acceptsGzip(TestHeaderMapImpl{{"accept-encoding", "*, gzip;q=0"}}));
+  EXPECT_FALSE(GzipFilter::acceptsGzip(TestHeaderMapImpl{{"accept-encoding", "*;q=0"}}));
+}
+
+class GzipFilterTest : public testing::Test {
+public:
+  GzipFilterTest() { setup("{}"); }
+
+  void setup(const std::string& json) {
+    config_.reset(
+        new GzipFilterConfig(*Json::Factory::loadFromString(json), "", store_, tls_, time_source_));
+    filter_.reset(new GzipFilter(config_));
+    filter_->setEncoderFilterCallbacks(encoder_callbacks_);
+  }
+
+  void request(const std::string& accept_encoding) {
+    TestHeaderMapImpl request_headers{{":method", "GET"}, {"accept-encoding", accept_encoding}};
+    EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, true));
+  }
+
+  // Expect a response not to be compressed.
+  void expectNotCompressed(const HeaderMap& response, const std::string& accept) {
+    setup("{}");
+    request(accept);
+    TestHeaderMapImpl response_headers(response);
+    EXPECT_EQ(FilterHeadersStatus::Continue, filter_->encodeHeaders(response_headers, false));
+    EXPECT_EQ(TestHeaderMapImpl(response), response_headers);
+
+    Buffer::OwnedImpl data(body_);
+    EXPECT_EQ(FilterDataStatus::Continue, filter_->encodeData(data, true));
+    EXPECT_EQ(body_, TestUtility::bufferToString(data));
+    filter_->onDestroy();
+  }
+
+  uint64_t counter(const std::string& name) { return store_.counter("gzip." + name).value(); }
+
+  const std::string body_ = std::string(1000, 'a') + std::string(1000, 'b');
+  Stats::IsolatedStoreImpl store_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  TestTimeSource time_source_;
+  GzipFilterConfigSharedPtr config_;
+  std::unique_ptr<GzipFilter> filter_;
+  NiceMock<MockStreamEncoderFilterCallbacks> encoder_callbacks_;
+};
+
+TEST_F(GzipFilterTest, CompressStreamingBody) {
+  request("deflate, gzip");
+  TestHeaderMapImpl response_headers{{":status", "200"},
+                                     {"content-type", "Text/HTML; charset=utf-8"},
+                                     {"content-length", "2000"},
+                                     {"etag", "\"abc\""}};
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->encodeHeaders(response_headers, false));
+  EXPECT_EQ(nullptr, response_headers.ContentLength());
+  EXPECT_EQ("gzip", response_headers.get_("content-encoding"));
+  EXPECT_EQ("accept-encoding", response_headers.get_("vary"));
+  EXPECT_EQ("W/\"abc\"", response_headers.get_("etag"));
+
+  // Every chunk is flushed, so the compressed stream can be decoded as it arrives.
+  Buffer::OwnedImpl chunk1(body_.substr(0, 1000));
+  EXPECT_EQ(FilterDataStatus::Continue, filter_->encodeData(chunk1, false));
+  std::string compressed = TestUtility::bufferToString(chunk1);
+  EXPECT_LT(0U, compressed.size());
+  Buffer::OwnedImpl chunk2(body_.substr(1000));
+  EXPECT_EQ(FilterDataStatus::Continue, filter_->encodeData(chunk2, true));
+  compressed += TestUtility::bufferToString(chunk2);
+  EXPECT_EQ(body_, gunzip(compressed));
+  filter_->onDestroy();
+
+  EXPECT_EQ(1U, counter("compressed"));
+  EXPECT_EQ(2000U, counter("total_uncompressed_bytes"));
+  EXPECT_EQ(compressed.size(), counter("total_compressed_bytes"));
+  EXPECT_EQ(10U, counter("compression_time_us"));
+  EXPECT_EQ(1U, counter("compressor_created"));
+}
+
+TEST_F(GzipFilterTest, CompressWithTrailers) {
+  request("gzip");
+  TestHeaderMapImpl response_headers{
+      {":status", "200"}, {"content-type", "application/json"}, {"vary", "Origin"}};
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->encodeHeaders(response_headers, false));
+  EXPECT_EQ("Origin, accept-encoding", response_headers.get_("vary"));
+
+  Buffer::OwnedImpl data(body_);
+  EXPECT_EQ(FilterDataStatus::Continue, filter_->encodeData(data, false));
+  std::string compressed = TestUtility::bufferToString(data);
+  EXPECT_CALL(encoder_callbacks_, addEncodedData(_, true))
+      .WillOnce(Invoke([&compressed](Buffer::Instance& data, bool) -> void {
+        compressed += TestUtility::bufferToString(data);
+      }));
+  TestHeaderMapImpl trailers{{"grpc-status", "0"}};
+  EXPECT_EQ(FilterTrailersStatus::Continue, filter_->encodeTrailers(trailers));
+  EXPECT_EQ(body_, gunzip(compressed));
+  filter_->onDestroy();
+}
+
+TEST_F(GzipFilterTest, NotCompressed) {
+  expectNotCompressed(TestHeaderMapImpl{{":status", "200"}, {"content-type", "text/html"}},
+                      "deflate");
+  EXPECT_EQ(0U, counter("not_compressed"));
+
+  expectNotCompressed(TestHeaderMapImpl{{":status", "200"},
+                                        {"content-type", "image/png"},
+                                        {"content-length", "2000"}},
+                      "gzip");
+  EXPECT_EQ(1U, counter("not_compressed"));
+
+  expectNotCompressed(TestHeaderMapImpl{{":status", "200"},
+                                        {"content-type", "text/html"},
+                                        {"content-length", "29"}},
+                      "gzip");
+  expectNotCompressed(TestHeaderMapImpl{{":status", "200"}}, "gzip");
+  expectNotCompressed(TestHeaderMapImpl{{":status", "200"},
+                                        {"content-type", "text/html"},
+                                        {"content-encoding", "br"}},
+                      "gzip");
+  expectNotCompressed(TestHeaderMapImpl{{":status", "200"},
+                                        {"content-type", "text/html"},
+                                        {"cache-control", "max-age=10, No-Transform"}},
+                      "gzip");
+  EXPECT_EQ(5U, counter("not_compressed"));
+  EXPECT_EQ(0U, counter("compressed"));
+}
+
+TEST_F(GzipFilterTest, HeadersOnlyResponse) {
+  request("gzip");
+  TestHeaderMapImpl response_headers{{":status", "304"}, {"content-type", "text/html"}};
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->encodeHeaders(response_headers, true));
+  EXPECT_EQ(nullptr, response_headers.get(Headers::get().ContentEncoding));
+  filter_->onDestroy();
+  EXPECT_EQ(0U, counter("compressor_created"));
+}
+
+TEST_F(GzipFilterTest, ContentTypes) {
+  setup("{\"content_types\": [\"application/grpc-web-text\"], \"min_content_length\": 0}");
+  request("gzip");
+  TestHeaderMapImpl response_headers{{":status", "200"},
+                                     {"content-type", "application/grpc-web-text"},
+                                     {"content-length", "1"}};
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->encodeHeaders(response_headers, false));
+  EXPECT_EQ("gzip", response_headers.get_("content-encoding"));
+  filter_->onDestroy();
+
+  EXPECT_FALSE(config_->compressibleContentType("text/html"));
+}
+
+TEST_F(GzipFilterTest, PooledCompressors) {
+  setup("{\"max_pooled_compressors\": 1}");
+  const auto stream = [this](std::unique_ptr<GzipFilter>& filter) -> void {
+    filter.reset(new GzipFilter(config_));
+    TestHeaderMapImpl request_headers{{"accept-encoding", "gzip"}};
+    filter->decodeHeaders(request_headers, true);
+    TestHeaderMapImpl response_headers{{":status", "200"}, {"content-type", "text/plain"}};
+    filter->encodeHeaders(response_headers, false);
+  };
+
+  // A stream that ends early still returns its compressor, which is reset for the next stream.
+  std::unique_ptr<GzipFilter> filter1;
+  stream(filter1);
+  Buffer::OwnedImpl partial(body_);
+  filter1->encodeData(partial, false);
+  filter1->onDestroy();
+  EXPECT_EQ(1U, config_->compressorPool().size());
+
+  std::unique_ptr<GzipFilter> filter2;
+  stream(filter2);
+  EXPECT_EQ(0U, config_->compressorPool().size());
+  Buffer::OwnedImpl data(body_);
+  filter2->encodeData(data, true);
+  EXPECT_EQ(body_, gunzip(TestUtility::bufferToString(data)));
+  EXPECT_EQ(1U, counter("compressor_created"));
+
+  // The pool keeps up to one idle compressor.
+  std::unique_ptr<GzipFilter> filter3;
+  stream(filter3);
+  EXPECT_EQ(2U, counter("compressor_created"));
+  filter2->onDestroy();
+  filter3->onDestroy();
+  EXPECT_EQ(1U, config_->compressorPool().size());
+}
+
+} // namespace Http
+} // namespace Envoy
@@ -2,6 +2,7 @@
 #include "common/http/filter/ip_tagging_filter.h"
 #include "common/http/header_map_impl.h"
 #include "common/http/headers.h"
+#include "common/stats/stats_impl.h"
 
 #include "test/mocks/http/mocks.h"
 #include "test/test_common/utility.h"
@@ -41,6 +42,21 @@ public:
     }
   )EOF";
 
+  const std::string nested_ranges_json = R"EOF(
+    {
+      "ip_tags" : [
+        {
+          "ip_tag_name" : "private",
+          "ip_list" : ["10.0.0.0/8", "fc00::/7"]
+        },
+        {
+          "ip_tag_name" : "office",
+          "ip_list" : ["10.1.0.0/16"]
+        }
+      ]
+    }
+  )EOF";
+
   const std::string both_request_json = R"EOF(
     {
       "request_type" : "both",
@@ -55,13 +71,14 @@ public:
 
   void SetUpTest(const std::string json) {
     Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
-    config_.reset(new IpTaggingFilterConfig(*config));
+    config_.reset(new IpTaggingFilterConfig(*config, "prefix.", stats_));
     filter_.reset(new IpTaggingFilter(config_));
     filter_->setDecoderFilterCallbacks(filter_callbacks_);
   }
 
   ~IpTaggingFilterTest() { filter_->onDestroy(); }
 
+  Stats::IsolatedStoreImpl stats_;
   IpTaggingFilterConfigSharedPtr config_;
   std::unique_ptr<IpTaggingFilter> filter_;
   NiceMock<MockStreamDecoderFilterCallbacks> filter_callbacks_;
@@ -93,5 +110,90 @@ TEST_F(IpTaggingFilterTest, BothRequest) {
   EXPECT_EQ(FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers_));
 }
 
+TEST_F(IpTaggingFilterTest, InternalRequestTagged) {
+  SetUpTest(internal_request_json);
+  filter_callbacks_.downstream_address_ = "1.2.3.4";
+
+  TestHeaderMapImpl external_headers;
+  EXPECT_CALL(filter_callbacks_, clearRouteCache()).Times(0);
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(external_headers, false));
+  EXPECT_FALSE(external_headers.has(Headers::get().EnvoyIpTags));
+  EXPECT_EQ(0UL, stats_.counter("prefix.ip_tagging.total").value());
+
+  TestHeaderMapImpl internal_headers{{"x-envoy-internal", "true"}};
+  EXPECT_CALL(filter_callbacks_, clearRouteCache());
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(internal_headers, false));
+  EXPECT_EQ("test_internal", internal_headers.get_(Headers::get().EnvoyIpTags));
+  EXPECT_EQ(1UL, stats_.counter("prefix.ip_tagging.total").value());
+  EXPECT_EQ(1UL, stats_.counter("prefix.ip_tagging.test_internal.hit").value());
+}
+
+TEST_F(IpTaggingFilterTest, ExternalRequestTagged) {
+  SetUpTest(external_request_json);
+  filter_callbacks_.downstream_address_ = "1.2.3.4";
+
+  TestHeaderMapImpl internal_headers{{"x-envoy-internal", "true"}};
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(internal_headers, false));
+  EXPECT_FALSE(internal_headers.has(Headers::get().EnvoyIpTags));
+
+  TestHeaderMapImpl external_headers;
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(external_headers, false));
+  EXPECT_EQ("test_external", external_headers.get_(Headers::get().EnvoyIpTags));
+  EXPECT_EQ(1UL, stats_.counter("prefix.ip_tagging.test_external.hit").value());
+}
+
+TEST_F(IpTaggingFilterTest, NestedRanges) {
+  SetUpTest(nested_ranges_json);
+
+  filter_callbacks_.downstream_address_ = "10.1.2.3";
+  TestHeaderMapImpl headers{{"x-envoy-ip-tags", "existing"}};
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(headers, false));
+  EXPECT_EQ("existing,private,office", headers.get_(Headers::get().EnvoyIpTags));
+
+  filter_callbacks_.downstream_address_ = "fd00::1";
+  TestHeaderMapImpl ipv6_headers;
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(ipv6_headers, false));
+  EXPECT_EQ("private", ipv6_headers.get_(Headers::get().EnvoyIpTags));
+
+  EXPECT_EQ(2UL, stats_.counter("prefix.ip_tagging.private.hit").value());
+  EXPECT_EQ(1UL, stats_.counter("prefix.ip_tagging.office.hit").value());
+  EXPECT_EQ(2UL, stats_.counter("prefix.ip_tagging.total").value());
+  EXPECT_EQ(0UL, stats_.counter("prefix.ip_tagging.no_hit").value());
+}
+
+TEST_F(IpTaggingFilterTest, NoHit) {
+  SetUpTest(both_request_json);
+
+  filter_callbacks_.downstream_address_ = "1.2.3.5";
+  EXPECT_CALL(filter_callbacks_, clearRouteCache()).Times(0);
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers_, false));
+  EXPECT_FALSE(request_headers_.has(Headers::get().EnvoyIpTags));
+
+  // Not an IP address.
+  filter_callbacks_.downstream_address_ = "";
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers_, false));
+  EXPECT_FALSE(request_headers_.has(Headers::get().EnvoyIpTags));
+
+  EXPECT_EQ(2UL, stats_.counter("prefix.ip_tagging.total").value());
+  EXPECT_EQ(2UL, stats_.counter("prefix.ip_tagging.no_hit").value());
+}
+
+TEST(IpTaggingFilterConfigTest, BadIpList) {
+  Stats::IsolatedStoreImpl stats;
+  std::string json = R"EOF(
+    {
+      "ip_tags" : [
+        {
+          "ip_tag_name" : "test",
+          "ip_list" : ["1.2.3.4/33"]
+        }
+      ]
+    }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+  EXPECT_THROW(IpTaggingFilterConfig(*config, "prefix.", stats), EnvoyException);
+}
+
 } // namespace Http
 } // namespace Envoy
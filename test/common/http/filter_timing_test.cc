@@ -0,0 +1,126 @@
+#include <memory>
+#include <string>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/http/filter_timing.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/http/mocks.h"
+#include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::InSequence;
+using testing::Return;
+using testing::SaveArg;
+using testing::_;
+
+namespace Envoy {
+namespace Http {
+
+class FilterTimingTest : public testing::Test {
+public:
+  FilterTimingTest()
+      : stats_(store_, "http.test.", "envoy.test"), timed_callbacks_(callbacks_, stats_) {}
+
+  uint64_t sampleCount(const std::string& name) {
+    Stats::HistogramImpl& histogram = dynamic_cast<Stats::HistogramImpl&>(
+        store_.histogram("http.test.filter.envoy.test." + name));
+    histogram.merge();
+    return histogram.cumulativeStatistics().sampleCount();
+  }
+
+  Stats::IsolatedStoreImpl store_;
+  FilterTimingStats stats_;
+  MockFilterChainFactoryCallbacks callbacks_;
+  TimedFilterChainFactoryCallbacks timed_callbacks_;
+  TestHeaderMapImpl headers_;
+  Buffer::OwnedImpl data_;
+};
+
+TEST_F(FilterTimingTest, DecoderFilter) {
+  std::shared_ptr<MockStreamDecoderFilter> filter(new MockStreamDecoderFilter());
+  StreamDecoderFilterSharedPtr timed_filter;
+  EXPECT_CALL(callbacks_, addStreamDecoderFilter(_)).WillOnce(SaveArg<0>(&timed_filter));
+  timed_callbacks_.addStreamDecoderFilter(filter);
+  ASSERT_NE(nullptr, timed_filter);
+  EXPECT_NE(filter, timed_filter);
+
+  InSequence s;
+  MockStreamDecoderFilterCallbacks decoder_callbacks;
+  EXPECT_CALL(*filter, setDecoderFilterCallbacks(_));
+  timed_filter->setDecoderFilterCallbacks(decoder_callbacks);
+  EXPECT_CALL(*filter, decodeHeaders(_, false))
+      .WillOnce(Return(FilterHeadersStatus::StopIteration));
+  EXPECT_EQ(FilterHeadersStatus::StopIteration, timed_filter->decodeHeaders(headers_, false));
+  EXPECT_CALL(*filter, decodeData(_, false)).WillOnce(Return(FilterDataStatus::Continue));
+  EXPECT_EQ(FilterDataStatus::Continue, timed_filter->decodeData(data_, false));
+  EXPECT_CALL(*filter, decodeData(_, false)).WillOnce(Return(FilterDataStatus::Continue));
+  EXPECT_EQ(FilterDataStatus::Continue, timed_filter->decodeData(data_, false));
+  EXPECT_CALL(*filter, decodeTrailers(_)).WillOnce(Return(FilterTrailersStatus::Continue));
+  EXPECT_EQ(FilterTrailersStatus::Continue, timed_filter->decodeTrailers(headers_));
+  EXPECT_CALL(*filter, onDestroy());
+  timed_filter->onDestroy();
+
+  EXPECT_EQ(1U, sampleCount("decode_headers_wall_us"));
+  EXPECT_EQ(1U, sampleCount("decode_headers_cpu_us"));
+  EXPECT_EQ(2U, sampleCount("decode_data_wall_us"));
+  EXPECT_EQ(2U, sampleCount("decode_data_cpu_us"));
+  EXPECT_EQ(0U, sampleCount("encode_headers_wall_us"));
+}
+
+TEST_F(FilterTimingTest, EncoderFilter) {
+  std::shared_ptr<MockStreamEncoderFilter> filter(new MockStreamEncoderFilter());
+  StreamEncoderFilterSharedPtr timed_filter;
+  EXPECT_CALL(callbacks_, addStreamEncoderFilter(_)).WillOnce(SaveArg<0>(&timed_filter));
+  timed_callbacks_.addStreamEncoderFilter(filter);
+  ASSERT_NE(nullptr, timed_filter);
+
+  EXPECT_CALL(*filter, encodeHeaders(_, true)).WillOnce(Return(FilterHeadersStatus::Continue));
+  EXPECT_EQ(FilterHeadersStatus::Continue, timed_filter->encodeHeaders(headers_, true));
+
+  EXPECT_EQ(1U, sampleCount("encode_headers_wall_us"));
+  EXPECT_EQ(1U, sampleCount("encode_headers_cpu_us"));
+  EXPECT_EQ(0U, sampleCount("encode_data_wall_us"));
+  EXPECT_EQ(0U, sampleCount("decode_headers_wall_us"));
+}
+
+TEST_F(FilterTimingTest, StreamFilter) {
+  std::shared_ptr<MockStreamFilter> filter(new MockStreamFilter());
+  StreamFilterSharedPtr timed_filter;
+  EXPECT_CALL(callbacks_, addStreamFilter(_)).WillOnce(SaveArg<0>(&timed_filter));
+  timed_callbacks_.addStreamFilter(filter);
+  ASSERT_NE(nullptr, timed_filter);
+
+  EXPECT_CALL(*filter, decodeHeaders(_, true)).WillOnce(Return(FilterHeadersStatus::Continue));
+  timed_filter->decodeHeaders(headers_, true);
+  EXPECT_CALL(*filter, encodeHeaders(_, false)).WillOnce(Return(FilterHeadersStatus::Continue));
+  timed_filter->encodeHeaders(headers_, false);
+  EXPECT_CALL(*filter, encodeData(_, true)).WillOnce(Return(FilterDataStatus::Continue));
+  timed_filter->encodeData(data_, true);
+
+  EXPECT_EQ(1U, sampleCount("decode_headers_wall_us"));
+  EXPECT_EQ(0U, sampleCount("decode_data_wall_us"));
+  EXPECT_EQ(1U, sampleCount("encode_headers_wall_us"));
+  EXPECT_EQ(1U, sampleCount("encode_data_cpu_us"));
+}
+
+TEST_F(FilterTimingTest, AccessLogHandler) {
+  AccessLog::InstanceSharedPtr handler(new AccessLog::MockInstance());
+  EXPECT_CALL(callbacks_, addAccessLogHandler(handler));
+  timed_callbacks_.addAccessLogHandler(handler);
+}
+
+TEST(FilterCallTimerTest, ThreadCpuTime) {
+  const std::chrono::nanoseconds start = FilterCallTimer::threadCpuTime();
+  volatile uint64_t sum = 0;
+  for (uint64_t i = 0; i < 1000000; i++) {
+    sum += i;
+  }
+  EXPECT_LT(start, FilterCallTimer::threadCpuTime());
+}
+
+} // namespace Http
+} // namespace Envoy
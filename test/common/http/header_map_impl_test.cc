@@ -1,4 +1,5 @@
 #include <string>
+#include <vector>
 
 #include "common/http/header_map_impl.h"
 
@@ -258,6 +259,57 @@ TEST(HeaderStringTest, All) {
     EXPECT_EQ(11U, string.size());
     EXPECT_EQ(HeaderString::Type::Reference, string.type());
   }
+
+  // Shared dynamic storage is copied once either string is modified.
+  {
+    const std::string large(4096, 'a');
+    HeaderString string;
+    string.setCopy(large.c_str(), large.size());
+    HeaderString string2;
+    string2.setShared(string);
+    EXPECT_EQ(HeaderString::Type::Dynamic, string2.type());
+    EXPECT_EQ(string.c_str(), string2.c_str());
+    EXPECT_EQ(4096U, string2.size());
+
+    string2.append("b", 1);
+    EXPECT_NE(string.c_str(), string2.c_str());
+    EXPECT_EQ(large, string.c_str());
+    EXPECT_EQ(large + "b", string2.c_str());
+
+    HeaderString string3;
+    string3.setShared(string);
+    string3.setInteger(5);
+    EXPECT_STREQ("5", string3.c_str());
+    EXPECT_EQ(large, string.c_str());
+
+    HeaderString string4;
+    string4.setShared(string);
+    string4.buffer()[0] = 'b';
+    EXPECT_EQ("b" + large.substr(1), string4.c_str());
+    EXPECT_EQ(large, string.c_str());
+
+    HeaderString string5;
+    string5.setShared(string);
+    string.setCopy("hello", 5);
+    EXPECT_STREQ("hello", string.c_str());
+    EXPECT_EQ(large, string5.c_str());
+  }
+
+  // Inline and reference strings are copied when shared.
+  {
+    const std::string static_string("hello");
+    HeaderString string(static_string);
+    HeaderString string2;
+    string2.setShared(string);
+    EXPECT_EQ(HeaderString::Type::Inline, string2.type());
+    EXPECT_NE(string.c_str(), string2.c_str());
+    EXPECT_STREQ("hello", string2.c_str());
+
+    HeaderString string3;
+    string3.setShared(string2);
+    EXPECT_EQ(HeaderString::Type::Inline, string3.type());
+    EXPECT_STREQ("hello", string3.c_str());
+  }
 }
 
 TEST(HeaderMapImplTest, InlineInsert) {
@@ -280,6 +332,46 @@ TEST(HeaderMapImplTest, MoveIntoInline) {
   EXPECT_STREQ("hello", headers.Host()->value().c_str());
 }
 
+TEST(HeaderMapImplTest, StaticLookup) {
+  HeaderMapImpl headers;
+  auto add = [&headers](const std::string& key, const std::string& value) {
+    HeaderString key_string;
+    key_string.setCopy(key.c_str(), key.size());
+    HeaderString value_string;
+    value_string.setCopy(value.c_str(), value.size());
+    headers.addViaMove(std::move(key_string), std::move(value_string));
+  };
+
+  // Every O(1) header, including the legacy host name, is found.
+  add("host", "foo");
+  EXPECT_STREQ("foo", headers.Host()->value().c_str());
+  add("x-envoy-upstream-rq-timeout-ms", "10");
+  EXPECT_STREQ("10", headers.EnvoyUpstreamRequestTimeoutMs()->value().c_str());
+  add("te", "trailers");
+  EXPECT_STREQ("trailers", headers.TE()->value().c_str());
+
+  // Prefixes and extensions of known names are not.
+  add("content-lengt", "1");
+  add("content-lengthx", "2");
+  EXPECT_EQ(nullptr, headers.ContentLength());
+
+  // Common names that are not O(1) headers reference the interned name instead of a copy.
+  add("accept-encoding", "gzip");
+  const HeaderEntry* accept_encoding = headers.get(LowerCaseString("accept-encoding"));
+  ASSERT_NE(nullptr, accept_encoding);
+  EXPECT_EQ(HeaderString::Type::Reference, accept_encoding->key().type());
+  EXPECT_STREQ("gzip", accept_encoding->value().c_str());
+
+  add("x-not-interned", "bar");
+  const HeaderEntry* not_interned = headers.get(LowerCaseString("x-not-interned"));
+  ASSERT_NE(nullptr, not_interned);
+  EXPECT_EQ(HeaderString::Type::Inline, not_interned->key().type());
+
+  headers.remove(LowerCaseString("accept-encoding"));
+  EXPECT_EQ(nullptr, headers.get(LowerCaseString("accept-encoding")));
+  EXPECT_EQ(6UL, headers.size());
+}
+
 TEST(HeaderMapImplTest, Remove) {
   HeaderMapImpl headers;
 
@@ -319,6 +411,27 @@ TEST(HeaderMapImplTest, DoubleInlineAdd) {
   EXPECT_EQ(1UL, headers.size());
 }
 
+TEST(HeaderMapImplTest, AddedByteSize) {
+  HeaderMapImpl headers;
+  EXPECT_EQ(0U, headers.addedByteSize());
+  EXPECT_EQ(0U, headers.addedCount());
+
+  headers.addReferenceKey(Headers::get().ContentLength, 5);
+  headers.addCopy(LowerCaseString("hello"), "world");
+  EXPECT_EQ(headers.byteSize(), headers.addedByteSize());
+  EXPECT_EQ(2U, headers.addedCount());
+
+  // Repeats of O(1) headers are counted even though the map drops them, and removing headers does
+  // not uncount them.
+  headers.addReferenceKey(Headers::get().ContentLength, 6);
+  EXPECT_EQ(2U, headers.size());
+  EXPECT_EQ(3U, headers.addedCount());
+  EXPECT_EQ(headers.byteSize() + 15, headers.addedByteSize());
+  headers.remove(LowerCaseString("hello"));
+  EXPECT_EQ(3U, headers.addedCount());
+  EXPECT_EQ(headers.byteSize() + 25, headers.addedByteSize());
+}
+
 TEST(HeaderMapImplTest, AddReferenceKey) {
   HeaderMapImpl headers;
   LowerCaseString foo("hello");
@@ -402,5 +515,97 @@ TEST(HeaderMapImplTest, LargeCharInHeader) {
   EXPECT_STREQ("value", headers.get(static_key)->value().c_str());
 }
 
+TEST(HeaderMapImplTest, ManyHeaders) {
+  HeaderMapImpl headers;
+  std::vector<const HeaderEntry*> entries;
+  for (size_t i = 0; i < 100; i++) {
+    headers.addCopy(LowerCaseString("x-header-" + std::to_string(i)), std::to_string(i));
+    entries.push_back(headers.get(LowerCaseString("x-header-" + std::to_string(i))));
+  }
+  headers.insertHost().value(std::string("host"));
+  const HeaderEntry* host = headers.Host();
+  EXPECT_EQ(101UL, headers.size());
+
+  // Entries must not move as storage grows.
+  for (size_t i = 0; i < 100; i++) {
+    EXPECT_EQ(entries[i], headers.get(LowerCaseString("x-header-" + std::to_string(i))));
+    EXPECT_STREQ(std::to_string(i).c_str(), entries[i]->value().c_str());
+  }
+  EXPECT_EQ(host, headers.Host());
+
+  // Remove every other header and make sure iteration preserves insertion order.
+  for (size_t i = 0; i < 100; i += 2) {
+    headers.remove(LowerCaseString("x-header-" + std::to_string(i)));
+  }
+  EXPECT_EQ(51UL, headers.size());
+
+  std::vector<std::string> values;
+  headers.iterate(
+      [](const HeaderEntry& header, void* context) -> void {
+        static_cast<std::vector<std::string>*>(context)->push_back(header.value().c_str());
+      },
+      &values);
+  ASSERT_EQ(51UL, values.size());
+  for (size_t i = 0; i < 50; i++) {
+    EXPECT_EQ(std::to_string(i * 2 + 1), values[i]);
+  }
+  EXPECT_EQ("host", values[50]);
+  EXPECT_EQ(host, headers.Host());
+
+  // Removing the tail and adding back reuses the freed space.
+  headers.removeHost();
+  headers.insertHost().value(std::string("host2"));
+  EXPECT_STREQ("host2", headers.Host()->value().c_str());
+  EXPECT_EQ(51UL, headers.size());
+}
+
+TEST(HeaderMapImplTest, Move) {
+  TestHeaderMapImpl headers{{":method", "GET"}, {"hello", "world"}};
+  for (size_t i = 0; i < 20; i++) {
+    headers.addCopy("x-header-" + std::to_string(i), "value");
+  }
+
+  HeaderMapImpl moved(std::move(headers));
+  EXPECT_EQ(22UL, moved.size());
+  EXPECT_STREQ("GET", moved.Method()->value().c_str());
+  EXPECT_STREQ("world", moved.get(LowerCaseString("hello"))->value().c_str());
+  EXPECT_STREQ("value", moved.get(LowerCaseString("x-header-19"))->value().c_str());
+
+  EXPECT_EQ(0UL, headers.size());
+  EXPECT_EQ(nullptr, headers.Method());
+  EXPECT_EQ(nullptr, headers.get(LowerCaseString("hello")));
+}
+
+TEST(HeaderMapImplTest, CopySharesDynamicValues) {
+  const std::string large(4096, 'a');
+  HeaderMapImpl headers;
+  headers.addCopy(LowerCaseString("hello"), "world");
+  headers.insertPath().value(large);
+
+  HeaderMapImpl copy(static_cast<const HeaderMap&>(headers));
+  EXPECT_EQ(2UL, copy.size());
+  EXPECT_STREQ("world", copy.get(LowerCaseString("hello"))->value().c_str());
+  EXPECT_EQ(headers.Path()->value().c_str(), copy.Path()->value().c_str());
+
+  copy.Path()->value().append("b", 1);
+  EXPECT_EQ(large, headers.Path()->value().c_str());
+  EXPECT_EQ(large + "b", copy.Path()->value().c_str());
+}
+
+TEST(HeaderMapImplTest, Arena) {
+  Arena arena;
+  {
+    HeaderMapImpl headers(arena);
+    for (size_t i = 0; i < 40; i++) {
+      headers.addCopy(LowerCaseString("x-header-" + std::to_string(i)), "value");
+    }
+    EXPECT_EQ(40UL, headers.size());
+    EXPECT_STREQ("value", headers.get(LowerCaseString("x-header-39"))->value().c_str());
+  }
+
+  // Storage beyond the embedded block came from the arena.
+  EXPECT_GT(arena.bytesAllocated(), 0U);
+}
+
 } // namespace Http
 } // namespace Envoy
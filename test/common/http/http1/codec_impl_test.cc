@@ -1,4 +1,5 @@
 #include <string>
+#include <vector>
 
 #include "envoy/buffer/buffer.h"
 #include "envoy/event/dispatcher.h"
@@ -104,6 +105,37 @@ TEST_F(Http1ServerConnectionImplTest, EmptyHeader) {
   EXPECT_EQ(0U, buffer.length());
 }
 
+TEST_F(Http1ServerConnectionImplTest, HeaderNameSplitAcrossSlices) {
+  initialize();
+
+  InSequence sequence;
+
+  Http::MockStreamDecoder decoder;
+  EXPECT_CALL(callbacks_, newStream(_)).WillOnce(ReturnRef(decoder));
+
+  TestHeaderMapImpl expected_headers{
+      {"x-a-rather-long-header-name-that-is-split", "Some Value"},
+      {":path", "/"},
+      {":method", "GET"},
+  };
+  EXPECT_CALL(decoder, decodeHeaders_(HeaderMapEqual(&expected_headers), true)).Times(1);
+
+  // Fragments always become their own slices, so the name and value arrive in pieces.
+  const std::string first("GET / HTTP/1.1\r\nX-A-Rather-Long-HEADER-");
+  const std::string second("Name-That-Is-Split: Some ");
+  const std::string third("Value\r\n\r\n");
+  Buffer::BufferFragmentImpl first_fragment(first.data(), first.size(), nullptr);
+  Buffer::BufferFragmentImpl second_fragment(second.data(), second.size(), nullptr);
+  Buffer::BufferFragmentImpl third_fragment(third.data(), third.size(), nullptr);
+  Buffer::OwnedImpl buffer;
+  buffer.addBufferFragment(first_fragment);
+  buffer.addBufferFragment(second_fragment);
+  buffer.addBufferFragment(third_fragment);
+  EXPECT_EQ(3U, buffer.getRawSlices(nullptr, 0));
+  codec_->dispatch(buffer);
+  EXPECT_EQ(0U, buffer.length());
+}
+
 TEST_F(Http1ServerConnectionImplTest, Http10) {
   initialize();
 
@@ -266,6 +298,45 @@ TEST_F(Http1ServerConnectionImplTest, BadRequestStartedStream) {
   EXPECT_EQ("HTTP/1.1 400 Bad Request\r\ncontent-length: 0\r\nconnection: close\r\n\r\n", output);
 }
 
+// Headers over the size limit are rejected while they are still arriving.
+TEST_F(Http1ServerConnectionImplTest, RequestHeadersOverSizeLimit) {
+  codec_settings_.max_request_headers_kb_ = 1;
+  initialize();
+
+  std::string output;
+  ON_CALL(connection_, write(_)).WillByDefault(AddBufferToString(&output));
+
+  Http::MockStreamDecoder decoder;
+  EXPECT_CALL(callbacks_, newStream(_)).WillOnce(ReturnRef(decoder));
+  EXPECT_CALL(decoder, decodeHeaders_(_, _)).Times(0);
+
+  Buffer::OwnedImpl buffer("GET / HTTP/1.1\r\nbig: " + std::string(1024, 'a'));
+  EXPECT_THROW(codec_->dispatch(buffer), CodecProtocolException);
+  EXPECT_EQ("HTTP/1.1 431 Request Header Fields Too Large\r\ncontent-length: 0\r\nconnection: "
+            "close\r\n\r\n",
+            output);
+}
+
+TEST_F(Http1ServerConnectionImplTest, RequestHeadersOverCountLimit) {
+  codec_settings_.max_request_headers_count_ = 2;
+  initialize();
+
+  std::string output;
+  ON_CALL(connection_, write(_)).WillByDefault(AddBufferToString(&output));
+
+  Http::MockStreamDecoder decoder;
+  EXPECT_CALL(callbacks_, newStream(_)).WillOnce(ReturnRef(decoder));
+  EXPECT_CALL(decoder, decodeHeaders_(_, _)).Times(0);
+
+  Buffer::OwnedImpl buffer("GET / HTTP/1.1\r\na: 1\r\nb: 2\r\n");
+  codec_->dispatch(buffer);
+  Buffer::OwnedImpl buffer2("c: 3\r\nd");
+  EXPECT_THROW(codec_->dispatch(buffer2), CodecProtocolException);
+  EXPECT_EQ("HTTP/1.1 431 Request Header Fields Too Large\r\ncontent-length: 0\r\nconnection: "
+            "close\r\n\r\n",
+            output);
+}
+
 TEST_F(Http1ServerConnectionImplTest, HostHeaderTranslation) {
   initialize();
 
@@ -374,6 +445,46 @@ TEST_F(Http1ServerConnectionImplTest, ChunkedResponse) {
             output);
 }
 
+// The body of a large chunk is moved to the connection rather than copied.
+TEST_F(Http1ServerConnectionImplTest, ChunkedResponseMovesBody) {
+  initialize();
+
+  NiceMock<Http::MockStreamDecoder> decoder;
+  Http::StreamEncoder* response_encoder = nullptr;
+  EXPECT_CALL(callbacks_, newStream(_))
+      .WillOnce(Invoke([&](Http::StreamEncoder& encoder) -> Http::StreamDecoder& {
+        response_encoder = &encoder;
+        return decoder;
+      }));
+
+  Buffer::OwnedImpl buffer("GET / HTTP/1.1\r\n\r\n");
+  codec_->dispatch(buffer);
+
+  std::string output;
+  ON_CALL(connection_, write(_)).WillByDefault(AddBufferToString(&output));
+  response_encoder->encodeHeaders(TestHeaderMapImpl{{":status", "200"}}, false);
+  output.clear();
+
+  const std::string body(4096, 'a');
+  Buffer::OwnedImpl data(body);
+  Buffer::RawSlice body_slice;
+  ASSERT_EQ(1U, data.getRawSlices(&body_slice, 1));
+  bool moved = false;
+  EXPECT_CALL(connection_, write(_)).WillOnce(Invoke([&](Buffer::Instance& written) -> void {
+    const uint64_t num_slices = written.getRawSlices(nullptr, 0);
+    Buffer::RawSlice slices[num_slices];
+    written.getRawSlices(slices, num_slices);
+    for (const Buffer::RawSlice& slice : slices) {
+      moved |= slice.mem_ == body_slice.mem_;
+    }
+    output.append(TestUtility::bufferToString(written));
+    written.drain(written.length());
+  }));
+  response_encoder->encodeData(data, true);
+  EXPECT_TRUE(moved);
+  EXPECT_EQ("1000\r\n" + body + "\r\n0\r\n\r\n", output);
+}
+
 TEST_F(Http1ServerConnectionImplTest, ContentLengthResponse) {
   initialize();
 
@@ -473,6 +584,87 @@ TEST_F(Http1ServerConnectionImplTest, DoubleRequest) {
   EXPECT_EQ(0U, buffer.length());
 }
 
+TEST_F(Http1ServerConnectionImplTest, PipelinedRequests) {
+  codec_settings_.max_pipeline_depth_ = 2;
+  initialize();
+
+  NiceMock<Http::MockStreamDecoder> decoder;
+  std::vector<Http::StreamEncoder*> response_encoders;
+  EXPECT_CALL(callbacks_, newStream(_))
+      .Times(3)
+      .WillRepeatedly(Invoke([&](Http::StreamEncoder& encoder) -> Http::StreamDecoder& {
+        response_encoders.push_back(&encoder);
+        return decoder;
+      }));
+
+  std::string output;
+  ON_CALL(connection_, write(_)).WillByDefault(AddBufferToString(&output));
+
+  // The parser pauses once two requests are in flight.
+  std::string request("GET / HTTP/1.1\r\n\r\n");
+  Buffer::OwnedImpl buffer(request);
+  buffer.add(request);
+  buffer.add(request);
+  codec_->dispatch(buffer);
+  EXPECT_EQ(request.size(), buffer.length());
+  ASSERT_EQ(2U, response_encoders.size());
+
+  // The second response is held until the first one is complete.
+  response_encoders[1]->encodeHeaders(TestHeaderMapImpl{{":status", "404"}}, true);
+  EXPECT_EQ("", output);
+  response_encoders[0]->encodeHeaders(TestHeaderMapImpl{{":status", "200"}}, false);
+  EXPECT_EQ("HTTP/1.1 200 OK\r\ntransfer-encoding: chunked\r\n\r\n", output);
+  Buffer::OwnedImpl data("Hello");
+  response_encoders[0]->encodeData(data, true);
+  EXPECT_EQ("HTTP/1.1 200 OK\r\ntransfer-encoding: chunked\r\n\r\n5\r\nHello\r\n0\r\n\r\n"
+            "HTTP/1.1 404 Not Found\r\ncontent-length: 0\r\n\r\n",
+            output);
+
+  // Both requests are done, so the third one is written directly.
+  codec_->dispatch(buffer);
+  EXPECT_EQ(0U, buffer.length());
+  ASSERT_EQ(3U, response_encoders.size());
+  output.clear();
+  response_encoders[2]->encodeHeaders(TestHeaderMapImpl{{":status", "200"}}, true);
+  EXPECT_EQ("HTTP/1.1 200 OK\r\ncontent-length: 0\r\n\r\n", output);
+}
+
+TEST_F(Http1ServerConnectionImplTest, PipelinedRequestsReset) {
+  codec_settings_.max_pipeline_depth_ = 3;
+  initialize();
+
+  NiceMock<Http::MockStreamDecoder> decoder;
+  std::vector<Http::StreamEncoder*> response_encoders;
+  EXPECT_CALL(callbacks_, newStream(_))
+      .Times(3)
+      .WillRepeatedly(Invoke([&](Http::StreamEncoder& encoder) -> Http::StreamDecoder& {
+        response_encoders.push_back(&encoder);
+        return decoder;
+      }));
+
+  std::string request("GET / HTTP/1.1\r\n\r\n");
+  Buffer::OwnedImpl buffer(request);
+  buffer.add(request);
+  buffer.add(request);
+  codec_->dispatch(buffer);
+  EXPECT_EQ(0U, buffer.length());
+  ASSERT_EQ(3U, response_encoders.size());
+
+  Http::MockStreamCallbacks callbacks1;
+  Http::MockStreamCallbacks callbacks2;
+  Http::MockStreamCallbacks callbacks3;
+  response_encoders[0]->getStream().addCallbacks(callbacks1);
+  response_encoders[1]->getStream().addCallbacks(callbacks2);
+  response_encoders[2]->getStream().addCallbacks(callbacks3);
+
+  // The second response is complete and only held, so its stream is not reset.
+  response_encoders[1]->encodeHeaders(TestHeaderMapImpl{{":status", "200"}}, true);
+  EXPECT_CALL(callbacks1, onResetStream(StreamResetReason::LocalReset));
+  EXPECT_CALL(callbacks2, onResetStream(_)).Times(0);
+  EXPECT_CALL(callbacks3, onResetStream(StreamResetReason::LocalReset));
+  response_encoders[0]->getStream().resetStream(StreamResetReason::LocalReset);
+}
+
 TEST_F(Http1ServerConnectionImplTest, RequestWithTrailers) {
   initialize();
 
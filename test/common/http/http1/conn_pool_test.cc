@@ -1,3 +1,4 @@
+#include <chrono>
 #include <memory>
 #include <vector>
 
@@ -242,8 +243,8 @@ TEST_F(Http1ConnPoolImplTest, MultipleRequestAndResponse) {
  * Test when we overflow max pending requests.
  */
 TEST_F(Http1ConnPoolImplTest, MaxPendingRequests) {
-  cluster_->resource_manager_.reset(
-      new Upstream::ResourceManagerImpl(runtime_, "fake_key", 1, 1, 1024, 1));
+  cluster_->resource_manager_.reset(new Upstream::ResourceManagerImpl(
+      runtime_, "fake_key", 1, 1, 1024, 1, cluster_->stats_store_));
 
   NiceMock<Http::MockStreamDecoder> outer_decoder;
   ConnPoolCallbacks callbacks;
@@ -496,8 +497,8 @@ TEST_F(Http1ConnPoolImplTest, MaxRequestsPerConnection) {
 TEST_F(Http1ConnPoolImplTest, ConcurrentConnections) {
   InSequence s;
 
-  cluster_->resource_manager_.reset(
-      new Upstream::ResourceManagerImpl(runtime_, "fake_key", 2, 1024, 1024, 1));
+  cluster_->resource_manager_.reset(new Upstream::ResourceManagerImpl(
+      runtime_, "fake_key", 2, 1024, 1024, 1, cluster_->stats_store_));
   ActiveTestRequest r1(*this, 0, ActiveTestRequest::Type::CreateConnection);
   r1.startRequest();
 
@@ -521,6 +522,140 @@ TEST_F(Http1ConnPoolImplTest, ConcurrentConnections) {
   dispatcher_.clearDeferredDeleteList();
 }
 
+/**
+ * Test that a spare connection is opened ahead of the requests when idle connections are wanted.
+ */
+TEST_F(Http1ConnPoolImplTest, MinIdleConnections) {
+  InSequence s;
+
+  cluster_->resource_manager_.reset(new Upstream::ResourceManagerImpl(
+      runtime_, "fake_key", 2, 1024, 1024, 1, cluster_->stats_store_));
+  cluster_->min_idle_connections_ = 1;
+
+  // The first request opens its own connection and a spare one.
+  conn_pool_.expectClientCreate();
+  conn_pool_.expectClientCreate();
+  ActiveTestRequest r1(*this, 0, ActiveTestRequest::Type::Pending);
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_prefetch_.value());
+
+  EXPECT_CALL(*conn_pool_.test_clients_[0].connect_timer_, disableTimer());
+  r1.expectNewStream();
+  conn_pool_.test_clients_[0].connection_->raiseEvent(Network::ConnectionEvent::Connected);
+  r1.startRequest();
+
+  // The spare connection is ready when the second request arrives. The circuit breaker keeps the
+  // pool from opening another spare one.
+  EXPECT_CALL(*conn_pool_.test_clients_[1].connect_timer_, disableTimer());
+  conn_pool_.test_clients_[1].connection_->raiseEvent(Network::ConnectionEvent::Connected);
+  ActiveTestRequest r2(*this, 1, ActiveTestRequest::Type::Immediate);
+  r2.startRequest();
+  EXPECT_EQ(2U, cluster_->stats_.upstream_cx_total_.value());
+
+  r1.completeResponse(false);
+  r2.completeResponse(false);
+
+  EXPECT_CALL(conn_pool_, onClientDestroy()).Times(2);
+  conn_pool_.test_clients_[1].connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  conn_pool_.test_clients_[0].connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  dispatcher_.clearDeferredDeleteList();
+}
+
+/**
+ * Test that connections are prefetched as a percentage of the requests.
+ */
+TEST_F(Http1ConnPoolImplTest, PrefetchPercent) {
+  InSequence s;
+
+  cluster_->resource_manager_.reset(new Upstream::ResourceManagerImpl(
+      runtime_, "fake_key", 1024, 1024, 1024, 1, cluster_->stats_store_));
+  cluster_->connection_prefetch_percent_ = 150;
+
+  // One request rounds up to two connections.
+  conn_pool_.expectClientCreate();
+  conn_pool_.expectClientCreate();
+  ActiveTestRequest r1(*this, 0, ActiveTestRequest::Type::Pending);
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_prefetch_.value());
+
+  // Two requests round up to three connections. The second request opens its own connection, which
+  // is enough.
+  conn_pool_.expectClientCreate();
+  ActiveTestRequest r2(*this, 2, ActiveTestRequest::Type::Pending);
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_prefetch_.value());
+  EXPECT_EQ(3U, cluster_->stats_.upstream_cx_total_.value());
+
+  // The first connect failure purges the pending requests, newest first.
+  EXPECT_CALL(r2.callbacks_.pool_failure_, ready());
+  EXPECT_CALL(r1.callbacks_.pool_failure_, ready());
+  conn_pool_.test_clients_[0].connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  conn_pool_.test_clients_[1].connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  conn_pool_.test_clients_[2].connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_CALL(conn_pool_, onClientDestroy()).Times(3);
+  dispatcher_.clearDeferredDeleteList();
+}
+
+/**
+ * Test that ready connections are closed once they have been idle for the idle timeout.
+ */
+TEST_F(Http1ConnPoolImplTest, IdleTimeout) {
+  InSequence s;
+
+  cluster_->idle_connection_timeout_ = std::chrono::milliseconds(5000);
+  ActiveTestRequest r1(*this, 0, ActiveTestRequest::Type::CreateConnection);
+  r1.startRequest();
+  Event::MockTimer* idle_timer = new Event::MockTimer(&dispatcher_);
+  EXPECT_CALL(*idle_timer, enableTimer(std::chrono::milliseconds(5000)));
+  r1.completeResponse(false);
+
+  // Reusing the connection stops the timer until the connection is idle again.
+  EXPECT_CALL(*idle_timer, disableTimer());
+  ActiveTestRequest r2(*this, 0, ActiveTestRequest::Type::Immediate);
+  r2.startRequest();
+  EXPECT_CALL(*idle_timer, enableTimer(std::chrono::milliseconds(5000)));
+  r2.completeResponse(false);
+  EXPECT_EQ(1U, cluster_->stats_.upstream_rq_reused_.value());
+
+  EXPECT_CALL(*idle_timer, disableTimer());
+  EXPECT_CALL(conn_pool_, onClientDestroy());
+  idle_timer->callback_();
+  dispatcher_.clearDeferredDeleteList();
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_idle_timeout_.value());
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_destroy_local_.value());
+}
+
+/**
+ * Test that ready connections are reused most recently used first unless FIFO reuse is asked for.
+ */
+TEST_F(Http1ConnPoolImplTest, ReuseOrder) {
+  InSequence s;
+
+  cluster_->resource_manager_.reset(new Upstream::ResourceManagerImpl(
+      runtime_, "fake_key", 2, 1024, 1024, 1, cluster_->stats_store_));
+  ActiveTestRequest r1(*this, 0, ActiveTestRequest::Type::CreateConnection);
+  r1.startRequest();
+  ActiveTestRequest r2(*this, 1, ActiveTestRequest::Type::CreateConnection);
+  r2.startRequest();
+  r1.completeResponse(false);
+  r2.completeResponse(false);
+
+  // The second connection was idle the shortest.
+  ActiveTestRequest r3(*this, 1, ActiveTestRequest::Type::Immediate);
+  r3.startRequest();
+  r3.completeResponse(false);
+
+  // The first connection was idle the longest.
+  cluster_->connection_reuse_fifo_ = true;
+  ActiveTestRequest r4(*this, 0, ActiveTestRequest::Type::Immediate);
+  r4.startRequest();
+  r4.completeResponse(false);
+  EXPECT_EQ(4U, cluster_->stats_.upstream_rq_total_.value());
+  EXPECT_EQ(2U, cluster_->stats_.upstream_rq_reused_.value());
+
+  EXPECT_CALL(conn_pool_, onClientDestroy()).Times(2);
+  conn_pool_.test_clients_[1].connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  conn_pool_.test_clients_[0].connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  dispatcher_.clearDeferredDeleteList();
+}
+
 TEST_F(Http1ConnPoolImplTest, DrainCallback) {
   InSequence s;
   ReadyWatcher drained;
@@ -51,6 +51,7 @@ public:
       : ServerConnectionImpl(connection, callbacks, scope, http2_settings) {}
   nghttp2_session* session() { return session_; }
   using ServerConnectionImpl::getStream;
+  using ServerConnectionImpl::small_stream_boost_bytes_;
 };
 
 class TestClientConnectionImpl : public ClientConnectionImpl {
@@ -60,6 +61,7 @@ public:
       : ClientConnectionImpl(connection, callbacks, scope, http2_settings) {}
   nghttp2_session* session() { return session_; }
   using ClientConnectionImpl::getStream;
+  using ClientConnectionImpl::small_stream_boost_bytes_;
 };
 
 class Http2CodecImplTest : public testing::TestWithParam<Http2SettingsTestParam> {
@@ -173,6 +175,43 @@ TEST_P(Http2CodecImplTest, ExpectContinueTrailersResponse) {
   response_encoder_->encodeTrailers(response_trailers);
 }
 
+TEST_P(Http2CodecImplTest, HeaderCompressionStats) {
+  initialize();
+
+  TestHeaderMapImpl request_headers;
+  HttpTestUtility::addDefaultHeaders(request_headers);
+  request_headers.addCopy("x-custom", std::string(100, 'a'));
+  EXPECT_CALL(request_decoder_, decodeHeaders_(_, true));
+  request_encoder_->encodeHeaders(request_headers, true);
+
+  // The client and the server share the stats store, so both sides of the header block are
+  // counted in the same scope.
+  const uint64_t plain_size = stats_store_.counter("http2.header_bytes_sent_plain").value();
+  EXPECT_LT(100U, plain_size);
+  EXPECT_EQ(plain_size, stats_store_.counter("http2.header_bytes_received_plain").value());
+  const uint64_t encoded_size = stats_store_.counter("http2.header_bytes_sent_encoded").value();
+  EXPECT_LT(0U, encoded_size);
+  EXPECT_EQ(encoded_size, stats_store_.counter("http2.header_bytes_received_encoded").value());
+}
+
+TEST_P(Http2CodecImplTest, BodyFramesWrittenAtOnce) {
+  initialize();
+
+  TestHeaderMapImpl request_headers;
+  HttpTestUtility::addDefaultHeaders(request_headers);
+  EXPECT_CALL(request_decoder_, decodeHeaders_(_, false));
+  request_encoder_->encodeHeaders(request_headers, false);
+
+  // The body is split into several DATA frames, which all go out with a single connection write.
+  EXPECT_CALL(client_connection_, write(_)).WillOnce(Invoke([&](Buffer::Instance& data) -> void {
+    EXPECT_LT(32 * 1024U, data.length());
+    server_wrapper_.dispatch(data, server_);
+  }));
+  EXPECT_CALL(request_decoder_, decodeData(_, _)).Times(AtLeast(1));
+  Buffer::OwnedImpl body(std::string(32 * 1024, 'a'));
+  request_encoder_->encodeData(body, true);
+}
+
 TEST_P(Http2CodecImplTest, ShutdownNotice) {
   initialize();
 
@@ -205,6 +244,24 @@ TEST_P(Http2CodecImplTest, RefusedStreamReset) {
   response_encoder_->getStream().resetStream(StreamResetReason::LocalRefusedStreamReset);
 }
 
+// The server resets a stream as soon as its request headers go over the count limit.
+TEST_P(Http2CodecImplTest, RequestHeadersOverCountLimit) {
+  initialize();
+
+  TestHeaderMapImpl request_headers;
+  HttpTestUtility::addDefaultHeaders(request_headers);
+  for (uint32_t i = 0; i < DEFAULT_MAX_REQUEST_HEADERS_COUNT; i++) {
+    request_headers.addCopy("header" + std::to_string(i), "");
+  }
+  MockStreamCallbacks callbacks;
+  request_encoder_->getStream().addCallbacks(callbacks);
+  EXPECT_CALL(request_decoder_, decodeHeaders_(_, _)).Times(0);
+  EXPECT_CALL(server_stream_callbacks_, onResetStream(_));
+  EXPECT_CALL(callbacks, onResetStream(StreamResetReason::RemoteReset));
+  request_encoder_->encodeHeaders(request_headers, true);
+  EXPECT_EQ(1U, stats_store_.counter("http2.header_overflow").value());
+}
+
 TEST_P(Http2CodecImplTest, InvalidFrame) {
   initialize();
 
@@ -573,6 +630,121 @@ TEST_P(Http2CodecImplTest, WatermarkUnderEndStream) {
   response_encoder_->encodeHeaders(response_headers, true);
 }
 
+class Http2CodecImplWriteSchedulingTest : public Http2CodecImplTest {
+public:
+  int32_t weight(nghttp2_session* session, int32_t stream_id) {
+    return nghttp2_stream_get_weight(nghttp2_session_find_stream(session, stream_id));
+  }
+};
+
+// DATA frames are held back while the connection is above its high watermark, and resume once it
+// drains.
+TEST_P(Http2CodecImplWriteSchedulingTest, DataHeldBackWhileConnectionBackedUp) {
+  initialize();
+
+  TestHeaderMapImpl request_headers;
+  HttpTestUtility::addDefaultHeaders(request_headers);
+  EXPECT_CALL(request_decoder_, decodeHeaders_(_, true));
+  request_encoder_->encodeHeaders(request_headers, true);
+
+  ON_CALL(server_connection_, write(_)).WillByDefault(Invoke([&](Buffer::Instance& data) -> void {
+    client_wrapper_.buffer_.add(data);
+  }));
+  ON_CALL(server_connection_, aboveHighWatermark()).WillByDefault(Return(true));
+  TestHeaderMapImpl response_headers{{":status", "200"}};
+  response_encoder_->encodeHeaders(response_headers, false);
+  Buffer::OwnedImpl body(std::string(1024 * 1024, 'a'));
+  response_encoder_->encodeData(body, true);
+  EXPECT_GT(128 * 1024U, client_wrapper_.buffer_.length());
+
+  ON_CALL(server_connection_, aboveHighWatermark()).WillByDefault(Return(false));
+  server_.onUnderlyingConnectionBelowWriteBufferLowWatermark();
+  EXPECT_LT(1024 * 1024U, client_wrapper_.buffer_.length());
+
+  EXPECT_CALL(response_decoder_, decodeHeaders_(_, false));
+  EXPECT_CALL(response_decoder_, decodeData(_, false)).Times(AnyNumber());
+  EXPECT_CALL(response_decoder_, decodeData(_, true));
+  setupDefaultConnectionMocks();
+  client_wrapper_.dispatch(Buffer::OwnedImpl(), client_);
+}
+
+// A short response that starts while a long one is backed up on the connection is not queued
+// behind the rest of the long one.
+TEST_P(Http2CodecImplWriteSchedulingTest, ShortStreamNotQueuedBehindLongStream) {
+  initialize();
+  server_.small_stream_boost_bytes_ = 16 * 1024;
+
+  TestHeaderMapImpl request_headers;
+  HttpTestUtility::addDefaultHeaders(request_headers);
+  EXPECT_CALL(request_decoder_, decodeHeaders_(_, true));
+  request_encoder_->encodeHeaders(request_headers, true);
+
+  MockStreamDecoder response_decoder2;
+  MockStreamDecoder request_decoder2;
+  StreamEncoder* request_encoder2 = &client_.newStream(response_decoder2);
+  StreamEncoder* response_encoder2{};
+  EXPECT_CALL(server_callbacks_, newStream(_))
+      .WillOnce(Invoke([&](StreamEncoder& encoder) -> StreamDecoder& {
+        response_encoder2 = &encoder;
+        return request_decoder2;
+      }));
+  EXPECT_CALL(request_decoder2, decodeHeaders_(_, true));
+  request_encoder2->encodeHeaders(request_headers, true);
+
+  ON_CALL(server_connection_, write(_)).WillByDefault(Invoke([&](Buffer::Instance& data) -> void {
+    client_wrapper_.buffer_.add(data);
+  }));
+  ON_CALL(server_connection_, aboveHighWatermark()).WillByDefault(Return(true));
+  TestHeaderMapImpl response_headers{{":status", "200"}};
+  response_encoder_->encodeHeaders(response_headers, false);
+  EXPECT_EQ(NGHTTP2_MAX_WEIGHT, weight(server_.session(), 1));
+  Buffer::OwnedImpl long_body(std::string(1024 * 1024, 'a'));
+  response_encoder_->encodeData(long_body, true);
+  // The long stream has used up its boost.
+  EXPECT_EQ(NGHTTP2_DEFAULT_WEIGHT, weight(server_.session(), 1));
+
+  response_encoder2->encodeHeaders(response_headers, false);
+  EXPECT_EQ(NGHTTP2_MAX_WEIGHT, weight(server_.session(), 3));
+  Buffer::OwnedImpl short_body(std::string(1024, 'b'));
+  response_encoder2->encodeData(short_body, true);
+
+  ON_CALL(server_connection_, aboveHighWatermark()).WillByDefault(Return(false));
+  server_.onUnderlyingConnectionBelowWriteBufferLowWatermark();
+
+  uint64_t long_bytes_received = 0;
+  EXPECT_CALL(response_decoder_, decodeHeaders_(_, false));
+  EXPECT_CALL(response_decoder_, decodeData(_, _))
+      .Times(AtLeast(1))
+      .WillRepeatedly(Invoke([&](Buffer::Instance& data, bool) -> void {
+        long_bytes_received += data.length();
+      }));
+  EXPECT_CALL(response_decoder2, decodeHeaders_(_, false));
+  EXPECT_CALL(response_decoder2, decodeData(_, true)).WillOnce(InvokeWithoutArgs([&]() -> void {
+    EXPECT_GT(256 * 1024U, long_bytes_received);
+  }));
+  setupDefaultConnectionMocks();
+  client_wrapper_.dispatch(Buffer::OwnedImpl(), client_);
+  EXPECT_EQ(1024 * 1024U, long_bytes_received);
+}
+
+// The client sends the boosted weight with its requests.
+TEST_P(Http2CodecImplWriteSchedulingTest, ClientBoostsRequests) {
+  client_.small_stream_boost_bytes_ = 16 * 1024;
+  initialize();
+
+  TestHeaderMapImpl request_headers;
+  HttpTestUtility::addDefaultHeaders(request_headers);
+  EXPECT_CALL(request_decoder_, decodeHeaders_(_, false));
+  request_encoder_->encodeHeaders(request_headers, false);
+  EXPECT_EQ(NGHTTP2_MAX_WEIGHT, weight(client_.session(), 1));
+  EXPECT_EQ(NGHTTP2_MAX_WEIGHT, weight(server_.session(), 1));
+
+  EXPECT_CALL(request_decoder_, decodeData(_, _)).Times(AtLeast(1));
+  Buffer::OwnedImpl body(std::string(32 * 1024, 'a'));
+  request_encoder_->encodeData(body, true);
+  EXPECT_EQ(NGHTTP2_DEFAULT_WEIGHT, weight(client_.session(), 1));
+}
+
 #define HTTP2SETTINGS_SMALL_WINDOW_COMBINE                                                         \
   ::testing::Combine(::testing::Values(Http2Settings::DEFAULT_HPACK_TABLE_SIZE),                   \
                      ::testing::Values(Http2Settings::DEFAULT_MAX_CONCURRENT_STREAMS),             \
@@ -600,6 +772,11 @@ INSTANTIATE_TEST_CASE_P(Http2CodecImplTestDefaultSettings, Http2CodecImplTest,
                         ::testing::Combine(HTTP2SETTINGS_DEFAULT_COMBINE,
                                            HTTP2SETTINGS_DEFAULT_COMBINE));
 
+// Write scheduling tests use the default windows so that flow control doesn't hold back frames.
+INSTANTIATE_TEST_CASE_P(Http2CodecImplWriteSchedulingTest, Http2CodecImplWriteSchedulingTest,
+                        ::testing::Combine(HTTP2SETTINGS_DEFAULT_COMBINE,
+                                           HTTP2SETTINGS_DEFAULT_COMBINE));
+
 #define HTTP2SETTINGS_EDGE_COMBINE                                                                 \
   ::testing::Combine(                                                                              \
       ::testing::Values(Http2Settings::MIN_HPACK_TABLE_SIZE, Http2Settings::MAX_HPACK_TABLE_SIZE), \
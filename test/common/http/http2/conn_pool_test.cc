@@ -177,6 +177,50 @@ TEST_F(Http2ConnPoolImplTest, RequestAndResponse) {
   dispatcher_.clearDeferredDeleteList();
 }
 
+TEST_F(Http2ConnPoolImplTest, MultipleConnectionsLeastLoaded) {
+  InSequence s;
+  cluster_->http2_settings_.max_connections_per_host_ = 2;
+  cluster_->http2_settings_.connection_stream_threshold_ = 1;
+
+  expectClientCreate();
+  ActiveTestRequest r1(*this, 0);
+  EXPECT_CALL(r1.inner_encoder_, encodeHeaders(_, true));
+  r1.callbacks_.outer_encoder_->encodeHeaders(HeaderMapImpl{}, true);
+  expectClientConnect(0);
+
+  // The only connection is at the threshold, so a second one is opened.
+  expectClientCreate();
+  ActiveTestRequest r2(*this, 1);
+  EXPECT_CALL(r2.inner_encoder_, encodeHeaders(_, true));
+  r2.callbacks_.outer_encoder_->encodeHeaders(HeaderMapImpl{}, true);
+  expectClientConnect(1);
+
+  // Both connections are at the threshold but the pool is full, so the first one is used.
+  ActiveTestRequest r3(*this, 0);
+  EXPECT_CALL(r3.inner_encoder_, encodeHeaders(_, true));
+  r3.callbacks_.outer_encoder_->encodeHeaders(HeaderMapImpl{}, true);
+
+  // The second connection is now the least loaded one.
+  EXPECT_CALL(r2.decoder_, decodeHeaders_(_, true));
+  r2.inner_decoder_->decodeHeaders(HeaderMapPtr{new HeaderMapImpl{}}, true);
+  ActiveTestRequest r4(*this, 1);
+  EXPECT_CALL(r4.inner_encoder_, encodeHeaders(_, true));
+  r4.callbacks_.outer_encoder_->encodeHeaders(HeaderMapImpl{}, true);
+
+  EXPECT_CALL(r1.decoder_, decodeHeaders_(_, true));
+  r1.inner_decoder_->decodeHeaders(HeaderMapPtr{new HeaderMapImpl{}}, true);
+  EXPECT_CALL(r3.decoder_, decodeHeaders_(_, true));
+  r3.inner_decoder_->decodeHeaders(HeaderMapPtr{new HeaderMapImpl{}}, true);
+  EXPECT_CALL(r4.decoder_, decodeHeaders_(_, true));
+  r4.inner_decoder_->decodeHeaders(HeaderMapPtr{new HeaderMapImpl{}}, true);
+
+  EXPECT_EQ(2U, cluster_->stats_.upstream_cx_total_.value());
+  test_clients_[0].connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  test_clients_[1].connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_CALL(*this, onClientDestroy()).Times(2);
+  dispatcher_.clearDeferredDeleteList();
+}
+
 TEST_F(Http2ConnPoolImplTest, LocalReset) {
   InSequence s;
 
@@ -358,8 +402,8 @@ TEST_F(Http2ConnPoolImplTest, ConnectTimeout) {
 
 TEST_F(Http2ConnPoolImplTest, MaxGlobalRequests) {
   InSequence s;
-  cluster_->resource_manager_.reset(
-      new Upstream::ResourceManagerImpl(runtime_, "fake_key", 1024, 1024, 1, 1));
+  cluster_->resource_manager_.reset(new Upstream::ResourceManagerImpl(
+      runtime_, "fake_key", 1024, 1024, 1, 1, cluster_->stats_store_));
 
   expectClientCreate();
   ActiveTestRequest r1(*this, 0);
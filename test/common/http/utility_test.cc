@@ -8,6 +8,7 @@
 #include "common/network/address_impl.h"
 
 #include "test/mocks/http/mocks.h"
+#include "test/mocks/runtime/mocks.h"
 #include "test/test_common/printers.h"
 #include "test/test_common/utility.h"
 
@@ -15,6 +16,8 @@
 #include "gtest/gtest.h"
 
 using testing::InvokeWithoutArgs;
+using testing::NiceMock;
+using testing::Return;
 using testing::_;
 
 namespace Envoy {
@@ -147,6 +150,52 @@ TEST(HttpUtility, parseHttp2Settings) {
   }
 }
 
+TEST(HttpUtility, parseHttp2SettingsWithRuntime) {
+  envoy::api::v2::Http2ProtocolOptions http2_protocol_options;
+  NiceMock<Runtime::MockLoader> runtime;
+
+  {
+    auto http2_settings =
+        Utility::parseHttp2Settings(http2_protocol_options, runtime, "upstream.foo.");
+    EXPECT_EQ(Http2Settings::DEFAULT_MAX_FRAME_SIZE, http2_settings.max_frame_size_);
+  }
+
+  {
+    EXPECT_CALL(runtime.snapshot_, getInteger("upstream.foo.http2.max_frame_size",
+                                              Http2Settings::DEFAULT_MAX_FRAME_SIZE))
+        .WillOnce(Return(65536));
+    auto http2_settings =
+        Utility::parseHttp2Settings(http2_protocol_options, runtime, "upstream.foo.");
+    EXPECT_EQ(65536U, http2_settings.max_frame_size_);
+    EXPECT_EQ(Http2Settings::DEFAULT_HPACK_TABLE_SIZE, http2_settings.hpack_table_size_);
+  }
+
+  {
+    EXPECT_CALL(runtime.snapshot_, getInteger("upstream.foo.http2.max_frame_size", _))
+        .WillOnce(Return(1));
+    EXPECT_EQ(Http2Settings::MIN_MAX_FRAME_SIZE,
+              Utility::parseHttp2Settings(http2_protocol_options, runtime, "upstream.foo.")
+                  .max_frame_size_);
+  }
+
+  {
+    EXPECT_CALL(runtime.snapshot_, getInteger("upstream.foo.http2.max_frame_size", _))
+        .WillOnce(Return(1 << 30));
+    EXPECT_EQ(Http2Settings::MAX_MAX_FRAME_SIZE,
+              Utility::parseHttp2Settings(http2_protocol_options, runtime, "upstream.foo.")
+                  .max_frame_size_);
+  }
+
+  {
+    EXPECT_EQ(0U, Utility::parseHttp2Settings(http2_protocol_options, runtime, "upstream.foo.")
+                      .small_stream_boost_bytes_);
+    EXPECT_CALL(runtime.snapshot_, getInteger("upstream.foo.http2.small_stream_boost_bytes", 0))
+        .WillOnce(Return(16384));
+    EXPECT_EQ(16384U, Utility::parseHttp2Settings(http2_protocol_options, runtime, "upstream.foo.")
+                          .small_stream_boost_bytes_);
+  }
+}
+
 TEST(HttpUtility, TwoAddressesInXFF) {
   const std::string first_address = "34.0.0.1";
   const std::string second_address = "10.0.0.1";
@@ -173,6 +222,18 @@ TEST(HttpUtility, OneAddressInXFF) {
   EXPECT_EQ(first_address, Utility::getLastAddressFromXFF(request_headers));
 }
 
+TEST(HttpUtility, SeparatorsInXFF) {
+  {
+    TestHeaderMapImpl request_headers{{"x-forwarded-for", "34.0.0.1,10.0.0.1, "}};
+    EXPECT_EQ("10.0.0.1", Utility::getLastAddressFromXFF(request_headers));
+  }
+
+  {
+    TestHeaderMapImpl request_headers{{"x-forwarded-for", " , "}};
+    EXPECT_EQ("", Utility::getLastAddressFromXFF(request_headers));
+  }
+}
+
 TEST(HttpUtility, TestParseCookie) {
   TestHeaderMapImpl headers{
       {"someheader", "10.0.0.1"},
@@ -1,6 +1,7 @@
 #include <string>
 #include <vector>
 
+#include "common/buffer/buffer_impl.h"
 #include "common/json/json_loader.h"
 
 #include "test/test_common/utility.h"
@@ -336,6 +337,26 @@ TEST(JsonLoaderTest, NestedSchema) {
                             "key: #/value1");
 }
 
+TEST(JsonLoaderTest, SchemaReused) {
+  std::string schema = R"EOF(
+  {
+    "properties": {
+      "value1": {"type" : "integer", "minimum": 0}
+    },
+    "additionalProperties": false
+  }
+  )EOF";
+
+  // The parsed schema is shared by all the validations against it.
+  for (int i = 0; i < 3; i++) {
+    EXPECT_NO_THROW(Factory::loadFromString("{\"value1\": 10}")->validateSchema(schema));
+    EXPECT_THROW_WITH_MESSAGE(
+        Factory::loadFromString("{\"value1\": -10}")->validateSchema(schema), Exception,
+        "JSON at lines 1-1 does not conform to schema.\n Invalid schema: "
+        "#/properties/value1\n Schema violation: minimum\n Offending document key: #/value1");
+  }
+}
+
 TEST(JsonLoaderTest, MissingEnclosingDocument) {
 
   std::string json_string = R"EOF(
@@ -352,6 +373,25 @@ TEST(JsonLoaderTest, MissingEnclosingDocument) {
                             "parsing due to Handler error.\n");
 }
 
+TEST(JsonLoaderTest, Buffer) {
+  // Each of the buffers moved into the body keeps its own slice, so that tokens span slices.
+  Buffer::OwnedImpl body;
+  for (const std::string& part : {"{\"hel", "", "lo\":", "\n[\"a\", \"b", "c\"]}"}) {
+    Buffer::OwnedImpl buffer(part);
+    body.move(buffer);
+  }
+  ObjectSharedPtr json = Factory::loadFromBuffer(body);
+  EXPECT_EQ((std::vector<std::string>{"a", "bc"}), json->getStringArray("hello"));
+  EXPECT_THROW_WITH_MESSAGE(json->getString("hello"), Exception,
+                            "key 'hello' missing or not a string from lines 1-2");
+  EXPECT_EQ(22U, body.length());
+
+  Buffer::OwnedImpl empty;
+  EXPECT_THROW(Factory::loadFromBuffer(empty), Exception);
+  Buffer::OwnedImpl invalid("{\n\"hello\"}");
+  EXPECT_THROW(Factory::loadFromBuffer(invalid), Exception);
+}
+
 TEST(JsonLoaderTest, AsString) {
   ObjectSharedPtr json = Factory::loadFromString("{\"name1\": \"value1\", \"name2\": true}");
   json->iterate([&](const std::string& key, const Json::Object& value) {
@@ -376,6 +416,14 @@ TEST(JsonLoaderTest, AsJsonString) {
   EXPECT_TRUE(json2->getBoolean("name2"));
 }
 
+TEST(JsonLoaderTest, AsJsonStringNested) {
+  const std::string json_string =
+      R"EOF({"array":[1,-2,2.5,"str\"ing",null,false,[],{"key":{}}]})EOF";
+  const ObjectSharedPtr json = Factory::loadFromString(json_string);
+  EXPECT_EQ(json_string, json->asJsonString());
+  EXPECT_EQ(json->hash(), Factory::loadFromString(json->asJsonString())->hash());
+}
+
 TEST(JsonLoaderTest, ListAsString) {
   {
     std::list<std::string> list = {};
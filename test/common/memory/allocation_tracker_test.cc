@@ -0,0 +1,96 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/memory/allocation_tracker.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Memory {
+
+class AllocationTrackerTest : public testing::Test {
+public:
+  ~AllocationTrackerTest() { AllocationTracker::disable(); }
+
+  // Allocate through a volatile pointer, so that the allocation cannot be optimized away.
+  void allocate(size_t size) {
+    char* volatile allocation = new char[size];
+    delete[] allocation;
+  }
+
+  AllocationCounts testThreadCounts() {
+    for (const ThreadAllocationCounts& thread : AllocationTracker::threadCounts()) {
+      if (thread.name_ == "test") {
+        return thread.counts_;
+      }
+    }
+    ADD_FAILURE() << "the test thread is not registered";
+    return {};
+  }
+};
+
+TEST_F(AllocationTrackerTest, DisabledByDefault) {
+  EXPECT_FALSE(AllocationTracker::enabled());
+
+  AllocationCounts counts;
+  {
+    AllocationScope scope(counts);
+    allocate(100);
+  }
+  EXPECT_EQ(0U, counts.allocations_);
+  EXPECT_EQ(0U, counts.bytes_);
+}
+
+TEST_F(AllocationTrackerTest, NestedScopes) {
+  if (!AllocationTracker::enable()) {
+    return;
+  }
+
+  AllocationCounts outer;
+  AllocationCounts inner;
+  {
+    AllocationScope outer_scope(outer);
+    allocate(100);
+    {
+      AllocationScope inner_scope(inner);
+      allocate(1000);
+      allocate(1000);
+    }
+    allocate(100);
+  }
+  allocate(100);
+
+  EXPECT_EQ(2U, outer.allocations_);
+  EXPECT_EQ(200U, outer.bytes_);
+  EXPECT_EQ(2U, inner.allocations_);
+  EXPECT_EQ(2000U, inner.bytes_);
+
+  AllocationTracker::disable();
+  EXPECT_FALSE(AllocationTracker::enabled());
+  {
+    AllocationScope scope(outer);
+    allocate(100);
+  }
+  EXPECT_EQ(2U, outer.allocations_);
+}
+
+TEST_F(AllocationTrackerTest, RegisteredThread) {
+  AllocationTracker::registerThread("test");
+  EXPECT_EQ(0U, testThreadCounts().allocations_);
+
+  if (AllocationTracker::enable()) {
+    const AllocationCounts before = testThreadCounts();
+    allocate(1000);
+    const AllocationCounts after = testThreadCounts();
+    // threadCounts() allocates too, so only lower bounds are known.
+    EXPECT_LE(before.allocations_ + 1, after.allocations_);
+    EXPECT_LE(before.bytes_ + 1000, after.bytes_);
+  }
+
+  AllocationTracker::unregisterThread();
+  EXPECT_TRUE(AllocationTracker::threadCounts().empty());
+}
+
+} // namespace Memory
+} // namespace Envoy
@@ -4,6 +4,7 @@
 #include "common/mongo/bson_impl.h"
 
 #include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
 
 #include "gtest/gtest.h"
 
@@ -48,6 +49,80 @@ TEST(BsonImplTest, InvalodDocumentTermination) {
   EXPECT_THROW(DocumentImpl::create(buffer), EnvoyException);
 }
 
+TEST(BsonImplTest, InvalidStringLength) {
+  Buffer::OwnedImpl buffer;
+  DocumentImpl::create()->addString("hello", "world")->encode(buffer);
+  // Point the string length past the end of the document.
+  std::string encoded = TestUtility::bufferToString(buffer);
+  encoded[11] = 100;
+  Buffer::OwnedImpl invalid(encoded);
+  EXPECT_THROW(DocumentImpl::create(invalid), EnvoyException);
+}
+
+TEST(BsonImplTest, InvalidNestedDocument) {
+  Buffer::OwnedImpl buffer;
+  DocumentImpl::create()
+      ->addDocument("nested", DocumentImpl::create()->addInt32("a", 1))
+      ->encode(buffer);
+  // The nested document is checked when the top level one is decoded.
+  std::string encoded = TestUtility::bufferToString(buffer);
+  encoded[encoded.size() - 2] = 1;
+  Buffer::OwnedImpl invalid(encoded);
+  EXPECT_THROW(DocumentImpl::create(invalid), EnvoyException);
+}
+
+TEST(BsonImplTest, Decode) {
+  DocumentSharedPtr nested = DocumentImpl::create()->addString("b", "c")->addInt64("d", 2);
+  DocumentSharedPtr doc = DocumentImpl::create()
+                              ->addInt32("a", 1)
+                              ->addDocument("nested", nested)
+                              ->addBinary("binary", std::string("\0\1", 2))
+                              ->addRegex("regex", {"pattern", "options"})
+                              ->addDouble("a", 2.0);
+  Buffer::OwnedImpl buffer;
+  doc->encode(buffer);
+  const std::string encoded = TestUtility::bufferToString(buffer);
+  buffer.add("next");
+
+  DocumentSharedPtr decoded = DocumentImpl::create(buffer);
+  EXPECT_EQ("next", TestUtility::bufferToString(buffer));
+  EXPECT_EQ(doc->byteSize(), decoded->byteSize());
+
+  // Fields are found without parsing the others, the first one with the key wins.
+  EXPECT_EQ(1, decoded->find("a")->asInt32());
+  EXPECT_EQ(2.0, decoded->find("a", Field::Type::DOUBLE)->asDouble());
+  EXPECT_EQ(nullptr, decoded->find("a", Field::Type::STRING));
+  EXPECT_EQ(nullptr, decoded->find("missing"));
+  const Document& decoded_nested = decoded->find("nested")->asDocument();
+  EXPECT_EQ("c", decoded_nested.find("b")->asString());
+  EXPECT_EQ(*nested, decoded_nested);
+  EXPECT_EQ(std::string("\0\1", 2), decoded->find("binary")->asBinary());
+  EXPECT_EQ("options", decoded->find("regex")->asRegex().options_);
+
+  // Unmodified documents are encoded as they were decoded.
+  Buffer::OwnedImpl reencoded;
+  decoded->encode(reencoded);
+  EXPECT_EQ(encoded, TestUtility::bufferToString(reencoded));
+
+  // Found fields stay valid once all of the fields are parsed.
+  const Field* field = decoded->find("a");
+  EXPECT_EQ(5UL, decoded->values().size());
+  EXPECT_EQ(field, decoded->values().front().get());
+  EXPECT_EQ(*doc, *decoded);
+  EXPECT_EQ(doc->toString(), decoded->toString());
+  EXPECT_EQ(field, decoded->find("a"));
+
+  // Modified documents are encoded from their fields.
+  decoded->addNull("null");
+  doc->addNull("null");
+  Buffer::OwnedImpl modified;
+  decoded->encode(modified);
+  Buffer::OwnedImpl expected;
+  doc->encode(expected);
+  EXPECT_EQ(TestUtility::bufferToString(expected), TestUtility::bufferToString(modified));
+  EXPECT_EQ(doc->byteSize(), decoded->byteSize());
+}
+
 TEST(BufferHelperTest, InvalidSize) {
   Buffer::OwnedImpl buffer;
   EXPECT_THROW(BufferHelper::peakInt32(buffer), EnvoyException);
@@ -13,18 +13,24 @@
 using testing::Eq;
 using testing::NiceMock;
 using testing::Pointee;
+using testing::Return;
+using testing::_;
 
 namespace Envoy {
 namespace Mongo {
 
 class TestDecoderCallbacks : public DecoderCallbacks {
 public:
+  TestDecoderCallbacks() { ON_CALL(*this, decodeHeader(_, _, _)).WillByDefault(Return(true)); }
+
   void decodeGetMore(GetMoreMessagePtr&& message) override { decodeGetMore_(message); }
   void decodeInsert(InsertMessagePtr&& message) override { decodeInsert_(message); }
   void decodeKillCursors(KillCursorsMessagePtr&& message) override { decodeKillCursors_(message); }
   void decodeQuery(QueryMessagePtr&& message) override { decodeQuery_(message); }
   void decodeReply(ReplyMessagePtr&& message) override { decodeReply_(message); }
 
+  MOCK_METHOD3(decodeHeader,
+               bool(int32_t request_id, int32_t response_to, Message::OpCode op_code));
   MOCK_METHOD1(decodeGetMore_, void(GetMoreMessagePtr& message));
   MOCK_METHOD1(decodeInsert_, void(InsertMessagePtr& message));
   MOCK_METHOD1(decodeKillCursors_, void(KillCursorsMessagePtr& message));
@@ -314,6 +320,33 @@ TEST_F(MongoCodecImplTest, InvalidMessage) {
   EXPECT_THROW(decoder_.onData(output_), EnvoyException);
 }
 
+TEST_F(MongoCodecImplTest, InvalidMessageLength) {
+  Bson::BufferHelper::writeInt32(output_, 15); // Size
+  Bson::BufferHelper::writeInt32(output_, 0);  // Request ID
+  Bson::BufferHelper::writeInt32(output_, 1);  // Response to
+  Bson::BufferHelper::writeInt32(output_, static_cast<int32_t>(Message::OpCode::OP_QUERY));
+  EXPECT_THROW(decoder_.onData(output_), EnvoyException);
+}
+
+TEST_F(MongoCodecImplTest, SkipMessage) {
+  QueryMessageImpl query(1, 0);
+  query.fullCollectionName("test");
+  query.query(Bson::DocumentImpl::create()->addString("string", "string"));
+  encoder_.encodeQuery(query);
+  InsertMessageImpl insert(2, 0);
+  insert.fullCollectionName("test");
+  insert.documents().push_back(Bson::DocumentImpl::create()->addString("world", "hello"));
+  encoder_.encodeInsert(insert);
+
+  // Skipped messages are drained without being decoded.
+  EXPECT_CALL(callbacks_, decodeHeader(1, 0, Message::OpCode::OP_QUERY)).WillOnce(Return(false));
+  EXPECT_CALL(callbacks_, decodeQuery_(_)).Times(0);
+  EXPECT_CALL(callbacks_, decodeHeader(2, 0, Message::OpCode::OP_INSERT)).WillOnce(Return(true));
+  EXPECT_CALL(callbacks_, decodeInsert_(Pointee(Eq(insert))));
+  decoder_.onData(output_);
+  EXPECT_EQ(0U, output_.length());
+}
+
 TEST_F(MongoCodecImplTest, QueryToStringWithEscape) {
   QueryMessageImpl query(1, 1);
   query.flags(0x4);
@@ -379,6 +379,44 @@ TEST_F(MongoProxyFilterTest, DecodeError) {
   EXPECT_EQ(1U, store_.counter("test.decoding_error").value());
 }
 
+TEST_F(MongoProxyFilterTest, DecodingSampled) {
+  setupDelayFault(true);
+  initializeFilter();
+
+  Event::MockTimer* delay_timer =
+      new Event::MockTimer(&read_filter_callbacks_.connection_.dispatcher_);
+  EXPECT_CALL(*delay_timer, enableTimer(std::chrono::milliseconds(10)));
+  EXPECT_CALL(runtime_.snapshot_, featureEnabled("mongo.decoding_enabled", 100))
+      .WillOnce(Return(false))
+      .WillOnce(Return(true))
+      .WillRepeatedly(Return(false));
+
+  EXPECT_CALL(*filter_->decoder_, onData(_)).WillOnce(Invoke([&](Buffer::Instance&) -> void {
+    // Faults are injected into the requests that are not decoded.
+    EXPECT_FALSE(filter_->callbacks_->decodeHeader(1, 0, Message::OpCode::OP_QUERY));
+
+    EXPECT_TRUE(filter_->callbacks_->decodeHeader(2, 0, Message::OpCode::OP_QUERY));
+    QueryMessagePtr message(new QueryMessageImpl(2, 0));
+    message->fullCollectionName("db.test");
+    message->query(Bson::DocumentImpl::create());
+    filter_->callbacks_->decodeQuery(std::move(message));
+  }));
+  filter_->onData(fake_data_);
+  EXPECT_EQ(1U, store_.counter("test.op_query").value());
+  EXPECT_EQ(1U, store_.counter("test.delays_injected").value());
+
+  EXPECT_CALL(*filter_->decoder_, onData(_)).WillOnce(Invoke([&](Buffer::Instance&) -> void {
+    // Only the reply to the decoded query is decoded.
+    EXPECT_FALSE(filter_->callbacks_->decodeHeader(3, 1, Message::OpCode::OP_REPLY));
+    EXPECT_TRUE(filter_->callbacks_->decodeHeader(4, 2, Message::OpCode::OP_REPLY));
+  }));
+  filter_->onWrite(fake_data_);
+  EXPECT_EQ(2U, store_.counter("test.decoding_skipped").value());
+
+  EXPECT_CALL(read_filter_callbacks_, continueReading());
+  delay_timer->callback_();
+}
+
 TEST_F(MongoProxyFilterTest, ConcurrentQuery) {
   initializeFilter();
 
@@ -267,6 +267,26 @@ TEST(PipeInstanceTest, Basic) {
   EXPECT_EQ(nullptr, address.ip());
 }
 
+// IP addresses compare by their network address and port, without formatting them.
+TEST(AddressImplTest, Equality) {
+  Ipv4Instance ipv4("1.2.3.4", 80);
+  EXPECT_TRUE(ipv4 == Ipv4Instance("1.2.3.4", 80));
+  EXPECT_FALSE(ipv4 == Ipv4Instance("1.2.3.4", 81));
+  EXPECT_FALSE(ipv4 == Ipv4Instance("1.2.3.5", 80));
+  EXPECT_FALSE(ipv4 == Ipv6Instance("::ffff:1.2.3.4", 80));
+  EXPECT_FALSE(ipv4 == PipeInstance("/foo"));
+
+  Ipv6Instance ipv6("01:0:0::1", 443);
+  EXPECT_TRUE(ipv6 == Ipv6Instance("1::1", 443));
+  EXPECT_FALSE(ipv6 == Ipv6Instance("1::1", 80));
+  EXPECT_FALSE(ipv6 == Ipv6Instance("1::2", 443));
+  EXPECT_FALSE(ipv6 == PipeInstance("/foo"));
+  EXPECT_EQ("[1::1]:443", ipv6.asString());
+
+  EXPECT_TRUE(PipeInstance("/foo") == PipeInstance("/foo"));
+  EXPECT_FALSE(PipeInstance("/foo") == PipeInstance("/bar"));
+}
+
 TEST(AddressFromSockAddr, IPv4) {
   sockaddr_storage ss;
   auto& sin = reinterpret_cast<sockaddr_in&>(ss);
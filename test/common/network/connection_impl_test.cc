@@ -3,6 +3,7 @@
 #include <string>
 
 #include "common/buffer/buffer_impl.h"
+#include "common/buffer/watermark_buffer.h"
 #include "common/common/empty_string.h"
 #include "common/event/dispatcher_impl.h"
 #include "common/network/address_impl.h"
@@ -402,6 +403,33 @@ TEST_P(ConnectionImplTest, BasicWrite) {
   disconnect(true);
 }
 
+// Writes made during one iteration of the event loop are coalesced into a single socket write.
+TEST_P(ConnectionImplTest, CoalescedWrites) {
+  useMockBuffer();
+
+  setUpBasicConnection();
+
+  connect();
+
+  std::string data_written;
+  EXPECT_CALL(*client_write_buffer_, move(_))
+      .WillRepeatedly(DoAll(AddBufferToStringWithoutDraining(&data_written),
+                            Invoke(client_write_buffer_, &MockWatermarkBuffer::baseMove)));
+  EXPECT_CALL(*client_write_buffer_, write(_))
+      .WillOnce(Invoke(client_write_buffer_, &MockWatermarkBuffer::trackWrites));
+  std::string expected;
+  for (uint32_t i = 0; i < 20; i++) {
+    Buffer::OwnedImpl buffer_to_write(std::string(600, 'a' + i));
+    expected += TestUtility::bufferToString(buffer_to_write);
+    client_connection_->write(buffer_to_write);
+  }
+  dispatcher_->run(Event::Dispatcher::RunType::NonBlock);
+  EXPECT_EQ(expected, data_written);
+  EXPECT_EQ(expected.size(), static_cast<uint64_t>(client_write_buffer_->bytes_written()));
+
+  disconnect(true);
+}
+
 // Similar to BasicWrite, only with watermarks set.
 TEST_P(ConnectionImplTest, WriteWithWatermarks) {
   useMockBuffer();
@@ -573,17 +601,117 @@ TEST_P(ConnectionImplTest, BindFailureTest) {
   dispatcher_->run(Event::Dispatcher::RunType::NonBlock);
 }
 
+// A connection with filters to skip, or spliced with itself, is not spliced.
+TEST_P(ConnectionImplTest, SpliceRefused) {
+  setUpBasicConnection();
+  connect();
+
+  EXPECT_FALSE(server_connection_->spliceWith(*server_connection_));
+  server_connection_->addWriteFilter(std::make_shared<NiceMock<MockWriteFilter>>());
+  EXPECT_FALSE(server_connection_->spliceWith(*client_connection_));
+  EXPECT_FALSE(client_connection_->spliceWith(*server_connection_));
+
+  disconnect(true);
+}
+
+#ifdef __linux__
+// Data read from a spliced connection reaches the other end of its peer without passing through the
+// read filters, in both directions. The connections are chained as client_connection_ ->
+// server_connection_ -> second_client -> second_server, with the middle two spliced.
+TEST_P(ConnectionImplTest, Splice) {
+  setUpBasicConnection();
+  connect();
+
+  ClientConnectionPtr second_client =
+      dispatcher_->createClientConnection(socket_.localAddress(), source_address_);
+  StrictMock<MockConnectionCallbacks> second_client_callbacks;
+  second_client->addConnectionCallbacks(second_client_callbacks);
+  second_client->connect();
+  ConnectionPtr second_server;
+  std::shared_ptr<MockReadFilter> second_server_filter(new NiceMock<MockReadFilter>());
+  int expected_callbacks = 2;
+  EXPECT_CALL(listener_callbacks_, onNewConnection_(_))
+      .WillOnce(Invoke([&](Network::ConnectionPtr& conn) -> void {
+        second_server = std::move(conn);
+        second_server->addReadFilter(second_server_filter);
+        if (--expected_callbacks == 0) {
+          dispatcher_->exit();
+        }
+      }));
+  EXPECT_CALL(second_client_callbacks, onEvent(ConnectionEvent::Connected))
+      .WillOnce(Invoke([&](Network::ConnectionEvent) -> void {
+        if (--expected_callbacks == 0) {
+          dispatcher_->exit();
+        }
+      }));
+  dispatcher_->run(Event::Dispatcher::RunType::Block);
+
+  ASSERT_TRUE(server_connection_->spliceWith(*second_client));
+  EXPECT_CALL(*read_filter_, onData(_)).Times(0);
+
+  // More than a pipe holds, so that reads wait for the pipe to be written.
+  const std::string request(256 * 1024, 'a');
+  std::string received;
+  EXPECT_CALL(*second_server_filter, onData(_))
+      .WillRepeatedly(Invoke([&](Buffer::Instance& data) -> FilterStatus {
+        received += TestUtility::bufferToString(data);
+        data.drain(data.length());
+        if (received.size() == request.size()) {
+          dispatcher_->exit();
+        }
+        return FilterStatus::StopIteration;
+      }));
+  Buffer::OwnedImpl request_buffer(request);
+  client_connection_->write(request_buffer);
+  dispatcher_->run(Event::Dispatcher::RunType::Block);
+  EXPECT_EQ(request, received);
+
+  std::shared_ptr<MockReadFilter> client_filter(new NiceMock<MockReadFilter>());
+  client_connection_->addReadFilter(client_filter);
+  const std::string response = "world";
+  received.clear();
+  EXPECT_CALL(*client_filter, onData(_))
+      .WillRepeatedly(Invoke([&](Buffer::Instance& data) -> FilterStatus {
+        received += TestUtility::bufferToString(data);
+        data.drain(data.length());
+        if (received.size() == response.size()) {
+          dispatcher_->exit();
+        }
+        return FilterStatus::StopIteration;
+      }));
+  Buffer::OwnedImpl response_buffer(response);
+  second_server->write(response_buffer);
+  dispatcher_->run(Event::Dispatcher::RunType::Block);
+  EXPECT_EQ(response, received);
+
+  // A spliced connection still sees the remote close.
+  EXPECT_CALL(client_callbacks_, onEvent(ConnectionEvent::LocalClose));
+  client_connection_->close(ConnectionCloseType::NoFlush);
+  EXPECT_CALL(server_callbacks_, onEvent(ConnectionEvent::RemoteClose))
+      .WillOnce(Invoke([&](Network::ConnectionEvent) -> void { dispatcher_->exit(); }));
+  dispatcher_->run(Event::Dispatcher::RunType::Block);
+
+  EXPECT_CALL(second_client_callbacks, onEvent(ConnectionEvent::LocalClose));
+  second_client->close(ConnectionCloseType::NoFlush);
+  second_server->close(ConnectionCloseType::NoFlush);
+  dispatcher_->run(Event::Dispatcher::RunType::NonBlock);
+}
+#endif
+
 class ReadBufferLimitTest : public ConnectionImplTest {
 public:
-  void readBufferLimitTest(uint32_t read_buffer_limit, uint32_t expected_chunk_size) {
+  void readBufferLimitTest(uint32_t read_buffer_limit, uint64_t read_budget,
+                           uint32_t expected_chunk_size) {
     const uint32_t buffer_size = 256 * 1024;
-    dispatcher_.reset(new Event::DispatcherImpl);
+    dispatcher_.reset(new Event::DispatcherImpl(
+        Buffer::WatermarkFactoryPtr{new Buffer::WatermarkBufferFactory}, read_budget));
     listener_ =
         dispatcher_->createListener(connection_handler_, socket_, listener_callbacks_, stats_store_,
                                     {.bind_to_port_ = true,
                                      .use_proxy_proto_ = false,
                                      .use_original_dst_ = false,
-                                     .per_connection_buffer_limit_bytes_ = read_buffer_limit});
+                                     .per_connection_buffer_limit_bytes_ = read_buffer_limit,
+                                     .max_accepts_per_event_ = 0});
 
     client_connection_ = dispatcher_->createClientConnection(
         socket_.localAddress(), Network::Address::InstanceConstSharedPtr());
@@ -632,9 +760,13 @@ public:
 INSTANTIATE_TEST_CASE_P(IpVersions, ReadBufferLimitTest,
                         testing::ValuesIn(TestEnvironment::getIpVersionsForTest()));
 
-TEST_P(ReadBufferLimitTest, NoLimit) { readBufferLimitTest(0, 256 * 1024); }
+TEST_P(ReadBufferLimitTest, NoLimit) { readBufferLimitTest(0, 0, 256 * 1024); }
+
+TEST_P(ReadBufferLimitTest, SomeLimit) { readBufferLimitTest(32 * 1024, 0, 32 * 1024); }
 
-TEST_P(ReadBufferLimitTest, SomeLimit) { readBufferLimitTest(32 * 1024, 32 * 1024); }
+// A read event stops reading once it read the budget, which it can exceed by at most one read of
+// at most 64K.
+TEST_P(ReadBufferLimitTest, ReadBudget) { readBufferLimitTest(0, 16 * 1024, 80 * 1024); }
 
 class TcpClientConnectionImplTest : public testing::TestWithParam<Address::IpVersion> {};
 INSTANTIATE_TEST_CASE_P(IpVersions, TcpClientConnectionImplTest,
@@ -2,6 +2,7 @@
 #include <arpa/nameser.h>
 #include <arpa/nameser_compat.h>
 
+#include <chrono>
 #include <list>
 #include <memory>
 #include <string>
@@ -19,6 +20,7 @@
 #include "common/network/utility.h"
 #include "common/stats/stats_impl.h"
 
+#include "test/mocks/common.h"
 #include "test/mocks/network/mocks.h"
 #include "test/test_common/environment.h"
 #include "test/test_common/network_utility.h"
@@ -29,6 +31,7 @@
 #include "gtest/gtest.h"
 
 using testing::InSequence;
+using testing::Invoke;
 using testing::Mock;
 using testing::NiceMock;
 using testing::Return;
@@ -49,8 +52,10 @@ enum record_type { A, AAAA };
 
 class TestDnsServerQuery {
 public:
-  TestDnsServerQuery(ConnectionPtr connection, const HostMap& hosts_A, const HostMap& hosts_AAAA)
-      : connection_(std::move(connection)), hosts_A_(hosts_A), hosts_AAAA_(hosts_AAAA) {
+  TestDnsServerQuery(ConnectionPtr connection, const HostMap& hosts_A, const HostMap& hosts_AAAA,
+                     const uint32_t& ttl, uint32_t& query_count)
+      : connection_(std::move(connection)), hosts_A_(hosts_A), hosts_AAAA_(hosts_AAAA), ttl_(ttl),
+        query_count_(query_count) {
     connection_->addReadFilter(Network::ReadFilterSharedPtr{new ReadFilter(*this)});
   }
 
@@ -92,6 +97,7 @@ private:
         unsigned char* request = static_cast<unsigned char*>(buffer_.linearize(size_));
         // Only expecting a single question.
         ASSERT_EQ(1, DNS_HEADER_QDCOUNT(request));
+        parent_.query_count_++;
         // Decode the question and perform lookup.
         const unsigned char* question = request + HFIXEDSZ;
         // The number of bytes the encoded question name takes up in the request.
@@ -143,7 +149,7 @@ private:
           DNS_RR_SET_LEN(response_rr_fixed, sizeof(in6_addr));
         }
         DNS_RR_SET_CLASS(response_rr_fixed, C_IN);
-        DNS_RR_SET_TTL(response_rr_fixed, 0);
+        DNS_RR_SET_TTL(response_rr_fixed, parent_.ttl_);
 
         size_t response_rest_len;
         if (q_type == T_A) {
@@ -194,13 +200,19 @@ private:
   ConnectionPtr connection_;
   const HostMap& hosts_A_;
   const HostMap& hosts_AAAA_;
+  const uint32_t& ttl_;
+  uint32_t& query_count_;
 };
 
 class TestDnsServer : public ListenerCallbacks {
 public:
+  bool onAccept(int, Address::InstanceConstSharedPtr, Address::InstanceConstSharedPtr,
+                bool) override {
+    return false;
+  }
   void onNewConnection(ConnectionPtr&& new_connection) override {
-    TestDnsServerQuery* query =
-        new TestDnsServerQuery(std::move(new_connection), hosts_A_, hosts_AAAA_);
+    TestDnsServerQuery* query = new TestDnsServerQuery(std::move(new_connection), hosts_A_,
+                                                       hosts_AAAA_, ttl_, query_count_);
     queries_.emplace_back(query);
   }
 
@@ -212,9 +224,15 @@ public:
     }
   }
 
+  // The TTL in seconds of the answers.
+  void setTtl(uint32_t ttl) { ttl_ = ttl; }
+  uint32_t queryCount() const { return query_count_; }
+
 private:
   HostMap hosts_A_;
   HostMap hosts_AAAA_;
+  uint32_t ttl_{};
+  uint32_t query_count_{};
   // All queries are tracked so we can do resource reclamation when the test is
   // over.
   std::vector<std::unique_ptr<TestDnsServerQuery>> queries_;
@@ -273,7 +291,7 @@ TEST(DnsImplConstructor, SupportsCustomResolvers) {
 class DnsImplTest : public testing::TestWithParam<Address::IpVersion> {
 public:
   void SetUp() override {
-    resolver_ = dispatcher_.createDnsResolver({});
+    resolver_ = createResolver();
 
     // Instantiate TestDnsServer and listen on a random port on the loopback address.
     server_.reset(new TestDnsServer());
@@ -283,7 +301,8 @@ public:
                                            {.bind_to_port_ = true,
                                             .use_proxy_proto_ = false,
                                             .use_original_dst_ = false,
-                                            .per_connection_buffer_limit_bytes_ = 0});
+                                            .per_connection_buffer_limit_bytes_ = 0,
+                                            .max_accepts_per_event_ = 0});
 
     // Point c-ares at the listener with no search domains and TCP-only.
     peer_.reset(new DnsResolverImplPeer(dynamic_cast<DnsResolverImpl*>(resolver_.get())));
@@ -298,6 +317,7 @@ public:
   }
 
 protected:
+  virtual DnsResolverSharedPtr createResolver() { return dispatcher_.createDnsResolver({}); }
   // Should the DnsResolverImpl use a zero timeout for c-ares queries?
   virtual bool zero_timeout() const { return false; }
   std::unique_ptr<TestDnsServer> server_;
@@ -541,6 +561,48 @@ TEST_P(DnsImplTest, MultiARecordLookupWithV6) {
   EXPECT_TRUE(hasAddress(address_list, "1::2:3:4"));
 }
 
+// Validate that All resolves both families, interleaved starting with IPv6.
+TEST_P(DnsImplTest, AllLookup) {
+  server_->addHosts("some.good.domain", {"201.134.56.7", "123.4.5.6", "6.5.4.3"}, A);
+  server_->addHosts("some.good.domain", {"1::2", "1::2:3"}, AAAA);
+  server_->addHosts("v4.good.domain", {"201.134.56.7"}, A);
+  std::list<Address::InstanceConstSharedPtr> address_list;
+  EXPECT_NE(nullptr,
+            resolver_->resolve("some.good.domain", DnsLookupFamily::All,
+                               [&](std::list<Address::InstanceConstSharedPtr>&& results) -> void {
+                                 address_list = results;
+                                 dispatcher_.exit();
+                               }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::Block);
+  std::vector<std::string> addresses;
+  for (const auto& address : address_list) {
+    addresses.push_back(address->ip()->addressAsString());
+  }
+  EXPECT_EQ(std::vector<std::string>({"1::2", "201.134.56.7", "1::2:3", "123.4.5.6", "6.5.4.3"}),
+            addresses);
+
+  // A family without addresses does not fail the resolution.
+  EXPECT_NE(nullptr,
+            resolver_->resolve("v4.good.domain", DnsLookupFamily::All,
+                               [&](std::list<Address::InstanceConstSharedPtr>&& results) -> void {
+                                 address_list = results;
+                                 dispatcher_.exit();
+                               }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::Block);
+  ASSERT_EQ(1U, address_list.size());
+  EXPECT_TRUE(hasAddress(address_list, "201.134.56.7"));
+
+  // Literals are resolved without a query.
+  EXPECT_EQ(nullptr,
+            resolver_->resolve("1.2.3.4", DnsLookupFamily::V4Only,
+                               [&](std::list<Address::InstanceConstSharedPtr>&& results) -> void {
+                                 address_list = results;
+                               }));
+  EXPECT_TRUE(hasAddress(address_list, "1.2.3.4"));
+}
+
 // Validate working of cancellation provided by ActiveDnsQuery return.
 TEST_P(DnsImplTest, Cancel) {
   server_->addHosts("some.good.domain", {"201.134.56.7"}, A);
@@ -588,6 +650,116 @@ TEST_P(DnsImplZeroTimeoutTest, Timeout) {
   EXPECT_TRUE(address_list.empty());
 }
 
+class DnsImplCacheTest : public DnsImplTest {
+protected:
+  DnsResolverSharedPtr createResolver() override {
+    cache_config_.max_ttl_ = std::chrono::seconds(60);
+    cache_config_.min_ttl_ = std::chrono::seconds(5);
+    cache_config_.negative_ttl_ = std::chrono::seconds(10);
+    cache_config_.stale_ttl_ = std::chrono::seconds(30);
+    ON_CALL(time_source_, currentTime()).WillByDefault(Invoke([this]() { return now_; }));
+    return std::make_shared<DnsResolverImpl>(
+        dispatcher_, std::vector<Address::InstanceConstSharedPtr>{}, cache_config_, time_source_);
+  }
+
+  // Resolve a name that is not cached, waiting for the answer.
+  std::list<Address::InstanceConstSharedPtr> resolveRemote(const std::string& dns_name) {
+    std::list<Address::InstanceConstSharedPtr> address_list;
+    EXPECT_NE(nullptr,
+              resolver_->resolve(dns_name, DnsLookupFamily::V4Only,
+                                 [&](std::list<Address::InstanceConstSharedPtr>&& results) -> void {
+                                   address_list = results;
+                                   dispatcher_.exit();
+                                 }));
+    dispatcher_.run(Event::Dispatcher::RunType::Block);
+    return address_list;
+  }
+
+  // Resolve a name that is cached, which answers before resolve() returns.
+  std::list<Address::InstanceConstSharedPtr> resolveCached(const std::string& dns_name) {
+    std::list<Address::InstanceConstSharedPtr> address_list;
+    EXPECT_EQ(nullptr,
+              resolver_->resolve(dns_name, DnsLookupFamily::V4Only,
+                                 [&](std::list<Address::InstanceConstSharedPtr>&& results) -> void {
+                                   address_list = results;
+                                 }));
+    return address_list;
+  }
+
+  DnsCacheConfig cache_config_;
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  MonotonicTime now_;
+};
+
+INSTANTIATE_TEST_CASE_P(IpVersions, DnsImplCacheTest,
+                        testing::ValuesIn(TestEnvironment::getIpVersionsForTest()));
+
+// Validate that answers are cached for their TTL.
+TEST_P(DnsImplCacheTest, CachedForTtl) {
+  server_->addHosts("some.good.domain", {"201.134.56.7"}, A);
+  server_->setTtl(20);
+  EXPECT_TRUE(hasAddress(resolveRemote("some.good.domain"), "201.134.56.7"));
+  EXPECT_EQ(1U, server_->queryCount());
+
+  now_ += std::chrono::seconds(19);
+  EXPECT_TRUE(hasAddress(resolveCached("some.good.domain"), "201.134.56.7"));
+  EXPECT_EQ(1U, server_->queryCount());
+
+  // The family is part of the cached name.
+  EXPECT_NE(nullptr, resolver_->resolve("some.good.domain", DnsLookupFamily::V6Only,
+                                        [](std::list<Address::InstanceConstSharedPtr>&&) {}));
+}
+
+// Validate that TTLs are clamped to the configured bounds.
+TEST_P(DnsImplCacheTest, TtlClamped) {
+  server_->addHosts("some.good.domain", {"201.134.56.7"}, A);
+  server_->setTtl(0);
+  resolveRemote("some.good.domain");
+  now_ += std::chrono::seconds(4);
+  EXPECT_TRUE(hasAddress(resolveCached("some.good.domain"), "201.134.56.7"));
+
+  server_->addHosts("other.good.domain", {"123.4.5.6"}, A);
+  server_->setTtl(3600);
+  resolveRemote("other.good.domain");
+  // Expired, and no longer served once the stale time has passed too.
+  now_ += std::chrono::seconds(91);
+  EXPECT_TRUE(hasAddress(resolveRemote("other.good.domain"), "123.4.5.6"));
+  EXPECT_EQ(3U, server_->queryCount());
+}
+
+// Validate that names that do not resolve are cached for the negative TTL.
+TEST_P(DnsImplCacheTest, NegativeCache) {
+  EXPECT_TRUE(resolveRemote("some.bad.domain").empty());
+  EXPECT_EQ(1U, server_->queryCount());
+  now_ += std::chrono::seconds(9);
+  EXPECT_TRUE(resolveCached("some.bad.domain").empty());
+  EXPECT_EQ(1U, server_->queryCount());
+
+  // Negative answers are not served stale.
+  server_->addHosts("some.bad.domain", {"201.134.56.7"}, A);
+  now_ += std::chrono::seconds(2);
+  EXPECT_TRUE(hasAddress(resolveRemote("some.bad.domain"), "201.134.56.7"));
+}
+
+// Validate that an expired answer is served while the name is resolved again.
+TEST_P(DnsImplCacheTest, StaleWhileRevalidate) {
+  server_->addHosts("some.good.domain", {"201.134.56.7"}, A);
+  server_->setTtl(10);
+  resolveRemote("some.good.domain");
+
+  server_->addHosts("some.good.domain", {"123.4.5.6"}, A);
+  now_ += std::chrono::seconds(15);
+  EXPECT_TRUE(hasAddress(resolveCached("some.good.domain"), "201.134.56.7"));
+  // Only one background resolution is started.
+  EXPECT_TRUE(hasAddress(resolveCached("some.good.domain"), "201.134.56.7"));
+
+  // The answers come back in order on the same connection, so the background resolution has
+  // completed once this one has.
+  resolveRemote("other.domain");
+  EXPECT_EQ(3U, server_->queryCount());
+  EXPECT_TRUE(hasAddress(resolveCached("some.good.domain"), "123.4.5.6"));
+}
+
 // Validate that the resolution timeout timer is enabled if we don't resolve
 // immediately.
 TEST(DnsImplUnitTest, PendingTimerEnable) {
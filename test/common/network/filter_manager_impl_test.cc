@@ -13,6 +13,7 @@
 #include "test/mocks/network/mocks.h"
 #include "test/mocks/ratelimit/mocks.h"
 #include "test/mocks/runtime/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
 #include "test/mocks/tracing/mocks.h"
 #include "test/mocks/upstream/host.h"
 #include "test/mocks/upstream/mocks.h"
@@ -100,6 +101,7 @@ TEST_F(NetworkFilterManagerTest, RateLimitAndTcpProxy) {
   Stats::IsolatedStoreImpl stats_store;
   NiceMock<Runtime::MockLoader> runtime;
   NiceMock<Upstream::MockClusterManager> cm;
+  NiceMock<ThreadLocal::MockInstance> tls;
   NiceMock<MockConnection> connection;
   FilterManagerImpl manager(connection, *this);
 
@@ -141,7 +143,7 @@ TEST_F(NetworkFilterManagerTest, RateLimitAndTcpProxy) {
 
   Json::ObjectSharedPtr tcp_proxy_config_loader = Json::Factory::loadFromString(tcp_proxy_json);
   Envoy::Filter::TcpProxyConfigSharedPtr tcp_proxy_config(
-      new Envoy::Filter::TcpProxyConfig(*tcp_proxy_config_loader, cm, stats_store));
+      new Envoy::Filter::TcpProxyConfig(*tcp_proxy_config_loader, cm, stats_store, tls));
   manager.addReadFilter(ReadFilterSharedPtr{new Envoy::Filter::TcpProxy(tcp_proxy_config, cm)});
 
   RateLimit::RequestCallbacks* request_callbacks{};
@@ -0,0 +1,178 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/network/happy_eyeballs_connection_impl.h"
+#include "common/network/utility.h"
+
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/network/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::InSequence;
+using testing::NiceMock;
+using testing::_;
+
+namespace Envoy {
+namespace Network {
+
+class HappyEyeballsConnectionImplTest : public testing::Test {
+public:
+  HappyEyeballsConnectionImplTest() {
+    addresses_ = {Utility::resolveUrl("tcp://[::1]:80"), Utility::resolveUrl("tcp://10.0.0.1:80"),
+                  Utility::resolveUrl("tcp://[::2]:80")};
+    timer_ = new Event::MockTimer(&dispatcher_);
+    connection_.reset(new HappyEyeballsConnectionImpl(
+        dispatcher_, addresses_, std::chrono::milliseconds(250),
+        [this](Address::InstanceConstSharedPtr address) -> ClientConnectionPtr {
+          NiceMock<MockClientConnection>* attempt = new NiceMock<MockClientConnection>();
+          attempt->remote_address_ = address;
+          attempts_.push_back(attempt);
+          return ClientConnectionPtr{attempt};
+        }));
+    connection_->addConnectionCallbacks(callbacks_);
+  }
+
+  void connect() {
+    EXPECT_CALL(*attempts_[0], connect());
+    EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(250)));
+    connection_->connect();
+  }
+
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  Event::MockTimer* timer_;
+  std::vector<Address::InstanceConstSharedPtr> addresses_;
+  std::vector<NiceMock<MockClientConnection>*> attempts_;
+  MockConnectionCallbacks callbacks_;
+  std::unique_ptr<HappyEyeballsConnectionImpl> connection_;
+};
+
+TEST_F(HappyEyeballsConnectionImplTest, FirstAttemptWins) {
+  ASSERT_EQ(1U, attempts_.size());
+  EXPECT_EQ("[::1]:80", connection_->remoteAddress().asString());
+  connect();
+
+  // The filters and the writes wait for an attempt to connect.
+  std::shared_ptr<MockReadFilter> filter(new NiceMock<MockReadFilter>());
+  connection_->addReadFilter(filter);
+  Buffer::OwnedImpl data("hello");
+  connection_->write(data);
+  connection_->readDisable(true);
+  EXPECT_FALSE(connection_->readEnabled());
+  EXPECT_EQ(0U, data.length());
+
+  {
+    InSequence s;
+    EXPECT_CALL(*timer_, disableTimer());
+    EXPECT_CALL(*attempts_[0], readDisable(true));
+    EXPECT_CALL(*attempts_[0], addReadFilter(_));
+    EXPECT_CALL(*attempts_[0], write(_));
+    EXPECT_CALL(callbacks_, onEvent(ConnectionEvent::Connected));
+  }
+  attempts_[0]->raiseEvent(ConnectionEvent::Connected);
+  EXPECT_EQ(1U, attempts_.size());
+
+  // Once connected, the calls go to the attempt.
+  EXPECT_CALL(*attempts_[0], readDisable(false));
+  connection_->readDisable(false);
+  EXPECT_CALL(*attempts_[0], close(ConnectionCloseType::FlushWrite));
+  EXPECT_CALL(callbacks_, onEvent(ConnectionEvent::LocalClose));
+  connection_->close(ConnectionCloseType::FlushWrite);
+}
+
+TEST_F(HappyEyeballsConnectionImplTest, DelayStartsNextAttempt) {
+  connect();
+
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(250)));
+  timer_->callback_();
+  ASSERT_EQ(2U, attempts_.size());
+  EXPECT_EQ("10.0.0.1:80", attempts_[1]->remoteAddress().asString());
+
+  // The last address is not followed by another delay.
+  EXPECT_CALL(*timer_, enableTimer(_)).Times(0);
+  timer_->callback_();
+  ASSERT_EQ(3U, attempts_.size());
+
+  // The losers are closed without their close events reaching the callbacks.
+  EXPECT_CALL(*attempts_[0], close(ConnectionCloseType::NoFlush));
+  EXPECT_CALL(*attempts_[1], close(_)).Times(0);
+  EXPECT_CALL(*attempts_[2], close(ConnectionCloseType::NoFlush));
+  EXPECT_CALL(callbacks_, onEvent(ConnectionEvent::Connected));
+  attempts_[1]->raiseEvent(ConnectionEvent::Connected);
+  EXPECT_EQ("10.0.0.1:80", connection_->remoteAddress().asString());
+
+  EXPECT_CALL(callbacks_, onEvent(ConnectionEvent::RemoteClose));
+  attempts_[1]->raiseEvent(ConnectionEvent::RemoteClose);
+  EXPECT_EQ(Connection::State::Closed, connection_->state());
+}
+
+TEST_F(HappyEyeballsConnectionImplTest, FailureStartsNextAttempt) {
+  connect();
+
+  // A failure does not wait for the delay.
+  EXPECT_CALL(*timer_, disableTimer());
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(250)));
+  EXPECT_CALL(callbacks_, onEvent(_)).Times(0);
+  attempts_[0]->raiseEvent(ConnectionEvent::RemoteClose);
+  ASSERT_EQ(2U, attempts_.size());
+  EXPECT_CALL(*timer_, disableTimer());
+  attempts_[1]->raiseEvent(ConnectionEvent::RemoteClose);
+  ASSERT_EQ(3U, attempts_.size());
+  EXPECT_EQ(Connection::State::Open, connection_->state());
+
+  // The connection fails once all the attempts have.
+  EXPECT_CALL(callbacks_, onEvent(ConnectionEvent::RemoteClose));
+  attempts_[2]->raiseEvent(ConnectionEvent::RemoteClose);
+  EXPECT_EQ(Connection::State::Closed, connection_->state());
+}
+
+TEST_F(HappyEyeballsConnectionImplTest, CloseBeforeConnected) {
+  connect();
+  EXPECT_CALL(*timer_, enableTimer(_));
+  timer_->callback_();
+
+  EXPECT_CALL(*timer_, disableTimer());
+  EXPECT_CALL(*attempts_[0], close(ConnectionCloseType::NoFlush));
+  EXPECT_CALL(*attempts_[1], close(ConnectionCloseType::NoFlush));
+  EXPECT_CALL(callbacks_, onEvent(ConnectionEvent::LocalClose));
+  connection_->close(ConnectionCloseType::FlushWrite);
+  EXPECT_EQ(Connection::State::Closed, connection_->state());
+
+  // Late events of the attempts are ignored.
+  attempts_[1]->raiseEvent(ConnectionEvent::Connected);
+  connection_->close(ConnectionCloseType::NoFlush);
+}
+
+TEST_F(HappyEyeballsConnectionImplTest, SettingsAppliedToAttempts) {
+  EXPECT_CALL(*attempts_[0], noDelay(true));
+  connection_->noDelay(true);
+  EXPECT_CALL(*attempts_[0], setBufferLimits(1024));
+  connection_->setBufferLimits(1024);
+  connect();
+
+  EXPECT_CALL(*timer_, enableTimer(_));
+  timer_->callback_();
+  ASSERT_EQ(2U, attempts_.size());
+  // Later settings are applied to all the attempts that are connecting.
+  EXPECT_CALL(*attempts_[0], noDelay(false));
+  EXPECT_CALL(*attempts_[1], noDelay(false));
+  connection_->noDelay(false);
+
+  EXPECT_CALL(*attempts_[1], close(ConnectionCloseType::NoFlush));
+  EXPECT_CALL(callbacks_, onEvent(ConnectionEvent::Connected));
+  attempts_[0]->raiseEvent(ConnectionEvent::Connected);
+
+  EXPECT_CALL(*attempts_[0], noDelay(true));
+  EXPECT_CALL(*attempts_[1], noDelay(_)).Times(0);
+  connection_->noDelay(true);
+
+  EXPECT_CALL(callbacks_, onEvent(ConnectionEvent::LocalClose));
+  connection_->close(ConnectionCloseType::NoFlush);
+}
+
+} // namespace Network
+} // namespace Envoy
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "envoy/common/exception.h"
+
+#include "common/network/address_impl.h"
+#include "common/network/cidr_range.h"
+#include "common/network/lc_trie.h"
+
+#include "fmt/format.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Network {
+namespace Address {
+
+class LcTrieTest : public testing::Test {
+public:
+  typedef std::vector<std::pair<std::string, std::vector<std::string>>> TagData;
+
+  void setup(const TagData& tag_data, double fill_factor = LcTrie::DEFAULT_FILL_FACTOR) {
+    tag_data_.clear();
+    for (const auto& entry : tag_data) {
+      std::vector<CidrRange> ranges;
+      for (const std::string& range : entry.second) {
+        ranges.push_back(CidrRange::create(range));
+      }
+      tag_data_.emplace_back(entry.first, ranges);
+    }
+    trie_.reset(new LcTrie(tag_data_, fill_factor));
+  }
+
+  // Computes the expected tags by checking every range.
+  void expectLinearScan(const Instance& address) {
+    std::vector<std::string> all_tags;
+    std::vector<std::string> longest_tags;
+    int longest_length = -1;
+    for (const auto& entry : tag_data_) {
+      for (const CidrRange& range : entry.second) {
+        if (!range.isInRange(address)) {
+          continue;
+        }
+        if (std::find(all_tags.begin(), all_tags.end(), entry.first) == all_tags.end()) {
+          all_tags.push_back(entry.first);
+        }
+        if (range.length() > longest_length) {
+          longest_length = range.length();
+          longest_tags.clear();
+        }
+        if (range.length() == longest_length &&
+            std::find(longest_tags.begin(), longest_tags.end(), entry.first) ==
+                longest_tags.end()) {
+          longest_tags.push_back(entry.first);
+        }
+      }
+    }
+    EXPECT_EQ(all_tags, trie_->getData(address)) << address.asString();
+    EXPECT_EQ(longest_tags, trie_->getLongestPrefixData(address)) << address.asString();
+  }
+
+  void expectData(const std::string& address, const std::vector<std::string>& all_tags,
+                  const std::vector<std::string>& longest_tags) {
+    InstanceConstSharedPtr instance;
+    if (address.find(':') != std::string::npos) {
+      instance.reset(new Ipv6Instance(address));
+    } else {
+      instance.reset(new Ipv4Instance(address));
+    }
+    EXPECT_EQ(all_tags, trie_->getData(*instance)) << address;
+    EXPECT_EQ(longest_tags, trie_->getLongestPrefixData(*instance)) << address;
+  }
+
+  std::vector<std::pair<std::string, std::vector<CidrRange>>> tag_data_;
+  std::unique_ptr<LcTrie> trie_;
+};
+
+TEST_F(LcTrieTest, Empty) {
+  setup({});
+  expectData("1.2.3.4", {}, {});
+  expectData("::1", {}, {});
+
+  setup({{"tag_a", {}}});
+  expectData("1.2.3.4", {}, {});
+}
+
+TEST_F(LcTrieTest, Ipv4) {
+  setup({
+      {"tag_a", {"10.0.0.0/8", "192.168.1.0/24"}},
+      {"tag_b", {"10.1.0.0/16"}},
+      {"tag_c", {"10.1.1.1/32", "172.16.0.0/12"}},
+  });
+
+  expectData("10.0.0.1", {"tag_a"}, {"tag_a"});
+  expectData("10.255.255.255", {"tag_a"}, {"tag_a"});
+  expectData("10.1.2.3", {"tag_a", "tag_b"}, {"tag_b"});
+  expectData("10.1.1.1", {"tag_a", "tag_b", "tag_c"}, {"tag_c"});
+  expectData("10.1.1.2", {"tag_a", "tag_b"}, {"tag_b"});
+  expectData("172.31.255.255", {"tag_c"}, {"tag_c"});
+  expectData("172.32.0.0", {}, {});
+  expectData("192.168.1.77", {"tag_a"}, {"tag_a"});
+  expectData("192.168.2.1", {}, {});
+  expectData("11.0.0.0", {}, {});
+  expectData("9.255.255.255", {}, {});
+  expectData("0.0.0.0", {}, {});
+  expectData("::a01:101", {}, {});
+}
+
+TEST_F(LcTrieTest, Ipv6) {
+  setup({
+      {"tag_a", {"2001:db8::/32"}},
+      {"tag_b", {"2001:db8:85a3::/48", "::/0"}},
+      {"tag_c", {"2001:db8:85a3::8a2e:370:7334/128"}},
+  });
+
+  expectData("2001:db8:1::1", {"tag_a", "tag_b"}, {"tag_a"});
+  expectData("2001:db8:85a3::1", {"tag_a", "tag_b"}, {"tag_b"});
+  expectData("2001:db8:85a3::8a2e:370:7334", {"tag_a", "tag_b", "tag_c"}, {"tag_c"});
+  expectData("2001:db9::", {"tag_b"}, {"tag_b"});
+  expectData("::", {"tag_b"}, {"tag_b"});
+  expectData("ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff", {"tag_b"}, {"tag_b"});
+  expectData("1.2.3.4", {}, {});
+}
+
+TEST_F(LcTrieTest, SharedRanges) {
+  setup({
+      {"tag_a", {"1.2.3.0/24"}},
+      {"tag_b", {"1.2.3.0/24", "1.2.3.0/24"}},
+      {"tag_a", {"5.6.7.8/32"}},
+  });
+
+  expectData("1.2.3.4", {"tag_a", "tag_b"}, {"tag_a", "tag_b"});
+  expectData("5.6.7.8", {"tag_a"}, {"tag_a"});
+  expectData("5.6.7.9", {}, {});
+}
+
+TEST_F(LcTrieTest, DefaultRoute) {
+  setup({{"tag_a", {"0.0.0.0/0"}}});
+  expectData("0.0.0.0", {"tag_a"}, {"tag_a"});
+  expectData("255.255.255.255", {"tag_a"}, {"tag_a"});
+  expectData("::", {}, {});
+}
+
+TEST_F(LcTrieTest, NonIpAddress) {
+  setup({{"tag_a", {"0.0.0.0/0", "::/0"}}});
+  EXPECT_TRUE(trie_->getData(PipeInstance("/foo")).empty());
+  EXPECT_TRUE(trie_->getLongestPrefixData(PipeInstance("/foo")).empty());
+}
+
+TEST_F(LcTrieTest, InvalidRange) {
+  std::vector<std::pair<std::string, std::vector<CidrRange>>> tag_data{
+      {"tag_a", {CidrRange::create("1.2.3.4/33")}}};
+  EXPECT_THROW(LcTrie trie(tag_data), EnvoyException);
+}
+
+// Compares lookups with a linear scan of the ranges, for many random nested ranges.
+TEST_F(LcTrieTest, RandomRanges) {
+  std::mt19937 engine(1);
+  for (double fill_factor : {0.25, 0.5, 1.0}) {
+    TagData tag_data;
+    for (uint32_t tag = 0; tag < 8; tag++) {
+      std::vector<std::string> ranges;
+      for (uint32_t i = 0; i < 64; i++) {
+        // Keep the ranges in a small part of the address space so that they often nest.
+        const uint32_t address = 0x0a000000 | (engine() & 0x0000ffff);
+        const uint32_t length = 8 + engine() % 25;
+        ranges.push_back(fmt::format("{}.{}.{}.{}/{}", address >> 24, (address >> 16) & 0xff,
+                                     (address >> 8) & 0xff, address & 0xff, length));
+        ranges.push_back(fmt::format("2001:db8::{:x}:{:x}/{}", engine() & 0xff, engine() & 0xff,
+                                     96 + engine() % 33));
+      }
+      tag_data.emplace_back(fmt::format("tag_{}", tag), ranges);
+    }
+    setup(tag_data, fill_factor);
+
+    for (uint32_t i = 0; i < 1000; i++) {
+      const uint32_t address = 0x0a000000 | (engine() & 0x0000ffff);
+      expectLinearScan(Ipv4Instance(fmt::format("{}.{}.{}.{}", address >> 24,
+                                                (address >> 16) & 0xff, (address >> 8) & 0xff,
+                                                address & 0xff)));
+      expectLinearScan(
+          Ipv6Instance(fmt::format("2001:db8::{:x}:{:x}", engine() & 0xff, engine() & 0xff)));
+    }
+  }
+}
+
+} // namespace Address
+} // namespace Network
+} // namespace Envoy
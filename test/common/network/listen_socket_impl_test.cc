@@ -59,5 +59,19 @@ TEST_P(ListenSocketImplTest, BindPortZero) {
   EXPECT_GT(socket.localAddress()->ip()->port(), 0U);
 }
 
+// Validate that several SO_REUSEPORT sockets can be bound to the same address, but a socket
+// without SO_REUSEPORT can not join them.
+TEST_P(ListenSocketImplTest, BindReusePort) {
+  auto loopback = Network::Test::getCanonicalLoopbackAddress(version_);
+  TcpListenSocket socket1(loopback, true, true);
+  EXPECT_EQ(0, listen(socket1.fd(), 0));
+
+  TcpListenSocket socket2(socket1.localAddress(), true, true);
+  EXPECT_EQ(0, listen(socket2.fd(), 0));
+  EXPECT_EQ(socket1.localAddress()->asString(), socket2.localAddress()->asString());
+
+  EXPECT_THROW(Network::TcpListenSocket socket3(socket1.localAddress(), true), EnvoyException);
+}
+
 } // namespace Network
 } // namespace Envoy
@@ -34,7 +34,8 @@ static void errorCallbackTest(Address::IpVersion version) {
                                 {.bind_to_port_ = true,
                                  .use_proxy_proto_ = false,
                                  .use_original_dst_ = false,
-                                 .per_connection_buffer_limit_bytes_ = 0});
+                                 .per_connection_buffer_limit_bytes_ = 0,
+                                 .max_accepts_per_event_ = 0});
 
   Network::ClientConnectionPtr client_connection = dispatcher.createClientConnection(
       socket.localAddress(), Network::Address::InstanceConstSharedPtr());
@@ -107,7 +108,8 @@ TEST_P(ListenerImplTest, NormalRedirect) {
                                      {.bind_to_port_ = true,
                                       .use_proxy_proto_ = false,
                                       .use_original_dst_ = true,
-                                      .per_connection_buffer_limit_bytes_ = 0});
+                                      .per_connection_buffer_limit_bytes_ = 0,
+                                      .max_accepts_per_event_ = 0});
   Network::MockListenerCallbacks listener_callbacks2;
   Network::TestListenerImpl listenerDst(connection_handler, dispatcher, socketDst,
                                         listener_callbacks2, stats_store,
@@ -148,7 +150,8 @@ TEST_P(ListenerImplTest, FallbackToWildcardListener) {
                                      {.bind_to_port_ = true,
                                       .use_proxy_proto_ = false,
                                       .use_original_dst_ = true,
-                                      .per_connection_buffer_limit_bytes_ = 0});
+                                      .per_connection_buffer_limit_bytes_ = 0,
+                                      .max_accepts_per_event_ = 0});
   Network::MockListenerCallbacks listener_callbacks2;
   Network::TestListenerImpl listenerDst(connection_handler, dispatcher, socketDst,
                                         listener_callbacks2, stats_store,
@@ -189,7 +192,8 @@ TEST_P(ListenerImplTest, WildcardListenerWithOriginalDst) {
                                      {.bind_to_port_ = true,
                                       .use_proxy_proto_ = false,
                                       .use_original_dst_ = true,
-                                      .per_connection_buffer_limit_bytes_ = 0});
+                                      .per_connection_buffer_limit_bytes_ = 0,
+                                      .max_accepts_per_event_ = 0});
 
   auto local_dst_address = Network::Utility::getAddressWithPort(
       *Network::Test::getCanonicalLoopbackAddress(version_), socket.localAddress()->ip()->port());
@@ -226,7 +230,8 @@ TEST_P(ListenerImplTest, WildcardListenerNoOriginalDst) {
                                      {.bind_to_port_ = true,
                                       .use_proxy_proto_ = false,
                                       .use_original_dst_ = true,
-                                      .per_connection_buffer_limit_bytes_ = 0});
+                                      .per_connection_buffer_limit_bytes_ = 0,
+                                      .max_accepts_per_event_ = 0});
 
   auto local_dst_address = Network::Utility::getAddressWithPort(
       *Network::Test::getCanonicalLoopbackAddress(version_), socket.localAddress()->ip()->port());
@@ -264,7 +269,8 @@ TEST_P(ListenerImplTest, UseActualDst) {
                                      {.bind_to_port_ = true,
                                       .use_proxy_proto_ = false,
                                       .use_original_dst_ = false,
-                                      .per_connection_buffer_limit_bytes_ = 0});
+                                      .per_connection_buffer_limit_bytes_ = 0,
+                                      .max_accepts_per_event_ = 0});
   Network::MockListenerCallbacks listener_callbacks2;
   Network::TestListenerImpl listenerDst(connection_handler, dispatcher, socketDst,
                                         listener_callbacks2, stats_store,
@@ -303,7 +309,8 @@ TEST_P(ListenerImplTest, WildcardListenerUseActualDst) {
                                      {.bind_to_port_ = true,
                                       .use_proxy_proto_ = false,
                                       .use_original_dst_ = false,
-                                      .per_connection_buffer_limit_bytes_ = 0});
+                                      .per_connection_buffer_limit_bytes_ = 0,
+                                      .max_accepts_per_event_ = 0});
 
   auto local_dst_address = Network::Utility::getAddressWithPort(
       *Network::Test::getCanonicalLoopbackAddress(version_), socket.localAddress()->ip()->port());
@@ -327,5 +334,109 @@ TEST_P(ListenerImplTest, WildcardListenerUseActualDst) {
   dispatcher.run(Event::Dispatcher::RunType::Block);
 }
 
+TEST_P(ListenerImplTest, MaxAcceptsPerEvent) {
+  Stats::IsolatedStoreImpl stats_store;
+  Event::DispatcherImpl dispatcher;
+  Network::TcpListenSocket socket(Network::Test::getCanonicalLoopbackAddress(version_), true);
+  Network::MockListenerCallbacks listener_callbacks;
+  Network::MockConnectionHandler connection_handler;
+  Network::ListenerPtr listener =
+      dispatcher.createListener(connection_handler, socket, listener_callbacks, stats_store,
+                                {.bind_to_port_ = true,
+                                 .use_proxy_proto_ = false,
+                                 .use_original_dst_ = false,
+                                 .per_connection_buffer_limit_bytes_ = 0,
+                                 .max_accepts_per_event_ = 2});
+
+  // Queue three connections before running the event loop. A blocking connect over loopback
+  // returns once the connection is in the accept queue.
+  std::vector<int> client_fds;
+  for (int i = 0; i < 3; i++) {
+    const int fd =
+        ::socket(version_ == Address::IpVersion::v4 ? AF_INET : AF_INET6, SOCK_STREAM, 0);
+    ASSERT_NE(-1, fd);
+    ASSERT_EQ(0, socket.localAddress()->connect(fd));
+    client_fds.push_back(fd);
+  }
+
+  std::vector<Network::ConnectionPtr> server_connections;
+  EXPECT_CALL(listener_callbacks, onNewConnection_(_))
+      .Times(3)
+      .WillRepeatedly(Invoke([&](Network::ConnectionPtr& conn) -> void {
+        server_connections.push_back(std::move(conn));
+      }));
+
+  // The first iteration accepts up to the limit and leaves the third connection queued.
+  dispatcher.run(Event::Dispatcher::RunType::NonBlock);
+  EXPECT_EQ(2U, server_connections.size());
+  dispatcher.run(Event::Dispatcher::RunType::NonBlock);
+  EXPECT_EQ(3U, server_connections.size());
+
+  for (auto& connection : server_connections) {
+    connection->close(ConnectionCloseType::NoFlush);
+  }
+  for (int fd : client_fds) {
+    close(fd);
+  }
+}
+
+class LimitedListenerCallbacks : public Network::MockListenerCallbacks {
+public:
+  bool canAccept() override {
+    if (accepts_left_ == 0) {
+      return false;
+    }
+    accepts_left_--;
+    return true;
+  }
+
+  uint32_t accepts_left_{};
+};
+
+// Connections that the callbacks do not accept are left in the accept queue.
+TEST_P(ListenerImplTest, CanAccept) {
+  Stats::IsolatedStoreImpl stats_store;
+  Event::DispatcherImpl dispatcher;
+  Network::TcpListenSocket socket(Network::Test::getCanonicalLoopbackAddress(version_), true);
+  LimitedListenerCallbacks listener_callbacks;
+  listener_callbacks.accepts_left_ = 1;
+  Network::MockConnectionHandler connection_handler;
+  Network::ListenerPtr listener =
+      dispatcher.createListener(connection_handler, socket, listener_callbacks, stats_store,
+                                Network::ListenerOptions::listenerOptionsWithBindToPort());
+
+  std::vector<int> client_fds;
+  for (int i = 0; i < 2; i++) {
+    const int fd =
+        ::socket(version_ == Address::IpVersion::v4 ? AF_INET : AF_INET6, SOCK_STREAM, 0);
+    ASSERT_NE(-1, fd);
+    ASSERT_EQ(0, socket.localAddress()->connect(fd));
+    client_fds.push_back(fd);
+  }
+
+  std::vector<Network::ConnectionPtr> server_connections;
+  EXPECT_CALL(listener_callbacks, onNewConnection_(_))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](Network::ConnectionPtr& conn) -> void {
+        server_connections.push_back(std::move(conn));
+      }));
+
+  dispatcher.run(Event::Dispatcher::RunType::NonBlock);
+  EXPECT_EQ(1U, server_connections.size());
+  dispatcher.run(Event::Dispatcher::RunType::NonBlock);
+  EXPECT_EQ(1U, server_connections.size());
+
+  listener_callbacks.accepts_left_ = 1;
+  dispatcher.run(Event::Dispatcher::RunType::NonBlock);
+  EXPECT_EQ(2U, server_connections.size());
+
+  for (auto& connection : server_connections) {
+    connection->close(ConnectionCloseType::NoFlush);
+  }
+  for (int fd : client_fds) {
+    close(fd);
+  }
+}
+
 } // namespace Network
 } // namespace Envoy
@@ -34,7 +34,8 @@ public:
                                              {.bind_to_port_ = true,
                                               .use_proxy_proto_ = true,
                                               .use_original_dst_ = false,
-                                              .per_connection_buffer_limit_bytes_ = 0})) {
+                                              .per_connection_buffer_limit_bytes_ = 0,
+                                              .max_accepts_per_event_ = 0})) {
     conn_ = dispatcher_.createClientConnection(socket_.localAddress(),
                                                Network::Address::InstanceConstSharedPtr());
     conn_->addConnectionCallbacks(connection_callbacks_);
@@ -282,6 +283,170 @@ TEST_P(ProxyProtocolTest, ClosedEmpty) {
   dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
 }
 
+// The signature, version, command, address family and transport of V2 headers.
+const std::string V2_PROXY_TCP4("\r\n\r\n\0\r\nQUIT\n\x21\x11", 14);
+const std::string V2_PROXY_TCP6("\r\n\r\n\0\r\nQUIT\n\x21\x21", 14);
+const std::string V2_LOCAL("\r\n\r\n\0\r\nQUIT\n\x20\x00", 14);
+
+// 1.2.3.4:65535 to 254.254.254.254:1234
+const std::string V2_TCP4_ADDRESSES("\x01\x02\x03\x04\xfe\xfe\xfe\xfe\xff\xff\x04\xd2", 12);
+
+std::string v2Length(uint16_t length) {
+  return std::string{static_cast<char>(length >> 8), static_cast<char>(length & 0xff)};
+}
+
+TEST_P(ProxyProtocolTest, V2Basic) {
+  connect();
+  write(V2_PROXY_TCP4 + v2Length(12) + V2_TCP4_ADDRESSES + "more data");
+
+  EXPECT_CALL(*read_filter_, onNewConnection());
+  EXPECT_CALL(*read_filter_, onData(_))
+      .WillOnce(Invoke([&](Buffer::Instance& buffer) -> FilterStatus {
+        EXPECT_EQ(server_connection_->remoteAddress().asString(), "1.2.3.4:65535");
+        EXPECT_EQ(server_connection_->localAddress().asString(), "254.254.254.254:1234");
+
+        EXPECT_EQ(TestUtility::bufferToString(buffer), "more data");
+        buffer.drain(9);
+        return Network::FilterStatus::Continue;
+      }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+
+  disconnect();
+}
+
+TEST_P(ProxyProtocolTest, V2BasicV6) {
+  connect();
+  // [1:2:3::4]:65535 to [5:6::7:8]:1234
+  write(V2_PROXY_TCP6 + v2Length(36) +
+        std::string("\x00\x01\x00\x02\x00\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00\x04"
+                    "\x00\x05\x00\x06\x00\x00\x00\x00\x00\x00\x00\x00\x00\x07\x00\x08"
+                    "\xff\xff\x04\xd2",
+                    36) +
+        "more data");
+
+  EXPECT_CALL(*read_filter_, onNewConnection());
+  EXPECT_CALL(*read_filter_, onData(_))
+      .WillOnce(Invoke([&](Buffer::Instance& buffer) -> FilterStatus {
+        EXPECT_EQ(server_connection_->remoteAddress().asString(), "[1:2:3::4]:65535");
+        EXPECT_EQ(server_connection_->localAddress().asString(), "[5:6::7:8]:1234");
+
+        EXPECT_EQ(TestUtility::bufferToString(buffer), "more data");
+        buffer.drain(9);
+        return Network::FilterStatus::Continue;
+      }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+
+  disconnect();
+}
+
+TEST_P(ProxyProtocolTest, V2Tlvs) {
+  connect();
+  // A PP2_TYPE_AUTHORITY and a PP2_TYPE_NOOP TLV, which is empty.
+  write(V2_PROXY_TCP4 + v2Length(12 + 14 + 3) + V2_TCP4_ADDRESSES +
+        std::string("\x02\x00\x0b" "example.com" "\x04\x00\x00", 17) + "more data");
+
+  EXPECT_CALL(*read_filter_, onNewConnection());
+  EXPECT_CALL(*read_filter_, onData(_))
+      .WillOnce(Invoke([&](Buffer::Instance& buffer) -> FilterStatus {
+        EXPECT_EQ(server_connection_->remoteAddress().asString(), "1.2.3.4:65535");
+        EXPECT_EQ(TestUtility::bufferToString(buffer), "more data");
+        buffer.drain(9);
+        return Network::FilterStatus::Continue;
+      }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+
+  disconnect();
+}
+
+// A header that doesn't fit in a single peek.
+TEST_P(ProxyProtocolTest, V2LargeTlv) {
+  connect();
+  write(V2_PROXY_TCP4 + v2Length(12 + 3 + 1000) + V2_TCP4_ADDRESSES + "\x04" + v2Length(1000) +
+        std::string(1000, 'x') + "more data");
+
+  EXPECT_CALL(*read_filter_, onNewConnection());
+  EXPECT_CALL(*read_filter_, onData(_))
+      .WillOnce(Invoke([&](Buffer::Instance& buffer) -> FilterStatus {
+        EXPECT_EQ(server_connection_->remoteAddress().asString(), "1.2.3.4:65535");
+        EXPECT_EQ(TestUtility::bufferToString(buffer), "more data");
+        buffer.drain(9);
+        return Network::FilterStatus::Continue;
+      }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+
+  disconnect();
+}
+
+TEST_P(ProxyProtocolTest, V2Fragmented) {
+  connect();
+  const std::string header = V2_PROXY_TCP4 + v2Length(12) + V2_TCP4_ADDRESSES;
+  write(header.substr(0, 5));
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+  write(header.substr(5, 10));
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+  write(header.substr(15));
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+
+  disconnect();
+
+  EXPECT_EQ(server_connection_->remoteAddress().ip()->addressAsString(), "1.2.3.4");
+}
+
+// The connections of the proxy itself keep their own addresses.
+TEST_P(ProxyProtocolTest, V2Local) {
+  connect();
+  write(V2_LOCAL + v2Length(0) + "more data");
+
+  EXPECT_CALL(*read_filter_, onNewConnection());
+  EXPECT_CALL(*read_filter_, onData(_))
+      .WillOnce(Invoke([&](Buffer::Instance& buffer) -> FilterStatus {
+        EXPECT_EQ(server_connection_->remoteAddress().ip()->addressAsString(),
+                  Network::Test::getLoopbackAddressString(GetParam()));
+        EXPECT_EQ(TestUtility::bufferToString(buffer), "more data");
+        buffer.drain(9);
+        return Network::FilterStatus::Continue;
+      }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+
+  disconnect();
+}
+
+TEST_P(ProxyProtocolTest, V2BadSignature) {
+  connectNoRead();
+  write(std::string("\r\n\r\n\0\r\nQUIT\r\x21\x11", 14) + v2Length(12) + V2_TCP4_ADDRESSES);
+  expectProxyProtoError();
+}
+
+TEST_P(ProxyProtocolTest, V2BadVersion) {
+  connectNoRead();
+  write(std::string("\r\n\r\n\0\r\nQUIT\n\x31\x11", 14) + v2Length(12) + V2_TCP4_ADDRESSES);
+  expectProxyProtoError();
+}
+
+TEST_P(ProxyProtocolTest, V2AddressesTruncated) {
+  connectNoRead();
+  write(V2_PROXY_TCP4 + v2Length(8) + V2_TCP4_ADDRESSES.substr(0, 8));
+  expectProxyProtoError();
+}
+
+TEST_P(ProxyProtocolTest, V2TlvTooLong) {
+  connectNoRead();
+  write(V2_PROXY_TCP4 + v2Length(12 + 4) + V2_TCP4_ADDRESSES + "\x04" + v2Length(2) + "x");
+  expectProxyProtoError();
+}
+
+TEST_P(ProxyProtocolTest, V2InvalidSrcAddress) {
+  connectNoRead();
+  write(V2_PROXY_TCP4 + v2Length(12) +
+        std::string("\xe6\x00\x00\x01\x0a\x01\x01\x03\x04\xd2\x16\x2e", 12));
+  expectProxyProtoError();
+}
+
 class WildcardProxyProtocolTest : public testing::TestWithParam<Address::IpVersion> {
 public:
   WildcardProxyProtocolTest()
@@ -293,7 +458,8 @@ public:
                                              {.bind_to_port_ = true,
                                               .use_proxy_proto_ = true,
                                               .use_original_dst_ = false,
-                                              .per_connection_buffer_limit_bytes_ = 0})) {
+                                              .per_connection_buffer_limit_bytes_ = 0,
+                                              .max_accepts_per_event_ = 0})) {
     conn_ = dispatcher_.createClientConnection(local_dst_address_,
                                                Network::Address::InstanceConstSharedPtr());
     conn_->addConnectionCallbacks(connection_callbacks_);
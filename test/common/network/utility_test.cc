@@ -1,3 +1,8 @@
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include <cstdint>
 #include <list>
 #include <string>
@@ -214,6 +219,37 @@ TEST(NetworkUtility, AnyAddress) {
   }
 }
 
+#ifdef TCP_NOTSENT_LOWAT
+// Options of upstream connections are not set on listen sockets, and the other way around.
+TEST(NetworkUtility, SocketOptions) {
+  SocketOptions options;
+  options.tcp_fast_open_connect_ = true;
+  options.notsent_lowat_bytes_ = 16384;
+  options.defer_accept_seconds_ = 5;
+
+  auto getOption = [](int fd, int option) -> int {
+    int value = 0;
+    socklen_t length = sizeof(value);
+    EXPECT_EQ(0, getsockopt(fd, IPPROTO_TCP, option, &value, &length));
+    return value;
+  };
+
+  const int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_NE(-1, listen_fd);
+  Utility::setListenSocketOptions(listen_fd, options);
+  EXPECT_EQ(16384, getOption(listen_fd, TCP_NOTSENT_LOWAT));
+  EXPECT_NE(0, getOption(listen_fd, TCP_DEFER_ACCEPT));
+  ::close(listen_fd);
+
+  const int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_NE(-1, client_fd);
+  Utility::setClientSocketOptions(client_fd, options);
+  EXPECT_EQ(16384, getOption(client_fd, TCP_NOTSENT_LOWAT));
+  EXPECT_EQ(0, getOption(client_fd, TCP_DEFER_ACCEPT));
+  ::close(client_fd);
+}
+#endif
+
 TEST(PortRangeListTest, Errors) {
   {
     std::string port_range_str = "a1";
@@ -0,0 +1,69 @@
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "common/profiler/profiler.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Profiler {
+
+namespace {
+
+uintptr_t word(const std::string& profile, size_t index) {
+  uintptr_t value;
+  memcpy(&value, profile.data() + index * sizeof(value), sizeof(value));
+  return value;
+}
+
+} // namespace
+
+#ifdef __linux__
+
+TEST(CpuSamplerTest, SampleRegisteredThread) {
+  CpuSampler::registerThread();
+  EXPECT_FALSE(CpuSampler::start(0));
+  ASSERT_TRUE(CpuSampler::start(1000));
+  EXPECT_TRUE(CpuSampler::running());
+  EXPECT_FALSE(CpuSampler::start(1000));
+
+  // Burn CPU time until a few samples are taken.
+  volatile uint64_t sum = 0;
+  const auto start = std::chrono::steady_clock::now();
+  while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(200)) {
+    for (uint32_t i = 0; i < 1000; i++) {
+      sum += i;
+    }
+  }
+  CpuSampler::stop();
+  CpuSampler::unregisterThread();
+  EXPECT_FALSE(CpuSampler::running());
+
+  const std::string profile = CpuSampler::profile();
+  EXPECT_EQ(0U, word(profile, 0));
+  EXPECT_EQ(3U, word(profile, 1));
+  EXPECT_EQ(0U, word(profile, 2));
+  EXPECT_EQ(1000U, word(profile, 3));
+  EXPECT_EQ(0U, word(profile, 4));
+
+  uint64_t samples = 0;
+  size_t index = 5;
+  while (word(profile, index) != 0) {
+    samples += word(profile, index);
+    const uintptr_t depth = word(profile, index + 1);
+    EXPECT_TRUE(depth <= CpuSampler::MAX_DEPTH);
+    index += 2 + depth;
+  }
+  EXPECT_LT(0U, samples);
+  EXPECT_EQ(0U, CpuSampler::droppedSamples());
+  EXPECT_EQ(1U, word(profile, index + 1));
+  EXPECT_EQ(0U, word(profile, index + 2));
+  EXPECT_NE(std::string::npos, profile.find("[stack]", (index + 3) * sizeof(uintptr_t)));
+}
+
+#endif
+
+} // namespace Profiler
+} // namespace Envoy
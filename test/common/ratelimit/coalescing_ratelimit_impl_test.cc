@@ -0,0 +1,221 @@
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "common/json/json_loader.h"
+#include "common/ratelimit/coalescing_ratelimit_impl.h"
+
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/ratelimit/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::Invoke;
+using testing::InSequence;
+using testing::NiceMock;
+using testing::WithArg;
+using testing::_;
+
+namespace Envoy {
+namespace RateLimit {
+
+class TestTimeSource : public MonotonicTimeSource {
+public:
+  MonotonicTime currentTime() override { return time_; }
+
+  MonotonicTime time_;
+};
+
+class RequestCoalescerTest : public testing::Test {
+public:
+  void setup(const std::string& json) {
+    config_.reset(new CoalescingConfig(*Json::Factory::loadFromString(json)));
+    coalescer_.reset(new RequestCoalescer(*config_, time_source_, dispatcher_, [this]() {
+      MockClient* client = new MockClient();
+      RequestCallbacks*& callbacks = call_callbacks_[clients_.size()];
+      EXPECT_CALL(*client, limit(_, "domain", _, _))
+          .WillOnce(WithArg<0>(Invoke([&callbacks](RequestCallbacks& call_callbacks) -> void {
+            callbacks = &call_callbacks;
+          })));
+      clients_.push_back(client);
+      return ClientPtr{client};
+    }));
+  }
+
+  ClientPtr limit(MockRequestCallbacks& callbacks, const std::vector<Descriptor>& descriptors) {
+    ClientPtr client{new CoalescingClientImpl(*coalescer_)};
+    client->limit(callbacks, "domain", descriptors, Tracing::EMPTY_CONTEXT);
+    return client;
+  }
+
+  TestTimeSource time_source_;
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  std::unique_ptr<CoalescingConfig> config_;
+  std::unique_ptr<RequestCoalescer> coalescer_;
+  std::vector<MockClient*> clients_;
+  RequestCallbacks* call_callbacks_[4]{};
+};
+
+TEST_F(RequestCoalescerTest, RequestKey) {
+  EXPECT_EQ(RequestCoalescer::requestKey("domain", {{{{"a", "b"}}}}),
+            RequestCoalescer::requestKey("domain", {{{{"a", "b"}}}}));
+  EXPECT_NE(RequestCoalescer::requestKey("domain", {{{{"a", "b"}}}}),
+            RequestCoalescer::requestKey("other", {{{{"a", "b"}}}}));
+  EXPECT_NE(RequestCoalescer::requestKey("domain", {{{{"a", "b"}, {"c", "d"}}}}),
+            RequestCoalescer::requestKey("domain", {{{{"a", "b"}}}, {{{"c", "d"}}}}));
+  EXPECT_NE(RequestCoalescer::requestKey("domain", {{{{"a1", "b"}}}}),
+            RequestCoalescer::requestKey("domain", {{{{"a", "1b"}}}}));
+}
+
+TEST_F(RequestCoalescerTest, CoalesceAndCache) {
+  setup("{\"cache_ttl_ms\": 100}");
+  MockRequestCallbacks callbacks1;
+  MockRequestCallbacks callbacks2;
+  MockRequestCallbacks callbacks3;
+
+  ClientPtr client1 = limit(callbacks1, {{{{"a", "b"}}}});
+  ClientPtr client2 = limit(callbacks2, {{{{"a", "b"}}}});
+  ClientPtr client3 = limit(callbacks3, {{{{"a", "c"}}}});
+  EXPECT_EQ(2U, clients_.size());
+  EXPECT_EQ(2U, coalescer_->pendingCalls());
+
+  EXPECT_CALL(callbacks1, complete(LimitStatus::OK));
+  EXPECT_CALL(callbacks2, complete(LimitStatus::OK));
+  call_callbacks_[0]->complete(LimitStatus::OK);
+  EXPECT_EQ(1U, coalescer_->pendingCalls());
+  EXPECT_EQ(1U, coalescer_->cacheSize());
+
+  // The under limit response is cached.
+  MockRequestCallbacks callbacks4;
+  EXPECT_CALL(callbacks4, complete(LimitStatus::OK));
+  limit(callbacks4, {{{{"a", "b"}}}});
+  EXPECT_EQ(2U, clients_.size());
+
+  // The over limit response is not.
+  EXPECT_CALL(callbacks3, complete(LimitStatus::OverLimit));
+  call_callbacks_[1]->complete(LimitStatus::OverLimit);
+  EXPECT_EQ(1U, coalescer_->cacheSize());
+  MockRequestCallbacks callbacks5;
+  ClientPtr client5 = limit(callbacks5, {{{{"a", "c"}}}});
+  EXPECT_EQ(3U, clients_.size());
+
+  // The cached response expires.
+  time_source_.time_ += std::chrono::milliseconds(100);
+  MockRequestCallbacks callbacks6;
+  ClientPtr client6 = limit(callbacks6, {{{{"a", "b"}}}});
+  EXPECT_EQ(4U, clients_.size());
+  EXPECT_EQ(0U, coalescer_->cacheSize());
+
+  // The pending calls are cancelled with the coalescer.
+  client5->cancel();
+  client6->cancel();
+  EXPECT_CALL(*clients_[2], cancel());
+  EXPECT_CALL(*clients_[3], cancel());
+  coalescer_.reset();
+}
+
+TEST_F(RequestCoalescerTest, CancelWaiter) {
+  setup("{}");
+  MockRequestCallbacks callbacks1;
+  MockRequestCallbacks callbacks2;
+
+  ClientPtr client1 = limit(callbacks1, {{{{"a", "b"}}}});
+  ClientPtr client2 = limit(callbacks2, {{{{"a", "b"}}}});
+  client1->cancel();
+
+  // The call goes on for the other waiter. Without a cache TTL nothing is cached.
+  EXPECT_CALL(callbacks2, complete(LimitStatus::OK));
+  call_callbacks_[0]->complete(LimitStatus::OK);
+  EXPECT_EQ(0U, coalescer_->cacheSize());
+
+  // A call whose waiters all cancelled still completes.
+  ClientPtr client3 = limit(callbacks1, {{{{"a", "b"}}}});
+  EXPECT_EQ(2U, clients_.size());
+  client3->cancel();
+  call_callbacks_[1]->complete(LimitStatus::Error);
+  EXPECT_EQ(0U, coalescer_->pendingCalls());
+}
+
+TEST_F(RequestCoalescerTest, WaiterCancelsOtherWaiter) {
+  setup("{}");
+  MockRequestCallbacks callbacks1;
+  MockRequestCallbacks callbacks2;
+
+  ClientPtr client1 = limit(callbacks1, {{{{"a", "b"}}}});
+  ClientPtr client2 = limit(callbacks2, {{{{"a", "b"}}}});
+
+  // A waiter that completes may start a new call for the same request, or cancel other waiters.
+  MockRequestCallbacks callbacks3;
+  ClientPtr client3;
+  EXPECT_CALL(callbacks1, complete(LimitStatus::Error)).WillOnce(Invoke([&](LimitStatus) -> void {
+    client3 = limit(callbacks3, {{{{"a", "b"}}}});
+    client2->cancel();
+  }));
+  call_callbacks_[0]->complete(LimitStatus::Error);
+  EXPECT_EQ(2U, clients_.size());
+  EXPECT_EQ(1U, coalescer_->pendingCalls());
+
+  EXPECT_CALL(callbacks3, complete(LimitStatus::OverLimit));
+  call_callbacks_[1]->complete(LimitStatus::OverLimit);
+}
+
+TEST_F(RequestCoalescerTest, MaxCacheEntries) {
+  setup("{\"cache_ttl_ms\": 100, \"max_cache_entries\": 1}");
+  MockRequestCallbacks callbacks;
+  EXPECT_CALL(callbacks, complete(LimitStatus::OK)).Times(3);
+
+  ClientPtr client1 = limit(callbacks, {{{{"a", "b"}}}});
+  call_callbacks_[0]->complete(LimitStatus::OK);
+  ClientPtr client2 = limit(callbacks, {{{{"a", "c"}}}});
+  call_callbacks_[1]->complete(LimitStatus::OK);
+  EXPECT_EQ(1U, coalescer_->cacheSize());
+
+  // Expired entries make room.
+  time_source_.time_ += std::chrono::milliseconds(100);
+  ClientPtr client3 = limit(callbacks, {{{{"a", "c"}}}});
+  call_callbacks_[2]->complete(LimitStatus::OK);
+  EXPECT_EQ(1U, coalescer_->cacheSize());
+  EXPECT_EQ(3U, clients_.size());
+}
+
+TEST_F(RequestCoalescerTest, CompleteInline) {
+  config_.reset(new CoalescingConfig(*Json::Factory::loadFromString("{\"cache_ttl_ms\": 100}")));
+  coalescer_.reset(new RequestCoalescer(*config_, time_source_, dispatcher_, []() -> ClientPtr {
+    MockClient* client = new MockClient();
+    EXPECT_CALL(*client, limit(_, _, _, _))
+        .WillOnce(Invoke([](RequestCallbacks& callbacks, const std::string&,
+                            const std::vector<Descriptor>&, const Tracing::TransportContext&) {
+          callbacks.complete(LimitStatus::OK);
+        }));
+    return ClientPtr{client};
+  }));
+
+  MockRequestCallbacks callbacks;
+  InSequence s;
+  EXPECT_CALL(dispatcher_, deferredDelete_(_));
+  EXPECT_CALL(callbacks, complete(LimitStatus::OK)).Times(2);
+  limit(callbacks, {{{{"a", "b"}}}});
+  limit(callbacks, {{{{"a", "b"}}}});
+  EXPECT_EQ(0U, coalescer_->pendingCalls());
+}
+
+TEST(CoalescingFactoryImplTest, CreateClient) {
+  NiceMock<ThreadLocal::MockInstance> tls;
+  TestTimeSource time_source;
+  MockClient* inner_client = new MockClient();
+  CoalescingFactoryImpl factory(*Json::Factory::loadFromString("{}"), tls, time_source,
+                                [inner_client]() { return ClientPtr{inner_client}; });
+
+  ClientPtr client = factory.create(Optional<std::chrono::milliseconds>());
+  MockRequestCallbacks callbacks;
+  EXPECT_CALL(*inner_client, limit(_, "domain", _, _))
+      .WillOnce(WithArg<0>(
+          Invoke([](RequestCallbacks& callbacks) -> void { callbacks.complete(LimitStatus::OK); })));
+  EXPECT_CALL(callbacks, complete(LimitStatus::OK));
+  client->limit(callbacks, "domain", {{{{"a", "b"}}}}, Tracing::EMPTY_CONTEXT);
+}
+
+} // namespace RateLimit
+} // namespace Envoy
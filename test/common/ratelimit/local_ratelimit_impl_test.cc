@@ -0,0 +1,249 @@
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "common/json/json_loader.h"
+#include "common/ratelimit/local_ratelimit_impl.h"
+
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/ratelimit/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::Invoke;
+using testing::NiceMock;
+using testing::WithArg;
+using testing::_;
+
+namespace Envoy {
+namespace RateLimit {
+
+class TestTimeSource : public MonotonicTimeSource {
+public:
+  MonotonicTime currentTime() override { return time_; }
+
+  MonotonicTime time_;
+};
+
+TEST(TokenBucketTest, ConsumeAndRefill) {
+  MonotonicTime now;
+  TokenBucket bucket(2, 1, now);
+  EXPECT_TRUE(bucket.consume(now));
+  EXPECT_TRUE(bucket.consume(now));
+  EXPECT_FALSE(bucket.consume(now));
+
+  now += std::chrono::milliseconds(500);
+  EXPECT_FALSE(bucket.consume(now));
+  now += std::chrono::milliseconds(500);
+  EXPECT_TRUE(bucket.consume(now));
+
+  // The bucket does not fill beyond its size.
+  now += std::chrono::seconds(10);
+  EXPECT_TRUE(bucket.consume(now));
+  EXPECT_TRUE(bucket.consume(now));
+  EXPECT_FALSE(bucket.consume(now));
+}
+
+TEST(LocalRateLimitConfigTest, DuplicateDescriptor) {
+  std::string json = R"EOF(
+  {
+    "limits": [
+      {"descriptor": [{"key": "a", "value": "b"}], "requests_per_second": 1},
+      {"descriptor": [{"key": "a", "value": "b"}], "requests_per_second": 2}
+    ]
+  }
+  )EOF";
+
+  EXPECT_THROW_WITH_MESSAGE(LocalRateLimitConfig(*Json::Factory::loadFromString(json)),
+                            EnvoyException, "rate limit: duplicate local limit descriptor");
+}
+
+TEST(LocalRateLimitConfigTest, Defaults) {
+  std::string json = R"EOF(
+  {
+    "limits": [
+      {"descriptor": [{"key": "a", "value": "b"}, {"key": "c", "value": "d"}],
+       "requests_per_second": 10}
+    ],
+    "global_sync": {}
+  }
+  )EOF";
+
+  LocalRateLimitConfig config(*Json::Factory::loadFromString(json));
+  ASSERT_EQ(1U, config.limits().size());
+  EXPECT_EQ(10U, config.limits()[0].burst_);
+  EXPECT_TRUE(config.globalSync());
+  EXPECT_EQ(64U, config.maxPendingGlobalChecks());
+  EXPECT_EQ(std::chrono::milliseconds(1000), config.globalOverLimitDuration());
+
+  EXPECT_EQ(0U, config.limitIndex({{{"a", "b"}, {"c", "d"}}}).value());
+  EXPECT_FALSE(config.limitIndex({{{"a", "b"}}}).valid());
+  EXPECT_FALSE(config.limitIndex({{{"c", "d"}, {"a", "b"}}}).valid());
+}
+
+class LocalRateLimiterTest : public testing::Test {
+public:
+  void setup(const std::string& json, bool global_sync) {
+    config_.reset(new LocalRateLimitConfig(*Json::Factory::loadFromString(json)));
+    ClientCreateCb global_client;
+    if (global_sync) {
+      global_client = [this]() -> ClientPtr {
+        MockClient* client = new MockClient();
+        RequestCallbacks*& callbacks = global_callbacks_[clients_.size()];
+        EXPECT_CALL(*client, limit(_, "domain", _, _))
+            .WillOnce(WithArg<0>(
+                Invoke([&callbacks](RequestCallbacks& limit_callbacks) -> void {
+                  callbacks = &limit_callbacks;
+                })));
+        clients_.push_back(client);
+        return ClientPtr{client};
+      };
+    }
+    limiter_.reset(new LocalRateLimiter(*config_, time_source_, dispatcher_, global_client));
+  }
+
+  LimitStatus limit(const std::vector<Descriptor>& descriptors) {
+    return limiter_->limit("domain", descriptors, Tracing::EMPTY_CONTEXT);
+  }
+
+  const std::string json_ = R"EOF(
+  {
+    "limits": [
+      {"descriptor": [{"key": "a", "value": "1"}], "requests_per_second": 1, "burst": 2},
+      {"descriptor": [{"key": "b", "value": "1"}], "requests_per_second": 10}
+    ],
+    "global_sync": {"max_pending": 2, "over_limit_ms": 100}
+  }
+  )EOF";
+
+  TestTimeSource time_source_;
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  std::unique_ptr<LocalRateLimitConfig> config_;
+  std::unique_ptr<LocalRateLimiter> limiter_;
+  std::vector<MockClient*> clients_;
+  RequestCallbacks* global_callbacks_[4]{};
+};
+
+TEST_F(LocalRateLimiterTest, LocalOnly) {
+  setup(json_, false);
+
+  // Descriptors without a local limit are not limited.
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(LimitStatus::OK, limit({{{{"a", "2"}}}}));
+  }
+  EXPECT_EQ(LimitStatus::OK, limit({}));
+
+  EXPECT_EQ(LimitStatus::OK, limit({{{{"a", "1"}}}}));
+  EXPECT_EQ(LimitStatus::OK, limit({{{{"a", "1"}}}, {{{"a", "2"}}}}));
+  EXPECT_EQ(LimitStatus::OverLimit, limit({{{{"a", "1"}}}}));
+
+  // A request is over limit if any of its limits is.
+  EXPECT_EQ(LimitStatus::OverLimit, limit({{{{"b", "1"}}}, {{{"a", "1"}}}}));
+  EXPECT_EQ(LimitStatus::OK, limit({{{{"b", "1"}}}}));
+
+  time_source_.time_ += std::chrono::seconds(1);
+  EXPECT_EQ(LimitStatus::OK, limit({{{{"a", "1"}}}}));
+  EXPECT_EQ(LimitStatus::OverLimit, limit({{{{"a", "1"}}}}));
+  EXPECT_EQ(0U, limiter_->pendingGlobalChecks());
+}
+
+TEST_F(LocalRateLimiterTest, GlobalSyncOverLimit) {
+  setup(json_, true);
+
+  EXPECT_EQ(LimitStatus::OK, limit({{{{"a", "1"}}}, {{{"c", "1"}}}}));
+  ASSERT_EQ(1U, clients_.size());
+  EXPECT_EQ(1U, limiter_->pendingGlobalChecks());
+
+  // Requests without a local limit are not checked.
+  EXPECT_EQ(LimitStatus::OK, limit({{{{"c", "1"}}}}));
+  EXPECT_EQ(1U, clients_.size());
+
+  EXPECT_CALL(dispatcher_, deferredDelete_(_));
+  global_callbacks_[0]->complete(LimitStatus::OverLimit);
+  EXPECT_EQ(0U, limiter_->pendingGlobalChecks());
+
+  // The limit of the checked request rejects requests although it has tokens, the other limit
+  // does not.
+  EXPECT_EQ(LimitStatus::OverLimit, limit({{{{"a", "1"}}}}));
+  EXPECT_EQ(LimitStatus::OK, limit({{{{"b", "1"}}}}));
+  EXPECT_EQ(2U, clients_.size());
+
+  time_source_.time_ += std::chrono::milliseconds(100);
+  EXPECT_EQ(LimitStatus::OK, limit({{{{"a", "1"}}}}));
+  EXPECT_EQ(3U, clients_.size());
+
+  // The pending checks are cancelled with the limiter.
+  EXPECT_CALL(*clients_[1], cancel());
+  EXPECT_CALL(*clients_[2], cancel());
+  limiter_.reset();
+}
+
+TEST_F(LocalRateLimiterTest, GlobalSyncErrorAndMaxPending) {
+  setup(json_, true);
+
+  EXPECT_EQ(LimitStatus::OK, limit({{{{"b", "1"}}}}));
+  EXPECT_EQ(LimitStatus::OK, limit({{{{"b", "1"}}}}));
+  // Over the maximum number of pending checks, requests are only limited locally.
+  EXPECT_EQ(LimitStatus::OK, limit({{{{"b", "1"}}}}));
+  EXPECT_EQ(2U, clients_.size());
+  EXPECT_EQ(2U, limiter_->pendingGlobalChecks());
+
+  // Errors and responses under the limit do not reject requests.
+  global_callbacks_[0]->complete(LimitStatus::Error);
+  global_callbacks_[1]->complete(LimitStatus::OK);
+  EXPECT_EQ(0U, limiter_->pendingGlobalChecks());
+  EXPECT_EQ(LimitStatus::OK, limit({{{{"b", "1"}}}}));
+  EXPECT_EQ(3U, clients_.size());
+
+  global_callbacks_[2]->complete(LimitStatus::OK);
+}
+
+TEST_F(LocalRateLimiterTest, GlobalSyncCompleteInline) {
+  setup(json_, false);
+  limiter_.reset(new LocalRateLimiter(*config_, time_source_, dispatcher_, []() -> ClientPtr {
+    MockClient* client = new MockClient();
+    EXPECT_CALL(*client, limit(_, _, _, _))
+        .WillOnce(Invoke([](RequestCallbacks& callbacks, const std::string&,
+                            const std::vector<Descriptor>&, const Tracing::TransportContext&) {
+          callbacks.complete(LimitStatus::OverLimit);
+        }));
+    return ClientPtr{client};
+  }));
+
+  EXPECT_CALL(dispatcher_, deferredDelete_(_));
+  EXPECT_EQ(LimitStatus::OK, limit({{{{"a", "1"}}}}));
+  EXPECT_EQ(0U, limiter_->pendingGlobalChecks());
+  EXPECT_EQ(LimitStatus::OverLimit, limit({{{{"a", "1"}}}}));
+}
+
+TEST(LocalFactoryImplTest, CreateClient) {
+  std::string json = R"EOF(
+  {
+    "limits": [
+      {"descriptor": [{"key": "a", "value": "1"}], "requests_per_second": 1}
+    ]
+  }
+  )EOF";
+
+  NiceMock<ThreadLocal::MockInstance> tls;
+  TestTimeSource time_source;
+  // The global client is only used with the global sync.
+  LocalFactoryImpl factory(*Json::Factory::loadFromString(json), tls, time_source,
+                           []() -> ClientPtr {
+                             ADD_FAILURE();
+                             return nullptr;
+                           });
+
+  ClientPtr client = factory.create(Optional<std::chrono::milliseconds>());
+  MockRequestCallbacks callbacks;
+  EXPECT_CALL(callbacks, complete(LimitStatus::OK));
+  client->limit(callbacks, "domain", {{{{"a", "1"}}}}, Tracing::EMPTY_CONTEXT);
+  EXPECT_CALL(callbacks, complete(LimitStatus::OverLimit));
+  client->limit(callbacks, "domain", {{{{"a", "1"}}}}, Tracing::EMPTY_CONTEXT);
+}
+
+} // namespace RateLimit
+} // namespace Envoy
@@ -0,0 +1,111 @@
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/redis/cluster_utility.h"
+#include "common/redis/codec_impl.h"
+
+#include "test/mocks/redis/mocks.h"
+#include "test/test_common/printers.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Redis {
+
+class RedisClusterUtilityTest : public testing::Test, public DecoderCallbacks {
+public:
+  // Redis::DecoderCallbacks
+  void onRespValue(RespValuePtr&& value) override { value_ = std::move(value); }
+
+  const RespValue& decode(const std::string& encoded) {
+    Buffer::OwnedImpl buffer(encoded);
+    DecoderImpl decoder(*this);
+    decoder.decode(buffer);
+    return *value_;
+  }
+
+  RespValuePtr value_;
+};
+
+TEST_F(RedisClusterUtilityTest, HashSlot) {
+  EXPECT_EQ(0x31C3 % ClusterUtility::NUM_SLOTS, ClusterUtility::hashSlot("123456789"));
+  EXPECT_EQ(12182, ClusterUtility::hashSlot("foo"));
+  EXPECT_EQ(5061, ClusterUtility::hashSlot("bar"));
+
+  // Only the first non empty hash tag is hashed.
+  EXPECT_EQ(ClusterUtility::hashSlot("user1000"),
+            ClusterUtility::hashSlot("{user1000}.following"));
+  EXPECT_EQ(ClusterUtility::hashSlot("user1000"),
+            ClusterUtility::hashSlot("{user1000}.followers"));
+  EXPECT_EQ(ClusterUtility::hashSlot("bar"), ClusterUtility::hashSlot("foo{bar}{zap}"));
+  EXPECT_EQ(ClusterUtility::hashSlot("{bar"), ClusterUtility::hashSlot("foo{{bar}}zap"));
+  EXPECT_NE(ClusterUtility::hashSlot("bar"), ClusterUtility::hashSlot("foo{}{bar}"));
+  EXPECT_NE(ClusterUtility::hashSlot("foo"), ClusterUtility::hashSlot("foo{"));
+}
+
+TEST_F(RedisClusterUtilityTest, ParseClusterSlots) {
+  std::vector<ClusterUtility::SlotRange> ranges = ClusterUtility::parseClusterSlots(
+      decode("*2\r\n"
+             "*4\r\n:0\r\n:5460\r\n*3\r\n$8\r\n10.0.0.1\r\n:6379\r\n$2\r\nid\r\n"
+             "*2\r\n$8\r\n10.0.0.4\r\n:6379\r\n"
+             "*3\r\n:5461\r\n:16383\r\n*2\r\n$3\r\n::1\r\n:6380\r\n"));
+  ASSERT_EQ(2UL, ranges.size());
+  EXPECT_EQ(0, ranges[0].start_);
+  EXPECT_EQ(5460, ranges[0].end_);
+  EXPECT_EQ("10.0.0.1:6379", ranges[0].address_);
+  EXPECT_EQ(std::vector<std::string>{"10.0.0.4:6379"}, ranges[0].replicas_);
+  EXPECT_EQ(5461, ranges[1].start_);
+  EXPECT_EQ(16383, ranges[1].end_);
+  EXPECT_EQ("[::1]:6380", ranges[1].address_);
+  EXPECT_TRUE(ranges[1].replicas_.empty());
+
+  EXPECT_TRUE(ClusterUtility::parseClusterSlots(decode("*0\r\n")).empty());
+}
+
+TEST_F(RedisClusterUtilityTest, ParseInvalidClusterSlots) {
+  EXPECT_THROW(ClusterUtility::parseClusterSlots(decode("-ERR cluster support disabled\r\n")),
+               ProtocolError);
+  EXPECT_THROW(ClusterUtility::parseClusterSlots(decode("*1\r\n*2\r\n:0\r\n:1\r\n")),
+               ProtocolError);
+  EXPECT_THROW(ClusterUtility::parseClusterSlots(
+                   decode("*1\r\n*3\r\n:0\r\n:16384\r\n*2\r\n$1\r\na\r\n:1\r\n")),
+               ProtocolError);
+  EXPECT_THROW(ClusterUtility::parseClusterSlots(
+                   decode("*1\r\n*3\r\n:2\r\n:1\r\n*2\r\n$1\r\na\r\n:1\r\n")),
+               ProtocolError);
+  EXPECT_THROW(ClusterUtility::parseClusterSlots(decode("*1\r\n*3\r\n:0\r\n:1\r\n*1\r\n:1\r\n")),
+               ProtocolError);
+  EXPECT_THROW(ClusterUtility::parseClusterSlots(
+                   decode("*1\r\n*4\r\n:0\r\n:1\r\n*2\r\n$1\r\na\r\n:1\r\n:2\r\n")),
+               ProtocolError);
+}
+
+TEST_F(RedisClusterUtilityTest, ParseRedirect) {
+  ClusterUtility::Redirect redirect;
+  EXPECT_TRUE(ClusterUtility::parseRedirect(decode("-MOVED 3999 127.0.0.1:6381\r\n"), redirect));
+  EXPECT_FALSE(redirect.ask_);
+  EXPECT_EQ(3999, redirect.slot_);
+  EXPECT_EQ("127.0.0.1:6381", redirect.address_);
+
+  EXPECT_TRUE(ClusterUtility::parseRedirect(decode("-ASK 1 ::1:6381\r\n"), redirect));
+  EXPECT_TRUE(redirect.ask_);
+  EXPECT_EQ(1, redirect.slot_);
+  EXPECT_EQ("[::1]:6381", redirect.address_);
+  EXPECT_TRUE(ClusterUtility::parseRedirect(decode("-ASK 1 [::1]:6381\r\n"), redirect));
+  EXPECT_EQ("[::1]:6381", redirect.address_);
+
+  EXPECT_FALSE(ClusterUtility::parseRedirect(decode("+MOVED 3999 127.0.0.1:6381\r\n"), redirect));
+  EXPECT_FALSE(ClusterUtility::parseRedirect(decode("-ERR unknown command\r\n"), redirect));
+  EXPECT_FALSE(ClusterUtility::parseRedirect(decode("-MOVED 16384 127.0.0.1:6381\r\n"), redirect));
+  EXPECT_FALSE(ClusterUtility::parseRedirect(decode("-MOVED 1 127.0.0.1\r\n"), redirect));
+}
+
+TEST_F(RedisClusterUtilityTest, Requests) {
+  EXPECT_EQ("[\"cluster\", \"slots\"]", ClusterUtility::clusterSlotsRequest().toString());
+  EXPECT_EQ("[\"asking\"]", ClusterUtility::askingRequest().toString());
+  EXPECT_EQ("[\"readonly\"]", ClusterUtility::readOnlyRequest().toString());
+}
+
+} // namespace Redis
+} // namespace Envoy
@@ -161,6 +161,31 @@ TEST_F(RedisEncoderDecoderImplTest, NullArray) {
   EXPECT_EQ(RespType::Null, decoded_values_[0]->type());
 }
 
+TEST_F(RedisEncoderDecoderImplTest, RawBytes) {
+  // The first value is split across two decode calls, the second shares a call with it.
+  buffer_.add("*2\r\n$5\r\nhel");
+  decoder_.decode(buffer_);
+  EXPECT_TRUE(decoded_values_.empty());
+  EXPECT_EQ(0UL, buffer_.length());
+  buffer_.add("lo\r\n:-5\r\n+OK\r\n");
+  decoder_.decode(buffer_);
+  EXPECT_EQ(0UL, buffer_.length());
+  ASSERT_EQ(2UL, decoded_values_.size());
+  EXPECT_EQ("[\"hello\", -5]", decoded_values_[0]->toString());
+  EXPECT_EQ("*2\r\n$5\r\nhello\r\n:-5\r\n",
+            TestUtility::bufferToString(*decoded_values_[0]->raw()));
+  EXPECT_EQ("+OK\r\n", TestUtility::bufferToString(*decoded_values_[1]->raw()));
+
+  // Decoded values are forwarded verbatim, and the bytes are dropped once a value changes.
+  encoder_.encode(*decoded_values_[1], buffer_);
+  EXPECT_EQ("+OK\r\n", TestUtility::bufferToString(buffer_));
+  buffer_.drain(buffer_.length());
+  decoded_values_[1]->asString() = "PONG";
+  EXPECT_EQ(nullptr, decoded_values_[1]->raw());
+  encoder_.encode(*decoded_values_[1], buffer_);
+  EXPECT_EQ("+PONG\r\n", TestUtility::bufferToString(buffer_));
+}
+
 TEST_F(RedisEncoderDecoderImplTest, InvalidType) {
   buffer_.add("^");
   EXPECT_THROW(decoder_.decode(buffer_), ProtocolError);
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdint>
 #include <list>
 #include <string>
@@ -9,6 +10,7 @@
 
 #include "test/mocks/common.h"
 #include "test/mocks/redis/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
 #include "test/test_common/printers.h"
 
 #include "fmt/format.h"
@@ -19,6 +21,8 @@ using testing::ByRef;
 using testing::DoAll;
 using testing::Eq;
 using testing::InSequence;
+using testing::Invoke;
+using testing::NiceMock;
 using testing::Ref;
 using testing::Return;
 using testing::WithArg;
@@ -41,9 +45,20 @@ public:
     value.asArray().swap(values);
   }
 
+  // Read-only commands are sent as reads, which may go to replicas.
+  static bool isReadOnly(const RespValue& request) {
+    std::string command(request.asArray()[0].asString());
+    ToLowerTable().toLowerCase(command);
+    const std::vector<std::string>& read_only_commands = SupportedCommands::readOnlyCommands();
+    return std::find(read_only_commands.begin(), read_only_commands.end(), command) !=
+           read_only_commands.end();
+  }
+
   ConnPool::MockInstance* conn_pool_{new ConnPool::MockInstance()};
   Stats::IsolatedStoreImpl store_;
-  InstanceImpl splitter_{ConnPool::InstancePtr{conn_pool_}, store_, "redis.foo."};
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  InstanceImpl splitter_{ConnPool::InstancePtr{conn_pool_}, store_, "redis.foo.", tls_,
+                         HotKeyCacheConfig()};
   MockSplitCallbacks callbacks_;
   SplitRequestPtr handle_;
 };
@@ -100,8 +115,13 @@ class RedisSingleServerRequestTest : public RedisCommandSplitterImplTest,
                                      public testing::WithParamInterface<std::string> {
 public:
   void makeRequest(const std::string& hash_key, const RespValue& request) {
-    EXPECT_CALL(*conn_pool_, makeRequest(hash_key, Ref(request), _))
-        .WillOnce(DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks_)), Return(&pool_request_)));
+    if (isReadOnly(request)) {
+      EXPECT_CALL(*conn_pool_, makeReadRequest(hash_key, Ref(request), _))
+          .WillOnce(DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks_)), Return(&pool_request_)));
+    } else {
+      EXPECT_CALL(*conn_pool_, makeRequest(hash_key, Ref(request), _))
+          .WillOnce(DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks_)), Return(&pool_request_)));
+    }
     handle_ = splitter_.makeRequest(request, callbacks_);
   }
 
@@ -186,7 +206,11 @@ TEST_P(RedisSingleServerRequestTest, NoUpstream) {
 
   RespValue request;
   makeBulkStringArray(request, {GetParam(), "hello"});
-  EXPECT_CALL(*conn_pool_, makeRequest("hello", Ref(request), _)).WillOnce(Return(nullptr));
+  if (isReadOnly(request)) {
+    EXPECT_CALL(*conn_pool_, makeReadRequest("hello", Ref(request), _)).WillOnce(Return(nullptr));
+  } else {
+    EXPECT_CALL(*conn_pool_, makeRequest("hello", Ref(request), _)).WillOnce(Return(nullptr));
+  }
   RespValue response;
   response.type(RespType::Error);
   response.asString() = "no upstream host";
@@ -278,6 +302,11 @@ public:
     RespValue request;
     makeBulkStringArray(request, request_strings);
 
+    // Each key is on its own upstream.
+    EXPECT_CALL(*conn_pool_, upstreamId(_))
+        .WillRepeatedly(
+            Invoke([](const std::string& key) -> uint64_t { return std::stoull(key); }));
+
     std::vector<RespValue> tmp_expected_requests(num_gets);
     expected_requests_.swap(tmp_expected_requests);
     pool_callbacks_.resize(num_gets);
@@ -290,7 +319,8 @@ public:
           null_handle_indexes.end()) {
         request_to_use = &pool_requests_[i];
       }
-      EXPECT_CALL(*conn_pool_, makeRequest(std::to_string(i), Eq(ByRef(expected_requests_[i])), _))
+      EXPECT_CALL(*conn_pool_,
+                  makeReadRequest(std::to_string(i), Eq(ByRef(expected_requests_[i])), _))
           .WillOnce(DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks_[i])), Return(request_to_use)));
     }
 
@@ -449,6 +479,107 @@ TEST_F(RedisMGETCommandHandlerTest, Cancel) {
   handle_->cancel();
 };
 
+class RedisMGETGroupedCommandHandlerTest : public RedisCommandSplitterImplTest {
+public:
+  // Keys "a" and "c" are on one upstream and "b" is on another.
+  void setup() {
+    EXPECT_CALL(*conn_pool_, upstreamId(_))
+        .WillRepeatedly(Invoke([](const std::string& key) -> uint64_t { return key == "b"; }));
+    makeBulkStringArray(expected_requests_[0], {"mget", "a", "c"});
+    makeBulkStringArray(expected_requests_[1], {"get", "b"});
+    EXPECT_CALL(*conn_pool_, makeReadRequest("a", Eq(ByRef(expected_requests_[0])), _))
+        .WillOnce(
+            DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks_[0])), Return(&pool_requests_[0])));
+    EXPECT_CALL(*conn_pool_, makeReadRequest("b", Eq(ByRef(expected_requests_[1])), _))
+        .WillOnce(
+            DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks_[1])), Return(&pool_requests_[1])));
+
+    RespValue request;
+    makeBulkStringArray(request, {"mget", "a", "b", "c"});
+    handle_ = splitter_.makeRequest(request, callbacks_);
+    EXPECT_NE(nullptr, handle_);
+  }
+
+  RespValuePtr makeGetResponse(const std::string& value) {
+    RespValuePtr response(new RespValue());
+    response->type(RespType::BulkString);
+    response->asString() = value;
+    return response;
+  }
+
+  RespValue expected_requests_[2];
+  ConnPool::PoolCallbacks* pool_callbacks_[2];
+  ConnPool::MockPoolRequest pool_requests_[2];
+};
+
+TEST_F(RedisMGETGroupedCommandHandlerTest, Normal) {
+  InSequence s;
+
+  setup();
+
+  RespValue expected_response;
+  makeBulkStringArray(expected_response, {"1", "2", "3"});
+
+  pool_callbacks_[1]->onResponse(makeGetResponse("2"));
+
+  RespValuePtr response(new RespValue());
+  makeBulkStringArray(*response, {"1", "3"});
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected_response)));
+  pool_callbacks_[0]->onResponse(std::move(response));
+};
+
+TEST_F(RedisMGETGroupedCommandHandlerTest, Error) {
+  InSequence s;
+
+  setup();
+
+  RespValue expected_response;
+  makeBulkStringArray(expected_response, {"ERR", "2", "ERR"});
+  expected_response.asArray()[0].type(RespType::Error);
+  expected_response.asArray()[0].asString() = "ERR";
+  expected_response.asArray()[2].type(RespType::Error);
+  expected_response.asArray()[2].asString() = "ERR";
+
+  pool_callbacks_[1]->onResponse(makeGetResponse("2"));
+
+  RespValuePtr response(new RespValue());
+  response->type(RespType::Error);
+  response->asString() = "ERR";
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected_response)));
+  pool_callbacks_[0]->onResponse(std::move(response));
+};
+
+TEST_F(RedisMGETGroupedCommandHandlerTest, InvalidUpstreamResponse) {
+  InSequence s;
+
+  setup();
+
+  RespValue expected_response;
+  makeBulkStringArray(expected_response, {"", "2", ""});
+  expected_response.asArray()[0].type(RespType::Error);
+  expected_response.asArray()[0].asString() = "upstream protocol error";
+  expected_response.asArray()[2].type(RespType::Error);
+  expected_response.asArray()[2].asString() = "upstream protocol error";
+
+  pool_callbacks_[1]->onResponse(makeGetResponse("2"));
+
+  // One value for two keys.
+  RespValuePtr response(new RespValue());
+  makeBulkStringArray(*response, {"1"});
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected_response)));
+  pool_callbacks_[0]->onResponse(std::move(response));
+};
+
+TEST_F(RedisMGETGroupedCommandHandlerTest, Cancel) {
+  InSequence s;
+
+  setup();
+
+  EXPECT_CALL(pool_requests_[0], cancel());
+  EXPECT_CALL(pool_requests_[1], cancel());
+  handle_->cancel();
+};
+
 class RedisMSETCommandHandlerTest : public RedisCommandSplitterImplTest {
 public:
   void setup(uint32_t num_sets, const std::list<uint64_t>& null_handle_indexes) {
@@ -463,6 +594,11 @@ public:
     RespValue request;
     makeBulkStringArray(request, request_strings);
 
+    // Each key is on its own upstream.
+    EXPECT_CALL(*conn_pool_, upstreamId(_))
+        .WillRepeatedly(
+            Invoke([](const std::string& key) -> uint64_t { return std::stoull(key); }));
+
     std::vector<RespValue> tmp_expected_requests(num_sets);
     expected_requests_.swap(tmp_expected_requests);
     pool_callbacks_.resize(num_sets);
@@ -563,6 +699,40 @@ TEST_F(RedisMSETCommandHandlerTest, WrongNumberOfArgs) {
   EXPECT_EQ(nullptr, splitter_.makeRequest(request, callbacks_));
 };
 
+TEST_F(RedisMSETCommandHandlerTest, Grouped) {
+  InSequence s;
+
+  // Keys "a" and "c" are on one upstream and "b" is on another.
+  EXPECT_CALL(*conn_pool_, upstreamId(_))
+      .WillRepeatedly(Invoke([](const std::string& key) -> uint64_t { return key == "b"; }));
+  RespValue expected_requests[2];
+  makeBulkStringArray(expected_requests[0], {"mset", "a", "1", "c", "3"});
+  makeBulkStringArray(expected_requests[1], {"set", "b", "2"});
+  ConnPool::PoolCallbacks* pool_callbacks[2];
+  ConnPool::MockPoolRequest pool_requests[2];
+  EXPECT_CALL(*conn_pool_, makeRequest("a", Eq(ByRef(expected_requests[0])), _))
+      .WillOnce(DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks[0])), Return(&pool_requests[0])));
+  EXPECT_CALL(*conn_pool_, makeRequest("b", Eq(ByRef(expected_requests[1])), _))
+      .WillOnce(DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks[1])), Return(&pool_requests[1])));
+
+  RespValue request;
+  makeBulkStringArray(request, {"mset", "a", "1", "b", "2", "c", "3"});
+  handle_ = splitter_.makeRequest(request, callbacks_);
+  EXPECT_NE(nullptr, handle_);
+
+  RespValuePtr response2(new RespValue());
+  response2->type(RespType::SimpleString);
+  response2->asString() = "OK";
+  pool_callbacks[1]->onResponse(std::move(response2));
+
+  // Both keys of the failed MSET count as errors.
+  RespValue expected_response;
+  expected_response.type(RespType::Error);
+  expected_response.asString() = "finished with 2 error(s)";
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected_response)));
+  pool_callbacks[0]->onFailure();
+};
+
 class RedisSplitKeysSumResultHandlerTest : public RedisCommandSplitterImplTest,
                                            public testing::WithParamInterface<std::string> {
 public:
@@ -662,6 +832,107 @@ TEST_P(RedisSplitKeysSumResultHandlerTest, NoUpstreamHostForAll) {
 INSTANTIATE_TEST_CASE_P(RedisSplitKeysSumResultHandlerTest, RedisSplitKeysSumResultHandlerTest,
                         testing::ValuesIn(SupportedCommands::hashMultipleSumResultCommands()));
 
+class RedisHotKeyCommandTest : public RedisCommandSplitterImplTest {
+public:
+  RedisHotKeyCommandTest() {
+    ON_CALL(time_source_, currentTime()).WillByDefault(Invoke([this]() { return now_; }));
+  }
+
+  static HotKeyCacheConfig hotKeyCacheConfig() {
+    HotKeyCacheConfig config;
+    config.keys_ = {"hot"};
+    config.max_entries_ = 1;
+    config.ttl_ = std::chrono::milliseconds(100);
+    return config;
+  }
+
+  // Sends a GET of the hot key upstream and responds with value.
+  void getUpstream(const std::string& value) {
+    RespValue request;
+    makeBulkStringArray(request, {"get", "hot"});
+    ConnPool::PoolCallbacks* pool_callbacks;
+    EXPECT_CALL(*hot_key_conn_pool_, makeReadRequest("hot", Ref(request), _))
+        .WillOnce(DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks)), Return(&pool_request_)));
+    handle_ = hot_key_splitter_.makeRequest(request, callbacks_);
+    EXPECT_NE(nullptr, handle_);
+
+    RespValuePtr response(new RespValue());
+    response->type(RespType::BulkString);
+    response->asString() = value;
+    RespValue expected(*response);
+    EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected)));
+    pool_callbacks->onResponse(std::move(response));
+    handle_.reset();
+  }
+
+  // Expects a GET of the hot key to be served from the cache with value.
+  void getCached(const std::string& value) {
+    RespValue request;
+    makeBulkStringArray(request, {"get", "hot"});
+    RespValue expected;
+    expected.type(RespType::BulkString);
+    expected.asString() = value;
+    EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected)));
+    EXPECT_EQ(nullptr, hot_key_splitter_.makeRequest(request, callbacks_));
+  }
+
+  ConnPool::MockInstance* hot_key_conn_pool_{new ConnPool::MockInstance()};
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  MonotonicTime now_;
+  InstanceImpl hot_key_splitter_{ConnPool::InstancePtr{hot_key_conn_pool_}, store_, "redis.bar.",
+                                 tls_, hotKeyCacheConfig(), time_source_};
+  ConnPool::MockPoolRequest pool_request_;
+};
+
+TEST_F(RedisHotKeyCommandTest, GetFromCache) {
+  getUpstream("value");
+  getCached("value");
+  EXPECT_EQ(1UL, store_.counter("redis.bar.splitter.hot_key_cache_miss").value());
+  EXPECT_EQ(1UL, store_.counter("redis.bar.splitter.hot_key_cache_hit").value());
+  EXPECT_EQ(2UL, store_.counter("redis.bar.command.get.total").value());
+
+  // The value expires.
+  now_ += std::chrono::milliseconds(100);
+  getUpstream("value2");
+  getCached("value2");
+
+  // Other keys are not cached.
+  RespValue request;
+  makeBulkStringArray(request, {"get", "cold"});
+  EXPECT_CALL(*hot_key_conn_pool_, makeReadRequest("cold", Ref(request), _))
+      .WillOnce(Return(&pool_request_));
+  EXPECT_NE(nullptr, hot_key_splitter_.makeRequest(request, callbacks_));
+  EXPECT_EQ(2UL, store_.counter("redis.bar.splitter.hot_key_cache_miss").value());
+}
+
+TEST_F(RedisHotKeyCommandTest, WriteInvalidates) {
+  getUpstream("value");
+
+  RespValue request;
+  makeBulkStringArray(request, {"del", "cold", "hot"});
+  EXPECT_CALL(*hot_key_conn_pool_, makeRequest("cold", _, _)).WillOnce(Return(&pool_request_));
+  EXPECT_CALL(*hot_key_conn_pool_, makeRequest("hot", _, _)).WillOnce(Return(&pool_request_));
+  handle_ = hot_key_splitter_.makeRequest(request, callbacks_);
+  EXPECT_CALL(pool_request_, cancel()).Times(2);
+  handle_->cancel();
+
+  getUpstream("value2");
+}
+
+TEST_F(RedisHotKeyCommandTest, ErrorsNotCached) {
+  RespValue request;
+  makeBulkStringArray(request, {"get", "hot"});
+  ConnPool::PoolCallbacks* pool_callbacks;
+  EXPECT_CALL(*hot_key_conn_pool_, makeReadRequest("hot", Ref(request), _))
+      .WillOnce(DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks)), Return(&pool_request_)));
+  handle_ = hot_key_splitter_.makeRequest(request, callbacks_);
+  EXPECT_CALL(callbacks_, onResponse_(_));
+  pool_callbacks->onFailure();
+  handle_.reset();
+
+  getUpstream("value");
+}
+
 } // namespace CommandSplitter
 } // namespace Redis
 } // namespace Envoy
@@ -2,18 +2,25 @@
 #include <string>
 
 #include "common/network/utility.h"
+#include "common/redis/cluster_utility.h"
 #include "common/redis/conn_pool_impl.h"
 #include "common/upstream/upstream_impl.h"
 
+#include "test/common/upstream/utility.h"
+#include "test/mocks/buffer/mocks.h"
+#include "test/mocks/common.h"
+#include "test/mocks/event/mocks.h"
 #include "test/mocks/network/mocks.h"
 #include "test/mocks/redis/mocks.h"
 #include "test/mocks/thread_local/mocks.h"
 #include "test/mocks/upstream/mocks.h"
 #include "test/test_common/printers.h"
 
+#include "fmt/format.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+using testing::DoAll;
 using testing::Eq;
 using testing::InSequence;
 using testing::Invoke;
@@ -21,6 +28,7 @@ using testing::Ref;
 using testing::Return;
 using testing::ReturnRef;
 using testing::SaveArg;
+using testing::WithArg;
 using testing::_;
 
 namespace Envoy {
@@ -48,14 +56,21 @@ public:
   }
 
   void setup() {
-    std::string json_string = R"EOF(
+    setup(R"EOF(
     {
       "op_timeout_ms": 20
     }
-    )EOF";
+    )EOF");
+  }
 
+  void setup(const std::string& json_string) {
     Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
     config_.reset(new ConfigImpl(*json_config));
+    // The connect timer is created first, so it must be the last mock timer.
+    if (config_->maxBufferSizeBeforeFlush() > 0) {
+      flush_timer_ = new Event::MockTimer(&dispatcher_);
+    }
+    connect_or_op_timer_ = new Event::MockTimer(&dispatcher_);
 
     upstream_connection_ = new NiceMock<Network::MockClientConnection>();
     Upstream::MockHost::MockCreateConnectionData conn_info;
@@ -80,7 +95,8 @@ public:
   const std::string cluster_name_{"foo"};
   std::shared_ptr<Upstream::MockHost> host_{new NiceMock<Upstream::MockHost>()};
   Event::MockDispatcher dispatcher_;
-  Event::MockTimer* connect_or_op_timer_{new Event::MockTimer(&dispatcher_)};
+  Event::MockTimer* connect_or_op_timer_{};
+  Event::MockTimer* flush_timer_{};
   MockEncoder* encoder_{new MockEncoder()};
   MockDecoder* decoder_{new MockDecoder()};
   DecoderCallbacks* callbacks_{};
@@ -136,6 +152,49 @@ TEST_F(RedisClientImplTest, Basic) {
   client_->close();
 }
 
+TEST_F(RedisClientImplTest, CoalesceWrites) {
+  setup(R"EOF(
+  {
+    "op_timeout_ms": 20,
+    "max_buffer_size_before_flush": 8
+  }
+  )EOF");
+
+  // Null values encode to 5 bytes, so the second request fills the buffer.
+  RespValue request1;
+  MockPoolCallbacks callbacks1;
+  EXPECT_CALL(*flush_timer_, enableTimer(std::chrono::milliseconds(0)));
+  EXPECT_CALL(*upstream_connection_, write(_)).Times(0);
+  client_->makeRequest(request1, callbacks1);
+
+  onConnected();
+
+  RespValue request2;
+  MockPoolCallbacks callbacks2;
+  EXPECT_CALL(*connect_or_op_timer_, enableTimer(_)).Times(2);
+  EXPECT_CALL(*flush_timer_, disableTimer());
+  EXPECT_CALL(*upstream_connection_, write(BufferStringEqual("$-1\r\n$-1\r\n")));
+  client_->makeRequest(request2, callbacks2);
+
+  // A request made after the flush waits for the end of the event loop iteration.
+  RespValue request3;
+  MockPoolCallbacks callbacks3;
+  EXPECT_CALL(*flush_timer_, enableTimer(std::chrono::milliseconds(0)));
+  client_->makeRequest(request3, callbacks3);
+  EXPECT_CALL(*flush_timer_, disableTimer());
+  EXPECT_CALL(*upstream_connection_, write(BufferStringEqual("$-1\r\n")));
+  flush_timer_->callback_();
+
+  EXPECT_EQ(3UL, client_->numPendingRequests());
+  EXPECT_CALL(callbacks1, onFailure());
+  EXPECT_CALL(callbacks2, onFailure());
+  EXPECT_CALL(callbacks3, onFailure());
+  EXPECT_CALL(*connect_or_op_timer_, disableTimer());
+  EXPECT_CALL(*flush_timer_, disableTimer());
+  upstream_connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_EQ(0UL, client_->numPendingRequests());
+}
+
 TEST_F(RedisClientImplTest, Cancel) {
   InSequence s;
 
@@ -346,12 +405,14 @@ TEST(RedisClientFactoryImplTest, Basic) {
 class RedisConnPoolImplTest : public testing::Test, public ClientFactory {
 public:
   RedisConnPoolImplTest() {
-    std::string json_string = R"EOF(
+    setup(R"EOF(
     {
       "op_timeout_ms": 20
     }
-    )EOF";
+    )EOF");
+  }
 
+  void setup(const std::string& json_string) {
     Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
     conn_pool_.reset(new InstanceImpl(cluster_name_, cm_, *this, tls_, *json_config));
   }
@@ -392,6 +453,355 @@ TEST_F(RedisConnPoolImplTest, Basic) {
   tls_.shutdownThread();
 };
 
+TEST_F(RedisConnPoolImplTest, UpstreamId) {
+  Upstream::HostSharedPtr host1{
+      Upstream::makeTestHost(cm_.thread_local_cluster_.cluster_.info_, "tcp://10.0.0.1:6379")};
+  Upstream::HostSharedPtr host2{
+      Upstream::makeTestHost(cm_.thread_local_cluster_.cluster_.info_, "tcp://10.0.0.2:6379")};
+
+  // The keys that are load balanced to the same host have the same id.
+  EXPECT_CALL(cm_.thread_local_cluster_.lb_, chooseHost(_))
+      .WillOnce(Return(host1))
+      .WillOnce(Return(host2))
+      .WillOnce(Return(host1));
+  const uint64_t id = conn_pool_->upstreamId("foo");
+  EXPECT_NE(id, conn_pool_->upstreamId("bar"));
+  EXPECT_EQ(id, conn_pool_->upstreamId("baz"));
+
+  tls_.shutdownThread();
+};
+
+TEST_F(RedisConnPoolImplTest, MultipleConnectionsPerHost) {
+  setup(R"EOF(
+  {
+    "op_timeout_ms": 20,
+    "max_connections_per_host": 2,
+    "max_requests_per_connection": 1
+  }
+  )EOF");
+
+  RespValue value;
+  MockPoolRequest active_request;
+  MockPoolCallbacks callbacks;
+  MockClient* client1 = new NiceMock<MockClient>();
+  MockClient* client2 = new NiceMock<MockClient>();
+  MockClient* client3 = new NiceMock<MockClient>();
+  EXPECT_CALL(*this, create_(_))
+      .WillOnce(Return(client1))
+      .WillOnce(Return(client2))
+      .WillOnce(Return(client3));
+
+  EXPECT_CALL(*client1, makeRequest(Ref(value), Ref(callbacks)))
+      .Times(2)
+      .WillRepeatedly(Return(&active_request));
+  EXPECT_EQ(&active_request, conn_pool_->makeRequest("foo", value, callbacks));
+
+  // The connection is at its limit, so a second one is made.
+  ON_CALL(*client1, numPendingRequests()).WillByDefault(Return(1));
+  EXPECT_CALL(*client2, makeRequest(Ref(value), Ref(callbacks))).WillOnce(Return(&active_request));
+  EXPECT_EQ(&active_request, conn_pool_->makeRequest("foo", value, callbacks));
+
+  // Both connections are made, so the least loaded one is used.
+  ON_CALL(*client2, numPendingRequests()).WillByDefault(Return(2));
+  EXPECT_EQ(&active_request, conn_pool_->makeRequest("foo", value, callbacks));
+
+  // A closed connection makes room for a new one.
+  EXPECT_CALL(tls_.dispatcher_, deferredDelete_(_));
+  client1->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_CALL(*client3, makeRequest(Ref(value), Ref(callbacks))).WillOnce(Return(&active_request));
+  EXPECT_EQ(&active_request, conn_pool_->makeRequest("foo", value, callbacks));
+
+  EXPECT_CALL(*client2, close());
+  EXPECT_CALL(*client3, close());
+  tls_.shutdownThread();
+}
+
+class RedisConnPoolImplClusterTest : public RedisConnPoolImplTest, public DecoderCallbacks {
+public:
+  void setupCluster(const std::string& read_policy = "master") {
+    cm_.thread_local_cluster_.cluster_.hosts_ = {host1_, host2_, replica_};
+    EXPECT_CALL(*refresh_timer_, enableTimer(std::chrono::milliseconds(0)));
+    setup(fmt::format(R"EOF(
+    {{
+      "op_timeout_ms": 20,
+      "cluster_mode": true,
+      "cluster_refresh_interval_ms": 1000,
+      "read_policy": "{}"
+    }}
+    )EOF",
+                      read_policy));
+  }
+
+  // Redis::DecoderCallbacks
+  void onRespValue(RespValuePtr&& value) override { decoded_value_ = std::move(value); }
+
+  RespValuePtr decode(const std::string& encoded) {
+    Buffer::OwnedImpl buffer(encoded);
+    DecoderImpl decoder(*this);
+    decoder.decode(buffer);
+    return std::move(decoded_value_);
+  }
+
+  // Discovers slots 0-8191 on host1 and slots 8192-16383 on host2.
+  void discoverSlots() {
+    PoolCallbacks* slots_callbacks;
+    EXPECT_CALL(*this, create_(Eq(host1_))).WillOnce(Return(client1_));
+    EXPECT_CALL(*client1_, makeRequest(Eq(ClusterUtility::clusterSlotsRequest()), _))
+        .WillOnce(DoAll(WithArg<1>(SaveArgAddress(&slots_callbacks)), Return(&slots_request_)));
+    refresh_timer_->callback_();
+
+    EXPECT_CALL(*refresh_timer_, enableTimer(std::chrono::milliseconds(1000)));
+    slots_callbacks->onResponse(decode("*2\r\n"
+                                       "*3\r\n:0\r\n:8191\r\n*2\r\n$8\r\n10.0.0.1\r\n:6379\r\n"
+                                       "*3\r\n:8192\r\n:16383\r\n*2\r\n$8\r\n10.0.0.2\r\n"
+                                       ":6379\r\n"));
+  }
+
+  // Discovers slots 0-8191 on host1 with a replica and slots 8192-16383 on host2, when connections
+  // send READONLY first.
+  void discoverSlotsWithReplica() {
+    PoolCallbacks* slots_callbacks;
+    EXPECT_CALL(*this, create_(Eq(host1_))).WillOnce(Return(client1_));
+    {
+      InSequence s;
+      EXPECT_CALL(*client1_, makeRequest(Eq(ClusterUtility::readOnlyRequest()), _));
+      EXPECT_CALL(*client1_, makeRequest(Eq(ClusterUtility::clusterSlotsRequest()), _))
+          .WillOnce(DoAll(WithArg<1>(SaveArgAddress(&slots_callbacks)), Return(&slots_request_)));
+    }
+    refresh_timer_->callback_();
+
+    EXPECT_CALL(*refresh_timer_, enableTimer(std::chrono::milliseconds(1000)));
+    slots_callbacks->onResponse(
+        decode("*2\r\n"
+               "*4\r\n:0\r\n:8191\r\n*2\r\n$8\r\n10.0.0.1\r\n:6379\r\n"
+               "*2\r\n$8\r\n10.0.0.3\r\n:6379\r\n"
+               "*3\r\n:8192\r\n:16383\r\n*2\r\n$8\r\n10.0.0.2\r\n:6379\r\n"));
+  }
+
+  Event::MockTimer* refresh_timer_{new Event::MockTimer(&tls_.dispatcher_)};
+  Upstream::HostSharedPtr host1_{
+      Upstream::makeTestHost(cm_.thread_local_cluster_.cluster_.info_, "tcp://10.0.0.1:6379")};
+  Upstream::HostSharedPtr host2_{
+      Upstream::makeTestHost(cm_.thread_local_cluster_.cluster_.info_, "tcp://10.0.0.2:6379")};
+  Upstream::HostSharedPtr replica_{
+      Upstream::makeTestHost(cm_.thread_local_cluster_.cluster_.info_, "tcp://10.0.0.3:6379")};
+  MockClient* client1_{new NiceMock<MockClient>()};
+  MockClient* client2_{new NiceMock<MockClient>()};
+  MockPoolRequest slots_request_;
+  RespValuePtr decoded_value_;
+};
+
+TEST_F(RedisConnPoolImplClusterTest, SlotRouting) {
+  setupCluster();
+
+  // Until the slots are discovered, requests are load balanced.
+  RespValue value;
+  MockPoolRequest active_request;
+  MockPoolCallbacks callbacks;
+  EXPECT_CALL(cm_.thread_local_cluster_.lb_, chooseHost(_)).WillOnce(Return(host2_));
+  EXPECT_CALL(*this, create_(Eq(host2_))).WillOnce(Return(client2_));
+  EXPECT_CALL(*client2_, makeRequest(Eq(value), _)).WillOnce(Return(&active_request));
+  PoolRequest* request = conn_pool_->makeRequest("bar", value, callbacks);
+  EXPECT_NE(nullptr, request);
+  EXPECT_CALL(active_request, cancel());
+  request->cancel();
+
+  discoverSlots();
+
+  // "bar" is in slot 5061 and "foo" in slot 12182.
+  EXPECT_CALL(cm_.thread_local_cluster_.lb_, chooseHost(_)).Times(0);
+  EXPECT_CALL(*client1_, makeRequest(Eq(value), _)).WillOnce(Return(&active_request));
+  conn_pool_->makeRequest("bar", value, callbacks);
+  EXPECT_CALL(*client2_, makeRequest(Eq(value), _)).WillOnce(Return(&active_request));
+  conn_pool_->makeRequest("foo", value, callbacks);
+
+  // The hash tag decides the slot.
+  EXPECT_CALL(*client1_, makeRequest(Eq(value), _)).WillOnce(Return(&active_request));
+  conn_pool_->makeRequest("foo{bar}", value, callbacks);
+
+  EXPECT_CALL(*client1_, close());
+  EXPECT_CALL(*client2_, close());
+  tls_.shutdownThread();
+}
+
+TEST_F(RedisConnPoolImplClusterTest, UpstreamId) {
+  setupCluster();
+
+  // The id is the slot, even before the slots are discovered.
+  EXPECT_CALL(cm_.thread_local_cluster_.lb_, chooseHost(_)).Times(0);
+  EXPECT_EQ(5061UL, conn_pool_->upstreamId("bar"));
+  EXPECT_EQ(12182UL, conn_pool_->upstreamId("foo"));
+  EXPECT_EQ(5061UL, conn_pool_->upstreamId("foo{bar}"));
+
+  tls_.shutdownThread();
+}
+
+TEST_F(RedisConnPoolImplClusterTest, Redirects) {
+  setupCluster();
+  discoverSlots();
+
+  RespValue value;
+  value.type(RespType::BulkString);
+  value.asString() = "hello";
+  MockPoolRequest active_request;
+  MockPoolCallbacks callbacks;
+  PoolCallbacks* request_callbacks;
+
+  // A MOVED redirection updates the slot and triggers a discovery.
+  EXPECT_CALL(*client1_, makeRequest(Eq(value), _))
+      .WillOnce(DoAll(WithArg<1>(SaveArgAddress(&request_callbacks)), Return(&active_request)));
+  conn_pool_->makeRequest("bar", value, callbacks);
+  EXPECT_CALL(*this, create_(Eq(host2_))).WillOnce(Return(client2_));
+  EXPECT_CALL(*client2_, makeRequest(Eq(value), _)).WillOnce(Return(&active_request));
+  EXPECT_CALL(*refresh_timer_, enableTimer(std::chrono::milliseconds(0)));
+  request_callbacks->onResponse(decode("-MOVED 5061 10.0.0.2:6379\r\n"));
+
+  EXPECT_CALL(*client2_, makeRequest(Eq(value), _))
+      .WillOnce(DoAll(WithArg<1>(SaveArgAddress(&request_callbacks)), Return(&active_request)));
+  conn_pool_->makeRequest("bar", value, callbacks);
+
+  // An ASK redirection is followed once, after ASKING on the same connection.
+  {
+    InSequence s;
+    EXPECT_CALL(*client1_, makeRequest(Eq(ClusterUtility::askingRequest()), _));
+    EXPECT_CALL(*client1_, makeRequest(Eq(value), _))
+        .WillOnce(DoAll(WithArg<1>(SaveArgAddress(&request_callbacks)), Return(&active_request)));
+  }
+  request_callbacks->onResponse(decode("-ASK 5061 10.0.0.1:6379\r\n"));
+
+  EXPECT_CALL(callbacks, onResponse_(_)).WillOnce(Invoke([](RespValuePtr& response) -> void {
+    EXPECT_EQ("\"world\"", response->toString());
+  }));
+  request_callbacks->onResponse(decode("$5\r\nworld\r\n"));
+
+  // The ASK redirection did not change the slot.
+  EXPECT_CALL(*client2_, makeRequest(Eq(value), _))
+      .WillOnce(DoAll(WithArg<1>(SaveArgAddress(&request_callbacks)), Return(&active_request)));
+  conn_pool_->makeRequest("bar", value, callbacks);
+
+  // Redirections to unknown nodes are returned.
+  EXPECT_CALL(*refresh_timer_, enableTimer(std::chrono::milliseconds(0)));
+  EXPECT_CALL(callbacks, onResponse_(_)).WillOnce(Invoke([](RespValuePtr& response) -> void {
+    EXPECT_EQ("\"MOVED 5061 10.0.0.4:6379\"", response->toString());
+  }));
+  request_callbacks->onResponse(decode("-MOVED 5061 10.0.0.4:6379\r\n"));
+
+  // The slot is load balanced until the next discovery.
+  EXPECT_CALL(cm_.thread_local_cluster_.lb_, chooseHost(_)).WillOnce(Return(host1_));
+  EXPECT_CALL(*client1_, makeRequest(Eq(value), _))
+      .WillOnce(DoAll(WithArg<1>(SaveArgAddress(&request_callbacks)), Return(&active_request)));
+  conn_pool_->makeRequest("bar", value, callbacks);
+  EXPECT_CALL(callbacks, onFailure());
+  request_callbacks->onFailure();
+
+  EXPECT_CALL(*client1_, close());
+  EXPECT_CALL(*client2_, close());
+  tls_.shutdownThread();
+}
+
+TEST_F(RedisConnPoolImplClusterTest, DiscoveryFailure) {
+  setupCluster();
+  PoolCallbacks* slots_callbacks;
+  EXPECT_CALL(*this, create_(Eq(host1_))).WillOnce(Return(client1_));
+  EXPECT_CALL(*client1_, makeRequest(Eq(ClusterUtility::clusterSlotsRequest()), _))
+      .WillOnce(DoAll(WithArg<1>(SaveArgAddress(&slots_callbacks)), Return(&slots_request_)));
+  refresh_timer_->callback_();
+
+  // The next discovery asks the next host.
+  EXPECT_CALL(*refresh_timer_, enableTimer(std::chrono::milliseconds(1000)));
+  slots_callbacks->onFailure();
+  EXPECT_CALL(*this, create_(Eq(host2_))).WillOnce(Return(client2_));
+  EXPECT_CALL(*client2_, makeRequest(Eq(ClusterUtility::clusterSlotsRequest()), _))
+      .WillOnce(DoAll(WithArg<1>(SaveArgAddress(&slots_callbacks)), Return(&slots_request_)));
+  refresh_timer_->callback_();
+
+  // An invalid response keeps load balancing.
+  EXPECT_CALL(*refresh_timer_, enableTimer(std::chrono::milliseconds(1000)));
+  slots_callbacks->onResponse(decode("-ERR This instance has cluster support disabled\r\n"));
+  RespValue value;
+  MockPoolRequest active_request;
+  MockPoolCallbacks callbacks;
+  EXPECT_CALL(cm_.thread_local_cluster_.lb_, chooseHost(_)).WillOnce(Return(host1_));
+  EXPECT_CALL(*client1_, makeRequest(Eq(value), _)).WillOnce(Return(&active_request));
+  EXPECT_NE(nullptr, conn_pool_->makeRequest("bar", value, callbacks));
+
+  EXPECT_CALL(*client1_, close());
+  EXPECT_CALL(*client2_, close());
+  tls_.shutdownThread();
+}
+
+TEST_F(RedisConnPoolImplClusterTest, PreferReplica) {
+  setupCluster("prefer_replica");
+  discoverSlotsWithReplica();
+
+  // Reads go to the replica and the other requests to the master.
+  RespValue value;
+  MockPoolRequest active_request;
+  MockPoolCallbacks callbacks;
+  MockClient* replica_client = new NiceMock<MockClient>();
+  EXPECT_CALL(*this, create_(Eq(replica_))).WillOnce(Return(replica_client));
+  {
+    InSequence s;
+    EXPECT_CALL(*replica_client, makeRequest(Eq(ClusterUtility::readOnlyRequest()), _));
+    EXPECT_CALL(*replica_client, makeRequest(Eq(value), _)).WillOnce(Return(&active_request));
+  }
+  EXPECT_NE(nullptr, conn_pool_->makeReadRequest("bar", value, callbacks));
+  EXPECT_CALL(*client1_, makeRequest(Eq(value), _)).WillOnce(Return(&active_request));
+  EXPECT_NE(nullptr, conn_pool_->makeRequest("bar", value, callbacks));
+
+  // Without replicas, reads go to the master.
+  EXPECT_CALL(*this, create_(Eq(host2_))).WillOnce(Return(client2_));
+  {
+    InSequence s;
+    EXPECT_CALL(*client2_, makeRequest(Eq(ClusterUtility::readOnlyRequest()), _));
+    EXPECT_CALL(*client2_, makeRequest(Eq(value), _)).WillOnce(Return(&active_request));
+  }
+  EXPECT_NE(nullptr, conn_pool_->makeReadRequest("foo", value, callbacks));
+
+  // A removed replica stops serving reads.
+  EXPECT_CALL(*replica_client, close());
+  EXPECT_CALL(*refresh_timer_, enableTimer(std::chrono::milliseconds(0)));
+  cm_.thread_local_cluster_.cluster_.hosts_ = {host1_, host2_};
+  cm_.thread_local_cluster_.cluster_.runCallbacks({}, {replica_});
+  EXPECT_CALL(*client1_, makeRequest(Eq(value), _)).WillOnce(Return(&active_request));
+  EXPECT_NE(nullptr, conn_pool_->makeReadRequest("bar", value, callbacks));
+
+  EXPECT_CALL(*client1_, close());
+  EXPECT_CALL(*client2_, close());
+  tls_.shutdownThread();
+}
+
+TEST_F(RedisConnPoolImplClusterTest, ReadFromAnyHost) {
+  setupCluster("any");
+  discoverSlotsWithReplica();
+
+  // Reads take turns over the replica and the master.
+  RespValue value;
+  MockPoolRequest active_request;
+  MockPoolCallbacks callbacks;
+  MockClient* replica_client = new NiceMock<MockClient>();
+  EXPECT_CALL(*this, create_(Eq(replica_))).WillOnce(Return(replica_client));
+  EXPECT_CALL(*replica_client, makeRequest(Eq(ClusterUtility::readOnlyRequest()), _));
+  EXPECT_CALL(*replica_client, makeRequest(Eq(value), _))
+      .Times(2)
+      .WillRepeatedly(Return(&active_request));
+  EXPECT_CALL(*client1_, makeRequest(Eq(value), _)).WillOnce(Return(&active_request));
+  conn_pool_->makeReadRequest("bar", value, callbacks);
+  conn_pool_->makeReadRequest("bar", value, callbacks);
+  conn_pool_->makeReadRequest("bar", value, callbacks);
+
+  // Slots without replicas are read from their master.
+  EXPECT_CALL(*this, create_(Eq(host2_))).WillOnce(Return(client2_));
+  EXPECT_CALL(*client2_, makeRequest(Eq(ClusterUtility::readOnlyRequest()), _));
+  EXPECT_CALL(*client2_, makeRequest(Eq(value), _)).WillOnce(Return(&active_request));
+  conn_pool_->makeReadRequest("foo", value, callbacks);
+
+  EXPECT_CALL(*client1_, close());
+  EXPECT_CALL(*client2_, close());
+  EXPECT_CALL(*replica_client, close());
+  tls_.shutdownThread();
+}
+
 TEST_F(RedisConnPoolImplTest, HostRemove) {
   InSequence s;
   MockPoolCallbacks callbacks;
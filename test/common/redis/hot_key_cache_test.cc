@@ -0,0 +1,105 @@
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "common/json/json_loader.h"
+#include "common/redis/hot_key_cache.h"
+
+#include "test/mocks/common.h"
+#include "test/mocks/redis/mocks.h"
+#include "test/test_common/printers.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::NiceMock;
+using testing::ReturnPointee;
+
+namespace Envoy {
+namespace Redis {
+
+class RedisHotKeyCacheTest : public testing::Test {
+public:
+  RedisHotKeyCacheTest() {
+    ON_CALL(time_source_, currentTime()).WillByDefault(ReturnPointee(&now_));
+  }
+
+  void setup(const std::string& json) {
+    Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+    cache_.reset(new HotKeyCache(HotKeyCacheConfig(*config), time_source_));
+  }
+
+  RespValue makeValue(const std::string& string) {
+    RespValue value;
+    value.type(RespType::BulkString);
+    value.asString() = string;
+    return value;
+  }
+
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  MonotonicTime now_;
+  std::unique_ptr<HotKeyCache> cache_;
+};
+
+TEST_F(RedisHotKeyCacheTest, Config) {
+  setup(R"EOF({"keys": ["a", "b"], "ttl_ms": 100})EOF");
+  EXPECT_TRUE(cache_->isHot("a"));
+  EXPECT_TRUE(cache_->isHot("b"));
+  EXPECT_FALSE(cache_->isHot("c"));
+
+  // All the keys fit by default.
+  cache_->insert("a", makeValue("1"));
+  cache_->insert("b", makeValue("2"));
+  EXPECT_EQ(2UL, cache_->size());
+}
+
+TEST_F(RedisHotKeyCacheTest, InsertAndExpire) {
+  setup(R"EOF({"keys": ["a"], "ttl_ms": 100})EOF");
+  EXPECT_EQ(nullptr, cache_->lookup("a"));
+
+  // Only hot keys and values, including nil, are cached.
+  cache_->insert("b", makeValue("1"));
+  RespValue error;
+  error.type(RespType::Error);
+  error.asString() = "ERR";
+  cache_->insert("a", error);
+  EXPECT_EQ(0UL, cache_->size());
+  cache_->insert("a", RespValue());
+  ASSERT_NE(nullptr, cache_->lookup("a"));
+  EXPECT_EQ(RespType::Null, cache_->lookup("a")->type());
+
+  cache_->insert("a", makeValue("1"));
+  EXPECT_EQ(makeValue("1"), *cache_->lookup("a"));
+  EXPECT_EQ(1UL, cache_->size());
+
+  now_ += std::chrono::milliseconds(99);
+  EXPECT_NE(nullptr, cache_->lookup("a"));
+  now_ += std::chrono::milliseconds(1);
+  EXPECT_EQ(nullptr, cache_->lookup("a"));
+  EXPECT_EQ(0UL, cache_->size());
+}
+
+TEST_F(RedisHotKeyCacheTest, Invalidate) {
+  setup(R"EOF({"keys": ["a"], "ttl_ms": 100})EOF");
+  cache_->invalidate("a");
+  cache_->insert("a", makeValue("1"));
+  cache_->invalidate("a");
+  EXPECT_EQ(nullptr, cache_->lookup("a"));
+  EXPECT_EQ(0UL, cache_->size());
+}
+
+TEST_F(RedisHotKeyCacheTest, EvictLeastRecentlyUsed) {
+  setup(R"EOF({"keys": ["a", "b", "c"], "ttl_ms": 100, "max_entries": 2})EOF");
+  cache_->insert("a", makeValue("1"));
+  cache_->insert("b", makeValue("2"));
+  EXPECT_NE(nullptr, cache_->lookup("a"));
+
+  cache_->insert("c", makeValue("3"));
+  EXPECT_EQ(2UL, cache_->size());
+  EXPECT_EQ(nullptr, cache_->lookup("b"));
+  EXPECT_NE(nullptr, cache_->lookup("a"));
+  EXPECT_NE(nullptr, cache_->lookup("c"));
+}
+
+} // namespace Redis
+} // namespace Envoy
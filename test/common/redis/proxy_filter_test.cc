@@ -43,6 +43,28 @@ TEST(RedisProxyFilterConfigTest, Normal) {
   EXPECT_EQ("fake_cluster", config.clusterName());
 }
 
+TEST(RedisProxyFilterConfigTest, HotKeyCache) {
+  std::string json_string = R"EOF(
+  {
+    "cluster_name": "fake_cluster",
+    "stat_prefix": "foo",
+    "conn_pool": {},
+    "hot_key_cache": {
+      "keys": ["a", "b"],
+      "ttl_ms": 50
+    }
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<Upstream::MockClusterManager> cm;
+  Stats::IsolatedStoreImpl store;
+  ProxyFilterConfig config(*json_config, cm, store);
+  EXPECT_EQ(2UL, config.hotKeyCacheConfig().keys_.size());
+  EXPECT_EQ(2U, config.hotKeyCacheConfig().max_entries_);
+  EXPECT_EQ(std::chrono::milliseconds(50), config.hotKeyCacheConfig().ttl_);
+}
+
 TEST(RedisProxyFilterConfigTest, InvalidCluster) {
   std::string json_string = R"EOF(
   {
@@ -4,7 +4,9 @@
 #include <memory>
 #include <string>
 
+#include "common/config/metadata.h"
 #include "common/config/rds_json.h"
+#include "common/config/well_known_names.h"
 #include "common/http/header_map_impl.h"
 #include "common/http/headers.h"
 #include "common/json/json_loader.h"
@@ -287,6 +289,12 @@ TEST(RouteMatcherTest, TestRoutes) {
       "regex_default",
       config.route(genHeaders("bat.com", "/tac?tic=true", "GET"), 0)->routeEntry()->clusterName());
 
+  // Routes to a single cluster keep a handle of it.
+  EXPECT_EQ("instant-server", config.route(genHeaders("api.lyft.com", "/", "GET"), 0)
+                                  ->routeEntry()
+                                  ->clusterHandle()
+                                  ->name());
+
   // Timeout testing.
   EXPECT_EQ(std::chrono::milliseconds(30000),
             config.route(genHeaders("api.lyft.com", "/", "GET"), 0)->routeEntry()->timeout());
@@ -595,13 +603,14 @@ TEST(RouteMatcherTest, TestAddRemoveReqRespHeaders) {
   }
 
   // Response header manipulation testing.
-  EXPECT_THAT(std::list<Http::LowerCaseString>{Http::LowerCaseString("x-lyft-user-id")},
+  EXPECT_THAT(std::vector<Http::LowerCaseString>{Http::LowerCaseString("x-lyft-user-id")},
               ContainerEq(config.internalOnlyHeaders()));
-  EXPECT_THAT((std::list<std::pair<Http::LowerCaseString, std::string>>(
+  EXPECT_THAT((std::vector<std::pair<Http::LowerCaseString, std::string>>(
                   {{Http::LowerCaseString("x-envoy-upstream-canary"), "true"}})),
               ContainerEq(config.responseHeadersToAdd()));
-  EXPECT_THAT(std::list<Http::LowerCaseString>({Http::LowerCaseString("x-envoy-upstream-canary"),
-                                                Http::LowerCaseString("x-envoy-virtual-cluster")}),
+  EXPECT_THAT(std::vector<Http::LowerCaseString>(
+                  {Http::LowerCaseString("x-envoy-upstream-canary"),
+                   Http::LowerCaseString("x-envoy-virtual-cluster")}),
               ContainerEq(config.responseHeadersToRemove()));
 }
 
@@ -801,6 +810,76 @@ TEST(RouteMatcherTest, HeaderMatchedRouting) {
   }
 }
 
+// Routes must be matched in configuration order regardless of how they are indexed.
+TEST(RouteMatcherTest, MixedMatcherOrdering) {
+  std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "local_service",
+      "domains": ["*"],
+      "routes": [
+        {
+          "prefix": "/foo/bar",
+          "cluster": "foo_bar_with_header",
+          "headers" : [
+            {"name": "test_header", "value": "test"}
+          ]
+        },
+        {
+          "regex": "/foo/b.*",
+          "cluster": "regex"
+        },
+        {
+          "path": "/foo/bar",
+          "cluster": "foo_bar_path"
+        },
+        {
+          "prefix": "/FOO/",
+          "case_sensitive": false,
+          "cluster": "foo_insensitive"
+        },
+        {
+          "prefix": "/foo",
+          "cluster": "foo"
+        },
+        {
+          "prefix": "/",
+          "cluster": "default"
+        }
+      ]
+    }
+  ]
+}
+  )EOF";
+
+  NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Upstream::MockClusterManager> cm;
+  ConfigImpl config(parseRouteConfigurationFromJson(json), runtime, cm, true);
+
+  {
+    Http::TestHeaderMapImpl headers = genHeaders("www.lyft.com", "/foo/bar", "GET");
+    headers.addCopy("test_header", "test");
+    EXPECT_EQ("foo_bar_with_header", config.route(headers, 0)->routeEntry()->clusterName());
+  }
+  EXPECT_EQ("regex", config.route(genHeaders("www.lyft.com", "/foo/bar", "GET"), 0)
+                         ->routeEntry()
+                         ->clusterName());
+  EXPECT_EQ("foo_insensitive", config.route(genHeaders("www.lyft.com", "/foo/car", "GET"), 0)
+                                   ->routeEntry()
+                                   ->clusterName());
+  EXPECT_EQ("foo_insensitive", config.route(genHeaders("www.lyft.com", "/Foo/car", "GET"), 0)
+                                   ->routeEntry()
+                                   ->clusterName());
+  EXPECT_EQ("foo", config.route(genHeaders("www.lyft.com", "/foocar", "GET"), 0)
+                       ->routeEntry()
+                       ->clusterName());
+  EXPECT_EQ("default",
+            config.route(genHeaders("www.lyft.com", "/", "GET"), 0)->routeEntry()->clusterName());
+  EXPECT_EQ("default",
+            config.route(genHeaders("www.lyft.com", "/bar", "GET"), 0)->routeEntry()->clusterName());
+}
+
 TEST(RouterMatcherTest, HashPolicy) {
   std::string json = R"EOF(
 {
@@ -891,6 +970,8 @@ TEST(RouteMatcherTest, ClusterHeader) {
     headers.addCopy("some_header", "some_cluster");
     Router::RouteConstSharedPtr route = config.route(headers, 0);
     EXPECT_EQ("some_cluster", route->routeEntry()->clusterName());
+    // The cluster of a header is looked up by its name.
+    EXPECT_EQ(nullptr, route->routeEntry()->clusterHandle());
 
     // Make sure things forward and don't crash.
     EXPECT_EQ(std::chrono::milliseconds(0), route->routeEntry()->timeout());
@@ -1674,6 +1755,9 @@ TEST(RouteMatcherTest, WeightedClusters) {
   {
     Http::TestHeaderMapImpl headers = genHeaders("www1.lyft.com", "/foo", "GET");
     const RouteEntry* route = config.route(headers, 115)->routeEntry();
+    ASSERT_NE(nullptr, route->clusterHandle());
+    EXPECT_EQ("cluster1", route->clusterHandle()->name());
+    EXPECT_EQ(route->clusterHandle(), config.route(headers, 115)->routeEntry()->clusterHandle());
     EXPECT_EQ(nullptr, route->hashPolicy());
     EXPECT_TRUE(route->opaqueConfig().empty());
     EXPECT_FALSE(route->autoHostRewrite());
@@ -2148,6 +2232,122 @@ TEST(RouteMatcherTest, TestOpaqueConfig) {
   EXPECT_EQ(opaque_config.find("name2")->second, "value2");
 }
 
+TEST(RouteMatcherTest, TestMetadataMatchCriteria) {
+  std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "default",
+      "domains": ["*"],
+      "routes": [
+        {
+          "prefix": "/canary",
+          "cluster": "ats"
+        },
+        {
+          "prefix": "/",
+          "cluster": "ats"
+        }
+      ]
+    }
+  ]
+}
+)EOF";
+
+  NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Upstream::MockClusterManager> cm;
+  envoy::api::v2::RouteConfiguration route_config = parseRouteConfigurationFromJson(json);
+  envoy::api::v2::Metadata& metadata =
+      *route_config.mutable_virtual_hosts(0)->mutable_routes(0)->mutable_metadata();
+  const std::string& filter = Envoy::Config::MetadataFilters::get().ENVOY_LB;
+  Envoy::Config::Metadata::mutableMetadataValue(metadata, filter, "version").set_number_value(1);
+  Envoy::Config::Metadata::mutableMetadataValue(metadata, filter, "stage")
+      .set_string_value("canary");
+  ConfigImpl config(route_config, runtime, cm, true);
+
+  std::string subset_key;
+  EXPECT_TRUE(Envoy::Config::Metadata::subsetKey(metadata, filter, {"stage", "version"},
+                                                 subset_key));
+  const Upstream::MetadataMatchCriteria* criteria =
+      config.route(genHeaders("api.lyft.com", "/canary", "GET"), 0)
+          ->routeEntry()
+          ->metadataMatchCriteria();
+  ASSERT_NE(nullptr, criteria);
+  EXPECT_EQ(subset_key, criteria->subsetKey());
+  EXPECT_EQ(nullptr, config.route(genHeaders("api.lyft.com", "/", "GET"), 0)
+                         ->routeEntry()
+                         ->metadataMatchCriteria());
+
+  Envoy::Config::Metadata::mutableMetadataValue(metadata, filter, "stage").mutable_list_value();
+  EXPECT_THROW_WITH_MESSAGE(ConfigImpl(route_config, runtime, cm, true), EnvoyException,
+                            "route: envoy.lb metadata values must be strings, numbers or bools");
+}
+
+TEST(RouteMatcherTest, TestPerRequestBufferLimit) {
+  std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "default",
+      "domains": ["*"],
+      "routes": [
+        {
+          "prefix": "/upload",
+          "cluster": "ats",
+          "opaque_config" : {
+              "per_request_buffer_limit_bytes": "1048576"
+          }
+        },
+        {
+          "prefix": "/api",
+          "cluster": "ats"
+        },
+        {
+          "prefix": "/",
+          "cluster": "ats"
+        }
+      ]
+    }
+  ]
+}
+)EOF";
+
+  NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Upstream::MockClusterManager> cm;
+  envoy::api::v2::RouteConfiguration route_config = parseRouteConfigurationFromJson(json);
+  ProtobufWkt::Value& value = Envoy::Config::Metadata::mutableMetadataValue(
+      *route_config.mutable_virtual_hosts(0)->mutable_routes(1)->mutable_metadata(),
+      Envoy::Config::HttpFilterNames::get().ROUTER, "per_request_buffer_limit_bytes");
+  value.set_number_value(4096);
+  {
+    ConfigImpl config(route_config, runtime, cm, true);
+    Optional<uint32_t> limit = config.route(genHeaders("api.lyft.com", "/upload", "GET"), 0)
+                                   ->routeEntry()
+                                   ->perRequestBufferLimit();
+    ASSERT_TRUE(limit.valid());
+    EXPECT_EQ(1048576U, limit.value());
+    limit = config.route(genHeaders("api.lyft.com", "/api", "GET"), 0)
+                ->routeEntry()
+                ->perRequestBufferLimit();
+    ASSERT_TRUE(limit.valid());
+    EXPECT_EQ(4096U, limit.value());
+    EXPECT_FALSE(config.route(genHeaders("api.lyft.com", "/", "GET"), 0)
+                     ->routeEntry()
+                     ->perRequestBufferLimit()
+                     .valid());
+  }
+
+  value.set_number_value(-1);
+  EXPECT_THROW_WITH_MESSAGE(ConfigImpl(route_config, runtime, cm, true), EnvoyException,
+                            "route: per_request_buffer_limit_bytes must be a number of bytes");
+  value.set_number_value(8589934592);
+  EXPECT_THROW_WITH_MESSAGE(ConfigImpl(route_config, runtime, cm, true), EnvoyException,
+                            "route: per_request_buffer_limit_bytes must be a number of bytes");
+  value.set_string_value("lots");
+  EXPECT_THROW_WITH_MESSAGE(ConfigImpl(route_config, runtime, cm, true), EnvoyException,
+                            "route: per_request_buffer_limit_bytes must be a number of bytes");
+}
+
 TEST(RoutePropertyTest, excludeVHRateLimits) {
   std::string json = R"EOF(
   {
@@ -2321,6 +2521,62 @@ TEST(RoutePropertyTest, TestRouteCorsConfig) {
   EXPECT_EQ(cors_policy->allowCredentials(), true);
 }
 
+TEST(RoutePropertyTest, TestCorsOriginMatching) {
+  std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "default",
+      "domains": ["*"],
+      "routes": [
+        {
+          "prefix": "/api",
+          "cluster": "ats",
+          "cors" : {
+              "allow_origin": ["https://b.example.com", "https://*.example.org", "http://a.com",
+                               "https://a*b*c"]
+          }
+        },
+        {
+          "prefix": "/",
+          "cluster": "ats",
+          "cors" : {
+              "allow_origin": ["http://a.com", "*"]
+          }
+        }
+      ]
+    }
+  ]
+}
+)EOF";
+
+  NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Upstream::MockClusterManager> cm;
+  ConfigImpl config(parseRouteConfigurationFromJson(json), runtime, cm, true);
+  const auto allowed = [&config](const std::string& path, const std::string& origin) -> bool {
+    Http::HeaderString value;
+    value.setCopy(origin.c_str(), origin.size());
+    return config.route(genHeaders("api.lyft.com", path, "GET"), 0)
+        ->routeEntry()
+        ->corsPolicy()
+        ->originAllowed(value);
+  };
+
+  EXPECT_TRUE(allowed("/api", "https://b.example.com"));
+  EXPECT_TRUE(allowed("/api", "http://a.com"));
+  EXPECT_FALSE(allowed("/api", "http://a.co"));
+  EXPECT_FALSE(allowed("/api", "http://a.com.evil"));
+  EXPECT_FALSE(allowed("/api", "https://a.example.com"));
+  EXPECT_TRUE(allowed("/api", "https://a.example.org"));
+  EXPECT_TRUE(allowed("/api", "https://a.b.example.org"));
+  EXPECT_FALSE(allowed("/api", "https://example.org"));
+  EXPECT_FALSE(allowed("/api", "http://a.example.org"));
+  // Origins with more than one wildcard are matched exactly.
+  EXPECT_TRUE(allowed("/api", "https://a*b*c"));
+  EXPECT_FALSE(allowed("/api", "https://aXbYc"));
+  EXPECT_TRUE(allowed("/", "https://any.origin"));
+}
+
 TEST(RoutePropertyTest, TestBadCorsConfig) {
   std::string json = R"EOF(
 {
@@ -0,0 +1,96 @@
+#include <string>
+
+#include "common/router/domain_match_trie.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Router {
+
+class DomainMatchTrieTest : public testing::Test {
+public:
+  uint32_t find(const std::string& host) { return trie_.find(host.c_str(), host.size()); }
+
+  DomainMatchTrie trie_;
+};
+
+TEST_F(DomainMatchTrieTest, Empty) {
+  EXPECT_TRUE(trie_.empty());
+  EXPECT_EQ(DomainMatchTrie::NO_MATCH, find(""));
+  EXPECT_EQ(DomainMatchTrie::NO_MATCH, find("foo.com"));
+}
+
+TEST_F(DomainMatchTrieTest, Domains) {
+  EXPECT_TRUE(trie_.addDomain("foo.com", 0));
+  EXPECT_TRUE(trie_.addDomain("www.foo.com", 1));
+  EXPECT_TRUE(trie_.addDomain("bar.com", 2));
+  EXPECT_FALSE(trie_.addDomain("foo.com", 3));
+  EXPECT_FALSE(trie_.empty());
+
+  EXPECT_EQ(0U, find("foo.com"));
+  EXPECT_EQ(1U, find("www.foo.com"));
+  EXPECT_EQ(2U, find("bar.com"));
+  EXPECT_EQ(DomainMatchTrie::NO_MATCH, find("oo.com"));
+  EXPECT_EQ(DomainMatchTrie::NO_MATCH, find("ww.foo.com"));
+  EXPECT_EQ(DomainMatchTrie::NO_MATCH, find("afoo.com"));
+  EXPECT_EQ(DomainMatchTrie::NO_MATCH, find("foo.co"));
+  EXPECT_EQ(DomainMatchTrie::NO_MATCH, find(".com"));
+  EXPECT_EQ(DomainMatchTrie::NO_MATCH, find(""));
+  // Matching is case sensitive.
+  EXPECT_EQ(DomainMatchTrie::NO_MATCH, find("Foo.com"));
+}
+
+TEST_F(DomainMatchTrieTest, WildcardSuffixes) {
+  trie_.addWildcardSuffix(".foo.com", 0);
+  trie_.addWildcardSuffix("-bar.foo.com", 1);
+  trie_.addWildcardSuffix(".com", 2);
+  trie_.addWildcardSuffix(".foo.com", 3);
+
+  EXPECT_EQ(0U, find("www.foo.com"));
+  EXPECT_EQ(0U, find("a.b.foo.com"));
+  EXPECT_EQ(1U, find("baz-bar.foo.com"));
+  EXPECT_EQ(0U, find("baz.bar.foo.com"));
+  EXPECT_EQ(2U, find("bar.com"));
+  EXPECT_EQ(2U, find("x-bar.foo.org.com"));
+  // A wildcard matches at least one character.
+  EXPECT_EQ(2U, find(".foo.com"));
+  EXPECT_EQ(0U, find("-bar.foo.com"));
+  EXPECT_EQ(DomainMatchTrie::NO_MATCH, find(".com"));
+  EXPECT_EQ(DomainMatchTrie::NO_MATCH, find("com"));
+  EXPECT_EQ(DomainMatchTrie::NO_MATCH, find("foo.org"));
+}
+
+TEST_F(DomainMatchTrieTest, DomainsBeforeWildcards) {
+  trie_.addWildcardSuffix(".foo.com", 0);
+  EXPECT_TRUE(trie_.addDomain("www.foo.com", 1));
+  EXPECT_TRUE(trie_.addDomain("foo.com", 2));
+  trie_.addWildcardSuffix("oo.com", 3);
+
+  EXPECT_EQ(1U, find("www.foo.com"));
+  EXPECT_EQ(0U, find("ww.foo.com"));
+  EXPECT_EQ(0U, find("wwww.foo.com"));
+  EXPECT_EQ(2U, find("foo.com"));
+  EXPECT_EQ(3U, find("boo.com"));
+  EXPECT_EQ(3U, find("afoo.com"));
+}
+
+// Edges are split where domains diverge, and shared suffixes share nodes.
+TEST_F(DomainMatchTrieTest, NodeCount) {
+  EXPECT_EQ(1U, trie_.nodeCount());
+  trie_.addDomain("a.foo.com", 0);
+  EXPECT_EQ(2U, trie_.nodeCount());
+  trie_.addDomain("b.foo.com", 1);
+  EXPECT_EQ(4U, trie_.nodeCount());
+  trie_.addWildcardSuffix(".foo.com", 2);
+  EXPECT_EQ(4U, trie_.nodeCount());
+  trie_.addDomain("foo.com", 3);
+  EXPECT_EQ(5U, trie_.nodeCount());
+
+  EXPECT_EQ(0U, find("a.foo.com"));
+  EXPECT_EQ(1U, find("b.foo.com"));
+  EXPECT_EQ(2U, find("c.foo.com"));
+  EXPECT_EQ(3U, find("foo.com"));
+}
+
+} // namespace Router
+} // namespace Envoy
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "common/router/path_match_trie.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Router {
+
+class PathMatchTrieTest : public testing::Test {
+public:
+  std::vector<uint32_t> candidates(const PathMatchTrie& trie, const std::string& path) {
+    std::vector<uint32_t> ids;
+    size_t exact_length = std::min(path.find('?'), path.size());
+    trie.forEachCandidate(path.c_str(), path.size(), exact_length,
+                          [&ids](const std::vector<uint32_t>& list) -> void {
+                            ids.insert(ids.end(), list.begin(), list.end());
+                          });
+    std::sort(ids.begin(), ids.end());
+    return ids;
+  }
+};
+
+TEST_F(PathMatchTrieTest, Prefixes) {
+  PathMatchTrie trie(true);
+  trie.addPrefix("/", 0);
+  trie.addPrefix("/foo", 1);
+  trie.addPrefix("/foobar", 2);
+  trie.addPrefix("/fob", 3);
+  trie.addPrefix("/foo", 4);
+  trie.addPrefix("", 5);
+
+  EXPECT_EQ((std::vector<uint32_t>{0, 5}), candidates(trie, "/"));
+  EXPECT_EQ((std::vector<uint32_t>{5}), candidates(trie, ""));
+  EXPECT_EQ((std::vector<uint32_t>{0, 1, 4, 5}), candidates(trie, "/foo"));
+  EXPECT_EQ((std::vector<uint32_t>{0, 1, 4, 5}), candidates(trie, "/foob"));
+  EXPECT_EQ((std::vector<uint32_t>{0, 1, 2, 4, 5}), candidates(trie, "/foobar/baz"));
+  EXPECT_EQ((std::vector<uint32_t>{0, 3, 5}), candidates(trie, "/fob"));
+  EXPECT_EQ((std::vector<uint32_t>{0, 5}), candidates(trie, "/fo"));
+  EXPECT_EQ((std::vector<uint32_t>{0, 5}), candidates(trie, "/FOO"));
+  EXPECT_EQ((std::vector<uint32_t>{0, 1, 4, 5}), candidates(trie, "/foo?a=b"));
+}
+
+TEST_F(PathMatchTrieTest, Paths) {
+  PathMatchTrie trie(true);
+  trie.addPath("/foo", 0);
+  trie.addPrefix("/foo/", 1);
+  trie.addPath("/foo/bar", 2);
+
+  EXPECT_EQ((std::vector<uint32_t>{0}), candidates(trie, "/foo"));
+  EXPECT_EQ((std::vector<uint32_t>{0}), candidates(trie, "/foo?bar"));
+  EXPECT_EQ((std::vector<uint32_t>{1}), candidates(trie, "/foo/"));
+  EXPECT_EQ((std::vector<uint32_t>{1, 2}), candidates(trie, "/foo/bar"));
+  EXPECT_EQ((std::vector<uint32_t>{1}), candidates(trie, "/foo/bar/baz"));
+  EXPECT_EQ((std::vector<uint32_t>{}), candidates(trie, "/fo"));
+}
+
+TEST_F(PathMatchTrieTest, CaseInsensitive) {
+  PathMatchTrie trie(false);
+  trie.addPrefix("/Foo", 0);
+  trie.addPath("/BAR", 1);
+
+  EXPECT_EQ((std::vector<uint32_t>{0}), candidates(trie, "/foo/x"));
+  EXPECT_EQ((std::vector<uint32_t>{0}), candidates(trie, "/FOO"));
+  EXPECT_EQ((std::vector<uint32_t>{1}), candidates(trie, "/bar"));
+  EXPECT_EQ((std::vector<uint32_t>{}), candidates(trie, "/bar/"));
+}
+
+TEST_F(PathMatchTrieTest, EdgeSplitting) {
+  PathMatchTrie trie(true);
+  trie.addPrefix("/abcdef", 0);
+  EXPECT_EQ(2U, trie.nodeCount());
+  trie.addPrefix("/abc", 1);
+  EXPECT_EQ(3U, trie.nodeCount());
+  trie.addPrefix("/abd", 2);
+  EXPECT_EQ(5U, trie.nodeCount());
+
+  EXPECT_EQ((std::vector<uint32_t>{0, 1}), candidates(trie, "/abcdefg"));
+  EXPECT_EQ((std::vector<uint32_t>{1}), candidates(trie, "/abcde"));
+  EXPECT_EQ((std::vector<uint32_t>{2}), candidates(trie, "/abd"));
+  EXPECT_EQ((std::vector<uint32_t>{}), candidates(trie, "/ab"));
+}
+
+TEST_F(PathMatchTrieTest, ManyRoutes) {
+  PathMatchTrie trie(true);
+  for (uint32_t i = 0; i < 2500; i++) {
+    trie.addPrefix("/service/" + std::to_string(i) + "/", i);
+  }
+
+  EXPECT_EQ((std::vector<uint32_t>{1234}), candidates(trie, "/service/1234/method"));
+  EXPECT_EQ((std::vector<uint32_t>{}), candidates(trie, "/service/12345"));
+}
+
+} // namespace Router
+} // namespace Envoy
@@ -1,5 +1,9 @@
 #include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "common/config/filter_json.h"
 #include "common/config/utility.h"
@@ -346,6 +350,102 @@ TEST_F(RdsImplTest, Basic) {
   EXPECT_EQ(3UL, store_.counter("foo.rds.update_success").value());
 }
 
+// With rds.compile_in_background set, a new configuration is compiled off the main thread and is
+// published once the compiler posts it back. Configurations that fail to compile are rejected.
+TEST_F(RdsImplTest, CompileInBackground) {
+  ON_CALL(runtime_.snapshot_, getInteger("rds.compile_in_background", 0)).WillByDefault(Return(1));
+  std::mutex posted_lock;
+  std::condition_variable posted_event;
+  std::list<std::function<void()>> posted;
+  EXPECT_CALL(dispatcher_, post(_))
+      .WillRepeatedly(Invoke([&](std::function<void()> callback) -> void {
+        std::unique_lock<std::mutex> lock(posted_lock);
+        posted.push_back(callback);
+        posted_event.notify_one();
+      }));
+  auto run_posted = [&]() -> void {
+    std::function<void()> callback;
+    {
+      std::unique_lock<std::mutex> lock(posted_lock);
+      posted_event.wait(lock, [&]() -> bool { return !posted.empty(); });
+      callback = posted.front();
+      posted.pop_front();
+    }
+    callback();
+  };
+
+  setup();
+
+  const std::string response1_json = R"EOF(
+  {
+    "virtual_hosts": [
+    {
+      "name": "local_service",
+      "domains": ["*"],
+      "routes": [
+        {
+          "prefix": "/foo",
+          "cluster": "foo"
+        }
+      ]
+    }
+  ]
+  }
+  )EOF";
+
+  Http::MessagePtr message(new Http::ResponseMessageImpl(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}));
+  message->body().reset(new Buffer::OwnedImpl(response1_json));
+
+  // Initialization finishes once the configuration is published.
+  EXPECT_CALL(init_manager_.initialized_, ready()).Times(0);
+  EXPECT_CALL(*interval_timer_, enableTimer(_));
+  callbacks_->onSuccess(std::move(message));
+  EXPECT_EQ(nullptr, rds_->config()->route(
+                         Http::TestHeaderMapImpl{{":authority", "foo"}, {":path", "/foo"}}, 0));
+
+  EXPECT_CALL(init_manager_.initialized_, ready());
+  run_posted();
+  EXPECT_EQ("foo", rds_->config()
+                       ->route(Http::TestHeaderMapImpl{{":authority", "foo"}, {":path", "/foo"}}, 0)
+                       ->routeEntry()
+                       ->clusterName());
+  EXPECT_EQ(1UL, store_.counter("foo.rds.config_reload").value());
+
+  // Two wildcard virtual hosts do not compile, so the current configuration stays in place.
+  const std::string response2_json = R"EOF(
+  {
+    "virtual_hosts": [
+    {
+      "name": "local_service",
+      "domains": ["*"],
+      "routes": []
+    },
+    {
+      "name": "other_service",
+      "domains": ["*"],
+      "routes": []
+    }
+  ]
+  }
+  )EOF";
+
+  expectRequest();
+  interval_timer_->callback_();
+  message.reset(new Http::ResponseMessageImpl(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}));
+  message->body().reset(new Buffer::OwnedImpl(response2_json));
+  EXPECT_CALL(*interval_timer_, enableTimer(_));
+  callbacks_->onSuccess(std::move(message));
+  run_posted();
+  EXPECT_EQ("foo", rds_->config()
+                       ->route(Http::TestHeaderMapImpl{{":authority", "foo"}, {":path", "/foo"}}, 0)
+                       ->routeEntry()
+                       ->clusterName());
+  EXPECT_EQ(1UL, store_.counter("foo.rds.config_reload").value());
+  EXPECT_EQ(1UL, store_.counter("foo.rds.update_rejected").value());
+}
+
 TEST_F(RdsImplTest, Failure) {
   InSequence s;
 
@@ -478,6 +578,72 @@ TEST_F(RouteConfigProviderManagerImplTest, Basic) {
   EXPECT_EQ(0UL, configured_providers.size());
 }
 
+// Identical static route configurations share one compiled configuration, whose clusters are
+// validated for every provider.
+TEST_F(RouteConfigProviderManagerImplTest, StaticRouteConfigs) {
+  envoy::api::v2::RouteConfiguration route_config;
+  auto* virtual_host = route_config.add_virtual_hosts();
+  virtual_host->set_name("local_service");
+  virtual_host->add_domains("*");
+  auto* route = virtual_host->add_routes();
+  route->mutable_match()->set_prefix("/");
+  route->mutable_route()->set_cluster("foo");
+
+  RouteConfigProviderSharedPtr provider =
+      route_config_provider_manager_.getStaticRouteConfigProvider(route_config, runtime_, cm_);
+  RouteConfigProviderSharedPtr provider2 =
+      route_config_provider_manager_.getStaticRouteConfigProvider(route_config, runtime_, cm_);
+  EXPECT_NE(provider, provider2);
+  EXPECT_EQ(provider->config(), provider2->config());
+  EXPECT_EQ("static", provider2->versionInfo());
+
+  route_config.set_name("other");
+  RouteConfigProviderSharedPtr provider3 =
+      route_config_provider_manager_.getStaticRouteConfigProvider(route_config, runtime_, cm_);
+  EXPECT_NE(provider->config(), provider3->config());
+
+  route_config.clear_name();
+  EXPECT_CALL(cm_, get("foo")).WillOnce(Return(nullptr));
+  EXPECT_THROW_WITH_MESSAGE(
+      route_config_provider_manager_.getStaticRouteConfigProvider(route_config, runtime_, cm_),
+      EnvoyException, "route: unknown cluster 'foo'");
+}
+
+// Static route configurations compiled ahead of time are used by their providers, which still
+// validate the clusters of the configurations.
+TEST_F(RouteConfigProviderManagerImplTest, PrecompileStaticRouteConfigs) {
+  std::vector<envoy::api::v2::RouteConfiguration> route_configs(5);
+  for (size_t i = 0; i < route_configs.size(); i++) {
+    auto* virtual_host = route_configs[i].add_virtual_hosts();
+    virtual_host->set_name("local_service");
+    virtual_host->add_domains("*");
+    auto* route = virtual_host->add_routes();
+    route->mutable_match()->set_prefix("/");
+    route->mutable_route()->set_cluster("foo");
+    route_configs[i].set_name(std::to_string(i % 4));
+  }
+  // The fifth configuration is the same as the first one, and the fourth one is invalid.
+  route_configs[3].mutable_virtual_hosts(0)->add_domains("*");
+
+  EXPECT_CALL(cm_, get(_)).Times(0);
+  std::vector<ConfigConstSharedPtr> configs =
+      route_config_provider_manager_.precompileStaticRouteConfigs(route_configs, runtime_, cm_, 2);
+  EXPECT_EQ(3UL, configs.size());
+  testing::Mock::VerifyAndClearExpectations(&cm_);
+
+  RouteConfigProviderSharedPtr provider =
+      route_config_provider_manager_.getStaticRouteConfigProvider(route_configs[1], runtime_, cm_);
+  EXPECT_EQ(configs[1], provider->config());
+
+  EXPECT_CALL(cm_, get("foo")).WillOnce(Return(nullptr));
+  EXPECT_THROW_WITH_MESSAGE(
+      route_config_provider_manager_.getStaticRouteConfigProvider(route_configs[0], runtime_, cm_),
+      EnvoyException, "route: unknown cluster 'foo'");
+  EXPECT_THROW(
+      route_config_provider_manager_.getStaticRouteConfigProvider(route_configs[3], runtime_, cm_),
+      EnvoyException);
+}
+
 TEST_F(RouteConfigProviderManagerImplTest, onConfigUpdateEmpty) {
   std::string config_json = R"EOF(
     {
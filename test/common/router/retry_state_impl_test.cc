@@ -226,7 +226,7 @@ TEST_F(RouterRetryStateImplTest, RouteConfigNoHeaderConfig) {
 
 TEST_F(RouterRetryStateImplTest, NoAvailableRetries) {
   cluster_.resource_manager_.reset(
-      new Upstream::ResourceManagerImpl(runtime_, "fake_key", 0, 0, 0, 0));
+      new Upstream::ResourceManagerImpl(runtime_, "fake_key", 0, 0, 0, 0, cluster_.stats_store_));
 
   Http::TestHeaderMapImpl request_headers{{"x-envoy-retry-on", "connect-failure"}};
   setup(request_headers);
@@ -236,6 +236,23 @@ TEST_F(RouterRetryStateImplTest, NoAvailableRetries) {
   EXPECT_EQ(1UL, cluster_.stats().upstream_rq_retry_overflow_.value());
 }
 
+TEST_F(RouterRetryStateImplTest, RetryBudgetExhausted) {
+  cluster_.resource_manager_.reset(new Upstream::ResourceManagerImpl(
+      runtime_, "fake_key", 1024, 1024, 1024, 1024, cluster_.stats_store_));
+  ON_CALL(runtime_.snapshot_, getInteger("fake_keyretry_budget_percent", 0))
+      .WillByDefault(Return(20U));
+  ON_CALL(runtime_.snapshot_, getInteger("fake_keyretry_budget_min_concurrency", 3))
+      .WillByDefault(Return(0U));
+
+  Http::TestHeaderMapImpl request_headers{{"x-envoy-retry-on", "connect-failure"}};
+  setup(request_headers);
+  EXPECT_TRUE(state_->enabled());
+
+  EXPECT_EQ(RetryStatus::NoOverflow, state_->shouldRetry(nullptr, connect_failure_, callback_));
+  EXPECT_EQ(1UL, cluster_.stats().upstream_rq_retry_budget_exhausted_.value());
+  EXPECT_EQ(0UL, cluster_.stats().upstream_rq_retry_overflow_.value());
+}
+
 TEST_F(RouterRetryStateImplTest, MaxRetriesHeader) {
   Http::TestHeaderMapImpl request_headers{{"x-envoy-retry-on", "connect-failure"},
                                           {"x-envoy-retry-grpc-on", "cancelled"},
@@ -8,6 +8,7 @@
 #include "common/upstream/upstream_impl.h"
 
 #include "test/common/http/common.h"
+#include "test/mocks/buffer/mocks.h"
 #include "test/mocks/http/mocks.h"
 #include "test/mocks/local_info/mocks.h"
 #include "test/mocks/router/mocks.h"
@@ -20,9 +21,9 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
-using testing::AtLeast;
 using testing::Invoke;
 using testing::NiceMock;
+using testing::Ref;
 using testing::Return;
 using testing::ReturnRef;
 using testing::SaveArg;
@@ -51,7 +52,7 @@ public:
   RouterTest()
       : shadow_writer_(new MockShadowWriter()),
         config_("test.", local_info_, stats_store_, cm_, runtime_, random_,
-                ShadowWriterPtr{shadow_writer_}, true),
+                ShadowWriterPtr{shadow_writer_}, true, 0),
         router_(config_) {
     router_.setDecoderFilterCallbacks(callbacks_);
 
@@ -112,6 +113,25 @@ TEST_F(RouterTest, ClusterNotFound) {
   EXPECT_EQ(1UL, stats_store_.counter("test.no_cluster").value());
 }
 
+TEST_F(RouterTest, ClusterHandle) {
+  Upstream::ClusterHandle handle("fake_cluster");
+  ON_CALL(callbacks_.route_->route_entry_, clusterHandle()).WillByDefault(Return(&handle));
+  EXPECT_CALL(cm_, get(_)).Times(0);
+  EXPECT_CALL(cm_, httpConnPoolForCluster(_, _, _)).Times(0);
+  EXPECT_CALL(cm_, getByHandle(Ref(handle))).WillOnce(Return(&cm_.thread_local_cluster_));
+  EXPECT_CALL(cm_, httpConnPoolForHandle(Ref(handle), _, &router_))
+      .WillOnce(Return(&cm_.conn_pool_));
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _)).WillOnce(Return(&cancellable_));
+  expectResponseTimerCreate();
+
+  Http::TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  router_.decodeHeaders(headers, true);
+
+  EXPECT_CALL(cancellable_, cancel());
+  router_.onDestroy();
+}
+
 TEST_F(RouterTest, PoolFailureWithPriority) {
   ON_CALL(callbacks_.route_->route_entry_, priority())
       .WillByDefault(Return(Upstream::ResourcePriority::High));
@@ -673,6 +693,166 @@ TEST_F(RouterTest, RetryUpstream5xx) {
   response_decoder->decodeHeaders(std::move(response_headers2), true);
 }
 
+TEST_F(RouterTest, HedgedRequestWins) {
+  NiceMock<Http::MockStreamEncoder> encoder1;
+  Http::StreamDecoder* response_decoder1 = nullptr;
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder& decoder, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+        response_decoder1 = &decoder;
+        callbacks.onPoolReady(encoder1, cm_.conn_pool_.host_);
+        return nullptr;
+      }));
+  Event::MockTimer* hedge_timer = new Event::MockTimer(&callbacks_.dispatcher_);
+  EXPECT_CALL(*hedge_timer, enableTimer(std::chrono::milliseconds(5)));
+  expectResponseTimerCreate();
+
+  Http::TestHeaderMapImpl headers{{"x-envoy-upstream-rq-hedge-delay-ms", "5"},
+                                  {"x-envoy-internal", "true"}};
+  HttpTestUtility::addDefaultHeaders(headers);
+  router_.decodeHeaders(headers, true);
+
+  // No response yet, so a second request is sent.
+  NiceMock<Http::MockStreamEncoder> encoder2;
+  Http::StreamDecoder* response_decoder2 = nullptr;
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder& decoder, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+        response_decoder2 = &decoder;
+        callbacks.onPoolReady(encoder2, cm_.conn_pool_.host_);
+        return nullptr;
+      }));
+  hedge_timer->callback_();
+  EXPECT_EQ(1U, cm_.thread_local_cluster_.cluster_.info_->stats_store_.counter("upstream_rq_hedge")
+                    .value());
+
+  // The second request responds first, so the first one is reset.
+  EXPECT_CALL(encoder1.stream_, resetStream(Http::StreamResetReason::LocalReset));
+  EXPECT_CALL(encoder2.stream_, resetStream(_)).Times(0);
+  EXPECT_CALL(*hedge_timer, disableTimer());
+  EXPECT_CALL(cm_.conn_pool_.host_->outlier_detector_, putHttpResponseCode(200));
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, true));
+  Http::HeaderMapPtr response_headers(new Http::TestHeaderMapImpl{{":status", "200"}});
+  response_decoder2->decodeHeaders(std::move(response_headers), true);
+  EXPECT_EQ(1U, cm_.thread_local_cluster_.cluster_.info_->stats_store_
+                    .counter("upstream_rq_hedge_win")
+                    .value());
+}
+
+TEST_F(RouterTest, HedgedRequestLoses) {
+  NiceMock<Http::MockStreamEncoder> encoder1;
+  Http::StreamDecoder* response_decoder1 = nullptr;
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder& decoder, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+        response_decoder1 = &decoder;
+        callbacks.onPoolReady(encoder1, cm_.conn_pool_.host_);
+        return nullptr;
+      }));
+  Event::MockTimer* hedge_timer = new Event::MockTimer(&callbacks_.dispatcher_);
+  EXPECT_CALL(*hedge_timer, enableTimer(std::chrono::milliseconds(5)));
+  expectResponseTimerCreate();
+
+  Http::TestHeaderMapImpl headers{{"x-envoy-upstream-rq-hedge-delay-ms", "5"},
+                                  {"x-envoy-internal", "true"}};
+  HttpTestUtility::addDefaultHeaders(headers);
+  router_.decodeHeaders(headers, true);
+
+  // The second request is still waiting for a connection.
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _)).WillOnce(Return(&cancellable_));
+  hedge_timer->callback_();
+
+  EXPECT_CALL(cancellable_, cancel());
+  EXPECT_CALL(encoder1.stream_, resetStream(_)).Times(0);
+  EXPECT_CALL(*hedge_timer, disableTimer());
+  EXPECT_CALL(cm_.conn_pool_.host_->outlier_detector_, putHttpResponseCode(200));
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, true));
+  Http::HeaderMapPtr response_headers(new Http::TestHeaderMapImpl{{":status", "200"}});
+  response_decoder1->decodeHeaders(std::move(response_headers), true);
+  EXPECT_EQ(0U, cm_.thread_local_cluster_.cluster_.info_->stats_store_
+                    .counter("upstream_rq_hedge_win")
+                    .value());
+}
+
+TEST_F(RouterTest, HedgedRequestFailureDropped) {
+  NiceMock<Http::MockStreamEncoder> encoder1;
+  Http::StreamDecoder* response_decoder1 = nullptr;
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder& decoder, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+        response_decoder1 = &decoder;
+        callbacks.onPoolReady(encoder1, cm_.conn_pool_.host_);
+        return nullptr;
+      }));
+  Event::MockTimer* hedge_timer = new Event::MockTimer(&callbacks_.dispatcher_);
+  EXPECT_CALL(*hedge_timer, enableTimer(std::chrono::milliseconds(5)));
+  expectResponseTimerCreate();
+
+  Http::TestHeaderMapImpl headers{{"x-envoy-upstream-rq-hedge-delay-ms", "5"},
+                                  {"x-envoy-internal", "true"}};
+  HttpTestUtility::addDefaultHeaders(headers);
+  router_.decodeHeaders(headers, true);
+
+  // The failure of the second request does not fail the downstream request.
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder&, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+        callbacks.onPoolFailure(Http::ConnectionPool::PoolFailureReason::ConnectionFailure,
+                                cm_.conn_pool_.host_);
+        return nullptr;
+      }));
+  EXPECT_CALL(cm_.conn_pool_.host_->outlier_detector_, putHttpResponseCode(503));
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, _)).Times(0);
+  hedge_timer->callback_();
+
+  EXPECT_CALL(*hedge_timer, disableTimer());
+  EXPECT_CALL(cm_.conn_pool_.host_->outlier_detector_, putHttpResponseCode(200));
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, true));
+  Http::HeaderMapPtr response_headers(new Http::TestHeaderMapImpl{{":status", "200"}});
+  response_decoder1->decodeHeaders(std::move(response_headers), true);
+}
+
+TEST_F(RouterTest, RetryBufferLimit) {
+  FilterConfig config("test.", local_info_, stats_store_, cm_, runtime_, random_,
+                      ShadowWriterPtr{new MockShadowWriter()}, true, 8);
+  TestFilter router(config);
+  router.setDecoderFilterCallbacks(callbacks_);
+
+  NiceMock<Http::MockStreamEncoder> encoder;
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder&, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+        callbacks.onPoolReady(encoder, cm_.conn_pool_.host_);
+        return nullptr;
+      }));
+
+  Http::TestHeaderMapImpl headers{{"x-envoy-retry-on", "5xx"}, {"x-envoy-internal", "true"}};
+  HttpTestUtility::addDefaultHeaders(headers);
+  router.decodeHeaders(headers, false);
+  EXPECT_CALL(*router.retry_state_, enabled()).WillOnce(Return(true));
+
+  // The body is proxied as it arrives, and kept for a retry while it fits the limit.
+  std::string proxied;
+  EXPECT_CALL(encoder, encodeData(_, false))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](Buffer::Instance& data, bool) -> void {
+        proxied += TestUtility::bufferToString(data);
+        data.drain(data.length());
+      }));
+  Buffer::OwnedImpl data1("1234");
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, router.decodeData(data1, false));
+  callbacks_.buffer_.reset(new Buffer::OwnedImpl("1234"));
+
+  Buffer::OwnedImpl data2("56789");
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationNoBuffer, router.decodeData(data2, false));
+  EXPECT_EQ("123456789", proxied);
+  EXPECT_EQ(1U, cm_.thread_local_cluster_.cluster_.info_->stats_store_
+                    .counter("retry_or_shadow_abandoned")
+                    .value());
+
+  router.onDestroy();
+}
+
 TEST_F(RouterTest, RetryTimeoutDuringRetryDelay) {
   NiceMock<Http::MockStreamEncoder> encoder1;
   Http::StreamDecoder* response_decoder = nullptr;
@@ -880,29 +1060,60 @@ TEST_F(RouterTest, Shadow) {
 
   EXPECT_CALL(runtime_.snapshot_, featureEnabled("bar", 0, 43, 10000)).WillOnce(Return(true));
 
+  // The shadow request is streamed along with the request, so nothing is buffered for it.
+  MockShadowStream* shadow_stream = new MockShadowStream();
+  EXPECT_CALL(*shadow_writer_, streamShadow_("foo", _, false, std::chrono::milliseconds(10)))
+      .WillOnce(Return(shadow_stream));
   Http::TestHeaderMapImpl headers;
   HttpTestUtility::addDefaultHeaders(headers);
   router_.decodeHeaders(headers, false);
 
-  Buffer::InstancePtr body_data(new Buffer::OwnedImpl("hello"));
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, router_.decodeData(*body_data, false));
+  Buffer::OwnedImpl body_data("hello");
+  EXPECT_CALL(*shadow_stream, sendData(BufferStringEqual("hello"), false)).WillOnce(Return(true));
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationNoBuffer, router_.decodeData(body_data, false));
 
   Http::TestHeaderMapImpl trailers{{"some", "trailer"}};
-  EXPECT_CALL(callbacks_, decodingBuffer())
-      .Times(AtLeast(1))
-      .WillRepeatedly(Return(body_data.get()));
-  EXPECT_CALL(*shadow_writer_, shadow_("foo", _, std::chrono::milliseconds(10)))
-      .WillOnce(Invoke(
-          [](const std::string&, Http::MessagePtr& request, std::chrono::milliseconds) -> void {
-            EXPECT_NE(nullptr, request->body());
-            EXPECT_NE(nullptr, request->trailers());
-          }));
+  EXPECT_CALL(*shadow_stream, sendTrailers(HeaderMapEqualRef(&trailers)));
   router_.decodeTrailers(trailers);
 
   Http::HeaderMapPtr response_headers(new Http::TestHeaderMapImpl{{":status", "200"}});
   response_decoder->decodeHeaders(std::move(response_headers), true);
 }
 
+TEST_F(RouterTest, ShadowAbandoned) {
+  callbacks_.route_->route_entry_.shadow_policy_.cluster_ = "foo";
+
+  NiceMock<Http::MockStreamEncoder> encoder;
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder&, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+        callbacks.onPoolReady(encoder, cm_.conn_pool_.host_);
+        return nullptr;
+      }));
+
+  MockShadowStream* shadow_stream = new MockShadowStream();
+  EXPECT_CALL(*shadow_writer_, streamShadow_("foo", _, false, _)).WillOnce(Return(shadow_stream));
+  Http::TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  router_.decodeHeaders(headers, false);
+
+  // The shadow request is dropped, but the request is still proxied.
+  Buffer::OwnedImpl data1("hello");
+  EXPECT_CALL(*shadow_stream, sendData(_, false)).WillOnce(Return(false));
+  EXPECT_CALL(encoder, encodeData(BufferStringEqual("hello"), false));
+  router_.decodeData(data1, false);
+  EXPECT_EQ(1U, cm_.thread_local_cluster_.cluster_.info_->stats_store_
+                    .counter("retry_or_shadow_abandoned")
+                    .value());
+
+  expectResponseTimerCreate();
+  Buffer::OwnedImpl data2("world");
+  EXPECT_CALL(encoder, encodeData(BufferStringEqual("world"), true));
+  router_.decodeData(data2, true);
+
+  router_.onDestroy();
+}
+
 TEST_F(RouterTest, AltStatName) {
   // Also test no upstream timeout here.
   EXPECT_CALL(callbacks_.route_->route_entry_, timeout())
@@ -950,6 +1161,42 @@ TEST_F(RouterTest, AltStatName) {
                     .value());
 }
 
+TEST_F(RouterTest, UpstreamLoadReport) {
+  NiceMock<Http::MockStreamEncoder> encoder;
+  Http::StreamDecoder* response_decoder = nullptr;
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder& decoder, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+        response_decoder = &decoder;
+        callbacks.onPoolReady(encoder, cm_.conn_pool_.host_);
+        return nullptr;
+      }));
+
+  Http::TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  router_.decodeHeaders(headers, true);
+
+  // The load report is passed to the host and is not forwarded downstream.
+  EXPECT_CALL(*cm_.conn_pool_.host_, reportLoad(50));
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, false))
+      .WillOnce(Invoke([](Http::HeaderMap& headers, bool) -> void {
+        EXPECT_EQ(nullptr, headers.EnvoyUpstreamLoad());
+      }));
+  Http::HeaderMapPtr response_headers(
+      new Http::TestHeaderMapImpl{{":status", "200"}, {"x-envoy-upstream-load", "50"}});
+  response_decoder->decodeHeaders(std::move(response_headers), false);
+
+  // Reports in the trailers are clamped to 100.
+  EXPECT_CALL(*cm_.conn_pool_.host_, reportLoad(100));
+  EXPECT_CALL(callbacks_, encodeTrailers_(_))
+      .WillOnce(Invoke([](Http::HeaderMap& trailers) -> void {
+        EXPECT_EQ(nullptr, trailers.EnvoyUpstreamLoad());
+      }));
+  Http::HeaderMapPtr response_trailers(
+      new Http::TestHeaderMapImpl{{"x-envoy-upstream-load", "250"}});
+  response_decoder->decodeTrailers(std::move(response_trailers));
+}
+
 TEST_F(RouterTest, Redirect) {
   MockRedirectEntry redirect;
   EXPECT_CALL(redirect, newPath(_)).WillOnce(Return("hello"));
@@ -1040,6 +1287,22 @@ TEST(RouterFilterUtilityTest, finalTimeout) {
     EXPECT_FALSE(headers.has("x-envoy-upstream-rq-per-try-timeout-ms"));
     EXPECT_EQ("5", headers.get_("x-envoy-expected-rq-timeout-ms"));
   }
+  {
+    NiceMock<MockRouteEntry> route;
+    EXPECT_CALL(route, timeout()).WillOnce(Return(std::chrono::milliseconds(10)));
+    Http::TestHeaderMapImpl headers{{"x-envoy-upstream-rq-hedge-delay-ms", "5"}};
+    FilterUtility::TimeoutData timeout = FilterUtility::finalTimeout(route, headers);
+    EXPECT_EQ(std::chrono::milliseconds(5), timeout.hedge_delay_);
+    EXPECT_FALSE(headers.has("x-envoy-upstream-rq-hedge-delay-ms"));
+  }
+  {
+    NiceMock<MockRouteEntry> route;
+    EXPECT_CALL(route, timeout()).WillOnce(Return(std::chrono::milliseconds(10)));
+    Http::TestHeaderMapImpl headers{{"x-envoy-upstream-rq-hedge-delay-ms", "10"}};
+    FilterUtility::TimeoutData timeout = FilterUtility::finalTimeout(route, headers);
+    EXPECT_EQ(std::chrono::milliseconds(0), timeout.hedge_delay_);
+    EXPECT_FALSE(headers.has("x-envoy-upstream-rq-hedge-delay-ms"));
+  }
 }
 
 TEST(RouterFilterUtilityTest, setUpstreamScheme) {
@@ -1341,6 +1604,38 @@ TEST_F(WatermarkTest, FilterWatermarks) {
   sendResponse();
 } // namespace Router
 
+// A route's per request buffer limit replaces the limit of the connection for the stream and for
+// the upstream request.
+TEST_F(WatermarkTest, RouteBufferLimit) {
+  EXPECT_CALL(callbacks_, decoderBufferLimit()).WillOnce(Return(1024));
+  router_.setDecoderFilterCallbacks(callbacks_);
+  EXPECT_CALL(callbacks_.route_->route_entry_, perRequestBufferLimit())
+      .WillOnce(Return(Optional<uint32_t>(10)));
+  EXPECT_CALL(callbacks_, setDecoderBufferLimit(10));
+  sendRequest(false, false);
+
+  Buffer::OwnedImpl data("1234567890");
+  router_.decodeData(data, false);
+  EXPECT_EQ(0U, cm_.thread_local_cluster_.cluster_.info_->stats_store_
+                    .counter("upstream_flow_control_backed_up_total")
+                    .value());
+
+  Buffer::OwnedImpl last_byte("!");
+  router_.decodeData(last_byte, true);
+  EXPECT_EQ(1U, cm_.thread_local_cluster_.cluster_.info_->stats_store_
+                    .counter("upstream_flow_control_backed_up_total")
+                    .value());
+
+  EXPECT_CALL(encoder_, encodeData(_, true))
+      .WillOnce(Invoke([&](Buffer::Instance& data, bool) -> void { data.drain(data.length()); }));
+  pool_callbacks_->onPoolReady(encoder_, cm_.conn_pool_.host_);
+  EXPECT_EQ(1U, cm_.thread_local_cluster_.cluster_.info_->stats_store_
+                    .counter("upstream_flow_control_drained_total")
+                    .value());
+
+  sendResponse();
+}
+
 // Same as RetryRequestNotComplete but with decodeData larger than the buffer
 // limit, no retry will occur.
 TEST_F(WatermarkTest, RetryRequestNotComplete) {
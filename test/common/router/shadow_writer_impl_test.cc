@@ -1,16 +1,24 @@
 #include <chrono>
 #include <string>
 
+#include "common/buffer/buffer_impl.h"
+#include "common/http/header_map_impl.h"
 #include "common/http/headers.h"
 #include "common/http/message_impl.h"
 #include "common/router/shadow_writer_impl.h"
 
+#include "test/mocks/buffer/mocks.h"
+#include "test/mocks/http/mocks.h"
 #include "test/mocks/upstream/mocks.h"
+#include "test/test_common/utility.h"
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+using testing::DoAll;
 using testing::Invoke;
+using testing::Return;
+using testing::SaveArg;
 using testing::_;
 
 namespace Envoy {
@@ -18,7 +26,7 @@ namespace Router {
 
 TEST(ShadowWriterImplTest, All) {
   Upstream::MockClusterManager cm;
-  ShadowWriterImpl writer(cm);
+  ShadowWriterImpl writer(cm, 0);
 
   // Success case
   Http::MessagePtr message(new Http::RequestMessageImpl());
@@ -59,5 +67,132 @@ TEST(ShadowWriterImplTest, All) {
   callback->onFailure(Http::AsyncClient::FailureReason::Reset);
 }
 
+class ShadowWriterImplStreamTest : public testing::Test {
+public:
+  ShadowStreamPtr startShadow(ShadowWriterImpl& writer, Http::MockAsyncClientStream& stream) {
+    EXPECT_CALL(cm_, httpAsyncClientForCluster("foo")).WillOnce(ReturnRef(cm_.async_client_));
+    EXPECT_CALL(cm_.async_client_,
+                start(_, Optional<std::chrono::milliseconds>(std::chrono::milliseconds(5))))
+        .WillOnce(DoAll(SaveArg<0>(&callbacks_), Return(&stream)));
+    EXPECT_CALL(stream, sendHeaders(_, false))
+        .WillOnce(Invoke([](Http::HeaderMap& headers, bool) -> void {
+          EXPECT_STREQ("cluster1-shadow", headers.Host()->value().c_str());
+        }));
+    return writer.streamShadow("foo", headers_, false, std::chrono::milliseconds(5));
+  }
+
+  Upstream::MockClusterManager cm_;
+  Http::TestHeaderMapImpl headers_{{":authority", "cluster1"}};
+  Http::AsyncClient::StreamCallbacks* callbacks_{};
+};
+
+TEST_F(ShadowWriterImplStreamTest, FireAndForget) {
+  ShadowWriterImpl writer(cm_, 0);
+  Http::MockAsyncClientStream stream;
+  ShadowStreamPtr shadow_stream = startShadow(writer, stream);
+  ASSERT_NE(nullptr, shadow_stream);
+  EXPECT_STREQ("cluster1", headers_.Host()->value().c_str());
+
+  // The data is shared rather than drained, so the caller can still proxy it.
+  Buffer::OwnedImpl data("hello");
+  EXPECT_CALL(stream, sendData(BufferStringEqual("hello"), false));
+  EXPECT_TRUE(shadow_stream->sendData(data, false));
+  EXPECT_EQ(5U, data.length());
+  EXPECT_EQ(5U, writer.bytesInFlight());
+
+  Http::TestHeaderMapImpl trailers{{"some", "trailer"}};
+  EXPECT_CALL(stream, sendTrailers(HeaderMapEqualRef(&trailers)));
+  shadow_stream->sendTrailers(trailers);
+
+  // The request is complete, so the shadow request outlives the stream handle.
+  EXPECT_CALL(stream, reset()).Times(0);
+  shadow_stream.reset();
+  EXPECT_EQ(5U, writer.bytesInFlight());
+
+  EXPECT_CALL(cm_.async_client_.dispatcher_, deferredDelete_(_));
+  callbacks_->onHeaders(Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}},
+                        true);
+  cm_.async_client_.dispatcher_.to_delete_.clear();
+  EXPECT_EQ(0U, writer.bytesInFlight());
+}
+
+TEST_F(ShadowWriterImplStreamTest, ResetIncompleteRequest) {
+  ShadowWriterImpl writer(cm_, 0);
+  Http::MockAsyncClientStream stream;
+  ShadowStreamPtr shadow_stream = startShadow(writer, stream);
+
+  Buffer::OwnedImpl data("hello");
+  EXPECT_CALL(stream, sendData(_, false));
+  EXPECT_TRUE(shadow_stream->sendData(data, false));
+
+  EXPECT_CALL(stream, reset()).WillOnce(Invoke([&]() -> void { callbacks_->onReset(); }));
+  shadow_stream.reset();
+  EXPECT_EQ(0U, writer.bytesInFlight());
+}
+
+TEST_F(ShadowWriterImplStreamTest, EarlyResponse) {
+  ShadowWriterImpl writer(cm_, 0);
+  Http::MockAsyncClientStream stream;
+  ShadowStreamPtr shadow_stream = startShadow(writer, stream);
+
+  // Once the shadow cluster responded, the rest of the request is not sent.
+  callbacks_->onHeaders(Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "400"}}},
+                        true);
+  Buffer::OwnedImpl data("hello");
+  EXPECT_CALL(stream, sendData(_, _)).Times(0);
+  EXPECT_CALL(stream, reset()).WillOnce(Invoke([&]() -> void { callbacks_->onReset(); }));
+  EXPECT_TRUE(shadow_stream->sendData(data, true));
+  shadow_stream.reset();
+}
+
+TEST_F(ShadowWriterImplStreamTest, BytesInFlightLimit) {
+  ShadowWriterImpl writer(cm_, 8);
+  Http::MockAsyncClientStream stream1;
+  ShadowStreamPtr shadow_stream1 = startShadow(writer, stream1);
+  Buffer::OwnedImpl data1("hello");
+  EXPECT_CALL(stream1, sendData(_, false));
+  EXPECT_TRUE(shadow_stream1->sendData(data1, false));
+
+  Http::MockAsyncClientStream stream2;
+  ShadowStreamPtr shadow_stream2 = startShadow(writer, stream2);
+  Buffer::OwnedImpl data2("world");
+  EXPECT_CALL(stream2, sendData(_, _)).Times(0);
+  EXPECT_CALL(stream2, reset());
+  EXPECT_FALSE(shadow_stream2->sendData(data2, false));
+  shadow_stream2.reset();
+  EXPECT_EQ(5U, writer.bytesInFlight());
+
+  EXPECT_CALL(stream1, reset());
+  shadow_stream1.reset();
+  EXPECT_EQ(0U, writer.bytesInFlight());
+}
+
+TEST_F(ShadowWriterImplStreamTest, HeaderOnly) {
+  ShadowWriterImpl writer(cm_, 0);
+  Http::MockAsyncClientStream stream;
+  EXPECT_CALL(cm_, httpAsyncClientForCluster("foo")).WillOnce(ReturnRef(cm_.async_client_));
+  EXPECT_CALL(cm_.async_client_, start(_, _))
+      .WillOnce(DoAll(SaveArg<0>(&callbacks_), Return(&stream)));
+  EXPECT_CALL(stream, sendHeaders(_, true));
+  EXPECT_EQ(nullptr, writer.streamShadow("foo", headers_, true, std::chrono::milliseconds(5)));
+
+  EXPECT_CALL(cm_.async_client_.dispatcher_, deferredDelete_(_));
+  callbacks_->onReset();
+  cm_.async_client_.dispatcher_.to_delete_.clear();
+}
+
+TEST_F(ShadowWriterImplStreamTest, StartFailure) {
+  ShadowWriterImpl writer(cm_, 0);
+  EXPECT_CALL(cm_, httpAsyncClientForCluster("foo")).WillOnce(ReturnRef(cm_.async_client_));
+  EXPECT_CALL(cm_.async_client_, start(_, _))
+      .WillOnce(Invoke(
+          [](Http::AsyncClient::StreamCallbacks& callbacks,
+             const Optional<std::chrono::milliseconds>&) -> Http::AsyncClient::Stream* {
+            callbacks.onReset();
+            return nullptr;
+          }));
+  EXPECT_EQ(nullptr, writer.streamShadow("foo", headers_, false, std::chrono::milliseconds(5)));
+}
+
 } // namespace Router
 } // namespace Envoy
@@ -1,4 +1,5 @@
 #include <memory>
+#include <set>
 #include <string>
 
 #include "common/runtime/runtime_impl.h"
@@ -16,6 +17,8 @@
 using testing::NiceMock;
 using testing::Return;
 using testing::ReturnNew;
+using testing::SaveArg;
+using testing::_;
 
 namespace Envoy {
 namespace Runtime {
@@ -41,6 +44,39 @@ TEST(UUID, sanityCheckOfUniqueness) {
   EXPECT_EQ(num_of_uuids, uuids.size());
 }
 
+TEST(UUID, writeToBuffer) {
+  RandomGeneratorImpl random;
+
+  // Only the uuid is written.
+  char buffer[RandomGenerator::UUID_LENGTH + 1];
+  buffer[RandomGenerator::UUID_LENGTH] = 'x';
+  random.uuid(buffer);
+  EXPECT_EQ('x', buffer[RandomGenerator::UUID_LENGTH]);
+
+  const std::string uuid(buffer, RandomGenerator::UUID_LENGTH);
+  EXPECT_EQ('-', uuid[8]);
+  EXPECT_EQ('4', uuid[14]);
+  EXPECT_EQ(std::string::npos, uuid.find_first_not_of("0123456789abcdef-"));
+}
+
+TEST(Random, sanityCheckOfUniqueness) {
+  std::set<uint64_t> values;
+  const size_t num_of_values = 100000;
+
+  RandomGeneratorImpl random;
+  uint64_t low_bits = 0;
+  for (size_t i = 0; i < num_of_values; ++i) {
+    const uint64_t value = random.random();
+    values.insert(value);
+    low_bits += value % 2;
+  }
+
+  EXPECT_EQ(num_of_values, values.size());
+  // Roughly half of the values are odd.
+  EXPECT_LT(num_of_values * 45 / 100, low_bits);
+  EXPECT_GT(num_of_values * 55 / 100, low_bits);
+}
+
 class RuntimeImplTest : public testing::Test {
 public:
   static void SetUpTestCase() {
@@ -48,12 +84,13 @@ public:
         {TestEnvironment::runfilesPath("test/common/runtime/filesystem_setup.sh")});
   }
 
-  void setup(const std::string& primary_dir, const std::string& override_dir) {
+  void setup(const std::string& primary_dir, const std::string& override_dir,
+             const std::string& subdir = "envoy") {
     EXPECT_CALL(dispatcher, createFilesystemWatcher_())
         .WillOnce(ReturnNew<NiceMock<Filesystem::MockWatcher>>());
 
     loader.reset(new LoaderImpl(dispatcher, tls, TestEnvironment::temporaryPath(primary_dir),
-                                "envoy", override_dir, store, generator));
+                                subdir, override_dir, store, generator));
   }
 
   Event::MockDispatcher dispatcher;
@@ -96,6 +133,108 @@ TEST_F(RuntimeImplTest, All) {
   EXPECT_EQ("hello override", loader->snapshot().get("file1"));
 }
 
+TEST_F(RuntimeImplTest, PrehashedKeys) {
+  setup("test/common/runtime/test_data/current", "envoy_override");
+
+  EXPECT_EQ("world", loader->snapshot().get(Key("file2")));
+  EXPECT_EQ("", loader->snapshot().get(Key("invalid")));
+  EXPECT_EQ(2UL, loader->snapshot().getInteger(Key("file3"), 1));
+  EXPECT_EQ(1UL, loader->snapshot().getInteger(Key("invalid"), 1));
+  EXPECT_EQ("hello override", loader->snapshot().get(Key("file1")));
+
+  EXPECT_CALL(generator, random()).WillOnce(Return(1));
+  EXPECT_TRUE(loader->snapshot().featureEnabled(Key("file3"), 1));
+  EXPECT_FALSE(loader->snapshot().featureEnabled(Key("file3"), 1, 3));
+  EXPECT_TRUE(loader->snapshot().featureEnabled(Key("file4"), 1, 122, 300));
+}
+
+TEST_F(RuntimeImplTest, IndexFile) {
+  setup("test/common/runtime/test_data/current", "envoy_override", "envoy_index");
+
+  EXPECT_EQ("world", loader->snapshot().get("file2"));
+  EXPECT_EQ("hello\nworld", loader->snapshot().get(Key("subdir.file3")));
+  EXPECT_EQ("a\\b", loader->snapshot().get("backslash"));
+  EXPECT_EQ("", loader->snapshot().get("empty"));
+  EXPECT_EQ(2UL, loader->snapshot().getInteger("file3", 1));
+
+  // The override directory still applies on top of the index.
+  EXPECT_EQ("hello override", loader->snapshot().get("file1"));
+  EXPECT_EQ(6UL, store.gauge("runtime.num_keys").value());
+  EXPECT_EQ(1UL, store.counter("runtime.load_success").value());
+}
+
+TEST_F(RuntimeImplTest, InvalidIndexFile) {
+  setup("test/common/runtime/test_data/current", "envoy_override_does_not_exist",
+        "envoy_index_invalid");
+
+  // Entries before the invalid line are kept.
+  EXPECT_EQ("hello", loader->snapshot().get("file1"));
+  EXPECT_EQ(1UL, store.counter("runtime.load_error").value());
+}
+
+TEST_F(RuntimeImplTest, FeatureHandles) {
+  NiceMock<Filesystem::MockWatcher>* watcher = new NiceMock<Filesystem::MockWatcher>();
+  Filesystem::Watcher::OnChangedCb on_changed;
+  EXPECT_CALL(dispatcher, createFilesystemWatcher_()).WillOnce(Return(watcher));
+  EXPECT_CALL(*watcher, addWatch(_, _, _)).WillOnce(SaveArg<2>(&on_changed));
+  const std::string root = TestEnvironment::temporaryPath("test/common/runtime/test_data/current");
+  loader.reset(
+      new LoaderImpl(dispatcher, tls, root, "envoy", "envoy_override", store, generator));
+
+  // Handles created after the snapshot look the key up.
+  FeatureHandleSharedPtr file3 = loader->featureHandle("file3");
+  FeatureHandleSharedPtr invalid = loader->featureHandle("invalid");
+  EXPECT_EQ(file3, loader->featureHandle("file3"));
+  EXPECT_EQ("file3", file3->key());
+  EXPECT_EQ(2UL, file3->getInteger(1));
+  EXPECT_EQ(1UL, invalid->getInteger(1));
+
+  // The next snapshot resolves the handles when it is created.
+  on_changed(Filesystem::Watcher::Events::MovedTo);
+  EXPECT_EQ(2UL, file3->getInteger(1));
+  EXPECT_EQ(1UL, invalid->getInteger(1));
+  EXPECT_EQ(123UL, loader->featureHandle("file4")->getInteger(1));
+
+  EXPECT_CALL(generator, random()).WillOnce(Return(1));
+  EXPECT_TRUE(file3->featureEnabled(1));
+  EXPECT_FALSE(file3->featureEnabled(1, 3));
+  EXPECT_FALSE(invalid->featureEnabled(0));
+}
+
+TEST_F(RuntimeImplTest, MergeValues) {
+  NiceMock<Filesystem::MockWatcher>* watcher = new NiceMock<Filesystem::MockWatcher>();
+  Filesystem::Watcher::OnChangedCb on_changed;
+  EXPECT_CALL(dispatcher, createFilesystemWatcher_()).WillOnce(Return(watcher));
+  EXPECT_CALL(*watcher, addWatch(_, _, _)).WillOnce(SaveArg<2>(&on_changed));
+  const std::string root = TestEnvironment::temporaryPath("test/common/runtime/test_data/current");
+  loader.reset(
+      new LoaderImpl(dispatcher, tls, root, "envoy", "envoy_override", store, generator));
+  FeatureHandleSharedPtr file3 = loader->featureHandle("file3");
+  const uint64_t disk_keys = store.gauge("runtime.num_keys").value();
+
+  // Merged values take precedence over both the directory and the override directory.
+  loader->mergeValues({{"file1", "hello admin"}, {"file3", "5"}, {"new_key", "7"}});
+  EXPECT_EQ("hello admin", loader->snapshot().get("file1"));
+  EXPECT_EQ(5UL, file3->getInteger(1));
+  EXPECT_EQ(7UL, loader->snapshot().getInteger(Key("new_key"), 1));
+  EXPECT_EQ("world", loader->snapshot().get("file2"));
+  EXPECT_EQ(disk_keys + 1, store.gauge("runtime.num_keys").value());
+  EXPECT_EQ(3UL, store.gauge("runtime.admin_overrides_active").value());
+
+  // Merged values survive a reload of the directory.
+  on_changed(Filesystem::Watcher::Events::MovedTo);
+  EXPECT_EQ("hello admin", loader->snapshot().get("file1"));
+  EXPECT_EQ(5UL, file3->getInteger(1));
+
+  // An empty value removes the merged value, uncovering the one from disk.
+  loader->mergeValues({{"file1", ""}, {"new_key", ""}, {"not_merged", ""}});
+  EXPECT_EQ("hello override", loader->snapshot().get("file1"));
+  EXPECT_EQ("", loader->snapshot().get("new_key"));
+  EXPECT_EQ(5UL, file3->getInteger(1));
+  EXPECT_EQ(disk_keys, store.gauge("runtime.num_keys").value());
+  EXPECT_EQ(1UL, store.gauge("runtime.admin_overrides_active").value());
+}
+
 TEST_F(RuntimeImplTest, BadDirectory) { setup("/baddir", "/baddir"); }
 
 TEST_F(RuntimeImplTest, OverrideFolderDoesNotExist) {
@@ -111,6 +250,15 @@ TEST(NullRuntimeImplTest, All) {
   EXPECT_EQ(1UL, loader.snapshot().getInteger("foo", 1));
   EXPECT_CALL(generator, random()).WillOnce(Return(49));
   EXPECT_TRUE(loader.snapshot().featureEnabled("foo", 50));
+  EXPECT_EQ("", loader.snapshot().get(Key("foo")));
+  EXPECT_EQ(1UL, loader.snapshot().getInteger(Key("foo"), 1));
+  EXPECT_TRUE(loader.snapshot().featureEnabled(Key("foo"), 50, 49));
+
+  FeatureHandleSharedPtr handle = loader.featureHandle("foo");
+  EXPECT_EQ(1UL, handle->getInteger(1));
+  EXPECT_FALSE(handle->featureEnabled(50, 50));
+
+  EXPECT_THROW(loader.mergeValues({{"foo", "bar"}}), EnvoyException);
 }
 
 } // namespace Runtime
@@ -3,6 +3,8 @@
 #include <string>
 
 #include "common/buffer/buffer_impl.h"
+#include "common/common/hex.h"
+#include "common/config/tls_context_json.h"
 #include "common/event/dispatcher_impl.h"
 #include "common/json/json_loader.h"
 #include "common/network/address_impl.h"
@@ -11,6 +13,7 @@
 #include "common/ssl/connection_impl.h"
 #include "common/ssl/context_config_impl.h"
 #include "common/ssl/context_impl.h"
+#include "common/ssl/private_key_operation_impl.h"
 #include "common/stats/stats_impl.h"
 
 #include "test/common/ssl/ssl_certs_test.h"
@@ -39,13 +42,14 @@ namespace {
 void testUtil(const std::string& client_ctx_json, const std::string& server_ctx_json,
               const std::string& expected_digest, const std::string& expected_uri,
               const std::string& expected_stats, bool expect_success,
-              const Network::Address::IpVersion version) {
+              const Network::Address::IpVersion version,
+              PrivateKeyOperationProviderSharedPtr private_key_provider = nullptr) {
   Stats::IsolatedStoreImpl stats_store;
   Runtime::MockLoader runtime;
 
   Json::ObjectSharedPtr server_ctx_loader = TestEnvironment::jsonLoadFromString(server_ctx_json);
   ServerContextConfigImpl server_ctx_config(*server_ctx_loader);
-  ContextManagerImpl manager(runtime);
+  ContextManagerImpl manager(runtime, private_key_provider);
   ServerContextPtr server_ctx(manager.createSslServerContext(stats_store, server_ctx_config));
 
   Event::DispatcherImpl dispatcher;
@@ -76,8 +80,13 @@ void testUtil(const std::string& client_ctx_json, const std::string& server_ctx_
         .WillOnce(Invoke([&](Network::ConnectionEvent) -> void {
           if (!expected_digest.empty()) {
             EXPECT_EQ(expected_digest, server_connection->ssl()->sha256PeerCertificateDigest());
+            Sha256Digest raw_digest;
+            EXPECT_TRUE(server_connection->ssl()->rawSha256PeerCertificateDigest(raw_digest));
+            EXPECT_EQ(expected_digest, Hex::encode(raw_digest.data(), raw_digest.size()));
           }
           EXPECT_EQ(expected_uri, server_connection->ssl()->uriSanPeerCertificate());
+          // The fields are cached once the handshake is complete.
+          EXPECT_EQ(expected_uri, server_connection->ssl()->uriSanPeerCertificate());
           server_connection->close(Network::ConnectionCloseType::NoFlush);
           client_connection->close(Network::ConnectionCloseType::NoFlush);
           dispatcher.exit();
@@ -168,6 +177,48 @@ TEST_P(SslConnectionImplTest, GetNoUriWithDnsSan) {
   testUtil(client_ctx_json, server_ctx_json, "", "", "ssl.handshake", true, GetParam());
 }
 
+TEST_P(SslConnectionImplTest, PrivateKeyOperationOffloaded) {
+  std::string client_ctx_json = R"EOF(
+  {
+    "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/san_uri_cert.pem",
+    "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/san_uri_key.pem"
+  }
+  )EOF";
+
+  std::string server_ctx_json = R"EOF(
+  {
+    "cert_chain_file": "{{ test_tmpdir }}/unittestcert.pem",
+    "private_key_file": "{{ test_tmpdir }}/unittestkey.pem",
+    "ca_cert_file": "{{ test_rundir }}/test/common/ssl/test_data/ca_cert.pem"
+  }
+  )EOF";
+
+  testUtil(client_ctx_json, server_ctx_json, "", "spiffe://lyft.com/test-team", "ssl.handshake",
+           true, GetParam(), std::make_shared<ThreadPoolPrivateKeyOperationProvider>(2));
+}
+
+// A cipher suite with RSA key exchange makes the server decrypt instead of sign.
+TEST_P(SslConnectionImplTest, PrivateKeyDecryptOffloaded) {
+  std::string client_ctx_json = R"EOF(
+  {
+    "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/san_uri_cert.pem",
+    "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/san_uri_key.pem",
+    "cipher_suites": "AES128-SHA"
+  }
+  )EOF";
+
+  std::string server_ctx_json = R"EOF(
+  {
+    "cert_chain_file": "{{ test_tmpdir }}/unittestcert.pem",
+    "private_key_file": "{{ test_tmpdir }}/unittestkey.pem",
+    "ca_cert_file": "{{ test_rundir }}/test/common/ssl/test_data/ca_cert.pem"
+  }
+  )EOF";
+
+  testUtil(client_ctx_json, server_ctx_json, "", "spiffe://lyft.com/test-team", "ssl.handshake",
+           true, GetParam(), std::make_shared<ThreadPoolPrivateKeyOperationProvider>(1));
+}
+
 TEST_P(SslConnectionImplTest, NoCert) {
   std::string client_ctx_json = R"EOF(
   {
@@ -379,6 +430,73 @@ TEST_P(SslConnectionImplTest, ClientAuthMultipleCAs) {
   EXPECT_EQ(1UL, stats_store.counter("ssl.handshake").value());
 }
 
+TEST_P(SslConnectionImplTest, ClientSessionResumption) {
+  Stats::IsolatedStoreImpl server_stats_store;
+  Stats::IsolatedStoreImpl client_stats_store;
+  Runtime::MockLoader runtime;
+
+  std::string server_ctx_json = R"EOF(
+  {
+    "cert_chain_file": "{{ test_tmpdir }}/unittestcert.pem",
+    "private_key_file": "{{ test_tmpdir }}/unittestkey.pem"
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr server_ctx_loader = TestEnvironment::jsonLoadFromString(server_ctx_json);
+  ServerContextConfigImpl server_ctx_config(*server_ctx_loader);
+  ContextManagerImpl manager(runtime);
+  ServerContextPtr server_ctx(
+      manager.createSslServerContext(server_stats_store, server_ctx_config));
+
+  Event::DispatcherImpl dispatcher;
+  Network::TcpListenSocket socket(Network::Test::getCanonicalLoopbackAddress(GetParam()), true);
+  Network::MockListenerCallbacks callbacks;
+  Network::MockConnectionHandler connection_handler;
+  Network::ListenerPtr listener = dispatcher.createSslListener(
+      connection_handler, *server_ctx, socket, callbacks, server_stats_store,
+      Network::ListenerOptions::listenerOptionsWithBindToPort());
+
+  Json::ObjectSharedPtr client_ctx_loader = TestEnvironment::jsonLoadFromString("{}");
+  ClientContextConfigImpl client_ctx_config(*client_ctx_loader, 1);
+  ClientContextPtr client_ctx(
+      manager.createSslClientContext(client_stats_store, client_ctx_config));
+
+  // Each connection is closed once its handshake is complete.
+  auto connect = [&]() -> void {
+    Network::ClientConnectionPtr client_connection = dispatcher.createSslClientConnection(
+        *client_ctx, socket.localAddress(), Network::Address::InstanceConstSharedPtr());
+    client_connection->connect();
+
+    Network::ConnectionPtr server_connection;
+    Network::MockConnectionCallbacks server_connection_callbacks;
+    EXPECT_CALL(callbacks, onNewConnection_(_))
+        .WillOnce(Invoke([&](Network::ConnectionPtr& conn) -> void {
+          server_connection = std::move(conn);
+          server_connection->addConnectionCallbacks(server_connection_callbacks);
+        }));
+    EXPECT_CALL(server_connection_callbacks, onEvent(Network::ConnectionEvent::Connected))
+        .WillOnce(Invoke([&](Network::ConnectionEvent) -> void {
+          server_connection->close(Network::ConnectionCloseType::NoFlush);
+          client_connection->close(Network::ConnectionCloseType::NoFlush);
+          dispatcher.exit();
+        }));
+    EXPECT_CALL(server_connection_callbacks, onEvent(Network::ConnectionEvent::LocalClose));
+
+    dispatcher.run(Event::Dispatcher::RunType::Block);
+  };
+
+  connect();
+  EXPECT_EQ(1UL, client_stats_store.counter("ssl.session_cache_miss").value());
+  EXPECT_EQ(0UL, client_stats_store.counter("ssl.session_reused").value());
+
+  // The second connection to the server resumes the session of the first.
+  connect();
+  EXPECT_EQ(1UL, client_stats_store.counter("ssl.session_cache_hit").value());
+  EXPECT_EQ(1UL, client_stats_store.counter("ssl.session_reused").value());
+  EXPECT_EQ(1UL, server_stats_store.counter("ssl.session_reused").value());
+  EXPECT_EQ(2UL, client_stats_store.counter("ssl.handshake").value());
+}
+
 TEST_P(SslConnectionImplTest, SslError) {
   Stats::IsolatedStoreImpl stats_store;
   Runtime::MockLoader runtime;
@@ -435,7 +553,10 @@ class SslReadBufferLimitTest : public SslCertsTest,
 public:
   void initialize(uint32_t read_buffer_limit) {
     server_ctx_loader_ = TestEnvironment::jsonLoadFromString(server_ctx_json_);
-    server_ctx_config_.reset(new ServerContextConfigImpl(*server_ctx_loader_));
+    envoy::api::v2::DownstreamTlsContext server_tls_context;
+    Config::TlsContextJson::translateDownstreamTlsContext(*server_ctx_loader_, server_tls_context);
+    server_ctx_config_.reset(
+        new ServerContextConfigImpl(server_tls_context, record_sizing_, kernel_tls_));
     manager_.reset(new ContextManagerImpl(runtime_));
     server_ctx_ = manager_->createSslServerContext(stats_store_, *server_ctx_config_);
 
@@ -444,7 +565,8 @@ public:
         {.bind_to_port_ = true,
          .use_proxy_proto_ = false,
          .use_original_dst_ = false,
-         .per_connection_buffer_limit_bytes_ = read_buffer_limit});
+         .per_connection_buffer_limit_bytes_ = read_buffer_limit,
+         .max_accepts_per_event_ = 0});
 
     client_ctx_loader_ = TestEnvironment::jsonLoadFromString(client_ctx_json_);
     client_ctx_config_.reset(new ClientContextConfigImpl(*client_ctx_loader_));
@@ -596,6 +718,8 @@ public:
     }
   )EOF";
   Runtime::MockLoader runtime_;
+  DynamicRecordSizing record_sizing_;
+  bool kernel_tls_{};
   Json::ObjectSharedPtr server_ctx_loader_;
   std::unique_ptr<ServerContextConfigImpl> server_ctx_config_;
   std::unique_ptr<ContextManagerImpl> manager_;
@@ -633,6 +757,126 @@ TEST_P(SslReadBufferLimitTest, WritesSmallerThanBufferLimit) { singleWriteTest(5
 
 TEST_P(SslReadBufferLimitTest, WritesLargerThanBufferLimit) { singleWriteTest(1024, 5 * 1024); }
 
+TEST_P(SslReadBufferLimitTest, DynamicRecordSizing) {
+  record_sizing_.initial_record_size_ = 1024;
+  record_sizing_.ramp_bytes_ = 4096;
+  initialize(0);
+
+  EXPECT_CALL(listener_callbacks_, onNewConnection_(_))
+      .WillOnce(Invoke([&](Network::ConnectionPtr& conn) -> void {
+        server_connection_ = std::move(conn);
+        server_connection_->addConnectionCallbacks(server_callbacks_);
+      }));
+  EXPECT_CALL(client_callbacks_, onEvent(Network::ConnectionEvent::Connected))
+      .WillOnce(Invoke([&](Network::ConnectionEvent) -> void { dispatcher_->exit(); }));
+  dispatcher_->run(Event::Dispatcher::RunType::Block);
+
+  // The server writes small records until it has written the ramp, then full ones.
+  const uint32_t write_size = 64 * 1024;
+  uint32_t client_seen = 0;
+  client_connection_->addReadFilter(read_filter_);
+  EXPECT_CALL(*read_filter_, onNewConnection());
+  EXPECT_CALL(*read_filter_, onData(_))
+      .WillRepeatedly(Invoke([&](Buffer::Instance& data) -> Network::FilterStatus {
+        client_seen += data.length();
+        data.drain(data.length());
+        if (client_seen == write_size) {
+          dispatcher_->exit();
+        }
+        return Network::FilterStatus::StopIteration;
+      }));
+  Buffer::OwnedImpl data(std::string(write_size, 'a'));
+  server_connection_->write(data);
+  dispatcher_->run(Event::Dispatcher::RunType::Block);
+
+  EXPECT_LE(4UL, stats_store_.counter("ssl.small_record").value());
+  EXPECT_GT(write_size / 1024, stats_store_.counter("ssl.small_record").value());
+  EXPECT_EQ(1UL, stats_store_.counter("ssl.record_size_ramped").value());
+
+  disconnect();
+}
+
+// The kernel may not support TLS, so the connection must work either way.
+TEST_P(SslReadBufferLimitTest, KernelTls) {
+  kernel_tls_ = true;
+  initialize(0);
+
+  std::shared_ptr<Network::MockReadFilter> server_read_filter(new Network::MockReadFilter());
+  EXPECT_CALL(listener_callbacks_, onNewConnection_(_))
+      .WillOnce(Invoke([&](Network::ConnectionPtr& conn) -> void {
+        server_connection_ = std::move(conn);
+        server_connection_->addConnectionCallbacks(server_callbacks_);
+        server_connection_->addReadFilter(server_read_filter);
+      }));
+  EXPECT_CALL(client_callbacks_, onEvent(Network::ConnectionEvent::Connected))
+      .WillOnce(Invoke([&](Network::ConnectionEvent) -> void { dispatcher_->exit(); }));
+  dispatcher_->run(Event::Dispatcher::RunType::Block);
+  EXPECT_EQ(1UL, stats_store_.counter("ssl.kernel_tls").value() +
+                     stats_store_.counter("ssl.kernel_tls_fallback").value());
+
+  const std::string request(32 * 1024, 'a');
+  std::string server_seen;
+  EXPECT_CALL(*server_read_filter, onNewConnection());
+  EXPECT_CALL(*server_read_filter, onData(_))
+      .WillRepeatedly(Invoke([&](Buffer::Instance& data) -> Network::FilterStatus {
+        server_seen += TestUtility::bufferToString(data);
+        data.drain(data.length());
+        if (server_seen.size() == request.size()) {
+          dispatcher_->exit();
+        }
+        return Network::FilterStatus::StopIteration;
+      }));
+  Buffer::OwnedImpl request_buffer(request);
+  client_connection_->write(request_buffer);
+  dispatcher_->run(Event::Dispatcher::RunType::Block);
+  EXPECT_EQ(request, server_seen);
+
+  const std::string response(32 * 1024, 'b');
+  std::string client_seen;
+  client_connection_->addReadFilter(read_filter_);
+  EXPECT_CALL(*read_filter_, onNewConnection());
+  EXPECT_CALL(*read_filter_, onData(_))
+      .WillRepeatedly(Invoke([&](Buffer::Instance& data) -> Network::FilterStatus {
+        client_seen += TestUtility::bufferToString(data);
+        data.drain(data.length());
+        if (client_seen.size() == response.size()) {
+          dispatcher_->exit();
+        }
+        return Network::FilterStatus::StopIteration;
+      }));
+  Buffer::OwnedImpl response_buffer(response);
+  server_connection_->write(response_buffer);
+  dispatcher_->run(Event::Dispatcher::RunType::Block);
+  EXPECT_EQ(response, client_seen);
+
+  disconnect();
+}
+
+TEST_P(SslReadBufferLimitTest, KernelTlsUnsupportedCipher) {
+  kernel_tls_ = true;
+  client_ctx_json_ = R"EOF(
+    {
+      "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_cert.pem",
+      "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_key.pem",
+      "cipher_suites": "ECDHE-RSA-AES256-GCM-SHA384"
+    }
+  )EOF";
+  initialize(0);
+
+  EXPECT_CALL(listener_callbacks_, onNewConnection_(_))
+      .WillOnce(Invoke([&](Network::ConnectionPtr& conn) -> void {
+        server_connection_ = std::move(conn);
+        server_connection_->addConnectionCallbacks(server_callbacks_);
+      }));
+  EXPECT_CALL(client_callbacks_, onEvent(Network::ConnectionEvent::Connected))
+      .WillOnce(Invoke([&](Network::ConnectionEvent) -> void { dispatcher_->exit(); }));
+  dispatcher_->run(Event::Dispatcher::RunType::Block);
+  EXPECT_EQ(0UL, stats_store_.counter("ssl.kernel_tls").value());
+  EXPECT_EQ(1UL, stats_store_.counter("ssl.kernel_tls_fallback").value());
+
+  disconnect();
+}
+
 TEST_P(SslReadBufferLimitTest, TestBind) {
   std::string address_string = TestUtility::getIpv4Loopback();
   if (GetParam() == Network::Address::IpVersion::v4) {
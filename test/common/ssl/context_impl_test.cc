@@ -9,7 +9,9 @@
 #include "test/common/ssl/ssl_certs_test.h"
 #include "test/mocks/runtime/mocks.h"
 #include "test/test_common/environment.h"
+#include "test/test_common/utility.h"
 
+#include "fmt/format.h"
 #include "gtest/gtest.h"
 
 namespace Envoy {
@@ -168,5 +170,223 @@ TEST_F(SslContextImplTest, TestNoCert) {
   EXPECT_EQ("", context->getCertChainInformation());
 }
 
+class SslSessionTicketTest : public SslCertsTest {
+public:
+  SslSessionTicketTest() : manager_(runtime_), client_ctx_(SSL_CTX_new(TLS_method())) {
+    SSL_CTX_set_max_proto_version(client_ctx_.get(), TLS1_2_VERSION);
+  }
+
+  ServerContextPtr createContext(const std::vector<std::string>& key_paths) {
+    std::string paths;
+    for (const std::string& path : key_paths) {
+      paths += (paths.empty() ? "\"" : ", \"") + path + "\"";
+    }
+    std::string json = R"EOF(
+    {
+      "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_cert.pem",
+      "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_key.pem",
+      "session_ticket_key_paths": [)EOF" +
+                       paths + "]}";
+
+    Json::ObjectSharedPtr loader = TestEnvironment::jsonLoadFromString(json);
+    ServerContextConfigImpl cfg(*loader);
+    return manager_.createSslServerContext(store_, cfg);
+  }
+
+  // Runs a handshake in memory, resuming the session if one is given, and returns the session of
+  // the client.
+  bssl::UniquePtr<SSL_SESSION> handshake(ServerContext& context, SSL_SESSION* session,
+                                         bool& reused) {
+    ContextImpl& context_impl = dynamic_cast<ContextImpl&>(context);
+    bssl::UniquePtr<SSL> server(context_impl.newSsl());
+    bssl::UniquePtr<SSL> client(SSL_new(client_ctx_.get()));
+    BIO* server_bio;
+    BIO* client_bio;
+    EXPECT_EQ(1, BIO_new_bio_pair(&server_bio, 0, &client_bio, 0));
+    SSL_set_bio(server.get(), server_bio, server_bio);
+    SSL_set_bio(client.get(), client_bio, client_bio);
+    SSL_set_accept_state(server.get());
+    SSL_set_connect_state(client.get());
+    if (session) {
+      SSL_set_session(client.get(), session);
+    }
+
+    bool client_done = false;
+    bool server_done = false;
+    for (uint32_t i = 0; i < 10 && !(client_done && server_done); i++) {
+      client_done = client_done || SSL_do_handshake(client.get()) == 1;
+      server_done = server_done || SSL_do_handshake(server.get()) == 1;
+    }
+    EXPECT_TRUE(client_done && server_done);
+
+    context_impl.logHandshake(server.get());
+    reused = SSL_session_reused(server.get());
+    return bssl::UniquePtr<SSL_SESSION>(SSL_get1_session(client.get()));
+  }
+
+  bool resumes(ServerContext& context, SSL_SESSION* session) {
+    bool reused;
+    handshake(context, session, reused);
+    return reused;
+  }
+
+  bssl::UniquePtr<SSL_SESSION> newSession(ServerContext& context) {
+    bool reused;
+    bssl::UniquePtr<SSL_SESSION> session = handshake(context, nullptr, reused);
+    EXPECT_FALSE(reused);
+    return session;
+  }
+
+  Runtime::MockLoader runtime_;
+  ContextManagerImpl manager_;
+  Stats::IsolatedStoreImpl store_;
+  bssl::UniquePtr<SSL_CTX> client_ctx_;
+  const std::string key_a_{TestEnvironment::writeStringToFileForTest("ticket_key_a",
+                                                                     std::string(80, 'a'))};
+  const std::string key_b_{TestEnvironment::writeStringToFileForTest("ticket_key_b",
+                                                                     std::string(80, 'b'))};
+};
+
+// Contexts with the same keys, such as those of other instances, resume each other's tickets.
+TEST_F(SslSessionTicketTest, SharedKeys) {
+  ServerContextPtr context_1 = createContext({key_a_});
+  ServerContextPtr context_2 = createContext({key_a_});
+  ServerContextPtr other_context = createContext({key_b_});
+
+  bssl::UniquePtr<SSL_SESSION> session = newSession(*context_1);
+  EXPECT_TRUE(resumes(*context_2, session.get()));
+  EXPECT_FALSE(resumes(*other_context, session.get()));
+  EXPECT_EQ(1U, store_.counter("ssl.session_reused").value());
+  EXPECT_EQ(3U, store_.counter("ssl.handshake").value());
+}
+
+// Tickets of a key that is no longer the first one are still resumed.
+TEST_F(SslSessionTicketTest, RotatedKeys) {
+  ServerContextPtr old_context = createContext({key_a_});
+  ServerContextPtr new_context = createContext({key_b_, key_a_});
+
+  bssl::UniquePtr<SSL_SESSION> old_session = newSession(*old_context);
+  EXPECT_TRUE(resumes(*new_context, old_session.get()));
+
+  bssl::UniquePtr<SSL_SESSION> new_session = newSession(*new_context);
+  EXPECT_FALSE(resumes(*old_context, new_session.get()));
+}
+
+TEST_F(SslSessionTicketTest, Reload) {
+  const std::string key =
+      TestEnvironment::writeStringToFileForTest("ticket_key", std::string(80, 'a'));
+  ServerContextPtr context = createContext({key});
+  ServerContextPtr context_a = createContext({key_a_});
+  ServerContextPtr context_b = createContext({key_b_});
+
+  // A key file that cannot be loaded keeps the previous keys.
+  TestEnvironment::writeStringToFileForTest("ticket_key", std::string(79, 'b'));
+  EXPECT_THROW_WITH_MESSAGE(
+      context->reloadSessionTicketKeys(), EnvoyException,
+      fmt::format("invalid TLS session ticket key length in {}: 79, expected 80", key));
+  EXPECT_TRUE(resumes(*context_a, newSession(*context).get()));
+
+  TestEnvironment::writeStringToFileForTest("ticket_key", std::string(80, 'b'));
+  context->reloadSessionTicketKeys();
+  bssl::UniquePtr<SSL_SESSION> session = newSession(*context);
+  EXPECT_FALSE(resumes(*context_a, session.get()));
+  EXPECT_TRUE(resumes(*context_b, session.get()));
+}
+
+TEST_F(SslSessionTicketTest, InvalidKey) {
+  const std::string key = TestEnvironment::writeStringToFileForTest("ticket_key", "short");
+  EXPECT_THROW_WITH_MESSAGE(
+      createContext({key}), EnvoyException,
+      fmt::format("invalid TLS session ticket key length in {}: 5, expected 80", key));
+  EXPECT_THROW(createContext({TestEnvironment::temporaryPath("missing_ticket_key")}),
+               EnvoyException);
+}
+
+class SslSniTest : public SslCertsTest {
+public:
+  SslSniTest() : manager_(runtime_), client_ctx_(SSL_CTX_new(TLS_method())) {
+    std::string json = R"EOF(
+  {
+    "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_cert.pem",
+    "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_key.pem",
+    "sni_certificates": [
+      {
+        "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/san_wildcard_dns_cert.pem",
+        "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/san_wildcard_dns_key.pem"
+      },
+      {
+        "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/san_dns_cert.pem",
+        "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/san_dns_key.pem"
+      }
+    ]
+  }
+  )EOF";
+
+    Json::ObjectSharedPtr loader = TestEnvironment::jsonLoadFromString(json);
+    ServerContextConfigImpl cfg(*loader);
+    context_ = manager_.createSslServerContext(store_, cfg);
+  }
+
+  // Runs a handshake in memory and returns the name of the file of the certificate served.
+  std::string servedCertificate(const char* server_name) {
+    bssl::UniquePtr<SSL> server(dynamic_cast<ContextImpl&>(*context_).newSsl());
+    bssl::UniquePtr<SSL> client(SSL_new(client_ctx_.get()));
+    BIO* server_bio;
+    BIO* client_bio;
+    EXPECT_EQ(1, BIO_new_bio_pair(&server_bio, 0, &client_bio, 0));
+    SSL_set_bio(server.get(), server_bio, server_bio);
+    SSL_set_bio(client.get(), client_bio, client_bio);
+    SSL_set_accept_state(server.get());
+    SSL_set_connect_state(client.get());
+    if (server_name) {
+      SSL_set_tlsext_host_name(client.get(), server_name);
+    }
+
+    bool client_done = false;
+    bool server_done = false;
+    for (uint32_t i = 0; i < 10 && !(client_done && server_done); i++) {
+      client_done = client_done || SSL_do_handshake(client.get()) == 1;
+      server_done = server_done || SSL_do_handshake(server.get()) == 1;
+    }
+    EXPECT_TRUE(client_done && server_done);
+
+    bssl::UniquePtr<X509> served(SSL_get_peer_certificate(client.get()));
+    for (const char* name : {"no_san_cert.pem", "san_wildcard_dns_cert.pem", "san_dns_cert.pem"}) {
+      FILE* fp = fopen(
+          TestEnvironment::runfilesPath(std::string("test/common/ssl/test_data/") + name).c_str(),
+          "r");
+      EXPECT_NE(fp, nullptr);
+      bssl::UniquePtr<X509> cert(PEM_read_X509(fp, nullptr, nullptr, nullptr));
+      fclose(fp);
+      if (X509_cmp(served.get(), cert.get()) == 0) {
+        return name;
+      }
+    }
+    return "";
+  }
+
+  Runtime::MockLoader runtime_;
+  ContextManagerImpl manager_;
+  Stats::IsolatedStoreImpl store_;
+  bssl::UniquePtr<SSL_CTX> client_ctx_;
+  ServerContextPtr context_;
+};
+
+TEST_F(SslSniTest, ExactName) {
+  EXPECT_EQ("san_dns_cert.pem", servedCertificate("server1.example.com"));
+  EXPECT_EQ("san_dns_cert.pem", servedCertificate("Server1.EXAMPLE.com"));
+}
+
+TEST_F(SslSniTest, WildcardName) {
+  EXPECT_EQ("san_wildcard_dns_cert.pem", servedCertificate("server2.example.com"));
+  EXPECT_EQ("no_san_cert.pem", servedCertificate("a.server2.example.com"));
+  EXPECT_EQ("no_san_cert.pem", servedCertificate("example.com"));
+}
+
+TEST_F(SslSniTest, DefaultCertificate) {
+  EXPECT_EQ("no_san_cert.pem", servedCertificate(nullptr));
+  EXPECT_EQ("no_san_cert.pem", servedCertificate("lyft.com"));
+}
+
 } // namespace Ssl
 } // namespace Envoy
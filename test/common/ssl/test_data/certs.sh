@@ -8,6 +8,7 @@ set -e
 # openssl genrsa -out no_san_key.pem 1024
 # openssl genrsa -out san_dns_key.pem 1024
 # openssl genrsa -out san_uri_key.pem 1024
+# openssl genrsa -out san_wildcard_dns_key.pem 1024
 # openssl genrsa -out selfsigned_key.pem 1024
 
 # Generate ca_cert.pem.
@@ -29,6 +30,10 @@ openssl x509 -req -days 730 -in no_san_cert.csr -sha256 -CA ca_cert.pem -CAkey c
 openssl req -new -key san_dns_key.pem -out san_dns_cert.csr -config san_dns_cert.cfg -batch -sha256
 openssl x509 -req -days 730 -in san_dns_cert.csr -sha256 -CA ca_cert.pem -CAkey ca_key.pem -CAcreateserial -out san_dns_cert.pem -extensions v3_ca -extfile san_dns_cert.cfg
 
+# Generate san_wildcard_dns_cert.pem.
+openssl req -new -key san_wildcard_dns_key.pem -out san_wildcard_dns_cert.csr -config san_wildcard_dns_cert.cfg -batch -sha256
+openssl x509 -req -days 730 -in san_wildcard_dns_cert.csr -sha256 -CA ca_cert.pem -CAkey ca_key.pem -CAcreateserial -out san_wildcard_dns_cert.pem -extensions v3_ca -extfile san_wildcard_dns_cert.cfg
+
 # Generate san_uri_cert.pem.
 openssl req -new -key san_uri_key.pem -out san_uri_cert.csr -config san_uri_cert.cfg -batch -sha256
 openssl x509 -req -days 730 -in san_uri_cert.csr -sha256 -CA ca_cert.pem -CAkey ca_key.pem -CAcreateserial -out san_uri_cert.pem -extensions v3_ca -extfile san_uri_cert.cfg
@@ -0,0 +1,32 @@
+#include <string>
+
+#include "common/stats/cardinality_limiter.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Stats {
+
+TEST(CardinalityLimiterTest, FoldsOverflow) {
+  CardinalityLimiter limiter(2);
+  const std::string& foo = limiter.admit("foo");
+  EXPECT_EQ("foo", foo);
+  EXPECT_EQ("bar", limiter.admit("bar"));
+  EXPECT_EQ(2U, limiter.size());
+
+  // Values past the maximum are folded, and admitted values stay admitted.
+  EXPECT_EQ(&CardinalityLimiter::overflowValue(), &limiter.admit("baz"));
+  EXPECT_EQ("other", limiter.admit("baz"));
+  EXPECT_EQ(&foo, &limiter.admit(std::string("foo")));
+  EXPECT_EQ("bar", limiter.admit("bar"));
+  EXPECT_EQ(2U, limiter.size());
+}
+
+TEST(CardinalityLimiterTest, NoValues) {
+  CardinalityLimiter limiter(0);
+  EXPECT_EQ("other", limiter.admit("foo"));
+  EXPECT_EQ(0U, limiter.size());
+}
+
+} // namespace Stats
+} // namespace Envoy
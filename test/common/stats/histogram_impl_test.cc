@@ -0,0 +1,121 @@
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "common/stats/histogram_impl.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Stats {
+
+TEST(HistogramBucketsTest, BucketBounds) {
+  // Small values get exact buckets.
+  for (uint64_t i = 0; i < HistogramBuckets::SUB_BUCKET_COUNT; i++) {
+    EXPECT_EQ(i, HistogramBuckets::bucketIndex(i));
+    EXPECT_EQ(i, HistogramBuckets::bucketLowerBound(i));
+    EXPECT_EQ(1U, HistogramBuckets::bucketWidth(i));
+  }
+
+  // Every value falls into a bucket whose bounds contain it, and buckets are contiguous.
+  for (uint64_t value : std::vector<uint64_t>{16, 17, 31, 32, 33, 1000, 65535, 65536, 1234567890,
+                                              UINT64_MAX}) {
+    const uint32_t index = HistogramBuckets::bucketIndex(value);
+    EXPECT_LE(HistogramBuckets::bucketLowerBound(index), value);
+    EXPECT_LE(value - HistogramBuckets::bucketLowerBound(index),
+              HistogramBuckets::bucketWidth(index) - 1);
+    EXPECT_LE(HistogramBuckets::bucketWidth(index) * HistogramBuckets::SUB_BUCKET_COUNT, value);
+  }
+  for (uint32_t index = 0; index < 500; index++) {
+    EXPECT_EQ(HistogramBuckets::bucketLowerBound(index) + HistogramBuckets::bucketWidth(index),
+              HistogramBuckets::bucketLowerBound(index + 1));
+    EXPECT_EQ(index, HistogramBuckets::bucketIndex(HistogramBuckets::bucketLowerBound(index)));
+  }
+}
+
+TEST(HistogramBucketsTest, Quantiles) {
+  HistogramBuckets buckets;
+  EXPECT_TRUE(std::isnan(buckets.quantile(0.5)));
+
+  for (uint64_t i = 1; i <= 10000; i++) {
+    buckets.recordValue(i);
+  }
+  EXPECT_EQ(10000U, buckets.sampleCount());
+  EXPECT_EQ(50005000U, buckets.sampleSum());
+
+  // The relative error is bounded by the sub bucket resolution.
+  for (double q : {0.5, 0.9, 0.99, 0.999}) {
+    EXPECT_NEAR(q * 10000, buckets.quantile(q), q * 10000 / HistogramBuckets::SUB_BUCKET_COUNT);
+  }
+  EXPECT_EQ(1, buckets.quantile(0));
+}
+
+TEST(HistogramBucketsTest, MergeAndClear) {
+  HistogramBuckets a;
+  HistogramBuckets b;
+  a.recordValue(1);
+  b.recordValue(1000000);
+  a.merge(b);
+  EXPECT_EQ(2U, a.sampleCount());
+  EXPECT_EQ(1000001U, a.sampleSum());
+  EXPECT_EQ(1, a.quantile(0.5));
+  EXPECT_LT(900000, a.quantile(1));
+
+  a.clear();
+  EXPECT_EQ(0U, a.sampleCount());
+  EXPECT_TRUE(std::isnan(a.quantile(0.5)));
+}
+
+TEST(HistogramBucketsTest, CountAtMost) {
+  HistogramBuckets buckets;
+  EXPECT_EQ(0U, buckets.countAtMost(100));
+
+  for (uint64_t i = 0; i < 1000; i++) {
+    buckets.recordValue(i);
+  }
+  EXPECT_EQ(1U, buckets.countAtMost(0.5));
+  EXPECT_EQ(11U, buckets.countAtMost(10));
+  EXPECT_EQ(1000U, buckets.countAtMost(1023));
+  EXPECT_EQ(1000U, buckets.countAtMost(1e9));
+
+  // Bounds inside a wide bucket are interpolated within the resolution of the buckets.
+  EXPECT_NEAR(501, buckets.countAtMost(500), 500 / HistogramBuckets::SUB_BUCKET_COUNT);
+
+  HistogramStatisticsImpl statistics(buckets);
+  ASSERT_EQ(statistics.supportedBuckets().size(), statistics.computedBuckets().size());
+  for (size_t i = 1; i < statistics.computedBuckets().size(); i++) {
+    EXPECT_LE(statistics.computedBuckets()[i - 1], statistics.computedBuckets()[i]);
+  }
+  EXPECT_EQ(1000U, statistics.computedBuckets().back());
+}
+
+TEST(HistogramImplTest, Merge) {
+  HistogramImpl histogram("h");
+  EXPECT_EQ("h", histogram.name());
+  EXPECT_FALSE(histogram.used());
+  EXPECT_EQ("P50: nan P90: nan P99: nan P99.9: nan", histogram.cumulativeStatistics().summary());
+
+  histogram.recordValue(10);
+  histogram.recordValue(10);
+  histogram.merge();
+  EXPECT_TRUE(histogram.used());
+  EXPECT_EQ(2U, histogram.intervalStatistics().sampleCount());
+  EXPECT_EQ(20U, histogram.intervalStatistics().sampleSum());
+  EXPECT_EQ(10, histogram.intervalStatistics().computedQuantiles()[0]);
+  EXPECT_EQ("P50: 10.0 P90: 10.0 P99: 10.0 P99.9: 10.0",
+            histogram.cumulativeStatistics().summary());
+
+  histogram.recordValue(5);
+  histogram.merge();
+  EXPECT_EQ(1U, histogram.intervalStatistics().sampleCount());
+  EXPECT_EQ(3U, histogram.cumulativeStatistics().sampleCount());
+  EXPECT_EQ(25U, histogram.cumulativeStatistics().sampleSum());
+
+  // An empty interval keeps the cumulative statistics.
+  histogram.merge();
+  EXPECT_EQ(0U, histogram.intervalStatistics().sampleCount());
+  EXPECT_EQ(3U, histogram.cumulativeStatistics().sampleCount());
+}
+
+} // namespace Stats
+} // namespace Envoy
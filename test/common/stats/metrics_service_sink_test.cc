@@ -0,0 +1,203 @@
+#include <memory>
+#include <string>
+
+#include "common/stats/histogram_impl.h"
+#include "common/stats/metrics_service_sink.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/grpc/mocks.h"
+#include "test/mocks/local_info/mocks.h"
+#include "test/mocks/stats/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+using testing::SaveArg;
+using testing::_;
+
+namespace Envoy {
+namespace Stats {
+namespace Metrics {
+
+class MetricsServiceSinkTest : public testing::Test {
+public:
+  MetricsServiceSinkTest()
+      : async_client_(new Grpc::MockAsyncClient<envoy::metrics::StreamMetricsMessage,
+                                                envoy::metrics::StreamMetricsResponse>()),
+        sink_(GrpcMetricsAsyncClientPtr{async_client_}, local_info_) {}
+
+  void expectStreamStart() {
+    EXPECT_CALL(*async_client_, start(_, _))
+        .WillOnce(Invoke([this](const Protobuf::MethodDescriptor& service_method,
+                                Grpc::AsyncStreamCallbacks<envoy::metrics::StreamMetricsResponse>&)
+                             -> Grpc::AsyncStream<envoy::metrics::StreamMetricsMessage>* {
+          EXPECT_EQ("envoy.metrics.MetricsService", service_method.service()->full_name());
+          EXPECT_EQ("StreamMetrics", service_method.name());
+          return &stream_;
+        }));
+  }
+
+  NiceMock<LocalInfo::MockLocalInfo> local_info_;
+  Grpc::MockAsyncClient<envoy::metrics::StreamMetricsMessage,
+                        envoy::metrics::StreamMetricsResponse>* async_client_;
+  Grpc::MockAsyncStream<envoy::metrics::StreamMetricsMessage> stream_;
+  MetricsServiceSink sink_;
+  IsolatedStoreImpl store_;
+};
+
+TEST_F(MetricsServiceSinkTest, NamesSentOncePerStream) {
+  envoy::metrics::StreamMetricsMessage message;
+
+  expectStreamStart();
+  EXPECT_CALL(stream_, sendMessage(_, false)).WillOnce(SaveArg<0>(&message));
+  sink_.beginFlush();
+  // The first flush of a stream sends every gauge.
+  EXPECT_TRUE(sink_.wantsAllGauges());
+  sink_.flushCounter(store_.counter("foo"), 3);
+  sink_.flushGauge(store_.gauge("bar"), 7);
+  sink_.endFlush();
+
+  EXPECT_EQ("node_name", message.identifier().node());
+  EXPECT_EQ("cluster_name", message.identifier().cluster());
+  ASSERT_EQ(2, message.stat_names_size());
+  EXPECT_EQ(0U, message.stat_names(0).id());
+  EXPECT_EQ("foo", message.stat_names(0).name());
+  EXPECT_EQ(1U, message.stat_names(1).id());
+  EXPECT_EQ("bar", message.stat_names(1).name());
+  ASSERT_EQ(1, message.counters_size());
+  EXPECT_EQ(0U, message.counters(0).id());
+  EXPECT_EQ(3U, message.counters(0).delta());
+  ASSERT_EQ(1, message.gauges_size());
+  EXPECT_EQ(1U, message.gauges(0).id());
+  EXPECT_EQ(7U, message.gauges(0).value());
+
+  // The stream is reused and only new names are sent.
+  EXPECT_CALL(stream_, sendMessage(_, false)).WillOnce(SaveArg<0>(&message));
+  sink_.beginFlush();
+  EXPECT_FALSE(sink_.wantsAllGauges());
+  sink_.flushCounter(store_.counter("foo"), 1);
+  sink_.flushCounter(store_.counter("baz"), 2);
+  sink_.endFlush();
+
+  EXPECT_FALSE(message.has_identifier());
+  ASSERT_EQ(1, message.stat_names_size());
+  EXPECT_EQ(2U, message.stat_names(0).id());
+  EXPECT_EQ("baz", message.stat_names(0).name());
+  ASSERT_EQ(2, message.counters_size());
+  EXPECT_EQ(0U, message.counters(0).id());
+  EXPECT_EQ(2U, message.counters(1).id());
+  EXPECT_EQ(0, message.gauges_size());
+
+  // A new stream starts over with the names.
+  sink_.onRemoteClose(Grpc::Status::Internal, "bad");
+  expectStreamStart();
+  EXPECT_CALL(stream_, sendMessage(_, false)).WillOnce(SaveArg<0>(&message));
+  sink_.beginFlush();
+  EXPECT_TRUE(sink_.wantsAllGauges());
+  sink_.flushCounter(store_.counter("baz"), 4);
+  sink_.endFlush();
+
+  EXPECT_TRUE(message.has_identifier());
+  ASSERT_EQ(1, message.stat_names_size());
+  EXPECT_EQ(0U, message.stat_names(0).id());
+  EXPECT_EQ("baz", message.stat_names(0).name());
+
+  EXPECT_CALL(stream_, resetStream());
+}
+
+TEST_F(MetricsServiceSinkTest, Tags) {
+  NiceMock<MockCounter> counter;
+  ON_CALL(counter, name()).WillByDefault(Return("cluster.foo.upstream_rq_200"));
+  ON_CALL(counter, tagExtractedName()).WillByDefault(Return("cluster.upstream_rq"));
+  counter.tags_ = {{"envoy.cluster_name", "foo"}, {"envoy.response_code", "200"}};
+
+  envoy::metrics::StreamMetricsMessage message;
+  expectStreamStart();
+  EXPECT_CALL(stream_, sendMessage(_, false)).WillOnce(SaveArg<0>(&message));
+  sink_.beginFlush();
+  sink_.flushCounter(counter, 1);
+  sink_.flushCounter(store_.counter("untagged"), 1);
+  sink_.endFlush();
+
+  ASSERT_EQ(2, message.stat_names_size());
+  const auto& tagged = message.stat_names(0);
+  EXPECT_EQ("cluster.foo.upstream_rq_200", tagged.name());
+  EXPECT_EQ("cluster.upstream_rq", tagged.tag_extracted_name());
+  ASSERT_EQ(2, tagged.tags_size());
+  EXPECT_EQ("envoy.cluster_name", tagged.tags(0).name());
+  EXPECT_EQ("foo", tagged.tags(0).value());
+  EXPECT_EQ("envoy.response_code", tagged.tags(1).name());
+  EXPECT_EQ("200", tagged.tags(1).value());
+
+  const auto& untagged = message.stat_names(1);
+  EXPECT_EQ("untagged", untagged.tag_extracted_name());
+  EXPECT_EQ(0, untagged.tags_size());
+
+  EXPECT_CALL(stream_, resetStream());
+}
+
+TEST_F(MetricsServiceSinkTest, StreamStartFailure) {
+  EXPECT_CALL(*async_client_, start(_, _)).WillOnce(Return(nullptr));
+  sink_.beginFlush();
+  EXPECT_FALSE(sink_.wantsAllGauges());
+  sink_.flushCounter(store_.counter("foo"), 3);
+  sink_.endFlush();
+
+  // The next flush tries again.
+  expectStreamStart();
+  envoy::metrics::StreamMetricsMessage message;
+  EXPECT_CALL(stream_, sendMessage(_, false)).WillOnce(SaveArg<0>(&message));
+  sink_.beginFlush();
+  sink_.flushCounter(store_.counter("foo"), 1);
+  sink_.endFlush();
+  ASSERT_EQ(1, message.counters_size());
+  EXPECT_EQ(1U, message.counters(0).delta());
+
+  EXPECT_CALL(stream_, resetStream());
+}
+
+TEST_F(MetricsServiceSinkTest, Histograms) {
+  HistogramImpl histogram("h");
+  histogram.recordValue(1);
+  histogram.recordValue(2);
+  histogram.merge();
+  HistogramImpl empty("empty");
+  empty.merge();
+
+  envoy::metrics::StreamMetricsMessage message;
+  expectStreamStart();
+  EXPECT_CALL(stream_, sendMessage(_, false)).WillOnce(SaveArg<0>(&message));
+  sink_.beginFlush();
+  sink_.flushHistogram(histogram);
+  sink_.flushHistogram(empty);
+  sink_.endFlush();
+
+  const std::vector<double>& quantiles = histogram.intervalStatistics().supportedQuantiles();
+  ASSERT_EQ(static_cast<int>(quantiles.size()), message.quantiles_size());
+  ASSERT_EQ(1, message.histograms_size());
+  const auto& summary = message.histograms(0);
+  EXPECT_EQ("h", message.stat_names(0).name());
+  EXPECT_EQ(2U, summary.sample_count());
+  EXPECT_EQ(3U, summary.sample_sum());
+  EXPECT_EQ(static_cast<int>(quantiles.size()), summary.quantile_values_size());
+
+  // Quantiles are only sent once per stream.
+  histogram.recordValue(5);
+  histogram.merge();
+  EXPECT_CALL(stream_, sendMessage(_, false)).WillOnce(SaveArg<0>(&message));
+  sink_.beginFlush();
+  sink_.flushHistogram(histogram);
+  sink_.endFlush();
+  EXPECT_EQ(0, message.quantiles_size());
+  ASSERT_EQ(1, message.histograms_size());
+  EXPECT_EQ(1U, message.histograms(0).sample_count());
+
+  EXPECT_CALL(stream_, resetStream());
+}
+
+} // namespace Metrics
+} // namespace Stats
+} // namespace Envoy
@@ -38,5 +38,29 @@ TEST(StatsIsolatedStoreImplTest, All) {
   EXPECT_EQ(2UL, store.gauges().size());
 }
 
+TEST(StatsStandaloneImplTest, All) {
+  StandaloneCounterImpl counter("c1");
+  EXPECT_EQ("c1", counter.name());
+  EXPECT_FALSE(counter.used());
+  counter.inc();
+  counter.add(2);
+  EXPECT_TRUE(counter.used());
+  EXPECT_EQ(3UL, counter.value());
+  EXPECT_EQ(3UL, counter.latch());
+  EXPECT_EQ(0UL, counter.latch());
+  counter.reset();
+  EXPECT_EQ(0UL, counter.value());
+
+  StandaloneGaugeImpl gauge("g1");
+  EXPECT_EQ("g1", gauge.name());
+  EXPECT_FALSE(gauge.used());
+  gauge.set(5);
+  EXPECT_TRUE(gauge.used());
+  gauge.inc();
+  gauge.sub(2);
+  gauge.dec();
+  EXPECT_EQ(3UL, gauge.value());
+}
+
 } // namespace Stats
 } // namespace Envoy
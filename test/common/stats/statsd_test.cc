@@ -9,6 +9,7 @@
 #include "test/mocks/buffer/mocks.h"
 #include "test/mocks/local_info/mocks.h"
 #include "test/mocks/network/mocks.h"
+#include "test/mocks/stats/mocks.h"
 #include "test/mocks/thread_local/mocks.h"
 #include "test/mocks/upstream/mocks.h"
 
@@ -31,6 +32,8 @@ public:
     sink_.reset(
         new TcpStatsdSink(local_info_, "fake_cluster", tls_, cluster_manager_,
                           cluster_manager_.thread_local_cluster_.cluster_.info_->stats_store_));
+    ON_CALL(counter_, name()).WillByDefault(Return("test_counter"));
+    ON_CALL(gauge_, name()).WillByDefault(Return("test_gauge"));
   }
 
   void expectCreateConnection() {
@@ -51,6 +54,8 @@ public:
   std::unique_ptr<TcpStatsdSink> sink_;
   NiceMock<LocalInfo::MockLocalInfo> local_info_;
   Network::MockClientConnection* connection_{};
+  NiceMock<MockCounter> counter_;
+  NiceMock<MockGauge> gauge_;
 };
 
 TEST_F(TcpStatsdSinkTest, EmptyFlush) {
@@ -66,8 +71,8 @@ TEST_F(TcpStatsdSinkTest, BasicFlow) {
   InSequence s;
 
   sink_->beginFlush();
-  sink_->flushCounter("test_counter", 1);
-  sink_->flushGauge("test_gauge", 2);
+  sink_->flushCounter(counter_, 1);
+  sink_->flushGauge(gauge_, 2);
 
   expectCreateConnection();
   EXPECT_CALL(*connection_,
@@ -93,7 +98,7 @@ TEST_F(TcpStatsdSinkTest, BufferReallocate) {
 
   sink_->beginFlush();
   for (int i = 0; i < 2000; i++) {
-    sink_->flushCounter("test_counter", 1);
+    sink_->flushCounter(counter_, 1);
   }
 
   expectCreateConnection();
@@ -114,14 +119,14 @@ TEST_F(TcpStatsdSinkTest, Overflow) {
   cluster_manager_.thread_local_cluster_.cluster_.info_->stats().upstream_cx_tx_bytes_buffered_.set(
       1024 * 1024 * 17);
   sink_->beginFlush();
-  sink_->flushCounter("test_counter", 1);
+  sink_->flushCounter(counter_, 1);
   sink_->endFlush();
 
   // Lower and make sure we write.
   cluster_manager_.thread_local_cluster_.cluster_.info_->stats().upstream_cx_tx_bytes_buffered_.set(
       1024 * 1024 * 15);
   sink_->beginFlush();
-  sink_->flushCounter("test_counter", 1);
+  sink_->flushCounter(counter_, 1);
   expectCreateConnection();
   EXPECT_CALL(*connection_, write(BufferStringEqual("envoy.test_counter:1|c\n")));
   sink_->endFlush();
@@ -130,7 +135,7 @@ TEST_F(TcpStatsdSinkTest, Overflow) {
   cluster_manager_.thread_local_cluster_.cluster_.info_->stats().upstream_cx_tx_bytes_buffered_.set(
       1024 * 1024 * 17);
   sink_->beginFlush();
-  sink_->flushCounter("test_counter", 1);
+  sink_->flushCounter(counter_, 1);
   EXPECT_CALL(*connection_, close(Network::ConnectionCloseType::NoFlush));
   sink_->endFlush();
 
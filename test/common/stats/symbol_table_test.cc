@@ -0,0 +1,69 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/stats/symbol_table.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Stats {
+
+TEST(SymbolTableTest, Intern) {
+  SymbolTable table;
+  StatNameRef a = table.intern("cluster.foo.upstream_rq_total");
+  StatNameRef b = table.intern(std::string("cluster.foo.upstream_rq_total"));
+  StatNameRef c = table.intern("cluster.bar.upstream_rq_total");
+
+  EXPECT_EQ(&a.str(), &b.str());
+  EXPECT_NE(&a.str(), &c.str());
+  EXPECT_EQ("cluster.foo.upstream_rq_total", a.str());
+  EXPECT_EQ(2U, table.size());
+
+  // The name remains interned until the last reference is dropped.
+  table.free(a);
+  EXPECT_EQ(2U, table.size());
+  EXPECT_EQ("cluster.foo.upstream_rq_total", b.str());
+  table.free(b);
+  EXPECT_EQ(1U, table.size());
+  table.free(c);
+  EXPECT_EQ(0U, table.size());
+}
+
+TEST(SymbolTableTest, LookupKey) {
+  SymbolTable table;
+  StatNameRefMap<int> map;
+  map.emplace(table.intern("hello"), 1);
+
+  // A non interned reference finds the interned entry by value.
+  const std::string name = "hello";
+  auto entry = map.find(StatNameRef(name));
+  ASSERT_NE(map.end(), entry);
+  EXPECT_EQ(1, entry->second);
+  EXPECT_NE(&name, &entry->first.str());
+  EXPECT_EQ(map.end(), map.find(StatNameRef(std::string("world"))));
+
+  table.free(entry->first);
+}
+
+TEST(SymbolTableTest, Threads) {
+  SymbolTable table;
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < 4; i++) {
+    threads.emplace_back([&table]() -> void {
+      for (uint32_t j = 0; j < 1000; j++) {
+        const std::string name = "stat." + std::to_string(j % 100);
+        table.free(table.intern(name));
+        table.intern(name);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(100U, table.size());
+}
+
+} // namespace Stats
+} // namespace Envoy
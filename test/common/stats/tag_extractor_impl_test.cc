@@ -0,0 +1,118 @@
+#include <string>
+#include <vector>
+
+#include "envoy/common/exception.h"
+
+#include "common/stats/tag_extractor_impl.h"
+
+#include "test/test_common/utility.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Stats {
+
+class DefaultTagExtractorTest : public testing::Test {
+public:
+  DefaultTagExtractorTest() : tag_extractors_(TagExtractorImpl::createTagExtractors({})) {}
+
+  std::string extract(const std::string& name) {
+    tags_.clear();
+    return TagExtractorImpl::extractTags(name, tag_extractors_, tags_);
+  }
+
+  const std::vector<TagExtractorPtr> tag_extractors_;
+  std::vector<Tag> tags_;
+};
+
+TEST_F(DefaultTagExtractorTest, Cluster) {
+  EXPECT_EQ("cluster.upstream_rq_total", extract("cluster.foo.upstream_rq_total"));
+  ASSERT_EQ(1U, tags_.size());
+  EXPECT_EQ(TagNames::get().CLUSTER_NAME, tags_[0].name_);
+  EXPECT_EQ("foo", tags_[0].value_);
+
+  // The cluster name ends at the first dot and the response code is also extracted.
+  EXPECT_EQ("cluster.bar.upstream_rq", extract("cluster.foo.bar.upstream_rq_200"));
+  ASSERT_EQ(2U, tags_.size());
+  EXPECT_EQ("foo", tags_[0].value_);
+  EXPECT_EQ(TagNames::get().RESPONSE_CODE, tags_[1].name_);
+  EXPECT_EQ("200", tags_[1].value_);
+
+  EXPECT_EQ("cluster.upstream_rq", extract("cluster.foo.upstream_rq_5xx"));
+  ASSERT_EQ(2U, tags_.size());
+  EXPECT_EQ(TagNames::get().RESPONSE_CODE_CLASS, tags_[1].name_);
+  EXPECT_EQ("5xx", tags_[1].value_);
+}
+
+TEST_F(DefaultTagExtractorTest, Listener) {
+  EXPECT_EQ("listener.downstream_cx_total", extract("listener.127.0.0.1:80.downstream_cx_total"));
+  ASSERT_EQ(1U, tags_.size());
+  EXPECT_EQ(TagNames::get().LISTENER_ADDRESS, tags_[0].name_);
+  EXPECT_EQ("127.0.0.1:80", tags_[0].value_);
+
+  // Listener stats without an address are not tagged.
+  EXPECT_EQ("listener_manager.total_listeners_active",
+            extract("listener_manager.total_listeners_active"));
+  EXPECT_TRUE(tags_.empty());
+}
+
+TEST_F(DefaultTagExtractorTest, HttpAndVirtualHost) {
+  EXPECT_EQ("http.downstream_rq", extract("http.ingress_http.downstream_rq_2xx"));
+  ASSERT_EQ(2U, tags_.size());
+  EXPECT_EQ(TagNames::get().HTTP_CONN_MANAGER_PREFIX, tags_[0].name_);
+  EXPECT_EQ("ingress_http", tags_[0].value_);
+  EXPECT_EQ("2xx", tags_[1].value_);
+
+  EXPECT_EQ("vhost.vcluster.upstream_rq_time",
+            extract("vhost.service.vcluster.other.upstream_rq_time"));
+  ASSERT_EQ(2U, tags_.size());
+  EXPECT_EQ(TagNames::get().VIRTUAL_HOST, tags_[0].name_);
+  EXPECT_EQ("service", tags_[0].value_);
+  EXPECT_EQ(TagNames::get().VIRTUAL_CLUSTER, tags_[1].name_);
+  EXPECT_EQ("other", tags_[1].value_);
+}
+
+TEST_F(DefaultTagExtractorTest, Untagged) {
+  EXPECT_EQ("server.uptime", extract("server.uptime"));
+  EXPECT_TRUE(tags_.empty());
+}
+
+TEST(TagExtractorImplTest, Custom) {
+  std::vector<TagExtractorPtr> tag_extractors =
+      TagExtractorImpl::createTagExtractors({{"shard", "(\\.shard_(\\d+))$"}});
+  EXPECT_EQ("shard", tag_extractors[0]->name());
+
+  std::vector<Tag> tags;
+  EXPECT_EQ("cluster.upstream_cx_active",
+            TagExtractorImpl::extractTags("cluster.foo.upstream_cx_active.shard_3",
+                                          tag_extractors, tags));
+  ASSERT_EQ(2U, tags.size());
+  EXPECT_EQ("shard", tags[0].name_);
+  EXPECT_EQ("3", tags[0].value_);
+  EXPECT_EQ(TagNames::get().CLUSTER_NAME, tags[1].name_);
+}
+
+TEST(TagExtractorImplTest, SingleGroup) {
+  TagExtractorImpl tag_extractor("cluster", "^cluster\\.([^.]+)");
+  std::string name = "cluster.foo.bar";
+  std::vector<Tag> tags;
+  EXPECT_TRUE(tag_extractor.extractTag(name, tags));
+  EXPECT_EQ("cluster..bar", name);
+  ASSERT_EQ(1U, tags.size());
+  EXPECT_EQ("foo", tags[0].value_);
+
+  name = "server.bar";
+  EXPECT_FALSE(tag_extractor.extractTag(name, tags));
+  EXPECT_EQ("server.bar", name);
+  EXPECT_EQ(1U, tags.size());
+}
+
+TEST(TagExtractorImplTest, BadRegex) {
+  EXPECT_THROW_WITH_MESSAGE(TagExtractorImpl("foo", "^cluster\\."), EnvoyException,
+                            "tag extractor 'foo' regex '^cluster\\.' has no capture group");
+  EXPECT_THROW(TagExtractorImpl("foo", "(unclosed"), EnvoyException);
+  EXPECT_THROW(TagExtractorImpl::createTagExtractors({{"foo", "[bad"}}), EnvoyException);
+}
+
+} // namespace Stats
+} // namespace Envoy
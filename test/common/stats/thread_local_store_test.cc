@@ -3,6 +3,7 @@
 #include <string>
 #include <unordered_map>
 
+#include "common/stats/tag_extractor_impl.h"
 #include "common/stats/thread_local_store.h"
 
 #include "test/mocks/event/mocks.h"
@@ -304,6 +305,53 @@ TEST_F(StatsThreadLocalStoreTest, OverlappingScopes) {
   EXPECT_CALL(*this, free(_)).Times(3);
 }
 
+TEST_F(StatsThreadLocalStoreTest, ChangedStats) {
+  InSequence s;
+  store_->initializeThreading(main_thread_dispatcher_, tls_);
+
+  ScopePtr scope1 = store_->createScope("scope1.");
+  EXPECT_CALL(*this, alloc(_)).Times(3);
+  Counter& c1 = scope1->counter("c1");
+  Counter& c2 = scope1->counter("c2");
+  Gauge& g1 = scope1->gauge("g1");
+  EXPECT_TRUE(store_->latchChangedCounters().empty());
+  EXPECT_TRUE(store_->latchChangedGauges().empty());
+
+  // A stat is only returned once no matter how often it changed.
+  c1.inc();
+  c1.inc();
+  g1.set(5);
+  g1.sub(1);
+  std::vector<CounterSharedPtr> counters = store_->latchChangedCounters();
+  ASSERT_EQ(1UL, counters.size());
+  EXPECT_EQ(&c1, counters[0].get());
+  std::vector<GaugeSharedPtr> gauges = store_->latchChangedGauges();
+  ASSERT_EQ(1UL, gauges.size());
+  EXPECT_EQ(&g1, gauges[0].get());
+  EXPECT_TRUE(store_->latchChangedCounters().empty());
+  EXPECT_TRUE(store_->latchChangedGauges().empty());
+
+  // Changing again after a latch tracks the stat again.
+  c1.inc();
+  counters = store_->latchChangedCounters();
+  ASSERT_EQ(1UL, counters.size());
+  EXPECT_EQ(&c1, counters[0].get());
+  counters.clear();
+  gauges.clear();
+
+  // Tracking does not keep stats alive, deleted stats are skipped.
+  c2.inc();
+  EXPECT_CALL(*this, free(_)).Times(3);
+  scope1.reset();
+  EXPECT_TRUE(store_->latchChangedCounters().empty());
+
+  store_->shutdownThreading();
+  tls_.shutdownThread();
+
+  // Includes overflow stat.
+  EXPECT_CALL(*this, free(_));
+}
+
 TEST_F(StatsThreadLocalStoreTest, AllocFailed) {
   InSequence s;
   store_->initializeThreading(main_thread_dispatcher_, tls_);
@@ -345,5 +393,91 @@ TEST_F(StatsThreadLocalStoreTest, ShuttingDown) {
   EXPECT_CALL(*this, free(_)).Times(5);
 }
 
+TEST_F(StatsThreadLocalStoreTest, Histograms) {
+  InSequence s;
+
+  // Values recorded before threading is initialized go directly into the parent histogram.
+  Histogram& h0 = store_->histogram("h");
+  h0.recordValue(1);
+
+  store_->initializeThreading(main_thread_dispatcher_, tls_);
+  Histogram& h1 = store_->histogram("h");
+  EXPECT_NE(&h0, &h1);
+  EXPECT_EQ(&h1, &store_->histogram("h"));
+  EXPECT_EQ("h", h1.name());
+  h1.recordValue(2);
+  h1.recordValue(3);
+
+  // Timings and histogram deliveries are also recorded.
+  EXPECT_CALL(sink_, onTimespanComplete("t", std::chrono::milliseconds(200)));
+  store_->deliverTimingToSinks("t", std::chrono::milliseconds(200));
+  EXPECT_CALL(sink_, onHistogramComplete("h", 4));
+  store_->deliverHistogramToSinks("h", 4);
+
+  EXPECT_EQ(2UL, store_->histograms().size());
+  ParentHistogramSharedPtr h = TestUtility::findHistogram(*store_, "h");
+  EXPECT_FALSE(h->used());
+
+  EXPECT_CALL(tls_, runOnAllThreads(_, _));
+  bool merged = false;
+  store_->mergeHistograms([&merged]() -> void { merged = true; });
+  EXPECT_TRUE(merged);
+  EXPECT_TRUE(h->used());
+  EXPECT_EQ(4UL, h->intervalStatistics().sampleCount());
+  EXPECT_EQ(10UL, h->intervalStatistics().sampleSum());
+  EXPECT_EQ(200UL, TestUtility::findHistogram(*store_, "t")->intervalStatistics().sampleSum());
+
+  h1.recordValue(5);
+  EXPECT_CALL(tls_, runOnAllThreads(_, _));
+  store_->mergeHistograms([]() -> void {});
+  EXPECT_EQ(1UL, h->intervalStatistics().sampleCount());
+  EXPECT_EQ(5UL, h->cumulativeStatistics().sampleCount());
+  EXPECT_EQ(15UL, h->cumulativeStatistics().sampleSum());
+
+  // Merging after shutdown completes immediately without touching the threads.
+  store_->shutdownThreading();
+  merged = false;
+  store_->mergeHistograms([&merged]() -> void { merged = true; });
+  EXPECT_TRUE(merged);
+  tls_.shutdownThread();
+
+  // Includes overflow stat.
+  EXPECT_CALL(*this, free(_));
+}
+
+TEST_F(StatsThreadLocalStoreTest, Tags) {
+  InSequence s;
+  store_->setTagExtractors(TagExtractorImpl::createTagExtractors({}));
+  EXPECT_CALL(*this, alloc(_)).Times(2);
+
+  Counter& c1 = store_->counter("cluster.foo.upstream_rq_200");
+  EXPECT_EQ("cluster.foo.upstream_rq_200", c1.name());
+  EXPECT_EQ("cluster.upstream_rq", c1.tagExtractedName());
+  ASSERT_EQ(2U, c1.tags().size());
+  EXPECT_EQ(TagNames::get().CLUSTER_NAME, c1.tags()[0].name_);
+  EXPECT_EQ("foo", c1.tags()[0].value_);
+  EXPECT_EQ(TagNames::get().RESPONSE_CODE, c1.tags()[1].name_);
+  EXPECT_EQ("200", c1.tags()[1].value_);
+
+  ScopePtr scope = store_->createScope("listener.127.0.0.1:80.");
+  Gauge& g1 = scope->gauge("downstream_cx_active");
+  EXPECT_EQ("listener.downstream_cx_active", g1.tagExtractedName());
+  ASSERT_EQ(1U, g1.tags().size());
+  EXPECT_EQ("127.0.0.1:80", g1.tags()[0].value_);
+
+  Histogram& h1 = store_->histogram("http.ingress.downstream_rq_time");
+  EXPECT_EQ("http.ingress.downstream_rq_time", h1.name());
+  ParentHistogramSharedPtr h =
+      TestUtility::findHistogram(*store_, "http.ingress.downstream_rq_time");
+  EXPECT_EQ("http.downstream_rq_time", h->tagExtractedName());
+  ASSERT_EQ(1U, h->tags().size());
+  EXPECT_EQ("ingress", h->tags()[0].value_);
+
+  store_->shutdownThreading();
+
+  // Includes overflow stat.
+  EXPECT_CALL(*this, free(_)).Times(3);
+}
+
 } // namespace Stats
 } // namespace Envoy
@@ -1,7 +1,10 @@
 #include <chrono>
+#include <string>
+#include <vector>
 
 #include "common/network/address_impl.h"
 #include "common/network/utility.h"
+#include "common/stats/stats_impl.h"
 #include "common/stats/statsd.h"
 
 #include "test/mocks/thread_local/mocks.h"
@@ -33,8 +36,9 @@ TEST_P(UdpStatsdSinkTest, InitWithIpAddress) {
   EXPECT_NE(fd, -1);
 
   // Check that fd has not changed.
-  sink.flushCounter("test_counter", 1);
-  sink.flushGauge("test_gauge", 1);
+  IsolatedStoreImpl store;
+  sink.flushCounter(store.counter("test_counter"), 1);
+  sink.flushGauge(store.gauge("test_gauge"), 1);
   sink.onHistogramComplete("histogram_test_timer", 5);
   sink.onTimespanComplete("test_timer", std::chrono::milliseconds(5));
   EXPECT_EQ(fd, sink.getFdForTests());
@@ -47,6 +51,72 @@ TEST_P(UdpStatsdSinkTest, InitWithIpAddress) {
   tls_.shutdownThread();
 }
 
+// Receive all datagrams already queued on a socket.
+std::vector<std::string> receivePackets(int fd) {
+  std::vector<std::string> packets;
+  char buffer[65536];
+  ssize_t rc;
+  while ((rc = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+    packets.emplace_back(buffer, rc);
+  }
+  return packets;
+}
+
+TEST_P(UdpStatsdSinkTest, Batching) {
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  // Bind a local UDP socket to act as the statsd server.
+  std::pair<Network::Address::InstanceConstSharedPtr, int> server =
+      Network::Test::bindFreeLoopbackPort(GetParam(), Network::Address::SocketType::Datagram);
+  UdpStatsdSink sink(tls_, server.first, 30);
+
+  // Nothing is sent until the flush ends.
+  IsolatedStoreImpl store;
+  sink.beginFlush();
+  sink.flushCounter(store.counter("c1"), 1);
+  sink.flushCounter(store.counter("c2"), 2);
+  sink.flushGauge(store.gauge("g1"), 3);
+  sink.flushGauge(store.gauge("a_gauge_that_is_longer_than_a_packet"), 4);
+  EXPECT_TRUE(receivePackets(server.second).empty());
+  sink.endFlush();
+
+  EXPECT_EQ((std::vector<std::string>{"envoy.c1:1|c\nenvoy.c2:2|c", "envoy.g1:3|g",
+                                      "envoy.a_gauge_that_is_longer_than_a_packet:4|g"}),
+            receivePackets(server.second));
+
+  // Timers are buffered until the packet is flushed.
+  sink.onTimespanComplete("t", std::chrono::milliseconds(5));
+  sink.onHistogramComplete("h", 6);
+  EXPECT_TRUE(receivePackets(server.second).empty());
+  tls_.shutdownThread();
+  EXPECT_EQ((std::vector<std::string>{"envoy.t:5|ms\nenvoy.h:6|ms"}),
+            receivePackets(server.second));
+  close(server.second);
+}
+
+TEST_P(UdpStatsdSinkTest, SendWhenPacketsFill) {
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  std::pair<Network::Address::InstanceConstSharedPtr, int> server =
+      Network::Test::bindFreeLoopbackPort(GetParam(), Network::Address::SocketType::Datagram);
+  UdpStatsdSink sink(tls_, server.first, 30);
+
+  // Each timer takes a packet of its own. The last packet is still being filled, so it is held.
+  for (uint32_t i = 0; i < Writer::MAX_PACKETS_PER_SEND; i++) {
+    sink.onTimespanComplete(fmt::format("timer_{:02}", i), std::chrono::milliseconds(5));
+  }
+  EXPECT_TRUE(receivePackets(server.second).empty());
+
+  // Starting one more packet sends the full ones right away, not on the timer.
+  sink.onTimespanComplete("timer_last", std::chrono::milliseconds(5));
+  std::vector<std::string> packets = receivePackets(server.second);
+  ASSERT_EQ(Writer::MAX_PACKETS_PER_SEND, packets.size());
+  EXPECT_EQ("envoy.timer_00:5|ms", packets.front());
+  EXPECT_EQ("envoy.timer_63:5|ms", packets.back());
+
+  tls_.shutdownThread();
+  EXPECT_EQ((std::vector<std::string>{"envoy.timer_last:5|ms"}), receivePackets(server.second));
+  close(server.second);
+}
+
 } // namespace Statsd
 } // namespace Stats
 } // namespace Envoy
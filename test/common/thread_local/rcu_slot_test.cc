@@ -0,0 +1,195 @@
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/thread_local/rcu_slot.h"
+#include "common/thread_local/thread_local_impl.h"
+
+#include "test/mocks/event/mocks.h"
+
+#include "gmock/gmock.h"
+
+using testing::Invoke;
+using testing::NiceMock;
+using testing::_;
+
+namespace Envoy {
+namespace ThreadLocal {
+namespace {
+
+struct TestVersion {
+  TestVersion(const std::string& name, std::thread::id& destroyed_on)
+      : name_(name), destroyed_on_(destroyed_on) {}
+  ~TestVersion() { destroyed_on_ = std::this_thread::get_id(); }
+
+  const std::string name_;
+  std::thread::id& destroyed_on_;
+};
+
+/**
+ * A thread that runs functions on request, so that its thread local data lives across them.
+ */
+class TestThread {
+public:
+  TestThread() : thread_([this]() -> void { threadRoutine(); }) {}
+  ~TestThread() {
+    run(nullptr);
+    thread_.join();
+  }
+
+  // Run a function on the thread and wait for it to finish. nullptr stops the thread.
+  void run(std::function<void()> function) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    function_ = function;
+    pending_ = true;
+    cv_.notify_all();
+    cv_.wait(lock, [this]() -> bool { return !pending_; });
+  }
+
+private:
+  void threadRoutine() {
+    while (true) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() -> bool { return pending_; });
+      if (!function_) {
+        pending_ = false;
+        cv_.notify_all();
+        return;
+      }
+      function_();
+      pending_ = false;
+      cv_.notify_all();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::function<void()> function_;
+  bool pending_{};
+  std::thread thread_;
+};
+
+} // namespace
+
+class RcuSlotTest : public testing::Test {
+public:
+  RcuSlotTest() {
+    // Posts are queued, and run on the worker thread or the main thread when the test says so.
+    ON_CALL(main_dispatcher_, post(_))
+        .WillByDefault(Invoke([this](Event::PostCb cb) -> void { main_posts_.push_back(cb); }));
+    ON_CALL(thread_dispatcher_, post(_))
+        .WillByDefault(Invoke([this](Event::PostCb cb) -> void { thread_posts_.push_back(cb); }));
+    tls_.registerThread(main_dispatcher_, true);
+    tls_.registerThread(thread_dispatcher_, false);
+  }
+
+  ~RcuSlotTest() {
+    tls_.shutdownGlobalThreading();
+    worker_.run([this]() -> void { tls_.shutdownThread(); });
+    tls_.shutdownThread();
+  }
+
+  std::shared_ptr<const TestVersion> newVersion(const std::string& name) {
+    return std::make_shared<const TestVersion>(name, destroyed_on_);
+  }
+
+  void runWorkerPosts() {
+    std::vector<Event::PostCb> posts;
+    posts.swap(thread_posts_);
+    worker_.run([&posts]() -> void {
+      for (Event::PostCb& post : posts) {
+        post();
+      }
+      posts.clear();
+    });
+  }
+
+  void runMainPosts() {
+    std::vector<Event::PostCb> posts;
+    posts.swap(main_posts_);
+    for (Event::PostCb& post : posts) {
+      post();
+    }
+  }
+
+  std::string workerName(RcuSlot<TestVersion>& rcu) {
+    std::string name;
+    worker_.run([&rcu, &name]() -> void { name = rcu.get().name_; });
+    return name;
+  }
+
+  NiceMock<Event::MockDispatcher> main_dispatcher_;
+  NiceMock<Event::MockDispatcher> thread_dispatcher_;
+  std::vector<Event::PostCb> main_posts_;
+  std::vector<Event::PostCb> thread_posts_;
+  std::thread::id destroyed_on_;
+  InstanceImpl tls_;
+  TestThread worker_;
+};
+
+TEST_F(RcuSlotTest, Publish) {
+  RcuSlot<TestVersion> rcu(tls_, newVersion("v1"));
+  runWorkerPosts();
+  EXPECT_EQ("v1", rcu.get().name_);
+  EXPECT_EQ("v1", workerName(rcu));
+  EXPECT_EQ(0U, rcu.retiredVersions());
+
+  // The main thread switches right away, the worker at its next quiescent point.
+  std::weak_ptr<const TestVersion> v1 = rcu.latest();
+  rcu.publish(newVersion("v2"));
+  EXPECT_EQ(2U, rcu.version());
+  EXPECT_EQ("v2", rcu.get().name_);
+  EXPECT_EQ("v1", workerName(rcu));
+  EXPECT_EQ(1U, rcu.retiredVersions());
+
+  // The grace period of v1 ends once the worker switched, and v1 is freed on the main thread.
+  runWorkerPosts();
+  EXPECT_EQ("v2", workerName(rcu));
+  EXPECT_FALSE(v1.expired());
+  runMainPosts();
+  EXPECT_TRUE(v1.expired());
+  EXPECT_EQ(std::this_thread::get_id(), destroyed_on_);
+  EXPECT_EQ(0U, rcu.retiredVersions());
+}
+
+TEST_F(RcuSlotTest, OverlappingGracePeriods) {
+  RcuSlot<TestVersion> rcu(tls_, newVersion("v1"));
+  runWorkerPosts();
+
+  std::weak_ptr<const TestVersion> v1 = rcu.latest();
+  rcu.publish(newVersion("v2"));
+  std::weak_ptr<const TestVersion> v2 = rcu.latest();
+  rcu.publish(newVersion("v3"));
+  EXPECT_EQ(2U, rcu.retiredVersions());
+  EXPECT_EQ(3U, rcu.version());
+
+  runWorkerPosts();
+  worker_.run([&rcu]() -> void { EXPECT_EQ(3U, rcu.threadVersion()); });
+  runMainPosts();
+  EXPECT_TRUE(v1.expired());
+  EXPECT_TRUE(v2.expired());
+  EXPECT_EQ(0U, rcu.retiredVersions());
+}
+
+TEST_F(RcuSlotTest, DestroyDuringGracePeriod) {
+  std::weak_ptr<const TestVersion> v1;
+  {
+    RcuSlot<TestVersion> rcu(tls_, newVersion("v1"));
+    runWorkerPosts();
+    v1 = rcu.latest();
+    rcu.publish(newVersion("v2"));
+  }
+
+  // The retired version stays alive until the worker is done with it.
+  EXPECT_FALSE(v1.expired());
+  runWorkerPosts();
+  runMainPosts();
+  EXPECT_TRUE(v1.expired());
+}
+
+} // namespace ThreadLocal
+} // namespace Envoy
@@ -1,3 +1,6 @@
+#include <string>
+#include <vector>
+
 #include "common/thread_local/thread_local_impl.h"
 
 #include "test/mocks/event/mocks.h"
@@ -79,5 +82,24 @@ TEST_F(ThreadLocalInstanceImplTest, All) {
   tls_.shutdownThread();
 }
 
+TEST_F(ThreadLocalInstanceImplTest, RunOnAllThreadsWithCompletion) {
+  SlotPtr slot = tls_.allocateSlot();
+
+  // The callback runs on the main thread and then on the worker, which posts the completion back
+  // to the main thread once it is done.
+  InSequence s;
+  std::vector<std::string> events;
+  EXPECT_CALL(thread_dispatcher_, post(_));
+  EXPECT_CALL(main_dispatcher_, post(_));
+  slot->runOnAllThreads([&events]() -> void { events.push_back("cb"); },
+                        [&events]() -> void { events.push_back("complete"); });
+  EXPECT_EQ((std::vector<std::string>{"cb", "cb", "complete"}), events);
+
+  EXPECT_CALL(thread_dispatcher_, post(_));
+  slot.reset();
+  tls_.shutdownGlobalThreading();
+  tls_.shutdownThread();
+}
+
 } // namespace ThreadLocal
 } // namespace Envoy
@@ -232,6 +232,45 @@ TEST_F(LightStepDriverTest, FlushSpansTimer) {
   EXPECT_EQ(1U, stats_.counter("tracing.lightstep.spans_sent").value());
 }
 
+// With a shared report, spans are sent once enough of them are shared, or once the flush timers
+// of all of the workers have fired.
+TEST_F(LightStepDriverTest, FlushSharedReport) {
+  setupValidDriver();
+
+  ON_CALL(runtime_.snapshot_, getInteger("tracing.lightstep.shared_report", 0))
+      .WillByDefault(Return(1));
+  ON_CALL(runtime_.snapshot_, getInteger("tracing.lightstep.min_flush_spans", 5))
+      .WillByDefault(Return(1));
+  ON_CALL(runtime_.snapshot_, getInteger("tracing.lightstep.shared_report_max_spans", 5000))
+      .WillByDefault(Return(2));
+  Tracing::MockFinalizer finalizer;
+  EXPECT_CALL(finalizer, finalize(_)).Times(3);
+  auto finish_span = [&]() -> void {
+    SpanPtr span = driver_->startSpan(config_, request_headers_, operation_name_, start_time_);
+    span->finishSpan(finalizer);
+  };
+
+  finish_span();
+  EXPECT_EQ(0U, stats_.counter("tracing.lightstep.spans_sent").value());
+
+  const Optional<std::chrono::milliseconds> timeout(std::chrono::seconds(5));
+  EXPECT_CALL(cm_.async_client_, send_(_, _, timeout));
+  finish_span();
+  EXPECT_EQ(2U, stats_.counter("tracing.lightstep.spans_sent").value());
+
+  finish_span();
+  EXPECT_EQ(2U, stats_.counter("tracing.lightstep.spans_sent").value());
+
+  EXPECT_CALL(cm_.async_client_, send_(_, _, timeout));
+  timer_->callback_();
+  EXPECT_EQ(3U, stats_.counter("tracing.lightstep.spans_sent").value());
+
+  // Nothing is sent while there are no spans.
+  EXPECT_CALL(cm_.async_client_, send_(_, _, _)).Times(0);
+  timer_->callback_();
+  EXPECT_EQ(3U, stats_.counter("tracing.lightstep.spans_sent").value());
+}
+
 TEST_F(LightStepDriverTest, FlushOneSpanGrpcFailure) {
   setupValidDriver();
 
@@ -0,0 +1,121 @@
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "common/network/utility.h"
+#include "common/tracing/zipkin/span_proto_encoder.h"
+#include "common/tracing/zipkin/zipkin_core_constants.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Zipkin {
+
+namespace {
+
+std::string bytes(std::initializer_list<uint8_t> values) {
+  return std::string(values.begin(), values.end());
+}
+
+Span sharedServerSpan() {
+  Endpoint endpoint("svc", Network::Utility::parseInternetAddressAndPort("1.2.3.4:80"));
+  Span span;
+  span.setTraceId(1);
+  span.setId(2);
+  span.setName("a");
+  span.addAnnotation(Annotation(10, ZipkinCoreConstants::get().SERVER_RECV, endpoint));
+  span.addAnnotation(Annotation(15, ZipkinCoreConstants::get().SERVER_SEND, endpoint));
+  span.addBinaryAnnotation(BinaryAnnotation("k", "v"));
+  return span;
+}
+
+} // namespace
+
+TEST(ZipkinSpanProtoEncoderTest, EmptySpan) {
+  SpanProtoEncoder encoder;
+  std::string output;
+  encoder.encodeSpan(Span(), output);
+  // Only the trace id and the id, which are always present.
+  EXPECT_EQ(bytes({0x0a, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0x1a, 8, 0, 0, 0, 0, 0, 0, 0, 0}), output);
+}
+
+TEST(ZipkinSpanProtoEncoderTest, SharedServerSpan) {
+  const std::string span = bytes({
+      // trace_id
+      0x0a, 8, 0, 0, 0, 0, 0, 0, 0, 1,
+      // id
+      0x1a, 8, 0, 0, 0, 0, 0, 0, 0, 2,
+      // kind: SERVER
+      0x20, 2,
+      // name
+      0x2a, 1, 'a',
+      // timestamp, from the SR annotation
+      0x31, 10, 0, 0, 0, 0, 0, 0, 0,
+      // duration, from the SS annotation
+      0x38, 5,
+      // local_endpoint
+      0x42, 13, 0x0a, 3, 's', 'v', 'c', 0x12, 4, 1, 2, 3, 4, 0x20, 80,
+      // tags
+      0x5a, 6, 0x0a, 1, 'k', 0x12, 1, 'v',
+      // shared
+      0x68, 1,
+  });
+
+  SpanProtoEncoder encoder;
+  std::string output;
+  encoder.encodeSpan(sharedServerSpan(), output);
+  EXPECT_EQ(span, output);
+
+  // The list wraps each span in a length delimited field, and the output is appended to.
+  std::vector<Span> spans{sharedServerSpan(), sharedServerSpan()};
+  output = "x";
+  encoder.encodeListOfSpans(spans, output);
+  const std::string framed = bytes({0x0a, static_cast<uint8_t>(span.size())}) + span;
+  EXPECT_EQ("x" + framed + framed, output);
+}
+
+TEST(ZipkinSpanProtoEncoderTest, ClientSpan) {
+  Endpoint endpoint("svc", Network::Utility::parseInternetAddressAndPort("[::1]:443"));
+  Span span;
+  span.setTraceIdHigh(0x0102030405060708);
+  span.setTraceId(0x1112131415161718);
+  span.setParentId(0x300);
+  span.setId(0x200);
+  span.setTimestamp(0x1234);
+  span.setDuration(300);
+  span.setDebug();
+  span.addAnnotation(Annotation(1, ZipkinCoreConstants::get().CLIENT_SEND, endpoint));
+  span.addAnnotation(Annotation(2, "retry", endpoint));
+  span.addAnnotation(Annotation(3, ZipkinCoreConstants::get().CLIENT_RECV, endpoint));
+
+  const std::string expected = bytes({
+      // 128-bit trace_id, high bits first
+      0x0a, 16, 1, 2, 3, 4, 5, 6, 7, 8, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+      // parent_id
+      0x12, 8, 0, 0, 0, 0, 0, 0, 3, 0,
+      // id
+      0x1a, 8, 0, 0, 0, 0, 0, 0, 2, 0,
+      // kind: CLIENT
+      0x20, 1,
+      // timestamp of the span
+      0x31, 0x34, 0x12, 0, 0, 0, 0, 0, 0,
+      // duration, as a two byte varint
+      0x38, 0xac, 0x02,
+      // local_endpoint with the 16 bytes of the ipv6 address
+      0x42, 26, 0x0a, 3, 's', 'v', 'c', 0x1a, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+      0x20, 0xbb, 0x03,
+      // annotations, without the core ones
+      0x52, 16, 0x09, 2, 0, 0, 0, 0, 0, 0, 0, 0x12, 5, 'r', 'e', 't', 'r', 'y',
+      // debug
+      0x60, 1,
+  });
+
+  SpanProtoEncoder encoder;
+  std::string output;
+  encoder.encodeSpan(span, output);
+  EXPECT_EQ(expected, output);
+}
+
+} // namespace Zipkin
+} // namespace Envoy
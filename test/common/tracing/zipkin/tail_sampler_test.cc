@@ -0,0 +1,150 @@
+#include <chrono>
+#include <vector>
+
+#include "common/tracing/zipkin/tail_sampler.h"
+#include "common/tracing/zipkin/zipkin_core_constants.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Zipkin {
+
+class TestTimeSource : public MonotonicTimeSource {
+public:
+  MonotonicTime currentTime() override { return time_; }
+
+  MonotonicTime time_;
+};
+
+class ZipkinTailSamplerTest : public testing::Test {
+public:
+  // A span that the egress connection manager creates as the child of an incoming context.
+  Span childSpan(uint64_t trace_id, uint64_t id) {
+    Span span;
+    span.setTraceId(trace_id);
+    span.setId(id);
+    span.setParentId(1);
+    span.setDuration(10000);
+    span.addAnnotation(Annotation(0, ZipkinCoreConstants::get().CLIENT_SEND, endpoint_));
+    return span;
+  }
+
+  // A shared context span that the ingress connection manager creates.
+  Span rootSpan(uint64_t trace_id, uint64_t duration_us, bool error = false) {
+    Span span;
+    span.setTraceId(trace_id);
+    span.setId(1);
+    span.addAnnotation(Annotation(1000, ZipkinCoreConstants::get().SERVER_RECV, endpoint_));
+    span.addAnnotation(
+        Annotation(1000 + duration_us, ZipkinCoreConstants::get().SERVER_SEND, endpoint_));
+    if (error) {
+      span.setTag(ZipkinCoreConstants::get().ERROR, "true");
+    }
+    return span;
+  }
+
+  Endpoint endpoint_;
+  TestTimeSource time_source_;
+  TailSampler sampler_{std::chrono::milliseconds(100), std::chrono::milliseconds(1000), 4,
+                       time_source_};
+  std::vector<Span> exported_;
+};
+
+TEST_F(ZipkinTailSamplerTest, LocalRoot) {
+  EXPECT_TRUE(TailSampler::isLocalRoot(rootSpan(1, 0)));
+  EXPECT_FALSE(TailSampler::isLocalRoot(childSpan(1, 2)));
+
+  Span root_without_parent;
+  root_without_parent.addAnnotation(
+      Annotation(0, ZipkinCoreConstants::get().CLIENT_SEND, endpoint_));
+  EXPECT_TRUE(TailSampler::isLocalRoot(root_without_parent));
+
+  EXPECT_EQ(std::chrono::microseconds(250), TailSampler::duration(rootSpan(1, 250)));
+  EXPECT_EQ(std::chrono::microseconds(10000), TailSampler::duration(childSpan(1, 2)));
+  EXPECT_EQ(std::chrono::microseconds(0), TailSampler::duration(Span()));
+}
+
+TEST_F(ZipkinTailSamplerTest, KeepSlowTrace) {
+  EXPECT_EQ(0U, sampler_.onSpan(childSpan(7, 2), exported_));
+  EXPECT_EQ(0U, sampler_.onSpan(childSpan(8, 3), exported_));
+  EXPECT_EQ(0U, sampler_.onSpan(childSpan(7, 4), exported_));
+  EXPECT_TRUE(exported_.empty());
+  EXPECT_EQ(3U, sampler_.bufferedSpans());
+
+  // The root span is exported last, after the buffered spans of its trace.
+  EXPECT_EQ(0U, sampler_.onSpan(rootSpan(7, 100000), exported_));
+  ASSERT_EQ(3U, exported_.size());
+  EXPECT_EQ(2U, exported_[0].id());
+  EXPECT_EQ(4U, exported_[1].id());
+  EXPECT_EQ(1U, exported_[2].id());
+  EXPECT_EQ(1U, sampler_.bufferedSpans());
+}
+
+TEST_F(ZipkinTailSamplerTest, KeepFailedTrace) {
+  sampler_.onSpan(childSpan(7, 2), exported_);
+  EXPECT_EQ(0U, sampler_.onSpan(rootSpan(7, 10, true), exported_));
+  EXPECT_EQ(2U, exported_.size());
+}
+
+TEST_F(ZipkinTailSamplerTest, DiscardFastTrace) {
+  sampler_.onSpan(childSpan(7, 2), exported_);
+  sampler_.onSpan(childSpan(8, 3), exported_);
+  EXPECT_EQ(2U, sampler_.onSpan(rootSpan(7, 99999), exported_));
+  EXPECT_TRUE(exported_.empty());
+  EXPECT_EQ(1U, sampler_.bufferedSpans());
+
+  // A later root span of the same trace does not find the discarded spans.
+  EXPECT_EQ(0U, sampler_.onSpan(rootSpan(7, 100000), exported_));
+  EXPECT_EQ(1U, exported_.size());
+}
+
+TEST_F(ZipkinTailSamplerTest, ExpireAfterWindow) {
+  sampler_.onSpan(childSpan(7, 2), exported_);
+  time_source_.time_ += std::chrono::milliseconds(500);
+  sampler_.onSpan(childSpan(8, 3), exported_);
+  sampler_.onSpan(childSpan(7, 4), exported_);
+
+  // The first trace was buffered a window ago, the second one was not.
+  time_source_.time_ += std::chrono::milliseconds(500);
+  EXPECT_EQ(2U, sampler_.onSpan(rootSpan(7, 100000), exported_));
+  EXPECT_EQ(1U, exported_.size());
+  EXPECT_EQ(1U, sampler_.bufferedSpans());
+
+  time_source_.time_ += std::chrono::milliseconds(500);
+  exported_.clear();
+  EXPECT_EQ(1U, sampler_.onSpan(rootSpan(8, 100000), exported_));
+  EXPECT_EQ(1U, exported_.size());
+  EXPECT_EQ(0U, sampler_.bufferedSpans());
+}
+
+TEST_F(ZipkinTailSamplerTest, EvictOldestTraceWhenFull) {
+  sampler_.onSpan(childSpan(7, 2), exported_);
+  sampler_.onSpan(childSpan(7, 3), exported_);
+  sampler_.onSpan(childSpan(8, 4), exported_);
+  sampler_.onSpan(childSpan(9, 5), exported_);
+  EXPECT_EQ(4U, sampler_.bufferedSpans());
+
+  // The whole oldest trace makes room.
+  EXPECT_EQ(2U, sampler_.onSpan(childSpan(10, 6), exported_));
+  EXPECT_EQ(3U, sampler_.bufferedSpans());
+
+  EXPECT_EQ(0U, sampler_.onSpan(rootSpan(7, 100000), exported_));
+  EXPECT_EQ(1U, exported_.size());
+  exported_.clear();
+  EXPECT_EQ(0U, sampler_.onSpan(rootSpan(8, 100000), exported_));
+  EXPECT_EQ(2U, exported_.size());
+}
+
+TEST_F(ZipkinTailSamplerTest, NoBuffer) {
+  TailSampler sampler(std::chrono::milliseconds(0), std::chrono::milliseconds(1000), 0,
+                      time_source_);
+  EXPECT_EQ(1U, sampler.onSpan(childSpan(7, 2), exported_));
+  EXPECT_EQ(0U, sampler.bufferedSpans());
+
+  // A zero threshold keeps every trace.
+  EXPECT_EQ(0U, sampler.onSpan(rootSpan(7, 0), exported_));
+  EXPECT_EQ(1U, exported_.size());
+}
+
+} // namespace Zipkin
+} // namespace Envoy
@@ -2,6 +2,7 @@
 #include <memory>
 #include <string>
 
+#include "common/common/utility.h"
 #include "common/http/header_map_impl.h"
 #include "common/http/headers.h"
 #include "common/http/message_impl.h"
@@ -126,6 +127,121 @@ TEST_F(ZipkinDriverTest, InitializeDriver) {
 
     setup(*loader, true);
   }
+
+  {
+    // Unknown collector encoding.
+    std::string invalid_config = R"EOF(
+      {
+       "collector_cluster": "fake_cluster",
+       "collector_encoding": "thrift"
+       }
+    )EOF";
+    Json::ObjectSharedPtr loader = Json::Factory::loadFromString(invalid_config);
+
+    EXPECT_THROW_WITH_MESSAGE(setup(*loader, false), EnvoyException,
+                              "unknown zipkin collector encoding 'thrift'");
+  }
+}
+
+TEST_F(ZipkinDriverTest, FlushSpansProto) {
+  EXPECT_CALL(cm_, get("fake_cluster")).WillRepeatedly(Return(&cm_.thread_local_cluster_));
+  std::string proto_config = R"EOF(
+    {
+     "collector_cluster": "fake_cluster",
+     "collector_encoding": "proto"
+     }
+  )EOF";
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(proto_config);
+  setup(*loader, true);
+
+  Http::MockAsyncClientRequest request(&cm_.async_client_);
+  const Optional<std::chrono::milliseconds> timeout(std::chrono::seconds(5));
+  EXPECT_CALL(cm_.async_client_, send_(_, _, timeout))
+      .WillOnce(
+          Invoke([&](Http::MessagePtr& message, Http::AsyncClient::Callbacks&,
+                     const Optional<std::chrono::milliseconds>&) -> Http::AsyncClient::Request* {
+            // The protobuf encoding defaults to the v2 API.
+            EXPECT_STREQ("/api/v2/spans", message->headers().Path()->value().c_str());
+            EXPECT_STREQ("application/x-protobuf",
+                         message->headers().ContentType()->value().c_str());
+
+            // A ListOfSpans, which starts with the tag of the length delimited spans field.
+            const std::string body = TestUtility::bufferToString(*message->body());
+            EXPECT_EQ(0U, body.find('\x0a'));
+
+            return &request;
+          }));
+  EXPECT_CALL(runtime_.snapshot_, getInteger("tracing.zipkin.min_flush_spans", 5))
+      .WillOnce(Return(1));
+
+  Tracing::SpanPtr span =
+      driver_->startSpan(config_, request_headers_, operation_name_, start_time_);
+  Tracing::MockFinalizer finalizer;
+  EXPECT_CALL(finalizer, finalize(_));
+  span->finishSpan(finalizer);
+
+  EXPECT_EQ(1U, stats_.counter("tracing.zipkin.spans_sent").value());
+}
+
+TEST_F(ZipkinDriverTest, SpansDroppedWhenBufferFull) {
+  // The buffer is sized for one span when the reporter is created, and the flush threshold is
+  // raised afterwards.
+  EXPECT_CALL(runtime_.snapshot_, getInteger("tracing.zipkin.min_flush_spans", 5))
+      .WillOnce(Return(1))
+      .WillRepeatedly(Return(10));
+  setupValidDriver();
+
+  EXPECT_CALL(cm_.async_client_, send_(_, _, _)).Times(0);
+  Tracing::MockFinalizer finalizer;
+  for (uint32_t i = 0; i < 3; i++) {
+    Tracing::SpanPtr span =
+        driver_->startSpan(config_, request_headers_, operation_name_, start_time_);
+    EXPECT_CALL(finalizer, finalize(_));
+    span->finishSpan(finalizer);
+  }
+
+  EXPECT_EQ(2U, stats_.counter("tracing.zipkin.spans_dropped").value());
+  EXPECT_EQ(0U, stats_.counter("tracing.zipkin.spans_sent").value());
+
+  // The buffered span is still flushed by the timer.
+  EXPECT_CALL(cm_.async_client_, send_(_, _, _));
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(5000)));
+  timer_->callback_();
+  EXPECT_EQ(1U, stats_.counter("tracing.zipkin.spans_sent").value());
+}
+
+TEST_F(ZipkinDriverTest, TailSampling) {
+  EXPECT_CALL(cm_, get("fake_cluster")).WillRepeatedly(Return(&cm_.thread_local_cluster_));
+  std::string tail_sampling_config = R"EOF(
+    {
+     "collector_cluster": "fake_cluster",
+     "tail_sampling": {"latency_threshold_ms": 60000}
+     }
+  )EOF";
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(tail_sampling_config);
+  ON_CALL(runtime_.snapshot_, getInteger("tracing.zipkin.min_flush_spans", 5))
+      .WillByDefault(Return(1));
+  setup(*loader, true);
+  start_time_ = ProdSystemTimeSource::instance_.currentTime();
+  Tracing::MockFinalizer finalizer;
+
+  // A fast and successful request is not sent.
+  EXPECT_CALL(cm_.async_client_, send_(_, _, _)).Times(0);
+  Tracing::SpanPtr span =
+      driver_->startSpan(config_, request_headers_, operation_name_, start_time_);
+  EXPECT_CALL(finalizer, finalize(_));
+  span->finishSpan(finalizer);
+  EXPECT_EQ(1U, stats_.counter("tracing.zipkin.tail_discarded").value());
+  EXPECT_EQ(0U, stats_.counter("tracing.zipkin.tail_sampled").value());
+
+  // A failed one is.
+  EXPECT_CALL(cm_.async_client_, send_(_, _, _));
+  span = driver_->startSpan(config_, request_headers_, operation_name_, start_time_);
+  span->setTag("error", "true");
+  EXPECT_CALL(finalizer, finalize(_));
+  span->finishSpan(finalizer);
+  EXPECT_EQ(1U, stats_.counter("tracing.zipkin.tail_sampled").value());
+  EXPECT_EQ(1U, stats_.counter("tracing.zipkin.spans_sent").value());
 }
 
 TEST_F(ZipkinDriverTest, FlushSeveralSpans) {
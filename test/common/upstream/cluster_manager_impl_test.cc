@@ -70,6 +70,8 @@ public:
     return CdsApiPtr{createCds_()};
   }
 
+  const std::string& xdsCacheDirectory() override { return xds_cache_directory_; }
+
   ClusterManagerPtr clusterManagerFromProto(const envoy::api::v2::Bootstrap& bootstrap,
                                             Stats::Store& stats, ThreadLocal::Instance& tls,
                                             Runtime::Loader& runtime,
@@ -102,6 +104,7 @@ public:
   Ssl::ContextManagerImpl ssl_context_manager_{runtime_};
   NiceMock<Event::MockDispatcher> dispatcher_;
   LocalInfo::MockLocalInfo local_info_;
+  std::string xds_cache_directory_;
 };
 
 class ClusterManagerImplTest : public testing::Test {
@@ -409,6 +412,58 @@ TEST_F(ClusterManagerImplTest, VerifyBufferLimits) {
   factory_.tls_.shutdownThread();
 }
 
+// Ring hash rings are built on the main thread and shared with the thread local load balancer.
+TEST_F(ClusterManagerImplTest, RingHashSharedRings) {
+  const std::string json = R"EOF(
+  {
+    "clusters": [
+    {
+      "name": "cluster_1",
+      "connect_timeout_ms": 250,
+      "type": "static",
+      "lb_type": "ring_hash",
+      "hosts": [{"url": "tcp://127.0.0.1:11001"}, {"url": "tcp://127.0.0.1:11002"}]
+    }]
+  }
+  )EOF";
+
+  create(parseBootstrapFromJson(json));
+  const Cluster& cluster = cluster_manager_->clusters().begin()->second;
+  ThreadLocalCluster* tls_cluster = cluster_manager_->get("cluster_1");
+  EXPECT_EQ(2UL, tls_cluster->hostSet().hosts().size());
+
+  HostConstSharedPtr host = tls_cluster->loadBalancer().chooseHost(nullptr);
+  EXPECT_TRUE(host == cluster.hosts()[0] || host == cluster.hosts()[1]);
+  factory_.tls_.shutdownThread();
+}
+
+// The worker host sets share the immutable host lists of the primary cluster instead of copies.
+TEST_F(ClusterManagerImplTest, SharedHostLists) {
+  const std::string json = R"EOF(
+  {
+    "clusters": [
+    {
+      "name": "cluster_1",
+      "connect_timeout_ms": 250,
+      "type": "static",
+      "lb_type": "round_robin",
+      "hosts": [{"url": "tcp://127.0.0.1:11001"}, {"url": "tcp://127.0.0.1:11002"}]
+    }]
+  }
+  )EOF";
+
+  create(parseBootstrapFromJson(json));
+  const Cluster& cluster = cluster_manager_->clusters().begin()->second;
+  const HostSet& host_set = cluster_manager_->get("cluster_1")->hostSet();
+  EXPECT_EQ(2UL, host_set.hosts().size());
+  EXPECT_EQ(&cluster.hosts(), &host_set.hosts());
+  EXPECT_EQ(&cluster.healthyHosts(), &host_set.healthyHosts());
+  EXPECT_EQ(&cluster.hostsPerZone(), &host_set.hostsPerZone());
+  EXPECT_EQ(&cluster.healthyHostsPerZone(), &host_set.healthyHostsPerZone());
+  EXPECT_EQ(cluster.hostsPtr(), host_set.hostsPtr());
+  factory_.tls_.shutdownThread();
+}
+
 TEST_F(ClusterManagerImplTest, ShutdownOrder) {
   const std::string json =
       fmt::sprintf("{%s}", clustersJson({defaultStaticClusterJson("cluster_1")}));
@@ -632,6 +687,62 @@ TEST_F(ClusterManagerImplTest, DynamicAddRemove) {
   EXPECT_TRUE(Mock::VerifyAndClearExpectations(cluster2.get()));
 }
 
+TEST_F(ClusterManagerImplTest, ClusterHandle) {
+  const std::string json = R"EOF(
+  {
+    "clusters": []
+  }
+  )EOF";
+
+  create(parseBootstrapFromJson(json));
+
+  // A handle resolves before its cluster exists, and then finds it once it is added.
+  ClusterHandle handle("fake_cluster");
+  EXPECT_EQ(nullptr, cluster_manager_->getByHandle(handle));
+  EXPECT_NE(ClusterHandle::UNRESOLVED, handle.id().load());
+
+  std::shared_ptr<MockCluster> cluster1(new NiceMock<MockCluster>());
+  EXPECT_CALL(factory_, clusterFromProto_(_, _, _, _)).WillOnce(Return(cluster1));
+  EXPECT_TRUE(cluster_manager_->addOrUpdatePrimaryCluster(defaultStaticCluster("fake_cluster")));
+  ThreadLocalCluster* entry1 = cluster_manager_->getByHandle(handle);
+  ASSERT_NE(nullptr, entry1);
+  EXPECT_EQ(cluster1->info_, entry1->info());
+  EXPECT_EQ(entry1, cluster_manager_->get("fake_cluster"));
+
+  // The same name on another handle is the same id.
+  ClusterHandle other_handle("fake_cluster");
+  EXPECT_EQ(entry1, cluster_manager_->getByHandle(other_handle));
+  EXPECT_EQ(handle.id().load(), other_handle.id().load());
+
+  // An update replaces the cluster of the handle.
+  auto update_cluster = defaultStaticCluster("fake_cluster");
+  update_cluster.mutable_per_connection_buffer_limit_bytes()->set_value(12345);
+  std::shared_ptr<MockCluster> cluster2(new NiceMock<MockCluster>());
+  cluster2->hosts_ = {makeTestHost(cluster2->info_, "tcp://127.0.0.1:80")};
+  EXPECT_CALL(factory_, clusterFromProto_(_, _, _, _)).WillOnce(Return(cluster2));
+  EXPECT_TRUE(cluster_manager_->addOrUpdatePrimaryCluster(update_cluster));
+  EXPECT_EQ(cluster2->info_, cluster_manager_->getByHandle(handle)->info());
+
+  Http::ConnectionPool::MockInstance* cp = new Http::ConnectionPool::MockInstance();
+  EXPECT_CALL(factory_, allocateConnPool_(_)).WillOnce(Return(cp));
+  EXPECT_EQ(cp,
+            cluster_manager_->httpConnPoolForHandle(handle, ResourcePriority::Default, nullptr));
+  EXPECT_EQ(cp, cluster_manager_->httpConnPoolForCluster("fake_cluster", ResourcePriority::Default,
+                                                         nullptr));
+
+  // A removed cluster is no longer found by its handle.
+  Http::ConnectionPool::Instance::DrainedCb drained_cb;
+  EXPECT_CALL(*cp, addDrainedCallback(_)).WillOnce(SaveArg<0>(&drained_cb));
+  EXPECT_TRUE(cluster_manager_->removePrimaryCluster("fake_cluster"));
+  EXPECT_EQ(nullptr, cluster_manager_->getByHandle(handle));
+  EXPECT_EQ(nullptr,
+            cluster_manager_->httpConnPoolForHandle(handle, ResourcePriority::Default, nullptr));
+  drained_cb();
+
+  EXPECT_TRUE(Mock::VerifyAndClearExpectations(cluster1.get()));
+  EXPECT_TRUE(Mock::VerifyAndClearExpectations(cluster2.get()));
+}
+
 TEST_F(ClusterManagerImplTest, AddOrUpdatePrimaryClusterStaticExists) {
   const std::string json =
       fmt::sprintf("{%s}", clustersJson({defaultStaticClusterJson("some_cluster")}));
@@ -801,6 +912,106 @@ TEST_F(ClusterManagerImplTest, DynamicHostRemoveDefaultPriority) {
   factory_.tls_.shutdownThread();
 }
 
+// A thread only creates its state for a cluster on first use, from the latest update.
+TEST_F(ClusterManagerImplTest, ThreadLocalClusterCreatedOnFirstUse) {
+  const std::string json = R"EOF(
+  {
+    "clusters": [
+    {
+      "name": "cluster_1",
+      "connect_timeout_ms": 250,
+      "type": "strict_dns",
+      "dns_resolvers": [ "1.2.3.4:80" ],
+      "lb_type": "round_robin",
+      "hosts": [{"url": "tcp://localhost:11001"}]
+    }]
+  }
+  )EOF";
+
+  std::shared_ptr<Network::MockDnsResolver> dns_resolver(new Network::MockDnsResolver());
+  EXPECT_CALL(factory_.dispatcher_, createDnsResolver(_)).WillOnce(Return(dns_resolver));
+
+  Network::DnsResolver::ResolveCb dns_callback;
+  Event::MockTimer* dns_timer_ = new NiceMock<Event::MockTimer>(&factory_.dispatcher_);
+  Network::MockActiveDnsQuery active_dns_query;
+  EXPECT_CALL(*dns_resolver, resolve(_, _, _))
+      .WillRepeatedly(DoAll(SaveArg<2>(&dns_callback), Return(&active_dns_query)));
+  create(parseBootstrapFromJson(json));
+
+  dns_callback(TestUtility::makeDnsResponse({"127.0.0.1", "127.0.0.2"}));
+  dns_timer_->callback_();
+  dns_callback(TestUtility::makeDnsResponse({"127.0.0.2"}));
+
+  const Cluster& cluster = cluster_manager_->clusters().begin()->second;
+  const HostSet& host_set = cluster_manager_->get("cluster_1")->hostSet();
+  EXPECT_EQ(1UL, host_set.hosts().size());
+  EXPECT_EQ(&cluster.hosts(), &host_set.hosts());
+  EXPECT_EQ(cluster.hosts()[0],
+            cluster_manager_->get("cluster_1")->loadBalancer().chooseHost(nullptr));
+
+  dns_timer_->callback_();
+  dns_callback(TestUtility::makeDnsResponse({"127.0.0.2", "127.0.0.3"}));
+  EXPECT_EQ(2UL, host_set.hosts().size());
+  EXPECT_EQ(nullptr, cluster_manager_->get("cluster_2"));
+
+  factory_.tls_.shutdownThread();
+}
+
+// Membership changes within the merge window reach the workers as a single update.
+TEST_F(ClusterManagerImplTest, MergedHostUpdates) {
+  const std::string json = R"EOF(
+  {
+    "clusters": [
+    {
+      "name": "cluster_1",
+      "connect_timeout_ms": 250,
+      "type": "strict_dns",
+      "dns_resolvers": [ "1.2.3.4:80" ],
+      "lb_type": "round_robin",
+      "hosts": [{"url": "tcp://localhost:11001"}]
+    }]
+  }
+  )EOF";
+
+  ON_CALL(factory_.runtime_.snapshot_, getInteger("upstream.update_merge_window_ms", 0))
+      .WillByDefault(Return(100));
+  std::shared_ptr<Network::MockDnsResolver> dns_resolver(new Network::MockDnsResolver());
+  EXPECT_CALL(factory_.dispatcher_, createDnsResolver(_)).WillOnce(Return(dns_resolver));
+
+  Network::DnsResolver::ResolveCb dns_callback;
+  Event::MockTimer* dns_timer_ = new NiceMock<Event::MockTimer>(&factory_.dispatcher_);
+  Network::MockActiveDnsQuery active_dns_query;
+  EXPECT_CALL(*dns_resolver, resolve(_, _, _))
+      .WillRepeatedly(DoAll(SaveArg<2>(&dns_callback), Return(&active_dns_query)));
+  create(parseBootstrapFromJson(json));
+  const HostSet& host_set = cluster_manager_->get("cluster_1")->hostSet();
+
+  Event::MockTimer* merge_timer = new Event::MockTimer(&factory_.dispatcher_);
+  EXPECT_CALL(*merge_timer, enableTimer(std::chrono::milliseconds(100)));
+  dns_callback(TestUtility::makeDnsResponse({"127.0.0.1", "127.0.0.2"}));
+  EXPECT_EQ(0UL, host_set.hosts().size());
+
+  // The window is not extended by the changes that are merged.
+  dns_timer_->callback_();
+  dns_callback(TestUtility::makeDnsResponse({"127.0.0.2", "127.0.0.3"}));
+  EXPECT_EQ(1UL, factory_.stats_.counter("cluster_manager.update_merged").value());
+  EXPECT_EQ(0UL, host_set.hosts().size());
+
+  merge_timer->callback_();
+  EXPECT_EQ(2UL, host_set.hosts().size());
+  EXPECT_EQ(&cluster_manager_->clusters().begin()->second.get().hosts(), &host_set.hosts());
+
+  // The next change starts a new window.
+  EXPECT_CALL(*merge_timer, enableTimer(std::chrono::milliseconds(100)));
+  dns_timer_->callback_();
+  dns_callback(TestUtility::makeDnsResponse({"127.0.0.2"}));
+  EXPECT_EQ(2UL, host_set.hosts().size());
+  merge_timer->callback_();
+  EXPECT_EQ(1UL, host_set.hosts().size());
+
+  factory_.tls_.shutdownThread();
+}
+
 TEST_F(ClusterManagerImplTest, OriginalDstInitialization) {
   const std::string json = R"EOF(
   {
@@ -953,6 +1164,74 @@ TEST(ClusterManagerInitHelper, RemoveClusterWithinInitLoop) {
   init_helper.onStaticLoadComplete();
 }
 
+TEST(ClusterManagerInitHelper, MaxConcurrentSecondaryInit) {
+  InSequence s;
+  ClusterManagerInitHelper init_helper;
+  init_helper.setMaxConcurrentSecondaryInit(2);
+
+  ReadyWatcher cm_initialized;
+  init_helper.setInitializedCb([&]() -> void { cm_initialized.ready(); });
+
+  NiceMock<MockCluster> cluster1;
+  NiceMock<MockCluster> cluster2;
+  NiceMock<MockCluster> cluster3;
+  NiceMock<MockCluster> cluster4;
+  for (NiceMock<MockCluster>* cluster : {&cluster1, &cluster2, &cluster3, &cluster4}) {
+    ON_CALL(*cluster, initializePhase())
+        .WillByDefault(Return(Cluster::InitializePhase::Secondary));
+    init_helper.addCluster(*cluster);
+  }
+
+  EXPECT_CALL(cluster1, initialize());
+  EXPECT_CALL(cluster2, initialize());
+  init_helper.onStaticLoadComplete();
+
+  // A cluster removed before it starts is not initialized.
+  init_helper.removeCluster(cluster3);
+
+  EXPECT_CALL(cluster4, initialize());
+  cluster2.initialize_callback_();
+
+  cluster1.initialize_callback_();
+  EXPECT_CALL(cm_initialized, ready());
+  cluster4.initialize_callback_();
+}
+
+TEST(ClusterManagerInitHelper, CriticalClusters) {
+  InSequence s;
+  ClusterManagerInitHelper init_helper;
+  init_helper.setCriticalClusters({"critical"});
+
+  MockCdsApi cds;
+  EXPECT_CALL(cds, setInitializedCb(_));
+  init_helper.setCds(&cds);
+
+  ReadyWatcher cm_initialized;
+  init_helper.setInitializedCb([&]() -> void { cm_initialized.ready(); });
+
+  NiceMock<MockCluster> critical;
+  ON_CALL(critical, initializePhase()).WillByDefault(Return(Cluster::InitializePhase::Primary));
+  critical.info_->name_ = "critical";
+  EXPECT_CALL(critical, initialize());
+  init_helper.addCluster(critical);
+
+  NiceMock<MockCluster> other;
+  ON_CALL(other, initializePhase()).WillByDefault(Return(Cluster::InitializePhase::Primary));
+  other.info_->name_ = "other";
+  EXPECT_CALL(other, initialize());
+  init_helper.addCluster(other);
+
+  init_helper.onStaticLoadComplete();
+
+  // Initialization is reported once the critical cluster is done, and only once.
+  EXPECT_CALL(cm_initialized, ready());
+  critical.initialize_callback_();
+
+  EXPECT_CALL(cds, initialize());
+  other.initialize_callback_();
+  cds.initialized_callback_();
+}
+
 } // namespace
 } // namespace Upstream
 } // namespace Envoy
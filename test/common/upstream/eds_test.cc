@@ -167,5 +167,68 @@ TEST_F(EdsTest, EndpointMetadata) {
   EXPECT_TRUE(hosts[1]->canary());
 }
 
+// Validate that onConfigUpdate() applies the endpoint health status, also to existing hosts.
+TEST_F(EdsTest, EndpointHealthStatus) {
+  Protobuf::RepeatedPtrField<envoy::api::v2::ClusterLoadAssignment> resources;
+  auto* cluster_load_assignment = resources.Add();
+  cluster_load_assignment->set_cluster_name("fare");
+  auto* endpoints = cluster_load_assignment->add_endpoints();
+
+  auto* healthy = endpoints->add_lb_endpoints();
+  healthy->mutable_endpoint()->mutable_address()->mutable_socket_address()->set_address("1.2.3.4");
+  healthy->set_health_status(envoy::api::v2::HealthStatus::HEALTHY);
+  auto* unhealthy = endpoints->add_lb_endpoints();
+  unhealthy->mutable_endpoint()->mutable_address()->mutable_socket_address()->set_address(
+      "2.3.4.5");
+  unhealthy->set_health_status(envoy::api::v2::HealthStatus::UNHEALTHY);
+
+  EXPECT_NO_THROW(cluster_->onConfigUpdate(resources));
+  EXPECT_EQ(2UL, cluster_->hosts().size());
+  EXPECT_TRUE(cluster_->hosts()[0]->healthy());
+  EXPECT_TRUE(cluster_->hosts()[1]->healthFlagGet(Host::HealthFlag::FAILED_EDS_HEALTH));
+  EXPECT_EQ(1UL, cluster_->healthyHosts().size());
+
+  unhealthy->set_health_status(envoy::api::v2::HealthStatus::UNKNOWN);
+  healthy->set_health_status(envoy::api::v2::HealthStatus::DRAINING);
+  EXPECT_NO_THROW(cluster_->onConfigUpdate(resources));
+  EXPECT_TRUE(cluster_->hosts()[0]->healthFlagGet(Host::HealthFlag::FAILED_EDS_HEALTH));
+  EXPECT_TRUE(cluster_->hosts()[1]->healthy());
+  EXPECT_EQ(1UL, cluster_->healthyHosts().size());
+  EXPECT_EQ(cluster_->hosts()[1], cluster_->healthyHosts()[0]);
+}
+
+// Validate that an unchanged ClusterLoadAssignment does not rebuild the hosts, and that a changed
+// one keeps the hosts that are still there.
+TEST_F(EdsTest, OnConfigUpdateNoRebuild) {
+  Protobuf::RepeatedPtrField<envoy::api::v2::ClusterLoadAssignment> resources;
+  auto* cluster_load_assignment = resources.Add();
+  cluster_load_assignment->set_cluster_name("fare");
+  auto* endpoints = cluster_load_assignment->add_endpoints();
+  for (const char* address : {"1.2.3.4", "2.3.4.5", "3.4.5.6"}) {
+    auto* endpoint = endpoints->add_lb_endpoints()->mutable_endpoint();
+    endpoint->mutable_address()->mutable_socket_address()->set_address(address);
+  }
+
+  EXPECT_NO_THROW(cluster_->onConfigUpdate(resources));
+  const std::vector<HostSharedPtr> hosts = cluster_->hosts();
+  EXPECT_EQ(3UL, hosts.size());
+  EXPECT_EQ(1UL, stats_.counter("cluster.name.membership_change").value());
+
+  EXPECT_NO_THROW(cluster_->onConfigUpdate(resources));
+  EXPECT_EQ(1UL, stats_.counter("cluster.name.update_no_rebuild").value());
+  EXPECT_EQ(1UL, stats_.counter("cluster.name.membership_change").value());
+  EXPECT_EQ(hosts, cluster_->hosts());
+
+  auto* endpoint = endpoints->mutable_lb_endpoints(1)->mutable_endpoint();
+  endpoint->mutable_address()->mutable_socket_address()->set_address("4.5.6.7");
+  EXPECT_NO_THROW(cluster_->onConfigUpdate(resources));
+  EXPECT_EQ(1UL, stats_.counter("cluster.name.update_no_rebuild").value());
+  EXPECT_EQ(2UL, stats_.counter("cluster.name.membership_change").value());
+  ASSERT_EQ(3UL, cluster_->hosts().size());
+  EXPECT_EQ(hosts[0], cluster_->hosts()[0]);
+  EXPECT_EQ("4.5.6.7:0", cluster_->hosts()[1]->address()->asString());
+  EXPECT_EQ(hosts[2], cluster_->hosts()[2]);
+}
+
 } // namespace Upstream
 } // namespace Envoy
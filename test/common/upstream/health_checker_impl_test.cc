@@ -14,6 +14,7 @@
 
 #include "test/common/http/common.h"
 #include "test/common/upstream/utility.h"
+#include "test/mocks/local_info/mocks.h"
 #include "test/mocks/network/mocks.h"
 #include "test/mocks/redis/mocks.h"
 #include "test/mocks/runtime/mocks.h"
@@ -24,6 +25,7 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+using testing::AnyNumber;
 using testing::DoAll;
 using testing::InSequence;
 using testing::Invoke;
@@ -61,9 +63,10 @@ TEST(HealthCheckerFactoryTest, createRedis) {
   Runtime::MockLoader runtime;
   Runtime::MockRandomGenerator random;
   Event::MockDispatcher dispatcher;
+  NiceMock<LocalInfo::MockLocalInfo> local_info;
   EXPECT_NE(nullptr, dynamic_cast<RedisHealthCheckerImpl*>(
                          HealthCheckerFactory::create(parseHealthCheckFromJson(json), cluster,
-                                                      runtime, random, dispatcher)
+                                                      runtime, random, dispatcher, local_info)
                              .get()));
 }
 
@@ -75,19 +78,23 @@ TEST(HealthCheckerFactoryTest, MissingFieldiException) {
   Runtime::MockLoader runtime;
   Runtime::MockRandomGenerator random;
   Event::MockDispatcher dispatcher;
+  NiceMock<LocalInfo::MockLocalInfo> local_info;
   envoy::api::v2::HealthCheck health_check;
   // No health checker type set
-  EXPECT_THROW(HealthCheckerFactory::create(health_check, cluster, runtime, random, dispatcher),
+  EXPECT_THROW(HealthCheckerFactory::create(health_check, cluster, runtime, random, dispatcher,
+                                           local_info),
                EnvoyException);
   health_check.mutable_http_health_check();
   // No timeout field set.
-  EXPECT_THROW(HealthCheckerFactory::create(health_check, cluster, runtime, random, dispatcher),
+  EXPECT_THROW(HealthCheckerFactory::create(health_check, cluster, runtime, random, dispatcher,
+                                           local_info),
                MissingFieldException);
 }
 
 class TestHttpHealthCheckerImpl : public HttpHealthCheckerImpl {
 public:
   using HttpHealthCheckerImpl::HttpHealthCheckerImpl;
+  using HttpHealthCheckerImpl::codecClientType;
 
   Http::CodecClient* createCodecClient(Upstream::Host::CreateConnectionData& conn_data) override {
     return createCodecClient_(conn_data);
@@ -113,7 +120,10 @@ public:
 
   typedef std::unique_ptr<TestSession> TestSessionPtr;
 
-  HttpHealthCheckerImplTest() : cluster_(new NiceMock<MockCluster>()) {}
+  HttpHealthCheckerImplTest() : cluster_(new NiceMock<MockCluster>()) {
+    EXPECT_CALL(runtime_.snapshot_, getInteger("health_check.subset_percent", 100))
+        .Times(AnyNumber());
+  }
 
   void setupNoServiceValidationHC() {
     std::string json = R"EOF(
@@ -171,8 +181,10 @@ public:
 
     auto* codec = test_session.codec_ = new NiceMock<Http::MockClientConnection>();
     test_session.client_connection_ = new NiceMock<Network::MockClientConnection>();
-    auto create_codec_client = [codec](Upstream::Host::CreateConnectionData& conn_data) {
-      return new CodecClientForTest(std::move(conn_data.connection_), codec, nullptr, nullptr);
+    const Http::CodecClient::Type type = codec_client_type_;
+    auto create_codec_client = [codec, type](Upstream::Host::CreateConnectionData& conn_data) {
+      return new CodecClientForTest(std::move(conn_data.connection_), codec, nullptr, nullptr,
+                                    type);
     };
 
     EXPECT_CALL(dispatcher_, createClientConnection_(_, _))
@@ -221,6 +233,7 @@ public:
   std::shared_ptr<TestHttpHealthCheckerImpl> health_checker_;
   NiceMock<Runtime::MockLoader> runtime_;
   NiceMock<Runtime::MockRandomGenerator> random_;
+  Http::CodecClient::Type codec_client_type_{Http::CodecClient::Type::HTTP1};
 };
 
 TEST_F(HttpHealthCheckerImplTest, Success) {
@@ -456,6 +469,36 @@ TEST_F(HttpHealthCheckerImplTest, SuccessStartFailedFailFirst) {
   EXPECT_TRUE(cluster_->hosts_[0]->healthy());
 }
 
+TEST_F(HttpHealthCheckerImplTest, SubsetInterval) {
+  setupNoServiceValidationHC();
+  cluster_->hosts_ = {makeTestHost(cluster_->info_, "tcp://127.0.0.1:80")};
+  cluster_->info_->stats().upstream_cx_total_.inc();
+  expectSessionCreate();
+  expectStreamCreate(0);
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  health_checker_->start();
+
+  // No host is in the subset, so a healthy host is checked 100 times less often.
+  EXPECT_CALL(runtime_.snapshot_, getInteger("health_check.subset_percent", 100))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*this, onHostStatus(_, false));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(std::chrono::milliseconds(100000)));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respond(0, "200", false);
+  EXPECT_TRUE(cluster_->hosts_[0]->healthy());
+
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  expectStreamCreate(0);
+  test_sessions_[0]->interval_timer_->callback_();
+
+  // An unhealthy host is checked at the full rate.
+  EXPECT_CALL(*this, onHostStatus(_, true));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(std::chrono::milliseconds(1000)));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respond(0, "503", false);
+  EXPECT_FALSE(cluster_->hosts_[0]->healthy());
+}
+
 TEST_F(HttpHealthCheckerImplTest, HttpFail) {
   setupNoServiceValidationHC();
   cluster_->hosts_ = {makeTestHost(cluster_->info_, "tcp://127.0.0.1:80")};
@@ -549,6 +592,76 @@ TEST_F(HttpHealthCheckerImplTest, Timeout) {
   EXPECT_FALSE(cluster_->hosts_[0]->healthy());
 }
 
+TEST_F(HttpHealthCheckerImplTest, Http2Timeout) {
+  setupNoServiceValidationHC();
+  codec_client_type_ = Http::CodecClient::Type::HTTP2;
+  cluster_->hosts_ = {makeTestHost(cluster_->info_, "tcp://127.0.0.1:80")};
+  expectSessionCreate();
+  expectStreamCreate(0);
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  health_checker_->start();
+
+  // Only the timed out stream is reset, the connection is kept for the next check.
+  EXPECT_CALL(test_sessions_[0]->request_encoder_.stream_,
+              resetStream(Http::StreamResetReason::LocalReset));
+  EXPECT_CALL(*test_sessions_[0]->client_connection_, close(_)).Times(0);
+  EXPECT_CALL(*this, onHostStatus(_, false));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(_));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  test_sessions_[0]->timeout_timer_->callback_();
+  EXPECT_TRUE(cluster_->hosts_[0]->healthy());
+
+  expectStreamCreate(0);
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  test_sessions_[0]->interval_timer_->callback_();
+
+  EXPECT_CALL(*this, onHostStatus(_, false));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(_));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respond(0, "200", false);
+  EXPECT_TRUE(cluster_->hosts_[0]->healthy());
+}
+
+TEST_F(HttpHealthCheckerImplTest, CodecClientType) {
+  setupNoServiceValidationHC();
+  EXPECT_EQ(Http::CodecClient::Type::HTTP1, health_checker_->codecClientType());
+
+  ON_CALL(*cluster_->info_, features())
+      .WillByDefault(Return(Upstream::ClusterInfo::Features::HTTP2));
+  EXPECT_EQ(Http::CodecClient::Type::HTTP1, health_checker_->codecClientType());
+
+  ON_CALL(runtime_.snapshot_, featureEnabled("health_check.use_http2", 0))
+      .WillByDefault(Return(true));
+  EXPECT_EQ(Http::CodecClient::Type::HTTP2, health_checker_->codecClientType());
+}
+
+TEST_F(HttpHealthCheckerImplTest, FirstIntervalSpread) {
+  setupNoServiceValidationHC();
+  cluster_->hosts_ = {makeTestHost(cluster_->info_, "tcp://127.0.0.1:80")};
+  cluster_->info_->stats().upstream_cx_total_.inc();
+  expectSessionCreate();
+  expectStreamCreate(0);
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  health_checker_->start();
+
+  // The interval after the first check is extended by a random part of itself: 1000ms plus 700ms
+  // of jitter, plus 1000ms.
+  ON_CALL(random_, random()).WillByDefault(Return(2700));
+  EXPECT_CALL(*this, onHostStatus(_, false));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(std::chrono::milliseconds(2700)));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respond(0, "200", false);
+
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  expectStreamCreate(0);
+  test_sessions_[0]->interval_timer_->callback_();
+
+  EXPECT_CALL(*this, onHostStatus(_, false));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(std::chrono::milliseconds(1700)));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respond(0, "200", false);
+}
+
 TEST_F(HttpHealthCheckerImplTest, DynamicAddAndRemove) {
   setupNoServiceValidationHC();
   health_checker_->start();
@@ -565,6 +678,69 @@ TEST_F(HttpHealthCheckerImplTest, DynamicAddAndRemove) {
   cluster_->runCallbacks({}, removed);
 }
 
+TEST_F(HttpHealthCheckerImplTest, DispatchedHealthChecker) {
+  std::string json = R"EOF(
+    {
+      "type": "http",
+      "timeout_ms": 1000,
+      "interval_ms": 1000,
+      "unhealthy_threshold": 2,
+      "healthy_threshold": 2,
+      "path": "/healthcheck"
+    }
+    )EOF";
+
+  health_checker_.reset(new TestHttpHealthCheckerImpl(*cluster_, parseHealthCheckFromJson(json),
+                                                      dispatcher_, runtime_, random_));
+  NiceMock<Event::MockDispatcher> main_dispatcher;
+  HealthCheckerSharedPtr dispatched_health_checker =
+      DispatchedHealthChecker::create(health_checker_, dispatcher_, main_dispatcher);
+  dispatched_health_checker->addHostCheckCompleteCb([this](HostSharedPtr host,
+                                                           bool changed_state) -> void {
+    onHostStatus(host, changed_state);
+  });
+
+  // start() is posted to the health check dispatcher.
+  std::vector<Event::PostCb> health_check_posts;
+  EXPECT_CALL(dispatcher_, post(_))
+      .WillRepeatedly(Invoke([&health_check_posts](Event::PostCb callback) -> void {
+        health_check_posts.push_back(callback);
+      }));
+  cluster_->hosts_ = {makeTestHost(cluster_->info_, "tcp://127.0.0.1:80")};
+  dispatched_health_checker->start();
+  ASSERT_EQ(1U, health_check_posts.size());
+
+  expectSessionCreate();
+  expectStreamCreate(0);
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  health_check_posts[0]();
+
+  // The results are posted back to the main thread, where the callbacks run.
+  Event::PostCb main_post;
+  EXPECT_CALL(main_dispatcher, post(_)).WillOnce(SaveArg<0>(&main_post));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(_));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respond(0, "200", false, true);
+  EXPECT_CALL(*this, onHostStatus(cluster_->hosts_[0], false));
+  main_post();
+
+  expectStreamCreate(0);
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  test_sessions_[0]->interval_timer_->callback_();
+  EXPECT_CALL(main_dispatcher, post(_)).WillOnce(SaveArg<0>(&main_post));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(_));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respond(0, "200", false, true);
+
+  // Once the dispatched health checker is gone, the results that are still on their way to the
+  // main thread are dropped, and the health checker is released on its own dispatcher.
+  dispatched_health_checker.reset();
+  main_post();
+  ASSERT_EQ(2U, health_check_posts.size());
+  health_check_posts[1]();
+  EXPECT_EQ(1, health_checker_.use_count());
+}
+
 TEST_F(HttpHealthCheckerImplTest, ConnectionClose) {
   setupNoServiceValidationHC();
   EXPECT_CALL(*this, onHostStatus(_, false));
@@ -713,6 +889,41 @@ TEST(TcpHealthCheckMatcher, match) {
   EXPECT_TRUE(TcpHealthCheckMatcher::match(segments, buffer));
 }
 
+TEST(TcpHealthCheckMatcher, matchProgress) {
+  Protobuf::RepeatedPtrField<envoy::api::v2::HealthCheck::Payload> repeated_payload;
+  repeated_payload.Add()->set_text("0102");
+  repeated_payload.Add()->set_text("03");
+
+  TcpHealthCheckMatcher::MatchSegments segments =
+      TcpHealthCheckMatcher::loadProtoBytes(repeated_payload);
+  TcpHealthCheckMatcher::MatchProgress progress;
+
+  // The first segment is split across two reads.
+  Buffer::OwnedImpl buffer;
+  add_uint8(buffer, 0);
+  add_uint8(buffer, 1);
+  EXPECT_FALSE(TcpHealthCheckMatcher::match(segments, buffer, progress));
+  EXPECT_EQ(0U, progress.segments_);
+  EXPECT_EQ(1U, progress.start_);
+
+  Buffer::OwnedImpl second_read;
+  add_uint8(second_read, 2);
+  add_uint8(second_read, 4);
+  buffer.move(second_read);
+  EXPECT_FALSE(TcpHealthCheckMatcher::match(segments, buffer, progress));
+  EXPECT_EQ(1U, progress.segments_);
+  EXPECT_EQ(4U, progress.start_);
+
+  add_uint8(buffer, 3);
+  EXPECT_TRUE(TcpHealthCheckMatcher::match(segments, buffer, progress));
+  EXPECT_TRUE(TcpHealthCheckMatcher::match(segments, buffer));
+
+  buffer.drain(buffer.length());
+  progress.reset();
+  EXPECT_FALSE(TcpHealthCheckMatcher::match(segments, buffer, progress));
+  EXPECT_EQ(0U, progress.start_);
+}
+
 class TcpHealthCheckerImplTest : public testing::Test {
 public:
   TcpHealthCheckerImplTest() : cluster_(new NiceMock<MockCluster>()) {}
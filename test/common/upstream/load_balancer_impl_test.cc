@@ -3,6 +3,8 @@
 #include <string>
 #include <vector>
 
+#include "common/config/metadata.h"
+#include "common/config/well_known_names.h"
 #include "common/network/utility.h"
 #include "common/upstream/load_balancer_impl.h"
 #include "common/upstream/upstream_impl.h"
@@ -64,6 +66,34 @@ TEST_F(RoundRobinLoadBalancerTest, Normal) {
   EXPECT_EQ(cluster_.healthy_hosts_[0], lb_->chooseHost(nullptr));
 }
 
+// Hosts at the per host circuit breakers are skipped, and nothing is picked when all are.
+TEST_F(RoundRobinLoadBalancerTest, SaturatedHosts) {
+  init(false);
+  cluster_.healthy_hosts_ = {makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                             makeTestHost(cluster_.info_, "tcp://127.0.0.1:81"),
+                             makeTestHost(cluster_.info_, "tcp://127.0.0.1:82")};
+  cluster_.hosts_ = cluster_.healthy_hosts_;
+  cluster_.info_->max_host_requests_ = 2;
+  cluster_.info_->max_host_connections_ = 1;
+  cluster_.healthy_hosts_[0]->stats().rq_active_.set(2);
+  cluster_.healthy_hosts_[2]->stats().cx_active_.set(1);
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_->chooseHost(nullptr));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_->chooseHost(nullptr));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_->chooseHost(nullptr));
+  EXPECT_EQ(3U, stats_.lb_host_saturated_.value());
+
+  cluster_.healthy_hosts_[1]->stats().rq_active_.set(2);
+  EXPECT_EQ(nullptr, lb_->chooseHost(nullptr));
+  EXPECT_EQ(6U, stats_.lb_host_saturated_.value());
+  EXPECT_EQ(1U, stats_.upstream_rq_host_overflow_.value());
+
+  // The limits are off by default.
+  cluster_.info_->max_host_requests_ = 0;
+  cluster_.info_->max_host_connections_ = 0;
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_->chooseHost(nullptr));
+  EXPECT_EQ(6U, stats_.lb_host_saturated_.value());
+}
+
 TEST_F(RoundRobinLoadBalancerTest, MaxUnhealthyPanic) {
   init(false);
   cluster_.healthy_hosts_ = {makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
@@ -244,6 +274,91 @@ TEST_F(RoundRobinLoadBalancerTest, ZoneAwareRoutingSmallZone) {
   EXPECT_EQ(1U, stats_.lb_zone_routing_cross_zone_.value());
 }
 
+TEST_F(RoundRobinLoadBalancerTest, SharedZoneRouting) {
+  local_cluster_hosts_.reset(new HostSetImpl());
+  RoundRobinLoadBalancer lb(cluster_, local_cluster_hosts_.get(), stats_, runtime_, random_,
+                            nullptr);
+
+  HostVectorSharedPtr upstream_hosts(
+      new std::vector<HostSharedPtr>({makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                                      makeTestHost(cluster_.info_, "tcp://127.0.0.1:81"),
+                                      makeTestHost(cluster_.info_, "tcp://127.0.0.1:82"),
+                                      makeTestHost(cluster_.info_, "tcp://127.0.0.1:83"),
+                                      makeTestHost(cluster_.info_, "tcp://127.0.0.1:84")}));
+  HostVectorSharedPtr local_hosts(
+      new std::vector<HostSharedPtr>({makeTestHost(cluster_.info_, "tcp://127.0.0.1:0"),
+                                      makeTestHost(cluster_.info_, "tcp://127.0.0.1:1"),
+                                      makeTestHost(cluster_.info_, "tcp://127.0.0.1:2")}));
+
+  HostListsSharedPtr upstream_hosts_per_zone(new std::vector<std::vector<HostSharedPtr>>(
+      {{makeTestHost(cluster_.info_, "tcp://127.0.0.1:81")},
+       {makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+        makeTestHost(cluster_.info_, "tcp://127.0.0.1:82")},
+       {makeTestHost(cluster_.info_, "tcp://127.0.0.1:83"),
+        makeTestHost(cluster_.info_, "tcp://127.0.0.1:84")}}));
+
+  HostListsSharedPtr local_hosts_per_zone(new std::vector<std::vector<HostSharedPtr>>(
+      {{makeTestHost(cluster_.info_, "tcp://127.0.0.1:0")},
+       {makeTestHost(cluster_.info_, "tcp://127.0.0.1:1")},
+       {makeTestHost(cluster_.info_, "tcp://127.0.0.1:2")}}));
+
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.healthy_panic_threshold", 50))
+      .WillRepeatedly(Return(50));
+  EXPECT_CALL(runtime_.snapshot_, featureEnabled("upstream.zone_routing.enabled", 100))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.zone_routing.min_cluster_size", 6))
+      .WillRepeatedly(Return(5));
+
+  cluster_.healthy_hosts_ = *upstream_hosts;
+  cluster_.hosts_ = *upstream_hosts;
+  cluster_.healthy_hosts_per_zone_ = *upstream_hosts_per_zone;
+  cluster_.runCallbacks({}, {});
+  local_cluster_hosts_->updateHosts(local_hosts, local_hosts, local_hosts_per_zone,
+                                    local_hosts_per_zone, empty_host_vector_, empty_host_vector_);
+
+  // Membership updates do not recompute zone routing, so there is no zone aware routing yet.
+  EXPECT_EQ(cluster_.healthy_hosts_[0], lb.chooseHost(nullptr));
+  EXPECT_EQ(0U, stats_.lb_recalculate_zone_structures_.value());
+
+  LoadBalancerBase::ZoneRoutingConstSharedPtr zone_routing =
+      LoadBalancerBase::createZoneRouting(cluster_, *local_cluster_hosts_, stats_, runtime_);
+  EXPECT_EQ(1U, stats_.lb_recalculate_zone_structures_.value());
+  EXPECT_EQ(LoadBalancerBase::ZoneRouting::State::ZoneResidual, zone_routing->state_);
+  EXPECT_EQ(3U, zone_routing->num_zones_);
+  lb.setZoneRouting(zone_routing);
+
+  EXPECT_CALL(random_, random()).WillOnce(Return(100));
+  EXPECT_EQ(cluster_.healthy_hosts_per_zone_[0][0], lb.chooseHost(nullptr));
+  EXPECT_EQ(1U, stats_.lb_zone_routing_sampled_.value());
+
+  EXPECT_CALL(random_, random()).WillOnce(Return(9999)).WillOnce(Return(2));
+  EXPECT_EQ(cluster_.healthy_hosts_per_zone_[1][0], lb.chooseHost(nullptr));
+  EXPECT_EQ(1U, stats_.lb_zone_routing_cross_zone_.value());
+
+  // Zone routing computed for a different number of zones than the host set has is ignored.
+  cluster_.healthy_hosts_per_zone_.pop_back();
+  EXPECT_EQ(cluster_.healthy_hosts_[3], lb.chooseHost(nullptr));
+  EXPECT_EQ(1U, stats_.lb_zone_routing_cross_zone_.value());
+
+  lb.setZoneRouting(nullptr);
+  EXPECT_EQ(cluster_.healthy_hosts_[4], lb.chooseHost(nullptr));
+}
+
+TEST(ZoneRoutingTest, ResidualCapacityZone) {
+  LoadBalancerBase::ZoneRouting zone_routing;
+  zone_routing.residual_capacity_ = {0, 10000, 15000};
+  EXPECT_EQ(1U, zone_routing.residualCapacityZone(1));
+  EXPECT_EQ(1U, zone_routing.residualCapacityZone(10000));
+  EXPECT_EQ(2U, zone_routing.residualCapacityZone(10001));
+  EXPECT_EQ(2U, zone_routing.residualCapacityZone(14999));
+
+  // Zones without residual capacity are skipped.
+  zone_routing.residual_capacity_ = {0, 0, 0, 5000, 5000, 6000};
+  EXPECT_EQ(3U, zone_routing.residualCapacityZone(1));
+  EXPECT_EQ(3U, zone_routing.residualCapacityZone(5000));
+  EXPECT_EQ(5U, zone_routing.residualCapacityZone(5001));
+}
+
 TEST_F(RoundRobinLoadBalancerTest, LowPrecisionForDistribution) {
   init(true);
 
@@ -375,6 +490,131 @@ TEST_F(RoundRobinLoadBalancerTest, NoZoneAwareRoutingLocalEmpty) {
   EXPECT_EQ(1U, stats_.lb_local_cluster_not_ok_.value());
 }
 
+class PriorityLoadBalancerTest : public testing::Test {
+public:
+  PriorityLoadBalancerTest() : stats_(ClusterInfoImpl::generateStats(stats_store_)) {}
+
+  HostSharedPtr makeHost(const std::string& url, uint32_t priority, const std::string& zone = "",
+                         uint32_t locality_weight = 0) {
+    envoy::api::v2::Metadata metadata;
+    const std::string& filter = Config::MetadataFilters::get().ENVOY_LB;
+    Config::Metadata::mutableMetadataValue(metadata, filter,
+                                           Config::MetadataEnvoyLbKeys::get().PRIORITY)
+        .set_number_value(priority);
+    Config::Metadata::mutableMetadataValue(metadata, filter,
+                                           Config::MetadataEnvoyLbKeys::get().LOCALITY_WEIGHT)
+        .set_number_value(locality_weight);
+    return HostSharedPtr{
+        new HostImpl(cluster_.info_, "", Network::Utility::resolveUrl(url), metadata, 1, zone)};
+  }
+
+  std::vector<uint64_t> load() {
+    return LoadBalancerBase::createPriorityRouting(cluster_, runtime_)->load_;
+  }
+
+  NiceMock<MockCluster> cluster_;
+  NiceMock<Runtime::MockLoader> runtime_;
+  NiceMock<Runtime::MockRandomGenerator> random_;
+  Stats::IsolatedStoreImpl stats_store_;
+  ClusterStats stats_;
+};
+
+// Without priorities or locality weights the host set is load balanced as a whole.
+TEST_F(PriorityLoadBalancerTest, NoPriorities) {
+  cluster_.hosts_ = {makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                     makeHost("tcp://127.0.0.1:81", 0)};
+  EXPECT_EQ(nullptr, LoadBalancerBase::createPriorityRouting(cluster_, runtime_));
+}
+
+// A level keeps all of the load while it is healthy enough given the overprovisioning factor, and
+// sheds the rest to the next level otherwise.
+TEST_F(PriorityLoadBalancerTest, Spillover) {
+  cluster_.hosts_ = {makeHost("tcp://127.0.0.1:80", 0), makeHost("tcp://127.0.0.1:81", 0),
+                     makeHost("tcp://127.0.0.1:82", 0), makeHost("tcp://127.0.0.1:83", 0),
+                     makeHost("tcp://127.0.0.1:84", 1)};
+  cluster_.healthy_hosts_ = {cluster_.hosts_[0], cluster_.hosts_[1], cluster_.hosts_[2],
+                             cluster_.hosts_[4]};
+  RoundRobinLoadBalancer lb(cluster_, nullptr, stats_, runtime_, random_);
+  EXPECT_EQ(std::vector<uint64_t>({100, 100}), load());
+  EXPECT_CALL(random_, random()).WillOnce(Return(99));
+  EXPECT_EQ(cluster_.hosts_[0], lb.chooseHost(nullptr));
+
+  // 2 of 4 healthy hosts are overprovisioned to 70% of the load.
+  cluster_.healthy_hosts_ = {cluster_.hosts_[0], cluster_.hosts_[1], cluster_.hosts_[4]};
+  cluster_.runCallbacks({}, {});
+  EXPECT_EQ(std::vector<uint64_t>({70, 100}), load());
+  EXPECT_CALL(random_, random()).WillOnce(Return(69)).WillOnce(Return(70));
+  EXPECT_EQ(cluster_.hosts_[1], lb.chooseHost(nullptr));
+  EXPECT_EQ(cluster_.hosts_[4], lb.chooseHost(nullptr));
+
+  ON_CALL(runtime_.snapshot_, getInteger("upstream.priority_overprovisioning_factor", 140))
+      .WillByDefault(Return(100));
+  EXPECT_EQ(std::vector<uint64_t>({50, 100}), load());
+}
+
+// Levels that are not healthy enough together split the load in proportion to their health, and
+// all hosts are used once the total health goes below the panic threshold.
+TEST_F(PriorityLoadBalancerTest, ProportionalSplitAndPanic) {
+  cluster_.hosts_ = {makeHost("tcp://127.0.0.1:80", 0), makeHost("tcp://127.0.0.1:81", 0),
+                     makeHost("tcp://127.0.0.1:82", 0), makeHost("tcp://127.0.0.1:83", 2),
+                     makeHost("tcp://127.0.0.1:84", 2), makeHost("tcp://127.0.0.1:85", 2),
+                     makeHost("tcp://127.0.0.1:86", 2)};
+  cluster_.healthy_hosts_ = {cluster_.hosts_[0], cluster_.hosts_[3]};
+  RoundRobinLoadBalancer lb(cluster_, nullptr, stats_, runtime_, random_);
+
+  // The health is 46% and 35%, so the rounding remainder of the split goes to level 0.
+  EXPECT_EQ(std::vector<uint64_t>({57, 100}), load());
+  EXPECT_CALL(random_, random()).WillOnce(Return(57));
+  EXPECT_EQ(cluster_.hosts_[3], lb.chooseHost(nullptr));
+  EXPECT_EQ(0U, stats_.lb_healthy_panic_.value());
+
+  cluster_.healthy_hosts_.clear();
+  cluster_.runCallbacks({}, {});
+  EXPECT_EQ(std::vector<uint64_t>({100, 100}), load());
+  EXPECT_CALL(random_, random()).WillOnce(Return(99));
+  EXPECT_EQ(cluster_.hosts_[1], lb.chooseHost(nullptr));
+  EXPECT_EQ(1U, stats_.lb_healthy_panic_.value());
+}
+
+// The localities of a level share its load by their weights scaled by their health.
+TEST_F(PriorityLoadBalancerTest, LocalityWeights) {
+  cluster_.hosts_ = {makeHost("tcp://127.0.0.1:80", 0, "a", 1),
+                     makeHost("tcp://127.0.0.1:81", 0, "a", 1),
+                     makeHost("tcp://127.0.0.1:82", 0, "b", 3),
+                     makeHost("tcp://127.0.0.1:83", 0, "b", 3), makeHost("tcp://127.0.0.1:84", 0)};
+  cluster_.healthy_hosts_ = {cluster_.hosts_[0], cluster_.hosts_[1], cluster_.hosts_[2],
+                             cluster_.hosts_[4]};
+  RoundRobinLoadBalancer lb(cluster_, nullptr, stats_, runtime_, random_);
+
+  LoadBalancerBase::PriorityRoutingConstSharedPtr priority_routing =
+      LoadBalancerBase::createPriorityRouting(cluster_, runtime_);
+  ASSERT_EQ(1U, priority_routing->levels_.size());
+  // Hosts without a zone form a locality without weight, which takes no load.
+  EXPECT_EQ(std::vector<uint64_t>({100, 310, 310}),
+            priority_routing->levels_[0].locality_weights_);
+
+  EXPECT_CALL(random_, random())
+      .WillOnce(Return(0))
+      .WillOnce(Return(99))
+      .WillOnce(Return(0))
+      .WillOnce(Return(100));
+  EXPECT_EQ(cluster_.hosts_[0], lb.chooseHost(nullptr));
+  EXPECT_EQ(cluster_.hosts_[2], lb.chooseHost(nullptr));
+}
+
+TEST(PriorityRoutingTest, Level) {
+  LoadBalancerBase::PriorityRouting priority_routing;
+  priority_routing.levels_.resize(3);
+  for (uint32_t i = 0; i < 3; i++) {
+    priority_routing.levels_[i].priority_ = i;
+  }
+  priority_routing.load_ = {60, 60, 100};
+  EXPECT_EQ(0U, priority_routing.level(0).priority_);
+  EXPECT_EQ(0U, priority_routing.level(59).priority_);
+  EXPECT_EQ(2U, priority_routing.level(60).priority_);
+  EXPECT_EQ(2U, priority_routing.level(99).priority_);
+}
+
 class LeastRequestLoadBalancerTest : public testing::Test {
 public:
   LeastRequestLoadBalancerTest() : stats_(ClusterInfoImpl::generateStats(stats_store_)) {}
@@ -402,7 +642,7 @@ TEST_F(LeastRequestLoadBalancerTest, SingleHost) {
 
   // Host weight is 100.
   {
-    EXPECT_CALL(random_, random()).WillOnce(Return(2));
+    EXPECT_CALL(random_, random()).WillOnce(Return(2)).WillOnce(Return(3));
     stats_.max_host_weight_.set(100UL);
     EXPECT_EQ(cluster_.healthy_hosts_[0], lb_.chooseHost(nullptr));
   }
@@ -410,7 +650,7 @@ TEST_F(LeastRequestLoadBalancerTest, SingleHost) {
   std::vector<HostSharedPtr> empty;
   {
     cluster_.runCallbacks(empty, empty);
-    EXPECT_CALL(random_, random()).WillOnce(Return(2));
+    EXPECT_CALL(random_, random()).WillOnce(Return(2)).WillOnce(Return(3));
     EXPECT_EQ(cluster_.healthy_hosts_[0], lb_.chooseHost(nullptr));
   }
 
@@ -444,6 +684,34 @@ TEST_F(LeastRequestLoadBalancerTest, Normal) {
   EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
 }
 
+TEST_F(LeastRequestLoadBalancerTest, SaturatedHosts) {
+  cluster_.healthy_hosts_ = {makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                             makeTestHost(cluster_.info_, "tcp://127.0.0.1:81"),
+                             makeTestHost(cluster_.info_, "tcp://127.0.0.1:82")};
+  stats_.max_host_weight_.set(1UL);
+  cluster_.hosts_ = cluster_.healthy_hosts_;
+  cluster_.info_->max_host_requests_ = 2;
+  cluster_.healthy_hosts_[0]->stats().rq_active_.set(2);
+  cluster_.healthy_hosts_[1]->stats().rq_active_.set(1);
+
+  // The saturated candidate is skipped.
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
+  EXPECT_EQ(1U, stats_.lb_host_saturated_.value());
+
+  // When all the candidates are saturated, the first host after a random one that isn't is picked.
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(3)).WillOnce(Return(0));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
+  EXPECT_EQ(4U, stats_.lb_host_saturated_.value());
+  EXPECT_EQ(0U, stats_.upstream_rq_host_overflow_.value());
+
+  cluster_.healthy_hosts_[1]->stats().rq_active_.set(2);
+  cluster_.healthy_hosts_[2]->stats().rq_active_.set(2);
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1)).WillOnce(Return(2));
+  EXPECT_EQ(nullptr, lb_.chooseHost(nullptr));
+  EXPECT_EQ(1U, stats_.upstream_rq_host_overflow_.value());
+}
+
 TEST_F(LeastRequestLoadBalancerTest, WeightImbalanceRuntimeOff) {
   // Disable weight balancing.
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.weight_enabled", 1))
@@ -472,43 +740,54 @@ TEST_F(LeastRequestLoadBalancerTest, WeightImbalance) {
   stats_.max_host_weight_.set(3UL);
 
   cluster_.hosts_ = cluster_.healthy_hosts_;
-  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.healthy_panic_threshold", 50))
-      .WillRepeatedly(Return(50));
-
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.weight_enabled", 1))
       .WillRepeatedly(Return(1));
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.healthy_panic_threshold", 50))
       .WillRepeatedly(Return(50));
 
-  // As max weight higher then 1 we do random host pick and keep it for weight requests.
-  EXPECT_CALL(random_, random()).WillOnce(Return(1));
+  // Both hosts are idle so the host with the higher weight wins regardless of pick order.
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
   EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
-
-  // Same host stays as we have to hit it 3 times.
-  cluster_.healthy_hosts_[0]->stats().rq_active_.set(2);
-  cluster_.healthy_hosts_[1]->stats().rq_active_.set(1);
-  EXPECT_CALL(random_, random()).Times(0);
+  EXPECT_CALL(random_, random()).WillOnce(Return(1)).WillOnce(Return(0));
   EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
 
-  // Same host stays as we have to hit it 3 times.
-  EXPECT_CALL(random_, random()).Times(0);
+  // Active requests are scaled by weight: 2 / 1 vs. 3 / 3.
+  cluster_.healthy_hosts_[0]->stats().rq_active_.set(1);
+  cluster_.healthy_hosts_[1]->stats().rq_active_.set(2);
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
   EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
 
-  // Get random host after previous one was selected 3 times in a row.
-  EXPECT_CALL(random_, random()).WillOnce(Return(2));
+  // 1 / 1 vs. 4 / 3.
+  cluster_.healthy_hosts_[0]->stats().rq_active_.set(0);
+  cluster_.healthy_hosts_[1]->stats().rq_active_.set(3);
+  EXPECT_CALL(random_, random()).WillOnce(Return(1)).WillOnce(Return(0));
   EXPECT_EQ(cluster_.healthy_hosts_[0], lb_.chooseHost(nullptr));
 
-  // Select second host again.
-  EXPECT_CALL(random_, random()).WillOnce(Return(1));
-  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
+  // Set weight to 1, we compare active requests only.
+  stats_.max_host_weight_.set(1UL);
+  cluster_.healthy_hosts_[0]->stats().rq_active_.set(1);
+  cluster_.healthy_hosts_[1]->stats().rq_active_.set(2);
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
+  EXPECT_EQ(cluster_.healthy_hosts_[0], lb_.chooseHost(nullptr));
+}
 
-  // Set weight to 1, we will switch to the two random hosts mode.
+TEST_F(LeastRequestLoadBalancerTest, LoadReports) {
+  cluster_.healthy_hosts_ = {makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                             makeTestHost(cluster_.info_, "tcp://127.0.0.1:81")};
   stats_.max_host_weight_.set(1UL);
-  EXPECT_CALL(random_, random()).WillOnce(Return(2)).WillOnce(Return(3));
-  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
+  cluster_.hosts_ = cluster_.healthy_hosts_;
+  cluster_.healthy_hosts_[0]->reportLoad(90);
+  cluster_.healthy_hosts_[1]->stats().rq_active_.set(2);
 
-  EXPECT_CALL(random_, random()).WillOnce(Return(2)).WillOnce(Return(2));
+  // Load reports are ignored by default, so the host with fewer active requests wins.
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
   EXPECT_EQ(cluster_.healthy_hosts_[0], lb_.chooseHost(nullptr));
+
+  // 1 / (101 - 90) vs. 3 / (101 - 0).
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.least_request.load_reports_enabled", 0))
+      .WillRepeatedly(Return(1));
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
 }
 
 TEST_F(LeastRequestLoadBalancerTest, WeightImbalanceCallbacks) {
@@ -518,10 +797,10 @@ TEST_F(LeastRequestLoadBalancerTest, WeightImbalanceCallbacks) {
 
   cluster_.hosts_ = cluster_.healthy_hosts_;
 
-  EXPECT_CALL(random_, random()).WillOnce(Return(1));
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
   EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
 
-  // Same host stays as we have to hit it 3 times, but we remove it and fire callback.
+  // Remove the preferred host and fire callback.
   std::vector<HostSharedPtr> empty;
   std::vector<HostSharedPtr> hosts_removed;
   hosts_removed.push_back(cluster_.hosts_[1]);
@@ -529,10 +808,40 @@ TEST_F(LeastRequestLoadBalancerTest, WeightImbalanceCallbacks) {
   cluster_.healthy_hosts_.erase(cluster_.healthy_hosts_.begin() + 1);
   cluster_.runCallbacks(empty, hosts_removed);
 
-  EXPECT_CALL(random_, random()).WillOnce(Return(1));
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
   EXPECT_EQ(cluster_.healthy_hosts_[0], lb_.chooseHost(nullptr));
 }
 
+TEST_F(LeastRequestLoadBalancerTest, ChoiceCount) {
+  cluster_.healthy_hosts_ = {makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                             makeTestHost(cluster_.info_, "tcp://127.0.0.1:81"),
+                             makeTestHost(cluster_.info_, "tcp://127.0.0.1:82")};
+  stats_.max_host_weight_.set(1UL);
+  cluster_.hosts_ = cluster_.healthy_hosts_;
+  cluster_.healthy_hosts_[0]->stats().rq_active_.set(3);
+  cluster_.healthy_hosts_[1]->stats().rq_active_.set(1);
+  cluster_.healthy_hosts_[2]->stats().rq_active_.set(2);
+
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.least_request.choice_count", 2))
+      .WillOnce(Return(3));
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1)).WillOnce(Return(2));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
+
+  // A choice count of 0 is treated as 1, which makes this a random load balancer.
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.least_request.choice_count", 2))
+      .WillOnce(Return(0));
+  EXPECT_CALL(random_, random()).WillOnce(Return(2));
+  EXPECT_EQ(cluster_.healthy_hosts_[2], lb_.chooseHost(nullptr));
+
+  // An oversized choice count is capped, so a pick compares a bounded number of hosts.
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.least_request.choice_count", 2))
+      .WillOnce(Return(1000000000));
+  EXPECT_CALL(random_, random())
+      .Times(LeastRequestLoadBalancer::MAX_CHOICE_COUNT)
+      .WillRepeatedly(Return(1));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
+}
+
 class RandomLoadBalancerTest : public testing::Test {
 public:
   RandomLoadBalancerTest() : stats_(ClusterInfoImpl::generateStats(stats_store_)) {}
@@ -556,5 +865,17 @@ TEST_F(RandomLoadBalancerTest, Normal) {
   EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
 }
 
+TEST_F(RandomLoadBalancerTest, SaturatedHosts) {
+  cluster_.healthy_hosts_ = {makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                             makeTestHost(cluster_.info_, "tcp://127.0.0.1:81")};
+  cluster_.hosts_ = cluster_.healthy_hosts_;
+  cluster_.info_->max_host_connections_ = 4;
+  cluster_.healthy_hosts_[0]->stats().cx_active_.set(4);
+  EXPECT_CALL(random_, random()).WillOnce(Return(2)).WillOnce(Return(3));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
+  EXPECT_EQ(1U, stats_.lb_host_saturated_.value());
+}
+
 } // namespace Upstream
 } // namespace Envoy
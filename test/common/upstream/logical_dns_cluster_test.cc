@@ -21,6 +21,7 @@
 
 using testing::Invoke;
 using testing::NiceMock;
+using testing::Return;
 using testing::_;
 
 namespace Envoy {
@@ -236,5 +237,48 @@ TEST_F(LogicalDnsClusterTest, Basic) {
   tls_.shutdownThread();
 }
 
+TEST_F(LogicalDnsClusterTest, HappyEyeballs) {
+  const std::string json = R"EOF(
+  {
+    "name": "name",
+    "connect_timeout_ms": 250,
+    "type": "logical_dns",
+    "lb_type": "round_robin",
+    "dns_lookup_family": "auto",
+    "hosts": [{"url": "tcp://foo.bar.com:443"}]
+  }
+  )EOF";
+
+  // With happy eyeballs enabled, both families are resolved.
+  ON_CALL(runtime_.snapshot_, getInteger("upstream.happy_eyeballs_delay_ms.name", 0))
+      .WillByDefault(Return(250));
+  expectResolve(Network::DnsLookupFamily::All);
+  setup(json);
+
+  EXPECT_CALL(membership_updated_, ready());
+  EXPECT_CALL(initialized_, ready());
+  EXPECT_CALL(*resolve_timer_, enableTimer(_));
+  dns_callback_(TestUtility::makeDnsResponse({"::1", "127.0.0.1"}));
+  HostSharedPtr logical_host = cluster_->hosts()[0];
+
+  // The first address is connected to first, and the next after the delay.
+  Event::MockTimer* attempt_timer = new Event::MockTimer(&dispatcher_);
+  EXPECT_CALL(dispatcher_, createClientConnection_(
+                               PointeesEq(Network::Utility::resolveUrl("tcp://[::1]:443")), _))
+      .WillOnce(Return(new NiceMock<Network::MockClientConnection>()));
+  Host::CreateConnectionData data = logical_host->createConnection(dispatcher_);
+  EXPECT_EQ("[::1]:443", data.host_description_->address()->asString());
+
+  EXPECT_CALL(*attempt_timer, enableTimer(std::chrono::milliseconds(250)));
+  data.connection_->connect();
+  EXPECT_CALL(dispatcher_, createClientConnection_(
+                               PointeesEq(Network::Utility::resolveUrl("tcp://127.0.0.1:443")), _))
+      .WillOnce(Return(new NiceMock<Network::MockClientConnection>()));
+  attempt_timer->callback_();
+  data.connection_->close(Network::ConnectionCloseType::NoFlush);
+
+  tls_.shutdownThread();
+}
+
 } // namespace Upstream
 } // namespace Envoy
@@ -0,0 +1,162 @@
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "common/network/utility.h"
+#include "common/upstream/maglev_lb.h"
+#include "common/upstream/upstream_impl.h"
+
+#include "test/common/upstream/utility.h"
+#include "test/mocks/runtime/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::NiceMock;
+using testing::Return;
+
+namespace Envoy {
+namespace Upstream {
+
+class MaglevTestLoadBalancerContext : public LoadBalancerContext {
+public:
+  MaglevTestLoadBalancerContext(uint64_t hash_key) : hash_key_(hash_key) {}
+
+  // Upstream::LoadBalancerContext
+  Optional<uint64_t> hashKey() const override { return hash_key_; }
+  const Network::Connection* downstreamConnection() const override { return nullptr; }
+  const MetadataMatchCriteria* metadataMatchCriteria() const override { return nullptr; }
+
+  Optional<uint64_t> hash_key_;
+};
+
+class MaglevLoadBalancerTest : public testing::Test {
+public:
+  MaglevLoadBalancerTest() : stats_(ClusterInfoImpl::generateStats(stats_store_)) {}
+
+  // Count how many slots of a table of the given size each host owns.
+  std::unordered_map<HostConstSharedPtr, uint64_t> slotCounts(MaglevLoadBalancer& lb,
+                                                              uint64_t table_size) {
+    std::unordered_map<HostConstSharedPtr, uint64_t> counts;
+    for (uint64_t i = 0; i < table_size; i++) {
+      MaglevTestLoadBalancerContext context(i);
+      counts[lb.chooseHost(&context)]++;
+    }
+    return counts;
+  }
+
+  NiceMock<MockCluster> cluster_;
+  Stats::IsolatedStoreImpl stats_store_;
+  ClusterStats stats_;
+  NiceMock<Runtime::MockLoader> runtime_;
+  NiceMock<Runtime::MockRandomGenerator> random_;
+};
+
+TEST_F(MaglevLoadBalancerTest, NoHost) {
+  MaglevLoadBalancer lb(cluster_, stats_, runtime_, random_);
+  EXPECT_EQ(nullptr, lb.chooseHost(nullptr));
+}
+
+TEST_F(MaglevLoadBalancerTest, EvenDistribution) {
+  cluster_.hosts_ = {makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                     makeTestHost(cluster_.info_, "tcp://127.0.0.1:81"),
+                     makeTestHost(cluster_.info_, "tcp://127.0.0.1:82")};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+
+  MaglevLoadBalancer lb(cluster_, stats_, runtime_, random_,
+                        MaglevLoadBalancer::createTables(cluster_, 7));
+
+  // Maglev guarantees that slot counts differ by at most one.
+  std::unordered_map<HostConstSharedPtr, uint64_t> counts = slotCounts(lb, 7);
+  ASSERT_EQ(3U, counts.size());
+  for (const auto& host : cluster_.hosts_) {
+    EXPECT_GE(counts[host], 2U);
+    EXPECT_LE(counts[host], 3U);
+  }
+
+  // Hashes beyond the table size wrap.
+  for (uint64_t i = 0; i < 7; i++) {
+    MaglevTestLoadBalancerContext context(i);
+    MaglevTestLoadBalancerContext wrapped(i + 7 * 1000);
+    EXPECT_EQ(lb.chooseHost(&context), lb.chooseHost(&wrapped));
+  }
+
+  // Without a hash a random value is used.
+  EXPECT_CALL(random_, random()).WillOnce(Return(8));
+  MaglevTestLoadBalancerContext context(1);
+  EXPECT_EQ(lb.chooseHost(&context), lb.chooseHost(nullptr));
+  EXPECT_EQ(0UL, stats_.lb_healthy_panic_.value());
+}
+
+TEST_F(MaglevLoadBalancerTest, Panic) {
+  cluster_.hosts_ = {makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                     makeTestHost(cluster_.info_, "tcp://127.0.0.1:81")};
+  MaglevLoadBalancer lb(cluster_, stats_, runtime_, random_);
+
+  // No healthy hosts so we use the all hosts table.
+  MaglevTestLoadBalancerContext context(0);
+  EXPECT_NE(nullptr, lb.chooseHost(&context));
+  EXPECT_EQ(1UL, stats_.lb_healthy_panic_.value());
+}
+
+TEST_F(MaglevLoadBalancerTest, MinimalDisruption) {
+  for (uint32_t i = 0; i < 10; i++) {
+    cluster_.hosts_.push_back(
+        makeTestHost(cluster_.info_, "tcp://127.0.0.1:" + std::to_string(80 + i)));
+  }
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  MaglevLoadBalancer lb(cluster_, stats_, runtime_, random_);
+
+  const uint64_t table_size = MaglevLoadBalancer::DEFAULT_TABLE_SIZE;
+  std::vector<HostConstSharedPtr> before;
+  for (uint64_t i = 0; i < table_size; i++) {
+    MaglevTestLoadBalancerContext context(i);
+    before.push_back(lb.chooseHost(&context));
+  }
+
+  HostSharedPtr removed = cluster_.hosts_.back();
+  cluster_.hosts_.pop_back();
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  cluster_.runCallbacks({}, {removed});
+
+  // Every slot owned by the removed host must move. Only a small fraction of the other slots
+  // should.
+  uint64_t moved = 0;
+  for (uint64_t i = 0; i < table_size; i++) {
+    MaglevTestLoadBalancerContext context(i);
+    HostConstSharedPtr host = lb.chooseHost(&context);
+    EXPECT_NE(removed, host);
+    if (before[i] != removed && before[i] != host) {
+      moved++;
+    }
+  }
+  EXPECT_LT(moved, table_size / 20);
+}
+
+TEST_F(MaglevLoadBalancerTest, SharedTables) {
+  NiceMock<MockCluster> worker_cluster;
+  MaglevLoadBalancer worker_lb(worker_cluster, stats_, runtime_, random_, nullptr);
+  EXPECT_EQ(nullptr, worker_lb.chooseHost(nullptr));
+
+  cluster_.hosts_ = {makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                     makeTestHost(cluster_.info_, "tcp://127.0.0.1:81")};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  MaglevLoadBalancer lb(cluster_, stats_, runtime_, random_);
+
+  worker_cluster.hosts_ = cluster_.hosts_;
+  worker_cluster.healthy_hosts_ = cluster_.healthy_hosts_;
+  worker_lb.setTables(MaglevLoadBalancer::createTables(cluster_));
+  worker_cluster.runCallbacks({}, {});
+
+  for (uint64_t i = 0; i < 100; i++) {
+    MaglevTestLoadBalancerContext context(i);
+    EXPECT_EQ(lb.chooseHost(&context), worker_lb.chooseHost(&context));
+  }
+
+  worker_lb.setTables(nullptr);
+  EXPECT_EQ(nullptr, worker_lb.chooseHost(nullptr));
+}
+
+} // namespace Upstream
+} // namespace Envoy
@@ -38,6 +38,7 @@ public:
   // Upstream::LoadBalancerContext
   Optional<uint64_t> hashKey() const override { return 0; }
   const Network::Connection* downstreamConnection() const override { return connection_; }
+  const MetadataMatchCriteria* metadataMatchCriteria() const override { return nullptr; }
 
   Optional<uint64_t> hash_key_;
   const Network::Connection* connection_;
@@ -345,6 +346,62 @@ TEST_F(OriginalDstClusterTest, Membership2) {
   EXPECT_EQ(0UL, cluster_->hosts().size());
 }
 
+// Hosts are told apart by address family and port, and only stale hosts are cleaned up.
+TEST_F(OriginalDstClusterTest, MembershipByAddressAndPort) {
+  std::string json = R"EOF(
+  {
+    "name": "name",
+    "connect_timeout_ms": 1250,
+    "type": "original_dst",
+    "lb_type": "original_dst_lb"
+  }
+  )EOF";
+
+  EXPECT_CALL(initialized_, ready());
+  EXPECT_CALL(*cleanup_timer_, enableTimer(_));
+  setup(json);
+
+  OriginalDstCluster::LoadBalancer lb(*cluster_, cluster_);
+  std::vector<Network::Address::InstanceConstSharedPtr> addresses{
+      std::make_shared<Network::Address::Ipv4Instance>("10.10.11.11", 80),
+      std::make_shared<Network::Address::Ipv4Instance>("10.10.11.11", 81),
+      std::make_shared<Network::Address::Ipv6Instance>("::ffff:10.10.11.11", 80)};
+  std::vector<HostConstSharedPtr> hosts;
+  for (const Network::Address::InstanceConstSharedPtr& address : addresses) {
+    NiceMock<Network::MockConnection> connection;
+    TestLoadBalancerContext lb_context(&connection);
+    EXPECT_CALL(connection, localAddress()).WillRepeatedly(ReturnRef(*address));
+    EXPECT_CALL(connection, usingOriginalDst()).WillRepeatedly(Return(true));
+
+    EXPECT_CALL(membership_updated_, ready());
+    Event::PostCb post_cb;
+    EXPECT_CALL(dispatcher_, post(_)).WillOnce(SaveArg<0>(&post_cb));
+    hosts.push_back(lb.chooseHost(&lb_context));
+    post_cb();
+    ASSERT_NE(hosts.back(), nullptr);
+    EXPECT_EQ(*address, *hosts.back()->address());
+  }
+  EXPECT_EQ(3UL, cluster_->hosts().size());
+
+  // The first cleanup only marks the hosts, after which the middle one is used again.
+  EXPECT_CALL(*cleanup_timer_, enableTimer(_));
+  cleanup_timer_->callback_();
+  {
+    NiceMock<Network::MockConnection> connection;
+    TestLoadBalancerContext lb_context(&connection);
+    EXPECT_CALL(connection, localAddress()).WillRepeatedly(ReturnRef(*addresses[1]));
+    EXPECT_CALL(connection, usingOriginalDst()).WillRepeatedly(Return(true));
+    EXPECT_CALL(dispatcher_, post(_)).Times(0);
+    EXPECT_EQ(hosts[1], lb.chooseHost(&lb_context));
+  }
+
+  EXPECT_CALL(*cleanup_timer_, enableTimer(_));
+  EXPECT_CALL(membership_updated_, ready());
+  cleanup_timer_->callback_();
+  ASSERT_EQ(1UL, cluster_->hosts().size());
+  EXPECT_EQ(hosts[1], cluster_->hosts()[0]);
+}
+
 TEST_F(OriginalDstClusterTest, Connection) {
   std::string json = R"EOF(
   {
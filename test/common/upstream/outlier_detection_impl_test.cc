@@ -82,6 +82,12 @@ public:
     }
   }
 
+  void loadResponseTime(HostSharedPtr host, int num_rq, std::chrono::milliseconds time) {
+    for (int i = 0; i < num_rq; i++) {
+      host->outlierDetector().putResponseTime(time);
+    }
+  }
+
   NiceMock<MockCluster> cluster_;
   NiceMock<Event::MockDispatcher> dispatcher_;
   NiceMock<Runtime::MockLoader> runtime_;
@@ -319,6 +325,66 @@ TEST_F(OutlierDetectorImplTest, BasicFlowSuccessRate) {
   EXPECT_EQ(-1, detector->successRateEjectionThreshold());
 }
 
+TEST_F(OutlierDetectorImplTest, BasicFlowLatency) {
+  EXPECT_CALL(cluster_, addMemberUpdateCb(_));
+  addHosts({
+      "tcp://127.0.0.1:80",
+      "tcp://127.0.0.1:81",
+      "tcp://127.0.0.1:82",
+      "tcp://127.0.0.1:83",
+      "tcp://127.0.0.1:84",
+  });
+
+  EXPECT_CALL(*interval_timer_, enableTimer(std::chrono::milliseconds(10000)));
+  std::shared_ptr<DetectorImpl> detector(DetectorImpl::create(
+      cluster_, empty_outlier_detection_, dispatcher_, runtime_, time_source_, event_logger_));
+  detector->addChangedStateCb([&](HostSharedPtr host) -> void { checker_.check(host); });
+
+  // Latency ejection is not enforced by default.
+  ON_CALL(runtime_.snapshot_, featureEnabled("outlier_detection.enforcing_latency", 0))
+      .WillByDefault(Return(true));
+
+  // Make one host much slower than the others.
+  for (uint64_t i = 0; i < 4; i++) {
+    loadResponseTime(cluster_.hosts_[i], 200, std::chrono::milliseconds(10));
+  }
+  loadResponseTime(cluster_.hosts_[4], 200, std::chrono::milliseconds(100));
+
+  EXPECT_CALL(time_source_, currentTime())
+      .Times(2)
+      .WillRepeatedly(Return(MonotonicTime(std::chrono::milliseconds(10000))));
+  EXPECT_CALL(checker_, check(cluster_.hosts_[4]));
+  EXPECT_CALL(*event_logger_,
+              logEject(std::static_pointer_cast<const HostDescription>(cluster_.hosts_[4]), _,
+                       EjectionType::Latency, true));
+  EXPECT_CALL(*interval_timer_, enableTimer(std::chrono::milliseconds(10000)));
+  interval_timer_->callback_();
+  EXPECT_EQ(10, cluster_.hosts_[0]->outlierDetector().latency());
+  EXPECT_EQ(96, cluster_.hosts_[4]->outlierDetector().latency());
+  EXPECT_DOUBLE_EQ(27.2, detector->latencyAverage());
+  EXPECT_NEAR(92.56, detector->latencyEjectionThreshold(), 0.0001);
+  EXPECT_TRUE(cluster_.hosts_[4]->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK));
+  EXPECT_EQ(1UL, cluster_.info_->stats_store_.gauge("outlier_detection.ejections_active").value());
+  EXPECT_EQ(1UL,
+            cluster_.info_->stats_store_.counter("outlier_detection.ejections_latency").value());
+
+  // Interval that brings the host back in. The remaining hosts have too few requests to compute
+  // their latency.
+  loadResponseTime(cluster_.hosts_[0], 50, std::chrono::milliseconds(10));
+  EXPECT_CALL(time_source_, currentTime())
+      .WillOnce(Return(MonotonicTime(std::chrono::milliseconds(50001))));
+  EXPECT_CALL(checker_, check(cluster_.hosts_[4]));
+  EXPECT_CALL(*event_logger_,
+              logUneject(std::static_pointer_cast<const HostDescription>(cluster_.hosts_[4])));
+  EXPECT_CALL(*interval_timer_, enableTimer(std::chrono::milliseconds(10000)));
+  interval_timer_->callback_();
+  EXPECT_FALSE(cluster_.hosts_[4]->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK));
+  EXPECT_EQ(0UL, cluster_.info_->stats_store_.gauge("outlier_detection.ejections_active").value());
+  EXPECT_EQ(-1, cluster_.hosts_[0]->outlierDetector().latency());
+  EXPECT_EQ(-1, detector->latencyAverage());
+  EXPECT_EQ(-1, detector->latencyEjectionThreshold());
+}
+
 TEST_F(OutlierDetectorImplTest, RemoveWhileEjected) {
   EXPECT_CALL(cluster_, addMemberUpdateCb(_));
   addHosts({"tcp://127.0.0.1:80"});
@@ -351,6 +417,40 @@ TEST_F(OutlierDetectorImplTest, RemoveWhileEjected) {
   interval_timer_->callback_();
 }
 
+TEST_F(OutlierDetectorImplTest, RemoveFirstHost) {
+  EXPECT_CALL(cluster_, addMemberUpdateCb(_));
+  addHosts({"tcp://127.0.0.1:80", "tcp://127.0.0.1:81", "tcp://127.0.0.1:82"});
+  EXPECT_CALL(*interval_timer_, enableTimer(std::chrono::milliseconds(10000)));
+  std::shared_ptr<DetectorImpl> detector(DetectorImpl::create(
+      cluster_, empty_outlier_detection_, dispatcher_, runtime_, time_source_, event_logger_));
+  detector->addChangedStateCb([&](HostSharedPtr host) -> void { checker_.check(host); });
+
+  // The last host takes the place of the removed one and can still be ejected and unejected.
+  HostSharedPtr removed_host = cluster_.hosts_[0];
+  cluster_.hosts_.erase(cluster_.hosts_.begin());
+  cluster_.runCallbacks({}, {removed_host});
+
+  EXPECT_CALL(time_source_, currentTime())
+      .WillOnce(Return(MonotonicTime(std::chrono::milliseconds(0))));
+  EXPECT_CALL(checker_, check(cluster_.hosts_[1]));
+  EXPECT_CALL(*event_logger_,
+              logEject(std::static_pointer_cast<const HostDescription>(cluster_.hosts_[1]), _,
+                       EjectionType::Consecutive5xx, true));
+  loadRq(cluster_.hosts_[1], 5, 503);
+  EXPECT_TRUE(cluster_.hosts_[1]->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK));
+  EXPECT_EQ(1UL, cluster_.info_->stats_store_.gauge("outlier_detection.ejections_active").value());
+
+  EXPECT_CALL(time_source_, currentTime())
+      .WillOnce(Return(MonotonicTime(std::chrono::milliseconds(30001))));
+  EXPECT_CALL(checker_, check(cluster_.hosts_[1]));
+  EXPECT_CALL(*event_logger_,
+              logUneject(std::static_pointer_cast<const HostDescription>(cluster_.hosts_[1])));
+  EXPECT_CALL(*interval_timer_, enableTimer(std::chrono::milliseconds(10000)));
+  interval_timer_->callback_();
+  EXPECT_FALSE(cluster_.hosts_[1]->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK));
+  EXPECT_EQ(0UL, cluster_.info_->stats_store_.gauge("outlier_detection.ejections_active").value());
+}
+
 TEST_F(OutlierDetectorImplTest, Overflow) {
   EXPECT_CALL(cluster_, addMemberUpdateCb(_));
   addHosts({"tcp://127.0.0.1:80", "tcp://127.0.0.1:81"});
@@ -579,6 +679,23 @@ TEST(OutlierDetectionEventLoggerImplTest, All) {
       .WillOnce(SaveArg<0>(&log4));
   event_logger.logUneject(host);
   Json::Factory::loadFromString(log4);
+
+  std::string log5;
+  EXPECT_CALL(host->outlier_detector_, lastUnejectionTime()).WillOnce(ReturnRef(monotonic_time));
+  EXPECT_CALL(host->outlier_detector_, latency()).WillOnce(Return(96));
+  EXPECT_CALL(detector, latencyAverage()).WillOnce(Return(27.2));
+  EXPECT_CALL(detector, latencyEjectionThreshold()).WillOnce(Return(92.56));
+  EXPECT_CALL(*file, write("{\"time\": \"1970-01-01T00:00:00.000Z\", \"secs_since_last_action\": "
+                           "\"30\", \"cluster\": "
+                           "\"fake_cluster\", \"upstream_url\": \"10.0.0.1:443\", \"action\": "
+                           "\"eject\", \"type\": \"Latency\", \"num_ejections\": \"0\", "
+                           "\"enforced\": \"true\", "
+                           "\"host_latency\": \"96\", \"cluster_average_latency\": "
+                           "\"27.2\", \"cluster_latency_ejection_threshold\": \"92.56\""
+                           "}\n"))
+      .WillOnce(SaveArg<0>(&log5));
+  event_logger.logEject(host, detector, EjectionType::Latency, true);
+  Json::Factory::loadFromString(log5);
 }
 
 TEST(OutlierUtility, SRThreshold) {
@@ -594,6 +711,56 @@ TEST(OutlierUtility, SRThreshold) {
   EXPECT_EQ(90.0, ejection_pair.success_rate_average_);
 }
 
+TEST(OutlierUtility, LatencyThreshold) {
+  std::vector<HostLatencyPair> data = {
+      HostLatencyPair(nullptr, 10), HostLatencyPair(nullptr, 10), HostLatencyPair(nullptr, 10),
+      HostLatencyPair(nullptr, 10), HostLatencyPair(nullptr, 60),
+  };
+  double sum = 100;
+
+  Utility::LatencyEjectionPair ejection_pair =
+      Utility::latencyEjectionThreshold(sum, data, 1.9, 1.5);
+  EXPECT_DOUBLE_EQ(58.0, ejection_pair.ejection_threshold_);
+  EXPECT_EQ(20.0, ejection_pair.latency_average_);
+
+  // Hosts with about the same latency are not ejected for small differences.
+  data = {HostLatencyPair(nullptr, 10), HostLatencyPair(nullptr, 10),
+          HostLatencyPair(nullptr, 10), HostLatencyPair(nullptr, 10),
+          HostLatencyPair(nullptr, 11)};
+  ejection_pair = Utility::latencyEjectionThreshold(51, data, 1.9, 1.5);
+  EXPECT_DOUBLE_EQ(15.3, ejection_pair.ejection_threshold_);
+}
+
+TEST(OutlierLatencyAccumulatorTest, Buckets) {
+  // Each response time is counted in a bucket whose lower bound is within a quarter of it.
+  uint32_t last_index = 0;
+  for (uint64_t time = 0; time <= LatencyAccumulatorBucket::MAX_RESPONSE_TIME_MS; time++) {
+    const uint32_t index = LatencyAccumulatorBucket::index(time);
+    ASSERT_LT(index, LatencyAccumulatorBucket::NUM_BUCKETS);
+    ASSERT_LE(last_index, index);
+    ASSERT_LE(LatencyAccumulatorBucket::lowerBound(index), time);
+    ASSERT_LE(time - LatencyAccumulatorBucket::lowerBound(index), time / 4);
+    last_index = index;
+  }
+  EXPECT_EQ(LatencyAccumulatorBucket::NUM_BUCKETS - 1, last_index);
+  EXPECT_EQ(last_index,
+            LatencyAccumulatorBucket::index(LatencyAccumulatorBucket::MAX_RESPONSE_TIME_MS * 2));
+}
+
+TEST(OutlierLatencyAccumulatorTest, Percentile) {
+  LatencyAccumulator accumulator;
+  LatencyAccumulatorBucket* bucket = accumulator.updateCurrentWriter();
+  for (uint64_t time = 1; time <= 100; time++) {
+    bucket->response_time_counters_[LatencyAccumulatorBucket::index(time)]++;
+  }
+  accumulator.updateCurrentWriter();
+
+  EXPECT_FALSE(accumulator.getLatency(101, 99).valid());
+  EXPECT_EQ(96, accumulator.getLatency(100, 99).value());
+  EXPECT_EQ(48, accumulator.getLatency(100, 50).value());
+  EXPECT_EQ(1, accumulator.getLatency(100, 0).value());
+}
+
 } // namespace Outlier
 } // namespace Upstream
 } // namespace Envoy
@@ -1,3 +1,4 @@
+#include "common/stats/stats_impl.h"
 #include "common/upstream/resource_manager_impl.h"
 
 #include "test/mocks/runtime/mocks.h"
@@ -13,8 +14,9 @@ namespace Upstream {
 
 TEST(ResourceManagerImplTest, RuntimeResourceManager) {
   NiceMock<Runtime::MockLoader> runtime;
+  Stats::IsolatedStoreImpl stats;
   ResourceManagerImpl resource_manager(
-      runtime, "circuit_breakers.runtime_resource_manager_test.default.", 0, 0, 0, 1);
+      runtime, "circuit_breakers.runtime_resource_manager_test.default.", 0, 0, 0, 1, stats);
 
   EXPECT_CALL(
       runtime.snapshot_,
@@ -47,5 +49,126 @@ TEST(ResourceManagerImplTest, RuntimeResourceManager) {
   EXPECT_FALSE(resource_manager.retries().canCreate());
 }
 
+TEST(ResourceManagerImplTest, RetryBudget) {
+  NiceMock<Runtime::MockLoader> runtime;
+  Stats::IsolatedStoreImpl stats;
+  ResourceManagerImpl resource_manager(runtime, "circuit_breakers.retry_budget_test.default.", 1024,
+                                       1024, 1024, 1024, stats);
+
+  // There is no budget by default.
+  EXPECT_TRUE(resource_manager.retryBudget().canCreate());
+
+  ON_CALL(runtime.snapshot_,
+          getInteger("circuit_breakers.retry_budget_test.default.retry_budget_percent", 0U))
+      .WillByDefault(Return(20U));
+  EXPECT_EQ(3U, resource_manager.retryBudget().max());
+  for (uint32_t i = 0; i < 3; i++) {
+    EXPECT_TRUE(resource_manager.retryBudget().canCreate());
+    resource_manager.retries().inc();
+  }
+  EXPECT_FALSE(resource_manager.retryBudget().canCreate());
+  EXPECT_TRUE(resource_manager.retries().canCreate());
+
+  // The budget grows with the active and pending requests.
+  for (uint32_t i = 0; i < 15; i++) {
+    resource_manager.requests().inc();
+  }
+  for (uint32_t i = 0; i < 5; i++) {
+    resource_manager.pendingRequests().inc();
+  }
+  EXPECT_EQ(4U, resource_manager.retryBudget().max());
+  EXPECT_TRUE(resource_manager.retryBudget().canCreate());
+
+  EXPECT_CALL(
+      runtime.snapshot_,
+      getInteger("circuit_breakers.retry_budget_test.default.retry_budget_min_concurrency", 3U))
+      .WillOnce(Return(10U));
+  EXPECT_EQ(10U, resource_manager.retryBudget().max());
+
+  for (uint32_t i = 0; i < 15; i++) {
+    resource_manager.requests().dec();
+  }
+  for (uint32_t i = 0; i < 5; i++) {
+    resource_manager.pendingRequests().dec();
+  }
+  for (uint32_t i = 0; i < 3; i++) {
+    resource_manager.retryBudget().dec();
+  }
+}
+
+TEST(ResourceManagerImplTest, AdaptiveConcurrencyLimit) {
+  NiceMock<Runtime::MockLoader> runtime;
+  Stats::IsolatedStoreImpl stats;
+  ResourceManagerImpl resource_manager(runtime, "circuit_breakers.adaptive_test.default.", 1024,
+                                       1024, 100, 3, stats);
+  Stats::Counter& limited = stats.counter("rq_concurrency_limited");
+  Stats::Gauge& limit = stats.gauge("rq_concurrency_limit");
+  ON_CALL(runtime.snapshot_,
+          getInteger("circuit_breakers.adaptive_test.default.adaptive_concurrency_window_requests",
+                     100))
+      .WillByDefault(Return(1U));
+
+  // Latencies are ignored until the limit is enabled, which then starts at max_requests.
+  resource_manager.putRequestLatency(std::chrono::microseconds(100000));
+  ON_CALL(runtime.snapshot_,
+          getInteger("circuit_breakers.adaptive_test.default.adaptive_concurrency_enabled", 0))
+      .WillByDefault(Return(1U));
+  EXPECT_EQ(100U, resource_manager.requests().max());
+  for (uint32_t i = 0; i < 60; i++) {
+    resource_manager.requests().inc();
+  }
+  resource_manager.putRequestLatency(std::chrono::microseconds(1000));
+  EXPECT_EQ(100U, resource_manager.requests().max());
+  EXPECT_EQ(100U, limit.value());
+
+  // Tripled latency shrinks the limit.
+  resource_manager.putRequestLatency(std::chrono::microseconds(3000));
+  EXPECT_EQ(65U, resource_manager.requests().max());
+  for (uint32_t i = 0; i < 5; i++) {
+    EXPECT_TRUE(resource_manager.requests().canCreate());
+    resource_manager.requests().inc();
+  }
+  EXPECT_FALSE(resource_manager.requests().canCreate());
+  EXPECT_EQ(1U, limited.value());
+
+  // The limit grows back while latency is normal and the requests use the limit.
+  resource_manager.putRequestLatency(std::chrono::microseconds(1000));
+  EXPECT_EQ(73U, resource_manager.requests().max());
+  EXPECT_TRUE(resource_manager.requests().canCreate());
+
+  // It doesn't grow while the requests use less than half of it.
+  for (uint32_t i = 0; i < 55; i++) {
+    resource_manager.requests().dec();
+  }
+  resource_manager.putRequestLatency(std::chrono::microseconds(1000));
+  EXPECT_EQ(73U, resource_manager.requests().max());
+
+  // It doesn't shrink below the minimum.
+  for (uint32_t i = 0; i < 10; i++) {
+    resource_manager.putRequestLatency(std::chrono::microseconds(100000));
+  }
+  EXPECT_EQ(20U, resource_manager.requests().max());
+  EXPECT_EQ(20U, limit.value());
+
+  // Nor above max_requests.
+  ON_CALL(runtime.snapshot_, getInteger("circuit_breakers.adaptive_test.default.max_requests", 100))
+      .WillByDefault(Return(10U));
+  EXPECT_EQ(10U, resource_manager.requests().max());
+  EXPECT_FALSE(resource_manager.requests().canCreate());
+  EXPECT_EQ(1U, limited.value());
+
+  ON_CALL(runtime.snapshot_,
+          getInteger("circuit_breakers.adaptive_test.default.adaptive_concurrency_enabled", 0))
+      .WillByDefault(Return(0U));
+  ON_CALL(runtime.snapshot_, getInteger("circuit_breakers.adaptive_test.default.max_requests", 100))
+      .WillByDefault(Return(100U));
+  EXPECT_EQ(100U, resource_manager.requests().max());
+  EXPECT_TRUE(resource_manager.requests().canCreate());
+
+  for (uint32_t i = 0; i < 10; i++) {
+    resource_manager.requests().dec();
+  }
+}
+
 } // namespace Upstream
 } // namespace Envoy
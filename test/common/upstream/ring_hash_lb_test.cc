@@ -26,6 +26,7 @@ public:
   // Upstream::LoadBalancerContext
   Optional<uint64_t> hashKey() const override { return hash_key_; }
   const Network::Connection* downstreamConnection() const override { return nullptr; }
+  const MetadataMatchCriteria* metadataMatchCriteria() const override { return nullptr; }
 
   Optional<uint64_t> hash_key_;
 };
@@ -139,5 +140,38 @@ TEST_F(RingHashLoadBalancerTest, UnevenHosts) {
   }
 }
 
+TEST_F(RingHashLoadBalancerTest, SharedRings) {
+  NiceMock<MockCluster> worker_cluster;
+  RingHashLoadBalancer worker_lb(worker_cluster, stats_, runtime_, random_, nullptr);
+  EXPECT_EQ(nullptr, worker_lb.chooseHost(nullptr));
+
+  cluster_.hosts_ = {makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                     makeTestHost(cluster_.info_, "tcp://127.0.0.1:81")};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  ON_CALL(runtime_.snapshot_, getInteger("upstream.ring_hash.min_ring_size", _))
+      .WillByDefault(Return(3));
+
+  // The worker has the same hosts but never builds a ring itself.
+  RingHashLoadBalancer::RingsConstSharedPtr rings =
+      RingHashLoadBalancer::createRings(runtime_, cluster_);
+  worker_cluster.hosts_ = cluster_.hosts_;
+  worker_cluster.healthy_hosts_ = cluster_.healthy_hosts_;
+  worker_lb.setRings(rings);
+  worker_cluster.runCallbacks({}, {});
+
+  // Same ring as UnevenHosts.
+  {
+    TestLoadBalancerContext context(0);
+    EXPECT_EQ(cluster_.hosts_[1], worker_lb.chooseHost(&context));
+  }
+  {
+    TestLoadBalancerContext context(15427156902705414897UL);
+    EXPECT_EQ(cluster_.hosts_[0], worker_lb.chooseHost(&context));
+  }
+
+  worker_lb.setRings(nullptr);
+  EXPECT_EQ(nullptr, worker_lb.chooseHost(nullptr));
+}
+
 } // namespace Upstream
 } // namespace Envoy
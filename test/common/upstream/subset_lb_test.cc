@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/config/metadata.h"
+#include "common/config/well_known_names.h"
+#include "common/network/utility.h"
+#include "common/upstream/subset_lb.h"
+#include "common/upstream/upstream_impl.h"
+
+#include "test/mocks/runtime/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::NiceMock;
+using testing::Return;
+using testing::_;
+
+namespace Envoy {
+namespace Upstream {
+
+class TestMetadataMatchCriteria : public MetadataMatchCriteria {
+public:
+  TestMetadataMatchCriteria(const envoy::api::v2::Metadata& metadata,
+                            const std::vector<std::string>& keys) {
+    EXPECT_TRUE(Config::Metadata::subsetKey(metadata, Config::MetadataFilters::get().ENVOY_LB,
+                                            keys, subset_key_));
+  }
+
+  // Upstream::MetadataMatchCriteria
+  const std::string& subsetKey() const override { return subset_key_; }
+
+  std::string subset_key_;
+};
+
+class SubsetLoadBalancerContext : public LoadBalancerContext {
+public:
+  SubsetLoadBalancerContext(const MetadataMatchCriteria* criteria) : criteria_(criteria) {}
+
+  // Upstream::LoadBalancerContext
+  Optional<uint64_t> hashKey() const override { return {}; }
+  const Network::Connection* downstreamConnection() const override { return nullptr; }
+  const MetadataMatchCriteria* metadataMatchCriteria() const override { return criteria_; }
+
+  const MetadataMatchCriteria* criteria_;
+};
+
+class SubsetLoadBalancerTest : public testing::Test {
+public:
+  static envoy::api::v2::Metadata
+  metadata(const std::vector<std::pair<std::string, std::string>>& values) {
+    envoy::api::v2::Metadata metadata;
+    for (const auto& value : values) {
+      Config::Metadata::mutableMetadataValue(metadata, Config::MetadataFilters::get().ENVOY_LB,
+                                             value.first)
+          .set_string_value(value.second);
+    }
+    return metadata;
+  }
+
+  HostSharedPtr makeHost(const std::string& url,
+                         const std::vector<std::pair<std::string, std::string>>& values) {
+    return HostSharedPtr{new HostImpl(cluster_.info_, "", Network::Utility::resolveUrl(url),
+                                      metadata(values), 1, "")};
+  }
+
+  void createLoadBalancer() {
+    fallback_lb_ = new NiceMock<MockLoadBalancer>();
+    lb_.reset(new SubsetLoadBalancer(*cluster_.info_, cluster_, LoadBalancerPtr{fallback_lb_},
+                                     runtime_, random_));
+  }
+
+  HostConstSharedPtr chooseHost(const std::vector<std::pair<std::string, std::string>>& values) {
+    std::vector<std::string> keys;
+    for (const auto& value : values) {
+      keys.push_back(value.first);
+    }
+    std::sort(keys.begin(), keys.end());
+    TestMetadataMatchCriteria criteria(metadata(values), keys);
+    SubsetLoadBalancerContext context(&criteria);
+    return lb_->chooseHost(&context);
+  }
+
+  NiceMock<MockCluster> cluster_;
+  NiceMock<Runtime::MockLoader> runtime_;
+  NiceMock<Runtime::MockRandomGenerator> random_;
+  NiceMock<MockLoadBalancer>* fallback_lb_;
+  std::unique_ptr<SubsetLoadBalancer> lb_;
+};
+
+// Requests without criteria are load balanced over the whole cluster.
+TEST_F(SubsetLoadBalancerTest, NoCriteria) {
+  cluster_.info_->lb_subset_keys_ = {{"version"}};
+  createLoadBalancer();
+
+  EXPECT_CALL(*fallback_lb_, chooseHost(nullptr)).WillOnce(Return(fallback_lb_->host_));
+  EXPECT_EQ(fallback_lb_->host_, lb_->chooseHost(nullptr));
+
+  SubsetLoadBalancerContext context(nullptr);
+  EXPECT_CALL(*fallback_lb_, chooseHost(&context)).WillOnce(Return(fallback_lb_->host_));
+  EXPECT_EQ(fallback_lb_->host_, lb_->chooseHost(&context));
+  EXPECT_EQ(0U, cluster_.info_->stats_.lb_subsets_fallback_.value());
+}
+
+// Hosts are split by each of the key sets, and a subset is load balanced round robin.
+TEST_F(SubsetLoadBalancerTest, SubsetsByKeySets) {
+  cluster_.info_->lb_subset_keys_ = {{"version"}, {"stage", "version"}};
+  cluster_.hosts_ = {makeHost("tcp://127.0.0.1:80", {{"version", "1"}, {"stage", "prod"}}),
+                     makeHost("tcp://127.0.0.1:81", {{"version", "1"}, {"stage", "canary"}}),
+                     makeHost("tcp://127.0.0.1:82", {{"version", "2"}, {"stage", "prod"}}),
+                     makeHost("tcp://127.0.0.1:83", {{"version", "1"}})};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  createLoadBalancer();
+
+  EXPECT_CALL(*fallback_lb_, chooseHost(_)).Times(0);
+  EXPECT_EQ(cluster_.hosts_[0], chooseHost({{"version", "1"}}));
+  EXPECT_EQ(cluster_.hosts_[1], chooseHost({{"version", "1"}}));
+  EXPECT_EQ(cluster_.hosts_[3], chooseHost({{"version", "1"}}));
+  EXPECT_EQ(cluster_.hosts_[0], chooseHost({{"version", "1"}}));
+  EXPECT_EQ(cluster_.hosts_[2], chooseHost({{"version", "2"}}));
+  EXPECT_EQ(cluster_.hosts_[1], chooseHost({{"stage", "canary"}, {"version", "1"}}));
+  EXPECT_EQ(cluster_.hosts_[1], chooseHost({{"stage", "canary"}, {"version", "1"}}));
+  EXPECT_EQ(7U, cluster_.info_->stats_.lb_subsets_selected_.value());
+}
+
+// Subsets follow the membership of the host set, and only healthy hosts are chosen while there
+// are enough of them.
+TEST_F(SubsetLoadBalancerTest, MembershipUpdate) {
+  cluster_.info_->lb_subset_keys_ = {{"version"}};
+  createLoadBalancer();
+  EXPECT_CALL(*fallback_lb_, chooseHost(_)).WillRepeatedly(Return(nullptr));
+  EXPECT_EQ(nullptr, chooseHost({{"version", "1"}}));
+  EXPECT_EQ(1U, cluster_.info_->stats_.lb_subsets_fallback_.value());
+
+  cluster_.hosts_ = {makeHost("tcp://127.0.0.1:80", {{"version", "1"}}),
+                     makeHost("tcp://127.0.0.1:81", {{"version", "1"}}),
+                     makeHost("tcp://127.0.0.1:82", {{"version", "1"}})};
+  cluster_.healthy_hosts_ = {cluster_.hosts_[0], cluster_.hosts_[2]};
+  cluster_.runCallbacks(cluster_.hosts_, {});
+  EXPECT_EQ(cluster_.hosts_[0], chooseHost({{"version", "1"}}));
+  EXPECT_EQ(cluster_.hosts_[2], chooseHost({{"version", "1"}}));
+  EXPECT_EQ(cluster_.hosts_[0], chooseHost({{"version", "1"}}));
+
+  // A subset whose hosts are removed is gone.
+  const std::vector<HostSharedPtr> removed = cluster_.hosts_;
+  cluster_.hosts_.clear();
+  cluster_.healthy_hosts_.clear();
+  cluster_.runCallbacks({}, removed);
+  EXPECT_EQ(nullptr, chooseHost({{"version", "1"}}));
+  EXPECT_EQ(2U, cluster_.info_->stats_.lb_subsets_fallback_.value());
+}
+
+// Criteria that match no subset fall back to the whole cluster unless disabled via runtime.
+TEST_F(SubsetLoadBalancerTest, Fallback) {
+  cluster_.info_->lb_subset_keys_ = {{"version"}};
+  cluster_.hosts_ = {makeHost("tcp://127.0.0.1:80", {{"version", "1"}, {"stage", "prod"}})};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  createLoadBalancer();
+
+  EXPECT_CALL(*fallback_lb_, chooseHost(_)).WillRepeatedly(Return(fallback_lb_->host_));
+  EXPECT_EQ(fallback_lb_->host_, chooseHost({{"version", "2"}}));
+  // Keys that are not a configured key set select no subset either.
+  EXPECT_EQ(fallback_lb_->host_, chooseHost({{"stage", "prod"}}));
+  EXPECT_EQ(2U, cluster_.info_->stats_.lb_subsets_fallback_.value());
+
+  ON_CALL(runtime_.snapshot_, getInteger("upstream.fake_cluster.lb_subset_fallback", 1))
+      .WillByDefault(Return(0));
+  EXPECT_EQ(nullptr, chooseHost({{"version", "2"}}));
+  EXPECT_EQ(cluster_.hosts_[0], chooseHost({{"version", "1"}}));
+  EXPECT_EQ(2U, cluster_.info_->stats_.lb_subsets_fallback_.value());
+}
+
+// Subsets use a load balancer of the type of the cluster.
+TEST_F(SubsetLoadBalancerTest, RingHashSubsets) {
+  cluster_.info_->lb_type_ = LoadBalancerType::RingHash;
+  cluster_.info_->lb_subset_keys_ = {{"version"}};
+  cluster_.hosts_ = {makeHost("tcp://127.0.0.1:80", {{"version", "1"}}),
+                     makeHost("tcp://127.0.0.1:81", {{"version", "1"}}),
+                     makeHost("tcp://127.0.0.1:82", {{"version", "2"}})};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  createLoadBalancer();
+
+  envoy::api::v2::Metadata version = metadata({{"version", "2"}});
+  TestMetadataMatchCriteria criteria(version, {"version"});
+  class HashContext : public SubsetLoadBalancerContext {
+  public:
+    HashContext(const MetadataMatchCriteria* criteria, uint64_t hash)
+        : SubsetLoadBalancerContext(criteria), hash_(hash) {}
+    Optional<uint64_t> hashKey() const override { return hash_; }
+    const uint64_t hash_;
+  };
+  for (uint64_t hash = 0; hash < 16; hash++) {
+    HashContext context(&criteria, hash * 0x1000000000000000ULL);
+    EXPECT_EQ(cluster_.hosts_[2], lb_->chooseHost(&context));
+  }
+}
+
+} // namespace Upstream
+} // namespace Envoy
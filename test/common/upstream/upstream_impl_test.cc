@@ -28,6 +28,8 @@
 using testing::ContainerEq;
 using testing::Invoke;
 using testing::NiceMock;
+using testing::Return;
+using testing::ReturnRef;
 using testing::_;
 
 namespace Envoy {
@@ -295,6 +297,70 @@ TEST(HostImplTest, HostameCanaryAndZone) {
   EXPECT_EQ("hello", host.zone());
 }
 
+TEST(HostImplTest, SharedZoneAndMetadata) {
+  MockCluster cluster;
+  envoy::api::v2::Metadata metadata;
+  Config::Metadata::mutableMetadataValue(metadata, Config::MetadataFilters::get().ENVOY_LB, "key")
+      .set_string_value("value");
+  envoy::api::v2::Metadata other_metadata;
+  Config::Metadata::mutableMetadataValue(other_metadata, Config::MetadataFilters::get().ENVOY_LB,
+                                         "key")
+      .set_string_value("other");
+
+  HostImpl host1(cluster.info_, "", Network::Utility::resolveUrl("tcp://10.0.0.1:1234"), metadata,
+                 1, "zone_a");
+  HostImpl host2(cluster.info_, "", Network::Utility::resolveUrl("tcp://10.0.0.2:1234"), metadata,
+                 1, "zone_a");
+  HostImpl host3(cluster.info_, "", Network::Utility::resolveUrl("tcp://10.0.0.3:1234"),
+                 other_metadata, 1, "zone_b");
+  EXPECT_EQ(&host1.zone(), &host2.zone());
+  EXPECT_EQ(&host1.metadata(), &host2.metadata());
+  EXPECT_NE(&host1.zone(), &host3.zone());
+  EXPECT_NE(&host1.metadata(), &host3.metadata());
+  EXPECT_EQ("zone_b", host3.zone());
+  EXPECT_TRUE(TestUtility::protoEqual(other_metadata, host3.metadata()));
+}
+
+TEST(HostImplTest, Stats) {
+  MockCluster cluster;
+  HostSharedPtr host = makeTestHost(cluster.info_, "tcp://10.0.0.1:1234", 1);
+  host->stats().cx_total_.inc();
+  host->stats().rq_active_.inc();
+
+  std::list<Stats::CounterSharedPtr> counters = host->counters();
+  std::list<Stats::GaugeSharedPtr> gauges = host->gauges();
+  EXPECT_EQ(4UL, counters.size());
+  EXPECT_EQ(2UL, gauges.size());
+  EXPECT_EQ("cx_total", counters.front()->name());
+  EXPECT_EQ(1UL, counters.front()->value());
+  EXPECT_EQ("cx_active", gauges.front()->name());
+  EXPECT_EQ(1UL, gauges.back()->value());
+
+  // The stats keep the host alive.
+  std::weak_ptr<Host> weak_host = host;
+  host.reset();
+  EXPECT_FALSE(weak_host.expired());
+  counters.clear();
+  gauges.clear();
+  EXPECT_TRUE(weak_host.expired());
+}
+
+TEST(HostImplTest, ReportLoad) {
+  MockCluster cluster;
+  HostSharedPtr host = makeTestHost(cluster.info_, "tcp://10.0.0.1:1234", 1);
+  EXPECT_EQ(0U, host->reportedLoad());
+
+  // The first report is used as is, later ones are smoothed.
+  host->reportLoad(80);
+  EXPECT_EQ(80U, host->reportedLoad());
+  host->reportLoad(0);
+  EXPECT_EQ(70U, host->reportedLoad());
+
+  // Reports above 100 are treated as 100.
+  host->reportLoad(200);
+  EXPECT_EQ(74U, host->reportedLoad());
+}
+
 TEST(StaticClusterImplTest, EmptyHostname) {
   Stats::IsolatedStoreImpl stats;
   Ssl::MockContextManager ssl_context_manager;
@@ -339,6 +405,98 @@ TEST(StaticClusterImplTest, RingHash) {
   EXPECT_TRUE(cluster.info()->addedViaApi());
 }
 
+TEST(StaticClusterImplTest, Http2RuntimeSettings) {
+  Stats::IsolatedStoreImpl stats;
+  Ssl::MockContextManager ssl_context_manager;
+  NiceMock<Runtime::MockLoader> runtime;
+  const std::string json = R"EOF(
+  {
+    "name": "staticcluster",
+    "connect_timeout_ms": 250,
+    "type": "static",
+    "lb_type": "random",
+    "features": "http2",
+    "hosts": [{"url": "tcp://10.0.0.1:11001"}]
+  }
+  )EOF";
+
+  EXPECT_CALL(runtime.snapshot_,
+              getInteger("upstream.staticcluster.http2.max_connections_per_host", 1))
+      .WillOnce(Return(4));
+  EXPECT_CALL(runtime.snapshot_,
+              getInteger("upstream.staticcluster.http2.connection_stream_threshold", 100))
+      .WillOnce(Return(0));
+  NiceMock<MockClusterManager> cm;
+  StaticClusterImpl cluster(parseClusterFromJson(json), runtime, stats, ssl_context_manager, cm,
+                            false);
+  EXPECT_EQ(4U, cluster.info()->http2Settings().max_connections_per_host_);
+  EXPECT_EQ(1U, cluster.info()->http2Settings().connection_stream_threshold_);
+  EXPECT_EQ(Http::Http2Settings::DEFAULT_MAX_FRAME_SIZE,
+            cluster.info()->http2Settings().max_frame_size_);
+}
+
+TEST(StaticClusterImplTest, LbSubsetKeys) {
+  Stats::IsolatedStoreImpl stats;
+  Ssl::MockContextManager ssl_context_manager;
+  NiceMock<Runtime::MockLoader> runtime;
+  const std::string json = R"EOF(
+  {
+    "name": "staticcluster",
+    "connect_timeout_ms": 250,
+    "type": "static",
+    "lb_type": "round_robin",
+    "hosts": [{"url": "tcp://10.0.0.1:11001"}]
+  }
+  )EOF";
+
+  const std::string keys = "version,stage;;version;stage,version,stage";
+  ON_CALL(runtime.snapshot_, get("upstream.staticcluster.lb_subset_keys"))
+      .WillByDefault(ReturnRef(keys));
+  NiceMock<MockClusterManager> cm;
+  StaticClusterImpl cluster(parseClusterFromJson(json), runtime, stats, ssl_context_manager, cm,
+                            false);
+  const std::vector<std::vector<std::string>> expected{{"stage", "version"}, {"version"}};
+  EXPECT_EQ(expected, cluster.info()->lbSubsetKeys());
+}
+
+// Socket options from runtime are set on the connections to the hosts of the cluster.
+TEST(StaticClusterImplTest, SocketOptions) {
+  Stats::IsolatedStoreImpl stats;
+  Ssl::MockContextManager ssl_context_manager;
+  NiceMock<Runtime::MockLoader> runtime;
+  const std::string json = R"EOF(
+  {
+    "name": "staticcluster",
+    "connect_timeout_ms": 250,
+    "type": "static",
+    "lb_type": "round_robin",
+    "hosts": [{"url": "tcp://10.0.0.1:11001"}]
+  }
+  )EOF";
+
+  ON_CALL(runtime.snapshot_, getInteger("upstream.staticcluster.socket.tcp_fast_open", 0))
+      .WillByDefault(Return(1));
+  ON_CALL(runtime.snapshot_, getInteger("upstream.staticcluster.socket.notsent_lowat_bytes", 0))
+      .WillByDefault(Return(16384));
+  NiceMock<MockClusterManager> cm;
+  StaticClusterImpl cluster(parseClusterFromJson(json), runtime, stats, ssl_context_manager, cm,
+                            false);
+  const Network::SocketOptions& options = cluster.info()->socketOptions();
+  EXPECT_TRUE(options.tcp_fast_open_connect_);
+  EXPECT_EQ(16384U, options.notsent_lowat_bytes_);
+  EXPECT_EQ(0U, options.receive_buffer_bytes_);
+
+  NiceMock<Event::MockDispatcher> dispatcher;
+  Network::MockClientConnection* connection = new NiceMock<Network::MockClientConnection>();
+  EXPECT_CALL(dispatcher, createClientConnection_(_, _)).WillOnce(Return(connection));
+  EXPECT_CALL(*connection, setSocketOptions(_))
+      .WillOnce(Invoke([](const Network::SocketOptions& options) -> void {
+        EXPECT_TRUE(options.tcp_fast_open_connect_);
+        EXPECT_EQ(16384U, options.notsent_lowat_bytes_);
+      }));
+  cluster.hosts()[0]->createConnection(dispatcher);
+}
+
 TEST(StaticClusterImplTest, OutlierDetector) {
   Stats::IsolatedStoreImpl stats;
   Ssl::MockContextManager ssl_context_manager;
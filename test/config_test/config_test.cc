@@ -46,7 +46,8 @@ public:
 
     cluster_manager_factory_.reset(new Upstream::ProdClusterManagerFactory(
         server_.runtime(), server_.stats(), server_.threadLocal(), server_.random(),
-        server_.dnsResolver(), ssl_context_manager_, server_.dispatcher(), server_.localInfo()));
+        server_.dnsResolver(), ssl_context_manager_, server_.dispatcher(), server_.localInfo(),
+        ""));
 
     ON_CALL(server_, clusterManager()).WillByDefault(Invoke([&]() -> Upstream::ClusterManager& {
       return main_config.clusterManager();
@@ -0,0 +1,118 @@
+#include "test/integration/autonomous_upstream.h"
+
+#include <string>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/http/header_map_impl.h"
+#include "common/http/headers.h"
+#include "common/http/http1/codec_impl.h"
+#include "common/http/http2/codec_impl.h"
+
+namespace Envoy {
+
+namespace {
+
+/**
+ * Writes the data of a connection back to it.
+ */
+class EchoFilter : public Network::ReadFilterBaseImpl {
+public:
+  EchoFilter(Network::Connection& connection) : connection_(connection) {}
+
+  // Network::ReadFilter
+  Network::FilterStatus onData(Buffer::Instance& data) override {
+    connection_.write(data);
+    return Network::FilterStatus::StopIteration;
+  }
+
+private:
+  Network::Connection& connection_;
+};
+
+} // namespace
+
+AutonomousStream::AutonomousStream(AutonomousHttpConnection& parent, Http::StreamEncoder& encoder)
+    : parent_(parent), encoder_(encoder) {
+  encoder_.getStream().addCallbacks(*this);
+}
+
+void AutonomousStream::decodeHeaders(Http::HeaderMapPtr&&, bool end_stream) {
+  if (end_stream) {
+    respond();
+  }
+}
+
+void AutonomousStream::decodeData(Buffer::Instance& data, bool end_stream) {
+  data.drain(data.length());
+  if (end_stream) {
+    respond();
+  }
+}
+
+void AutonomousStream::onResetStream(Http::StreamResetReason) {
+  parent_.connection_.dispatcher().deferredDelete(removeFromList(parent_.streams_));
+}
+
+void AutonomousStream::respond() {
+  // The HTTP/1 codec destroys the stream once the response of a complete request is encoded, so
+  // the callbacks are removed first.
+  encoder_.getStream().removeCallbacks(*this);
+
+  const uint64_t body_size = parent_.response_body_size_;
+  Http::HeaderMapImpl headers{{Http::Headers::get().Status, "200"},
+                              {Http::Headers::get().ContentLength, std::to_string(body_size)}};
+  encoder_.encodeHeaders(headers, body_size == 0);
+  if (body_size > 0) {
+    Buffer::OwnedImpl body(std::string(body_size, 'a'));
+    encoder_.encodeData(body, true);
+  }
+
+  parent_.connection_.dispatcher().deferredDelete(removeFromList(parent_.streams_));
+}
+
+AutonomousHttpConnection::AutonomousHttpConnection(Network::Connection& connection,
+                                                   Stats::Store& store,
+                                                   FakeHttpConnection::Type type,
+                                                   uint64_t response_body_size)
+    : connection_(connection), response_body_size_(response_body_size) {
+  if (type == FakeHttpConnection::Type::HTTP1) {
+    codec_.reset(new Http::Http1::ServerConnectionImpl(connection_, *this, Http::Http1Settings()));
+  } else {
+    codec_.reset(
+        new Http::Http2::ServerConnectionImpl(connection_, *this, store, Http::Http2Settings()));
+  }
+}
+
+Network::FilterStatus AutonomousHttpConnection::onData(Buffer::Instance& data) {
+  codec_->dispatch(data);
+  return Network::FilterStatus::StopIteration;
+}
+
+Http::StreamDecoder& AutonomousHttpConnection::newStream(Http::StreamEncoder& response_encoder) {
+  AutonomousStreamPtr stream(new AutonomousStream(*this, response_encoder));
+  stream->moveIntoList(std::move(stream), streams_);
+  return *streams_.front();
+}
+
+AutonomousUpstream::AutonomousUpstream(uint32_t port, Type type,
+                                       Network::Address::IpVersion version,
+                                       uint64_t response_body_size)
+    : FakeUpstream(port,
+                   type == Type::HTTP2 ? FakeHttpConnection::Type::HTTP2
+                                       : FakeHttpConnection::Type::HTTP1,
+                   version),
+      type_(type), response_body_size_(response_body_size) {}
+
+void AutonomousUpstream::post(std::function<void()> callback) { dispatcher().post(callback); }
+
+bool AutonomousUpstream::createFilterChain(Network::Connection& connection) {
+  if (type_ == Type::ECHO) {
+    connection.addReadFilter(Network::ReadFilterSharedPtr{new EchoFilter(connection)});
+  } else {
+    connection.addReadFilter(Network::ReadFilterSharedPtr{new AutonomousHttpConnection(
+        connection, statsStore(), httpType(), response_body_size_)});
+  }
+  return true;
+}
+
+} // namespace Envoy
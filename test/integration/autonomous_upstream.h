@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+
+#include "envoy/event/deferred_deletable.h"
+#include "envoy/http/codec.h"
+#include "envoy/network/connection.h"
+
+#include "common/common/linked_object.h"
+#include "common/network/filter_impl.h"
+
+#include "test/integration/fake_upstream.h"
+
+namespace Envoy {
+
+class AutonomousHttpConnection;
+
+/**
+ * A stream of an AutonomousHttpConnection, which responds as soon as the request is complete.
+ */
+class AutonomousStream : public Http::StreamDecoder,
+                         public Http::StreamCallbacks,
+                         public Event::DeferredDeletable,
+                         public LinkedObject<AutonomousStream> {
+public:
+  AutonomousStream(AutonomousHttpConnection& parent, Http::StreamEncoder& encoder);
+
+  // Http::StreamDecoder
+  void decodeHeaders(Http::HeaderMapPtr&&, bool end_stream) override;
+  void decodeData(Buffer::Instance& data, bool end_stream) override;
+  void decodeTrailers(Http::HeaderMapPtr&&) override { respond(); }
+
+  // Http::StreamCallbacks
+  void onResetStream(Http::StreamResetReason) override;
+  void onAboveWriteBufferHighWatermark() override {}
+  void onBelowWriteBufferLowWatermark() override {}
+
+private:
+  void respond();
+
+  AutonomousHttpConnection& parent_;
+  Http::StreamEncoder& encoder_;
+};
+
+typedef std::unique_ptr<AutonomousStream> AutonomousStreamPtr;
+
+/**
+ * An HTTP connection of an AutonomousUpstream. Unlike FakeHttpConnection, it is only used on the
+ * thread of the upstream, so it needs no locking and cannot be waited on.
+ */
+class AutonomousHttpConnection : public Network::ReadFilterBaseImpl,
+                                 public Http::ServerConnectionCallbacks {
+public:
+  AutonomousHttpConnection(Network::Connection& connection, Stats::Store& store,
+                           FakeHttpConnection::Type type, uint64_t response_body_size);
+
+  // Network::ReadFilter
+  Network::FilterStatus onData(Buffer::Instance& data) override;
+
+  // Http::ServerConnectionCallbacks
+  Http::StreamDecoder& newStream(Http::StreamEncoder& response_encoder) override;
+  void onGoAway() override {}
+
+private:
+  friend class AutonomousStream;
+
+  Network::Connection& connection_;
+  const uint64_t response_body_size_;
+  Http::ServerConnectionPtr codec_;
+  std::list<AutonomousStreamPtr> streams_;
+};
+
+/**
+ * A fake upstream that serves requests on its own, for tests that drive more load than can be
+ * handled one request at a time with FakeUpstream::waitForHttpConnection(). Every HTTP request is
+ * answered with a 200 and a body of a fixed size once it is complete, and in ECHO mode the data of
+ * each connection is written back as it arrives.
+ */
+class AutonomousUpstream : public FakeUpstream {
+public:
+  enum class Type { HTTP1, HTTP2, ECHO };
+
+  AutonomousUpstream(uint32_t port, Type type, Network::Address::IpVersion version,
+                     uint64_t response_body_size);
+
+  /**
+   * Run a callback on the thread of the upstream, e.g. to set up thread local state.
+   */
+  void post(std::function<void()> callback);
+
+  // Network::FilterChainFactory
+  bool createFilterChain(Network::Connection& connection) override;
+
+private:
+  const Type type_;
+  const uint64_t response_body_size_;
+};
+
+typedef std::unique_ptr<AutonomousUpstream> AutonomousUpstreamPtr;
+
+} // namespace Envoy
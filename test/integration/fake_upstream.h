@@ -282,6 +282,10 @@ public:
   bool createFilterChain(Network::Connection& connection) override;
   void set_allow_unexpected_disconnects(bool value) { allow_unexpected_disconnects_ = value; }
 
+protected:
+  Event::Dispatcher& dispatcher() { return *dispatcher_; }
+  Stats::Store& statsStore() { return stats_store_; }
+
 private:
   FakeUpstream(Ssl::ServerContext* ssl_ctx, Network::ListenSocketPtr&& connection,
                FakeHttpConnection::Type type);
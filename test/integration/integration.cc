@@ -15,6 +15,7 @@
 #include "common/api/api_impl.h"
 #include "common/buffer/buffer_impl.h"
 #include "common/common/assert.h"
+#include "common/event/dispatcher_impl.h"
 #include "common/network/connection_impl.h"
 #include "common/network/utility.h"
 #include "common/upstream/upstream_impl.h"
@@ -169,7 +170,8 @@ void IntegrationTcpClient::ConnectionCallbacks::onEvent(Network::ConnectionEvent
 }
 
 BaseIntegrationTest::BaseIntegrationTest(Network::Address::IpVersion version)
-    : api_(new Api::Impl(std::chrono::milliseconds(10000))),
+    : api_(new Api::Impl(std::chrono::milliseconds(10000),
+                         Event::DispatcherImpl::DEFAULT_CONNECTION_READ_BUDGET, "")),
       mock_buffer_factory_(new NiceMock<MockBufferFactory>),
       dispatcher_(new Event::DispatcherImpl(Buffer::WatermarkFactoryPtr{mock_buffer_factory_})),
       version_(version), default_log_level_(TestEnvironment::getOptions().logLevel()) {
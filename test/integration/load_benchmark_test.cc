@@ -0,0 +1,438 @@
+// Load benchmarks that drive a real server instance against autonomous fake upstreams, and report
+// the throughput, latency and allocations of each proxy scenario. They are tagged manual, and are
+// meant to be run on an optimized build:
+//
+//   bazel test -c opt //test/integration:load_benchmark_test --test_output=streamed
+//
+// The load is configured through the environment, e.g. --test_env=ENVOY_BENCHMARK_CONNECTIONS=16:
+//
+//   ENVOY_BENCHMARK_WARMUP_MS               load before the measurement starts (default 1000)
+//   ENVOY_BENCHMARK_DURATION_MS             length of the measurement (default 5000)
+//   ENVOY_BENCHMARK_CONNECTIONS             downstream connections (default 4)
+//   ENVOY_BENCHMARK_STREAMS_PER_CONNECTION  concurrent HTTP/2 streams per connection (default 1)
+//   ENVOY_BENCHMARK_REQUEST_BYTES           request body, or TCP message, size (default 0 for
+//                                           HTTP, 1024 for TCP)
+//   ENVOY_BENCHMARK_RESPONSE_BYTES          response body size (default 1024)
+//   ENVOY_BENCHMARK_MAX_ALLOCATIONS_PER_REQUEST
+//                                           fail if the server allocates more per request (default
+//                                           0 for no budget, needs tcmalloc)
+//
+// The results are printed and also recorded as properties of the test XML, so that two commits can
+// be compared with the same settings. The server runs a single worker, so throughput is that of
+// one core, and the latency includes the load generator and the fake upstream, which run on two
+// more threads.
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "envoy/http/codec.h"
+#include "envoy/network/connection.h"
+
+#include "common/buffer/buffer_impl.h"
+#include "common/common/utility.h"
+#include "common/http/utility.h"
+#include "common/memory/allocation_tracker.h"
+#include "common/network/filter_impl.h"
+#include "common/stats/histogram_impl.h"
+
+#include "test/integration/autonomous_upstream.h"
+#include "test/integration/http_integration.h"
+
+#include "fmt/format.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace {
+
+uint64_t benchmarkOption(const char* name, uint64_t default_value) {
+  const char* value = ::getenv(name);
+  uint64_t out;
+  return value != nullptr && StringUtil::atoul(value, out) ? out : default_value;
+}
+
+/**
+ * Counts the allocations of the server threads, which register themselves with the allocation
+ * tracker. The load generator and the fake upstream run on threads that do not.
+ */
+class AllocationCounter {
+public:
+  static uint64_t count() {
+    uint64_t allocations = 0;
+    for (const Memory::ThreadAllocationCounts& thread : Memory::AllocationTracker::threadCounts()) {
+      allocations += thread.counts_.allocations_;
+    }
+    return allocations;
+  }
+};
+
+struct LoadResult {
+  uint64_t requests_{};
+  std::chrono::nanoseconds elapsed_{};
+  uint64_t allocations_{};
+  Stats::HistogramBuckets latency_us_;
+};
+
+/**
+ * Keeps a request in flight on each of a number of slots, from the dispatcher of the test, and
+ * records the latency of the requests. Each slot starts its next request as soon as the previous
+ * one completes.
+ */
+class LoadGenerator {
+public:
+  LoadGenerator(Event::Dispatcher& dispatcher, uint32_t slots)
+      : dispatcher_(dispatcher), start_times_(slots) {}
+  virtual ~LoadGenerator() {}
+
+  /**
+   * Run requests for a duration, and then wait for the requests in flight to complete.
+   */
+  LoadResult run(std::chrono::milliseconds duration) {
+    result_ = LoadResult();
+    stopping_ = false;
+    const uint64_t allocations = AllocationCounter::count();
+    const MonotonicTime start = std::chrono::steady_clock::now();
+
+    Event::TimerPtr timer = dispatcher_.createTimer([this]() -> void {
+      stopping_ = true;
+      if (in_flight_ == 0) {
+        dispatcher_.exit();
+      }
+    });
+    timer->enableTimer(duration);
+    for (uint32_t slot = 0; slot < start_times_.size(); slot++) {
+      beginRequest(slot);
+    }
+    dispatcher_.run(Event::Dispatcher::RunType::Block);
+
+    EXPECT_EQ(0U, in_flight_);
+    result_.elapsed_ = std::chrono::steady_clock::now() - start;
+    result_.allocations_ = AllocationCounter::count() - allocations;
+    return std::move(result_);
+  }
+
+protected:
+  /**
+   * Start a request on a slot, which calls onRequestComplete() when it completes.
+   */
+  virtual void startRequest(uint32_t slot) PURE;
+
+  void onRequestComplete(uint32_t slot) {
+    const std::chrono::nanoseconds latency = std::chrono::steady_clock::now() - start_times_[slot];
+    result_.latency_us_.recordValue(
+        std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+    result_.requests_++;
+    in_flight_--;
+
+    if (!stopping_) {
+      // The next request is not started from the callbacks of the codec that completed this one.
+      dispatcher_.post([this, slot]() -> void { beginRequest(slot); });
+    } else if (in_flight_ == 0) {
+      dispatcher_.exit();
+    }
+  }
+
+  void onFailure(const std::string& reason) {
+    ADD_FAILURE() << reason;
+    dispatcher_.exit();
+  }
+
+  Event::Dispatcher& dispatcher_;
+
+private:
+  void beginRequest(uint32_t slot) {
+    start_times_[slot] = std::chrono::steady_clock::now();
+    in_flight_++;
+    startRequest(slot);
+  }
+
+  std::vector<MonotonicTime> start_times_;
+  uint32_t in_flight_{};
+  bool stopping_{};
+  LoadResult result_;
+};
+
+typedef std::unique_ptr<LoadGenerator> LoadGeneratorPtr;
+
+/**
+ * Sends HTTP requests on a set of codec clients, with a number of concurrent streams on each.
+ */
+class HttpLoadGenerator : public LoadGenerator {
+public:
+  HttpLoadGenerator(Event::Dispatcher& dispatcher,
+                    std::vector<IntegrationCodecClientPtr>&& clients, uint32_t streams_per_client,
+                    uint64_t request_body_size)
+      : LoadGenerator(dispatcher, clients.size() * streams_per_client),
+        clients_(std::move(clients)), streams_per_client_(streams_per_client),
+        request_body_(request_body_size, 'a'),
+        request_headers_{{":method", request_body_size > 0 ? "POST" : "GET"},
+                         {":path", "/"},
+                         {":scheme", "http"},
+                         {":authority", "host"}} {
+    if (request_body_size > 0) {
+      request_headers_.addCopy("content-length", std::to_string(request_body_size));
+    }
+    for (uint32_t slot = 0; slot < clients_.size() * streams_per_client; slot++) {
+      requests_.emplace_back(new Request(*this, slot));
+    }
+  }
+
+  ~HttpLoadGenerator() {
+    for (IntegrationCodecClientPtr& client : clients_) {
+      client->close();
+    }
+  }
+
+private:
+  struct Request : public Http::StreamDecoder, public Http::StreamCallbacks {
+    Request(HttpLoadGenerator& parent, uint32_t slot) : parent_(parent), slot_(slot) {}
+
+    // Http::StreamDecoder
+    void decodeHeaders(Http::HeaderMapPtr&& headers, bool end_stream) override {
+      const uint64_t status = Http::Utility::getResponseStatus(*headers);
+      if (status != 200) {
+        parent_.onFailure(fmt::format("unexpected response status {}", status));
+      } else if (end_stream) {
+        parent_.onRequestComplete(slot_);
+      }
+    }
+    void decodeData(Buffer::Instance& data, bool end_stream) override {
+      data.drain(data.length());
+      if (end_stream) {
+        parent_.onRequestComplete(slot_);
+      }
+    }
+    void decodeTrailers(Http::HeaderMapPtr&&) override { parent_.onRequestComplete(slot_); }
+
+    // Http::StreamCallbacks
+    void onResetStream(Http::StreamResetReason) override { parent_.onFailure("stream reset"); }
+    void onAboveWriteBufferHighWatermark() override {}
+    void onBelowWriteBufferLowWatermark() override {}
+
+    HttpLoadGenerator& parent_;
+    const uint32_t slot_;
+  };
+
+  // LoadGenerator
+  void startRequest(uint32_t slot) override {
+    Request& request = *requests_[slot];
+    Http::StreamEncoder& encoder = clients_[slot / streams_per_client_]->newStream(request);
+    encoder.getStream().addCallbacks(request);
+    encoder.encodeHeaders(request_headers_, request_body_.empty());
+    if (!request_body_.empty()) {
+      Buffer::OwnedImpl body(request_body_);
+      encoder.encodeData(body, true);
+    }
+  }
+
+  std::vector<IntegrationCodecClientPtr> clients_;
+  const uint32_t streams_per_client_;
+  const std::string request_body_;
+  Http::TestHeaderMapImpl request_headers_;
+  std::vector<std::unique_ptr<Request>> requests_;
+};
+
+/**
+ * Sends messages on a set of TCP connections to an echo upstream, and waits for each message to
+ * come back before sending the next one.
+ */
+class TcpLoadGenerator : public LoadGenerator {
+public:
+  TcpLoadGenerator(Event::Dispatcher& dispatcher,
+                   std::vector<Network::ClientConnectionPtr>&& connections, uint64_t message_size)
+      : LoadGenerator(dispatcher, connections.size()), connections_(std::move(connections)),
+        message_(message_size, 'a') {
+    for (uint32_t slot = 0; slot < connections_.size(); slot++) {
+      std::shared_ptr<Session> session(new Session(*this, slot));
+      connections_[slot]->addConnectionCallbacks(*session);
+      connections_[slot]->addReadFilter(session);
+      connections_[slot]->connect();
+      sessions_.push_back(session);
+    }
+  }
+
+  ~TcpLoadGenerator() {
+    closing_ = true;
+    for (Network::ClientConnectionPtr& connection : connections_) {
+      connection->close(Network::ConnectionCloseType::NoFlush);
+    }
+  }
+
+private:
+  struct Session : public Network::ReadFilterBaseImpl, public Network::ConnectionCallbacks {
+    Session(TcpLoadGenerator& parent, uint32_t slot) : parent_(parent), slot_(slot) {}
+
+    // Network::ReadFilter
+    Network::FilterStatus onData(Buffer::Instance& data) override {
+      received_ += data.length();
+      data.drain(data.length());
+      if (received_ >= parent_.message_.size()) {
+        received_ = 0;
+        parent_.onRequestComplete(slot_);
+      }
+      return Network::FilterStatus::StopIteration;
+    }
+
+    // Network::ConnectionCallbacks
+    void onEvent(Network::ConnectionEvent event) override {
+      if (event == Network::ConnectionEvent::RemoteClose && !parent_.closing_) {
+        parent_.onFailure("connection closed by the server");
+      }
+    }
+    void onAboveWriteBufferHighWatermark() override {}
+    void onBelowWriteBufferLowWatermark() override {}
+
+    TcpLoadGenerator& parent_;
+    const uint32_t slot_;
+    uint64_t received_{};
+  };
+
+  // LoadGenerator
+  void startRequest(uint32_t slot) override {
+    Buffer::OwnedImpl message(message_);
+    connections_[slot]->write(message);
+  }
+
+  std::vector<Network::ClientConnectionPtr> connections_;
+  const std::string message_;
+  std::vector<std::shared_ptr<Session>> sessions_;
+  bool closing_{};
+};
+
+class LoadBenchmarkTest : public HttpIntegrationTest, public testing::Test {
+public:
+  LoadBenchmarkTest()
+      : HttpIntegrationTest(Http::CodecClient::Type::HTTP1,
+                            TestEnvironment::getIpVersionsForTest().front()) {}
+
+  void SetUp() override { allocations_tracked_ = Memory::AllocationTracker::enable(); }
+
+  void TearDown() override {
+    load_generator_.reset();
+    HttpIntegrationTest::TearDown();
+    Memory::AllocationTracker::disable();
+  }
+
+  void createUpstreams() override {
+    AutonomousUpstream* upstream =
+        new AutonomousUpstream(0, upstream_type_, version_, response_body_size_);
+    fake_upstreams_.emplace_back(upstream);
+    ports_.push_back(upstream->localAddress()->ip()->port());
+  }
+
+  void initializeHttp(Http::CodecClient::Type downstream_type,
+                      AutonomousUpstream::Type upstream_type) {
+    upstream_type_ = upstream_type;
+    setDownstreamProtocol(downstream_type);
+    setUpstreamProtocol(upstream_type == AutonomousUpstream::Type::HTTP2
+                            ? FakeHttpConnection::Type::HTTP2
+                            : FakeHttpConnection::Type::HTTP1);
+    initialize();
+
+    const uint32_t streams_per_connection =
+        downstream_type == Http::CodecClient::Type::HTTP2 ? streams_per_connection_ : 1;
+    std::vector<IntegrationCodecClientPtr> clients;
+    for (uint32_t i = 0; i < connections_; i++) {
+      clients.push_back(makeHttpConnection(lookupPort("http")));
+    }
+    load_generator_.reset(
+        new HttpLoadGenerator(*dispatcher_, std::move(clients), streams_per_connection,
+                              benchmarkOption("ENVOY_BENCHMARK_REQUEST_BYTES", 0)));
+  }
+
+  void initializeTcp() {
+    upstream_type_ = AutonomousUpstream::Type::ECHO;
+    BaseIntegrationTest::initialize();
+    createUpstreams();
+    registerPort("upstream_0", ports_[0]);
+    registerPort("cluster_with_buffer_limits", ports_[0]);
+    createTestServer(
+        "test/config/integration/tcp_proxy.json",
+        {"tcp_proxy", "tcp_proxy_with_write_limits", "tcp_proxy_with_tls_termination"});
+
+    std::vector<Network::ClientConnectionPtr> connections;
+    for (uint32_t i = 0; i < connections_; i++) {
+      connections.push_back(makeClientConnection(lookupPort("tcp_proxy")));
+    }
+    load_generator_.reset(
+        new TcpLoadGenerator(*dispatcher_, std::move(connections),
+                             benchmarkOption("ENVOY_BENCHMARK_REQUEST_BYTES", 1024)));
+  }
+
+  /**
+   * Warm up, measure, and report the results.
+   */
+  void runBenchmark(const std::string& scenario) {
+    load_generator_->run(
+        std::chrono::milliseconds(benchmarkOption("ENVOY_BENCHMARK_WARMUP_MS", 1000)));
+    const LoadResult result = load_generator_->run(
+        std::chrono::milliseconds(benchmarkOption("ENVOY_BENCHMARK_DURATION_MS", 5000)));
+    ASSERT_GT(result.requests_, 0U);
+
+    const double seconds = std::chrono::duration<double>(result.elapsed_).count();
+    const uint64_t requests_per_second = result.requests_ / seconds;
+    const uint64_t p50_us = result.latency_us_.quantile(0.5);
+    const uint64_t p99_us = result.latency_us_.quantile(0.99);
+    const uint64_t p999_us = result.latency_us_.quantile(0.999);
+    std::string report = fmt::format(
+        "{}: {} requests in {:.2f}s, {} requests/s, latency p50 {}us p99 {}us p999 {}us", scenario,
+        result.requests_, seconds, requests_per_second, p50_us, p99_us, p999_us);
+    RecordProperty("requests_per_second", std::to_string(requests_per_second));
+    RecordProperty("latency_p50_us", std::to_string(p50_us));
+    RecordProperty("latency_p99_us", std::to_string(p99_us));
+    RecordProperty("latency_p999_us", std::to_string(p999_us));
+    if (allocations_tracked_) {
+      const double allocations_per_request =
+          static_cast<double>(result.allocations_) / result.requests_;
+      report += fmt::format(", {:.1f} allocations/request", allocations_per_request);
+      RecordProperty("allocations_per_request", fmt::format("{:.1f}", allocations_per_request));
+      std::cout << report << std::endl;
+
+      const uint64_t max_allocations_per_request =
+          benchmarkOption("ENVOY_BENCHMARK_MAX_ALLOCATIONS_PER_REQUEST", 0);
+      if (max_allocations_per_request > 0) {
+        EXPECT_LE(allocations_per_request, max_allocations_per_request)
+            << "the allocations of " << scenario << " exceed the budget";
+      }
+    } else {
+      std::cout << report << std::endl;
+    }
+  }
+
+protected:
+  const uint32_t connections_ = benchmarkOption("ENVOY_BENCHMARK_CONNECTIONS", 4);
+  const uint32_t streams_per_connection_ =
+      benchmarkOption("ENVOY_BENCHMARK_STREAMS_PER_CONNECTION", 1);
+  const uint64_t response_body_size_ = benchmarkOption("ENVOY_BENCHMARK_RESPONSE_BYTES", 1024);
+  AutonomousUpstream::Type upstream_type_{AutonomousUpstream::Type::HTTP1};
+  LoadGeneratorPtr load_generator_;
+  bool allocations_tracked_{};
+};
+
+TEST_F(LoadBenchmarkTest, Http1) {
+  initializeHttp(Http::CodecClient::Type::HTTP1, AutonomousUpstream::Type::HTTP1);
+  runBenchmark("HTTP/1.1 to HTTP/1.1");
+}
+
+TEST_F(LoadBenchmarkTest, Http2) {
+  initializeHttp(Http::CodecClient::Type::HTTP2, AutonomousUpstream::Type::HTTP2);
+  runBenchmark("HTTP/2 to HTTP/2");
+}
+
+TEST_F(LoadBenchmarkTest, Http2ToHttp1) {
+  initializeHttp(Http::CodecClient::Type::HTTP2, AutonomousUpstream::Type::HTTP1);
+  runBenchmark("HTTP/2 to HTTP/1.1");
+}
+
+TEST_F(LoadBenchmarkTest, TcpProxy) {
+  initializeTcp();
+  runBenchmark("TCP proxy");
+}
+
+} // namespace
+} // namespace Envoy
@@ -6,6 +6,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include "envoy/server/options.h"
 
@@ -37,11 +38,28 @@ public:
   uint32_t concurrency() override { return 1; }
   const std::string& configPath() override { return config_path_; }
   const std::string& adminAddressPath() override { return admin_address_path_; }
+  const std::string& xdsCacheDirectory() override { return xds_cache_directory_; }
   Network::Address::IpVersion localAddressIpVersion() override { return local_address_ip_version_; }
   std::chrono::seconds drainTime() override { return std::chrono::seconds(1); }
+  uint32_t drainCloseRate() override { return 0; }
+  uint32_t maxStats() override { return 16384; }
+  uint64_t connectionReadBudget() override { return 262144; }
+  const std::string& eventBackend() override { return event_backend_; }
+  uint32_t maxAcceptsPerEvent() override { return 64; }
   spdlog::level::level_enum logLevel() override { NOT_IMPLEMENTED; }
+  uint32_t logAsyncBufferSize() override { return 0; }
   std::chrono::seconds parentShutdownTime() override { return std::chrono::seconds(2); }
   uint64_t restartEpoch() override { return 0; }
+  bool reusePort() override { return false; }
+  bool balanceConnections() override { return false; }
+  uint32_t privateKeyThreads() override { return 0; }
+  const std::vector<uint32_t>& workerCpus() override { return worker_cpus_; }
+  const Network::DnsCacheConfig& dnsCacheConfig() override { return dns_cache_config_; }
+  const OverloadConfig& overloadConfig() override { return overload_config_; }
+  const std::vector<std::pair<std::string, std::string>>& statsTags() override {
+    return stats_tags_;
+  }
+  bool watchdogSampleStacks() override { return false; }
   std::chrono::milliseconds fileFlushIntervalMsec() override {
     return std::chrono::milliseconds(10000);
   }
@@ -53,10 +71,16 @@ public:
 private:
   const std::string config_path_;
   const std::string admin_address_path_;
+  const std::string xds_cache_directory_;
   const Network::Address::IpVersion local_address_ip_version_;
   const std::string service_cluster_name_;
   const std::string service_node_name_;
   const std::string service_zone_;
+  const std::string event_backend_;
+  const std::vector<uint32_t> worker_cpus_;
+  const Network::DnsCacheConfig dns_cache_config_;
+  const OverloadConfig overload_config_;
+  const std::vector<std::pair<std::string, std::string>> stats_tags_;
 };
 
 class TestDrainManager : public DrainManager {
@@ -123,6 +147,11 @@ public:
     return wrapped_scope_->timer(name);
   }
 
+  Histogram& histogram(const std::string& name) override {
+    std::unique_lock<std::mutex> lock(lock_);
+    return wrapped_scope_->histogram(name);
+  }
+
 private:
   std::mutex& lock_;
   ScopePtr wrapped_scope_;
@@ -153,6 +182,10 @@ public:
     std::unique_lock<std::mutex> lock(lock_);
     return store_.timer(name);
   }
+  Histogram& histogram(const std::string& name) override {
+    std::unique_lock<std::mutex> lock(lock_);
+    return store_.histogram(name);
+  }
 
   // Stats::Store
   std::list<CounterSharedPtr> counters() const override {
@@ -163,11 +196,25 @@ public:
     std::unique_lock<std::mutex> lock(lock_);
     return store_.gauges();
   }
+  std::list<ParentHistogramSharedPtr> histograms() const override {
+    std::unique_lock<std::mutex> lock(lock_);
+    return store_.histograms();
+  }
+  std::vector<CounterSharedPtr> latchChangedCounters() override {
+    std::unique_lock<std::mutex> lock(lock_);
+    return store_.latchChangedCounters();
+  }
+  std::vector<GaugeSharedPtr> latchChangedGauges() override {
+    std::unique_lock<std::mutex> lock(lock_);
+    return store_.latchChangedGauges();
+  }
 
   // Stats::StoreRoot
   void addSink(Sink&) override {}
   void initializeThreading(Event::Dispatcher&, ThreadLocal::Instance&) override {}
   void shutdownThreading() override {}
+  void mergeHistograms(std::function<void()> merge_complete_cb) override { merge_complete_cb(); }
+  void setTagExtractors(std::vector<TagExtractorPtr>&&) override {}
 
 private:
   mutable std::mutex lock_;
@@ -11,6 +11,7 @@
 #include "common/api/api_impl.h"
 #include "common/buffer/buffer_impl.h"
 #include "common/common/assert.h"
+#include "common/event/dispatcher_impl.h"
 #include "common/http/header_map_impl.h"
 #include "common/http/headers.h"
 #include "common/network/utility.h"
@@ -56,7 +57,8 @@ BufferingStreamDecoderPtr
 IntegrationUtil::makeSingleRequest(uint32_t port, const std::string& method, const std::string& url,
                                    const std::string& body, Http::CodecClient::Type type,
                                    Network::Address::IpVersion version, const std::string& host) {
-  Api::Impl api(std::chrono::milliseconds(9000));
+  Api::Impl api(std::chrono::milliseconds(9000),
+                Event::DispatcherImpl::DEFAULT_CONNECTION_READ_BUDGET, "");
   Event::DispatcherPtr dispatcher(api.allocateDispatcher());
   std::shared_ptr<Upstream::MockClusterInfo> cluster{new NiceMock<Upstream::MockClusterInfo>()};
   Upstream::HostDescriptionConstSharedPtr host_description{Upstream::makeTestHostDescription(
@@ -90,7 +92,8 @@ IntegrationUtil::makeSingleRequest(uint32_t port, const std::string& method, con
 RawConnectionDriver::RawConnectionDriver(uint32_t port, Buffer::Instance& initial_data,
                                          ReadCallback data_callback,
                                          Network::Address::IpVersion version) {
-  api_.reset(new Api::Impl(std::chrono::milliseconds(10000)));
+  api_.reset(new Api::Impl(std::chrono::milliseconds(10000),
+                          Event::DispatcherImpl::DEFAULT_CONNECTION_READ_BUDGET, ""));
   dispatcher_ = api_->allocateDispatcher();
   client_ = dispatcher_->createClientConnection(
       Network::Utility::resolveUrl(
@@ -66,6 +66,7 @@ public:
   }
 
   TimerPtr createTimer(TimerCb cb) override { return TimerPtr{createTimer_(cb)}; }
+  TimerPtr createTimer(TimerCb cb, TimerPrecision) override { return TimerPtr{createTimer_(cb)}; }
 
   void deferredDelete(DeferredDeletablePtr&& to_delete) override {
     deferredDelete_(to_delete);
@@ -106,6 +107,8 @@ public:
   MOCK_METHOD1(createTimer_, Timer*(TimerCb cb));
   MOCK_METHOD1(deferredDelete_, void(DeferredDeletablePtr& to_delete));
   MOCK_METHOD0(exit, void());
+  MOCK_METHOD2(initializeStats, void(Stats::Scope& scope, const std::string& prefix));
+  MOCK_METHOD1(setSlowCallbackThreshold, void(std::chrono::milliseconds threshold));
   MOCK_METHOD2(listenForSignal_, SignalEvent*(int signal_num, SignalCb cb));
   MOCK_METHOD1(post, void(std::function<void()> callback));
   MOCK_METHOD1(run, void(RunType type));
@@ -29,6 +29,14 @@ ssize_t MockOsSysCalls::write(int fd, const void* buffer, size_t num_bytes) {
   return result;
 }
 
+ssize_t MockOsSysCalls::writev(int fd, const iovec* iov, int num_iov) {
+  std::string data;
+  for (int i = 0; i < num_iov; i++) {
+    data.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+  }
+  return write(fd, data.data(), data.size());
+}
+
 MockFile::MockFile() {}
 MockFile::~MockFile() {}
 
@@ -20,6 +20,8 @@ public:
 
   // Filesystem::OsSysCalls
   ssize_t write(int fd, const void* buffer, size_t num_bytes) override;
+  // Gathers the buffers and records them as a single write_().
+  ssize_t writev(int fd, const iovec* iov, int num_iov) override;
   int open(const std::string& full_path, int flags, int mode) override;
   MOCK_METHOD1(close, int(int));
 
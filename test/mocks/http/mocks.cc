@@ -17,6 +17,7 @@ namespace Http {
 
 MockConnectionManagerConfig::MockConnectionManagerConfig() {
   ON_CALL(*this, generateRequestId()).WillByDefault(Return(true));
+  ON_CALL(*this, maxRequestHeadersKb()).WillByDefault(Return(DEFAULT_MAX_REQUEST_HEADERS_KB));
 }
 
 MockConnectionManagerConfig::~MockConnectionManagerConfig() {}
@@ -59,6 +60,7 @@ MockStreamEncoder::~MockStreamEncoder() {}
 
 MockServerConnection::MockServerConnection() {
   ON_CALL(*this, protocol()).WillByDefault(Return(protocol_));
+  ON_CALL(*this, maxPipelineDepth()).WillByDefault(Return(1));
 }
 
 MockServerConnection::~MockServerConnection() {}
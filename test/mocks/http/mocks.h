@@ -91,6 +91,7 @@ public:
   MOCK_METHOD0(filterFactory, FilterChainFactory&());
   MOCK_METHOD0(generateRequestId, bool());
   MOCK_METHOD0(idleTimeout, const Optional<std::chrono::milliseconds>&());
+  MOCK_METHOD0(maxRequestHeadersKb, uint32_t());
   MOCK_METHOD0(routeConfigProvider, Router::RouteConfigProvider&());
   MOCK_METHOD0(serverName, const std::string&());
   MOCK_METHOD0(stats, ConnectionManagerStats&());
@@ -206,6 +207,9 @@ public:
   MOCK_METHOD0(onUnderlyingConnectionAboveWriteBufferHighWatermark, void());
   MOCK_METHOD0(onUnderlyingConnectionBelowWriteBufferLowWatermark, void());
 
+  // Http::ServerConnection
+  MOCK_CONST_METHOD0(maxPipelineDepth, uint32_t());
+
   Protocol protocol_{Protocol::Http11};
 };
 
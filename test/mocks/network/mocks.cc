@@ -61,6 +61,10 @@ template <class T> static void initializeMockConnection(T& connection) {
       .WillByDefault(Invoke([&connection](Network::ConnectionCallbacks& callbacks) -> void {
         connection.callbacks_.push_back(&callbacks);
       }));
+  ON_CALL(connection, removeConnectionCallbacks(_))
+      .WillByDefault(Invoke([&connection](Network::ConnectionCallbacks& callbacks) -> void {
+        connection.callbacks_.remove(&callbacks);
+      }));
   ON_CALL(connection, close(_)).WillByDefault(Invoke([&connection](ConnectionCloseType) -> void {
     connection.raiseEvent(Network::ConnectionEvent::LocalClose);
   }));
@@ -50,6 +50,7 @@ public:
 
   // Network::Connection
   MOCK_METHOD1(addConnectionCallbacks, void(ConnectionCallbacks& cb));
+  MOCK_METHOD1(removeConnectionCallbacks, void(ConnectionCallbacks& cb));
   MOCK_METHOD1(addWriteFilter, void(WriteFilterSharedPtr filter));
   MOCK_METHOD1(addFilter, void(FilterSharedPtr filter));
   MOCK_METHOD1(addReadFilter, void(ReadFilterSharedPtr filter));
@@ -73,6 +74,7 @@ public:
   MOCK_CONST_METHOD0(bufferLimit, uint32_t());
   MOCK_CONST_METHOD0(usingOriginalDst, bool());
   MOCK_CONST_METHOD0(aboveHighWatermark, bool());
+  MOCK_METHOD1(spliceWith, bool(Connection& peer));
 };
 
 /**
@@ -86,6 +88,7 @@ public:
 
   // Network::Connection
   MOCK_METHOD1(addConnectionCallbacks, void(ConnectionCallbacks& cb));
+  MOCK_METHOD1(removeConnectionCallbacks, void(ConnectionCallbacks& cb));
   MOCK_METHOD1(addWriteFilter, void(WriteFilterSharedPtr filter));
   MOCK_METHOD1(addFilter, void(FilterSharedPtr filter));
   MOCK_METHOD1(addReadFilter, void(ReadFilterSharedPtr filter));
@@ -109,9 +112,11 @@ public:
   MOCK_CONST_METHOD0(bufferLimit, uint32_t());
   MOCK_CONST_METHOD0(usingOriginalDst, bool());
   MOCK_CONST_METHOD0(aboveHighWatermark, bool());
+  MOCK_METHOD1(spliceWith, bool(Connection& peer));
 
   // Network::ClientConnection
   MOCK_METHOD0(connect, void());
+  MOCK_METHOD1(setSocketOptions, void(const SocketOptions& options));
 };
 
 class MockActiveDnsQuery : public ActiveDnsQuery {
@@ -187,6 +192,11 @@ public:
   MockListenerCallbacks();
   ~MockListenerCallbacks();
 
+  bool onAccept(int, Address::InstanceConstSharedPtr, Address::InstanceConstSharedPtr,
+                bool) override {
+    return false;
+  }
+  bool canAccept() override { return true; }
   void onNewConnection(ConnectionPtr&& conn) override { onNewConnection_(conn); }
 
   MOCK_METHOD1(onNewConnection_, void(ConnectionPtr& conn));
@@ -226,6 +236,11 @@ public:
   ~MockListener();
 
   MOCK_METHOD0(onDestroy, void());
+  MOCK_METHOD4(newConnection,
+               void(int fd, Address::InstanceConstSharedPtr remote_address,
+                    Address::InstanceConstSharedPtr local_address, bool using_original_dst));
+  MOCK_METHOD0(disable, void());
+  MOCK_METHOD0(enable, void());
 };
 
 class MockConnectionHandler : public ConnectionHandler {
@@ -245,8 +260,11 @@ public:
   MOCK_METHOD1(findListenerByAddress,
                Network::Listener*(const Network::Address::Instance& address));
   MOCK_METHOD1(removeListeners, void(uint64_t listener_tag));
+  MOCK_METHOD2(retireListeners, void(uint64_t listener_tag, std::function<void()> completion));
   MOCK_METHOD1(stopListeners, void(uint64_t listener_tag));
   MOCK_METHOD0(stopListeners, void());
+  MOCK_METHOD0(disableListeners, void());
+  MOCK_METHOD0(enableListeners, void());
 };
 
 } // namespace Network
@@ -3,6 +3,9 @@
 namespace Envoy {
 namespace RateLimit {
 
+MockRequestCallbacks::MockRequestCallbacks() {}
+MockRequestCallbacks::~MockRequestCallbacks() {}
+
 MockClient::MockClient() {}
 MockClient::~MockClient() {}
 
@@ -11,6 +11,15 @@
 namespace Envoy {
 namespace RateLimit {
 
+class MockRequestCallbacks : public RequestCallbacks {
+public:
+  MockRequestCallbacks();
+  ~MockRequestCallbacks();
+
+  // RateLimit::RequestCallbacks
+  MOCK_METHOD1(complete, void(LimitStatus status));
+};
+
 class MockClient : public Client {
 public:
   MockClient();
@@ -53,6 +53,7 @@ public:
   MOCK_METHOD1(addConnectionCallbacks, void(Network::ConnectionCallbacks& callbacks));
   MOCK_METHOD0(close, void());
   MOCK_METHOD2(makeRequest, PoolRequest*(const RespValue& request, PoolCallbacks& callbacks));
+  MOCK_CONST_METHOD0(numPendingRequests, uint64_t());
 
   std::list<Network::ConnectionCallbacks*> callbacks_;
 };
@@ -83,6 +84,9 @@ public:
 
   MOCK_METHOD3(makeRequest, PoolRequest*(const std::string& hash_key, const RespValue& request,
                                          PoolCallbacks& callbacks));
+  MOCK_METHOD3(makeReadRequest, PoolRequest*(const std::string& hash_key,
+                                             const RespValue& request, PoolCallbacks& callbacks));
+  MOCK_METHOD1(upstreamId, uint64_t(const std::string& hash_key));
 };
 
 } // namespace ConnPool
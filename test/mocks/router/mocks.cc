@@ -39,6 +39,9 @@ MockRateLimitPolicy::MockRateLimitPolicy() {
 
 MockRateLimitPolicy::~MockRateLimitPolicy() {}
 
+MockShadowStream::MockShadowStream() {}
+MockShadowStream::~MockShadowStream() {}
+
 MockShadowWriter::MockShadowWriter() {}
 MockShadowWriter::~MockShadowWriter() {}
 
@@ -40,6 +40,14 @@ class TestCorsPolicy : public CorsPolicy {
 public:
   // Router::CorsPolicy
   const std::list<std::string>& allowOrigins() const override { return allow_origin_; };
+  bool originAllowed(const Http::HeaderString& origin) const override {
+    for (const std::string& allowed : allow_origin_) {
+      if (allowed == "*" || origin == allowed.c_str()) {
+        return true;
+      }
+    }
+    return false;
+  }
   const std::string& allowMethods() const override { return allow_methods_; };
   const std::string& allowHeaders() const override { return allow_headers_; };
   const std::string& exposeHeaders() const override { return expose_headers_; };
@@ -125,6 +133,16 @@ public:
   std::string runtime_key_;
 };
 
+class MockShadowStream : public ShadowStream {
+public:
+  MockShadowStream();
+  ~MockShadowStream();
+
+  // Router::ShadowStream
+  MOCK_METHOD2(sendData, bool(const Buffer::Instance& data, bool end_stream));
+  MOCK_METHOD1(sendTrailers, void(const Http::HeaderMap& trailers));
+};
+
 class MockShadowWriter : public ShadowWriter {
 public:
   MockShadowWriter();
@@ -135,9 +153,16 @@ public:
               std::chrono::milliseconds timeout) override {
     shadow_(cluster, request, timeout);
   }
+  ShadowStreamPtr streamShadow(const std::string& cluster, const Http::HeaderMap& headers,
+                               bool end_stream, std::chrono::milliseconds timeout) override {
+    return ShadowStreamPtr{streamShadow_(cluster, headers, end_stream, timeout)};
+  }
 
   MOCK_METHOD3(shadow_, void(const std::string& cluster, Http::MessagePtr& request,
                              std::chrono::milliseconds timeout));
+  MOCK_METHOD4(streamShadow_,
+               ShadowStream*(const std::string& cluster, const Http::HeaderMap& headers,
+                             bool end_stream, std::chrono::milliseconds timeout));
 };
 
 class TestVirtualCluster : public VirtualCluster {
@@ -179,6 +204,7 @@ public:
 
   // Router::Config
   MOCK_CONST_METHOD0(clusterName, const std::string&());
+  MOCK_CONST_METHOD0(clusterHandle, const Upstream::ClusterHandle*());
   MOCK_CONST_METHOD1(finalizeRequestHeaders, void(Http::HeaderMap& headers));
   MOCK_CONST_METHOD0(hashPolicy, const HashPolicy*());
   MOCK_CONST_METHOD0(priority, Upstream::ResourcePriority());
@@ -193,6 +219,8 @@ public:
   MOCK_CONST_METHOD0(useWebSocket, bool());
   MOCK_CONST_METHOD0(opaqueConfig, const std::multimap<std::string, std::string>&());
   MOCK_CONST_METHOD0(includeVirtualHostRateLimits, bool());
+  MOCK_CONST_METHOD0(metadataMatchCriteria, const Upstream::MetadataMatchCriteria*());
+  MOCK_CONST_METHOD0(perRequestBufferLimit, Optional<uint32_t>());
   MOCK_CONST_METHOD0(corsPolicy, const CorsPolicy*());
 
   std::string cluster_name_{"fake_cluster"};
@@ -239,16 +267,16 @@ public:
 
   // Router::Config
   MOCK_CONST_METHOD2(route, RouteConstSharedPtr(const Http::HeaderMap&, uint64_t random_value));
-  MOCK_CONST_METHOD0(internalOnlyHeaders, const std::list<Http::LowerCaseString>&());
+  MOCK_CONST_METHOD0(internalOnlyHeaders, const std::vector<Http::LowerCaseString>&());
   MOCK_CONST_METHOD0(responseHeadersToAdd,
-                     const std::list<std::pair<Http::LowerCaseString, std::string>>&());
-  MOCK_CONST_METHOD0(responseHeadersToRemove, const std::list<Http::LowerCaseString>&());
+                     const std::vector<std::pair<Http::LowerCaseString, std::string>>&());
+  MOCK_CONST_METHOD0(responseHeadersToRemove, const std::vector<Http::LowerCaseString>&());
   MOCK_CONST_METHOD0(usesRuntime, bool());
 
   std::shared_ptr<MockRoute> route_;
-  std::list<Http::LowerCaseString> internal_only_headers_;
-  std::list<std::pair<Http::LowerCaseString, std::string>> response_headers_to_add_;
-  std::list<Http::LowerCaseString> response_headers_to_remove_;
+  std::vector<Http::LowerCaseString> internal_only_headers_;
+  std::vector<std::pair<Http::LowerCaseString, std::string>> response_headers_to_add_;
+  std::vector<Http::LowerCaseString> response_headers_to_remove_;
 };
 
 class MockRouteConfigProviderManager : public ServerRouteConfigProviderManager {
@@ -262,6 +290,10 @@ public:
                                             Upstream::ClusterManager& cm, Stats::Scope& scope,
                                             const std::string& stat_prefix,
                                             Init::Manager& init_manager));
+  MOCK_METHOD3(getStaticRouteConfigProvider,
+               RouteConfigProviderSharedPtr(const envoy::api::v2::RouteConfiguration& route_config,
+                                            Runtime::Loader& runtime,
+                                            Upstream::ClusterManager& cm));
   MOCK_METHOD1(removeRouteConfigProvider, void(const std::string& identifier));
 };
 
@@ -1,24 +1,41 @@
 #include "mocks.h"
 
+#include "common/common/empty_string.h"
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+using testing::Invoke;
 using testing::Return;
 using testing::ReturnArg;
+using testing::ReturnRef;
+using testing::SetArrayArgument;
 using testing::_;
 
 namespace Envoy {
 namespace Runtime {
 
-MockRandomGenerator::MockRandomGenerator() { ON_CALL(*this, uuid()).WillByDefault(Return(uuid_)); }
+MockRandomGenerator::MockRandomGenerator() {
+  ON_CALL(*this, uuid()).WillByDefault(Return(uuid_));
+  ON_CALL(*this, uuid(_)).WillByDefault(SetArrayArgument<0>(uuid_.begin(), uuid_.end()));
+}
 
 MockRandomGenerator::~MockRandomGenerator() {}
 
-MockSnapshot::MockSnapshot() { ON_CALL(*this, getInteger(_, _)).WillByDefault(ReturnArg<1>()); }
+MockSnapshot::MockSnapshot() {
+  ON_CALL(*this, get(_)).WillByDefault(ReturnRef(EMPTY_STRING));
+  ON_CALL(*this, getInteger(_, _)).WillByDefault(ReturnArg<1>());
+}
 
 MockSnapshot::~MockSnapshot() {}
 
-MockLoader::MockLoader() { ON_CALL(*this, snapshot()).WillByDefault(ReturnRef(snapshot_)); }
+MockLoader::MockLoader() {
+  ON_CALL(*this, snapshot()).WillByDefault(ReturnRef(snapshot_));
+  ON_CALL(*this, featureHandle(_))
+      .WillByDefault(Invoke([this](const std::string& key) -> FeatureHandleSharedPtr {
+        return std::make_shared<SnapshotFeatureHandle>(*this, key);
+      }));
+}
 
 MockLoader::~MockLoader() {}
 
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <string>
+#include <unordered_map>
 
 #include "envoy/runtime/runtime.h"
 
@@ -17,6 +18,7 @@ public:
 
   MOCK_METHOD0(random, uint64_t());
   MOCK_METHOD0(uuid, std::string());
+  MOCK_METHOD1(uuid, void(char* buffer));
 
   const std::string uuid_{"a121e9e1-feae-4136-9e0e-6fac343d56c9"};
 };
@@ -33,6 +35,48 @@ public:
                                           uint64_t random_value, uint16_t num_buckets));
   MOCK_CONST_METHOD1(get, const std::string&(const std::string& key));
   MOCK_CONST_METHOD2(getInteger, uint64_t(const std::string& key, uint64_t default_value));
+
+  // Prehashed keys are looked up by name so that expectations only need to be set on one variant.
+  bool featureEnabled(const Key& key, uint64_t default_value) const override {
+    return featureEnabled(key.name(), default_value);
+  }
+  bool featureEnabled(const Key& key, uint64_t default_value,
+                      uint64_t random_value) const override {
+    return featureEnabled(key.name(), default_value, random_value);
+  }
+  bool featureEnabled(const Key& key, uint64_t default_value, uint64_t random_value,
+                      uint16_t num_buckets) const override {
+    return featureEnabled(key.name(), default_value, random_value, num_buckets);
+  }
+  const std::string& get(const Key& key) const override { return get(key.name()); }
+  uint64_t getInteger(const Key& key, uint64_t default_value) const override {
+    return getInteger(key.name(), default_value);
+  }
+};
+
+/**
+ * Feature handle that looks its key up in the loader's snapshot on every call, so that
+ * expectations can be set on the snapshot.
+ */
+class SnapshotFeatureHandle : public FeatureHandle {
+public:
+  SnapshotFeatureHandle(Loader& loader, const std::string& key) : loader_(loader), key_(key) {}
+
+  // Runtime::FeatureHandle
+  bool featureEnabled(uint64_t default_value) const override {
+    return loader_.snapshot().featureEnabled(key_, default_value);
+  }
+  bool featureEnabled(uint64_t default_value, uint64_t random_value) const override {
+    return loader_.snapshot().featureEnabled(key_, default_value, random_value);
+  }
+  uint64_t getInteger(uint64_t default_value) const override {
+    return loader_.snapshot().getInteger(key_, default_value);
+  }
+  const std::string& key() const override { return key_; }
+
+private:
+  Loader& loader_;
+  const std::string key_;
 };
 
 class MockLoader : public Loader {
@@ -41,6 +85,8 @@ public:
   ~MockLoader();
 
   MOCK_METHOD0(snapshot, Snapshot&());
+  MOCK_METHOD1(featureHandle, FeatureHandleSharedPtr(const std::string& key));
+  MOCK_METHOD1(mergeValues, void(const std::unordered_map<std::string, std::string>& values));
 
   testing::NiceMock<MockSnapshot> snapshot_;
 };
@@ -21,9 +21,18 @@ MockOptions::MockOptions(const std::string& config_path)
     : config_path_(config_path), admin_address_path_("") {
   ON_CALL(*this, configPath()).WillByDefault(ReturnRef(config_path_));
   ON_CALL(*this, adminAddressPath()).WillByDefault(ReturnRef(admin_address_path_));
+  ON_CALL(*this, xdsCacheDirectory()).WillByDefault(ReturnRef(xds_cache_directory_));
   ON_CALL(*this, serviceClusterName()).WillByDefault(ReturnRef(service_cluster_name_));
   ON_CALL(*this, serviceNodeName()).WillByDefault(ReturnRef(service_node_name_));
   ON_CALL(*this, serviceZone()).WillByDefault(ReturnRef(service_zone_name_));
+  ON_CALL(*this, maxStats()).WillByDefault(Return(16384));
+  ON_CALL(*this, connectionReadBudget()).WillByDefault(Return(262144));
+  ON_CALL(*this, eventBackend()).WillByDefault(ReturnRef(event_backend_));
+  ON_CALL(*this, workerCpus()).WillByDefault(ReturnRef(worker_cpus_));
+  ON_CALL(*this, maxAcceptsPerEvent()).WillByDefault(Return(64));
+  ON_CALL(*this, dnsCacheConfig()).WillByDefault(ReturnRef(dns_cache_config_));
+  ON_CALL(*this, overloadConfig()).WillByDefault(ReturnRef(overload_config_));
+  ON_CALL(*this, statsTags()).WillByDefault(ReturnRef(stats_tags_));
 }
 MockOptions::~MockOptions() {}
 
@@ -35,6 +44,9 @@ MockDrainManager::MockDrainManager() {
 }
 MockDrainManager::~MockDrainManager() {}
 
+MockOverloadManager::MockOverloadManager() {}
+MockOverloadManager::~MockOverloadManager() {}
+
 MockWatchDog::MockWatchDog() {}
 MockWatchDog::~MockWatchDog() {}
 
@@ -49,6 +61,7 @@ MockHotRestart::~MockHotRestart() {}
 MockListenerComponentFactory::MockListenerComponentFactory()
     : socket_(std::make_shared<NiceMock<Network::MockListenSocket>>()) {
   ON_CALL(*this, createListenSocket(_, _)).WillByDefault(Return(socket_));
+  ON_CALL(*this, createReusePortListenSocket(_, _)).WillByDefault(Return(socket_));
 }
 MockListenerComponentFactory::~MockListenerComponentFactory() {}
 
@@ -58,6 +71,7 @@ MockListenerManager::~MockListenerManager() {}
 MockListener::MockListener() {
   ON_CALL(*this, filterChainFactory()).WillByDefault(ReturnRef(filter_chain_factory_));
   ON_CALL(*this, socket()).WillByDefault(ReturnRef(socket_));
+  ON_CALL(*this, workerSocket(_)).WillByDefault(ReturnRef(socket_));
   ON_CALL(*this, listenerScope()).WillByDefault(ReturnRef(scope_));
   ON_CALL(*this, name()).WillByDefault(ReturnRef(name_));
 }
@@ -78,6 +92,12 @@ MockWorker::MockWorker() {
         EXPECT_EQ(nullptr, remove_listener_completion_);
         remove_listener_completion_ = completion;
       }));
+
+  ON_CALL(*this, retireListener(_, _))
+      .WillByDefault(Invoke([this](Listener&, std::function<void()> completion) -> void {
+        EXPECT_EQ(nullptr, retire_listener_completion_);
+        retire_listener_completion_ = completion;
+      }));
 }
 MockWorker::~MockWorker() {}
 
@@ -101,6 +121,7 @@ MockInstance::MockInstance()
   ON_CALL(*this, drainManager()).WillByDefault(ReturnRef(drain_manager_));
   ON_CALL(*this, initManager()).WillByDefault(ReturnRef(init_manager_));
   ON_CALL(*this, listenerManager()).WillByDefault(ReturnRef(listener_manager_));
+  ON_CALL(*this, overloadManager()).WillByDefault(ReturnRef(overload_manager_));
   ON_CALL(*this, singletonManager()).WillByDefault(ReturnRef(*singleton_manager_));
 }
 
@@ -125,6 +146,7 @@ MockFactoryContext::MockFactoryContext() : singleton_manager_(new Singleton::Man
   ON_CALL(*this, initManager()).WillByDefault(ReturnRef(init_manager_));
   ON_CALL(*this, localInfo()).WillByDefault(ReturnRef(local_info_));
   ON_CALL(*this, random()).WillByDefault(ReturnRef(random_));
+  ON_CALL(*this, overloadManager()).WillByDefault(ReturnRef(overload_manager_));
   ON_CALL(*this, runtime()).WillByDefault(ReturnRef(runtime_loader_));
   ON_CALL(*this, scope()).WillByDefault(ReturnRef(scope_));
   ON_CALL(*this, singletonManager()).WillByDefault(ReturnRef(*singleton_manager_));
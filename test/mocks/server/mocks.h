@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <list>
 #include <string>
+#include <vector>
 
 #include "envoy/server/admin.h"
 #include "envoy/server/configuration.h"
@@ -11,6 +12,7 @@
 #include "envoy/server/filter_config.h"
 #include "envoy/server/instance.h"
 #include "envoy/server/options.h"
+#include "envoy/server/overload_manager.h"
 #include "envoy/server/worker.h"
 #include "envoy/ssl/context_manager.h"
 
@@ -47,11 +49,26 @@ public:
   MOCK_METHOD0(concurrency, uint32_t());
   MOCK_METHOD0(configPath, const std::string&());
   MOCK_METHOD0(adminAddressPath, const std::string&());
+  MOCK_METHOD0(xdsCacheDirectory, const std::string&());
   MOCK_METHOD0(localAddressIpVersion, Network::Address::IpVersion());
   MOCK_METHOD0(drainTime, std::chrono::seconds());
+  MOCK_METHOD0(drainCloseRate, uint32_t());
+  MOCK_METHOD0(maxStats, uint32_t());
+  MOCK_METHOD0(connectionReadBudget, uint64_t());
+  MOCK_METHOD0(eventBackend, const std::string&());
+  MOCK_METHOD0(maxAcceptsPerEvent, uint32_t());
   MOCK_METHOD0(logLevel, spdlog::level::level_enum());
+  MOCK_METHOD0(logAsyncBufferSize, uint32_t());
   MOCK_METHOD0(parentShutdownTime, std::chrono::seconds());
   MOCK_METHOD0(restartEpoch, uint64_t());
+  MOCK_METHOD0(reusePort, bool());
+  MOCK_METHOD0(balanceConnections, bool());
+  MOCK_METHOD0(privateKeyThreads, uint32_t());
+  MOCK_METHOD0(workerCpus, const std::vector<uint32_t>&());
+  MOCK_METHOD0(dnsCacheConfig, const Network::DnsCacheConfig&());
+  MOCK_METHOD0(overloadConfig, const OverloadConfig&());
+  MOCK_METHOD0(statsTags, const std::vector<std::pair<std::string, std::string>>&());
+  MOCK_METHOD0(watchdogSampleStacks, bool());
   MOCK_METHOD0(fileFlushIntervalMsec, std::chrono::milliseconds());
   MOCK_CONST_METHOD0(mode, Mode());
   MOCK_METHOD0(serviceClusterName, const std::string&());
@@ -60,9 +77,15 @@ public:
 
   std::string config_path_;
   std::string admin_address_path_;
+  std::string xds_cache_directory_;
   std::string service_cluster_name_;
   std::string service_node_name_;
   std::string service_zone_name_;
+  std::string event_backend_;
+  std::vector<uint32_t> worker_cpus_;
+  Network::DnsCacheConfig dns_cache_config_;
+  OverloadConfig overload_config_;
+  std::vector<std::pair<std::string, std::string>> stats_tags_;
 };
 
 class MockAdmin : public Admin {
@@ -90,6 +113,18 @@ public:
   std::function<void()> drain_sequence_completion_;
 };
 
+class MockOverloadManager : public OverloadManager {
+public:
+  MockOverloadManager();
+  ~MockOverloadManager();
+
+  // Server::OverloadManager
+  MOCK_METHOD0(start, void());
+  MOCK_METHOD3(registerForAction,
+               void(OverloadAction action, Event::Dispatcher& dispatcher, ActionCb callback));
+  MOCK_CONST_METHOD1(isActive, bool(OverloadAction action));
+};
+
 class MockWatchDog : public WatchDog {
 public:
   MockWatchDog();
@@ -121,7 +156,8 @@ public:
 
   // Server::HotRestart
   MOCK_METHOD0(drainParentListeners, void());
-  MOCK_METHOD1(duplicateParentListenSocket, int(const std::string& address));
+  MOCK_METHOD2(duplicateParentListenSocket,
+               int(const std::string& address, uint32_t worker_index));
   MOCK_METHOD1(getParentStats, void(GetParentStatsInfo& info));
   MOCK_METHOD2(initialize, void(Event::Dispatcher& dispatcher, Server::Instance& server));
   MOCK_METHOD1(shutdownParentAdmin, void(ShutdownParentAdminInfo& info));
@@ -144,6 +180,9 @@ public:
   MOCK_METHOD2(createListenSocket,
                Network::ListenSocketSharedPtr(Network::Address::InstanceConstSharedPtr address,
                                               bool bind_to_port));
+  MOCK_METHOD2(createReusePortListenSocket,
+               Network::ListenSocketSharedPtr(Network::Address::InstanceConstSharedPtr address,
+                                              uint32_t worker_index));
   MOCK_METHOD0(createDrainManager_, DrainManager*());
   MOCK_METHOD0(nextListenerTag, uint64_t());
 
@@ -171,11 +210,14 @@ public:
 
   MOCK_METHOD0(filterChainFactory, Network::FilterChainFactory&());
   MOCK_METHOD0(socket, Network::ListenSocket&());
+  MOCK_METHOD1(workerSocket, Network::ListenSocket&(uint32_t worker_index));
   MOCK_METHOD0(sslContext, Ssl::ServerContext*());
   MOCK_METHOD0(useProxyProto, bool());
   MOCK_METHOD0(bindToPort, bool());
   MOCK_METHOD0(useOriginalDst, bool());
   MOCK_METHOD0(perConnectionBufferLimitBytes, uint32_t());
+  MOCK_METHOD0(maxAcceptsPerEvent, uint32_t());
+  MOCK_METHOD0(connectionLimit, Network::ConnectionLimitSharedPtr());
   MOCK_METHOD0(listenerScope, Stats::Scope&());
   MOCK_METHOD0(listenerTag, uint64_t());
   MOCK_CONST_METHOD0(name, const std::string&());
@@ -214,10 +256,17 @@ public:
     remove_listener_completion_ = nullptr;
   }
 
+  void callRetireCompletion() {
+    EXPECT_NE(nullptr, retire_listener_completion_);
+    retire_listener_completion_();
+    retire_listener_completion_ = nullptr;
+  }
+
   // Server::Worker
   MOCK_METHOD2(addListener, void(Listener& listener, AddListenerCompletion completion));
   MOCK_METHOD0(numConnections, uint64_t());
   MOCK_METHOD2(removeListener, void(Listener& listener, std::function<void()> completion));
+  MOCK_METHOD2(retireListener, void(Listener& listener, std::function<void()> completion));
   MOCK_METHOD1(start, void(GuardDog& guard_dog));
   MOCK_METHOD0(stop, void());
   MOCK_METHOD1(stopListener, void(Listener& listener));
@@ -225,6 +274,7 @@ public:
 
   AddListenerCompletion add_listener_completion_;
   std::function<void()> remove_listener_completion_;
+  std::function<void()> retire_listener_completion_;
 };
 
 class MockInstance : public Instance {
@@ -253,6 +303,7 @@ public:
   MOCK_METHOD0(initManager, Init::Manager&());
   MOCK_METHOD0(listenerManager, ListenerManager&());
   MOCK_METHOD0(options, Options&());
+  MOCK_METHOD0(overloadManager, OverloadManager&());
   MOCK_METHOD0(random, Runtime::RandomGenerator&());
   MOCK_METHOD0(rateLimitClient_, RateLimit::Client*());
   MOCK_METHOD0(runtime, Runtime::Loader&());
@@ -286,6 +337,7 @@ public:
   testing::NiceMock<LocalInfo::MockLocalInfo> local_info_;
   testing::NiceMock<Init::MockManager> init_manager_;
   testing::NiceMock<MockListenerManager> listener_manager_;
+  testing::NiceMock<MockOverloadManager> overload_manager_;
   Singleton::ManagerPtr singleton_manager_;
 };
 
@@ -330,6 +382,7 @@ public:
   MOCK_METHOD0(initManager, Init::Manager&());
   MOCK_METHOD0(localInfo, const LocalInfo::LocalInfo&());
   MOCK_METHOD0(random, Envoy::Runtime::RandomGenerator&());
+  MOCK_METHOD0(overloadManager, OverloadManager&());
   MOCK_METHOD0(rateLimitClient_, RateLimit::Client*());
   MOCK_METHOD0(runtime, Envoy::Runtime::Loader&());
   MOCK_METHOD0(scope, Stats::Scope&());
@@ -345,6 +398,7 @@ public:
   testing::NiceMock<Init::MockManager> init_manager_;
   testing::NiceMock<LocalInfo::MockLocalInfo> local_info_;
   testing::NiceMock<Envoy::Runtime::MockRandomGenerator> random_;
+  testing::NiceMock<MockOverloadManager> overload_manager_;
   testing::NiceMock<Envoy::Runtime::MockLoader> runtime_loader_;
   Stats::IsolatedStoreImpl scope_;
   testing::NiceMock<ThreadLocal::MockInstance> thread_local_;
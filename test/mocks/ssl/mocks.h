@@ -45,6 +45,7 @@ public:
   MOCK_METHOD0(peerCertificatePresented, bool());
   MOCK_METHOD0(uriSanLocalCertificate, std::string());
   MOCK_METHOD0(sha256PeerCertificateDigest, std::string());
+  MOCK_METHOD1(rawSha256PeerCertificateDigest, bool(Sha256Digest& digest));
   MOCK_METHOD0(subjectPeerCertificate, std::string());
   MOCK_METHOD0(uriSanPeerCertificate, std::string());
 };
@@ -3,15 +3,16 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+using testing::ReturnRef;
 using testing::_;
 
 namespace Envoy {
 namespace Stats {
 
-MockCounter::MockCounter() {}
+MockCounter::MockCounter() { ON_CALL(*this, tags()).WillByDefault(ReturnRef(tags_)); }
 MockCounter::~MockCounter() {}
 
-MockGauge::MockGauge() {}
+MockGauge::MockGauge() { ON_CALL(*this, tags()).WillByDefault(ReturnRef(tags_)); }
 MockGauge::~MockGauge() {}
 
 MockTimespan::MockTimespan() {}
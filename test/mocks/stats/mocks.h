@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <list>
 #include <string>
+#include <vector>
 
 #include "envoy/stats/stats.h"
 #include "envoy/thread_local/thread_local.h"
@@ -24,10 +25,14 @@ public:
   MOCK_METHOD1(add, void(uint64_t amount));
   MOCK_METHOD0(inc, void());
   MOCK_METHOD0(latch, uint64_t());
-  MOCK_METHOD0(name, std::string());
+  MOCK_CONST_METHOD0(name, std::string());
   MOCK_METHOD0(reset, void());
   MOCK_METHOD0(used, bool());
   MOCK_METHOD0(value, uint64_t());
+  MOCK_CONST_METHOD0(tagExtractedName, std::string());
+  MOCK_CONST_METHOD0(tags, const std::vector<Tag>&());
+
+  std::vector<Tag> tags_;
 };
 
 class MockGauge : public Gauge {
@@ -38,11 +43,15 @@ public:
   MOCK_METHOD1(add, void(uint64_t amount));
   MOCK_METHOD0(dec, void());
   MOCK_METHOD0(inc, void());
-  MOCK_METHOD0(name, std::string());
+  MOCK_CONST_METHOD0(name, std::string());
   MOCK_METHOD1(set, void(uint64_t value));
   MOCK_METHOD1(sub, void(uint64_t amount));
   MOCK_METHOD0(used, bool());
   MOCK_METHOD0(value, uint64_t());
+  MOCK_CONST_METHOD0(tagExtractedName, std::string());
+  MOCK_CONST_METHOD0(tags, const std::vector<Tag>&());
+
+  std::vector<Tag> tags_;
 };
 
 class MockTimespan : public Timespan {
@@ -60,8 +69,10 @@ public:
   ~MockSink();
 
   MOCK_METHOD0(beginFlush, void());
-  MOCK_METHOD2(flushCounter, void(const std::string& name, uint64_t delta));
-  MOCK_METHOD2(flushGauge, void(const std::string& name, uint64_t value));
+  MOCK_CONST_METHOD0(wantsAllGauges, bool());
+  MOCK_METHOD2(flushCounter, void(const Counter& counter, uint64_t delta));
+  MOCK_METHOD2(flushGauge, void(const Gauge& gauge, uint64_t value));
+  MOCK_METHOD1(flushHistogram, void(const ParentHistogram& histogram));
   MOCK_METHOD0(endFlush, void());
   MOCK_METHOD2(onHistogramComplete, void(const std::string& name, uint64_t value));
   MOCK_METHOD2(onTimespanComplete, void(const std::string& name, std::chrono::milliseconds ms));
@@ -82,6 +93,10 @@ public:
   MOCK_METHOD1(gauge, Gauge&(const std::string&));
   MOCK_CONST_METHOD0(gauges, std::list<GaugeSharedPtr>());
   MOCK_METHOD1(timer, Timer&(const std::string& name));
+  MOCK_METHOD1(histogram, Histogram&(const std::string& name));
+  MOCK_CONST_METHOD0(histograms, std::list<ParentHistogramSharedPtr>());
+  MOCK_METHOD0(latchChangedCounters, std::vector<CounterSharedPtr>());
+  MOCK_METHOD0(latchChangedGauges, std::vector<GaugeSharedPtr>());
 
   testing::NiceMock<MockCounter> counter_;
 };
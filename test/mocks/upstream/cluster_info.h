@@ -4,10 +4,13 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "envoy/upstream/cluster_manager.h"
 #include "envoy/upstream/upstream.h"
 
+#include "common/http/codes.h"
+
 #include "test/mocks/runtime/mocks.h"
 #include "test/mocks/stats/mocks.h"
 
@@ -31,24 +34,42 @@ public:
   MOCK_CONST_METHOD0(features, uint64_t());
   MOCK_CONST_METHOD0(http2Settings, const Http::Http2Settings&());
   MOCK_CONST_METHOD0(lbType, LoadBalancerType());
+  MOCK_CONST_METHOD0(lbSubsetKeys, const std::vector<std::vector<std::string>>&());
   MOCK_CONST_METHOD0(maintenanceMode, bool());
   MOCK_CONST_METHOD0(maxRequestsPerConnection, uint64_t());
+  MOCK_CONST_METHOD0(minIdleConnections, uint32_t());
+  MOCK_CONST_METHOD0(connectionPrefetchPercent, uint32_t());
+  MOCK_CONST_METHOD0(idleConnectionTimeout, std::chrono::milliseconds());
+  MOCK_CONST_METHOD0(connectionReuseFifo, bool());
+  MOCK_CONST_METHOD0(maxHostConnections, uint64_t());
+  MOCK_CONST_METHOD0(maxHostRequests, uint64_t());
   MOCK_CONST_METHOD0(name, const std::string&());
   MOCK_CONST_METHOD1(resourceManager, ResourceManager&(ResourcePriority priority));
   MOCK_CONST_METHOD0(sslContext, Ssl::ClientContext*());
   MOCK_CONST_METHOD0(stats, ClusterStats&());
   MOCK_CONST_METHOD0(statsScope, Stats::Scope&());
+  MOCK_CONST_METHOD0(codeStats, Http::UpstreamCodeStats&());
   MOCK_CONST_METHOD0(sourceAddress, const Network::Address::InstanceConstSharedPtr&());
+  MOCK_CONST_METHOD0(socketOptions, const Network::SocketOptions&());
 
   std::string name_{"fake_cluster"};
   Http::Http2Settings http2_settings_{};
   uint64_t max_requests_per_connection_{};
+  uint32_t min_idle_connections_{};
+  uint32_t connection_prefetch_percent_{100};
+  std::chrono::milliseconds idle_connection_timeout_{};
+  bool connection_reuse_fifo_{};
+  uint64_t max_host_connections_{};
+  uint64_t max_host_requests_{};
   NiceMock<Stats::MockIsolatedStatsStore> stats_store_;
   ClusterStats stats_;
+  Http::UpstreamCodeStatsImpl code_stats_{stats_store_};
   NiceMock<Runtime::MockLoader> runtime_;
   std::unique_ptr<Upstream::ResourceManager> resource_manager_;
   Network::Address::InstanceConstSharedPtr source_address_;
   LoadBalancerType lb_type_{LoadBalancerType::RoundRobin};
+  std::vector<std::vector<std::string>> lb_subset_keys_;
+  Network::SocketOptions socket_options_;
 };
 
 } // namespace Upstream
@@ -29,6 +29,7 @@ public:
   MOCK_METHOD0(lastUnejectionTime, const Optional<MonotonicTime>&());
   MOCK_CONST_METHOD0(successRate, double());
   MOCK_METHOD1(successRate, void(double new_success_rate));
+  MOCK_CONST_METHOD0(latency, double());
 };
 
 class MockEventLogger : public EventLogger {
@@ -55,6 +56,8 @@ public:
   MOCK_METHOD1(addChangedStateCb, void(ChangeStateCb cb));
   MOCK_CONST_METHOD0(successRateAverage, double());
   MOCK_CONST_METHOD0(successRateEjectionThreshold, double());
+  MOCK_CONST_METHOD0(latencyAverage, double());
+  MOCK_CONST_METHOD0(latencyEjectionThreshold, double());
 
   std::list<ChangeStateCb> callbacks_;
 };
@@ -83,6 +86,10 @@ public:
   MOCK_CONST_METHOD0(hostname, const std::string&());
   MOCK_CONST_METHOD0(stats, HostStats&());
   MOCK_CONST_METHOD0(zone, const std::string&());
+  MOCK_CONST_METHOD0(priority, uint32_t());
+  MOCK_CONST_METHOD0(localityWeight, uint32_t());
+  MOCK_CONST_METHOD1(reportLoad, void(uint32_t load));
+  MOCK_CONST_METHOD0(reportedLoad, uint32_t());
 
   std::string hostname_;
   Network::Address::InstanceConstSharedPtr address_;
@@ -138,6 +145,10 @@ public:
   MOCK_CONST_METHOD0(used, bool());
   MOCK_METHOD1(used, void(bool new_used));
   MOCK_CONST_METHOD0(zone, const std::string&());
+  MOCK_CONST_METHOD0(priority, uint32_t());
+  MOCK_CONST_METHOD0(localityWeight, uint32_t());
+  MOCK_CONST_METHOD1(reportLoad, void(uint32_t load));
+  MOCK_CONST_METHOD0(reportedLoad, uint32_t());
 
   testing::NiceMock<MockClusterInfo> cluster_;
   testing::NiceMock<Outlier::MockDetectorHostMonitor> outlier_detector_;
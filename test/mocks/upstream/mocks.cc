@@ -63,20 +63,31 @@ MockHost::~MockHost() {}
 
 MockClusterInfo::MockClusterInfo()
     : stats_(ClusterInfoImpl::generateStats(stats_store_)),
-      resource_manager_(new Upstream::ResourceManagerImpl(runtime_, "fake_key", 1, 1024, 1024, 1)) {
+      resource_manager_(
+          new Upstream::ResourceManagerImpl(runtime_, "fake_key", 1, 1024, 1024, 1, stats_store_)) {
 
   ON_CALL(*this, connectTimeout()).WillByDefault(Return(std::chrono::milliseconds(1)));
   ON_CALL(*this, name()).WillByDefault(ReturnRef(name_));
   ON_CALL(*this, http2Settings()).WillByDefault(ReturnRef(http2_settings_));
   ON_CALL(*this, maxRequestsPerConnection())
       .WillByDefault(ReturnPointee(&max_requests_per_connection_));
+  ON_CALL(*this, minIdleConnections()).WillByDefault(ReturnPointee(&min_idle_connections_));
+  ON_CALL(*this, connectionPrefetchPercent())
+      .WillByDefault(ReturnPointee(&connection_prefetch_percent_));
+  ON_CALL(*this, idleConnectionTimeout()).WillByDefault(ReturnPointee(&idle_connection_timeout_));
+  ON_CALL(*this, connectionReuseFifo()).WillByDefault(ReturnPointee(&connection_reuse_fifo_));
+  ON_CALL(*this, maxHostConnections()).WillByDefault(ReturnPointee(&max_host_connections_));
+  ON_CALL(*this, maxHostRequests()).WillByDefault(ReturnPointee(&max_host_requests_));
   ON_CALL(*this, stats()).WillByDefault(ReturnRef(stats_));
   ON_CALL(*this, statsScope()).WillByDefault(ReturnRef(stats_store_));
+  ON_CALL(*this, codeStats()).WillByDefault(ReturnRef(code_stats_));
   ON_CALL(*this, sourceAddress()).WillByDefault(ReturnRef(source_address_));
   ON_CALL(*this, resourceManager(_))
       .WillByDefault(Invoke(
           [this](ResourcePriority) -> Upstream::ResourceManager& { return *resource_manager_; }));
   ON_CALL(*this, lbType()).WillByDefault(ReturnPointee(&lb_type_));
+  ON_CALL(*this, lbSubsetKeys()).WillByDefault(ReturnRef(lb_subset_keys_));
+  ON_CALL(*this, socketOptions()).WillByDefault(ReturnRef(socket_options_));
   ON_CALL(*this, sourceAddress()).WillByDefault(ReturnRef(source_address_));
 }
 
@@ -91,6 +102,20 @@ MockCluster::MockCluster() {
   ON_CALL(*this, healthyHosts()).WillByDefault(ReturnRef(healthy_hosts_));
   ON_CALL(*this, hostsPerZone()).WillByDefault(ReturnRef(hosts_per_zone_));
   ON_CALL(*this, healthyHostsPerZone()).WillByDefault(ReturnRef(healthy_hosts_per_zone_));
+  ON_CALL(*this, hostsPtr()).WillByDefault(Invoke([this]() -> HostVectorConstSharedPtr {
+    return std::make_shared<const std::vector<HostSharedPtr>>(hosts_);
+  }));
+  ON_CALL(*this, healthyHostsPtr()).WillByDefault(Invoke([this]() -> HostVectorConstSharedPtr {
+    return std::make_shared<const std::vector<HostSharedPtr>>(healthy_hosts_);
+  }));
+  ON_CALL(*this, hostsPerZonePtr()).WillByDefault(Invoke([this]() -> HostListsConstSharedPtr {
+    return std::make_shared<const std::vector<std::vector<HostSharedPtr>>>(hosts_per_zone_);
+  }));
+  ON_CALL(*this, healthyHostsPerZonePtr())
+      .WillByDefault(Invoke([this]() -> HostListsConstSharedPtr {
+        return std::make_shared<const std::vector<std::vector<HostSharedPtr>>>(
+            healthy_hosts_per_zone_);
+      }));
   ON_CALL(*this, info()).WillByDefault(Return(info_));
   ON_CALL(*this, setInitializedCb(_))
       .WillByDefault(Invoke([this](std::function<void()> callback) -> void {
@@ -118,10 +143,22 @@ MockClusterManager::MockClusterManager() {
   ON_CALL(*this, httpAsyncClientForCluster(_)).WillByDefault(ReturnRef(async_client_));
   ON_CALL(*this, httpAsyncClientForCluster(_)).WillByDefault((ReturnRef(async_client_)));
   ON_CALL(*this, sourceAddress()).WillByDefault(ReturnRef(source_address_));
+  ON_CALL(*this, xdsCacheDirectory()).WillByDefault(ReturnRef(xds_cache_directory_));
 
   // Matches are LIFO so "" will match first.
   ON_CALL(*this, get(_)).WillByDefault(Return(&thread_local_cluster_));
   ON_CALL(*this, get("")).WillByDefault(Return(nullptr));
+
+  // Lookups by handle are expected by name, so that tests do not depend on how they are done.
+  ON_CALL(*this, getByHandle(_))
+      .WillByDefault(Invoke([this](const ClusterHandle& cluster) -> ThreadLocalCluster* {
+        return get(cluster.name());
+      }));
+  ON_CALL(*this, httpConnPoolForHandle(_, _, _))
+      .WillByDefault(Invoke([this](const ClusterHandle& cluster, ResourcePriority priority,
+                                   LoadBalancerContext* context) {
+        return httpConnPoolForCluster(cluster.name(), priority, context);
+      }));
 }
 
 MockClusterManager::~MockClusterManager() {}
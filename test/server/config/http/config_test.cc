@@ -8,11 +8,13 @@
 #include "common/protobuf/utility.h"
 
 #include "server/config/http/buffer.h"
+#include "server/config/http/cache.h"
 #include "server/config/http/dynamo.h"
 #include "server/config/http/fault.h"
 #include "server/config/http/file_access_log.h"
 #include "server/config/http/grpc_http1_bridge.h"
 #include "server/config/http/grpc_web.h"
+#include "server/config/http/gzip.h"
 #include "server/config/http/ip_tagging.h"
 #include "server/config/http/ratelimit.h"
 #include "server/config/http/router.h"
@@ -51,6 +53,27 @@ TEST(HttpFilterConfigTest, BufferFilter) {
   cb(filter_callback);
 }
 
+TEST(HttpFilterConfigTest, BufferFilterSpill) {
+  std::string json_string = R"EOF(
+  {
+    "max_request_bytes" : 1048576,
+    "max_request_time_s" : 2,
+    "spill" : {
+      "directory" : "/tmp",
+      "stream_memory_bytes" : 4096
+    }
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<MockFactoryContext> context;
+  BufferFilterConfig factory;
+  HttpFilterFactoryCb cb = factory.createFilterFactory(*json_config, "stats", context);
+  Http::MockFilterChainFactoryCallbacks filter_callback;
+  EXPECT_CALL(filter_callback, addStreamDecoderFilter(_));
+  cb(filter_callback);
+}
+
 TEST(HttpFilterConfigTest, BadBufferFilterConfig) {
   std::string json_string = R"EOF(
   {
@@ -65,6 +88,67 @@ TEST(HttpFilterConfigTest, BadBufferFilterConfig) {
   EXPECT_THROW(factory.createFilterFactory(*json_config, "stats", context), Json::Exception);
 }
 
+TEST(HttpFilterConfigTest, CacheFilter) {
+  std::string json_string = R"EOF(
+  {
+    "max_bytes" : 1048576,
+    "max_entry_bytes" : 1024
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<MockFactoryContext> context;
+  CacheFilterConfig factory;
+  HttpFilterFactoryCb cb = factory.createFilterFactory(*json_config, "stats", context);
+  Http::MockFilterChainFactoryCallbacks filter_callback;
+  EXPECT_CALL(filter_callback, addStreamFilter(_));
+  cb(filter_callback);
+}
+
+TEST(HttpFilterConfigTest, BadCacheFilterConfig) {
+  std::string json_string = R"EOF(
+  {
+    "max_bytes" : 0
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<MockFactoryContext> context;
+  CacheFilterConfig factory;
+  EXPECT_THROW(factory.createFilterFactory(*json_config, "stats", context), Json::Exception);
+}
+
+TEST(HttpFilterConfigTest, GzipFilter) {
+  std::string json_string = R"EOF(
+  {
+    "compression_level" : 1,
+    "min_content_length" : 100,
+    "content_types" : ["text/html"]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<MockFactoryContext> context;
+  GzipFilterConfig factory;
+  HttpFilterFactoryCb cb = factory.createFilterFactory(*json_config, "stats", context);
+  Http::MockFilterChainFactoryCallbacks filter_callback;
+  EXPECT_CALL(filter_callback, addStreamFilter(_));
+  cb(filter_callback);
+}
+
+TEST(HttpFilterConfigTest, BadGzipFilterConfig) {
+  std::string json_string = R"EOF(
+  {
+    "window_bits" : 16
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<MockFactoryContext> context;
+  GzipFilterConfig factory;
+  EXPECT_THROW(factory.createFilterFactory(*json_config, "stats", context), Json::Exception);
+}
+
 TEST(HttpFilterConfigTest, RateLimitFilter) {
   std::string json_string = R"EOF(
   {
@@ -82,6 +166,52 @@ TEST(HttpFilterConfigTest, RateLimitFilter) {
   cb(filter_callback);
 }
 
+TEST(HttpFilterConfigTest, RateLimitFilterLocal) {
+  std::string json_string = R"EOF(
+  {
+    "domain" : "test",
+    "local" : {
+      "limits" : [
+        {
+          "descriptor" : [{"key" : "destination_cluster", "value" : "foo"}],
+          "requests_per_second" : 100,
+          "burst" : 200
+        }
+      ],
+      "global_sync" : {}
+    }
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<MockFactoryContext> context;
+  RateLimitFilterConfig factory;
+  HttpFilterFactoryCb cb = factory.createFilterFactory(*json_config, "stats", context);
+  Http::MockFilterChainFactoryCallbacks filter_callback;
+  EXPECT_CALL(filter_callback, addStreamDecoderFilter(_));
+  cb(filter_callback);
+}
+
+TEST(HttpFilterConfigTest, RateLimitFilterCoalesce) {
+  std::string json_string = R"EOF(
+  {
+    "domain" : "test",
+    "coalesce" : {
+      "cache_ttl_ms" : 100,
+      "max_cache_entries" : 128
+    }
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<MockFactoryContext> context;
+  RateLimitFilterConfig factory;
+  HttpFilterFactoryCb cb = factory.createFilterFactory(*json_config, "stats", context);
+  Http::MockFilterChainFactoryCallbacks filter_callback;
+  EXPECT_CALL(filter_callback, addStreamDecoderFilter(_));
+  cb(filter_callback);
+}
+
 TEST(HttpFilterConfigTest, BadRateLimitFilterConfig) {
   std::string json_string = R"EOF(
   {
@@ -196,7 +326,8 @@ TEST(HttpFilterConfigTest, BadHealthCheckFilterConfig) {
 TEST(HttpFilterConfigTest, RouterFilter) {
   std::string json_string = R"EOF(
   {
-    "dynamic_stats" : true
+    "dynamic_stats" : true,
+    "retry_buffer_limit_bytes" : 65536
   }
   )EOF";
 
@@ -5,6 +5,7 @@
 
 #include "server/config/network/http_connection_manager.h"
 
+#include "test/mocks/http/mocks.h"
 #include "test/mocks/network/mocks.h"
 #include "test/mocks/server/mocks.h"
 #include "test/test_common/printers.h"
@@ -111,6 +112,57 @@ TEST_F(HttpConnectionManagerConfigTest, MiscConfig) {
   EXPECT_EQ("foo", config.serverName());
 }
 
+TEST_F(HttpConnectionManagerConfigTest, MaxPipelineDepth) {
+  const std::string json_string = R"EOF(
+  {
+    "codec_type": "http1",
+    "stat_prefix": "router",
+    "route_config":
+    {
+      "virtual_hosts": [
+        {
+          "name": "service",
+          "domains": [ "*" ],
+          "routes": [
+            {
+              "prefix": "/",
+              "cluster": "cluster"
+            }
+          ]
+        }
+      ]
+    },
+    "filters": [
+      { "type": "both", "name": "http_dynamo_filter", "config": {} }
+    ]
+  }
+  )EOF";
+
+  HttpConnectionManagerConfig config(parseHttpConnectionManagerFromJson(json_string), context_,
+                                     date_provider_, route_config_provider_manager_);
+  NiceMock<Network::MockConnection> connection;
+  NiceMock<Http::MockServerConnectionCallbacks> callbacks;
+  Buffer::OwnedImpl data;
+
+  // The depth is read once per codec, which reports it to the connection manager.
+  EXPECT_CALL(context_.runtime_loader_.snapshot_,
+              getInteger(Http::ConnectionManagerImpl::MAX_PIPELINE_DEPTH_KEY, 1))
+      .WillOnce(Return(4));
+  EXPECT_EQ(4U, config.createCodec(connection, data, callbacks)->maxPipelineDepth());
+
+  // Values that do not fit a sane depth, including ones that would wrap a uint32_t, are clamped.
+  EXPECT_CALL(context_.runtime_loader_.snapshot_,
+              getInteger(Http::ConnectionManagerImpl::MAX_PIPELINE_DEPTH_KEY, 1))
+      .WillOnce(Return(1ULL << 32));
+  EXPECT_EQ(Http::ConnectionManagerImpl::MAX_PIPELINE_DEPTH,
+            config.createCodec(connection, data, callbacks)->maxPipelineDepth());
+
+  EXPECT_CALL(context_.runtime_loader_.snapshot_,
+              getInteger(Http::ConnectionManagerImpl::MAX_PIPELINE_DEPTH_KEY, 1))
+      .WillOnce(Return(0));
+  EXPECT_EQ(1U, config.createCodec(connection, data, callbacks)->maxPipelineDepth());
+}
+
 TEST_F(HttpConnectionManagerConfigTest, SingleDateProvider) {
   const std::string json_string = R"EOF(
   {
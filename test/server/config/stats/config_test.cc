@@ -4,8 +4,11 @@
 
 #include "common/config/well_known_names.h"
 #include "common/protobuf/utility.h"
+#include "common/stats/metrics_service.pb.h"
+#include "common/stats/metrics_service_sink.h"
 #include "common/stats/statsd.h"
 
+#include "server/config/stats/metrics_service.h"
 #include "server/config/stats/statsd.h"
 
 #include "test/mocks/server/mocks.h"
@@ -44,6 +47,24 @@ TEST(StatsConfigTest, ValidTcpStatsd) {
   EXPECT_NE(dynamic_cast<Stats::Statsd::TcpStatsdSink*>(sink.get()), nullptr);
 }
 
+TEST(StatsConfigTest, ValidMetricsService) {
+  const std::string name = Config::StatsSinkNames::get().METRICS_SERVICE;
+
+  envoy::metrics::MetricsServiceSinkConfig sink_config;
+  sink_config.set_cluster_name("fake_cluster");
+
+  StatsSinkFactory* factory = Registry::FactoryRegistry<StatsSinkFactory>::getFactory(name);
+  ASSERT_NE(factory, nullptr);
+
+  ProtobufTypes::MessagePtr message = factory->createEmptyConfigProto();
+  MessageUtil::jsonConvert(sink_config, *message);
+
+  NiceMock<MockInstance> server;
+  Stats::SinkPtr sink = factory->createStatsSink(*message, server);
+  EXPECT_NE(sink, nullptr);
+  EXPECT_NE(dynamic_cast<Stats::Metrics::MetricsServiceSink*>(sink.get()), nullptr);
+}
+
 class StatsConfigLoopbackTest : public testing::TestWithParam<Network::Address::IpVersion> {};
 INSTANTIATE_TEST_CASE_P(IpVersions, StatsConfigLoopbackTest,
                         testing::ValuesIn(TestEnvironment::getIpVersionsForTest()));
@@ -15,6 +15,7 @@ using testing::InSequence;
 using testing::Invoke;
 using testing::NiceMock;
 using testing::Return;
+using testing::SaveArg;
 using testing::_;
 
 namespace Envoy {
@@ -69,6 +70,75 @@ TEST_F(ConnectionHandlerTest, RemoveListener) {
   handler_->removeListeners(0);
 }
 
+// A retired listener stops accepting, and is removed once its last connection has closed.
+TEST_F(ConnectionHandlerTest, RetireListener) {
+  Network::MockListener* listener = new NiceMock<Network::MockListener>();
+  Network::ListenerCallbacks* listener_callbacks;
+  EXPECT_CALL(dispatcher_, createListener_(_, _, _, _, _))
+      .WillOnce(Invoke([&](Network::ConnectionHandler&, Network::ListenSocket&,
+                           Network::ListenerCallbacks& cb, Stats::Scope&,
+                           const Network::ListenerOptions&) -> Network::Listener* {
+        listener_callbacks = &cb;
+        return listener;
+      }));
+  handler_->addListener(factory_, socket_, stats_store_, 1,
+                        Network::ListenerOptions::listenerOptionsWithBindToPort());
+
+  Network::MockConnection* connection = new NiceMock<Network::MockConnection>();
+  EXPECT_CALL(factory_, createFilterChain(_)).WillOnce(Return(true));
+  listener_callbacks->onNewConnection(Network::ConnectionPtr{connection});
+
+  uint32_t retired = 0;
+  EXPECT_CALL(*listener, onDestroy());
+  handler_->retireListeners(1, [&retired]() -> void { retired++; });
+  EXPECT_EQ(0U, retired);
+
+  // The removal waits for the connection to be out of its close callbacks.
+  Event::PostCb post_cb;
+  EXPECT_CALL(dispatcher_, post(_)).WillOnce(SaveArg<0>(&post_cb));
+  connection->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_EQ(0UL, handler_->numConnections());
+  EXPECT_EQ(0U, retired);
+
+  post_cb();
+  EXPECT_EQ(1U, retired);
+  handler_->removeListeners(1);
+  EXPECT_EQ(1U, retired);
+}
+
+// A retired listener without connections is removed right away, and one that is removed before its
+// connections have closed still calls its completion.
+TEST_F(ConnectionHandlerTest, RetireListenerIdleOrRemoved) {
+  Network::ListenerCallbacks* listener_callbacks;
+  EXPECT_CALL(dispatcher_, createListener_(_, _, _, _, _))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](Network::ConnectionHandler&, Network::ListenSocket&,
+                                 Network::ListenerCallbacks& cb, Stats::Scope&,
+                                 const Network::ListenerOptions&) -> Network::Listener* {
+        listener_callbacks = &cb;
+        return new NiceMock<Network::MockListener>();
+      }));
+  handler_->addListener(factory_, socket_, stats_store_, 1,
+                        Network::ListenerOptions::listenerOptionsWithBindToPort());
+  uint32_t retired = 0;
+  handler_->retireListeners(1, [&retired]() -> void { retired++; });
+  EXPECT_EQ(1U, retired);
+
+  handler_->addListener(factory_, socket_, stats_store_, 2,
+                        Network::ListenerOptions::listenerOptionsWithBindToPort());
+  Network::MockConnection* connection = new NiceMock<Network::MockConnection>();
+  EXPECT_CALL(factory_, createFilterChain(_)).WillOnce(Return(true));
+  listener_callbacks->onNewConnection(Network::ConnectionPtr{connection});
+  handler_->retireListeners(2, [&retired]() -> void { retired++; });
+  EXPECT_EQ(1U, retired);
+
+  EXPECT_CALL(*connection, close(Network::ConnectionCloseType::NoFlush));
+  EXPECT_CALL(dispatcher_, post(_)).Times(0);
+  handler_->removeListeners(2);
+  EXPECT_EQ(2U, retired);
+  EXPECT_EQ(0UL, handler_->numConnections());
+}
+
 TEST_F(ConnectionHandlerTest, DestroyCloseConnections) {
   InSequence s;
 
@@ -96,6 +166,97 @@ TEST_F(ConnectionHandlerTest, DestroyCloseConnections) {
   handler_.reset();
 }
 
+TEST_F(ConnectionHandlerTest, HandlerStats) {
+  InSequence s;
+
+  Stats::ScopePtr handler_scope = stats_store_.createScope("worker.");
+  handler_.reset(new ConnectionHandlerImpl(ENVOY_LOGGER(), dispatcher_, *handler_scope, nullptr));
+
+  Network::MockListener* listener = new NiceMock<Network::MockListener>();
+  Network::ListenerCallbacks* listener_callbacks;
+  EXPECT_CALL(dispatcher_, createListener_(_, _, _, _, _))
+      .WillOnce(Invoke([&](Network::ConnectionHandler&, Network::ListenSocket&,
+                           Network::ListenerCallbacks& cb, Stats::Scope&,
+                           const Network::ListenerOptions&) -> Network::Listener* {
+        listener_callbacks = &cb;
+        return listener;
+
+      }));
+  handler_->addListener(factory_, socket_, stats_store_, 1,
+                        Network::ListenerOptions::listenerOptionsWithBindToPort());
+
+  Network::MockConnection* connection = new NiceMock<Network::MockConnection>();
+  EXPECT_CALL(factory_, createFilterChain(_)).WillOnce(Return(true));
+  listener_callbacks->onNewConnection(Network::ConnectionPtr{connection});
+  EXPECT_EQ(1UL, stats_store_.counter("worker.downstream_cx_total").value());
+  EXPECT_EQ(1UL, stats_store_.gauge("worker.downstream_cx_active").value());
+
+  EXPECT_CALL(*connection, close(Network::ConnectionCloseType::NoFlush));
+  EXPECT_CALL(dispatcher_, clearDeferredDeleteList());
+  EXPECT_CALL(*listener, onDestroy());
+  handler_.reset();
+  EXPECT_EQ(1UL, stats_store_.counter("worker.downstream_cx_total").value());
+  EXPECT_EQ(0UL, stats_store_.gauge("worker.downstream_cx_active").value());
+}
+
+TEST_F(ConnectionHandlerTest, BalanceConnections) {
+  ConnectionBalancerImpl balancer;
+  Stats::ScopePtr handler_scope = stats_store_.createScope("worker_0.");
+  handler_.reset(new ConnectionHandlerImpl(ENVOY_LOGGER(), dispatcher_, *handler_scope, &balancer));
+  NiceMock<Event::MockDispatcher> dispatcher2;
+  Stats::ScopePtr handler_scope2 = stats_store_.createScope("worker_1.");
+  Network::ConnectionHandlerPtr handler2(
+      new ConnectionHandlerImpl(ENVOY_LOGGER(), dispatcher2, *handler_scope2, &balancer));
+
+  Network::MockListener* listener = new NiceMock<Network::MockListener>();
+  Network::ListenerCallbacks* listener_callbacks;
+  EXPECT_CALL(dispatcher_, createListener_(_, _, _, _, _))
+      .WillOnce(Invoke([&](Network::ConnectionHandler&, Network::ListenSocket&,
+                           Network::ListenerCallbacks& cb, Stats::Scope&,
+                           const Network::ListenerOptions&) -> Network::Listener* {
+        listener_callbacks = &cb;
+        return listener;
+      }));
+  handler_->addListener(factory_, socket_, stats_store_, 1,
+                        Network::ListenerOptions::listenerOptionsWithBindToPort());
+
+  Network::MockListener* listener2 = new NiceMock<Network::MockListener>();
+  Network::ListenerCallbacks* listener_callbacks2;
+  EXPECT_CALL(dispatcher2, createListener_(_, _, _, _, _))
+      .WillOnce(Invoke([&](Network::ConnectionHandler&, Network::ListenSocket&,
+                           Network::ListenerCallbacks& cb, Stats::Scope&,
+                           const Network::ListenerOptions&) -> Network::Listener* {
+        listener_callbacks2 = &cb;
+        return listener2;
+      }));
+  handler2->addListener(factory_, socket_, stats_store_, 1,
+                        Network::ListenerOptions::listenerOptionsWithBindToPort());
+
+  // The first handler owns a connection, so the second handler is less loaded.
+  Network::MockConnection* connection = new NiceMock<Network::MockConnection>();
+  EXPECT_CALL(factory_, createFilterChain(_)).WillOnce(Return(true));
+  listener_callbacks->onNewConnection(Network::ConnectionPtr{connection});
+
+  // A socket accepted by the first handler is created by the listener of the second handler.
+  Network::Address::InstanceConstSharedPtr remote_address(
+      new Network::Address::Ipv4Instance("127.0.0.1", 10001));
+  Network::Address::InstanceConstSharedPtr local_address(
+      new Network::Address::Ipv4Instance("127.0.0.1", 10000));
+  EXPECT_CALL(*listener2, newConnection(42, remote_address, local_address, false));
+  EXPECT_TRUE(listener_callbacks->onAccept(42, remote_address, local_address, false));
+  EXPECT_EQ(1UL, stats_store_.counter("worker_0.downstream_cx_balanced").value());
+
+  // The second handler keeps the sockets it accepts while it is the least loaded.
+  EXPECT_FALSE(listener_callbacks2->onAccept(43, remote_address, local_address, false));
+  EXPECT_EQ(0UL, stats_store_.counter("worker_1.downstream_cx_balanced").value());
+
+  EXPECT_CALL(*connection, close(Network::ConnectionCloseType::NoFlush));
+  EXPECT_CALL(*listener, onDestroy());
+  EXPECT_CALL(*listener2, onDestroy());
+  handler_.reset();
+  handler2.reset();
+}
+
 TEST_F(ConnectionHandlerTest, CloseDuringFilterChainCreate) {
   InSequence s;
 
@@ -147,6 +308,118 @@ TEST_F(ConnectionHandlerTest, CloseConnectionOnEmptyFilterChain) {
   EXPECT_CALL(*listener, onDestroy());
 }
 
+TEST_F(ConnectionHandlerTest, OverloadActions) {
+  Network::MockListener* listener = new NiceMock<Network::MockListener>();
+  Network::ListenerCallbacks* listener_callbacks;
+  EXPECT_CALL(dispatcher_, createListener_(_, _, _, _, _))
+      .WillOnce(Invoke([&](Network::ConnectionHandler&, Network::ListenSocket&,
+                           Network::ListenerCallbacks& cb, Stats::Scope&,
+                           const Network::ListenerOptions&) -> Network::Listener* {
+        listener_callbacks = &cb;
+        return listener;
+      }));
+  handler_->addListener(factory_, socket_, stats_store_, 1,
+                        Network::ListenerOptions::listenerOptionsWithBindToPort());
+
+  EXPECT_CALL(*listener, disable());
+  handler_->disableListeners();
+  EXPECT_CALL(*listener, enable());
+  handler_->enableListeners();
+
+  // A listener added while the listeners are disabled starts disabled.
+  handler_->disableListeners();
+  Network::MockListener* listener2 = new NiceMock<Network::MockListener>();
+  EXPECT_CALL(dispatcher_, createListener_(_, _, _, _, _)).WillOnce(Return(listener2));
+  EXPECT_CALL(*listener2, disable());
+  handler_->addListener(factory_, socket_, stats_store_, 2,
+                        Network::ListenerOptions::listenerOptionsWithBindToPort());
+  handler_->enableListeners();
+
+  // The cap shrinks the buffer limits of new connections, but never raises them.
+  static_cast<ConnectionHandlerImpl*>(handler_.get())->setBufferLimitCap(1024);
+  Network::MockConnection* connection = new NiceMock<Network::MockConnection>();
+  ON_CALL(*connection, bufferLimit()).WillByDefault(Return(32768));
+  EXPECT_CALL(*connection, setBufferLimits(1024));
+  EXPECT_CALL(factory_, createFilterChain(_)).WillOnce(Return(true));
+  listener_callbacks->onNewConnection(Network::ConnectionPtr{connection});
+
+  Network::MockConnection* connection2 = new NiceMock<Network::MockConnection>();
+  ON_CALL(*connection2, bufferLimit()).WillByDefault(Return(512));
+  EXPECT_CALL(*connection2, setBufferLimits(_)).Times(0);
+  EXPECT_CALL(factory_, createFilterChain(_)).WillOnce(Return(true));
+  listener_callbacks->onNewConnection(Network::ConnectionPtr{connection2});
+
+  EXPECT_CALL(*listener, onDestroy());
+  EXPECT_CALL(*listener2, onDestroy());
+}
+
+// A listener stops accepting while its connection limit is reached, and resumes once a connection
+// is destroyed.
+TEST_F(ConnectionHandlerTest, ConnectionLimit) {
+  Network::MockListener* listener = new NiceMock<Network::MockListener>();
+  Network::ListenerCallbacks* listener_callbacks;
+  EXPECT_CALL(dispatcher_, createListener_(_, _, _, _, _))
+      .WillOnce(Invoke([&](Network::ConnectionHandler&, Network::ListenSocket&,
+                           Network::ListenerCallbacks& cb, Stats::Scope&,
+                           const Network::ListenerOptions&) -> Network::Listener* {
+        listener_callbacks = &cb;
+        return listener;
+      }));
+  Network::ListenerOptions listener_options =
+      Network::ListenerOptions::listenerOptionsWithBindToPort();
+  listener_options.connection_limit_ = std::make_shared<ConnectionLimitImpl>(1);
+  handler_->addListener(factory_, socket_, stats_store_, 1, listener_options);
+
+  EXPECT_TRUE(listener_callbacks->canAccept());
+  Network::MockConnection* connection = new NiceMock<Network::MockConnection>();
+  EXPECT_CALL(factory_, createFilterChain(_)).WillOnce(Return(true));
+  listener_callbacks->onNewConnection(Network::ConnectionPtr{connection});
+
+  // Paused by the limit, and then disabled by an overload action, which does not resume it.
+  EXPECT_CALL(*listener, disable()).Times(2);
+  EXPECT_FALSE(listener_callbacks->canAccept());
+  EXPECT_EQ(1U, stats_store_.counter("downstream_cx_overflow").value());
+  handler_->disableListeners();
+  EXPECT_CALL(*listener, enable()).Times(0);
+  handler_->enableListeners();
+  testing::Mock::VerifyAndClearExpectations(listener);
+
+  connection->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_CALL(*listener, enable());
+  dispatcher_.clearDeferredDeleteList();
+  EXPECT_TRUE(listener_callbacks->canAccept());
+
+  EXPECT_CALL(*listener, onDestroy());
+}
+
+TEST(ConnectionLimitImplTest, PauseAndResume) {
+  ConnectionLimitImpl limit(2);
+  uint32_t resumed = 0;
+  std::function<void()> resume_cb = [&resumed]() -> void { resumed++; };
+  int worker1;
+  int worker2;
+
+  limit.acquire();
+  EXPECT_FALSE(limit.pause(&worker1, resume_cb));
+  limit.acquire();
+  EXPECT_TRUE(limit.pause(&worker1, resume_cb));
+  EXPECT_TRUE(limit.pause(&worker2, resume_cb));
+  limit.cancelPause(&worker2);
+
+  // The limit is soft, and the workers are resumed once the listener is below it.
+  limit.acquire();
+  limit.release();
+  EXPECT_EQ(0U, resumed);
+  limit.release();
+  EXPECT_EQ(1U, resumed);
+
+  // Resumed workers are only resumed once.
+  limit.acquire();
+  limit.release();
+  limit.release();
+  EXPECT_EQ(1U, resumed);
+}
+
 TEST_F(ConnectionHandlerTest, FindListenerByAddress) {
   Network::Address::InstanceConstSharedPtr alt_address(
       new Network::Address::Ipv4Instance("127.0.0.1", 10001));
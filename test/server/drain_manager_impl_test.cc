@@ -2,6 +2,7 @@
 
 #include "server/drain_manager_impl.h"
 
+#include "test/mocks/common.h"
 #include "test/mocks/server/mocks.h"
 
 #include "gmock/gmock.h"
@@ -21,7 +22,8 @@ TEST(DrainManagerImplTest, All) {
   NiceMock<MockInstance> server;
   ON_CALL(server.options_, drainTime()).WillByDefault(Return(std::chrono::seconds(600)));
   ON_CALL(server.options_, parentShutdownTime()).WillByDefault(Return(std::chrono::seconds(900)));
-  DrainManagerImpl drain_manager(server);
+  NiceMock<MockMonotonicTimeSource> time_source;
+  DrainManagerImpl drain_manager(server, time_source);
 
   // Test parent shutdown.
   Event::MockTimer* shutdown_timer = new Event::MockTimer(&server.dispatcher_);
@@ -57,5 +59,47 @@ TEST(DrainManagerImplTest, All) {
   EXPECT_TRUE(drain_manager.drainClose());
 }
 
+// With a close rate, drain closes are spaced by the second divided by the rate of all workers.
+TEST(DrainManagerImplTest, CloseRate) {
+  NiceMock<MockInstance> server;
+  ON_CALL(server.options_, drainTime()).WillByDefault(Return(std::chrono::seconds(2)));
+  ON_CALL(server.options_, drainCloseRate()).WillByDefault(Return(10));
+  ON_CALL(server.options_, concurrency()).WillByDefault(Return(2));
+  ON_CALL(server.random_, random()).WillByDefault(Return(0));
+  NiceMock<MockMonotonicTimeSource> time_source;
+  DrainManagerImpl drain_manager(server, time_source);
+
+  Event::MockTimer* drain_timer = new Event::MockTimer(&server.dispatcher_);
+  EXPECT_CALL(*drain_timer, enableTimer(_));
+  ReadyWatcher drain_complete;
+  drain_manager.startDrainSequence([&drain_complete]() -> void { drain_complete.ready(); });
+  EXPECT_EQ(1U, server.stats_store_.gauge("server.drain.sequences_active").value());
+
+  const MonotonicTime start = MonotonicTime() + std::chrono::seconds(1);
+  EXPECT_CALL(time_source, currentTime()).WillRepeatedly(Return(start));
+  EXPECT_TRUE(drain_manager.drainClose());
+  EXPECT_FALSE(drain_manager.drainClose());
+
+  EXPECT_CALL(time_source, currentTime())
+      .WillRepeatedly(Return(start + std::chrono::milliseconds(49)));
+  EXPECT_FALSE(drain_manager.drainClose());
+
+  EXPECT_CALL(time_source, currentTime())
+      .WillRepeatedly(Return(start + std::chrono::milliseconds(50)));
+  EXPECT_TRUE(drain_manager.drainClose());
+
+  // Closes that were not asked for in their time are not saved up.
+  EXPECT_CALL(time_source, currentTime()).WillRepeatedly(Return(start + std::chrono::seconds(1)));
+  EXPECT_TRUE(drain_manager.drainClose());
+  EXPECT_FALSE(drain_manager.drainClose());
+
+  EXPECT_EQ(3U, server.stats_store_.counter("server.drain.close").value());
+  EXPECT_EQ(3U, server.stats_store_.counter("server.drain.close_rate_limited").value());
+
+  EXPECT_CALL(drain_complete, ready());
+  drain_timer->callback_();
+  EXPECT_EQ(0U, server.stats_store_.gauge("server.drain.sequences_active").value());
+}
+
 } // namespace Server
 } // namespace Envoy
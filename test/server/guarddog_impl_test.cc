@@ -1,9 +1,11 @@
 #include <atomic>
 #include <chrono>
 #include <memory>
+#include <string>
 
 #include "envoy/common/time.h"
 
+#include "common/common/thread.h"
 #include "common/common/utility.h"
 #include "common/stats/stats_impl.h"
 
@@ -16,6 +18,7 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+using testing::HasSubstr;
 using testing::InSequence;
 using testing::NiceMock;
 
@@ -230,6 +233,33 @@ TEST_F(GuardDogMissTest, MissCountTest) {
   sometimes_pet_dog = nullptr;
 }
 
+#ifdef __linux__
+TEST_F(GuardDogMissTest, SampleStacksTest) {
+  // The test thread is watched, so it is sampled while it waits for the guard dog to check.
+  const int32_t thread_id = Thread::Thread::currentThreadId();
+  GuardDogImpl gd(stats_store_, config_miss_, time_source_, true);
+  auto unpet_dog = gd.createWatchDog(thread_id);
+  EXPECT_EQ("", gd.stallSites());
+  mock_time_ += 501;
+  gd.forceCheckForTest();
+  EXPECT_EQ(1UL, stats_store_.counter("server.watchdog_stack_samples").value());
+  EXPECT_EQ(1UL, stats_store_.gauge("server.watchdog_stall_sites").value());
+  EXPECT_THAT(gd.stallSites(),
+              HasSubstr("1 samples, last on thread " + std::to_string(thread_id) + ":"));
+  // A thread is only sampled once per miss.
+  gd.forceCheckForTest();
+  EXPECT_EQ(1UL, stats_store_.counter("server.watchdog_stack_samples").value());
+  // It is sampled again when it misses again after a touch.
+  unpet_dog->touch();
+  mock_time_ += 501;
+  gd.forceCheckForTest();
+  EXPECT_EQ(2UL, stats_store_.counter("server.watchdog_stack_samples").value());
+  EXPECT_EQ(2UL, stats_store_.counter("server.watchdog_miss").value());
+  gd.stopWatching(unpet_dog);
+  unpet_dog = nullptr;
+}
+#endif
+
 TEST(GuardDogBasicTest, StartStopTest) {
   NiceMock<Stats::MockStore> stats;
   NiceMock<Configuration::MockMain> config(0, 0, 0, 0);
@@ -0,0 +1,288 @@
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/common/thread.h"
+#include "common/network/address_impl.h"
+
+#include "server/hot_restart_impl.h"
+
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/network/mocks.h"
+#include "test/mocks/server/mocks.h"
+
+#include "fmt/format.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::DoAll;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+using testing::ReturnRef;
+using testing::SaveArg;
+using testing::_;
+
+namespace Envoy {
+namespace Server {
+
+class HotRestartImplTest : public testing::Test {
+public:
+  HotRestartImplTest() : base_id_(nextBaseId()) {}
+
+  ~HotRestartImplTest() {
+    shm_unlink(fmt::format("/envoy_shared_memory_{}", base_id_).c_str());
+    for (int fd : socket_fds_) {
+      ::close(fd);
+    }
+  }
+
+  // Processes of different tests must not share their shared memory or domain sockets, which are
+  // named after the base id and the restart epoch.
+  static uint64_t nextBaseId() {
+    static uint32_t num_tests = 0;
+    return static_cast<uint64_t>(getpid()) * 100 + 10 * num_tests++;
+  }
+
+  std::unique_ptr<HotRestartImpl> createHotRestart(uint64_t restart_epoch) {
+    options_.emplace_back(new NiceMock<MockOptions>());
+    ON_CALL(*options_.back(), baseId()).WillByDefault(Return(base_id_));
+    ON_CALL(*options_.back(), restartEpoch()).WillByDefault(Return(restart_epoch));
+    ON_CALL(*options_.back(), concurrency()).WillByDefault(Return(concurrency_));
+    return std::unique_ptr<HotRestartImpl>(new HotRestartImpl(*options_.back()));
+  }
+
+  // Create a parent, whose socket events are served by runParent(), and its child.
+  void createParentAndChild() {
+    parent_ = createHotRestart(0);
+    EXPECT_CALL(dispatcher_, createFileEvent_(_, _, _, _))
+        .WillOnce(DoAll(SaveArg<1>(&parent_socket_cb_),
+                        Return(new NiceMock<Event::MockFileEvent>())));
+    parent_->initialize(dispatcher_, server_);
+    // A child can only start once its parent has initialized.
+    parent_->drainParentListeners();
+    child_ = createHotRestart(1);
+  }
+
+  // Give the parent listeners on consecutive ports. Each worker has a socket of its own, unless
+  // the workers share the socket of worker 0.
+  void addListeners(uint32_t num_listeners, bool share_worker_sockets = false) {
+    for (uint32_t i = 0; i < num_listeners; i++) {
+      listeners_.emplace_back(new NiceMock<MockListener>());
+      MockListener& listener = *listeners_.back();
+      listener.socket_.local_address_.reset(
+          new Network::Address::Ipv4Instance("127.0.0.1", 10000 + i));
+      ON_CALL(listener.socket_, localAddress())
+          .WillByDefault(Return(listener.socket_.local_address_));
+
+      std::vector<int> fds;
+      for (uint32_t worker_index = 0; worker_index < concurrency_; worker_index++) {
+        Network::MockListenSocket* socket = &listener.socket_;
+        if (worker_index > 0 && share_worker_sockets) {
+          fds.push_back(fds[0]);
+        } else {
+          if (worker_index > 0) {
+            worker_sockets_.emplace_back(new NiceMock<Network::MockListenSocket>());
+            socket = worker_sockets_.back().get();
+          }
+          socket_fds_.push_back(::socket(AF_UNIX, SOCK_DGRAM, 0));
+          fds.push_back(socket_fds_.back());
+          ON_CALL(*socket, fd()).WillByDefault(Return(fds.back()));
+        }
+        ON_CALL(listener, workerSocket(worker_index)).WillByDefault(ReturnRef(*socket));
+      }
+
+      listener_fds_.push_back(fds);
+      listener_refs_.emplace_back(listener);
+    }
+    ON_CALL(server_.listener_manager_, listeners()).WillByDefault(Invoke([this]() {
+      return listener_refs_;
+    }));
+  }
+
+  // The child blocks until the parent replies, so the parent serves its socket on a thread of its
+  // own, as its event loop would.
+  void runParent(std::function<void()> child_routine) {
+    std::atomic<bool> done{false};
+    Thread::Thread parent([this, &done]() -> void {
+      while (!done) {
+        parent_socket_cb_(Event::FileReadyType::Read);
+      }
+    });
+    child_routine();
+    done = true;
+    parent.join();
+  }
+
+  std::string listenerUrl(uint32_t listener) {
+    return fmt::format("tcp://127.0.0.1:{}", 10000 + listener);
+  }
+
+  // Duplicates of a socket refer to the same open file.
+  static bool sameSocket(int fd1, int fd2) {
+    struct stat stat1, stat2;
+    EXPECT_EQ(0, fstat(fd1, &stat1));
+    EXPECT_EQ(0, fstat(fd2, &stat2));
+    return stat1.st_dev == stat2.st_dev && stat1.st_ino == stat2.st_ino;
+  }
+
+  // Check that the child gets a duplicate of the socket of a listener and worker of the parent.
+  void expectParentSocket(uint32_t listener, uint32_t worker_index, int expected_fd) {
+    const int fd = child_->duplicateParentListenSocket(listenerUrl(listener), worker_index);
+    ASSERT_NE(-1, fd);
+    EXPECT_NE(expected_fd, fd);
+    EXPECT_TRUE(sameSocket(expected_fd, fd));
+    ::close(fd);
+  }
+
+  static uint32_t numOpenFds() {
+    uint32_t num_fds = 0;
+    DIR* dir = opendir("/proc/self/fd");
+    while (readdir(dir) != nullptr) {
+      num_fds++;
+    }
+    closedir(dir);
+    return num_fds;
+  }
+
+  // Bind the domain socket of a parent that is not a HotRestartImpl, for the given restart epoch.
+  int bindFakeParent(uint64_t restart_epoch) { return child_->bindDomainSocket(restart_epoch); }
+
+  // Queue the replies of a parent that only knows the RPC for a single socket: an
+  // UnknownRequestReply to the batched request, and then the socket.
+  void queueOldParentReplies(HotRestartImpl& sender, uint64_t child_epoch, int fd) {
+    sockaddr_un child_address = sender.createDomainSocketAddress(child_epoch);
+    HotRestartImpl::RpcBase unknown_reply(HotRestartImpl::RpcMessageType::UnknownRequestReply);
+    sender.sendMessage(child_address, unknown_reply);
+    HotRestartImpl::RpcGetListenSocketReply socket_reply;
+    socket_reply.fd_ = fd;
+    sender.sendMessage(child_address, socket_reply, {fd});
+  }
+
+  // Check that the fake parent was asked for all the sockets in a batch, and then for the socket
+  // of the given address and worker on its own.
+  void expectOldParentRequests(int fake_parent, const std::string& address,
+                               uint32_t worker_index) {
+    std::array<uint8_t, sizeof(HotRestartImpl::RpcGetListenSocketsReply)> buffer;
+    ssize_t rc = recv(fake_parent, buffer.data(), buffer.size(), MSG_DONTWAIT);
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(HotRestartImpl::RpcGetListenSocketsRequest)), rc);
+    auto* batch_request = reinterpret_cast<HotRestartImpl::RpcGetListenSocketsRequest*>(&buffer[0]);
+    // The fields are packed, so they are copied out before they are compared.
+    HotRestartImpl::RpcMessageType type = batch_request->type_;
+    const uint32_t start_index = batch_request->start_index_;
+    EXPECT_EQ(HotRestartImpl::RpcMessageType::GetListenSocketsRequest, type);
+    EXPECT_EQ(0, start_index);
+
+    rc = recv(fake_parent, buffer.data(), buffer.size(), MSG_DONTWAIT);
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(HotRestartImpl::RpcGetListenSocketRequest)), rc);
+    auto* request = reinterpret_cast<HotRestartImpl::RpcGetListenSocketRequest*>(&buffer[0]);
+    type = request->type_;
+    const uint32_t request_worker_index = request->worker_index_;
+    EXPECT_EQ(HotRestartImpl::RpcMessageType::GetListenSocketRequest, type);
+    EXPECT_EQ(address, std::string(request->address_));
+    EXPECT_EQ(worker_index, request_worker_index);
+  }
+
+  static const uint32_t MAX_SOCKETS_PER_REPLY = HotRestartImpl::MAX_SOCKETS_PER_REPLY;
+
+  const uint64_t base_id_;
+  uint32_t concurrency_{2};
+  std::vector<std::unique_ptr<NiceMock<MockOptions>>> options_;
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  NiceMock<MockInstance> server_;
+  Event::FileReadyCb parent_socket_cb_;
+  std::unique_ptr<HotRestartImpl> parent_;
+  std::unique_ptr<HotRestartImpl> child_;
+  std::vector<std::unique_ptr<NiceMock<MockListener>>> listeners_;
+  std::vector<std::unique_ptr<NiceMock<Network::MockListenSocket>>> worker_sockets_;
+  std::vector<std::reference_wrapper<Listener>> listener_refs_;
+  // The fds of the sockets of each listener, by worker.
+  std::vector<std::vector<int>> listener_fds_;
+  std::vector<int> socket_fds_;
+};
+
+// More sockets than fit in a reply take a batch per reply, and are then all handed out from the
+// child's cache.
+TEST_F(HotRestartImplTest, ListenSocketsSpanReplies) {
+  createParentAndChild();
+  addListeners(40);
+  EXPECT_CALL(server_.listener_manager_, listeners()).Times(2);
+
+  runParent([this]() -> void { expectParentSocket(0, 0, listener_fds_[0][0]); });
+  for (uint32_t listener = 0; listener < 40; listener++) {
+    for (uint32_t worker_index = 0; worker_index < concurrency_; worker_index++) {
+      expectParentSocket(listener, worker_index, listener_fds_[listener][worker_index]);
+    }
+  }
+}
+
+// Exactly as many sockets as fit in a reply take a single reply.
+TEST_F(HotRestartImplTest, ListenSocketsFillOneReply) {
+  createParentAndChild();
+  addListeners(MAX_SOCKETS_PER_REPLY / 2);
+  EXPECT_CALL(server_.listener_manager_, listeners()).Times(1);
+
+  const uint32_t last = MAX_SOCKETS_PER_REPLY / 2 - 1;
+  runParent([this, last]() -> void { expectParentSocket(last, 1, listener_fds_[last][1]); });
+  for (uint32_t listener = 0; listener <= last; listener++) {
+    for (uint32_t worker_index = 0; worker_index < concurrency_; worker_index++) {
+      expectParentSocket(listener, worker_index, listener_fds_[listener][worker_index]);
+    }
+  }
+}
+
+// A worker that the parent has no socket of its own for gets the socket of worker 0.
+TEST_F(HotRestartImplTest, MissingWorkerFallsBackToWorkerZero) {
+  createParentAndChild();
+  addListeners(1, true);
+
+  runParent([this]() -> void { expectParentSocket(0, 1, listener_fds_[0][0]); });
+  expectParentSocket(0, 0, listener_fds_[0][0]);
+  expectParentSocket(0, 5, listener_fds_[0][0]);
+  EXPECT_EQ(-1, child_->duplicateParentListenSocket(listenerUrl(1), 0));
+}
+
+// A parent that does not know the batched RPC is asked for each socket on its own.
+TEST_F(HotRestartImplTest, OldParentAnswersUnknownRequest) {
+  std::unique_ptr<HotRestartImpl> first = createHotRestart(0);
+  first->drainParentListeners();
+  child_ = createHotRestart(2);
+  const int fake_parent = bindFakeParent(1);
+  socket_fds_.push_back(fake_parent);
+  socket_fds_.push_back(::socket(AF_UNIX, SOCK_DGRAM, 0));
+  const int parent_fd = socket_fds_.back();
+
+  queueOldParentReplies(*first, 2, parent_fd);
+  const int fd = child_->duplicateParentListenSocket(listenerUrl(0), 1);
+  ASSERT_NE(-1, fd);
+  EXPECT_TRUE(sameSocket(parent_fd, fd));
+  ::close(fd);
+  expectOldParentRequests(fake_parent, listenerUrl(0), 1);
+}
+
+// Draining the parent closes the cached sockets, and later sockets are asked for one at a time.
+TEST_F(HotRestartImplTest, DrainClosesCachedListenSockets) {
+  createParentAndChild();
+  addListeners(2);
+
+  runParent([this]() -> void { expectParentSocket(0, 0, listener_fds_[0][0]); });
+  const uint32_t num_fds = numOpenFds();
+  child_->drainParentListeners();
+  EXPECT_EQ(num_fds - 2 * concurrency_, numOpenFds());
+
+  EXPECT_CALL(server_, drainListeners());
+  runParent([this]() -> void { expectParentSocket(1, 1, listener_fds_[1][1]); });
+}
+
+} // namespace Server
+} // namespace Envoy
@@ -1,7 +1,13 @@
 #include <fstream>
+#include <list>
+#include <string>
 
 #include "common/http/message_impl.h"
+#include "common/memory/allocation_tracker.h"
 #include "common/profiler/profiler.h"
+#include "common/stats/histogram_impl.h"
+#include "common/stats/tag_extractor_impl.h"
+#include "common/stats/thread_local_store.h"
 
 #include "server/http/admin.h"
 
@@ -14,7 +20,9 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+using testing::Invoke;
 using testing::NiceMock;
+using testing::Throw;
 using testing::_;
 
 namespace Envoy {
@@ -53,6 +61,86 @@ TEST_P(AdminFilterTest, Body) {
   filter_.decodeData(data, true);
 }
 
+TEST_P(AdminFilterTest, StreamStats) {
+  for (size_t i = 0; i < AdminFilter::STATS_PER_BATCH; i++) {
+    server_.stats_store_.counter(fmt::format("test.c{:04}", i)).inc();
+  }
+  request_headers_.insertPath().value(std::string("/stats?prefix=test."));
+
+  // Hold the posts to the main thread, which render the batches.
+  std::list<Event::PostCb> posts;
+  ON_CALL(server_.dispatcher_, post(_)).WillByDefault(Invoke([&posts](Event::PostCb cb) -> void {
+    posts.push_back(cb);
+  }));
+  auto run_post = [&posts]() -> void {
+    ASSERT_EQ(1U, posts.size());
+    Event::PostCb cb = posts.front();
+    posts.pop_front();
+    cb();
+  };
+
+  filter_.decodeHeaders(request_headers_, true);
+  EXPECT_CALL(callbacks_, addDownstreamWatermarkCallbacks(_));
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, false))
+      .WillOnce(Invoke([](Http::HeaderMap& headers, bool) -> void {
+        EXPECT_STREQ("200", headers.Status()->value().c_str());
+        EXPECT_STREQ("text/plain", headers.ContentType()->value().c_str());
+      }));
+  run_post();
+
+  // The next batch waits while the client is not keeping up.
+  filter_.onAboveWriteBufferHighWatermark();
+  EXPECT_CALL(callbacks_, encodeData(_, false)).WillOnce(Invoke([](Buffer::Instance& data, bool) {
+    const std::string body = TestUtility::bufferToString(data);
+    EXPECT_EQ(0U, body.find("test.c0000: 1\n"));
+    EXPECT_NE(std::string::npos, body.find("test.c0999: 1\n"));
+  }));
+  run_post();
+  EXPECT_TRUE(posts.empty());
+  filter_.onBelowWriteBufferLowWatermark();
+
+  EXPECT_CALL(callbacks_, removeDownstreamWatermarkCallbacks(_));
+  EXPECT_CALL(callbacks_, encodeData(_, true)).WillOnce(Invoke([](Buffer::Instance& data, bool) {
+    EXPECT_EQ(0U, data.length());
+  }));
+  run_post();
+  filter_.onDestroy();
+}
+
+TEST_P(AdminFilterTest, Clusters) {
+  // No clusters, so the snapshot renders an empty response.
+  request_headers_.insertPath().value(std::string("/clusters"));
+  EXPECT_CALL(server_.cluster_manager_, clusters());
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, true));
+  filter_.decodeHeaders(request_headers_, true);
+}
+
+TEST_P(AdminFilterTest, ResponseAfterDestroy) {
+  std::list<Event::PostCb> posts;
+  ON_CALL(server_.dispatcher_, post(_)).WillByDefault(Invoke([&posts](Event::PostCb cb) -> void {
+    posts.push_back(cb);
+  }));
+
+  // The handler runs on the main thread, but the stream is gone by the time it responds.
+  request_headers_.insertPath().value(std::string("/server_info"));
+  filter_.decodeHeaders(request_headers_, true);
+  filter_.onDestroy();
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, _)).Times(0);
+  ASSERT_EQ(1U, posts.size());
+  posts.front()();
+}
+
+TEST_P(AdminFilterTest, StreamStatsBadQuery) {
+  request_headers_.insertPath().value(std::string("/stats?filter=("));
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, false))
+      .WillOnce(Invoke([](Http::HeaderMap& headers, bool) -> void {
+        EXPECT_STREQ("400", headers.Status()->value().c_str());
+      }));
+  EXPECT_CALL(callbacks_, encodeData(_, true));
+  filter_.decodeHeaders(request_headers_, true);
+  filter_.onDestroy();
+}
+
 TEST_P(AdminFilterTest, Trailers) {
   filter_.decodeHeaders(request_headers_, false);
   Buffer::OwnedImpl data("hello");
@@ -95,6 +183,56 @@ TEST_P(AdminInstanceTest, AdminProfiler) {
 
 #endif
 
+TEST_P(AdminInstanceTest, CpuSampler) {
+  Buffer::OwnedImpl data;
+  EXPECT_EQ(Http::Code::BadRequest, admin_.runCallback("/cpusampler", data));
+  EXPECT_EQ(Http::Code::BadRequest, admin_.runCallback("/cpusampler?enable=x", data));
+  EXPECT_EQ(Http::Code::BadRequest, admin_.runCallback("/cpusampler?enable=y&hz=0", data));
+  EXPECT_EQ(Http::Code::BadRequest, admin_.runCallback("/cpusampler?enable=y&hz=1001", data));
+  EXPECT_EQ(Http::Code::BadRequest, admin_.runCallback("/cpusampler?enable=y&foo=1", data));
+
+#ifdef __linux__
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/cpusampler?enable=y&hz=500", data));
+  EXPECT_TRUE(Profiler::CpuSampler::running());
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/cpusampler?enable=y", data));
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/cpusampler?enable=n", data));
+  EXPECT_FALSE(Profiler::CpuSampler::running());
+  data.drain(data.length());
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/cpusamples", data));
+  EXPECT_LT(0U, data.length());
+#endif
+}
+
+TEST_P(AdminInstanceTest, AllocationTracker) {
+  Buffer::OwnedImpl data;
+  EXPECT_EQ(Http::Code::BadRequest, admin_.runCallback("/allocationtracker", data));
+  EXPECT_EQ(Http::Code::BadRequest, admin_.runCallback("/allocationtracker?enable=x", data));
+  EXPECT_EQ(Http::Code::BadRequest,
+            admin_.runCallback("/allocationtracker?enable=y&foo=1", data));
+
+#ifdef TCMALLOC
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/allocationtracker?enable=y", data));
+  EXPECT_TRUE(Memory::AllocationTracker::enabled());
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/allocationtracker?enable=n", data));
+#else
+  EXPECT_EQ(Http::Code::NotImplemented, admin_.runCallback("/allocationtracker?enable=y", data));
+#endif
+  EXPECT_FALSE(Memory::AllocationTracker::enabled());
+
+  Memory::AllocationTracker::registerThread("test");
+  data.drain(data.length());
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/allocations", data));
+  EXPECT_EQ("tracking: off\ntest: 0 allocations, 0 bytes\n", TestUtility::bufferToString(data));
+  Memory::AllocationTracker::unregisterThread();
+}
+
+#ifndef TCMALLOC
+TEST_P(AdminInstanceTest, HeapProfilerWithoutTcmalloc) {
+  Buffer::OwnedImpl data;
+  EXPECT_EQ(Http::Code::NotImplemented, admin_.runCallback("/heapprofiler", data));
+}
+#endif
+
 TEST_P(AdminInstanceTest, AdminBadProfiler) {
   Buffer::OwnedImpl data;
   AdminImpl admin_bad_profile_path(
@@ -146,5 +284,112 @@ TEST_P(AdminInstanceTest, CustomHandler) {
   EXPECT_EQ(Http::Code::Accepted, admin_.runCallback("/foo/bar", response));
 }
 
+TEST_P(AdminInstanceTest, StatsFilter) {
+  server_.stats_store_.counter("test.b.counter").add(2);
+  server_.stats_store_.gauge("test.a.gauge").set(3);
+  server_.stats_store_.counter("test.c.counter").inc();
+  server_.stats_store_.counter("other.counter").inc();
+
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/stats?prefix=test.", response));
+  EXPECT_EQ("test.a.gauge: 3\ntest.b.counter: 2\ntest.c.counter: 1\n",
+            TestUtility::bufferToString(response));
+
+  response.drain(response.length());
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/stats?filter=\\.counter$", response));
+  EXPECT_EQ("other.counter: 1\ntest.b.counter: 2\ntest.c.counter: 1\n",
+            TestUtility::bufferToString(response));
+
+  response.drain(response.length());
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/stats?prefix=test.&filter=^test.b", response));
+  EXPECT_EQ("test.b.counter: 2\n", TestUtility::bufferToString(response));
+
+  response.drain(response.length());
+  EXPECT_EQ(Http::Code::BadRequest, admin_.runCallback("/stats?filter=[", response));
+  EXPECT_NE(std::string::npos, TestUtility::bufferToString(response).find("missing ]"));
+  // Back references cannot be matched in linear time and are rejected.
+  response.drain(response.length());
+  EXPECT_EQ(Http::Code::BadRequest, admin_.runCallback("/stats?filter=(a)\\1", response));
+  response.drain(response.length());
+  EXPECT_EQ(Http::Code::BadRequest, admin_.runCallback("/stats?unknown=1", response));
+}
+
+TEST_P(AdminInstanceTest, StatsPrometheus) {
+  server_.stats_store_.counter("test.upstream_rq-200").add(2);
+  server_.stats_store_.gauge("test.active").set(3);
+  Stats::HistogramImpl& histogram =
+      dynamic_cast<Stats::HistogramImpl&>(server_.stats_store_.histogram("test.time"));
+  histogram.recordValue(1);
+  histogram.recordValue(100);
+  histogram.merge();
+
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/stats?format=prometheus&prefix=test.", response));
+  const std::string body = TestUtility::bufferToString(response);
+  EXPECT_EQ(0U, body.find("# TYPE envoy_test_active gauge\nenvoy_test_active 3\n"
+                          "# TYPE envoy_test_upstream_rq_200 counter\n"
+                          "envoy_test_upstream_rq_200 2\n"
+                          "# TYPE envoy_test_time histogram\n"));
+  EXPECT_NE(std::string::npos, body.find("envoy_test_time_bucket{le=\"0.5\"} 0\n"));
+  EXPECT_NE(std::string::npos, body.find("envoy_test_time_bucket{le=\"5\"} 1\n"));
+  EXPECT_NE(std::string::npos, body.find("envoy_test_time_bucket{le=\"100\"} 2\n"));
+  EXPECT_NE(std::string::npos, body.find("envoy_test_time_bucket{le=\"+Inf\"} 2\n"
+                                         "envoy_test_time_sum 101\nenvoy_test_time_count 2\n"));
+}
+
+TEST(StatsRendererTest, PrometheusTags) {
+  Stats::HeapRawStatDataAllocator alloc;
+  Stats::ThreadLocalStoreImpl store(alloc);
+  store.setTagExtractors(Stats::TagExtractorImpl::createTagExtractors({}));
+  store.counter("cluster.foo.upstream_rq_200").add(2);
+  store.counter("cluster.bar.upstream_rq_503").add(1);
+  store.counter("cluster.bar.upstream_cx_total").add(3);
+  store.gauge("cluster.foo.upstream_cx_active").set(4);
+
+  StatsRenderer renderer(
+      store, StatsRenderer::Format::Prometheus,
+      [](const std::string& name) -> bool { return name.find("cluster.") == 0; });
+  Buffer::OwnedImpl response;
+  EXPECT_TRUE(renderer.nextBatch(response, 100));
+  EXPECT_EQ("# TYPE envoy_cluster_upstream_cx_active gauge\n"
+            "envoy_cluster_upstream_cx_active{envoy_cluster_name=\"foo\"} 4\n"
+            "# TYPE envoy_cluster_upstream_cx_total counter\n"
+            "envoy_cluster_upstream_cx_total{envoy_cluster_name=\"bar\"} 3\n"
+            "# TYPE envoy_cluster_upstream_rq counter\n"
+            "envoy_cluster_upstream_rq{envoy_cluster_name=\"bar\",envoy_response_code=\"503\"} 1\n"
+            "envoy_cluster_upstream_rq{envoy_cluster_name=\"foo\",envoy_response_code=\"200\"} 2\n",
+            TestUtility::bufferToString(response));
+
+  store.shutdownThreading();
+}
+
+TEST(StatsRendererTest, PrometheusLabels) {
+  EXPECT_EQ("", StatsRenderer::prometheusLabels({}));
+  EXPECT_EQ("envoy_cluster_name=\"foo\",a_b=\"\\\"x\\\\\\n\"",
+            StatsRenderer::prometheusLabels({{"envoy.cluster_name", "foo"}, {"a-b", "\"x\\\n"}}));
+}
+
+TEST_P(AdminInstanceTest, RuntimeModify) {
+  std::unordered_map<std::string, std::string> values{{"foo", "bar"}, {"baz", ""}};
+  EXPECT_CALL(server_.runtime_loader_, mergeValues(values));
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/runtime_modify?foo=bar&baz=", response));
+  EXPECT_EQ("OK\n", TestUtility::bufferToString(response));
+}
+
+TEST_P(AdminInstanceTest, RuntimeModifyNoParams) {
+  EXPECT_CALL(server_.runtime_loader_, mergeValues(_)).Times(0);
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::BadRequest, admin_.runCallback("/runtime_modify", response));
+}
+
+TEST_P(AdminInstanceTest, RuntimeModifyNotSupported) {
+  EXPECT_CALL(server_.runtime_loader_, mergeValues(_))
+      .WillOnce(Throw(EnvoyException("not configured")));
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::ServiceUnavailable, admin_.runCallback("/runtime_modify?foo=", response));
+  EXPECT_EQ("not configured\n", TestUtility::bufferToString(response));
+}
+
 } // namespace Server
 } // namespace Envoy
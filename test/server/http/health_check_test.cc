@@ -107,6 +107,44 @@ TEST_F(HealthCheckFilterNoPassThroughTest, HealthCheckFailedCallbackCalled) {
   EXPECT_EQ(Http::FilterTrailersStatus::StopIteration, filter_->decodeTrailers(request_headers_));
 }
 
+TEST_F(HealthCheckFilterNoPassThroughTest, ClusterMinHealthyPercentages) {
+  std::shared_ptr<std::list<ClusterMinHealthyPercentage>> percentages =
+      std::make_shared<std::list<ClusterMinHealthyPercentage>>();
+  percentages->emplace_back("www1", 50);
+  percentages->emplace_back("www2", 0);
+  filter_.reset(new HealthCheckFilter(context_, false, nullptr, "/healthcheck", percentages));
+  filter_->setDecoderFilterCallbacks(callbacks_);
+
+  // Both of the clusters are the mock cluster, whose membership gauges are set below.
+  Upstream::ClusterStats& stats =
+      context_.cluster_manager_.thread_local_cluster_.cluster_.info_->stats_;
+  stats.membership_total_.set(4);
+  stats.membership_healthy_.set(2);
+  Http::TestHeaderMapImpl ok_response{{":status", "200"}};
+  EXPECT_CALL(callbacks_, encodeHeaders_(HeaderMapEqualRef(&ok_response), true));
+  EXPECT_CALL(callbacks_.request_info_, setResponseFlag(_)).Times(0);
+  filter_->decodeHeaders(request_headers_, true);
+
+  filter_.reset(new HealthCheckFilter(context_, false, nullptr, "/healthcheck", percentages));
+  filter_->setDecoderFilterCallbacks(callbacks_);
+  stats.membership_healthy_.set(1);
+  Http::TestHeaderMapImpl unavailable_response{{":status", "503"}};
+  EXPECT_CALL(callbacks_, encodeHeaders_(HeaderMapEqualRef(&unavailable_response), true));
+  EXPECT_CALL(callbacks_.request_info_,
+              setResponseFlag(Http::AccessLog::ResponseFlag::FailedLocalHealthCheck));
+  filter_->decodeHeaders(request_headers_, true);
+
+  // A missing cluster fails the health check whatever its minimum.
+  filter_.reset(new HealthCheckFilter(context_, false, nullptr, "/healthcheck", percentages));
+  filter_->setDecoderFilterCallbacks(callbacks_);
+  stats.membership_healthy_.set(4);
+  EXPECT_CALL(context_.cluster_manager_, get("www2")).WillRepeatedly(Return(nullptr));
+  EXPECT_CALL(callbacks_, encodeHeaders_(HeaderMapEqualRef(&unavailable_response), true));
+  EXPECT_CALL(callbacks_.request_info_,
+              setResponseFlag(Http::AccessLog::ResponseFlag::FailedLocalHealthCheck));
+  filter_->decodeHeaders(request_headers_, true);
+}
+
 TEST_F(HealthCheckFilterPassThroughTest, Ok) {
   EXPECT_CALL(context_, healthCheckFailed()).WillOnce(Return(false));
   EXPECT_CALL(callbacks_.request_info_, healthCheck(true));
@@ -226,4 +264,15 @@ TEST(HealthCheckFilterConfig, notFailingWhenNotPassThroughAndTimeoutNotSet) {
 
   healthCheckFilterConfig.createFilterFactory(*config, "dummy_stats_prefix", context);
 }
+
+TEST(HealthCheckFilterConfig, failsWhenPassThroughAndClusterMinHealthyPercentagesSet) {
+  Server::Configuration::HealthCheckFilterConfig healthCheckFilterConfig;
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(
+      "{\"pass_through_mode\":true, \"endpoint\":\"foo\", "
+      "\"cluster_min_healthy_percentages\":{\"www1\":50}}");
+  NiceMock<Server::Configuration::MockFactoryContext> context;
+
+  EXPECT_THROW(healthCheckFilterConfig.createFilterFactory(*config, "dummy_stats_prefix", context),
+               EnvoyException);
+}
 } // namespace Envoy
@@ -1,3 +1,6 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include "envoy/registry/registry.h"
 
 #include "common/network/address_impl.h"
@@ -143,6 +146,34 @@ TEST_F(ListenerManagerImplWithRealFiltersTest, SetListenerPerConnectionBufferLim
   EXPECT_EQ(8192U, manager_->listeners().back().get().perConnectionBufferLimitBytes());
 }
 
+TEST_F(ListenerManagerImplWithRealFiltersTest, ConnectionLimit) {
+  const std::string json = R"EOF(
+  {
+    "name": "foo",
+    "address": "tcp://127.0.0.1:1234",
+    "filters": []
+  }
+  )EOF";
+
+  EXPECT_CALL(listener_factory_, createListenSocket(_, true));
+  manager_->addOrUpdateListener(parseListenerFromJson(json));
+  EXPECT_EQ(nullptr, manager_->listeners().back().get().connectionLimit());
+
+  // The limit is read from runtime when the listener is created.
+  ON_CALL(server_.runtime_loader_.snapshot_, getInteger("listener.foo.max_connections", 0))
+      .WillByDefault(Return(100));
+  const std::string json_update = R"EOF(
+  {
+    "name": "foo",
+    "address": "tcp://127.0.0.1:1234",
+    "filters": [],
+    "per_connection_buffer_limit_bytes": 8192
+  }
+  )EOF";
+  manager_->addOrUpdateListener(parseListenerFromJson(json_update));
+  EXPECT_NE(nullptr, manager_->listeners().back().get().connectionLimit());
+}
+
 TEST_F(ListenerManagerImplWithRealFiltersTest, SslContext) {
   const std::string json = TestEnvironment::substitute(R"EOF(
   {
@@ -335,9 +366,12 @@ TEST_F(ListenerManagerImplTest, AddOrUpdateListener) {
   checkStats(1, 1, 0, 0, 1, 0);
 
   // Update foo. Should go into warming, have an immediate warming callback, and start immediate
-  // removal.
+  // removal, since in place filter chain updates are turned off in runtime.
   ListenerHandle* listener_foo_update2 = expectListenerCreate(false);
   EXPECT_CALL(*worker_, addListener(_, _));
+  EXPECT_CALL(server_.runtime_loader_.snapshot_,
+              getInteger("listener_manager.drain_on_filter_chain_update", 0))
+      .WillOnce(Return(1));
   EXPECT_CALL(*worker_, stopListener(_));
   EXPECT_CALL(*listener_foo_update1->drain_manager_, startDrainSequence(_));
   EXPECT_TRUE(manager_->addOrUpdateListener(parseListenerFromJson(listener_foo_json)));
@@ -421,6 +455,126 @@ TEST_F(ListenerManagerImplTest, AddOrUpdateListener) {
   EXPECT_CALL(*listener_baz_update1, onDestroy());
 }
 
+// A listener that only differs in its filter chains replaces the old one without draining it, and
+// the old one is removed once its connections have closed.
+TEST_F(ListenerManagerImplTest, FilterChainOnlyUpdate) {
+  InSequence s;
+
+  EXPECT_CALL(*worker_, start(_));
+  manager_->startWorkers(guard_dog_);
+
+  const std::string listener_foo_json = R"EOF(
+  {
+    "name": "foo",
+    "address": "tcp://127.0.0.1:1234",
+    "filters": []
+  }
+  )EOF";
+
+  ListenerHandle* listener_foo = expectListenerCreate(false);
+  EXPECT_CALL(listener_factory_, createListenSocket(_, true));
+  EXPECT_CALL(*worker_, addListener(_, _));
+  EXPECT_TRUE(manager_->addOrUpdateListener(parseListenerFromJson(listener_foo_json)));
+  worker_->callAddCompletion(true);
+  checkStats(1, 0, 0, 0, 1, 0);
+
+  const std::string listener_foo_update1_json = R"EOF(
+  {
+    "name": "foo",
+    "address": "tcp://127.0.0.1:1234",
+    "filters": [
+      { "type" : "read", "name" : "fake", "config" : {} }
+    ]
+  }
+  )EOF";
+
+  ListenerHandle* listener_foo_update1 = expectListenerCreate(false);
+  EXPECT_CALL(*worker_, addListener(_, _));
+  EXPECT_CALL(*worker_, retireListener(_, _));
+  EXPECT_CALL(*worker_, stopListener(_)).Times(0);
+  EXPECT_CALL(*listener_foo->drain_manager_, startDrainSequence(_)).Times(0);
+  EXPECT_TRUE(manager_->addOrUpdateListener(parseListenerFromJson(listener_foo_update1_json)));
+  worker_->callAddCompletion(true);
+  checkStats(1, 1, 0, 0, 1, 1);
+  EXPECT_EQ(1UL,
+            server_.stats_store_.counter("listener_manager.listener_modified_in_place").value());
+
+  // Connections of the retired listener are not asked to drain.
+  EXPECT_CALL(*listener_foo->drain_manager_, drainClose()).WillOnce(Return(false));
+  EXPECT_CALL(server_.drain_manager_, drainClose()).WillOnce(Return(false));
+  EXPECT_FALSE(listener_foo->context_->drainDecision().drainClose());
+
+  EXPECT_CALL(*listener_foo, onDestroy());
+  worker_->callRetireCompletion();
+  checkStats(1, 1, 0, 0, 1, 0);
+
+  EXPECT_CALL(*listener_foo_update1, onDestroy());
+}
+
+// Removing a listener drains the listeners that it retired, along with itself.
+TEST_F(ListenerManagerImplTest, RemoveListenerDrainsRetiredListener) {
+  InSequence s;
+
+  EXPECT_CALL(*worker_, start(_));
+  manager_->startWorkers(guard_dog_);
+
+  const std::string listener_foo_json = R"EOF(
+  {
+    "name": "foo",
+    "address": "tcp://127.0.0.1:1234",
+    "filters": []
+  }
+  )EOF";
+
+  ListenerHandle* listener_foo = expectListenerCreate(false);
+  EXPECT_CALL(listener_factory_, createListenSocket(_, true));
+  EXPECT_CALL(*worker_, addListener(_, _));
+  EXPECT_TRUE(manager_->addOrUpdateListener(parseListenerFromJson(listener_foo_json)));
+  worker_->callAddCompletion(true);
+
+  const std::string listener_foo_update1_json = R"EOF(
+  {
+    "name": "foo",
+    "address": "tcp://127.0.0.1:1234",
+    "filters": [
+      { "type" : "read", "name" : "fake", "config" : {} }
+    ]
+  }
+  )EOF";
+
+  ListenerHandle* listener_foo_update1 = expectListenerCreate(false);
+  EXPECT_CALL(*worker_, addListener(_, _));
+  EXPECT_CALL(*worker_, retireListener(_, _));
+  EXPECT_TRUE(manager_->addOrUpdateListener(parseListenerFromJson(listener_foo_update1_json)));
+  worker_->callAddCompletion(true);
+
+  EXPECT_CALL(*worker_, stopListener(_));
+  EXPECT_CALL(*listener_foo_update1->drain_manager_, startDrainSequence(_));
+  EXPECT_CALL(*listener_foo->drain_manager_, startDrainSequence(_));
+  EXPECT_TRUE(manager_->removeListener("foo"));
+  checkStats(1, 1, 1, 0, 0, 2);
+
+  // The retired listener is removed by the workers once its drain completes, which is reported by
+  // its retire completion.
+  std::function<void()> removal_completion;
+  EXPECT_CALL(*worker_, removeListener(_, _))
+      .WillOnce(Invoke([&removal_completion](Listener&, std::function<void()> completion) -> void {
+        removal_completion = completion;
+      }));
+  listener_foo->drain_manager_->drain_sequence_completion_();
+  removal_completion();
+  checkStats(1, 1, 1, 0, 0, 2);
+  EXPECT_CALL(*listener_foo, onDestroy());
+  worker_->callRetireCompletion();
+  checkStats(1, 1, 1, 0, 0, 1);
+
+  EXPECT_CALL(*worker_, removeListener(_, _));
+  listener_foo_update1->drain_manager_->drain_sequence_completion_();
+  EXPECT_CALL(*listener_foo_update1, onDestroy());
+  worker_->callRemovalCompletion();
+  checkStats(1, 1, 1, 0, 0, 0);
+}
+
 TEST_F(ListenerManagerImplTest, AddDrainingListener) {
   InSequence s;
 
@@ -492,6 +646,38 @@ TEST_F(ListenerManagerImplTest, CantBindSocket) {
                EnvoyException);
 }
 
+// Socket options from runtime are set on the sockets of a listener when they are created.
+TEST_F(ListenerManagerImplTest, SocketOptions) {
+  const std::string listener_foo_json = R"EOF(
+  {
+    "name": "foo",
+    "address": "tcp://127.0.0.1:1234",
+    "filters": []
+  }
+  )EOF";
+
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_NE(-1, fd);
+  int initial_size;
+  socklen_t length = sizeof(initial_size);
+  ASSERT_EQ(0, getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &initial_size, &length));
+  ON_CALL(*listener_factory_.socket_, fd()).WillByDefault(Return(fd));
+  ON_CALL(server_.runtime_loader_.snapshot_,
+          getInteger("listener.foo.socket.receive_buffer_bytes", 0))
+      .WillByDefault(Return(4096));
+
+  ListenerHandle* listener_foo = expectListenerCreate(false);
+  EXPECT_CALL(listener_factory_, createListenSocket(_, true));
+  EXPECT_TRUE(manager_->addOrUpdateListener(parseListenerFromJson(listener_foo_json)));
+
+  int size;
+  ASSERT_EQ(0, getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, &length));
+  EXPECT_NE(initial_size, size);
+
+  ::close(fd);
+  EXPECT_CALL(*listener_foo, onDestroy());
+}
+
 TEST_F(ListenerManagerImplTest, ListenerDraining) {
   InSequence s;
 
@@ -699,5 +885,70 @@ TEST_F(ListenerManagerImplTest, DuplicateAddressDontBind) {
   EXPECT_CALL(*listener_foo, onDestroy());
 }
 
+TEST_F(ListenerManagerImplTest, ReusePortSocketPerWorker) {
+  ON_CALL(server_.options_, reusePort()).WillByDefault(Return(true));
+  ON_CALL(server_.options_, concurrency()).WillByDefault(Return(2));
+  MockWorker* worker1 = new MockWorker();
+  MockWorker* worker2 = new MockWorker();
+  EXPECT_CALL(worker_factory_, createWorker_()).WillOnce(Return(worker1)).WillOnce(Return(worker2));
+  manager_.reset(new ListenerManagerImpl(server_, listener_factory_, worker_factory_));
+
+  // The first socket picks the port of a listener configured with port zero, and the socket of the
+  // second worker binds to the same port.
+  const std::string listener_foo_json = R"EOF(
+  {
+    "name": "foo",
+    "address": "tcp://127.0.0.1:0",
+    "filters": []
+  }
+  )EOF";
+
+  Network::Address::InstanceConstSharedPtr bound_address(
+      new Network::Address::Ipv4Instance("127.0.0.1", 1234));
+  auto socket1 = std::make_shared<NiceMock<Network::MockListenSocket>>();
+  auto socket2 = std::make_shared<NiceMock<Network::MockListenSocket>>();
+  ON_CALL(*socket1, localAddress()).WillByDefault(Return(bound_address));
+
+  ListenerHandle* listener_foo = expectListenerCreate(false);
+  EXPECT_CALL(listener_factory_, createReusePortListenSocket(_, 0))
+      .WillOnce(Invoke([&socket1](Network::Address::InstanceConstSharedPtr address,
+                                  uint32_t) -> Network::ListenSocketSharedPtr {
+        EXPECT_EQ("127.0.0.1:0", address->asString());
+        return socket1;
+      }));
+  EXPECT_CALL(listener_factory_, createReusePortListenSocket(_, 1))
+      .WillOnce(Invoke([&socket2](Network::Address::InstanceConstSharedPtr address,
+                                  uint32_t) -> Network::ListenSocketSharedPtr {
+        EXPECT_EQ("127.0.0.1:1234", address->asString());
+        return socket2;
+      }));
+  EXPECT_TRUE(manager_->addOrUpdateListener(parseListenerFromJson(listener_foo_json)));
+
+  Listener& listener = manager_->listeners().front().get();
+  EXPECT_EQ(socket1.get(), &listener.socket());
+  EXPECT_EQ(socket1.get(), &listener.workerSocket(0));
+  EXPECT_EQ(socket2.get(), &listener.workerSocket(1));
+
+  // Listeners that do not bind still share a single socket.
+  const std::string listener_bar_json = R"EOF(
+  {
+    "name": "bar",
+    "address": "tcp://127.0.0.1:1235",
+    "filters": [],
+    "bind_to_port": false
+  }
+  )EOF";
+
+  ListenerHandle* listener_bar = expectListenerCreate(false);
+  EXPECT_CALL(listener_factory_, createListenSocket(_, false));
+  EXPECT_TRUE(manager_->addOrUpdateListener(parseListenerFromJson(listener_bar_json)));
+  Listener& listener2 = manager_->listeners().back().get();
+  EXPECT_EQ(&listener2.socket(), &listener2.workerSocket(0));
+  EXPECT_EQ(&listener2.socket(), &listener2.workerSocket(1));
+
+  EXPECT_CALL(*listener_foo, onDestroy());
+  EXPECT_CALL(*listener_bar, onDestroy());
+}
+
 } // namespace Server
 } // namespace Envoy
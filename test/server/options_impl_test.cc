@@ -1,6 +1,7 @@
 #include <chrono>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "common/common/utility.h"
@@ -19,8 +20,8 @@ std::unique_ptr<OptionsImpl> createOptionsImpl(const std::string& args) {
   for (const std::string& s : words) {
     argv.push_back(s.c_str());
   }
-  return std::unique_ptr<OptionsImpl>(
-      new OptionsImpl(argv.size(), const_cast<char**>(&argv[0]), "1", spdlog::level::warn));
+  return std::unique_ptr<OptionsImpl>(new OptionsImpl(
+      argv.size(), const_cast<char**>(&argv[0]), [](uint32_t) { return "1"; }, spdlog::level::warn));
 }
 
 TEST(OptionsImplDeathTest, HotRestartVersion) {
@@ -38,9 +39,17 @@ TEST(OptionsImplDeathTest, InvalidCommandLine) {
 TEST(OptionsImplTest, All) {
   std::unique_ptr<OptionsImpl> options = createOptionsImpl(
       "envoy --mode validate --concurrency 2 -c hello --admin-address-path path --restart-epoch 1 "
-      "--local-address-ip-version v6 -l info --service-cluster cluster --service-node node "
+      "--local-address-ip-version v6 -l info --log-async-buffer-size 1024 "
+      "--service-cluster cluster --service-node node "
       "--service-zone zone --file-flush-interval-msec 9000 --drain-time-s 60 "
-      "--parent-shutdown-time-s 90");
+      "--drain-close-rate 100 --parent-shutdown-time-s 90 --max-stats 20000 "
+      "--connection-read-budget-bytes 1024 --event-backend poll --max-accepts-per-event 16 "
+      "--reuse-port --balance-connections --private-key-threads 4 --worker-cpus 0-2,5 "
+      "--dns-cache-max-ttl-s 300 "
+      "--dns-cache-min-ttl-s 5 --dns-cache-negative-ttl-s 10 --dns-cache-stale-ttl-s 60 "
+      "--overload-max-heap-bytes 1073741824 --overload-max-connections 10000 "
+      "--overload-max-active-streams 20000 --overload-refresh-interval-ms 250 "
+      "--watchdog-sample-stacks --stats-tag shard=(\\.shard_(\\d+))$ --stats-tag a=b=c");
   EXPECT_EQ(Server::Mode::Validate, options->mode());
   EXPECT_EQ(2U, options->concurrency());
   EXPECT_EQ("hello", options->configPath());
@@ -48,25 +57,90 @@ TEST(OptionsImplTest, All) {
   EXPECT_EQ(Network::Address::IpVersion::v6, options->localAddressIpVersion());
   EXPECT_EQ(1U, options->restartEpoch());
   EXPECT_EQ(spdlog::level::info, options->logLevel());
+  EXPECT_EQ(1024U, options->logAsyncBufferSize());
   EXPECT_EQ("cluster", options->serviceClusterName());
   EXPECT_EQ("node", options->serviceNodeName());
   EXPECT_EQ("zone", options->serviceZone());
   EXPECT_EQ(std::chrono::milliseconds(9000), options->fileFlushIntervalMsec());
   EXPECT_EQ(std::chrono::seconds(60), options->drainTime());
+  EXPECT_EQ(100U, options->drainCloseRate());
   EXPECT_EQ(std::chrono::seconds(90), options->parentShutdownTime());
+  EXPECT_EQ(20000U, options->maxStats());
+  EXPECT_EQ(1024U, options->connectionReadBudget());
+  EXPECT_EQ("poll", options->eventBackend());
+  EXPECT_EQ(16U, options->maxAcceptsPerEvent());
+  EXPECT_TRUE(options->reusePort());
+  EXPECT_TRUE(options->balanceConnections());
+  EXPECT_EQ(4U, options->privateKeyThreads());
+  EXPECT_EQ((std::vector<uint32_t>{0, 1, 2, 5}), options->workerCpus());
+  EXPECT_EQ(std::chrono::seconds(300), options->dnsCacheConfig().max_ttl_);
+  EXPECT_EQ(std::chrono::seconds(5), options->dnsCacheConfig().min_ttl_);
+  EXPECT_EQ(std::chrono::seconds(10), options->dnsCacheConfig().negative_ttl_);
+  EXPECT_EQ(std::chrono::seconds(60), options->dnsCacheConfig().stale_ttl_);
+  EXPECT_EQ(1073741824U, options->overloadConfig().max_heap_bytes_);
+  EXPECT_EQ(10000U, options->overloadConfig().max_connections_);
+  EXPECT_EQ(20000U, options->overloadConfig().max_active_streams_);
+  EXPECT_EQ(std::chrono::milliseconds(250), options->overloadConfig().refresh_interval_);
+  EXPECT_TRUE(options->watchdogSampleStacks());
+  EXPECT_EQ((std::vector<std::pair<std::string, std::string>>{{"shard", "(\\.shard_(\\d+))$"},
+                                                              {"a", "b=c"}}),
+            options->statsTags());
 }
 
 TEST(OptionsImplTest, DefaultParams) {
   std::unique_ptr<OptionsImpl> options = createOptionsImpl("envoy -c hello");
   EXPECT_EQ(std::chrono::seconds(600), options->drainTime());
+  EXPECT_EQ(0U, options->drainCloseRate());
+  EXPECT_EQ(0U, options->logAsyncBufferSize());
   EXPECT_EQ(std::chrono::seconds(900), options->parentShutdownTime());
   EXPECT_EQ("", options->adminAddressPath());
   EXPECT_EQ(Network::Address::IpVersion::v4, options->localAddressIpVersion());
   EXPECT_EQ(Server::Mode::Serve, options->mode());
+  EXPECT_EQ(16384U, options->maxStats());
+  EXPECT_EQ(262144U, options->connectionReadBudget());
+  EXPECT_EQ("", options->eventBackend());
+  EXPECT_EQ(64U, options->maxAcceptsPerEvent());
+  EXPECT_FALSE(options->reusePort());
+  EXPECT_FALSE(options->balanceConnections());
+  EXPECT_EQ(0U, options->privateKeyThreads());
+  EXPECT_TRUE(options->workerCpus().empty());
+  EXPECT_EQ(std::chrono::seconds(0), options->dnsCacheConfig().max_ttl_);
+  EXPECT_EQ(0U, options->overloadConfig().max_heap_bytes_);
+  EXPECT_EQ(std::chrono::milliseconds(1000), options->overloadConfig().refresh_interval_);
+  EXPECT_FALSE(options->watchdogSampleStacks());
+  EXPECT_TRUE(options->statsTags().empty());
 }
 
 TEST(OptionsImplTest, BadCliOption) {
   EXPECT_DEATH(createOptionsImpl("envoy -c hello --local-address-ip-version foo"),
                "error: unknown IP address version 'foo'");
+  EXPECT_DEATH(createOptionsImpl("envoy -c hello --event-backend io_uring"),
+               "error: unknown event backend 'io_uring'");
+  EXPECT_DEATH(createOptionsImpl("envoy -c hello --worker-cpus 3-1"),
+               "error: invalid CPU list '3-1'");
+  EXPECT_DEATH(createOptionsImpl("envoy -c hello --stats-tag =foo"),
+               "error: invalid stats tag '=foo'");
+  EXPECT_DEATH(createOptionsImpl("envoy -c hello --stats-tag foo"),
+               "error: invalid stats tag 'foo'");
+  EXPECT_DEATH(createOptionsImpl("envoy -c hello --max-stats 0"),
+               "error: --max-stats must be between 1 and 1048576");
+  EXPECT_DEATH(createOptionsImpl("envoy -c hello --max-stats 1048577"),
+               "error: --max-stats must be between 1 and 1048576");
+  EXPECT_DEATH(createOptionsImpl("envoy -c hello --max-stats 4294967295"),
+               "error: --max-stats must be between 1 and 1048576");
+}
+
+TEST(OptionsImplTest, ParseCpuList) {
+  std::vector<uint32_t> cpus;
+  EXPECT_TRUE(OptionsImpl::parseCpuList("", cpus));
+  EXPECT_TRUE(cpus.empty());
+  EXPECT_TRUE(OptionsImpl::parseCpuList("4", cpus));
+  EXPECT_EQ(std::vector<uint32_t>{4}, cpus);
+  EXPECT_TRUE(OptionsImpl::parseCpuList("8-9,0,2-3", cpus));
+  EXPECT_EQ((std::vector<uint32_t>{8, 9, 0, 2, 3}), cpus);
+
+  for (const std::string list : {",", "1,", "a", "1-", "-1", "1-2-3", "2-1", "4096"}) {
+    EXPECT_FALSE(OptionsImpl::parseCpuList(list, cpus)) << list;
+  }
 }
 } // namespace Envoy
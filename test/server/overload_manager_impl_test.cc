@@ -0,0 +1,112 @@
+#include <chrono>
+#include <vector>
+
+#include "common/stats/stats_impl.h"
+
+#include "server/overload_manager_impl.h"
+
+#include "test/mocks/event/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::NiceMock;
+using testing::_;
+
+namespace Envoy {
+namespace Server {
+
+class OverloadManagerImplTest : public testing::Test {
+public:
+  OverloadManagerImplTest() { config_.max_connections_ = 100; }
+
+  void createManager() {
+    refresh_timer_ = new Event::MockTimer(&dispatcher_);
+    manager_.reset(new OverloadManagerImpl(dispatcher_, stats_store_, config_,
+                                           [this]() -> OverloadResourceUsage { return usage_; }));
+  }
+
+  void refreshAt(uint64_t connections) {
+    usage_.connections_ = connections;
+    EXPECT_CALL(*refresh_timer_, enableTimer(std::chrono::milliseconds(1000)));
+    refresh_timer_->callback_();
+  }
+
+  uint64_t gauge(const std::string& name) { return stats_store_.gauge("overload." + name).value(); }
+
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  Stats::IsolatedStoreImpl stats_store_;
+  OverloadConfig config_;
+  OverloadResourceUsage usage_{};
+  Event::MockTimer* refresh_timer_;
+  std::unique_ptr<OverloadManagerImpl> manager_;
+};
+
+TEST_F(OverloadManagerImplTest, Pressure) {
+  config_.max_heap_bytes_ = 1000;
+  config_.max_active_streams_ = 10;
+  createManager();
+
+  EXPECT_DOUBLE_EQ(0, manager_->pressure({0, 0, 0}));
+  EXPECT_DOUBLE_EQ(0.5, manager_->pressure({500, 10, 1}));
+  EXPECT_DOUBLE_EQ(0.7, manager_->pressure({500, 10, 7}));
+  EXPECT_DOUBLE_EQ(1.2, manager_->pressure({0, 120, 0}));
+}
+
+TEST_F(OverloadManagerImplTest, NoLimits) {
+  config_.max_connections_ = 0;
+  EXPECT_CALL(dispatcher_, createTimer_(_)).Times(0);
+  manager_.reset(new OverloadManagerImpl(dispatcher_, stats_store_, config_,
+                                         [this]() -> OverloadResourceUsage { return usage_; }));
+  manager_->start();
+  EXPECT_FALSE(manager_->isActive(OverloadAction::ShrinkBufferLimits));
+}
+
+TEST_F(OverloadManagerImplTest, Actions) {
+  createManager();
+  std::vector<bool> stop_accepting;
+  manager_->registerForAction(OverloadAction::StopAcceptingConnections, dispatcher_,
+                              [&stop_accepting](bool active) -> void {
+                                stop_accepting.push_back(active);
+                              });
+
+  EXPECT_CALL(*refresh_timer_, enableTimer(std::chrono::milliseconds(1000)));
+  manager_->start();
+
+  refreshAt(50);
+  EXPECT_EQ(50U, gauge("pressure_percent"));
+  EXPECT_FALSE(manager_->isActive(OverloadAction::ShrinkBufferLimits));
+
+  refreshAt(85);
+  EXPECT_TRUE(manager_->isActive(OverloadAction::ShrinkBufferLimits));
+  EXPECT_FALSE(manager_->isActive(OverloadAction::DisableHttpKeepAlive));
+  EXPECT_EQ(1U, gauge("shrink_buffer_limits_active"));
+
+  refreshAt(100);
+  EXPECT_TRUE(manager_->isActive(OverloadAction::DisableHttpKeepAlive));
+  EXPECT_TRUE(manager_->isActive(OverloadAction::StopAcceptingConnections));
+  EXPECT_TRUE(manager_->isActive(OverloadAction::RejectNewStreams));
+  EXPECT_EQ(std::vector<bool>({true}), stop_accepting);
+
+  // The actions stay active until the pressure falls a tenth below their thresholds.
+  refreshAt(91);
+  EXPECT_TRUE(manager_->isActive(OverloadAction::RejectNewStreams));
+  EXPECT_TRUE(manager_->isActive(OverloadAction::StopAcceptingConnections));
+  refreshAt(89);
+  EXPECT_FALSE(manager_->isActive(OverloadAction::RejectNewStreams));
+  EXPECT_TRUE(manager_->isActive(OverloadAction::StopAcceptingConnections));
+  EXPECT_EQ(0U, gauge("reject_new_streams_active"));
+  refreshAt(84);
+  EXPECT_FALSE(manager_->isActive(OverloadAction::StopAcceptingConnections));
+  EXPECT_TRUE(manager_->isActive(OverloadAction::DisableHttpKeepAlive));
+  EXPECT_TRUE(manager_->isActive(OverloadAction::ShrinkBufferLimits));
+  EXPECT_EQ(std::vector<bool>({true, false}), stop_accepting);
+
+  refreshAt(0);
+  EXPECT_FALSE(manager_->isActive(OverloadAction::DisableHttpKeepAlive));
+  EXPECT_FALSE(manager_->isActive(OverloadAction::ShrinkBufferLimits));
+  EXPECT_EQ(std::vector<bool>({true, false}), stop_accepting);
+}
+
+} // namespace Server
+} // namespace Envoy
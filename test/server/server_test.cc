@@ -2,6 +2,7 @@
 #include "common/network/address_impl.h"
 #include "common/thread_local/thread_local_impl.h"
 
+#include "server/configuration_impl.h"
 #include "server/server.h"
 
 #include "test/integration/server.h"
@@ -12,6 +13,9 @@
 #include "gtest/gtest.h"
 
 using testing::InSequence;
+using testing::NiceMock;
+using testing::Ref;
+using testing::Return;
 using testing::SaveArg;
 using testing::StrictMock;
 using testing::_;
@@ -27,13 +31,99 @@ TEST(ServerInstanceUtil, flushHelper) {
   store.gauge("world").set(5);
   std::unique_ptr<Stats::MockSink> sink(new StrictMock<Stats::MockSink>());
   EXPECT_CALL(*sink, beginFlush());
-  EXPECT_CALL(*sink, flushCounter("hello", 1));
-  EXPECT_CALL(*sink, flushGauge("world", 5));
+  EXPECT_CALL(*sink, flushCounter(Ref(store.counter("hello")), 1));
+  EXPECT_CALL(*sink, wantsAllGauges()).WillOnce(Return(false));
+  EXPECT_CALL(*sink, flushGauge(Ref(store.gauge("world")), 5));
   EXPECT_CALL(*sink, endFlush());
 
   std::list<Stats::SinkPtr> sinks;
   sinks.emplace_back(std::move(sink));
-  InstanceUtil::flushCountersAndGaugesToSinks(sinks, store);
+  InstanceUtil::flushMetricsToSinks(sinks, store);
+}
+
+TEST(ServerInstanceUtil, flushOnlyChanged) {
+  InSequence s;
+
+  Stats::IsolatedStoreImpl store;
+  store.counter("hello").inc();
+  store.counter("unchanged");
+  store.gauge("world").set(5);
+  Stats::MockSink* sink = new StrictMock<Stats::MockSink>();
+  std::list<Stats::SinkPtr> sinks;
+  sinks.emplace_back(sink);
+
+  EXPECT_CALL(*sink, beginFlush());
+  EXPECT_CALL(*sink, flushCounter(Ref(store.counter("hello")), 1));
+  EXPECT_CALL(*sink, wantsAllGauges()).WillOnce(Return(false));
+  EXPECT_CALL(*sink, flushGauge(Ref(store.gauge("world")), 5));
+  EXPECT_CALL(*sink, endFlush());
+  InstanceUtil::flushMetricsToSinks(sinks, store);
+
+  // Nothing changed since the previous flush.
+  EXPECT_CALL(*sink, beginFlush());
+  EXPECT_CALL(*sink, wantsAllGauges()).WillOnce(Return(false));
+  EXPECT_CALL(*sink, endFlush());
+  InstanceUtil::flushMetricsToSinks(sinks, store);
+
+  store.counter("hello").add(2);
+  EXPECT_CALL(*sink, beginFlush());
+  EXPECT_CALL(*sink, flushCounter(Ref(store.counter("hello")), 2));
+  EXPECT_CALL(*sink, wantsAllGauges()).WillOnce(Return(false));
+  EXPECT_CALL(*sink, endFlush());
+  InstanceUtil::flushMetricsToSinks(sinks, store);
+}
+
+TEST(ServerInstanceUtil, flushAllGauges) {
+  InSequence s;
+
+  Stats::IsolatedStoreImpl store;
+  store.gauge("world").set(5);
+  Stats::MockSink* sink = new StrictMock<Stats::MockSink>();
+  std::list<Stats::SinkPtr> sinks;
+  sinks.emplace_back(sink);
+
+  EXPECT_CALL(*sink, beginFlush());
+  EXPECT_CALL(*sink, wantsAllGauges()).WillOnce(Return(false));
+  EXPECT_CALL(*sink, flushGauge(Ref(store.gauge("world")), 5));
+  EXPECT_CALL(*sink, endFlush());
+  InstanceUtil::flushMetricsToSinks(sinks, store);
+
+  // A sink that starts over gets the gauge although it did not change.
+  EXPECT_CALL(*sink, beginFlush());
+  EXPECT_CALL(*sink, wantsAllGauges()).WillOnce(Return(true));
+  EXPECT_CALL(*sink, flushGauge(Ref(store.gauge("world")), 5));
+  EXPECT_CALL(*sink, endFlush());
+  InstanceUtil::flushMetricsToSinks(sinks, store);
+
+  // The changes were latched during that flush all the same.
+  EXPECT_CALL(*sink, beginFlush());
+  EXPECT_CALL(*sink, wantsAllGauges()).WillOnce(Return(false));
+  EXPECT_CALL(*sink, endFlush());
+  InstanceUtil::flushMetricsToSinks(sinks, store);
+}
+
+// The maintenance thread is only created if the runtime enables it when the server starts.
+TEST(ServerInstanceUtil, maintenanceThreadEnabled) {
+  NiceMock<MockInstance> server;
+  envoy::api::v2::Bootstrap bootstrap;
+  bootstrap.mutable_admin()->mutable_address()->mutable_pipe()->set_path("/admin");
+  Configuration::InitialImpl no_runtime(bootstrap);
+  EXPECT_FALSE(InstanceUtil::maintenanceThreadEnabled(server, no_runtime));
+
+  const std::string root = TestEnvironment::temporaryPath("maintenance_runtime");
+  TestEnvironment::exec({"mkdir", "-p", root + "/envoy/health_check"});
+  bootstrap.mutable_runtime()->set_symlink_root(root);
+  bootstrap.mutable_runtime()->set_subdirectory("envoy");
+  bootstrap.mutable_runtime()->set_override_subdirectory("envoy_override");
+  Configuration::InitialImpl initial(bootstrap);
+  EXPECT_FALSE(InstanceUtil::maintenanceThreadEnabled(server, initial));
+
+  TestEnvironment::writeStringToFileForTest(
+      "maintenance_runtime/envoy/health_check/maintenance_thread", "1");
+  EXPECT_TRUE(InstanceUtil::maintenanceThreadEnabled(server, initial));
+  TestEnvironment::writeStringToFileForTest(
+      "maintenance_runtime/envoy/health_check/maintenance_thread", "0");
+  EXPECT_FALSE(InstanceUtil::maintenanceThreadEnabled(server, initial));
 }
 
 class RunHelperTest : public testing::Test {
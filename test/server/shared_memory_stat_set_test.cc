@@ -0,0 +1,93 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "server/shared_memory_stat_set.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Server {
+
+class SharedMemoryStatSetTest : public testing::Test {
+public:
+  void init(uint32_t capacity) {
+    // Back the memory with uint64_t to get the alignment shared memory would have.
+    memory_.resize(SharedMemoryStatSet::bytesRequired(capacity) / sizeof(uint64_t) + 1);
+    set_.reset(new SharedMemoryStatSet(memory(), capacity, true));
+  }
+
+  uint8_t* memory() { return reinterpret_cast<uint8_t*>(memory_.data()); }
+
+  std::vector<uint64_t> memory_;
+  std::unique_ptr<SharedMemoryStatSet> set_;
+};
+
+TEST_F(SharedMemoryStatSetTest, InsertFindRemove) {
+  init(4);
+  EXPECT_EQ(4U, set_->capacity());
+  EXPECT_EQ(nullptr, set_->find("a"));
+
+  Stats::RawStatData* a = set_->insert("a");
+  Stats::RawStatData* b = set_->insert("b");
+  EXPECT_EQ(2U, set_->size());
+  EXPECT_EQ(a, set_->find("a"));
+  EXPECT_EQ(b, set_->find("b"));
+  EXPECT_STREQ("a", a->name_);
+  EXPECT_EQ(1U, a->ref_count_);
+
+  set_->remove(*a);
+  EXPECT_EQ(1U, set_->size());
+  EXPECT_EQ(nullptr, set_->find("a"));
+  EXPECT_EQ(b, set_->find("b"));
+  EXPECT_FALSE(a->initialized());
+
+  // The freed slot is reused.
+  EXPECT_EQ(a, set_->insert("c"));
+}
+
+TEST_F(SharedMemoryStatSetTest, Full) {
+  init(3);
+  std::vector<Stats::RawStatData*> stats;
+  for (uint32_t i = 0; i < 3; i++) {
+    stats.push_back(set_->insert(std::to_string(i)));
+    EXPECT_NE(nullptr, stats.back());
+  }
+  EXPECT_EQ(nullptr, set_->insert("overflow"));
+
+  set_->remove(*stats[1]);
+  EXPECT_NE(nullptr, set_->insert("overflow"));
+  EXPECT_EQ(nullptr, set_->insert("overflow2"));
+  for (uint32_t i : {0, 2}) {
+    EXPECT_EQ(stats[i], set_->find(std::to_string(i)));
+  }
+}
+
+TEST_F(SharedMemoryStatSetTest, Truncation) {
+  init(2);
+  const std::string long_name(Stats::RawStatData::MAX_NAME_SIZE + 10, 'a');
+  const std::string truncated_name(Stats::RawStatData::MAX_NAME_SIZE, 'a');
+
+  Stats::RawStatData* stat = set_->insert(truncated_name);
+  EXPECT_EQ(stat, set_->find(long_name));
+  EXPECT_EQ(stat, set_->find(truncated_name));
+  set_->remove(*stat);
+  EXPECT_EQ(nullptr, set_->find(truncated_name));
+}
+
+TEST_F(SharedMemoryStatSetTest, Attach) {
+  init(16);
+  Stats::RawStatData* a = set_->insert("a");
+  a->value_ = 5;
+
+  // A second process attaching to the same memory sees the same stats.
+  SharedMemoryStatSet attached(memory(), 16, false);
+  EXPECT_EQ(1U, attached.size());
+  EXPECT_EQ(a, attached.find("a"));
+  EXPECT_EQ(5U, attached.find("a")->value_);
+  attached.insert("b");
+  EXPECT_NE(nullptr, set_->find("b"));
+}
+
+} // namespace Server
+} // namespace Envoy
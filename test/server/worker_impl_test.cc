@@ -1,4 +1,8 @@
+#include <atomic>
+#include <functional>
+
 #include "common/event/dispatcher_impl.h"
+#include "common/stats/stats_impl.h"
 
 #include "server/worker_impl.h"
 
@@ -10,15 +14,28 @@
 #include "gtest/gtest.h"
 
 using testing::InSequence;
+using testing::Invoke;
 using testing::InvokeWithoutArgs;
 using testing::NiceMock;
+using testing::Ref;
 using testing::Return;
+using testing::ReturnRef;
 using testing::Throw;
 using testing::_;
 
 namespace Envoy {
 namespace Server {
 
+class CountingTestHooks : public TestHooks {
+public:
+  // TestHooks
+  void onWorkerListenerAdded() override { added_++; }
+  void onWorkerListenerRemoved() override { removed_++; }
+
+  std::atomic<uint32_t> added_{};
+  std::atomic<uint32_t> removed_{};
+};
+
 class WorkerImplTest : public testing::Test {
 public:
   WorkerImplTest() {
@@ -31,9 +48,11 @@ public:
   Event::DispatcherImpl* dispatcher_ = new Event::DispatcherImpl();
   Network::MockConnectionHandler* handler_ = new Network::MockConnectionHandler();
   NiceMock<MockGuardDog> guard_dog_;
-  DefaultTestHooks hooks_;
+  CountingTestHooks hooks_;
+  Stats::IsolatedStoreImpl stats_store_;
   WorkerImpl worker_{tls_, hooks_, Event::DispatcherPtr{dispatcher_},
-                     Network::ConnectionHandlerPtr{handler_}};
+                     Network::ConnectionHandlerPtr{handler_}, 1,
+                     stats_store_.createScope("worker."), Optional<uint32_t>()};
   Event::TimerPtr no_exit_timer_ = dispatcher_->createTimer([]() -> void {});
 };
 
@@ -110,6 +129,84 @@ TEST_F(WorkerImplTest, BasicFlow) {
     EXPECT_NE(current_thread_id, std::this_thread::get_id());
   });
 
+  // A retired listener reports its removal once the handler has removed it.
+  EXPECT_CALL(*handler_, retireListeners(1, _))
+      .WillOnce(Invoke([current_thread_id](uint64_t, std::function<void()> completion) -> void {
+        EXPECT_NE(current_thread_id, std::this_thread::get_id());
+        completion();
+      }));
+  worker_.retireListener(listener, [current_thread_id, &ci]() -> void {
+    EXPECT_NE(current_thread_id, std::this_thread::get_id());
+    ci.setReady();
+  });
+  ci.waitReady();
+
+  worker_.stop();
+}
+
+// A listener with a socket per worker is added with the socket of the worker's index.
+TEST_F(WorkerImplTest, WorkerSocket) {
+  InSequence s;
+  ConditionalInitializer ci;
+
+  NiceMock<MockListener> listener;
+  NiceMock<Network::MockListenSocket> worker_socket;
+  ON_CALL(listener, listenerTag()).WillByDefault(Return(1));
+  ON_CALL(listener, workerSocket(1)).WillByDefault(ReturnRef(worker_socket));
+  EXPECT_CALL(*handler_, addListener(_, Ref(worker_socket), _, 1, _));
+  worker_.addListener(listener, [&ci](bool success) -> void {
+    EXPECT_TRUE(success);
+    ci.setReady();
+  });
+
+  worker_.start(guard_dog_);
+  ci.waitReady();
+  worker_.stop();
+}
+
+// A listener that is retired and then removed reports its removal once, whether its retire
+// completes before the removal or because of it.
+TEST_F(WorkerImplTest, RetireThenRemove) {
+  InSequence s;
+  ConditionalInitializer ci;
+
+  NiceMock<MockListener> listener1;
+  NiceMock<MockListener> listener2;
+  ON_CALL(listener1, listenerTag()).WillByDefault(Return(1));
+  ON_CALL(listener2, listenerTag()).WillByDefault(Return(2));
+  EXPECT_CALL(*handler_, addListener(_, _, _, 1, _));
+  worker_.addListener(listener1, [](bool success) -> void { EXPECT_TRUE(success); });
+  EXPECT_CALL(*handler_, addListener(_, _, _, 2, _));
+  worker_.addListener(listener2, [&ci](bool success) -> void {
+    EXPECT_TRUE(success);
+    ci.setReady();
+  });
+  worker_.start(guard_dog_);
+  ci.waitReady();
+  EXPECT_EQ(2U, hooks_.added_);
+
+  // The first listener closes its last connection before it is removed.
+  EXPECT_CALL(*handler_, retireListeners(1, _))
+      .WillOnce(Invoke([](uint64_t, std::function<void()> completion) -> void { completion(); }));
+  worker_.retireListener(listener1, []() -> void {});
+  EXPECT_CALL(*handler_, removeListeners(1));
+  worker_.removeListener(listener1, [&ci]() -> void { ci.setReady(); });
+  ci.waitReady();
+  EXPECT_EQ(1U, hooks_.removed_);
+
+  // The second listener still has connections, so its retire completes when it is removed.
+  std::function<void()> retire_completion;
+  EXPECT_CALL(*handler_, retireListeners(2, _))
+      .WillOnce(Invoke([&retire_completion](uint64_t, std::function<void()> completion) -> void {
+        retire_completion = completion;
+      }));
+  worker_.retireListener(listener2, []() -> void {});
+  EXPECT_CALL(*handler_, removeListeners(2))
+      .WillOnce(InvokeWithoutArgs([&retire_completion]() -> void { retire_completion(); }));
+  worker_.removeListener(listener2, [&ci]() -> void { ci.setReady(); });
+  ci.waitReady();
+  EXPECT_EQ(2U, hooks_.removed_);
+
   worker_.stop();
 }
 
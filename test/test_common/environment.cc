@@ -87,7 +87,8 @@ std::vector<Network::Address::IpVersion> TestEnvironment::getIpVersionsForTest()
 }
 
 Server::Options& TestEnvironment::getOptions() {
-  static OptionsImpl* options = new OptionsImpl(argc_, argv_, "1", spdlog::level::err);
+  static OptionsImpl* options = new OptionsImpl(
+      argc_, argv_, [](uint32_t) { return "1"; }, spdlog::level::err);
   return *options;
 }
 
@@ -41,31 +41,8 @@ TestRandomGenerator::TestRandomGenerator()
 uint64_t TestRandomGenerator::random() { return generator_(); }
 
 bool TestUtility::buffersEqual(const Buffer::Instance& lhs, const Buffer::Instance& rhs) {
-  if (lhs.length() != rhs.length()) {
-    return false;
-  }
-
-  uint64_t lhs_num_slices = lhs.getRawSlices(nullptr, 0);
-  uint64_t rhs_num_slices = rhs.getRawSlices(nullptr, 0);
-  if (lhs_num_slices != rhs_num_slices) {
-    return false;
-  }
-
-  Buffer::RawSlice lhs_slices[lhs_num_slices];
-  lhs.getRawSlices(lhs_slices, lhs_num_slices);
-  Buffer::RawSlice rhs_slices[rhs_num_slices];
-  rhs.getRawSlices(rhs_slices, rhs_num_slices);
-  for (size_t i = 0; i < lhs_num_slices; i++) {
-    if (lhs_slices[i].len_ != rhs_slices[i].len_) {
-      return false;
-    }
-
-    if (0 != memcmp(lhs_slices[i].mem_, rhs_slices[i].mem_, lhs_slices[i].len_)) {
-      return false;
-    }
-  }
-
-  return true;
+  // The slice layout depends on how the data was added or moved, so only compare the contents.
+  return lhs.length() == rhs.length() && bufferToString(lhs) == bufferToString(rhs);
 }
 
 std::string TestUtility::bufferToString(const Buffer::Instance& buffer) {
@@ -98,6 +75,16 @@ Stats::GaugeSharedPtr TestUtility::findGauge(Stats::Store& store, const std::str
   return nullptr;
 }
 
+Stats::ParentHistogramSharedPtr TestUtility::findHistogram(Stats::Store& store,
+                                                           const std::string& name) {
+  for (auto histogram : store.histograms()) {
+    if (histogram->name() == name) {
+      return histogram;
+    }
+  }
+  return nullptr;
+}
+
 std::list<Network::Address::InstanceConstSharedPtr>
 TestUtility::makeDnsResponse(const std::list<std::string>& addresses) {
   std::list<Network::Address::InstanceConstSharedPtr> ret;
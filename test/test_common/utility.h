@@ -77,6 +77,15 @@ public:
    */
   static Stats::GaugeSharedPtr findGauge(Stats::Store& store, const std::string& name);
 
+  /**
+   * Find a histogram in a stats store.
+   * @param store supplies the stats store.
+   * @param name supplies the name to search for.
+   * @return Stats::ParentHistogramSharedPtr the histogram or nullptr if there is none.
+   */
+  static Stats::ParentHistogramSharedPtr findHistogram(Stats::Store& store,
+                                                       const std::string& name);
+
   /**
    * Convert a string list of IP addresses into a list of network addresses usable for DNS
    * response testing.